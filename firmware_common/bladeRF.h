@@ -51,6 +51,23 @@
 #define BLADE_OTP               _IOR(BLADERF_IOCTL_BASE, 52, unsigned int)
 #define BLADE_DEVICE_RESET      _IOR(BLADERF_IOCTL_BASE, 53, unsigned int)
 
+/* Zero-copy streaming via the Linux kernel driver's mmap()'d sample rings.
+ * See struct bladeRF_ring_info and struct bladeRF_ring_pos. */
+#define BLADE_RING_INFO         _IOR(BLADERF_IOCTL_BASE, 60, struct bladeRF_ring_info)
+#define BLADE_RX_RING_ADVANCE   _IOWR(BLADERF_IOCTL_BASE, 61, struct bladeRF_ring_pos)
+#define BLADE_TX_RING_ADVANCE   _IOWR(BLADERF_IOCTL_BASE, 62, struct bladeRF_ring_pos)
+#define BLADE_SET_RING_CONFIG   _IOW(BLADERF_IOCTL_BASE, 63, struct bladeRF_ring_config)
+#define BLADE_GET_STATS         _IOR(BLADERF_IOCTL_BASE, 64, struct bladeRF_stats)
+#define BLADE_SET_RX_META       _IOW(BLADERF_IOCTL_BASE, 65, unsigned int)
+
+/* Pass-through of control transfers and of synchronous bulk transfers on the
+ * peripheral endpoints, which allow libbladeRF to use the Linux kernel driver
+ * as a USB backend. See struct bladeRF_usb_control and struct bladeRF_usb_bulk.
+ * BLADE_SET_INTERFACE selects an alternate setting of interface 0. */
+#define BLADE_USB_CONTROL       _IOWR(BLADERF_IOCTL_BASE, 66, struct bladeRF_usb_control)
+#define BLADE_USB_BULK          _IOWR(BLADERF_IOCTL_BASE, 67, struct bladeRF_usb_bulk)
+#define BLADE_SET_INTERFACE     _IOW(BLADERF_IOCTL_BASE, 68, unsigned int)
+
 #define BLADE_USB_CMD_QUERY_VERSION             0
 #define BLADE_USB_CMD_QUERY_FPGA_STATUS         1
 #define BLADE_USB_CMD_BEGIN_PROG                2
@@ -73,6 +90,12 @@
 #define BLADE_USB_CMD_REFRESH_CAL_CACHE       112
 #define BLADE_USB_CMD_SET_LOOPBACK            113
 #define BLADE_USB_CMD_GET_LOOPBACK            114
+#define BLADE_USB_CMD_FLASH_CRC32             115
+#define BLADE_USB_CMD_SET_DMA_CONFIG          116
+#define BLADE_USB_CMD_GET_DMA_CONFIG          117
+#define BLADE_USB_CMD_GET_PERF_COUNTERS       118
+#define BLADE_USB_CMD_SET_BURST_LEN           119
+#define BLADE_USB_CMD_GET_FPGA_LOAD_TIME      120
 
 /* String descriptor indices */
 #define BLADE_USB_STR_INDEX_MFR     1   /* Manufacturer */
@@ -80,6 +103,75 @@
 #define BLADE_USB_STR_INDEX_SERIAL  3   /* Serial number */
 #define BLADE_USB_STR_INDEX_FW_VER  4   /* Firmware version */
 
+/* Maximum number of flash pages that may be read or written by a single
+ * BLADE_USB_CMD_FLASH_READ or BLADE_USB_CMD_FLASH_WRITE request, via the
+ * firmware's page buffer. The page count is specified via wValue, where 0
+ * denotes a single page. Supported as of FX3 firmware v1.9.0. */
+#define BLADE_FLASH_MAX_PAGES_PER_REQ 16
+
+/* BLADE_USB_CMD_FLASH_CRC32 computes the CRC-32 (as used by zlib, Ethernet,
+ * etc.) of wValue flash pages, starting at the page specified by wIndex. The
+ * page count may not exceed BLADE_FLASH_CRC32_MAX_PAGES (one erase block).
+ * The device responds with a struct bladerf_fx3_crc32.
+ *
+ * Supported as of FX3 firmware v1.9.0. */
+#define BLADE_FLASH_CRC32_MAX_PAGES 256
+
+/* BLADE_USB_CMD_SET_DMA_CONFIG selects the number (wValue) and size in bytes
+ * (wIndex) of the buffers backing each of the FX3's sample DMA channels. A
+ * value of 0 selects the firmware's default for that field. The buffer size
+ * must be a multiple of the current USB max packet size, and a channel's
+ * buffers may not exceed BLADE_DMA_MAX_CHANNEL_MEM in total. The device
+ * responds with a 32-bit status code; the new configuration takes effect the
+ * next time the RF link interface is selected.
+ *
+ * BLADE_USB_CMD_SET_BURST_LEN selects the burst length (wValue), in packets,
+ * of the sample endpoints at SuperSpeed, where 0 selects the default. It may
+ * not exceed BLADE_MAX_BURST_LEN. The device responds with a 32-bit status
+ * code, and the new burst length takes effect the next time the RF link
+ * interface is selected. By default, each SuperSpeed DMA buffer holds
+ * exactly one burst.
+ *
+ * BLADE_USB_CMD_GET_DMA_CONFIG responds with a struct bladerf_fx3_dma_config
+ * describing the configuration the RF link uses at the current USB speed.
+ *
+ * Supported as of FX3 firmware v1.9.0. */
+#define BLADE_DMA_MIN_BUF_COUNT     2
+#define BLADE_DMA_MAX_BUF_COUNT     256
+#define BLADE_DMA_MAX_BUF_SIZE      (32 * 1024)
+#define BLADE_DMA_MAX_CHANNEL_MEM   (96 * 1024)
+#define BLADE_MAX_BURST_LEN         16
+
+/* BLADE_USB_CMD_GET_FPGA_LOAD_TIME responds with a 32-bit value denoting the
+ * number of milliseconds the most recent FPGA configuration took, from the
+ * start of programming until the final portion of the bitstream was written
+ * to the FPGA. This applies both to bitstreams sent by the host and to those
+ * autoloaded from flash. BLADE_FPGA_LOAD_TIME_UNKNOWN is reported if no
+ * configuration has completed (i.e., CONF_DONE has not yet been observed).
+ *
+ * As of FX3 firmware v1.9.0, bitstreams sent by the host whose length is a
+ * multiple of the max packet size must be followed by a zero-length packet.
+ *
+ * Supported as of FX3 firmware v1.9.0. */
+#define BLADE_FPGA_LOAD_TIME_UNKNOWN (-1)
+
+/* BLADE_USB_CMD_BEGIN_PROG accepts flags via wValue. BLADE_FPGA_LOAD_COMPRESSED
+ * denotes a bitstream generated with on-chip decompression enabled, whose
+ * bytes are each held for several DCLK cycles while it is loaded.
+ *
+ * The FPGA autoload metadata denotes such a bitstream via a "CMP" field with
+ * a value of "1". Bitstreams are otherwise treated as uncompressed.
+ *
+ * Supported as of FX3 firmware v1.10.0. Earlier firmware ignores wValue. */
+#define BLADE_FPGA_LOAD_COMPRESSED  (1 << 0)
+
+/* BLADE_USB_CMD_GET_PERF_COUNTERS responds with a
+ * struct bladerf_fx3_perf_counters, describing the sample path activity since
+ * the RF link interface was selected or since the counters were last reset.
+ * A non-zero wValue resets the counters after they are reported.
+ *
+ * Supported as of FX3 firmware v1.9.0. */
+
 #define CAL_BUFFER_SIZE 256
 #define CAL_PAGE 768
 
@@ -104,6 +196,49 @@ struct bladerf_fx3_version {
     unsigned short minor;
 });
 
+PACK(
+struct bladerf_fx3_crc32 {
+    int status;         /* 0 on success, or a firmware error code */
+    unsigned int crc;   /* CRC-32 of the requested pages */
+});
+
+PACK(
+struct bladerf_fx3_dma_config {
+    unsigned short count;       /* Number of buffers per sample DMA channel */
+    unsigned short size;        /* Size of each buffer, in bytes */
+    unsigned short burst_len;   /* Endpoint burst length, in packets */
+    unsigned short packet_size; /* Endpoint max packet size, in bytes */
+});
+
+PACK(
+struct bladerf_fx3_perf_counters {
+    /* Bytes passed through each sample DMA channel, from its producer
+     * (GPIF for RX, USB for TX) and to its consumer */
+    unsigned long long rx_prod_bytes;
+    unsigned long long rx_cons_bytes;
+    unsigned long long tx_prod_bytes;
+    unsigned long long tx_cons_bytes;
+
+    /* GPIF RX thread overruns (no free DMA buffer for samples from the FPGA)
+     * and TX thread underruns (no samples available for the FPGA) */
+    unsigned int rx_overruns;
+    unsigned int tx_underruns;
+
+    unsigned int rx_dma_errors;     /* DMA channel error notifications */
+    unsigned int tx_dma_errors;
+    unsigned int pib_errors;        /* Other P-port (PIB) errors */
+    unsigned int gpif_errors;       /* GPIF state machine errors */
+
+    /* TX OUT endpoint flow control events (NAK/NRDY) issued because no DMA
+     * buffer was available for samples from the host */
+    unsigned int tx_ep_flow_control;
+
+    unsigned int rx_ep_retries;     /* SuperSpeed endpoint retries */
+    unsigned int tx_ep_retries;
+    unsigned int rx_ep_errors;      /* Endpoint sequence/stream errors */
+    unsigned int tx_ep_errors;
+});
+
 struct bladeRF_firmware {
     unsigned int len;
     unsigned char *ptr;
@@ -115,6 +250,99 @@ struct bladeRF_sector {
     unsigned char *ptr;
 };
 
+/* Layout of the sample rings, which are mapped by calling mmap() on the
+ * device with the offsets below. Each ring consists of `num_bufs` buffers of
+ * `buf_size` bytes, stored contiguously in the mapping. Mapping requires
+ * `buf_size` to be a multiple of the page size. */
+struct bladeRF_ring_info {
+    unsigned int num_bufs;      /* Buffers per ring */
+    unsigned int buf_size;      /* Bytes per buffer */
+    unsigned int rx_offset;     /* mmap() offset of the RX ring */
+    unsigned int tx_offset;     /* mmap() offset of the TX ring */
+};
+
+/* Argument to BLADE_RX_RING_ADVANCE and BLADE_TX_RING_ADVANCE.
+ *
+ * On input, `count` is the number of buffers the caller is done with: RX
+ * buffers it has finished reading, or TX buffers it has filled, starting at
+ * the index previously returned. A count of 0 only queries the ring, which
+ * enables RX streaming upon the first BLADE_RX_RING_ADVANCE.
+ *
+ * On output, `idx` is the ring index of the next buffer to read (RX) or fill
+ * (TX), and `count` is the number of buffers that are ready to be read (RX)
+ * or free to be filled (TX), starting at `idx` and wrapping around the ring.
+ * These calls do not block; poll() reports POLLIN when RX buffers are ready,
+ * and POLLOUT when TX buffers are free. */
+struct bladeRF_ring_pos {
+    unsigned int idx;
+    unsigned int count;
+};
+
+/* Argument to BLADE_SET_RING_CONFIG, which reallocates both rings. This fails
+ * with EBUSY while RX or TX is in use by an open handle of the device, and
+ * existing mappings of the rings must be unmapped first. The defaults are set by the driver's num_bufs and buf_size parameters.
+ *
+ * `num_bufs` must be a power of two in [NUM_CONCURRENT, BLADE_RING_MAX_BUFS],
+ * and `buf_size` a multiple of 1024 in [1024, BLADE_RING_MAX_BUF_SZ]. */
+struct bladeRF_ring_config {
+    unsigned int num_bufs;      /* Buffers per ring */
+    unsigned int buf_size;      /* Bytes per buffer */
+};
+
+/* Streaming statistics reported by BLADE_GET_STATS, and by the Linux kernel
+ * driver's sysfs "stats" attributes. Counters accumulate across streams.
+ *
+ * An RX overrun is counted each time RX stalls because every buffer holds
+ * samples the application has yet to read, causing samples to be dropped.
+ * A TX underrun is counted each time TX runs out of queued buffers, which
+ * includes the end of each transmission.
+ *
+ * RX timestamp discontinuities are only detected while the FPGA's metadata
+ * headers are enabled via BLADE_SET_RX_META, in which case the headers are
+ * delivered intact, as with libbladeRF's BLADERF_FORMAT_SC16_Q11_META. */
+struct bladeRF_stats {
+    unsigned long long rx_buffers;      /* RX buffers received */
+    unsigned long long tx_buffers;      /* TX buffers sent */
+    unsigned long long rx_gap_ticks;    /* Timestamp ticks skipped by gaps */
+    unsigned int rx_overruns;           /* RX stalls due to a full ring */
+    unsigned int tx_underruns;          /* TX stalls due to an empty ring */
+    unsigned int rx_errors;             /* RX transfers that failed */
+    unsigned int tx_errors;             /* TX transfers that failed */
+    unsigned int rx_inflight;           /* RX transfers currently submitted */
+    unsigned int tx_inflight;           /* TX transfers currently submitted */
+    unsigned int rx_queued;             /* RX buffers awaiting the application */
+    unsigned int tx_queued;             /* TX buffers awaiting submission */
+    unsigned int rx_gaps;               /* RX timestamp discontinuities */
+    unsigned int reserved;
+};
+
+/* Argument to BLADE_USB_CONTROL, which returns the number of bytes
+ * transferred. Only vendor requests and standard device-to-host requests are
+ * permitted; use BLADE_SET_INTERFACE to change alternate settings.
+ *
+ * The BLADE_USB_CMD_RF_RX and BLADE_USB_CMD_RF_TX requests are handled by the
+ * driver, which starts or stops its transfers along with the FX3's. */
+struct bladeRF_usb_control {
+    unsigned char request_type;     /* bmRequestType */
+    unsigned char request;          /* bRequest */
+    unsigned short value;           /* wValue */
+    unsigned short index;           /* wIndex */
+    unsigned short len;             /* wLength, up to BLADE_USB_CONTROL_MAX_LEN */
+    unsigned int timeout_ms;
+    unsigned char *ptr;
+};
+
+/* Argument to BLADE_USB_BULK, which returns the number of bytes transferred.
+ * Only the peripheral endpoints (0x02 and 0x82) may be used; the sample
+ * endpoints belong to the driver's rings. A device-to-host transfer ends
+ * early upon a short packet. */
+struct bladeRF_usb_bulk {
+    unsigned int endpoint;
+    unsigned int len;
+    unsigned int timeout_ms;
+    unsigned char *ptr;
+};
+
 #define USB_CYPRESS_VENDOR_ID   0x04b4
 #define USB_FX3_PRODUCT_ID      0x00f3
 
@@ -129,6 +357,21 @@ struct bladeRF_sector {
 #define NUM_CONCURRENT  8
 #define NUM_DATA_URB    (1024)
 #define DATA_BUF_SZ     (1024*4)
+#define BLADE_MMAP_RX_OFFSET    0
+#define BLADE_RING_MAX_BUFS     (64*1024)
+#define BLADE_RING_MAX_BUF_SZ   (1024*1024)
+
+/* FPGA metadata header fields and the configuration GPIO byte holding the
+ * timestamp enable and 2x divider bits, used by BLADE_SET_RX_META */
+#define BLADE_META_HEADER_SZ            16
+#define BLADE_META_TIMESTAMP_OFFSET     4
+#define BLADE_GPIO_TIMESTAMP_ADDR       2
+#define BLADE_GPIO_TIMESTAMP_BITS       0x03
+
+/* Largest control and bulk transfers accepted by BLADE_USB_CONTROL and
+ * BLADE_USB_BULK. Longer bulk transfers are split into pieces of this size. */
+#define BLADE_USB_CONTROL_MAX_LEN       4096
+#define BLADE_USB_BULK_MAX_LEN          (64*1024)
 
 #define UART_PKT_DEV_GPIO_ADDR          0
 #define UART_PKT_DEV_RX_GAIN_ADDR       4
@@ -158,8 +401,49 @@ struct uart_pkt {
 #define UART_PKT_MODE_DIR_SHIFT  6
 #define UART_PKT_MODE_DIR_READ   (2<<UART_PKT_MODE_DIR_SHIFT)
 #define UART_PKT_MODE_DIR_WRITE  (1<<UART_PKT_MODE_DIR_SHIFT)
+#define UART_PKT_MODE_DIR_SEQ    (3<<UART_PKT_MODE_DIR_SHIFT)
+
+    /* With UART_PKT_MODE_DIR_SEQ, the dev field selects a sequence request */
+#define UART_PKT_SEQ_APPEND      (0<<UART_PKT_MODE_DEV_SHIFT)
+#define UART_PKT_SEQ_RUN         (1<<UART_PKT_MODE_DEV_SHIFT)
+#define UART_PKT_SEQ_RESULTS     (2<<UART_PKT_MODE_DEV_SHIFT)
+#define UART_PKT_SEQ_CLEAR       (3<<UART_PKT_MODE_DEV_SHIFT)
 };
 
+/* Command sequences run by the NIOS II without a host round trip per access.
+ * SEQ_APPEND packets add their payload to the program, and a SEQ_RUN packet
+ * runs and then discards it. Each operation is an opcode followed by its
+ * arguments:
+ *
+ *  WRITE   addr, data                  Write data to addr
+ *  READ    addr                        Read addr into the results
+ *  MODIFY  addr, mask, value           Replace the mask bits of addr
+ *  POLL    addr, mask, value, tries    Read addr up to tries times, until
+ *                                      (reg & mask) == value, and store the
+ *                                      last value read in the results
+ *
+ * OR'ing UART_PKT_SEQ_OP_SI5338 into an opcode accesses the Si5338 instead of
+ * the LMS6002D.
+ *
+ * The SEQ_RUN response payload holds the status, the number of operations
+ * completed, the number of results and the first UART_PKT_SEQ_RUN_RESULTS
+ * results. A SEQ_RESULTS request carries a result offset in its first byte,
+ * and its response holds the 14 results from that offset. */
+#define UART_PKT_SEQ_PROG_LEN           96
+#define UART_PKT_SEQ_RESULTS_LEN        32
+#define UART_PKT_SEQ_RUN_RESULTS        11
+
+#define UART_PKT_SEQ_OP_WRITE           0x10
+#define UART_PKT_SEQ_OP_READ            0x20
+#define UART_PKT_SEQ_OP_MODIFY          0x30
+#define UART_PKT_SEQ_OP_POLL            0x40
+#define UART_PKT_SEQ_OP_SI5338          0x01
+
+#define UART_PKT_SEQ_STATUS_OK          0
+#define UART_PKT_SEQ_STATUS_TIMEOUT     1
+#define UART_PKT_SEQ_STATUS_INVALID     2
+#define UART_PKT_SEQ_STATUS_OVERFLOW    3
+
 struct uart_cmd {
     union {
         struct {
@@ -47,7 +47,8 @@ uint8_t glUsbAltInterface = 0;                 /* Active USB interface. */
 
 
 uint8_t glSelBuffer[32];
-uint8_t glPageBuffer[FLASH_PAGE_SIZE] __attribute__ ((aligned (32)));
+uint8_t glPageBuffer[FLASH_PAGE_SIZE * BLADE_FLASH_MAX_PAGES_PER_REQ]
+    __attribute__ ((aligned (32)));
 
 CyBool_t glCalCacheValid = CyFalse;
 uint8_t glCal[CAL_BUFFER_SIZE] __attribute__ ((aligned (32)));
@@ -345,6 +346,7 @@ CyBool_t NuandHandleVendorRequest(
     CyU3PReturnStatus_t apiRetStatus = CY_U3P_SUCCESS;
     int retStatus;
     uint16_t readC;
+    uint16_t numPages;
     CyBool_t txen, rxen;
     txen = rxen = CyFalse ;
     isHandled = CyTrue;
@@ -415,7 +417,8 @@ CyBool_t NuandHandleVendorRequest(
     break;
 
     case BLADE_USB_CMD_BEGIN_PROG:
-        retStatus = FpgaBeginProgram();
+        retStatus = FpgaBeginProgram(
+                (wValue & BLADE_FPGA_LOAD_COMPRESSED) ? CyTrue : CyFalse);
         CyU3PUsbSendRetCode(retStatus);
     break;
 
@@ -423,6 +426,9 @@ CyBool_t NuandHandleVendorRequest(
         apiRetStatus = CyU3PGpioGetValue (GPIO_CONFDONE, &fpgaProg);
         if (apiRetStatus == CY_U3P_SUCCESS) {
             ret = fpgaProg ? 1 : 0;
+            if (fpgaProg) {
+                NuandFpgaLoadDone();
+            }
         } else {
             ret = -1;
         }
@@ -430,6 +436,10 @@ CyBool_t NuandHandleVendorRequest(
         CyU3PUsbSendRetCode(ret);
     break;
 
+    case BLADE_USB_CMD_GET_FPGA_LOAD_TIME:
+        CyU3PUsbSendRetCode(NuandFpgaGetLoadTime());
+    break;
+
     case BLADE_USB_CMD_QUERY_DEVICE_READY:
         ret = glDeviceReady ? 1 : 0;
         CyU3PUsbSendRetCode(ret);
@@ -447,6 +457,43 @@ CyBool_t NuandHandleVendorRequest(
     }
     break;
 
+    case BLADE_USB_CMD_SET_DMA_CONFIG:
+        apiRetStatus = NuandRFLinkSetDmaConfig(wValue, wIndex);
+        CyU3PUsbSendRetCode(apiRetStatus);
+    break;
+
+    case BLADE_USB_CMD_SET_BURST_LEN:
+        apiRetStatus = NuandRFLinkSetBurstLen(wValue);
+        CyU3PUsbSendRetCode(apiRetStatus);
+    break;
+
+    case BLADE_USB_CMD_GET_DMA_CONFIG:
+    {
+        struct bladerf_fx3_dma_config cfg;
+
+        NuandRFLinkGetDmaConfig(&cfg);
+
+        apiRetStatus = CyU3PUsbSendEP0Data(sizeof(cfg), (uint8_t *) &cfg);
+        if (apiRetStatus != CY_U3P_SUCCESS) {
+            CyU3PDebugPrint(4, "Failed to send data, error code = %d\n", apiRetStatus);
+        }
+    }
+    break;
+
+    case BLADE_USB_CMD_GET_PERF_COUNTERS:
+    {
+        struct bladerf_fx3_perf_counters counters;
+
+        NuandRFLinkGetPerfCounters(&counters, wValue != 0);
+
+        apiRetStatus = CyU3PUsbSendEP0Data(sizeof(counters),
+                                           (uint8_t *) &counters);
+        if (apiRetStatus != CY_U3P_SUCCESS) {
+            CyU3PDebugPrint(4, "Failed to send data, error code = %d\n", apiRetStatus);
+        }
+    }
+    break;
+
     case BLADE_USB_CMD_READ_PAGE_BUFFER:
         if(wIndex + wLength > sizeof(glPageBuffer)) {
             apiRetStatus = CyU3PUsbStall(0x80, CyTrue, CyFalse);
@@ -506,9 +553,16 @@ CyBool_t NuandHandleVendorRequest(
             apiRetStatus = CyU3PUsbStall(0x80, CyTrue, CyFalse);
         }
 
-        apiRetStatus = CyFxSpiTransfer (
-                wIndex, 0x100,
-                glPageBuffer, CyTrue);
+        /* wValue specifies the number of pages, with 0 denoting 1 page for
+         * compatibility with older libbladeRF versions */
+        numPages = wValue ? wValue : 1;
+        if (numPages > BLADE_FLASH_MAX_PAGES_PER_REQ) {
+            apiRetStatus = CY_U3P_ERROR_BAD_ARGUMENT;
+        } else {
+            apiRetStatus = CyFxSpiTransfer (
+                    wIndex, numPages * FLASH_PAGE_SIZE,
+                    glPageBuffer, CyTrue);
+        }
         CyU3PUsbSendRetCode(apiRetStatus);
     break;
 
@@ -517,12 +571,44 @@ CyBool_t NuandHandleVendorRequest(
             apiRetStatus = CyU3PUsbStall(0x80, CyTrue, CyFalse);
         }
 
-        apiRetStatus = CyFxSpiTransfer (
-                wIndex, 0x100,
-                glPageBuffer, CyFalse);
+        numPages = wValue ? wValue : 1;
+        if (numPages > BLADE_FLASH_MAX_PAGES_PER_REQ) {
+            apiRetStatus = CY_U3P_ERROR_BAD_ARGUMENT;
+        } else {
+            apiRetStatus = CyFxSpiTransfer (
+                    wIndex, numPages * FLASH_PAGE_SIZE,
+                    glPageBuffer, CyFalse);
+        }
         CyU3PUsbSendRetCode(apiRetStatus);
     break;
 
+    case BLADE_USB_CMD_FLASH_CRC32:
+    {
+        struct bladerf_fx3_crc32 crc;
+        uint32_t value = 0;
+
+        if (glUsbAltInterface != USB_IF_SPI_FLASH) {
+            apiRetStatus = CyU3PUsbStall(0x80, CyTrue, CyFalse);
+        }
+
+        if (wValue == 0 || wValue > BLADE_FLASH_CRC32_MAX_PAGES) {
+            apiRetStatus = CY_U3P_ERROR_BAD_ARGUMENT;
+        } else {
+            apiRetStatus = NuandFlashCrc32(wIndex, wValue, glPageBuffer,
+                                           BLADE_FLASH_MAX_PAGES_PER_REQ,
+                                           &value);
+        }
+
+        crc.status = apiRetStatus;
+        crc.crc = value;
+
+        apiRetStatus = CyU3PUsbSendEP0Data(sizeof(crc), (uint8_t *) &crc);
+        if (apiRetStatus != CY_U3P_SUCCESS) {
+            CyU3PDebugPrint(4, "Failed to send data, error code = %d\n", apiRetStatus);
+        }
+    }
+    break;
+
     case BLADE_USB_CMD_FLASH_ERASE:
         if (glUsbAltInterface != USB_IF_SPI_FLASH) {
            apiRetStatus = CyU3PUsbStall(0x80, CyTrue, CyFalse);
@@ -954,10 +1040,18 @@ void bladeRFAppThread_Entry( uint32_t input)
 
     if (glAutoLoadValid) {
         char fpga_len[11] = {0};
+        char fpga_cmp[2] = {0};
         if (!NuandExtractField((void*)glAutoLoad, 0x100, "LEN", (char *)&fpga_len, 10)) {
+            CyBool_t compressed = CyFalse;
             fpga_len[10] = 0;
-            FpgaBeginProgram();
-            NuandLoadFromFlash(atoi(fpga_len));
+
+            /* Bitstreams written by older hosts lack this field */
+            if (!NuandExtractField((void*)glAutoLoad, 0x100, "CMP", fpga_cmp, 1)) {
+                compressed = (fpga_cmp[0] == '1') ? CyTrue : CyFalse;
+            }
+
+            FpgaBeginProgram(compressed);
+            NuandLoadFromFlash(atoi(fpga_len), compressed);
         }
     }
 
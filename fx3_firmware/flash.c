@@ -157,6 +157,52 @@ static word crc16mp(word crcval, void *data_p, word count) {
     return(crcval);
 }
 
+/* CRC-32 (reflected, polynomial 0x04c11db7), computed a nibble at a time to
+ * keep the table small */
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len)
+{
+    static const uint32_t table[16] = {
+        0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+        0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+        0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+        0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+    };
+
+    crc = ~crc;
+
+    while (len-- > 0) {
+        crc ^= *data++;
+        crc = (crc >> 4) ^ table[crc & 0xf];
+        crc = (crc >> 4) ^ table[crc & 0xf];
+    }
+
+    return ~crc;
+}
+
+CyU3PReturnStatus_t NuandFlashCrc32(uint16_t page, uint16_t count,
+                                    uint8_t *buf, uint16_t buf_pages,
+                                    uint32_t *crc)
+{
+    CyU3PReturnStatus_t status = CY_U3P_SUCCESS;
+    uint16_t n;
+
+    *crc = 0;
+
+    while (count != 0 && status == CY_U3P_SUCCESS) {
+        n = count < buf_pages ? count : buf_pages;
+
+        status = CyFxSpiTransfer(page, n * FLASH_PAGE_SIZE, buf, CyTrue);
+        if (status == CY_U3P_SUCCESS) {
+            *crc = crc32_update(*crc, buf, n * FLASH_PAGE_SIZE);
+        }
+
+        page += n;
+        count -= n;
+    }
+
+    return status;
+}
+
 int NuandExtractField(char *ptr, int len, char *field,
                             char *val, size_t  maxlen) {
     int c, wlen;
@@ -29,6 +29,12 @@ CyU3PReturnStatus_t NuandReadOtp(size_t offset, size_t size, void *buf);
 CyU3PReturnStatus_t NuandWriteOtp(size_t offset, size_t size, void *buf);
 CyU3PReturnStatus_t NuandLockOtp();
 
+/* Compute the CRC-32 of `count` flash pages, starting at `page`, using the
+ * provided buffer of `buf_pages` pages to read the flash contents */
+CyU3PReturnStatus_t NuandFlashCrc32(uint16_t page, uint16_t count,
+                                    uint8_t *buf, uint16_t buf_pages,
+                                    uint32_t *crc);
+
 void NuandFlashInit();
 void NuandFlashDeinit();
 
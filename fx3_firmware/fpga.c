@@ -34,12 +34,97 @@ static uint32_t glDMARxCount = 0;                  /* Counter to track the numbe
                                              * from USB during FPGA programming */
 static uint16_t glFlipLut[256];
 
-int FpgaBeginProgram(void)
+/* Number of USB packets of bitstream received into each DMA buffer. Each
+ * buffer is sized to hold these once expanded to 16-bit GPIF words. */
+#ifndef FPGA_LOAD_PKTS_PER_BUF
+#   define FPGA_LOAD_PKTS_PER_BUF 8
+#endif
+
+#ifndef FPGA_LOAD_DMA_BUF_COUNT
+#   define FPGA_LOAD_DMA_BUF_COUNT 4
+#endif
+
+/* In FPP mode, the FPGA's on-chip decompression requires each byte of a
+ * compressed bitstream to be held for this many DCLK cycles. One GPIF word
+ * is written per DCLK cycle. */
+#define FPGA_COMPRESSED_WORDS_PER_BYTE 4
+
+#if (FPGA_LOAD_PKTS_PER_BUF % FPGA_COMPRESSED_WORDS_PER_BYTE) != 0
+#   error "FPGA_LOAD_PKTS_PER_BUF must be a multiple of the compressed bitstream expansion"
+#endif
+
+/* Number of flash pages read per DMA transfer when autoloading the FPGA.
+ * Two buffers of these, once expanded to GPIF words, are used. */
+#ifndef FPGA_FLASH_PAGES_PER_XFER
+#   define FPGA_FLASH_PAGES_PER_XFER 16
+#endif
+
+#define FPGA_FLASH_XFER_LEN (FPGA_FLASH_PAGES_PER_XFER * FLASH_PAGE_SIZE)
+
+#if ((FPGA_FLASH_XFER_LEN + 16) * 2 * FPGA_COMPRESSED_WORDS_PER_BYTE) > 0xffff
+#   error "FPGA_FLASH_PAGES_PER_XFER is too large for a DMA buffer"
+#endif
+
+/* SPI clock used when autoloading the FPGA, which is the maximum that the
+ * FX3's SPI block supports. Reads use the flash's Fast Read command, which
+ * is specified well beyond this. */
+#ifndef FPGA_FLASH_SPI_CLOCK
+#   define FPGA_FLASH_SPI_CLOCK 33000000
+#endif
+
+/* Configuration timing, in ms ticks. glFpgaLoadLast is the time at which the
+ * last portion of the bitstream was passed to the FPGA. */
+static uint32_t glFpgaLoadStart;
+static uint32_t glFpgaLoadLast;
+static CyBool_t glFpgaLoading = CyFalse;
+static int32_t glFpgaLoadTime = BLADE_FPGA_LOAD_TIME_UNKNOWN;
+
+/* GPIF words written per bitstream byte, and the USB max packet size the
+ * configuration DMA channel was created for */
+static uint32_t glFpgaLoadWordsPerByte = 1;
+static uint16_t glFpgaLoadPktSize = 0;
+
+void NuandFpgaLoadDone(void)
+{
+    if (glFpgaLoading) {
+        glFpgaLoadTime = (int32_t) (glFpgaLoadLast - glFpgaLoadStart);
+        glFpgaLoading = CyFalse;
+    }
+}
+
+int32_t NuandFpgaGetLoadTime(void)
+{
+    return glFpgaLoadTime;
+}
+
+static CyU3PReturnStatus_t NuandFpgaConfigCreateChannel(void);
+
+int FpgaBeginProgram(CyBool_t compressed)
 {
     CyBool_t value;
+    const uint32_t words_per_byte =
+        compressed ? FPGA_COMPRESSED_WORDS_PER_BYTE : 1;
 
     unsigned tEnd;
     CyU3PReturnStatus_t apiRetStatus = CY_U3P_SUCCESS;
+    glFpgaLoadStart = glFpgaLoadLast = CyU3PGetTime();
+    glFpgaLoadTime = BLADE_FPGA_LOAD_TIME_UNKNOWN;
+    glFpgaLoading = CyTrue;
+
+    /* The configuration channel's buffers are divided according to the
+     * bitstream's expansion, so it must be recreated if that changes */
+    if (words_per_byte != glFpgaLoadWordsPerByte) {
+        glFpgaLoadWordsPerByte = words_per_byte;
+
+        if (glAppMode == MODE_FPGA_CONFIG) {
+            CyU3PDmaChannelDestroy(&glChHandlebladeRFUtoP);
+            apiRetStatus = NuandFpgaConfigCreateChannel();
+            if (apiRetStatus != CY_U3P_SUCCESS) {
+                return -1;
+            }
+        }
+    }
+
     apiRetStatus = CyU3PGpioSetValue(GPIO_nCONFIG, CyFalse);
     tEnd = CyU3PGetTime() + 10;
     while (CyU3PGetTime() < tEnd);
@@ -82,32 +167,91 @@ static void bladeRFConfigUtoPDmaCallback(CyU3PDmaChannel *chHandle, CyU3PDmaCbTy
     CyU3PReturnStatus_t status = CY_U3P_SUCCESS;
 
     if (type == CY_U3P_DMA_CB_PROD_EVENT) {
-        int i;
+        int i, j;
 
+        /* The host terminates bitstreams that end on a packet boundary with a
+         * ZLP, such that the final buffer is committed */
+        if (input->buffer_p.count == 0) {
+            CyU3PDmaChannelDiscardBuffer(chHandle);
+            return;
+        }
+
+        const uint32_t words = input->buffer_p.count * glFpgaLoadWordsPerByte;
         uint8_t *end_in_b = &( ((uint8_t *)input->buffer_p.buffer)[input->buffer_p.count - 1]);
-        uint16_t *end_in_w = &( ((uint16_t *)input->buffer_p.buffer)[input->buffer_p.count - 1]);
+        uint16_t *end_in_w = &( ((uint16_t *)input->buffer_p.buffer)[words - 1]);
 
 
         /* Flip the bits in such a way that the FPGA can be programmed
          * This mapping can be determined by looking at the schematic */
         for (i = input->buffer_p.count - 1; i >= 0; i--) {
-            *end_in_w-- = glFlipLut[*end_in_b--];
+            const uint16_t w = glFlipLut[*end_in_b--];
+            for (j = 0; j < (int) glFpgaLoadWordsPerByte; j++) {
+                *end_in_w-- = w;
+            }
         }
-        status = CyU3PDmaChannelCommitBuffer (chHandle, input->buffer_p.count * 2, 0);
+        status = CyU3PDmaChannelCommitBuffer (chHandle, words * 2, 0);
         if (status != CY_U3P_SUCCESS) {
             CyU3PDebugPrint (4, "CyU3PDmaChannelCommitBuffer failed, Error code = %d\n", status);
         }
 
         /* Increment the counter. */
         glDMARxCount++;
+        glFpgaLoadLast = CyU3PGetTime();
     }
 }
 
+/* Create the configuration DMA channel for the current USB max packet size
+ * and bitstream expansion */
+static CyU3PReturnStatus_t NuandFpgaConfigCreateChannel(void)
+{
+    CyU3PDmaChannelConfig_t dmaCfg;
+    CyU3PReturnStatus_t apiRetStatus = CY_U3P_SUCCESS;
+    const uint32_t buf_size = glFpgaLoadPktSize * FPGA_LOAD_PKTS_PER_BUF * 2;
+
+    /* The bitstream occupies the start of each buffer, and is expanded to
+     * fill the remainder (the producer's footer) in the DMA callback. Each
+     * byte of a compressed bitstream becomes several words, so fewer packets
+     * are received into each buffer. */
+    CyU3PMemSet((uint8_t *)&dmaCfg, 0, sizeof (dmaCfg));
+    dmaCfg.size  = buf_size;
+    dmaCfg.count = FPGA_LOAD_DMA_BUF_COUNT;
+    dmaCfg.prodSckId = BLADE_FPGA_CONFIG_SOCKET;
+    dmaCfg.consSckId = CY_U3P_PIB_SOCKET_3;
+    dmaCfg.dmaMode = CY_U3P_DMA_MODE_BYTE;
+
+    /* Enable the callback for produce event, this is where the bits will get flipped */
+    dmaCfg.notification = CY_U3P_DMA_CB_PROD_EVENT;
+
+    dmaCfg.cb = bladeRFConfigUtoPDmaCallback;
+    dmaCfg.prodHeader = 0;
+    dmaCfg.prodFooter = buf_size - (buf_size / (2 * glFpgaLoadWordsPerByte));
+    dmaCfg.consHeader = 0;
+    dmaCfg.prodAvailCount = 0;
+
+    apiRetStatus = CyU3PDmaChannelCreate(&glChHandlebladeRFUtoP,
+            CY_U3P_DMA_TYPE_MANUAL, &dmaCfg);
+
+    if (apiRetStatus != CY_U3P_SUCCESS) {
+        CyU3PDebugPrint(4, "CyU3PDmaChannelCreate failed, Error code = %d\n", apiRetStatus);
+        return apiRetStatus;
+    }
+
+    /* Flush the endpoint memory */
+    CyU3PUsbFlushEp(BLADE_FPGA_EP_PRODUCER);
+
+    /* Set DMA channel transfer size. */
+    apiRetStatus = CyU3PDmaChannelSetXfer(&glChHandlebladeRFUtoP, BLADE_DMA_TX_SIZE);
+    if (apiRetStatus != CY_U3P_SUCCESS) {
+        CyU3PDebugPrint(4, "CyU3PDmaChannelSetXfer Failed, Error code = %d\n", apiRetStatus);
+    }
+
+    return apiRetStatus;
+}
+
 static void NuandFpgaConfigStart(void)
 {
     uint16_t size = 0;
     CyU3PEpConfig_t epCfg;
-    CyU3PDmaChannelConfig_t dmaCfg;
     CyU3PReturnStatus_t apiRetStatus = CY_U3P_SUCCESS;
     CyU3PUSBSpeed_t usbSpeed = CyU3PUsbGetSpeed();
     static int first_call = 1;
@@ -158,36 +302,10 @@ static void NuandFpgaConfigStart(void)
         CyFxAppErrorHandler (apiRetStatus);
     }
 
-    dmaCfg.size  = size * 4;
-    dmaCfg.count = BLADE_DMA_BUF_COUNT;
-    dmaCfg.prodSckId = BLADE_FPGA_CONFIG_SOCKET;
-    dmaCfg.consSckId = CY_U3P_PIB_SOCKET_3;
-    dmaCfg.dmaMode = CY_U3P_DMA_MODE_BYTE;
-
-    /* Enable the callback for produce event, this is where the bits will get flipped */
-    dmaCfg.notification = CY_U3P_DMA_CB_PROD_EVENT;
-
-    dmaCfg.cb = bladeRFConfigUtoPDmaCallback;
-    dmaCfg.prodHeader = 0;
-    dmaCfg.prodFooter = size * 3;
-    dmaCfg.consHeader = 0;
-    dmaCfg.prodAvailCount = 0;
-
-    apiRetStatus = CyU3PDmaChannelCreate(&glChHandlebladeRFUtoP,
-            CY_U3P_DMA_TYPE_MANUAL, &dmaCfg);
-
-    if (apiRetStatus != CY_U3P_SUCCESS) {
-        CyU3PDebugPrint(4, "CyU3PDmaChannelCreate failed, Error code = %d\n", apiRetStatus);
-        CyFxAppErrorHandler(apiRetStatus);
-    }
-
-    /* Flush the endpoint memory */
-    CyU3PUsbFlushEp(BLADE_FPGA_EP_PRODUCER);
+    glFpgaLoadPktSize = size;
 
-    /* Set DMA channel transfer size. */
-    apiRetStatus = CyU3PDmaChannelSetXfer(&glChHandlebladeRFUtoP, BLADE_DMA_TX_SIZE);
+    apiRetStatus = NuandFpgaConfigCreateChannel();
     if (apiRetStatus != CY_U3P_SUCCESS) {
-        CyU3PDebugPrint(4, "CyU3PDmaChannelSetXfer Failed, Error code = %d\n", apiRetStatus);
         CyFxAppErrorHandler(apiRetStatus);
     }
 
@@ -286,87 +404,129 @@ CyBool_t NuandFpgaConfigHalted(uint16_t endpoint, uint8_t * data)
     return isHandled;
 }
 
-CyBool_t NuandLoadFromFlash(int fpga_len)
+/* Read a portion of an autoloaded bitstream from flash, starting at the
+ * specified page, and expand it in place into GPIF words */
+static CyU3PReturnStatus_t NuandFpgaReadFlashXfer(uint32_t page, uint8_t *buf,
+                                                 uint32_t words_per_byte)
+{
+    int32_t i, j;
+    CyU3PReturnStatus_t status;
+
+    status = CyFxSpiBulkRead(page * FLASH_PAGE_SIZE, FPGA_FLASH_XFER_LEN, buf);
+    if (status != CY_U3P_SUCCESS) {
+        return status;
+    }
+
+    uint8_t *end_in_b = &( ((uint8_t *)buf)[FPGA_FLASH_XFER_LEN - 1]);
+    uint16_t *end_in_w = &( ((uint16_t *)buf)[FPGA_FLASH_XFER_LEN * words_per_byte - 1]);
+
+    /* Flip the bits in such a way that the FPGA can be programmed
+     * This mapping can be determined by looking at the schematic */
+    for (i = FPGA_FLASH_XFER_LEN - 1; i >= 0; i--) {
+        const uint16_t w = glFlipLut[*end_in_b--];
+        for (j = 0; j < (int32_t) words_per_byte; j++)
+            *end_in_w-- = w;
+    }
+
+    return CY_U3P_SUCCESS;
+}
+
+CyBool_t NuandLoadFromFlash(int fpga_len, CyBool_t compressed)
 {
-    uint8_t *ptr;
+    uint8_t *ptr[2];
+    unsigned int cur = 0;
     int nleft;
     CyBool_t retval = CyFalse;
+    CyBool_t last;
     CyU3PDmaBuffer_t dbuf;
     uint32_t sector_idx = 1025;
-    uint32_t prodCnt, consCnt;
-    int32_t i;
-    CyU3PDmaState_t state;
+    const uint32_t words_per_byte =
+        compressed ? FPGA_COMPRESSED_WORDS_PER_BYTE : 1;
+    const uint16_t buf_size = (FPGA_FLASH_XFER_LEN + 16) * 2 * words_per_byte;
 
     CyU3PReturnStatus_t apiRetStatus = CY_U3P_SUCCESS;
     NuandFpgaConfigStart();
-    ptr = CyU3PDmaBufferAlloc(4096);
-    apiRetStatus = CyFxSpiInit(0x100);
+    ptr[0] = CyU3PDmaBufferAlloc(buf_size);
+    ptr[1] = CyU3PDmaBufferAlloc(buf_size);
+    if (ptr[0] == NULL || ptr[1] == NULL) {
+        apiRetStatus = CY_U3P_ERROR_MEMORY_ERROR;
+    }
+
+    if (apiRetStatus == CY_U3P_SUCCESS) {
+        apiRetStatus = CyFxSpiInit();
+    }
 
     CyFxSpiFastRead(CyTrue);
-    apiRetStatus = CyU3PSpiSetClock(30000000);
+    if (apiRetStatus == CY_U3P_SUCCESS) {
+        apiRetStatus = CyFxSpiBulkReadStart(FPGA_FLASH_SPI_CLOCK);
+    }
 
-    FpgaBeginProgram();
+    FpgaBeginProgram(compressed);
     nleft = fpga_len;
 
-    while(nleft) {
-        apiRetStatus = CyU3PDmaChannelGetStatus(&glChHandlebladeRFUtoP, &state, &prodCnt, &consCnt);
-        if (apiRetStatus)
-            break;
+    /* The first portion of the bitstream is read up front. Each subsequent
+     * portion is read into the other buffer while the GPIF is still
+     * clocking the previous one into the FPGA. */
+    if (apiRetStatus == CY_U3P_SUCCESS) {
+        apiRetStatus = NuandFpgaReadFlashXfer(sector_idx, ptr[cur],
+                                              words_per_byte);
+    }
 
-        CyU3PDmaChannelAbort(&glChHandlebladeRFUtoP);
-
-        apiRetStatus = CyU3PDmaChannelGetStatus(&glChHandlebladeRFUtoP, &state, &prodCnt, &consCnt);
-        if (apiRetStatus)
-            break;
+    while (apiRetStatus == CY_U3P_SUCCESS && nleft > 0) {
+        last = (nleft <= FPGA_FLASH_XFER_LEN) ? CyTrue : CyFalse;
 
         CyU3PDmaChannelReset(&glChHandlebladeRFUtoP);
 
-        apiRetStatus = CyU3PDmaChannelGetStatus(&glChHandlebladeRFUtoP, &state, &prodCnt, &consCnt);
-        if (apiRetStatus)
-            break;
-
-        if (CyFxSpiTransfer(sector_idx++, 0x100, ptr, CyTrue) != CY_U3P_SUCCESS)
-            break;
-
-        uint8_t *end_in_b = &( ((uint8_t *)ptr)[255]);
-        uint16_t *end_in_w = &( ((uint16_t *)ptr)[255]);
-
-        /* Flip the bits in such a way that the FPGA can be programmed
-         * This mapping can be determined by looking at the schematic */
-        for (i = 255; i >= 0; i--)
-            *end_in_w-- = glFlipLut[*end_in_b--];
-
-        dbuf.buffer = ptr;
-        dbuf.count = ((nleft > 256) ? 256 : (nleft + 2)) * 2;
-        dbuf.size = 4096;
+        dbuf.buffer = ptr[cur];
+        dbuf.count = (last ? (nleft + 2) : FPGA_FLASH_XFER_LEN) * 2 * words_per_byte;
+        dbuf.size = buf_size;
         dbuf.status = 0;
 
         apiRetStatus = CyU3PDmaChannelSetupSendBuffer(&glChHandlebladeRFUtoP, &dbuf);
         if (apiRetStatus)
             break;
 
-        apiRetStatus = CyU3PDmaChannelGetStatus(&glChHandlebladeRFUtoP, &state, &prodCnt, &consCnt);
-        if (apiRetStatus)
-            break;
+        if (!last) {
+            sector_idx += FPGA_FLASH_PAGES_PER_XFER;
+            apiRetStatus = NuandFpgaReadFlashXfer(sector_idx, ptr[cur ^ 1],
+                                                  words_per_byte);
+        }
 
-        apiRetStatus = CyU3PDmaChannelWaitForCompletion(&glChHandlebladeRFUtoP, 100);
-        if (apiRetStatus)
+        /* Wait regardless, so the GPIF is idle upon a failed read */
+        if (CyU3PDmaChannelWaitForCompletion(&glChHandlebladeRFUtoP, 100)
+                != CY_U3P_SUCCESS) {
             break;
+        }
 
-        apiRetStatus = CyU3PDmaChannelGetStatus(&glChHandlebladeRFUtoP, &state, &prodCnt, &consCnt);
-        if (apiRetStatus)
-            break;
+        glFpgaLoadLast = CyU3PGetTime();
 
-        if (nleft > 256) {
-            nleft -= 256;
-        } else {
+        if (last) {
             retval = CyTrue;
             nleft = 0;
-            break;
+        } else {
+            nleft -= FPGA_FLASH_XFER_LEN;
+            cur ^= 1;
+        }
+    }
+
+    if (retval) {
+        CyBool_t conf_done = CyFalse;
+        CyU3PGpioGetValue(GPIO_CONFDONE, &conf_done);
+        if (conf_done) {
+            NuandFpgaLoadDone();
         }
     }
 
-    CyU3PDmaBufferFree(ptr);
+    CyFxSpiBulkReadStop();
+
+    if (ptr[0] != NULL) {
+        CyU3PDmaBufferFree(ptr[0]);
+    }
+
+    if (ptr[1] != NULL) {
+        CyU3PDmaBufferFree(ptr[1]);
+    }
+
     CyU3PSpiDeInit();
 
     CyFxSpiFastRead(CyFalse);
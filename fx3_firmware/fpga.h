@@ -26,7 +26,17 @@
 
 void NuandFpgaConfigSwInit(void);
 extern const struct NuandApplication NuandFpgaConfig;
-int FpgaBeginProgram(void);
-CyBool_t NuandLoadFromFlash(int fpga_len);
+
+/* Begin configuring the FPGA. A compressed bitstream is one that the FPGA
+ * decompresses on-chip, and is expanded accordingly while it is loaded. */
+int FpgaBeginProgram(CyBool_t compressed);
+CyBool_t NuandLoadFromFlash(int fpga_len, CyBool_t compressed);
+
+/* Record that the FPGA has been configured, once CONF_DONE is observed */
+void NuandFpgaLoadDone(void);
+
+/* Get the duration of the last FPGA configuration, in ms, or
+ * BLADE_FPGA_LOAD_TIME_UNKNOWN */
+int32_t NuandFpgaGetLoadTime(void);
 
 #endif /* _FPGA_H_ */
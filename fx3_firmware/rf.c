@@ -21,6 +21,7 @@
  */
 #include <cyu3error.h>
 #include <cyu3gpio.h>
+#include <cyu3pib.h>
 #include <cyu3usb.h>
 #include <cyu3uart.h>
 #include "gpif.h"
@@ -43,6 +44,331 @@ int NuandRFLinkGetLoopBack() {
     return loopback;
 }
 
+/* Default number of buffers backing each sample DMA channel at Full and High
+ * Speed. Each defaults to two max-size packets. */
+#ifndef RF_DMA_DEFAULT_COUNT
+#   define RF_DMA_DEFAULT_COUNT 22
+#endif
+
+/* Default SuperSpeed burst length of the sample endpoints */
+#ifndef RF_DEFAULT_BURST_LEN
+#   define RF_DEFAULT_BURST_LEN 16
+#endif
+
+/* At SuperSpeed, each DMA buffer defaults to holding one full burst, with
+ * enough buffers to fill this much memory per channel */
+#ifndef RF_DMA_SS_DEFAULT_MEM
+#   define RF_DMA_SS_DEFAULT_MEM (64 * 1024)
+#endif
+
+/* Requested sample DMA buffering and SuperSpeed burst length. 0 selects the
+ * default for a field. */
+static uint16_t dma_count = 0;
+static uint16_t dma_size = 0;
+static uint16_t burst_len = 0;
+
+/* Sample path performance counters. The DMA channels' transfer counts are
+ * cleared whenever a channel is reset, so they are accumulated into
+ * dma_totals, relative to the counts in dma_offsets. */
+enum {
+    PERF_RX_PROD = 0,
+    PERF_RX_CONS,
+    PERF_TX_PROD,
+    PERF_TX_CONS,
+    PERF_DMA_COUNTS
+};
+
+static struct bladerf_fx3_perf_counters perf;
+static uint64_t dma_totals[PERF_DMA_COUNTS];
+static uint32_t dma_offsets[PERF_DMA_COUNTS];
+static CyBool_t link_active = CyFalse;
+
+static void NuandRFLinkDmaCounts(CyU3PDmaChannel *ch, unsigned int idx,
+                                 uint32_t *counts)
+{
+    CyU3PDmaState_t state;
+
+    if (!link_active || (idx == PERF_RX_PROD && loopback_when_created) ||
+        CyU3PDmaChannelGetStatus(ch, &state,
+                                 &counts[idx], &counts[idx + 1])
+            != CY_U3P_SUCCESS) {
+
+        counts[idx] = dma_offsets[idx];
+        counts[idx + 1] = dma_offsets[idx + 1];
+    }
+}
+
+static void NuandRFLinkGetDmaCounts(uint32_t *counts)
+{
+    NuandRFLinkDmaCounts(&glChHandlePtoU, PERF_RX_PROD, counts);
+    NuandRFLinkDmaCounts(&glChHandleUtoP, PERF_TX_PROD, counts);
+}
+
+/* Fold a channel's current transfer counts into the totals, prior to the
+ * channel being reset or destroyed */
+static void NuandRFLinkAccumulateDma(CyU3PDmaChannel *ch, unsigned int idx)
+{
+    uint32_t counts[PERF_DMA_COUNTS];
+    unsigned int i;
+
+    NuandRFLinkDmaCounts(ch, idx, counts);
+
+    for (i = idx; i < idx + 2; i++) {
+        dma_totals[i] += counts[i] - dma_offsets[i];
+        dma_offsets[i] = 0;
+    }
+}
+
+void NuandRFLinkGetPerfCounters(struct bladerf_fx3_perf_counters *counters,
+                                CyBool_t reset)
+{
+    uint32_t counts[PERF_DMA_COUNTS];
+    unsigned int i;
+
+    NuandRFLinkGetDmaCounts(counts);
+
+    *counters = perf;
+    counters->rx_prod_bytes = dma_totals[PERF_RX_PROD] +
+                              counts[PERF_RX_PROD] - dma_offsets[PERF_RX_PROD];
+    counters->rx_cons_bytes = dma_totals[PERF_RX_CONS] +
+                              counts[PERF_RX_CONS] - dma_offsets[PERF_RX_CONS];
+    counters->tx_prod_bytes = dma_totals[PERF_TX_PROD] +
+                              counts[PERF_TX_PROD] - dma_offsets[PERF_TX_PROD];
+    counters->tx_cons_bytes = dma_totals[PERF_TX_CONS] +
+                              counts[PERF_TX_CONS] - dma_offsets[PERF_TX_CONS];
+
+    if (reset) {
+        CyU3PMemSet((uint8_t *) &perf, 0, sizeof(perf));
+        for (i = 0; i < PERF_DMA_COUNTS; i++) {
+            dma_totals[i] = 0;
+            dma_offsets[i] = counts[i];
+        }
+    }
+}
+
+static void NuandRFLinkResetPerfCounters(void)
+{
+    CyU3PMemSet((uint8_t *) &perf, 0, sizeof(perf));
+    CyU3PMemSet((uint8_t *) dma_totals, 0, sizeof(dma_totals));
+    CyU3PMemSet((uint8_t *) dma_offsets, 0, sizeof(dma_offsets));
+}
+
+static void NuandRFLinkDmaCallback(CyU3PDmaChannel *ch,
+                                   CyU3PDmaCbType_t type,
+                                   CyU3PDmaCBInput_t *input)
+{
+    if (type == CY_U3P_DMA_CB_ERROR) {
+        if (ch == &glChHandlePtoU) {
+            perf.rx_dma_errors++;
+        } else {
+            perf.tx_dma_errors++;
+        }
+    }
+}
+
+/* The RX samples are written to PIB socket (thread) 0, and the TX samples
+ * read from socket 3 */
+static void NuandRFLinkPibCallback(CyU3PPibIntrType type, uint16_t arg)
+{
+    if (type != CYU3P_PIB_INTR_ERROR) {
+        return;
+    }
+
+    switch (CYU3P_GET_PIB_ERROR_TYPE(arg)) {
+        case CYU3P_PIB_ERR_NONE:
+            break;
+
+        case CYU3P_PIB_ERR_THR0_WR_OVERRUN:
+            perf.rx_overruns++;
+            break;
+
+        case CYU3P_PIB_ERR_THR3_RD_UNDERRUN:
+            perf.tx_underruns++;
+            break;
+
+        default:
+            perf.pib_errors++;
+            break;
+    }
+
+    if (CYU3P_GET_GPIF_ERROR_TYPE(arg) != CYU3P_GPIF_ERR_NONE) {
+        perf.gpif_errors++;
+    }
+}
+
+/* Note that IN endpoint NAKs are expected whenever the host is keeping up
+ * with the RX sample stream, and are not counted */
+static void NuandRFLinkEpCallback(CyU3PUsbEpEvtType type,
+                                  CyU3PUSBSpeed_t speed, uint8_t ep)
+{
+    const CyBool_t rx = (ep == BLADE_RF_SAMPLE_EP_CONSUMER);
+
+    switch (type) {
+        case CYU3P_USBEP_NAK_EVT:
+            if (!rx) {
+                perf.tx_ep_flow_control++;
+            }
+            break;
+
+        case CYU3P_USBEP_SS_RETRY_EVT:
+            if (rx) {
+                perf.rx_ep_retries++;
+            } else {
+                perf.tx_ep_retries++;
+            }
+            break;
+
+        case CYU3P_USBEP_SS_SEQERR_EVT:
+        case CYU3P_USBEP_SS_STREAMERR_EVT:
+            if (rx) {
+                perf.rx_ep_errors++;
+            } else {
+                perf.tx_ep_errors++;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static uint16_t NuandRFLinkPacketSize(CyU3PUSBSpeed_t usbSpeed)
+{
+    switch (usbSpeed) {
+        case CY_U3P_FULL_SPEED:
+            return 64;
+
+        case CY_U3P_HIGH_SPEED:
+            return 512;
+
+        case CY_U3P_SUPER_SPEED:
+            return 1024;
+
+        default:
+            return 0;
+    }
+}
+
+static CyBool_t NuandRFLinkDmaConfigValid(uint16_t packet_size,
+                                          uint16_t count, uint16_t size)
+{
+    if (count < BLADE_DMA_MIN_BUF_COUNT || count > BLADE_DMA_MAX_BUF_COUNT) {
+        return CyFalse;
+    }
+
+    if (size == 0 || size > BLADE_DMA_MAX_BUF_SIZE || (size % packet_size)) {
+        return CyFalse;
+    }
+
+    return ((uint32_t) count * size) <= BLADE_DMA_MAX_CHANNEL_MEM;
+}
+
+/* Bursts only apply at SuperSpeed */
+static uint16_t NuandRFLinkBurstLen(uint16_t packet_size)
+{
+    if (packet_size != 1024) {
+        return 1;
+    }
+
+    return burst_len ? burst_len : RF_DEFAULT_BURST_LEN;
+}
+
+/* The default buffer size matches the burst size at SuperSpeed, such that
+ * each burst fills exactly one buffer */
+static void NuandRFLinkDefaultDmaConfig(uint16_t packet_size,
+                                        uint16_t *count, uint16_t *size)
+{
+    if (packet_size == 1024) {
+        *size  = NuandRFLinkBurstLen(packet_size) * packet_size;
+        *count = RF_DMA_SS_DEFAULT_MEM / *size;
+        if (*count > BLADE_DMA_MAX_BUF_COUNT) {
+            *count = BLADE_DMA_MAX_BUF_COUNT;
+        }
+    } else {
+        *size  = packet_size * 2;
+        *count = RF_DMA_DEFAULT_COUNT;
+    }
+}
+
+/* Resolve the requested buffering against the defaults for the given max
+ * packet size. A request that is no longer valid (e.g., it was made at
+ * SuperSpeed and the device has since enumerated at High Speed) reverts to
+ * the defaults. */
+static void NuandRFLinkResolveDmaConfig(uint16_t packet_size,
+                                        uint16_t *count, uint16_t *size)
+{
+    uint16_t default_count, default_size;
+
+    NuandRFLinkDefaultDmaConfig(packet_size, &default_count, &default_size);
+
+    *count = dma_count ? dma_count : default_count;
+    *size  = dma_size  ? dma_size  : default_size;
+
+    if (!NuandRFLinkDmaConfigValid(packet_size, *count, *size)) {
+        CyU3PDebugPrint(4, "Invalid DMA config (%d x %d), using defaults\n",
+                        *count, *size);
+        *count = default_count;
+        *size  = default_size;
+    }
+}
+
+CyU3PReturnStatus_t NuandRFLinkSetDmaConfig(uint16_t count, uint16_t size)
+{
+    const uint16_t packet_size = NuandRFLinkPacketSize(CyU3PUsbGetSpeed());
+    uint16_t default_count, default_size;
+
+    if (packet_size == 0) {
+        return CY_U3P_ERROR_INVALID_SEQUENCE;
+    }
+
+    NuandRFLinkDefaultDmaConfig(packet_size, &default_count, &default_size);
+
+    if (!NuandRFLinkDmaConfigValid(packet_size,
+                                   count ? count : default_count,
+                                   size  ? size  : default_size)) {
+        return CY_U3P_ERROR_BAD_ARGUMENT;
+    }
+
+    dma_count = count;
+    dma_size = size;
+    return CY_U3P_SUCCESS;
+}
+
+CyU3PReturnStatus_t NuandRFLinkSetBurstLen(uint16_t len)
+{
+    if (len > BLADE_MAX_BURST_LEN) {
+        return CY_U3P_ERROR_BAD_ARGUMENT;
+    }
+
+    burst_len = len;
+    return CY_U3P_SUCCESS;
+}
+
+void NuandRFLinkGetDmaConfig(struct bladerf_fx3_dma_config *cfg)
+{
+    const uint16_t packet_size = NuandRFLinkPacketSize(CyU3PUsbGetSpeed());
+    uint16_t count = 0, size = 0;
+
+    if (packet_size != 0) {
+        NuandRFLinkResolveDmaConfig(packet_size, &count, &size);
+    }
+
+    cfg->count = count;
+    cfg->size = size;
+    cfg->burst_len = packet_size ? NuandRFLinkBurstLen(packet_size) : 0;
+    cfg->packet_size = packet_size;
+}
+
+/* Number of buffers for peripheral requests received from the host, and for
+ * the NIOS II's ACKs */
+#ifndef UART_DMA_REQ_COUNT
+#   define UART_DMA_REQ_COUNT 4
+#endif
+
+#ifndef UART_DMA_ACK_COUNT
+#   define UART_DMA_ACK_COUNT 10
+#endif
+
 static void UartBridgeStart(void)
 {
     uint16_t size = 0;
@@ -130,9 +456,13 @@ static void UartBridgeStart(void)
         CyFxAppErrorHandler (apiRetStatus);
     }
 
+    /* The host may send several peripheral requests in a single transfer, so
+     * each USB-to-UART buffer holds a full packet. ACKs are kept in 16-byte
+     * buffers, such that each is passed to the host as soon as the NIOS II
+     * has sent it. */
     CyU3PMemSet((uint8_t *)&dmaCfg, 0, sizeof(dmaCfg));
-    dmaCfg.size  = 16;
-    dmaCfg.count = 10;
+    dmaCfg.size  = size;
+    dmaCfg.count = UART_DMA_REQ_COUNT;
     dmaCfg.prodSckId = CY_U3P_UIB_SOCKET_PROD_2;
     dmaCfg.consSckId = CY_U3P_LPP_SOCKET_UART_CONS;
     dmaCfg.dmaMode = CY_U3P_DMA_MODE_BYTE;
@@ -150,6 +480,8 @@ static void UartBridgeStart(void)
         CyFxAppErrorHandler(apiRetStatus);
     }
 
+    dmaCfg.size  = 16;
+    dmaCfg.count = UART_DMA_ACK_COUNT;
     dmaCfg.prodSckId = CY_U3P_LPP_SOCKET_UART_PROD;
     dmaCfg.consSckId = CY_U3P_UIB_SOCKET_CONS_2;
     apiRetStatus = CyU3PDmaChannelCreate(&glChHandlebladeRFUARTtoU,
@@ -226,6 +558,7 @@ static void UartBridgeStop(void)
 static void NuandRFLinkStart(void)
 {
     uint16_t size = 0;
+    uint16_t dma_buf_count, dma_buf_size;
     CyU3PEpConfig_t epCfg;
     CyU3PDmaChannelConfig_t dmaCfg;
     CyU3PDmaMultiChannelConfig_t dmaMultiConfig;
@@ -248,30 +581,18 @@ static void NuandRFLinkStart(void)
     }
 
     /* Determine max packet size based on USB speed */
-    switch (usbSpeed)
-    {
-        case CY_U3P_FULL_SPEED:
-            size = 64;
-            break;
-
-        case CY_U3P_HIGH_SPEED:
-            size = 512;
-            break;
-
-        case CY_U3P_SUPER_SPEED:
-            size = 1024;
-            break;
-
-        default:
-            CyU3PDebugPrint (4, "Error! Invalid USB speed.\n");
-            CyFxAppErrorHandler (CY_U3P_ERROR_FAILURE);
-            break;
+    size = NuandRFLinkPacketSize(usbSpeed);
+    if (size == 0) {
+        CyU3PDebugPrint (4, "Error! Invalid USB speed.\n");
+        CyFxAppErrorHandler (CY_U3P_ERROR_FAILURE);
     }
 
+    NuandRFLinkResolveDmaConfig(size, &dma_buf_count, &dma_buf_size);
+
     CyU3PMemSet ((uint8_t *)&epCfg, 0, sizeof (epCfg));
     epCfg.enable = CyTrue;
     epCfg.epType = CY_U3P_USB_EP_BULK;
-    epCfg.burstLen = (usbSpeed == CY_U3P_SUPER_SPEED ? 15 : 1);
+    epCfg.burstLen = NuandRFLinkBurstLen(size);
     epCfg.streams = 0;
     epCfg.pcktSize = size;
 
@@ -290,8 +611,8 @@ static void NuandRFLinkStart(void)
     }
 
     // multi variant
-    dmaMultiConfig.size = size * 2;
-    dmaMultiConfig.count = 22;
+    dmaMultiConfig.size = dma_buf_size;
+    dmaMultiConfig.count = dma_buf_count;
     dmaMultiConfig.validSckCount = 2;
     dmaMultiConfig.prodSckId[0] = BLADE_RF_SAMPLE_EP_PRODUCER_USB_SOCKET;
     dmaMultiConfig.consSckId[0] = CY_U3P_PIB_SOCKET_2;
@@ -306,13 +627,13 @@ static void NuandRFLinkStart(void)
 
     // non multi variant
     CyU3PMemSet((uint8_t *)&dmaCfg, 0, sizeof(dmaCfg));
-    dmaCfg.size  = size * 2;
-    dmaCfg.count = 22;
+    dmaCfg.size  = dma_buf_size;
+    dmaCfg.count = dma_buf_count;
     dmaCfg.prodSckId = BLADE_RF_SAMPLE_EP_PRODUCER_USB_SOCKET;
     dmaCfg.consSckId = CY_U3P_PIB_SOCKET_3;
     dmaCfg.dmaMode = CY_U3P_DMA_MODE_BYTE;
-    dmaCfg.notification = 0;
-    dmaCfg.cb = 0;
+    dmaCfg.notification = CY_U3P_DMA_CB_ERROR;
+    dmaCfg.cb = NuandRFLinkDmaCallback;
     dmaCfg.prodHeader = 0;
     dmaCfg.prodFooter = 0;
     dmaCfg.consHeader = 0;
@@ -362,6 +683,18 @@ static void NuandRFLinkStart(void)
         }
     }
 
+    NuandRFLinkResetPerfCounters();
+    link_active = CyTrue;
+
+    CyU3PPibRegisterCallback(NuandRFLinkPibCallback, CYU3P_PIB_INTR_ERROR);
+    CyU3PUsbRegisterEpEvtCallback(NuandRFLinkEpCallback,
+                                  CYU3P_USBEP_NAK_EVT |
+                                  CYU3P_USBEP_SS_RETRY_EVT |
+                                  CYU3P_USBEP_SS_SEQERR_EVT |
+                                  CYU3P_USBEP_SS_STREAMERR_EVT,
+                                  1 << (BLADE_RF_SAMPLE_EP_PRODUCER & 0xf),
+                                  1 << (BLADE_RF_SAMPLE_EP_CONSUMER & 0xf));
+
     UartBridgeStart();
     glAppMode = MODE_RF_CONFIG;
 
@@ -383,6 +716,16 @@ static void NuandRFLinkStop (void)
     CyU3PUsbFlushEp(BLADE_RF_SAMPLE_EP_PRODUCER);
     CyU3PUsbFlushEp(BLADE_RF_SAMPLE_EP_CONSUMER);
 
+    CyU3PUsbRegisterEpEvtCallback(NULL, 0, 0, 0);
+    CyU3PPibRegisterCallback(NULL, 0);
+
+    /* Retain the final transfer counts for readback */
+    if (!loopback_when_created) {
+        NuandRFLinkAccumulateDma(&glChHandlePtoU, PERF_RX_PROD);
+    }
+    NuandRFLinkAccumulateDma(&glChHandleUtoP, PERF_TX_PROD);
+    link_active = CyFalse;
+
     /* Destroy the channels */
     CyU3PDmaChannelDestroy(&glChHandleUtoP);
     if (!loopback_when_created)
@@ -432,11 +775,15 @@ CyU3PReturnStatus_t NuandRFLinkResetEndpoint(uint8_t endpoint)
 
     switch(endpoint) {
         case BLADE_RF_SAMPLE_EP_PRODUCER:
+            NuandRFLinkAccumulateDma(&glChHandleUtoP, PERF_TX_PROD);
             status = ClearDMAChannel(endpoint, &glChHandleUtoP,
                                      BLADE_DMA_TX_SIZE);
             break;
 
         case BLADE_RF_SAMPLE_EP_CONSUMER:
+            if (!loopback_when_created) {
+                NuandRFLinkAccumulateDma(&glChHandlePtoU, PERF_RX_PROD);
+            }
             status = ClearDMAChannel(endpoint, &glChHandlePtoU,
                                      BLADE_DMA_TX_SIZE);
             break;
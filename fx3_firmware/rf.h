@@ -32,4 +32,20 @@ void NuandRFLinkLoopBack(int);
 /* Check if FW sample loopback is enabled */
 int NuandRFLinkGetLoopBack();
 
+/* Select the number and size of the sample DMA channels' buffers, applied
+ * when the RF link is next started. 0 selects the default for a field. */
+CyU3PReturnStatus_t NuandRFLinkSetDmaConfig(uint16_t count, uint16_t size);
+
+/* Select the SuperSpeed burst length of the sample endpoints, applied when
+ * the RF link is next started. 0 selects the default. */
+CyU3PReturnStatus_t NuandRFLinkSetBurstLen(uint16_t len);
+
+/* Get the sample DMA buffering and endpoint configuration used at the
+ * current USB speed */
+void NuandRFLinkGetDmaConfig(struct bladerf_fx3_dma_config *cfg);
+
+/* Get the sample path performance counters, optionally resetting them */
+void NuandRFLinkGetPerfCounters(struct bladerf_fx3_perf_counters *counters,
+                                CyBool_t reset);
+
 #endif /* _RF_H_ */
@@ -111,6 +111,31 @@ CyU3PReturnStatus_t CyFxSpiWaitForStatus(void)
     return CY_U3P_SUCCESS;
 }
 
+/* Wait for an in-progress program or erase operation to complete */
+static CyU3PReturnStatus_t CyFxSpiWaitForIdle(void)
+{
+    uint8_t buf[1], rd_buf[1];
+    CyU3PReturnStatus_t status = CY_U3P_SUCCESS;
+
+    buf[0] = 0x05;  /* Read status command */
+
+    do {
+        CyU3PSpiSetSsnLine(CyFalse);
+        status = CyU3PSpiTransmitWords(buf, 1);
+        if (status == CY_U3P_SUCCESS) {
+            status = CyU3PSpiReceiveWords(rd_buf, 1);
+        }
+        CyU3PSpiSetSsnLine(CyTrue);
+
+        if (status != CY_U3P_SUCCESS) {
+            CyU3PDebugPrint(2, "SPI status read failed\n\r");
+            return status;
+        }
+    } while (rd_buf[0] & 1);
+
+    return CY_U3P_SUCCESS;
+}
+
 CyBool_t spiFastRead = CyFalse;
 void CyFxSpiFastRead(CyBool_t v) {
     spiFastRead = v;
@@ -142,7 +167,9 @@ CyU3PReturnStatus_t CyFxSpiTransfer(uint16_t pageAddress, uint16_t byteCount, ui
         if (isRead) {
             location[0] = 0x03; /* Read command. */
 
-            if (!spiFastRead) {
+            /* The status only needs to be checked before the first page, in
+             * case a program or erase operation is still in progress. */
+            if (!spiFastRead && byteAddress == pageAddress * FLASH_PAGE_SIZE) {
                 status = CyFxSpiWaitForStatus();
                 if (status != CY_U3P_SUCCESS)
                     return status;
@@ -191,12 +218,115 @@ CyU3PReturnStatus_t CyFxSpiTransfer(uint16_t pageAddress, uint16_t byteCount, ui
         byteAddress += FLASH_PAGE_SIZE;
         buffer += FLASH_PAGE_SIZE;
         pageCount--;
+    }
 
-        if (!spiFastRead)
-            CyU3PThreadSleep(15);
+    /* Rather than sleeping after each page, the status register is polled
+     * before programming the next one. Poll until the last page has been
+     * programmed, so that success is not reported prematurely, and so that
+     * a subsequent command (e.g., an erase, or exiting the OTP region) is
+     * not ignored by a busy flash. */
+    if (!isRead) {
+        status = CyFxSpiWaitForIdle();
     }
 
-    return CY_U3P_SUCCESS;
+    return status;
+}
+
+/* DMA channel used by bulk reads, from the SPI block into CPU memory */
+static CyU3PDmaChannel glSpiRxHandle;
+static CyBool_t glSpiRxHandleValid = CyFalse;
+
+CyU3PReturnStatus_t CyFxSpiBulkReadStart(uint32_t clock)
+{
+    CyU3PDmaChannelConfig_t dmaConfig;
+    CyU3PReturnStatus_t status;
+
+    status = CyU3PSpiSetClock(clock);
+    if (status != CY_U3P_SUCCESS) {
+        return status;
+    }
+
+    /* Buffers are supplied with each read */
+    CyU3PMemSet((uint8_t *)&dmaConfig, 0, sizeof(dmaConfig));
+    dmaConfig.size           = FLASH_PAGE_SIZE;
+    dmaConfig.count          = 0;
+    dmaConfig.prodSckId      = CY_U3P_LPP_SOCKET_SPI_PROD;
+    dmaConfig.consSckId      = CY_U3P_CPU_SOCKET_CONS;
+    dmaConfig.dmaMode        = CY_U3P_DMA_MODE_BYTE;
+    dmaConfig.notification   = 0;
+    dmaConfig.cb             = NULL;
+
+    status = CyU3PDmaChannelCreate(&glSpiRxHandle,
+                                   CY_U3P_DMA_TYPE_MANUAL_IN, &dmaConfig);
+    if (status == CY_U3P_SUCCESS) {
+        glSpiRxHandleValid = CyTrue;
+    }
+
+    return status;
+}
+
+void CyFxSpiBulkReadStop(void)
+{
+    if (glSpiRxHandleValid) {
+        CyU3PDmaChannelDestroy(&glSpiRxHandle);
+        glSpiRxHandleValid = CyFalse;
+    }
+}
+
+CyU3PReturnStatus_t CyFxSpiBulkRead(uint32_t byteAddress, uint16_t byteCount,
+                                    uint8_t *buffer)
+{
+    uint8_t cmd[5];
+    CyU3PDmaBuffer_t buf;
+    CyU3PReturnStatus_t status;
+
+    if (!glSpiRxHandleValid) {
+        return CY_U3P_ERROR_NOT_CONFIGURED;
+    }
+
+    if (byteCount == 0) {
+        return CY_U3P_SUCCESS;
+    }
+
+    /* A single Fast Read spans as many pages as required. Its dummy byte
+     * allows for the higher SPI clocks used by bulk reads. */
+    cmd[0] = 0x0b;  /* Fast read command */
+    cmd[1] = (byteAddress >> 16) & 0xFF;
+    cmd[2] = (byteAddress >> 8) & 0xFF;
+    cmd[3] = byteAddress & 0xFF;
+    cmd[4] = 0x00;
+
+    CyU3PSpiSetSsnLine(CyFalse);
+    status = CyU3PSpiTransmitWords(cmd, sizeof(cmd));
+    if (status != CY_U3P_SUCCESS) {
+        CyU3PDebugPrint(2, "SPI FAST_READ command failed\r\n");
+        CyU3PSpiSetSsnLine(CyTrue);
+        return status;
+    }
+
+    CyU3PSpiSetBlockXfer(0, byteCount);
+
+    buf.buffer = buffer;
+    buf.status = 0;
+    buf.size   = (byteCount + 15) & ~15;
+    buf.count  = 0;
+
+    status = CyU3PDmaChannelSetupRecvBuffer(&glSpiRxHandle, &buf);
+    if (status == CY_U3P_SUCCESS) {
+        status = CyU3PDmaChannelWaitForCompletion(&glSpiRxHandle,
+                                                  CY_FX_SPI_BULK_TIMEOUT);
+    }
+
+    CyU3PSpiSetSsnLine(CyTrue);
+    CyU3PSpiDisableBlockXfer(CyFalse, CyTrue);
+
+    if (status != CY_U3P_SUCCESS) {
+        CyU3PDebugPrint(2, "SPI bulk read failed, Error code = %d\r\n",
+                        status);
+        CyU3PDmaChannelReset(&glSpiRxHandle);
+    }
+
+    return status;
 }
 
 /* Function to erase SPI flash sectors. */
@@ -31,4 +31,17 @@ CyU3PReturnStatus_t CyFxSpiTransfer(
         uint16_t pageAddress, uint16_t byteCount,
         uint8_t *buffer, CyBool_t isRead);
 
+/* Timeout for a single bulk read, in ms */
+#define CY_FX_SPI_BULK_TIMEOUT 100
+
+/* Bulk reads transfer many pages per command via DMA, at the specified SPI
+ * clock. CyFxSpiBulkReadStart() must be called after CyFxSpiInit(), and
+ * CyFxSpiBulkReadStop() before CyFxSpiDeInit(). The buffer passed to
+ * CyFxSpiBulkRead() must be a DMA buffer, with room for byteCount rounded up
+ * to a multiple of 16 bytes. */
+CyU3PReturnStatus_t CyFxSpiBulkReadStart(uint32_t clock);
+void CyFxSpiBulkReadStop(void);
+CyU3PReturnStatus_t CyFxSpiBulkRead(uint32_t byteAddress, uint16_t byteCount,
+                                    uint8_t *buffer);
+
 #endif
@@ -47,7 +47,7 @@
 #define FPGA_VERSION_ID         0x7777
 #define FPGA_VERSION_MAJOR      0
 #define FPGA_VERSION_MINOR      1
-#define FPGA_VERSION_PATCH      2
+#define FPGA_VERSION_PATCH      24
 #define FPGA_VERSION            (FPGA_VERSION_MAJOR | (FPGA_VERSION_MINOR << 8) | (FPGA_VERSION_PATCH << 16))
 
 #define TIME_TAMER              TIME_TAMER_0_BASE
@@ -124,6 +124,67 @@ void si5338_write( uint8_t addr, uint8_t data ) {
     return ;
 }
 
+// Read len consecutive registers in one I2C transaction, using the Si5338's
+// register address auto-increment
+void si5338_read_burst( uint8_t addr, uint8_t *data, uint8_t len ) {
+    uint8_t i ;
+
+    if( len == 0 ) return ;
+
+    IOWR_8DIRECT(I2C, OC_I2C_DATA, SI5338_I2C ) ;
+    IOWR_8DIRECT(I2C, OC_I2C_CMD_STATUS, OC_I2C_STA | OC_I2C_WR ) ;
+    si5338_complete_transfer( 1 ) ;
+
+    IOWR_8DIRECT(I2C, OC_I2C_DATA, addr ) ;
+    IOWR_8DIRECT(I2C, OC_I2C_CMD_STATUS, OC_I2C_WR | OC_I2C_STO ) ;
+    si5338_complete_transfer( 1 ) ;
+
+    IOWR_8DIRECT(I2C, OC_I2C_DATA, SI5338_I2C | 1 ) ;
+    IOWR_8DIRECT(I2C, OC_I2C_CMD_STATUS, OC_I2C_STA | OC_I2C_WR ) ;
+    si5338_complete_transfer( 1 ) ;
+
+    // ACK every byte but the last, which is NACK'd to end the read
+    for( i = 0 ; i < len ; i++ ) {
+        if( i == len - 1 ) {
+            IOWR_8DIRECT(I2C, OC_I2C_CMD_STATUS, OC_I2C_RD | OC_I2C_NACK | OC_I2C_STO ) ;
+        } else {
+            IOWR_8DIRECT(I2C, OC_I2C_CMD_STATUS, OC_I2C_RD ) ;
+        }
+        si5338_complete_transfer( 0 ) ;
+        data[i] = IORD_8DIRECT(I2C, OC_I2C_DATA) ;
+    }
+
+    return ;
+}
+
+// Write len consecutive registers in one I2C transaction
+void si5338_write_burst( uint8_t addr, const uint8_t *data, uint8_t len ) {
+    uint8_t i ;
+
+    if( len == 0 ) return ;
+
+    IOWR_8DIRECT(I2C, OC_I2C_DATA, SI5338_I2C) ;
+    IOWR_8DIRECT(I2C, OC_I2C_CMD_STATUS, OC_I2C_STA | OC_I2C_WR ) ;
+    si5338_complete_transfer( 1 ) ;
+
+    IOWR_8DIRECT(I2C, OC_I2C_DATA, addr) ;
+    IOWR_8DIRECT(I2C, OC_I2C_CMD_STATUS, OC_I2C_WR ) ;
+    si5338_complete_transfer( 1 ) ;
+
+    for( i = 0 ; i < len ; i++ ) {
+        IOWR_8DIRECT(I2C, OC_I2C_DATA, data[i] ) ;
+        if( i == len - 1 ) {
+            IOWR_8DIRECT(I2C, OC_I2C_CMD_STATUS, OC_I2C_WR | OC_I2C_STO ) ;
+            si5338_complete_transfer( 0 ) ;
+        } else {
+            IOWR_8DIRECT(I2C, OC_I2C_CMD_STATUS, OC_I2C_WR ) ;
+            si5338_complete_transfer( 1 ) ;
+        }
+    }
+
+    return ;
+}
+
 // Trim DAC write
 void dac_write( uint16_t val ) {
 //    alt_printf( "DAC Writing: %x\n", val ) ;
@@ -157,21 +218,109 @@ void adf4351_write( uint32_t val ) {
     return ;
 }
 
-// SPI Read
-void lms_spi_read( uint8_t address, uint8_t *val )
+// Timed LMS SPI command engine
+//
+// The FPGA's command engine performs queued LMS register writes and
+// read-modify-writes on its own, each after waiting for an RX or TX
+// timestamp, so scheduled retunes are applied without NIOS latency. Words
+// are pushed by toggling bit 31 of the command PIO, while bit 30 keeps the
+// engine off the SPI bus during accesses from the NIOS. Images without the
+// engine read its status as zero, which reports no free FIFO entries.
+#define SPI_ENGINE_PUSH         (1u << 31)
+#define SPI_ENGINE_HOLD         (1u << 30)
+#define SPI_ENGINE_WRITE        (0u << 28)
+#define SPI_ENGINE_TIME         (1u << 28)
+#define SPI_ENGINE_WAIT         (2u << 28)
+#define SPI_ENGINE_MODIFY       (3u << 28)
+#define SPI_ENGINE_OWNED        (1u << 30)
+#define SPI_ENGINE_WAITING      (1u << 29)
+#define SPI_ENGINE_FREE_MASK    0xff
+#define SPI_ENGINE_FIFO_DEPTH   32
+
+static uint32_t spi_engine_cmd ;
+static uint8_t spi_engine_present ;
+
+static uint8_t spi_engine_free( void )
+{
+    return IORD_ALTERA_AVALON_PIO_DATA(LMS_SPI_STATUS_BASE) & SPI_ENGINE_FREE_MASK ;
+}
+
+static uint8_t spi_engine_idle( void )
+{
+    uint32_t status = IORD_ALTERA_AVALON_PIO_DATA(LMS_SPI_STATUS_BASE) ;
+    return (status & SPI_ENGINE_WAITING) == 0 &&
+           (status & SPI_ENGINE_FREE_MASK) == SPI_ENGINE_FIFO_DEPTH ;
+}
+
+// Push a command word, once the previous push has been accepted
+static void spi_engine_push( uint32_t word )
+{
+    while( ((IORD_ALTERA_AVALON_PIO_DATA(LMS_SPI_STATUS_BASE) ^ spi_engine_cmd) & SPI_ENGINE_PUSH) != 0 ) { } ;
+    spi_engine_cmd = ((spi_engine_cmd ^ SPI_ENGINE_PUSH) & (SPI_ENGINE_PUSH | SPI_ENGINE_HOLD)) |
+                     (word & ~(SPI_ENGINE_PUSH | SPI_ENGINE_HOLD)) ;
+    IOWR_ALTERA_AVALON_PIO_DATA(LMS_SPI_CMD_BASE, spi_engine_cmd) ;
+}
+
+static void spi_engine_push_wait( uint8_t module, uint64_t timestamp )
+{
+    spi_engine_push( SPI_ENGINE_TIME | (0 << 24) | (uint32_t)(timestamp & 0xffffff) ) ;
+    spi_engine_push( SPI_ENGINE_TIME | (1 << 24) | (uint32_t)((timestamp >> 24) & 0xffffff) ) ;
+    spi_engine_push( SPI_ENGINE_TIME | (2 << 24) | (uint32_t)(timestamp >> 48) ) ;
+    spi_engine_push( SPI_ENGINE_WAIT | module ) ;
+}
+
+static void spi_engine_push_modify( uint8_t addr, uint8_t mask, uint8_t data )
+{
+    spi_engine_push( SPI_ENGINE_MODIFY | ((uint32_t)mask << 15) | ((uint32_t)addr << 8) | data ) ;
+}
+
+static void spi_engine_push_write( uint8_t addr, uint8_t data )
+{
+    spi_engine_push( SPI_ENGINE_WRITE | ((uint32_t)addr << 8) | data ) ;
+}
+
+// Keep the engine off the SPI bus, and wait for any transfer it has started
+static void spi_engine_hold( void )
+{
+    if( spi_engine_present ) {
+        spi_engine_cmd |= SPI_ENGINE_HOLD ;
+        IOWR_ALTERA_AVALON_PIO_DATA(LMS_SPI_CMD_BASE, spi_engine_cmd) ;
+        while( IORD_ALTERA_AVALON_PIO_DATA(LMS_SPI_STATUS_BASE) & SPI_ENGINE_OWNED ) { } ;
+    }
+}
+
+static void spi_engine_release( void )
+{
+    if( spi_engine_present ) {
+        spi_engine_cmd &= ~SPI_ENGINE_HOLD ;
+        IOWR_ALTERA_AVALON_PIO_DATA(LMS_SPI_CMD_BASE, spi_engine_cmd) ;
+    }
+}
+
+// Read len consecutive registers in one SPI transaction, using the
+// LMS6002D's register address auto-increment
+void lms_spi_read_burst( uint8_t address, uint8_t *data, uint8_t len )
 {
     uint8_t rv ;
-    if( address > 0x7f )
+    if( len == 0 || address > 0x7f || (address + len - 1) > 0x7f )
     {
 //        alt_printf( "Invalid read address: %x\n", address ) ;
     } else {
-        alt_avalon_spi_command( SPI_0_BASE, 0, 1, &address, 0, 0, ALT_AVALON_SPI_COMMAND_MERGE ) ;
-        rv = alt_avalon_spi_command( SPI_0_BASE, 0, 0, 0, 1, val, 0 ) ;
-        if( rv != 1 )
+        spi_engine_hold() ;
+        rv = alt_avalon_spi_command( SPI_0_BASE, 0, 1, &address, len, data, 0 ) ;
+        spi_engine_release() ;
+        if( rv != len )
         {
 //            alt_putstr( "SPI data read did not work :(\n") ;
         }
     }
+    return ;
+}
+
+// SPI Read
+void lms_spi_read( uint8_t address, uint8_t *val )
+{
+    lms_spi_read_burst( address, val, 1 ) ;
     if( LMS_VERBOSE )
     {
 //        alt_printf( "r-addr: %x data: %x\n", address, *val ) ;
@@ -179,6 +328,24 @@ void lms_spi_read( uint8_t address, uint8_t *val )
     return ;
 }
 
+// Write len consecutive registers in one SPI transaction
+void lms_spi_write_burst( uint8_t address, const uint8_t *data, uint8_t len )
+{
+    uint8_t i ;
+    uint8_t buf[8] ;
+
+    if( len == 0 || len > sizeof(buf) - 1 ) return ;
+
+    buf[0] = address | LMS_WRITE ;
+    for( i = 0 ; i < len ; i++ ) {
+        buf[i + 1] = data[i] ;
+    }
+    spi_engine_hold() ;
+    alt_avalon_spi_command( SPI_0_BASE, 0, len + 1, buf, 0, 0, 0 ) ;
+    spi_engine_release() ;
+    return ;
+}
+
 // SPI Write
 void lms_spi_write( uint8_t address, uint8_t val )
 {
@@ -191,11 +358,548 @@ void lms_spi_write( uint8_t address, uint8_t val )
         alt_printf( "Invalid write address: %x\n", address ) ;
     } else*/ {
         uint8_t data[2] = { address |= LMS_WRITE, val } ;
+        spi_engine_hold() ;
         alt_avalon_spi_command( SPI_0_BASE, 0, 2, data, 0, 0, 0 ) ;
+        spi_engine_release() ;
     }
     return ;
 }
 
+// Scheduled retunes
+//
+// The host stages a retune in the 16 byte GDEV_RETUNE register window,
+// and writing the last byte of the window queues it. Reading the last
+// byte of the window returns the number of free queue entries.
+//
+//  Offset  | Contents
+//  --------+--------------------------------------------------
+//   0 - 7  | Timestamp (little-endian) at which to retune
+//   8 - 11 | LMS PLL register values for base + 0 .. base + 3
+//   12     | LMS PLL register value for base + 5 (FREQSEL)
+//   13     | VCOCAP value for base + 9
+//   14     | Module: 0 = RX, 1 = TX
+//   15     | Write: queue the staged retune. Read: free entries
+//
+// If RETUNE_FLAG_WRITES is set in the module byte, the entry instead
+// describes up to three LMS register writes (e.g., a gain change), with
+// offsets 8 - 13 holding address/data pairs. Pairs with an address of
+// 0x80 or greater are ignored.
+//
+// If RETUNE_FLAG_XB200 is set instead, the entry switches the module's
+// XB-200 signal path and filter bank. Offsets 8 - 11 hold the expansion GPIO
+// value, of which only the module's path and filter bank bits are applied,
+// and offset 12 is 1 to select the LMS path swap for the XB-200 mixer.
+#define RETUNE_QUEUE_LEN        16
+#define RETUNE_WINDOW_LEN       16
+#define RETUNE_MODULE_RX        0
+#define RETUNE_MODULE_TX        1
+#define RETUNE_FLAG_WRITES      0x80
+#define RETUNE_FLAG_XB200       0x40
+#define RETUNE_NUM_WRITES       3
+
+// Expansion GPIO bits holding each module's XB-200 path and filter bank,
+// and the LMS register 0x5A bits swapping its path through the mixer
+#define XB200_RX_GPIO_MASK      0x30002030
+#define XB200_TX_GPIO_MASK      0x0c00100c
+#define XB200_RX_LMS_SWAP       0x40
+#define XB200_TX_LMS_SWAP       0x08
+
+struct retune {
+    uint64_t timestamp;
+    uint8_t payload[6];
+    uint8_t module;
+    uint8_t valid;
+};
+
+static struct retune retune_queue[RETUNE_QUEUE_LEN];
+static uint8_t retune_staging[RETUNE_WINDOW_LEN];
+
+// Identifier of the loaded FPGA image, written by the host after it loads
+// this image. This is zeroed whenever the FPGA is (re)configured.
+#define IMAGE_ID_LEN            8
+static uint8_t image_id[IMAGE_ID_LEN];
+
+// RX DC offset and IQ imbalance tracking estimates. Both are captured when
+// the first byte of the window is read, so a host read sees one coherent
+// snapshot.
+#define RX_TRACK_LEN            8
+static uint32_t rx_track[2];
+
+// Sample FIFO fill level marks, and the FIFO depths. Both are captured when
+// the first byte of the window is read.
+#define FIFO_LEVELS_LEN         8
+static uint32_t fifo_levels[2];
+
+// RX trigger status, captured when the first byte is read
+static uint32_t rx_trigger_status;
+
+// Late TX message count and worst lateness, captured when the first byte is
+// read
+static uint32_t tx_late;
+
+// TX sample FIFO underflow count, captured when the first byte is read
+static uint32_t tx_underflows;
+
+// Timestamp latch. Its configuration occupies bits 10:0 of the control PIO,
+// and the remaining bits select the word read back and stage the counter
+// load value 16 bits at a time.
+#define TIME_LATCH_CFG_MASK     0x7ff
+#define TIME_LATCH_ARM          (1 << 11)
+#define TIME_LATCH_SEL_SHIFT    12
+#define TIME_LATCH_SEL_STATUS   (1 << 14)
+#define TIME_LATCH_STAGE        (1 << 15)
+#define TIME_LATCH_DATA_SHIFT   16
+
+#define TIME_LATCH_EDGES_MASK   0xffff
+#define TIME_LATCH_STAGED_SHIFT 18
+
+#define TIME_LATCH_LOAD_LEN     8
+#define TIME_LATCH_LEN          20
+
+static uint32_t time_latch_ctrl;
+static uint8_t time_latch_load[TIME_LATCH_LOAD_LEN];
+
+// RX time, TX time, and status, captured when the first byte is read
+static uint32_t time_latch[5];
+
+// The tracker's estimates change at most every few thousand samples, and the
+// FIFO level marks only as new extremes are reached, so two matching reads
+// of a PIO are a coherent value
+static uint32_t pio_read_stable(uint32_t base)
+{
+    uint32_t prev, cur = IORD_ALTERA_AVALON_PIO_DATA(base);
+
+    do {
+        prev = cur;
+        cur = IORD_ALTERA_AVALON_PIO_DATA(base);
+    } while (cur != prev);
+
+    return cur;
+}
+
+static uint32_t time_latch_read(uint32_t sel)
+{
+    time_latch_ctrl &= ~(TIME_LATCH_SEL_STATUS | (3 << TIME_LATCH_SEL_SHIFT));
+    time_latch_ctrl |= sel;
+    IOWR_ALTERA_AVALON_PIO_DATA(TIME_LATCH_CTRL_BASE, time_latch_ctrl);
+    return pio_read_stable(TIME_LATCH_STATUS_BASE);
+}
+
+// Apply a timestamp latch configuration. If an action is to be armed, the
+// load value is first staged in both the RX and TX latches. The wait for
+// each chunk is bounded, in case the LMS clocks are not running.
+static void time_latch_config(uint32_t cfg)
+{
+    int i, tries;
+    uint32_t chunk, staged, status;
+
+    time_latch_ctrl &= ~TIME_LATCH_CFG_MASK;
+    time_latch_ctrl |= cfg & TIME_LATCH_CFG_MASK;
+    IOWR_ALTERA_AVALON_PIO_DATA(TIME_LATCH_CTRL_BASE, time_latch_ctrl);
+
+    if ((cfg & TIME_LATCH_ARM) == 0) {
+        return;
+    }
+
+    for (i = 0; i < TIME_LATCH_LOAD_LEN / 2; i++) {
+        chunk = time_latch_load[2 * i] | (time_latch_load[2 * i + 1] << 8);
+
+        // The chunk and its index settle before the stage toggle changes
+        time_latch_ctrl &= ~((0xffff << TIME_LATCH_DATA_SHIFT) |
+                             TIME_LATCH_SEL_STATUS |
+                             (3 << TIME_LATCH_SEL_SHIFT));
+        time_latch_ctrl |= (chunk << TIME_LATCH_DATA_SHIFT) |
+                           (i << TIME_LATCH_SEL_SHIFT);
+        IOWR_ALTERA_AVALON_PIO_DATA(TIME_LATCH_CTRL_BASE, time_latch_ctrl);
+
+        time_latch_ctrl ^= TIME_LATCH_STAGE;
+        IOWR_ALTERA_AVALON_PIO_DATA(TIME_LATCH_CTRL_BASE, time_latch_ctrl);
+
+        // Both latches acknowledge the chunk. The chunk index is kept while
+        // the status is selected.
+        staged = (time_latch_ctrl & TIME_LATCH_STAGE) ? 3 : 0;
+        for (tries = 0; tries < 1000; tries++) {
+            status = time_latch_read(TIME_LATCH_SEL_STATUS |
+                                     (i << TIME_LATCH_SEL_SHIFT));
+            if (((status >> TIME_LATCH_STAGED_SHIFT) & 3) == staged) {
+                break;
+            }
+        }
+    }
+
+    time_latch_ctrl ^= TIME_LATCH_ARM;
+    IOWR_ALTERA_AVALON_PIO_DATA(TIME_LATCH_CTRL_BASE, time_latch_ctrl);
+}
+
+// Capture both latched times and the status. The latch is read again if an
+// edge arrived part way through.
+static void time_latch_capture(void)
+{
+    uint32_t status;
+    int i;
+
+    do {
+        status = time_latch_read(TIME_LATCH_SEL_STATUS);
+        for (i = 0; i < 4; i++) {
+            time_latch[i] = time_latch_read(i << TIME_LATCH_SEL_SHIFT);
+        }
+        time_latch[4] = time_latch_read(TIME_LATCH_SEL_STATUS);
+    } while (((status ^ time_latch[4]) & TIME_LATCH_EDGES_MASK) != 0);
+}
+
+// Read a module's current timestamp. The upper bytes are read again to
+// detect a carry between the individual byte reads.
+static uint64_t time_tamer_read( uint8_t module )
+{
+    const uint8_t base = (module == RETUNE_MODULE_RX) ? 0 : 8 ;
+    uint32_t upper, lower, check ;
+    int i ;
+
+    do {
+        upper = lower = check = 0 ;
+        for( i = 0 ; i < 4 ; i++ ) {
+            upper |= ((uint32_t)IORD_8DIRECT(TIME_TAMER, base + 4 + i)) << (i * 8) ;
+        }
+        for( i = 0 ; i < 4 ; i++ ) {
+            lower |= ((uint32_t)IORD_8DIRECT(TIME_TAMER, base + i)) << (i * 8) ;
+        }
+        for( i = 0 ; i < 4 ; i++ ) {
+            check |= ((uint32_t)IORD_8DIRECT(TIME_TAMER, base + 4 + i)) << (i * 8) ;
+        }
+    } while( upper != check ) ;
+
+    return (((uint64_t)upper) << 32) | lower ;
+}
+
+static uint8_t retune_free_entries( void )
+{
+    uint8_t i, n = 0 ;
+    for( i = 0 ; i < RETUNE_QUEUE_LEN ; i++ ) {
+        if( !retune_queue[i].valid ) {
+            n++ ;
+        }
+    }
+    return n ;
+}
+
+// The module and timestamp of the last retune handed to the SPI engine
+static uint8_t spi_engine_module ;
+static uint64_t spi_engine_last ;
+
+// Number of engine FIFO entries taken by a retune
+#define SPI_ENGINE_RETUNE_WORDS 12
+#define SPI_ENGINE_WRITES_WORDS (4 + RETUNE_NUM_WRITES)
+
+// Hand a retune to the SPI engine, if it can perform the retune on time.
+// The engine performs its commands in order, so a retune is only accepted
+// while the engine is idle, or if it follows the last accepted retune on
+// the same module. Returns 1 if the retune was accepted.
+static uint8_t retune_offload( const uint8_t *staging )
+{
+    const uint8_t module = staging[14] ;
+    const uint8_t base = ((module & 1) == RETUNE_MODULE_RX) ? 0x20 : 0x10 ;
+    const uint8_t *payload = &staging[8] ;
+    uint64_t timestamp = 0 ;
+    uint8_t i, words ;
+
+    if( !spi_engine_present || (module & RETUNE_FLAG_XB200) ) {
+        return 0 ;
+    }
+
+    for( i = 0 ; i < 8 ; i++ ) {
+        timestamp |= ((uint64_t)staging[i]) << (i * 8) ;
+    }
+
+    words = (module & RETUNE_FLAG_WRITES) ? SPI_ENGINE_WRITES_WORDS : SPI_ENGINE_RETUNE_WORDS ;
+    if( spi_engine_free() < words ) {
+        return 0 ;
+    }
+
+    if( !spi_engine_idle() &&
+        (spi_engine_module != (module & 1) || timestamp < spi_engine_last) ) {
+        return 0 ;
+    }
+
+    spi_engine_push_wait( module & 1, timestamp ) ;
+
+    if( module & RETUNE_FLAG_WRITES ) {
+        for( i = 0 ; i < RETUNE_NUM_WRITES ; i++ ) {
+            if( payload[2 * i] < 0x80 ) {
+                spi_engine_push_write( payload[2 * i], payload[2 * i + 1] ) ;
+            }
+        }
+    } else {
+        // The same sequence as retune_apply()
+        spi_engine_push_modify( 0x09, 0x05, 0x05 ) ;
+        spi_engine_push_write( base + 5, payload[4] ) ;
+        for( i = 0 ; i < 4 ; i++ ) {
+            spi_engine_push_write( base + i, payload[i] ) ;
+        }
+        spi_engine_push_modify( base + 9, 0x3f, payload[5] & 0x3f ) ;
+        spi_engine_push_modify( 0x09, 0x05, 0x00 ) ;
+    }
+
+    spi_engine_module = module & 1 ;
+    spi_engine_last = timestamp ;
+    return 1 ;
+}
+
+// Queue the staged retune. The host checks for a free entry beforehand, so
+// if the queue is full the request is dropped.
+static void retune_enqueue( void )
+{
+    uint8_t i ;
+    struct retune *r = NULL ;
+
+    if( retune_offload( retune_staging ) ) {
+        return ;
+    }
+
+    for( i = 0 ; i < RETUNE_QUEUE_LEN && r == NULL ; i++ ) {
+        if( !retune_queue[i].valid ) {
+            r = &retune_queue[i] ;
+        }
+    }
+
+    if( r == NULL ) {
+        return ;
+    }
+
+    r->timestamp = 0 ;
+    for( i = 0 ; i < 8 ; i++ ) {
+        r->timestamp |= ((uint64_t)retune_staging[i]) << (i * 8) ;
+    }
+
+    memcpy(r->payload, &retune_staging[8], sizeof(r->payload)) ;
+    r->module = retune_staging[14] ;
+    r->valid = 1 ;
+}
+
+static void retune_apply( const struct retune *r )
+{
+    const uint8_t base = ((r->module & 1) == RETUNE_MODULE_RX) ? 0x20 : 0x10 ;
+    uint8_t i, val ;
+
+    if( r->module & RETUNE_FLAG_WRITES ) {
+        for( i = 0 ; i < RETUNE_NUM_WRITES ; i++ ) {
+            if( r->payload[2 * i] < 0x80 ) {
+                lms_spi_write( r->payload[2 * i], r->payload[2 * i + 1] ) ;
+            }
+        }
+        return ;
+    }
+
+    if( r->module & RETUNE_FLAG_XB200 ) {
+        const uint8_t rx = (r->module & 1) == RETUNE_MODULE_RX ;
+        const uint32_t mask = rx ? XB200_RX_GPIO_MASK : XB200_TX_GPIO_MASK ;
+        const uint8_t swap = rx ? XB200_RX_LMS_SWAP : XB200_TX_LMS_SWAP ;
+        uint32_t gpio = 0 ;
+
+        for( i = 0 ; i < 4 ; i++ ) {
+            gpio |= ((uint32_t)r->payload[i]) << (i * 8) ;
+        }
+
+        lms_spi_read( 0x5a, &val ) ;
+        lms_spi_write( 0x5a, r->payload[4] ? (val | swap) : (val & ~swap) ) ;
+
+        IOWR_ALTERA_AVALON_PIO_DATA( PIO_1_BASE,
+            (IORD_ALTERA_AVALON_PIO_DATA(PIO_1_BASE) & ~mask) | (gpio & mask) ) ;
+        return ;
+    }
+
+    // Turn on the DSMs while the PLL is reconfigured
+    lms_spi_read( 0x09, &val ) ;
+    lms_spi_write( 0x09, val | 0x05 ) ;
+
+    lms_spi_write( base + 5, r->payload[4] ) ;
+    for( i = 0 ; i < 4 ; i++ ) {
+        lms_spi_write( base + i, r->payload[i] ) ;
+    }
+
+    lms_spi_read( base + 9, &val ) ;
+    lms_spi_write( base + 9, (val & ~0x3f) | (r->payload[5] & 0x3f) ) ;
+
+    lms_spi_read( 0x09, &val ) ;
+    lms_spi_write( 0x09, val & ~0x05 ) ;
+}
+
+// Perform any queued retunes whose timestamps have been reached, earliest first
+static void retune_service( void )
+{
+    uint8_t i ;
+    uint64_t now[2] ;
+    struct retune *next ;
+
+    if( retune_free_entries() == RETUNE_QUEUE_LEN ) {
+        return ;
+    }
+
+    now[RETUNE_MODULE_RX] = time_tamer_read( RETUNE_MODULE_RX ) ;
+    now[RETUNE_MODULE_TX] = time_tamer_read( RETUNE_MODULE_TX ) ;
+
+    do {
+        next = NULL ;
+        for( i = 0 ; i < RETUNE_QUEUE_LEN ; i++ ) {
+            struct retune *r = &retune_queue[i] ;
+            if( r->valid && r->timestamp <= now[r->module & 1] &&
+                (next == NULL || r->timestamp < next->timestamp) ) {
+                next = r ;
+            }
+        }
+
+        if( next != NULL ) {
+            retune_apply( next ) ;
+            next->valid = 0 ;
+        }
+    } while( next != NULL ) ;
+}
+
+// Command sequences
+//
+// A sequence is a short program of LMS6002D and Si5338 accesses, run without
+// a host round trip per access. The host appends the program 14 bytes at a
+// time with SEQ_APPEND packets, and a SEQ_RUN packet runs and then discards
+// it. Each operation is an opcode byte followed by its arguments:
+//
+//  Opcode         | Arguments                | Effect
+//  ---------------+--------------------------+-----------------------------
+//  SEQ_OP_WRITE   | addr, data               | Write data to addr
+//  SEQ_OP_READ    | addr                     | Read addr into the results
+//  SEQ_OP_MODIFY  | addr, mask, value        | Replace the mask bits of addr
+//  SEQ_OP_POLL    | addr, mask, value, tries | Read addr up to tries times,
+//                 |                          | until (reg & mask) == value
+//
+// SEQ_DEV_SI5338 may be OR'd into an opcode to access the Si5338 instead of
+// the LMS6002D. A poll stores the last value read in the results, and stops
+// the sequence with SEQ_STATUS_TIMEOUT if it never matched.
+//
+// The SEQ_RUN response holds the status, the number of operations that
+// completed, the number of results, and the first 11 results. A SEQ_RESULTS
+// packet returns 14 results from the offset in its first address byte.
+#define SEQ_PROG_LEN            96
+#define SEQ_RESULTS_LEN         32
+#define SEQ_RUN_RESULTS         11
+
+#define SEQ_OP_WRITE            0x10
+#define SEQ_OP_READ             0x20
+#define SEQ_OP_MODIFY           0x30
+#define SEQ_OP_POLL             0x40
+#define SEQ_OP_MASK             0xf0
+#define SEQ_DEV_SI5338          0x01
+
+#define SEQ_STATUS_OK           0
+#define SEQ_STATUS_TIMEOUT      1
+#define SEQ_STATUS_INVALID      2
+#define SEQ_STATUS_OVERFLOW     3
+
+static uint8_t seq_prog[SEQ_PROG_LEN];
+static uint8_t seq_len;
+static uint8_t seq_overflow;
+static uint8_t seq_results[SEQ_RESULTS_LEN];
+static uint8_t seq_num_results;
+
+static void seq_append( const uint8_t *data, uint8_t len )
+{
+    if( seq_len + len > SEQ_PROG_LEN ) {
+        seq_overflow = 1 ;
+    } else {
+        memcpy( &seq_prog[seq_len], data, len ) ;
+        seq_len += len ;
+    }
+}
+
+static void seq_reg_read( uint8_t op, uint8_t addr, uint8_t *val )
+{
+    if( op & SEQ_DEV_SI5338 ) {
+        si5338_read( addr, val ) ;
+    } else {
+        lms_spi_read( addr, val ) ;
+    }
+}
+
+static void seq_reg_write( uint8_t op, uint8_t addr, uint8_t val )
+{
+    if( op & SEQ_DEV_SI5338 ) {
+        si5338_write( addr, val ) ;
+    } else {
+        lms_spi_write( addr, val ) ;
+    }
+}
+
+static uint8_t seq_store( uint8_t val )
+{
+    if( seq_num_results >= SEQ_RESULTS_LEN ) {
+        return SEQ_STATUS_OVERFLOW ;
+    }
+    seq_results[seq_num_results++] = val ;
+    return SEQ_STATUS_OK ;
+}
+
+// Run and then discard the staged sequence, returning its status
+static uint8_t seq_run( uint8_t *completed )
+{
+    uint8_t pc = 0, len, val, tries ;
+    uint8_t status = seq_overflow ? SEQ_STATUS_OVERFLOW : SEQ_STATUS_OK ;
+    const uint8_t *arg ;
+
+    *completed = 0 ;
+    seq_num_results = 0 ;
+
+    while( status == SEQ_STATUS_OK && pc < seq_len ) {
+        switch( seq_prog[pc] & SEQ_OP_MASK ) {
+            case SEQ_OP_WRITE:  len = 3 ; break ;
+            case SEQ_OP_READ:   len = 2 ; break ;
+            case SEQ_OP_MODIFY: len = 4 ; break ;
+            case SEQ_OP_POLL:   len = 5 ; break ;
+            default:            len = 0 ; break ;
+        }
+
+        if( len == 0 || pc + len > seq_len ) {
+            status = SEQ_STATUS_INVALID ;
+            break ;
+        }
+
+        arg = &seq_prog[pc + 1] ;
+        switch( seq_prog[pc] & SEQ_OP_MASK ) {
+            case SEQ_OP_WRITE:
+                seq_reg_write( seq_prog[pc], arg[0], arg[1] ) ;
+                break ;
+
+            case SEQ_OP_READ:
+                seq_reg_read( seq_prog[pc], arg[0], &val ) ;
+                status = seq_store( val ) ;
+                break ;
+
+            case SEQ_OP_MODIFY:
+                seq_reg_read( seq_prog[pc], arg[0], &val ) ;
+                seq_reg_write( seq_prog[pc], arg[0], (val & ~arg[1]) | (arg[2] & arg[1]) ) ;
+                break ;
+
+            case SEQ_OP_POLL:
+                tries = 0 ;
+                do {
+                    seq_reg_read( seq_prog[pc], arg[0], &val ) ;
+                    tries++ ;
+                } while( (val & arg[1]) != arg[2] && tries < arg[3] ) ;
+
+                status = seq_store( val ) ;
+                if( status == SEQ_STATUS_OK && (val & arg[1]) != arg[2] ) {
+                    status = SEQ_STATUS_TIMEOUT ;
+                }
+                break ;
+        }
+
+        if( status == SEQ_STATUS_OK ) {
+            (*completed)++ ;
+        }
+        pc += len ;
+    }
+
+    seq_len = 0 ;
+    seq_overflow = 0 ;
+    return status ;
+}
+
 // Entry point
 int main()
 {
@@ -220,6 +924,13 @@ int main()
 #define UART_PKT_MODE_DIR_SHIFT  6
 #define UART_PKT_MODE_DIR_READ   (2<<UART_PKT_MODE_DIR_SHIFT)
 #define UART_PKT_MODE_DIR_WRITE  (1<<UART_PKT_MODE_DIR_SHIFT)
+#define UART_PKT_MODE_DIR_SEQ    (3<<UART_PKT_MODE_DIR_SHIFT)
+
+      // With UART_PKT_MODE_DIR_SEQ, the dev field selects a sequence request
+#define UART_PKT_SEQ_APPEND      (0<<UART_PKT_MODE_DEV_SHIFT)
+#define UART_PKT_SEQ_RUN         (1<<UART_PKT_MODE_DEV_SHIFT)
+#define UART_PKT_SEQ_RESULTS     (2<<UART_PKT_MODE_DEV_SHIFT)
+#define UART_PKT_SEQ_CLEAR       (3<<UART_PKT_MODE_DEV_SHIFT)
   };
 
   struct uart_cmd {
@@ -238,6 +949,29 @@ int main()
   IOWR_ALTERA_AVALON_PIO_DATA(IQ_CORR_RX_PHASE_GAIN_BASE, DEFAULT_CORRECTION);
   IOWR_ALTERA_AVALON_PIO_DATA(IQ_CORR_TX_PHASE_GAIN_BASE, DEFAULT_CORRECTION);
 
+  // Bypass the RX DDC
+  IOWR_ALTERA_AVALON_PIO_DATA(RX_NCO_DPHASE_BASE, 0);
+
+  // Only stream channelizer channel 0 until told otherwise
+  IOWR_ALTERA_AVALON_PIO_DATA(RX_CHAN_MASK_BASE, 1);
+
+  // Unpacked SC16 Q11 samples in both directions, an 8-bit sample shift of
+  // 4 should either module switch to SC8 Q7, and QPSK should TX switch to
+  // symbols
+  IOWR_ALTERA_AVALON_PIO_DATA(SAMPLE_FMT_BASE, (1 << 16) | (4 << 12) | (4 << 8));
+
+  // Forward all RX samples until a trigger is configured
+  IOWR_ALTERA_AVALON_PIO_DATA(RX_TRIGGER_CTRL_BASE, 0);
+
+  // The timestamp latch is idle, and its toggles match the FPGA's reset state
+  time_latch_ctrl = 0;
+  IOWR_ALTERA_AVALON_PIO_DATA(TIME_LATCH_CTRL_BASE, time_latch_ctrl);
+
+  // Scheduled retunes are handed to the SPI engine, where there is one
+  spi_engine_cmd = IORD_ALTERA_AVALON_PIO_DATA(LMS_SPI_STATUS_BASE) & SPI_ENGINE_PUSH;
+  IOWR_ALTERA_AVALON_PIO_DATA(LMS_SPI_CMD_BASE, spi_engine_cmd);
+  spi_engine_present = spi_engine_idle();
+
   /* Event loop never exits. */
   {
       char state;
@@ -258,12 +992,15 @@ int main()
       state = LOOKING_FOR_MAGIC;
       while(1)
       {
+          retune_service() ;
+
           // Check if anything is in the FSK UART
           if( IORD_ALTERA_AVALON_UART_STATUS(UART_0_BASE) & ALTERA_AVALON_UART_STATUS_RRDY_MSK )
           {
               uint8_t val ;
               int isRead;
               int isWrite;
+              int isSeq;
 
               val = IORD_ALTERA_AVALON_UART_RXDATA(UART_0_BASE) ;
 
@@ -299,6 +1036,7 @@ int main()
 
               isRead = (mode & UART_PKT_MODE_DIR_MASK) == UART_PKT_MODE_DIR_READ;
               isWrite = (mode & UART_PKT_MODE_DIR_MASK) == UART_PKT_MODE_DIR_WRITE;
+              isSeq = (mode & UART_PKT_MODE_DIR_MASK) == UART_PKT_MODE_DIR_SEQ;
 
               if (state == EXECUTE_CMDS) {
                   write_uart(UART_PKT_MAGIC);
@@ -307,34 +1045,114 @@ int main()
                   cnt = (mode & UART_PKT_MODE_CNT_MASK);
                   cmd_ptr = (struct uart_cmd *)buf;
 
-                  if ((mode & UART_PKT_MODE_DEV_MASK) == UART_PKT_DEV_LMS) {
-                      for (i = 0; i < cnt; i++) {
+                  if (isSeq) {
+                      uint8_t k, offset, completed;
+
+                      switch (mode & UART_PKT_MODE_DEV_MASK) {
+                          case UART_PKT_SEQ_APPEND:
+                              seq_append(buf, cnt * sizeof(struct uart_cmd));
+                              memset(buf, 0, sizeof(buf));
+                              break;
+
+                          case UART_PKT_SEQ_RUN:
+                              buf[0] = seq_run(&completed);
+                              buf[1] = completed;
+                              buf[2] = seq_num_results;
+                              for (k = 0; k < SEQ_RUN_RESULTS; k++) {
+                                  buf[3 + k] = (k < seq_num_results) ? seq_results[k] : 0;
+                              }
+                              break;
+
+                          case UART_PKT_SEQ_RESULTS:
+                              offset = buf[0];
+                              for (k = 0; k < sizeof(buf); k++) {
+                                  buf[k] = (offset + k < seq_num_results) ? seq_results[offset + k] : 0;
+                              }
+                              break;
+
+                          default:
+                              seq_len = 0;
+                              seq_overflow = 0;
+                              memset(buf, 0, sizeof(buf));
+                              break;
+                      }
+
+                      // The response always carries the whole payload
+                      cnt = sizeof(buf) / sizeof(struct uart_cmd);
+                  }
+                  if (!isSeq && (mode & UART_PKT_MODE_DEV_MASK) == UART_PKT_DEV_LMS) {
+                      // Commands for consecutive registers are performed
+                      // as a single SPI burst
+                      i = 0;
+                      while (i < cnt) {
+                          uint8_t run, k;
+                          uint8_t burst[7];
+
+                          run = 1;
+                          while ((i + run) < cnt &&
+                                 cmd_ptr[i + run].addr == (uint8_t)(cmd_ptr[i].addr + run) &&
+                                 cmd_ptr[i + run].addr <= 0x7f) {
+                              run++;
+                          }
+
                           if (isRead) {
-                              lms_spi_read(cmd_ptr->addr, &cmd_ptr->data);
+                              if (cmd_ptr[i].addr > 0x7f) {
+                                  burst[0] = cmd_ptr[i].data;
+                              } else {
+                                  lms_spi_read_burst(cmd_ptr[i].addr, burst, run);
+                              }
+                              for (k = 0; k < run; k++) {
+                                  cmd_ptr[i + k].data = burst[k];
+                              }
                           } else if (isWrite) {
-                              lms_spi_write(cmd_ptr->addr, cmd_ptr->data);
-                              cmd_ptr->data = 0;
+                              for (k = 0; k < run; k++) {
+                                  burst[k] = cmd_ptr[i + k].data;
+                                  cmd_ptr[i + k].data = 0;
+                              }
+                              lms_spi_write_burst(cmd_ptr[i].addr, burst, run);
                           } else {
-                              cmd_ptr->addr = 0;
-                              cmd_ptr->data = 0;
+                              for (k = 0; k < run; k++) {
+                                  cmd_ptr[i + k].addr = 0;
+                                  cmd_ptr[i + k].data = 0;
+                              }
                           }
-                          cmd_ptr++;
+
+                          i += run;
                       }
                   }
-                  if ((mode & UART_PKT_MODE_DEV_MASK) == UART_PKT_DEV_SI5338) {
-                      for (i = 0; i < cnt; i++) {
+                  if (!isSeq && (mode & UART_PKT_MODE_DEV_MASK) == UART_PKT_DEV_SI5338) {
+                      // Commands for consecutive registers are performed
+                      // as a single I2C burst
+                      i = 0;
+                      while (i < cnt) {
+                          uint8_t run, k;
+                          uint8_t burst[7];
+
+                          run = 1;
+                          while ((i + run) < cnt &&
+                                 cmd_ptr[i + run].addr == (uint8_t)(cmd_ptr[i].addr + run)) {
+                              run++;
+                          }
+
                           if (isRead) {
-                              uint8_t tmpvar;
-                              si5338_read(cmd_ptr->addr, &tmpvar);
-                              cmd_ptr->data = tmpvar;
+                              si5338_read_burst(cmd_ptr[i].addr, burst, run);
+                              for (k = 0; k < run; k++) {
+                                  cmd_ptr[i + k].data = burst[k];
+                              }
                           } else if (isWrite) {
-                              si5338_write(cmd_ptr->addr, cmd_ptr->data);
-                              cmd_ptr->data = 0;
+                              for (k = 0; k < run; k++) {
+                                  burst[k] = cmd_ptr[i + k].data;
+                                  cmd_ptr[i + k].data = 0;
+                              }
+                              si5338_write_burst(cmd_ptr[i].addr, burst, run);
                           } else {
-                              cmd_ptr->addr = 0;
-                              cmd_ptr->data = 0;
+                              for (k = 0; k < run; k++) {
+                                  cmd_ptr[i + k].addr = 0;
+                                  cmd_ptr[i + k].data = 0;
+                              }
                           }
-                          cmd_ptr++;
+
+                          i += run;
                       }
                   }
 
@@ -352,6 +1170,22 @@ int main()
                           GDEV_XB_LO,
                           GDEV_EXPANSION,
                           GDEV_EXPANSION_DIR,
+                          GDEV_RETUNE,
+                          GDEV_IMAGE_ID,
+                          GDEV_RX_NCO,
+                          GDEV_RX_CHANNELS,
+                          GDEV_RX_TRACK,
+                          GDEV_SAMPLE_FMT,
+                          GDEV_FIFO_LEVELS,
+                          GDEV_RX_TRIGGER_CTRL,
+                          GDEV_RX_TRIGGER_LEVEL,
+                          GDEV_RX_TRIGGER_POST,
+                          GDEV_RX_TRIGGER_STATUS,
+                          GDEV_TX_LATE,
+                          GDEV_TX_UNDERFLOWS,
+                          GDEV_TIME_LATCH_CFG,
+                          GDEV_TIME_LATCH_LOAD,
+                          GDEV_TIME_LATCH,
                       } gdev;
                       int start, len;
                   } gdev_lut[] = {
@@ -366,6 +1200,22 @@ int main()
                           {GDEV_XB_LO,         36, 4},
                           {GDEV_EXPANSION,     40, 4},
                           {GDEV_EXPANSION_DIR, 44, 4},
+                          {GDEV_RETUNE,        48, RETUNE_WINDOW_LEN},
+                          {GDEV_IMAGE_ID,      64, IMAGE_ID_LEN},
+                          {GDEV_RX_NCO,        72, 4},
+                          {GDEV_RX_CHANNELS,   76, 4},
+                          {GDEV_RX_TRACK,      80, RX_TRACK_LEN},
+                          {GDEV_SAMPLE_FMT,    88, 4},
+                          {GDEV_FIFO_LEVELS,   92, FIFO_LEVELS_LEN},
+                          {GDEV_RX_TRIGGER_CTRL,   100, 4},
+                          {GDEV_RX_TRIGGER_LEVEL,  104, 4},
+                          {GDEV_RX_TRIGGER_POST,   108, 4},
+                          {GDEV_RX_TRIGGER_STATUS, 112, 4},
+                          {GDEV_TX_LATE,           116, 4},
+                          {GDEV_TX_UNDERFLOWS,     120, 4},
+                          {GDEV_TIME_LATCH_CFG,    124, 4},
+                          {GDEV_TIME_LATCH_LOAD,   128, TIME_LATCH_LOAD_LEN},
+                          {GDEV_TIME_LATCH,        136, TIME_LATCH_LEN},
                   };
 #define ARRAY_SZ(x) (sizeof(x)/sizeof(x[0]))
 #define COLLECT_BYTES(x)       tmpvar &= ~ ( 0xff << ( 8 * cmd_ptr->addr));   \
@@ -378,7 +1228,7 @@ int main()
                               iovar |= (tmpvar) << shift;                \
                               IOWR_ALTERA_AVALON_PIO_DATA(reg, iovar);   \
                          })
-                  if ((mode & UART_PKT_MODE_DEV_MASK) == UART_PKT_DEV_GPIO) {
+                  if (!isSeq && (mode & UART_PKT_MODE_DEV_MASK) == UART_PKT_DEV_GPIO) {
                     uint32_t device;
                     volatile uint32_t lol, lol3;
                     int lut, lastByte;
@@ -413,6 +1263,64 @@ int main()
                             	cmd_ptr->data = (IORD_ALTERA_AVALON_PIO_DATA(IQ_CORR_TX_PHASE_GAIN_BASE)) >> (cmd_ptr->addr * 8);
                             else if (device == GDEV_IQ_CORR_TX_PHASE)
                             	cmd_ptr->data = (IORD_ALTERA_AVALON_PIO_DATA(IQ_CORR_TX_PHASE_GAIN_BASE)) >> ((cmd_ptr->addr + 2) * 8);
+                            else if (device == GDEV_RETUNE)
+                                cmd_ptr->data = lastByte ? retune_free_entries() : retune_staging[cmd_ptr->addr];
+                            else if (device == GDEV_IMAGE_ID)
+                                cmd_ptr->data = image_id[cmd_ptr->addr];
+                            else if (device == GDEV_RX_NCO)
+                                cmd_ptr->data = (IORD_ALTERA_AVALON_PIO_DATA(RX_NCO_DPHASE_BASE)) >> (cmd_ptr->addr * 8);
+                            else if (device == GDEV_RX_CHANNELS)
+                                cmd_ptr->data = (IORD_ALTERA_AVALON_PIO_DATA(RX_CHAN_MASK_BASE)) >> (cmd_ptr->addr * 8);
+                            else if (device == GDEV_RX_TRACK) {
+                                if (cmd_ptr->addr == 0) {
+                                    rx_track[0] = pio_read_stable(RX_TRACK_DC_BASE);
+                                    rx_track[1] = pio_read_stable(RX_TRACK_IQ_BASE);
+                                }
+                                cmd_ptr->data = rx_track[cmd_ptr->addr / 4] >> ((cmd_ptr->addr % 4) * 8);
+                            }
+                            else if (device == GDEV_SAMPLE_FMT)
+                                cmd_ptr->data = (IORD_ALTERA_AVALON_PIO_DATA(SAMPLE_FMT_BASE)) >> (cmd_ptr->addr * 8);
+                            else if (device == GDEV_FIFO_LEVELS) {
+                                if (cmd_ptr->addr == 0) {
+                                    fifo_levels[0] = pio_read_stable(FIFO_LEVELS_BASE);
+                                    fifo_levels[1] = IORD_ALTERA_AVALON_PIO_DATA(FIFO_DEPTH_BASE);
+                                }
+                                cmd_ptr->data = fifo_levels[cmd_ptr->addr / 4] >> ((cmd_ptr->addr % 4) * 8);
+                            }
+                            else if (device == GDEV_RX_TRIGGER_CTRL)
+                                cmd_ptr->data = (IORD_ALTERA_AVALON_PIO_DATA(RX_TRIGGER_CTRL_BASE)) >> (cmd_ptr->addr * 8);
+                            else if (device == GDEV_RX_TRIGGER_LEVEL)
+                                cmd_ptr->data = (IORD_ALTERA_AVALON_PIO_DATA(RX_TRIGGER_LEVEL_BASE)) >> (cmd_ptr->addr * 8);
+                            else if (device == GDEV_RX_TRIGGER_POST)
+                                cmd_ptr->data = (IORD_ALTERA_AVALON_PIO_DATA(RX_TRIGGER_POST_BASE)) >> (cmd_ptr->addr * 8);
+                            else if (device == GDEV_RX_TRIGGER_STATUS) {
+                                if (cmd_ptr->addr == 0) {
+                                    rx_trigger_status = pio_read_stable(RX_TRIGGER_STATUS_BASE);
+                                }
+                                cmd_ptr->data = rx_trigger_status >> (cmd_ptr->addr * 8);
+                            }
+                            else if (device == GDEV_TX_LATE) {
+                                if (cmd_ptr->addr == 0) {
+                                    tx_late = pio_read_stable(TX_LATE_BASE);
+                                }
+                                cmd_ptr->data = tx_late >> (cmd_ptr->addr * 8);
+                            }
+                            else if (device == GDEV_TX_UNDERFLOWS) {
+                                if (cmd_ptr->addr == 0) {
+                                    tx_underflows = pio_read_stable(TX_UNDERFLOWS_BASE);
+                                }
+                                cmd_ptr->data = tx_underflows >> (cmd_ptr->addr * 8);
+                            }
+                            else if (device == GDEV_TIME_LATCH_CFG)
+                                cmd_ptr->data = (time_latch_ctrl & TIME_LATCH_CFG_MASK) >> (cmd_ptr->addr * 8);
+                            else if (device == GDEV_TIME_LATCH_LOAD)
+                                cmd_ptr->data = time_latch_load[cmd_ptr->addr];
+                            else if (device == GDEV_TIME_LATCH) {
+                                if (cmd_ptr->addr == 0) {
+                                    time_latch_capture();
+                                }
+                                cmd_ptr->data = time_latch[cmd_ptr->addr / 4] >> ((cmd_ptr->addr % 4) * 8);
+                            }
                         } else if (isWrite) {
                             if (device == GDEV_TIME_TIMER) {
                                 IOWR_8DIRECT(TIME_TAMER, cmd_ptr->addr, 1) ;
@@ -434,6 +1342,32 @@ int main()
                                 COLLECT_BYTES(SPLIT_WRITE(IQ_CORR_TX_PHASE_GAIN_BASE, 0));
                             } else if (device == GDEV_IQ_CORR_TX_PHASE) {
                                 COLLECT_BYTES(SPLIT_WRITE(IQ_CORR_TX_PHASE_GAIN_BASE, 16));
+                            } else if (device == GDEV_RETUNE) {
+                                retune_staging[cmd_ptr->addr] = cmd_ptr->data;
+                                if (lastByte) {
+                                    retune_enqueue();
+                                }
+                                cmd_ptr->data = 0;
+                            } else if (device == GDEV_IMAGE_ID) {
+                                image_id[cmd_ptr->addr] = cmd_ptr->data;
+                                cmd_ptr->data = 0;
+                            } else if (device == GDEV_RX_NCO) {
+                                COLLECT_BYTES(IOWR_ALTERA_AVALON_PIO_DATA(RX_NCO_DPHASE_BASE, tmpvar));
+                            } else if (device == GDEV_RX_CHANNELS) {
+                                COLLECT_BYTES(IOWR_ALTERA_AVALON_PIO_DATA(RX_CHAN_MASK_BASE, tmpvar));
+                            } else if (device == GDEV_SAMPLE_FMT) {
+                                COLLECT_BYTES(IOWR_ALTERA_AVALON_PIO_DATA(SAMPLE_FMT_BASE, tmpvar));
+                            } else if (device == GDEV_RX_TRIGGER_CTRL) {
+                                COLLECT_BYTES(IOWR_ALTERA_AVALON_PIO_DATA(RX_TRIGGER_CTRL_BASE, tmpvar));
+                            } else if (device == GDEV_RX_TRIGGER_LEVEL) {
+                                COLLECT_BYTES(IOWR_ALTERA_AVALON_PIO_DATA(RX_TRIGGER_LEVEL_BASE, tmpvar));
+                            } else if (device == GDEV_RX_TRIGGER_POST) {
+                                COLLECT_BYTES(IOWR_ALTERA_AVALON_PIO_DATA(RX_TRIGGER_POST_BASE, tmpvar));
+                            } else if (device == GDEV_TIME_LATCH_CFG) {
+                                COLLECT_BYTES(time_latch_config(tmpvar));
+                            } else if (device == GDEV_TIME_LATCH_LOAD) {
+                                time_latch_load[cmd_ptr->addr] = cmd_ptr->data;
+                                cmd_ptr->data = 0;
                             }
                         } else {
                             cmd_ptr->addr = 0;
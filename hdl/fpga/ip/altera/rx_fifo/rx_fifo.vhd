@@ -40,6 +40,11 @@ LIBRARY altera_mf;
 USE altera_mf.all;
 
 ENTITY rx_fifo IS
+	GENERIC
+	(
+		-- log2 of the depth, in words
+		DEPTH_LOG2	: NATURAL := 12
+	);
 	PORT
 	(
 		aclr		: IN STD_LOGIC  := '0';
@@ -51,10 +56,10 @@ ENTITY rx_fifo IS
 		q		: OUT STD_LOGIC_VECTOR (31 DOWNTO 0);
 		rdempty		: OUT STD_LOGIC ;
 		rdfull		: OUT STD_LOGIC ;
-		rdusedw		: OUT STD_LOGIC_VECTOR (11 DOWNTO 0);
+		rdusedw		: OUT STD_LOGIC_VECTOR (DEPTH_LOG2-1 DOWNTO 0);
 		wrempty		: OUT STD_LOGIC ;
 		wrfull		: OUT STD_LOGIC ;
-		wrusedw		: OUT STD_LOGIC_VECTOR (11 DOWNTO 0)
+		wrusedw		: OUT STD_LOGIC_VECTOR (DEPTH_LOG2-1 DOWNTO 0)
 	);
 END rx_fifo;
 
@@ -66,8 +71,8 @@ ARCHITECTURE SYN OF rx_fifo IS
 	SIGNAL sub_wire2	: STD_LOGIC_VECTOR (31 DOWNTO 0);
 	SIGNAL sub_wire3	: STD_LOGIC ;
 	SIGNAL sub_wire4	: STD_LOGIC ;
-	SIGNAL sub_wire5	: STD_LOGIC_VECTOR (11 DOWNTO 0);
-	SIGNAL sub_wire6	: STD_LOGIC_VECTOR (11 DOWNTO 0);
+	SIGNAL sub_wire5	: STD_LOGIC_VECTOR (DEPTH_LOG2-1 DOWNTO 0);
+	SIGNAL sub_wire6	: STD_LOGIC_VECTOR (DEPTH_LOG2-1 DOWNTO 0);
 
 
 
@@ -95,11 +100,11 @@ ARCHITECTURE SYN OF rx_fifo IS
 			rdempty	: OUT STD_LOGIC ;
 			rdfull	: OUT STD_LOGIC ;
 			wrreq	: IN STD_LOGIC ;
-			wrusedw	: OUT STD_LOGIC_VECTOR (11 DOWNTO 0);
+			wrusedw	: OUT STD_LOGIC_VECTOR (DEPTH_LOG2-1 DOWNTO 0);
 			aclr	: IN STD_LOGIC ;
 			data	: IN STD_LOGIC_VECTOR (31 DOWNTO 0);
 			rdreq	: IN STD_LOGIC ;
-			rdusedw	: OUT STD_LOGIC_VECTOR (11 DOWNTO 0);
+			rdusedw	: OUT STD_LOGIC_VECTOR (DEPTH_LOG2-1 DOWNTO 0);
 			wrclk	: IN STD_LOGIC 
 	);
 	END COMPONENT;
@@ -110,17 +115,17 @@ BEGIN
 	q    <= sub_wire2(31 DOWNTO 0);
 	rdempty    <= sub_wire3;
 	rdfull    <= sub_wire4;
-	wrusedw    <= sub_wire5(11 DOWNTO 0);
-	rdusedw    <= sub_wire6(11 DOWNTO 0);
+	wrusedw    <= sub_wire5(DEPTH_LOG2-1 DOWNTO 0);
+	rdusedw    <= sub_wire6(DEPTH_LOG2-1 DOWNTO 0);
 
 	dcfifo_component : dcfifo
 	GENERIC MAP (
 		intended_device_family => "Cyclone IV E",
-		lpm_numwords => 4096,
+		lpm_numwords => 2**DEPTH_LOG2,
 		lpm_showahead => "ON",
 		lpm_type => "dcfifo",
 		lpm_width => 32,
-		lpm_widthu => 12,
+		lpm_widthu => DEPTH_LOG2,
 		overflow_checking => "OFF",
 		rdsync_delaypipe => 5,
 		read_aclr_synch => "ON",
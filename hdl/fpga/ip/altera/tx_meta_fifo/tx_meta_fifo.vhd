@@ -40,6 +40,11 @@ LIBRARY altera_mf;
 USE altera_mf.all;
 
 ENTITY tx_meta_fifo IS
+	GENERIC
+	(
+		-- log2 of the depth, in written words
+		DEPTH_LOG2	: NATURAL := 5
+	);
 	PORT
 	(
 		aclr		: IN STD_LOGIC  := '0';
@@ -51,10 +56,10 @@ ENTITY tx_meta_fifo IS
 		q		: OUT STD_LOGIC_VECTOR (127 DOWNTO 0);
 		rdempty		: OUT STD_LOGIC ;
 		rdfull		: OUT STD_LOGIC ;
-		rdusedw		: OUT STD_LOGIC_VECTOR (2 DOWNTO 0);
+		rdusedw		: OUT STD_LOGIC_VECTOR (DEPTH_LOG2-3 DOWNTO 0);
 		wrempty		: OUT STD_LOGIC ;
 		wrfull		: OUT STD_LOGIC ;
-		wrusedw		: OUT STD_LOGIC_VECTOR (4 DOWNTO 0)
+		wrusedw		: OUT STD_LOGIC_VECTOR (DEPTH_LOG2-1 DOWNTO 0)
 	);
 END tx_meta_fifo;
 
@@ -66,8 +71,8 @@ ARCHITECTURE SYN OF tx_meta_fifo IS
 	SIGNAL sub_wire2	: STD_LOGIC_VECTOR (127 DOWNTO 0);
 	SIGNAL sub_wire3	: STD_LOGIC ;
 	SIGNAL sub_wire4	: STD_LOGIC ;
-	SIGNAL sub_wire5	: STD_LOGIC_VECTOR (4 DOWNTO 0);
-	SIGNAL sub_wire6	: STD_LOGIC_VECTOR (2 DOWNTO 0);
+	SIGNAL sub_wire5	: STD_LOGIC_VECTOR (DEPTH_LOG2-1 DOWNTO 0);
+	SIGNAL sub_wire6	: STD_LOGIC_VECTOR (DEPTH_LOG2-3 DOWNTO 0);
 
 
 
@@ -97,11 +102,11 @@ ARCHITECTURE SYN OF tx_meta_fifo IS
 			rdempty	: OUT STD_LOGIC ;
 			rdfull	: OUT STD_LOGIC ;
 			wrreq	: IN STD_LOGIC ;
-			wrusedw	: OUT STD_LOGIC_VECTOR (4 DOWNTO 0);
+			wrusedw	: OUT STD_LOGIC_VECTOR (DEPTH_LOG2-1 DOWNTO 0);
 			aclr	: IN STD_LOGIC ;
 			data	: IN STD_LOGIC_VECTOR (31 DOWNTO 0);
 			rdreq	: IN STD_LOGIC ;
-			rdusedw	: OUT STD_LOGIC_VECTOR (2 DOWNTO 0);
+			rdusedw	: OUT STD_LOGIC_VECTOR (DEPTH_LOG2-3 DOWNTO 0);
 			wrclk	: IN STD_LOGIC 
 	);
 	END COMPONENT;
@@ -112,18 +117,18 @@ BEGIN
 	q    <= sub_wire2(127 DOWNTO 0);
 	rdempty    <= sub_wire3;
 	rdfull    <= sub_wire4;
-	wrusedw    <= sub_wire5(4 DOWNTO 0);
-	rdusedw    <= sub_wire6(2 DOWNTO 0);
+	wrusedw    <= sub_wire5(DEPTH_LOG2-1 DOWNTO 0);
+	rdusedw    <= sub_wire6(DEPTH_LOG2-3 DOWNTO 0);
 
 	dcfifo_mixed_widths_component : dcfifo_mixed_widths
 	GENERIC MAP (
 		intended_device_family => "Cyclone IV E",
-		lpm_numwords => 32,
+		lpm_numwords => 2**DEPTH_LOG2,
 		lpm_showahead => "ON",
 		lpm_type => "dcfifo_mixed_widths",
 		lpm_width => 32,
-		lpm_widthu => 5,
-		lpm_widthu_r => 3,
+		lpm_widthu => DEPTH_LOG2,
+		lpm_widthu_r => DEPTH_LOG2-2,
 		lpm_width_r => 128,
 		overflow_checking => "ON",
 		rdsync_delaypipe => 5,
@@ -0,0 +1,472 @@
+-- Copyright (c) 2014 Nuand LLC
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+
+library ieee ;
+    use ieee.std_logic_1164.all ;
+    use ieee.numeric_std.all ;
+    use ieee.math_real.all ;
+
+-- Critically sampled polyphase analysis filter bank.
+--
+-- The input band is split into CHANNELS equally spaced channels, each
+-- decimated by CHANNELS.  Channel k is centered on k/CHANNELS of the input
+-- sample rate, so the upper half of the channels hold the negative
+-- frequencies.  The prototype low pass filter is a Blackman windowed sinc
+-- with TAPS_PER_BRANCH taps per polyphase branch, generated at elaboration.
+--
+-- Rather than a full FFT, the DFT is only evaluated for the channels set in
+-- channel_mask, using one complex multiply-accumulate unit per channel.  At
+-- most MAX_SELECTED channels are produced; any further bits set in the mask
+-- are ignored.  The mask is sampled at the start of each block and should
+-- only be changed while the stream is stopped.
+--
+-- For every CHANNELS input samples, one sample of each selected channel is
+-- output on consecutive clocks, in ascending channel order.  out_channel
+-- identifies each output sample, and next_channel is the channel of the
+-- next sample that will be output.  Outputs are saturated to SAMPLE_WIDTH
+-- bits.
+--
+-- in_valid may be asserted at most once per clock.
+entity channelizer is
+  generic (
+    CHANNELS        :   positive    := 16 ;
+    TAPS_PER_BRANCH :   positive    := 8 ;
+    MAX_SELECTED    :   positive    := 8 ;
+    SAMPLE_WIDTH    :   positive    := 12
+  ) ;
+  port (
+    clock           :   in  std_logic ;
+    reset           :   in  std_logic ;
+
+    channel_mask    :   in  std_logic_vector(CHANNELS-1 downto 0) ;
+
+    in_i            :   in  signed(15 downto 0) ;
+    in_q            :   in  signed(15 downto 0) ;
+    in_valid        :   in  std_logic ;
+
+    out_i           :   out signed(15 downto 0) ;
+    out_q           :   out signed(15 downto 0) ;
+    out_channel     :   out natural range 0 to CHANNELS-1 ;
+    out_valid       :   out std_logic ;
+
+    next_channel    :   out natural range 0 to CHANNELS-1
+  ) ;
+end entity ;
+
+architecture arch of channelizer is
+
+    constant M : positive := CHANNELS ;
+    constant T : positive := TAPS_PER_BRANCH ;
+
+    function clog2( x : positive ) return natural is
+        variable rv : natural := 0 ;
+    begin
+        while 2**rv < x loop
+            rv := rv + 1 ;
+        end loop ;
+        return rv ;
+    end function ;
+
+    constant CHANNEL_BITS   : natural := clog2(M) ;
+
+    -- Prototype coefficients are scaled so the filter has unity DC gain
+    -- with 16 fractional bits to spare per channel
+    constant COEF_WIDTH     : positive := 18 ;
+    constant COEF_SHIFT     : natural  := 16 + CHANNEL_BITS ;
+
+    -- Twiddle factors represent 1.0 as 2**TWIDDLE_SHIFT
+    constant TWIDDLE_SHIFT  : natural  := 14 ;
+
+    -- Polyphase branch outputs
+    constant V_WIDTH        : positive := 18 ;
+
+    constant PROD_WIDTH     : positive := 16 + COEF_WIDTH ;
+    constant ACC_WIDTH      : positive := V_WIDTH + 16 + 1 + CHANNEL_BITS ;
+
+    type sample_array_t is array(natural range <>) of signed(15 downto 0) ;
+    type coef_array_t is array(natural range <>) of signed(COEF_WIDTH-1 downto 0) ;
+    type prod_array_t is array(natural range <>) of signed(PROD_WIDTH-1 downto 0) ;
+    type acc_array_t is array(natural range <>) of signed(ACC_WIDTH-1 downto 0) ;
+    type history_t is array(1 to T-1) of sample_array_t(0 to M-1) ;
+    type chan_array_t is array(0 to MAX_SELECTED-1) of natural range 0 to M-1 ;
+
+    function prototype return coef_array_t is
+        constant L  : positive := M*T ;
+        variable h  : real ;
+        variable x  : real ;
+        variable sum : real := 0.0 ;
+        variable rv : coef_array_t(0 to L-1) ;
+    begin
+        for pass in 0 to 1 loop
+            for n in 0 to L-1 loop
+                x := (real(n) - real(L-1)/2.0) / real(M) ;
+                if( x = 0.0 ) then
+                    h := 1.0 ;
+                else
+                    h := sin(MATH_PI*x) / (MATH_PI*x) ;
+                end if ;
+                h := h * (0.42 - 0.5*cos(2.0*MATH_PI*real(n)/real(L-1))
+                                + 0.08*cos(4.0*MATH_PI*real(n)/real(L-1))) ;
+                if( pass = 0 ) then
+                    sum := sum + h ;
+                else
+                    rv(n) := to_signed(integer(round(h/sum * 2.0**COEF_SHIFT)), COEF_WIDTH) ;
+                end if ;
+            end loop ;
+        end loop ;
+        return rv ;
+    end function ;
+
+    function twiddles( imag : boolean ) return sample_array_t is
+        variable rv : sample_array_t(0 to M-1) ;
+        variable w  : real ;
+    begin
+        for i in 0 to M-1 loop
+            if( imag ) then
+                w := sin(2.0*MATH_PI*real(i)/real(M)) ;
+            else
+                w := cos(2.0*MATH_PI*real(i)/real(M)) ;
+            end if ;
+            rv(i) := to_signed(integer(round(w * 2.0**TWIDDLE_SHIFT)), 16) ;
+        end loop ;
+        return rv ;
+    end function ;
+
+    function saturate( x : signed ; bits : positive ) return signed is
+        constant MAX : signed(x'range) := to_signed(2**(bits-1)-1, x'length) ;
+        constant MIN : signed(x'range) := to_signed(-(2**(bits-1)), x'length) ;
+    begin
+        if( x > MAX ) then
+            return MAX ;
+        elsif( x < MIN ) then
+            return MIN ;
+        else
+            return x ;
+        end if ;
+    end function ;
+
+    constant H          :   coef_array_t(0 to M*T-1) := prototype ;
+    constant TWIDDLE_RE :   sample_array_t(0 to M-1) := twiddles(false) ;
+    constant TWIDDLE_IM :   sample_array_t(0 to M-1) := twiddles(true) ;
+
+    -- Input blocks
+    signal fill         :   natural range 0 to M-1 ;
+    signal block_i      :   sample_array_t(0 to M-1) ;
+    signal block_q      :   sample_array_t(0 to M-1) ;
+    signal work_i       :   sample_array_t(0 to M-1) ;
+    signal work_q       :   sample_array_t(0 to M-1) ;
+    signal block_ready  :   std_logic ;
+
+    -- Polyphase filter state
+    signal history_i    :   history_t ;
+    signal history_q    :   history_t ;
+    signal running      :   std_logic ;
+    signal branch       :   natural range 0 to M-1 ;
+
+    signal sel_chan     :   chan_array_t ;
+    signal sel_count    :   natural range 0 to MAX_SELECTED ;
+
+    signal taps_i       :   sample_array_t(0 to T-1) ;
+    signal taps_q       :   sample_array_t(0 to T-1) ;
+    signal coefs        :   coef_array_t(0 to T-1) ;
+    signal prods_i      :   prod_array_t(0 to T-1) ;
+    signal prods_q      :   prod_array_t(0 to T-1) ;
+    signal v_i          :   signed(V_WIDTH-1 downto 0) ;
+    signal v_q          :   signed(V_WIDTH-1 downto 0) ;
+
+    -- DFT state
+    type twiddle_idx_t is array(0 to MAX_SELECTED-1) of natural range 0 to M-1 ;
+    signal tw_idx_a     :   twiddle_idx_t ;
+    signal tw_idx_b     :   twiddle_idx_t ;
+    signal tw_idx_c     :   twiddle_idx_t ;
+    signal w_re         :   sample_array_t(0 to MAX_SELECTED-1) ;
+    signal w_im         :   sample_array_t(0 to MAX_SELECTED-1) ;
+    signal v_i_d        :   signed(V_WIDTH-1 downto 0) ;
+    signal v_q_d        :   signed(V_WIDTH-1 downto 0) ;
+    signal rot_re       :   acc_array_t(0 to MAX_SELECTED-1) ;
+    signal rot_im       :   acc_array_t(0 to MAX_SELECTED-1) ;
+    signal acc_re       :   acc_array_t(0 to MAX_SELECTED-1) ;
+    signal acc_im       :   acc_array_t(0 to MAX_SELECTED-1) ;
+
+    -- Pipeline qualifiers: valid, first branch and last branch of a block
+    signal valid_pipe   :   std_logic_vector(0 to 5) ;
+    signal first_pipe   :   std_logic_vector(0 to 5) ;
+    signal last_pipe    :   std_logic_vector(0 to 5) ;
+
+    -- Channel selection in effect for the block leaving the pipeline
+    signal pass_chan    :   chan_array_t ;
+    signal pass_count   :   natural range 0 to MAX_SELECTED ;
+
+    -- Output
+    signal res_i        :   sample_array_t(0 to MAX_SELECTED-1) ;
+    signal res_q        :   sample_array_t(0 to MAX_SELECTED-1) ;
+    signal res_chan     :   chan_array_t ;
+    signal res_count    :   natural range 0 to MAX_SELECTED ;
+    signal emit         :   natural range 0 to MAX_SELECTED ;
+
+begin
+
+    assert M = 2**CHANNEL_BITS
+        report "CHANNELS must be a power of two"
+        severity failure ;
+
+    -- The pipeline drains before the next block's results are latched
+    assert M > valid_pipe'length + 2 and MAX_SELECTED <= M and T > 1
+        report "Unsupported channelizer configuration"
+        severity failure ;
+
+    -- Collect M input samples, double buffered so the next block can fill
+    -- while the current one is filtered
+    collect : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            fill <= 0 ;
+            block_i <= (others =>(others =>'0')) ;
+            block_q <= (others =>(others =>'0')) ;
+            work_i <= (others =>(others =>'0')) ;
+            work_q <= (others =>(others =>'0')) ;
+            block_ready <= '0' ;
+        elsif( rising_edge(clock) ) then
+            block_ready <= '0' ;
+            if( in_valid = '1' ) then
+                block_i(fill) <= in_i ;
+                block_q(fill) <= in_q ;
+                if( fill = M-1 ) then
+                    fill <= 0 ;
+                    work_i <= block_i(0 to M-2) & in_i ;
+                    work_q <= block_q(0 to M-2) & in_q ;
+                    block_ready <= '1' ;
+                else
+                    fill <= fill + 1 ;
+                end if ;
+            end if ;
+        end if ;
+    end process ;
+
+    -- Step through the polyphase branches, one per clock, starting as soon
+    -- as a block is ready.  Branch p is fed the newest samples first, and
+    -- its history shifts by one block.
+    polyphase : process(clock, reset)
+        variable taps_i_v : sample_array_t(0 to T-1) ;
+        variable taps_q_v : sample_array_t(0 to T-1) ;
+        variable chans    : chan_array_t ;
+        variable n        : natural range 0 to MAX_SELECTED ;
+        variable b        : natural range 0 to M-1 ;
+    begin
+        if( reset = '1' ) then
+            history_i <= (others =>(others =>(others =>'0'))) ;
+            history_q <= (others =>(others =>(others =>'0'))) ;
+            running <= '0' ;
+            branch <= 0 ;
+            sel_chan <= (others =>0) ;
+            sel_count <= 0 ;
+            pass_chan <= (others =>0) ;
+            pass_count <= 0 ;
+            taps_i <= (others =>(others =>'0')) ;
+            taps_q <= (others =>(others =>'0')) ;
+            coefs <= (others =>(others =>'0')) ;
+            tw_idx_a <= (others =>0) ;
+            valid_pipe(0) <= '0' ;
+            first_pipe(0) <= '0' ;
+            last_pipe(0) <= '0' ;
+        elsif( rising_edge(clock) ) then
+            valid_pipe(0) <= '0' ;
+            first_pipe(0) <= '0' ;
+            last_pipe(0) <= '0' ;
+
+            if( block_ready = '1' ) then
+                n := 0 ;
+                chans := (others =>0) ;
+                for c in 0 to M-1 loop
+                    if( channel_mask(c) = '1' and n < MAX_SELECTED ) then
+                        chans(n) := c ;
+                        n := n + 1 ;
+                    end if ;
+                end loop ;
+                sel_chan <= chans ;
+                sel_count <= n ;
+                b := 0 ;
+            else
+                chans := sel_chan ;
+                n := sel_count ;
+                b := branch ;
+            end if ;
+
+            if( block_ready = '1' or running = '1' ) then
+                taps_i_v(0) := work_i(M-1-b) ;
+                taps_q_v(0) := work_q(M-1-b) ;
+                for t in 1 to T-1 loop
+                    taps_i_v(t) := history_i(t)(b) ;
+                    taps_q_v(t) := history_q(t)(b) ;
+                end loop ;
+
+                for t in 0 to T-1 loop
+                    taps_i(t) <= taps_i_v(t) ;
+                    taps_q(t) <= taps_q_v(t) ;
+                    coefs(t) <= H(t*M + b) ;
+                end loop ;
+
+                for t in 1 to T-1 loop
+                    history_i(t)(b) <= taps_i_v(t-1) ;
+                    history_q(t)(b) <= taps_q_v(t-1) ;
+                end loop ;
+
+                for u in 0 to MAX_SELECTED-1 loop
+                    tw_idx_a(u) <= (chans(u) * b) mod M ;
+                end loop ;
+
+                valid_pipe(0) <= '1' ;
+                if( b = 0 ) then
+                    first_pipe(0) <= '1' ;
+                end if ;
+
+                if( b = M-1 ) then
+                    last_pipe(0) <= '1' ;
+                    pass_chan <= chans ;
+                    pass_count <= n ;
+                    running <= '0' ;
+                    branch <= 0 ;
+                else
+                    running <= '1' ;
+                    branch <= b + 1 ;
+                end if ;
+            end if ;
+        end if ;
+    end process ;
+
+    -- Branch filter: multiply, then sum and remove the coefficient scaling
+    branch_filter : process(clock, reset)
+        variable sum_i : signed(PROD_WIDTH+clog2(T)-1 downto 0) ;
+        variable sum_q : signed(PROD_WIDTH+clog2(T)-1 downto 0) ;
+    begin
+        if( reset = '1' ) then
+            prods_i <= (others =>(others =>'0')) ;
+            prods_q <= (others =>(others =>'0')) ;
+            tw_idx_b <= (others =>0) ;
+            v_i <= (others =>'0') ;
+            v_q <= (others =>'0') ;
+            tw_idx_c <= (others =>0) ;
+        elsif( rising_edge(clock) ) then
+            for t in 0 to T-1 loop
+                prods_i(t) <= taps_i(t) * coefs(t) ;
+                prods_q(t) <= taps_q(t) * coefs(t) ;
+            end loop ;
+            tw_idx_b <= tw_idx_a ;
+
+            sum_i := (others =>'0') ;
+            sum_q := (others =>'0') ;
+            for t in 0 to T-1 loop
+                sum_i := sum_i + prods_i(t) ;
+                sum_q := sum_q + prods_q(t) ;
+            end loop ;
+            v_i <= resize(shift_right(sum_i, COEF_SHIFT), V_WIDTH) ;
+            v_q <= resize(shift_right(sum_q, COEF_SHIFT), V_WIDTH) ;
+            tw_idx_c <= tw_idx_b ;
+        end if ;
+    end process ;
+
+    -- One complex multiply-accumulate per selected channel
+    dft : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            w_re <= (others =>(others =>'0')) ;
+            w_im <= (others =>(others =>'0')) ;
+            v_i_d <= (others =>'0') ;
+            v_q_d <= (others =>'0') ;
+            rot_re <= (others =>(others =>'0')) ;
+            rot_im <= (others =>(others =>'0')) ;
+            acc_re <= (others =>(others =>'0')) ;
+            acc_im <= (others =>(others =>'0')) ;
+        elsif( rising_edge(clock) ) then
+            v_i_d <= v_i ;
+            v_q_d <= v_q ;
+            for u in 0 to MAX_SELECTED-1 loop
+                w_re(u) <= TWIDDLE_RE(tw_idx_c(u)) ;
+                w_im(u) <= TWIDDLE_IM(tw_idx_c(u)) ;
+
+                rot_re(u) <= resize(v_i_d * w_re(u), ACC_WIDTH) - resize(v_q_d * w_im(u), ACC_WIDTH) ;
+                rot_im(u) <= resize(v_i_d * w_im(u), ACC_WIDTH) + resize(v_q_d * w_re(u), ACC_WIDTH) ;
+
+                if( first_pipe(4) = '1' ) then
+                    acc_re(u) <= rot_re(u) ;
+                    acc_im(u) <= rot_im(u) ;
+                elsif( valid_pipe(4) = '1' ) then
+                    acc_re(u) <= acc_re(u) + rot_re(u) ;
+                    acc_im(u) <= acc_im(u) + rot_im(u) ;
+                end if ;
+            end loop ;
+        end if ;
+    end process ;
+
+    -- Stage 0 is registered by the polyphase process.  Stage n lines up
+    -- with the data registered n clocks later: taps, products, branch
+    -- outputs, twiddles, rotations, then the accumulators.
+    qualify : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            valid_pipe(1 to valid_pipe'high) <= (others =>'0') ;
+            first_pipe(1 to first_pipe'high) <= (others =>'0') ;
+            last_pipe(1 to last_pipe'high) <= (others =>'0') ;
+        elsif( rising_edge(clock) ) then
+            valid_pipe(1 to valid_pipe'high) <= valid_pipe(0 to valid_pipe'high-1) ;
+            first_pipe(1 to first_pipe'high) <= first_pipe(0 to first_pipe'high-1) ;
+            last_pipe(1 to last_pipe'high) <= last_pipe(0 to last_pipe'high-1) ;
+        end if ;
+    end process ;
+
+    -- Latch the finished channel samples and send them out one per clock
+    output : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            res_i <= (others =>(others =>'0')) ;
+            res_q <= (others =>(others =>'0')) ;
+            res_chan <= (others =>0) ;
+            res_count <= 0 ;
+            emit <= 0 ;
+            out_i <= (others =>'0') ;
+            out_q <= (others =>'0') ;
+            out_channel <= 0 ;
+            out_valid <= '0' ;
+        elsif( rising_edge(clock) ) then
+            out_valid <= '0' ;
+
+            -- The accumulators include the last branch once its qualifier
+            -- reaches the end of the pipeline
+            if( last_pipe(5) = '1' ) then
+                for u in 0 to MAX_SELECTED-1 loop
+                    res_i(u) <= resize(saturate(shift_right(acc_re(u), TWIDDLE_SHIFT), SAMPLE_WIDTH), 16) ;
+                    res_q(u) <= resize(saturate(shift_right(acc_im(u), TWIDDLE_SHIFT), SAMPLE_WIDTH), 16) ;
+                end loop ;
+                res_chan <= pass_chan ;
+                res_count <= pass_count ;
+                emit <= 0 ;
+            elsif( emit < res_count ) then
+                out_i <= res_i(emit) ;
+                out_q <= res_q(emit) ;
+                out_channel <= res_chan(emit) ;
+                out_valid <= '1' ;
+                emit <= emit + 1 ;
+            end if ;
+        end if ;
+    end process ;
+
+    next_channel <= res_chan(emit) when emit < res_count else sel_chan(0) ;
+
+end architecture ;
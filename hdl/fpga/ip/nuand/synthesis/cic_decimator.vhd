@@ -0,0 +1,115 @@
+-- Copyright (c) 2014 Nuand LLC
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+
+library ieee ;
+    use ieee.std_logic_1164.all ;
+    use ieee.numeric_std.all ;
+
+-- Cascaded integrator-comb decimator with a runtime selectable decimation
+-- factor of 2**rate_log2.
+--
+-- The integrators and combs are pipelined, one register per stage, and use
+-- wrapping arithmetic.  The STAGES*rate_log2 bits of CIC gain are removed
+-- before the output, so the DC gain is exactly 1.
+entity cic_decimator is
+  generic (
+    INPUT_WIDTH     :   positive    := 16 ;
+    OUTPUT_WIDTH    :   positive    := 16 ;
+    STAGES          :   positive    := 3 ;
+    MAX_RATE_LOG2   :   positive    := 7
+  ) ;
+  port (
+    clock           :   in  std_logic ;
+    reset           :   in  std_logic ;
+
+    rate_log2       :   in  natural range 0 to MAX_RATE_LOG2 ;
+
+    in_sample       :   in  signed(INPUT_WIDTH-1 downto 0) ;
+    in_valid        :   in  std_logic ;
+
+    out_sample      :   out signed(OUTPUT_WIDTH-1 downto 0) ;
+    out_valid       :   out std_logic
+  ) ;
+end entity ;
+
+architecture arch of cic_decimator is
+
+    constant ACCUM_WIDTH : positive := INPUT_WIDTH + STAGES*MAX_RATE_LOG2 ;
+
+    type accum_array_t is array(natural range <>) of signed(ACCUM_WIDTH-1 downto 0) ;
+
+    signal integrators  :   accum_array_t(0 to STAGES) ;
+    signal combs        :   accum_array_t(0 to STAGES) ;
+    signal delays       :   accum_array_t(1 to STAGES) ;
+
+    signal count        :   unsigned(MAX_RATE_LOG2-1 downto 0) ;
+    signal comb_valid   :   std_logic ;
+
+begin
+
+    integrate : process(clock, reset)
+        variable mask : unsigned(count'range) ;
+    begin
+        if( reset = '1' ) then
+            integrators <= (others =>(others =>'0')) ;
+            count <= (others =>'0') ;
+            comb_valid <= '0' ;
+        elsif( rising_edge(clock) ) then
+            comb_valid <= '0' ;
+            if( in_valid = '1' ) then
+                integrators(0) <= resize(in_sample, ACCUM_WIDTH) ;
+                for i in 1 to STAGES loop
+                    integrators(i) <= integrators(i) + integrators(i-1) ;
+                end loop ;
+
+                -- Pass every 2**rate_log2'th integrator output to the combs
+                mask := shift_left(to_unsigned(1, mask'length), rate_log2) - 1 ;
+                if( (count and mask) = mask ) then
+                    count <= (others =>'0') ;
+                    comb_valid <= '1' ;
+                else
+                    count <= count + 1 ;
+                end if ;
+            end if ;
+        end if ;
+    end process ;
+
+    comb : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            combs <= (others =>(others =>'0')) ;
+            delays <= (others =>(others =>'0')) ;
+            out_valid <= '0' ;
+        elsif( rising_edge(clock) ) then
+            out_valid <= '0' ;
+            if( comb_valid = '1' ) then
+                combs(0) <= integrators(STAGES) ;
+                for i in 1 to STAGES loop
+                    combs(i) <= combs(i-1) - delays(i) ;
+                    delays(i) <= combs(i-1) ;
+                end loop ;
+                out_valid <= '1' ;
+            end if ;
+        end if ;
+    end process ;
+
+    out_sample <= resize(shift_right(combs(STAGES), STAGES*rate_log2), OUTPUT_WIDTH) ;
+
+end architecture ;
@@ -0,0 +1,127 @@
+-- Copyright (c) 2014 Nuand LLC
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+
+library ieee ;
+    use ieee.std_logic_1164.all ;
+    use ieee.numeric_std.all ;
+
+-- Cascaded integrator-comb interpolator with a runtime selectable
+-- interpolation factor of 2**rate_log2.
+--
+-- The caller paces both rates: in_load moves the most recent input sample
+-- into the combs, and each out_strobe produces one output sample.  There
+-- must be 2**rate_log2 out_strobe pulses per in_load.  If no sample arrived
+-- since the last in_load, a zero is used instead.
+--
+-- The (STAGES-1)*rate_log2 bits of CIC gain are removed before the output,
+-- so the DC gain is exactly 1.
+entity cic_interpolator is
+  generic (
+    INPUT_WIDTH     :   positive    := 16 ;
+    OUTPUT_WIDTH    :   positive    := 16 ;
+    STAGES          :   positive    := 3 ;
+    MAX_RATE_LOG2   :   positive    := 7
+  ) ;
+  port (
+    clock           :   in  std_logic ;
+    reset           :   in  std_logic ;
+
+    rate_log2       :   in  natural range 0 to MAX_RATE_LOG2 ;
+
+    in_sample       :   in  signed(INPUT_WIDTH-1 downto 0) ;
+    in_valid        :   in  std_logic ;
+    in_load         :   in  std_logic ;
+
+    out_strobe      :   in  std_logic ;
+    out_sample      :   out signed(OUTPUT_WIDTH-1 downto 0) ;
+    out_valid       :   out std_logic
+  ) ;
+end entity ;
+
+architecture arch of cic_interpolator is
+
+    constant ACCUM_WIDTH : positive := INPUT_WIDTH + STAGES*MAX_RATE_LOG2 ;
+
+    type accum_array_t is array(natural range <>) of signed(ACCUM_WIDTH-1 downto 0) ;
+
+    signal pending      :   signed(INPUT_WIDTH-1 downto 0) ;
+    signal combs        :   accum_array_t(0 to STAGES) ;
+    signal delays       :   accum_array_t(1 to STAGES) ;
+    signal integrators  :   accum_array_t(0 to STAGES) ;
+    signal stuffed      :   std_logic ;
+
+begin
+
+    comb : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            pending <= (others =>'0') ;
+            combs <= (others =>(others =>'0')) ;
+            delays <= (others =>(others =>'0')) ;
+        elsif( rising_edge(clock) ) then
+            if( in_valid = '1' ) then
+                pending <= in_sample ;
+            end if ;
+
+            if( in_load = '1' ) then
+                -- Underflows are sent as zeroes
+                pending <= (others =>'0') ;
+                combs(0) <= resize(pending, ACCUM_WIDTH) ;
+                for i in 1 to STAGES loop
+                    combs(i) <= combs(i-1) - delays(i) ;
+                    delays(i) <= combs(i-1) ;
+                end loop ;
+            end if ;
+        end if ;
+    end process ;
+
+    integrate : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            integrators <= (others =>(others =>'0')) ;
+            stuffed <= '0' ;
+            out_valid <= '0' ;
+        elsif( rising_edge(clock) ) then
+            out_valid <= '0' ;
+
+            if( out_strobe = '1' ) then
+                -- Zero stuff between comb outputs
+                if( stuffed = '0' ) then
+                    integrators(0) <= combs(STAGES) ;
+                else
+                    integrators(0) <= (others =>'0') ;
+                end if ;
+                stuffed <= '1' ;
+
+                for i in 1 to STAGES loop
+                    integrators(i) <= integrators(i) + integrators(i-1) ;
+                end loop ;
+                out_valid <= '1' ;
+            end if ;
+
+            if( in_load = '1' ) then
+                stuffed <= '0' ;
+            end if ;
+        end if ;
+    end process ;
+
+    out_sample <= resize(shift_right(integrators(STAGES), (STAGES-1)*rate_log2), OUTPUT_WIDTH) ;
+
+end architecture ;
@@ -157,17 +157,31 @@ architecture arch of constellation_mapper is
         return rv ;
     end function ;
 
+    -- Point on the unit circle at angle theta, scaled by SCALE_FACTOR
+    function polar( theta : real ) return complex_fixed_t is
+    begin
+        return (to_signed(integer(round(cos(theta) * SCALE_FACTOR)),16),
+                to_signed(integer(round(sin(theta) * SCALE_FACTOR)),16)) ;
+    end function ;
+
     -- BPSK Modulation Points
     function constellation_psk_2 return complex_fixed_array_t is
         variable rv : complex_fixed_array_t(0 to 1) := (others =>(to_signed(0,16),to_signed(0,16))) ;
     begin
+        rv(0) := polar(0.0) ;
+        rv(1) := polar(MATH_PI) ;
         return rv ;
     end function ;
 
-    -- QPSK Modulation Points
+    -- QPSK Modulation Points, Gray coded with bit 0 selecting the sign of I
+    -- and bit 1 the sign of Q
     function constellation_psk_4 return complex_fixed_array_t is
         variable rv : complex_fixed_array_t(0 to 3) := (others =>(to_signed(0,16),to_signed(0,16))) ;
     begin
+        rv(0) := polar(MATH_PI/4.0) ;
+        rv(1) := polar(3.0*MATH_PI/4.0) ;
+        rv(2) := polar(-MATH_PI/4.0) ;
+        rv(3) := polar(-3.0*MATH_PI/4.0) ;
         return rv ;
     end function ;
 
@@ -175,13 +189,22 @@ architecture arch of constellation_mapper is
     function constellation_psk_8 return complex_fixed_array_t is
         variable rv : complex_fixed_array_t(0 to 7) := (others =>(to_signed(0,16),to_signed(0,16))) ;
     begin
+        for i in rv'range loop
+            rv(i) := polar(real(i)*MATH_PI/4.0) ;
+        end loop ;
         return rv ;
     end function ;
 
-    -- 8-PSK Offset Modulation Points
+    -- 8-PSK Modulation Points, Gray coded such that neighbouring points differ
+    -- by one bit
     function constellation_psk_8_gray return complex_fixed_array_t is
         variable rv : complex_fixed_array_t(0 to 7) := (others =>(to_signed(0,16),to_signed(0,16))) ;
+        variable gray : natural ;
     begin
+        for i in rv'range loop
+            gray := to_integer(to_unsigned(i,3) xor shift_right(to_unsigned(i,3),1)) ;
+            rv(gray) := polar(real(i)*MATH_PI/4.0) ;
+        end loop ;
         return rv ;
     end function ;
 
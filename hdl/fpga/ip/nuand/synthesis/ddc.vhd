@@ -0,0 +1,120 @@
+-- Copyright (c) 2014 Nuand LLC
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+
+library ieee ;
+    use ieee.std_logic_1164.all ;
+    use ieee.numeric_std.all ;
+
+library work ;
+    use work.cordic_p.all ;
+
+-- Digital down-converter which shifts the input spectrum by dphase/2**32
+-- of the sample rate.  The mixer is a CORDIC in rotation mode, driven by a
+-- 32-bit phase accumulator, so no multipliers are used for the mixing.
+--
+-- A dphase of 0 bypasses the DDC entirely.
+entity ddc is
+  port (
+    clock           :   in  std_logic ;
+    reset           :   in  std_logic ;
+
+    -- Two's complement phase increment per sample, where 2**32 is one turn
+    dphase          :   in  signed(31 downto 0) ;
+
+    in_i            :   in  signed(15 downto 0) ;
+    in_q            :   in  signed(15 downto 0) ;
+    in_valid        :   in  std_logic ;
+
+    out_i           :   out signed(15 downto 0) ;
+    out_q           :   out signed(15 downto 0) ;
+    out_valid       :   out std_logic
+  ) ;
+end entity ;
+
+architecture arch of ddc is
+
+    -- The CORDIC represents pi as 2**12
+    constant CORDIC_PHASE_BITS : positive := 13 ;
+
+    -- Headroom gained by scaling 12-bit samples up before the CORDIC
+    constant INPUT_SHIFT : natural := 2 ;
+
+    -- Reciprocal of the 12 stage CORDIC gain, 1.64676, in Q15
+    constant CORDIC_GAIN_INV : signed(15 downto 0) := to_signed(19898, 16) ;
+
+    signal phase            :   signed(31 downto 0) ;
+
+    signal cordic_inputs    :   cordic_xyz_t ;
+    signal cordic_outputs   :   cordic_xyz_t ;
+
+    signal scaled_i         :   signed(15 downto 0) ;
+    signal scaled_q         :   signed(15 downto 0) ;
+    signal scaled_valid     :   std_logic ;
+
+begin
+
+    accumulate_phase : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            phase <= (others =>'0') ;
+        elsif( rising_edge(clock) ) then
+            if( in_valid = '1' ) then
+                phase <= phase + dphase ;
+            end if ;
+        end if ;
+    end process ;
+
+    cordic_inputs <= (
+        x       =>  shift_left(in_i, INPUT_SHIFT),
+        y       =>  shift_left(in_q, INPUT_SHIFT),
+        z       =>  resize(phase(31 downto 32-CORDIC_PHASE_BITS), 16),
+        valid   =>  in_valid
+    ) ;
+
+    U_cordic : entity work.cordic
+      port map (
+        clock   =>  clock,
+        reset   =>  reset,
+        mode    =>  CORDIC_ROTATION,
+        inputs  =>  cordic_inputs,
+        outputs =>  cordic_outputs
+      ) ;
+
+    -- Remove the CORDIC gain and the input scaling
+    scale : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            scaled_i <= (others =>'0') ;
+            scaled_q <= (others =>'0') ;
+            scaled_valid <= '0' ;
+        elsif( rising_edge(clock) ) then
+            scaled_valid <= cordic_outputs.valid ;
+            if( cordic_outputs.valid = '1' ) then
+                scaled_i <= resize(shift_right(cordic_outputs.x * CORDIC_GAIN_INV, 15+INPUT_SHIFT), 16) ;
+                scaled_q <= resize(shift_right(cordic_outputs.y * CORDIC_GAIN_INV, 15+INPUT_SHIFT), 16) ;
+            end if ;
+        end if ;
+    end process ;
+
+    out_i     <= in_i when dphase = 0 else scaled_i ;
+    out_q     <= in_q when dphase = 0 else scaled_q ;
+    out_valid <= in_valid when dphase = 0 else scaled_valid ;
+
+end architecture ;
@@ -3,6 +3,10 @@ library ieee ;
     use ieee.numeric_std.all ;
 
 entity fifo_reader is
+  generic (
+    -- Waveform memory holds 2**WAVE_ADDR_WIDTH SC16 Q11 samples
+    WAVE_ADDR_WIDTH     :   positive := 12
+  ) ;
   port (
     clock               :   in      std_logic ;
     reset               :   in      std_logic ;
@@ -12,12 +16,23 @@ entity fifo_reader is
     meta_en             :   in      std_logic ;
     timestamp           :   in      unsigned(63 downto 0);
 
-    fifo_usedw          :   in      std_logic_vector(11 downto 0);
+    -- Held low to pace reads for a downstream interpolator
+    read_enable         :   in      std_logic := '1' ;
+
+    -- Unpack groups of 3 words into 4 samples, 12 bits per component.  This
+    -- may not be combined with meta_en.
+    pack_en             :   in      std_logic := '0' ;
+
+    -- Expand 8-bit samples, 2 per word, multiplying them by 2**sc8_shift
+    sc8_en              :   in      std_logic := '0' ;
+    sc8_shift           :   in      unsigned(3 downto 0) := x"4" ;
+
+    fifo_usedw          :   in      std_logic_vector ;
     fifo_read           :   buffer  std_logic ;
     fifo_empty          :   in      std_logic ;
     fifo_data           :   in      std_logic_vector(31 downto 0) ;
 
-    meta_fifo_usedw     :   in      std_logic_vector(2 downto 0);
+    meta_fifo_usedw     :   in      std_logic_vector ;
     meta_fifo_read      :   buffer  std_logic ;
     meta_fifo_empty     :   in      std_logic ;
     meta_fifo_data      :   in      std_logic_vector(127 downto 0) ;
@@ -28,7 +43,17 @@ entity fifo_reader is
 
     underflow_led       :   buffer  std_logic ;
     underflow_count     :   buffer  unsigned(63 downto 0) ;
-    underflow_duration  :   in      unsigned(15 downto 0)
+    underflow_duration  :   in      unsigned(15 downto 0) ;
+
+    -- Lowest FIFO fill level, in words, since samples first arrived after
+    -- enable was last raised.  All ones until then.
+    fifo_low_water      :   buffer  unsigned(15 downto 0) ;
+
+    -- Timed messages whose time had passed when they were loaded, and the
+    -- largest lateness among them in samples, since enable was last raised.
+    -- Both saturate.
+    late_count          :   buffer  unsigned(15 downto 0) ;
+    late_max            :   buffer  unsigned(15 downto 0)
   ) ;
 end entity ;
 
@@ -40,8 +65,76 @@ architecture simple of fifo_reader is
     signal meta_time_hit        :   signed(15 downto 0) ;
     signal meta_p_time          :   unsigned(63 downto 0);
     signal meta_p_sec           :   unsigned(31 downto 0);
+    signal meta_p_gated         :   std_logic;
+    signal meta_p_words         :   unsigned(15 downto 0);
+    signal meta_p_drop_late     :   std_logic;
+    signal meta_p_play          :   std_logic;
+    signal meta_p_load          :   std_logic;
+    signal meta_p_id            :   natural range 0 to 15;
     signal meta_loaded          :   std_logic;
+    signal meta_full_words      :   natural range 0 to 508 ;
+    signal meta_words           :   natural range 0 to 508 ;
+    signal meta_msg_words       :   natural range 0 to 508 ;
+
+    -- Waveforms are loaded into block RAM by load messages, whose words are
+    -- written to memory rather than transmitted, and are transmitted by play
+    -- messages in place of the message's own words
+    type wave_ram_t is array(0 to 2**WAVE_ADDR_WIDTH-1) of std_logic_vector(31 downto 0) ;
+    type wave_table_t is array(0 to 15) of unsigned(15 downto 0) ;
+
+    signal wave_ram             :   wave_ram_t ;
+    signal wave_base            :   wave_table_t ;
+    signal wave_len             :   wave_table_t ;
+    signal wave_q               :   std_logic_vector(31 downto 0) ;
+
+    signal load_start           :   std_logic ;
+    signal load_count           :   unsigned(8 downto 0) ;
+    signal load_addr            :   unsigned(WAVE_ADDR_WIDTH-1 downto 0) ;
+    signal load_read            :   std_logic ;
+    signal load_read_q          :   std_logic ;
+
+    signal play_start           :   std_logic ;
+    signal play_pending         :   std_logic ;
+    signal play_count           :   unsigned(15 downto 0) ;
+    signal play_addr            :   unsigned(WAVE_ADDR_WIDTH-1 downto 0) ;
+    signal play_read            :   std_logic ;
+    signal play_read_q          :   std_logic ;
+
+    -- A late message marked to be dropped has its words read out of the FIFO
+    -- and discarded, while zeroes are sent in its place
+    signal meta_late            :   std_logic ;
+    signal meta_drop            :   std_logic ;
+    signal drain_count          :   unsigned(8 downto 0) ;
+    signal drain_read           :   std_logic ;
 
+    signal enable_q             :   std_logic ;
+    signal low_water_armed      :   std_logic ;
+
+    signal sample_read          :   std_logic ;
+    signal sample_read_q        :   std_logic ;
+    signal blank_read           :   std_logic ;
+    signal blank_read_q         :   std_logic ;
+    signal pack_slot            :   unsigned(1 downto 0) ;
+    signal pack_slot_q          :   unsigned(1 downto 0) ;
+    signal pack_prev            :   std_logic_vector(31 downto 0) ;
+    signal pack_sample          :   std_logic_vector(23 downto 0) ;
+    signal pack_hold            :   std_logic ;
+    signal pack_hold_q          :   std_logic ;
+    signal sc8_sample           :   std_logic_vector(15 downto 0) ;
+
+    -- Scale an 8-bit component up by 2**shift, saturated to 12 bits
+    function expand( x : std_logic_vector(7 downto 0) ; shift : natural ) return signed is
+        variable t : signed(23 downto 0) ;
+    begin
+        t := shift_left(resize(signed(x), t'length), shift) ;
+        if( t > 2047 ) then
+            return to_signed(2047, 16) ;
+        elsif( t < -2048 ) then
+            return to_signed(-2048, 16) ;
+        else
+            return resize(t, 16) ;
+        end if ;
+    end function ;
 
 begin
 
@@ -50,12 +143,24 @@ begin
         if (reset = '1') then
             meta_loaded   <= '0';
             meta_p_time <= (others => '0');
+            meta_p_gated <= '0';
+            meta_p_words <= (others => '0');
+            meta_p_drop_late <= '0';
+            meta_p_play <= '0';
+            meta_p_load <= '0';
+            meta_p_id <= 0;
             meta_fifo_read <= '0' ;
         elsif( rising_edge(clock) ) then
             meta_fifo_read <= '0';
             if( meta_loaded = '0' ) then
                 if( meta_fifo_empty = '0' ) then
                     meta_p_time <= unsigned(meta_fifo_data(95 downto 32));
+                    meta_p_gated <= meta_fifo_data(31);
+                    meta_p_words <= unsigned(meta_fifo_data(15 downto 0));
+                    meta_p_drop_late <= meta_fifo_data(30);
+                    meta_p_play <= meta_fifo_data(29);
+                    meta_p_load <= meta_fifo_data(28);
+                    meta_p_id <= to_integer(unsigned(meta_fifo_data(19 downto 16)));
                     meta_loaded <= '1';
                     meta_fifo_read <= '1';
                 end if;
@@ -66,49 +171,255 @@ begin
             end if;
         end if;
     end process;
-    meta_time_eq <= '1' when (enable = '1' and meta_loaded = '1' and ((meta_p_time = 0 and meta_time_hit = 0) or (timestamp >= meta_p_time and meta_p_time /= 0))) else '0';
+    -- A load message's timestamp field holds its addresses, and it is
+    -- started as soon as the preceding message has played out
+    meta_time_eq <= '1' when (enable = '1' and meta_loaded = '1' and drain_count = 0 and load_count = 0 and
+                              ((meta_p_load = '1' and meta_time_hit = 0) or
+                               (meta_p_load = '0' and ((meta_p_time = 0 and meta_time_hit = 0) or (timestamp >= meta_p_time and meta_p_time /= 0))))) else '0';
+    meta_late <= '1' when (meta_time_eq = '1' and meta_p_load = '0' and meta_p_time /= 0 and timestamp > meta_p_time) else '0';
+    meta_drop <= meta_late and meta_p_drop_late ;
+
+    load_start <= meta_time_eq and meta_p_load ;
+    play_start <= '1' when (meta_time_eq = '1' and meta_p_play = '1' and meta_drop = '0' and wave_len(meta_p_id) /= 0) else '0' ;
+
+    -- Words carried by the loaded message.  A gated message only carries the
+    -- words before its gap.
+    meta_full_words <= 508 when usb_speed = '0' else 252 ;
+    meta_words <= to_integer(meta_p_words) when meta_p_gated = '1' and meta_p_words > 0 and meta_p_words < meta_full_words else meta_full_words ;
+
+    -- Words that follow the header in the FIFO.  A gated message of no words
+    -- only reaches the FIFO when it plays a waveform.
+    meta_msg_words <= 0 when meta_p_gated = '1' and meta_p_words = 0 else meta_words ;
+
+    -- Each message plays for two clocks per sample.  The clock on which
+    -- meta_time_eq is asserted reads the first sample.
     process(clock, reset)
+        variable hit : natural range 0 to 2**(meta_time_hit'length-1)-1 ;
     begin
         if (reset = '1') then
             meta_time_hit <= (others => '0');
         elsif(rising_edge(clock)) then
-            if (meta_time_eq = '1') then
-                if (usb_speed = '0') then
-                    meta_time_hit <= to_signed(1014, meta_time_hit'length);
+            if (meta_drop = '1' or load_start = '1' or (meta_time_eq = '1' and meta_p_play = '1' and play_start = '0')) then
+                meta_time_hit <= (others => '0');
+            elsif (play_start = '1') then
+                hit := 2 * to_integer(wave_len(meta_p_id)) - 2 ;
+                meta_time_hit <= to_signed(hit, meta_time_hit'length);
+            elsif (meta_time_eq = '1') then
+                -- 8-bit messages hold twice as many samples
+                if (sc8_en = '1') then
+                    hit := 4 * meta_words - 2 ;
                 else
-                    meta_time_hit <= to_signed(502, meta_time_hit'length);
+                    hit := 2 * meta_words - 2 ;
                 end if;
+                meta_time_hit <= to_signed(hit, meta_time_hit'length);
             else
-                if (meta_time_hit > 0) then
+                if (meta_time_hit > 0 and read_enable = '1') then
                     meta_time_hit <= meta_time_hit - 1;
                 end if;
             end if;
         end if;
     end process;
-    meta_time_go <= '1' when (meta_en = '1' and (meta_time_eq = '1' or meta_time_hit > 0 )) else '0';
+    meta_time_go <= '1' when (meta_en = '1' and ((meta_time_eq = '1' and meta_drop = '0' and meta_p_load = '0' and (meta_p_play = '0' or play_start = '1')) or meta_time_hit > 0 )) else '0';
+
+    -- Discard the words of a dropped message, or of a message that plays a
+    -- waveform, as they become available
+    drain_read <= '1' when drain_count > 0 and fifo_empty = '0' and sample_read = '0' else '0' ;
+
+    drain_late : process( clock, reset )
+    begin
+        if( reset = '1' ) then
+            drain_count <= (others =>'0') ;
+        elsif( rising_edge( clock ) ) then
+            if( enable = '0' or meta_en = '0' ) then
+                drain_count <= (others =>'0') ;
+            elsif( meta_drop = '1' or (meta_time_eq = '1' and meta_p_play = '1') ) then
+                drain_count <= to_unsigned(meta_msg_words, drain_count'length) ;
+            elsif( drain_read = '1' ) then
+                drain_count <= drain_count - 1 ;
+            end if ;
+        end if ;
+    end process ;
+
+    -- Write the words of a load message to waveform memory, and record the
+    -- waveform's extent.  The timestamp field of a load message holds:
+    --
+    --   [15:0]     Address of the message's first word
+    --   [31:16]    Address of the waveform's first sample
+    --   [47:32]    Length of the waveform, in samples
+    load_read <= '1' when load_count > 0 and fifo_empty = '0' and sample_read = '0' else '0' ;
+
+    load_wave : process( clock, reset )
+    begin
+        if( reset = '1' ) then
+            load_count <= (others =>'0') ;
+            load_addr <= (others =>'0') ;
+            load_read_q <= '0' ;
+            wave_base <= (others =>(others =>'0')) ;
+            wave_len <= (others =>(others =>'0')) ;
+        elsif( rising_edge( clock ) ) then
+            load_read_q <= load_read ;
+            if( enable = '0' or meta_en = '0' ) then
+                load_count <= (others =>'0') ;
+            elsif( load_start = '1' ) then
+                load_count <= to_unsigned(meta_msg_words, load_count'length) ;
+                load_addr <= meta_p_time(WAVE_ADDR_WIDTH-1 downto 0) ;
+                wave_base(meta_p_id) <= meta_p_time(31 downto 16) ;
+                wave_len(meta_p_id) <= meta_p_time(47 downto 32) ;
+            elsif( load_read = '1' ) then
+                load_count <= load_count - 1 ;
+            end if ;
+
+            -- The FIFO presents a word on the clock after it is read
+            if( load_read_q = '1' ) then
+                load_addr <= load_addr + 1 ;
+            end if ;
+        end if ;
+    end process ;
+
+    wave_memory : process( clock )
+    begin
+        if( rising_edge( clock ) ) then
+            if( load_read_q = '1' ) then
+                wave_ram(to_integer(load_addr)) <= fifo_data ;
+            end if ;
+            wave_q <= wave_ram(to_integer(play_addr)) ;
+        end if ;
+    end process ;
+
+    -- Step through a waveform's samples as a play message is transmitted
+    play_pending <= '1' when play_start = '1' or play_count /= 0 else '0' ;
 
-    -- Assumes we want to read every other clock cycle
+    play_wave : process( clock, reset )
+    begin
+        if( reset = '1' ) then
+            play_count <= (others =>'0') ;
+            play_addr <= (others =>'0') ;
+            play_read_q <= '0' ;
+        elsif( rising_edge( clock ) ) then
+            play_read_q <= play_read ;
+            if( enable = '0' or meta_en = '0' ) then
+                play_count <= (others =>'0') ;
+            elsif( play_start = '1' ) then
+                play_count <= wave_len(meta_p_id) ;
+                play_addr <= wave_base(meta_p_id)(WAVE_ADDR_WIDTH-1 downto 0) ;
+            elsif( play_read = '1' ) then
+                play_count <= play_count - 1 ;
+                play_addr <= play_addr + 1 ;
+            end if ;
+        end if ;
+    end process ;
+
+    -- Count late messages, and track the most any of them was late by
+    count_late : process( clock, reset )
+        variable lateness : unsigned(63 downto 0) ;
+    begin
+        if( reset = '1' ) then
+            late_count <= (others =>'0') ;
+            late_max <= (others =>'0') ;
+        elsif( rising_edge( clock ) ) then
+            lateness := timestamp - meta_p_time ;
+            if( enable = '1' and enable_q = '0' ) then
+                late_count <= (others =>'0') ;
+                late_max <= (others =>'0') ;
+            elsif( meta_late = '1' ) then
+                if( late_count /= 2**late_count'length - 1 ) then
+                    late_count <= late_count + 1 ;
+                end if ;
+                if( lateness > 2**late_max'length - 1 ) then
+                    late_max <= (others =>'1') ;
+                elsif( lateness(late_max'range) > late_max ) then
+                    late_max <= lateness(late_max'range) ;
+                end if ;
+            end if ;
+        end if ;
+    end process ;
+
+    -- Assumes we want to read every other clock cycle.  Packed groups of 4
+    -- samples span 3 words, so the last sample of a group needs no read.
+    -- Likewise for the second of each pair of 8-bit samples.
+    pack_hold <= '1' when (pack_en = '1' and pack_slot = 3) or (sc8_en = '1' and pack_slot(0) = '1') else '0' ;
+
+    -- Between timed messages, zeroes are sent at the same pace as samples so
+    -- that the transmitter is blanked rather than holding the last sample
     read_fifo : process( clock, reset )
     begin
         if( reset = '1' ) then
-            fifo_read <= '0' ;
+            sample_read <= '0' ;
+            blank_read <= '0' ;
+            play_read <= '0' ;
         elsif( rising_edge( clock ) ) then
-            fifo_read <= '0' ;
+            sample_read <= '0' ;
+            blank_read <= '0' ;
+            play_read <= '0' ;
             if( enable = '1' ) then
-                if( fifo_read = '0' and fifo_empty = '0' ) then
-                    if (meta_en = '0' or (meta_en = '1' and meta_time_go = '1')) then
-                        fifo_read <= '1' ;
-                    end if;
+                if( sample_read = '0' and blank_read = '0' and play_read = '0' and read_enable = '1' ) then
+                    if( meta_en = '1' and meta_time_go = '0' ) then
+                        blank_read <= '1' ;
+                    elsif( meta_en = '1' and play_pending = '1' ) then
+                        play_read <= '1' ;
+                    elsif( fifo_empty = '0' or pack_hold = '1' ) then
+                        sample_read <= '1' ;
+                    end if ;
                 end if ;
             else
-                fifo_read <= '0' ;
+                sample_read <= '0' ;
             end if ;
         end if ;
     end process ;
 
-    -- Muxed values so empty reads come out as zeroes
-    out_i <= resize(signed(fifo_data(11 downto  0)),out_i'length) when fifo_empty = '0' else (others =>'0') ;
-    out_q <= resize(signed(fifo_data(27 downto 16)),out_q'length) when fifo_empty = '0' else (others =>'0') ;
+    fifo_read <= drain_read or load_read when pack_hold = '1' else sample_read or drain_read or load_read ;
+
+    -- Track each sample's position within its packed group, and keep the
+    -- previous word for the samples that straddle two words
+    track_pack : process( clock, reset )
+    begin
+        if( reset = '1' ) then
+            pack_slot <= (others =>'0') ;
+            pack_slot_q <= (others =>'0') ;
+            pack_prev <= (others =>'0') ;
+            pack_hold_q <= '0' ;
+            sample_read_q <= '0' ;
+            blank_read_q <= '0' ;
+        elsif( rising_edge( clock ) ) then
+            sample_read_q <= sample_read ;
+            blank_read_q <= blank_read ;
+            pack_slot_q <= pack_slot ;
+            pack_hold_q <= pack_hold ;
+            if( enable = '0' or (pack_en = '0' and sc8_en = '0') ) then
+                pack_slot <= (others =>'0') ;
+            elsif( sample_read = '1' ) then
+                pack_slot <= pack_slot + 1 ;
+            end if ;
+
+            if( sample_read_q = '1' and pack_hold_q = '0' ) then
+                pack_prev <= fifo_data ;
+            end if ;
+        end if ;
+    end process ;
+
+    with pack_slot_q select pack_sample <=
+        fifo_data(23 downto 0)                          when "00",
+        fifo_data(15 downto 0) & pack_prev(31 downto 24) when "01",
+        fifo_data(7 downto 0) & pack_prev(31 downto 16)  when "10",
+        pack_prev(31 downto 8)                          when others ;
+
+    sc8_sample <= fifo_data(15 downto 0) when pack_slot_q(0) = '0' else pack_prev(31 downto 16) ;
+
+    -- Muxed values so empty reads and blanking come out as zeroes
+    out_i <= (others =>'0') when blank_read_q = '1' else
+             resize(signed(wave_q(11 downto 0)),out_i'length) when play_read_q = '1' else
+             resize(signed(pack_sample(11 downto 0)),out_i'length) when pack_en = '1' and sample_read_q = '1' else
+             (others =>'0') when pack_en = '1' else
+             expand(sc8_sample(7 downto 0), to_integer(sc8_shift)) when sc8_en = '1' and sample_read_q = '1' else
+             (others =>'0') when sc8_en = '1' else
+             resize(signed(fifo_data(11 downto  0)),out_i'length) when fifo_empty = '0' else (others =>'0') ;
+    out_q <= (others =>'0') when blank_read_q = '1' else
+             resize(signed(wave_q(27 downto 16)),out_q'length) when play_read_q = '1' else
+             resize(signed(pack_sample(23 downto 12)),out_q'length) when pack_en = '1' and sample_read_q = '1' else
+             (others =>'0') when pack_en = '1' else
+             expand(sc8_sample(15 downto 8), to_integer(sc8_shift)) when sc8_en = '1' and sample_read_q = '1' else
+             (others =>'0') when sc8_en = '1' else
+             resize(signed(fifo_data(27 downto 16)),out_q'length) when fifo_empty = '0' else (others =>'0') ;
 
     register_out_valid : process(clock, reset)
         constant COUNT_RESET : natural := 11 ;
@@ -129,7 +440,7 @@ begin
                     end if ;
                     downcount := downcount - 1 ;
                 else
-                    out_valid <= fifo_read ;
+                    out_valid <= sample_read or blank_read or play_read ;
                 end if ;
             else
                 downcount := COUNT_RESET ;
@@ -138,6 +449,40 @@ begin
         end if ;
     end process ;
 
+    -- Track how close the FIFO has come to underflowing
+    track_low_water : process( clock, reset )
+        variable level : unsigned(fifo_low_water'range) ;
+    begin
+        if( reset = '1' ) then
+            enable_q <= '0' ;
+            low_water_armed <= '0' ;
+            fifo_low_water <= (others =>'1') ;
+        elsif( rising_edge( clock ) ) then
+            enable_q <= enable ;
+
+            -- The used word count wraps to zero when the FIFO is full
+            if( fifo_empty = '1' ) then
+                level := (others =>'0') ;
+            elsif( unsigned(fifo_usedw) = 0 ) then
+                level := to_unsigned(2**fifo_usedw'length, level'length) ;
+            else
+                level := resize(unsigned(fifo_usedw), level'length) ;
+            end if ;
+
+            if( enable = '1' and enable_q = '0' ) then
+                low_water_armed <= '0' ;
+                fifo_low_water <= (others =>'1') ;
+            elsif( enable = '1' ) then
+                if( fifo_empty = '0' ) then
+                    low_water_armed <= '1' ;
+                end if ;
+                if( low_water_armed = '1' and level < fifo_low_water ) then
+                    fifo_low_water <= level ;
+                end if ;
+            end if ;
+        end if ;
+    end process ;
+
     -- Underflow detection
     detect_underflows : process( clock, reset )
     begin
@@ -145,7 +490,7 @@ begin
             underflow_detected <= '0' ;
         elsif( rising_edge( clock ) ) then
             underflow_detected <= '0' ;
-            if( enable = '1' and fifo_empty = '1' and (meta_en = '0' or (meta_en = '1' and meta_time_go = '1')) ) then
+            if( enable = '1' and read_enable = '1' and fifo_empty = '1' and play_pending = '0' and (meta_en = '0' or (meta_en = '1' and meta_time_go = '1')) ) then
                 underflow_detected <= '1' ;
             end if ;
         end if ;
@@ -12,55 +12,124 @@ entity fifo_writer is
     meta_en             :   in      std_logic ;
     timestamp           :   in      unsigned(63 downto 0);
 
+    -- Stored in the reserved word of each metadata header
+    meta_tag            :   in      std_logic_vector(31 downto 0) := x"12344321" ;
+
+    -- Sampled at the start of each message.  Messages started while this is
+    -- low are dropped whole, but still advance the message framing.
+    meta_keep           :   in      std_logic := '1' ;
+
+    -- Pack each group of 4 samples, 12 bits per component, into 3 words.
+    -- This may not be combined with meta_en.
+    pack_en             :   in      std_logic := '0' ;
+
+    -- Requantize samples to 8 bits per component, dividing them by
+    -- 2**sc8_shift, and send 2 samples per word
+    sc8_en              :   in      std_logic := '0' ;
+    sc8_shift           :   in      unsigned(3 downto 0) := x"4" ;
+
     in_i                :   in      signed(15 downto 0) ;
     in_q                :   in      signed(15 downto 0) ;
     in_valid            :   in      std_logic ;
 
-    fifo_usedw          :   in      std_logic_vector(11 downto 0) ;
+    fifo_usedw          :   in      std_logic_vector ;
     fifo_clear          :   buffer  std_logic ;
     fifo_write          :   buffer  std_logic ;
     fifo_full           :   in      std_logic ;
     fifo_data           :   out     std_logic_vector(31 downto 0) ;
 
     meta_fifo_full      :   in     std_logic;
-    meta_fifo_usedw     :   in     std_logic_vector(4 downto 0);
+    meta_fifo_usedw     :   in     std_logic_vector;
     meta_fifo_data      :   out    std_logic_vector(127 downto 0);
     meta_fifo_write     :   out    std_logic;
 
     overflow_led        :   buffer  std_logic ;
     overflow_count      :   buffer  unsigned(63 downto 0) ;
-    overflow_duration   :   in      unsigned(15 downto 0)
+    overflow_duration   :   in      unsigned(15 downto 0) ;
+
+    -- Highest FIFO fill level, in words, since enable was last raised
+    fifo_high_water     :   buffer  unsigned(15 downto 0)
   ) ;
 end entity ;
 
 architecture simple of fifo_writer is
 
-    signal buf_enough    : std_logic;
     signal dma_buf_sz    : signed(12 downto 0);
     signal dma_downcount : signed(12 downto 0);
     signal overflow_recovering  :   std_logic ;
     signal overflow_detected    :   std_logic ;
+    signal meta_start : std_logic ;
     signal meta_written : std_logic ;
     signal meta_written_reg : std_logic ;
+    signal msg_keep : std_logic ;
+    signal msg_drop : std_logic ;
+
+    -- Samples lost since the last message header, saturating
+    signal lost_count : unsigned(29 downto 0) ;
+    signal lost_armed : std_logic ;
+    signal lost_now   : unsigned(1 downto 0) ;
+    signal lost_flag  : std_logic ;
+
+    signal pack_phase   :   unsigned(1 downto 0) ;
+    signal pack_carry   :   std_logic_vector(23 downto 0) ;
+    signal pack_drop    :   std_logic ;
+    signal pack_room    :   std_logic ;
+    signal pack_sample  :   std_logic_vector(23 downto 0) ;
+    signal pack_word    :   std_logic_vector(31 downto 0) ;
+
+    signal enable_q     :   std_logic ;
+
+    signal sc8_phase    :   std_logic ;
+    signal sc8_prev     :   std_logic_vector(15 downto 0) ;
+    signal sc8_sample   :   std_logic_vector(15 downto 0) ;
+
+    -- Round x to 2**-shift of its value, saturated to 8 bits
+    function requantize( x : signed ; shift : natural ) return std_logic_vector is
+        variable t : signed(x'length+1 downto 0) ;
+    begin
+        -- Keep one fractional bit to round half up
+        t := shift_right(shift_left(resize(x, t'length), 1), shift) + 1 ;
+        t := shift_right(t, 1) ;
+        if( t > 127 ) then
+            return x"7f" ;
+        elsif( t < -128 ) then
+            return x"80" ;
+        else
+            return std_logic_vector(t(7 downto 0)) ;
+        end if ;
+    end function ;
 
 begin
 
-    dma_buf_sz <= to_signed(1015, dma_buf_sz'length) when usb_speed = '0' else to_signed(503, dma_buf_sz'length);
+    -- Samples per message, following the 16 byte metadata header.  Samples
+    -- are counted as they are written, rather than by clock cycles, so
+    -- upstream decimation does not skew the message framing.
+    dma_buf_sz <= to_signed(508, dma_buf_sz'length) when usb_speed = '0' else to_signed(252, dma_buf_sz'length);
     process( clock, reset)
     begin
         if( reset = '1') then
-            dma_downcount <= dma_buf_sz;
+            dma_downcount <= (others =>'0') ;
+            meta_start <= '0' ;
             meta_written <= '0' ;
+            msg_keep <= '1' ;
         elsif( rising_edge( clock ) ) then
+            meta_start <= '0' ;
             if (enable = '1' and meta_en = '1') then
                 if( dma_downcount > 0 ) then
-                    dma_downcount <= dma_downcount - 1 ;
-                elsif ( to_signed(2**fifo_usedw'length,fifo_usedw'length+2) - (signed('0'&fifo_full&fifo_usedw)) > dma_buf_sz ) then
-                    -- Guaranteed to be done downcounting here .. so only reset the downcount
-                    -- if we are able to store that amount of samples in the downstream FIFO
-                    if( meta_written = '1' or in_valid = '1' ) then
+                    if( fifo_write = '1' or msg_drop = '1' ) then
+                        dma_downcount <= dma_downcount - 1 ;
+                    end if ;
+                elsif ( meta_keep = '0' or to_signed(2**fifo_usedw'length,fifo_usedw'length+2) - (signed('0'&fifo_full&fifo_usedw)) > dma_buf_sz ) then
+                    -- Only start a new message if we are able to store
+                    -- all of its samples in the downstream FIFO.  8-bit
+                    -- messages also start on a pair boundary, so their
+                    -- first sample is the one the timestamp refers to.
+                    if( (meta_written = '1' or in_valid = '1') and
+                        (sc8_en = '0' or sc8_phase = '0') ) then
                         dma_downcount <= dma_buf_sz;
+                        meta_start <= meta_keep ;
                         meta_written <= '1' ;
+                        msg_keep <= meta_keep ;
                     end if ;
                 else
                     meta_written <= '0' ;
@@ -68,20 +137,109 @@ begin
             else
                 dma_downcount <= (others =>'0') ;
                 meta_written <= '0' ;
+                msg_keep <= '1' ;
             end if;
         end if;
     end process;
 
-    buf_enough <= '1' when ( dma_downcount = (dma_buf_sz)) else '0';
-
-    meta_fifo_write <= '1' when (enable = '1' and meta_en = '1' and buf_enough = '1') else '0';
-    meta_fifo_data <= x"FFFFFFFF" & std_logic_vector(timestamp) & x"12344321";
+    meta_fifo_write <= '1' when (enable = '1' and meta_en = '1' and meta_start = '1') else '0';
+    -- The flags word reports samples lost before this message
+    lost_flag <= '0' when lost_count = 0 else '1' ;
+    meta_fifo_data <= '0' & lost_flag & std_logic_vector(lost_count) & std_logic_vector(timestamp) & meta_tag;
 
     meta_written_reg <= '0' when reset = '1' else meta_written when rising_edge(clock) ;
 
+    -- Samples of a dropped message, counted as if they had been written
+    msg_drop <= in_valid when msg_keep = '0' and (sc8_en = '0' or sc8_phase = '1') and meta_written_reg = '1' else '0' ;
+
+    -- Samples that neither reached the FIFO nor belonged to a dropped message
+    -- since the first message after enable was raised.  A lost pair of 8-bit
+    -- samples counts as 2.
+    lost_now <= "00" when enable = '0' or meta_en = '0' or pack_en = '1' or in_valid = '0' or fifo_write = '1' or msg_drop = '1' else
+                "10" when sc8_en = '1' and sc8_phase = '1' else
+                "01" when sc8_en = '0' else
+                "00" ;
+
+    count_lost : process( clock, reset )
+    begin
+        if( reset = '1' ) then
+            lost_count <= (others =>'0') ;
+            lost_armed <= '0' ;
+        elsif( rising_edge( clock ) ) then
+            if( enable = '0' or meta_en = '0' ) then
+                lost_count <= (others =>'0') ;
+                lost_armed <= '0' ;
+            elsif( meta_start = '1' ) then
+                lost_count <= resize(lost_now, lost_count'length) ;
+                lost_armed <= '1' ;
+            elsif( lost_armed = '1' and lost_count < 2**lost_count'length - 3 ) then
+                lost_count <= lost_count + lost_now ;
+            end if ;
+        end if ;
+    end process ;
+
+    -- Packed samples form a little endian stream of 24-bit samples, each
+    -- holding I in its lower 12 bits and Q in its upper 12 bits.  A group of
+    -- 4 samples is only started when all 3 of its words fit in the FIFO, and
+    -- is otherwise dropped as a whole, so the stream stays aligned.
+    pack_sample <= std_logic_vector(in_q(11 downto 0) & in_i(11 downto 0)) ;
+    pack_room <= '1' when fifo_full = '0' and unsigned(fifo_usedw) < 2**fifo_usedw'length - 4 else '0' ;
+
+    pack_samples : process( clock, reset )
+    begin
+        if( reset = '1' ) then
+            pack_phase <= (others =>'0') ;
+            pack_carry <= (others =>'0') ;
+            pack_drop <= '0' ;
+        elsif( rising_edge( clock ) ) then
+            if( enable = '0' or pack_en = '0' ) then
+                pack_phase <= (others =>'0') ;
+                pack_drop <= '0' ;
+            elsif( in_valid = '1' ) then
+                pack_phase <= pack_phase + 1 ;
+                case pack_phase is
+                    when "00"   =>  pack_carry <= pack_sample ;
+                                    pack_drop <= not pack_room ;
+                    when "01"   =>  pack_carry <= x"00" & pack_sample(23 downto 8) ;
+                    when "10"   =>  pack_carry <= x"0000" & pack_sample(23 downto 16) ;
+                    when others =>  pack_carry <= (others =>'0') ;
+                end case ;
+            end if ;
+        end if ;
+    end process ;
+
+    with pack_phase select pack_word <=
+        pack_sample(7 downto 0) & pack_carry(23 downto 0)   when "01",
+        pack_sample(15 downto 0) & pack_carry(15 downto 0)  when "10",
+        pack_sample(23 downto 0) & pack_carry(7 downto 0)   when others ;
+
+    -- 8-bit samples hold each component rounded, divided by 2**sc8_shift and
+    -- saturated.  Pairs of samples share a word, forming the bytes I0, Q0,
+    -- I1, Q1 in little endian order.
+    sc8_sample <= requantize(in_q, to_integer(sc8_shift)) & requantize(in_i, to_integer(sc8_shift)) ;
+
+    pair_samples : process( clock, reset )
+    begin
+        if( reset = '1' ) then
+            sc8_phase <= '0' ;
+            sc8_prev <= (others =>'0') ;
+        elsif( rising_edge( clock ) ) then
+            if( enable = '0' or sc8_en = '0' ) then
+                sc8_phase <= '0' ;
+            elsif( in_valid = '1' ) then
+                sc8_phase <= not sc8_phase ;
+                sc8_prev <= sc8_sample ;
+            end if ;
+        end if ;
+    end process ;
+
     -- Simple concatenation of samples
-    fifo_data   <= std_logic_vector(in_q & in_i) ;
-    fifo_write  <= in_valid when overflow_recovering = '0' and fifo_full = '0' and (meta_en = '0' or meta_written_reg = '1') else '0' ;
+    fifo_data   <= pack_word when pack_en = '1' else
+                   sc8_sample & sc8_prev when sc8_en = '1' else
+                   std_logic_vector(in_q & in_i) ;
+    fifo_write  <= in_valid when pack_en = '1' and pack_phase /= 0 and pack_drop = '0' else
+                   '0' when pack_en = '1' else
+                   in_valid when (sc8_en = '0' or sc8_phase = '1') and overflow_recovering = '0' and fifo_full = '0' and (meta_en = '0' or (meta_written_reg = '1' and msg_keep = '1' and dma_downcount > 0)) else '0' ;
 
     -- Clear out the contents when RX is disabled
     clear_fifo : process( clock, reset )
@@ -96,6 +254,24 @@ begin
         end if ;
     end process ;
 
+    -- Track how close the FIFO has come to overflowing
+    track_high_water : process( clock, reset )
+        variable level : unsigned(fifo_high_water'range) ;
+    begin
+        if( reset = '1' ) then
+            enable_q <= '0' ;
+            fifo_high_water <= (others =>'0') ;
+        elsif( rising_edge( clock ) ) then
+            enable_q <= enable ;
+            level := resize(unsigned(fifo_full & fifo_usedw), level'length) ;
+            if( enable = '1' and enable_q = '0' ) then
+                fifo_high_water <= (others =>'0') ;
+            elsif( enable = '1' and level > fifo_high_water ) then
+                fifo_high_water <= level ;
+            end if ;
+        end if ;
+    end process ;
+
     -- Overflow detection
     detect_overflows : process( clock, reset )
     begin
@@ -103,8 +279,14 @@ begin
             overflow_detected <= '0' ;
         elsif( rising_edge( clock ) ) then
             overflow_detected <= '0' ;
-            if( enable = '1' and in_valid = '1' and fifo_full = '1' and fifo_clear = '0' ) then
-                overflow_detected <= '1' ;
+            if( enable = '1' and in_valid = '1' and fifo_clear = '0' ) then
+                if( pack_en = '1' ) then
+                    if( pack_phase = 0 and pack_room = '0' ) then
+                        overflow_detected <= '1' ;
+                    end if ;
+                elsif( fifo_full = '1' ) then
+                    overflow_detected <= '1' ;
+                end if ;
             end if ;
         end if ;
     end process ;
@@ -0,0 +1,183 @@
+-- Copyright (c) 2014 Nuand LLC
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+
+library ieee ;
+    use ieee.std_logic_1164.all ;
+    use ieee.numeric_std.all ;
+
+library work ;
+    use work.constellation_mapper_p.all ;
+
+-- TX interpolation chain: a FIR filter, at the input rate, which
+-- pre-compensates for the CIC passband droop, followed by a CIC
+-- interpolator.
+--
+-- The overall interpolation factor is 2**rate_log2.  A rate_log2 of 0
+-- bypasses the chain entirely.
+--
+-- Output samples are produced every other clock cycle, as the LMS6002D TX
+-- interface expects.  in_request is held high for two clock cycles each
+-- time an input sample is needed, and should gate the reads of the sample
+-- source.  When bypassed, in_request is held high.  Outputs are saturated to
+-- SAMPLE_WIDTH bits.
+entity interpolator is
+  generic (
+    SAMPLE_WIDTH    :   positive    := 12 ;
+    MAX_RATE_LOG2   :   positive    := 7
+  ) ;
+  port (
+    clock           :   in  std_logic ;
+    reset           :   in  std_logic ;
+
+    rate_log2       :   in  natural range 0 to MAX_RATE_LOG2 ;
+
+    in_i            :   in  signed(15 downto 0) ;
+    in_q            :   in  signed(15 downto 0) ;
+    in_valid        :   in  std_logic ;
+    in_request      :   out std_logic ;
+
+    out_i           :   out signed(15 downto 0) ;
+    out_q           :   out signed(15 downto 0) ;
+    out_valid       :   out std_logic
+  ) ;
+end entity ;
+
+architecture arch of interpolator is
+
+    -- Least squares fit to 1/sinc(f)**3 over 0 to 0.2 and 0 from 0.32 to
+    -- 0.5 of the input sample rate, normalized for unity gain at DC
+    constant CIC_COMPENSATION : real_array_t := (
+         0.039295,  0.011778, -0.105148, -0.040902,  0.319296,  0.551362,
+         0.319296, -0.040902, -0.105148,  0.011778,  0.039295
+    ) ;
+
+    function saturate( x : signed ; bits : positive ) return signed is
+        constant MAX : signed(x'range) := to_signed(2**(bits-1)-1, x'length) ;
+        constant MIN : signed(x'range) := to_signed(-(2**(bits-1)), x'length) ;
+    begin
+        if( x > MAX ) then
+            return MAX ;
+        elsif( x < MIN ) then
+            return MIN ;
+        else
+            return x ;
+        end if ;
+    end function ;
+
+    -- Clock cycles within one input sample period, 2**(rate_log2+1) long
+    signal phase        :   unsigned(MAX_RATE_LOG2 downto 0) ;
+    signal phase_last   :   unsigned(MAX_RATE_LOG2 downto 0) ;
+
+    signal load         :   std_logic ;
+    signal strobe       :   std_logic ;
+    signal request      :   std_logic ;
+
+    signal fir_i        :   signed(15 downto 0) ;
+    signal fir_q        :   signed(15 downto 0) ;
+    signal fir_valid    :   std_logic ;
+
+    signal cic_i        :   signed(15 downto 0) ;
+    signal cic_q        :   signed(15 downto 0) ;
+    signal cic_valid    :   std_logic ;
+
+begin
+
+    phase_last <= shift_left(to_unsigned(1, phase'length), rate_log2+1) - 1 ;
+
+    -- The sample requested in the last two cycles of a period arrives from
+    -- the FIR at least two cycles before the following period's load.
+    pace : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            phase <= (others =>'0') ;
+        elsif( rising_edge(clock) ) then
+            if( (phase and phase_last) = phase_last ) then
+                phase <= (others =>'0') ;
+            else
+                phase <= phase + 1 ;
+            end if ;
+        end if ;
+    end process ;
+
+    strobe  <= not phase(0) ;
+    load    <= '1' when (phase and phase_last) = phase_last else '0' ;
+    request <= '1' when (phase and phase_last) >= phase_last - 1 else '0' ;
+
+    U_fir_i : entity work.fir_filter(systolic)
+      generic map (
+        H               =>  CIC_COMPENSATION
+      ) port map (
+        clock           =>  clock,
+        reset           =>  reset,
+        in_sample       =>  in_i,
+        in_valid        =>  in_valid,
+        out_sample      =>  fir_i,
+        out_valid       =>  fir_valid
+      ) ;
+
+    U_fir_q : entity work.fir_filter(systolic)
+      generic map (
+        H               =>  CIC_COMPENSATION
+      ) port map (
+        clock           =>  clock,
+        reset           =>  reset,
+        in_sample       =>  in_q,
+        in_valid        =>  in_valid,
+        out_sample      =>  fir_q,
+        out_valid       =>  open
+      ) ;
+
+    U_cic_i : entity work.cic_interpolator
+      generic map (
+        MAX_RATE_LOG2   =>  MAX_RATE_LOG2
+      ) port map (
+        clock           =>  clock,
+        reset           =>  reset,
+        rate_log2       =>  rate_log2,
+        in_sample       =>  fir_i,
+        in_valid        =>  fir_valid,
+        in_load         =>  load,
+        out_strobe      =>  strobe,
+        out_sample      =>  cic_i,
+        out_valid       =>  cic_valid
+      ) ;
+
+    U_cic_q : entity work.cic_interpolator
+      generic map (
+        MAX_RATE_LOG2   =>  MAX_RATE_LOG2
+      ) port map (
+        clock           =>  clock,
+        reset           =>  reset,
+        rate_log2       =>  rate_log2,
+        in_sample       =>  fir_q,
+        in_valid        =>  fir_valid,
+        in_load         =>  load,
+        out_strobe      =>  strobe,
+        out_sample      =>  cic_q,
+        out_valid       =>  open
+      ) ;
+
+    in_request <= '1' when rate_log2 = 0 else request ;
+
+    out_i     <= in_i when rate_log2 = 0 else saturate(cic_i, SAMPLE_WIDTH) ;
+    out_q     <= in_q when rate_log2 = 0 else saturate(cic_q, SAMPLE_WIDTH) ;
+    out_valid <= in_valid when rate_log2 = 0 else cic_valid ;
+
+end architecture ;
@@ -0,0 +1,249 @@
+-- Copyright (c) 2014 Nuand LLC
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+
+library ieee ;
+    use ieee.std_logic_1164.all ;
+    use ieee.numeric_std.all ;
+
+-- Continuously adapting DC offset and IQ imbalance correction.
+--
+-- The DC offset of each rail is tracked by a leaky integrator with a time
+-- constant of 2**DC_SHIFT samples, and subtracted.
+--
+-- The IQ imbalance is removed by a blind LMS loop, which drives the output
+-- rails to equal power and zero correlation:
+--
+--      out_real = I
+--      out_imag = gain*Q + phase*I
+--
+--      gain  += mu * (out_real**2 - out_imag**2)
+--      phase -= mu * (out_real * out_imag)
+--
+-- gain and phase are Q12, so a gain of 4096 is unity.  mu is 2**-IQ_SHIFT
+-- per squared input LSB.  gain is held within [0.5, 2) and phase within
+-- [-0.5, 0.5).
+--
+-- Each loop resets to its neutral state while its enable is low, and its
+-- stage is then bypassed.  The latency is two valid samples either way.
+--
+-- The estimates are presented on dc_real, dc_imag, gain and phase.  They only
+-- change every 2**SNAPSHOT_LOG2 samples, so a slower clock domain can sample
+-- them coherently by reading until two reads match.
+entity iq_tracker is
+  generic (
+    INPUT_WIDTH     :   positive    := 16 ;
+    DC_SHIFT        :   positive    := 14 ;
+    IQ_SHIFT        :   positive    := 26 ;
+    SNAPSHOT_LOG2   :   positive    := 12
+  ) ;
+  port (
+    clock           :   in  std_logic ;
+    reset           :   in  std_logic ;
+
+    dc_enable       :   in  std_logic ;
+    iq_enable       :   in  std_logic ;
+
+    in_real         :   in  signed(INPUT_WIDTH-1 downto 0) ;
+    in_imag         :   in  signed(INPUT_WIDTH-1 downto 0) ;
+    in_valid        :   in  std_logic ;
+
+    out_real        :   out signed(INPUT_WIDTH-1 downto 0) ;
+    out_imag        :   out signed(INPUT_WIDTH-1 downto 0) ;
+    out_valid       :   out std_logic ;
+
+    dc_real         :   out signed(15 downto 0) ;
+    dc_imag         :   out signed(15 downto 0) ;
+    gain            :   out signed(15 downto 0) ;
+    phase           :   out signed(15 downto 0)
+  ) ;
+end entity ;
+
+architecture arch of iq_tracker is
+
+    constant Q              :   natural := 12 ;
+    constant UNITY          :   integer := 2**Q ;
+    constant GAIN_MIN       :   integer := UNITY / 2 ;
+    constant GAIN_MAX       :   integer := 2*UNITY - 1 ;
+    constant PHASE_MIN      :   integer := -UNITY / 2 ;
+    constant PHASE_MAX      :   integer := UNITY / 2 - 1 ;
+
+    constant DC_ACC_WIDTH   :   positive := INPUT_WIDTH + DC_SHIFT + 1 ;
+    constant IQ_ACC_WIDTH   :   positive := 16 + IQ_SHIFT ;
+    constant PROD_WIDTH     :   positive := 2*INPUT_WIDTH + 1 ;
+
+    function saturate( x : signed ; width : positive ) return signed is
+        constant hi : signed(width-1 downto 0) := (width-1 => '0', others => '1') ;
+        constant lo : signed(width-1 downto 0) := (width-1 => '1', others => '0') ;
+    begin
+        if( x > resize(hi, x'length) ) then
+            return hi ;
+        elsif( x < resize(lo, x'length) ) then
+            return lo ;
+        else
+            return resize(x, width) ;
+        end if ;
+    end function ;
+
+    signal dc_acc_real  :   signed(DC_ACC_WIDTH-1 downto 0) ;
+    signal dc_acc_imag  :   signed(DC_ACC_WIDTH-1 downto 0) ;
+    signal dc_est_real  :   signed(INPUT_WIDTH-1 downto 0) ;
+    signal dc_est_imag  :   signed(INPUT_WIDTH-1 downto 0) ;
+
+    signal gain_acc     :   signed(IQ_ACC_WIDTH-1 downto 0) ;
+    signal phase_acc    :   signed(IQ_ACC_WIDTH-1 downto 0) ;
+    signal gain_est     :   signed(15 downto 0) ;
+    signal phase_est    :   signed(15 downto 0) ;
+
+    signal s1_real      :   signed(INPUT_WIDTH-1 downto 0) ;
+    signal s1_imag      :   signed(INPUT_WIDTH-1 downto 0) ;
+    signal s1_valid     :   std_logic ;
+
+    signal s2_real      :   signed(INPUT_WIDTH-1 downto 0) ;
+    signal s2_imag      :   signed(INPUT_WIDTH-1 downto 0) ;
+    signal s2_valid     :   std_logic ;
+
+    signal snapshot     :   unsigned(SNAPSHOT_LOG2-1 downto 0) ;
+
+begin
+
+    dc_est_real <= resize(shift_right(dc_acc_real, DC_SHIFT), INPUT_WIDTH) ;
+    dc_est_imag <= resize(shift_right(dc_acc_imag, DC_SHIFT), INPUT_WIDTH) ;
+
+    gain_est  <= resize(shift_right(gain_acc, IQ_SHIFT), 16) ;
+    phase_est <= resize(shift_right(phase_acc, IQ_SHIFT), 16) ;
+
+    -- Remove and track the DC offset
+    dc_stage : process(clock, reset)
+        variable err_real   :   signed(INPUT_WIDTH downto 0) ;
+        variable err_imag   :   signed(INPUT_WIDTH downto 0) ;
+    begin
+        if( reset = '1' ) then
+            dc_acc_real <= (others =>'0') ;
+            dc_acc_imag <= (others =>'0') ;
+            s1_real <= (others =>'0') ;
+            s1_imag <= (others =>'0') ;
+            s1_valid <= '0' ;
+        elsif( rising_edge(clock) ) then
+            s1_valid <= in_valid ;
+            if( in_valid = '1' ) then
+                if( dc_enable = '1' ) then
+                    err_real := resize(in_real, err_real'length) - dc_est_real ;
+                    err_imag := resize(in_imag, err_imag'length) - dc_est_imag ;
+                    dc_acc_real <= dc_acc_real + err_real ;
+                    dc_acc_imag <= dc_acc_imag + err_imag ;
+                    s1_real <= saturate(err_real, INPUT_WIDTH) ;
+                    s1_imag <= saturate(err_imag, INPUT_WIDTH) ;
+                else
+                    dc_acc_real <= (others =>'0') ;
+                    dc_acc_imag <= (others =>'0') ;
+                    s1_real <= in_real ;
+                    s1_imag <= in_imag ;
+                end if ;
+            end if ;
+        end if ;
+    end process ;
+
+    -- Apply the current gain and phase corrections to the imaginary rail
+    iq_stage : process(clock, reset)
+        variable acc : signed(PROD_WIDTH downto 0) ;
+    begin
+        if( reset = '1' ) then
+            s2_real <= (others =>'0') ;
+            s2_imag <= (others =>'0') ;
+            s2_valid <= '0' ;
+        elsif( rising_edge(clock) ) then
+            s2_valid <= s1_valid ;
+            if( s1_valid = '1' ) then
+                s2_real <= s1_real ;
+                if( iq_enable = '1' ) then
+                    acc := resize(s1_imag * gain_est, acc'length) +
+                           resize(s1_real * phase_est, acc'length) +
+                           2**(Q-1) ;
+                    s2_imag <= saturate(shift_right(acc, Q), INPUT_WIDTH) ;
+                else
+                    s2_imag <= s1_imag ;
+                end if ;
+            end if ;
+        end if ;
+    end process ;
+
+    -- LMS update from the corrected output
+    iq_update : process(clock, reset)
+        variable pwr_err    :   signed(PROD_WIDTH-1 downto 0) ;
+        variable xcorr      :   signed(PROD_WIDTH-1 downto 0) ;
+        variable next_gain  :   signed(IQ_ACC_WIDTH-1 downto 0) ;
+        variable next_phase :   signed(IQ_ACC_WIDTH-1 downto 0) ;
+    begin
+        if( reset = '1' ) then
+            gain_acc <= shift_left(to_signed(UNITY, IQ_ACC_WIDTH), IQ_SHIFT) ;
+            phase_acc <= (others =>'0') ;
+        elsif( rising_edge(clock) ) then
+            if( iq_enable = '0' ) then
+                gain_acc <= shift_left(to_signed(UNITY, IQ_ACC_WIDTH), IQ_SHIFT) ;
+                phase_acc <= (others =>'0') ;
+            elsif( s2_valid = '1' ) then
+                pwr_err := resize(s2_real * s2_real, PROD_WIDTH) -
+                           resize(s2_imag * s2_imag, PROD_WIDTH) ;
+                xcorr   := resize(s2_real * s2_imag, PROD_WIDTH) ;
+
+                next_gain  := gain_acc + pwr_err ;
+                next_phase := phase_acc - xcorr ;
+
+                -- Hold either estimate at its limits
+                if( shift_right(next_gain, IQ_SHIFT) >= GAIN_MIN and
+                    shift_right(next_gain, IQ_SHIFT) <= GAIN_MAX ) then
+                    gain_acc <= next_gain ;
+                end if ;
+
+                if( shift_right(next_phase, IQ_SHIFT) >= PHASE_MIN and
+                    shift_right(next_phase, IQ_SHIFT) <= PHASE_MAX ) then
+                    phase_acc <= next_phase ;
+                end if ;
+            end if ;
+        end if ;
+    end process ;
+
+    -- Periodically expose the estimates
+    present : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            snapshot <= (others =>'0') ;
+            dc_real <= (others =>'0') ;
+            dc_imag <= (others =>'0') ;
+            gain <= to_signed(UNITY, 16) ;
+            phase <= (others =>'0') ;
+        elsif( rising_edge(clock) ) then
+            if( in_valid = '1' ) then
+                snapshot <= snapshot + 1 ;
+                if( snapshot = 0 ) then
+                    dc_real <= resize(dc_est_real, 16) ;
+                    dc_imag <= resize(dc_est_imag, 16) ;
+                    gain <= gain_est ;
+                    phase <= phase_est ;
+                end if ;
+            end if ;
+        end if ;
+    end process ;
+
+    out_real <= s2_real ;
+    out_imag <= s2_imag ;
+    out_valid <= s2_valid ;
+
+end architecture ;
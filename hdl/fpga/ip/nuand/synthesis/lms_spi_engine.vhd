@@ -0,0 +1,320 @@
+-- Copyright (c) 2014 Nuand LLC
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+
+library ieee ;
+    use ieee.std_logic_1164.all ;
+    use ieee.numeric_std.all ;
+
+-- Timed LMS6002D SPI command engine.
+--
+-- Commands are queued through a 32-bit control word, normally driven by a
+-- PIO.  Bit 31 is toggled to push bits 29:0 into the command FIFO, and bit
+-- 30 holds off any new SPI transfers while it is set.  Bits 29:28 select
+-- the command:
+--
+--  Kind | Bits                                | Command
+--  -----+-------------------------------------+---------------------------------
+--   00  | 14:8 addr, 7:0 data                 | Write data to addr
+--   01  | 25:24 index, 23:0 value             | Set bits 24*index+23 downto
+--       |                                     | 24*index of the target time
+--   10  | 0 module (0 = RX, 1 = TX)           | Wait until the module's
+--       |                                     | timestamp reaches the target
+--   11  | 22:15 mask, 14:8 addr, 7:0 data     | Replace the mask bits of addr
+--
+-- Commands are performed in order, so a wait delays all of the commands
+-- queued after it.  The timestamps are brought into this clock domain with
+-- a handshake, so a wait ends within a few clock cycles of the timestamp
+-- being reached.
+--
+-- The status word holds the last toggle accepted in bit 31, whether the
+-- engine owns the SPI bus in bit 30, whether it is waiting on the target
+-- time in bit 29, and the number of free FIFO entries in bits 7:0.  A push
+-- is accepted once bit 31 of the status word matches the toggle.
+--
+-- The engine only starts a transfer while hold is low and the other SPI
+-- master has nothing selected, and bus_owned is high from then until the
+-- transfer completes.  SCLK runs at the clock rate divided by
+-- 2*HALF_PERIOD, in SPI mode 0.
+entity lms_spi_engine is
+  generic (
+    FIFO_DEPTH_LOG2 :   positive    := 5 ;
+    HALF_PERIOD     :   positive    := 1
+  ) ;
+  port (
+    clock           :   in  std_logic ;
+    reset           :   in  std_logic ;
+
+    cmd             :   in  std_logic_vector(31 downto 0) ;
+    status          :   out std_logic_vector(31 downto 0) ;
+
+    rx_clock        :   in  std_logic ;
+    rx_reset        :   in  std_logic ;
+    rx_timestamp    :   in  unsigned(63 downto 0) ;
+
+    tx_clock        :   in  std_logic ;
+    tx_reset        :   in  std_logic ;
+    tx_timestamp    :   in  unsigned(63 downto 0) ;
+
+    other_ss_n      :   in  std_logic ;
+    bus_owned       :   out std_logic ;
+
+    spi_sclk        :   out std_logic ;
+    spi_sen         :   out std_logic ;
+    spi_sdio        :   out std_logic ;
+    spi_sdo         :   in  std_logic
+  ) ;
+end entity ;
+
+architecture arch of lms_spi_engine is
+
+    constant FIFO_DEPTH     :   natural := 2**FIFO_DEPTH_LOG2 ;
+
+    subtype word_t is std_logic_vector(29 downto 0) ;
+    type fifo_t is array(0 to FIFO_DEPTH-1) of word_t ;
+    signal fifo             :   fifo_t ;
+
+    signal wr_ptr           :   unsigned(FIFO_DEPTH_LOG2-1 downto 0) ;
+    signal rd_ptr           :   unsigned(FIFO_DEPTH_LOG2-1 downto 0) ;
+    signal count            :   unsigned(FIFO_DEPTH_LOG2 downto 0) ;
+    signal toggle           :   std_logic ;
+    signal pop              :   std_logic ;
+
+    type ts_t is array(0 to 1) of unsigned(63 downto 0) ;
+    signal now              :   ts_t ;
+    signal ts_req           :   std_logic_vector(0 to 1) ;
+    signal ts_ack           :   std_logic_vector(0 to 1) ;
+    signal ts_data          :   ts_t ;
+
+    type state_t is (IDLE, WAITING, SPI_START, SPI_LOW, SPI_HIGH, SPI_GAP) ;
+    signal state            :   state_t ;
+
+    signal target           :   unsigned(71 downto 0) ;
+    signal module           :   natural range 0 to 1 ;
+    signal owned            :   std_logic ;
+    signal addr             :   std_logic_vector(6 downto 0) ;
+    signal shift            :   std_logic_vector(15 downto 0) ;
+    signal rx_shift         :   std_logic_vector(7 downto 0) ;
+    signal bits             :   natural range 0 to 16 ;
+    signal timer            :   natural range 0 to HALF_PERIOD-1 ;
+    signal modify           :   boolean ;
+    signal mask             :   std_logic_vector(7 downto 0) ;
+    signal value            :   std_logic_vector(7 downto 0) ;
+
+begin
+
+    -- Accept pushes from the toggle in the control word
+    push : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            wr_ptr <= (others =>'0') ;
+            rd_ptr <= (others =>'0') ;
+            count <= (others =>'0') ;
+            toggle <= '0' ;
+        elsif( rising_edge(clock) ) then
+            if( cmd(31) /= toggle and count < FIFO_DEPTH ) then
+                fifo(to_integer(wr_ptr)) <= cmd(29 downto 0) ;
+                wr_ptr <= wr_ptr + 1 ;
+                toggle <= cmd(31) ;
+                if( pop = '0' ) then
+                    count <= count + 1 ;
+                end if ;
+            elsif( pop = '1' ) then
+                count <= count - 1 ;
+            end if ;
+
+            if( pop = '1' ) then
+                rd_ptr <= rd_ptr + 1 ;
+            end if ;
+        end if ;
+    end process ;
+
+    -- Continuously sample both timestamps into this clock domain
+    generate_timestamps : for i in 0 to 1 generate
+        signal src_clock    :   std_logic ;
+        signal src_reset    :   std_logic ;
+        signal src_data     :   unsigned(63 downto 0) ;
+    begin
+        src_clock <= rx_clock when i = 0 else tx_clock ;
+        src_reset <= rx_reset when i = 0 else tx_reset ;
+        src_data  <= rx_timestamp when i = 0 else tx_timestamp ;
+
+        U_handshake : entity work.handshake
+          generic map (
+            DATA_WIDTH          =>  64
+          ) port map (
+            source_clock        =>  src_clock,
+            source_reset        =>  src_reset,
+            source_data         =>  std_logic_vector(src_data),
+
+            dest_clock          =>  clock,
+            dest_reset          =>  reset,
+            unsigned(dest_data) =>  ts_data(i),
+            dest_req            =>  ts_req(i),
+            dest_ack            =>  ts_ack(i)
+          ) ;
+
+        sample : process(clock, reset)
+        begin
+            if( reset = '1' ) then
+                ts_req(i) <= '0' ;
+                now(i) <= (others =>'0') ;
+            elsif( rising_edge(clock) ) then
+                if( ts_ack(i) = '0' ) then
+                    ts_req(i) <= '1' ;
+                elsif( ts_req(i) = '1' ) then
+                    now(i) <= ts_data(i) ;
+                    ts_req(i) <= '0' ;
+                end if ;
+            end if ;
+        end process ;
+    end generate ;
+
+    -- Perform the commands at the head of the FIFO
+    sequence : process(clock, reset)
+        variable word   : word_t ;
+    begin
+        if( reset = '1' ) then
+            state <= IDLE ;
+            pop <= '0' ;
+            target <= (others =>'0') ;
+            module <= 0 ;
+            addr <= (others =>'0') ;
+            shift <= (others =>'0') ;
+            rx_shift <= (others =>'0') ;
+            bits <= 0 ;
+            timer <= 0 ;
+            modify <= false ;
+            mask <= (others =>'0') ;
+            value <= (others =>'0') ;
+            spi_sclk <= '0' ;
+            spi_sen <= '1' ;
+            spi_sdio <= '0' ;
+            owned <= '0' ;
+        elsif( rising_edge(clock) ) then
+            pop <= '0' ;
+            case state is
+                when IDLE =>
+                    owned <= '0' ;
+                    word := fifo(to_integer(rd_ptr)) ;
+                    if( count /= 0 and pop = '0' ) then
+                        case word(29 downto 28) is
+                            when "01" =>
+                                case word(25 downto 24) is
+                                    when "00" => target(23 downto 0) <= unsigned(word(23 downto 0)) ;
+                                    when "01" => target(47 downto 24) <= unsigned(word(23 downto 0)) ;
+                                    when "10" => target(71 downto 48) <= unsigned(word(23 downto 0)) ;
+                                    when others => null ;
+                                end case ;
+                                pop <= '1' ;
+
+                            when "10" =>
+                                if( word(0) = '0' ) then
+                                    module <= 0 ;
+                                else
+                                    module <= 1 ;
+                                end if ;
+                                pop <= '1' ;
+                                state <= WAITING ;
+
+                            when others =>
+                                if( cmd(30) = '0' and other_ss_n = '1' ) then
+                                    modify <= word(29 downto 28) = "11" ;
+                                    addr <= word(14 downto 8) ;
+                                    mask <= word(22 downto 15) ;
+                                    value <= word(7 downto 0) ;
+                                    if( word(29 downto 28) = "11" ) then
+                                        shift <= '0' & word(14 downto 8) & x"00" ;
+                                    else
+                                        shift <= '1' & word(14 downto 8) & word(7 downto 0) ;
+                                    end if ;
+                                    owned <= '1' ;
+                                    pop <= '1' ;
+                                    state <= SPI_START ;
+                                end if ;
+                        end case ;
+                    end if ;
+
+                when WAITING =>
+                    if( resize(now(module), target'length) >= target ) then
+                        state <= IDLE ;
+                    end if ;
+
+                when SPI_START =>
+                    spi_sen <= '0' ;
+                    spi_sclk <= '0' ;
+                    spi_sdio <= shift(15) ;
+                    bits <= 16 ;
+                    timer <= HALF_PERIOD-1 ;
+                    state <= SPI_LOW ;
+
+                when SPI_LOW =>
+                    if( timer = 0 ) then
+                        spi_sclk <= '1' ;
+                        rx_shift <= rx_shift(6 downto 0) & spi_sdo ;
+                        timer <= HALF_PERIOD-1 ;
+                        state <= SPI_HIGH ;
+                    else
+                        timer <= timer - 1 ;
+                    end if ;
+
+                when SPI_HIGH =>
+                    if( timer = 0 ) then
+                        spi_sclk <= '0' ;
+                        timer <= HALF_PERIOD-1 ;
+                        if( bits = 1 ) then
+                            state <= SPI_GAP ;
+                        else
+                            bits <= bits - 1 ;
+                            shift <= shift(14 downto 0) & '0' ;
+                            spi_sdio <= shift(14) ;
+                            state <= SPI_LOW ;
+                        end if ;
+                    else
+                        timer <= timer - 1 ;
+                    end if ;
+
+                -- Deselect for at least a half period between transfers
+                when SPI_GAP =>
+                    spi_sen <= '1' ;
+                    spi_sdio <= '0' ;
+                    if( timer = 0 ) then
+                        if( modify ) then
+                            modify <= false ;
+                            shift <= '1' & addr & ((rx_shift and not mask) or (value and mask)) ;
+                            state <= SPI_START ;
+                        else
+                            state <= IDLE ;
+                        end if ;
+                    else
+                        timer <= timer - 1 ;
+                    end if ;
+            end case ;
+        end if ;
+    end process ;
+
+    bus_owned <= owned ;
+
+    status(31) <= toggle ;
+    status(30) <= owned ;
+    status(29) <= '1' when state = WAITING else '0' ;
+    status(28 downto 8) <= (others =>'0') ;
+    status(7 downto 0) <= std_logic_vector(resize(FIFO_DEPTH - count, 8)) ;
+
+end architecture ;
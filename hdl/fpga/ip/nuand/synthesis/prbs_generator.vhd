@@ -0,0 +1,91 @@
+-- Copyright (c) 2015 Nuand LLC
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+
+library ieee ;
+    use ieee.std_logic_1164.all ;
+    use ieee.numeric_std.all ;
+
+-- Pseudorandom test pattern source.
+--
+-- Each sample carries the next 32-bit word of an xorshift sequence
+-- (x ^= x << 13; x ^= x >> 17; x ^= x << 5), which has a period of
+-- 2**32 - 1.  The low 16 bits of the word are presented on sample_i and the
+-- high 16 bits on sample_q, such that the host sees the word as a
+-- little-endian 32-bit value, as it does the 32-bit counter.  Every word
+-- depends only on the one before it, so the host can check each sample
+-- against its predecessor and resynchronize immediately after an error.
+--
+-- As with the signal_generator, a sample is produced every other clock and
+-- the sequence restarts from SEED whenever enable is deasserted.
+entity prbs_generator is
+  generic (
+    SEED            :   unsigned(31 downto 0) := x"00000001"
+  ) ;
+  port (
+    clock           :   in      std_logic ;
+    reset           :   in      std_logic ;
+    enable          :   in      std_logic ;
+
+    sample_i        :   out     signed(15 downto 0) ;
+    sample_q        :   out     signed(15 downto 0) ;
+    sample_valid    :   buffer  std_logic
+  ) ;
+end entity ;
+
+architecture arch of prbs_generator is
+
+    function xorshift32( x : unsigned(31 downto 0) ) return unsigned is
+        variable rv : unsigned(31 downto 0) := x ;
+    begin
+        rv := rv xor shift_left(rv, 13) ;
+        rv := rv xor shift_right(rv, 17) ;
+        rv := rv xor shift_left(rv, 5) ;
+        return rv ;
+    end function ;
+
+begin
+
+    generate_prbs : process(clock, reset)
+        variable state  :   unsigned(31 downto 0) := SEED ;
+    begin
+        if( reset = '1' ) then
+            state := SEED ;
+            sample_i <= (others =>'0') ;
+            sample_q <= (others =>'0') ;
+            sample_valid <= '0' ;
+        elsif( rising_edge(clock) ) then
+            sample_i <= signed(std_logic_vector(state(15 downto 0))) ;
+            sample_q <= signed(std_logic_vector(state(31 downto 16))) ;
+
+            if( enable = '0' ) then
+                state := SEED ;
+                sample_i <= (others =>'0') ;
+                sample_q <= (others =>'0') ;
+                sample_valid <= '0' ;
+            else
+                sample_valid <= not sample_valid ;
+                if( sample_valid = '1' ) then
+                    state := xorshift32(state) ;
+                end if ;
+            end if ;
+        end if ;
+    end process ;
+
+end architecture ;
@@ -0,0 +1,394 @@
+-- Copyright (c) 2014 Nuand LLC
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+
+library ieee ;
+    use ieee.std_logic_1164.all ;
+    use ieee.numeric_std.all ;
+    use ieee.math_real.all ;
+
+-- Averaged power spectrum.
+--
+-- Frames of 2**FFT_LOG2 samples are Hann windowed and transformed by an
+-- in-place radix-2 FFT, which scales by 1/2 per stage.  The power of each bin
+-- is averaged over 2**avg_log2 frames, and the averaged spectrum is sent out
+-- as one unsigned 32-bit word per bin, low half on out_i and high half on
+-- out_q, in natural FFT bin order.
+--
+-- Each word is round(4096 * mean(|X[k]|**2)), saturated, where X is the
+-- windowed FFT of the input in integer counts, divided by the FFT size.
+--
+-- A single butterfly unit and memory are shared, so input samples arriving
+-- while a frame is being transformed or accumulated are skipped.  A spectrum
+-- is only sent once out_ready indicates room downstream for a whole frame,
+-- after which the words are written without further flow control.
+entity psd is
+  generic (
+    FFT_LOG2        :   positive    := 8 ;
+    MAX_AVG_LOG2    :   positive    := 8
+  ) ;
+  port (
+    clock           :   in  std_logic ;
+    reset           :   in  std_logic ;
+    enable          :   in  std_logic ;
+
+    avg_log2        :   in  natural range 0 to MAX_AVG_LOG2 ;
+
+    in_i            :   in  signed(15 downto 0) ;
+    in_q            :   in  signed(15 downto 0) ;
+    in_valid        :   in  std_logic ;
+
+    out_ready       :   in  std_logic ;
+    out_i           :   out signed(15 downto 0) ;
+    out_q           :   out signed(15 downto 0) ;
+    out_valid       :   out std_logic
+  ) ;
+end entity ;
+
+architecture arch of psd is
+
+    constant N              : positive := 2**FFT_LOG2 ;
+
+    -- Samples are held with 11 extra fractional bits
+    constant DATA_WIDTH     : positive := 24 ;
+    constant INPUT_SHIFT    : natural  := 11 ;
+
+    -- Window and twiddle factors represent 1.0 as 2**COEF_SHIFT
+    constant COEF_WIDTH     : positive := 18 ;
+    constant COEF_SHIFT     : natural  := 16 ;
+
+    constant POWER_WIDTH    : positive := 2*DATA_WIDTH ;
+    constant ACC_WIDTH      : positive := POWER_WIDTH + MAX_AVG_LOG2 ;
+
+    -- Converts |X|**2 in the memory's units to the output's units
+    constant OUTPUT_SHIFT   : natural  := 2*INPUT_SHIFT - 12 ;
+
+    type data_array_t is array(natural range <>) of signed(DATA_WIDTH-1 downto 0) ;
+    type coef_array_t is array(natural range <>) of signed(COEF_WIDTH-1 downto 0) ;
+    type acc_array_t is array(natural range <>) of unsigned(ACC_WIDTH-1 downto 0) ;
+
+    function hann return coef_array_t is
+        variable rv : coef_array_t(0 to N-1) ;
+    begin
+        for n in 0 to N-1 loop
+            rv(n) := to_signed(integer(round((0.5 - 0.5*cos(2.0*MATH_PI*real(n)/real(N))) * 2.0**COEF_SHIFT)), COEF_WIDTH) ;
+        end loop ;
+        return rv ;
+    end function ;
+
+    -- e**(-j*2*pi*k/N) for the first half of the circle
+    function twiddles( imag : boolean ) return coef_array_t is
+        variable rv : coef_array_t(0 to N/2-1) ;
+        variable w  : real ;
+    begin
+        for k in 0 to N/2-1 loop
+            if( imag ) then
+                w := -sin(2.0*MATH_PI*real(k)/real(N)) ;
+            else
+                w := cos(2.0*MATH_PI*real(k)/real(N)) ;
+            end if ;
+            rv(k) := to_signed(integer(round(w * 2.0**COEF_SHIFT)), COEF_WIDTH) ;
+        end loop ;
+        return rv ;
+    end function ;
+
+    function bit_reverse( x : natural ) return natural is
+        variable u  : unsigned(FFT_LOG2-1 downto 0) := to_unsigned(x, FFT_LOG2) ;
+        variable rv : unsigned(FFT_LOG2-1 downto 0) ;
+    begin
+        for i in u'range loop
+            rv(i) := u(FFT_LOG2-1-i) ;
+        end loop ;
+        return to_integer(rv) ;
+    end function ;
+
+    constant WINDOW     :   coef_array_t(0 to N-1) := hann ;
+    constant TWIDDLE_RE :   coef_array_t(0 to N/2-1) := twiddles(false) ;
+    constant TWIDDLE_IM :   coef_array_t(0 to N/2-1) := twiddles(true) ;
+
+    type state_t is (CAPTURE, BFLY_READ_A, BFLY_READ_B, BFLY_LATCH_A,
+                     BFLY_MULTIPLY, BFLY_WRITE_A, BFLY_WRITE_B,
+                     ACC_READ, ACC_WAIT, ACC_SQUARE, ACC_WRITE,
+                     OUT_WAIT, OUT_READ, OUT_LATCH, OUT_EMIT) ;
+
+    signal state        :   state_t ;
+
+    -- Sample memory, used in place by the FFT
+    signal mem_re       :   data_array_t(0 to N-1) ;
+    signal mem_im       :   data_array_t(0 to N-1) ;
+    signal mem_raddr    :   natural range 0 to N-1 ;
+    signal mem_rdata_re :   signed(DATA_WIDTH-1 downto 0) ;
+    signal mem_rdata_im :   signed(DATA_WIDTH-1 downto 0) ;
+    signal mem_waddr    :   natural range 0 to N-1 ;
+    signal mem_wdata_re :   signed(DATA_WIDTH-1 downto 0) ;
+    signal mem_wdata_im :   signed(DATA_WIDTH-1 downto 0) ;
+    signal mem_write    :   std_logic ;
+
+    -- Power accumulators
+    signal acc          :   acc_array_t(0 to N-1) ;
+    signal acc_raddr    :   natural range 0 to N-1 ;
+    signal acc_rdata    :   unsigned(ACC_WIDTH-1 downto 0) ;
+    signal acc_waddr    :   natural range 0 to N-1 ;
+    signal acc_wdata    :   unsigned(ACC_WIDTH-1 downto 0) ;
+    signal acc_write    :   std_logic ;
+
+    signal index        :   natural range 0 to N-1 ;
+    signal stage        :   natural range 0 to FFT_LOG2-1 ;
+    signal butterfly    :   natural range 0 to N/2-1 ;
+    signal addr_a       :   natural range 0 to N-1 ;
+    signal addr_b       :   natural range 0 to N-1 ;
+    signal w_re         :   signed(COEF_WIDTH-1 downto 0) ;
+    signal w_im         :   signed(COEF_WIDTH-1 downto 0) ;
+    signal a_re         :   signed(DATA_WIDTH-1 downto 0) ;
+    signal a_im         :   signed(DATA_WIDTH-1 downto 0) ;
+    signal wb_re        :   signed(DATA_WIDTH+1 downto 0) ;
+    signal wb_im        :   signed(DATA_WIDTH+1 downto 0) ;
+
+    signal sq_re        :   unsigned(POWER_WIDTH-1 downto 0) ;
+    signal sq_im        :   unsigned(POWER_WIDTH-1 downto 0) ;
+    signal frame        :   natural range 0 to 2**MAX_AVG_LOG2-1 ;
+    signal frame_avg    :   natural range 0 to MAX_AVG_LOG2 ;
+
+begin
+
+    memory : process(clock)
+    begin
+        if( rising_edge(clock) ) then
+            if( mem_write = '1' ) then
+                mem_re(mem_waddr) <= mem_wdata_re ;
+                mem_im(mem_waddr) <= mem_wdata_im ;
+            end if ;
+            mem_rdata_re <= mem_re(mem_raddr) ;
+            mem_rdata_im <= mem_im(mem_raddr) ;
+
+            if( acc_write = '1' ) then
+                acc(acc_waddr) <= acc_wdata ;
+            end if ;
+            acc_rdata <= acc(acc_raddr) ;
+        end if ;
+    end process ;
+
+    fsm : process(clock, reset)
+        variable group  : natural range 0 to N/2-1 ;
+        variable pos    : natural range 0 to N/2-1 ;
+        variable a      : natural range 0 to N-1 ;
+        variable br_re  : signed(DATA_WIDTH+COEF_WIDTH downto 0) ;
+        variable br_im  : signed(DATA_WIDTH+COEF_WIDTH downto 0) ;
+        variable sum    : signed(DATA_WIDTH+2 downto 0) ;
+        variable windowed : signed(16+COEF_WIDTH-1 downto 0) ;
+        variable power  : unsigned(ACC_WIDTH-1 downto 0) ;
+        variable scaled : unsigned(ACC_WIDTH-1 downto 0) ;
+    begin
+        if( reset = '1' ) then
+            state <= CAPTURE ;
+            index <= 0 ;
+            stage <= 0 ;
+            butterfly <= 0 ;
+            addr_a <= 0 ;
+            addr_b <= 0 ;
+            w_re <= (others =>'0') ;
+            w_im <= (others =>'0') ;
+            a_re <= (others =>'0') ;
+            a_im <= (others =>'0') ;
+            wb_re <= (others =>'0') ;
+            wb_im <= (others =>'0') ;
+            sq_re <= (others =>'0') ;
+            sq_im <= (others =>'0') ;
+            frame <= 0 ;
+            frame_avg <= 0 ;
+            mem_raddr <= 0 ;
+            mem_waddr <= 0 ;
+            mem_wdata_re <= (others =>'0') ;
+            mem_wdata_im <= (others =>'0') ;
+            mem_write <= '0' ;
+            acc_raddr <= 0 ;
+            acc_waddr <= 0 ;
+            acc_wdata <= (others =>'0') ;
+            acc_write <= '0' ;
+            out_i <= (others =>'0') ;
+            out_q <= (others =>'0') ;
+            out_valid <= '0' ;
+        elsif( rising_edge(clock) ) then
+            mem_write <= '0' ;
+            acc_write <= '0' ;
+            out_valid <= '0' ;
+
+            if( enable = '0' ) then
+                state <= CAPTURE ;
+                index <= 0 ;
+                frame <= 0 ;
+                frame_avg <= avg_log2 ;
+            else
+                case state is
+
+                    -- Window the input into bit reversed order
+                    when CAPTURE =>
+                        if( in_valid = '1' ) then
+                            windowed := resize(in_i, 16) * WINDOW(index) ;
+                            mem_wdata_re <= resize(shift_right(windowed, COEF_SHIFT-INPUT_SHIFT), DATA_WIDTH) ;
+                            windowed := resize(in_q, 16) * WINDOW(index) ;
+                            mem_wdata_im <= resize(shift_right(windowed, COEF_SHIFT-INPUT_SHIFT), DATA_WIDTH) ;
+                            mem_waddr <= bit_reverse(index) ;
+                            mem_write <= '1' ;
+
+                            if( index = N-1 ) then
+                                index <= 0 ;
+                                stage <= 0 ;
+                                butterfly <= 0 ;
+                                state <= BFLY_READ_A ;
+                            else
+                                index <= index + 1 ;
+                            end if ;
+                        end if ;
+
+                    when BFLY_READ_A =>
+                        group := butterfly / 2**stage ;
+                        pos := butterfly mod 2**stage ;
+                        a := group * 2**(stage+1) + pos ;
+                        addr_a <= a ;
+                        addr_b <= a + 2**stage ;
+                        mem_raddr <= a ;
+                        w_re <= TWIDDLE_RE(pos * 2**(FFT_LOG2-1-stage)) ;
+                        w_im <= TWIDDLE_IM(pos * 2**(FFT_LOG2-1-stage)) ;
+                        state <= BFLY_READ_B ;
+
+                    when BFLY_READ_B =>
+                        mem_raddr <= addr_b ;
+                        state <= BFLY_LATCH_A ;
+
+                    when BFLY_LATCH_A =>
+                        a_re <= mem_rdata_re ;
+                        a_im <= mem_rdata_im ;
+                        state <= BFLY_MULTIPLY ;
+
+                    when BFLY_MULTIPLY =>
+                        br_re := resize(mem_rdata_re * w_re, br_re'length) - resize(mem_rdata_im * w_im, br_re'length) ;
+                        br_im := resize(mem_rdata_re * w_im, br_im'length) + resize(mem_rdata_im * w_re, br_im'length) ;
+                        wb_re <= resize(shift_right(br_re, COEF_SHIFT), wb_re'length) ;
+                        wb_im <= resize(shift_right(br_im, COEF_SHIFT), wb_im'length) ;
+                        state <= BFLY_WRITE_A ;
+
+                    when BFLY_WRITE_A =>
+                        sum := resize(a_re, sum'length) + wb_re ;
+                        mem_wdata_re <= resize(shift_right(sum, 1), DATA_WIDTH) ;
+                        sum := resize(a_im, sum'length) + wb_im ;
+                        mem_wdata_im <= resize(shift_right(sum, 1), DATA_WIDTH) ;
+                        mem_waddr <= addr_a ;
+                        mem_write <= '1' ;
+                        state <= BFLY_WRITE_B ;
+
+                    when BFLY_WRITE_B =>
+                        sum := resize(a_re, sum'length) - wb_re ;
+                        mem_wdata_re <= resize(shift_right(sum, 1), DATA_WIDTH) ;
+                        sum := resize(a_im, sum'length) - wb_im ;
+                        mem_wdata_im <= resize(shift_right(sum, 1), DATA_WIDTH) ;
+                        mem_waddr <= addr_b ;
+                        mem_write <= '1' ;
+                        state <= BFLY_READ_A ;
+
+                        if( butterfly = N/2-1 ) then
+                            butterfly <= 0 ;
+                            if( stage = FFT_LOG2-1 ) then
+                                index <= 0 ;
+                                state <= ACC_READ ;
+                            else
+                                stage <= stage + 1 ;
+                            end if ;
+                        else
+                            butterfly <= butterfly + 1 ;
+                        end if ;
+
+                    -- Add the power of each bin to its accumulator
+                    when ACC_READ =>
+                        mem_raddr <= index ;
+                        acc_raddr <= index ;
+                        state <= ACC_WAIT ;
+
+                    when ACC_WAIT =>
+                        state <= ACC_SQUARE ;
+
+                    when ACC_SQUARE =>
+                        sq_re <= unsigned(mem_rdata_re * mem_rdata_re) ;
+                        sq_im <= unsigned(mem_rdata_im * mem_rdata_im) ;
+                        state <= ACC_WRITE ;
+
+                    when ACC_WRITE =>
+                        power := resize(sq_re, ACC_WIDTH) + resize(sq_im, ACC_WIDTH) ;
+                        if( frame = 0 ) then
+                            acc_wdata <= power ;
+                        else
+                            acc_wdata <= acc_rdata + power ;
+                        end if ;
+                        acc_waddr <= index ;
+                        acc_write <= '1' ;
+
+                        if( index = N-1 ) then
+                            index <= 0 ;
+                            if( frame = 2**frame_avg-1 ) then
+                                frame <= 0 ;
+                                state <= OUT_WAIT ;
+                            else
+                                frame <= frame + 1 ;
+                                state <= CAPTURE ;
+                            end if ;
+                        else
+                            index <= index + 1 ;
+                            state <= ACC_READ ;
+                        end if ;
+
+                    -- Send the averaged spectrum once it fits downstream
+                    when OUT_WAIT =>
+                        if( out_ready = '1' ) then
+                            state <= OUT_READ ;
+                        end if ;
+
+                    when OUT_READ =>
+                        acc_raddr <= index ;
+                        state <= OUT_LATCH ;
+
+                    when OUT_LATCH =>
+                        state <= OUT_EMIT ;
+
+                    when OUT_EMIT =>
+                        scaled := shift_right(acc_rdata, frame_avg) ;
+                        scaled := shift_right(scaled + 2**(OUTPUT_SHIFT-1), OUTPUT_SHIFT) ;
+                        if( scaled(scaled'high downto 32) /= 0 ) then
+                            out_i <= (others =>'1') ;
+                            out_q <= (others =>'1') ;
+                        else
+                            out_i <= signed(scaled(15 downto 0)) ;
+                            out_q <= signed(scaled(31 downto 16)) ;
+                        end if ;
+                        out_valid <= '1' ;
+
+                        if( index = N-1 ) then
+                            index <= 0 ;
+                            frame_avg <= avg_log2 ;
+                            state <= CAPTURE ;
+                        else
+                            index <= index + 1 ;
+                            state <= OUT_READ ;
+                        end if ;
+
+                end case ;
+            end if ;
+        end if ;
+    end process ;
+
+end architecture ;
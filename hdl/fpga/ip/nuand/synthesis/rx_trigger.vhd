@@ -0,0 +1,195 @@
+-- Copyright (c) 2014 Nuand LLC
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+
+library ieee ;
+    use ieee.std_logic_1164.all ;
+    use ieee.numeric_std.all ;
+
+-- RX capture trigger with a pre-trigger delay line.
+--
+-- Samples are delayed by pre+1 samples, so a trigger is seen before the
+-- samples leading up to it leave the block.  Once armed, the block triggers
+-- on the first input sample with i**2 + q**2 >= threshold, or on a rising
+-- edge of ext_trigger, and then raises out_keep for the pre+1+post samples
+-- that follow.  out_timestamp is delayed to match the samples.
+--
+-- A capture is armed by a rising edge of arm, and is re-armed after each
+-- capture while rearm is high.  Triggers while a capture is in progress are
+-- ignored.  pre is limited to 2**DEPTH_LOG2-2.
+--
+-- While enable is low the samples and timestamp pass through undelayed,
+-- out_keep is held high, and the trigger is disarmed.
+entity rx_trigger is
+  generic (
+    DEPTH_LOG2      :   positive    := 10 ;
+    MAX_RATE_LOG2   :   positive    := 7
+  ) ;
+  port (
+    clock           :   in  std_logic ;
+    reset           :   in  std_logic ;
+
+    enable          :   in  std_logic ;
+    source_ext      :   in  std_logic ;
+    rearm           :   in  std_logic ;
+    arm             :   in  std_logic ;
+
+    threshold       :   in  unsigned(31 downto 0) ;
+    pre             :   in  unsigned(DEPTH_LOG2-1 downto 0) ;
+    post            :   in  unsigned(31 downto 0) ;
+    ext_trigger     :   in  std_logic ;
+
+    -- Decimation applied to the samples, relating them to the timestamp
+    rate_log2       :   in  natural range 0 to MAX_RATE_LOG2 ;
+    timestamp       :   in  unsigned(63 downto 0) ;
+
+    in_i            :   in  signed(15 downto 0) ;
+    in_q            :   in  signed(15 downto 0) ;
+    in_valid        :   in  std_logic ;
+
+    out_i           :   out signed(15 downto 0) ;
+    out_q           :   out signed(15 downto 0) ;
+    out_valid       :   out std_logic ;
+    out_timestamp   :   out unsigned(63 downto 0) ;
+    out_keep        :   out std_logic ;
+
+    armed           :   buffer std_logic ;
+    triggers        :   buffer unsigned(15 downto 0)
+  ) ;
+end entity ;
+
+architecture arch of rx_trigger is
+
+    constant PRE_MAX    :   natural := 2**DEPTH_LOG2 - 2 ;
+
+    type ram_t is array(0 to 2**DEPTH_LOG2-1) of std_logic_vector(31 downto 0) ;
+    signal ram          :   ram_t ;
+
+    signal wr_addr      :   unsigned(DEPTH_LOG2-1 downto 0) ;
+    signal delay        :   unsigned(DEPTH_LOG2-1 downto 0) ;
+    signal delayed      :   std_logic_vector(31 downto 0) ;
+    signal delayed_valid:   std_logic ;
+
+    signal power        :   unsigned(32 downto 0) ;
+    signal power_valid  :   std_logic ;
+
+    signal arm_q        :   std_logic ;
+    signal ext_q        :   std_logic ;
+    signal remaining    :   unsigned(32 downto 0) ;
+
+begin
+
+    -- Delay by pre+1 samples, so the read and write addresses always differ
+    delay <= pre + 1 when pre < PRE_MAX else to_unsigned(PRE_MAX + 1, delay'length) ;
+
+    delay_line : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            wr_addr <= (others =>'0') ;
+            delayed_valid <= '0' ;
+        elsif( rising_edge(clock) ) then
+            delayed_valid <= in_valid ;
+            if( in_valid = '1' ) then
+                ram(to_integer(wr_addr)) <= std_logic_vector(in_q & in_i) ;
+                delayed <= ram(to_integer(wr_addr - delay)) ;
+                wr_addr <= wr_addr + 1 ;
+            end if ;
+        end if ;
+    end process ;
+
+    measure_power : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            power <= (others =>'0') ;
+            power_valid <= '0' ;
+        elsif( rising_edge(clock) ) then
+            power_valid <= in_valid ;
+            if( in_valid = '1' ) then
+                power <= resize(unsigned(in_i * in_i), power'length) +
+                         resize(unsigned(in_q * in_q), power'length) ;
+            end if ;
+        end if ;
+    end process ;
+
+    -- The output side of the capture window, counted in delayed samples
+    detect : process(clock, reset)
+        variable hit : boolean ;
+    begin
+        if( reset = '1' ) then
+            arm_q <= '0' ;
+            ext_q <= '0' ;
+            armed <= '0' ;
+            triggers <= (others =>'0') ;
+            remaining <= (others =>'0') ;
+        elsif( rising_edge(clock) ) then
+            arm_q <= arm ;
+            ext_q <= ext_trigger ;
+
+            if( source_ext = '1' ) then
+                hit := ext_q = '0' and ext_trigger = '1' ;
+            else
+                hit := power_valid = '1' and power >= threshold ;
+            end if ;
+
+            if( enable = '0' ) then
+                armed <= '0' ;
+                triggers <= (others =>'0') ;
+                remaining <= (others =>'0') ;
+            elsif( armed = '1' and hit ) then
+                armed <= '0' ;
+                triggers <= triggers + 1 ;
+                remaining <= resize(delay, remaining'length) + post ;
+            else
+                if( delayed_valid = '1' and remaining /= 0 ) then
+                    remaining <= remaining - 1 ;
+                end if ;
+                if( arm_q = '0' and arm = '1' ) then
+                    armed <= '1' ;
+                elsif( rearm = '1' and remaining = 0 ) then
+                    armed <= '1' ;
+                end if ;
+            end if ;
+        end if ;
+    end process ;
+
+    present : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            out_i <= (others =>'0') ;
+            out_q <= (others =>'0') ;
+            out_valid <= '0' ;
+            out_timestamp <= (others =>'0') ;
+        elsif( rising_edge(clock) ) then
+            if( enable = '1' ) then
+                out_i <= signed(delayed(15 downto 0)) ;
+                out_q <= signed(delayed(31 downto 16)) ;
+                out_valid <= delayed_valid ;
+                out_timestamp <= timestamp - shift_left(resize(delay, 64), rate_log2) ;
+            else
+                out_i <= in_i ;
+                out_q <= in_q ;
+                out_valid <= in_valid ;
+                out_timestamp <= timestamp ;
+            end if ;
+        end if ;
+    end process ;
+
+    out_keep <= '1' when enable = '0' or remaining /= 0 else '0' ;
+
+end architecture ;
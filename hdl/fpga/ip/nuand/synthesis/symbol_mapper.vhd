@@ -1,10 +1,256 @@
+-- Copyright (c) 2015 Nuand LLC
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
 
-library ieee;
-    use ieee.std_logic_1164.all;
-    use ieee.numeric_std.all;
+library ieee ;
+    use ieee.std_logic_1164.all ;
+    use ieee.numeric_std.all ;
+    use ieee.math_real.all ;
 
+library work ;
+    use work.constellation_mapper_p.all ;
 
+-- Map packed PSK symbols read from the TX sample FIFO to root raised cosine
+-- shaped samples, SPS samples per symbol.  Samples are produced on the same
+-- read_enable handshake as the fifo_reader, so the interpolator may follow.
 entity symbol_mapper is
-    generic(
+  generic (
+    SPS         :   positive    := 4 ;
+    SPAN        :   positive    := 6 ;          -- Pulse length, in symbols
+    ROLLOFF     :   real        := 0.35 ;
+    SCALE       :   real        := 1280.0       -- Amplitude of the symbols
+  ) ;
+  port (
+    clock       :   in      std_logic ;
+    reset       :   in      std_logic ;
+    enable      :   in      std_logic ;
 
-        );
+    -- "00" BPSK, "01" QPSK and "10" 8-PSK, Gray coded.  Each FIFO word holds
+    -- 32, 16 or 10 symbols respectively, starting from its least significant
+    -- bits.
+    modulation  :   in      std_logic_vector(1 downto 0) ;
+
+    read_enable :   in      std_logic := '1' ;
+
+    fifo_empty  :   in      std_logic ;
+    fifo_data   :   in      std_logic_vector(31 downto 0) ;
+    fifo_read   :   buffer  std_logic ;
+
+    out_i       :   buffer  signed(15 downto 0) ;
+    out_q       :   buffer  signed(15 downto 0) ;
+    out_valid   :   buffer  std_logic
+  ) ;
+end entity ;
+
+architecture arch of symbol_mapper is
+
+    -- Root raised cosine taps, normalized for a peak of 1.0
+    function rrc( sps : positive ; span : positive ; beta : real ) return real_array_t is
+        variable rv : real_array_t(0 to sps*span) ;
+        variable t  : real ;
+        variable peak : real ;
+    begin
+        for i in rv'range loop
+            t := real(i - sps*span/2) / real(sps) ;
+            if( abs(t) < 1.0e-9 ) then
+                rv(i) := 1.0 - beta + 4.0*beta/MATH_PI ;
+            elsif( abs(abs(t) - 1.0/(4.0*beta)) < 1.0e-9 ) then
+                rv(i) := beta/sqrt(2.0) * ((1.0 + 2.0/MATH_PI)*sin(MATH_PI/(4.0*beta)) +
+                                           (1.0 - 2.0/MATH_PI)*cos(MATH_PI/(4.0*beta))) ;
+            else
+                rv(i) := (sin(MATH_PI*t*(1.0 - beta)) + 4.0*beta*t*cos(MATH_PI*t*(1.0 + beta))) /
+                         (MATH_PI*t*(1.0 - (4.0*beta*t)**2)) ;
+            end if ;
+        end loop ;
+
+        peak := rv(sps*span/2) ;
+        for i in rv'range loop
+            rv(i) := rv(i) / peak ;
+        end loop ;
+        return rv ;
+    end function ;
+
+    function saturate( x : signed ; bits : positive ) return signed is
+        constant MAX : signed(x'range) := to_signed(2**(bits-1)-1, x'length) ;
+        constant MIN : signed(x'range) := to_signed(-(2**(bits-1)), x'length) ;
+    begin
+        if( x > MAX ) then
+            return MAX ;
+        elsif( x < MIN ) then
+            return MIN ;
+        else
+            return x ;
+        end if ;
+    end function ;
+
+    constant PULSE : real_array_t := rrc(SPS, SPAN, ROLLOFF) ;
+
+    signal bits_per_symbol  :   natural range 1 to 3 ;
+    signal symbols_per_word :   natural range 1 to 32 ;
+
+    -- Symbols being sent, and the word read after them
+    signal word             :   std_logic_vector(31 downto 0) ;
+    signal symbols_left     :   natural range 0 to 32 ;
+    signal next_word        :   std_logic_vector(31 downto 0) ;
+    signal next_full        :   std_logic ;
+    signal fifo_read_q      :   std_logic ;
+
+    -- The mapper registers its output, so the symbol at the bottom of word
+    -- is available the clock after word changes
+    signal map_in           :   constellation_mapper_inputs_t ;
+    signal map_out          :   constellation_mapper_outputs_t ;
+    signal map_ready        :   std_logic ;
+
+    signal sample_read      :   std_logic ;
+    signal phase            :   natural range 0 to SPS-1 ;
+    signal take             :   std_logic ;
+
+    signal stuffed_i        :   signed(15 downto 0) ;
+    signal stuffed_q        :   signed(15 downto 0) ;
+    signal fir_i            :   signed(15 downto 0) ;
+    signal fir_q            :   signed(15 downto 0) ;
+    signal fir_valid        :   std_logic ;
+
+begin
+
+    bits_per_symbol <= 1 when modulation = "00" else
+                       3 when modulation = "10" else
+                       2 ;
+
+    symbols_per_word <= 32 when modulation = "00" else
+                        10 when modulation = "10" else
+                        16 ;
+
+    map_in.modulation <= PSK_2 when modulation = "00" else
+                         PSK_8_GRAY when modulation = "10" else
+                         PSK_4 ;
+    map_in.bits <= std_logic_vector(resize(unsigned(word(2 downto 0)), map_in.bits'length)) ;
+    map_in.valid <= '1' ;
+
+    U_mapper : entity work.constellation_mapper
+      generic map (
+        SCALE_FACTOR    =>  SCALE,
+        MODULATIONS     =>  (PSK_2, PSK_4, PSK_8_GRAY)
+      ) port map (
+        clock           =>  clock,
+        inputs          =>  map_in,
+        outputs         =>  map_out
+      ) ;
+
+    -- Keep a word waiting behind the one being sent.  The FIFO presents a
+    -- word on the clock after it is read.
+    fifo_read <= '1' when enable = '1' and fifo_empty = '0' and next_full = '0' and fifo_read_q = '0' else '0' ;
+
+    -- Produce one sample for each read, every other clock at most
+    read_samples : process( clock, reset )
+    begin
+        if( reset = '1' ) then
+            sample_read <= '0' ;
+        elsif( rising_edge( clock ) ) then
+            sample_read <= '0' ;
+            if( enable = '1' and read_enable = '1' and sample_read = '0' ) then
+                sample_read <= '1' ;
+            end if ;
+        end if ;
+    end process ;
+
+    -- A symbol starts on the first sample of each symbol period, should one
+    -- be available, and zeros are sent otherwise
+    take <= '1' when sample_read = '1' and phase = 0 and symbols_left /= 0 and map_ready = '1' else '0' ;
+
+    stuffed_i <= map_out.symbol.re when take = '1' else (others =>'0') ;
+    stuffed_q <= map_out.symbol.im when take = '1' else (others =>'0') ;
+
+    consume_symbols : process( clock, reset )
+    begin
+        if( reset = '1' ) then
+            word <= (others =>'0') ;
+            symbols_left <= 0 ;
+            next_word <= (others =>'0') ;
+            next_full <= '0' ;
+            fifo_read_q <= '0' ;
+            map_ready <= '0' ;
+            phase <= 0 ;
+        elsif( rising_edge( clock ) ) then
+            fifo_read_q <= fifo_read ;
+            map_ready <= '1' ;
+            if( enable = '0' ) then
+                symbols_left <= 0 ;
+                next_full <= '0' ;
+                phase <= 0 ;
+            else
+                if( sample_read = '1' ) then
+                    if( phase = SPS-1 ) then
+                        phase <= 0 ;
+                    else
+                        phase <= phase + 1 ;
+                    end if ;
+                end if ;
+
+                if( take = '1' and symbols_left > 1 ) then
+                    word <= std_logic_vector(shift_right(unsigned(word), bits_per_symbol)) ;
+                    symbols_left <= symbols_left - 1 ;
+                    map_ready <= '0' ;
+                elsif( (take = '1' or symbols_left = 0) and next_full = '1' ) then
+                    word <= next_word ;
+                    symbols_left <= symbols_per_word ;
+                    next_full <= '0' ;
+                    map_ready <= '0' ;
+                elsif( take = '1' ) then
+                    symbols_left <= 0 ;
+                end if ;
+
+                if( fifo_read_q = '1' ) then
+                    next_word <= fifo_data ;
+                    next_full <= '1' ;
+                end if ;
+            end if ;
+        end if ;
+    end process ;
+
+    -- Shape the zero-stuffed symbols
+    U_fir_i : entity work.fir_filter(systolic)
+      generic map (
+        H               =>  PULSE
+      ) port map (
+        clock           =>  clock,
+        reset           =>  reset,
+        in_sample       =>  stuffed_i,
+        in_valid        =>  sample_read,
+        out_sample      =>  fir_i,
+        out_valid       =>  fir_valid
+      ) ;
+
+    U_fir_q : entity work.fir_filter(systolic)
+      generic map (
+        H               =>  PULSE
+      ) port map (
+        clock           =>  clock,
+        reset           =>  reset,
+        in_sample       =>  stuffed_q,
+        in_valid        =>  sample_read,
+        out_sample      =>  fir_q,
+        out_valid       =>  open
+      ) ;
+
+    out_i <= saturate(fir_i, 12) ;
+    out_q <= saturate(fir_q, 12) ;
+    out_valid <= fir_valid ;
+
+end architecture ;
@@ -0,0 +1,177 @@
+-- Copyright (c) 2015 Nuand LLC
+--
+-- Permission is hereby granted, free of charge, to any person obtaining a copy
+-- of this software and associated documentation files (the "Software"), to deal
+-- in the Software without restriction, including without limitation the rights
+-- to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+-- copies of the Software, and to permit persons to whom the Software is
+-- furnished to do so, subject to the following conditions:
+--
+-- The above copyright notice and this permission notice shall be included in
+-- all copies or substantial portions of the Software.
+--
+-- THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+-- IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+-- FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+-- AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+-- LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+-- OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+-- THE SOFTWARE.
+
+library ieee ;
+    use ieee.std_logic_1164.all ;
+    use ieee.numeric_std.all ;
+
+-- Timestamp latch on an external event, such as a 1PPS input.
+--
+-- The ext_event input is synchronized to clock, and each of its rising
+-- edges, or falling edges when falling is high, is detected a fixed 3 clocks
+-- after it occurs.  While enable is high, every detected edge copies
+-- timestamp into latched and increments edges.
+--
+-- A change of the arm toggle arms a one-shot action, performed on the next
+-- detected edge: "01" resets the counter, and "10" loads it with the staged
+-- value, by pulsing load for one clock with load_value.  The counter takes
+-- the new value on the clock following the detected edge.  That edge is also
+-- latched, regardless of enable, and armed falls once it has been handled.
+--
+-- The load value is staged 16 bits at a time.  A change of the stage toggle
+-- stores stage_data in the chunk selected by stage_sel, and staged follows
+-- the stage toggle once it has been stored.  stage_sel, stage_data and the
+-- other quasi-static controls must be stable when a toggle changes.
+entity time_latch is
+  port (
+    clock           :   in  std_logic ;
+    reset           :   in  std_logic ;
+
+    ext_event       :   in  std_logic ;
+    falling         :   in  std_logic ;
+    enable          :   in  std_logic ;
+
+    action          :   in  std_logic_vector(1 downto 0) ;
+    arm             :   in  std_logic ;
+    armed           :   out std_logic ;
+
+    stage           :   in  std_logic ;
+    stage_sel       :   in  unsigned(1 downto 0) ;
+    stage_data      :   in  std_logic_vector(15 downto 0) ;
+    staged          :   buffer std_logic ;
+
+    timestamp       :   in  unsigned(63 downto 0) ;
+    latched         :   buffer unsigned(63 downto 0) ;
+    edges           :   buffer unsigned(7 downto 0) ;
+
+    load            :   out std_logic ;
+    load_value      :   out unsigned(63 downto 0)
+  ) ;
+end entity ;
+
+architecture arch of time_latch is
+
+    signal event_sync   :   std_logic ;
+    signal event_prev   :   std_logic ;
+    signal edge         :   std_logic ;
+
+    signal arm_sync     :   std_logic ;
+    signal arm_ack      :   std_logic ;
+    signal stage_sync   :   std_logic ;
+
+    signal staging      :   unsigned(63 downto 0) ;
+
+begin
+
+    U_event_sync : entity work.synchronizer
+      generic map (
+        RESET_LEVEL         =>  '0'
+      ) port map (
+        reset               =>  reset,
+        clock               =>  clock,
+        async               =>  ext_event,
+        sync                =>  event_sync
+      ) ;
+
+    U_arm_sync : entity work.synchronizer
+      generic map (
+        RESET_LEVEL         =>  '0'
+      ) port map (
+        reset               =>  reset,
+        clock               =>  clock,
+        async               =>  arm,
+        sync                =>  arm_sync
+      ) ;
+
+    U_stage_sync : entity work.synchronizer
+      generic map (
+        RESET_LEVEL         =>  '0'
+      ) port map (
+        reset               =>  reset,
+        clock               =>  clock,
+        async               =>  stage,
+        sync                =>  stage_sync
+      ) ;
+
+    edge  <= (event_sync and not event_prev) when falling = '0' else
+             (event_prev and not event_sync) ;
+
+    armed <= arm_sync xor arm_ack ;
+
+    detect : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            event_prev <= '0' ;
+        elsif( rising_edge(clock) ) then
+            event_prev <= event_sync ;
+        end if ;
+    end process ;
+
+    store : process(clock, reset)
+        variable chunk : natural range 0 to 3 ;
+    begin
+        if( reset = '1' ) then
+            staging <= (others => '0') ;
+            staged <= '0' ;
+        elsif( rising_edge(clock) ) then
+            if( stage_sync /= staged ) then
+                chunk := to_integer(stage_sel) ;
+                staging(chunk*16+15 downto chunk*16) <= unsigned(stage_data) ;
+                staged <= stage_sync ;
+            end if ;
+        end if ;
+    end process ;
+
+    capture : process(clock, reset)
+    begin
+        if( reset = '1' ) then
+            latched <= (others => '0') ;
+            edges <= (others => '0') ;
+            arm_ack <= '0' ;
+            load <= '0' ;
+            load_value <= (others => '0') ;
+        elsif( rising_edge(clock) ) then
+            load <= '0' ;
+
+            if( edge = '1' ) then
+                if( enable = '1' or arm_sync /= arm_ack ) then
+                    latched <= timestamp ;
+                    edges <= edges + 1 ;
+                end if ;
+
+                if( arm_sync /= arm_ack ) then
+                    arm_ack <= arm_sync ;
+
+                    case action is
+                        when "01" =>
+                            load <= '1' ;
+                            load_value <= (others => '0') ;
+                        when "10" =>
+                            load <= '1' ;
+                            load_value <= staging ;
+                        when others =>
+                            null ;
+                    end case ;
+                end if ;
+            end if ;
+        end if ;
+    end process ;
+
+end architecture ;
@@ -56,6 +56,22 @@ architecture hosted_bladerf of bladerf is
         xb_gpio_dir_export              :   out std_logic_vector(31 downto 0);
         correction_rx_phase_gain_export :   out std_logic_vector(31 downto 0);
         correction_tx_phase_gain_export :   out std_logic_vector(31 downto 0);
+        rx_nco_dphase_export            :   out std_logic_vector(31 downto 0);
+        rx_track_dc_export              :   in  std_logic_vector(31 downto 0) := (others => '0');
+        rx_track_iq_export              :   in  std_logic_vector(31 downto 0) := (others => '0');
+        sample_fmt_export               :   out std_logic_vector(31 downto 0);
+        fifo_levels_export              :   in  std_logic_vector(31 downto 0) := (others => '0');
+        fifo_depth_export               :   in  std_logic_vector(31 downto 0) := (others => '0');
+        rx_trigger_ctrl_export          :   out std_logic_vector(31 downto 0);
+        rx_trigger_level_export         :   out std_logic_vector(31 downto 0);
+        rx_trigger_post_export          :   out std_logic_vector(31 downto 0);
+        rx_trigger_status_export        :   in  std_logic_vector(31 downto 0) := (others => '0');
+        lms_spi_cmd_export              :   out std_logic_vector(31 downto 0);
+        lms_spi_status_export           :   in  std_logic_vector(31 downto 0) := (others => '0');
+        tx_late_export                  :   in  std_logic_vector(31 downto 0) := (others => '0');
+        tx_underflows_export            :   in  std_logic_vector(31 downto 0) := (others => '0');
+        time_latch_ctrl_export          :   out std_logic_vector(31 downto 0);
+        time_latch_status_export        :   in  std_logic_vector(31 downto 0) := (others => '0');
         time_tamer_synchronize          :   out std_logic;
         time_tamer_tx_clock             :   in  std_logic ;
         time_tamer_tx_reset             :   in  std_logic ;
@@ -70,11 +86,27 @@ architecture hosted_bladerf of bladerf is
     alias tx_clock  is c4_tx_clock ;
     alias rx_clock  is lms_rx_clock_out ;
 
-    type rx_mux_mode_t is (RX_MUX_NORMAL, RX_MUX_12BIT_COUNTER, RX_MUX_32BIT_COUNTER, RX_MUX_ENTROPY, RX_MUX_DIGITAL_LOOPBACK) ;
+    type rx_mux_mode_t is (RX_MUX_NORMAL, RX_MUX_12BIT_COUNTER, RX_MUX_32BIT_COUNTER, RX_MUX_ENTROPY, RX_MUX_DIGITAL_LOOPBACK, RX_MUX_PRBS) ;
 
     signal rx_mux_sel       : unsigned(2 downto 0) ;
     signal rx_mux_mode      : rx_mux_mode_t ;
 
+    -- Decimation and interpolation factors are 2**rate_log2
+    constant MAX_RATE_LOG2  : positive := 7 ;
+
+    signal rx_rate_sel      : unsigned(2 downto 0) ;
+    signal tx_rate_sel      : unsigned(2 downto 0) ;
+    signal rx_rate_log2     : natural range 0 to MAX_RATE_LOG2 ;
+    signal tx_rate_log2     : natural range 0 to MAX_RATE_LOG2 ;
+
+    -- Power spectra are averaged over 2**psd_avg_log2 frames
+    constant PSD_FFT_LOG2       : positive := 8 ;
+    constant PSD_MAX_AVG_LOG2   : positive := 8 ;
+
+    signal psd_en           : std_logic ;
+    signal psd_avg_sel      : unsigned(3 downto 0) ;
+    signal psd_avg_log2     : natural range 0 to PSD_MAX_AVG_LOG2 ;
+
     signal \80MHz\          : std_logic ;
     signal \80MHz locked\   : std_logic ;
 
@@ -87,6 +119,34 @@ architecture hosted_bladerf of bladerf is
     signal correction_rx_phase_gain :  std_logic_vector(31 downto 0);
     signal correction_tx_phase_gain :  std_logic_vector(31 downto 0);
 
+    signal nios_rx_nco_dphase : std_logic_vector(31 downto 0);
+    signal nios_rx_track_dc   : std_logic_vector(31 downto 0);
+    signal nios_rx_track_iq   : std_logic_vector(31 downto 0);
+    signal nios_sample_fmt    : std_logic_vector(31 downto 0);
+    signal nios_fifo_levels   : std_logic_vector(31 downto 0);
+    signal nios_fifo_depth    : std_logic_vector(31 downto 0);
+    signal nios_rx_trigger_ctrl   : std_logic_vector(31 downto 0);
+    signal nios_rx_trigger_level  : std_logic_vector(31 downto 0);
+    signal nios_rx_trigger_post   : std_logic_vector(31 downto 0);
+    signal nios_rx_trigger_status : std_logic_vector(31 downto 0);
+    signal nios_lms_spi_cmd       : std_logic_vector(31 downto 0);
+    signal nios_lms_spi_status    : std_logic_vector(31 downto 0);
+    signal nios_tx_late           : std_logic_vector(31 downto 0);
+    signal nios_tx_underflows     : std_logic_vector(31 downto 0);
+    signal nios_time_latch_ctrl   : std_logic_vector(31 downto 0);
+    signal nios_time_latch_status : std_logic_vector(31 downto 0);
+
+    -- LMS SPI bus, shared by the NIOS SPI master and the timed command engine
+    signal nios_lms_sclk    : std_logic ;
+    signal nios_lms_sen     : std_logic ;
+    signal nios_lms_sdio    : std_logic ;
+    signal spi_engine_reset : std_logic ;
+    signal spi_engine_owned : std_logic ;
+    signal spi_engine_sclk  : std_logic ;
+    signal spi_engine_sen   : std_logic ;
+    signal spi_engine_sdio  : std_logic ;
+    signal rx_nco_dphase      : signed(31 downto 0);
+
     signal i2c_scl_in       : std_logic ;
     signal i2c_scl_out      : std_logic ;
     signal i2c_scl_oen      : std_logic ;
@@ -103,14 +163,14 @@ architecture hosted_bladerf of bladerf is
         wreq    :   std_logic ;
         wempty  :   std_logic ;
         wfull   :   std_logic ;
-        wused   :   std_logic_vector(11 downto 0) ;
+        wused   :   std_logic_vector(FIFO_DEPTH_LOG2-1 downto 0) ;
 
         rclock  :   std_logic ;
         rdata   :   std_logic_vector(31 downto 0) ;
         rreq    :   std_logic ;
         rempty  :   std_logic ;
         rfull   :   std_logic ;
-        rused   :   std_logic_vector(11 downto 0) ;
+        rused   :   std_logic_vector(FIFO_DEPTH_LOG2-1 downto 0) ;
     end record ;
 
     signal rx_sample_fifo   : fifo_t ;
@@ -124,14 +184,14 @@ architecture hosted_bladerf of bladerf is
         wreq    :   std_logic ;
         wempty  :   std_logic ;
         wfull   :   std_logic ;
-        wused   :   std_logic_vector(4 downto 0) ;
+        wused   :   std_logic_vector(FIFO_DEPTH_LOG2-8 downto 0) ;
 
         rclock  :   std_logic ;
         rdata   :   std_logic_vector(127 downto 0) ;
         rreq    :   std_logic ;
         rempty  :   std_logic ;
         rfull   :   std_logic ;
-        rused   :   std_logic_vector(2 downto 0) ;
+        rused   :   std_logic_vector(FIFO_DEPTH_LOG2-10 downto 0) ;
     end record ;
     signal tx_meta_fifo     : meta_fifo_tx_t ;
 
@@ -143,14 +203,14 @@ architecture hosted_bladerf of bladerf is
         wreq    :   std_logic ;
         wempty  :   std_logic ;
         wfull   :   std_logic ;
-        wused   :   std_logic_vector(4 downto 0) ;
+        wused   :   std_logic_vector(FIFO_DEPTH_LOG2-8 downto 0) ;
 
         rclock  :   std_logic ;
         rdata   :   std_logic_vector(31 downto 0) ;
         rreq    :   std_logic ;
         rempty  :   std_logic ;
         rfull   :   std_logic ;
-        rused   :   std_logic_vector(6 downto 0) ;
+        rused   :   std_logic_vector(FIFO_DEPTH_LOG2-6 downto 0) ;
     end record ;
     signal rx_meta_fifo     : meta_fifo_rx_t ;
 
@@ -171,11 +231,34 @@ architecture hosted_bladerf of bladerf is
 
     signal meta_en_tx       : std_logic ;
     signal meta_en_rx       : std_logic ;
+    signal pack_en_tx       : std_logic ;
+    signal pack_en_rx       : std_logic ;
+    signal sc8_en_tx        : std_logic ;
+    signal sc8_en_rx        : std_logic ;
+    signal sc8_shift_tx     : unsigned(3 downto 0) ;
+    signal sc8_shift_rx     : unsigned(3 downto 0) ;
+    signal sym_en_tx        : std_logic ;
+    signal sym_mod_tx       : std_logic_vector(1 downto 0) ;
     signal meta_en_fx3      : std_logic ;
     signal tx_timestamp     : unsigned(63 downto 0) ;
     signal rx_timestamp     : unsigned(63 downto 0) ;
     signal timestamp_sync   : std_logic ;
 
+    -- Timestamp latch on an external event
+    signal time_latch_event     : std_logic ;
+    signal rx_latch_time        : unsigned(63 downto 0) ;
+    signal rx_latch_edges       : unsigned(7 downto 0) ;
+    signal rx_latch_armed       : std_logic ;
+    signal rx_latch_staged      : std_logic ;
+    signal rx_latch_load        : std_logic ;
+    signal rx_latch_load_value  : unsigned(63 downto 0) ;
+    signal tx_latch_time        : unsigned(63 downto 0) ;
+    signal tx_latch_edges       : unsigned(7 downto 0) ;
+    signal tx_latch_armed       : std_logic ;
+    signal tx_latch_staged      : std_logic ;
+    signal tx_latch_load        : std_logic ;
+    signal tx_latch_load_value  : unsigned(63 downto 0) ;
+
     signal rx_sample_i      : signed(15 downto 0) ;
     signal rx_sample_q      : signed(15 downto 0) ;
     signal rx_sample_valid  : std_logic ;
@@ -185,6 +268,10 @@ architecture hosted_bladerf of bladerf is
     signal rx_gen_q         : signed(15 downto 0) ;
     signal rx_gen_valid     : std_logic ;
 
+    signal rx_prbs_i        : signed(15 downto 0) ;
+    signal rx_prbs_q        : signed(15 downto 0) ;
+    signal rx_prbs_valid    : std_logic ;
+
     signal rx_entropy_i     : signed(15 downto 0) := (others =>'0') ;
     signal rx_entropy_q     : signed(15 downto 0) := (others =>'0') ;
     signal rx_entropy_valid : std_logic := '0' ;
@@ -192,6 +279,23 @@ architecture hosted_bladerf of bladerf is
     signal tx_sample_raw_i : signed(15 downto 0);
     signal tx_sample_raw_q : signed(15 downto 0);
     signal tx_sample_raw_valid : std_logic;
+    signal tx_sample_raw_request : std_logic;
+
+    signal tx_reader_enable : std_logic ;
+    signal tx_reader_i      : signed(15 downto 0) ;
+    signal tx_reader_q      : signed(15 downto 0) ;
+    signal tx_reader_valid  : std_logic ;
+    signal tx_reader_fifo_read : std_logic ;
+
+    signal tx_sym_enable    : std_logic ;
+    signal tx_sym_i         : signed(15 downto 0) ;
+    signal tx_sym_q         : signed(15 downto 0) ;
+    signal tx_sym_valid     : std_logic ;
+    signal tx_sym_fifo_read : std_logic ;
+
+    signal tx_sample_interp_i : signed(15 downto 0);
+    signal tx_sample_interp_q : signed(15 downto 0);
+    signal tx_sample_interp_valid : std_logic;
 
     signal tx_sample_i      : signed(15 downto 0) ;
     signal tx_sample_q      : signed(15 downto 0) ;
@@ -214,6 +318,11 @@ architecture hosted_bladerf of bladerf is
     signal rx_overflow_led      :   std_logic ;
     signal rx_overflow_count    :   unsigned(63 downto 0) ;
 
+    signal rx_fifo_high_water   :   unsigned(15 downto 0) ;
+    signal tx_fifo_low_water    :   unsigned(15 downto 0) ;
+    signal tx_late_count        :   unsigned(15 downto 0) ;
+    signal tx_late_max          :   unsigned(15 downto 0) ;
+
     signal lms_rx_data_reg      :   signed(11 downto 0) ;
     signal lms_rx_iq_select_reg :   std_logic ;
 
@@ -225,6 +334,55 @@ architecture hosted_bladerf of bladerf is
     signal rx_sample_corrected_q : signed(15 downto 0);
     signal rx_sample_corrected_valid : std_logic;
 
+    signal rx_track_dc_en : std_logic ;
+    signal rx_track_iq_en : std_logic ;
+    signal rx_track_dc_i : signed(15 downto 0);
+    signal rx_track_dc_q : signed(15 downto 0);
+    signal rx_track_gain : signed(15 downto 0);
+    signal rx_track_phase : signed(15 downto 0);
+
+    signal rx_sample_tracked_i : signed(15 downto 0);
+    signal rx_sample_tracked_q : signed(15 downto 0);
+    signal rx_sample_tracked_valid : std_logic;
+
+    signal rx_sample_ddc_i : signed(15 downto 0);
+    signal rx_sample_ddc_q : signed(15 downto 0);
+    signal rx_sample_ddc_valid : std_logic;
+
+    signal rx_sample_decim_i : signed(15 downto 0);
+    signal rx_sample_decim_q : signed(15 downto 0);
+    signal rx_sample_decim_valid : std_logic;
+
+    signal rx_psd_i : signed(15 downto 0);
+    signal rx_psd_q : signed(15 downto 0);
+    signal rx_psd_valid : std_logic;
+    signal rx_psd_ready : std_logic;
+
+    signal rx_writer_i : signed(15 downto 0);
+    signal rx_writer_q : signed(15 downto 0);
+    signal rx_writer_valid : std_logic;
+    signal rx_writer_timestamp : unsigned(63 downto 0);
+    signal rx_writer_keep : std_logic;
+
+    -- Pre-trigger samples are held in a 2**RX_TRIGGER_DEPTH_LOG2 sample RAM
+    constant RX_TRIGGER_DEPTH_LOG2 : positive := 10 ;
+
+    signal rx_trigger_en        : std_logic ;
+    signal rx_trigger_ext_src   : std_logic ;
+    signal rx_trigger_rearm     : std_logic ;
+    signal rx_trigger_arm       : std_logic ;
+    signal rx_trigger_ext       : std_logic ;
+    signal rx_trigger_level     : unsigned(31 downto 0) ;
+    signal rx_trigger_pre       : unsigned(RX_TRIGGER_DEPTH_LOG2-1 downto 0) ;
+    signal rx_trigger_post      : unsigned(31 downto 0) ;
+    signal rx_trigger_i         : signed(15 downto 0) ;
+    signal rx_trigger_q         : signed(15 downto 0) ;
+    signal rx_trigger_valid     : std_logic ;
+    signal rx_trigger_timestamp : unsigned(63 downto 0) ;
+    signal rx_trigger_keep      : std_logic ;
+    signal rx_trigger_armed     : std_logic ;
+    signal rx_trigger_count     : unsigned(15 downto 0) ;
+
     signal led1_blink : std_logic;
 
     signal nios_sdo : std_logic;
@@ -320,6 +478,126 @@ begin
           ) ;
     end generate ;
 
+    generate_rate_sel : for i in rx_rate_sel'range generate
+        U_rx_rate : entity work.synchronizer
+          generic map (
+            RESET_LEVEL         =>  '0'
+          ) port map (
+            reset               =>  '0',
+            clock               =>  rx_clock,
+            async               =>  nios_gpio(18+i),
+            sync                =>  rx_rate_sel(i)
+          ) ;
+
+        U_tx_rate : entity work.synchronizer
+          generic map (
+            RESET_LEVEL         =>  '0'
+          ) port map (
+            reset               =>  '0',
+            clock               =>  tx_clock,
+            async               =>  nios_gpio(21+i),
+            sync                =>  tx_rate_sel(i)
+          ) ;
+    end generate ;
+
+    rx_rate_log2 <= to_integer(rx_rate_sel) ;
+    tx_rate_log2 <= to_integer(tx_rate_sel) ;
+
+    U_psd_en : entity work.synchronizer
+      generic map (
+        RESET_LEVEL         =>  '0'
+      ) port map (
+        reset               =>  '0',
+        clock               =>  rx_clock,
+        async               =>  nios_gpio(24),
+        sync                =>  psd_en
+      ) ;
+
+    generate_psd_avg_sel : for i in psd_avg_sel'range generate
+        U_psd_avg : entity work.synchronizer
+          generic map (
+            RESET_LEVEL         =>  '0'
+          ) port map (
+            reset               =>  '0',
+            clock               =>  rx_clock,
+            async               =>  nios_gpio(25+i),
+            sync                =>  psd_avg_sel(i)
+          ) ;
+    end generate ;
+
+    U_rx_track_dc_en : entity work.synchronizer
+      generic map (
+        RESET_LEVEL         =>  '0'
+      ) port map (
+        reset               =>  '0',
+        clock               =>  rx_clock,
+        async               =>  nios_gpio(11),
+        sync                =>  rx_track_dc_en
+      ) ;
+
+    U_rx_track_iq_en : entity work.synchronizer
+      generic map (
+        RESET_LEVEL         =>  '0'
+      ) port map (
+        reset               =>  '0',
+        clock               =>  rx_clock,
+        async               =>  nios_gpio(29),
+        sync                =>  rx_track_iq_en
+      ) ;
+
+    U_rx_trigger_en : entity work.synchronizer
+      generic map (
+        RESET_LEVEL         =>  '0'
+      ) port map (
+        reset               =>  '0',
+        clock               =>  rx_clock,
+        async               =>  nios_rx_trigger_ctrl(0),
+        sync                =>  rx_trigger_en
+      ) ;
+
+    U_rx_trigger_ext_src : entity work.synchronizer
+      generic map (
+        RESET_LEVEL         =>  '0'
+      ) port map (
+        reset               =>  '0',
+        clock               =>  rx_clock,
+        async               =>  nios_rx_trigger_ctrl(1),
+        sync                =>  rx_trigger_ext_src
+      ) ;
+
+    U_rx_trigger_rearm : entity work.synchronizer
+      generic map (
+        RESET_LEVEL         =>  '0'
+      ) port map (
+        reset               =>  '0',
+        clock               =>  rx_clock,
+        async               =>  nios_rx_trigger_ctrl(2),
+        sync                =>  rx_trigger_rearm
+      ) ;
+
+    U_rx_trigger_arm : entity work.synchronizer
+      generic map (
+        RESET_LEVEL         =>  '0'
+      ) port map (
+        reset               =>  '0',
+        clock               =>  rx_clock,
+        async               =>  nios_rx_trigger_ctrl(3),
+        sync                =>  rx_trigger_arm
+      ) ;
+
+    -- External trigger input on the mini expansion header, J51-1
+    U_rx_trigger_ext : entity work.synchronizer
+      generic map (
+        RESET_LEVEL         =>  '0'
+      ) port map (
+        reset               =>  '0',
+        clock               =>  rx_clock,
+        async               =>  mini_exp1,
+        sync                =>  rx_trigger_ext
+      ) ;
+
+    psd_avg_log2 <= PSD_MAX_AVG_LOG2 when psd_avg_sel > PSD_MAX_AVG_LOG2 else to_integer(psd_avg_sel) ;
+
     U_meta_sync_fx3 : entity work.synchronizer
       generic map (
         RESET_LEVEL         =>  '0'
@@ -350,6 +628,92 @@ begin
         sync                =>  meta_en_rx
       ) ;
 
+    U_pack_sync_tx : entity work.synchronizer
+      generic map (
+        RESET_LEVEL         =>  '0'
+      ) port map (
+        reset               =>  '0',
+        clock               =>  tx_clock,
+        async               =>  nios_sample_fmt(1),
+        sync                =>  pack_en_tx
+      ) ;
+
+    U_pack_sync_rx : entity work.synchronizer
+      generic map (
+        RESET_LEVEL         =>  '0'
+      ) port map (
+        reset               =>  '0',
+        clock               =>  rx_clock,
+        async               =>  nios_sample_fmt(0),
+        sync                =>  pack_en_rx
+      ) ;
+
+    U_sc8_sync_tx : entity work.synchronizer
+      generic map (
+        RESET_LEVEL         =>  '0'
+      ) port map (
+        reset               =>  '0',
+        clock               =>  tx_clock,
+        async               =>  nios_sample_fmt(3),
+        sync                =>  sc8_en_tx
+      ) ;
+
+    U_sc8_sync_rx : entity work.synchronizer
+      generic map (
+        RESET_LEVEL         =>  '0'
+      ) port map (
+        reset               =>  '0',
+        clock               =>  rx_clock,
+        async               =>  nios_sample_fmt(2),
+        sync                =>  sc8_en_rx
+      ) ;
+
+    -- The shifts are only changed while the modules are idle
+    generate_sc8_shift : for i in sc8_shift_rx'range generate
+        U_sc8_shift_tx : entity work.synchronizer
+          generic map (
+            RESET_LEVEL         =>  '0'
+          ) port map (
+            reset               =>  '0',
+            clock               =>  tx_clock,
+            async               =>  nios_sample_fmt(12+i),
+            sync                =>  sc8_shift_tx(i)
+          ) ;
+
+        U_sc8_shift_rx : entity work.synchronizer
+          generic map (
+            RESET_LEVEL         =>  '0'
+          ) port map (
+            reset               =>  '0',
+            clock               =>  rx_clock,
+            async               =>  nios_sample_fmt(8+i),
+            sync                =>  sc8_shift_rx(i)
+          ) ;
+    end generate ;
+
+    U_sym_sync_tx : entity work.synchronizer
+      generic map (
+        RESET_LEVEL         =>  '0'
+      ) port map (
+        reset               =>  '0',
+        clock               =>  tx_clock,
+        async               =>  nios_sample_fmt(5),
+        sync                =>  sym_en_tx
+      ) ;
+
+    -- The modulation is only changed while TX is idle
+    generate_sym_mod : for i in sym_mod_tx'range generate
+        U_sym_mod_tx : entity work.synchronizer
+          generic map (
+            RESET_LEVEL         =>  '0'
+          ) port map (
+            reset               =>  '0',
+            clock               =>  tx_clock,
+            async               =>  nios_sample_fmt(16+i),
+            sync                =>  sym_mod_tx(i)
+          ) ;
+    end generate ;
+
     xb_mode <= nios_gpio(31 downto 30);
 
     U_sys_reset_sync : entity work.reset_synchronizer
@@ -407,7 +771,9 @@ begin
     tx_sample_fifo.wclock <= fx3_pclk_pll ;
     tx_sample_fifo.rclock <= tx_clock ;
     U_tx_sample_fifo : entity work.tx_fifo
-      port map (
+      generic map (
+        DEPTH_LOG2          => FIFO_DEPTH_LOG2
+      ) port map (
         aclr                => tx_sample_fifo.aclr,
         data                => tx_sample_fifo.wdata,
         rdclk               => tx_sample_fifo.rclock,
@@ -428,7 +794,10 @@ begin
     tx_meta_fifo.wclock <= fx3_pclk_pll ;
     tx_meta_fifo.rclock <= tx_clock ;
     U_tx_meta_fifo : entity work.tx_meta_fifo
-      port map (
+      generic map (
+        -- Scaled along with the sample FIFOs
+        DEPTH_LOG2          => FIFO_DEPTH_LOG2-7
+      ) port map (
         aclr                => tx_meta_fifo.aclr,
         data                => tx_meta_fifo.wdata,
         rdclk               => tx_meta_fifo.rclock,
@@ -448,7 +817,9 @@ begin
     rx_sample_fifo.wclock <= rx_clock ;
     rx_sample_fifo.rclock <= fx3_pclk_pll ;
     U_rx_sample_fifo : entity work.rx_fifo
-      port map (
+      generic map (
+        DEPTH_LOG2          => FIFO_DEPTH_LOG2
+      ) port map (
         aclr                => rx_sample_fifo.aclr,
         data                => rx_sample_fifo.wdata,
         rdclk               => rx_sample_fifo.rclock,
@@ -469,7 +840,10 @@ begin
     rx_meta_fifo.wclock <= rx_clock ;
     rx_meta_fifo.rclock <= fx3_pclk_pll ;
     U_rx_meta_fifo : entity work.rx_meta_fifo
-      port map (
+      generic map (
+        -- Scaled along with the sample FIFOs
+        DEPTH_LOG2          => FIFO_DEPTH_LOG2-7
+      ) port map (
         aclr                => rx_meta_fifo.aclr,
         data                => rx_meta_fifo.wdata,
         rdclk               => rx_meta_fifo.rclock,
@@ -540,7 +914,11 @@ begin
 
         usb_speed           =>  usb_speed_rx,
         meta_en             =>  meta_en_rx,
-        timestamp           =>  rx_timestamp,
+        pack_en             =>  pack_en_rx,
+        sc8_en              =>  sc8_en_rx,
+        sc8_shift           =>  sc8_shift_rx,
+        timestamp           =>  rx_writer_timestamp,
+        meta_keep           =>  rx_writer_keep,
 
         fifo_clear          =>  rx_sample_fifo.aclr,
         fifo_full           =>  rx_sample_fifo.wfull,
@@ -553,13 +931,15 @@ begin
         meta_fifo_data      =>  rx_meta_fifo.wdata,
         meta_fifo_write     =>  rx_meta_fifo.wreq,
 
-        in_i                =>  rx_sample_corrected_i,
-        in_q                =>  rx_sample_corrected_q,
-        in_valid            =>  rx_sample_corrected_valid,
+        in_i                =>  rx_writer_i,
+        in_q                =>  rx_writer_q,
+        in_valid            =>  rx_writer_valid,
 
         overflow_led        =>  rx_overflow_led,
         overflow_count      =>  rx_overflow_count,
-        overflow_duration   =>  x"ffff"
+        overflow_duration   =>  x"ffff",
+
+        fifo_high_water     =>  rx_fifo_high_water
       ) ;
 
     U_rx_iq_correction : entity work.iq_correction(rx)
@@ -584,45 +964,261 @@ begin
         correction_valid    => correction_valid
       );
 
+    -- Residual DC offset and IQ imbalance tracking, after the static
+    -- corrections
+    U_rx_iq_tracker : entity work.iq_tracker
+      port map (
+        clock               =>  rx_clock,
+        reset               =>  rx_reset,
+
+        dc_enable           =>  rx_track_dc_en,
+        iq_enable           =>  rx_track_iq_en,
+
+        in_real             =>  rx_sample_corrected_i,
+        in_imag             =>  rx_sample_corrected_q,
+        in_valid            =>  rx_sample_corrected_valid,
+
+        out_real            =>  rx_sample_tracked_i,
+        out_imag            =>  rx_sample_tracked_q,
+        out_valid           =>  rx_sample_tracked_valid,
+
+        dc_real             =>  rx_track_dc_i,
+        dc_imag             =>  rx_track_dc_q,
+        gain                =>  rx_track_gain,
+        phase               =>  rx_track_phase
+      ) ;
+
+    nios_rx_track_dc <= std_logic_vector(rx_track_dc_q & rx_track_dc_i) ;
+    nios_rx_track_iq <= std_logic_vector(rx_track_phase & rx_track_gain) ;
+
+    -- Sample FIFO level marks, and the depths they are relative to
+    nios_fifo_levels <= std_logic_vector(tx_fifo_low_water & rx_fifo_high_water) ;
+    nios_fifo_depth <= x"0000" & std_logic_vector(to_unsigned(FIFO_DEPTH_LOG2, 8)) &
+                                 std_logic_vector(to_unsigned(FIFO_DEPTH_LOG2, 8)) ;
+
+    -- Late timed TX messages, and TX sample FIFO underflows
+    nios_tx_late <= std_logic_vector(tx_late_max & tx_late_count) ;
+    nios_tx_underflows <= std_logic_vector(tx_underflow_count(31 downto 0)) ;
+
+    -- The NCO phase increment is quasi-static, like the IQ corrections
+    register_rx_nco : process(rx_clock)
+    begin
+        if( rising_edge(rx_clock) ) then
+            rx_nco_dphase <= signed(nios_rx_nco_dphase) ;
+        end if ;
+    end process ;
+
+    -- So are the trigger settings, which are only changed while disabled
+    register_rx_trigger : process(rx_clock)
+    begin
+        if( rising_edge(rx_clock) ) then
+            rx_trigger_level <= unsigned(nios_rx_trigger_level) ;
+            rx_trigger_post <= unsigned(nios_rx_trigger_post) ;
+            rx_trigger_pre <= unsigned(nios_rx_trigger_ctrl(16+RX_TRIGGER_DEPTH_LOG2-1 downto 16)) ;
+        end if ;
+    end process ;
+
+    nios_rx_trigger_status <= (31 downto 18 => '0') & (rx_trigger_en and rx_trigger_keep) &
+                              rx_trigger_armed & std_logic_vector(rx_trigger_count) ;
+
+    U_rx_ddc : entity work.ddc
+      port map (
+        clock               =>  rx_clock,
+        reset               =>  rx_reset,
+
+        dphase              =>  rx_nco_dphase,
+
+        in_i                =>  rx_sample_tracked_i,
+        in_q                =>  rx_sample_tracked_q,
+        in_valid            =>  rx_sample_tracked_valid,
+
+        out_i               =>  rx_sample_ddc_i,
+        out_q               =>  rx_sample_ddc_q,
+        out_valid           =>  rx_sample_ddc_valid
+      ) ;
+
+    U_rx_decimator : entity work.decimator
+      generic map (
+        MAX_RATE_LOG2       =>  MAX_RATE_LOG2
+      ) port map (
+        clock               =>  rx_clock,
+        reset               =>  rx_reset,
+
+        rate_log2           =>  rx_rate_log2,
+
+        in_i                =>  rx_sample_ddc_i,
+        in_q                =>  rx_sample_ddc_q,
+        in_valid            =>  rx_sample_ddc_valid,
+
+        out_i               =>  rx_sample_decim_i,
+        out_q               =>  rx_sample_decim_q,
+        out_valid           =>  rx_sample_decim_valid
+      ) ;
+
+    -- Only start sending a spectrum if the whole frame fits in the FIFO
+    rx_psd_ready <= '1' when rx_sample_fifo.wfull = '0' and
+                             unsigned(rx_sample_fifo.wused) < 2**rx_sample_fifo.wused'length - 2**(PSD_FFT_LOG2+1)
+                    else '0' ;
+
+    U_rx_psd : entity work.psd
+      generic map (
+        FFT_LOG2            =>  PSD_FFT_LOG2,
+        MAX_AVG_LOG2        =>  PSD_MAX_AVG_LOG2
+      ) port map (
+        clock               =>  rx_clock,
+        reset               =>  rx_reset,
+        enable              =>  psd_en and rx_enable,
+
+        avg_log2            =>  psd_avg_log2,
+
+        in_i                =>  rx_sample_decim_i,
+        in_q                =>  rx_sample_decim_q,
+        in_valid            =>  rx_sample_decim_valid,
+
+        out_ready           =>  rx_psd_ready,
+        out_i               =>  rx_psd_i,
+        out_q               =>  rx_psd_q,
+        out_valid           =>  rx_psd_valid
+      ) ;
+
+    U_rx_trigger : entity work.rx_trigger
+      generic map (
+        DEPTH_LOG2          =>  RX_TRIGGER_DEPTH_LOG2,
+        MAX_RATE_LOG2       =>  MAX_RATE_LOG2
+      ) port map (
+        clock               =>  rx_clock,
+        reset               =>  rx_reset,
+
+        enable              =>  rx_trigger_en and rx_enable and meta_en_rx,
+        source_ext          =>  rx_trigger_ext_src,
+        rearm               =>  rx_trigger_rearm,
+        arm                 =>  rx_trigger_arm,
+
+        threshold           =>  rx_trigger_level,
+        pre                 =>  rx_trigger_pre,
+        post                =>  rx_trigger_post,
+        ext_trigger         =>  rx_trigger_ext,
+
+        rate_log2           =>  rx_rate_log2,
+        timestamp           =>  rx_timestamp,
+
+        in_i                =>  rx_sample_decim_i,
+        in_q                =>  rx_sample_decim_q,
+        in_valid            =>  rx_sample_decim_valid,
+
+        out_i               =>  rx_trigger_i,
+        out_q               =>  rx_trigger_q,
+        out_valid           =>  rx_trigger_valid,
+        out_timestamp       =>  rx_trigger_timestamp,
+        out_keep            =>  rx_trigger_keep,
+
+        armed               =>  rx_trigger_armed,
+        triggers            =>  rx_trigger_count
+      ) ;
+
+    rx_writer_i     <= rx_psd_i when psd_en = '1' else rx_trigger_i ;
+    rx_writer_q     <= rx_psd_q when psd_en = '1' else rx_trigger_q ;
+    rx_writer_valid <= rx_psd_valid when psd_en = '1' else rx_trigger_valid ;
+    rx_writer_timestamp <= rx_timestamp when psd_en = '1' else rx_trigger_timestamp ;
+    rx_writer_keep  <= '1' when psd_en = '1' else rx_trigger_keep ;
+
+    -- The TX sample FIFO carries either samples for the fifo_reader, or
+    -- packed symbols for the symbol_mapper
+    tx_reader_enable <= tx_enable and not sym_en_tx ;
+    tx_sym_enable <= tx_enable and sym_en_tx ;
+    tx_sample_fifo.rreq <= tx_sym_fifo_read when sym_en_tx = '1' else tx_reader_fifo_read ;
+
     U_fifo_reader : entity work.fifo_reader
       port map (
         clock               =>  tx_clock,
         reset               =>  tx_reset,
-        enable              =>  tx_enable,
+        enable              =>  tx_reader_enable,
 
         usb_speed           =>  usb_speed_tx,
         meta_en             =>  meta_en_tx,
+        pack_en             =>  pack_en_tx,
+        sc8_en              =>  sc8_en_tx,
+        sc8_shift           =>  sc8_shift_tx,
         timestamp           =>  tx_timestamp,
 
+        read_enable         =>  tx_sample_raw_request,
+
         fifo_empty          =>  tx_sample_fifo.rempty,
         fifo_usedw          =>  tx_sample_fifo.rused,
         fifo_data           =>  tx_sample_fifo.rdata,
-        fifo_read           =>  tx_sample_fifo.rreq,
+        fifo_read           =>  tx_reader_fifo_read,
 
         meta_fifo_empty     =>  tx_meta_fifo.rempty,
         meta_fifo_usedw     =>  tx_meta_fifo.rused,
         meta_fifo_data      =>  tx_meta_fifo.rdata,
         meta_fifo_read      =>  tx_meta_fifo.rreq,
 
-        out_i               =>  tx_sample_raw_i,
-        out_q               =>  tx_sample_raw_q,
-        out_valid           =>  tx_sample_raw_valid,
+        out_i               =>  tx_reader_i,
+        out_q               =>  tx_reader_q,
+        out_valid           =>  tx_reader_valid,
 
         underflow_led       =>  tx_underflow_led,
         underflow_count     =>  tx_underflow_count,
-        underflow_duration  =>  x"ffff"
+        underflow_duration  =>  x"ffff",
+
+        fifo_low_water      =>  tx_fifo_low_water,
+
+        late_count          =>  tx_late_count,
+        late_max            =>  tx_late_max
+      ) ;
+
+    U_symbol_mapper : entity work.symbol_mapper
+      port map (
+        clock               =>  tx_clock,
+        reset               =>  tx_reset,
+        enable              =>  tx_sym_enable,
+
+        modulation          =>  sym_mod_tx,
+
+        read_enable         =>  tx_sample_raw_request,
+
+        fifo_empty          =>  tx_sample_fifo.rempty,
+        fifo_data           =>  tx_sample_fifo.rdata,
+        fifo_read           =>  tx_sym_fifo_read,
+
+        out_i               =>  tx_sym_i,
+        out_q               =>  tx_sym_q,
+        out_valid           =>  tx_sym_valid
+      ) ;
+
+    tx_sample_raw_i <= tx_sym_i when sym_en_tx = '1' else tx_reader_i ;
+    tx_sample_raw_q <= tx_sym_q when sym_en_tx = '1' else tx_reader_q ;
+    tx_sample_raw_valid <= tx_sym_valid when sym_en_tx = '1' else tx_reader_valid ;
+
+    U_tx_interpolator : entity work.interpolator
+      generic map (
+        MAX_RATE_LOG2       =>  MAX_RATE_LOG2
+      ) port map (
+        clock               =>  tx_clock,
+        reset               =>  tx_reset,
+
+        rate_log2           =>  tx_rate_log2,
+
+        in_i                =>  tx_sample_raw_i,
+        in_q                =>  tx_sample_raw_q,
+        in_valid            =>  tx_sample_raw_valid,
+        in_request          =>  tx_sample_raw_request,
+
+        out_i               =>  tx_sample_interp_i,
+        out_q               =>  tx_sample_interp_q,
+        out_valid           =>  tx_sample_interp_valid
       ) ;
 
     U_tx_iq_correction : entity work.iq_correction(tx)
       generic map (
-        INPUT_WIDTH         => tx_sample_raw_i'length
+        INPUT_WIDTH         => tx_sample_interp_i'length
       ) port map (
         reset               => tx_reset,
         clock               => tx_clock,
 
-        in_real             => tx_sample_raw_i,
-        in_imag             => tx_sample_raw_q,
-        in_valid            => tx_sample_raw_valid,
+        in_real             => tx_sample_interp_i,
+        in_imag             => tx_sample_interp_q,
+        in_valid            => tx_sample_interp_valid,
 
         out_real            => tx_sample_i,
         out_imag            => tx_sample_q,
@@ -678,6 +1274,17 @@ begin
         sample_valid    =>  rx_gen_valid
       ) ;
 
+    U_rx_prbs : entity work.prbs_generator
+      port map (
+        clock           =>  rx_clock,
+        reset           =>  rx_reset,
+        enable          =>  rx_enable,
+
+        sample_i        =>  rx_prbs_i,
+        sample_q        =>  rx_prbs_q,
+        sample_valid    =>  rx_prbs_valid
+      ) ;
+
     rx_mux_mode <= rx_mux_mode_t'val(to_integer(rx_mux_sel)) ;
 
     rx_mux : process(rx_reset, rx_clock)
@@ -707,9 +1314,13 @@ begin
                     rx_mux_q <= rx_entropy_q ;
                     rx_mux_valid <= rx_entropy_valid ;
                 when RX_MUX_DIGITAL_LOOPBACK =>
-                    rx_mux_i <= tx_sample_raw_i ;
-                    rx_mux_q <= tx_sample_raw_q ;
-                    rx_mux_valid <= tx_sample_raw_valid ;
+                    rx_mux_i <= tx_sample_interp_i ;
+                    rx_mux_q <= tx_sample_interp_q ;
+                    rx_mux_valid <= tx_sample_interp_valid ;
+                when RX_MUX_PRBS =>
+                    rx_mux_i <= rx_prbs_i ;
+                    rx_mux_q <= rx_prbs_q ;
+                    rx_mux_valid <= rx_prbs_valid ;
                 when others =>
                     rx_mux_i <= (others =>'0') ;
                     rx_mux_q <= (others =>'0') ;
@@ -757,9 +1368,9 @@ begin
         dac_SCLK                        => nios_sclk,
         dac_SS_n                        => nios_ss_n,
         spi_MISO                        => lms_sdo,
-        spi_MOSI                        => lms_sdio,
-        spi_SCLK                        => lms_sclk,
-        spi_SS_n                        => lms_sen,
+        spi_MOSI                        => nios_lms_sdio,
+        spi_SCLK                        => nios_lms_sclk,
+        spi_SS_n                        => nios_lms_sen,
         uart_rxd                        => nios_uart_txd,
         uart_txd                        => nios_uart_rxd,
         gpio_export                     => nios_gpio,
@@ -768,6 +1379,22 @@ begin
         xb_gpio_dir_export              => nios_xb_gpio_dir,
         correction_tx_phase_gain_export => correction_tx_phase_gain,
         correction_rx_phase_gain_export => correction_rx_phase_gain,
+        rx_nco_dphase_export            => nios_rx_nco_dphase,
+        rx_track_dc_export              => nios_rx_track_dc,
+        rx_track_iq_export              => nios_rx_track_iq,
+        sample_fmt_export               => nios_sample_fmt,
+        fifo_levels_export              => nios_fifo_levels,
+        fifo_depth_export               => nios_fifo_depth,
+        rx_trigger_ctrl_export          => nios_rx_trigger_ctrl,
+        rx_trigger_level_export         => nios_rx_trigger_level,
+        rx_trigger_post_export          => nios_rx_trigger_post,
+        rx_trigger_status_export        => nios_rx_trigger_status,
+        lms_spi_cmd_export              => nios_lms_spi_cmd,
+        lms_spi_status_export           => nios_lms_spi_status,
+        tx_late_export                  => nios_tx_late,
+        tx_underflows_export            => nios_tx_underflows,
+        time_latch_ctrl_export          => nios_time_latch_ctrl,
+        time_latch_status_export        => nios_time_latch_status,
         oc_i2c_scl_pad_o                => i2c_scl_out,
         oc_i2c_scl_padoen_o             => i2c_scl_oen,
         oc_i2c_sda_pad_i                => i2c_sda_in,
@@ -784,6 +1411,40 @@ begin
         time_tamer_synchronize          => timestamp_sync
       ) ;
 
+    -- Timed LMS SPI writes, queued by the NIOS. The engine shares the clock
+    -- of the NIOS, and is only reset until the PLL locks so the two never
+    -- disagree on the state of the push toggle.
+    spi_engine_reset <= not \80MHz locked\ ;
+
+    U_lms_spi_engine : entity work.lms_spi_engine
+      port map (
+        clock               =>  \80MHz\,
+        reset               =>  spi_engine_reset,
+
+        cmd                 =>  nios_lms_spi_cmd,
+        status              =>  nios_lms_spi_status,
+
+        rx_clock            =>  rx_clock,
+        rx_reset            =>  rx_reset,
+        rx_timestamp        =>  rx_timestamp,
+
+        tx_clock            =>  tx_clock,
+        tx_reset            =>  tx_reset,
+        tx_timestamp        =>  tx_timestamp,
+
+        other_ss_n          =>  nios_lms_sen,
+        bus_owned           =>  spi_engine_owned,
+
+        spi_sclk            =>  spi_engine_sclk,
+        spi_sen             =>  spi_engine_sen,
+        spi_sdio            =>  spi_engine_sdio,
+        spi_sdo             =>  lms_sdo
+      ) ;
+
+    lms_sclk <= spi_engine_sclk when spi_engine_owned = '1' else nios_lms_sclk ;
+    lms_sen  <= spi_engine_sen  when spi_engine_owned = '1' else nios_lms_sen ;
+    lms_sdio <= spi_engine_sdio when spi_engine_owned = '1' else nios_lms_sdio ;
+
     xb_gpio_direction_proc : for i in 0 to 31 generate
         process(xb_gpio_dir, nios_xb_gpio_out, nios_xb_gpio_in, xb_mode, nios_ss_n)
         begin
@@ -805,8 +1466,6 @@ begin
         end process;
     end generate ;
 
-    nios_gpio(20 downto 19) <= nios_ss_n;
-    nios_gpio(22 downto 21) <= xb_mode;
     process(all)
     begin
         if( xb_mode = "00" ) then
@@ -898,6 +1557,76 @@ begin
     mini_exp1               <= 'Z';
     mini_exp2               <= 'Z';
 
+    -- Timestamp latch, capturing both counters on an edge of the 1PPS input,
+    -- J51-1, J51-2 or an expansion GPIO, and optionally resetting or loading
+    -- them on the next edge. The NIOS reads back the word selected by
+    -- ctrl(14:12): RX time low and high, TX time low and high, or status.
+    time_latch_event <= ref_1pps when nios_time_latch_ctrl(1 downto 0) = "00" else
+                        mini_exp1 when nios_time_latch_ctrl(1 downto 0) = "01" else
+                        mini_exp2 when nios_time_latch_ctrl(1 downto 0) = "10" else
+                        nios_xb_gpio_in(to_integer(unsigned(nios_time_latch_ctrl(6 downto 2)))) ;
+
+    U_rx_time_latch : entity work.time_latch
+      port map (
+        clock               =>  rx_clock,
+        reset               =>  rx_reset,
+
+        ext_event           =>  time_latch_event,
+        falling             =>  nios_time_latch_ctrl(7),
+        enable              =>  nios_time_latch_ctrl(8),
+
+        action              =>  nios_time_latch_ctrl(10 downto 9),
+        arm                 =>  nios_time_latch_ctrl(11),
+        armed               =>  rx_latch_armed,
+
+        stage               =>  nios_time_latch_ctrl(15),
+        stage_sel           =>  unsigned(nios_time_latch_ctrl(13 downto 12)),
+        stage_data          =>  nios_time_latch_ctrl(31 downto 16),
+        staged              =>  rx_latch_staged,
+
+        timestamp           =>  rx_timestamp,
+        latched             =>  rx_latch_time,
+        edges               =>  rx_latch_edges,
+
+        load                =>  rx_latch_load,
+        load_value          =>  rx_latch_load_value
+      ) ;
+
+    U_tx_time_latch : entity work.time_latch
+      port map (
+        clock               =>  tx_clock,
+        reset               =>  tx_reset,
+
+        ext_event           =>  time_latch_event,
+        falling             =>  nios_time_latch_ctrl(7),
+        enable              =>  nios_time_latch_ctrl(8),
+
+        action              =>  nios_time_latch_ctrl(10 downto 9),
+        arm                 =>  nios_time_latch_ctrl(11),
+        armed               =>  tx_latch_armed,
+
+        stage               =>  nios_time_latch_ctrl(15),
+        stage_sel           =>  unsigned(nios_time_latch_ctrl(13 downto 12)),
+        stage_data          =>  nios_time_latch_ctrl(31 downto 16),
+        staged              =>  tx_latch_staged,
+
+        timestamp           =>  tx_timestamp,
+        latched             =>  tx_latch_time,
+        edges               =>  tx_latch_edges,
+
+        load                =>  tx_latch_load,
+        load_value          =>  tx_latch_load_value
+      ) ;
+
+    with nios_time_latch_ctrl(14 downto 12) select nios_time_latch_status <=
+        std_logic_vector(rx_latch_time(31 downto 0))    when "000",
+        std_logic_vector(rx_latch_time(63 downto 32))   when "001",
+        std_logic_vector(tx_latch_time(31 downto 0))    when "010",
+        std_logic_vector(tx_latch_time(63 downto 32))   when "011",
+        x"000" & tx_latch_staged & rx_latch_staged & tx_latch_armed & rx_latch_armed &
+            std_logic_vector(tx_latch_edges) & std_logic_vector(rx_latch_edges)
+                                                        when others ;
+
     increment_tx_time : process(tx_clock, tx_reset)
         variable tock : boolean := false ;
     begin
@@ -907,6 +1636,8 @@ begin
         elsif( rising_edge( tx_clock )) then
             if (meta_en_tx = '0') then
                 tx_timestamp <= (others => '0');
+            elsif( tx_latch_load = '1' ) then
+                tx_timestamp <= tx_latch_load_value;
             else
                 if( nios_gpio(17) = '0' or tock = true) then
                     tx_timestamp <= tx_timestamp + 1;
@@ -925,6 +1656,8 @@ begin
         elsif( rising_edge( rx_clock )) then
             if (meta_en_rx = '0') then
                 rx_timestamp <= (others => '0');
+            elsif( rx_latch_load = '1' ) then
+                rx_timestamp <= rx_latch_load_value;
             else
                 if( nios_gpio(17) = '0' or tock = true ) then
                     rx_timestamp <= rx_timestamp + 1;
@@ -25,6 +25,12 @@ library ieee ;
     use ieee.math_complex.all ;
 
 entity bladerf is
+  generic (
+    -- log2 of the RX and TX sample FIFO depths, in 32-bit words.  Deeper
+    -- FIFOs ride out longer host stalls, and the metadata FIFOs are scaled
+    -- to match.  Depths beyond 2**13 only fit the 115 kLE FPGA.
+    FIFO_DEPTH_LOG2     :   natural range 12 to 15  := 12
+  ) ;
   port (
     -- Main 38.4MHz system clock
     c4_clock            :   in      std_logic ;
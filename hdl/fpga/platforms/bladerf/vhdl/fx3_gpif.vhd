@@ -82,7 +82,7 @@ architecture sample_shuffler of fx3_gpif is
 
     type dma_event is (DE_TX, DE_RX);
     signal dma_last_event : dma_event;
-    type state_t is (IDLE, IDLE_RD, IDLE_RD_1, IDLE_WR, IDLE_WR_1, IDLE_WR_2, IDLE_WR_3, META_READ, SAMPLE_READ, META_WRITE, SAMPLE_WRITE, SAMPLE_WRITE_IGNORE, FINISHED);
+    type state_t is (IDLE, IDLE_RD, IDLE_RD_1, IDLE_WR, IDLE_WR_1, IDLE_WR_2, IDLE_WR_3, META_READ, SAMPLE_READ, META_WRITE, SAMPLE_WRITE, SAMPLE_WRITE_IGNORE, SAMPLE_WRITE_SKIP, FINISHED);
     signal state : state_t;
 
     signal gpif_buf_size        :   unsigned(12 downto 0) ;
@@ -100,6 +100,10 @@ architecture sample_shuffler of fx3_gpif is
     signal dma_downcount : signed(12 downto 0) ;
     signal meta_downcount : signed(12 downto 0) ;
 
+    -- Sample words left to write from a TX message.  A gated message only
+    -- carries as many words as its header says, and the rest is dropped.
+    signal tx_msg_words : unsigned(12 downto 0) ;
+
     signal underrun : std_logic;
     signal underrun_set, underrun_set_r : std_logic;
     signal underrun_clr, underrun_clr_r : std_logic;
@@ -183,7 +187,7 @@ begin
     end process ;
 
     rx_fifo_read  <= '1' when ((rx_meta_en = '0' and state = IDLE_RD) or state = SAMPLE_READ ) else '0';
-    tx_fifo_write <= '1' when (state = SAMPLE_WRITE) else '0';
+    tx_fifo_write <= '1' when (state = SAMPLE_WRITE and (tx_meta_en = '0' or tx_msg_words /= 0)) else '0';
     tx_meta_fifo_write <= '1' when (state = SAMPLE_WRITE and meta_enable = '1' and meta_downcount >= 0) else '0';
     rx_meta_fifo_read <= '1' when (state = META_READ or (rx_meta_en = '1' and state = IDLE_RD) ) else '0';
 
@@ -277,6 +281,7 @@ begin
             dma_downcount <= (others => '0');
             dma_last_event <= DE_TX;
             meta_downcount <= (others => '0');
+            tx_msg_words <= (others => '0');
             gpif_oe <= '1';
             underrun_set <= '0';
             underrun_clr <= '0';
@@ -341,7 +346,20 @@ begin
                         meta_downcount <= meta_downcount - 1;
                     else
                         dma_downcount <= dma_downcount - 1;
-                        if (unsigned(meta_buffer(63 downto 0)) = 0 or unsigned(meta_buffer(31 downto 0) & meta_buffer(63 downto 32)) > (tx_timestamp + 32)) then
+                        -- The first header word is now in bits 95:64.  Its
+                        -- bit 31 gates the message to the word count in its
+                        -- low 16 bits, and a gated message of no words is
+                        -- dropped without being timed unless bit 29 plays a
+                        -- waveform.  Bit 28 loads a waveform, and its
+                        -- timestamp field holds addresses instead of a time.
+                        if (meta_buffer(95) = '1' and unsigned(meta_buffer(79 downto 64)) < gpif_buf_size) then
+                           tx_msg_words <= resize(unsigned(meta_buffer(79 downto 64)), tx_msg_words'length);
+                        else
+                           tx_msg_words <= gpif_buf_size;
+                        end if;
+                        if (meta_buffer(95) = '1' and unsigned(meta_buffer(79 downto 64)) = 0 and meta_buffer(93) = '0') then
+                           state <= SAMPLE_WRITE_SKIP;
+                        elsif (meta_buffer(92) = '1' or unsigned(meta_buffer(63 downto 0)) = 0 or unsigned(meta_buffer(31 downto 0) & meta_buffer(63 downto 32)) > (tx_timestamp + 32)) then
                            meta_downcount <= to_signed(3, 13);
                            state <= SAMPLE_WRITE;
                         else
@@ -357,11 +375,22 @@ begin
                     else
                         state <= FINISHED;
                     end if;
+                when SAMPLE_WRITE_SKIP =>
+                    dma2_tx_ack <= '0';
+                    dma3_tx_ack <= '0';
+                    if( dma_downcount > 0 ) then
+                        dma_downcount <= dma_downcount - 1;
+                    else
+                        state <= FINISHED;
+                    end if;
                 when SAMPLE_WRITE =>
                     if( meta_downcount >= 0 ) then
                         meta_downcount <= meta_downcount - 1;
                         meta_buffer(127 downto 0) <= meta_buffer(95 downto 0) & x"00000000";
                     end if;
+                    if( tx_msg_words /= 0 ) then
+                        tx_msg_words <= tx_msg_words - 1;
+                    end if;
                     dma2_tx_ack <= '0';
                     dma3_tx_ack <= '0';
                     if( dma_downcount > 0 ) then
@@ -3,9 +3,11 @@ package require cmdline
 
 set options {\
     { "size.arg" "40" "FPGA Size - 40 or 115" } \
+    { "fifo.arg" "12" "log2 of the sample FIFO depths, in words" } \
     { "rev.arg" "" "Revision name" } \
     { "stp.arg" "" "SignalTap II File to use" } \
-    { "force" "" "Force using SignalTap II" }
+    { "force" "" "Force using SignalTap II" } \
+    { "compress" "" "Generate a compressed bitstream" }
 }
 
 # Read the revision from the commandline
@@ -73,6 +75,20 @@ if { $opts(stp) != "" } {
 }
 
 set_global_assignment -name DEVICE EP4CE$opts(size)F23C8
+
+# Always set the FIFO depth, so an earlier build's setting does not linger
+if { $opts(fifo) < 12 || $opts(fifo) > 15 } {
+    puts stderr "ERROR: FIFO depth must be from 12 through 15, not $opts(fifo)"
+    exit 1
+}
+set_parameter -name FIFO_DEPTH_LOG2 $opts(fifo)
+
+# Likewise for bitstream compression, which requires FX3 firmware v1.10.0
+if { $opts(compress) } {
+    set_global_assignment -name ON_CHIP_BITSTREAM_DECOMPRESSION ON
+} else {
+    set_global_assignment -name ON_CHIP_BITSTREAM_DECOMPRESSION OFF
+}
 set failed 0
 
 # Save all the options
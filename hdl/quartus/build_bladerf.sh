@@ -14,11 +14,14 @@ function usage()
     echo "    -r <rev>       FPGA revision"
     echo "    -s <size>      FPGA size"
     echo "    -a <stp>       SignalTap STP file"
+    echo "    -f <log2>      log2 of the sample FIFO depths, in words (default: 12)"
+    echo "    -z             Generate a compressed bitstream (FX3 firmware v1.10.0+)"
     echo "    -h             Show this text"
     echo ""
     echo "Supported revisions:"
     echo "    hosted"
     echo "    atsc_tx"
+    echo "    channelizer"
 
     # These revisions were for used for early prototyping and testing. They
     # require some work to get building with the current design. As such,
@@ -33,6 +36,10 @@ function usage()
     echo "    40"
     echo "    115"
     echo ""
+    echo "Supported FIFO depths (log2)"
+    echo "    12 - 13 on 40 kLE"
+    echo "    12 - 15 on 115 kLE"
+    echo ""
 }
 
 if [ $# -eq 0 ]; then
@@ -40,7 +47,10 @@ if [ $# -eq 0 ]; then
     exit 0
 fi
 
-while getopts ":a:s:r:h" opt; do
+fifo_depth=12
+compress=""
+
+while getopts ":a:s:r:f:zh" opt; do
     case $opt in
         h)
             usage
@@ -55,6 +65,14 @@ while getopts ":a:s:r:h" opt; do
             size=$OPTARG
             ;;
 
+        f)
+            fifo_depth=$OPTARG
+            ;;
+
+        z)
+            compress="-compress"
+            ;;
+
         a)
             echo "STP: $OPTARG"
             stp=$(readlink -f $OPTARG)
@@ -80,13 +98,22 @@ if [ "$size" -ne 40 ] && [ "$size" -ne 115 ]; then
     exit 1
 fi
 
+# Both sample FIFOs, 2**fifo_depth 32-bit words each, must fit in block RAM
+if [ "$fifo_depth" != "12" ] && [ "$fifo_depth" != "13" ] &&
+   ( [ "$size" -ne 115 ] ||
+     ( [ "$fifo_depth" != "14" ] && [ "$fifo_depth" != "15" ] ) ); then
+    echo -e "\nError: Invalid FIFO depth (\"$fifo_depth\") for size $size\n" >&2
+    usage
+    exit 1
+fi
+
 if [ "$rev" == "" ]; then
     echo -e "\nError: revision (-r) is required\n" >&2
     usage
     exit 1
 fi
 
-if [ "$rev" != "hosted" ] && [ "$rev" != "atsc_tx" ]; then
+if [ "$rev" != "hosted" ] && [ "$rev" != "atsc_tx" ] && [ "$rev" != "channelizer" ]; then
     echo -e "\nError: Invalid revision (\"$rev\")\n" >&2
     usage
     exit 1
@@ -179,9 +206,9 @@ mkdir -p work
 pushd work
 $quartus_sh -t ../bladerf.tcl
 if [ "$stp" == "" ]; then
-    $quartus_sh -t ../build.tcl -rev $rev -size $size
+    $quartus_sh -t ../build.tcl -rev $rev -size $size -fifo $fifo_depth $compress
 else
-    $quartus_sh -t ../build.tcl -rev $rev -size $size -stp $stp
+    $quartus_sh -t ../build.tcl -rev $rev -size $size -fifo $fifo_depth $compress -stp $stp
 fi
 popd
 
@@ -189,6 +216,12 @@ BUILD_TIME_DONE="$(cat work/output_files/$rev.done)"
 BUILD_TIME_DONE=$(date -d"$BUILD_TIME_DONE" '+%F_%H.%M.%S')
 
 BUILD_NAME="$rev"x"$size"
+if [ "$fifo_depth" != "12" ]; then
+    BUILD_NAME="$BUILD_NAME"-fifo"$fifo_depth"
+fi
+if [ "$compress" != "" ]; then
+    BUILD_NAME="$BUILD_NAME"-compressed
+fi
 BUILD_OUTPUT_DIR="$BUILD_NAME"-"$BUILD_TIME_DONE"
 RBF=$BUILD_NAME.rbf
 
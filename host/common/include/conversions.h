@@ -119,6 +119,25 @@ unsigned int str2uint_suffix(const char *str, unsigned int min,
         unsigned int max, const struct numeric_suffix suffixes[],
         int num_suffixes, bool *ok);
 
+/**
+ * Convert a string to a uint64_t with range and error checking, supporting
+ * suffixes as with str2uint_suffix().
+ *
+ * @param[in]   str     String to convert
+ * @param[in]   min     Minimum allowed value (inclusive)
+ * @param[in]   max     Maximum allowed value (inclusive)
+ * @param[in]   suffixes    List of allowed suffixes and their multipliers
+ * @param[in]   num_suffixes    Number of suffixes in the list
+ * @param[out]  ok      If non-NULL, this is set to true if the conversion was
+ *                      successful, and false for an invalid or out of range
+ *                      value.
+ *
+ * @return  Converted value on success, 0 on failure
+ */
+uint64_t str2uint64_suffix(const char *str, uint64_t min, uint64_t max,
+                           const struct numeric_suffix suffixes[],
+                           int num_suffixes, bool *ok);
+
 /**
  * Convert a string to a bladerf_version
  *
@@ -0,0 +1,44 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (c) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef CRC32_H__
+#define CRC32_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Update a CRC-32 (reflected, polynomial 0x04c11db7, as used by zlib) with
+ * the provided data. This matches the CRC computed by the FX3 firmware's
+ * BLADE_USB_CMD_FLASH_CRC32 request.
+ *
+ * @param   crc     CRC of the preceding data, or 0 to begin a new CRC
+ * @param   data    Data to process
+ * @param   len     Length of data, in bytes
+ *
+ * @return Updated CRC
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+#endif
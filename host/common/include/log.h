@@ -76,16 +76,54 @@
 
 /** @} */
 
-#ifdef LOG_INCLUDE_FILE_INFO
+/**
+ * Messages below this level are removed at compile time, along with the
+ * evaluation of their arguments. This is set by the LIBBLADERF_LOG_MIN_LEVEL
+ * build option, and no messages are removed by default.
+ */
+#ifndef LOG_MIN_LEVEL
+#   define LOG_MIN_LEVEL BLADERF_LOG_LEVEL_VERBOSE
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#   define LOG_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#   define LOG_UNLIKELY(x) (x)
+#endif
+
+/* Tests the level before calling log_write(), so that the arguments of a
+ * filtered message are not evaluated. The LOG_MIN_LEVEL test is constant,
+ * and allows the compiler to drop the call entirely. */
+#define LOG_ENABLED_(LEVEL) \
+    ((LEVEL) >= LOG_MIN_LEVEL && LOG_UNLIKELY((LEVEL) >= log_filter_level))
+
+#ifndef LOGGING_ENABLED
+#   define LOG_WRITE(LEVEL, LEVEL_STRING, ...) do {} while (0)
+#elif defined(LOG_INCLUDE_FILE_INFO)
 #   define LOG_WRITE(LEVEL, LEVEL_STRING, ...) \
-    do { log_write(LEVEL, LEVEL_STRING  \
-                     " @ "  LOG_EXPAND_(THIS_FILE) \
-                     ":" LOG_STRINGIFY_(__LINE__) "] " \
-                     __VA_ARGS__); \
+    do { \
+        if (LOG_ENABLED_(LEVEL)) { \
+            log_write(LEVEL, LEVEL_STRING  \
+                      " @ "  LOG_EXPAND_(THIS_FILE) \
+                      ":" LOG_STRINGIFY_(__LINE__) "] " \
+                      __VA_ARGS__); \
+        } \
     } while (0)
 #else
 #   define LOG_WRITE(LEVEL, LEVEL_STRING, ...) \
-    do { log_write(LEVEL, LEVEL_STRING "] " __VA_ARGS__); } while (0)
+    do { \
+        if (LOG_ENABLED_(LEVEL)) { \
+            log_write(LEVEL, LEVEL_STRING "] " __VA_ARGS__); \
+        } \
+    } while (0)
+#endif
+
+/**
+ * Current filter level. This is only exposed for the log_* macros; use
+ * log_set_verbosity() to change it.
+ */
+#ifdef LOGGING_ENABLED
+extern bladerf_log_level log_filter_level;
 #endif
 
 /**
@@ -118,5 +156,29 @@ void log_set_verbosity(bladerf_log_level level);
 #define log_set_verbosity(level) do {} while (0)
 #endif
 
+/**
+ * Routes log messages to `cb`, instead of stderr or syslog. A NULL `cb`
+ * restores the default output.
+ *
+ * @param   cb          Callback, invoked with each formatted message
+ * @param   user_data   Passed to `cb`
+ */
+#ifdef LOGGING_ENABLED
+void log_set_callback(bladerf_log_callback cb, void *user_data);
+#else
+#define log_set_callback(cb, user_data) do {} while (0)
+#endif
+
+/**
+ * Writes out any messages queued by the asynchronous logger, and stops its
+ * background thread. Messages logged afterwards are written out directly.
+ * This has no effect when the asynchronous logger is not built.
+ */
+#ifdef LOGGING_ENABLED
+void log_flush(void);
+#else
+#define log_flush() do {} while (0)
+#endif
+
 
 #endif
@@ -0,0 +1,109 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (c) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef SAMPLE_STATS_H__
+#define SAMPLE_STATS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Statistics of interleaved SC16 Q11 (I, Q) sample buffers, as used by
+ * calibration and monitoring code.
+ *
+ * All statistics are derived from exact integer sums, which are computed
+ * using the widest SIMD implementation (SSE2, AVX2, or NEON) supported by the
+ * host, selected at runtime. */
+
+/**
+ * Sums over a buffer of samples
+ */
+struct sample_sums {
+    size_t n;           /**< Number of samples summed */
+    int64_t i;          /**< Sum of I values */
+    int64_t q;          /**< Sum of Q values */
+    int64_t i_sq;       /**< Sum of squared I values */
+    int64_t q_sq;       /**< Sum of squared Q values */
+};
+
+/**
+ * Compute sums over a buffer of samples
+ *
+ * @param[in]   samples     Interleaved I/Q samples
+ * @param[in]   n           Number of samples, where a sample is an (I, Q) pair
+ * @param[out]  sums        Resulting sums
+ */
+void sample_sums(const int16_t *samples, size_t n, struct sample_sums *sums);
+
+/**
+ * Compute the mean I and Q values of a buffer of samples
+ *
+ * @param[in]   samples     Interleaved I/Q samples
+ * @param[in]   n           Number of samples
+ * @param[out]  mean_i      Mean I value
+ * @param[out]  mean_q      Mean Q value
+ */
+void sample_mean(const int16_t *samples, size_t n,
+                 float *mean_i, float *mean_q);
+
+/**
+ * Estimate the DC offset of a buffer of samples. Equivalent to
+ * sample_mean(), with the results truncated towards zero.
+ *
+ * @param[in]   samples     Interleaved I/Q samples
+ * @param[in]   n           Number of samples
+ * @param[out]  dc_i        I DC offset
+ * @param[out]  dc_q        Q DC offset
+ */
+void sample_dc(const int16_t *samples, size_t n,
+               int16_t *dc_i, int16_t *dc_q);
+
+/**
+ * Compute the (sample) variance of the I and Q values of a buffer of samples
+ *
+ * @param[in]   samples     Interleaved I/Q samples
+ * @param[in]   n           Number of samples. Must be > 1.
+ * @param[out]  var_i       Variance of I values
+ * @param[out]  var_q       Variance of Q values
+ */
+void sample_variance(const int16_t *samples, size_t n,
+                     float *var_i, float *var_q);
+
+/**
+ * Compute the mean power, I^2 + Q^2, of a buffer of samples
+ *
+ * @param   samples     Interleaved I/Q samples
+ * @param   n           Number of samples
+ *
+ * @return Mean power, in units of (sample value)^2
+ */
+float sample_power(const int16_t *samples, size_t n);
+
+/**
+ * Get the name of the implementation used to compute sums
+ *
+ * @return "avx2", "sse2", "neon", or "generic"
+ */
+const char *sample_stats_impl(void);
+
+#endif
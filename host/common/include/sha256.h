@@ -39,11 +39,18 @@ typedef struct SHA256Context {
 	uint32_t state[8];
 	uint32_t count[2];
 	unsigned char buf[64];
+
+	/* Block compression function selected for this CPU by SHA256_Init() */
+	void (*transform)(uint32_t *, const unsigned char *, size_t);
 } SHA256_CTX;
 
 void	SHA256_Init(SHA256_CTX *);
 void	SHA256_Update(SHA256_CTX *, const void *, size_t);
 void	SHA256_Final(unsigned char [32], SHA256_CTX *);
+
+/* Name of the block compression function used on this CPU:
+ * "scalar", "sha-ni", or "armv8-ce" */
+const char *SHA256_Impl(void);
 /* char   *SHA256_End(SHA256_CTX *, char *); */
 /* char   *SHA256_File(const char *, char *); */
 /* char   *SHA256_FileChunk(const char *, char *, off_t, off_t); */
@@ -33,6 +33,8 @@
  * may be used; one of the objectives of this file is to ease that transistion.
  */
 #include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
 #include "rel_assert.h"
 
 #define MUTEX pthread_mutex_t
@@ -66,4 +68,85 @@
 #   define MUTEX_UNLOCK(m) pthread_mutex_unlock(m)
 #endif
 
+/* Thread scheduling policies */
+typedef enum {
+    THREAD_SCHED_DEFAULT,   /* The OS's default, non-real-time policy */
+    THREAD_SCHED_FIFO,      /* Real-time, first-in first-out */
+    THREAD_SCHED_RR,        /* Real-time, round-robin */
+} thread_sched_policy;
+
+/* Scheduling parameters saved by thread_save_sched(). The contents are
+ * OS-specific and should not be accessed directly. */
+struct thread_sched_state {
+    int policy;
+    int priority;
+    uint64_t affinity;
+    bool affinity_saved;
+};
+
+/* Portable wrappers for thread scheduling controls.
+ *
+ * These return 0 on success, ENOSYS if the operation is not supported on the
+ * current platform, or another errno value on failure (e.g., EPERM if the
+ * process lacks permission to use real-time scheduling policies).
+ */
+
+/* Set a thread's scheduling policy and priority. The priority is ignored
+ * for THREAD_SCHED_DEFAULT. */
+int thread_set_sched(pthread_t thread, thread_sched_policy policy,
+                     int priority);
+
+/* Restrict a thread to the CPUs specified by a bitmask (CPUs 0 through 63) */
+int thread_set_affinity(pthread_t thread, uint64_t cpu_mask);
+
+/* Lock all current and future pages of the process' memory into RAM */
+int thread_lock_memory(void);
+
+/* Save a thread's scheduling policy, priority, and affinity */
+int thread_save_sched(pthread_t thread, struct thread_sched_state *state);
+
+/* Restore a thread's scheduling parameters saved via thread_save_sched() */
+int thread_restore_sched(pthread_t thread,
+                         const struct thread_sched_state *state);
+
+/* Accessors for naturally aligned, volatile-qualified variables that are
+ * shared between threads without holding a lock. Accesses to word-sized
+ * variables are atomic. 64-bit variables are only guaranteed to be accessed
+ * atomically on 64-bit targets, so they should only be used for values where
+ * a torn read is benign (e.g., statistics).
+ *
+ * ATOMIC_LOAD_ACQUIRE() ensures subsequent accesses are not reordered before
+ * the load, ATOMIC_STORE_RELEASE() ensures prior accesses are not reordered
+ * after the store, and ATOMIC_FENCE() is a full (sequentially consistent)
+ * memory barrier.
+ *
+ * ATOMIC_CAS_U32() replaces a uint32_t holding `expected` with `desired`,
+ * evaluating to true if it did, and ATOMIC_INC_U32() and ATOMIC_DEC_U32()
+ * increment and decrement a uint32_t. All are full barriers.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#   define ATOMIC_LOAD_ACQUIRE(p)      __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#   define ATOMIC_STORE_RELEASE(p, v)  __atomic_store_n(p, v, __ATOMIC_RELEASE)
+#   define ATOMIC_FENCE()              __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#   define ATOMIC_CAS_U32(p, expected, desired) \
+        __sync_bool_compare_and_swap(p, expected, desired)
+#   define ATOMIC_INC_U32(p)          ((void) __sync_fetch_and_add(p, 1))
+#   define ATOMIC_DEC_U32(p)          ((void) __sync_fetch_and_sub(p, 1))
+#elif defined(_MSC_VER)
+    /* With MSVC's default /volatile:ms semantics, volatile loads and stores
+     * have acquire and release semantics, respectively. */
+#   include <intrin.h>
+#   define ATOMIC_LOAD_ACQUIRE(p)      (*(p))
+#   define ATOMIC_STORE_RELEASE(p, v)  (*(p) = (v))
+#   define ATOMIC_FENCE()              _mm_mfence()
+#   define ATOMIC_CAS_U32(p, expected, desired) \
+        (_InterlockedCompareExchange((volatile long *) (p), \
+                                     (long) (desired), (long) (expected)) == \
+         (long) (expected))
+#   define ATOMIC_INC_U32(p)          ((void) _InterlockedIncrement((volatile long *) (p)))
+#   define ATOMIC_DEC_U32(p)          ((void) _InterlockedDecrement((volatile long *) (p)))
+#else
+#   error "Atomic accessors are not defined for this compiler."
+#endif
+
 #endif
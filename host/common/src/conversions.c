@@ -186,6 +186,53 @@ unsigned int str2uint_suffix(const char *str, unsigned int min,
     return (unsigned int)value;
 }
 
+uint64_t str2uint64_suffix(const char *str, uint64_t min, uint64_t max,
+                           const struct numeric_suffix suffixes[],
+                           int num_suffixes, bool *ok)
+{
+    double value;
+    char *endptr;
+    int i;
+
+    errno = 0;
+    value = strtod(str, &endptr);
+
+    /* If a number could not be parsed at the beginning of the string */
+    if (errno != 0 || endptr == str) {
+        if (ok) {
+            *ok = false;
+        }
+
+        return 0;
+    }
+
+    /* Loop through each available suffix */
+    for (i = 0; i < num_suffixes; i++) {
+        /* If the suffix appears at the end of the number */
+        if (!strcasecmp(endptr, suffixes[i].suffix)) {
+            /* Apply the multiplier */
+            value *= suffixes[i].multiplier;
+            break;
+        }
+    }
+
+    /* Check that the resulting value is in bounds */
+    if (value > (double) max || value < (double) min) {
+        if (ok) {
+            *ok = false;
+        }
+
+        return 0;
+    }
+
+    if (ok) {
+        *ok = true;
+    }
+
+    /* Truncate the floating point value to an integer and return it */
+    return (uint64_t)value;
+}
+
 int str2version(const char *str, struct bladerf_version *version)
 {
     unsigned long tmp;
@@ -401,7 +448,7 @@ int str2args(const char *line, char comment_char, char ***argv_ret)
                 if (argc >= argv_size) {
                     void *tmp;
                     argv_size = argv_size + argv_size / 2;
-                    tmp = realloc(argv, argv_size);
+                    tmp = realloc(argv, argv_size * sizeof(char *));
 
                     if (tmp) {
                         argv = (char **)tmp;
@@ -544,6 +591,9 @@ const char *backend_description(bladerf_backend b)
         case BLADERF_BACKEND_CYPRESS:
             return "Cypress driver";
 
+        case BLADERF_BACKEND_USBFS:
+            return "Linux usbfs";
+
         case BLADERF_BACKEND_DUMMY:
             return "Dummy";
 
@@ -29,65 +29,341 @@
 #endif
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 
-static bladerf_log_level filter_level = BLADERF_LOG_LEVEL_INFO;
+#ifdef LOG_ASYNC_ENABLED
+#include <pthread.h>
+#include "host_config.h"
+#if BLADERF_OS_WINDOWS || BLADERF_OS_OSX
+#include "clock_gettime.h"
+#else
+#include <time.h>
+#endif
+#include "thread.h"
+#endif
+
+bladerf_log_level log_filter_level = BLADERF_LOG_LEVEL_INFO;
+
+static bladerf_log_callback user_cb = NULL;
+static void *user_cb_data = NULL;
+
+/* Longest formatted message. Longer messages are truncated. */
+#ifndef LOG_MSG_MAX_LEN
+#   define LOG_MSG_MAX_LEN 256
+#endif
+
+#if !defined(WIN32) && !defined(__CYGWIN__) && defined(LOG_SYSLOG_ENABLED)
+static int syslog_level(bladerf_log_level level)
+{
+    switch (level) {
+        case BLADERF_LOG_LEVEL_VERBOSE:
+        case BLADERF_LOG_LEVEL_DEBUG:
+            return LOG_DEBUG;
+
+        case BLADERF_LOG_LEVEL_INFO:
+            return LOG_INFO;
+
+        case BLADERF_LOG_LEVEL_WARNING:
+            return LOG_WARNING;
+
+        case BLADERF_LOG_LEVEL_ERROR:
+            return LOG_ERR;
+
+        case BLADERF_LOG_LEVEL_CRITICAL:
+            return LOG_CRIT;
+
+        default:
+            /* Shouldn't be used, so just route it to a low level */
+            return LOG_DEBUG;
+    }
+}
+#endif
+
+#ifdef LOG_ASYNC_ENABLED
+/* Deliver a formatted message to the user's callback, or the log output */
+static void log_output(bladerf_log_level level, const char *msg)
+{
+    if (user_cb != NULL) {
+        user_cb(level, msg, user_cb_data);
+    } else {
+#if defined(WIN32) || defined(__CYGWIN__)
+        fputs(msg, stderr);
+#elif defined(LOG_SYSLOG_ENABLED)
+        syslog(syslog_level(level) | LOG_USER, "%s", msg);
+#else
+        fputs(msg, stderr);
+#endif
+    }
+}
+
+/* Asynchronous logging
+ *
+ * Messages are formatted by the logging thread into a slot of a bounded,
+ * lock-free ring, and written out by a background thread. A full ring drops
+ * messages, which are then counted and reported. Each slot's sequence number
+ * tells producers when it is free and the consumer when it is filled, as in
+ * Dmitry Vyukov's bounded MPMC queue.
+ *
+ * The background thread also collapses runs of identical messages,
+ * reporting at most one "repeated" summary per LOG_REPEAT_INTERVAL_MS.
+ */
+#ifndef LOG_RING_LEN
+#   define LOG_RING_LEN 256     /* Must be a power of two */
+#endif
+
+#ifndef LOG_POLL_INTERVAL_MS
+#   define LOG_POLL_INTERVAL_MS 10
+#endif
+
+#ifndef LOG_REPEAT_INTERVAL_MS
+#   define LOG_REPEAT_INTERVAL_MS 1000
+#endif
+
+struct log_record {
+    volatile uint32_t seq;
+    bladerf_log_level level;
+    char msg[LOG_MSG_MAX_LEN];
+};
+
+static struct log_record ring[LOG_RING_LEN];
+static volatile uint32_t ring_head;     /* Next slot to claim */
+static uint32_t ring_tail;              /* Next slot to drain */
+static volatile uint32_t num_dropped;
+
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_t log_thread;
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_wake = PTHREAD_COND_INITIALIZER;
+static bool log_running = false;
+static bool log_stop = false;
+
+/* Only accessed by the background thread */
+static char last_msg[LOG_MSG_MAX_LEN];
+static bladerf_log_level last_level;
+static unsigned int num_repeats;
+static uint64_t repeat_start_ms;
+static uint32_t num_dropped_reported;
+
+static uint64_t log_time_ms(void)
+{
+    struct timespec t;
+
+    if (clock_gettime(CLOCK_REALTIME, &t) != 0) {
+        return 0;
+    }
+
+    return (uint64_t) t.tv_sec * 1000 + t.tv_nsec / 1000000;
+}
+
+static void log_flush_repeats(void)
+{
+    static const char *prefixes[] = {
+        "VERBOSE", "DEBUG", "INFO", "WARNING", "ERROR", "CRITICAL"
+    };
+
+    char summary[64];
+
+    if (num_repeats != 0) {
+        snprintf(summary, sizeof(summary),
+                 "[%s] Previous message repeated %u time%s\n",
+                 prefixes[last_level <= BLADERF_LOG_LEVEL_CRITICAL ?
+                          last_level : BLADERF_LOG_LEVEL_CRITICAL],
+                 num_repeats, num_repeats == 1 ? "" : "s");
+        log_output(last_level, summary);
+        num_repeats = 0;
+    }
+}
+
+static void log_dedup_output(bladerf_log_level level, const char *msg)
+{
+    if (level == last_level && strcmp(msg, last_msg) == 0) {
+        if (num_repeats++ == 0) {
+            repeat_start_ms = log_time_ms();
+        }
+        return;
+    }
+
+    log_flush_repeats();
+    log_output(level, msg);
+
+    last_level = level;
+    strncpy(last_msg, msg, sizeof(last_msg) - 1);
+    last_msg[sizeof(last_msg) - 1] = '\0';
+}
+
+/* Write out all of the filled slots. Returns true if any were. */
+static bool log_drain(void)
+{
+    bool drained = false;
+    uint32_t dropped;
+    char msg[64];
+
+    for (;;) {
+        struct log_record *r = &ring[ring_tail & (LOG_RING_LEN - 1)];
+
+        if (ATOMIC_LOAD_ACQUIRE(&r->seq) != ring_tail + 1) {
+            break;
+        }
+
+        log_dedup_output(r->level, r->msg);
+        ATOMIC_STORE_RELEASE(&r->seq, ring_tail + LOG_RING_LEN);
+        ring_tail++;
+        drained = true;
+    }
+
+    dropped = ATOMIC_LOAD_ACQUIRE(&num_dropped);
+    if (dropped != num_dropped_reported) {
+        log_flush_repeats();
+        snprintf(msg, sizeof(msg), "[WARNING] %u log messages dropped\n",
+                 (unsigned int) (dropped - num_dropped_reported));
+        log_output(BLADERF_LOG_LEVEL_WARNING, msg);
+        last_msg[0] = '\0';
+        num_dropped_reported = dropped;
+    }
+
+    if (num_repeats != 0 &&
+        log_time_ms() - repeat_start_ms >= LOG_REPEAT_INTERVAL_MS) {
+        log_flush_repeats();
+    }
+
+    return drained;
+}
+
+static void *log_thread_fn(void *arg)
+{
+    struct timespec timeout;
+    bool stop;
+    uint64_t t;
+
+    (void) arg;
+
+    do {
+        log_drain();
+
+        pthread_mutex_lock(&log_lock);
+        stop = log_stop;
+        if (!stop) {
+            t = log_time_ms() + LOG_POLL_INTERVAL_MS;
+            timeout.tv_sec = (time_t) (t / 1000);
+            timeout.tv_nsec = (long) ((t % 1000) * 1000000);
+            pthread_cond_timedwait(&log_wake, &log_lock, &timeout);
+        }
+        pthread_mutex_unlock(&log_lock);
+    } while (!stop);
+
+    /* Write out anything that arrived before the stop request */
+    log_drain();
+    log_flush_repeats();
+    return NULL;
+}
+
+static void log_start(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < LOG_RING_LEN; i++) {
+        ring[i].seq = i;
+    }
+
+    log_running = pthread_create(&log_thread, NULL, log_thread_fn, NULL) == 0;
+}
+
+/* Claim a slot and format the message into it. Returns false if the ring
+ * is full, or the background thread could not be started. */
+static bool log_enqueue(bladerf_log_level level,
+                        const char *format, va_list args)
+{
+    struct log_record *r;
+    uint32_t pos, seq;
+
+    pthread_once(&log_once, log_start);
+    if (!log_running) {
+        return false;
+    }
+
+    pos = ATOMIC_LOAD_ACQUIRE(&ring_head);
+    for (;;) {
+        r = &ring[pos & (LOG_RING_LEN - 1)];
+        seq = ATOMIC_LOAD_ACQUIRE(&r->seq);
+
+        if (seq == pos) {
+            if (ATOMIC_CAS_U32(&ring_head, pos, pos + 1)) {
+                break;
+            }
+        } else if ((int32_t) (seq - pos) < 0) {
+            ATOMIC_INC_U32(&num_dropped);
+            return true;
+        }
+
+        pos = ATOMIC_LOAD_ACQUIRE(&ring_head);
+    }
+
+    r->level = level;
+    vsnprintf(r->msg, sizeof(r->msg), format, args);
+    ATOMIC_STORE_RELEASE(&r->seq, pos + 1);
+    return true;
+}
+
+void log_flush(void)
+{
+    pthread_mutex_lock(&log_lock);
+    if (log_running && !log_stop) {
+        log_stop = true;
+        pthread_cond_signal(&log_wake);
+        pthread_mutex_unlock(&log_lock);
+        pthread_join(log_thread, NULL);
+
+        /* Anything logged from here on is written out directly */
+        log_running = false;
+    } else {
+        pthread_mutex_unlock(&log_lock);
+    }
+}
+#else
+void log_flush(void)
+{
+}
+#endif
 
 void log_write(bladerf_log_level level, const char *format, ...)
 {
     /* Only process this message if its level exceeds the current threshold */
-    if (level >= filter_level)
+    if (level >= log_filter_level)
     {
         va_list args;
 
         /* Write the log message */
         va_start(args, format);
+#ifdef LOG_ASYNC_ENABLED
+        if (!log_enqueue(level, format, args))
+#endif
+        {
+            if (user_cb != NULL) {
+                char msg[LOG_MSG_MAX_LEN];
+                vsnprintf(msg, sizeof(msg), format, args);
+                user_cb(level, msg, user_cb_data);
+            } else {
 #if defined(WIN32) || defined(__CYGWIN__)
-        vfprintf(stderr, format, args);
+                vfprintf(stderr, format, args);
+#elif defined(LOG_SYSLOG_ENABLED)
+                vsyslog(syslog_level(level) | LOG_USER, format, args);
 #else
-#  if defined (LOG_SYSLOG_ENABLED)
-        {
-            int syslog_level;
-
-            switch (level) {
-                case BLADERF_LOG_LEVEL_VERBOSE:
-                case BLADERF_LOG_LEVEL_DEBUG:
-                    syslog_level = LOG_DEBUG;
-                    break;
-
-                case BLADERF_LOG_LEVEL_INFO:
-                    syslog_level = LOG_INFO;
-                    break;
-
-                case BLADERF_LOG_LEVEL_WARNING:
-                    syslog_level = LOG_WARNING;
-                    break;
-
-                case BLADERF_LOG_LEVEL_ERROR:
-                    syslog_level = LOG_ERR;
-                    break;
-
-                case BLADERF_LOG_LEVEL_CRITICAL:
-                    syslog_level = LOG_CRIT;
-                    break;
-
-                default:
-                    /* Shouldn't be used, so just route it to a low level */
-                    syslog_level = LOG_DEBUG;
-                    break;
+                vfprintf(stderr, format, args);
+#endif
             }
-
-            vsyslog(syslog_level | LOG_USER, format, args);
         }
-#  else
-        vfprintf(stderr, format, args);
-#  endif
-#endif
         va_end(args);
     }
 }
 
 void log_set_verbosity(bladerf_log_level level)
 {
-    filter_level = level;
+    log_filter_level = level;
+}
+
+void log_set_callback(bladerf_log_callback cb, void *user_data)
+{
+    user_cb_data = user_data;
+    user_cb = cb;
 }
 #endif
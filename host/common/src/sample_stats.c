@@ -0,0 +1,369 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (c) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <string.h>
+#include "sample_stats.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define SAMPLE_STATS_SSE2 1
+#   include <emmintrin.h>
+#else
+#   define SAMPLE_STATS_SSE2 0
+#endif
+
+/* AVX2 support is compiled in via function attributes, and used if it is
+ * available at runtime */
+#if SAMPLE_STATS_SSE2 && \
+    ((defined(__GNUC__) && __GNUC__ >= 5) || defined(__clang__))
+#   define SAMPLE_STATS_AVX2 1
+#   include <immintrin.h>
+#else
+#   define SAMPLE_STATS_AVX2 0
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#   define SAMPLE_STATS_NEON 1
+#   include <arm_neon.h>
+#else
+#   define SAMPLE_STATS_NEON 0
+#endif
+
+/* Max number of vector iterations for which sums of I and Q values may be
+ * accumulated in 32-bit lanes, before they must be moved to 64-bit totals.
+ * Each iteration adds at most 2 * 2^15 to a lane. */
+#define SUMS_BLOCK_LEN 16384
+
+static inline size_t block_len(size_t remaining, size_t per_iter)
+{
+    const size_t iters = remaining / per_iter;
+    return (iters < SUMS_BLOCK_LEN ? iters : SUMS_BLOCK_LEN) * per_iter;
+}
+
+static void sums_generic(const int16_t *samples, size_t n,
+                         struct sample_sums *sums)
+{
+    size_t k;
+
+    for (k = 0; k < n; k++) {
+        const int32_t i = samples[2 * k];
+        const int32_t q = samples[2 * k + 1];
+
+        sums->i += i;
+        sums->q += q;
+        sums->i_sq += i * i;
+        sums->q_sq += q * q;
+    }
+}
+
+#if SAMPLE_STATS_SSE2
+static inline int64_t hsum_epi32(__m128i v)
+{
+    int32_t tmp[4];
+    _mm_storeu_si128((__m128i *) tmp, v);
+    return (int64_t) tmp[0] + tmp[1] + tmp[2] + tmp[3];
+}
+
+static inline int64_t hsum_epi64(__m128i v)
+{
+    int64_t tmp[2];
+    _mm_storeu_si128((__m128i *) tmp, v);
+    return tmp[0] + tmp[1];
+}
+
+static void sums_sse2(const int16_t *samples, size_t n,
+                      struct sample_sums *sums)
+{
+    size_t k = 0;
+    const __m128i zero = _mm_setzero_si128();
+
+    /* 16-bit lanes of (1, 0) and (0, 1), selecting I and Q values when
+     * used with _mm_madd_epi16() */
+    const __m128i sel_i = _mm_set1_epi32(0x00000001);
+    const __m128i sel_q = _mm_set1_epi32(0x00010000);
+    const __m128i mask_i = _mm_set1_epi32(0x0000ffff);
+    const __m128i mask_q = _mm_set1_epi32((int) 0xffff0000);
+
+    __m128i acc_i_sq = zero, acc_q_sq = zero;
+
+    while (n - k >= 4) {
+        const size_t end = k + block_len(n - k, 4);
+        __m128i acc_i = zero, acc_q = zero;
+
+        for (; k < end; k += 4) {
+            const __m128i v = _mm_loadu_si128((const __m128i *) &samples[2 * k]);
+            const __m128i sq_i = _mm_madd_epi16(v, _mm_and_si128(v, mask_i));
+            const __m128i sq_q = _mm_madd_epi16(v, _mm_and_si128(v, mask_q));
+
+            acc_i = _mm_add_epi32(acc_i, _mm_madd_epi16(v, sel_i));
+            acc_q = _mm_add_epi32(acc_q, _mm_madd_epi16(v, sel_q));
+
+            /* Squares are non-negative, so they may be zero-extended */
+            acc_i_sq = _mm_add_epi64(acc_i_sq, _mm_unpacklo_epi32(sq_i, zero));
+            acc_i_sq = _mm_add_epi64(acc_i_sq, _mm_unpackhi_epi32(sq_i, zero));
+            acc_q_sq = _mm_add_epi64(acc_q_sq, _mm_unpacklo_epi32(sq_q, zero));
+            acc_q_sq = _mm_add_epi64(acc_q_sq, _mm_unpackhi_epi32(sq_q, zero));
+        }
+
+        sums->i += hsum_epi32(acc_i);
+        sums->q += hsum_epi32(acc_q);
+    }
+
+    sums->i_sq += hsum_epi64(acc_i_sq);
+    sums->q_sq += hsum_epi64(acc_q_sq);
+
+    sums_generic(&samples[2 * k], n - k, sums);
+}
+#endif
+
+#if SAMPLE_STATS_AVX2
+__attribute__((target("avx2")))
+static inline int64_t hsum256_epi32(__m256i v)
+{
+    int32_t tmp[8];
+    _mm256_storeu_si256((__m256i *) tmp, v);
+    return (int64_t) tmp[0] + tmp[1] + tmp[2] + tmp[3] +
+           tmp[4] + tmp[5] + tmp[6] + tmp[7];
+}
+
+__attribute__((target("avx2")))
+static inline int64_t hsum256_epi64(__m256i v)
+{
+    int64_t tmp[4];
+    _mm256_storeu_si256((__m256i *) tmp, v);
+    return tmp[0] + tmp[1] + tmp[2] + tmp[3];
+}
+
+/* Same approach as sums_sse2(), over 8 samples per iteration */
+__attribute__((target("avx2")))
+static void sums_avx2(const int16_t *samples, size_t n,
+                      struct sample_sums *sums)
+{
+    size_t k = 0;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i sel_i = _mm256_set1_epi32(0x00000001);
+    const __m256i sel_q = _mm256_set1_epi32(0x00010000);
+    const __m256i mask_i = _mm256_set1_epi32(0x0000ffff);
+    const __m256i mask_q = _mm256_set1_epi32((int) 0xffff0000);
+
+    __m256i acc_i_sq = zero, acc_q_sq = zero;
+
+    while (n - k >= 8) {
+        const size_t end = k + block_len(n - k, 8);
+        __m256i acc_i = zero, acc_q = zero;
+
+        for (; k < end; k += 8) {
+            const __m256i v =
+                _mm256_loadu_si256((const __m256i *) &samples[2 * k]);
+            const __m256i sq_i =
+                _mm256_madd_epi16(v, _mm256_and_si256(v, mask_i));
+            const __m256i sq_q =
+                _mm256_madd_epi16(v, _mm256_and_si256(v, mask_q));
+
+            acc_i = _mm256_add_epi32(acc_i, _mm256_madd_epi16(v, sel_i));
+            acc_q = _mm256_add_epi32(acc_q, _mm256_madd_epi16(v, sel_q));
+
+            acc_i_sq = _mm256_add_epi64(acc_i_sq,
+                                        _mm256_unpacklo_epi32(sq_i, zero));
+            acc_i_sq = _mm256_add_epi64(acc_i_sq,
+                                        _mm256_unpackhi_epi32(sq_i, zero));
+            acc_q_sq = _mm256_add_epi64(acc_q_sq,
+                                        _mm256_unpacklo_epi32(sq_q, zero));
+            acc_q_sq = _mm256_add_epi64(acc_q_sq,
+                                        _mm256_unpackhi_epi32(sq_q, zero));
+        }
+
+        sums->i += hsum256_epi32(acc_i);
+        sums->q += hsum256_epi32(acc_q);
+    }
+
+    sums->i_sq += hsum256_epi64(acc_i_sq);
+    sums->q_sq += hsum256_epi64(acc_q_sq);
+
+    sums_sse2(&samples[2 * k], n - k, sums);
+}
+#endif
+
+#if SAMPLE_STATS_NEON
+static inline int64_t hsum_s32(int32x4_t v)
+{
+    const int64x2_t tmp = vpaddlq_s32(v);
+    return vgetq_lane_s64(tmp, 0) + vgetq_lane_s64(tmp, 1);
+}
+
+static inline int64_t hsum_s64(int64x2_t v)
+{
+    return vgetq_lane_s64(v, 0) + vgetq_lane_s64(v, 1);
+}
+
+static void sums_neon(const int16_t *samples, size_t n,
+                      struct sample_sums *sums)
+{
+    size_t k = 0;
+    int64x2_t acc_i_sq = vdupq_n_s64(0);
+    int64x2_t acc_q_sq = vdupq_n_s64(0);
+
+    while (n - k >= 8) {
+        const size_t end = k + block_len(n - k, 8);
+        int32x4_t acc_i = vdupq_n_s32(0);
+        int32x4_t acc_q = vdupq_n_s32(0);
+
+        for (; k < end; k += 8) {
+            /* De-interleaves into 8 I values and 8 Q values */
+            const int16x8x2_t v = vld2q_s16(&samples[2 * k]);
+            const int16x4_t i_lo = vget_low_s16(v.val[0]);
+            const int16x4_t i_hi = vget_high_s16(v.val[0]);
+            const int16x4_t q_lo = vget_low_s16(v.val[1]);
+            const int16x4_t q_hi = vget_high_s16(v.val[1]);
+
+            acc_i = vpadalq_s16(acc_i, v.val[0]);
+            acc_q = vpadalq_s16(acc_q, v.val[1]);
+
+            acc_i_sq = vpadalq_s32(acc_i_sq, vmull_s16(i_lo, i_lo));
+            acc_i_sq = vpadalq_s32(acc_i_sq, vmull_s16(i_hi, i_hi));
+            acc_q_sq = vpadalq_s32(acc_q_sq, vmull_s16(q_lo, q_lo));
+            acc_q_sq = vpadalq_s32(acc_q_sq, vmull_s16(q_hi, q_hi));
+        }
+
+        sums->i += hsum_s32(acc_i);
+        sums->q += hsum_s32(acc_q);
+    }
+
+    sums->i_sq += hsum_s64(acc_i_sq);
+    sums->q_sq += hsum_s64(acc_q_sq);
+
+    sums_generic(&samples[2 * k], n - k, sums);
+}
+#endif
+
+struct sums_impl {
+    const char *name;
+    void (*fn)(const int16_t *samples, size_t n, struct sample_sums *sums);
+};
+
+static const struct sums_impl *get_impl(void)
+{
+#if SAMPLE_STATS_AVX2
+    static const struct sums_impl avx2 = { "avx2", sums_avx2 };
+#endif
+#if SAMPLE_STATS_SSE2
+    static const struct sums_impl sse2 = { "sse2", sums_sse2 };
+#endif
+#if SAMPLE_STATS_NEON
+    static const struct sums_impl neon = { "neon", sums_neon };
+#endif
+#if !SAMPLE_STATS_SSE2 && !SAMPLE_STATS_NEON
+    static const struct sums_impl generic = { "generic", sums_generic };
+#endif
+
+#if SAMPLE_STATS_AVX2
+    /* This only reads the CPU feature data populated at program startup */
+    if (__builtin_cpu_supports("avx2")) {
+        return &avx2;
+    }
+#endif
+
+#if SAMPLE_STATS_SSE2
+    return &sse2;
+#elif SAMPLE_STATS_NEON
+    return &neon;
+#else
+    return &generic;
+#endif
+}
+
+void sample_sums(const int16_t *samples, size_t n, struct sample_sums *sums)
+{
+    memset(sums, 0, sizeof(*sums));
+    sums->n = n;
+    get_impl()->fn(samples, n, sums);
+}
+
+void sample_mean(const int16_t *samples, size_t n,
+                 float *mean_i, float *mean_q)
+{
+    struct sample_sums sums;
+
+    if (n == 0) {
+        *mean_i = *mean_q = 0.0f;
+        return;
+    }
+
+    sample_sums(samples, n, &sums);
+    *mean_i = (float) ((double) sums.i / n);
+    *mean_q = (float) ((double) sums.q / n);
+}
+
+void sample_dc(const int16_t *samples, size_t n,
+               int16_t *dc_i, int16_t *dc_q)
+{
+    struct sample_sums sums;
+
+    if (n == 0) {
+        *dc_i = *dc_q = 0;
+        return;
+    }
+
+    sample_sums(samples, n, &sums);
+    *dc_i = (int16_t) (sums.i / (int64_t) n);
+    *dc_q = (int16_t) (sums.q / (int64_t) n);
+}
+
+void sample_variance(const int16_t *samples, size_t n,
+                     float *var_i, float *var_q)
+{
+    struct sample_sums sums;
+    double n_d;
+
+    if (n < 2) {
+        *var_i = *var_q = 0.0f;
+        return;
+    }
+
+    sample_sums(samples, n, &sums);
+    n_d = (double) n;
+
+    *var_i = (float) ((sums.i_sq - (double) sums.i * sums.i / n_d) /
+                      (n_d - 1));
+
+    *var_q = (float) ((sums.q_sq - (double) sums.q * sums.q / n_d) /
+                      (n_d - 1));
+}
+
+float sample_power(const int16_t *samples, size_t n)
+{
+    struct sample_sums sums;
+
+    if (n == 0) {
+        return 0.0f;
+    }
+
+    sample_sums(samples, n, &sums);
+    return (float) ((double) (sums.i_sq + sums.q_sq) / n);
+}
+
+const char *sample_stats_impl(void)
+{
+    return get_impl()->name;
+}
@@ -30,6 +30,40 @@
 
 #include "sha256.h"
 
+/*
+ * The SHA extensions of x86 and ARMv8 are compiled in via function
+ * attributes, and used if they are available at runtime.  Otherwise, the
+ * portable scalar implementation below is used.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    ((defined(__GNUC__) && __GNUC__ >= 5) || defined(__clang__))
+#   define SHA256_SHANI 1
+#   include <cpuid.h>
+#   include <immintrin.h>
+#else
+#   define SHA256_SHANI 0
+#endif
+
+#if defined(__aarch64__) && \
+    (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+    /* Enabled by the compiler flags, so it is always available */
+#   define SHA256_ARMV8 1
+#   define SHA256_ARMV8_TARGET
+#   include <arm_neon.h>
+#elif defined(__aarch64__) && defined(__linux__) && \
+    defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 6
+#   define SHA256_ARMV8 1
+#   define SHA256_ARMV8_HWCAP 1
+#   define SHA256_ARMV8_TARGET __attribute__((target("+crypto")))
+#   include <arm_neon.h>
+#   include <sys/auxv.h>
+#   ifndef HWCAP_SHA2
+#       define HWCAP_SHA2 (1 << 6)
+#   endif
+#else
+#   define SHA256_ARMV8 0
+#endif
+
 #if BLADERF_BIG_ENDIAN == 1
 
 /* Copy a vector of big-endian uint32_t into a vector of bytes */
@@ -233,6 +267,175 @@ SHA256_Transform(uint32_t * state, const unsigned char block[64])
 		state[i] += S[i];
 }
 
+/* Compress a sequence of 512-bit blocks with SHA256_Transform() */
+static void
+SHA256_Transform_scalar(uint32_t * state, const unsigned char *blocks,
+    size_t n)
+{
+
+	for (; n > 0; n--, blocks += 64)
+		SHA256_Transform(state, blocks);
+}
+
+#if SHA256_SHANI || SHA256_ARMV8
+/* Round constants, four per vector of message words */
+static const uint32_t K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+#endif
+
+#if SHA256_SHANI
+/*
+ * Compress a sequence of 512-bit blocks with the x86 SHA extensions.  The
+ * rounds instruction operates on the state as {A,B,E,F} and {C,D,G,H}, and
+ * each iteration of the inner loop computes four words of the message
+ * schedule W and performs the four rounds that use them.
+ */
+__attribute__((target("sha,sse4.1")))
+static void
+SHA256_Transform_shani(uint32_t * state, const unsigned char *blocks,
+    size_t n)
+{
+	const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+	    0x0405060700010203ULL);
+	__m128i abef, cdgh, abef_save, cdgh_save, tmp, msg;
+	__m128i w0, w1, w2, w3;
+	int i;
+
+	/* Load {A,B,C,D}, {E,F,G,H} and rearrange them */
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]),
+	    0xb1);
+	cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]),
+	    0x1b);
+	abef = _mm_alignr_epi8(tmp, cdgh, 8);
+	cdgh = _mm_blend_epi16(cdgh, tmp, 0xf0);
+
+	for (; n > 0; n--, blocks += 64) {
+		abef_save = abef;
+		cdgh_save = cdgh;
+		w0 = w1 = w2 = w3 = _mm_setzero_si128();
+
+		for (i = 0; i < 16; i++) {
+			if (i < 4) {
+				msg = _mm_loadu_si128(
+				    (const __m128i *)&blocks[16 * i]);
+				msg = _mm_shuffle_epi8(msg, bswap);
+			} else {
+				msg = _mm_sha256msg1_epu32(w0, w1);
+				msg = _mm_add_epi32(msg,
+				    _mm_alignr_epi8(w3, w2, 4));
+				msg = _mm_sha256msg2_epu32(msg, w3);
+			}
+
+			w0 = w1;
+			w1 = w2;
+			w2 = w3;
+			w3 = msg;
+
+			msg = _mm_add_epi32(msg,
+			    _mm_loadu_si128((const __m128i *)&K[4 * i]));
+			cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+			msg = _mm_shuffle_epi32(msg, 0x0e);
+			abef = _mm_sha256rnds2_epu32(abef, cdgh, msg);
+		}
+
+		abef = _mm_add_epi32(abef, abef_save);
+		cdgh = _mm_add_epi32(cdgh, cdgh_save);
+	}
+
+	/* Restore {A,B,C,D}, {E,F,G,H} */
+	tmp = _mm_shuffle_epi32(abef, 0x1b);
+	cdgh = _mm_shuffle_epi32(cdgh, 0xb1);
+	_mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, cdgh, 0xf0));
+	_mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(cdgh, tmp, 8));
+}
+
+static int
+have_shani(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	if (__get_cpuid_max(0, NULL) < 7)
+		return (0);
+
+	/* SSSE3 and SSE4.1 */
+	__cpuid(1, eax, ebx, ecx, edx);
+	if ((ecx & (1 << 9)) == 0 || (ecx & (1 << 19)) == 0)
+		return (0);
+
+	/* SHA */
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	return ((ebx & (1 << 29)) != 0);
+}
+#endif
+
+#if SHA256_ARMV8
+/*
+ * Compress a sequence of 512-bit blocks with the ARMv8 cryptography
+ * extensions.  Each iteration of the inner loop computes four words of the
+ * message schedule W and performs the four rounds that use them.
+ */
+SHA256_ARMV8_TARGET
+static void
+SHA256_Transform_armv8(uint32_t * state, const unsigned char *blocks,
+    size_t n)
+{
+	uint32x4_t abcd, efgh, abcd_save, efgh_save, tmp, msg;
+	uint32x4_t w0, w1, w2, w3;
+	int i;
+
+	abcd = vld1q_u32(&state[0]);
+	efgh = vld1q_u32(&state[4]);
+
+	for (; n > 0; n--, blocks += 64) {
+		abcd_save = abcd;
+		efgh_save = efgh;
+		w0 = w1 = w2 = w3 = vdupq_n_u32(0);
+
+		for (i = 0; i < 16; i++) {
+			if (i < 4) {
+				msg = vreinterpretq_u32_u8(
+				    vrev32q_u8(vld1q_u8(&blocks[16 * i])));
+			} else {
+				msg = vsha256su1q_u32(vsha256su0q_u32(w0, w1),
+				    w2, w3);
+			}
+
+			w0 = w1;
+			w1 = w2;
+			w2 = w3;
+			w3 = msg;
+
+			msg = vaddq_u32(msg, vld1q_u32(&K[4 * i]));
+			tmp = abcd;
+			abcd = vsha256hq_u32(abcd, efgh, msg);
+			efgh = vsha256h2q_u32(efgh, tmp, msg);
+		}
+
+		abcd = vaddq_u32(abcd, abcd_save);
+		efgh = vaddq_u32(efgh, efgh_save);
+	}
+
+	vst1q_u32(&state[0], abcd);
+	vst1q_u32(&state[4], efgh);
+}
+#endif
+
 static unsigned char PAD[64] = {
 	0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
 	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
@@ -262,11 +465,55 @@ SHA256_Pad(SHA256_CTX * ctx)
 	SHA256_Update(ctx, len, 8);
 }
 
+struct sha256_impl {
+	const char *name;
+	void (*transform)(uint32_t *, const unsigned char *, size_t);
+};
+
+static const struct sha256_impl *
+get_impl(void)
+{
+#if SHA256_SHANI
+	static const struct sha256_impl shani =
+	    { "sha-ni", SHA256_Transform_shani };
+#endif
+#if SHA256_ARMV8
+	static const struct sha256_impl armv8 =
+	    { "armv8-ce", SHA256_Transform_armv8 };
+#endif
+	static const struct sha256_impl scalar =
+	    { "scalar", SHA256_Transform_scalar };
+
+#if SHA256_SHANI
+	if (have_shani())
+		return (&shani);
+#endif
+
+#if SHA256_ARMV8
+#   if SHA256_ARMV8_HWCAP
+	if (getauxval(AT_HWCAP) & HWCAP_SHA2)
+#   endif
+		return (&armv8);
+#endif
+
+	return (&scalar);
+}
+
+const char *
+SHA256_Impl(void)
+{
+
+	return (get_impl()->name);
+}
+
 /* SHA-256 initialization.  Begins a SHA-256 operation. */
 void
 SHA256_Init(SHA256_CTX * ctx)
 {
 
+	/* Compression function for this CPU */
+	ctx->transform = get_impl()->transform;
+
 	/* Zero bits processed so far */
 	ctx->count[0] = ctx->count[1] = 0;
 
@@ -309,15 +556,15 @@ SHA256_Update(SHA256_CTX * ctx, const void *in, size_t len)
 
 	/* Finish the current block */
 	memcpy(&ctx->buf[r], src, 64 - r);
-	SHA256_Transform(ctx->state, ctx->buf);
+	ctx->transform(ctx->state, ctx->buf, 1);
 	src += 64 - r;
 	len -= 64 - r;
 
 	/* Perform complete blocks */
-	while (len >= 64) {
-		SHA256_Transform(ctx->state, src);
-		src += 64;
-		len -= 64;
+	if (len >= 64) {
+		ctx->transform(ctx->state, src, len / 64);
+		src += len & ~(size_t)0x3f;
+		len &= 0x3f;
 	}
 
 	/* Copy left over data into buffer */
@@ -0,0 +1,239 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (c) 2014 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+    /* Required for pthread_setaffinity_np() and CPU_SET() */
+#   define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <string.h>
+#include "host_config.h"
+#include "thread.h"
+
+#if BLADERF_OS_LINUX || BLADERF_OS_OSX
+#   include <sched.h>
+#   include <sys/mman.h>
+#endif
+
+#if BLADERF_OS_WINDOWS
+static inline HANDLE thread_handle(pthread_t thread)
+{
+    return (HANDLE) pthread_getw32threadhandle_np(thread);
+}
+#endif
+
+int thread_set_sched(pthread_t thread, thread_sched_policy policy,
+                     int priority)
+{
+#if BLADERF_OS_LINUX || BLADERF_OS_OSX
+    struct sched_param param;
+    int os_policy;
+
+    memset(&param, 0, sizeof(param));
+
+    switch (policy) {
+        case THREAD_SCHED_DEFAULT:
+            os_policy = SCHED_OTHER;
+            param.sched_priority = 0;
+            break;
+
+        case THREAD_SCHED_FIFO:
+            os_policy = SCHED_FIFO;
+            param.sched_priority = priority;
+            break;
+
+        case THREAD_SCHED_RR:
+            os_policy = SCHED_RR;
+            param.sched_priority = priority;
+            break;
+
+        default:
+            return EINVAL;
+    }
+
+    return pthread_setschedparam(thread, os_policy, &param);
+
+#elif BLADERF_OS_WINDOWS
+    int win_priority;
+
+    /* Windows has no real-time policies per se; the closest we can get is
+     * the highest priority level within our process' priority class. */
+    switch (policy) {
+        case THREAD_SCHED_DEFAULT:
+            win_priority = THREAD_PRIORITY_NORMAL;
+            break;
+
+        case THREAD_SCHED_FIFO:
+        case THREAD_SCHED_RR:
+            win_priority = THREAD_PRIORITY_TIME_CRITICAL;
+            break;
+
+        default:
+            return EINVAL;
+    }
+
+    if (!SetThreadPriority(thread_handle(thread), win_priority)) {
+        return EPERM;
+    }
+
+    return 0;
+#else
+    return ENOSYS;
+#endif
+}
+
+int thread_set_affinity(pthread_t thread, uint64_t cpu_mask)
+{
+#if BLADERF_OS_LINUX
+    cpu_set_t cpus;
+    unsigned int i;
+
+    if (cpu_mask == 0) {
+        return EINVAL;
+    }
+
+    CPU_ZERO(&cpus);
+    for (i = 0; i < 64; i++) {
+        if (cpu_mask & ((uint64_t) 1 << i)) {
+            CPU_SET(i, &cpus);
+        }
+    }
+
+    return pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+
+#elif BLADERF_OS_WINDOWS
+    if (SetThreadAffinityMask(thread_handle(thread),
+                              (DWORD_PTR) cpu_mask) == 0) {
+        return EINVAL;
+    }
+
+    return 0;
+#else
+    /* OSX only supports affinity "tags" as scheduler hints, not masks */
+    return ENOSYS;
+#endif
+}
+
+int thread_lock_memory(void)
+{
+#if BLADERF_OS_LINUX || BLADERF_OS_OSX
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        return errno;
+    }
+
+    return 0;
+#else
+    return ENOSYS;
+#endif
+}
+
+int thread_save_sched(pthread_t thread, struct thread_sched_state *state)
+{
+    memset(state, 0, sizeof(*state));
+
+#if BLADERF_OS_LINUX || BLADERF_OS_OSX
+    {
+        struct sched_param param;
+        int status = pthread_getschedparam(thread, &state->policy, &param);
+
+        if (status != 0) {
+            return status;
+        }
+
+        state->priority = param.sched_priority;
+    }
+#endif
+
+#if BLADERF_OS_LINUX
+    {
+        cpu_set_t cpus;
+        unsigned int i;
+        int count = 0;
+
+        if (pthread_getaffinity_np(thread, sizeof(cpus), &cpus) == 0) {
+            for (i = 0; i < 64; i++) {
+                if (CPU_ISSET(i, &cpus)) {
+                    state->affinity |= ((uint64_t) 1 << i);
+                    count++;
+                }
+            }
+
+            /* Only CPUs 0-63 may be represented in the saved mask */
+            state->affinity_saved = (count != 0 && count == CPU_COUNT(&cpus));
+        }
+    }
+#elif BLADERF_OS_WINDOWS
+    {
+        DWORD_PTR process_mask, system_mask;
+
+        state->priority = GetThreadPriority(thread_handle(thread));
+
+        /* There's no way to query a thread's affinity directly. Threads
+         * inherit the process affinity, so we assume it hasn't changed. */
+        if (GetProcessAffinityMask(GetCurrentProcess(),
+                                   &process_mask, &system_mask)) {
+            state->affinity = process_mask;
+            state->affinity_saved = true;
+        }
+    }
+#endif
+
+    return 0;
+}
+
+int thread_restore_sched(pthread_t thread,
+                         const struct thread_sched_state *state)
+{
+    int status = 0;
+
+#if BLADERF_OS_LINUX || BLADERF_OS_OSX
+    struct sched_param param;
+
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = state->priority;
+    status = pthread_setschedparam(thread, state->policy, &param);
+#endif
+
+#if BLADERF_OS_LINUX
+    if (state->affinity_saved) {
+        int affinity_status = thread_set_affinity(thread, state->affinity);
+        if (status == 0) {
+            status = affinity_status;
+        }
+    }
+#elif BLADERF_OS_WINDOWS
+    if (!SetThreadPriority(thread_handle(thread), state->priority)) {
+        status = EPERM;
+    }
+
+    if (state->affinity_saved &&
+        SetThreadAffinityMask(thread_handle(thread),
+                              (DWORD_PTR) state->affinity) == 0) {
+        status = EINVAL;
+    }
+#endif
+
+    return status;
+}
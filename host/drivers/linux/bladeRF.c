@@ -28,6 +28,8 @@
 #include <linux/mutex.h>
 #include <linux/wait.h>
 #include <linux/uaccess.h>
+#include <linux/mm.h>
+#include <linux/poll.h>
 #include "../../../firmware_common/bladeRF.h"
 
 struct data_buffer {
@@ -44,6 +46,9 @@ typedef struct {
     int                   intnum;
     int                   disconnecting;
 
+    unsigned int          num_bufs;             // buffers per ring, a power of two
+    unsigned int          buf_size;             // bytes per buffer
+
     //    0   1   2   3   4   5   6   7   8   9   10  11  12  13  14  15
     //  |   |   |   | X | X | X | X | X | S | S | S | S |   |   |   |   |
     //                ^                   ^               ^ producer index
@@ -60,7 +65,7 @@ typedef struct {
     atomic_t              data_in_queued;       // number of buffers with data unread by the usermode application [transmit index - transmit index]
     atomic_t              data_in_used;         // number of buffers that may be inflight or have unread data [transmit index - consumer index]
     atomic_t              data_in_inflight;     // number of buffers currently in the USB stack [transmit index - consumer index]
-    struct data_buffer    data_in_bufs[NUM_DATA_URB];
+    struct data_buffer   *data_in_bufs;         // dev->num_bufs entries
     struct usb_anchor     data_in_anchor;
     wait_queue_head_t     data_in_wait;
 
@@ -81,19 +86,56 @@ typedef struct {
     atomic_t              data_out_queued;
     atomic_t              data_out_used;
     atomic_t              data_out_inflight;
-    struct data_buffer    data_out_bufs[NUM_DATA_URB];
+    struct data_buffer   *data_out_bufs;
     struct usb_anchor     data_out_anchor;
     wait_queue_head_t     data_out_wait;
 
     // allow only one reader and writer
     struct file           *reader, *writer;
 
+    // statistics, protected by data_in_lock and data_out_lock, respectively
+    u64                   rx_buffers;
+    u32                   rx_overruns;
+    u32                   rx_errors;
+    int                   rx_stalled;           // every RX buffer holds unread data
+    u64                   tx_buffers;
+    u32                   tx_underruns;
+    u32                   tx_errors;
+
+    // RX metadata checking, when the FPGA's timestamp headers are enabled
+    int                   rx_meta;
+    int                   rx_ts_valid;
+    u64                   rx_next_ts;
+    u32                   rx_gaps;
+    u64                   rx_gap_ticks;
+
     int bytes;
     int debug;
 } bladerf_device_t;
 
 static struct usb_driver bladerf_driver;
 
+static unsigned int num_bufs = NUM_DATA_URB;
+module_param(num_bufs, uint, 0444);
+MODULE_PARM_DESC(num_bufs, "Default number of buffers per RX and TX ring, a power of two");
+
+static unsigned int buf_size = DATA_BUF_SZ;
+module_param(buf_size, uint, 0444);
+MODULE_PARM_DESC(buf_size, "Default size of each ring buffer in bytes, a multiple of 1024");
+
+static int ring_config_valid(unsigned int nbufs, unsigned int size)
+{
+    // the ring indices wrap by masking, and all of the concurrent URBs must fit
+    if (nbufs < NUM_CONCURRENT || nbufs > BLADE_RING_MAX_BUFS || (nbufs & (nbufs - 1)))
+        return 0;
+
+    // buffers hold whole USB 3.0 bulk packets
+    if (size < 1024 || size > BLADE_RING_MAX_BUF_SZ || (size % 1024))
+        return 0;
+
+    return 1;
+}
+
 // USB PID-VID table
 static struct usb_device_id bladerf_table[] = {
     { USB_DEVICE(USB_NUAND_VENDOR_ID, USB_NUAND_BLADERF_PRODUCT_ID) },
@@ -108,7 +150,7 @@ static int __submit_rx_urb(bladerf_device_t *dev, unsigned int flags) {
 
     do {
         spin_lock_irqsave(&dev->data_in_lock, irq_flags);
-        if (atomic_read(&dev->data_in_inflight) < NUM_CONCURRENT && atomic_read(&dev->data_in_used) < NUM_DATA_URB) {
+        if (atomic_read(&dev->data_in_inflight) < NUM_CONCURRENT && atomic_read(&dev->data_in_used) < dev->num_bufs) {
             urb = dev->data_in_bufs[dev->data_in_producer_idx].urb;
 
             if (!dev->data_in_bufs[dev->data_in_producer_idx].valid) {
@@ -128,6 +170,15 @@ static int __submit_rx_urb(bladerf_device_t *dev, unsigned int flags) {
                 atomic_dec(&dev->data_in_inflight);
                 goto leave_rx;
             }
+            dev->rx_stalled = 0;
+        } else {
+            // all buffers hold data the application has yet to read, so the
+            // FPGA's FIFO will overflow and samples will be dropped
+            if (atomic_read(&dev->data_in_inflight) == 0 && dev->rx_en && !dev->rx_stalled) {
+                dev->rx_overruns++;
+                dev->rx_stalled = 1;
+            }
+            break;
         }
     } while(1);
     spin_unlock_irqrestore(&dev->data_in_lock, irq_flags);
@@ -137,6 +188,35 @@ leave_rx:
 }
 
 static void __bladeRF_write_cb(struct urb *urb);
+static inline int __urb_failed(struct urb *urb) {
+    // URBs killed when streaming is disabled are not errors
+    return urb->status && urb->status != -ENOENT &&
+           urb->status != -ECONNRESET && urb->status != -ESHUTDOWN;
+}
+
+/* Check the timestamps in the metadata headers of a received buffer for
+ * discontinuities. Must be called with data_in_lock held. */
+static void __check_rx_meta(bladerf_device_t *dev, const unsigned char *buf, unsigned int len) {
+    const unsigned int msg_size = (dev->udev->speed == USB_SPEED_SUPER) ? 2048 : 1024;
+    // with the 2x timestamp divider, the timestamp counts samples
+    const u64 msg_ticks = (msg_size - BLADE_META_HEADER_SZ) / 4;
+    unsigned int off;
+    u64 ts;
+
+    for (off = 0; off + msg_size <= len; off += msg_size) {
+        ts = le64_to_cpup((const __le64 *)(buf + off + BLADE_META_TIMESTAMP_OFFSET));
+
+        if (dev->rx_ts_valid && ts != dev->rx_next_ts) {
+            dev->rx_gaps++;
+            if (ts > dev->rx_next_ts)
+                dev->rx_gap_ticks += ts - dev->rx_next_ts;
+        }
+
+        dev->rx_next_ts = ts + msg_ticks;
+        dev->rx_ts_valid = 1;
+    }
+}
+
 static void __bladeRF_read_cb(struct urb *urb) {
     bladerf_device_t *dev;
     unsigned char *buf;
@@ -144,12 +224,21 @@ static void __bladeRF_read_cb(struct urb *urb) {
 
     usb_unanchor_urb(urb);
 
-    spin_lock_irqsave(&dev->data_in_lock, flags);
     buf = (unsigned char *)urb->transfer_buffer;
     dev = (bladerf_device_t *)urb->context;
+
+    spin_lock_irqsave(&dev->data_in_lock, flags);
     atomic_dec(&dev->data_in_inflight);
-    dev->bytes += DATA_BUF_SZ;
+    dev->bytes += dev->buf_size;
     atomic_inc(&dev->data_in_queued);
+
+    if (__urb_failed(urb)) {
+        dev->rx_errors++;
+    } else if (urb->status == 0) {
+        dev->rx_buffers++;
+        if (dev->rx_meta)
+            __check_rx_meta(dev, buf, urb->actual_length);
+    }
     spin_unlock_irqrestore(&dev->data_in_lock, flags);
 
     if (dev->rx_en)
@@ -157,39 +246,70 @@ static void __bladeRF_read_cb(struct urb *urb) {
     wake_up_interruptible(&dev->data_in_wait);
 }
 
+static void bladerf_stop(bladerf_device_t *dev) {
+    unsigned int i;
+
+    if (dev->data_in_bufs) {
+        for (i = 0; i < dev->num_bufs; i++) {
+            usb_free_coherent(dev->udev, dev->buf_size, dev->data_in_bufs[i].addr, dev->data_in_bufs[i].dma);
+            usb_free_urb(dev->data_in_bufs[i].urb);
+        }
+    }
+
+    if (dev->data_out_bufs) {
+        for (i = 0; i < dev->num_bufs; i++) {
+            usb_free_coherent(dev->udev, dev->buf_size, dev->data_out_bufs[i].addr, dev->data_out_bufs[i].dma);
+            usb_free_urb(dev->data_out_bufs[i].urb);
+        }
+    }
+
+    kfree(dev->data_in_bufs);
+    kfree(dev->data_out_bufs);
+    dev->data_in_bufs = NULL;
+    dev->data_out_bufs = NULL;
+}
+
+/* Allocate dev->num_bufs buffers of dev->buf_size bytes for each ring */
 static int bladerf_start(bladerf_device_t *dev) {
-    int i;
+    unsigned int i;
     void *buf;
     struct urb *urb;
 
+    dev->data_in_bufs = kcalloc(dev->num_bufs, sizeof(struct data_buffer), GFP_KERNEL);
+    dev->data_out_bufs = kcalloc(dev->num_bufs, sizeof(struct data_buffer), GFP_KERNEL);
+    if (!dev->data_in_bufs || !dev->data_out_bufs) {
+        dev_err(&dev->interface->dev, "Could not allocate data buffer tables\n");
+        goto err_out;
+    }
+
     dev->rx_en = 0;
     atomic_set(&dev->data_in_queued, 0);
     atomic_set(&dev->data_in_used, 0);
     dev->data_in_consumer_idx = 0;
     dev->data_in_producer_idx = 0;
 
-    for (i = 0; i < NUM_DATA_URB; i++) {
-        buf = usb_alloc_coherent(dev->udev, DATA_BUF_SZ,
+    for (i = 0; i < dev->num_bufs; i++) {
+        buf = usb_alloc_coherent(dev->udev, dev->buf_size,
                 GFP_KERNEL, &dev->data_in_bufs[i].dma);
-        memset(buf, 0, DATA_BUF_SZ);
         if (!buf) {
             dev_err(&dev->interface->dev, "Could not allocate data IN buffer\n");
-            return -1;
+            goto err_out;
         }
 
+        memset(buf, 0, dev->buf_size);
         dev->data_in_bufs[i].addr = buf;
 
         urb = usb_alloc_urb(0, GFP_KERNEL);
-        if (!buf) {
+        if (!urb) {
             dev_err(&dev->interface->dev, "Could not allocate data IN URB\n");
-            return -1;
+            goto err_out;
         }
 
         dev->data_in_bufs[i].urb = urb;
         dev->data_in_bufs[i].valid = 1;
 
         usb_fill_bulk_urb(urb, dev->udev, usb_rcvbulkpipe(dev->udev, 1),
-                dev->data_in_bufs[i].addr, DATA_BUF_SZ, __bladeRF_read_cb, dev);
+                dev->data_in_bufs[i].addr, dev->buf_size, __bladeRF_read_cb, dev);
 
         urb->transfer_flags |= URB_NO_TRANSFER_DMA_MAP;
         urb->transfer_dma = dev->data_in_bufs[i].dma;
@@ -202,52 +322,75 @@ static int bladerf_start(bladerf_device_t *dev) {
     dev->data_out_consumer_idx = 0;
     dev->data_out_producer_idx = 0;
 
-    for (i = 0; i < NUM_DATA_URB; i++) {
-        buf = usb_alloc_coherent(dev->udev, DATA_BUF_SZ,
+    for (i = 0; i < dev->num_bufs; i++) {
+        buf = usb_alloc_coherent(dev->udev, dev->buf_size,
                 GFP_KERNEL, &dev->data_out_bufs[i].dma);
-        memset(buf, 0, DATA_BUF_SZ);
         if (!buf) {
             dev_err(&dev->interface->dev, "Could not allocate data OUT buffer\n");
-            return -1;
+            goto err_out;
         }
 
+        memset(buf, 0, dev->buf_size);
         dev->data_out_bufs[i].addr = buf;
 
         urb = usb_alloc_urb(0, GFP_KERNEL);
-        if (!buf) {
+        if (!urb) {
             dev_err(&dev->interface->dev, "Could not allocate data OUT URB\n");
-            return -1;
+            goto err_out;
         }
 
         dev->data_out_bufs[i].urb = urb;
         dev->data_out_bufs[i].valid = 0;
 
         usb_fill_bulk_urb(urb, dev->udev, usb_sndbulkpipe(dev->udev, 1),
-                dev->data_out_bufs[i].addr, DATA_BUF_SZ, __bladeRF_write_cb, dev);
+                dev->data_out_bufs[i].addr, dev->buf_size, __bladeRF_write_cb, dev);
 
         urb->transfer_flags |= URB_NO_TRANSFER_DMA_MAP;
         urb->transfer_dma = dev->data_out_bufs[i].dma;
     }
 
-
     return 0;
+
+err_out:
+    bladerf_stop(dev);
+    return -ENOMEM;
 }
 
-static void bladerf_stop(bladerf_device_t *dev) {
-    int i;
-    for (i = 0; i < NUM_DATA_URB; i++) {
-        usb_free_coherent(dev->udev, DATA_BUF_SZ, dev->data_in_bufs[i].addr, dev->data_in_bufs[i].dma);
-        usb_free_urb(dev->data_in_bufs[i].urb);
-        usb_free_coherent(dev->udev, DATA_BUF_SZ, dev->data_out_bufs[i].addr, dev->data_out_bufs[i].dma);
-        usb_free_urb(dev->data_out_bufs[i].urb);
+/* Enable or disable RF RX or TX in the FX3, which reports a status word */
+static int __bladerf_rf_cmd(bladerf_device_t *dev, int cmd, int enable) {
+    __le32 *fx3_ret;
+    int retval;
+
+    fx3_ret = kmalloc(sizeof(*fx3_ret), GFP_KERNEL);
+    if (!fx3_ret)
+        return -ENOMEM;
+
+    retval = usb_control_msg(dev->udev, usb_rcvctrlpipe(dev->udev, 0),
+            cmd, BLADE_USB_TYPE_IN, enable ? 1 : 0, 0,
+            fx3_ret, sizeof(*fx3_ret), BLADE_USB_TIMEOUT_MS);
+
+    if (retval >= 0) {
+        retval = le32_to_cpu(*fx3_ret);
+
+        // 0x44 (CY_U3P_ERROR_ALREADY_STARTED) is harmless
+        if (retval && retval != 0x44) {
+            dev_err(&dev->interface->dev, "FX3 reported error=0x%x when %s RF %s\n",
+                    retval, enable ? "enabling" : "disabling",
+                    cmd == BLADE_USB_CMD_RF_RX ? "RX" : "TX");
+            retval = -EIO;
+        } else {
+            retval = 0;
+        }
     }
+
+    kfree(fx3_ret);
+    return retval;
 }
 
-int __bladerf_snd_cmd(bladerf_device_t *dev, int cmd, void *ptr, __u16 len);
 static int disable_tx(bladerf_device_t *dev) {
+    unsigned long flags;
+    unsigned int i;
     int ret;
-    unsigned int val;
-    val = 0;
 
     if (dev->intnum != 1)
         return -1;
@@ -256,25 +399,29 @@ static int disable_tx(bladerf_device_t *dev) {
 
     usb_kill_anchored_urbs(&dev->data_out_anchor);
 
-    ret = __bladerf_snd_cmd(dev, BLADE_USB_CMD_RF_TX, &val, sizeof(val));
-    if (ret < 0)
-        goto err_out;
+    // discard buffers that were queued but never submitted
+    spin_lock_irqsave(&dev->data_out_lock, flags);
+    for (i = 0; i < dev->num_bufs; i++)
+        dev->data_out_bufs[i].valid = 0;
+    atomic_set(&dev->data_out_queued, 0);
+    atomic_set(&dev->data_out_used, 0);
+    dev->data_out_consumer_idx = 0;
+    dev->data_out_producer_idx = 0;
+    spin_unlock_irqrestore(&dev->data_out_lock, flags);
+    wake_up_interruptible(&dev->data_out_wait);
 
-    ret = 0;
+    ret = __bladerf_rf_cmd(dev, BLADE_USB_CMD_RF_TX, 0);
 
-err_out:
     return ret;
 }
 
 static int enable_tx(bladerf_device_t *dev) {
     int ret;
-    unsigned int val;
-    val = 1;
 
     if (dev->intnum != 1)
         return -1;
 
-    ret = __bladerf_snd_cmd(dev, BLADE_USB_CMD_RF_TX, &val, sizeof(val));
+    ret = __bladerf_rf_cmd(dev, BLADE_USB_CMD_RF_TX, 1);
     if (ret < 0)
         goto err_out;
 
@@ -287,8 +434,6 @@ err_out:
 
 static int disable_rx(bladerf_device_t *dev) {
     int ret;
-    unsigned int val;
-    val = 0;
 
     if (dev->intnum != 1)
         return -1;
@@ -297,7 +442,7 @@ static int disable_rx(bladerf_device_t *dev) {
 
     usb_kill_anchored_urbs(&dev->data_in_anchor);
 
-    ret = __bladerf_snd_cmd(dev, BLADE_USB_CMD_RF_RX, &val, sizeof(val));
+    ret = __bladerf_rf_cmd(dev, BLADE_USB_CMD_RF_RX, 0);
     if (ret < 0)
         goto err_out;
 
@@ -314,8 +459,6 @@ err_out:
 static int enable_rx(bladerf_device_t *dev) {
     int ret;
     int i;
-    unsigned int val;
-    val = 1;
 
     if (dev->intnum != 1)
         return -1;
@@ -323,10 +466,13 @@ static int enable_rx(bladerf_device_t *dev) {
     if (dev->disconnecting)
         return -ENODEV;
 
-    for (i = 0; i < NUM_DATA_URB; i++)
+    for (i = 0; i < dev->num_bufs; i++)
         dev->data_in_bufs[i].valid = 1;
 
-    ret = __bladerf_snd_cmd(dev, BLADE_USB_CMD_RF_RX, &val, sizeof(val));
+    dev->rx_stalled = 0;
+    dev->rx_ts_valid = 0;
+
+    ret = __bladerf_rf_cmd(dev, BLADE_USB_CMD_RF_RX, 1);
     if (ret < 0)
         goto err_out;
 
@@ -344,17 +490,24 @@ err_out:
     return ret;
 }
 
+/* Move as many queued RX buffers as fit into the caller's buffer, blocking
+ * only until the first one is available */
 static ssize_t bladerf_read(struct file *file, char __user *buf, size_t count, loff_t *ppos)
 {
     ssize_t ret = 0;
+    size_t copied = 0;
     bladerf_device_t *dev;
     unsigned long flags;
+    unsigned int idx;
 
     dev = (bladerf_device_t *)file->private_data;
     if (dev->intnum != 1) {
         return -1;
     }
 
+    if (count < dev->buf_size)
+        return -EINVAL;
+
     if (dev->reader) {
         if (file != dev->reader) {
             return -EPERM;
@@ -371,55 +524,47 @@ static ssize_t bladerf_read(struct file *file, char __user *buf, size_t count, l
         }
     }
 
-    do {
+    while (count - copied >= dev->buf_size) {
         spin_lock_irqsave(&dev->data_in_lock, flags);
-        if (atomic_read(&dev->data_in_queued)) {
-            unsigned int idx;
+        if (!atomic_read(&dev->data_in_queued)) {
+            spin_unlock_irqrestore(&dev->data_in_lock, flags);
 
-            atomic_dec(&dev->data_in_queued);
-            atomic_dec(&dev->data_in_used);
-            idx = dev->data_in_consumer_idx++;
-            dev->data_in_consumer_idx &= (NUM_DATA_URB - 1);
+            // return what we have rather than waiting for more
+            if (copied)
+                break;
 
-            spin_unlock_irqrestore(&dev->data_in_lock, flags);
+            ret = wait_event_interruptible(dev->data_in_wait, atomic_read(&dev->data_in_queued));
+            if (ret < 0)
+                break;
 
-            if (copy_to_user(buf, dev->data_in_bufs[idx].addr, DATA_BUF_SZ)) {
-                ret = -EFAULT;
-            } else {
-                ret = 0;
-            }
+            continue;
+        }
 
-            dev->data_in_bufs[idx].valid = 1; // mark this RX packet as free
+        atomic_dec(&dev->data_in_queued);
+        atomic_dec(&dev->data_in_used);
+        idx = dev->data_in_consumer_idx++;
+        dev->data_in_consumer_idx &= (dev->num_bufs - 1);
 
-            // in case all of the buffers were full, rx needs to be restarted
-            // samples may have also been dropped if this happens because the user-mode
-            // application is not reading samples fast enough
+        spin_unlock_irqrestore(&dev->data_in_lock, flags);
 
-            if (atomic_read(&dev->data_in_inflight) == 0)
-                __submit_rx_urb(dev, 0);
+        ret = copy_to_user(buf + copied, dev->data_in_bufs[idx].addr, dev->buf_size) ? -EFAULT : 0;
 
-            if (!ret)
-                ret = DATA_BUF_SZ;
+        dev->data_in_bufs[idx].valid = 1; // mark this RX packet as free
 
+        if (ret)
             break;
 
-        } else {
-            spin_unlock_irqrestore(&dev->data_in_lock, flags);
-            ret = wait_event_interruptible(dev->data_in_wait, atomic_read(&dev->data_in_queued));
-            spin_lock_irqsave(&dev->data_in_lock, flags);
-            if (ret < 0) {
-                break;
-            } else if (ret == 0) {
-                ret = -ETIMEDOUT;
-                break;
-            } else {
-                ret = 0;
-            }
-        }
-    } while (1);
-    spin_unlock_irqrestore(&dev->data_in_lock, flags);
+        copied += dev->buf_size;
+    }
 
-    return ret;
+    // in case all of the buffers were full, rx needs to be restarted
+    // samples may have also been dropped if this happens because the user-mode
+    // application is not reading samples fast enough
+
+    if (atomic_read(&dev->data_in_inflight) == 0)
+        __submit_rx_urb(dev, 0);
+
+    return copied ? copied : ret;
 }
 
 static int __submit_tx_urb(bladerf_device_t *dev) {
@@ -444,7 +589,7 @@ static int __submit_tx_urb(bladerf_device_t *dev) {
             // is used and copy_from_user() has copied data into the buffer
             db->valid = 0;
             dev->data_out_consumer_idx++;
-            dev->data_out_consumer_idx &= (NUM_DATA_URB - 1);
+            dev->data_out_consumer_idx &= (dev->num_bufs - 1);
 
             atomic_dec(&dev->data_out_queued);
 
@@ -479,11 +624,20 @@ static void __bladeRF_write_cb(struct urb *urb)
     atomic_dec(&dev->data_out_inflight);
     atomic_dec(&dev->data_out_used);
 
+    if (__urb_failed(urb))
+        dev->tx_errors++;
+    else if (urb->status == 0)
+        dev->tx_buffers++;
+
+    // the application did not keep up, or has stopped transmitting
+    if (dev->tx_en && !atomic_read(&dev->data_out_inflight) && !atomic_read(&dev->data_out_queued))
+        dev->tx_underruns++;
+
     spin_unlock_irqrestore(&dev->data_out_lock, flags);
 
     if (dev->tx_en)
         __submit_tx_urb(dev);
-    dev->bytes += DATA_BUF_SZ;
+    dev->bytes += dev->buf_size;
     wake_up_interruptible(&dev->data_out_wait);
 }
 
@@ -496,6 +650,7 @@ static ssize_t bladerf_write(struct file *file, const char *user_buf, size_t cou
     unsigned int idx;
     int reread;
     int status = 0;
+    size_t written = 0, len;
 
     /* TODO truncate count to be within range of ssize_t here? */
 
@@ -530,40 +685,216 @@ static ssize_t bladerf_write(struct file *file, const char *user_buf, size_t cou
     } else
         dev->writer = file;
 
-    reread = atomic_read(&dev->data_out_used);
-    if (reread >= NUM_DATA_URB) {
-        status = wait_event_interruptible(dev->data_out_wait, atomic_read(&dev->data_out_used) < NUM_DATA_URB);
+    // fill and submit as many buffers as the request spans, zero-padding a
+    // partial final buffer
+    while (written < count) {
+        len = min_t(size_t, count - written, dev->buf_size);
 
-        if (status < 0) {
-            return status;
-        } else if (status == 0) {
-            return -ETIMEDOUT;
+        reread = atomic_read(&dev->data_out_used);
+        if (reread >= dev->num_bufs) {
+            status = wait_event_interruptible(dev->data_out_wait, atomic_read(&dev->data_out_used) < dev->num_bufs);
+
+            if (status < 0) {
+                break;
+            }
         }
+
+        spin_lock_irqsave(&dev->data_out_lock, flags);
+
+        idx = dev->data_out_producer_idx++;
+        dev->data_out_producer_idx &= (dev->num_bufs - 1);
+        db = &dev->data_out_bufs[idx];
+        atomic_inc(&dev->data_out_queued);
+        atomic_inc(&dev->data_out_used);
+
+        spin_unlock_irqrestore(&dev->data_out_lock, flags);
+
+        if (copy_from_user(db->addr, user_buf + written, len)) {
+            memset(db->addr, 0, dev->buf_size);
+            status = -EFAULT;
+        } else if (len < dev->buf_size) {
+            memset((char *)db->addr + len, 0, dev->buf_size - len);
+        }
+
+        // the buffer was claimed, so it is submitted even on failure
+        db->valid = 1; // mark this TX packet as having valid data
+
+        __submit_tx_urb(dev);
+        if (!dev->tx_en)
+            enable_tx(dev);
+
+        if (status < 0)
+            break;
+
+        written += len;
     }
 
-    spin_lock_irqsave(&dev->data_out_lock, flags);
+    return written ? written : status;
+}
 
-    idx = dev->data_out_producer_idx++;
-    dev->data_out_producer_idx &= (NUM_DATA_URB - 1);
-    db = &dev->data_out_bufs[idx];
-    atomic_inc(&dev->data_out_queued);
-    atomic_inc(&dev->data_out_used);
+/* Reallocate the rings. This is only permitted while neither RX nor TX is
+ * in use, as the buffers are freed. Existing mappings of the rings must be
+ * unmapped beforehand; they would otherwise retain the old buffers. */
+static int bladerf_set_ring_config(bladerf_device_t *dev, void __user *arg)
+{
+    struct bladeRF_ring_config cfg;
+    unsigned int old_num_bufs, old_buf_size;
+    int ret;
 
-    spin_unlock_irqrestore(&dev->data_out_lock, flags);
+    if (copy_from_user(&cfg, arg, sizeof(cfg)))
+        return -EFAULT;
+
+    if (!ring_config_valid(cfg.num_bufs, cfg.buf_size))
+        return -EINVAL;
+
+    if (dev->disconnecting)
+        return -ENODEV;
+
+    if (dev->rx_en || dev->tx_en || dev->reader || dev->writer)
+        return -EBUSY;
 
-    if (copy_from_user(db->addr, user_buf, count)) {
+    if (cfg.num_bufs == dev->num_bufs && cfg.buf_size == dev->buf_size)
+        return 0;
+
+    old_num_bufs = dev->num_bufs;
+    old_buf_size = dev->buf_size;
+
+    bladerf_stop(dev);
+
+    dev->num_bufs = cfg.num_bufs;
+    dev->buf_size = cfg.buf_size;
+
+    ret = bladerf_start(dev);
+    if (ret) {
+        dev_err(&dev->interface->dev, "Failed to allocate %u buffers of %u bytes, reverting to %u of %u\n",
+                cfg.num_bufs, cfg.buf_size, old_num_bufs, old_buf_size);
+
+        dev->num_bufs = old_num_bufs;
+        dev->buf_size = old_buf_size;
+        if (bladerf_start(dev))
+            dev_err(&dev->interface->dev, "Failed to reallocate data buffers\n");
+    }
+
+    return ret;
+}
+
+/* Release RX buffers read via the mmap()'d ring and report ready buffers */
+static int bladerf_rx_ring_advance(bladerf_device_t *dev, struct file *file, void __user *arg)
+{
+    struct bladeRF_ring_pos pos;
+    unsigned long flags;
+    unsigned int i;
+
+    if (dev->intnum != 1)
+        return -EINVAL;
+
+    if (dev->disconnecting)
+        return -ENODEV;
+
+    if (copy_from_user(&pos, arg, sizeof(pos)))
         return -EFAULT;
+
+    if (dev->reader) {
+        if (file != dev->reader) {
+            return -EPERM;
+        }
+    } else
+        dev->reader = file;
+
+    if (!dev->rx_en) {
+        if (enable_rx(dev)) {
+            return -EINVAL;
+        }
+    }
+
+    spin_lock_irqsave(&dev->data_in_lock, flags);
+
+    if (pos.count > atomic_read(&dev->data_in_queued)) {
+        spin_unlock_irqrestore(&dev->data_in_lock, flags);
+        return -EINVAL;
+    }
+
+    for (i = 0; i < pos.count; i++) {
+        dev->data_in_bufs[dev->data_in_consumer_idx].valid = 1; // mark this RX packet as free
+        dev->data_in_consumer_idx++;
+        dev->data_in_consumer_idx &= (dev->num_bufs - 1);
     }
 
-    db->valid = 1; // mark this TX packet as having valid data
+    atomic_sub(pos.count, &dev->data_in_queued);
+    atomic_sub(pos.count, &dev->data_in_used);
 
-    __submit_tx_urb(dev);
-    if (!dev->tx_en)
-        enable_tx(dev);
+    i = pos.count;
+    pos.idx = dev->data_in_consumer_idx;
+    pos.count = atomic_read(&dev->data_in_queued);
 
-    return count;
+    spin_unlock_irqrestore(&dev->data_in_lock, flags);
+
+    // resubmit the released buffers, which restarts rx if all of them were full
+    if (i)
+        __submit_rx_urb(dev, 0);
+
+    if (copy_to_user(arg, &pos, sizeof(pos)))
+        return -EFAULT;
+
+    return 0;
 }
 
+/* Submit TX buffers filled via the mmap()'d ring and report free buffers */
+static int bladerf_tx_ring_advance(bladerf_device_t *dev, struct file *file, void __user *arg)
+{
+    struct bladeRF_ring_pos pos;
+    unsigned long flags;
+    unsigned int i;
+
+    if (dev->intnum != 1)
+        return -EINVAL;
+
+    if (dev->disconnecting)
+        return -ENODEV;
+
+    if (copy_from_user(&pos, arg, sizeof(pos)))
+        return -EFAULT;
+
+    if (dev->writer) {
+        if (file != dev->writer) {
+            return -EPERM;
+        }
+    } else
+        dev->writer = file;
+
+    spin_lock_irqsave(&dev->data_out_lock, flags);
+
+    if (pos.count > dev->num_bufs - atomic_read(&dev->data_out_used)) {
+        spin_unlock_irqrestore(&dev->data_out_lock, flags);
+        return -EINVAL;
+    }
+
+    for (i = 0; i < pos.count; i++) {
+        dev->data_out_bufs[dev->data_out_producer_idx].valid = 1; // mark this TX packet as having valid data
+        dev->data_out_producer_idx++;
+        dev->data_out_producer_idx &= (dev->num_bufs - 1);
+    }
+
+    atomic_add(pos.count, &dev->data_out_queued);
+    atomic_add(pos.count, &dev->data_out_used);
+
+    i = pos.count;
+    pos.idx = dev->data_out_producer_idx;
+    pos.count = dev->num_bufs - atomic_read(&dev->data_out_used);
+
+    spin_unlock_irqrestore(&dev->data_out_lock, flags);
+
+    if (i) {
+        __submit_tx_urb(dev);
+        if (!dev->tx_en)
+            enable_tx(dev);
+    }
+
+    if (copy_to_user(arg, &pos, sizeof(pos)))
+        return -EFAULT;
+
+    return 0;
+}
 
 int __bladerf_rcv_cmd(bladerf_device_t *dev, int cmd, void *ptr, __u16 len) {
     int tries = 3;
@@ -648,6 +979,278 @@ err_out:
     return retval;
 }
 
+/* Perform a single register access on a peripheral behind the FPGA's UART */
+static int __bladerf_uart_cmd(bladerf_device_t *dev, int targetdev, int write, struct uart_cmd *spi_reg) {
+    unsigned char buf[16];
+    int count, nread, tries;
+    int retval;
+
+    nread = count = 16;
+    memset(buf, 0, sizeof(buf));
+    buf[0] = 'N';
+
+    if (write) {
+        buf[1] = UART_PKT_MODE_DIR_WRITE | targetdev | 0x01;
+        buf[2] = spi_reg->addr;
+        buf[3] = spi_reg->data;
+    } else {
+        buf[1] = UART_PKT_MODE_DIR_READ | targetdev | 0x01;
+        buf[2] = spi_reg->addr;
+        buf[3] = 0xff;
+    }
+
+    retval = usb_bulk_msg(dev->udev, usb_sndbulkpipe(dev->udev, 2), buf, count, &nread, BLADE_USB_TIMEOUT_MS);
+    if (!retval) {
+        memset(buf, 0, sizeof(buf));
+
+        tries = 3;
+        do {
+            retval = usb_bulk_msg(dev->udev, usb_rcvbulkpipe(dev->udev, 0x82), buf, count, &nread, BLADE_USB_TIMEOUT_MS);
+        } while(retval == -ETIMEDOUT && tries--);
+
+        if (!retval) {
+            spi_reg->addr = buf[2];
+            spi_reg->data = buf[3];
+        }
+    }
+
+    return retval;
+}
+
+/* Enable or disable the FPGA's metadata headers (and its timestamp counter,
+ * in single-sample units) so that RX buffers carry timestamps */
+static int bladerf_set_rx_meta(bladerf_device_t *dev, void __user *arg) {
+    struct uart_cmd reg;
+    unsigned int enable;
+    int retval;
+
+    if (dev->intnum != 1)
+        return -EINVAL;
+
+    if (copy_from_user(&enable, arg, sizeof(enable)))
+        return -EFAULT;
+
+    reg.addr = BLADE_GPIO_TIMESTAMP_ADDR;
+    reg.data = 0;
+    retval = __bladerf_uart_cmd(dev, UART_PKT_DEV_GPIO, 0, &reg);
+    if (retval)
+        return retval;
+
+    if (enable)
+        reg.data |= BLADE_GPIO_TIMESTAMP_BITS;
+    else
+        reg.data &= ~BLADE_GPIO_TIMESTAMP_BITS;
+
+    reg.addr = BLADE_GPIO_TIMESTAMP_ADDR;
+    retval = __bladerf_uart_cmd(dev, UART_PKT_DEV_GPIO, 1, &reg);
+    if (retval)
+        return retval;
+
+    dev->rx_meta = enable ? 1 : 0;
+    dev->rx_ts_valid = 0;
+    return 0;
+}
+
+static void bladerf_get_stats(bladerf_device_t *dev, struct bladeRF_stats *stats) {
+    unsigned long flags;
+
+    memset(stats, 0, sizeof(*stats));
+
+    spin_lock_irqsave(&dev->data_in_lock, flags);
+    stats->rx_buffers = dev->rx_buffers;
+    stats->rx_gap_ticks = dev->rx_gap_ticks;
+    stats->rx_overruns = dev->rx_overruns;
+    stats->rx_errors = dev->rx_errors;
+    stats->rx_gaps = dev->rx_gaps;
+    stats->rx_inflight = atomic_read(&dev->data_in_inflight);
+    stats->rx_queued = atomic_read(&dev->data_in_queued);
+    spin_unlock_irqrestore(&dev->data_in_lock, flags);
+
+    spin_lock_irqsave(&dev->data_out_lock, flags);
+    stats->tx_buffers = dev->tx_buffers;
+    stats->tx_underruns = dev->tx_underruns;
+    stats->tx_errors = dev->tx_errors;
+    stats->tx_inflight = atomic_read(&dev->data_out_inflight);
+    stats->tx_queued = atomic_read(&dev->data_out_queued);
+    spin_unlock_irqrestore(&dev->data_out_lock, flags);
+}
+
+/* Start or stop streaming in one direction. The file becomes the reader or
+ * writer of the device, so that streaming stops when it is closed. */
+static int bladerf_rf_enable(bladerf_device_t *dev, struct file *file, int rx, unsigned int enable) {
+    struct file **owner = rx ? &dev->reader : &dev->writer;
+    int retval = 0;
+
+    if (dev->intnum != 1) {
+        dev_err(&dev->interface->dev, "Cannot enable %s from config mode\n", rx ? "RX" : "TX");
+        return -EINVAL;
+    }
+
+    if (dev->disconnecting)
+        return -ENODEV;
+
+    if (*owner && *owner != file)
+        return -EPERM;
+
+    if (rx) {
+        if (enable && !dev->rx_en)
+            retval = enable_rx(dev);
+        else if (!enable && dev->rx_en)
+            retval = disable_rx(dev);
+    } else {
+        if (enable && !dev->tx_en)
+            retval = enable_tx(dev);
+        else if (!enable && dev->tx_en)
+            retval = disable_tx(dev);
+    }
+
+    if (!retval)
+        *owner = enable ? file : NULL;
+
+    return retval;
+}
+
+/* Perform a control transfer on behalf of user space, returning the number
+ * of bytes transferred */
+static int bladerf_usb_control(bladerf_device_t *dev, struct file *file, void __user *arg) {
+    struct bladeRF_usb_control ctrl;
+    unsigned char *buf;
+    unsigned int pipe;
+    __le32 fx3_ret = 0;
+    int type, in;
+    int retval;
+
+    if (copy_from_user(&ctrl, arg, sizeof(ctrl)))
+        return -EFAULT;
+
+    if (ctrl.len > BLADE_USB_CONTROL_MAX_LEN)
+        return -EINVAL;
+
+    if (dev->disconnecting)
+        return -ENODEV;
+
+    type = ctrl.request_type & USB_TYPE_MASK;
+    in = ctrl.request_type & USB_DIR_IN;
+
+    // standard requests altering the device's state would confuse the driver
+    if (type != USB_TYPE_VENDOR && !(type == USB_TYPE_STANDARD && in))
+        return -EPERM;
+
+    // our transfers must be started and stopped along with the FX3's
+    if (type == USB_TYPE_VENDOR &&
+            (ctrl.request == BLADE_USB_CMD_RF_RX || ctrl.request == BLADE_USB_CMD_RF_TX)) {
+        retval = bladerf_rf_enable(dev, file, ctrl.request == BLADE_USB_CMD_RF_RX, ctrl.value);
+        if (retval)
+            return retval;
+
+        retval = min_t(int, ctrl.len, sizeof(fx3_ret));
+        if (in && copy_to_user(ctrl.ptr, &fx3_ret, retval))
+            return -EFAULT;
+
+        return retval;
+    }
+
+    buf = kmalloc(ctrl.len ? ctrl.len : 1, GFP_KERNEL);
+    if (!buf)
+        return -ENOMEM;
+
+    if (!in && copy_from_user(buf, ctrl.ptr, ctrl.len)) {
+        retval = -EFAULT;
+        goto out;
+    }
+
+    pipe = in ? usb_rcvctrlpipe(dev->udev, 0) : usb_sndctrlpipe(dev->udev, 0);
+    retval = usb_control_msg(dev->udev, pipe, ctrl.request, ctrl.request_type,
+            ctrl.value, ctrl.index, buf, ctrl.len, ctrl.timeout_ms);
+
+    if (retval > 0 && in && copy_to_user(ctrl.ptr, buf, retval))
+        retval = -EFAULT;
+
+out:
+    kfree(buf);
+    return retval;
+}
+
+/* Perform a bulk transfer on a peripheral endpoint on behalf of user space,
+ * returning the number of bytes transferred */
+static int bladerf_usb_bulk(bladerf_device_t *dev, void __user *arg) {
+    struct bladeRF_usb_bulk bulk;
+    unsigned int done, chunk, pipe;
+    unsigned char *buf;
+    int actual, in;
+    int retval = 0;
+
+    if (copy_from_user(&bulk, arg, sizeof(bulk)))
+        return -EFAULT;
+
+    if ((bulk.endpoint & ~USB_DIR_IN) != 0x02 || bulk.len > INT_MAX)
+        return -EINVAL;
+
+    if (dev->disconnecting)
+        return -ENODEV;
+
+    in = bulk.endpoint & USB_DIR_IN;
+    pipe = in ? usb_rcvbulkpipe(dev->udev, 2) : usb_sndbulkpipe(dev->udev, 2);
+
+    buf = kmalloc(min_t(unsigned int, bulk.len ? bulk.len : 1, BLADE_USB_BULK_MAX_LEN), GFP_KERNEL);
+    if (!buf)
+        return -ENOMEM;
+
+    /* A zero-length OUT transfer sends a ZLP, e.g., to terminate a bitstream */
+    if (bulk.len == 0 && !in)
+        retval = usb_bulk_msg(dev->udev, pipe, buf, 0, &actual, bulk.timeout_ms);
+
+    for (done = 0; done < bulk.len; done += actual) {
+        chunk = min_t(unsigned int, bulk.len - done, BLADE_USB_BULK_MAX_LEN);
+
+        if (!in && copy_from_user(buf, bulk.ptr + done, chunk)) {
+            retval = -EFAULT;
+            break;
+        }
+
+        retval = usb_bulk_msg(dev->udev, pipe, buf, chunk, &actual, bulk.timeout_ms);
+        if (retval)
+            break;
+
+        if (in && copy_to_user(bulk.ptr + done, buf, actual)) {
+            retval = -EFAULT;
+            break;
+        }
+
+        if (actual < chunk) {
+            done += actual;
+            break;
+        }
+    }
+
+    kfree(buf);
+    return retval ? retval : done;
+}
+
+/* Select an alternate setting of interface 0, which stops streaming */
+static int bladerf_set_interface(bladerf_device_t *dev, void __user *arg) {
+    unsigned int alt;
+    int retval;
+
+    if (copy_from_user(&alt, arg, sizeof(alt)))
+        return -EFAULT;
+
+    if (dev->disconnecting)
+        return -ENODEV;
+
+    if (dev->rx_en)
+        disable_rx(dev);
+
+    if (dev->tx_en)
+        disable_tx(dev);
+
+    retval = usb_set_interface(dev->udev, 0, alt);
+    if (!retval)
+        dev->intnum = alt;
+
+    return retval;
+}
+
 long bladerf_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 {
     bladerf_device_t *dev;
@@ -661,8 +1264,10 @@ long bladerf_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
     int pages_to_write, page_idx;
     int pages_to_read;
     int check_idx;
-    int count, tries;
+    int count;
     int targetdev;
+    struct bladeRF_ring_info ring_info;
+    struct bladeRF_stats stats;
 
     /* FIXME this large buffer should be kmalloc'd and kept with the dev, no? */
     unsigned char buf[1024];
@@ -1037,25 +1642,13 @@ leave_fw:
             break;
 
         case BLADE_RF_RX:
-            if (dev->intnum != 1) {
-                dev_err(&dev->interface->dev, "Cannot enable RX from config mode\n");
-                retval = -1;
-                break;
-            }
-
-            printk("RF_RX!\n");
-            retval = __bladerf_snd_one_word(dev, BLADE_USB_CMD_RF_RX, data);
-            break;
-
         case BLADE_RF_TX:
-            if (dev->intnum != 1) {
-                dev_err(&dev->interface->dev, "Cannot enable TX from config mode\n");
-                retval = -1;
+            if (copy_from_user(&ret, data, sizeof(ret))) {
+                retval = -EFAULT;
                 break;
             }
 
-            printk("RF_TX!\n");
-            retval = __bladerf_snd_one_word(dev, BLADE_USB_CMD_RF_TX, data);
+            retval = bladerf_rf_enable(dev, file, cmd == BLADE_RF_RX, ret);
             break;
 
         case BLADE_LMS_WRITE:
@@ -1071,10 +1664,6 @@ leave_fw:
                 break;
             }
 
-            nread = count = 16;
-            memset(buf, 0, 20);
-            buf[0] = 'N';
-
             targetdev = UART_PKT_DEV_SI5338;
             if (cmd == BLADE_GPIO_WRITE || cmd == BLADE_GPIO_READ)
                 targetdev = UART_PKT_DEV_GPIO;
@@ -1083,30 +1672,10 @@ leave_fw:
             if (cmd == BLADE_VCTCXO_WRITE)
                 targetdev = UART_PKT_DEV_VCTCXO;
 
-            if (cmd == BLADE_LMS_WRITE || cmd == BLADE_GPIO_WRITE || cmd == BLADE_SI5338_WRITE || cmd == BLADE_VCTCXO_WRITE) {
-                buf[1] = UART_PKT_MODE_DIR_WRITE | targetdev | 0x01;
-                buf[2] = spi_reg.addr;
-                buf[3] = spi_reg.data;
-            } else if (cmd == BLADE_LMS_READ || cmd == BLADE_GPIO_READ || cmd == BLADE_SI5338_READ) {
-                buf[1] = UART_PKT_MODE_DIR_READ | targetdev | 0x01;
-                buf[2] = spi_reg.addr;
-                buf[3] = 0xff;
-            }
-
-            retval = usb_bulk_msg(dev->udev, usb_sndbulkpipe(dev->udev, 2), buf, count, &nread, BLADE_USB_TIMEOUT_MS);
+            retval = __bladerf_uart_cmd(dev, targetdev,
+                    cmd == BLADE_LMS_WRITE || cmd == BLADE_GPIO_WRITE || cmd == BLADE_SI5338_WRITE || cmd == BLADE_VCTCXO_WRITE,
+                    &spi_reg);
             if (!retval) {
-                memset(buf, 0, 20);
-
-                tries = 3;
-                do {
-                    retval = usb_bulk_msg(dev->udev, usb_rcvbulkpipe(dev->udev, 0x82), buf, count, &nread, BLADE_USB_TIMEOUT_MS);
-                } while(retval == -ETIMEDOUT && tries--);
-
-                if (!retval) {
-                    spi_reg.addr = buf[2];
-                    spi_reg.data = buf[3];
-                }
-
                 if (copy_to_user((void __user *)arg, &spi_reg, sizeof(struct uart_cmd))) {
                     retval = -EFAULT;
                 } else {
@@ -1142,6 +1711,55 @@ leave_fw:
             }
             break;
 
+        case BLADE_RING_INFO:
+            ring_info.num_bufs = dev->num_bufs;
+            ring_info.buf_size = dev->buf_size;
+            ring_info.rx_offset = BLADE_MMAP_RX_OFFSET;
+            ring_info.tx_offset = BLADE_MMAP_RX_OFFSET + dev->num_bufs * dev->buf_size;
+            if (copy_to_user(data, &ring_info, sizeof(ring_info))) {
+                retval = -EFAULT;
+            } else {
+                retval = 0;
+            }
+            break;
+
+        case BLADE_GET_STATS:
+            bladerf_get_stats(dev, &stats);
+            if (copy_to_user(data, &stats, sizeof(stats))) {
+                retval = -EFAULT;
+            } else {
+                retval = 0;
+            }
+            break;
+
+        case BLADE_SET_RX_META:
+            retval = bladerf_set_rx_meta(dev, data);
+            break;
+
+        case BLADE_SET_RING_CONFIG:
+            retval = bladerf_set_ring_config(dev, data);
+            break;
+
+        case BLADE_RX_RING_ADVANCE:
+            retval = bladerf_rx_ring_advance(dev, file, data);
+            break;
+
+        case BLADE_TX_RING_ADVANCE:
+            retval = bladerf_tx_ring_advance(dev, file, data);
+            break;
+
+        case BLADE_USB_CONTROL:
+            retval = bladerf_usb_control(dev, file, data);
+            break;
+
+        case BLADE_USB_BULK:
+            retval = bladerf_usb_bulk(dev, data);
+            break;
+
+        case BLADE_SET_INTERFACE:
+            retval = bladerf_set_interface(dev, data);
+            break;
+
     }
 
     return retval;
@@ -1194,15 +1812,129 @@ static int bladerf_release(struct inode *inode, struct file *file)
     return 0;
 }
 
+/* Map the RX ring at BLADE_MMAP_RX_OFFSET and the TX ring immediately after
+ * it, as reported by BLADE_RING_INFO. The rings' pages are inserted up front, so no fault
+ * handling is needed. This relies upon the coherent buffers residing in the
+ * kernel's linear mapping, as is the case on x86. */
+static int bladerf_mmap(struct file *file, struct vm_area_struct *vma)
+{
+    bladerf_device_t *dev;
+    unsigned long ring_pages, buf_pages;
+    unsigned long num_pages, pgoff, i;
+    struct data_buffer *bufs;
+    char *addr;
+    int ret;
+
+    dev = (bladerf_device_t *)file->private_data;
+
+    if (dev->disconnecting)
+        return -ENODEV;
+
+    // each page must belong to a single buffer
+    if (dev->buf_size % PAGE_SIZE)
+        return -EINVAL;
+
+    buf_pages = dev->buf_size >> PAGE_SHIFT;
+    ring_pages = dev->num_bufs * buf_pages;
+
+    num_pages = (vma->vm_end - vma->vm_start) >> PAGE_SHIFT;
+    if (vma->vm_pgoff + num_pages > 2 * ring_pages)
+        return -EINVAL;
+
+    for (i = 0; i < num_pages; i++) {
+        pgoff = vma->vm_pgoff + i;
+        bufs = (pgoff < ring_pages) ? dev->data_in_bufs : dev->data_out_bufs;
+        pgoff %= ring_pages;
+
+        addr = (char *)bufs[pgoff / buf_pages].addr + (pgoff % buf_pages) * PAGE_SIZE;
+        ret = vm_insert_page(vma, vma->vm_start + i * PAGE_SIZE, virt_to_page(addr));
+        if (ret)
+            return ret;
+    }
+
+    return 0;
+}
+
+static unsigned int bladerf_poll(struct file *file, poll_table *wait)
+{
+    bladerf_device_t *dev;
+    unsigned int mask = 0;
+
+    dev = (bladerf_device_t *)file->private_data;
+
+    poll_wait(file, &dev->data_in_wait, wait);
+    poll_wait(file, &dev->data_out_wait, wait);
+
+    if (dev->disconnecting)
+        return POLLERR | POLLHUP;
+
+    if (atomic_read(&dev->data_in_queued))
+        mask |= POLLIN | POLLRDNORM;
+
+    if (atomic_read(&dev->data_out_used) < dev->num_bufs)
+        mask |= POLLOUT | POLLWRNORM;
+
+    return mask;
+}
+
 static struct file_operations bladerf_fops = {
     .owner    =  THIS_MODULE,
     .read     =  bladerf_read,
     .write    =  bladerf_write,
+    .poll     =  bladerf_poll,
+    .mmap     =  bladerf_mmap,
     .unlocked_ioctl = bladerf_ioctl,
     .open     =  bladerf_open,
     .release  =  bladerf_release,
 };
 
+/* Streaming statistics, also available via BLADE_GET_STATS */
+#define BLADERF_STAT_ATTR(name_, fmt_)                                        \
+static ssize_t name_##_show(struct device *d, struct device_attribute *attr, char *buf) \
+{                                                                             \
+    bladerf_device_t *dev = usb_get_intfdata(to_usb_interface(d));            \
+    struct bladeRF_stats stats;                                               \
+    if (!dev)                                                                 \
+        return -ENODEV;                                                       \
+    bladerf_get_stats(dev, &stats);                                           \
+    return sprintf(buf, fmt_ "\n", stats.name_);                              \
+}                                                                             \
+static DEVICE_ATTR(name_, S_IRUGO, name_##_show, NULL)
+
+BLADERF_STAT_ATTR(rx_buffers, "%llu");
+BLADERF_STAT_ATTR(rx_overruns, "%u");
+BLADERF_STAT_ATTR(rx_errors, "%u");
+BLADERF_STAT_ATTR(rx_inflight, "%u");
+BLADERF_STAT_ATTR(rx_queued, "%u");
+BLADERF_STAT_ATTR(rx_gaps, "%u");
+BLADERF_STAT_ATTR(rx_gap_ticks, "%llu");
+BLADERF_STAT_ATTR(tx_buffers, "%llu");
+BLADERF_STAT_ATTR(tx_underruns, "%u");
+BLADERF_STAT_ATTR(tx_errors, "%u");
+BLADERF_STAT_ATTR(tx_inflight, "%u");
+BLADERF_STAT_ATTR(tx_queued, "%u");
+
+static struct attribute *bladerf_stat_attrs[] = {
+    &dev_attr_rx_buffers.attr,
+    &dev_attr_rx_overruns.attr,
+    &dev_attr_rx_errors.attr,
+    &dev_attr_rx_inflight.attr,
+    &dev_attr_rx_queued.attr,
+    &dev_attr_rx_gaps.attr,
+    &dev_attr_rx_gap_ticks.attr,
+    &dev_attr_tx_buffers.attr,
+    &dev_attr_tx_underruns.attr,
+    &dev_attr_tx_errors.attr,
+    &dev_attr_tx_inflight.attr,
+    &dev_attr_tx_queued.attr,
+    NULL
+};
+
+static const struct attribute_group bladerf_stat_group = {
+    .name  = "stats",
+    .attrs = bladerf_stat_attrs,
+};
+
 static struct usb_class_driver bladerf_class = {
     .name       = "bladerf%d",
     .fops       = &bladerf_fops,
@@ -1242,7 +1974,21 @@ static int bladerf_probe(struct usb_interface *interface,
     init_usb_anchor(&dev->data_out_anchor);
     init_waitqueue_head(&dev->data_out_wait);
 
-    bladerf_start(dev);
+    if (ring_config_valid(num_bufs, buf_size)) {
+        dev->num_bufs = num_bufs;
+        dev->buf_size = buf_size;
+    } else {
+        dev_warn(&interface->dev, "Invalid ring configuration (num_bufs=%u, buf_size=%u), using defaults\n", num_bufs, buf_size);
+        dev->num_bufs = NUM_DATA_URB;
+        dev->buf_size = DATA_BUF_SZ;
+    }
+
+    retval = bladerf_start(dev);
+    if (retval) {
+        usb_put_dev(dev->udev);
+        kfree(dev);
+        return retval;
+    }
 
     usb_set_intfdata(interface, dev);
 
@@ -1253,6 +1999,9 @@ static int bladerf_probe(struct usb_interface *interface,
         return retval;
     }
 
+    if (sysfs_create_group(&interface->dev.kobj, &bladerf_stat_group))
+        dev_warn(&interface->dev, "Unable to create statistics attributes\n");
+
     dev_info(&interface->dev, "Nuand bladeRF device is now attached\n");
     return 0;
 
@@ -1266,6 +2015,8 @@ static void bladerf_disconnect(struct usb_interface *interface)
     if (interface->cur_altsetting->desc.bInterfaceNumber != 0)
         return;
 
+    sysfs_remove_group(&interface->dev.kobj, &bladerf_stat_group);
+
     dev = usb_get_intfdata(interface);
 
     dev->disconnecting = 1;
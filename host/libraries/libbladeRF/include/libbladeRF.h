@@ -87,6 +87,8 @@ extern "C" {
 #define BLADERF_ERR_UPDATE_FPGA (-12) /**< An FPGA update is required */
 #define BLADERF_ERR_UPDATE_FW   (-13) /**< A firmware update is requied */
 #define BLADERF_ERR_TIME_PAST   (-14) /**< Requested timestamp is in the past */
+#define BLADERF_ERR_QUEUE_FULL  (-15) /**< Queue is full */
+#define BLADERF_ERR_WOULD_BLOCK (-16) /**< Operation would block */
 
 /** @} (End RETCODES) */
 
@@ -113,6 +115,9 @@ typedef enum {
     BLADERF_BACKEND_LINUX,  /**< Linux kernel driver */
     BLADERF_BACKEND_LIBUSB, /**< libusb */
     BLADERF_BACKEND_CYPRESS, /**< CyAPI */
+    BLADERF_BACKEND_USBFS,  /**< Linux usbfs, accessed directly */
+    BLADERF_BACKEND_NET,    /**< A device served by a remote host. See
+                             *   @ref FN_NET. */
     BLADERF_BACKEND_DUMMY = 100, /**< Dummy used for development purposes */
 } bladerf_backend;
 
@@ -188,6 +193,80 @@ API_EXPORT
 int CALL_CONV bladerf_open_with_devinfo(struct bladerf **device,
                                         struct bladerf_devinfo *devinfo);
 
+/**
+ * @defgroup FN_OPEN_FLAGS Open flags
+ *
+ * These flags may be passed to bladerf_open_with_flags() to defer portions of
+ * the work that opening a device normally entails, until that work is first
+ * required. This allows tools that only query or poke a device (e.g., read
+ * its serial number or a configuration GPIO) to open it quickly.
+ *
+ * @{
+ */
+
+/**
+ * Defer reading the VCTCXO trim and FPGA size from the calibration region of
+ * flash. These are read upon the first call to bladerf_get_vctcxo_trim() or
+ * bladerf_get_fpga_size(), when the device is initialized, or upon the first
+ * call to a function that triggers deferred FPGA work.
+ *
+ * As initializing the device requires these, this only has an effect in
+ * conjunction with ::BLADERF_OPEN_DEFER_FPGA.
+ */
+#define BLADERF_OPEN_DEFER_CAL_REGION   (1 << 0)
+
+/**
+ * Defer loading DC calibration tables from the configuration search path.
+ * These are loaded when the device is initialized, following an FPGA load, or
+ * upon the first call to a function that triggers deferred FPGA work.
+ *
+ * As initializing the device requires these, this only has an effect in
+ * conjunction with ::BLADERF_OPEN_DEFER_FPGA.
+ */
+#define BLADERF_OPEN_DEFER_DC_CALS      (1 << 1)
+
+/**
+ * Defer checking the FPGA's version, initializing the device if the FPGA is
+ * already configured, and autoloading an FPGA image from the configuration
+ * search path otherwise. This is performed upon the first call to a function
+ * that configures or queries the RF front end, expansion boards, or streams
+ * (e.g., bladerf_set_frequency(), bladerf_sync_config()).
+ *
+ * Low-level accessors, such as bladerf_lms_read(),
+ * bladerf_config_gpio_write(), and the flash functions, do not trigger this.
+ * Loading an FPGA via bladerf_load_fpga() supersedes the deferred autoload.
+ */
+#define BLADERF_OPEN_DEFER_FPGA         (1 << 2)
+
+/** Defer all of the above */
+#define BLADERF_OPEN_DEFER_ALL          (BLADERF_OPEN_DEFER_CAL_REGION | \
+                                         BLADERF_OPEN_DEFER_DC_CALS | \
+                                         BLADERF_OPEN_DEFER_FPGA)
+
+/** @} (End FN_OPEN_FLAGS) */
+
+/**
+ * Open the device specified by the provided bladerf_devinfo structure,
+ * deferring work as specified by \ref FN_OPEN_FLAGS
+ *
+ * bladerf_open_with_devinfo() is equivalent to this function with a `flags`
+ * value of 0.
+ *
+ * Errors in deferred work are reported by the function call that triggers
+ * it. Deferred work is attempted only once.
+ *
+ * @param[out]  device      Update with device handle on success
+ * @param[in]   devinfo     Device specification. If NULL, any available
+ *                          device will be opened.
+ * @param[in]   flags       Bitmask of BLADERF_OPEN_DEFER_* flags
+ *
+ * @return 0 on success, or value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_open_with_flags(struct bladerf **device,
+                                      struct bladerf_devinfo *devinfo,
+                                      uint32_t flags);
+
 /**
  * Open specified device using a device identifier string. See
  * bladerf_open_with_devinfo() if a device identifier string is not readily
@@ -207,6 +286,12 @@ int CALL_CONV bladerf_open_with_devinfo(struct bladerf **device,
  *   - libusb:  libusb (See libusb changelog notes for required version, given
  *   your OS and controller)
  *   - cypress: Cypress CyUSB/CyAPI backend (Windows only)
+ *   - linux:   bladeRF Linux kernel driver (host/drivers/linux). This is only
+ *              available when libbladeRF is built with
+ *              ENABLE_BACKEND_LINUX_DRIVER.
+ *   - dummy:   Emulated device, for development and benchmarking. This is
+ *              only available when libbladeRF is built with
+ *              ENABLE_BACKEND_DUMMY, and is never selected by "*".
  *
  * If no arguments are provided after the backend, the first encountered
  * device on the specified backend will be opened. Note that a backend is
@@ -236,6 +321,55 @@ API_EXPORT
 int CALL_CONV bladerf_open(struct bladerf **device,
                            const char *device_identifier);
 
+/**
+ * Open multiple devices concurrently
+ *
+ * Each device is opened from a separate thread. This includes any FPGA
+ * autoloading and calibration table loading that bladerf_open_with_devinfo()
+ * performs, which otherwise dominate the time taken to bring up many devices.
+ *
+ * @param[out]  devices     Array of `n` handles. Each is updated with the
+ *                          handle of the corresponding device, or NULL if that
+ *                          device could not be opened.
+ * @param[in]   devinfo     Array of `n` device specifications, such as those
+ *                          returned by bladerf_get_device_list()
+ * @param[out]  statuses    Optional array of `n` elements, updated with the
+ *                          bladerf_open_with_devinfo() result for each device.
+ *                          May be NULL.
+ * @param[in]   n           Number of devices to open
+ *
+ * @return Number of devices opened, or value from \ref RETCODES list if
+ *         the open operations could not be started
+ */
+API_EXPORT
+int CALL_CONV bladerf_open_many(struct bladerf **devices,
+                                struct bladerf_devinfo *devinfo,
+                                int *statuses, unsigned int n);
+
+/**
+ * Open all attached devices concurrently, via bladerf_open_many()
+ *
+ * Devices that could not be opened are omitted from the returned list.
+ *
+ * @param[out]  devices     Updated with a list of device handles, which
+ *                          should be closed and freed via bladerf_close_all()
+ *
+ * @return Number of devices opened, or value from \ref RETCODES list on
+ *         failure. BLADERF_ERR_NODEV is returned if no devices were found.
+ */
+API_EXPORT
+int CALL_CONV bladerf_open_all(struct bladerf ***devices);
+
+/**
+ * Close all devices in a list returned by bladerf_open_all(), and free the
+ * list
+ *
+ * @param   devices     Device list. This function does nothing if it is NULL.
+ * @param   n           Number of devices in the list
+ */
+API_EXPORT
+void CALL_CONV bladerf_close_all(struct bladerf **devices, unsigned int n);
+
 /**
  * Close device
  *
@@ -649,6 +783,10 @@ typedef enum
  *
  * When a synchronous stream is associated with the specified module, this
  * will shut down the underlying asynchronous stream when `enable` = false.
+ * A synchronous call on the module that is waiting for samples or buffers in
+ * another thread is woken, and returns ::BLADERF_ERR_INVAL, as do any later
+ * synchronous calls until the module's synchronous interface is configured
+ * again via bladerf_sync_config().
  *
  * When transmitting samples with the sync interface, be sure to provide ample
  * time for TX samples reach the FPGA and be transmitted before calling this
@@ -664,6 +802,50 @@ API_EXPORT
 int CALL_CONV bladerf_enable_module(struct bladerf *dev,
                                     bladerf_module m, bool enable);
 
+/**
+ * Place the device in a low power standby state, from which it may be
+ * brought back with bladerf_resume() much more quickly than it could be
+ * closed and reopened.
+ *
+ * This stops any frequency hopping, disables both modules (stopping their
+ * synchronous streams, as with bladerf_enable_module()), powers down the
+ * LMS6002D, and disables the RX and TX sample clocks. The USB session, FPGA
+ * configuration, calibration data, and the library's record of the device's
+ * register values are retained.
+ *
+ * While in standby, the timestamp counters do not advance, and
+ * bladerf_enable_module() will fail. Other settings may be changed, and take
+ * effect upon resuming.
+ *
+ * Calling this while already in standby has no effect.
+ *
+ * @param       dev     Device handle
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_standby(struct bladerf *dev);
+
+/**
+ * Return from the standby state entered via bladerf_standby().
+ *
+ * The sample clocks are re-enabled, and the LMS6002D configuration is written
+ * back to the device in a single batch, along with powering it up. The
+ * frequency, gain, bandwidth, and other RF settings in effect when standby
+ * was entered (or changed since) are thereby restored.
+ *
+ * Both modules are left disabled. To stream, configure the synchronous or
+ * asynchronous interface and enable the required modules, as usual.
+ *
+ * Calling this when the device is not in standby has no effect.
+ *
+ * @param       dev     Device handle
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_resume(struct bladerf *dev);
+
 /**
  * Apply specified loopback mode
  *
@@ -802,1063 +984,5719 @@ int CALL_CONV bladerf_get_rational_sample_rate(
                                         struct bladerf_rational_rate *rate);
 
 /**
- * Set the value of the specified configuration parameter
+ * Maximum decimation or interpolation factor supported by the FPGA
+ */
+#define BLADERF_DECIMATION_MAX 128
+
+/**
+ * Configure the FPGA to decimate received samples, or interpolate
+ * transmitted samples, by the specified factor.
  *
- * See the ::bladerf_correction description for the valid ranges of the
- * `value` parameter.
+ * The FPGA applies a CIC filter followed by a droop-compensating FIR filter
+ * (for TX, the FIR filter precedes the CIC filter). The samples exchanged with
+ * the host are then at the converter sample rate, as configured by
+ * bladerf_set_sample_rate(), divided by this factor. This reduces the USB
+ * bandwidth and host CPU load required for narrowband applications.
  *
- * @param   dev         Device handle
- * @param   module      Module to apply correction to
- * @param   corr        Correction type
- * @param   value       Value to apply
+ * A factor of 1 bypasses the filters. Timestamps continue to count samples at
+ * the converter rate.
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * This should be set while the associated module is disabled. This requires
+ * FPGA v0.1.5 or later.
+ *
+ * @param       dev         Device handle
+ * @param       module      Module to configure. For TX, this sets the
+ *                          interpolation factor.
+ * @param       factor      Decimation factor. Must be a power of 2 from 1
+ *                          through ::BLADERF_DECIMATION_MAX.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on an invalid factor,
+ *         BLADERF_ERR_UPDATE_FPGA if the FPGA does not support this feature,
+ *         or a value from \ref RETCODES list upon other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_set_correction(struct bladerf *dev, bladerf_module module,
-                                     bladerf_correction corr, int16_t value);
+int CALL_CONV bladerf_set_decimation(struct bladerf *dev,
+                                     bladerf_module module,
+                                     unsigned int factor);
 
 /**
- * Obtain the current value of the specified configuration parameter
+ * Get the decimation (RX) or interpolation (TX) factor applied by the FPGA
  *
  * @param[in]   dev         Device handle
- * @param[in]   module      Module to retrieve correction information from
- * @param[in]   corr        Correction type
- * @param[out]  value       Current value
+ * @param[in]   module      Module to query
+ * @param[out]  factor      Current factor. 1 denotes no decimation.
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 on success, value from \ref RETCODES list upon failure
  */
 API_EXPORT
-int CALL_CONV bladerf_get_correction(struct bladerf *dev, bladerf_module module,
-                                     bladerf_correction corr, int16_t *value);
+int CALL_CONV bladerf_get_decimation(struct bladerf *dev,
+                                     bladerf_module module,
+                                     unsigned int *factor);
 
 /**
- * Set the PA gain in dB
- *
- * Values outside the range of
- * [ \ref BLADERF_TXVGA2_GAIN_MIN, \ref BLADERF_TXVGA2_GAIN_MAX ]
- * will be clamped.
- *
- * @param       dev         Device handle
- * @param       gain        Desired gain
- *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * Number of channels the RX band is split into by the channelizer FPGA image
  */
-API_EXPORT
-int CALL_CONV bladerf_set_txvga2(struct bladerf *dev, int gain);
+#define BLADERF_CHANNELIZER_CHANNELS 16
 
 /**
- * Get the PA gain in dB
- *
- * @param       dev         Device handle
- * @param       gain        Pointer to returned gain
- *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * Maximum number of channelizer channels that may be streamed at once
  */
-API_EXPORT int
-CALL_CONV bladerf_get_txvga2(struct bladerf *dev, int *gain);
+#define BLADERF_CHANNELIZER_MAX_SELECTED 8
 
 /**
- * Set the post-LPF gain in dB
+ * Select which channels the channelizer FPGA image streams to the host.
  *
- * Values outside the range of
- * [ \ref BLADERF_TXVGA1_GAIN_MIN, \ref BLADERF_TXVGA1_GAIN_MAX ]
- * will be clamped.
+ * The channelizer image splits the RX band into
+ * ::BLADERF_CHANNELIZER_CHANNELS channels, each 1/16th of the sample rate
+ * wide and decimated by the same factor. Channel `k` is centered on
+ * `k * samplerate / 16`, so channels 8 through 15 hold the negative
+ * frequencies. Only the selected channels are sent over USB, one sample of
+ * each per block and in ascending channel order.
+ *
+ * With the ::BLADERF_FORMAT_SC16_Q11_META format, each message header
+ * identifies its first sample's channel, which bladerf_sync_rx() reports via
+ * bladerf_metadata::channel and bladerf_metadata::channel_mask. Timestamps
+ * count channelizer output samples, across all selected channels, rather than
+ * converter samples.
+ *
+ * This should be set while RX is disabled. It has no effect with other FPGA
+ * images. This requires FPGA v0.1.7 or later.
  *
  * @param       dev         Device handle
- * @param       gain        Desired gain
+ * @param       mask        Bit `k` selects channel `k`. Between 1 and
+ *                          ::BLADERF_CHANNELIZER_MAX_SELECTED bits may
+ *                          be set.
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 on success, BLADERF_ERR_INVAL on an invalid mask,
+ *         BLADERF_ERR_UPDATE_FPGA if the FPGA does not support this feature,
+ *         or a value from \ref RETCODES list upon other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_set_txvga1(struct bladerf *dev, int gain);
+int CALL_CONV bladerf_set_rx_channels(struct bladerf *dev, uint32_t mask);
 
 /**
- * Get the post-LPF gain in dB
+ * Get the channels selected by bladerf_set_rx_channels()
  *
  * @param       dev         Device handle
- * @param       gain        Pointer to returned gain
+ * @param[out]  mask        Selected channel mask
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 on success, BLADERF_ERR_UPDATE_FPGA if the FPGA does not support
+ *         this feature, or a value from \ref RETCODES list upon other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_get_txvga1(struct bladerf *dev, int *gain);
+int CALL_CONV bladerf_get_rx_channels(struct bladerf *dev, uint32_t *mask);
 
 /**
- * Set a combined VGA TX gain
+ * Number of bins in each spectrum produced with the ::BLADERF_FORMAT_PSD_U32
+ * format
+ */
+#define BLADERF_PSD_FFT_SIZE 256
+
+/**
+ * Maximum number of frames averaged into each ::BLADERF_FORMAT_PSD_U32
+ * spectrum
+ */
+#define BLADERF_PSD_AVERAGING_MAX 256
+
+/**
+ * Set the number of FFT frames the FPGA averages into each spectrum when
+ * streaming with the ::BLADERF_FORMAT_PSD_U32 format.
  *
- * This function computes the optimal TXVGA1 and TXVGA2 gains for a requested
- * amount of gain
+ * This should be set while RX is disabled. This requires FPGA v0.1.8 or later.
  *
  * @param       dev         Device handle
- * @param       gain        Desired gain
+ * @param       frames      Number of frames. Must be a power of 2 from 1
+ *                          through ::BLADERF_PSD_AVERAGING_MAX.
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 on success, BLADERF_ERR_INVAL on an invalid number of frames,
+ *         BLADERF_ERR_UPDATE_FPGA if the FPGA does not support this feature,
+ *         or a value from \ref RETCODES list upon other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_set_tx_gain(struct bladerf *dev, int gain);
+int CALL_CONV bladerf_set_psd_averaging(struct bladerf *dev,
+                                        unsigned int frames);
 
 /**
- * Set the LNA gain
+ * Get the number of FFT frames averaged into each spectrum
  *
  * @param       dev         Device handle
- * @param       gain        Desired gain level
+ * @param[out]  frames      Number of frames
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 on success, value from \ref RETCODES list upon failure
  */
 API_EXPORT
-int CALL_CONV bladerf_set_lna_gain(struct bladerf *dev, bladerf_lna_gain gain);
+int CALL_CONV bladerf_get_psd_averaging(struct bladerf *dev,
+                                        unsigned int *frames);
 
 /**
- * Get the LNA gain
- *
- * @param       dev         Device handle
- * @param       gain        Pointer to the set gain level
+ * Default shift between ::BLADERF_FORMAT_SC8_Q7 and SC16 Q11 samples, which
+ * maps the full scale of one onto the other
  */
-API_EXPORT
-int CALL_CONV bladerf_get_lna_gain(struct bladerf *dev, bladerf_lna_gain *gain);
+#define BLADERF_SC8_SHIFT_DEFAULT 4
 
 /**
- * Set the pre-LPF VGA gain
+ * Maximum shift between ::BLADERF_FORMAT_SC8_Q7 and SC16 Q11 samples
+ */
+#define BLADERF_SC8_SHIFT_MAX 15
+
+/**
+ * Set the shift the FPGA applies to a module's ::BLADERF_FORMAT_SC8_Q7 and
+ * ::BLADERF_FORMAT_SC8_Q7_META samples.
  *
- * Values outside the range of
- * [ \ref BLADERF_RXVGA1_GAIN_MIN, \ref BLADERF_RXVGA1_GAIN_MAX ]
- * will be clamped.
+ * RX samples are divided by `2^shift`, rounded and saturated to 8 bits. TX
+ * samples are multiplied by `2^shift` and saturated to the 12 bit range of
+ * the DAC. Shifts below the default trade full scale headroom for
+ * resolution of weak signals.
+ *
+ * This should be set while the module is disabled. This requires FPGA
+ * v0.1.11 or later.
  *
  * @param       dev         Device handle
- * @param       gain        Desired gain
+ * @param       module      Module to configure
+ * @param       shift       Shift, up to ::BLADERF_SC8_SHIFT_MAX
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 on success, BLADERF_ERR_INVAL on an invalid shift,
+ *         BLADERF_ERR_UPDATE_FPGA if the FPGA does not support this feature,
+ *         or a value from \ref RETCODES list upon other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_set_rxvga1(struct bladerf *dev, int gain);
+int CALL_CONV bladerf_set_sc8_shift(struct bladerf *dev, bladerf_module module,
+                                    unsigned int shift);
 
 /**
- * Get the pre-LPF VGA gain
+ * Get the shift applied to a module's 8-bit samples
  *
  * @param       dev         Device handle
- * @param       gain        Pointer to the set gain level
+ * @param       module      Module to query
+ * @param[out]  shift       Shift
+ *
+ * @return 0 on success, BLADERF_ERR_UPDATE_FPGA if the FPGA does not support
+ *         this feature, or a value from \ref RETCODES list upon other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_get_rxvga1(struct bladerf *dev, int *gain);
+int CALL_CONV bladerf_get_sc8_shift(struct bladerf *dev, bladerf_module module,
+                                    unsigned int *shift);
 
 /**
- * Set the post-LPF VGA gain
+ * Modulation of ::BLADERF_FORMAT_TX_SYMBOLS symbols
+ */
+typedef enum {
+    BLADERF_TX_MOD_BPSK = 0,    /**< BPSK, 1 bit per symbol */
+    BLADERF_TX_MOD_QPSK = 1,    /**< Gray coded QPSK, 2 bits per symbol */
+    BLADERF_TX_MOD_8PSK = 2,    /**< Gray coded 8-PSK, 3 bits per symbol */
+} bladerf_tx_modulation;
+
+/**
+ * Select the modulation of ::BLADERF_FORMAT_TX_SYMBOLS symbols. The default
+ * is ::BLADERF_TX_MOD_QPSK.
  *
- * Values outside the range of
- * [ \ref BLADERF_RXVGA2_GAIN_MIN, \ref BLADERF_RXVGA2_GAIN_MAX ]
- * will be clamped.
+ * This should be set while the TX module is disabled. This requires FPGA
+ * v0.1.23 or later.
  *
  * @param       dev         Device handle
- * @param       gain        Desired gain
+ * @param       modulation  Modulation
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 on success, BLADERF_ERR_INVAL on an invalid modulation,
+ *         BLADERF_ERR_UPDATE_FPGA if the FPGA does not support this feature,
+ *         or a value from \ref RETCODES list upon other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_set_rxvga2(struct bladerf *dev, int gain);
+int CALL_CONV bladerf_set_tx_modulation(struct bladerf *dev,
+                                        bladerf_tx_modulation modulation);
 
 /**
- * Get the post-LPF VGA gain
+ * Get the modulation of ::BLADERF_FORMAT_TX_SYMBOLS symbols
  *
  * @param       dev         Device handle
- * @param       gain        Pointer to the set gain level
+ * @param[out]  modulation  Modulation
+ *
+ * @return 0 on success, BLADERF_ERR_UPDATE_FPGA if the FPGA does not support
+ *         this feature, or a value from \ref RETCODES list upon other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_get_rxvga2(struct bladerf *dev, int *gain);
+int CALL_CONV bladerf_get_tx_modulation(struct bladerf *dev,
+                                        bladerf_tx_modulation *modulation);
 
 /**
- * Set a combined pre and post LPF RX gain
- *
- * This function computes the optimal LNA, RXVGA1, and RVGA2 gains for a
- * requested amount of RX gain, and computes the optimal TXVGA1 and TXVGA2 gains
- * for a requested amount of TX gain
- *
- * @param       dev         Device handle
- * @param       mod         Module
- * @param       gain        Desired gain
+ * Continuously track and remove the RX DC offset in the FPGA
+ */
+#define BLADERF_RX_TRACK_DC     (1 << 0)
+
+/**
+ * Continuously track and remove the RX IQ gain and phase imbalance in the FPGA
+ */
+#define BLADERF_RX_TRACK_IQ     (1 << 1)
+
+/**
+ * Current estimates of the FPGA's RX tracking loops.
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * These are applied after the ::BLADERF_CORR_FPGA_GAIN and
+ * ::BLADERF_CORR_FPGA_PHASE corrections, so they describe the residual error.
+ * Each value is zero while its loop is disabled.
  */
-API_EXPORT
-int CALL_CONV bladerf_set_gain(struct bladerf *dev, bladerf_module mod, int gain);
+struct bladerf_rx_tracking {
+    int16_t dc_i;   /**< DC offset removed from I, in SC16 Q11 units */
+    int16_t dc_q;   /**< DC offset removed from Q, in SC16 Q11 units */
+
+    /**
+     * Gain applied to Q, in the range [-2048, 4095]. As with
+     * ::BLADERF_CORR_FPGA_GAIN, 0 corresponds to a gain of 1.0 and 4096 to a
+     * gain of 2.0.
+     */
+    int16_t gain;
+
+    /**
+     * Fraction of I added to Q, scaled by 4096, in the range [-2048, 2047].
+     * For small errors this is the phase imbalance in radians, times -4096.
+     */
+    int16_t phase;
+};
 
 /**
- * Set the bandwidth of the LMS LPF to specified value in Hz
+ * Enable or disable the FPGA's RX tracking loops.
  *
- * The underlying device is capable of a discrete set of bandwidth values. The
- * caller should check the `actual` parameter to determine which of these
- * discrete bandwidth values is actually used for the requested bandwidth.
+ * These adapt continuously to the received signal, and need no calibration
+ * sweeps. A loop restarts from its neutral state whenever it is enabled.
  *
- * Values outside the range of
- * [ \ref BLADERF_BANDWIDTH_MIN, \ref BLADERF_BANDWIDTH_MAX ]
- * will be clamped.
+ * While ::BLADERF_RX_TRACK_DC is enabled, frequency and gain changes no longer
+ * look up and apply LMS DC offset values from a loaded RX DC calibration
+ * table. The LMS6002D's DC offset registers are left as they are.
  *
- * @param[in]   dev                 Device handle
- * @param[in]   module              Module for bandwidth request
- * @param[in]   bandwidth           Desired bandwidth
- * @param[out]  actual              If non-NULL, written with the actual
- *                                  bandwidth that the device was able to
- *                                  achieve.
+ * The loops converge on the average behavior of the received signal. Signals
+ * with a strong component at DC, or strongly unbalanced I and Q, will be
+ * distorted by them.
  *
- * @return 0 on success, value from \ref RETCODES list on failure
- */
-API_EXPORT
-int CALL_CONV bladerf_set_bandwidth(struct bladerf *dev, bladerf_module module,
-                                    unsigned int bandwidth,
-                                    unsigned int *actual);
-
-/**
- * Get the bandwidth of the LMS LPF
+ * This requires FPGA v0.1.9 or later.
  *
- * @param       dev                 Device Handle
- * @param       module              Module for bandwidth request
- * @param       bandwidth           Actual bandwidth in Hz
+ * @param       dev         Device handle
+ * @param       flags       Bitwise OR of BLADERF_RX_TRACK_* flags to enable.
+ *                          0 disables tracking.
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 on success, BLADERF_ERR_INVAL on invalid flags,
+ *         BLADERF_ERR_UPDATE_FPGA if the FPGA does not support this feature,
+ *         or a value from \ref RETCODES list upon other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_get_bandwidth(struct bladerf *dev, bladerf_module module,
-                                    unsigned int *bandwidth);
+int CALL_CONV bladerf_set_rx_tracking(struct bladerf *dev, uint32_t flags);
 
 /**
- * Set the LMS LPF mode to bypass or disable it
+ * Get the RX tracking loops enabled by bladerf_set_rx_tracking()
  *
  * @param       dev         Device handle
- * @param       module      Module for mode request
- * @param       mode        Mode to be set
+ * @param[out]  flags       Enabled BLADERF_RX_TRACK_* flags
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 on success, value from \ref RETCODES list upon failure
  */
 API_EXPORT
-int CALL_CONV bladerf_set_lpf_mode(struct bladerf *dev, bladerf_module module,
-                                   bladerf_lpf_mode mode);
+int CALL_CONV bladerf_get_rx_tracking(struct bladerf *dev, uint32_t *flags);
 
 /**
- * Get the current mode of the LMS LPF
+ * Read the current estimates of the FPGA's RX tracking loops
  *
  * @param       dev         Device handle
- * @param       module      Module for mode request
- * @param       mode        Current mode of the LPF
+ * @param[out]  state       Current estimates
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 on success, BLADERF_ERR_UPDATE_FPGA if the FPGA does not support
+ *         this feature, or a value from \ref RETCODES list upon other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_get_lpf_mode(struct bladerf *dev, bladerf_module module,
-                                   bladerf_lpf_mode *mode);
+int CALL_CONV bladerf_get_rx_tracking_state(struct bladerf *dev,
+                                            struct bladerf_rx_tracking *state);
 
 /**
- * Select the appropriate band path given a frequency in Hz.
+ * Depths and fill level marks of the FPGA's sample FIFOs, in 32-bit words.
+ * A word holds one ::BLADERF_FORMAT_SC16_Q11 sample, two
+ * ::BLADERF_FORMAT_SC8_Q7 samples, or 4/3 of a
+ * ::BLADERF_FORMAT_SC16_Q11_PACKED sample.
  *
- * The high band (LNA2 and PA2) is used for `frequency` >= 1.5 GHz. Otherwise,
- * The low band (LNA1 and PA1) is used.
+ * The marks are reset each time a module is enabled, and are held after it
+ * is disabled. Comparing them against the depths shows how close a stream
+ * has come to an overrun or underrun before one occurs.
+ */
+struct bladerf_fifo_levels {
+    unsigned int rx_depth;      /**< RX sample FIFO depth */
+
+    /** Highest RX sample FIFO fill level of the current stream */
+    unsigned int rx_high_water;
+
+    unsigned int tx_depth;      /**< TX sample FIFO depth */
+
+    /**
+     * Lowest TX sample FIFO fill level of the current stream, once samples
+     * first arrived. This equals `tx_depth` until then. Gaps between timed
+     * bursts legitimately drain the FIFO.
+     */
+    unsigned int tx_low_water;
+};
+
+/**
+ * Read the depths and fill level marks of the FPGA's sample FIFOs. The
+ * depths are chosen when the FPGA is built.
  *
- * Frequency values outside the range of
- * [ \ref BLADERF_FREQUENCY_MIN, \ref BLADERF_FREQUENCY_MAX ]
- * will be clamped.
+ * This requires FPGA v0.1.12 or later.
  *
  * @param       dev         Device handle
- * @param       module      Module to configure
- * @param       frequency   Tuned frequency
+ * @param[out]  levels      FIFO depths and fill level marks
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 on success, BLADERF_ERR_UPDATE_FPGA if the FPGA does not support
+ *         this feature, or a value from \ref RETCODES list upon other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_select_band(struct bladerf *dev, bladerf_module module,
-                                  unsigned int frequency);
+int CALL_CONV bladerf_get_fifo_levels(struct bladerf *dev,
+                                      struct bladerf_fifo_levels *levels);
 
 /**
- * Set module's frequency in Hz.
+ * Timed TX messages that reached the FPGA after their timestamp had passed,
+ * as when the host schedules bursts too close to the current time.
  *
- * Values outside the range of
- * [ \ref BLADERF_FREQUENCY_MIN, \ref BLADERF_FREQUENCY_MAX ]
- * will be clamped.
+ * Both fields are reset each time the TX module is enabled, are held after it
+ * is disabled, and saturate at 65535.
+ */
+struct bladerf_tx_late {
+    unsigned int count;         /**< Number of late messages */
+
+    /**
+     * The most that any of these messages was late by, in samples. Adding
+     * this to the time the scheduler leads the TX timestamp by avoids late
+     * messages under similar conditions.
+     */
+    unsigned int max_lateness;
+};
+
+/**
+ * Read the FPGA's count of late TX messages, sent with the
+ * ::BLADERF_FORMAT_SC16_Q11_META or ::BLADERF_FORMAT_SC8_Q7_META formats.
+ * Messages sent with ::BLADERF_META_FLAG_TX_NOW are never late.
  *
- * This calls bladerf_select_band() internally.
+ * This requires FPGA v0.1.20 or later.
  *
  * @param       dev         Device handle
- * @param       module      Module to configure
- * @param       frequency   Desired frequency
+ * @param[out]  late        Late message count and worst lateness
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 on success, BLADERF_ERR_UPDATE_FPGA if the FPGA does not support
+ *         this feature, or a value from \ref RETCODES list upon other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_set_frequency(struct bladerf *dev,
-                                    bladerf_module module,
-                                    unsigned int frequency);
+int CALL_CONV bladerf_get_tx_late(struct bladerf *dev,
+                                  struct bladerf_tx_late *late);
 
 /**
- * Get module's current frequency in Hz
- *
- * @param       dev         Device handle
- * @param       module      Module to configure
- * @param       frequency   Pointer to the returned frequency
+ * RX trigger sources
  */
-API_EXPORT
-int CALL_CONV bladerf_get_frequency(struct bladerf *dev,
-                                    bladerf_module module,
-                                    unsigned int *frequency);
+typedef enum {
+    /** Trigger when a sample's power, I^2 + Q^2, reaches a threshold */
+    BLADERF_RX_TRIGGER_POWER,
+
+    /** Trigger on a rising edge of mini expansion header pin J51-1 */
+    BLADERF_RX_TRIGGER_EXTERNAL,
+} bladerf_rx_trigger_source;
+
+/** Most pre-trigger samples the FPGA can hold */
+#define BLADERF_RX_TRIGGER_PRE_MAX  1022
 
 /**
- * Attach and enable an expansion board's features
+ * RX trigger configuration
  *
- * @param       dev         Device handle
- * @param       xb          Expansion board
+ * While a trigger is enabled, the FPGA holds back RX samples in a short
+ * delay line and only forwards those around trigger events. This requires
+ * a metadata sample format, and the timestamps in the metadata identify
+ * where each capture lies. Gaps between captures can be recognized by the
+ * jumps in those timestamps.
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * Samples are forwarded in whole metadata messages. A message is sent if
+ * the capture window covers its first sample, so captures are extended up
+ * to the end of a message, and up to a message's worth of the requested
+ * pre-trigger samples may be lost.
  */
-API_EXPORT
-int CALL_CONV bladerf_expansion_attach(struct bladerf *dev, bladerf_xb xb);
+struct bladerf_rx_trigger {
+    bool enable;                        /**< Enable the trigger */
+    bladerf_rx_trigger_source source;   /**< What to trigger on */
+
+    /**
+     * Power threshold for ::BLADERF_RX_TRIGGER_POWER, in squared SC16 Q11
+     * units. For example, 2048^2 / 100 triggers 20 dB below full scale.
+     */
+    uint32_t threshold;
+
+    /**
+     * Samples to keep from before the trigger, up to
+     * \ref BLADERF_RX_TRIGGER_PRE_MAX
+     */
+    unsigned int pre_samples;
+
+    /** Samples to keep from the trigger onwards */
+    unsigned int post_samples;
+
+    /**
+     * Re-arm after every capture. Otherwise, each capture must be armed with
+     * bladerf_arm_rx_trigger().
+     */
+    bool rearm;
+};
 
 /**
- * Determine which expansion board is attached
- *
- * @param       dev         Device handle
- * @param       xb          Expansion board
- *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * RX trigger state
  */
-API_EXPORT
-int CALL_CONV bladerf_expansion_get_attached(struct bladerf *dev, bladerf_xb *xb);
+struct bladerf_rx_trigger_state {
+    bool armed;             /**< Waiting for a trigger */
+    bool capturing;         /**< Forwarding the samples of a capture */
+    unsigned int triggers;  /**< Triggers since enabled, modulo 2^16 */
+};
 
 /**
- * Set XB-200 filterbank
+ * Configure the RX trigger. Changing the settings while RX is streaming
+ * may corrupt the capture in progress.
+ *
+ * This requires FPGA v0.1.14 or later.
  *
  * @param       dev         Device handle
- * @param       mod         Module
- * @param       filter      XB200 filterbank
+ * @param[in]   trigger     Trigger configuration
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 on success, BLADERF_ERR_INVAL if the pre-trigger length is out of
+ *         range, BLADERF_ERR_UPDATE_FPGA if the FPGA does not support this
+ *         feature, or a value from \ref RETCODES list upon other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_xb200_set_filterbank(struct bladerf *dev,
-                                           bladerf_module mod,
-                                           bladerf_xb200_filter filter);
+int CALL_CONV bladerf_set_rx_trigger(struct bladerf *dev,
+                                     const struct bladerf_rx_trigger *trigger);
 
 /**
- * Get current XB-200 filterbank
+ * Read back the RX trigger configuration
  *
- * @param[in]    dev        Device handle
- * @param[in]    module     Module to query
- * @param[out]   filter     Pointer to filterbank, only updated if return
- *                          value is 0.
+ * This requires FPGA v0.1.14 or later.
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @param       dev         Device handle
+ * @param[out]  trigger     Trigger configuration
+ *
+ * @return 0 on success, BLADERF_ERR_UPDATE_FPGA if the FPGA does not support
+ *         this feature, or a value from \ref RETCODES list upon other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_xb200_get_filterbank(struct bladerf *dev,
-                                           bladerf_module module,
-                                           bladerf_xb200_filter *filter);
+int CALL_CONV bladerf_get_rx_trigger(struct bladerf *dev,
+                                     struct bladerf_rx_trigger *trigger);
 
 /**
- * Set XB-200 signal path
+ * Arm the RX trigger for one capture. This has no effect if the trigger is
+ * already armed, or not enabled.
+ *
+ * This requires FPGA v0.1.14 or later.
  *
  * @param       dev         Device handle
- * @param       module      Module to configure
- * @param       path        Desired XB-200 signal path
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 on success, BLADERF_ERR_UPDATE_FPGA if the FPGA does not support
+ *         this feature, or a value from \ref RETCODES list upon other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_xb200_set_path(struct bladerf *dev,
-                                     bladerf_module module,
-                                     bladerf_xb200_path path);
+int CALL_CONV bladerf_arm_rx_trigger(struct bladerf *dev);
 
 /**
- * Get current XB-200 signal path
+ * Read the state of the RX trigger
+ *
+ * This requires FPGA v0.1.14 or later.
  *
  * @param       dev         Device handle
- * @param       module      Module to query
- * @param       path        Pointer to XB200 signal path
+ * @param[out]  state       Trigger state
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 on success, BLADERF_ERR_UPDATE_FPGA if the FPGA does not support
+ *         this feature, or a value from \ref RETCODES list upon other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_xb200_get_path(struct bladerf *dev,
-                                     bladerf_module module,
-                                     bladerf_xb200_path *path);
-
-/** @} (End of FN_CTRL) */
+int CALL_CONV bladerf_get_rx_trigger_state(struct bladerf *dev,
+                                        struct bladerf_rx_trigger_state *state);
 
 /**
- * @defgroup FMT_META   Sample Formats and Metadata
- *
- * This section defines the available sample formats and metadata flags.
+ * RX sample sources, selected with bladerf_set_rx_mux()
  *
- * @{
- */
-
-/**
- * Sample format
+ * The test patterns replace the samples received from the LMS6002D ahead of
+ * the FPGA's RX corrections and DSP. The corrections, tracking loops, DDC, and
+ * decimation should be left disabled for the patterns to reach the host
+ * unmodified.
  */
 typedef enum {
+    BLADERF_RX_MUX_INVALID = -1,        /**< Invalid selection */
+
+    /** Samples from the LMS6002D. This is the default. */
+    BLADERF_RX_MUX_BASEBAND_LMS = 0,
+
+    /** A 12-bit counter in I, and its negation in Q */
+    BLADERF_RX_MUX_12BIT_COUNTER = 1,
+
     /**
-     * Signed, Complex 16-bit Q11. This is the native format of the DAC data.
-     *
-     * Values in the range [-2048, 2048) are used to represent [-1.0, 1.0).
-     * Note that the lower bound here is inclusive, and the upper bound is
-     * exclusive. Ensure that provided samples stay within [-2048, 2047].
-     *
-     * Samples consist of interleaved IQ value pairs, with I being the first
-     * value in the pair. Each value in the pair is a right-aligned,
-     * little-endian int16_t. The FPGA ensures that these values are
-     * sign-extended.
-     *
-     * When using this format the minimum required buffer size, in bytes, is:
-     * <pre>
-     *   buffer_size_min = [ 2 * num_samples * sizeof(int16_t) ]
-     * </pre>
-     *
-     * For example, to hold 2048 samples, a buffer must be at least 8192 bytes
-     * large.
+     * A 32-bit counter, whose low 16 bits are carried in I and high 16 bits
+     * in Q. This is equivalent to ::BLADERF_GPIO_COUNTER_ENABLE.
      */
-    BLADERF_FORMAT_SC16_Q11,
+    BLADERF_RX_MUX_32BIT_COUNTER = 2,
+
+    /** Samples from the FPGA's entropy source */
+    BLADERF_RX_MUX_ENTROPY = 3,
+
+    /** Transmitted samples, looped back within the FPGA */
+    BLADERF_RX_MUX_DIGITAL_LOOPBACK = 4,
 
     /**
-     * This format is the same as the ::BLADERF_FORMAT_SC16_Q11 format, except the
-     * first 4 samples (16 bytes) in every block of 1024 samples are replaced
-     * with metadata, organized as follows, with all fields being little endian
-     * byte order:
-     *
-     * <pre>
-     *  0x00 [uint32_t:  Reserved]
-     *  0x04 [uint64_t:  64-bit Timestamp]
-     *  0x0c [uint32_t:  BLADERF_META_FLAG_* flags]
-     * </pre>
-     *
-     * When using the bladerf_sync_rx() and bladerf_sync_tx() functions,
-     * this detail is transparent to caller. These functions take care of
-     * packing/unpacking the metadata into/from the data, via the
-     * bladerf_metadata structure.
-     *
-     * Currently, when using the asynchronous data transfer interface, the user
-     * is responsible for manually packing/unpacking this metadata into/from
-     * their sample data.
+     * A 32-bit pseudorandom sequence, carried as the 32-bit counter is. See
+     * ::BLADERF_PATTERN_PRBS. This requires FPGA v0.1.18 or later.
      */
-    BLADERF_FORMAT_SC16_Q11_META,
-} bladerf_format;
+    BLADERF_RX_MUX_PRBS = 5,
+} bladerf_rx_mux;
 
-/*
- * Metadata status bits
+/**
+ * Select the source of RX samples. This should only be changed while the RX
+ * module is disabled.
  *
- * These are used in conjunction with the bladerf_metadata structure's
- * `status` field.
+ * @param       dev         Device handle
+ * @param       mux         Sample source
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL for an invalid source,
+ *         BLADERF_ERR_UPDATE_FPGA if the FPGA does not support the source,
+ *         or a value from \ref RETCODES list upon other failures
  */
+API_EXPORT
+int CALL_CONV bladerf_set_rx_mux(struct bladerf *dev, bladerf_rx_mux mux);
 
 /**
- * A sample overrun has occurred. This indicates that either the host
- * (more likely) or the FPGA is not keeping up with the incoming samples
+ * Read back the source of RX samples
+ *
+ * @param       dev         Device handle
+ * @param[out]  mux         Sample source
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
  */
-#define BLADERF_META_STATUS_OVERRUN  (1 << 0)
+API_EXPORT
+int CALL_CONV bladerf_get_rx_mux(struct bladerf *dev, bladerf_rx_mux *mux);
 
 /**
- * A sample underrun has occurred. This generally only occurrs on the TX module
- * when the FPGA is starved of samples.
+ * Set the value of the specified configuration parameter
  *
- * @note libbladeRF does not report this status. It is here for future use.
- */
-#define BLADERF_META_STATUS_UNDERRUN (1 << 1)
-
-
-
-/*
- * Metadata flags
+ * See the ::bladerf_correction description for the valid ranges of the
+ * `value` parameter.
  *
- * These are used in conjunction with the bladerf_metadata structure's
- * `flags` field.
+ * @param   dev         Device handle
+ * @param   module      Module to apply correction to
+ * @param   corr        Correction type
+ * @param   value       Value to apply
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
  */
+API_EXPORT
+int CALL_CONV bladerf_set_correction(struct bladerf *dev, bladerf_module module,
+                                     bladerf_correction corr, int16_t value);
 
 /**
- * Mark the associated buffer as the start of a burst transmission.
- * This is only used for the bladerf_sync_tx() call.
+ * Obtain the current value of the specified configuration parameter
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to retrieve correction information from
+ * @param[in]   corr        Correction type
+ * @param[out]  value       Current value
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
  */
-#define BLADERF_META_FLAG_TX_BURST_START   (1 << 0)
+API_EXPORT
+int CALL_CONV bladerf_get_correction(struct bladerf *dev, bladerf_module module,
+                                     bladerf_correction corr, int16_t *value);
 
 /**
- * Mark the associated buffer as the end of a burst transmission. This will
- * flush the remainder of the sync interfaces' current working buffer and
- * enqueue samples into the transmit FIFO.
- *
- * When specifying this flag to bladerf_sync_tx(), the final two samples
- * in the synchronous interface's internal working buffer <b>must</b> be zero.
- * Unexpected results may occur if this is not the case. To ensure this
- * requirement is met, API users should ensure the last two samples provided to
- * bladerf_sync_tx() are zero when using ::BLADERF_META_FLAG_TX_BURST_END. One
- * way to do this is to end bursts with a call of bladerf_sync_tx() with this
- * flag set and a buffer of 2 or more zero samples.
- *
- * Flushing the sync interface's working buffer implies that after specifying
- * this flag, the next timestamp that can be transmitted is the current
- * timestamp plus the duration of the burst that this flag is ending <b>and</b>
- * the remaining length of the remaining buffer that is flushed. (The buffer
- * size, in this case, is the `buffer_size` value passed to the previous
- * bladerf_sync_config() call.)
+ * Set the PA gain in dB
  *
- * Rather than attempting to keep track of the number of samples sent with
- * respect to buffer sizes, it is easiest to always assume 1 buffer's worth of
- * time is required between bursts. In this case "buffer" refers to the
- * `buffer_size` parameter provided to bladerf_sync_config().) If this is too
- * much time, consider combining multiple bursts and manually zero-padding
- * samples between them.
+ * Values outside the range of
+ * [ \ref BLADERF_TXVGA2_GAIN_MIN, \ref BLADERF_TXVGA2_GAIN_MAX ]
+ * will be clamped.
  *
- * This is only used for the bladerf_sync_tx() call. It is ignored by the
- * bladerf_sync_rx() call.
+ * @param       dev         Device handle
+ * @param       gain        Desired gain
  *
+ * @return 0 on success, value from \ref RETCODES list on failure
  */
-#define BLADERF_META_FLAG_TX_BURST_END     (1 << 1)
+API_EXPORT
+int CALL_CONV bladerf_set_txvga2(struct bladerf *dev, int gain);
 
 /**
- * Use this flag in conjunction with ::BLADERF_META_FLAG_TX_BURST_START to
- * indicate that the burst should be transmitted as soon as possible, as opposed
- * to waiting for a specific timestamp.
+ * Get the PA gain in dB
  *
- * When this flag is used, there is no need to set the
- * bladerf_metadata::timestamp field.
+ * @param       dev         Device handle
+ * @param       gain        Pointer to returned gain
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT int
+CALL_CONV bladerf_get_txvga2(struct bladerf *dev, int *gain);
+
+/**
+ * Set the post-LPF gain in dB
+ *
+ * Values outside the range of
+ * [ \ref BLADERF_TXVGA1_GAIN_MIN, \ref BLADERF_TXVGA1_GAIN_MAX ]
+ * will be clamped.
+ *
+ * @param       dev         Device handle
+ * @param       gain        Desired gain
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_txvga1(struct bladerf *dev, int gain);
+
+/**
+ * Get the post-LPF gain in dB
+ *
+ * @param       dev         Device handle
+ * @param       gain        Pointer to returned gain
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_txvga1(struct bladerf *dev, int *gain);
+
+/**
+ * Set a combined VGA TX gain
+ *
+ * This function computes the optimal TXVGA1 and TXVGA2 gains for a requested
+ * amount of gain
+ *
+ * @param       dev         Device handle
+ * @param       gain        Desired gain
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_tx_gain(struct bladerf *dev, int gain);
+
+/**
+ * Set the LNA gain
+ *
+ * @param       dev         Device handle
+ * @param       gain        Desired gain level
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_lna_gain(struct bladerf *dev, bladerf_lna_gain gain);
+
+/**
+ * Get the LNA gain
+ *
+ * @param       dev         Device handle
+ * @param       gain        Pointer to the set gain level
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_lna_gain(struct bladerf *dev, bladerf_lna_gain *gain);
+
+/**
+ * Set the pre-LPF VGA gain
+ *
+ * Values outside the range of
+ * [ \ref BLADERF_RXVGA1_GAIN_MIN, \ref BLADERF_RXVGA1_GAIN_MAX ]
+ * will be clamped.
+ *
+ * @param       dev         Device handle
+ * @param       gain        Desired gain
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_rxvga1(struct bladerf *dev, int gain);
+
+/**
+ * Get the pre-LPF VGA gain
+ *
+ * @param       dev         Device handle
+ * @param       gain        Pointer to the set gain level
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_rxvga1(struct bladerf *dev, int *gain);
+
+/**
+ * Set the post-LPF VGA gain
+ *
+ * Values outside the range of
+ * [ \ref BLADERF_RXVGA2_GAIN_MIN, \ref BLADERF_RXVGA2_GAIN_MAX ]
+ * will be clamped.
+ *
+ * @param       dev         Device handle
+ * @param       gain        Desired gain
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_rxvga2(struct bladerf *dev, int gain);
+
+/**
+ * Get the post-LPF VGA gain
+ *
+ * @param       dev         Device handle
+ * @param       gain        Pointer to the set gain level
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_rxvga2(struct bladerf *dev, int *gain);
+
+/**
+ * Set a combined pre and post LPF RX gain
+ *
+ * This function computes the optimal LNA, RXVGA1, and RVGA2 gains for a
+ * requested amount of RX gain, and computes the optimal TXVGA1 and TXVGA2 gains
+ * for a requested amount of TX gain
+ *
+ * @param       dev         Device handle
+ * @param       mod         Module
+ * @param       gain        Desired gain
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_gain(struct bladerf *dev, bladerf_module mod, int gain);
+
+/**
+ * Schedule a change of the combined gain, as computed by bladerf_set_gain(),
+ * to occur at the specified sample timestamp.
+ *
+ * The resulting LMS6002D register writes are queued in the FPGA, which applies
+ * them once the module's timestamp counter (see bladerf_get_timestamp())
+ * reaches `timestamp`. A timestamp of 0 applies the gain as soon as possible.
+ *
+ * Scheduled gain changes share the FPGA's queue with scheduled retunes (see
+ * bladerf_schedule_retune()), which holds up to 16 entries.
+ *
+ * @note This requires FPGA v0.1.4 or later.
+ *
+ * @param       dev         Device handle
+ * @param       mod         Module
+ * @param       timestamp   Timestamp at which to apply the gain
+ * @param       gain        Desired gain
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_QUEUE_FULL if the FPGA's queue is full,
+ *         BLADERF_ERR_UPDATE_FPGA if the FPGA does not support this feature,
+ *         value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_schedule_gain(struct bladerf *dev, bladerf_module mod,
+                                    uint64_t timestamp, int gain);
+
+/**
+ * RX automatic gain control configuration. See bladerf_enable_rx_agc().
+ *
+ * Gains are combined RX gains, as used by bladerf_set_gain().
+ */
+struct bladerf_agc_config {
+    int target_dbfs;            /**< Desired mean power of received samples,
+                                 *   in dBFS */
+    unsigned int hysteresis_db; /**< The gain is left unchanged while the
+                                 *   measured power is within this many dB of
+                                 *   `target_dbfs` */
+    unsigned int max_step_db;   /**< Largest change of gain per update, in dB.
+                                 *   Must be non-zero. */
+    int min_gain;               /**< Lowest gain the AGC may apply */
+    int max_gain;               /**< Highest gain the AGC may apply */
+    int initial_gain;           /**< Gain applied when the AGC is enabled */
+    unsigned int window;        /**< Number of samples per power estimate.
+                                 *   Must be non-zero. */
+    unsigned int settle;        /**< Number of samples, following each gain
+                                 *   change, excluded from power estimates */
+    unsigned int lead;          /**< Number of samples by which a gain change
+                                 *   is scheduled ahead of the current
+                                 *   timestamp. This must exceed the latency
+                                 *   of a control request. If 0, or if the
+                                 *   FPGA does not support scheduled gain
+                                 *   changes, gains are changed immediately. */
+};
+
+/**
+ * Enable or disable automatic gain control of received samples.
+ *
+ * While enabled, bladerf_sync_rx() estimates the power of each window of
+ * received samples as they are returned. When the estimate differs from the
+ * target by more than the hysteresis, the combined RX gain is stepped towards
+ * the target. The resulting LMS6002D register writes are batched, and are
+ * scheduled in the FPGA where possible (see bladerf_schedule_gain()).
+ *
+ * Each call to bladerf_sync_rx() reports the timestamp at which the most
+ * recent gain change takes effect via the `gain_timestamp` and `gain` fields
+ * of struct bladerf_metadata. The ::BLADERF_META_STATUS_GAIN_CHANGE status
+ * flag is set by the first call following each change. When gains are
+ * changed immediately, `gain_timestamp` is read once the change has been
+ * made, and is therefore an upper bound.
+ *
+ * The AGC only operates on streams configured with the
+ * ::BLADERF_FORMAT_SC16_Q11_META or ::BLADERF_FORMAT_CF32_META format, and
+ * only via bladerf_sync_rx(). Gains should not be changed by other means
+ * while it is enabled.
+ *
+ * @param       dev         Device handle
+ * @param       config      AGC configuration, or NULL to disable the AGC
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on an invalid configuration, or a
+ *         value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_enable_rx_agc(struct bladerf *dev,
+                                    const struct bladerf_agc_config *config);
+
+/**
+ * Estimate and correct the RX DC offset in the background. See
+ * bladerf_enable_rx_bg_cal().
+ */
+#define BLADERF_RX_BG_CAL_DC    (1 << 0)
+
+/**
+ * Estimate and correct the RX IQ gain and phase imbalance in the background.
+ * See bladerf_enable_rx_bg_cal().
+ */
+#define BLADERF_RX_BG_CAL_IQ    (1 << 1)
+
+/**
+ * RX background calibration configuration. See bladerf_enable_rx_bg_cal().
+ */
+struct bladerf_rx_bg_cal_config {
+    uint32_t flags;             /**< Bitwise OR of BLADERF_RX_BG_CAL_* flags.
+                                 *   Must be non-zero. */
+    unsigned int window;        /**< Number of samples per estimate. Must be
+                                 *   non-zero. */
+    unsigned int settle;        /**< Number of samples, following each
+                                 *   correction, excluded from estimates */
+    unsigned int max_dc_step;   /**< Largest change of a
+                                 *   ::BLADERF_CORR_LMS_DCOFF_I or
+                                 *   ::BLADERF_CORR_LMS_DCOFF_Q value per
+                                 *   update. Must be non-zero. */
+    unsigned int max_iq_step;   /**< Largest change of a
+                                 *   ::BLADERF_CORR_FPGA_GAIN or
+                                 *   ::BLADERF_CORR_FPGA_PHASE value per
+                                 *   update. Must be non-zero. */
+};
+
+/**
+ * RX background calibration state. See bladerf_get_rx_bg_cal_state().
+ */
+struct bladerf_rx_bg_cal_state {
+    uint64_t estimates;         /**< Number of windows evaluated */
+    uint64_t updates;           /**< Number of times corrections changed */
+
+    int16_t dc_i;               /**< Applied ::BLADERF_CORR_LMS_DCOFF_I */
+    int16_t dc_q;               /**< Applied ::BLADERF_CORR_LMS_DCOFF_Q */
+    int16_t gain;               /**< Applied ::BLADERF_CORR_FPGA_GAIN */
+    int16_t phase;              /**< Applied ::BLADERF_CORR_FPGA_PHASE */
+
+    float dc_i_error;           /**< Latest I DC offset estimate, in SC16 Q11
+                                 *   units */
+    float dc_q_error;           /**< Latest Q DC offset estimate, in SC16 Q11
+                                 *   units */
+    float gain_error_db;        /**< Latest estimate of the power of Q
+                                 *   relative to I, in dB */
+    float phase_error_deg;      /**< Latest estimate of the deviation of I and
+                                 *   Q from quadrature, in degrees */
+};
+
+/**
+ * Enable or disable background calibration of received samples.
+ *
+ * While enabled, bladerf_sync_rx() accumulates the statistics of received
+ * samples as they are returned, without interrupting the stream. At the end of
+ * each window, it estimates the residual DC offset and IQ imbalance, and moves
+ * the corrections a step towards cancelling them:
+ *
+ *  - ::BLADERF_RX_BG_CAL_DC adjusts the LMS6002D's RX DC offset corrections
+ *    (::BLADERF_CORR_LMS_DCOFF_I and ::BLADERF_CORR_LMS_DCOFF_Q), written
+ *    together in a single register transaction. The response of the DC
+ *    offset to these values is learned from the first corrections made.
+ *
+ *  - ::BLADERF_RX_BG_CAL_IQ adjusts the FPGA's RX gain and phase corrections
+ *    (::BLADERF_CORR_FPGA_GAIN and ::BLADERF_CORR_FPGA_PHASE).
+ *
+ * Corrections start from the values applied when this is called, such as
+ * those found by a prior calibration, and are left as they are when it is
+ * disabled.
+ *
+ * Errors are only corrected once they exceed the noise expected of their
+ * estimates, so that a converged calibration makes no further writes. Longer
+ * windows give finer corrections, at the cost of slower convergence. Windows
+ * with a mean power below -60 dBFS are not used to estimate the IQ imbalance.
+ *
+ * Estimates assume that the received signal averages to zero, and that its I
+ * and Q components are uncorrelated and of equal power. Signals with a strong
+ * component at DC, or strongly unbalanced I and Q, will be distorted.
+ *
+ * As with the AGC, this only operates on streams configured with the
+ * ::BLADERF_FORMAT_SC16_Q11_META or ::BLADERF_FORMAT_CF32_META format, and
+ * only via bladerf_sync_rx(). The corrections should not be changed by other
+ * means while it is enabled.
+ *
+ * @param       dev         Device handle
+ * @param       config      Configuration, or NULL to disable background
+ *                          calibration
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on an invalid configuration, or a
+ *         value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_enable_rx_bg_cal(
+                            struct bladerf *dev,
+                            const struct bladerf_rx_bg_cal_config *config);
+
+/**
+ * Get the state of RX background calibration
+ *
+ * @param       dev         Device handle
+ * @param[out]  state       Current state. Estimates are zero until the first
+ *                          window has been evaluated.
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_rx_bg_cal_state(
+                            struct bladerf *dev,
+                            struct bladerf_rx_bg_cal_state *state);
+
+/**
+ * Set the bandwidth of the LMS LPF to specified value in Hz
+ *
+ * The underlying device is capable of a discrete set of bandwidth values. The
+ * caller should check the `actual` parameter to determine which of these
+ * discrete bandwidth values is actually used for the requested bandwidth.
+ *
+ * Values outside the range of
+ * [ \ref BLADERF_BANDWIDTH_MIN, \ref BLADERF_BANDWIDTH_MAX ]
+ * will be clamped.
+ *
+ * @param[in]   dev                 Device handle
+ * @param[in]   module              Module for bandwidth request
+ * @param[in]   bandwidth           Desired bandwidth
+ * @param[out]  actual              If non-NULL, written with the actual
+ *                                  bandwidth that the device was able to
+ *                                  achieve.
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_bandwidth(struct bladerf *dev, bladerf_module module,
+                                    unsigned int bandwidth,
+                                    unsigned int *actual);
+
+/**
+ * Get the bandwidth of the LMS LPF
+ *
+ * @param       dev                 Device Handle
+ * @param       module              Module for bandwidth request
+ * @param       bandwidth           Actual bandwidth in Hz
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_bandwidth(struct bladerf *dev, bladerf_module module,
+                                    unsigned int *bandwidth);
+
+/**
+ * Set the LMS LPF mode to bypass or disable it
+ *
+ * @param       dev         Device handle
+ * @param       module      Module for mode request
+ * @param       mode        Mode to be set
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_lpf_mode(struct bladerf *dev, bladerf_module module,
+                                   bladerf_lpf_mode mode);
+
+/**
+ * Get the current mode of the LMS LPF
+ *
+ * @param       dev         Device handle
+ * @param       module      Module for mode request
+ * @param       mode        Current mode of the LPF
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_lpf_mode(struct bladerf *dev, bladerf_module module,
+                                   bladerf_lpf_mode *mode);
+
+/**
+ * Select the appropriate band path given a frequency in Hz.
+ *
+ * The high band (LNA2 and PA2) is used for `frequency` >= 1.5 GHz. Otherwise,
+ * The low band (LNA1 and PA1) is used.
+ *
+ * Frequency values outside the range of
+ * [ \ref BLADERF_FREQUENCY_MIN, \ref BLADERF_FREQUENCY_MAX ]
+ * will be clamped.
+ *
+ * @param       dev         Device handle
+ * @param       module      Module to configure
+ * @param       frequency   Tuned frequency
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_select_band(struct bladerf *dev, bladerf_module module,
+                                  unsigned int frequency);
+
+/**
+ * Set module's frequency in Hz.
+ *
+ * Values outside the range of
+ * [ \ref BLADERF_FREQUENCY_MIN, \ref BLADERF_FREQUENCY_MAX ]
+ * will be clamped.
+ *
+ * This calls bladerf_select_band() internally.
+ *
+ * @param       dev         Device handle
+ * @param       module      Module to configure
+ * @param       frequency   Desired frequency
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_frequency(struct bladerf *dev,
+                                    bladerf_module module,
+                                    unsigned int frequency);
+
+/**
+ * Set both the RX and TX modules' frequency in Hz.
+ *
+ * This is equivalent to calling bladerf_set_frequency() for each module, but
+ * takes fewer control transfers: the PLL configuration is computed once, the
+ * two modules' register writes are sent together, and their VCO capacitor
+ * searches proceed in lock-step.
+ *
+ * @param       dev         Device handle
+ * @param       frequency   Desired frequency
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_frequency_both(struct bladerf *dev,
+                                         unsigned int frequency);
+
+/**
+ * Get module's current frequency in Hz
+ *
+ * @param       dev         Device handle
+ * @param       module      Module to configure
+ * @param       frequency   Pointer to the returned frequency
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_frequency(struct bladerf *dev,
+                                    bladerf_module module,
+                                    unsigned int *frequency);
+
+/**
+ * Apply a fine frequency offset, in the FPGA, on top of the frequency set via
+ * bladerf_set_frequency().
+ *
+ * The FPGA's digital down-converter mixes received samples such that a
+ * signal at (frequency + offset) appears at DC. This takes effect
+ * immediately, without retuning the LMS6002D PLL, and so is suitable for
+ * fine retunes within the current receive bandwidth. An offset of 0 bypasses
+ * the down-converter.
+ *
+ * The offset is translated into an NCO phase increment using the current
+ * sample rate, so it should be set again after changing the sample rate.
+ * The down-converter precedes any decimation (see bladerf_set_decimation()).
+ *
+ * This is currently only supported for ::BLADERF_MODULE_RX, and requires
+ * FPGA v0.1.6 or later.
+ *
+ * @param       dev         Device handle
+ * @param       module      Module to configure
+ * @param       offset      Offset in Hz. Its magnitude must be less than
+ *                          half of the sample rate.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if the offset is out of range,
+ *         BLADERF_ERR_UNSUPPORTED for the TX module,
+ *         BLADERF_ERR_UPDATE_FPGA if the FPGA does not support this feature,
+ *         or a value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_frequency_offset(struct bladerf *dev,
+                                           bladerf_module module,
+                                           int32_t offset);
+
+/**
+ * Get the fine frequency offset applied in the FPGA
+ *
+ * The returned value is derived from the NCO phase increment and the current
+ * sample rate, and so reflects rounding to the NCO's resolution.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to query
+ * @param[out]  offset      Offset in Hz
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_frequency_offset(struct bladerf *dev,
+                                           bladerf_module module,
+                                           int32_t *offset);
+
+/**
+ * Quick retune parameters
+ *
+ * This structure captures the LMS6002D PLL configuration, VCO capacitor
+ * selection, and DC offset corrections associated with a tuned frequency,
+ * along with the XB-200 signal path and filter bank if one is attached.
+ * Obtain it via bladerf_get_quick_tune() after tuning the desired frequency
+ * with bladerf_set_frequency(), and apply it later via bladerf_quick_retune().
+ *
+ * The contents of this structure are specific to the device and module they
+ * were obtained from, and should be treated as opaque.
+ */
+struct bladerf_quick_tune {
+    unsigned int frequency; /**< LMS6002D frequency, in Hz */
+    uint16_t nint;          /**< Integer portion of PLL divider */
+    uint32_t nfrac;         /**< Fractional portion of PLL divider */
+    uint8_t freqsel;        /**< VCO and division ratio selection */
+    uint8_t vcocap;         /**< VCO capacitor selection */
+    int16_t dc_i;           /**< LMS DC offset correction, I channel */
+    int16_t dc_q;           /**< LMS DC offset correction, Q channel */
+
+    bool xb200;                         /**< XB-200 settings are captured */
+    bladerf_xb200_path xb200_path;      /**< XB-200 signal path */
+    bladerf_xb200_filter xb200_filter;  /**< Selected XB-200 filter bank */
+};
+
+/**
+ * Fetch the parameters needed to quickly return to the frequency that the
+ * specified module is currently tuned to.
+ *
+ * If an XB-200 is attached, its signal path and the filter bank in use are
+ * captured as well. With an automatic filter bank selection, this is the
+ * bank that was selected for the current frequency.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to query
+ * @param[out]  quick_tune  Quick retune parameters
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_quick_tune(struct bladerf *dev,
+                                     bladerf_module module,
+                                     struct bladerf_quick_tune *quick_tune);
+
+/**
+ * Retune to a frequency previously captured with bladerf_get_quick_tune().
+ *
+ * This writes the saved register values in a single batch, avoiding the
+ * PLL divider calculations and VCO capacitor search performed by
+ * bladerf_set_frequency(). The band selection and DC offset corrections
+ * are restored as well. Any captured XB-200 settings are restored, writing
+ * only those that differ from the current ones.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to retune
+ * @param[in]   quick_tune  Quick retune parameters
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_quick_retune(struct bladerf *dev,
+                                   bladerf_module module,
+                                   const struct bladerf_quick_tune *quick_tune);
+
+/**
+ * Specifies that a scheduled retune should occur immediately
+ */
+#define BLADERF_RETUNE_NOW 0
+
+/**
+ * Schedule a retune to occur at the specified sample timestamp.
+ *
+ * The retune is queued in the FPGA, which applies it once the module's
+ * timestamp counter (see bladerf_get_timestamp()) reaches `timestamp`.
+ * Hops therefore occur at a precise sample time, independent of USB latency.
+ * Up to 16 retunes and scheduled gain changes (see bladerf_schedule_gain())
+ * may be queued at a time.
+ *
+ * Only the LMS6002D PLL and VCO capacitor configuration are changed by a
+ * scheduled retune. The band selection and DC offset corrections are left
+ * untouched, so all scheduled retunes should remain in the currently selected
+ * band (i.e., on the same side of ::BLADERF_BAND_HIGH).
+ *
+ * If `quick_tune` captured XB-200 settings that differ from those of the
+ * previously scheduled retune, the XB-200 signal path and filter bank are
+ * switched at the same timestamp. This takes a second queue entry, and
+ * requires FPGA v0.1.15 or later. Retunes must be scheduled in timestamp
+ * order for these changes to be tracked correctly.
+ *
+ * @note This requires FPGA v0.1.3 or later.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to retune
+ * @param[in]   timestamp   Timestamp at which to retune, or
+ *                          ::BLADERF_RETUNE_NOW
+ * @param[in]   quick_tune  Quick retune parameters, from
+ *                          bladerf_get_quick_tune()
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_QUEUE_FULL if the FPGA's retune queue is full,
+ *         BLADERF_ERR_UPDATE_FPGA if the FPGA does not support this feature,
+ *         value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_schedule_retune(struct bladerf *dev,
+                                      bladerf_module module,
+                                      uint64_t timestamp,
+                                      const struct bladerf_quick_tune *quick_tune);
+
+/**
+ * Number of bins in the bladerf_tuning_phase_stats histograms. These are
+ * binned as described for ::BLADERF_STREAM_STATS_HIST_LEN.
+ */
+#define BLADERF_TUNING_STATS_HIST_LEN 20
+
+/**
+ * Portions of a frequency change timed by bladerf_get_tuning_stats()
+ */
+typedef enum {
+    BLADERF_TUNING_PHASE_XB200 = 0, /**< XB-200 path and filter selection */
+    BLADERF_TUNING_PHASE_PLL,       /**< LMS6002D PLL divider calculation and
+                                     *   configuration, excluding the VCOCAP
+                                     *   selection */
+    BLADERF_TUNING_PHASE_VCOCAP,    /**< VCO capacitor selection, from the
+                                     *   VCOCAP cache or a search */
+    BLADERF_TUNING_PHASE_BAND,      /**< Band selection */
+    BLADERF_TUNING_PHASE_DC_CAL,    /**< DC offset correction writes */
+    BLADERF_TUNING_PHASE_TOTAL,     /**< All of bladerf_set_frequency() */
+    BLADERF_TUNING_PHASE_QUICK,     /**< All of bladerf_quick_retune() */
+    BLADERF_TUNING_NUM_PHASES
+} bladerf_tuning_phase;
+
+/**
+ * Time spent in, and control requests performed by, one tuning phase
+ */
+struct bladerf_tuning_phase_stats {
+    uint64_t count;     /**< Number of times the phase was performed */
+    uint64_t total_us;  /**< Total time spent in the phase, in microseconds */
+    uint64_t max_us;    /**< Longest time spent in the phase */
+
+    /**
+     * Number of control requests sent to the device during the phase. Each
+     * request incurs a USB round trip, although batched requests may overlap.
+     */
+    uint64_t requests;
+
+    /** Histogram of the time spent in the phase, in microseconds */
+    uint64_t hist[BLADERF_TUNING_STATS_HIST_LEN];
+};
+
+/**
+ * Frequency change statistics for a module
+ *
+ * Only successful frequency changes are accounted for. Counts are
+ * accumulated from the time the device is opened, or from the last call to
+ * bladerf_reset_tuning_stats().
+ */
+struct bladerf_tuning_stats {
+    /** Statistics for each ::bladerf_tuning_phase */
+    struct bladerf_tuning_phase_stats phases[BLADERF_TUNING_NUM_PHASES];
+};
+
+/**
+ * Get the frequency change statistics for a module. These break down the
+ * time spent in bladerf_set_frequency() by phase, for profiling retune
+ * latency.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to query
+ * @param[out]  stats       Updated with the tuning statistics on success
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_tuning_stats(struct bladerf *dev,
+                                       bladerf_module module,
+                                       struct bladerf_tuning_stats *stats);
+
+/**
+ * Clear a module's frequency change statistics
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to reset statistics for
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_reset_tuning_stats(struct bladerf *dev,
+                                         bladerf_module module);
+
+/**
+ * How the frequency hopping engine performs hops
+ */
+typedef enum {
+    /**
+     * A host thread polls the module's timestamp counter, and retunes via
+     * bladerf_quick_retune() once each hop's timestamp is reached. Hops
+     * may cross bands, but occur a USB round trip or more after their
+     * timestamps.
+     */
+    BLADERF_HOP_HOST = 0,
+
+    /**
+     * A host thread keeps upcoming hops queued in the FPGA via
+     * bladerf_schedule_retune(), which performs them at their exact
+     * timestamps. All channels must be within the same band. This
+     * requires FPGA v0.1.3 or later.
+     */
+    BLADERF_HOP_SCHEDULED,
+} bladerf_hop_mode;
+
+/**
+ * Specifies that hopping should begin at the current timestamp
+ */
+#define BLADERF_HOP_NOW 0
+
+/**
+ * Frequency hopping statistics
+ *
+ * A hop's margin is its timestamp, less the module's timestamp counter
+ * as read once its retune (::BLADERF_HOP_HOST) or its scheduling request
+ * (::BLADERF_HOP_SCHEDULED) completed. In ::BLADERF_HOP_HOST mode, the
+ * margin is the negated time by which the hop was late, in samples. In
+ * ::BLADERF_HOP_SCHEDULED mode, it is how far ahead of time the hop was
+ * queued. A negative margin in this mode means the hop occurred late.
+ */
+struct bladerf_hop_stats {
+    uint64_t hops;              /**< Hops performed or queued */
+    uint64_t late;              /**< Hops with a negative margin */
+    int64_t margin_min;         /**< Smallest margin, in samples */
+    int64_t margin_max;         /**< Largest margin, in samples */
+    double margin_mean;         /**< Mean margin, in samples */
+
+    /** Longest retune or scheduling request, in microseconds */
+    uint64_t request_us_max;
+
+    /** Mean retune or scheduling request time, in microseconds */
+    double request_us_mean;
+
+    /**
+     * Error that stopped hopping, or 0. bladerf_hop_stop() must still be
+     * called after an error.
+     */
+    int status;
+};
+
+/**
+ * Configure the frequency hopping engine for a module.
+ *
+ * Each channel is tuned once with bladerf_set_frequency() and its quick tune
+ * parameters are captured (see bladerf_get_quick_tune()), so that no PLL
+ * calculations or VCOCAP searches occur while hopping. The module is left
+ * tuned to the first channel.
+ *
+ * Hopping must be stopped while this is called.
+ *
+ * @param       dev             Device handle
+ * @param       module          Module to hop
+ * @param       freqs           Channels, in Hz, visited in order
+ * @param       num_freqs       Number of channels
+ * @param       dwell_samples   Time spent on each channel, in samples
+ * @param       mode            How hops are performed
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on invalid parameters, if
+ *         hopping is running, or if ::BLADERF_HOP_SCHEDULED channels span
+ *         both bands, or a value from 
+ef RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_hop_config(struct bladerf *dev,
+                                 bladerf_module module,
+                                 const unsigned int *freqs,
+                                 unsigned int num_freqs,
+                                 uint64_t dwell_samples,
+                                 bladerf_hop_mode mode);
+
+/**
+ * Start hopping through the configured channels, one every `dwell_samples`,
+ * starting from the first. Hops are timed against the module's timestamp
+ * counter (see bladerf_get_timestamp()), so the module should be streaming
+ * with a metadata format. The statistics are cleared.
+ *
+ * @param       dev         Device handle
+ * @param       module      Module to hop
+ * @param       timestamp   Timestamp of the first hop, or ::BLADERF_HOP_NOW
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if hopping is not configured or is
+ *         already running, BLADERF_ERR_UPDATE_FPGA if the FPGA does not
+ *         support ::BLADERF_HOP_SCHEDULED, or a value from 
+ef RETCODES list
+ *         on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_hop_start(struct bladerf *dev,
+                                bladerf_module module,
+                                uint64_t timestamp);
+
+/**
+ * Stop hopping. Hops already queued in the FPGA are still performed. This
+ * has no effect if hopping is not running.
+ *
+ * @param       dev         Device handle
+ * @param       module      Module to stop hopping
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on an invalid module
+ */
+API_EXPORT
+int CALL_CONV bladerf_hop_stop(struct bladerf *dev, bladerf_module module);
+
+/**
+ * Get the frequency hopping statistics for a module, since hopping was last
+ * started
+ *
+ * @param       dev         Device handle
+ * @param       module      Module to query
+ * @param[out]  stats       Hopping statistics
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on an invalid module
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_hop_stats(struct bladerf *dev,
+                                    bladerf_module module,
+                                    struct bladerf_hop_stats *stats);
+
+/**
+ * Maximum length of an operating profile name, including the terminating
+ * NUL character
+ */
+#define BLADERF_PROFILE_NAME_LEN 32
+
+/**
+ * Specifies that a profile should be applied immediately
+ */
+#define BLADERF_PROFILE_NOW 0
+
+/**
+ * Operating profile parameters. See bladerf_profile_define().
+ */
+struct bladerf_profile_config {
+    unsigned int frequency;                 /**< Frequency, in Hz */
+    struct bladerf_rational_rate samplerate;/**< Sample rate */
+    unsigned int bandwidth;                 /**< LPF bandwidth, in Hz */
+    int gain;                               /**< Combined gain, as used by
+                                             *   bladerf_set_gain() */
+};
+
+/**
+ * Define a named operating profile for a module, replacing any existing
+ * profile of the same name.
+ *
+ * A profile holds the register values that configure the module's sample
+ * rate (Si5338), LPF bandwidth, gains, and frequency (LMS6002D), along with
+ * the XB-200 signal path and filter bank if one is attached. Since these are
+ * computed when the profile is defined, switching between profiles with
+ * bladerf_profile_apply() involves no sample rate, PLL or gain calculations,
+ * VCOCAP searches, or register reads.
+ *
+ * If `config` is provided, the module is first configured with it, via
+ * bladerf_set_rational_sample_rate(), bladerf_set_bandwidth(),
+ * bladerf_set_frequency() and bladerf_set_gain(), and is left in this
+ * configuration. If `config` is NULL, the module's current configuration is
+ * captured, including individually set gain stages and LPF modes.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to define the profile for
+ * @param[in]   name        Profile name, shorter than
+ *                          ::BLADERF_PROFILE_NAME_LEN
+ * @param[in]   config      Parameters, or NULL to capture the current ones
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on an invalid module or name,
+ *         BLADERF_ERR_MEM if the profile could not be stored,
+ *         or a value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_profile_define(struct bladerf *dev,
+                                     bladerf_module module,
+                                     const char *name,
+                                     const struct bladerf_profile_config *config);
+
+/**
+ * Switch a module to the specified operating profile.
+ *
+ * Only the registers that differ from their current values are written.
+ * Gain stages that are reduced are written first, followed by the sample
+ * clock, the XB-200 path and filter bank, and the band selection. The
+ * LMS6002D PLL, VCOCAP, DC offset corrections, LPF, and any gain increases
+ * are then written in a single batch. Thus, the module does not pass
+ * through states with more gain than either profile, and a switch takes a
+ * few batched requests rather than one round trip per setting.
+ *
+ * With a `timestamp` other than ::BLADERF_PROFILE_NOW, the changes are
+ * instead queued in the FPGA, which applies them once the module's
+ * timestamp counter (see bladerf_get_timestamp()) reaches `timestamp`. This
+ * uses up to five entries of the FPGA's queue, which is shared with
+ * bladerf_schedule_retune() and bladerf_schedule_gain(). As with
+ * bladerf_schedule_retune(), the profile must keep the current band, and
+ * its DC offset corrections are not applied. The sample clock cannot be
+ * switched by the FPGA, so the profile must have the current sample rate.
+ * This requires FPGA v0.1.4 or later.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to configure
+ * @param[in]   name        Name of a profile defined for `module`
+ * @param[in]   timestamp   Timestamp at which to apply the profile, or
+ *                          ::BLADERF_PROFILE_NOW
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if there is no such profile, or a scheduled
+ *         profile changes the band or sample rate,
+ *         BLADERF_ERR_QUEUE_FULL if the FPGA's queue is full,
+ *         BLADERF_ERR_UPDATE_FPGA if the FPGA does not support scheduling,
+ *         or a value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_profile_apply(struct bladerf *dev,
+                                    bladerf_module module,
+                                    const char *name,
+                                    uint64_t timestamp);
+
+/**
+ * Remove an operating profile
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module the profile was defined for
+ * @param[in]   name        Profile name
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if there is no such profile
+ */
+API_EXPORT
+int CALL_CONV bladerf_profile_remove(struct bladerf *dev,
+                                     bladerf_module module,
+                                     const char *name);
+
+/**
+ * Kind of operation recorded by the control path trace
+ */
+typedef enum {
+    /**
+     * A peripheral register access by the NIOS II, from the request to its
+     * acknowledgement. This spans the BLADERF_TRACE_BULK_OUT and
+     * BLADERF_TRACE_BULK_IN records of the request and its ACK.
+     */
+    BLADERF_TRACE_PERIPHERAL = 0,
+    BLADERF_TRACE_CONTROL,      /**< Vendor control request */
+    BLADERF_TRACE_BULK_OUT,     /**< Bulk transfer to the device */
+    BLADERF_TRACE_BULK_IN       /**< Bulk transfer from the device */
+} bladerf_trace_type;
+
+/**
+ * Device that a control path operation is directed to
+ */
+typedef enum {
+    BLADERF_TRACE_TARGET_FX3 = 0,   /**< The FX3 itself */
+    BLADERF_TRACE_TARGET_FPGA,      /**< FPGA configuration */
+    BLADERF_TRACE_TARGET_FLASH,     /**< SPI flash and OTP */
+    BLADERF_TRACE_TARGET_GPIO,      /**< FPGA registers */
+    BLADERF_TRACE_TARGET_LMS,       /**< LMS6002D */
+    BLADERF_TRACE_TARGET_SI5338,    /**< Si5338 clock generator */
+    BLADERF_TRACE_TARGET_VCTCXO     /**< VCTCXO trim DAC */
+} bladerf_trace_target;
+
+/**
+ * A control path operation, recorded by the trace enabled with
+ * bladerf_trace_enable()
+ */
+struct bladerf_trace_record {
+    /** Host time at which the operation started, in nanoseconds since the
+     *  Unix epoch. This is the clock used by the stream and tuning
+     *  statistics. */
+    uint64_t start_ns;
+
+    uint32_t duration_ns;           /**< Duration of the operation */
+    bladerf_trace_type type;        /**< Kind of operation */
+    bladerf_trace_target target;    /**< Target of the operation */
+
+    /**
+     * For BLADERF_TRACE_CONTROL, the vendor request code. For the other
+     * types, the peripheral request's mode byte, or 0 for other bulk
+     * transfers.
+     */
+    uint8_t request;
+
+    /**
+     * Number of bytes transferred, or for BLADERF_TRACE_PERIPHERAL, the
+     * number of registers accessed
+     */
+    uint32_t length;
+
+    int status;                     /**< 0 or a BLADERF_ERR_* value */
+};
+
+/**
+ * Enable or disable the control path trace, which records every peripheral
+ * access, vendor request, and control path bulk transfer in a ring buffer of
+ * `num_records` records. Once the buffer is full, the oldest records are
+ * overwritten.
+ *
+ * Stream transfers are not traced.
+ *
+ * @param       dev             Device handle
+ * @param[in]   num_records     Size of the ring buffer. 0 disables tracing
+ *                              and frees the buffer.
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_trace_enable(struct bladerf *dev,
+                                   unsigned int num_records);
+
+/**
+ * Remove and return the oldest records from the control path trace
+ *
+ * @param       dev             Device handle
+ * @param[out]  records         Populated with up to `max_records` records,
+ *                              oldest first
+ * @param[in]   max_records     Capacity of `records`
+ * @param[out]  num_records     Updated with the number of records read
+ *
+ * @return 0 on success, BLADERF_ERR_UNSUPPORTED if tracing is not enabled,
+ *         or a value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_trace_read(struct bladerf *dev,
+                                 struct bladerf_trace_record *records,
+                                 unsigned int max_records,
+                                 unsigned int *num_records);
+
+/**
+ * Attach and enable an expansion board's features
+ *
+ * @param       dev         Device handle
+ * @param       xb          Expansion board
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_expansion_attach(struct bladerf *dev, bladerf_xb xb);
+
+/**
+ * Determine which expansion board is attached
+ *
+ * @param       dev         Device handle
+ * @param       xb          Expansion board
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_expansion_get_attached(struct bladerf *dev, bladerf_xb *xb);
+
+/**
+ * Set XB-200 filterbank
+ *
+ * @param       dev         Device handle
+ * @param       mod         Module
+ * @param       filter      XB200 filterbank
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_xb200_set_filterbank(struct bladerf *dev,
+                                           bladerf_module mod,
+                                           bladerf_xb200_filter filter);
+
+/**
+ * Get current XB-200 filterbank
+ *
+ * @param[in]    dev        Device handle
+ * @param[in]    module     Module to query
+ * @param[out]   filter     Pointer to filterbank, only updated if return
+ *                          value is 0.
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_xb200_get_filterbank(struct bladerf *dev,
+                                           bladerf_module module,
+                                           bladerf_xb200_filter *filter);
+
+/**
+ * Set XB-200 signal path
+ *
+ * @param       dev         Device handle
+ * @param       module      Module to configure
+ * @param       path        Desired XB-200 signal path
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_xb200_set_path(struct bladerf *dev,
+                                     bladerf_module module,
+                                     bladerf_xb200_path path);
+
+/**
+ * Get current XB-200 signal path
+ *
+ * @param       dev         Device handle
+ * @param       module      Module to query
+ * @param       path        Pointer to XB200 signal path
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_xb200_get_path(struct bladerf *dev,
+                                     bladerf_module module,
+                                     bladerf_xb200_path *path);
+
+/**
+ * Snapshot of a device's configuration, as provided by
+ * bladerf_get_config_snapshot()
+ */
+struct bladerf_config_snapshot {
+    unsigned int rx_frequency;                  /**< RX frequency, in Hz */
+    unsigned int tx_frequency;                  /**< TX frequency, in Hz */
+    unsigned int rx_bandwidth;                  /**< RX LPF bandwidth, in Hz */
+    unsigned int tx_bandwidth;                  /**< TX LPF bandwidth, in Hz */
+    bladerf_lpf_mode rx_lpf_mode;               /**< RX LPF mode */
+    bladerf_lpf_mode tx_lpf_mode;               /**< TX LPF mode */
+    struct bladerf_rational_rate rx_samplerate; /**< RX sample rate */
+    struct bladerf_rational_rate tx_samplerate; /**< TX sample rate */
+    bladerf_lna_gain lnagain;                   /**< LNA gain */
+    int rxvga1;                                 /**< RXVGA1 gain, in dB */
+    int rxvga2;                                 /**< RXVGA2 gain, in dB */
+    int txvga1;                                 /**< TXVGA1 gain, in dB */
+    int txvga2;                                 /**< TXVGA2 gain, in dB */
+    bladerf_loopback loopback;                  /**< Loopback mode */
+    bladerf_sampling sampling;                  /**< Sampling mode */
+    uint32_t gpio;                              /**< FPGA configuration
+                                                 *   GPIO value */
+    uint16_t vctcxo_trim;                       /**< VCTCXO trim DAC value */
+};
+
+/**
+ * Read the device's frequencies, bandwidths, LPF modes, sample rates, gains,
+ * loopback and sampling modes, and configuration GPIO value.
+ *
+ * This is equivalent to calling each of the associated bladerf_get_*()
+ * functions, but the required LMS6002D and Si5338 registers are read in as
+ * few batched transactions as possible, and registers shared by multiple
+ * settings are read only once. This makes it suitable for frequently
+ * polling the state of many devices.
+ *
+ * @param       dev         Device handle
+ * @param[out]  snapshot    Updated with the device's configuration
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure. On failure,
+ *         the contents of `snapshot` are undefined.
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_config_snapshot(struct bladerf *dev,
+                                    struct bladerf_config_snapshot *snapshot);
+
+/** @} (End of FN_CTRL) */
+
+/**
+ * @defgroup FMT_META   Sample Formats and Metadata
+ *
+ * This section defines the available sample formats and metadata flags.
+ *
+ * @{
+ */
+
+/**
+ * Sample format
+ */
+typedef enum {
+    /**
+     * Signed, Complex 16-bit Q11. This is the native format of the DAC data.
+     *
+     * Values in the range [-2048, 2048) are used to represent [-1.0, 1.0).
+     * Note that the lower bound here is inclusive, and the upper bound is
+     * exclusive. Ensure that provided samples stay within [-2048, 2047].
+     *
+     * Samples consist of interleaved IQ value pairs, with I being the first
+     * value in the pair. Each value in the pair is a right-aligned,
+     * little-endian int16_t. The FPGA ensures that these values are
+     * sign-extended.
+     *
+     * When using this format the minimum required buffer size, in bytes, is:
+     * <pre>
+     *   buffer_size_min = [ 2 * num_samples * sizeof(int16_t) ]
+     * </pre>
+     *
+     * For example, to hold 2048 samples, a buffer must be at least 8192 bytes
+     * large.
+     */
+    BLADERF_FORMAT_SC16_Q11,
+
+    /**
+     * This format is the same as the ::BLADERF_FORMAT_SC16_Q11 format, except the
+     * first 4 samples (16 bytes) in every block of 1024 samples are replaced
+     * with metadata, organized as follows, with all fields being little endian
+     * byte order:
+     *
+     * <pre>
+     *  0x00 [uint32_t:  Reserved]
+     *  0x04 [uint64_t:  64-bit Timestamp]
+     *  0x0c [uint32_t:  BLADERF_META_FLAG_* flags]
+     * </pre>
+     *
+     * When using the bladerf_sync_rx() and bladerf_sync_tx() functions,
+     * this detail is transparent to caller. These functions take care of
+     * packing/unpacking the metadata into/from the data, via the
+     * bladerf_metadata structure.
+     *
+     * When using the asynchronous data transfer interface, RX callbacks
+     * receive a summary of each buffer's metadata, and the metadata of each
+     * message is available via bladerf_get_stream_msg_index(). The user is
+     * responsible for packing TX metadata into their sample data.
+     */
+    BLADERF_FORMAT_SC16_Q11_META,
+
+    /**
+     * Averaged power spectra computed by the FPGA, rather than IQ samples.
+     * This is only supported for RX, and requires FPGA v0.1.8 or later.
+     *
+     * The FPGA Hann windows frames of ::BLADERF_PSD_FFT_SIZE samples, takes
+     * their FFT, and averages the power of each bin over the number of frames
+     * set by bladerf_set_psd_averaging(). Each spectrum is delivered as
+     * ::BLADERF_PSD_FFT_SIZE little endian uint32_t values, in FFT bin
+     * order: bin `k` is centered on `k * samplerate / BLADERF_PSD_FFT_SIZE`
+     * for the first half of the bins, and on negative frequencies for the
+     * second half.
+     *
+     * Each value is `round(4096 * mean(|X[k]|^2))`, saturated, where `X` is
+     * the windowed FFT of the SC16 Q11 sample values divided by the FFT size.
+     * A full scale tone centered on a bin therefore reads close to
+     * 0xffffffff.
+     *
+     * Spectra are never split across buffers, and each uint32_t value
+     * occupies the space of one sample. Frames that arrive while the FPGA is
+     * busy with the previous one are skipped, so spectra are produced far
+     * less often than the sample rate would suggest. Stream timeouts should
+     * be chosen accordingly.
+     */
+    BLADERF_FORMAT_PSD_U32,
+
+    /**
+     * SC16 Q11 samples, carried over USB with only their 12 significant bits
+     * per component. This moves 33% more samples over the same link as
+     * ::BLADERF_FORMAT_SC16_Q11, which helps most on USB 2.0 and when
+     * streaming RX and TX at once. This requires FPGA v0.1.10 or later.
+     *
+     * Each sample is packed into 3 bytes, forming a little endian 24-bit
+     * value. I is held in its lower 12 bits and Q in its upper 12 bits.
+     *
+     * When using the bladerf_sync_rx() and bladerf_sync_tx() functions, the
+     * caller's samples are in the ::BLADERF_FORMAT_SC16_Q11 layout, and the
+     * packing is transparent. bladerf_sync_rx_acquire() and
+     * bladerf_sync_tx_acquire() are not supported.
+     *
+     * Asynchronous stream buffers hold the packed samples, and
+     * bladerf_unpack_sc16_q11() and bladerf_pack_sc16_q11() convert them.
+     * The minimum required buffer size, in bytes, is:
+     * <pre>
+     *   buffer_size_min = [ 3 * num_samples ]
+     * </pre>
+     *
+     * Buffers must hold a multiple of 4096 samples. This format cannot carry
+     * metadata, so it may not be used for one module while the other uses
+     * ::BLADERF_FORMAT_SC16_Q11_META.
+     */
+    BLADERF_FORMAT_SC16_Q11_PACKED,
+
+    /**
+     * Signed, interleaved 8-bit I/Q samples, 2 bytes per sample. This moves
+     * twice as many samples over the same link as ::BLADERF_FORMAT_SC16_Q11.
+     * This requires FPGA v0.1.11 or later.
+     *
+     * The FPGA converts between these and SC16 Q11 samples with the shift
+     * set by bladerf_set_sc8_shift(). With the default shift of
+     * ::BLADERF_SC8_SHIFT_DEFAULT, the values [-128, 127] cover the same
+     * range as [-2048, 2047] do in SC16 Q11.
+     *
+     * The samples are passed through unchanged by the synchronous and
+     * asynchronous interfaces, in the order:
+     * <pre>
+     *  I0, Q0, I1, Q1, ... I[n-1], Q[n-1]
+     * </pre>
+     *
+     * The minimum required buffer size, in bytes, is:
+     * <pre>
+     *   buffer_size_min = [ 2 * num_samples ]
+     * </pre>
+     *
+     * Buffers must hold a multiple of 2048 samples.
+     */
+    BLADERF_FORMAT_SC8_Q7,
+
+    /**
+     * ::BLADERF_FORMAT_SC8_Q7 samples, with metadata. This carries the same
+     * metadata as ::BLADERF_FORMAT_SC16_Q11_META, in the same message
+     * headers, and is used the same way. Each message holds twice as many
+     * samples, so the first 8 samples (16 bytes) in every message of 512
+     * (USB 2.0) or 1024 (USB 3.0) samples are replaced with metadata.
+     *
+     * It may be combined with ::BLADERF_FORMAT_SC16_Q11_META on the other
+     * module. This requires FPGA v0.1.11 or later.
+     */
+    BLADERF_FORMAT_SC8_Q7_META,
+
+    /**
+     * Interleaved single precision float samples, 8 bytes per sample, for
+     * use with the synchronous interface only. Samples are carried over USB
+     * as ::BLADERF_FORMAT_SC16_Q11, and bladerf_sync_rx() and
+     * bladerf_sync_tx() convert them as they are copied, using SIMD
+     * instructions when available.
+     *
+     * Values are scaled so that [-1.0, 1.0) covers the SC16 Q11 range: RX
+     * samples are divided by 2048.0, and TX samples are multiplied by 2048.0,
+     * rounded to the nearest integer, and saturated to [-2048, 2047].
+     * <pre>
+     *  I0, Q0, I1, Q1, ... I[n-1], Q[n-1]
+     * </pre>
+     *
+     * Buffer sizes passed to bladerf_sync_config() are in samples, as with
+     * ::BLADERF_FORMAT_SC16_Q11. bladerf_sync_rx_acquire() and
+     * bladerf_sync_tx_acquire() are not supported, nor is the asynchronous
+     * interface.
+     */
+    BLADERF_FORMAT_CF32,
+
+    /**
+     * ::BLADERF_FORMAT_CF32 samples, with the metadata of
+     * ::BLADERF_FORMAT_SC16_Q11_META. The caller's buffers hold only samples;
+     * the message headers are handled by the synchronous interface, as for
+     * ::BLADERF_FORMAT_SC16_Q11_META.
+     */
+    BLADERF_FORMAT_CF32_META,
+
+    /**
+     * Packed PSK symbols, for the TX module only. Each "sample" is a
+     * little-endian 32-bit word of symbols, least significant bits first:
+     * 32 BPSK, 16 QPSK, or 10 8-PSK symbols per word, as selected by
+     * bladerf_set_tx_modulation(). QPSK and 8-PSK symbols are Gray coded.
+     *
+     * The FPGA maps the symbols onto the constellation, shapes them with a
+     * root raised cosine filter (rolloff of 0.35, spanning 6 symbols) at 4
+     * samples per symbol, then interpolates them as set by
+     * bladerf_set_interpolation(). The symbol rate is therefore the sample
+     * rate divided by `4 * 2^rate_log2`.
+     *
+     * This format carries no metadata, and the RX module must not use a
+     * metadata format while it is in use. This requires FPGA v0.1.23 or
+     * later.
+     */
+    BLADERF_FORMAT_TX_SYMBOLS,
+} bladerf_format;
+
+/**
+ * Unpack samples of the ::BLADERF_FORMAT_SC16_Q11_PACKED format into the
+ * ::BLADERF_FORMAT_SC16_Q11 layout. This uses SIMD instructions when
+ * available.
+ *
+ * @param[out]  samples     Destination, with space for `num_samples` samples
+ * @param[in]   packed      Packed samples, `3 * num_samples` bytes long
+ * @param[in]   num_samples Number of samples to unpack
+ */
+API_EXPORT
+void CALL_CONV bladerf_unpack_sc16_q11(int16_t *samples, const void *packed,
+                                       unsigned int num_samples);
+
+/**
+ * Pack ::BLADERF_FORMAT_SC16_Q11 samples into the
+ * ::BLADERF_FORMAT_SC16_Q11_PACKED format. Only the lower 12 bits of each
+ * component are kept, so samples must stay within [-2048, 2047].
+ *
+ * @param[out]  packed      Destination, `3 * num_samples` bytes long
+ * @param[in]   samples     Samples to pack
+ * @param[in]   num_samples Number of samples to pack
+ */
+API_EXPORT
+void CALL_CONV bladerf_pack_sc16_q11(void *packed, const int16_t *samples,
+                                     unsigned int num_samples);
+
+/**
+ * Convert SC16 Q11 samples to interleaved floats, as described for
+ * ::BLADERF_FORMAT_CF32. Values are divided by 2048.0, so full scale is
+ * [-1.0, 1.0).
+ *
+ * This and the other bladerf_convert_* functions select the fastest SIMD
+ * implementation available at runtime. Buffers need not be aligned.
+ *
+ * @param[out]  dst         Destination, `2 * num_samples` floats long
+ * @param[in]   src         Samples to convert
+ * @param[in]   num_samples Number of samples to convert
+ */
+API_EXPORT
+void CALL_CONV bladerf_convert_sc16q11_to_cf32(float *dst, const int16_t *src,
+                                               unsigned int num_samples);
+
+/**
+ * Convert interleaved floats to SC16 Q11 samples, as described for
+ * ::BLADERF_FORMAT_CF32. Values are multiplied by 2048.0, rounded to the
+ * nearest integer, and saturated to [-2048, 2047]. NaNs are saturated to
+ * 2047.
+ *
+ * @param[out]  dst         Destination, `2 * num_samples` values long
+ * @param[in]   src         Samples to convert
+ * @param[in]   num_samples Number of samples to convert
+ */
+API_EXPORT
+void CALL_CONV bladerf_convert_cf32_to_sc16q11(int16_t *dst, const float *src,
+                                               unsigned int num_samples);
+
+/**
+ * Convert SC16 Q11 samples to signed 8-bit samples, as the FPGA does for
+ * ::BLADERF_FORMAT_SC8_Q7. Values are divided by `2^shift`, rounded, and
+ * saturated to [-128, 127].
+ *
+ * @param[out]  dst         Destination, `2 * num_samples` bytes long
+ * @param[in]   src         Samples to convert
+ * @param[in]   num_samples Number of samples to convert
+ * @param[in]   shift       Shift, up to ::BLADERF_SC8_SHIFT_MAX. Larger
+ *                          values are treated as ::BLADERF_SC8_SHIFT_MAX.
+ *                          ::BLADERF_SC8_SHIFT_DEFAULT maps full scale onto
+ *                          full scale.
+ */
+API_EXPORT
+void CALL_CONV bladerf_convert_sc16q11_to_cs8(int8_t *dst, const int16_t *src,
+                                              unsigned int num_samples,
+                                              unsigned int shift);
+
+/**
+ * Get the name of the SIMD implementation used by the bladerf_convert_*,
+ * bladerf_pack_sc16_q11() and bladerf_unpack_sc16_q11() functions on this
+ * machine.
+ *
+ * @return "avx2", "sse2", "neon", or "generic". The pack and unpack
+ *         functions use SSE2 where AVX2 is reported.
+ */
+API_EXPORT
+const char * CALL_CONV bladerf_convert_impl(void);
+
+/*
+ * Metadata status bits
+ *
+ * These are used in conjunction with the bladerf_metadata structure's
+ * `status` field.
+ */
+
+/**
+ * A sample overrun has occurred. This indicates that either the host
+ * (more likely) or the FPGA is not keeping up with the incoming samples.
+ *
+ * The number of samples lost is reported via the bladerf_metadata
+ * structure's `dropped_samples` field.
+ */
+#define BLADERF_META_STATUS_OVERRUN  (1 << 0)
+
+/**
+ * A sample underrun has occurred. This generally only occurrs on the TX module
+ * when the FPGA is starved of samples.
+ *
+ * bladerf_sync_tx() and bladerf_sync_tx_commit() report this status when
+ * one or more underruns have been counted in the `underruns` field of the
+ * bladerf_stream_stats structure since the previous call. As an underrun is
+ * only detected once transmission resumes, this is reported after the
+ * samples that followed it have been submitted.
+ */
+#define BLADERF_META_STATUS_UNDERRUN (1 << 1)
+
+/**
+ * The RX AGC has changed the gain since the previous call to
+ * bladerf_sync_rx(). The change takes effect at the bladerf_metadata
+ * structure's `gain_timestamp`. See bladerf_enable_rx_agc().
+ */
+#define BLADERF_META_STATUS_GAIN_CHANGE (1 << 2)
+
+/**
+ * The FPGA's RX sample FIFO overflowed, such that samples were dropped before
+ * reaching the host. The number of samples the FPGA dropped is reported via
+ * the bladerf_metadata structure's `fpga_dropped_samples` field.
+ *
+ * bladerf_sync_rx() reports this alongside ::BLADERF_META_STATUS_OVERRUN,
+ * when the discontinuity it reports follows an overflow. Any difference
+ * between `dropped_samples` and `fpga_dropped_samples` was then lost on the
+ * host. RX stream callbacks receive this for buffers holding messages that
+ * follow an overflow.
+ *
+ * This requires FPGA v0.1.19 or later, and a format with metadata.
+ */
+#define BLADERF_META_STATUS_FPGA_OVERFLOW (1 << 3)
+
+
+
+/*
+ * Metadata flags
+ *
+ * These are used in conjunction with the bladerf_metadata structure's
+ * `flags` field.
+ */
+
+/**
+ * Mark the associated buffer as the start of a burst transmission.
+ * This is only used for the bladerf_sync_tx() call.
+ */
+#define BLADERF_META_FLAG_TX_BURST_START   (1 << 0)
+
+/**
+ * Mark the associated buffer as the end of a burst transmission. This will
+ * flush the remainder of the sync interfaces' current working buffer and
+ * enqueue samples into the transmit FIFO.
+ *
+ * When specifying this flag to bladerf_sync_tx(), the final two samples
+ * in the synchronous interface's internal working buffer <b>must</b> be zero.
+ * Unexpected results may occur if this is not the case. To ensure this
+ * requirement is met, API users should ensure the last two samples provided to
+ * bladerf_sync_tx() are zero when using ::BLADERF_META_FLAG_TX_BURST_END. One
+ * way to do this is to end bursts with a call of bladerf_sync_tx() with this
+ * flag set and a buffer of 2 or more zero samples.
+ *
+ * Flushing the sync interface's working buffer implies that after specifying
+ * this flag, the next timestamp that can be transmitted is the current
+ * timestamp plus the duration of the burst that this flag is ending <b>and</b>
+ * the remaining length of the remaining buffer that is flushed. (The buffer
+ * size, in this case, is the `buffer_size` value passed to the previous
+ * bladerf_sync_config() call.)
+ *
+ * Rather than attempting to keep track of the number of samples sent with
+ * respect to buffer sizes, it is easiest to always assume 1 buffer's worth of
+ * time is required between bursts. In this case "buffer" refers to the
+ * `buffer_size` parameter provided to bladerf_sync_config().) If this is too
+ * much time, consider combining multiple bursts and manually zero-padding
+ * samples between them.
+ *
+ * FPGA v0.1.13 and later transmit zeros between bursts themselves. With
+ * these, the flushed remainder of the buffer is discarded by the FPGA rather
+ * than transmitted, so the next burst may begin as soon as this one ends, and
+ * bursts need not end with zero samples.
+ *
+ * This is only used for the bladerf_sync_tx() call. It is ignored by the
+ * bladerf_sync_rx() call.
+ *
+ */
+#define BLADERF_META_FLAG_TX_BURST_END     (1 << 1)
+
+/**
+ * Use this flag in conjunction with ::BLADERF_META_FLAG_TX_BURST_START to
+ * indicate that the burst should be transmitted as soon as possible, as opposed
+ * to waiting for a specific timestamp.
+ *
+ * When this flag is used, there is no need to set the
+ * bladerf_metadata::timestamp field.
+ */
+#define BLADERF_META_FLAG_TX_NOW           (1 << 2)
+
+/**
+ * Use this flag in conjunction with ::BLADERF_META_FLAG_TX_BURST_START to
+ * have the FPGA drop the burst's messages that arrive after their timestamp
+ * has passed. Zeros are transmitted in their place, so later messages of the
+ * burst still go out at the right time. Without this flag, late messages are
+ * transmitted as soon as they arrive.
+ *
+ * Late messages are counted either way. See bladerf_get_tx_late().
+ *
+ * This requires FPGA v0.1.20 or later, and is ignored otherwise.
+ */
+#define BLADERF_META_FLAG_TX_DROP_LATE     (1 << 3)
+
+/**
+ * This flag indicates that calls to bladerf_sync_rx should return any available
+ * samples, rather than wait until the timestamp indicated in the
+ * bladerf_metadata timestamp field.
+ *
+ * If a discontinuity is found prior to the first sample to be returned, and
+ * samples have previously been returned since the stream was started, the call
+ * returns with no samples and the ::BLADERF_META_STATUS_OVERRUN status flag
+ * set, such that the gap is reported. In this case, the timestamp field is
+ * updated with the timestamp of the first sample following the gap.
+ */
+#define BLADERF_META_FLAG_RX_NOW           (1 << 31)
+
+/*
+ * RX message header flags
+ *
+ * FPGA v0.1.19 and later report RX FIFO overflows in the flags word of the
+ * header of the first RX message following each overflow. These flags
+ * appear in the bladerf_stream_msg structure's `flags` field. They are zero
+ * with earlier FPGAs, whose RX headers carry no flags.
+ */
+
+/**
+ * Samples were dropped by the FPGA, due to an RX FIFO overflow, ahead of the
+ * message
+ */
+#define BLADERF_META_FLAG_RX_OVERFLOW      (1 << 30)
+
+/**
+ * Number of samples dropped ahead of a message flagged with
+ * ::BLADERF_META_FLAG_RX_OVERFLOW. This saturates at its maximum value.
+ */
+#define BLADERF_META_FLAG_RX_DROPPED_MASK  0x3fffffff
+
+/**
+ * Sample metadata
+ *
+ * This structure is used in conjunction with the ::BLADERF_FORMAT_SC16_Q11_META
+ * format to TX scheduled bursts or retrieve timestamp information about
+ * received samples.
+ */
+struct bladerf_metadata {
+
+    /**
+     * Free-running FPGA counter that monotonically increases at the
+     * sample rate of the associated module. */
+    uint64_t timestamp;
+
+    /**
+     * Input bit field to control the behavior of the call that the metadata
+     * structure is passed to. API calls read this field from the provided
+     * data structure, and do not modify it.
+     *
+     * Valid flags include
+     *  ::BLADERF_META_FLAG_TX_BURST_START, ::BLADERF_META_FLAG_TX_BURST_END,
+     *  ::BLADERF_META_FLAG_TX_NOW, and ::BLADERF_META_FLAG_RX_NOW
+     *
+     */
+    uint32_t flags;
+
+    /**
+     * Output bit field to denoting the status of transmissions/receptions. API
+     * calls will write this field.
+     *
+     * Possible status flags include ::BLADERF_META_STATUS_OVERRUN and
+     * ::BLADERF_META_STATUS_UNDERRUN;
+     *
+     */
+    uint32_t status;
+
+    /**
+     * This output parameter is updated to reflect the actual number of
+     * contiguous samples that have been populated in an RX buffer during
+     * a bladerf_sync_rx() call.
+     *
+     * This will not be equal to the requested count in the event of a
+     * discontinuity (i.e., when the status field has the
+     * ::BLADERF_META_STATUS_OVERRUN flag set). When an overrun occurs, it is
+     * important not to read past the number of samples specified by this
+     * value, as the remaining contents of the buffer are undefined.
+     *
+     * This parameter is not currently used by bladerf_sync_tx().
+     */
+    unsigned int actual_count;
+
+    /**
+     * This output parameter is updated by bladerf_sync_rx() and
+     * bladerf_sync_rx_acquire() with the number of RX overruns the library
+     * has encountered since the previous such call. Each overrun occurs when
+     * the caller does not consume samples quickly enough to free up a
+     * buffer, and results in `num_transfers` buffers worth of samples being
+     * dropped.
+     *
+     * This is reported for both the ::BLADERF_FORMAT_SC16_Q11 and
+     * ::BLADERF_FORMAT_SC16_Q11_META formats. It is not used by
+     * bladerf_sync_tx().
+     */
+    uint32_t overruns;
+
+    /**
+     * This output parameter is updated with the number of samples that are
+     * missing at the discontinuity reported via the
+     * ::BLADERF_META_STATUS_OVERRUN status flag, as determined from the
+     * timestamps embedded in the received data. It is zero when no
+     * discontinuity is reported.
+     *
+     * For bladerf_sync_rx(), the gap immediately follows the `actual_count`
+     * samples returned. For bladerf_sync_rx_acquire(), the gap
+     * immediately precedes the lent samples.
+     *
+     * This field is only used with the ::BLADERF_FORMAT_SC16_Q11_META format.
+     */
+    uint64_t dropped_samples;
+
+    /**
+     * This output parameter is updated with the number of samples the FPGA
+     * dropped due to RX FIFO overflows, as reported via the
+     * ::BLADERF_META_STATUS_FPGA_OVERFLOW status flag. It is zero when that
+     * flag is not set.
+     *
+     * For bladerf_sync_rx() and bladerf_sync_rx_acquire(), this covers the
+     * discontinuity reported alongside `dropped_samples`, and is at most
+     * that count. For RX stream callbacks, this covers all of a buffer's
+     * messages.
+     *
+     * This field is only used with the ::BLADERF_FORMAT_SC16_Q11_META format.
+     */
+    uint64_t fpga_dropped_samples;
+
+    /**
+     * This output parameter is updated by bladerf_sync_rx() with the mask of
+     * channels being streamed by the channelizer FPGA image. See
+     * bladerf_set_rx_channels(). It is zero with other FPGA images.
+     *
+     * This field is only used with the ::BLADERF_FORMAT_SC16_Q11_META format.
+     */
+    uint16_t channel_mask;
+
+    /**
+     * This output parameter is updated by bladerf_sync_rx() with the
+     * channelizer channel of the first returned sample, when `channel_mask`
+     * is non-zero. Subsequent samples cycle through the channels set in
+     * `channel_mask` in ascending order.
+     */
+    uint8_t channel;
+
+    /**
+     * This output parameter is updated by bladerf_sync_rx() while the RX AGC
+     * is enabled, with the combined RX gain applied by its most recent gain
+     * change. See bladerf_enable_rx_agc().
+     */
+    int8_t gain;
+
+    /**
+     * This output parameter is updated by bladerf_sync_rx() while the RX AGC
+     * is enabled, with the timestamp at which `gain` takes effect. Samples
+     * with earlier timestamps were received with the previous gain.
+     */
+    uint64_t gain_timestamp;
+
+    /**
+     * Reserved for future use. This is not used by any functions.
+     * It is recommended that users zero out this field.
+     */
+    uint8_t reserved[8];
+};
+
+
+/** @} (End of FMT_META) */
+
+
+/**
+ * @defgroup FN_DATA_ASYNC    Asynchronous data transmission and reception
+ *
+ * This interface gives the API user full control over the stream and buffer
+ * management, at the cost of added complexity.
+ *
+ * New users are recommended to first evaluate the \ref FN_DATA_SYNC interface,
+ * and to only use this interface if the former is found to not yield suitable
+ * performance.
+ *
+ * @{
+ */
+
+/**
+ * Use this as a return value in callbacks or as the buffer parameter to
+ * bladerf_submit_stream_buffer() to shutdown a stream.
+ */
+#define BLADERF_STREAM_SHUTDOWN (NULL)
+
+/**
+ * Use this value in a stream callback to indicate that no buffer is being
+ * provided. In this case, buffers are expected to be provided via
+ * bladerf_submit_stream_buffer().
+ */
+#define BLADERF_STREAM_NO_DATA  ((void*)(-1))
+
+/** This opaque structure is used to keep track of stream information */
+struct bladerf_stream;
+
+/**
+ * This typedef represents a callback function that is executed in response to
+ * this interface's asynchronous events.
+ *
+ * Stream callbacks <b>must not</b> block or perform long-running operations.
+ * Otherwise, timeouts may occur. If this cannot be guaranteed, consider
+ * returning BLADERF_STREAM_NO_DATA in callbacks and later submit a buffer using
+ * bladerf_submit_stream_buffer(). However, callbacks should always take a
+ * single approach of returning buffers <b>or</b> returning
+ * BLADERF_STREAM_NO_DATA and submitting buffers later -- <b>but not both</b>.
+ *
+ * When running in a full-duplex mode of operation with simultaneous TX and RX
+ * stream threads, be aware that one module's callback may occur in the context
+ * of another module's thread. The API user is responsible for ensuring their
+ * callbacks are thread safe. For example, when managing access to sample
+ * buffers, the caller must ensure that if one thread is processing samples in a
+ * buffer, that this buffer is not returned via the callback's return value.
+ *
+ * As of libbladeRF v0.15.0, is guaranteed that only one callback from a module
+ * will occur at a time. (i.e., a second TX callback will not fire while one is
+ * currently being handled.)
+ *
+ * With the libusb backend, callbacks execute without holding the per-stream
+ * lock, so a bladerf_submit_stream_buffer() call made from another thread may
+ * proceed while a callback is executing. When libbladeRF is built with the
+ * ENABLE_LIBBLADERF_STREAM_CB_LOCKED option (and with other backends), the
+ * per-stream lock is held while a callback executes. It is important to
+ * consider this when thinking about the order of lock acquisitions both in the
+ * callbacks, and the code surrounding bladerf_submit_stream_buffer().
+ *
+ * <b>Note:</b>Do not call bladerf_submit_stream_buffer() from a callback.
+ *
+ * For both RX and TX, the stream callback receives:
+ *  - dev:          Device structure
+ *  - stream:       The associated stream
+ *  - metadata:     For RX streams using a format with metadata (e.g.,
+ *                  ::BLADERF_FORMAT_SC16_Q11_META), this describes the
+ *                  buffer. Its `timestamp` is that of the first message, its
+ *                  `flags` are the header flags of all of the buffer's
+ *                  messages ORed together, `actual_count` is the number of
+ *                  samples following the headers, and `channel_mask` and
+ *                  `channel` are taken from the first message. FPGA RX FIFO
+ *                  overflows are reported via `status` and
+ *                  `fpga_dropped_samples`, whose count is left out of
+ *                  `flags`. Otherwise, it is zeroed. It should not be modified, and is only valid
+ *                  during the callback.
+ *  - user_data:    User data provided when initializing stream
+ *
+ * For TX callbacks:
+ *  - samples:      Pointer to buffer of samples that was sent
+ *  - num_samples:  Number of sent in last transfer and to send in next transfer
+ *  - Return value: The user specifies the address of the next buffer to send,
+ *                  BLADERF_STREAM_SHUTDOWN, or BLADERF_STREAM_NO_DATA.
+ *
+ * For RX callbacks:
+ *  - samples:          Buffer filled with received data
+ *  - num_samples:      Number of samples received and size of next buffers
+ *  - Return value:     The user specifies the next buffer to fill with RX data,
+ *                      which should be `num_samples` in size,
+ *                      BLADERF_STREAM_SHUTDOWN, or BLADERF_STREAM_NO_DATA.
+ *
+ */
+typedef void *(*bladerf_stream_cb)(struct bladerf *dev,
+                                   struct bladerf_stream *stream,
+                                   struct bladerf_metadata *meta,
+                                   void *samples,
+                                   size_t num_samples,
+                                   void *user_data);
+
+/**
+ * Initialize a stream for use with asynchronous routines.
+ *
+ * This function will internally allocate data buffers, which will be provided
+ * to the API user in callback functions.
+ *
+ * The `buffers` output parameter populates a pointer to the list of allocated
+ * buffers. This allows the API user to implement a buffer management scheme to
+ * best suit his or her specific use case.
+ *
+ * Generally, one will want to set the `buffers` parameter to a value larger
+ * than the `num_transfers` parameter, and keep track of which buffers are
+ * currently "in-flight", versus those available for use.
+ *
+ * For example, for a transmit stream, modulated data can be actively written
+ * into free buffers while transfers of other buffers are occurring. Once a
+ * buffer has been filled with data, it can be marked 'in-flight' and be
+ * returned in a successive callback to transmit.
+ *
+ * The choice of values for the `num_transfers` and `buffer_size` should be
+ * made based upon the desired samplerate, and the stream timeout value
+ * specified via bladerf_set_stream_timeout(), which defaults to 1 second.
+ *
+ * For a given sample rate, the below relationship must be upheld to transmit or
+ * receive data without timeouts or dropped data.
+ *
+ * @f[
+ * Sample\ Rate > \frac{\#\ Transfers}{Timeout} \times Buffer\ Size
+ * @f]
+ *
+ * ...where Sample Rate is in samples per second, and Timeout is in seconds.
+ *
+ * To account for general system overhead, it is recommended to multiply the
+ * righthand side by 1.1 to 1.25.
+ *
+ * While increasing the number of buffers available provides additional
+ * elasticity, be aware that it also increases latency.
+ *
+ * @param[out]  stream          Upon success, this will be updated to contain
+ *                              a stream handle (i.e., address)
+ *
+ * @param[in]   dev             Device to associate with the stream
+ *
+ * @param[in]   callback        Callback routine to handle asynchronous events
+ *
+ * @param[out]  buffers         This will be updated to point to a dynamically
+ *                              allocated array of buffer pointers.
+ *
+ * @param[in]   num_buffers     Number of buffers to allocate and return. This
+ *                              value must >= the `num_transfers` parameter.
+ *
+ * @param[in]   format          Sample data format
+ *
+ * @param[in]   samples_per_buffer  Size of allocated buffers, in units of
+ *                                  samples Note that the physical size of the
+ *                                  buffer is a function of this and the format
+ *                                  parameter.
+ *
+ * @param[in]   num_transfers   Maximum number of transfers that may be
+ *                              in-flight simultaneously. This must be <= the
+ *                              `num_buffers` parameter.
+ *
+ * @param[in]   user_data       Caller-provided data that will be provided
+ *                              in stream callbacks
+ *
+ *
+ * @note  This call should be later followed by a call to
+ *        bladerf_deinit_stream() to avoid memory leaks.
+ *
+ * @return 0 on success,
+ *          value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_init_stream(struct bladerf_stream **stream,
+                                  struct bladerf *dev,
+                                  bladerf_stream_cb callback,
+                                  void ***buffers,
+                                  size_t num_buffers,
+                                  bladerf_format format,
+                                  size_t samples_per_buffer,
+                                  size_t num_transfers,
+                                  void *user_data);
+
+/**
+ * Initialize a stream for use with asynchronous routines, using buffers
+ * provided by the caller.
+ *
+ * This behaves like bladerf_init_stream(), except that no sample buffers are
+ * allocated; the provided buffers are handed to the stream callback and
+ * submitted to the device instead. This allows samples to be streamed
+ * directly to or from memory that is owned by the caller, such as a ring in
+ * shared memory.
+ *
+ * Each buffer must be large enough to hold `samples_per_buffer` samples in the
+ * specified format, and must remain valid until bladerf_deinit_stream() has
+ * returned. Buffers are not freed by libbladeRF. Page-aligned buffers are
+ * recommended for best performance.
+ *
+ * The flags set via bladerf_set_stream_buffer_flags() do not apply to these
+ * buffers. In particular, backends generally cannot perform zero-copy
+ * transfers from arbitrary memory; use bladerf_init_stream() with
+ * ::BLADERF_STREAM_BUFFERS_DEVICE_MEM when that is required.
+ *
+ * @param[out]  stream          Upon success, this will be updated to contain
+ *                              a stream handle (i.e., address)
+ *
+ * @param[in]   dev             Device to associate with the stream
+ *
+ * @param[in]   callback        Callback routine to handle asynchronous events
+ *
+ * @param[in]   buffers         Array of `num_buffers` buffer pointers. This
+ *                              array is copied, and need not persist after
+ *                              this call.
+ *
+ * @param[in]   num_buffers     Number of buffers provided. This value must be
+ *                              >= the `num_transfers` parameter.
+ *
+ * @param[in]   format          Sample data format
+ *
+ * @param[in]   samples_per_buffer  Size of each buffer, in units of samples
+ *
+ * @param[in]   num_transfers   Maximum number of transfers that may be
+ *                              in-flight simultaneously. This must be <= the
+ *                              `num_buffers` parameter.
+ *
+ * @param[in]   user_data       Caller-provided data that will be provided
+ *                              in stream callbacks
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if `buffers` is NULL or contains a NULL or
+ *         misaligned buffer,
+ *         value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_init_stream_with_buffers(struct bladerf_stream **stream,
+                                               struct bladerf *dev,
+                                               bladerf_stream_cb callback,
+                                               void **buffers,
+                                               size_t num_buffers,
+                                               bladerf_format format,
+                                               size_t samples_per_buffer,
+                                               size_t num_transfers,
+                                               void *user_data);
+
+/**
+ * Begin running a stream. This call will block until the steam completes.
+ *
+ * Only 1 RX stream and 1 TX stream may be running at a time. Attempting to
+ * call bladerf_stream() with more than one stream per module will yield
+ * unexpected (and most likely undesirable) results. See the ::bladerf_stream_cb
+ * description for additional thread-safety caveats.
+ *
+ * @pre This function should be preceded by a call to bladerf_enable_module()
+ *      to enable the associated RX or TX module before attempting to use
+ *      it to stream data.
+ *
+ * @param   stream  A stream handle that has been successfully been initialized
+ *                  via bladerf_init_stream()
+ *
+ * @param   module  Module to perform streaming with
+ *
+ * @return  0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_stream(struct bladerf_stream *stream,
+                             bladerf_module module);
+
+/**
+ * Submit a buffer to a stream from outside of a stream callback function.
+ * Use this only when returning BLADERF_STREAM_NO_DATA from callbacks. <b>Do
+ * not</b> use this function if the associated callback functions will be
+ * returning buffers for submission.
+ *
+ * This call may block if the device is not ready to submit a buffer for
+ * transfer. Use the `timeout_ms` to place an upper limit on the time this
+ * function can block.
+ *
+ * To safely submit buffers from outside the stream callback flow, this function
+ * internally acquires a per-stream lock (the same one that may be held during
+ * the execution of a stream callback; see ::bladerf_stream_cb). Therefore, it is important to be aware of
+ * locks that may be held while making this call, especially those acquired
+ * during execution of the associated stream callback function. (i.e., be wary
+ * of the order of lock acquisitions, including the internal per-stream lock.)
+ *
+ * @param   stream      Stream to submit buffer to
+ * @param   buffer      Buffer to fill (RX) or containing data (TX). This buffer
+ *                      is assumed to be the size specified in the associated
+ *                      bladerf_init_stream() call.
+ * @param   timeout_ms  Milliseconds to timeout in, if this call blocks. 0
+ *                      implies an "infinite" wait.
+ *
+ * @return  0 on success, BLADERF_ERR_TIMEOUT upon a timeout, or a value from
+ * \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_submit_stream_buffer(struct bladerf_stream *stream,
+                                           void *buffer,
+                                           unsigned int timeout_ms);
+
+/**
+ * Submit multiple buffers to a stream from outside of a stream callback
+ * function.
+ *
+ * This is equivalent to calling bladerf_submit_stream_buffer() for each of the
+ * provided buffers, in order, but acquires the per-stream lock only once and
+ * submits the buffers back-to-back. The same restrictions and caveats apply.
+ *
+ * @param[in]   stream          Stream to submit buffers to
+ * @param[in]   buffers         Array of `num_buffers` buffers. These may not
+ *                              be BLADERF_STREAM_SHUTDOWN or
+ *                              BLADERF_STREAM_NO_DATA.
+ * @param[in]   num_buffers     Number of buffers to submit
+ * @param[out]  num_submitted   If non-NULL, updated with the number of
+ *                              buffers that were submitted. On failure, the
+ *                              caller retains ownership of the remaining
+ *                              buffers.
+ * @param[in]   timeout_ms      Milliseconds to timeout in, if this call blocks
+ *                              waiting for each buffer to be submitted. 0
+ *                              implies an "infinite" wait.
+ *
+ * @return  0 on success, BLADERF_ERR_TIMEOUT upon a timeout, or a value from
+ * \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_submit_stream_buffers(struct bladerf_stream *stream,
+                                            void **buffers,
+                                            unsigned int num_buffers,
+                                            unsigned int *num_submitted,
+                                            unsigned int timeout_ms);
+
+/**
+ * Deinitialize and deallocate stream resources.
+ *
+ * @pre    Stream is no longer being used (via bladerf_submit_stream_buffer() or
+ *          bladerf_stream() calls.)
+ * @post   Stream is deallocated and may no longer be used.
+ *
+ * @param   stream      Stream to deinitialize. This function does nothing
+ *                      if stream is NULL.
+ */
+API_EXPORT
+void CALL_CONV bladerf_deinit_stream(struct bladerf_stream *stream);
+
+/**
+ * Metadata of a single message within an RX stream buffer, as provided by
+ * bladerf_get_stream_msg_index()
+ */
+struct bladerf_stream_msg {
+    uint64_t timestamp;     /**< Timestamp of the message's first sample */
+    uint32_t flags;         /**< Flags from the message's header */
+
+    /**
+     * Index of the message's first sample within the buffer, counted in
+     * samples from the start of the buffer (and therefore just past the
+     * message's header)
+     */
+    uint32_t offset;
+};
+
+/**
+ * Enable or disable the per-message metadata index of an RX stream using a
+ * format with metadata. This must be called before bladerf_stream().
+ *
+ * The index costs a pass over each buffer's message headers, so it is
+ * disabled by default.
+ *
+ * @param   stream      Stream to configure
+ * @param   enable      Set true to build the index for each buffer
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if the stream's format does not
+ *         carry metadata, BLADERF_ERR_MEM if the index could not be
+ *         allocated, or value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_stream_msg_index(struct bladerf_stream *stream,
+                                           bool enable);
+
+/**
+ * Get the metadata index of the buffer passed to the current RX callback.
+ *
+ * This may only be called from within the stream's callback, and the index
+ * is only valid until the callback returns.
+ *
+ * @param[in]   stream      Stream whose callback is executing
+ * @param[out]  msgs        Updated to point to the buffer's messages
+ * @param[out]  num_msgs    Updated with the number of messages in the buffer
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if the index has not been
+ *         enabled via bladerf_set_stream_msg_index()
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_stream_msg_index(struct bladerf_stream *stream,
+                                   const struct bladerf_stream_msg **msgs,
+                                   unsigned int *num_msgs);
+
+/**
+ * A completed stream buffer, as provided to a ::bladerf_stream_batch_cb
+ */
+struct bladerf_stream_completion {
+    void *samples;          /**< Buffer that was sent or filled */
+    size_t num_samples;     /**< Number of samples in the buffer */
+
+    /**
+     * Metadata describing the buffer, as the `metadata` argument of a
+     * ::bladerf_stream_cb would
+     */
+    struct bladerf_metadata meta;
+};
+
+/**
+ * Batch stream callback, which is provided several completed buffers at once
+ * in place of a ::bladerf_stream_cb call for each of them.
+ *
+ * The same constraints as those of ::bladerf_stream_cb apply.
+ *
+ *  - completed:    Completed buffers, in the order they completed. These
+ *                  entries are only valid during the callback.
+ *  - count:        Number of entries in `completed` (at least 1)
+ *  - next:         Array of `count` entries that the callback fills in with
+ *                  the buffers to submit next, in order, as the return value
+ *                  of a ::bladerf_stream_cb. Each entry is initialized to
+ *                  BLADERF_STREAM_NO_DATA, and entries following one set to
+ *                  BLADERF_STREAM_SHUTDOWN are ignored.
+ *  - user_data:    User data provided when initializing stream
+ */
+typedef void (*bladerf_stream_batch_cb)(
+                            struct bladerf *dev,
+                            struct bladerf_stream *stream,
+                            const struct bladerf_stream_completion *completed,
+                            unsigned int count,
+                            void **next,
+                            void *user_data);
+
+/**
+ * Deliver a stream's completed buffers to a batch callback, rather than to
+ * the stream's ::bladerf_stream_cb one buffer at a time. This must be called
+ * before bladerf_stream().
+ *
+ * At high sample rates with small buffers, the overhead of a callback per
+ * buffer can dominate. With a batch callback, completions are collected
+ * until `max_batch` buffers have completed, or until no other transfers
+ * remain in flight, so the callback is never held off waiting for buffers
+ * that cannot yet complete. Buffers returned by the callback are submitted
+ * once it returns.
+ *
+ * The stream's ::bladerf_stream_cb is still used to obtain the initial TX
+ * buffers at the start of bladerf_stream(). When the message index is
+ * enabled via bladerf_set_stream_msg_index(), it describes the last buffer
+ * of each batch.
+ *
+ * @param   stream      Stream to configure
+ * @param   callback    Batch callback, or NULL to revert to per-buffer
+ *                      callbacks
+ * @param   max_batch   Maximum number of buffers per callback. This is
+ *                      limited to the stream's number of buffers.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if `max_batch` is 0,
+ *         BLADERF_ERR_UNSUPPORTED if the device's backend does not support
+ *         batch callbacks, or value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_stream_batch_callback(
+                                        struct bladerf_stream *stream,
+                                        bladerf_stream_batch_cb callback,
+                                        unsigned int max_batch);
+
+/**
+ * Set stream transfer timeout in milliseconds
+ *
+ * @param   dev         Device handle
+ * @param   module      Module to adjust
+ * @param   timeout     Timeout in milliseconds
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_stream_timeout(struct bladerf *dev,
+                                         bladerf_module module,
+                                         unsigned int timeout);
+
+
+/**
+ * Get transfer timeout in milliseconds
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to adjust
+ * @param[out]  timeout     On success, updated with current transfer
+ *                          timeout value. Undefined on failure.
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_stream_timeout(struct bladerf *dev,
+                                         bladerf_module module,
+                                         unsigned int *timeout);
+
+/**
+ * Scheduling policies for threads executing streams
+ */
+typedef enum {
+    BLADERF_SCHED_DEFAULT = 0,  /**< Leave the thread's scheduling policy and
+                                 *   priority unchanged */
+    BLADERF_SCHED_FIFO,         /**< Real-time, first-in first-out policy
+                                 *   (SCHED_FIFO) */
+    BLADERF_SCHED_RR,           /**< Real-time, round-robin policy
+                                 *   (SCHED_RR) */
+} bladerf_sched_policy;
+
+/**
+ * Scheduling options for the thread executing a stream.
+ *
+ * These are applied to the synchronous interface's internal worker thread,
+ * and to the thread calling bladerf_stream() for the duration of that call.
+ *
+ * Real-time policies generally require elevated privileges (e.g.,
+ * CAP_SYS_NICE or an appropriate RLIMIT_RTPRIO on Linux). If an option cannot
+ * be applied, a warning is logged and the stream proceeds without it.
+ *
+ * On Windows, the real-time policies map to THREAD_PRIORITY_TIME_CRITICAL and
+ * the priority value is ignored. CPU affinity is not supported on OSX, and
+ * memory locking is not supported on Windows.
+ */
+struct bladerf_stream_thread_config {
+    /** Scheduling policy */
+    bladerf_sched_policy policy;
+
+    /**
+     * Priority within the real-time policy. The valid range is
+     * OS-specific; it is 1 to 99 on Linux. This is ignored for
+     * ::BLADERF_SCHED_DEFAULT.
+     */
+    int priority;
+
+    /**
+     * Bitmask of the CPUs (0 through 63) the thread may execute on. A value
+     * of 0 leaves the thread's CPU affinity unchanged.
+     */
+    uint64_t cpu_affinity;
+
+    /**
+     * Lock all current and future memory pages of the process into RAM
+     * (i.e., mlockall()) when the stream starts, to avoid page faults in the
+     * data path. Note that this affects the entire process.
+     */
+    bool lock_memory;
+
+    /**
+     * Busy-poll for buffers and transfer completions, rather than blocking
+     * and being woken by the stream's threads. This trades CPU time for
+     * lower and more consistent latency.
+     *
+     * Synchronous interface calls spin until a buffer is available or their
+     * timeout elapses, and the libusb backend's event thread polls for
+     * completions without blocking while the stream runs. Each of these
+     * fully occupies a CPU, so this should be combined with `cpu_affinity`
+     * to dedicate cores to them. The other backends block for completions
+     * as usual.
+     *
+     * The cost of this may be measured via the `spin_waits`,
+     * `blocking_waits`, `wait_hist`, `event_polls` and `event_cpu_us`
+     * fields of bladerf_get_stream_stats().
+     */
+    bool busy_poll;
+
+    /**
+     * By default, on Linux hosts with multiple NUMA nodes, stream buffers
+     * are allocated on the NUMA node of the device's USB host controller,
+     * and the stream's threads are pinned to that node's CPUs unless a
+     * `cpu_affinity` is given. Setting this disables that placement.
+     *
+     * The placement is reported by the `numa_node`, `numa_buffers` and
+     * `thread_cpus` fields of bladerf_get_stream_stats().
+     */
+    bool ignore_numa;
+};
+
+/**
+ * Configure the scheduling options of threads executing streams for the
+ * specified module.
+ *
+ * These take effect for streams subsequently configured via
+ * bladerf_sync_config() or bladerf_init_stream().
+ *
+ * @param   dev         Device handle
+ * @param   module      Module to configure
+ * @param   config      Thread configuration. NULL restores the defaults,
+ *                      which leave threads unchanged.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on invalid parameters, or a value
+ *         from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_stream_thread_config(
+                            struct bladerf *dev,
+                            bladerf_module module,
+                            const struct bladerf_stream_thread_config *config);
+
+/**
+ * Retrieve the scheduling options of threads executing streams for the
+ * specified module.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to query
+ * @param[out]  config      Updated with the current configuration on success
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_stream_thread_config(
+                            struct bladerf *dev,
+                            bladerf_module module,
+                            struct bladerf_stream_thread_config *config);
+
+/**
+ * @defgroup STREAM_BUFFER_FLAGS Stream buffer allocation flags
+ *
+ * The sample buffers of a stream are always allocated as a single, contiguous
+ * and page-aligned region of memory. These flags request additional
+ * properties of that region. Each is best-effort; if a request cannot be
+ * satisfied, a message is logged and the stream falls back to a regular
+ * allocation.
+ *
+ * @{
+ */
+
+/**
+ * Back the buffers with huge pages (Linux only), reducing TLB pressure. This
+ * generally requires huge pages to have been reserved via
+ * /proc/sys/vm/nr_hugepages.
+ */
+#define BLADERF_STREAM_BUFFERS_HUGEPAGES    (1 << 0)
+
+/**
+ * Lock the buffers into RAM, such that accessing them never incurs a page
+ * fault. This generally requires an appropriate RLIMIT_MEMLOCK.
+ */
+#define BLADERF_STREAM_BUFFERS_LOCKED       (1 << 1)
+
+/**
+ * Allocate the buffers from memory the USB driver can DMA to and from
+ * directly, avoiding copies into kernel bounce buffers. This is only
+ * supported by recent versions of libusb on Linux (libusb_dev_mem_alloc()).
+ * When used, ::BLADERF_STREAM_BUFFERS_HUGEPAGES is ignored.
+ */
+#define BLADERF_STREAM_BUFFERS_DEVICE_MEM   (1 << 2)
+
+/** @} (End of STREAM_BUFFER_FLAGS) */
+
+/**
+ * Select how the sample buffers of streams are allocated.
+ *
+ * These take effect for streams subsequently configured via
+ * bladerf_sync_config(), bladerf_sync_resize(), or bladerf_init_stream().
+ *
+ * @param   dev         Device handle
+ * @param   flags       Bitmask of \ref STREAM_BUFFER_FLAGS values. 0 selects
+ *                      the default allocation.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on unknown flags
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_stream_buffer_flags(struct bladerf *dev,
+                                              uint32_t flags);
+
+/**
+ * Retrieve the flags used to allocate stream buffers
+ *
+ * @param[in]   dev         Device handle
+ * @param[out]  flags       Updated with the current \ref STREAM_BUFFER_FLAGS
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_stream_buffer_flags(struct bladerf *dev,
+                                              uint32_t *flags);
+
+/**
+ * Allow the backend to cover multiple stream buffers with a single USB
+ * transfer, reducing per-transfer overhead when using small buffers at high
+ * sample rates.
+ *
+ * Buffers are only combined when they are submitted consecutively and are
+ * adjacent in memory, which is the case for buffers allocated by
+ * bladerf_init_stream() and bladerf_sync_config() that are used in order.
+ * Stream callbacks are still executed once per buffer, and the number of
+ * buffers in flight is still limited by the `num_transfers` stream parameter.
+ *
+ * This currently only affects the libusb backend, and takes effect for
+ * streams subsequently configured via bladerf_sync_config() or
+ * bladerf_init_stream().
+ *
+ * @param   dev                     Device handle
+ * @param   module                  Module to configure
+ * @param   buffers_per_transfer    Maximum number of buffers per transfer.
+ *                                  0 or 1 selects the default of one buffer
+ *                                  per transfer.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on an invalid module
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_stream_buffers_per_transfer(
+                                    struct bladerf *dev,
+                                    bladerf_module module,
+                                    unsigned int buffers_per_transfer);
+
+/**
+ * Retrieve the maximum number of stream buffers covered by a single transfer
+ *
+ * @param[in]   dev                     Device handle
+ * @param[in]   module                  Module to query
+ * @param[out]  buffers_per_transfer    Updated with the current setting
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on an invalid module
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_stream_buffers_per_transfer(
+                                    struct bladerf *dev,
+                                    bladerf_module module,
+                                    unsigned int *buffers_per_transfer);
+
+/** @} (End of FN_DATA_ASYNC) */
+
+/**
+ * @defgroup FN_DATA_SYNC  Synchronous data transmission and reception
+ *
+ * This group of functions presents synchronous, blocking calls (with optional
+ * timeouts) for transmitting and receiving samples.
+ *
+ * The synchronous interface is built atop the asynchronous interface, and is
+ * generally less complex and easier to work with.  It alleviates the need to
+ * explicitly spawn threads (it is done under the hood) and manually manage
+ * sample buffers.
+ *
+ * Under the hood, this interface spawns worker threads to handle an
+ * asynchronous stream and perform thread-safe buffer management.
+ *
+ * These functions are thread-safe. The RX and TX instances of this interface
+ * are independent, so one module may be configured, resized, or have its
+ * stream timeout changed while the other is streaming.
+ *
+ * <H3>RX and TX without metadata </H3>
+ * Below is the general process for using this interface to transmit and receive
+ * SC16 Q11 samples, without metadata.
+ *
+ * @snippet sync_rxtx.c example_snippet
+ *
+ * To run in a half-duplex mode of operation, simply remove the RX or TX
+ * specific portions from the above example.
+ *
+ *
+ * <H3>RX with metadata</H3>
+ * By using the ::BLADERF_FORMAT_SC16_Q11_META format with the synchronous
+ * interface, one can read the timestamp associated with a received buffer of
+ * data, or schedule to read a specific number of samples at a desired
+ * timestamp.  Additionally, the metadata indicates if an overrun was detected,
+ * and the number of samples actually copied into the buffer before the
+ * discontinuity caused by the overrun.
+ *
+ * @snippet sync_rx_meta.c example_snippet
+ *
+ * <H3>TX with metadata</H3>
+ * Using the synchronous interface with the ::BLADERF_FORMAT_SC16_Q11_META
+ * format allows for bursts of samples to be scheduled for transmissions.
+ * Between these bursts, the device transmits I=0, Q=0.
+ *
+ * To begin a burst, call bladerf_sync_tx() with the metadata's
+ * ::BLADERF_META_FLAG_TX_BURST_START flag set, the desired timestamp set in the
+ * bladerf_metadata structure, and any number of samples.
+ *
+ * You may then continue calling bladerf_sync_tx(), without needing to update
+ * the timestamp field in the bladerf_metadata structure. For these calls,
+ * no flags should be set.
+ *
+ * On the final bladerf_sync_tx() call for the burst, set the
+ * ::BLADERF_META_FLAG_TX_BURST_END flag, and ensure the final two samples
+ * provided to this function are 0.
+ *
+ * It is valid to send the entire burst with a single function call, with both
+ * flags set.
+ *
+ * @snippet sync_tx_meta.c example_snippet
+ *
+ * @{
+ */
+
+/**
+ * (Re)Configure a device for synchronous transmission or reception
+ *
+ * This function sets up the device for the specified format and initializes
+ * the underlying asynchronous stream parameters
+ *
+ * This function does not call bladerf_enable_module(). The API user is
+ * responsible for enabling/disable modules when desired.
+ *
+ * Note that (re)configuring ::BLADERF_MODULE_TX does not affect the
+ * ::BLADERF_MODULE_RX modules, and vice versa. This call configures each module
+ * independently.
+ *
+ * Memory allocated by this function will be deallocated when bladerf_close()
+ * is called.
+ *
+ * See the bladerf_init_stream() documentation for information on determining
+ * appropriate values for `buffers_size`, `num_transfers`, and `stream_timeout`.
+ * The `num_buffers` parameter should generally be increased as the amount of
+ * work done between bladerf_sync_rx() or bladerf_sync_tx() calls increases.
+ *
+ * @param   dev             Device to configure
+ *
+ * @param   module          Module to use with synchronous interface
+ *
+ * @param   format          Format to use in synchronous data transfers
+ *
+ * @param   num_buffers     The number of buffers to use in the underlying
+ *                          data stream. This must be greater than the
+ *                          `num_xfers` parameter.
+ *
+ * @param   buffer_size     The size of the underlying stream buffers, in
+ *                          samples. This value must be a multiple of 1024.
+ *                          Note that samples are only transferred when a buffer
+ *                          of this size is filled.
+ *
+ * @param   num_transfers   The number of active USB transfers that may be
+ *                          in-flight at any given time. If unsure of what
+ *                          to use here, try values of 4, 8, or 16.
+ *
+ * @param   stream_timeout  Timeout (milliseconds) for transfers in the
+ *                          underlying data stream.
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_UNSUPPORTED if libbladeRF is not built with support
+ *         for this functionality,
+ *         or a value from \ref RETCODES list on failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_config(struct bladerf *dev,
+                                  bladerf_module module,
+                                  bladerf_format format,
+                                  unsigned int num_buffers,
+                                  unsigned int buffer_size,
+                                  unsigned int num_transfers,
+                                  unsigned int stream_timeout);
+
+struct bladerf_bandwidth_probe_results;
+
+/**
+ * Synchronous interface configuration chosen by bladerf_sync_config_auto()
+ */
+struct bladerf_sync_auto_config {
+    unsigned int num_buffers;       /**< Number of buffers */
+    unsigned int buffer_size;       /**< Size of each buffer, in samples */
+    unsigned int num_transfers;     /**< Number of in-flight transfers */
+    unsigned int stream_timeout;    /**< Stream timeout, in milliseconds */
+
+    /**
+     * Estimated latency introduced by the buffering, in microseconds. For
+     * RX, this assumes samples are read as soon as they are available. This
+     * exceeds the requested latency if no configuration can meet it.
+     */
+    unsigned int latency_us;
+
+    /**
+     * Time covered by the samples of the in-flight transfers, in
+     * microseconds. This is how long the host may be late in servicing the
+     * stream before an RX overrun or TX underrun occurs.
+     */
+    unsigned int margin_us;
+};
+
+/**
+ * Configure a module's synchronous interface, as per bladerf_sync_config(),
+ * with buffering derived from a sample rate and a latency budget.
+ *
+ * The largest buffers that fit within `latency_us` are used, as these incur
+ * the least per-transfer overhead, with enough transfers in flight to ride
+ * out scheduling delays on the host. The required margin depends upon the
+ * USB speed the device is connected at, and is increased to cover the latency
+ * jitter measured by bladerf_bandwidth_probe(), if its results are provided.
+ *
+ * If `sample_rate` exceeds the throughput expected of the USB connection (or
+ * measured by the probe), or the budget is too small to keep a reasonable
+ * margin in flight, a warning is logged and the closest configuration is
+ * used. The `latency_us` and `margin_us` fields of `config` indicate what was
+ * achieved.
+ *
+ * @param[in]   dev             Device to configure
+ * @param[in]   module          Module to configure
+ * @param[in]   format          Format to use in synchronous data transfers
+ * @param[in]   sample_rate     Sample rate the module will be streamed at,
+ *                              or 0 to use its current sample rate
+ * @param[in]   latency_us      Latency budget, in microseconds
+ * @param[in]   probe           Results of bladerf_bandwidth_probe(), or NULL
+ * @param[out]  config          Updated with the chosen configuration on
+ *                              success. May be NULL.
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if `latency_us` is 0 or `format` is not supported
+ *         by the synchronous interface,
+ *         or a value from \ref RETCODES list on other failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_config_auto(
+                        struct bladerf *dev,
+                        bladerf_module module,
+                        bladerf_format format,
+                        unsigned int sample_rate,
+                        unsigned int latency_us,
+                        const struct bladerf_bandwidth_probe_results *probe,
+                        struct bladerf_sync_auto_config *config);
+
+/**
+ * Change the buffering used by an already-configured synchronous interface
+ *
+ * Unlike calling bladerf_sync_config() again, this does not touch the
+ * module's format configuration, and does not require the module to be
+ * disabled and re-enabled. The format, stream timeout, and accumulated
+ * statistics (see bladerf_get_stream_stats()) are retained.
+ *
+ * This may be used while a module is streaming, to grow buffering when the
+ * host is under load, or shrink it to reduce latency. The underlying stream
+ * is stopped and restarted with the new buffers, so any samples buffered at
+ * the time of this call are discarded. For RX, the next bladerf_sync_rx() call
+ * using ::BLADERF_FORMAT_SC16_Q11_META will report the resulting discontinuity
+ * via ::BLADERF_META_STATUS_OVERRUN. For TX, any partially completed burst is
+ * lost; a new burst should be started after this call.
+ *
+ * The new buffers are allocated before the current ones are released, so
+ * memory for both is briefly required. Should this fail, the existing
+ * configuration remains in effect, and the stream is left as it was.
+ *
+ * This must not be called while samples obtained via bladerf_sync_rx_acquire()
+ * are outstanding.
+ *
+ * @param   dev             Device to reconfigure
+ *
+ * @param   module          Module whose synchronous interface to resize
+ *
+ * @param   num_buffers     See bladerf_sync_config()
+ *
+ * @param   buffer_size     See bladerf_sync_config()
+ *
+ * @param   num_transfers   See bladerf_sync_config()
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if the synchronous interface has not been
+ *         configured or the provided parameters are invalid,
+ *         BLADERF_ERR_MEM if the new buffers could not be allocated,
+ *         or a value from \ref RETCODES list on other failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_resize(struct bladerf *dev,
+                                  bladerf_module module,
+                                  unsigned int num_buffers,
+                                  unsigned int buffer_size,
+                                  unsigned int num_transfers);
+
+/**
+ * Enable or disable automatic tuning of the number of in-flight transfers
+ * used by a module's synchronous interface.
+ *
+ * When enabled, the interval between transfer completions is measured. If
+ * completion jitter or overruns suggest that more transfers are needed to
+ * keep the device serviced, more are put in flight; otherwise the number is
+ * gradually reduced to keep latency low. The `num_transfers` value provided
+ * to bladerf_sync_config() or bladerf_sync_resize() is the upper bound.
+ *
+ * This takes effect the next time the module's underlying stream is started,
+ * and persists across calls to bladerf_sync_resize().
+ *
+ * @param   dev                 Device handle
+ *
+ * @param   module              Module to configure
+ *
+ * @param   enable              Set to true to enable automatic tuning
+ *
+ * @param   min_transfers       Minimum number of transfers to keep in flight.
+ *                              Must be between 1 and the configured
+ *                              `num_transfers` when enabling.
+ *
+ * @param   latency_budget_us   Upper bound, in microseconds, on the latency
+ *                              introduced by buffered and in-flight
+ *                              transfers. 0 disables this limit.
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if the synchronous interface has not been
+ *         configured or the provided parameters are invalid,
+ *         or a value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_autotune(struct bladerf *dev,
+                                    bladerf_module module,
+                                    bool enable,
+                                    unsigned int min_transfers,
+                                    unsigned int latency_budget_us);
+
+/**
+ * Called by the RX timestamp continuity checker when the timestamp of a
+ * received message does not immediately follow that of the previous message.
+ *
+ * This is invoked from within bladerf_sync_rx() or bladerf_sync_rx_acquire(),
+ * in the caller's thread, while the RX synchronous interface is locked.
+ * Therefore, it must not call any RX synchronous interface functions. It
+ * should return quickly, as samples are not being consumed while it executes.
+ *
+ * @param   dev         Device handle
+ * @param   expected    Timestamp that was expected
+ * @param   actual      Timestamp that was received. When this is greater than
+ *                      `expected`, the difference is the number of samples
+ *                      that were dropped.
+ * @param   user_data   Data provided to bladerf_sync_continuity_check()
+ */
+typedef void (*bladerf_discontinuity_cb)(struct bladerf *dev,
+                                         uint64_t expected,
+                                         uint64_t actual,
+                                         void *user_data);
+
+/**
+ * Enable or disable checking the continuity of RX timestamps within the
+ * synchronous interface.
+ *
+ * When enabled, the timestamp of each message received using the
+ * ::BLADERF_FORMAT_SC16_Q11_META format is compared against the timestamp
+ * expected to follow the previous message. Each mismatch is counted in the
+ * `discontinuities` and `dropped_samples` fields of the bladerf_stream_stats
+ * structure (see bladerf_get_stream_stats()), and is passed to the provided
+ * callback.
+ *
+ * Unlike ::BLADERF_META_STATUS_OVERRUN, this reports every gap in the received
+ * stream, regardless of how the caller reads samples. Discontinuities
+ * resulting from the caller disabling and re-enabling the module, or from
+ * calling bladerf_sync_config(), are not reported. The expected timestamp is
+ * retained across bladerf_sync_resize(), so samples discarded by a resize are
+ * reported.
+ *
+ * This costs a single comparison per message, and persists across calls to
+ * bladerf_sync_resize(). Buffers that bladerf_sync_rx() discards while seeking
+ * to a future timestamp are checked only at their first and last messages, so
+ * any gaps within such a buffer are counted as a single discontinuity.
+ *
+ * @pre The RX module's synchronous interface must have been configured, via
+ *      bladerf_sync_config(), with the ::BLADERF_FORMAT_SC16_Q11_META format.
+ *
+ * @param   dev         Device handle
+ *
+ * @param   enable      Set to true to enable checking
+ *
+ * @param   cb          Function to call for each discontinuity.
+ *                      May be NULL if only the counters are of interest.
+ *
+ * @param   user_data   Passed to `cb`
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if the synchronous interface has not been
+ *         configured as described above,
+ *         or a value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_continuity_check(struct bladerf *dev,
+                                            bool enable,
+                                            bladerf_discontinuity_cb cb,
+                                            void *user_data);
+
+/**
+ * Called when the TX synchronous interface counts an underrun in the
+ * `underruns` field of the bladerf_stream_stats structure.
+ *
+ * This is invoked from the thread that services the underlying stream, while
+ * samples are not being transmitted. Therefore, it must return quickly and
+ * must not call any libbladeRF functions.
+ *
+ * @param   dev         Device handle
+ * @param   underruns   Number of underruns counted so far, including this one
+ * @param   user_data   Data provided to bladerf_sync_underrun_callback()
+ */
+typedef void (*bladerf_underrun_cb)(struct bladerf *dev,
+                                    uint64_t underruns,
+                                    void *user_data);
+
+/**
+ * Set a function to be called for each underrun of the TX synchronous
+ * interface.
+ *
+ * This persists across calls to bladerf_sync_resize().
+ *
+ * @pre The TX module's synchronous interface must have been configured, via
+ *      bladerf_sync_config().
+ *
+ * @param   dev         Device handle
+ *
+ * @param   cb          Function to call for each underrun, or NULL to
+ *                      disable notifications
+ *
+ * @param   user_data   Passed to `cb`
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if the synchronous interface has not been
+ *         configured,
+ *         or a value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_underrun_callback(struct bladerf *dev,
+                                             bladerf_underrun_cb cb,
+                                             void *user_data);
+
+/**
+ * Start a module's synchronous stream ahead of the first call to transmit or
+ * receive samples.
+ *
+ * Normally, the underlying stream is started by the first bladerf_sync_rx()
+ * or bladerf_sync_tx() call (or their acquire variants) following
+ * bladerf_sync_config(), so that call also pays for starting the worker
+ * thread and submitting the initial set of transfers. This function performs
+ * that work in advance, leaving the stream waiting for samples, so that the
+ * first call only waits for data.
+ *
+ * For the lowest latency to the first sample, call this after
+ * bladerf_sync_config() and before bladerf_enable_module(). Enabling the
+ * module is then the only remaining step before samples flow. For RX, any
+ * samples received between enabling the module and the first
+ * bladerf_sync_rx() call are buffered, as usual.
+ *
+ * This has no effect if the stream is already running. As with
+ * bladerf_sync_config(), disabling the module stops the stream, so this must
+ * be called again following the next bladerf_sync_config().
+ *
+ * @param   dev         Device handle
+ * @param   module      Module whose stream should be started
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if the module's synchronous interface has not
+ *         been configured,
+ *         or a value from \ref RETCODES list if the stream failed to start
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_arm(struct bladerf *dev, bladerf_module module);
+
+/**
+ * Transmit IQ samples.
+ *
+ * Under the hood, this call starts up an underlying asynchronous stream as
+ * needed. This stream can be stopped by disabling the TX module. (See
+ * bladerf_enable_module for more details.)
+ *
+ * Samples will only be sent to the FPGA when a buffer have been filled. The
+ * number of samples required to fill a buffer corresponds to the `buffer_size`
+ * parameter passed to bladerf_sync_config(). See bladerf_sync_tx_flush() and
+ * bladerf_sync_tx_autoflush() for submitting a partially filled buffer.
+ *
+ * @param[in]   dev         Device handle
+ *
+ * @param[in]   samples     Array of samples
+ *
+ * @param[in]   num_samples Number of samples to write
+ *
+ * @param[in]   metadata    Sample metadata. This must be provided when using
+ *                          the ::BLADERF_FORMAT_SC16_Q11_META format, but may
+ *                          be NULL when the interface is configured for
+ *                          the ::BLADERF_FORMAT_SC16_Q11 format.
+ *
+ * @param[in]   timeout_ms  Timeout (milliseconds) for this call to complete.
+ *                          Zero implies "infinite."
+ *
+ * @pre A bladerf_sync_config() call has been to configure the device for
+ *      synchronous data transfer.
+ *
+ * @pre A call to bladerf_enable_module() should be made before attempting to
+ *      transmit samples. Failing to do this may result in timeouts and other
+ *      errors.
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_UNSUPPORTED if libbladeRF is not built with support
+ *         for this functionality,
+ *         or a value from \ref RETCODES list on failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_tx(struct bladerf *dev,
+                              void *samples, unsigned int num_samples,
+                              struct bladerf_metadata *metadata,
+                              unsigned int timeout_ms);
+
+/**
+ * Obtain space within the synchronous interface's internal buffers to write
+ * TX samples into directly, avoiding an intermediate copy.
+ *
+ * The caller may write up to `num_samples` samples to the provided location,
+ * and must then call bladerf_sync_tx_commit() to indicate how many samples
+ * were written. Only one such region may be outstanding at a time, and
+ * bladerf_sync_tx() may not be called until it has been committed.
+ *
+ * When using the ::BLADERF_FORMAT_SC16_Q11 format, the remainder of the
+ * current buffer is provided. When using the ::BLADERF_FORMAT_SC16_Q11_META
+ * format, the remainder of the current message is provided, and the message's
+ * metadata header will have already been filled in. In this case, the
+ * ::BLADERF_META_FLAG_TX_BURST_START and ::BLADERF_META_FLAG_TX_NOW flags are
+ * processed exactly as they are by bladerf_sync_tx().
+ *
+ * @param[in]   dev         Device handle
+ *
+ * @param[out]  samples     Updated to point to the lent buffer space on
+ *                          success
+ *
+ * @param[out]  num_samples Updated with the number of samples that may be
+ *                          written to `samples`
+ *
+ * @param[in]   metadata    Sample metadata. This must be provided when using
+ *                          the ::BLADERF_FORMAT_SC16_Q11_META format, but may
+ *                          be NULL when the interface is configured for
+ *                          the ::BLADERF_FORMAT_SC16_Q11 format.
+ *
+ * @param[in]   timeout_ms  Timeout (milliseconds) for this call to complete.
+ *                          Zero implies "infinite."
+ *
+ * @pre A bladerf_sync_config() call has been to configure the device for
+ *      synchronous data transfer.
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if previously acquired space has not yet been
+ *         committed, BLADERF_ERR_UNSUPPORTED with the
+ *         ::BLADERF_FORMAT_SC16_Q11_PACKED, ::BLADERF_FORMAT_CF32 and
+ *         ::BLADERF_FORMAT_CF32_META formats,
+ *         or a value from \ref RETCODES list on failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_tx_acquire(struct bladerf *dev,
+                                      void **samples,
+                                      unsigned int *num_samples,
+                                      struct bladerf_metadata *metadata,
+                                      unsigned int timeout_ms);
+
+/**
+ * Commit samples written to the space provided by bladerf_sync_tx_acquire().
+ *
+ * Once the underlying buffer is full, it is submitted for transmission. When
+ * using the ::BLADERF_FORMAT_SC16_Q11_META format, the
+ * ::BLADERF_META_FLAG_TX_BURST_END flag may be specified to end the current
+ * burst, in which case the remainder of the current buffer is zeroed and
+ * submitted, as described for bladerf_sync_tx().
+ *
+ * The provided pointer must not be accessed after this call.
+ *
+ * @param[in]   dev         Device handle
+ *
+ * @param[in]   samples     Pointer provided by bladerf_sync_tx_acquire()
+ *
+ * @param[in]   num_samples Number of samples written. This may be less than,
+ *                          but not more than, the amount provided by
+ *                          bladerf_sync_tx_acquire().
+ *
+ * @param[in]   metadata    Sample metadata. This must be provided when using
+ *                          the ::BLADERF_FORMAT_SC16_Q11_META format, but may
+ *                          be NULL when the interface is configured for
+ *                          the ::BLADERF_FORMAT_SC16_Q11 format.
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if `samples` is not the outstanding acquired space,
+ *         or a value from \ref RETCODES list on failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_tx_commit(struct bladerf *dev,
+                                     void *samples, unsigned int num_samples,
+                                     struct bladerf_metadata *metadata);
+
+/**
+ * Zero the remainder of the TX synchronous interface's current buffer, and
+ * submit it for transmission, so that samples already written are not held
+ * until the buffer has been filled.
+ *
+ * When using the ::BLADERF_FORMAT_SC16_Q11_META format within a burst, the
+ * remainder of the current message is padded with zeros, and the burst's
+ * subsequent samples follow this padding. With FPGA v0.1.13 or later, the
+ * current message is instead ended early, so the timing of subsequent
+ * samples is unaffected. The burst remains active.
+ *
+ * This has no effect if no samples are waiting in a buffer.
+ *
+ * @param[in]   dev         Device handle
+ *
+ * @param[in]   timeout_ms  Timeout (milliseconds) for this call to complete.
+ *                          Zero implies "infinite."
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if the TX synchronous interface has not been
+ *         configured, or acquired space has not yet been committed,
+ *         or a value from \ref RETCODES list on failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_tx_flush(struct bladerf *dev,
+                                    unsigned int timeout_ms);
+
+/**
+ * Bound the time that samples may wait in a partially filled TX buffer.
+ *
+ * When enabled, bladerf_sync_tx() and bladerf_sync_tx_commit() flush the
+ * current buffer, as bladerf_sync_tx_flush() does, once samples have waited
+ * in it for at least `deadline_us`. The wait is timed from the end of the
+ * call that first left samples in the buffer, and is checked as each call
+ * returns. A deadline of 0 therefore submits a buffer at the end of every
+ * call.
+ *
+ * Buffers are not flushed between calls, as they are owned by the calling
+ * thread. Callers that may pause for longer than the deadline should call
+ * bladerf_sync_tx_flush() before doing so.
+ *
+ * This setting persists across calls to bladerf_sync_resize().
+ *
+ * @param[in]   dev         Device handle
+ *
+ * @param[in]   enable      Set to true to enable automatic flushing
+ *
+ * @param[in]   deadline_us Longest time (microseconds) that samples may
+ *                          wait in a partially filled buffer
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if the TX synchronous interface has not been
+ *         configured,
+ *         or a value from \ref RETCODES list on failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_tx_autoflush(struct bladerf *dev, bool enable,
+                                        unsigned int deadline_us);
+
+/**
+ * A burst of samples to be transmitted at a specific time, for use with
+ * bladerf_sync_tx_bursts()
+ */
+struct bladerf_tx_burst {
+    uint64_t timestamp;         /**< Timestamp of the first sample */
+    void *samples;              /**< Samples to transmit */
+    unsigned int num_samples;   /**< Number of samples in the burst */
+};
+
+/**
+ * Schedule multiple timestamped bursts for transmission in a single call.
+ *
+ * The bursts are sorted by timestamp and packed back-to-back into the
+ * underlying buffers, with zeros transmitted between them. Unlike sending
+ * each burst via bladerf_sync_tx() with the ::BLADERF_META_FLAG_TX_BURST_START
+ * and ::BLADERF_META_FLAG_TX_BURST_END flags, bursts share buffers, and only
+ * the final buffer is zero-padded and flushed. This is intended for
+ * applications that transmit many short bursts, such as TDMA schemes.
+ *
+ * Bursts need not be a multiple of any particular length. When the gap between
+ * bursts is longer than the remainder of the current message, the device
+ * remains idle (rather than transmitting zeros) until the next burst's
+ * timestamp. FPGA v0.1.13 and later transmit zeros while idle.
+ *
+ * As with bursts provided to bladerf_sync_tx(), the last two samples of each
+ * burst should be 0, unless FPGA v0.1.13 or later is in use.
+ *
+ * @param[in]       dev         Device handle
+ *
+ * @param[in,out]   bursts      Array of `num_bursts` bursts. This array is
+ *                              sorted by timestamp, in place.
+ *
+ * @param[in]       num_bursts  Number of bursts
+ *
+ * @param[in]       timeout_ms  Timeout (milliseconds) for each buffer to
+ *                              become available. Zero implies "infinite."
+ *
+ * @pre A bladerf_sync_config() call has been made to configure the device for
+ *      synchronous data transfer, using ::BLADERF_FORMAT_SC16_Q11_META.
+ *
+ * @pre A burst started via bladerf_sync_tx() must not be in progress.
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_TIME_PAST if the earliest burst is scheduled before
+ *         the end of previously transmitted samples,
+ *         BLADERF_ERR_INVAL if bursts overlap or parameters are invalid.
+ *         In both cases, no samples are written.
+ *         Otherwise, a value from \ref RETCODES list on failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_tx_bursts(struct bladerf *dev,
+                                     struct bladerf_tx_burst *bursts,
+                                     unsigned int num_bursts,
+                                     unsigned int timeout_ms);
+
+/**
+ * Number of waveform IDs available to bladerf_sync_tx_load_waveform()
+ */
+#define BLADERF_TX_WAVEFORMS                16
+
+/**
+ * Total number of samples that the FPGA's waveform memory can hold, shared
+ * by all loaded waveforms
+ */
+#define BLADERF_TX_WAVEFORM_MAX_SAMPLES     4096
+
+/**
+ * Load a waveform into the FPGA's waveform memory, for later transmission
+ * via bladerf_sync_tx_play_waveform(). This replaces any waveform previously
+ * loaded under the same ID.
+ *
+ * The waveform is carried to the FPGA in the TX sample stream, and takes
+ * effect in order with the samples and waveforms scheduled around it. As with
+ * other samples, it is not sent until its buffer is filled or flushed via
+ * bladerf_sync_tx_flush(). The device transmits zeros while the waveform is
+ * being written to memory.
+ *
+ * Waveforms remain loaded until the FPGA is reloaded or the device is closed.
+ *
+ * @param[in]   dev         Device handle
+ *
+ * @param[in]   id          Waveform ID, less than ::BLADERF_TX_WAVEFORMS
+ *
+ * @param[in]   samples     Interleaved SC16 Q11 samples
+ *
+ * @param[in]   num_samples Number of samples. Zero removes the waveform.
+ *
+ * @param[in]   timeout_ms  Timeout (milliseconds) for each buffer to
+ *                          become available. Zero implies "infinite."
+ *
+ * @pre A bladerf_sync_config() call has been made to configure the device for
+ *      synchronous data transfer, using a metadata format.
+ *
+ * @pre A burst started via bladerf_sync_tx() must not be in progress.
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_MEM if the waveform memory lacks space for the
+ *         waveform, alongside those loaded under other IDs,
+ *         BLADERF_ERR_UPDATE_FPGA if the FPGA version is older than v0.1.22,
+ *         BLADERF_ERR_INVAL on invalid parameters,
+ *         or a value from \ref RETCODES list on other failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_tx_load_waveform(struct bladerf *dev,
+                                            unsigned int id,
+                                            const int16_t *samples,
+                                            unsigned int num_samples,
+                                            unsigned int timeout_ms);
+
+/**
+ * Schedule transmission of a loaded waveform at the specified timestamp.
+ *
+ * Only a message header crosses the USB link, so repeatedly transmitted
+ * bursts, such as preambles, consume little bandwidth. The waveform occupies
+ * the timeline as a burst of the same length would, and later samples and
+ * waveforms must be scheduled after it. Zeros are transmitted between them.
+ *
+ * As with bladerf_sync_tx_bursts(), the request is not sent until its buffer
+ * is filled or flushed via bladerf_sync_tx_flush(), or by automatic flushing.
+ *
+ * @param[in]   dev         Device handle
+ *
+ * @param[in]   id          Waveform ID, as passed to
+ *                          bladerf_sync_tx_load_waveform()
+ *
+ * @param[in]   timestamp   Timestamp of the waveform's first sample
+ *
+ * @param[in]   timeout_ms  Timeout (milliseconds) for a buffer to
+ *                          become available. Zero implies "infinite."
+ *
+ * @pre A bladerf_sync_config() call has been made to configure the device for
+ *      synchronous data transfer, using a metadata format.
+ *
+ * @pre A burst started via bladerf_sync_tx() must not be in progress.
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_TIME_PAST if `timestamp` is before the end of previously
+ *         scheduled samples,
+ *         BLADERF_ERR_UPDATE_FPGA if the FPGA version is older than v0.1.22,
+ *         BLADERF_ERR_INVAL if no waveform is loaded under `id`, or on other
+ *         invalid parameters,
+ *         or a value from \ref RETCODES list on other failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_tx_play_waveform(struct bladerf *dev,
+                                            unsigned int id,
+                                            uint64_t timestamp,
+                                            unsigned int timeout_ms);
+
+/**
+ * Receive IQ samples.
+ *
+ * Under the hood, this call starts up an underlying asynchronous stream as
+ * needed. This stream can be stopped by disabling the RX module. (See
+ * bladerf_enable_module for more details.)
+ *
+ * @param[in]   dev         Device handle
+ *
+ * @param[out]  samples     Buffer to store samples in. The caller is
+ *                          responsible for ensuring this buffer is sufficiently
+ *                          large for the number of samples requested,
+ *                          considering the size of the sample format being
+ *                          used.
+ *
+ * @param[in]   num_samples Number of samples to read
+ *
+ * @param[out]  metadata    Sample metadata. This must be provided when using
+ *                          the ::BLADERF_FORMAT_SC16_Q11_META format, but may
+ *                          be NULL when the interface is configured for
+ *                          the ::BLADERF_FORMAT_SC16_Q11 format.
+ *
+ * @param[in]   timeout_ms  Timeout (milliseconds) for this call to complete.
+ *                          Zero implies "infinite."
+ *
+ * @pre A bladerf_sync_config() call has been to configure the device for
+ *      synchronous data transfer.
+ *
+ * @pre A call to bladerf_enable_module() should be made before attempting to
+ *      receive samples. Failing to do this may result in timeouts and other
+ *      errors.
+ *
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_UNSUPPORTED if libbladeRF is not built with support
+ *         for this functionality,
+ *         or a value from \ref RETCODES list on failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_rx(struct bladerf *dev,
+                              void *samples, unsigned int num_samples,
+                              struct bladerf_metadata *metadata,
+                              unsigned int timeout_ms);
+
+/**
+ * Transmit and receive IQ samples from a single thread.
+ *
+ * This is equivalent to calling bladerf_sync_tx() and then bladerf_sync_rx()
+ * on the same thread. The TX samples are written first, so that they are
+ * queued for transmission while this call waits for the RX samples. In a
+ * loop where both modules run at the same sample rate, each call therefore
+ * blocks for roughly one call's worth of samples, and a full-duplex
+ * application needs no separate TX thread.
+ *
+ * Each module's synchronous interface is configured separately, via
+ * bladerf_sync_config(), and may use a different format. Each call to
+ * transmit or receive samples is subject to `timeout_ms`.
+ *
+ * @param[in]   dev         Device handle
+ *
+ * @param[out]  rx_samples  Buffer to store received samples in
+ *
+ * @param[in]   tx_samples  Array of samples to transmit
+ *
+ * @param[in]   num_samples Number of samples to transmit and to receive
+ *
+ * @param[out]  rx_metadata RX sample metadata, as for bladerf_sync_rx()
+ *
+ * @param[in]   tx_metadata TX sample metadata, as for bladerf_sync_tx()
+ *
+ * @param[in]   timeout_ms  Timeout (milliseconds) for each of the TX and RX
+ *                          operations to complete. Zero implies "infinite."
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if a sample pointer is NULL,
+ *         or a value from \ref RETCODES list on failures. On a failure to
+ *         receive, the TX samples will have already been written.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_trx(struct bladerf *dev,
+                               void *rx_samples, void *tx_samples,
+                               unsigned int num_samples,
+                               struct bladerf_metadata *rx_metadata,
+                               struct bladerf_metadata *tx_metadata,
+                               unsigned int timeout_ms);
+
+/**
+ * Receive IQ samples, without waiting for any to arrive.
+ *
+ * This behaves as bladerf_sync_rx(), except that it returns only the samples
+ * that have already been received, up to `num_samples`. When using the
+ * ::BLADERF_FORMAT_SC16_Q11_META format, the metadata's `timestamp` is that
+ * of the first sample returned, and `actual_count` is also set. To continue
+ * a read that returned fewer samples than requested, advance the timestamp
+ * (if ::BLADERF_META_FLAG_RX_NOW is not used) by the number returned.
+ *
+ * The first call following bladerf_sync_config() starts the underlying
+ * stream, and may wait briefly for it to start, unless bladerf_sync_arm() has
+ * been called.
+ *
+ * @param[in]   dev         Device handle
+ * @param[out]  samples     Buffer to store samples in
+ * @param[in]   num_samples Maximum number of samples to read
+ * @param[out]  metadata    Sample metadata, as for bladerf_sync_rx()
+ * @param[out]  num_read    Number of samples returned
+ *
+ * @return 0 if any samples were returned,
+ *         BLADERF_ERR_WOULD_BLOCK if none were available,
+ *         or a value from \ref RETCODES list on failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_rx_try(struct bladerf *dev,
+                                  void *samples, unsigned int num_samples,
+                                  struct bladerf_metadata *metadata,
+                                  unsigned int *num_read);
+
+/**
+ * Transmit IQ samples, without waiting for buffer space.
+ *
+ * This behaves as bladerf_sync_tx(), except that it writes only as many
+ * samples as fit in the buffer space that is already available, up to
+ * `num_samples`. A call that writes no samples has no effect.
+ *
+ * When using the ::BLADERF_FORMAT_SC16_Q11_META format, a call that writes
+ * only some of its samples has started any burst it requested, but has not
+ * ended it. The remaining samples should then be written without the
+ * ::BLADERF_META_FLAG_TX_BURST_START and ::BLADERF_META_FLAG_TX_NOW flags,
+ * and with ::BLADERF_META_FLAG_TX_BURST_END if it was originally specified.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   samples     Array of samples
+ * @param[in]   num_samples Maximum number of samples to write
+ * @param[in]   metadata    Sample metadata, as for bladerf_sync_tx()
+ * @param[out]  num_written Number of samples written
+ *
+ * @return 0 if any samples were written,
+ *         BLADERF_ERR_WOULD_BLOCK if there was no space for any,
+ *         or a value from \ref RETCODES list on failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_tx_try(struct bladerf *dev,
+                                  void *samples, unsigned int num_samples,
+                                  struct bladerf_metadata *metadata,
+                                  unsigned int *num_written);
+
+/**
+ * Get a file descriptor that becomes readable when a module's synchronous
+ * interface may be able to transfer samples without blocking, for use with
+ * poll(), epoll and event loop libraries.
+ *
+ * The descriptor is signalled when a bladerf_sync_rx_try() or
+ * bladerf_sync_tx_try() call has returned ::BLADERF_ERR_WOULD_BLOCK and a
+ * buffer has since become available, or the underlying stream has stopped.
+ * It may also become readable spuriously, and initially is. Once it is
+ * readable, make non-blocking calls until one returns
+ * ::BLADERF_ERR_WOULD_BLOCK, before waiting on the descriptor again. Those
+ * calls consume its signal; do not read from it directly.
+ *
+ * The descriptor is owned by the synchronous interface. It remains valid
+ * across bladerf_sync_resize(), and is closed when the interface is
+ * reconfigured via bladerf_sync_config() or the module is disabled. Remove it
+ * from any event loop before then.
+ *
+ * @note This is not available on Windows, where the non-blocking functions
+ *       may instead be called periodically.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module whose synchronous interface to query
+ * @param[out]  fd          Readiness descriptor
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if the module's synchronous interface has not
+ *         been configured,
+ *         BLADERF_ERR_UNSUPPORTED on platforms where this is not available,
+ *         or a value from \ref RETCODES list on failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_get_fd(struct bladerf *dev, bladerf_module module,
+                                  int *fd);
+
+/**
+ * Destination range for bladerf_sync_rx_multi()
+ */
+struct bladerf_rx_iov {
+    void *samples;              /**< Buffer to store samples in */
+    unsigned int num_samples;   /**< Number of samples to read into `samples` */
+};
+
+/**
+ * Receive IQ samples into multiple buffers with a single call.
+ *
+ * This is equivalent to calling bladerf_sync_rx() for each of the provided
+ * ranges, in order, but avoids the per-call overhead of doing so: the RX
+ * sync lock is acquired and the request is validated only once, and a
+ * single pass through the receive loop fills the ranges in turn. This is
+ * intended for applications that consume many small blocks of samples.
+ *
+ * With the ::BLADERF_FORMAT_SC16_Q11_META format, a range is cut short at a
+ * discontinuity, as a bladerf_sync_rx() call would be, and the next range
+ * continues from the first sample following it.
+ *
+ * @param[in]   dev         Device handle
+ *
+ * @param[in]   iov         Array of `iov_count` destination ranges
+ *
+ * @param[out]  metadata    Array of `iov_count` metadata structures, one per
+ *                          range. Each is used (and updated) as the metadata
+ *                          passed to bladerf_sync_rx() for the corresponding
+ *                          range. This must be provided when using the
+ *                          ::BLADERF_FORMAT_SC16_Q11_META format, but may be
+ *                          NULL when the interface is configured for the
+ *                          ::BLADERF_FORMAT_SC16_Q11 format.
+ *
+ * @param[in]   iov_count   Number of ranges
+ *
+ * @param[in]   timeout_ms  Timeout (milliseconds) for each range to be filled.
+ *                          Zero implies "infinite."
+ *
+ * @pre A bladerf_sync_config() call has been to configure the device for
+ *      synchronous data transfer.
+ *
+ * @return 0 on success, or a value from \ref RETCODES list on failures. An
+ *         invalid request, such as one in which any range has a NULL
+ *         `samples` pointer, fails before any range is filled. Upon other
+ *         failures, no further ranges are filled after the range that failed.
+ *         When metadata is provided, the `actual_count` fields of the ranges
+ *         that were filled remain valid.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_rx_multi(struct bladerf *dev,
+                                    const struct bladerf_rx_iov *iov,
+                                    struct bladerf_metadata *metadata,
+                                    unsigned int iov_count,
+                                    unsigned int timeout_ms);
+
+/**
+ * Receive IQ samples without copying them out of the synchronous interface's
+ * internal buffers.
+ *
+ * This function lends the caller a pointer to samples residing in the
+ * underlying stream buffers. The associated buffer will not be reused for
+ * reception until the samples are returned via bladerf_sync_rx_release().
+ * Only one loan may be outstanding at a time, and bladerf_sync_rx() may not be
+ * called while samples are lent.
+ *
+ * When using the ::BLADERF_FORMAT_SC16_Q11 format, the remainder of the
+ * current buffer is provided. When using the ::BLADERF_FORMAT_SC16_Q11_META
+ * format, the remainder of the current message is provided, as samples are not
+ * contiguous across the metadata headers embedded in a buffer. In this case,
+ * the metadata's timestamp field is updated with the timestamp of the first
+ * lent sample, and the ::BLADERF_META_STATUS_OVERRUN status flag is set if a
+ * discontinuity occurred since the previously released samples. The number of
+ * samples missing at the discontinuity is reported via the metadata's
+ * `dropped_samples` field. The
+ * ::BLADERF_META_FLAG_RX_NOW flag is implied; scheduled reads are not
+ * supported by this function.
+ *
+ * Holding on to lent samples for an extended period of time reduces the
+ * number of buffers available to the underlying stream, and may cause
+ * overruns. Consider increasing the `num_buffers` parameter passed to
+ * bladerf_sync_config() if samples are to be held for some time.
+ *
+ * @param[in]   dev         Device handle
+ *
+ * @param[out]  samples     Updated to point to the lent samples on success
+ *
+ * @param[out]  num_samples Updated with the number of lent samples on success
+ *
+ * @param[out]  metadata    Sample metadata. This must be provided when using
+ *                          the ::BLADERF_FORMAT_SC16_Q11_META format, but may
+ *                          be NULL when the interface is configured for
+ *                          the ::BLADERF_FORMAT_SC16_Q11 format.
+ *
+ * @param[in]   timeout_ms  Timeout (milliseconds) for this call to complete.
+ *                          Zero implies "infinite."
+ *
+ * @pre A bladerf_sync_config() call has been to configure the device for
+ *      synchronous data transfer.
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if a previous loan has not yet been released,
+ *         BLADERF_ERR_UNSUPPORTED with the
+ *         ::BLADERF_FORMAT_SC16_Q11_PACKED, ::BLADERF_FORMAT_CF32 and
+ *         ::BLADERF_FORMAT_CF32_META formats,
+ *         or a value from \ref RETCODES list on failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_rx_acquire(struct bladerf *dev,
+                                      void **samples,
+                                      unsigned int *num_samples,
+                                      struct bladerf_metadata *metadata,
+                                      unsigned int timeout_ms);
+
+/**
+ * Return samples lent by bladerf_sync_rx_acquire() to the synchronous
+ * interface, allowing the associated buffer to be reused for reception.
+ *
+ * The provided pointer must not be accessed after this call.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   samples     Pointer provided by bladerf_sync_rx_acquire()
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if `samples` is not the outstanding loan,
+ *         or a value from \ref RETCODES list on failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_rx_release(struct bladerf *dev, void *samples);
+
+/**
+ * Location and metadata of one message's samples, as lent by
+ * bladerf_sync_rx_acquire_msgs()
+ */
+struct bladerf_rx_msg {
+    uint64_t timestamp;         /**< Timestamp of the first sample */
+    uint32_t flags;             /**< Flags from the message's header */
+    unsigned int num_samples;   /**< Number of samples at `samples` */
+    void *samples;              /**< Samples following the message's header */
+};
+
+/**
+ * Receive whole messages without copying them out of the synchronous
+ * interface's internal buffers, when using a format with metadata (e.g.,
+ * ::BLADERF_FORMAT_SC16_Q11_META).
+ *
+ * This is a variant of bladerf_sync_rx_acquire() that lends up to
+ * `max_msgs` of the remaining messages in the current buffer at once, rather
+ * than a single message's samples. The headers are left in place, and `msgs`
+ * is populated with the timestamp, flags, and location of each message's
+ * samples. When the current buffer has not been partially consumed and
+ * `max_msgs` is large enough, the lent region is the entire buffer, headers
+ * included.
+ *
+ * The metadata is updated as it is by bladerf_sync_rx_acquire(), with its
+ * `actual_count` holding the total number of lent samples. Timestamp
+ * discontinuities between the lent messages are reflected in their
+ * timestamps, rather than in the metadata's status. The loan is returned via
+ * bladerf_sync_rx_release(), and the same restrictions apply.
+ *
+ * @param[in]   dev         Device handle
+ * @param[out]  buffer      Updated to point to the start of the lent region
+ *                          on success. This is the pointer to pass to
+ *                          bladerf_sync_rx_release().
+ * @param[out]  msgs        Populated with the lent messages on success
+ * @param[in]   max_msgs    Number of entries available in `msgs`
+ * @param[out]  num_msgs    Updated with the number of lent messages
+ * @param[out]  metadata    Metadata of the first lent sample. Required.
+ * @param[in]   timeout_ms  Timeout (milliseconds) for this call to complete.
+ *                          Zero implies "infinite."
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if a previous loan has not yet been released,
+ *         BLADERF_ERR_UNSUPPORTED if the format does not carry metadata
+ *         or is ::BLADERF_FORMAT_CF32_META,
+ *         or a value from \ref RETCODES list on failures.
+ */
+API_EXPORT
+int CALL_CONV bladerf_sync_rx_acquire_msgs(struct bladerf *dev,
+                                           void **buffer,
+                                           struct bladerf_rx_msg *msgs,
+                                           unsigned int max_msgs,
+                                           unsigned int *num_msgs,
+                                           struct bladerf_metadata *metadata,
+                                           unsigned int timeout_ms);
+
+/**
+ * Number of bins in the bladerf_stream_stats histograms.
+ *
+ * Bin 0 counts durations under 1 microsecond. Bin `n`, for `n` > 0, counts
+ * durations in the range [2^(n-1), 2^n) microseconds. The last bin
+ * additionally includes all durations longer than its range.
+ */
+#define BLADERF_STREAM_STATS_HIST_LEN 20
+
+/**
+ * Synchronous interface stream statistics
+ *
+ * All counts are accumulated from the time bladerf_sync_config() is called
+ * for the associated module.
+ *
+ * @note Transfer counts and timing histograms are currently only collected
+ *       by the libusb backend.
+ */
+struct bladerf_stream_stats {
+    /**
+     * Number of RX overruns that have occurred. Each overrun results in
+     * `num_transfers` buffers worth of samples being dropped, as the
+     * associated transfers are resubmitted without being made available
+     * to the caller.
+     *
+     * This is always 0 for the TX module.
+     */
+    uint64_t overruns;
+
+    /**
+     * Number of filled RX transfers that have been resubmitted (and whose
+     * samples were therefore dropped) as a result of overruns.
+     *
+     * This is always 0 for the TX module.
+     */
+    uint64_t resubmissions;
+
+    /**
+     * Number of TX underruns that have occurred. An underrun is counted when
+     * all submitted samples have been transmitted, and further samples are
+     * later submitted. With a format that has metadata, the idle period
+     * following a burst ended with ::BLADERF_META_FLAG_TX_BURST_END is not
+     * counted.
+     *
+     * This is always 0 for the RX module.
+     */
+    uint64_t underruns;
+
+    /**
+     * Number of times the FPGA's TX sample FIFO has run empty while the TX
+     * module was enabled and samples were due to be transmitted. With a
+     * format that has metadata, this excludes periods in which no message's
+     * timestamp had yet been reached. Reading this requires a control
+     * transfer to the device.
+     *
+     * This requires FPGA v0.1.21 or later. It is always 0 for the RX module.
+     */
+    uint64_t fpga_underruns;
+
+    /**
+     * Number of RX timestamp discontinuities found by the continuity checker
+     * (see bladerf_sync_continuity_check()).
+     *
+     * This is always 0 for the TX module, and when checking is not enabled.
+     */
+    uint64_t discontinuities;
+
+    /**
+     * Total number of samples missing across the discontinuities counted by
+     * `discontinuities`. Timestamps that move backwards do not contribute to
+     * this count.
+     */
+    uint64_t dropped_samples;
+
+    /**
+     * Number of RX messages whose headers reported an FPGA RX FIFO overflow
+     * (see ::BLADERF_META_FLAG_RX_OVERFLOW). This includes messages in
+     * buffers that were dropped on the host.
+     *
+     * This requires FPGA v0.1.19 or later, and a format with metadata. It is
+     * always 0 for the TX module.
+     */
+    uint64_t fpga_overflows;
+
+    /**
+     * Total number of samples the FPGA dropped across the overflows counted
+     * by `fpga_overflows`. With the continuity checker enabled, subtracting
+     * this from `dropped_samples` gives the number of samples lost on the
+     * host.
+     */
+    uint64_t fpga_dropped_samples;
+
+    /** Number of transfers that have completed successfully */
+    uint64_t transfers;
+
+    /**
+     * Number of completed transfers that contained fewer bytes than
+     * requested
+     */
+    uint64_t short_transfers;
+
+    /**
+     * Number of sync interface buffers currently filled. For RX, these are
+     * buffers of received samples that have not yet been read by the caller.
+     * For TX, these are buffers submitted by the caller that have not yet
+     * been transmitted.
+     *
+     * An RX overrun occurs when this approaches `num_buffers` -
+     * `num_transfers`, and a TX underrun may occur when this approaches 0.
+     */
+    unsigned int fill_current;
+
+    /** Minimum observed value of `fill_current` while streaming */
+    unsigned int fill_min;
+
+    /** Maximum observed value of `fill_current` while streaming */
+    unsigned int fill_max;
+
+    /**
+     * Histogram of the time spent in the stream callback, per transfer.
+     * While the callback executes, no further transfers are submitted or
+     * completed.
+     */
+    uint64_t callback_hist[BLADERF_STREAM_STATS_HIST_LEN];
+
+    /**
+     * Histogram of transfer turnaround: the time between submitting a
+     * transfer to the USB stack and its completion.
+     */
+    uint64_t turnaround_hist[BLADERF_STREAM_STATS_HIST_LEN];
+
+    /**
+     * Number of times a synchronous interface call waited for a buffer,
+     * and one became available while spinning
+     */
+    uint64_t spin_waits;
+
+    /**
+     * Number of times a synchronous interface call blocked while waiting
+     * for a buffer
+     */
+    uint64_t blocking_waits;
+
+    /**
+     * Histogram of the time synchronous interface calls spent waiting for
+     * a buffer, per wait. Calls that find a buffer available do not wait.
+     */
+    uint64_t wait_hist[BLADERF_STREAM_STATS_HIST_LEN];
+
+    /**
+     * Number of times the backend's event thread has handled transfer
+     * completions (or, when busy-polling, checked for them).
+     *
+     * The event thread is shared by the device's RX and TX streams, so this
+     * and `event_cpu_us` include the activity of both.
+     */
+    uint64_t event_polls;
+
+    /**
+     * CPU time consumed by the backend's event thread, in microseconds. This
+     * is 0 where the CPU time of a thread is unavailable.
+     */
+    uint64_t event_cpu_us;
+
+    /**
+     * NUMA node of the device's USB host controller, on which the stream
+     * was placed. This is -1 if the node is unknown, if the host has only
+     * one node, or if `ignore_numa` was set in the stream's
+     * bladerf_stream_thread_config.
+     */
+    int numa_node;
+
+    /** Whether the stream's buffers were allocated on `numa_node` */
+    bool numa_buffers;
+
+    /**
+     * Bitmask of the CPUs (0 through 63) that the stream's threads were
+     * pinned to, or 0 if they were left unchanged
+     */
+    uint64_t thread_cpus;
+};
+
+/**
+ * Retrieve the statistics of the synchronous interface's stream for the
+ * specified module.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to query
+ * @param[out]  stats       Updated with the stream statistics on success
+ *
+ * @pre A bladerf_sync_config() call has been to configure the device for
+ *      synchronous data transfer.
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if the module has not been configured for
+ *         synchronous data transfer, or a value from \ref RETCODES list on
+ *         other failures.
  */
-#define BLADERF_META_FLAG_TX_NOW           (1 << 2)
+API_EXPORT
+int CALL_CONV bladerf_get_stream_stats(struct bladerf *dev,
+                                       bladerf_module module,
+                                       struct bladerf_stream_stats *stats);
+
+
+/** @} (End of FN_DATA_SYNC) */
 
 /**
- * This flag indicates that calls to bladerf_sync_rx should return any available
- * samples, rather than wait until the timestamp indicated in the
- * bladerf_metadata timestamp field.
+ * @defgroup FN_REPEATER  Full-duplex repeater
+ *
+ * These functions relay received samples back out of the transmitter, with
+ * either the lowest latency the configured buffering allows, or a fixed,
+ * sample-accurate delay.
+ *
+ * The repeater runs an RX and a TX asynchronous stream that share a single
+ * pool of buffers. Each received buffer is handed to the TX stream as-is,
+ * without copying its samples. In delayed mode, the
+ * ::BLADERF_FORMAT_SC16_Q11_META format is used, and each message's
+ * timestamp is advanced by the requested delay in place, such that the FPGA
+ * transmits it exactly `delay` samples after it was received.
+ *
+ * Both modules should be configured (e.g., sample rate, frequency, gains)
+ * prior to starting the repeater. These settings may be changed while the
+ * repeater is running. The synchronous and asynchronous interfaces must not
+ * otherwise be used while the repeater is running.
+ *
+ * Received samples may be passed through up to
+ * ::BLADERF_REPEATER_MAX_STAGES processing stages before being transmitted.
+ * Stages run in the RX stream's callback, in place, so the time they take
+ * adds to the latency of each buffer. If a buffer takes longer to process
+ * than it takes to receive, the RX stream falls behind and samples are
+ * dropped; the `budget_exceeded` field of bladerf_repeater_stats counts
+ * these occurrences.
+ *
+ * @{
  */
-#define BLADERF_META_FLAG_RX_NOW           (1 << 31)
+
+/** Maximum number of processing stages in a repeater */
+#define BLADERF_REPEATER_MAX_STAGES 4
 
 /**
- * Sample metadata
+ * Repeater processing stage function.
  *
- * This structure is used in conjunction with the ::BLADERF_FORMAT_SC16_Q11_META
- * format to TX scheduled bursts or retrieve timestamp information about
- * received samples.
+ * This function is called from the RX stream's callback context, and should
+ * not block.
+ *
+ * @param[inout]    samples     Interleaved SC16 Q11 samples to process in
+ *                              place. These must be kept within [-2048, 2047].
+ * @param[in]       num_samples Number of samples (I, Q pairs) in `samples`
+ * @param[in]       user_data   User data provided with the stage
  */
-struct bladerf_metadata {
+typedef void (*bladerf_repeater_stage_fn)(int16_t *samples,
+                                          unsigned int num_samples,
+                                          void *user_data);
 
-    /**
-     * Free-running FPGA counter that monotonically increases at the
-     * sample rate of the associated module. */
-    uint64_t timestamp;
+/** Repeater processing stage */
+struct bladerf_repeater_stage {
+    /** Name of the stage, used in log messages */
+    const char *name;
+
+    /** Processing function */
+    bladerf_repeater_stage_fn process;
+
+    /** Data passed to `process` */
+    void *user_data;
+};
 
+/** Repeater configuration */
+struct bladerf_repeater_config {
     /**
-     * Input bit field to control the behavior of the call that the metadata
-     * structure is passed to. API calls read this field from the provided
-     * data structure, and do not modify it.
-     *
-     * Valid flags include
-     *  ::BLADERF_META_FLAG_TX_BURST_START, ::BLADERF_META_FLAG_TX_BURST_END,
-     *  ::BLADERF_META_FLAG_TX_NOW, and ::BLADERF_META_FLAG_RX_NOW
-     *
+     * Total number of buffers, shared by the RX and TX streams. This must be
+     * greater than twice `num_transfers`.
      */
-    uint32_t flags;
+    unsigned int num_buffers;
+
+    /** Size of each buffer, in samples. Must be a multiple of 1024. */
+    unsigned int buffer_size;
 
     /**
-     * Output bit field to denoting the status of transmissions/receptions. API
-     * calls will write this field.
-     *
-     * Possible status flags include ::BLADERF_META_STATUS_OVERRUN and
-     * ::BLADERF_META_STATUS_UNDERRUN;
-     *
+     * Number of transfers kept in flight by each of the RX and TX streams.
+     * When `delay` is 0, the transmit path adds about this many buffers of
+     * latency, so this should be kept as small as the host allows.
      */
-    uint32_t status;
+    unsigned int num_transfers;
 
     /**
-     * This output parameter is updated to reflect the actual number of
-     * contiguous samples that have been populated in an RX buffer during
-     * a bladerf_sync_rx() call.
-     *
-     * This will not be equal to the requested count in the event of a
-     * discontinuity (i.e., when the status field has the
-     * ::BLADERF_META_STATUS_OVERRUN flag set). When an overrun occurs, it is
-     * important not to read past the number of samples specified by this
-     * value, as the remaining contents of the buffer are undefined.
+     * Delay, in samples, between the reception and transmission of each
+     * sample.
      *
-     * This parameter is not currently used by bladerf_sync_tx().
+     * If 0, buffers are transmitted as soon as they are received, without
+     * the use of timestamps. Otherwise, this must be large enough to cover
+     * the time buffers spend being received, handed off, and transferred to
+     * the device; buffers that fail to do so are counted in the `late` field
+     * of bladerf_repeater_stats.
      */
-    unsigned int actual_count;
+    uint64_t delay;
 
     /**
-     * Reserved for future use. This is not used by any functions.
-     * It is recommended that users zero out this field.
+     * Processing stages applied to received samples, in order, before they
+     * are transmitted. The stages are copied when the repeater is started,
+     * but their `user_data` must remain valid until it is stopped. May be
+     * NULL if `num_stages` is 0.
      */
-    uint8_t reserved[32];
+    const struct bladerf_repeater_stage *stages;
+
+    /** Number of entries in `stages`. At most ::BLADERF_REPEATER_MAX_STAGES */
+    unsigned int num_stages;
 };
 
+/** Repeater statistics */
+struct bladerf_repeater_stats {
+    /** Number of buffers handed from RX to TX */
+    uint64_t buffers;
 
-/** @} (End of FMT_META) */
+    /**
+     * Number of received buffers that were discarded because no free buffer
+     * was available to receive into.
+     */
+    uint64_t dropped;
+
+    /**
+     * Number of buffers of zeros transmitted because no received buffer was
+     * ready, after the first buffer was relayed.
+     */
+    uint64_t underruns;
+
+    /**
+     * Number of buffers handed to TX after their transmit time, according to
+     * the most recently received timestamp. Always 0 when `delay` is 0.
+     */
+    uint64_t late;
+
+    /**
+     * Smallest observed margin, in samples, between the most recently
+     * received timestamp and the transmit timestamp of a buffer when it was
+     * handed to TX. This is the portion of `delay` that could be removed
+     * while still allowing buffers to reach the device in time, less the time
+     * spent transferring them. INT64_MAX if no buffers have been relayed in
+     * delayed mode.
+     */
+    int64_t min_margin;
+
+    /** Largest time, in microseconds, a buffer spent between RX and TX */
+    uint64_t latency_max_us;
+
+    /**
+     * Sum of the times, in microseconds, buffers spent between RX and TX.
+     * Divide by `buffers` to obtain the mean.
+     */
+    uint64_t latency_total_us;
 
+    /**
+     * Histogram of the time between the completion of each buffer's RX
+     * transfer and its submission for TX. Bin 0 counts times under 1 us,
+     * and bin `i` counts times in [2^(i-1), 2^i) us, with the final bin
+     * including all larger times.
+     */
+    uint64_t latency_hist[BLADERF_STREAM_STATS_HIST_LEN];
+
+    /**
+     * Sum of the times, in microseconds, spent in each processing stage.
+     * Entries beyond the configured number of stages are 0.
+     */
+    uint64_t stage_total_us[BLADERF_REPEATER_MAX_STAGES];
+
+    /** Largest time, in microseconds, a stage spent on a single buffer */
+    uint64_t stage_max_us[BLADERF_REPEATER_MAX_STAGES];
+
+    /**
+     * Number of buffers whose processing stages took longer in total than
+     * the buffer's duration at the RX sample rate.
+     */
+    uint64_t budget_exceeded;
+};
+
+/** Opaque handle to a running repeater */
+struct bladerf_repeater;
 
 /**
- * @defgroup FN_DATA_ASYNC    Asynchronous data transmission and reception
+ * Enable the RX and TX modules and start relaying samples between them
  *
- * This interface gives the API user full control over the stream and buffer
- * management, at the cost of added complexity.
- *
- * New users are recommended to first evaluate the \ref FN_DATA_SYNC interface,
- * and to only use this interface if the former is found to not yield suitable
- * performance.
+ * @param[in]   dev         Device handle
+ * @param[in]   config      Repeater configuration
+ * @param[out]  repeater    Updated with a handle to the running repeater
  *
- * @{
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL on invalid configuration values,
+ *         BLADERF_ERR_UPDATE_FPGA if a delay is requested but the FPGA
+ *         does not support timestamps,
+ *         or a value from \ref RETCODES list on other failures
  */
+API_EXPORT
+int CALL_CONV bladerf_repeater_start(struct bladerf *dev,
+                                     const struct bladerf_repeater_config *config,
+                                     struct bladerf_repeater **repeater);
 
 /**
- * Use this as a return value in callbacks or as the buffer parameter to
- * bladerf_submit_stream_buffer() to shutdown a stream.
+ * Retrieve a running repeater's statistics
+ *
+ * @param[in]   repeater    Repeater handle
+ * @param[out]  stats       Updated with the current statistics
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on invalid parameters
  */
-#define BLADERF_STREAM_SHUTDOWN (NULL)
+API_EXPORT
+int CALL_CONV bladerf_repeater_get_stats(struct bladerf_repeater *repeater,
+                                         struct bladerf_repeater_stats *stats);
 
 /**
- * Use this value in a stream callback to indicate that no buffer is being
- * provided. In this case, buffers are expected to be provided via
- * bladerf_submit_stream_buffer().
+ * Stop a repeater, disable the RX and TX modules, and deallocate the handle
+ *
+ * @param[in]   repeater    Repeater handle. May be NULL.
+ *
+ * @return 0 on success, or the first error encountered by either stream
  */
-#define BLADERF_STREAM_NO_DATA  ((void*)(-1))
-
-/** This opaque structure is used to keep track of stream information */
-struct bladerf_stream;
+API_EXPORT
+int CALL_CONV bladerf_repeater_stop(struct bladerf_repeater *repeater);
 
 /**
- * This typedef represents a callback function that is executed in response to
- * this interface's asynchronous events.
+ * Initialize a built-in stage that scales samples by `gain`, saturating
+ * the results.
  *
- * Stream callbacks <b>must not</b> block or perform long-running operations.
- * Otherwise, timeouts may occur. If this cannot be guaranteed, consider
- * returning BLADERF_STREAM_NO_DATA in callbacks and later submit a buffer using
- * bladerf_submit_stream_buffer(). However, callbacks should always take a
- * single approach of returning buffers <b>or</b> returning
- * BLADERF_STREAM_NO_DATA and submitting buffers later -- <b>but not both</b>.
+ * The built-in stages are vectorized with SSE2 or NEON where available.
+ * Each maintains its own state, so a stage may be used in only one running
+ * repeater at a time. Free stages with bladerf_repeater_stage_free() once
+ * the repeater using them has been stopped.
  *
- * When running in a full-duplex mode of operation with simultaneous TX and RX
- * stream threads, be aware that one module's callback may occur in the context
- * of another module's thread. The API user is responsible for ensuring their
- * callbacks are thread safe. For example, when managing access to sample
- * buffers, the caller must ensure that if one thread is processing samples in a
- * buffer, that this buffer is not returned via the callback's return value.
+ * @param[out]  stage       Stage to initialize
+ * @param[in]   gain        Linear gain, within [0, 8). This is applied with
+ *                          a resolution of 1/4096.
  *
- * As of libbladeRF v0.15.0, is guaranteed that only one callback from a module
- * will occur at a time. (i.e., a second TX callback will not fire while one is
- * currently being handled.)  To achieve this, while a callback is executing, a
- * per-stream lock is held. It is important to consider this when thinking about
- * the order of lock acquisitions both in the callbacks, and the code
- * surrounding bladerf_submit_stream_buffer().
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL on an invalid gain,
+ *         BLADERF_ERR_MEM on memory allocation failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_repeater_stage_gain(struct bladerf_repeater_stage *stage,
+                                          float gain);
+
+/**
+ * Initialize a built-in stage that applies a FIR filter with real-valued
+ * taps to the I and Q components of samples, saturating the results.
+ * State is carried across buffers, so the filter is continuous.
  *
- * <b>Note:</b>Do not call bladerf_submit_stream_buffer() from a callback.
+ * @param[out]  stage       Stage to initialize
+ * @param[in]   taps        Filter taps, each within (-1, 1). These are
+ *                          applied with a resolution of 1/32768, and the sum
+ *                          of their magnitudes must be less than 16.
+ * @param[in]   num_taps    Number of taps. Must be within [1, 128].
  *
- * For both RX and TX, the stream callback receives:
- *  - dev:          Device structure
- *  - stream:       The associated stream
- *  - metadata:     For future support - do not attempt to read/write this
- *                  in the current library implementation.
- *  - user_data:    User data provided when initializing stream
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL on invalid taps,
+ *         BLADERF_ERR_MEM on memory allocation failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_repeater_stage_fir(struct bladerf_repeater_stage *stage,
+                                         const float *taps,
+                                         unsigned int num_taps);
+
+/**
+ * Initialize a built-in stage that mixes samples with a complex
+ * oscillator, shifting them in frequency.
  *
- * For TX callbacks:
- *  - samples:      Pointer to buffer of samples that was sent
- *  - num_samples:  Number of sent in last transfer and to send in next transfer
- *  - Return value: The user specifies the address of the next buffer to send,
- *                  BLADERF_STREAM_SHUTDOWN, or BLADERF_STREAM_NO_DATA.
+ * @param[out]  stage       Stage to initialize
+ * @param[in]   frequency   Frequency shift, in cycles per sample, within
+ *                          [-0.5, 0.5]. Multiply by the sample rate to obtain
+ *                          the shift in Hz.
  *
- * For RX callbacks:
- *  - samples:          Buffer filled with received data
- *  - num_samples:      Number of samples received and size of next buffers
- *  - Return value:     The user specifies the next buffer to fill with RX data,
- *                      which should be `num_samples` in size,
- *                      BLADERF_STREAM_SHUTDOWN, or BLADERF_STREAM_NO_DATA.
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL on an invalid frequency,
+ *         BLADERF_ERR_MEM on memory allocation failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_repeater_stage_nco(struct bladerf_repeater_stage *stage,
+                                         double frequency);
+
+/**
+ * Free a stage initialized by one of the bladerf_repeater_stage_*()
+ * functions.
  *
+ * @param[inout]    stage   Stage to free. It is zeroed upon return.
  */
-typedef void *(*bladerf_stream_cb)(struct bladerf *dev,
-                                   struct bladerf_stream *stream,
-                                   struct bladerf_metadata *meta,
-                                   void *samples,
-                                   size_t num_samples,
-                                   void *user_data);
+API_EXPORT
+void CALL_CONV bladerf_repeater_stage_free(struct bladerf_repeater_stage *stage);
+
+/** @} (End of FN_REPEATER) */
 
 /**
- * Initialize a stream for use with asynchronous routines.
+ * @defgroup FN_RX_PIPELINE  Parallel RX processing
  *
- * This function will internally allocate data buffers, which will be provided
- * to the API user in callback functions.
+ * These functions spread the processing of received buffers across a pool
+ * of worker threads, for processing that needs more than one CPU core to
+ * keep up with the sample rate, while still providing the results in the
+ * order the samples were received.
  *
- * The `buffers` output parameter populates a pointer to the list of allocated
- * buffers. This allows the API user to implement a buffer management scheme to
- * best suit his or her specific use case.
+ * The pipeline runs an RX asynchronous stream. Each received buffer is
+ * queued to one of the workers in turn, and a worker that runs out of
+ * buffers takes the oldest queued buffer of another worker. Once a worker's
+ * ::bladerf_rx_pipeline_work_fn returns, the buffer and its result are
+ * passed to the ::bladerf_rx_pipeline_deliver_fn, strictly in reception
+ * (and therefore timestamp) order, by whichever worker completed the next
+ * buffer due. The buffer is then handed back to the stream to receive into
+ * again. Samples are never copied.
  *
- * Generally, one will want to set the `buffers` parameter to a value larger
- * than the `num_transfers` parameter, and keep track of which buffers are
- * currently "in-flight", versus those available for use.
+ * When every buffer is held by the workers or awaiting delivery, received
+ * buffers are discarded, and counted in the `dropped` field of
+ * bladerf_rx_pipeline_stats.
  *
- * For example, for a transmit stream, modulated data can be actively written
- * into free buffers while transfers of other buffers are occurring. Once a
- * buffer has been filled with data, it can be marked 'in-flight' and be
- * returned in a successive callback to transmit.
+ * The RX module should be configured (e.g., sample rate, frequency, gains)
+ * prior to starting the pipeline. The synchronous and asynchronous RX
+ * interfaces must not otherwise be used while the pipeline is running.
  *
- * The choice of values for the `num_transfers` and `buffer_size` should be
- * made based upon the desired samplerate, and the stream timeout value
- * specified via bladerf_set_stream_timeout(), which defaults to 1 second.
+ * @{
+ */
+
+/** Maximum number of worker threads in an RX pipeline */
+#define BLADERF_RX_PIPELINE_MAX_WORKERS 64
+
+/**
+ * RX pipeline work function, which processes a received buffer.
  *
- * For a given sample rate, the below relationship must be upheld to transmit or
- * receive data without timeouts or dropped data.
+ * This is called from several worker threads at once, each with a
+ * different buffer.
  *
- * @f[
- * Sample\ Rate > \frac{\#\ Transfers}{Timeout} \times Buffer\ Size
- * @f]
+ * @param[in]   samples     Received samples, in the pipeline's format. These
+ *                          may be modified in place.
+ * @param[in]   num_samples Number of samples in `samples`
+ * @param[in]   meta        Metadata of the buffer, as provided to a
+ *                          ::bladerf_stream_cb
+ * @param[in]   worker      Index of the calling worker, within
+ *                          [0, `num_workers`)
+ * @param[in]   user_data   User data provided with the configuration
  *
- * ...where Sample Rate is in samples per second, and Timeout is in seconds.
+ * @return A result to pass to the ::bladerf_rx_pipeline_deliver_fn along
+ *         with the buffer
+ */
+typedef void *(*bladerf_rx_pipeline_work_fn)(
+                                        void *samples,
+                                        unsigned int num_samples,
+                                        const struct bladerf_metadata *meta,
+                                        unsigned int worker,
+                                        void *user_data);
+
+/**
+ * RX pipeline delivery function, which is provided each processed buffer
+ * in the order the buffers were received.
  *
- * To account for general system overhead, it is recommended to multiply the
- * righthand side by 1.1 to 1.25.
+ * Calls to this function do not overlap, but may be made from any worker
+ * thread. The buffer is received into again once this returns, so
+ * `samples` must not be accessed afterwards.
+ *
+ * @param[in]   samples     Processed samples
+ * @param[in]   num_samples Number of samples in `samples`
+ * @param[in]   meta        Metadata of the buffer
+ * @param[in]   result      Value returned by the work function
+ * @param[in]   user_data   User data provided with the configuration
+ */
+typedef void (*bladerf_rx_pipeline_deliver_fn)(
+                                        void *samples,
+                                        unsigned int num_samples,
+                                        const struct bladerf_metadata *meta,
+                                        void *result,
+                                        void *user_data);
+
+/** RX pipeline configuration */
+struct bladerf_rx_pipeline_config {
+    /** Sample format of the RX stream. See bladerf_init_stream(). */
+    bladerf_format format;
+
+    /**
+     * Total number of buffers. This must exceed `num_transfers`, and
+     * should leave at least one buffer per worker beyond it.
+     */
+    unsigned int num_buffers;
+
+    /** Size of each buffer, in samples. Must be a multiple of 1024. */
+    unsigned int buffer_size;
+
+    /** Number of transfers kept in flight by the RX stream */
+    unsigned int num_transfers;
+
+    /**
+     * Number of worker threads, within
+     * [1, ::BLADERF_RX_PIPELINE_MAX_WORKERS]
+     */
+    unsigned int num_workers;
+
+    /** Work function. Required. */
+    bladerf_rx_pipeline_work_fn work;
+
+    /** Delivery function. May be NULL if results need not be ordered. */
+    bladerf_rx_pipeline_deliver_fn deliver;
+
+    /** Data passed to `work` and `deliver` */
+    void *user_data;
+};
+
+/** RX pipeline statistics */
+struct bladerf_rx_pipeline_stats {
+    /** Number of buffers processed and delivered */
+    uint64_t buffers;
+
+    /**
+     * Number of received buffers that were discarded because no free buffer
+     * was available to receive into
+     */
+    uint64_t dropped;
+
+    /** Number of buffers processed by a worker other than the one queued */
+    uint64_t stolen;
+
+    /** Largest time, in microseconds, from reception to delivery */
+    uint64_t latency_max_us;
+
+    /**
+     * Sum of the times, in microseconds, from reception to delivery. Divide
+     * by `buffers` to obtain the mean.
+     */
+    uint64_t latency_total_us;
+};
+
+/** Opaque handle to a running RX pipeline */
+struct bladerf_rx_pipeline;
+
+/**
+ * Start the workers, enable the RX module, and start processing received
+ * buffers
  *
- * While increasing the number of buffers available provides additional
- * elasticity, be aware that it also increases latency.
+ * @param[in]   dev         Device handle
+ * @param[in]   config      Pipeline configuration
+ * @param[out]  pipeline    Updated with a handle to the running pipeline
  *
- * @param[out]  stream          Upon success, this will be updated to contain
- *                              a stream handle (i.e., address)
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL on invalid configuration values,
+ *         or a value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_rx_pipeline_start(
+                                struct bladerf *dev,
+                                const struct bladerf_rx_pipeline_config *config,
+                                struct bladerf_rx_pipeline **pipeline);
+
+/**
+ * Retrieve a running pipeline's statistics
  *
- * @param[in]   dev             Device to associate with the stream
+ * @param[in]   pipeline    Pipeline handle
+ * @param[out]  stats       Updated with the current statistics
  *
- * @param[in]   callback        Callback routine to handle asynchronous events
+ * @return 0 on success, BLADERF_ERR_INVAL on invalid parameters
+ */
+API_EXPORT
+int CALL_CONV bladerf_rx_pipeline_get_stats(
+                                struct bladerf_rx_pipeline *pipeline,
+                                struct bladerf_rx_pipeline_stats *stats);
+
+/**
+ * Stop receiving, wait for the workers to process and deliver the buffers
+ * already received, disable the RX module, and deallocate the handle
  *
- * @param[out]  buffers         This will be updated to point to a dynamically
- *                              allocated array of buffer pointers.
+ * @param[in]   pipeline    Pipeline handle. May be NULL.
  *
- * @param[in]   num_buffers     Number of buffers to allocate and return. This
- *                              value must >= the `num_transfers` parameter.
+ * @return 0 on success, or the error that ended the RX stream
+ */
+API_EXPORT
+int CALL_CONV bladerf_rx_pipeline_stop(struct bladerf_rx_pipeline *pipeline);
+
+/** @} (End of FN_RX_PIPELINE) */
+
+/**
+ * @defgroup FN_BW_PROBE  USB bandwidth probe
  *
- * @param[in]   format          Sample data format
+ * These functions measure the throughput and latency that the host and its
+ * USB connection sustain, with the RF front end and FPGA out of the picture.
  *
- * @param[in]   samples_per_buffer  Size of allocated buffers, in units of
- *                                  samples Note that the physical size of the
- *                                  buffer is a function of this and the format
- *                                  parameter.
+ * The device is placed in ::BLADERF_LB_FIRMWARE loopback mode, such that the
+ * FX3 returns each buffer it receives from the host over the RX endpoint.
+ * Samples are then streamed through the synchronous interface in both
+ * directions at once, as fast as the host, USB link, and FX3 allow. Marker
+ * samples inserted into the transmitted stream are located in the received
+ * stream to measure the round-trip latency of the configured buffering.
  *
- * @param[in]   num_transfers   Maximum number of transfers that may be
- *                              in-flight simultaneously. This must be <= the
- *                              `num_buffers` parameter.
+ * Deployments may compare the reported `samples_per_sec` against the sample
+ * rate they intend to use, with the same stream parameters.
  *
- * @param[in]   user_data       Caller-provided data that will be provided
- *                              in stream callbacks
+ * @{
+ */
+
+/** Bandwidth probe configuration */
+struct bladerf_bandwidth_probe_config {
+    /**
+     * Sample format to stream. Any format supported by bladerf_sync_config()
+     * may be used, other than ::BLADERF_FORMAT_PSD_U32 and the CF32 formats.
+     */
+    bladerf_format format;
+
+    /** Number of buffers, as passed to bladerf_sync_config() */
+    unsigned int num_buffers;
+
+    /** Size of each buffer, in samples, as passed to bladerf_sync_config() */
+    unsigned int buffer_size;
+
+    /** Number of transfers, as passed to bladerf_sync_config() */
+    unsigned int num_transfers;
+
+    /** Stream and synchronous call timeout, in milliseconds */
+    unsigned int timeout_ms;
+
+    /**
+     * Time to measure for, in milliseconds. This excludes the time taken to
+     * start the streams and for the first samples to be returned.
+     */
+    unsigned int duration_ms;
+};
+
+/** Bandwidth probe results */
+struct bladerf_bandwidth_probe_results {
+    /** Length of the measurement, in microseconds */
+    uint64_t elapsed_us;
+
+    /**
+     * Number of bytes transmitted and received over USB during the
+     * measurement, including any metadata headers
+     */
+    uint64_t tx_bytes;
+    uint64_t rx_bytes;      /**< See `tx_bytes` */
+
+    /** Average USB throughput over the measurement, in bytes per second */
+    uint64_t tx_bytes_per_sec;
+    uint64_t rx_bytes_per_sec;  /**< See `tx_bytes_per_sec` */
+
+    /**
+     * Highest sample rate, in the configured format, that was sustained in
+     * both directions at once
+     */
+    uint64_t samples_per_sec;
+
+    /** Number of markers whose round-trip latency was measured */
+    uint64_t markers;
+
+    /**
+     * Number of transmitted markers that were not received, after the first
+     * was. This indicates samples were lost in the loopback path.
+     */
+    uint64_t markers_lost;
+
+    /**
+     * Smallest and largest round-trip latency, in microseconds, from a
+     * marker being passed to bladerf_sync_tx() to its return from
+     * bladerf_sync_rx(). 0 if no markers were received.
+     */
+    uint64_t latency_min_us;
+    uint64_t latency_max_us;    /**< See `latency_min_us` */
+
+    /**
+     * Sum of the round-trip latencies, in microseconds. Divide by `markers`
+     * to obtain the mean.
+     */
+    uint64_t latency_total_us;
+
+    /**
+     * Histogram of the round-trip latencies, binned as described for
+     * ::BLADERF_STREAM_STATS_HIST_LEN
+     */
+    uint64_t latency_hist[BLADERF_STREAM_STATS_HIST_LEN];
+};
+
+/**
+ * Measure the sustainable USB throughput and latency of the stream
+ * configuration described by `config`.
  *
+ * This reconfigures the synchronous interfaces of both modules, and enables
+ * and then disables both modules. The loopback mode in effect beforehand is
+ * restored afterwards. The synchronous and asynchronous interfaces must not
+ * otherwise be in use while the probe runs.
  *
- * @note  This call should be later followed by a call to
- *        bladerf_deinit_stream() to avoid memory leaks.
+ * @param[in]   dev         Device handle
+ * @param[in]   config      Probe configuration
+ * @param[out]  results     Updated with the measurements
  *
  * @return 0 on success,
- *          value from \ref RETCODES list on failure
+ *         BLADERF_ERR_INVAL on invalid configuration values,
+ *         BLADERF_ERR_UPDATE_FW if the firmware does not support firmware
+ *         loopback,
+ *         or a value from \ref RETCODES list on other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_init_stream(struct bladerf_stream **stream,
-                                  struct bladerf *dev,
-                                  bladerf_stream_cb callback,
-                                  void ***buffers,
-                                  size_t num_buffers,
-                                  bladerf_format format,
-                                  size_t samples_per_buffer,
-                                  size_t num_transfers,
-                                  void *user_data);
+int CALL_CONV bladerf_bandwidth_probe(
+                            struct bladerf *dev,
+                            const struct bladerf_bandwidth_probe_config *config,
+                            struct bladerf_bandwidth_probe_results *results);
+
+/** @} (End of FN_BW_PROBE) */
 
 /**
- * Begin running a stream. This call will block until the steam completes.
- *
- * Only 1 RX stream and 1 TX stream may be running at a time. Attempting to
- * call bladerf_stream() with more than one stream per module will yield
- * unexpected (and most likely undesirable) results. See the ::bladerf_stream_cb
- * description for additional thread-safety caveats.
+ * @defgroup FN_PATTERN  RX test pattern verification
  *
- * @pre This function should be preceded by a call to bladerf_enable_module()
- *      to enable the associated RX or TX module before attempting to use
- *      it to stream data.
+ * These functions check received samples that carry one of the FPGA's test
+ * patterns (see bladerf_set_rx_mux()), and count the samples that were
+ * corrupted, dropped, or duplicated on their way to the application. This
+ * covers the whole path from the FPGA's RX FIFO, through the FX3 and USB, to
+ * the library's buffers.
  *
- * @param   stream  A stream handle that has been successfully been initialized
- *                  via bladerf_init_stream()
+ * Samples the library drops on an overrun are counted in the `resubmissions`
+ * field of bladerf_get_stream_stats(). Comparing those counts with the
+ * `dropped` count of a check tells losses on the host apart from losses
+ * upstream of it.
  *
- * @param   module  Module to perform streaming with
+ * Checks run with SSE2 or NEON when the host supports them, and verify every
+ * sample at well above the maximum sample rate on a single core.
  *
- * @return  0 on success, value from \ref RETCODES list on failure
+ * @{
  */
-API_EXPORT
-int CALL_CONV bladerf_stream(struct bladerf_stream *stream,
-                             bladerf_module module);
+
+/** Test patterns that may be checked */
+typedef enum {
+    /**
+     * Incrementing 32-bit counter, as produced by
+     * ::BLADERF_RX_MUX_32BIT_COUNTER
+     */
+    BLADERF_PATTERN_COUNTER,
+
+    /**
+     * Pseudorandom sequence, as produced by ::BLADERF_RX_MUX_PRBS. Each
+     * 32-bit word `x` is followed by the result of `x ^= x << 13`,
+     * `x ^= x >> 17`, `x ^= x << 5`.
+     */
+    BLADERF_PATTERN_PRBS,
+} bladerf_pattern;
 
 /**
- * Submit a buffer to a stream from outside of a stream callback function.
- * Use this only when returning BLADERF_STREAM_NO_DATA from callbacks. <b>Do
- * not</b> use this function if the associated callback functions will be
- * returning buffers for submission.
- *
- * This call may block if the device is not ready to submit a buffer for
- * transfer. Use the `timeout_ms` to place an upper limit on the time this
- * function can block.
- *
- * To safely submit buffers from outside the stream callback flow, this function
- * internally acquires a per-stream lock (the same one that is held during the
- * execution of a stream callback). Therefore, it is important to be aware of
- * locks that may be held while making this call, especially those acquired
- * during execution of the associated stream callback function. (i.e., be wary
- * of the order of lock acquisitions, including the internal per-stream lock.)
- *
- * @param   stream      Stream to submit buffer to
- * @param   buffer      Buffer to fill (RX) or containing data (TX). This buffer
- *                      is assumed to be the size specified in the associated
- *                      bladerf_init_stream() call.
- * @param   timeout_ms  Milliseconds to timeout in, if this call blocks. 0
- *                      implies an "infinite" wait.
- *
- * @return  0 on success, BLADERF_ERR_TIMEOUT upon a timeout, or a value from
- * \ref RETCODES list on other failures
+ * Default for the largest gap, in samples, that a check attributes to
+ * dropped samples. See bladerf_pattern_check::max_gap.
  */
-API_EXPORT
-int CALL_CONV bladerf_submit_stream_buffer(struct bladerf_stream *stream,
-                                           void *buffer,
-                                           unsigned int timeout_ms);
+#define BLADERF_PATTERN_MAX_GAP_DEFAULT (1 << 18)
 
 /**
- * Deinitialize and deallocate stream resources.
+ * Test pattern check state and counts
  *
- * @pre    Stream is no longer being used (via bladerf_submit_stream_buffer() or
- *          bladerf_stream() calls.)
- * @post   Stream is deallocated and may no longer be used.
+ * Each sample is the 32-bit word whose low 16 bits are carried in I and high
+ * 16 bits in Q. A sample is expected to follow its predecessor in the
+ * pattern. Otherwise, it is classified as follows:
  *
- * @param   stream      Stream to deinitialize. This function does nothing
- *                      if stream is NULL.
+ *  - A sample equal to its predecessor is a duplicate.
+ *  - A sample that lies up to `max_gap` words further along the pattern
+ *    follows a gap of dropped samples. For ::BLADERF_PATTERN_PRBS, this is
+ *    only known once the next sample continues the pattern from it, so a
+ *    gap in the last sample of a stream is counted as an error.
+ *  - Any other sample is an error. A corrupted sample is counted once, as
+ *    the check expects the one after it to continue the pattern from where
+ *    it should have been. Should the samples instead continue from the
+ *    erroneous one, the check resynchronizes to them.
+ *
+ * Structures must be initialized with bladerf_pattern_check_init(). The
+ * counts may be read at any time, and cleared by the caller.
  */
-API_EXPORT
-void CALL_CONV bladerf_deinit_stream(struct bladerf_stream *stream);
+struct bladerf_pattern_check {
+    bladerf_pattern pattern;    /**< Pattern to check */
+
+    /**
+     * Largest gap to attribute to dropped samples. Finding a gap in the
+     * ::BLADERF_PATTERN_PRBS pattern takes a step per sample of the gap. It
+     * is only searched for once the samples that follow a gap confirm it, so
+     * this costs up to this many steps per discontinuity in the pattern,
+     * but nothing for samples that are simply erroneous.
+     */
+    unsigned int max_gap;
+
+    uint64_t samples;           /**< Total number of samples checked */
+    uint64_t errors;            /**< Number of erroneous samples */
+    uint64_t gaps;              /**< Number of gaps of dropped samples */
+    uint64_t dropped;           /**< Total number of samples in those gaps */
+    uint64_t duplicates;        /**< Number of duplicated samples */
+
+    /* Internal state, which must not be modified by the caller */
+    bool synced;
+    bool resync;
+    uint32_t last;
+    uint32_t resync_from;
+    uint32_t resync_last;
+};
 
 /**
- * Set stream transfer timeout in milliseconds
+ * Initialize a check for the specified pattern, with zeroed counts. The
+ * first sample checked afterwards is taken as the start of the pattern.
  *
- * @param   dev         Device handle
- * @param   module      Module to adjust
- * @param   timeout     Timeout in milliseconds
+ * @param[out]  check       Check state to initialize
+ * @param[in]   pattern     Pattern to check
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 on success, BLADERF_ERR_INVAL for an invalid pattern
  */
 API_EXPORT
-int CALL_CONV bladerf_set_stream_timeout(struct bladerf *dev,
-                                         bladerf_module module,
-                                         unsigned int timeout);
-
+int CALL_CONV bladerf_pattern_check_init(struct bladerf_pattern_check *check,
+                                         bladerf_pattern pattern);
 
 /**
- * Get transfer timeout in milliseconds
+ * Check a buffer of samples, carrying on from the samples checked before it,
+ * and update the check's counts.
  *
- * @param[in]   dev         Device handle
- * @param[in]   module      Module to adjust
- * @param[out]  timeout     On success, updated with current transfer
- *                          timeout value. Undefined on failure.
+ * @param       check       Check state
+ * @param[in]   samples     Samples, in the ::BLADERF_FORMAT_SC16_Q11 format.
+ *                          When using ::BLADERF_FORMAT_SC16_Q11_META, pass
+ *                          a message's payload.
+ * @param[in]   num_samples Number of samples
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return Number of samples that were erroneous, duplicated, or followed a
+ *         gap in this buffer. 0 indicates the buffer continued the pattern
+ *         without fault.
  */
 API_EXPORT
-int CALL_CONV bladerf_get_stream_timeout(struct bladerf *dev,
-                                         bladerf_module module,
-                                         unsigned int *timeout);
+uint64_t CALL_CONV bladerf_pattern_check(struct bladerf_pattern_check *check,
+                                         const int16_t *samples,
+                                         unsigned int num_samples);
 
-/** @} (End of FN_DATA_ASYNC) */
+/** @} (End of FN_PATTERN) */
 
 /**
- * @defgroup FN_DATA_SYNC  Synchronous data transmission and reception
+ * @defgroup FN_MULTI  Multi-device synchronized streaming
  *
- * This group of functions presents synchronous, blocking calls (with optional
- * timeouts) for transmitting and receiving samples.
+ * These functions stream with several devices at once, such that sample `n`
+ * of every device's stream was received (or is transmitted) at the same
+ * instant. Samples from all devices are exchanged through a single
+ * synchronous interface, interleaved by device.
  *
- * The synchronous interface is built atop the asynchronous interface, and is
- * generally less complex and easier to work with.  It alleviates the need to
- * explicitly spawn threads (it is done under the hood) and manually manage
- * sample buffers.
+ * For the devices to remain aligned once started, they must share a sample
+ * clock. bladerf_multi_init() can configure the first device to drive its
+ * reference clock over the MIMO clock connector, and the remaining devices to
+ * use it. All devices should be configured with the same sample rate before
+ * the session is started.
  *
- * Under the hood, this interface spawns worker threads to handle an
- * asynchronous stream and perform thread-safe buffer management.
+ * The start of a session is scheduled for a common point in the near future,
+ * using the ::BLADERF_FORMAT_SC16_Q11_META format on each device:
  *
- * These functions are thread-safe.
+ *  - With ::BLADERF_MULTI_ALIGN_TIMESTAMP, every device is started at the
+ *    same timestamp. This is sample-accurate, provided the devices'
+ *    timestamp counters are known to be aligned, such as by resetting them
+ *    all on the same 1PPS edge with bladerf_config_time_latch().
  *
- * <H3>RX and TX without metadata </H3>
- * Below is the general process for using this interface to transmit and receive
- * SC16 Q11 samples, without metadata.
+ *  - With ::BLADERF_MULTI_ALIGN_HOST_CLOCK, each device's timestamp counter is
+ *    correlated with the host's clock (see
+ *    bladerf_enable_timestamp_correlation()), and each device is started at
+ *    the timestamp corresponding to the same host time. The alignment is then
+ *    limited by the uncertainty of these correlations, reported by
+ *    bladerf_multi_get_start(), which is typically tens of microseconds.
+ *    As the devices share a clock, any residual offset remains constant, and
+ *    may be measured and removed by the application.
  *
- * @snippet sync_rxtx.c example_snippet
+ * @{
+ */
+
+/** MIMO clock configuration */
+typedef enum {
+    BLADERF_MIMO_SLAVE,     /**< Use the clock provided by the master */
+    BLADERF_MIMO_MASTER,    /**< Provide this device's clock to slaves */
+} bladerf_mimo_mode;
+
+/**
+ * Configure a device to provide or use a reference clock over the MIMO clock
+ * connector.
  *
- * To run in a half-duplex mode of operation, simply remove the RX or TX
- * specific portions from the above example.
+ * @param   dev     Device handle
+ * @param   mode    MIMO clock mode
  *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_mimo_mode(struct bladerf *dev,
+                                    bladerf_mimo_mode mode);
+
+/** Method used to align the start of a multi-device session */
+typedef enum {
+    /** Start each device at the same host time, via timestamp correlation */
+    BLADERF_MULTI_ALIGN_HOST_CLOCK,
+
+    /** Start each device at the same timestamp */
+    BLADERF_MULTI_ALIGN_TIMESTAMP,
+} bladerf_multi_align;
+
+/** Multi-device session configuration */
+struct bladerf_multi_config {
+    /** Module to stream with on every device */
+    bladerf_module module;
+
+    /** Number of buffers used by each device's stream */
+    unsigned int num_buffers;
+
+    /** Size of each buffer, in samples. Must be a multiple of 1024. */
+    unsigned int buffer_size;
+
+    /** Number of transfers kept in flight by each device's stream */
+    unsigned int num_transfers;
+
+    /** Per-device stream timeout, in milliseconds */
+    unsigned int stream_timeout;
+
+    /**
+     * Configure the first device as the MIMO clock master, and all others as
+     * slaves. Set this to false if clocking has been configured otherwise.
+     */
+    bool mimo_clock;
+
+    /** Method used to align the devices' start times */
+    bladerf_multi_align align;
+
+    /**
+     * Time from bladerf_multi_start() to the start of the session, in
+     * milliseconds. When transmitting, the first samples should be provided
+     * within this time. If 0, a default of 100 ms is used.
+     */
+    unsigned int start_delay_ms;
+};
+
+/** Opaque handle to a multi-device session */
+struct bladerf_multi;
+
+/**
+ * Create a multi-device session, configuring clocking and arming each
+ * device's stream. Samples do not begin flowing until bladerf_multi_start()
+ * is called.
  *
- * <H3>RX with metadata</H3>
- * By using the ::BLADERF_FORMAT_SC16_Q11_META format with the synchronous
- * interface, one can read the timestamp associated with a received buffer of
- * data, or schedule to read a specific number of samples at a desired
- * timestamp.  Additionally, the metadata indicates if an overrun was detected,
- * and the number of samples actually copied into the buffer before the
- * discontinuity caused by the overrun.
+ * The devices must not otherwise be used for streaming with the session's
+ * module until it is deinitialized.
  *
- * @snippet sync_rx_meta.c example_snippet
+ * @param[out]  multi       Updated with a session handle
+ * @param[in]   devs        Device handles. The first device is the MIMO clock
+ *                          master if `mimo_clock` is set.
+ * @param[in]   num_devs    Number of entries in `devs`
+ * @param[in]   config      Session configuration
  *
- * <H3>TX with metadata</H3>
- * Using the synchronous interface with the ::BLADERF_FORMAT_SC16_Q11_META
- * format allows for bursts of samples to be scheduled for transmissions.
- * Between these bursts, the device transmits I=0, Q=0.
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL on invalid parameters,
+ *         BLADERF_ERR_UPDATE_FPGA if a device's FPGA does not support
+ *         timestamps,
+ *         or a value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_multi_init(struct bladerf_multi **multi,
+                                 struct bladerf *const *devs,
+                                 unsigned int num_devs,
+                                 const struct bladerf_multi_config *config);
+
+/**
+ * Schedule the start of the session, `start_delay_ms` from now
  *
- * To begin a burst, call bladerf_sync_tx() with the metadata's
- * ::BLADERF_META_FLAG_TX_BURST_START flag set, the desired timestamp set in the
- * bladerf_metadata structure, and any number of samples.
+ * @param   multi       Session handle
  *
- * You may then continue calling bladerf_sync_tx(), without needing to update
- * the timestamp field in the bladerf_metadata structure. For these calls,
- * no flags should be set.
+ * @return 0 on success, BLADERF_ERR_INVAL if the session was already started,
+ *         or a value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_multi_start(struct bladerf_multi *multi);
+
+/**
+ * Retrieve the timestamp at which a device's stream starts
  *
- * On the final bladerf_sync_tx() call for the burst, set the
- * ::BLADERF_META_FLAG_TX_BURST_END flag, and ensure the final two samples
- * provided to this function are 0.
+ * Instead of using bladerf_multi_rx(), an application may read each device's
+ * samples with bladerf_sync_rx(), from this timestamp onwards. This allows
+ * each device to be read from its own thread. bladerf_multi_rx() must then
+ * not be used with the session.
  *
- * It is valid to send the entire burst with a single function call, with both
- * flags set.
+ * @param[in]   multi           Session handle
+ * @param[in]   index           Index of the device, in the array provided to
+ *                              bladerf_multi_init()
+ * @param[out]  timestamp       Start timestamp, in terms of the device's
+ *                              counter
+ * @param[out]  uncertainty_us  If not NULL, updated with the uncertainty of
+ *                              this device's alignment, in microseconds.
+ *                              This is 0 when aligning by timestamp.
  *
- * @snippet sync_tx_meta.c example_snippet
+ * @return 0 on success, BLADERF_ERR_INVAL if the session has not been started
+ *         or `index` is invalid
+ */
+API_EXPORT
+int CALL_CONV bladerf_multi_get_start(struct bladerf_multi *multi,
+                                      unsigned int index,
+                                      uint64_t *timestamp,
+                                      double *uncertainty_us);
+
+/**
+ * Receive time-aligned samples from every device in a session
+ *
+ * Samples are interleaved by device: each SC16 Q11 sample of the first
+ * device is followed by the sample of the second device received at the same
+ * instant, and so on.
+ *
+ * If any device dropped samples, the affected region is skipped on all
+ * devices so that they remain aligned. In this case, the
+ * ::BLADERF_META_STATUS_OVERRUN status flag is set, `actual_count` reports
+ * the number of samples per device that are valid, and `dropped_samples`
+ * reports the number of samples per device that were skipped.
+ *
+ * @param[in]   multi       Session handle
+ * @param[out]  samples     Buffer of `num_samples * num_devs` samples
+ * @param[in]   num_samples Number of samples to receive from each device
+ * @param[out]  metadata    If not NULL, updated with the status of the
+ *                          read. Its `timestamp` is set to the index of the
+ *                          first sample since the start of the session.
+ * @param[in]   timeout_ms  Timeout for each device's read, in milliseconds.
+ *                          Zero implies "infinite."
  *
- * @{
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if the session is not started or not for RX,
+ *         or a value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_multi_rx(struct bladerf_multi *multi,
+                               int16_t *samples,
+                               unsigned int num_samples,
+                               struct bladerf_metadata *metadata,
+                               unsigned int timeout_ms);
+
+/**
+ * Transmit time-aligned samples on every device in a session
+ *
+ * Samples are interleaved by device, as described for bladerf_multi_rx().
+ * The first call transmits the first samples at the start of the session,
+ * and each later call continues where the previous one ended.
+ *
+ * @param[in]   multi       Session handle
+ * @param[in]   samples     Buffer of `num_samples * num_devs` samples
+ * @param[in]   num_samples Number of samples to transmit on each device
+ * @param[in]   metadata    May be NULL. If provided with the
+ *                          ::BLADERF_META_FLAG_TX_BURST_END flag, the session
+ *                          ends after these samples, and no further samples
+ *                          may be transmitted.
+ * @param[in]   timeout_ms  Timeout for each device's write, in milliseconds.
+ *                          Zero implies "infinite."
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if the session is not started, not for TX, or
+ *         has ended, or a value from \ref RETCODES list on other failures
  */
+API_EXPORT
+int CALL_CONV bladerf_multi_tx(struct bladerf_multi *multi,
+                               const int16_t *samples,
+                               unsigned int num_samples,
+                               struct bladerf_metadata *metadata,
+                               unsigned int timeout_ms);
 
 /**
- * (Re)Configure a device for synchronous transmission or reception
- *
- * This function sets up the device for the specified format and initializes
- * the underlying asynchronous stream parameters
+ * End a session, disable each device's module, and free the session
  *
- * This function does not call bladerf_enable_module(). The API user is
- * responsible for enabling/disable modules when desired.
+ * @param   multi       Session handle. May be NULL.
+ */
+API_EXPORT
+void CALL_CONV bladerf_multi_deinit(struct bladerf_multi *multi);
+
+/** @} (End of FN_MULTI) */
+
+/**
+ * @defgroup FN_NET  Network access
  *
- * Note that (re)configuring ::BLADERF_MODULE_TX does not affect the
- * ::BLADERF_MODULE_RX modules, and vice versa. This call configures each module
- * independently.
+ * A device may be served to other hosts with bladerf_net_serve(), or with
+ * bladeRF-cli's `serve` command. Remote devices are then opened with the
+ * "net" backend, the same as a local device, e.g., `"net:"` or
+ * `"net:instance=1"`.
  *
- * Memory allocated by this function will be deallocated when bladerf_close()
- * is called.
+ * Servers are specified by the `BLADERF_NET_SERVER` environment variable, as
+ * a comma-separated list of `host[:port]` entries (IPv6 addresses are
+ * written as `[address]:port`). The `instance` of a device is its server's
+ * position in this list. As remote devices cannot be told apart from the
+ * device identifier alone, this backend is only used when it is explicitly
+ * requested.
  *
- * See the bladerf_init_stream() documentation for information on determining
- * appropriate values for `buffers_size`, `num_transfers`, and `stream_timeout`.
- * The `num_buffers` parameter should generally be increased as the amount of
- * work done between bladerf_sync_rx() or bladerf_sync_tx() calls increases.
+ * Control requests are performed over one TCP connection, and each stream
+ * uses a connection of its own. The latency of these connections adds to
+ * every control request, so applications should favor the batched and
+ * cached interfaces where they matter. When the network cannot keep up
+ * with an RX stream, the server drops whole buffers, which are counted
+ * by bladerf_get_net_stats().
  *
- * @param   dev             Device to configure
+ * @{
+ */
+
+/**
+ * Statistics of a network backend connection
+ */
+struct bladerf_net_stats {
+    uint64_t requests;      /**< Control requests performed */
+    double rtt_mean_us;     /**< Mean round-trip time of control requests,
+                             *   in microseconds */
+    double rtt_min_us;      /**< Shortest round-trip time, in microseconds */
+    double rtt_max_us;      /**< Longest round-trip time, in microseconds */
+
+    uint64_t rx_frames;     /**< RX buffers received */
+    uint64_t rx_frames_lost;/**< RX buffers dropped by the server, or
+                             *   discarded for lack of a free buffer */
+    uint64_t rx_bytes;      /**< RX sample bytes received */
+    uint64_t tx_frames;     /**< TX buffers sent */
+    uint64_t tx_bytes;      /**< TX sample bytes sent */
+};
+
+/**
+ * Retrieve the statistics of a device opened with the network backend,
+ * accumulated since it was opened
  *
- * @param   module          Module to use with synchronous interface
+ * @param[in]   dev     Device handle
+ * @param[out]  stats   Updated with the current statistics
  *
- * @param   format          Format to use in synchronous data transfers
+ * @return 0 on success, ::BLADERF_ERR_UNSUPPORTED if the device was not
+ *         opened with the network backend
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_net_stats(struct bladerf *dev,
+                                    struct bladerf_net_stats *stats);
+
+/**
+ * Network server configuration, for bladerf_net_serve_with_config()
+ */
+struct bladerf_net_serve_config {
+    /** TCP port to listen on. 0 selects the default, 5910. */
+    uint16_t port;
+
+    /**
+     * Local address to listen on, e.g., "192.168.1.10". NULL listens on the
+     * loopback interface only, such that only clients on the local host may
+     * connect. "0.0.0.0" or "::" listen on all interfaces, which exposes the
+     * device to any host able to reach this one.
+     */
+    const char *address;
+
+    /**
+     * If non-NULL, listen on a Unix domain socket at this path instead of a
+     * TCP port. Clients list such a server in `BLADERF_NET_SERVER` by its
+     * path, which must begin with '/'. A stale socket left at this path is
+     * replaced.
+     */
+    const char *path;
+
+    /**
+     * Number of sessions to serve before returning. 0 serves sessions until
+     * the process is terminated.
+     */
+    unsigned int sessions;
+
+    /**
+     * Permit several clients to hold sessions at once, with each control
+     * request performed in turn. The modules are left as they are when
+     * sessions end, and clients may only stream TX samples, as the server is
+     * expected to distribute received samples via bladerf_rx_share_start().
+     *
+     * Each client keeps no cached LMS6002D register values in this mode, so
+     * that it sees changes made by the others.
+     */
+    bool shared;
+};
+
+/**
+ * Serve a device to network backend clients. This blocks until the
+ * specified number of sessions have ended.
  *
- * @param   num_buffers     The number of buffers to use in the underlying
- *                          data stream. This must be greater than the
- *                          `num_xfers` parameter.
+ * The server listens on the loopback interface only. Use
+ * bladerf_net_serve_with_config() to serve clients on other hosts.
  *
- * @param   buffer_size     The size of the underlying stream buffers, in
- *                          samples. This value must be a multiple of 1024.
- *                          Note that samples are only transferred when a buffer
- *                          of this size is filled.
+ * One client session is served at a time; others are refused until it
+ * ends. During a session, the device's settings are under the control of
+ * the client. At the end of each session, both modules are disabled, and
+ * the library's cached register state is discarded.
  *
- * @param   num_transfers   The number of active USB transfers that may be
- *                          in-flight at any given time. If unsure of what
- *                          to use here, try values of 4, 8, or 16.
+ * The device must not be streaming, and should not otherwise be used while
+ * it is being served.
  *
- * @param   stream_timeout  Timeout (milliseconds) for transfers in the
- *                          underlying data stream.
+ * @param   dev         Device handle
+ * @param   port        TCP port to listen on. 0 selects the default, 5910.
+ * @param   sessions    Number of sessions to serve before returning. 0
+ *                      serves sessions until the process is terminated.
  *
- * @return 0 on success,
- *         BLADERF_ERR_UNSUPPORTED if libbladeRF is not built with support
- *         for this functionality,
- *         or a value from \ref RETCODES list on failures.
+ * @return 0 on success, ::BLADERF_ERR_IO if the port could not be listened
+ *         on, ::BLADERF_ERR_INVAL if the listen address is invalid,
+ *         ::BLADERF_ERR_UNSUPPORTED if the library was built without the
+ *         network backend, or another BLADERF_ERR_* value on failure
  */
 API_EXPORT
-int CALL_CONV bladerf_sync_config(struct bladerf *dev,
-                                  bladerf_module module,
-                                  bladerf_format format,
-                                  unsigned int num_buffers,
-                                  unsigned int buffer_size,
-                                  unsigned int num_transfers,
-                                  unsigned int stream_timeout);
+int CALL_CONV bladerf_net_serve(struct bladerf *dev, uint16_t port,
+                                unsigned int sessions);
 
 /**
- * Transmit IQ samples.
+ * Serve a device to network backend clients, as bladerf_net_serve() does,
+ * with additional options
  *
- * Under the hood, this call starts up an underlying asynchronous stream as
- * needed. This stream can be stopped by disabling the TX module. (See
- * bladerf_enable_module for more details.)
+ * @param   dev         Device handle
+ * @param   config      Server configuration
  *
- * Samples will only be sent to the FPGA when a buffer have been filled. The
- * number of samples required to fill a buffer corresponds to the `buffer_size`
- * parameter passed to bladerf_sync_config().
+ * @return 0 on success, or a value listed for bladerf_net_serve()
+ */
+API_EXPORT
+int CALL_CONV bladerf_net_serve_with_config(
+                                struct bladerf *dev,
+                                const struct bladerf_net_serve_config *config);
+
+/** @} (End of FN_NET) */
+
+/**
+ * @defgroup FN_RX_SHARE  Shared-memory RX distribution
  *
- * @param[in]   dev         Device handle
+ * These functions allow received samples to be consumed by several
+ * processes at once. The process that owns the device publishes them with
+ * bladerf_rx_share_start(), into a ring of slots in a named POSIX shared
+ * memory object, and other processes read them with bladerf_rx_share_open()
+ * and bladerf_rx_share_read(), without opening the device.
  *
- * @param[in]   samples     Array of samples
+ * Readers are handed pointers into the ring, rather than copies. Each reader
+ * has its own position in the ring, and the publisher never waits for
+ * readers; a reader that falls a full ring behind skips ahead, and the
+ * first slot it reads afterwards has ::BLADERF_META_STATUS_OVERRUN set.
+ * A slot may also be overwritten while a slow reader still holds it, which
+ * is reported when the reader releases it with bladerf_rx_share_release().
  *
- * @param[in]   num_samples Number of samples to write
+ * The device's settings may be controlled by the readers via
+ * bladerf_net_serve_with_config(), in its shared mode, listening on a Unix
+ * domain socket. bladeRF-cli's `serve` command provides such a daemon.
  *
- * @param[in]   metadata    Sample metadata. This must be provided when using
- *                          the ::BLADERF_FORMAT_SC16_Q11_META format, but may
- *                          be NULL when the interface is configured for
- *                          the ::BLADERF_FORMAT_SC16_Q11 format.
+ * These functions are only available on Linux.
  *
- * @param[in]   timeout_ms  Timeout (milliseconds) for this call to complete.
- *                          Zero implies "infinite."
+ * @{
+ */
+
+/** RX share configuration */
+struct bladerf_rx_share_config {
+    /** Number of slots in the ring. Must be a power of two, at least 2. */
+    unsigned int num_slots;
+
+    /** Size of each slot, in samples */
+    unsigned int slot_size;
+
+    /** Number of buffers used by the sync interface. See bladerf_sync_config(). */
+    unsigned int num_buffers;
+
+    /**
+     * Size of the sync interface's buffers, in samples. See
+     * bladerf_sync_config().
+     */
+    unsigned int buffer_size;
+
+    /** Number of transfers in flight. See bladerf_sync_config(). */
+    unsigned int num_transfers;
+};
+
+/** Statistics of an RX share's publisher */
+struct bladerf_rx_share_stats {
+    /** Slots published */
+    uint64_t slots;
+
+    /** Slots preceded by a discontinuity in the received samples */
+    uint64_t overruns;
+
+    /** Attempts to fill a slot that timed out */
+    uint64_t timeouts;
+};
+
+/** A slot held by a reader */
+struct bladerf_rx_share_slot {
+    /**
+     * Interleaved SC16 Q11 samples. This points into the ring, and remains
+     * valid until the slot is released.
+     */
+    const int16_t *samples;
+
+    /** Number of samples (I, Q pairs) in the slot */
+    unsigned int num_samples;
+
+    /** Timestamp of the first sample */
+    uint64_t timestamp;
+
+    /**
+     * Status flags. ::BLADERF_META_STATUS_OVERRUN is set if samples were
+     * lost before this slot, by the device or by this reader.
+     */
+    uint32_t status;
+
+    /** Sequence number of the slot, incremented per slot (modulo 2^32) */
+    uint32_t seq;
+};
+
+/** Statistics of an RX share reader */
+struct bladerf_rx_share_reader_stats {
+    /** Slots read */
+    uint64_t slots_read;
+
+    /** Slots skipped because the reader fell a full ring behind */
+    uint64_t slots_lost;
+
+    /** Slots overwritten while they were held */
+    uint64_t slots_overwritten;
+};
+
+/** Opaque handle to an RX share's publisher */
+struct bladerf_rx_share;
+
+/** Opaque handle to an RX share reader */
+struct bladerf_rx_share_reader;
+
+/**
+ * Configure and enable the RX module, and start publishing received samples
+ * to a shared-memory ring
  *
- * @pre A bladerf_sync_config() call has been to configure the device for
- *      synchronous data transfer.
+ * The RX module must not otherwise be streaming while samples are
+ * published. Its settings may be changed at any time.
  *
- * @pre A call to bladerf_enable_module() should be made before attempting to
- *      transmit samples. Failing to do this may result in timeouts and other
- *      errors.
+ * @param[in]   dev     Device handle
+ * @param[in]   name    Name of the ring, e.g., "bladerf-rx". A ring of the
+ *                      same name that already exists is replaced.
+ * @param[in]   config  Ring and stream configuration
+ * @param[out]  share   Updated with a handle to the publisher
  *
  * @return 0 on success,
- *         BLADERF_ERR_UNSUPPORTED if libbladeRF is not built with support
- *         for this functionality,
- *         or a value from \ref RETCODES list on failures.
+ *         BLADERF_ERR_INVAL on an invalid name or configuration,
+ *         BLADERF_ERR_UPDATE_FPGA if the FPGA does not support timestamps,
+ *         BLADERF_ERR_UNSUPPORTED on platforms other than Linux,
+ *         or a value from \ref RETCODES list on other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_sync_tx(struct bladerf *dev,
-                              void *samples, unsigned int num_samples,
-                              struct bladerf_metadata *metadata,
-                              unsigned int timeout_ms);
+int CALL_CONV bladerf_rx_share_start(struct bladerf *dev, const char *name,
+                                 const struct bladerf_rx_share_config *config,
+                                 struct bladerf_rx_share **share);
 
 /**
- * Receive IQ samples.
+ * Retrieve a publisher's statistics
  *
- * Under the hood, this call starts up an underlying asynchronous stream as
- * needed. This stream can be stopped by disabling the RX module. (See
- * bladerf_enable_module for more details.)
+ * @param[in]   share   Publisher handle
+ * @param[out]  stats   Updated with the current statistics
  *
- * @param[in]   dev         Device handle
+ * @return 0 on success, BLADERF_ERR_INVAL on invalid parameters
+ */
+API_EXPORT
+int CALL_CONV bladerf_rx_share_get_stats(struct bladerf_rx_share *share,
+                                         struct bladerf_rx_share_stats *stats);
+
+/**
+ * Stop publishing, disable the RX module, and remove the ring. Readers are
+ * informed that it has ended once they have read its remaining slots.
  *
- * @param[out]  samples     Buffer to store samples in. The caller is
- *                          responsible for ensuring this buffer is sufficiently
- *                          large for the number of samples requested,
- *                          considering the size of the sample format being
- *                          used.
+ * @param   share   Publisher handle. May be NULL.
  *
- * @param[in]   num_samples Number of samples to read
+ * @return 0 on success, or the first RX error encountered
+ */
+API_EXPORT
+int CALL_CONV bladerf_rx_share_stop(struct bladerf_rx_share *share);
+
+/**
+ * Open a ring published by another process. Reading begins with the next
+ * slot published.
  *
- * @param[out]  metadata    Sample metadata. This must be provided when using
- *                          the ::BLADERF_FORMAT_SC16_Q11_META format, but may
- *                          be NULL when the interface is configured for
- *                          the ::BLADERF_FORMAT_SC16_Q11 format.
+ * @param[out]  reader  Updated with a reader handle
+ * @param[in]   name    Name of the ring
  *
- * @param[in]   timeout_ms  Timeout (milliseconds) for this call to complete.
- *                          Zero implies "infinite."
+ * @return 0 on success, BLADERF_ERR_NODEV if no ring of this name exists,
+ *         BLADERF_ERR_UNSUPPORTED on platforms other than Linux, or a value
+ *         from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_rx_share_open(struct bladerf_rx_share_reader **reader,
+                                    const char *name);
+
+/**
+ * Wait for the next slot, and hold it
  *
- * @pre A bladerf_sync_config() call has been to configure the device for
- *      synchronous data transfer.
+ * Any slot still held is released first. Slots should be released promptly,
+ * as the publisher does not wait for them.
  *
- * @pre A call to bladerf_enable_module() should be made before attempting to
- *      receive samples. Failing to do this may result in timeouts and other
- *      errors.
+ * @param[in]   reader      Reader handle
+ * @param[out]  slot        Updated with the slot's contents
+ * @param[in]   timeout_ms  Time to wait for a slot, in milliseconds. 0
+ *                          waits indefinitely.
+ *
+ * @return 0 on success, BLADERF_ERR_TIMEOUT, BLADERF_ERR_NODEV if the
+ *         publisher has stopped, or BLADERF_ERR_INVAL on invalid parameters
+ */
+API_EXPORT
+int CALL_CONV bladerf_rx_share_read(struct bladerf_rx_share_reader *reader,
+                                    struct bladerf_rx_share_slot *slot,
+                                    unsigned int timeout_ms);
+
+/**
+ * Release the slot held by the last bladerf_rx_share_read()
  *
+ * @param   reader  Reader handle
  *
- * @return 0 on success,
- *         BLADERF_ERR_UNSUPPORTED if libbladeRF is not built with support
- *         for this functionality,
- *         or a value from \ref RETCODES list on failures.
+ * @return true if the slot's samples were intact until now, or false if
+ *         the publisher overwrote them while they were held, in which case
+ *         any results derived from them should be discarded
  */
 API_EXPORT
-int CALL_CONV bladerf_sync_rx(struct bladerf *dev,
-                              void *samples, unsigned int num_samples,
-                              struct bladerf_metadata *metadata,
-                              unsigned int timeout_ms);
+bool CALL_CONV bladerf_rx_share_release(struct bladerf_rx_share_reader *reader);
+
+/**
+ * Retrieve a reader's statistics
+ *
+ * @param[in]   reader  Reader handle
+ * @param[out]  stats   Updated with the current statistics
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on invalid parameters
+ */
+API_EXPORT
+int CALL_CONV bladerf_rx_share_get_reader_stats(
+                                struct bladerf_rx_share_reader *reader,
+                                struct bladerf_rx_share_reader_stats *stats);
 
+/**
+ * Close a reader, releasing any slot it holds
+ *
+ * @param   reader  Reader handle. May be NULL.
+ */
+API_EXPORT
+void CALL_CONV bladerf_rx_share_close(struct bladerf_rx_share_reader *reader);
 
-/** @} (End of FN_DATA_SYNC) */
+/** @} (End of FN_RX_SHARE) */
 
 /**
  * @defgroup FN_INFO    Device info
@@ -1955,6 +6793,25 @@ int CALL_CONV bladerf_fw_version(struct bladerf *dev,
 API_EXPORT
 int CALL_CONV bladerf_is_fpga_configured(struct bladerf *dev);
 
+/**
+ * Get the duration of the most recent FPGA configuration, as measured by the
+ * device. This is the time from the start of programming until the final
+ * portion of the bitstream was written to the FPGA, and applies both to
+ * bladerf_load_fpga() and to FPGA autoloading from flash.
+ *
+ * This requires FX3 firmware v1.9.0 or later.
+ *
+ * @param       dev     Device handle
+ * @param[out]  ms      Configuration duration, in milliseconds
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if no FPGA configuration has
+ *         completed, BLADERF_ERR_UNSUPPORTED if the firmware does not support
+ *         this, or a value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_fpga_load_time(struct bladerf *dev,
+                                         unsigned int *ms);
+
 /**
  * Query FPGA version
  *
@@ -1994,31 +6851,91 @@ bladerf_dev_speed CALL_CONV bladerf_device_speed(struct bladerf *dev);
  * @note This will require a power cycle to take effect
  *
  * @param   dev         Device handle
- * @param   firmware    Full path to firmware file
+ * @param   firmware    Full path to firmware file
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_flash_firmware(struct bladerf *dev,
+                                     const char *firmware);
+
+/**
+ * Load device's FPGA. Note that this FPGA configuration will be reset
+ * at the next power cycle.
+ *
+ * If the FPGA is already running the provided bitstream, as previously loaded
+ * by this function, the bitstream is not reloaded. The device is still
+ * reinitialized as it would be after a load. Set the BLADERF_FORCE_FPGA_LOAD
+ * environment variable to always reload the FPGA.
+ *
+ * Bitstreams generated with on-chip decompression enabled (see the `-z`
+ * option of the FPGA build script) are substantially smaller, and so are
+ * loaded more quickly. They are identified by being shorter than an
+ * uncompressed bitstream for the device's FPGA size, and require FX3
+ * firmware v1.10.0 or later.
+ *
+ * @param   dev         Device handle
+ * @param   fpga        Full path to FPGA bitstream
+ *
+ * @return 0 upon successfully, or a value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_load_fpga(struct bladerf *dev, const char *fpga);
+
+/**
+ * Load device's FPGA from a bitstream held in memory, such as one embedded in
+ * an application or read once for use with many devices. This otherwise
+ * behaves as bladerf_load_fpga().
+ *
+ * @param   dev         Device handle
+ * @param   buf         FPGA bitstream (RBF) contents. This is not modified.
+ * @param   len         Length of `buf`, in bytes
  *
- * @return 0 on success, value from \ref RETCODES list on failure
+ * @return 0 upon success, BLADERF_ERR_INVAL if the bitstream is invalid, or a
+ *         value from \ref RETCODES list on other failures
  */
 API_EXPORT
-int CALL_CONV bladerf_flash_firmware(struct bladerf *dev,
-                                     const char *firmware);
+int CALL_CONV bladerf_load_fpga_from_buffer(struct bladerf *dev,
+                                            const uint8_t *buf, size_t len);
 
 /**
- * Load device's FPGA. Note that this FPGA configuration will be reset
- * at the next power cycle.
+ * Load one FPGA bitstream, held in memory, into several devices concurrently.
  *
- * @param   dev         Device handle
- * @param   fpga        Full path to FPGA bitstream
+ * The bitstream is validated and identified once, and then shared by a load
+ * performed for each device in its own thread. The time taken is therefore
+ * bounded by the slowest device, rather than the sum of all of them. Each
+ * load behaves as bladerf_load_fpga_from_buffer().
  *
- * @return 0 upon successfully, or a value from \ref RETCODES list on failure
+ * This is intended for use with the list of handles produced by
+ * bladerf_open_many(), and skips any NULL entries.
+ *
+ * @param   devices     Array of `n` device handles. Entries may be NULL.
+ * @param   n           Number of entries in `devices`
+ * @param   buf         FPGA bitstream (RBF) contents. This is not modified.
+ * @param   len         Length of `buf`, in bytes
+ * @param   statuses    Optional array of `n` elements, updated with the
+ *                      result of each device's load. NULL entries in
+ *                      `devices` are reported as BLADERF_ERR_NODEV.
+ *                      May be NULL.
+ *
+ * @return Number of devices successfully loaded, BLADERF_ERR_INVAL if the
+ *         bitstream is invalid, or a value from \ref RETCODES list if the
+ *         loads could not be started
  */
 API_EXPORT
-int CALL_CONV bladerf_load_fpga(struct bladerf *dev, const char *fpga);
+int CALL_CONV bladerf_load_fpga_many(struct bladerf **devices, unsigned int n,
+                                     const uint8_t *buf, size_t len,
+                                     int *statuses);
 
 /**
  * Write the provided FPGA image to the bladeRF's SPI flash and enable FPGA
  * loading from SPI flash at power on (also referred to within this project as
  * FPGA "autoloading").
  *
+ * Only the flash occupied by the image is written, so a compressed bitstream
+ * (see bladerf_load_fpga()) is both written and autoloaded more quickly.
+ * Autoloading a compressed bitstream requires FX3 firmware v1.10.0 or later.
+ *
  * @param   dev         Device handle
  * @param   fpga_image  Full path to FPGA file
  *
@@ -2106,6 +7023,39 @@ void CALL_CONV bladerf_version(struct bladerf_version *version);
 API_EXPORT
 void CALL_CONV bladerf_log_set_verbosity(bladerf_log_level level);
 
+/**
+ * Log message callback
+ *
+ * @param   level       Severity level of the message
+ * @param   msg         Formatted message, including its level prefix and
+ *                      trailing newline. This is only valid for the
+ *                      duration of the callback.
+ * @param   user_data   User data provided to bladerf_log_set_callback()
+ */
+typedef void (*bladerf_log_callback)(bladerf_log_level level,
+                                     const char *msg, void *user_data);
+
+/**
+ * Deliver log messages to a callback, instead of writing them to stderr
+ * (or syslog, if enabled).
+ *
+ * When libbladeRF is built with ENABLE_LIBBLADERF_ASYNC_LOG, messages are
+ * queued by the thread that logs them and are delivered from a background
+ * thread. Otherwise, the callback is invoked from the thread that logged the
+ * message, which may be a stream's callback thread. Either way, the callback
+ * should not call back into libbladeRF.
+ *
+ * This should be called before any devices are opened, as messages logged
+ * concurrently with this call may be delivered to either output.
+ *
+ * @param   cb          Callback to invoke, or NULL to restore the default
+ *                      output
+ * @param   user_data   Caller-defined data passed to `cb`
+ */
+API_EXPORT
+void CALL_CONV bladerf_log_set_callback(bladerf_log_callback cb,
+                                        void *user_data);
+
 /** @} (End of FN_MISC) */
 
 /**
@@ -2312,6 +7262,93 @@ int CALL_CONV bladerf_image_write(struct bladerf_image *image,
 API_EXPORT
 int CALL_CONV bladerf_image_read(struct bladerf_image *image, const char *file);
 
+/**
+ * Image file that is written or read incrementally, such that a large image
+ * need not be held in memory, and file I/O may overlap flash accesses.
+ */
+struct bladerf_image_stream;
+
+/**
+ * Begin writing an image file incrementally. Exactly `image->length` bytes
+ * of data must then be provided via bladerf_image_stream_write(), and the
+ * file is completed, including its checksum, by bladerf_image_stream_close().
+ *
+ * @param[out]   stream     Updated to refer to the new stream
+ * @param[in]    image      Image metadata, as initialized by
+ *                          bladerf_alloc_image(). The `data` field is not
+ *                          used, and may be NULL.
+ * @param[in]    file       File to write the image to
+ *
+ * @return 0 upon success, BLADERF_ERR_INVAL if any image fields are invalid,
+ *         or a value from \ref RETCODES list on any other failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_image_stream_create(struct bladerf_image_stream **stream,
+                                          const struct bladerf_image *image,
+                                          const char *file);
+
+/**
+ * Begin reading an image file incrementally. The entire file is read once to
+ * verify its checksum, so that no data is provided from a corrupted image.
+ * The data is then provided via bladerf_image_stream_read().
+ *
+ * @param[out]   stream     Updated to refer to the new stream
+ * @param[out]   image      Updated with the image's metadata. Its `data`
+ *                          field is not modified.
+ * @param[in]    file       File to read the image from
+ *
+ * @return 0 upon success,<br>
+ *         BLADERF_ERR_CHECKSUM upon detecting a checksum mismatch,<br>
+ *         BLADERF_ERR_INVAL if any image fields are invalid,<br>
+ *         BLADERF_ERR_IO on a file I/O error,<br>
+ *         or a value from \ref RETCODES list on any other failure<br>
+ */
+API_EXPORT
+int CALL_CONV bladerf_image_stream_open(struct bladerf_image_stream **stream,
+                                        struct bladerf_image *image,
+                                        const char *file);
+
+/**
+ * Write the next portion of an image's data
+ *
+ * @param       stream      Stream created by bladerf_image_stream_create()
+ * @param[in]   data        Data to write
+ * @param[in]   len         Length of `data`, in bytes
+ *
+ * @return 0 upon success, BLADERF_ERR_INVAL if this exceeds the image's
+ *         length, or a value from \ref RETCODES list on any other failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_image_stream_write(struct bladerf_image_stream *stream,
+                                         const uint8_t *data, size_t len);
+
+/**
+ * Read the next portion of an image's data
+ *
+ * @param       stream      Stream opened by bladerf_image_stream_open()
+ * @param[out]  data        Buffer to read data into
+ * @param[in]   len         Number of bytes to read
+ *
+ * @return 0 upon success, BLADERF_ERR_INVAL if this exceeds the image's
+ *         length, or a value from \ref RETCODES list on any other failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_image_stream_read(struct bladerf_image_stream *stream,
+                                        uint8_t *data, size_t len);
+
+/**
+ * Close an image stream and free its resources. A stream that is being
+ * written is first completed by filling in its checksum.
+ *
+ * @param       stream      Image stream. This may be NULL.
+ *
+ * @return 0 upon success, BLADERF_ERR_INVAL if a stream being written was
+ *         provided less data than the image's length, or a value from
+ *         \ref RETCODES list if writing the stream failed
+ */
+API_EXPORT
+int CALL_CONV bladerf_image_stream_close(struct bladerf_image_stream *stream);
+
 /** @} (End of FN_IMAGE) */
 
 
@@ -2359,6 +7396,39 @@ API_EXPORT
 int CALL_CONV bladerf_si5338_write(struct bladerf *dev,
                                    uint8_t address, uint8_t val);
 
+/**
+ * A register access performed by bladerf_si5338_access() or
+ * bladerf_lms_access()
+ */
+struct bladerf_reg_access {
+    uint8_t address;    /**< Register address */
+    uint8_t value;      /**< Value to write, or the value read */
+    bool write;         /**< Write `value` to the register if true,
+                         *   otherwise read the register into `value` */
+};
+
+/**
+ * Perform a sequence of Si5338 register accesses, in order.
+ *
+ * Where supported by the backend, the accesses are sent to the device as a
+ * single batch, rather than waiting upon each one in turn. This is
+ * considerably faster than a series of bladerf_si5338_read() and
+ * bladerf_si5338_write() calls, particularly for devices accessed over a
+ * network.
+ *
+ * @param       dev     Device handle
+ * @param[inout] regs   Register accesses. The `value` field of each read is
+ *                      updated on success.
+ * @param       count   Number of entries in `regs`
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure. On failure,
+ *         it is unknown which of the accesses were performed.
+ */
+API_EXPORT
+int CALL_CONV bladerf_si5338_access(struct bladerf *dev,
+                                    struct bladerf_reg_access *regs,
+                                    unsigned int count);
+
 /**
  * Set frequency for TX clocks
  *
@@ -2402,6 +7472,44 @@ struct bladerf_lms_dc_cals
     int16_t rxvga2b_q;  /**< RX VGA2, Q channel of second gain stage */
 };
 
+/**
+ * Begin a batch of control operations.
+ *
+ * While a batch is open, writes to the LMS6002D are queued on the host rather
+ * than being sent to the device one request at a time. Reads are served from
+ * the library's copy of the register values where possible; any other read
+ * sends the queued writes first, as do bladerf_enable_module(), the
+ * scheduled retune and gain functions, and the closing of the batch. This
+ * greatly reduces the time taken by a sequence of configuration changes,
+ * such as setting a number of gains, filters, and corrections in turn.
+ *
+ * Writes to other peripherals (e.g., the Si5338, VCTCXO DAC, and FPGA
+ * registers) are not deferred, and may therefore take effect before
+ * LMS6002D writes that precede them. Errors from queued writes are reported
+ * by the call that sends them, and by bladerf_batch_end().
+ *
+ * Batches may be nested, in which case the writes are sent when the outermost
+ * batch is ended. A batch applies to all users of the device handle.
+ *
+ * @param   dev         Device handle
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_batch_begin(struct bladerf *dev);
+
+/**
+ * End a batch of control operations, sending any queued writes to the device
+ *
+ * @param   dev         Device handle
+ *
+ * @return 0 on success,
+ *         BLADERF_ERR_INVAL if no batch is open,
+ *         or the first error encountered sending the batch's writes
+ */
+API_EXPORT
+int CALL_CONV bladerf_batch_end(struct bladerf *dev);
+
 /**
  * Read a LMS register
  *
@@ -2428,6 +7536,28 @@ API_EXPORT
 int CALL_CONV bladerf_lms_write(struct bladerf *dev,
                                 uint8_t address, uint8_t val);
 
+/**
+ * Perform a sequence of LMS register accesses, in order, as with
+ * bladerf_si5338_access().
+ *
+ * As with bladerf_lms_read(), reads are always performed on the device,
+ * rather than being served from the library's copy of the register values.
+ * If the accesses are all writes and a batch is open, they are queued as
+ * described for bladerf_batch_begin().
+ *
+ * @param       dev     Device handle
+ * @param[inout] regs   Register accesses. The `value` field of each read is
+ *                      updated on success.
+ * @param       count   Number of entries in `regs`
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure. On failure,
+ *         it is unknown which of the accesses were performed.
+ */
+API_EXPORT
+int CALL_CONV bladerf_lms_access(struct bladerf *dev,
+                                 struct bladerf_reg_access *regs,
+                                 unsigned int count);
+
 /**
  * Manually load values into LMS6002 DC calibration registers.
  *
@@ -2495,6 +7625,15 @@ int CALL_CONV bladerf_lms_get_dc_cals(struct bladerf *dev,
  */
 #define BLADERF_GPIO_COUNTER_ENABLE (1 << 9)
 
+/**
+ * RX sample source, as a ::bladerf_rx_mux value
+ *
+ * @note This is set using bladerf_set_rx_mux(). ::BLADERF_GPIO_COUNTER_ENABLE
+ *       lies within this field.
+ */
+#define BLADERF_GPIO_RX_MUX_SHIFT   8
+#define BLADERF_GPIO_RX_MUX_MASK    (7 << BLADERF_GPIO_RX_MUX_SHIFT)
+
 /**
  * Switch to use RX low band (300M - 1.5GHz)
  *
@@ -2537,6 +7676,53 @@ int CALL_CONV bladerf_lms_get_dc_cals(struct bladerf *dev,
  * */
 #define BLADERF_GPIO_TIMESTAMP_DIV2 (1 << 17)
 
+/**
+ * RX decimation control. These bits hold log2 of the decimation factor.
+ *
+ * @note This is set using bladerf_set_decimation().
+ */
+#define BLADERF_GPIO_RX_DECIMATION_SHIFT    18
+#define BLADERF_GPIO_RX_DECIMATION_MASK     (7 << 18)
+
+/**
+ * TX interpolation control. These bits hold log2 of the interpolation factor.
+ *
+ * @note This is set using bladerf_set_decimation().
+ */
+#define BLADERF_GPIO_TX_INTERPOLATION_SHIFT 21
+#define BLADERF_GPIO_TX_INTERPOLATION_MASK  (7 << 21)
+
+/**
+ * Replace RX samples with averaged power spectra.
+ *
+ * @note The library will set this as needed when the
+ *       ::BLADERF_FORMAT_PSD_U32 format is used.
+ */
+#define BLADERF_GPIO_PSD                    (1 << 24)
+
+/**
+ * Power spectrum averaging control. These bits hold log2 of the number of
+ * frames averaged.
+ *
+ * @note This is set using bladerf_set_psd_averaging().
+ */
+#define BLADERF_GPIO_PSD_AVERAGING_SHIFT    25
+#define BLADERF_GPIO_PSD_AVERAGING_MASK     (0xf << 25)
+
+/**
+ * Enable the RX DC offset tracking loop.
+ *
+ * @note This is set using bladerf_set_rx_tracking().
+ */
+#define BLADERF_GPIO_RX_TRACK_DC            (1 << 11)
+
+/**
+ * Enable the RX IQ imbalance tracking loop.
+ *
+ * @note This is set using bladerf_set_rx_tracking().
+ */
+#define BLADERF_GPIO_RX_TRACK_IQ            (1 << 29)
+
 /**
  * Read a configuration GPIO register
  *
@@ -2562,7 +7748,8 @@ API_EXPORT
 int CALL_CONV bladerf_config_gpio_write(struct bladerf *dev, uint32_t val);
 
 /**
- * Read a expansion GPIO register
+ * Read a expansion GPIO register. This always samples the pins on the device,
+ * so that inputs are current.
  *
  * @param   dev         Device handle
  * @param   val         Pointer to variable the data should be read into
@@ -2624,6 +7811,172 @@ API_EXPORT
 int CALL_CONV bladerf_get_timestamp(struct bladerf *dev, bladerf_module mod,
                                     uint64_t *value);
 
+/**
+ * Timestamp correlation status, reported by
+ * bladerf_get_timestamp_correlation()
+ */
+struct bladerf_timestamp_correlation {
+    unsigned int num_points;    /**< Number of measurements the current
+                                 *   estimate is based upon */
+    double rate;                /**< Estimated rate of the timestamp counter,
+                                 *   in ticks per second of host time */
+    double drift_ppm;           /**< Deviation of `rate` from the nominal
+                                 *   sample rate, in parts per million */
+    double uncertainty_us;      /**< Uncertainty of the latest measurement
+                                 *   (half its round trip time), in us */
+};
+
+/**
+ * Start or stop tracking the relationship between the host's clock and a
+ * module's timestamp counter.
+ *
+ * While enabled, a background thread periodically reads the counter, and fits
+ * these readings against the host's monotonic clock. This allows
+ * bladerf_estimate_timestamp() to determine, without any device I/O, the
+ * timestamp corresponding to a point in time (e.g., for scheduling a TX burst
+ * a few milliseconds from now).
+ *
+ * An initial measurement is taken before this function returns. The fit is
+ * restarted automatically if the counter is observed to have been reset, or
+ * if the sample rate is changed.
+ *
+ * @param   dev         Device handle
+ * @param   module      Module whose timestamp counter should be tracked
+ * @param   interval_ms Period between measurements, in milliseconds. Specify
+ *                      0 to stop tracking.
+ *
+ * @return 0 on success, value from \ref RETCODES list on failure
+ */
+API_EXPORT
+int CALL_CONV bladerf_enable_timestamp_correlation(struct bladerf *dev,
+                                                   bladerf_module module,
+                                                   unsigned int interval_ms);
+
+/**
+ * Estimate the value that a module's timestamp counter has at a time relative
+ * to now, using the correlation enabled via
+ * bladerf_enable_timestamp_correlation().
+ *
+ * @param       dev         Device handle
+ * @param       module      Module to query
+ * @param       delta_us    Offset from now, in microseconds. Negative values
+ *                          refer to the past.
+ * @param[out]  timestamp   Estimated counter value
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if correlation is not enabled,
+ *         value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_estimate_timestamp(struct bladerf *dev,
+                                         bladerf_module module,
+                                         int64_t delta_us,
+                                         uint64_t *timestamp);
+
+/**
+ * Get the status of a module's timestamp correlation
+ *
+ * @param       dev         Device handle
+ * @param       module      Module to query
+ * @param[out]  info        Correlation status
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if correlation is not enabled
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_timestamp_correlation(struct bladerf *dev,
+                                bladerf_module module,
+                                struct bladerf_timestamp_correlation *info);
+
+/**
+ * Source of the edges seen by the timestamp latch
+ */
+typedef enum {
+    BLADERF_TIME_LATCH_1PPS,    /**< 1PPS reference input */
+    BLADERF_TIME_LATCH_J51_1,   /**< Mini expansion header, J51-1 */
+    BLADERF_TIME_LATCH_J51_2,   /**< Mini expansion header, J51-2 */
+    BLADERF_TIME_LATCH_XB_GPIO, /**< Expansion GPIO, configured as an input */
+} bladerf_time_latch_source;
+
+/**
+ * Action the timestamp latch performs on the next edge
+ */
+typedef enum {
+    BLADERF_TIME_LATCH_CAPTURE, /**< Capture the counters only */
+    BLADERF_TIME_LATCH_RESET,   /**< Capture the counters, then reset them
+                                 *   to 0 */
+    BLADERF_TIME_LATCH_LOAD,    /**< Capture the counters, then load them
+                                 *   with the configured value */
+} bladerf_time_latch_action;
+
+/**
+ * Timestamp latch configuration
+ */
+struct bladerf_time_latch_config {
+    bladerf_time_latch_source source;   /**< Edge source */
+    unsigned int xb_gpio;               /**< Expansion GPIO number, 1 to 32,
+                                         *   for ::BLADERF_TIME_LATCH_XB_GPIO */
+    bool falling_edge;                  /**< Use falling rather than rising
+                                         *   edges */
+    bool continuous;                    /**< Capture the counters on every
+                                         *   edge, not only the next one */
+    bladerf_time_latch_action action;   /**< Action on the next edge */
+    uint64_t load_value;                /**< Value loaded by
+                                         *   ::BLADERF_TIME_LATCH_LOAD */
+};
+
+/**
+ * Timestamp latch state
+ */
+struct bladerf_time_latch {
+    uint64_t rx_time;       /**< RX counter at the latest captured edge */
+    uint64_t tx_time;       /**< TX counter at the latest captured edge */
+    unsigned int edges;     /**< Number of edges captured, modulo 256 */
+    bool pending;           /**< The next edge has not arrived yet */
+};
+
+/**
+ * Configure the FPGA's timestamp latch, which captures the RX and TX
+ * timestamp counters on an edge of an external signal such as a 1PPS input.
+ * This arms the configured action. It is performed on the next edge, which
+ * is captured whether or not `continuous` is set.
+ *
+ * An edge is detected a fixed number of sample clocks after it occurs. This
+ * delay is the same on every device, so devices that share a sample clock
+ * and whose counters are reset or loaded on the same edge remain exactly
+ * aligned. A reset or load applies to both counters. It is a discontinuity
+ * for any stream on either module, so it is best armed before streaming.
+ *
+ * The counters only run while a module uses a metadata format, and so only
+ * then can they be captured, reset or loaded.
+ *
+ * This requires FPGA v0.1.24 or later.
+ *
+ * @param   dev         Device handle
+ * @param   config      Configuration
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on an invalid configuration,
+ *         BLADERF_ERR_UPDATE_FPGA if the FPGA does not support this feature,
+ *         or a value from \ref RETCODES list upon other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_config_time_latch(struct bladerf *dev,
+                            const struct bladerf_time_latch_config *config);
+
+/**
+ * Read the timestamp latch. Both counters and the edge count are read as
+ * one consistent snapshot.
+ *
+ * Polling until `edges` changes, or `pending` clears, waits for an edge.
+ *
+ * @param       dev         Device handle
+ * @param[out]  latch       Latch state
+ *
+ * @return 0 on success, BLADERF_ERR_UPDATE_FPGA if the FPGA does not support
+ *         this feature, or a value from \ref RETCODES list upon other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_time_latch(struct bladerf *dev,
+                                     struct bladerf_time_latch *latch);
+
 /**
  * Write value to VCTCXO DAC
  *
@@ -2648,9 +8001,183 @@ API_EXPORT
 int CALL_CONV bladerf_xb_spi_write(struct bladerf *dev, uint32_t val);
 
 
+/**
+ * Configure the buffering of the FX3's sample DMA channels
+ *
+ * Deeper buffering allows the device to ride out longer host-side scheduling
+ * stalls before the FPGA's sample FIFOs overflow or underrun. Each of the RX
+ * and TX channels is backed by `count` buffers of `size` bytes. The size must
+ * be a multiple of the USB max packet size (512 bytes at High Speed, 1024 at
+ * SuperSpeed). Larger buffers are primarily beneficial at SuperSpeed, where
+ * the sample endpoints use burst transfers; ideally, the size is a multiple
+ * of the burst size (see bladerf_set_fx3_burst_len()). Each channel's buffers
+ * are limited to 96 KiB in total.
+ *
+ * The RF link is restarted to apply this configuration, so this should not
+ * be called while streaming. The configuration persists until the device is
+ * reset or power cycled.
+ *
+ * This requires FX3 firmware v1.9.0 or later.
+ *
+ * @param   dev     Device handle
+ * @param   count   Number of buffers per channel, or 0 for the default. This
+ *                  is 22 at High Speed, and enough buffers to fill 64 KiB at
+ *                  SuperSpeed.
+ * @param   size    Size of each buffer, in bytes, or 0 for the default. This is
+ *                  two packets at High Speed, and one burst at SuperSpeed.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if the configuration is not
+ *         supported, BLADERF_ERR_UNSUPPORTED if the firmware does not support
+ *         this, or a value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_fx3_dma_config(struct bladerf *dev,
+                                         unsigned int count,
+                                         unsigned int size);
+
+/**
+ * Select the SuperSpeed burst length of the FX3's sample endpoints
+ *
+ * This is the number of packets the device may transfer per endpoint before
+ * waiting for the host's acknowledgement. Longer bursts reduce protocol
+ * overhead, allowing higher sustained throughput (e.g., when streaming RX and
+ * TX simultaneously at high sample rates). This has no effect at High Speed.
+ *
+ * As with bladerf_set_fx3_dma_config(), the RF link is restarted to apply
+ * this, so it should not be called while streaming. Unless a buffer size has
+ * been selected, the DMA buffers are resized to hold one burst each.
+ *
+ * This requires FX3 firmware v1.9.0 or later.
+ *
+ * @param   dev     Device handle
+ * @param   len     Burst length in packets, from 1 to 16, or 0 for the
+ *                  default (16)
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if the length is not supported,
+ *         BLADERF_ERR_UNSUPPORTED if the firmware does not support this, or a
+ *         value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_set_fx3_burst_len(struct bladerf *dev, unsigned int len);
+
+/**
+ * FX3 sample endpoint and DMA configuration, as negotiated for the current
+ * USB speed
+ */
+struct bladerf_fx3_link_config {
+    unsigned int buf_count;         /**< DMA buffers per sample channel */
+    unsigned int buf_size;          /**< Size of each DMA buffer, in bytes */
+    unsigned int burst_len;         /**< Endpoint burst length, in packets.
+                                     *   This is 1 below SuperSpeed. */
+    unsigned int max_packet_size;   /**< Endpoint max packet size, in bytes */
+};
+
+/**
+ * Get the FX3's sample endpoint and DMA configuration at the current USB
+ * speed. See also bladerf_device_speed().
+ *
+ * @param       dev     Device handle
+ * @param[out]  config  Updated with the configuration on success
+ *
+ * @return 0 on success, BLADERF_ERR_UNSUPPORTED if the firmware does not
+ *         support this, or a value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_fx3_dma_config(struct bladerf *dev,
+                                 struct bladerf_fx3_link_config *config);
+
+/**
+ * FX3 sample path performance counters
+ *
+ * These describe the activity of the FX3's sample DMA channels since the
+ * RF link was last started (e.g., the device was opened) or since the
+ * counters were last reset. Comparing these with the host-side statistics
+ * (see bladerf_get_stream_stats()) allows drops to be attributed to the
+ * FPGA/FX3 interface, the FX3's buffering, or the host.
+ */
+struct bladerf_fx3_stats {
+    /** RX: Bytes written to the DMA channel by the FPGA (via the GPIF) */
+    uint64_t rx_prod_bytes;
+
+    /** RX: Bytes sent from the DMA channel to the host */
+    uint64_t rx_cons_bytes;
+
+    /** TX: Bytes written to the DMA channel by the host */
+    uint64_t tx_prod_bytes;
+
+    /** TX: Bytes read from the DMA channel by the FPGA (via the GPIF) */
+    uint64_t tx_cons_bytes;
+
+    /**
+     * RX: Number of GPIF overruns, where samples from the FPGA could not be
+     * written because no DMA buffer was free. This denotes that the FX3's
+     * buffering was exhausted (see bladerf_set_fx3_dma_config()).
+     */
+    uint32_t rx_overruns;
+
+    /**
+     * TX: Number of GPIF underruns, where the FPGA requested samples that
+     * were not yet available
+     */
+    uint32_t tx_underruns;
+
+    /** RX: DMA channel errors */
+    uint32_t rx_dma_errors;
+
+    /** TX: DMA channel errors */
+    uint32_t tx_dma_errors;
+
+    /** Other FX3 P-port errors */
+    uint32_t pib_errors;
+
+    /** GPIF state machine errors */
+    uint32_t gpif_errors;
+
+    /**
+     * TX: Number of flow control events (NAK or NRDY) issued to the host
+     * because no DMA buffer was available to receive samples
+     */
+    uint32_t tx_ep_flow_control;
+
+    /** RX: SuperSpeed endpoint retries */
+    uint32_t rx_ep_retries;
+
+    /** TX: SuperSpeed endpoint retries */
+    uint32_t tx_ep_retries;
+
+    /** RX: Endpoint sequence and stream errors */
+    uint32_t rx_ep_errors;
+
+    /** TX: Endpoint sequence and stream errors */
+    uint32_t tx_ep_errors;
+};
+
+/**
+ * Read the FX3's sample path performance counters
+ *
+ * This requires FX3 firmware v1.9.0 or later.
+ *
+ * @param       dev     Device handle
+ * @param[out]  stats   Updated with the counters on success
+ * @param[in]   reset   Reset the counters after reading them
+ *
+ * @return 0 on success, BLADERF_ERR_UNSUPPORTED if the firmware does not
+ *         support this, or a value from \ref RETCODES list on other failures
+ */
+API_EXPORT
+int CALL_CONV bladerf_get_fx3_stats(struct bladerf *dev,
+                                    struct bladerf_fx3_stats *stats,
+                                    bool reset);
+
 /**
  * Perform DC calibration
  *
+ * When libbladeRF is built with ENABLE_LIBBLADERF_LMS_DC_CAL_CACHE, the
+ * resulting LMS6002D DC calibration register values are saved to the user's
+ * bladeRF configuration directory (as `<serial>_lms_dc_cals.txt`) and are
+ * applied automatically the next time the device is opened, until they become
+ * stale (by default, after 7 days).
+ *
  * @param   dev         Device handle
  * @param   module      Module to calibrate
  *
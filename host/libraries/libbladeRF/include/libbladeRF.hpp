@@ -0,0 +1,699 @@
+/**
+ * @file libbladeRF.hpp
+ *
+ * @brief Optional, header-only C++ interface to libbladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+#ifndef BLADERF_HPP_
+#define BLADERF_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <libbladeRF.h>
+
+/**
+ * @defgroup FN_CPP C++ interface
+ *
+ * This header provides a thin C++11 layer over the C API: a device handle and
+ * synchronous streams that are released by their destructors, spans of
+ * samples typed according to the stream's ::bladerf_format, and move-only
+ * handles to the samples lent by the zero-copy functions,
+ * bladerf_sync_rx_acquire() and bladerf_sync_tx_acquire(). A handle returns
+ * its samples to the stream when it is destroyed, so streaming without
+ * allocations or copies is simply a matter of acquiring handles in a loop:
+ *
+ * @code
+ *  bladeRF::device dev("*:serial=f12ce1");
+ *  bladeRF::rx_stream<BLADERF_FORMAT_SC16_Q11> rx(dev, 16, 8192, 8, 3500);
+ *
+ *  for (;;) {
+ *      bladeRF::rx_buffer<BLADERF_FORMAT_SC16_Q11> buf = rx.acquire(5000);
+ *      for (const bladeRF::sc16 &s : buf.samples()) {
+ *          ...
+ *      }
+ *  }
+ * @endcode
+ *
+ * Errors are reported by throwing bladeRF::error. Destructors do not throw;
+ * call the corresponding function (e.g., rx_buffer::release()) explicitly to
+ * observe the errors they would otherwise ignore.
+ *
+ * As with the C API, a stream must be destroyed before its device, and buffer
+ * handles before their stream. Only one buffer of each stream may be held at
+ * a time.
+ *
+ * @{
+ */
+
+namespace bladeRF {
+
+/**
+ * Exception thrown upon the failure of a libbladeRF function
+ */
+class error : public std::runtime_error {
+public:
+    /**
+     * @param   status  BLADERF_ERR_* value
+     * @param   what    Description of the failed operation
+     */
+    error(int status, const std::string &what)
+        : std::runtime_error(what + ": " + bladerf_strerror(status)),
+          status_(status)
+    {
+    }
+
+    /** BLADERF_ERR_* value returned by the failed function */
+    int status() const noexcept { return status_; }
+
+private:
+    int status_;
+};
+
+namespace detail {
+
+inline void check(int status, const char *what)
+{
+    if (status < 0) {
+        throw error(status, what);
+    }
+}
+
+} // namespace detail
+
+/** ::BLADERF_FORMAT_SC16_Q11 sample */
+struct sc16 {
+    int16_t i;
+    int16_t q;
+};
+
+/** ::BLADERF_FORMAT_SC8_Q7 sample */
+struct sc8 {
+    int8_t i;
+    int8_t q;
+};
+
+/** ::BLADERF_FORMAT_CF32 sample */
+struct cf32 {
+    float i;
+    float q;
+};
+
+static_assert(sizeof(sc16) == 4, "sc16 must match the SC16 Q11 layout");
+static_assert(sizeof(sc8) == 2, "sc8 must match the SC8 Q7 layout");
+static_assert(sizeof(cf32) == 8, "cf32 must match the CF32 layout");
+
+/**
+ * Contiguous sequence of `T`, which is not owned by the span
+ */
+template <typename T>
+class span {
+public:
+    typedef T value_type;
+    typedef T *iterator;
+
+    span() noexcept : data_(nullptr), size_(0) {}
+    span(T *data, std::size_t size) noexcept : data_(data), size_(size) {}
+
+    template <std::size_t N>
+    span(T (&array)[N]) noexcept : data_(array), size_(N) {}
+
+    /** Spans of `T` convert to spans of `const T` */
+    operator span<const T>() const noexcept
+    {
+        return span<const T>(data_, size_);
+    }
+
+    T *data() const noexcept { return data_; }
+    std::size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+
+    T &operator[](std::size_t i) const noexcept { return data_[i]; }
+    iterator begin() const noexcept { return data_; }
+    iterator end() const noexcept { return data_ + size_; }
+
+    /** The first `count` elements, which must not exceed size() */
+    span first(std::size_t count) const noexcept
+    {
+        return span(data_, count);
+    }
+
+    /** `count` elements from `offset`, which must lie within the span */
+    span subspan(std::size_t offset, std::size_t count) const noexcept
+    {
+        return span(data_ + offset, count);
+    }
+
+private:
+    T *data_;
+    std::size_t size_;
+};
+
+/**
+ * Properties of a ::bladerf_format, as seen by the synchronous interface
+ *
+ *  - `sample_type`: type of one sample in the caller's buffers
+ *  - `has_metadata`: whether the format carries metadata
+ *  - `zero_copy`: whether samples may be lent by the acquire functions
+ */
+template <bladerf_format F>
+struct format_traits;
+
+template <>
+struct format_traits<BLADERF_FORMAT_SC16_Q11> {
+    typedef sc16 sample_type;
+    static const bool has_metadata = false;
+    static const bool zero_copy = true;
+};
+
+template <>
+struct format_traits<BLADERF_FORMAT_SC16_Q11_META> {
+    typedef sc16 sample_type;
+    static const bool has_metadata = true;
+    static const bool zero_copy = true;
+};
+
+template <>
+struct format_traits<BLADERF_FORMAT_PSD_U32> {
+    typedef uint32_t sample_type;
+    static const bool has_metadata = false;
+    static const bool zero_copy = true;
+};
+
+template <>
+struct format_traits<BLADERF_FORMAT_SC16_Q11_PACKED> {
+    typedef sc16 sample_type;
+    static const bool has_metadata = false;
+    static const bool zero_copy = false;
+};
+
+template <>
+struct format_traits<BLADERF_FORMAT_SC8_Q7> {
+    typedef sc8 sample_type;
+    static const bool has_metadata = false;
+    static const bool zero_copy = true;
+};
+
+template <>
+struct format_traits<BLADERF_FORMAT_SC8_Q7_META> {
+    typedef sc8 sample_type;
+    static const bool has_metadata = true;
+    static const bool zero_copy = true;
+};
+
+template <>
+struct format_traits<BLADERF_FORMAT_CF32> {
+    typedef cf32 sample_type;
+    static const bool has_metadata = false;
+    static const bool zero_copy = false;
+};
+
+template <>
+struct format_traits<BLADERF_FORMAT_CF32_META> {
+    typedef cf32 sample_type;
+    static const bool has_metadata = true;
+    static const bool zero_copy = false;
+};
+
+template <>
+struct format_traits<BLADERF_FORMAT_TX_SYMBOLS> {
+    typedef uint32_t sample_type;
+    static const bool has_metadata = false;
+    static const bool zero_copy = true;
+};
+
+/**
+ * Device handle, which is closed when destroyed
+ */
+class device {
+public:
+    /**
+     * Open a device, as with bladerf_open()
+     *
+     * @param   identifier  Device identifier string, or NULL to open the
+     *                      first available device
+     */
+    explicit device(const char *identifier = nullptr) : dev_(nullptr)
+    {
+        detail::check(bladerf_open(&dev_, identifier), "bladerf_open");
+    }
+
+    explicit device(const std::string &identifier)
+        : device(identifier.c_str())
+    {
+    }
+
+    /** Take ownership of a handle opened via the C API */
+    explicit device(struct bladerf *dev) noexcept : dev_(dev) {}
+
+    ~device() { reset(); }
+
+    device(device &&other) noexcept : dev_(other.dev_)
+    {
+        other.dev_ = nullptr;
+    }
+
+    device &operator=(device &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            dev_ = other.dev_;
+            other.dev_ = nullptr;
+        }
+
+        return *this;
+    }
+
+    device(const device &) = delete;
+    device &operator=(const device &) = delete;
+
+    /** Handle for use with the C API */
+    struct bladerf *get() const noexcept { return dev_; }
+
+    /** Give up ownership of the handle, without closing it */
+    struct bladerf *release() noexcept
+    {
+        struct bladerf *dev = dev_;
+        dev_ = nullptr;
+        return dev;
+    }
+
+    /** Close the device, if one is held */
+    void reset() noexcept
+    {
+        if (dev_ != nullptr) {
+            bladerf_close(dev_);
+            dev_ = nullptr;
+        }
+    }
+
+    explicit operator bool() const noexcept { return dev_ != nullptr; }
+
+private:
+    struct bladerf *dev_;
+};
+
+namespace detail {
+
+/* Synchronous interface of one module, which is enabled while held */
+class sync_module {
+public:
+    sync_module(device &dev, bladerf_module module, bladerf_format format,
+                unsigned int num_buffers, unsigned int buffer_size,
+                unsigned int num_transfers, unsigned int stream_timeout)
+        : dev_(dev.get()), module_(module)
+    {
+        check(bladerf_sync_config(dev_, module, format, num_buffers,
+                                  buffer_size, num_transfers, stream_timeout),
+              "bladerf_sync_config");
+
+        check(bladerf_enable_module(dev_, module, true),
+              "bladerf_enable_module");
+    }
+
+    ~sync_module()
+    {
+        if (dev_ != nullptr) {
+            bladerf_enable_module(dev_, module_, false);
+        }
+    }
+
+    sync_module(sync_module &&other) noexcept
+        : dev_(other.dev_), module_(other.module_)
+    {
+        other.dev_ = nullptr;
+    }
+
+    sync_module &operator=(sync_module &&other) noexcept
+    {
+        if (this != &other) {
+            if (dev_ != nullptr) {
+                bladerf_enable_module(dev_, module_, false);
+            }
+
+            dev_ = other.dev_;
+            module_ = other.module_;
+            other.dev_ = nullptr;
+        }
+
+        return *this;
+    }
+
+    sync_module(const sync_module &) = delete;
+    sync_module &operator=(const sync_module &) = delete;
+
+    struct bladerf *dev() const noexcept { return dev_; }
+
+private:
+    struct bladerf *dev_;
+    bladerf_module module_;
+};
+
+} // namespace detail
+
+/**
+ * Received samples lent by rx_stream::acquire(), which are returned to the
+ * stream when the handle is destroyed
+ */
+template <bladerf_format F>
+class rx_buffer {
+public:
+    typedef typename format_traits<F>::sample_type sample_type;
+
+    rx_buffer() noexcept
+        : dev_(nullptr), samples_(nullptr), count_(0), meta_()
+    {
+    }
+
+    ~rx_buffer() { reset(); }
+
+    rx_buffer(rx_buffer &&other) noexcept
+        : dev_(other.dev_), samples_(other.samples_), count_(other.count_),
+          meta_(other.meta_)
+    {
+        other.dev_ = nullptr;
+    }
+
+    rx_buffer &operator=(rx_buffer &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            dev_ = other.dev_;
+            samples_ = other.samples_;
+            count_ = other.count_;
+            meta_ = other.meta_;
+            other.dev_ = nullptr;
+        }
+
+        return *this;
+    }
+
+    rx_buffer(const rx_buffer &) = delete;
+    rx_buffer &operator=(const rx_buffer &) = delete;
+
+    /** The lent samples */
+    span<const sample_type> samples() const noexcept
+    {
+        return span<const sample_type>(
+            static_cast<const sample_type *>(samples_), count_);
+    }
+
+    /** Metadata of the first lent sample, for formats with metadata */
+    const struct bladerf_metadata &metadata() const noexcept { return meta_; }
+
+    /** Return the samples to the stream, as with bladerf_sync_rx_release() */
+    void release()
+    {
+        struct bladerf *dev = dev_;
+        dev_ = nullptr;
+
+        if (dev != nullptr) {
+            detail::check(bladerf_sync_rx_release(dev, samples_),
+                          "bladerf_sync_rx_release");
+        }
+    }
+
+    explicit operator bool() const noexcept { return dev_ != nullptr; }
+
+private:
+    template <bladerf_format> friend class rx_stream;
+
+    void reset() noexcept
+    {
+        if (dev_ != nullptr) {
+            bladerf_sync_rx_release(dev_, samples_);
+            dev_ = nullptr;
+        }
+    }
+
+    struct bladerf *dev_;
+    void *samples_;
+    unsigned int count_;
+    struct bladerf_metadata meta_;
+};
+
+/**
+ * RX synchronous interface, enabled for the lifetime of the object
+ */
+template <bladerf_format F>
+class rx_stream {
+public:
+    typedef typename format_traits<F>::sample_type sample_type;
+
+    /**
+     * Configure the RX synchronous interface, as with bladerf_sync_config(),
+     * and enable the RX module
+     */
+    rx_stream(device &dev, unsigned int num_buffers, unsigned int buffer_size,
+              unsigned int num_transfers, unsigned int stream_timeout)
+        : module_(dev, BLADERF_MODULE_RX, F, num_buffers, buffer_size,
+                  num_transfers, stream_timeout)
+    {
+    }
+
+    rx_stream(rx_stream &&other) noexcept = default;
+    rx_stream &operator=(rx_stream &&other) noexcept = default;
+
+    /**
+     * Receive samples into `samples`, as with bladerf_sync_rx()
+     *
+     * @param   samples     Destination
+     * @param   metadata    Sample metadata. Required for formats with
+     *                      metadata.
+     * @param   timeout_ms  Timeout, or 0 for none
+     *
+     * @return Number of samples received
+     */
+    unsigned int rx(span<sample_type> samples,
+                    struct bladerf_metadata *metadata = nullptr,
+                    unsigned int timeout_ms = 0)
+    {
+        const unsigned int count = static_cast<unsigned int>(samples.size());
+
+        detail::check(bladerf_sync_rx(module_.dev(), samples.data(), count,
+                                      metadata, timeout_ms),
+                      "bladerf_sync_rx");
+
+        return format_traits<F>::has_metadata ? metadata->actual_count : count;
+    }
+
+    /**
+     * Borrow received samples from the stream's buffers, as with
+     * bladerf_sync_rx_acquire()
+     *
+     * @param   timeout_ms  Timeout, or 0 for none
+     */
+    rx_buffer<F> acquire(unsigned int timeout_ms = 0)
+    {
+        static_assert(format_traits<F>::zero_copy,
+                      "This format's samples cannot be lent");
+
+        rx_buffer<F> buf;
+        struct bladerf_metadata *meta = nullptr;
+
+        if (format_traits<F>::has_metadata) {
+            buf.meta_ = bladerf_metadata();
+            meta = &buf.meta_;
+        }
+
+        detail::check(bladerf_sync_rx_acquire(module_.dev(), &buf.samples_,
+                                              &buf.count_, meta, timeout_ms),
+                      "bladerf_sync_rx_acquire");
+
+        buf.dev_ = module_.dev();
+        return buf;
+    }
+
+private:
+    detail::sync_module module_;
+};
+
+/**
+ * Space in the TX stream's buffers lent by tx_stream::acquire(), which is
+ * committed when the handle is destroyed
+ */
+template <bladerf_format F>
+class tx_buffer {
+public:
+    typedef typename format_traits<F>::sample_type sample_type;
+
+    tx_buffer() noexcept : dev_(nullptr), samples_(nullptr), count_(0) {}
+
+    /** Commit the lent space with no samples, unless already committed */
+    ~tx_buffer() { reset(); }
+
+    tx_buffer(tx_buffer &&other) noexcept
+        : dev_(other.dev_), samples_(other.samples_), count_(other.count_)
+    {
+        other.dev_ = nullptr;
+    }
+
+    tx_buffer &operator=(tx_buffer &&other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            dev_ = other.dev_;
+            samples_ = other.samples_;
+            count_ = other.count_;
+            other.dev_ = nullptr;
+        }
+
+        return *this;
+    }
+
+    tx_buffer(const tx_buffer &) = delete;
+    tx_buffer &operator=(const tx_buffer &) = delete;
+
+    /** Space for the samples to be transmitted */
+    span<sample_type> samples() const noexcept
+    {
+        return span<sample_type>(static_cast<sample_type *>(samples_),
+                                 count_);
+    }
+
+    /**
+     * Commit the first `count` samples of the lent space for transmission,
+     * as with bladerf_sync_tx_commit()
+     *
+     * @param   count       Number of samples written, up to samples().size()
+     * @param   metadata    Sample metadata, for formats with metadata. May be
+     *                      NULL to commit the samples without flags.
+     */
+    void commit(unsigned int count,
+                struct bladerf_metadata *metadata = nullptr)
+    {
+        struct bladerf_metadata none = bladerf_metadata();
+        struct bladerf *dev = dev_;
+        dev_ = nullptr;
+
+        if (format_traits<F>::has_metadata && metadata == nullptr) {
+            metadata = &none;
+        }
+
+        if (dev != nullptr) {
+            detail::check(bladerf_sync_tx_commit(dev, samples_, count,
+                                                 metadata),
+                          "bladerf_sync_tx_commit");
+        }
+    }
+
+    explicit operator bool() const noexcept { return dev_ != nullptr; }
+
+private:
+    template <bladerf_format> friend class tx_stream;
+
+    void reset() noexcept
+    {
+        struct bladerf_metadata none = bladerf_metadata();
+
+        if (dev_ != nullptr) {
+            bladerf_sync_tx_commit(dev_, samples_, 0,
+                                   format_traits<F>::has_metadata ? &none
+                                                                  : nullptr);
+            dev_ = nullptr;
+        }
+    }
+
+    struct bladerf *dev_;
+    void *samples_;
+    unsigned int count_;
+};
+
+/**
+ * TX synchronous interface, enabled for the lifetime of the object
+ */
+template <bladerf_format F>
+class tx_stream {
+public:
+    typedef typename format_traits<F>::sample_type sample_type;
+
+    /**
+     * Configure the TX synchronous interface, as with bladerf_sync_config(),
+     * and enable the TX module
+     */
+    tx_stream(device &dev, unsigned int num_buffers, unsigned int buffer_size,
+              unsigned int num_transfers, unsigned int stream_timeout)
+        : module_(dev, BLADERF_MODULE_TX, F, num_buffers, buffer_size,
+                  num_transfers, stream_timeout)
+    {
+    }
+
+    tx_stream(tx_stream &&other) noexcept = default;
+    tx_stream &operator=(tx_stream &&other) noexcept = default;
+
+    /**
+     * Transmit `samples`, as with bladerf_sync_tx()
+     *
+     * @param   samples     Samples to transmit
+     * @param   metadata    Sample metadata. Required for formats with
+     *                      metadata.
+     * @param   timeout_ms  Timeout, or 0 for none
+     */
+    void tx(span<const sample_type> samples,
+            struct bladerf_metadata *metadata = nullptr,
+            unsigned int timeout_ms = 0)
+    {
+        /* The samples are only read, despite the C prototype */
+        void *data = const_cast<sample_type *>(samples.data());
+
+        detail::check(bladerf_sync_tx(module_.dev(), data,
+                                      static_cast<unsigned int>(samples.size()),
+                                      metadata, timeout_ms),
+                      "bladerf_sync_tx");
+    }
+
+    /**
+     * Borrow space in the stream's buffers to write samples into, as with
+     * bladerf_sync_tx_acquire()
+     *
+     * @param   metadata    Sample metadata, for formats with metadata. May be
+     *                      NULL to continue the current burst.
+     * @param   timeout_ms  Timeout, or 0 for none
+     */
+    tx_buffer<F> acquire(struct bladerf_metadata *metadata = nullptr,
+                         unsigned int timeout_ms = 0)
+    {
+        static_assert(format_traits<F>::zero_copy,
+                      "This format's samples cannot be lent");
+
+        struct bladerf_metadata none = bladerf_metadata();
+        tx_buffer<F> buf;
+
+        if (format_traits<F>::has_metadata && metadata == nullptr) {
+            metadata = &none;
+        }
+
+        detail::check(bladerf_sync_tx_acquire(module_.dev(), &buf.samples_,
+                                              &buf.count_, metadata,
+                                              timeout_ms),
+                      "bladerf_sync_tx_acquire");
+
+        buf.dev_ = module_.dev();
+        return buf;
+    }
+
+private:
+    detail::sync_module module_;
+};
+
+} // namespace bladeRF
+
+/** @} (End of FN_CPP) */
+
+#endif
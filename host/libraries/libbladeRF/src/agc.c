@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <math.h>
+#include <string.h>
+#include <libbladeRF.h>
+
+#include "agc.h"
+#include "dsp.h"
+#include "log.h"
+
+/* Power assigned to silence, such that its level is finite */
+#define AGC_POWER_MIN 1e-12
+
+/* Full scale of SC16 Q11 samples, squared */
+#define AGC_SC16_FULL_SCALE (2048.0 * 2048.0)
+
+static inline int clamp(int x, int lo, int hi)
+{
+    return (x < lo) ? lo : ((x > hi) ? hi : x);
+}
+
+/* Apply a gain, scheduling it in the FPGA where possible.
+ *
+ * @pre lock is held */
+static int agc_apply(struct bladerf *dev, struct agc *agc, int gain)
+{
+    int status;
+    uint64_t now;
+
+    if (agc->schedule && agc->config.lead != 0) {
+        status = bladerf_get_timestamp(dev, BLADERF_MODULE_RX, &now);
+        if (status != 0) {
+            return status;
+        }
+
+        status = bladerf_schedule_gain(dev, BLADERF_MODULE_RX,
+                                       now + agc->config.lead, gain);
+
+        if (status == 0) {
+            agc->gain_timestamp = now + agc->config.lead;
+            agc->gain = gain;
+            agc->reported = false;
+            return 0;
+        } else if (status == BLADERF_ERR_QUEUE_FULL) {
+            /* Retry with the next estimate */
+            return 0;
+        } else if (status != BLADERF_ERR_UPDATE_FPGA &&
+                   status != BLADERF_ERR_UNSUPPORTED) {
+            return status;
+        }
+
+        log_debug("%s: Changing gains immediately\n", __FUNCTION__);
+        agc->schedule = false;
+    }
+
+    status = bladerf_set_gain(dev, BLADERF_MODULE_RX, gain);
+    if (status == 0) {
+        status = bladerf_get_timestamp(dev, BLADERF_MODULE_RX, &now);
+    }
+
+    if (status == 0) {
+        agc->gain_timestamp = now;
+        agc->gain = gain;
+        agc->reported = false;
+    }
+
+    return status;
+}
+
+void agc_init(struct agc *agc)
+{
+    memset(agc, 0, sizeof(*agc));
+    MUTEX_INIT(&agc->lock);
+}
+
+int agc_config(struct bladerf *dev, struct agc *agc,
+               const struct bladerf_agc_config *config)
+{
+    int status = 0;
+
+    if (config != NULL &&
+        (config->max_step_db == 0 || config->window == 0 ||
+         config->min_gain > config->max_gain ||
+         config->initial_gain < config->min_gain ||
+         config->initial_gain > config->max_gain ||
+         config->min_gain < INT8_MIN || config->max_gain > INT8_MAX)) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&agc->lock);
+
+    agc->enabled = false;
+
+    if (config != NULL) {
+        agc->config = *config;
+        agc->schedule = true;
+        agc->power = 0.0;
+        agc->count = 0;
+
+        status = bladerf_set_gain(dev, BLADERF_MODULE_RX,
+                                  config->initial_gain);
+        if (status == 0) {
+            status = bladerf_get_timestamp(dev, BLADERF_MODULE_RX,
+                                           &agc->gain_timestamp);
+        }
+
+        if (status == 0) {
+            agc->gain = config->initial_gain;
+            agc->reported = false;
+            agc->enabled = true;
+        }
+    }
+
+    MUTEX_UNLOCK(&agc->lock);
+    return status;
+}
+
+int agc_process(struct bladerf *dev, struct agc *agc, const void *samples,
+                bladerf_format format, struct bladerf_metadata *meta)
+{
+    int status = 0;
+    uint64_t settled;
+    unsigned int skip = 0, n;
+
+    if (format != BLADERF_FORMAT_SC16_Q11_META &&
+        format != BLADERF_FORMAT_CF32_META) {
+        return 0;
+    }
+
+    MUTEX_LOCK(&agc->lock);
+
+    if (!agc->enabled) {
+        MUTEX_UNLOCK(&agc->lock);
+        return 0;
+    }
+
+    /* Samples received before the most recent change has settled are not
+     * representative of its gain */
+    settled = agc->gain_timestamp + agc->config.settle;
+    if (meta->timestamp < settled) {
+        skip = (settled - meta->timestamp < meta->actual_count) ?
+               (unsigned int) (settled - meta->timestamp) : meta->actual_count;
+    }
+
+    n = meta->actual_count - skip;
+
+    if (format == BLADERF_FORMAT_SC16_Q11_META) {
+        const int16_t *s = (const int16_t *) samples;
+        agc->power += dsp_power_sc16_q11(&s[2 * skip], n) /
+                      AGC_SC16_FULL_SCALE;
+    } else {
+        const float *s = (const float *) samples;
+        agc->power += dsp_power_cf32(&s[2 * skip], n);
+    }
+
+    agc->count += n;
+
+    if (agc->count >= agc->config.window) {
+        const double level = 10.0 * log10(agc->power / agc->count +
+                                          AGC_POWER_MIN);
+        const double error = agc->config.target_dbfs - level;
+
+        agc->power = 0.0;
+        agc->count = 0;
+
+        if (fabs(error) > agc->config.hysteresis_db) {
+            const int max_step = (int) agc->config.max_step_db;
+            const int step = clamp((int) lrint(error), -max_step, max_step);
+            const int gain = clamp(agc->gain + step, agc->config.min_gain,
+                                   agc->config.max_gain);
+
+            if (gain != agc->gain) {
+                status = agc_apply(dev, agc, gain);
+            }
+        }
+    }
+
+    meta->gain = (int8_t) agc->gain;
+    meta->gain_timestamp = agc->gain_timestamp;
+
+    if (!agc->reported) {
+        meta->status |= BLADERF_META_STATUS_GAIN_CHANGE;
+        agc->reported = true;
+    }
+
+    MUTEX_UNLOCK(&agc->lock);
+    return status;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef BLADERF_AGC_H_
+#define BLADERF_AGC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libbladeRF.h>
+#include "thread.h"
+
+struct bladerf;
+
+struct agc {
+    MUTEX lock;
+    bool enabled;
+    bool schedule;              /* Scheduled gain changes are supported */
+    struct bladerf_agc_config config;
+
+    int gain;                   /* Gain applied by the most recent change */
+    uint64_t gain_timestamp;    /* Timestamp at which `gain` takes effect */
+    bool reported;              /* The change has been reported */
+
+    double power;               /* Sum of I^2 + Q^2, relative to full scale */
+    unsigned int count;         /* Number of samples in `power` */
+};
+
+/**
+ * Initialize an AGC. It is disabled.
+ */
+void agc_init(struct agc *agc);
+
+/**
+ * Enable the AGC with the specified configuration, applying its initial gain,
+ * or disable it if `config` is NULL. The caller must not hold any of
+ * dev->ctrl_lock[].
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int agc_config(struct bladerf *dev, struct agc *agc,
+               const struct bladerf_agc_config *config);
+
+/**
+ * Measure received samples and update the gain if required, reporting the
+ * most recent gain change in `meta`. This does nothing if the AGC is disabled
+ * or `format` is not supported. The caller must not hold any of
+ * dev->ctrl_lock[] or dev->sync_lock[].
+ *
+ * @param   dev         Device handle
+ * @param   agc         AGC
+ * @param   samples     Samples returned by sync_rx()
+ * @param   format      Host format of `samples`
+ * @param   meta        Metadata returned by sync_rx()
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure to change the gain
+ */
+int agc_process(struct bladerf *dev, struct agc *agc, const void *samples,
+                bladerf_format format, struct bladerf_metadata *meta);
+
+#endif
@@ -19,20 +19,225 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 #include <stdint.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <string.h>
+#include <assert.h>
 #include "async.h"
+#include "metadata.h"
+#include "numa_node.h"
+#include "version_compat.h"
 #include "log.h"
 
-int async_init_stream(struct bladerf_stream **stream,
-                      struct bladerf *dev,
-                      bladerf_stream_cb callback,
-                      void ***buffers,
-                      size_t num_buffers,
-                      bladerf_format format,
-                      size_t samples_per_buffer,
-                      size_t num_transfers,
-                      void *user_data)
+#if BLADERF_OS_LINUX || BLADERF_OS_OSX
+#   include <sys/mman.h>
+#endif
+
+/* Huge page size assumed when rounding up the size of huge page arenas */
+#define ARENA_HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+static void *alloc_os_pages(size_t size, bool hugepages)
+{
+    void *mem;
+
+#if BLADERF_OS_LINUX || BLADERF_OS_OSX
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+#   ifdef MAP_HUGETLB
+    if (hugepages) {
+        flags |= MAP_HUGETLB;
+    }
+#   else
+    if (hugepages) {
+        return NULL;
+    }
+#   endif
+
+    mem = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (mem == MAP_FAILED) {
+        mem = NULL;
+    }
+#elif BLADERF_OS_WINDOWS
+    /* Large pages require SeLockMemoryPrivilege; not supported here */
+    if (hugepages) {
+        return NULL;
+    }
+
+    mem = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#endif
+
+    return mem;
+}
+
+static void free_os_pages(void *mem, size_t size)
+{
+#if BLADERF_OS_LINUX || BLADERF_OS_OSX
+    munmap(mem, size);
+#elif BLADERF_OS_WINDOWS
+    VirtualFree(mem, 0, MEM_RELEASE);
+#endif
+}
+
+static bool lock_pages(void *mem, size_t size)
+{
+#if BLADERF_OS_LINUX || BLADERF_OS_OSX
+    return mlock(mem, size) == 0;
+#elif BLADERF_OS_WINDOWS
+    return VirtualLock(mem, size) != 0;
+#endif
+}
+
+static void unlock_pages(void *mem, size_t size)
+{
+#if BLADERF_OS_LINUX || BLADERF_OS_OSX
+    munlock(mem, size);
+#elif BLADERF_OS_WINDOWS
+    VirtualUnlock(mem, size);
+#endif
+}
+
+/* Allocate one zeroed, page-aligned region backing all stream buffers,
+ * honoring the device's BLADERF_STREAM_BUFFERS_* flags where possible */
+static int alloc_buffer_arena(struct bladerf_stream *stream, size_t size)
+{
+    struct async_buffer_arena *arena = &stream->arena;
+    const uint32_t flags = stream->buffer_flags;
+    const struct backend_fns *fn = stream->dev->fn;
+
+    arena->mem = NULL;
+    arena->size = size;
+    arena->type = ARENA_NONE;
+    arena->locked = false;
+    arena->numa_bound = false;
+
+    if ((flags & BLADERF_STREAM_BUFFERS_DEVICE_MEM) &&
+        fn->alloc_stream_mem != NULL) {
+
+        arena->mem = fn->alloc_stream_mem(stream->dev, size);
+        if (arena->mem != NULL) {
+            arena->type = ARENA_DEVICE_MEM;
+        } else {
+            log_info("Device memory unavailable for stream buffers. "
+                     "Falling back to regular allocation.\n");
+        }
+    } else if (flags & BLADERF_STREAM_BUFFERS_DEVICE_MEM) {
+        log_info("Backend does not support device memory for stream "
+                 "buffers. Falling back to regular allocation.\n");
+    }
+
+    if (arena->mem == NULL && (flags & BLADERF_STREAM_BUFFERS_HUGEPAGES)) {
+        size_t hp_size = (size + ARENA_HUGEPAGE_SIZE - 1) &
+                         ~((size_t) ARENA_HUGEPAGE_SIZE - 1);
+
+        arena->mem = alloc_os_pages(hp_size, true);
+        if (arena->mem != NULL) {
+            arena->size = hp_size;
+            arena->type = ARENA_HUGEPAGES;
+        } else {
+            log_info("Huge pages unavailable for stream buffers. "
+                     "Falling back to regular pages.\n");
+        }
+    }
+
+    if (arena->mem == NULL) {
+        arena->mem = alloc_os_pages(size, false);
+        if (arena->mem == NULL) {
+            return BLADERF_ERR_MEM;
+        }
+
+        arena->type = ARENA_PAGES;
+    }
+
+    /* The pages have yet to be touched, so they'll be placed on the node
+     * upon first use. The backend places device memory itself. */
+    if (arena->type != ARENA_DEVICE_MEM && stream->numa_node >= 0) {
+        arena->numa_bound = numa_bind_memory(arena->mem, arena->size,
+                                             stream->numa_node);
+        if (!arena->numa_bound) {
+            log_info("Failed to place stream buffers on NUMA node %d.\n",
+                     stream->numa_node);
+        }
+    }
+
+    if (flags & BLADERF_STREAM_BUFFERS_LOCKED) {
+        arena->locked = lock_pages(arena->mem, arena->size);
+        if (!arena->locked) {
+            log_warning("Failed to lock stream buffers into memory.\n");
+        }
+    }
+
+    log_verbose("Allocated %zu byte stream buffer arena (type=%d)\n",
+                arena->size, arena->type);
+
+    return 0;
+}
+
+static void free_buffer_arena(struct bladerf_stream *stream)
+{
+    struct async_buffer_arena *arena = &stream->arena;
+
+    if (arena->locked) {
+        unlock_pages(arena->mem, arena->size);
+        arena->locked = false;
+    }
+
+    switch (arena->type) {
+        case ARENA_PAGES:
+        case ARENA_HUGEPAGES:
+            free_os_pages(arena->mem, arena->size);
+            break;
+
+        case ARENA_DEVICE_MEM:
+            stream->dev->fn->free_stream_mem(stream->dev, arena->mem,
+                                             arena->size);
+            break;
+
+        case ARENA_NONE:
+            break;
+    }
+
+    arena->mem = NULL;
+    arena->type = ARENA_NONE;
+}
+
+/* Determine the NUMA node to place the stream's buffers and threads on. A
+ * stream that is used for both modules (as with bladerf_multi_rx()) is only
+ * placed if neither module's configuration disables it. */
+static void init_numa_placement(struct bladerf_stream *stream)
+{
+    const struct backend_fns *fn = stream->dev->fn;
+
+    stream->numa_node = -1;
+    stream->numa_cpus = 0;
+
+    if (stream->thread_config[BLADERF_MODULE_RX].ignore_numa ||
+        stream->thread_config[BLADERF_MODULE_TX].ignore_numa ||
+        fn->get_numa_node == NULL) {
+        return;
+    }
+
+    stream->numa_node = fn->get_numa_node(stream->dev);
+    if (stream->numa_node >= 0) {
+        stream->numa_cpus = numa_node_cpus(stream->numa_node);
+
+        log_verbose("Placing stream on NUMA node %d (CPUs 0x%016"PRIx64")\n",
+                    stream->numa_node, stream->numa_cpus);
+    }
+}
+
+/* If `user_buffers` is non-NULL, the stream uses these caller-owned buffers
+ * rather than allocating its own */
+static int init_stream(struct bladerf_stream **stream,
+                       struct bladerf *dev,
+                       bladerf_stream_cb callback,
+                       void ***buffers,
+                       void **user_buffers,
+                       size_t num_buffers,
+                       bladerf_format format,
+                       size_t samples_per_buffer,
+                       size_t num_transfers,
+                       void *user_data)
 {
     struct bladerf_stream *lstream;
     size_t buffer_size_bytes;
@@ -49,6 +254,21 @@ int async_init_stream(struct bladerf_stream **stream,
         return BLADERF_ERR_INVAL;
     }
 
+    /* Keep packed and 8-bit buffers a multiple of the page and DMA transfer
+     * sizes */
+    if (format == BLADERF_FORMAT_SC16_Q11_PACKED &&
+        samples_per_buffer % 4096 != 0) {
+        log_debug("Packed samples_per_buffer must be multiples of 4096\n");
+        return BLADERF_ERR_INVAL;
+    }
+
+    if ((format == BLADERF_FORMAT_SC8_Q7 ||
+         format == BLADERF_FORMAT_SC8_Q7_META) &&
+        samples_per_buffer % 2048 != 0) {
+        log_debug("8-bit samples_per_buffer must be multiples of 2048\n");
+        return BLADERF_ERR_INVAL;
+    }
+
     /* Create a stream and populate it with the appropriate information */
     lstream = malloc(sizeof(struct bladerf_stream));
 
@@ -74,14 +294,53 @@ int async_init_stream(struct bladerf_stream **stream,
     lstream->samples_per_buffer = samples_per_buffer;
     lstream->num_buffers = num_buffers;
     lstream->format = format;
+    lstream->rx_overflow_flags = format_has_metadata(format) &&
+        !version_less_than(&dev->fpga_version, 0, 1, 19);
     lstream->cb = callback;
     lstream->user_data = user_data;
     lstream->buffers = NULL;
+    lstream->arena.mem = NULL;
+    lstream->arena.type = ARENA_NONE;
+    lstream->arena.locked = false;
+    lstream->arena.numa_bound = false;
+    memset(&lstream->stats, 0, sizeof(lstream->stats));
+
+    STREAM_LOCK_BOTH(dev);
+
+    memcpy(lstream->thread_config, dev->stream_thread_config,
+           sizeof(lstream->thread_config));
+
+    memcpy(lstream->bufs_per_transfer, dev->stream_bufs_per_transfer,
+           sizeof(lstream->bufs_per_transfer));
+
+    lstream->buffer_flags = dev->stream_buffer_flags;
+
+    STREAM_UNLOCK_BOTH(dev);
+
+    init_numa_placement(lstream);
+
+    lstream->transfer_limit = 0;
+
+    lstream->msg_index = NULL;
+    lstream->msg_index_len = 0;
+    lstream->msg_index_count = 0;
+
+    lstream->batch_capable = false;
+    lstream->batch_cb = NULL;
+    lstream->batch_max = 0;
+    lstream->batch_count = 0;
+    lstream->batch = NULL;
+    lstream->batch_next = NULL;
 
     switch(format) {
         case BLADERF_FORMAT_SC16_Q11:
         case BLADERF_FORMAT_SC16_Q11_META:
-            buffer_size_bytes = sc16q11_to_bytes(samples_per_buffer);
+        case BLADERF_FORMAT_PSD_U32:
+        case BLADERF_FORMAT_SC16_Q11_PACKED:
+        case BLADERF_FORMAT_SC8_Q7:
+        case BLADERF_FORMAT_SC8_Q7_META:
+        case BLADERF_FORMAT_TX_SYMBOLS:
+            buffer_size_bytes = samples_to_bytes(format, samples_per_buffer);
             break;
 
         default:
@@ -89,14 +348,26 @@ int async_init_stream(struct bladerf_stream **stream,
             break;
     }
 
+    if (!status && num_buffers > SIZE_MAX / buffer_size_bytes) {
+        status = BLADERF_ERR_INVAL;
+    }
+
     if (!status) {
         lstream->buffers = calloc(num_buffers, sizeof(lstream->buffers[0]));
-        if (lstream->buffers) {
+        if (lstream->buffers && user_buffers) {
+            /* The arena remains unused, so nothing is freed but the array
+             * of buffer pointers when the stream is deinitialized */
+            memcpy(lstream->buffers, user_buffers,
+                   num_buffers * sizeof(lstream->buffers[0]));
+        } else if (lstream->buffers) {
+            /* Buffer sizes are a multiple of the page size, so each buffer
+             * within the arena remains page-aligned */
+            status = alloc_buffer_arena(lstream,
+                                        num_buffers * buffer_size_bytes);
+
             for (i = 0; i < num_buffers && !status; i++) {
-                lstream->buffers[i] = calloc(1, buffer_size_bytes);
-                if (!lstream->buffers[i]) {
-                    status = BLADERF_ERR_MEM;
-                }
+                lstream->buffers[i] =
+                    (uint8_t *) lstream->arena.mem + i * buffer_size_bytes;
             }
         } else {
             status = BLADERF_ERR_MEM;
@@ -105,15 +376,8 @@ int async_init_stream(struct bladerf_stream **stream,
 
     /* Clean up everything we've allocated if we hit any errors */
     if (status) {
-
-        if (lstream->buffers) {
-            for (i = 0; i < num_buffers; i++) {
-                free(lstream->buffers[i]);
-            }
-
-            free(lstream->buffers);
-        }
-
+        free_buffer_arena(lstream);
+        free(lstream->buffers);
         free(lstream);
     } else {
         /* Perform any backend-specific stream initialization */
@@ -135,76 +399,428 @@ int async_init_stream(struct bladerf_stream **stream,
     return status;
 }
 
+int async_init_stream(struct bladerf_stream **stream,
+                      struct bladerf *dev,
+                      bladerf_stream_cb callback,
+                      void ***buffers,
+                      size_t num_buffers,
+                      bladerf_format format,
+                      size_t samples_per_buffer,
+                      size_t num_transfers,
+                      void *user_data)
+{
+    return init_stream(stream, dev, callback, buffers, NULL, num_buffers,
+                       format, samples_per_buffer, num_transfers, user_data);
+}
+
+int async_init_stream_with_buffers(struct bladerf_stream **stream,
+                                   struct bladerf *dev,
+                                   bladerf_stream_cb callback,
+                                   void **buffers,
+                                   size_t num_buffers,
+                                   bladerf_format format,
+                                   size_t samples_per_buffer,
+                                   size_t num_transfers,
+                                   void *user_data)
+{
+    size_t i;
+
+    if (buffers == NULL) {
+        log_debug("%s: NULL buffer array\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    for (i = 0; i < num_buffers; i++) {
+        if (buffers[i] == NULL) {
+            log_debug("%s: Buffer %zu is NULL\n", __FUNCTION__, i);
+            return BLADERF_ERR_INVAL;
+        }
+
+        /* Samples must be naturally aligned */
+        if ((uintptr_t) buffers[i] % sizeof(int16_t) != 0) {
+            log_debug("%s: Buffer %zu is misaligned\n", __FUNCTION__, i);
+            return BLADERF_ERR_INVAL;
+        }
+    }
+
+    return init_stream(stream, dev, callback, NULL, buffers, num_buffers,
+                       format, samples_per_buffer, num_transfers, user_data);
+}
+
+/* Apply the configured scheduling options to the calling thread.
+ *
+ * Returns true if the thread's previous scheduling parameters were saved to
+ * `saved` and should be restored after the stream completes. */
+static bool apply_thread_config(struct bladerf_stream *stream,
+                                bladerf_module module,
+                                struct thread_sched_state *saved)
+{
+    int status;
+    bool restore = false;
+    const struct bladerf_stream_thread_config *config =
+        &stream->thread_config[module];
+
+    const uint64_t cpus = async_thread_cpus(stream, module);
+
+    if (config->policy == BLADERF_SCHED_DEFAULT &&
+        cpus == 0 && !config->lock_memory) {
+        return false;
+    }
+
+    if (config->policy != BLADERF_SCHED_DEFAULT || cpus != 0) {
+        restore = (thread_save_sched(pthread_self(), saved) == 0);
+    }
+
+    if (config->policy != BLADERF_SCHED_DEFAULT) {
+        const thread_sched_policy policy =
+            (config->policy == BLADERF_SCHED_FIFO) ?
+                THREAD_SCHED_FIFO : THREAD_SCHED_RR;
+
+        status = thread_set_sched(pthread_self(), policy, config->priority);
+        if (status != 0) {
+            log_warning("Failed to set %s stream thread priority: %s\n",
+                        module2str(module), strerror(status));
+        }
+    }
+
+    if (cpus != 0) {
+        status = thread_set_affinity(pthread_self(), cpus);
+        if (status != 0) {
+            log_warning("Failed to set %s stream thread CPU affinity: %s\n",
+                        module2str(module), strerror(status));
+        }
+    }
+
+    if (config->lock_memory) {
+        status = thread_lock_memory();
+        if (status != 0) {
+            log_warning("Failed to lock process memory: %s\n",
+                        strerror(status));
+        }
+    }
+
+    return restore;
+}
+
 int async_run_stream(struct bladerf_stream *stream, bladerf_module module)
 {
     int status;
     struct bladerf *dev = stream->dev;
+    struct thread_sched_state saved_sched;
+    bool restore_sched;
+
+    restore_sched = apply_thread_config(stream, module, &saved_sched);
 
     MUTEX_LOCK(&stream->lock);
     stream->module = module;
     stream->state = STREAM_RUNNING;
+    stream->batch_count = 0;
     pthread_cond_signal(&stream->stream_started);
     MUTEX_UNLOCK(&stream->lock);
 
     status = dev->fn->stream(stream, module);
 
+    if (restore_sched) {
+        thread_restore_sched(pthread_self(), &saved_sched);
+    }
+
     /* Backend return value takes precedence over stream error status */
     return status == 0 ? stream->error_code : status;
 }
 
+void async_rx_metadata(struct bladerf_stream *stream, const void *samples,
+                       size_t num_samples, struct bladerf_metadata *meta)
+{
+    const uint8_t *msg = (const uint8_t *) samples;
+    const size_t msg_size = stream->dev->msg_size;
+    const size_t hdr_samples = bytes_to_samples(stream->format,
+                                                METADATA_HEADER_SIZE);
+    size_t num_msgs, i;
+
+    memset(meta, 0, sizeof(*meta));
+    stream->msg_index_count = 0;
+
+    if (stream->module != BLADERF_MODULE_RX || samples == NULL ||
+        !format_has_metadata(stream->format) || msg_size == 0) {
+        return;
+    }
+
+    num_msgs = samples_to_bytes(stream->format, num_samples) / msg_size;
+    if (num_msgs == 0) {
+        return;
+    }
+
+    meta->timestamp = metadata_get_timestamp(msg);
+    meta->channel_mask = metadata_get_channel_mask(msg);
+    if (meta->channel_mask != 0) {
+        meta->channel = metadata_get_channel(msg);
+    }
+
+    meta->actual_count = (unsigned int)
+        (num_msgs * (bytes_to_samples(stream->format, msg_size) - hdr_samples));
+
+    for (i = 0; i < num_msgs; i++, msg += msg_size) {
+        /* Earlier FPGAs leave arbitrary values in RX header flags */
+        const uint32_t flags = stream->rx_overflow_flags ?
+                               metadata_get_flags(msg) : 0;
+
+        if (flags & BLADERF_META_FLAG_RX_OVERFLOW) {
+            meta->status |= BLADERF_META_STATUS_FPGA_OVERFLOW;
+            meta->fpga_dropped_samples += flags &
+                                          BLADERF_META_FLAG_RX_DROPPED_MASK;
+        }
+
+        meta->flags |= flags & ~BLADERF_META_FLAG_RX_DROPPED_MASK;
+
+        if (i < stream->msg_index_len) {
+            struct bladerf_stream_msg *entry = &stream->msg_index[i];
+
+            entry->timestamp = metadata_get_timestamp(msg);
+            entry->flags = flags;
+            entry->offset = (uint32_t)
+                (bytes_to_samples(stream->format, i * msg_size) + hdr_samples);
+        }
+    }
+
+    stream->msg_index_count = (unsigned int)
+        (num_msgs < stream->msg_index_len ? num_msgs : stream->msg_index_len);
+}
+
+int async_set_msg_index(struct bladerf_stream *stream, bool enable)
+{
+    size_t len;
+
+    if (!format_has_metadata(stream->format)) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    free(stream->msg_index);
+    stream->msg_index = NULL;
+    stream->msg_index_len = 0;
+    stream->msg_index_count = 0;
+
+    if (!enable) {
+        return 0;
+    }
+
+    len = async_stream_buf_bytes(stream) / stream->dev->msg_size;
+    if (len == 0) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    stream->msg_index = calloc(len, sizeof(stream->msg_index[0]));
+    if (stream->msg_index == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    stream->msg_index_len = (unsigned int) len;
+    return 0;
+}
+
+int async_set_batch(struct bladerf_stream *stream, bladerf_stream_batch_cb cb,
+                    unsigned int max_batch)
+{
+    if (cb != NULL && max_batch == 0) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (cb != NULL && !stream->batch_capable) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    free(stream->batch);
+    free(stream->batch_next);
+    stream->batch = NULL;
+    stream->batch_next = NULL;
+    stream->batch_cb = NULL;
+    stream->batch_max = 0;
+    stream->batch_count = 0;
+
+    if (cb == NULL) {
+        return 0;
+    }
+
+    /* No more buffers than the stream has can complete at once */
+    if (max_batch > stream->num_buffers) {
+        max_batch = (unsigned int) stream->num_buffers;
+    }
+
+    stream->batch = calloc(max_batch, sizeof(stream->batch[0]));
+    stream->batch_next = calloc(max_batch, sizeof(stream->batch_next[0]));
+    if (stream->batch == NULL || stream->batch_next == NULL) {
+        free(stream->batch);
+        free(stream->batch_next);
+        stream->batch = NULL;
+        stream->batch_next = NULL;
+        return BLADERF_ERR_MEM;
+    }
+
+    stream->batch_cb = cb;
+    stream->batch_max = max_batch;
+    return 0;
+}
+
+bool async_batch_add(struct bladerf_stream *stream, void *samples,
+                     size_t num_samples)
+{
+    struct bladerf_stream_completion *c = &stream->batch[stream->batch_count];
+
+    assert(stream->batch_count < stream->batch_max);
+
+    c->samples = samples;
+    c->num_samples = num_samples;
+    async_rx_metadata(stream, samples, num_samples, &c->meta);
+
+    return ++stream->batch_count == stream->batch_max;
+}
+
+unsigned int async_batch_deliver(struct bladerf_stream *stream)
+{
+    const unsigned int count = stream->batch_count;
+    uint64_t start_us;
+    unsigned int i;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    for (i = 0; i < count; i++) {
+        stream->batch_next[i] = BLADERF_STREAM_NO_DATA;
+    }
+
+    start_us = async_stats_time_us();
+
+#   if !ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+    MUTEX_UNLOCK(&stream->lock);
+#   endif
+
+    stream->batch_cb(stream->dev, stream, stream->batch, count,
+                     stream->batch_next, stream->user_data);
+
+#   if !ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+    MUTEX_LOCK(&stream->lock);
+#   endif
+
+    async_stats_hist_add(stream->stats.callback_hist, start_us,
+                         async_stats_time_us());
+
+    stream->batch_count = 0;
+
+    /* Nothing after a shutdown request is submitted */
+    for (i = 0; i < count; i++) {
+        if (stream->batch_next[i] == BLADERF_STREAM_SHUTDOWN) {
+            return i + 1;
+        }
+    }
+
+    return count;
+}
+
+/* Wait for a stream to start running, prior to submitting buffers to it.
+ * The caller must hold stream->lock. */
+static int wait_for_stream_start(struct bladerf_stream *stream,
+                                 unsigned int timeout_ms)
+{
+    int status = 0;
+    struct timespec timeout_abs;
+
+    if (stream->state != STREAM_RUNNING && timeout_ms != 0) {
+        status = populate_abs_timeout(&timeout_abs, timeout_ms);
+        if (status != 0) {
+            log_debug("Failed to populate timeout value\n");
+            return status;
+        }
+    }
+
+    while (stream->state != STREAM_RUNNING) {
+        log_debug("Buffer submitted while stream's not running. "
+                "Waiting for stream to start.\n");
+
+        if (timeout_ms == 0) {
+            status = pthread_cond_wait(&stream->stream_started,
+                                       &stream->lock);
+        } else {
+            status = pthread_cond_timedwait(&stream->stream_started,
+                    &stream->lock, &timeout_abs);
+        }
+
+        if (status == ETIMEDOUT) {
+            log_debug("%s: %u ms timeout expired",
+                      __FUNCTION__, timeout_ms);
+            return BLADERF_ERR_TIMEOUT;
+        } else if (status != 0) {
+            return BLADERF_ERR_UNEXPECTED;
+        }
+    }
+
+    return 0;
+}
+
 int async_submit_stream_buffer(struct bladerf_stream *stream,
                                void *buffer,
                                unsigned int timeout_ms)
 {
     int status = 0;
-    struct timespec timeout_abs;
 
     MUTEX_LOCK(&stream->lock);
 
     if (buffer != BLADERF_STREAM_SHUTDOWN) {
-        if (stream->state != STREAM_RUNNING && timeout_ms != 0) {
-            status = populate_abs_timeout(&timeout_abs, timeout_ms);
-            if (status != 0) {
-                log_debug("Failed to populate timeout value\n");
-                goto error;
-            }
-        }
+        status = wait_for_stream_start(stream, timeout_ms);
+    }
 
-        while (stream->state != STREAM_RUNNING) {
-            log_debug("Buffer submitted while stream's not running. "
-                    "Waiting for stream to start.\n");
+    if (status == 0) {
+        status = stream->dev->fn->submit_stream_buffer(stream, buffer,
+                                                       timeout_ms);
+    }
 
-            if (timeout_ms == 0) {
-                status = pthread_cond_wait(&stream->stream_started,
-                                           &stream->lock);
-            } else {
-                status = pthread_cond_timedwait(&stream->stream_started,
-                        &stream->lock, &timeout_abs);
-            }
+    MUTEX_UNLOCK(&stream->lock);
+    return status;
+}
 
-            if (status == ETIMEDOUT) {
-                status = BLADERF_ERR_TIMEOUT;
-                log_debug("%s: %u ms timeout expired",
-                          __FUNCTION__, timeout_ms);
-                goto error;
-            } else if (status != 0) {
-                status = BLADERF_ERR_UNEXPECTED;
-                goto error;
-            }
+int async_submit_stream_buffers(struct bladerf_stream *stream,
+                                void **buffers,
+                                unsigned int num_buffers,
+                                unsigned int *num_submitted,
+                                unsigned int timeout_ms)
+{
+    int status = 0;
+    unsigned int i;
+
+    if (num_submitted != NULL) {
+        *num_submitted = 0;
+    }
+
+    for (i = 0; i < num_buffers; i++) {
+        if (buffers[i] == BLADERF_STREAM_SHUTDOWN ||
+            buffers[i] == BLADERF_STREAM_NO_DATA) {
+            log_debug("%s: Buffer %u is not a valid buffer\n",
+                      __FUNCTION__, i);
+            return BLADERF_ERR_INVAL;
         }
     }
 
-    status = stream->dev->fn->submit_stream_buffer(stream, buffer, timeout_ms);
+    if (num_buffers == 0) {
+        return 0;
+    }
+
+    MUTEX_LOCK(&stream->lock);
+
+    status = wait_for_stream_start(stream, timeout_ms);
+
+    for (i = 0; i < num_buffers && status == 0; i++) {
+        status = stream->dev->fn->submit_stream_buffer(stream, buffers[i],
+                                                       timeout_ms);
+        if (status == 0 && num_submitted != NULL) {
+            *num_submitted = i + 1;
+        }
+    }
 
-error:
     MUTEX_UNLOCK(&stream->lock);
     return status;
 }
 
 void async_deinit_stream(struct bladerf_stream *stream)
 {
-    size_t i;
-
     if (!stream) {
         log_debug("%s called with NULL stream\n", __FUNCTION__);
         return;
@@ -219,13 +835,15 @@ void async_deinit_stream(struct bladerf_stream *stream)
     stream->dev->fn->deinit_stream(stream);
 
     /* Free up the buffers */
-    for (i = 0; i < stream->num_buffers; i++) {
-        free(stream->buffers[i]);
-    }
+    free_buffer_arena(stream);
 
     /* Free up the pointer to the buffers */
     free(stream->buffers);
 
+    free(stream->msg_index);
+    free(stream->batch);
+    free(stream->batch_next);
+
     /* Free up the stream itself */
     free(stream);
 }
@@ -35,6 +35,13 @@ typedef enum {
     STREAM_DONE             /* Done and deallocated */
 } bladerf_stream_state;
 
+typedef enum {
+    ARENA_NONE,             /* Not allocated */
+    ARENA_PAGES,            /* Anonymous pages from the OS */
+    ARENA_HUGEPAGES,        /* Huge pages from the OS */
+    ARENA_DEVICE_MEM,       /* DMA-able memory provided by the backend */
+} async_arena_type;
+
 struct bladerf_stream {
 
     /* These items are configured in async_init_stream() and should only be
@@ -44,10 +51,26 @@ struct bladerf_stream {
     bladerf_format format;
     bladerf_stream_cb cb;
     void *user_data;
+    bool rx_overflow_flags;     /* RX message headers report FPGA overflows */
     size_t samples_per_buffer;
     size_t num_buffers;
     void **buffers;
 
+    /* Single region of memory backing all of the above buffers */
+    struct async_buffer_arena {
+        void *mem;
+        size_t size;
+        async_arena_type type;
+        bool locked;
+        bool numa_bound;        /* Allocated on the stream's numa_node */
+    } arena;
+
+    /* NUMA node of the device, or -1 if unknown or not to be used, and the
+     * CPUs of threads without a configured CPU affinity are pinned to (or 0
+     * to leave them unchanged) */
+    int numa_node;
+    uint64_t numa_cpus;
+
     MUTEX lock;
 
     /* The following items must be accessed atomically */
@@ -56,8 +79,92 @@ struct bladerf_stream {
     pthread_cond_t can_submit_buffer;
     pthread_cond_t stream_started;
     void *backend_data;
+
+    /* Copied from the device when the stream is initialized */
+    struct bladerf_stream_thread_config thread_config[NUM_MODULES];
+    unsigned int bufs_per_transfer[NUM_MODULES];
+    uint32_t buffer_flags;
+
+    /* Maximum number of buffers the backend may have in flight. 0 implies
+     * no limit beyond the number of transfers. This may be changed at any
+     * time via async_set_transfer_limit(). */
+    volatile unsigned int transfer_limit;
+
+    /* Per-message metadata of the buffer passed to the current RX callback,
+     * built by async_rx_metadata() when msg_index is non-NULL. Only the
+     * stream's callback context accesses this while the stream runs. */
+    struct bladerf_stream_msg *msg_index;
+    unsigned int msg_index_len;     /* Number of entries allocated */
+    unsigned int msg_index_count;   /* Number of entries valid */
+
+    /* Batched delivery of completed buffers, configured via
+     * async_set_batch() before the stream runs. Backends that support it
+     * set batch_capable in their init_stream(), and collect completions via
+     * async_batch_add() while holding the stream lock. */
+    bool batch_capable;
+    bladerf_stream_batch_cb batch_cb;
+    unsigned int batch_max;         /* Capacity of the arrays below */
+    unsigned int batch_count;       /* # of completions collected */
+    struct bladerf_stream_completion *batch;
+    void **batch_next;              /* Buffers returned by batch_cb */
+
+    /* Maintained by the backend while holding the stream lock */
+    struct async_stream_stats {
+        uint64_t transfers;         /* Successfully completed transfers */
+        uint64_t short_transfers;   /* Completed with less data than expected */
+        uint64_t callback_hist[BLADERF_STREAM_STATS_HIST_LEN];
+        uint64_t turnaround_hist[BLADERF_STREAM_STATS_HIST_LEN];
+    } stats;
 };
 
+/* Change the number of buffers the backend may have in flight. Buffers
+ * beyond this limit are held by the backend, in order, until earlier
+ * transfers complete. */
+static inline void async_set_transfer_limit(struct bladerf_stream *stream,
+                                            unsigned int limit)
+{
+    ATOMIC_STORE_RELEASE(&stream->transfer_limit, limit);
+}
+
+/* CPUs that a thread executing the stream for the specified module should
+ * be pinned to, or 0 if its affinity is to be left unchanged */
+static inline uint64_t async_thread_cpus(const struct bladerf_stream *stream,
+                                         bladerf_module module)
+{
+    const uint64_t cpus = stream->thread_config[module].cpu_affinity;
+    return (cpus != 0) ? cpus : stream->numa_cpus;
+}
+
+/* Current time in microseconds, for stream timing statistics */
+static inline uint64_t async_stats_time_us(void)
+{
+    struct timespec t;
+
+    if (clock_gettime(CLOCK_REALTIME, &t) != 0) {
+        return 0;
+    }
+
+    return (uint64_t) t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+/* Account for the time between start_us and end_us in a log2-spaced
+ * histogram of BLADERF_STREAM_STATS_HIST_LEN bins */
+static inline void async_stats_hist_add(uint64_t *hist,
+                                        uint64_t start_us, uint64_t end_us)
+{
+    unsigned int bin = 0;
+
+    /* Guard against the realtime clock being stepped backwards */
+    uint64_t d = (end_us > start_us) ? (end_us - start_us) : 0;
+
+    while (d != 0 && bin < (BLADERF_STREAM_STATS_HIST_LEN - 1)) {
+        d >>= 1;
+        bin++;
+    }
+
+    hist[bin]++;
+}
+
 /* Get the number of bytes per stream buffer */
 static inline size_t async_stream_buf_bytes(struct bladerf_stream *s) {
     return samples_to_bytes(s->format, s->samples_per_buffer);
@@ -73,6 +180,55 @@ int async_init_stream(struct bladerf_stream **stream,
                       size_t num_transfers,
                       void *user_data);
 
+/* Initialize a stream that uses caller-owned buffers. The provided array of
+ * buffer pointers is copied; the buffers themselves are not freed when the
+ * stream is deinitialized. */
+int async_init_stream_with_buffers(struct bladerf_stream **stream,
+                                   struct bladerf *dev,
+                                   bladerf_stream_cb callback,
+                                   void **buffers,
+                                   size_t num_buffers,
+                                   bladerf_format format,
+                                   size_t buffer_size,
+                                   size_t num_transfers,
+                                   void *user_data);
+
+/* Populate the metadata passed to a stream callback. For RX streams using a
+ * format with metadata, this summarizes the message headers in `samples`, and
+ * builds the message index if it is enabled. Otherwise, `meta` is zeroed.
+ * Backends call this before each callback. */
+void async_rx_metadata(struct bladerf_stream *stream, const void *samples,
+                       size_t num_samples, struct bladerf_metadata *meta);
+
+/* Enable or disable the stream's message index */
+int async_set_msg_index(struct bladerf_stream *stream, bool enable);
+
+/* Configure the stream's batch callback. A NULL callback disables batched
+ * delivery. */
+int async_set_batch(struct bladerf_stream *stream, bladerf_stream_batch_cb cb,
+                    unsigned int max_batch);
+
+/* Whether completed buffers are delivered to a batch callback */
+static inline bool async_batch_enabled(const struct bladerf_stream *stream)
+{
+    return stream->batch_cb != NULL;
+}
+
+/* Add a completed buffer to the stream's batch, populating its metadata via
+ * async_rx_metadata(). Returns true once the batch is full, at which point
+ * the backend must deliver it via async_batch_deliver() before adding more.
+ * The caller must hold stream->lock. */
+bool async_batch_add(struct bladerf_stream *stream, void *samples,
+                     size_t num_samples);
+
+/* Pass the collected completions to the batch callback, releasing
+ * stream->lock while it executes (unless built with
+ * ENABLE_LIBBLADERF_STREAM_CB_LOCKED). Returns the number of entries of
+ * stream->batch_next that the backend must now act upon, as it would upon
+ * the return value of the stream's per-buffer callback. The caller must hold
+ * stream->lock. */
+unsigned int async_batch_deliver(struct bladerf_stream *stream);
+
 /* Backend code is responsible for acquiring stream->lock in thier callbacks */
 int async_run_stream(struct bladerf_stream *stream, bladerf_module module);
 
@@ -82,6 +238,15 @@ int async_submit_stream_buffer(struct bladerf_stream *stream,
                                void *buffer,
                                unsigned int timeout_ms);
 
+/* Submit multiple buffers, acquiring stream->lock only once. Stops at the
+ * first failure; `num_submitted` (if non-NULL) is updated with the number of
+ * buffers that were submitted. */
+int async_submit_stream_buffers(struct bladerf_stream *stream,
+                                void **buffers,
+                                unsigned int num_buffers,
+                                unsigned int *num_submitted,
+                                unsigned int timeout_ms);
+
 
 void async_deinit_stream(struct bladerf_stream *stream);
 
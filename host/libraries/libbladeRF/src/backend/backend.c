@@ -140,6 +140,15 @@ const char * backend2str(bladerf_backend backend)
         case BLADERF_BACKEND_CYPRESS:
             return BACKEND_STR_CYPRESS;
 
+        case BLADERF_BACKEND_USBFS:
+            return BACKEND_STR_USBFS;
+
+        case BLADERF_BACKEND_DUMMY:
+            return BACKEND_STR_DUMMY;
+
+        case BLADERF_BACKEND_NET:
+            return BACKEND_STR_NET;
+
         default:
             return BACKEND_STR_ANY;
     }
@@ -155,6 +164,12 @@ int str2backend(const char *str, bladerf_backend *backend)
         *backend = BLADERF_BACKEND_LINUX;
     } else if (!strcasecmp(BACKEND_STR_CYPRESS, str)) {
         *backend = BLADERF_BACKEND_CYPRESS;
+    } else if (!strcasecmp(BACKEND_STR_USBFS, str)) {
+        *backend = BLADERF_BACKEND_USBFS;
+    } else if (!strcasecmp(BACKEND_STR_DUMMY, str)) {
+        *backend = BLADERF_BACKEND_DUMMY;
+    } else if (!strcasecmp(BACKEND_STR_NET, str)) {
+        *backend = BLADERF_BACKEND_NET;
     } else if (!strcasecmp(BACKEND_STR_ANY, str)) {
         *backend = BLADERF_BACKEND_ANY;
     } else {
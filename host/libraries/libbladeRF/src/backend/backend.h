@@ -32,6 +32,9 @@
 #define BACKEND_STR_LIBUSB "libusb"
 #define BACKEND_STR_LINUX  "linux"
 #define BACKEND_STR_CYPRESS "cypress"
+#define BACKEND_STR_USBFS  "usbfs"
+#define BACKEND_STR_DUMMY  "dummy"
+#define BACKEND_STR_NET    "net"
 
 /**
  * Specifies what to probe for
@@ -41,6 +44,52 @@ typedef enum {
     BACKEND_PROBE_FX3_BOOTLOADER,
 } backend_probe_target;
 
+/**
+ * A single register access within a batch. For reads, `data` is filled in
+ * once the batch completes.
+ */
+struct backend_reg_access {
+    uint8_t addr;
+    uint8_t data;
+    bool write;
+};
+
+/**
+ * LMS6002D PLL register values written by the FPGA for a scheduled retune
+ */
+struct backend_retune {
+    uint8_t pll[4];     /* PLL registers base + 0 through base + 3 */
+    uint8_t freqsel;    /* PLL register base + 5 */
+    uint8_t vcocap;     /* VCOCAP field of PLL register base + 9 */
+};
+
+/**
+ * Operations in a device-side register access sequence
+ */
+typedef enum {
+    BACKEND_SEQ_WRITE,      /* Write `data` to `addr` */
+    BACKEND_SEQ_READ,       /* Read `addr` into `data` */
+    BACKEND_SEQ_MODIFY,     /* Replace the `mask` bits of `addr` with `data` */
+    BACKEND_SEQ_POLL,       /* Read `addr` up to `tries` times, until
+                             * (reg & mask) == value, leaving the last value
+                             * read in `data` */
+} backend_seq_type;
+
+/**
+ * A single operation within a device-side sequence. A poll's expected value
+ * is given in `data`.
+ */
+struct backend_seq_op {
+    backend_seq_type type;
+    uint8_t addr;
+    uint8_t data;
+    uint8_t mask;
+    uint8_t tries;
+};
+
+/* Maximum number of LMS6002D register writes in a single scheduled update */
+#define BACKEND_SCHEDULED_WRITES_MAX 3
+
 /**
  * Backend-specific function table
  */
@@ -138,8 +187,200 @@ struct backend_fns {
     int (*load_fw_from_bootloader)(bladerf_backend backend,
                                    uint8_t bus, uint8_t addr,
                                    struct fx3_firmware *fw);
+
+    /* Optional: Allocate and free zeroed memory that the backend may transfer
+     * stream samples to and from without intermediate copies. These may be
+     * NULL if the backend does not provide such memory. */
+    void * (*alloc_stream_mem)(struct bladerf *dev, size_t len);
+    void (*free_stream_mem)(struct bladerf *dev, void *mem, size_t len);
+
+    /* Optional: Perform a sequence of LMS6002D register accesses, in order.
+     * Backends may pipeline these accesses, such that only the completion of
+     * the final access is waited upon. May be NULL, in which case lms_write
+     * and lms_read are used for each access. */
+    int (*lms_access_batch)(struct bladerf *dev,
+                            struct backend_reg_access *regs, size_t count);
+
+    /* Optional: Perform a sequence of Si5338 register accesses, in order, as
+     * with lms_access_batch. May be NULL, in which case si5338_write and
+     * si5338_read are used for each access. */
+    int (*si5338_access_batch)(struct bladerf *dev,
+                               struct backend_reg_access *regs, size_t count);
+
+    /* Optional: Queue a retune to be performed by the FPGA once the module's
+     * timestamp counter reaches `timestamp`. May be NULL. */
+    int (*schedule_retune)(struct bladerf *dev, bladerf_module module,
+                           uint64_t timestamp,
+                           const struct backend_retune *regs);
+
+    /* Optional: Queue up to BACKEND_SCHEDULED_WRITES_MAX LMS register writes
+     * to be performed by the FPGA once the module's timestamp counter reaches
+     * `timestamp`. May be NULL. */
+    int (*schedule_lms_writes)(struct bladerf *dev, bladerf_module module,
+                               uint64_t timestamp,
+                               const struct backend_reg_access *regs,
+                               size_t count);
+
+    /* Optional: Read and write an identifier of the loaded FPGA image. The
+     * FPGA retains this until it is reconfigured, at which point it reads
+     * back as 0. FPGAs without support for this read back all 1's. May be
+     * NULL. */
+    int (*get_fpga_image_id)(struct bladerf *dev, uint64_t *id);
+    int (*set_fpga_image_id)(struct bladerf *dev, uint64_t id);
+
+    /* Optional: Compute the CRC-32 (see crc32_update()) of up to one erase
+     * block's worth of flash pages on the device, such that they need not be
+     * read back. Returns BLADERF_ERR_UNSUPPORTED if the device cannot do
+     * this. May be NULL. */
+    int (*flash_crc32)(struct bladerf *dev, uint32_t page, uint32_t count,
+                       uint32_t *crc);
+
+    /* Optional: Configure the number and size (in bytes) of the buffers
+     * backing the device's sample DMA channels, and the sample endpoints'
+     * SuperSpeed burst length, where 0 selects the device's default. The RF
+     * link is restarted to apply the change. The get variant reports the
+     * configuration in effect. May be NULL. */
+    int (*set_dma_config)(struct bladerf *dev, unsigned int count,
+                          unsigned int size);
+    int (*set_burst_len)(struct bladerf *dev, unsigned int len);
+    int (*get_dma_config)(struct bladerf *dev,
+                          struct bladerf_fx3_link_config *config);
+
+    /* Optional: Read, and optionally reset, the device's sample path
+     * performance counters. May be NULL. */
+    int (*get_fx3_stats)(struct bladerf *dev, struct bladerf_fx3_stats *stats,
+                         bool reset);
+
+    /* Optional: Get the duration of the most recent FPGA configuration, in
+     * milliseconds, as measured by the device. Returns BLADERF_ERR_INVAL if
+     * no configuration has completed. May be NULL. */
+    int (*get_fpga_load_time)(struct bladerf *dev, unsigned int *ms);
+
+    /* Optional: Read and write the phase increment of the FPGA's RX digital
+     * down-converter NCO, where 2^32 is one turn per sample. An increment of
+     * 0 bypasses the DDC. May be NULL. */
+    int (*get_rx_nco)(struct bladerf *dev, int32_t *dphase);
+    int (*set_rx_nco)(struct bladerf *dev, int32_t dphase);
+
+    /* Optional: Read and write the mask of RX channels streamed by the
+     * channelizer FPGA image. May be NULL. */
+    int (*get_rx_channels)(struct bladerf *dev, uint32_t *mask);
+    int (*set_rx_channels)(struct bladerf *dev, uint32_t mask);
+
+    /* Optional: Read the estimates of the FPGA's RX DC offset and IQ
+     * imbalance tracking loops. The gain is returned as Q12, where 4096 is
+     * unity. May be NULL. */
+    int (*get_rx_tracking)(struct bladerf *dev,
+                           struct bladerf_rx_tracking *state);
+
+    /* Optional: Read and write the FPGA's sample format register, a mask of
+     * SAMPLE_FMT_* bits. May be NULL. */
+    int (*get_sample_fmt)(struct bladerf *dev, uint32_t *fmt);
+    int (*set_sample_fmt)(struct bladerf *dev, uint32_t fmt);
+
+    /* Optional: Read the FPGA's sample FIFO depths and fill level marks.
+     * A TX low-water mark of 0xffff indicates that no samples have arrived
+     * yet. May be NULL. */
+    int (*get_fifo_levels)(struct bladerf *dev,
+                           struct bladerf_fifo_levels *levels);
+
+    /* Optional: Read the FPGA's late TX message count, in bits 15:0, and
+     * the largest lateness among them, in bits 31:16. May be NULL. */
+    int (*get_tx_late)(struct bladerf *dev, uint32_t *val);
+
+    /* Optional: Read the lower 32 bits of the FPGA's TX sample FIFO
+     * underflow count. May be NULL. */
+    int (*get_tx_underflows)(struct bladerf *dev, uint32_t *count);
+
+    /* Optional: Configure the FPGA's timestamp latch with TIME_LATCH_*
+     * fields, with the value a counter load arms, or read both latched
+     * counters and the TIME_LATCH_* status. May be NULL. */
+    int (*set_time_latch)(struct bladerf *dev, uint32_t cfg, uint64_t load);
+    int (*get_time_latch)(struct bladerf *dev, uint64_t *rx, uint64_t *tx,
+                          uint32_t *status);
+
+    /* Optional: Read and write the FPGA's RX trigger control, threshold and
+     * post-trigger length registers, and read its status register. The
+     * control and status registers hold RX_TRIGGER_* fields. May be NULL. */
+    int (*get_rx_trigger)(struct bladerf *dev, uint32_t *ctrl,
+                          uint32_t *level, uint32_t *post);
+    int (*set_rx_trigger)(struct bladerf *dev, uint32_t ctrl,
+                          uint32_t level, uint32_t post);
+    int (*get_rx_trigger_status)(struct bladerf *dev, uint32_t *status);
+
+    /* Optional: Queue an XB-200 signal path and filter bank change, applied
+     * by the FPGA once the module's timestamp counter reaches `timestamp`.
+     * Only the module's fields of the expansion GPIO value `gpio` are used.
+     * `mix` selects the LMS6002D swap for the mixer path. May be NULL. */
+    int (*schedule_xb200)(struct bladerf *dev, bladerf_module module,
+                          uint64_t timestamp, uint32_t gpio, bool mix);
+
+    /* Optional: Run a sequence of LMS6002D accesses on the device, without
+     * a host round trip per access. The values read by BACKEND_SEQ_READ and
+     * BACKEND_SEQ_POLL operations are stored in their `data` fields. Returns
+     * BLADERF_ERR_TIMEOUT if a poll never matched. May be NULL. */
+    int (*lms_sequence)(struct bladerf *dev, struct backend_seq_op *ops,
+                        unsigned int count);
+
+    /* Optional: Get the statistics of a backend that accesses the device
+     * over a network. May be NULL. */
+    int (*get_net_stats)(struct bladerf *dev, struct bladerf_net_stats *stats);
+
+    /* Optional: Get the number of event handling iterations and the CPU
+     * time (in microseconds) of the thread that services the device's
+     * stream transfers, since the device was opened. May be NULL. */
+    int (*get_event_stats)(struct bladerf *dev, uint64_t *polls,
+                           uint64_t *cpu_us);
+
+    /* Optional: Get the NUMA node that the device is attached to, or -1 if
+     * it is unknown. May be NULL. */
+    int (*get_numa_node)(struct bladerf *dev);
 };
 
+/* FPGA sample format register bits, selecting packed 12-bit or 8-bit
+ * samples, TX symbols, the shift applied to 8-bit samples, and the TX symbol
+ * modulation */
+#define SAMPLE_FMT_RX_PACKED    (1 << 0)
+#define SAMPLE_FMT_TX_PACKED    (1 << 1)
+#define SAMPLE_FMT_RX_SC8       (1 << 2)
+#define SAMPLE_FMT_TX_SC8       (1 << 3)
+#define SAMPLE_FMT_TX_SYMBOLS   (1 << 5)
+
+#define SAMPLE_FMT_RX_SC8_SHIFT_SHIFT   8
+#define SAMPLE_FMT_TX_SC8_SHIFT_SHIFT   12
+#define SAMPLE_FMT_SC8_SHIFT_MASK       0xf
+
+#define SAMPLE_FMT_TX_MOD_SHIFT         16
+#define SAMPLE_FMT_TX_MOD_MASK          0x3
+
+/* FPGA timestamp latch configuration fields, and status fields */
+#define TIME_LATCH_SOURCE_SHIFT     0
+#define TIME_LATCH_SOURCE_MASK      0x3
+#define TIME_LATCH_XB_GPIO_SHIFT    2
+#define TIME_LATCH_XB_GPIO_MASK     0x1f
+#define TIME_LATCH_FALLING          (1 << 7)
+#define TIME_LATCH_CONTINUOUS       (1 << 8)
+#define TIME_LATCH_ACTION_SHIFT     9
+#define TIME_LATCH_ARM              (1 << 11)
+
+#define TIME_LATCH_EDGES_MASK       0xff
+#define TIME_LATCH_RX_ARMED         (1 << 16)
+#define TIME_LATCH_TX_ARMED         (1 << 17)
+
+/* FPGA RX trigger control register bits. The trigger arms on a rising edge
+ * of RX_TRIGGER_CTRL_ARM. */
+#define RX_TRIGGER_CTRL_ENABLE      (1 << 0)
+#define RX_TRIGGER_CTRL_EXTERNAL    (1 << 1)
+#define RX_TRIGGER_CTRL_REARM       (1 << 2)
+#define RX_TRIGGER_CTRL_ARM         (1 << 3)
+#define RX_TRIGGER_CTRL_PRE_SHIFT   16
+#define RX_TRIGGER_CTRL_PRE_MASK    0x3ff
+
+/* FPGA RX trigger status register fields */
+#define RX_TRIGGER_STATUS_COUNT_MASK    0xffff
+#define RX_TRIGGER_STATUS_ARMED         (1 << 16)
+#define RX_TRIGGER_STATUS_CAPTURING     (1 << 17)
+
 /**
  * Open the device using the backend specified in the provided
  * bladerf_devinfo structure.
@@ -1,7 +1,55 @@
 /*
- * Dummy backend to allow libbladeRF to build when no other backends are
- * enabled. This is intended for development purposes only, and should
- * generally should not be enabled for libbladeRF releases.
+ * Dummy backend, which emulates a bladeRF in software. It allows libbladeRF
+ * to build when no other backends are enabled, and allows the library and
+ * its callers to be exercised without hardware. It should not generally be
+ * enabled for libbladeRF releases.
+ *
+ * A dummy device is never found when probing, but may be opened explicitly
+ * via a "dummy" device identifier (e.g., "dummy:"). Such a device emulates
+ * just enough of a bladeRF to be initialized and to stream samples:
+ *
+ *  - LMS6002D, Si5338, and GPIO registers read back what was last written to
+ *    them. The PLL VTUNE comparators report a lock when VCOCAP lies within
+ *    the middle of its range, such that tuning succeeds.
+ *
+ *  - Streams complete transfers at the sample rate derived from the
+ *    emulated Si5338 registers. If the host leaves the emulated device
+ *    without a buffer, it carries on from the current timestamp once one
+ *    is submitted, as it would after an RX overrun or a TX underrun.
+ *
+ *  - Completed RX buffers are filled with samples. By default, both I and Q
+ *    carry a 12-bit ramp of each sample's timestamp, such that dropped or
+ *    reordered samples are easy to spot. With ::BLADERF_FORMAT_SC16_Q11_META,
+ *    each message's header carries its first sample's timestamp, and the
+ *    first message after dropped samples flags them as FPGA v0.1.19 and
+ *    later do. As the emulated FPGA version predates this, libbladeRF
+ *    ignores these flags, and detects the drop from the timestamps instead.
+ *
+ *  - Selecting the ::BLADERF_RX_MUX_32BIT_COUNTER or ::BLADERF_RX_MUX_PRBS
+ *    RX mux via the config GPIO replaces the ramp with that test pattern,
+ *    which advances with the timestamp as the FPGA's would.
+ *
+ *  - The samples in completed TX buffers are discarded, and any metadata
+ *    headers are skipped, such that TX timestamps are not honored. When
+ *    firmware loopback is enabled, these samples are instead queued, and
+ *    received in place of the ramp or test pattern, as soon as their TX
+ *    transfer has completed. RX buffers are padded with zeros when too few
+ *    samples have been transmitted.
+ *
+ * The following environment variables, read when a device is opened, alter
+ * the emulated device's behavior:
+ *
+ *  - BLADERF_DUMMY_SAMPLERATE=<samples/s>: Stream at the specified rate,
+ *    regardless of the sample rate configured on the device.
+ *
+ *  - BLADERF_DUMMY_LATENCY_US=<us>: Delay each transfer's completion by the
+ *    specified amount, emulating the latency of the USB link.
+ *
+ *  - BLADERF_DUMMY_OVERRUN_INTERVAL=<n>: Drop a transfer's worth of RX
+ *    samples every n transfers, as though an overrun occurred.
+ *
+ * This makes the dummy backend suitable for measuring host-side streaming
+ * overhead without hardware.
  *
  * This file is part of the bladeRF project:
  *   http://www.github.com/nuand/bladeRF
@@ -22,8 +70,218 @@
  * License along with this library; if not, write to the Free Software
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "rel_assert.h"
 #include "bladerf_priv.h"
 #include "backend.h"
+#include "async.h"
+#include "metadata.h"
+#include "flash_fields.h"
+#include "conversions.h"
+#include "log.h"
+
+#ifndef ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+#   define ENABLE_LIBBLADERF_STREAM_CB_LOCKED 0
+#endif
+
+/* Versions reported by dummy devices */
+#define DUMMY_FW_VERSION_STR    "1.9.0-dummy"
+#define DUMMY_FPGA_MAJOR        0
+#define DUMMY_FPGA_MINOR        1
+#define DUMMY_FPGA_PATCH        2
+
+/* Stream transfer timeout */
+#define DUMMY_TIMEOUT_MS        1000
+
+/* Serial number reported when the device identifier does not specify one */
+#define DUMMY_SERIAL            "00000000000000000000000000000000"
+
+/* Si5338 VCO frequency, and the multisynths that clock the RX and TX
+ * modules, as configured by si5338.c */
+#define DUMMY_SI5338_F_VCO      (38400000.0 * 66.0)
+#define DUMMY_SI5338_MS_RX      1
+#define DUMMY_SI5338_MS_TX      2
+
+/* Range of VCOCAP values for which the emulated VCO is considered locked */
+#define DUMMY_VCOCAP_LOCK_MIN   16
+#define DUMMY_VCOCAP_LOCK_MAX   48
+
+/* Number of samples buffered between TX and RX in firmware loopback mode.
+ * Must be a power of two. When full, the oldest samples are overwritten. */
+#ifndef DUMMY_LOOPBACK_LEN
+#   define DUMMY_LOOPBACK_LEN   (1 << 20)
+#endif
+
+#define DUMMY_ENV_SAMPLERATE        "BLADERF_DUMMY_SAMPLERATE"
+#define DUMMY_ENV_LATENCY           "BLADERF_DUMMY_LATENCY_US"
+#define DUMMY_ENV_OVERRUN_INTERVAL  "BLADERF_DUMMY_OVERRUN_INTERVAL"
+
+/* Most dropped samples the PRBS test pattern is stepped over, before the
+ * sequence is restarted instead */
+#define DUMMY_PRBS_MAX_STEP     (1 << 24)
+
+extern const struct backend_fns backend_fns_dummy;
+
+/* Free-running timestamp counter, advanced at a module's sample rate */
+struct dummy_counter {
+    uint64_t base;              /* Count at t_base_ns */
+    uint64_t t_base_ns;
+    double rate;                /* samples/s */
+};
+
+struct bladerf_dummy {
+    MUTEX lock;                 /* Protects all of the below */
+
+    uint8_t lms_regs[LMS_NUM_REGISTERS];
+    uint8_t si5338_regs[256];
+
+    uint32_t config_gpio;
+    uint32_t xb_gpio;
+    uint32_t xb_gpio_dir;
+
+    int16_t corrections[NUM_MODULES][4];
+    bool fw_loopback;
+
+    /* Next PRBS test pattern word, for the sample at prbs_timestamp */
+    uint32_t prbs;
+    uint64_t prbs_timestamp;
+
+    struct dummy_counter counters[NUM_MODULES];
+
+    /* Configuration taken from the environment. 0 disables each. */
+    unsigned int rate_override;         /* samples/s */
+    uint64_t latency_ns;
+    unsigned int overrun_interval;      /* RX transfers */
+
+    /* Samples transmitted but not yet received in loopback mode,
+     * as interleaved I/Q pairs */
+    int16_t *lb_samples;
+    size_t lb_head;                     /* Oldest sample */
+    size_t lb_count;
+};
+
+struct dummy_stream_data {
+    /* Signaled when buffers are submitted and when shutting down */
+    pthread_cond_t changed;
+
+    /* Buffers in flight, in submission order */
+    void **queue;
+    uint64_t *submit_us;
+    size_t num_transfers;
+    size_t head;
+    size_t count;
+
+    /* Samples the device produces or consumes per transfer, excluding any
+     * metadata headers */
+    uint64_t samples_per_transfer;
+
+    /* Emulated device progress since t0_ns */
+    double rate;
+    uint64_t t0_ns;
+    uint64_t samples;
+    uint64_t timestamp;         /* Timestamp of the sample at t0_ns */
+    uint64_t lost;              /* RX samples dropped since the last
+                                 * message, as reported by its flags */
+
+    uint64_t latency_ns;        /* Added to each completion time */
+    unsigned int overrun_interval;
+    uint64_t completed;         /* # of transfers completed */
+};
+
+static inline struct bladerf_dummy *dummy_backend(struct bladerf *dev)
+{
+    return (struct bladerf_dummy *) dev->backend;
+}
+
+static uint64_t dummy_time_ns(void)
+{
+    struct timespec t;
+
+    if (clock_gettime(CLOCK_REALTIME, &t) != 0) {
+        return 0;
+    }
+
+    return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+/* Sample rate of the module, as derived from the multisynth registers.
+ * The dummy lock must be held. */
+static double dummy_sample_rate(struct bladerf_dummy *d,
+                                bladerf_module module)
+{
+    const unsigned int index = (module == BLADERF_MODULE_RX) ?
+                                DUMMY_SI5338_MS_RX : DUMMY_SI5338_MS_TX;
+    const uint8_t *regs = &d->si5338_regs[53 + index * 11];
+    const unsigned int r = 1 << ((d->si5338_regs[31 + index] >> 2) & 7);
+    uint32_t p1, p2, p3;
+    double ms;
+
+    if (d->rate_override != 0) {
+        return d->rate_override;
+    }
+
+    p1 = ((regs[2] & 3) << 16) | (regs[1] << 8) | regs[0];
+    p2 = ((uint32_t) regs[5] << 22) | (regs[4] << 14) | (regs[3] << 6) |
+         ((regs[2] >> 2) & 0x3f);
+    p3 = ((uint32_t) (regs[9] & 0x3f) << 24) | (regs[8] << 16) |
+         (regs[7] << 8) | regs[6];
+
+    /* P1 = floor(128 * (a + b/c)) - 512, P2 = (128 * b) mod c, P3 = c */
+    ms = (p1 + 512) / 128.0;
+    if (p3 != 0) {
+        ms += (double) p2 / p3 / 128.0;
+    }
+
+    /* The LMS6002D requires a 2:1 clock to sample rate ratio */
+    return DUMMY_SI5338_F_VCO / (2.0 * r * ms);
+}
+
+/* Read a module's timestamp counter, rebasing it if the sample rate has
+ * changed. The dummy lock must be held. */
+static uint64_t dummy_counter_read(struct bladerf_dummy *d,
+                                   bladerf_module module, uint64_t now_ns)
+{
+    struct dummy_counter *c = &d->counters[module];
+    const double rate = dummy_sample_rate(d, module);
+    const uint64_t count = c->base +
+                (uint64_t) ((now_ns - c->t_base_ns) * c->rate / 1e9);
+
+    if (rate != c->rate) {
+        c->base = count;
+        c->t_base_ns = now_ns;
+        c->rate = rate;
+    }
+
+    return count;
+}
+
+/* Returns the value of an unsigned integer environment variable, or 0 if it
+ * is not set or is invalid */
+static unsigned int dummy_env_uint(const char *name)
+{
+    const char *str = getenv(name);
+    unsigned int value;
+    bool ok;
+
+    if (str == NULL || str[0] == '\0') {
+        return 0;
+    }
+
+    value = str2uint(str, 0, UINT_MAX, &ok);
+    if (!ok) {
+        log_warning("Ignoring invalid %s value: %s\n", name, str);
+        return 0;
+    }
+
+    log_debug("%s=%u\n", name, value);
+    return value;
+}
 
 /* We never "find" dummy devices */
 int dummy_probe(backend_probe_target probe_target,
@@ -34,18 +292,87 @@ int dummy_probe(backend_probe_target probe_target,
 
 static int dummy_open(struct bladerf *device, struct bladerf_devinfo *info)
 {
-    return BLADERF_ERR_NODEV;
+    int status;
+    struct bladerf_dummy *d;
+    uint64_t now_ns;
+    size_t i;
+
+    /* Only explicit requests for a dummy device are honored */
+    if (info->backend != BLADERF_BACKEND_DUMMY) {
+        return BLADERF_ERR_NODEV;
+    }
+
+    d = (struct bladerf_dummy *) calloc(1, sizeof(*d));
+    if (d == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    MUTEX_INIT(&d->lock);
+
+    d->rate_override = dummy_env_uint(DUMMY_ENV_SAMPLERATE);
+    d->latency_ns = (uint64_t) dummy_env_uint(DUMMY_ENV_LATENCY) * 1000;
+    d->overrun_interval = dummy_env_uint(DUMMY_ENV_OVERRUN_INTERVAL);
+
+    now_ns = dummy_time_ns();
+    for (i = 0; i < NUM_MODULES; i++) {
+        d->counters[i].t_base_ns = now_ns;
+        d->counters[i].rate = dummy_sample_rate(d, (bladerf_module) i);
+    }
+
+    device->fn = &backend_fns_dummy;
+    device->backend = d;
+
+    device->ident.backend = BLADERF_BACKEND_DUMMY;
+    device->ident.usb_bus = 0;
+    device->ident.usb_addr = 0;
+    device->ident.instance = 0;
+
+    if (!strcmp(info->serial, DEVINFO_SERIAL_ANY)) {
+        memcpy(device->ident.serial, DUMMY_SERIAL, sizeof(DUMMY_SERIAL));
+    } else {
+        strncpy(device->ident.serial, info->serial, BLADERF_SERIAL_LENGTH - 1);
+    }
+    device->ident.serial[BLADERF_SERIAL_LENGTH - 1] = '\0';
+
+    device->transfer_timeout[BLADERF_MODULE_TX] = DUMMY_TIMEOUT_MS;
+    device->transfer_timeout[BLADERF_MODULE_RX] = DUMMY_TIMEOUT_MS;
+
+    strncpy((char *) device->fw_version.describe, DUMMY_FW_VERSION_STR,
+            BLADERF_VERSION_STR_MAX);
+    status = str2version(device->fw_version.describe, &device->fw_version);
+    if (status != 0) {
+        free(d);
+        device->backend = NULL;
+        device->fn = NULL;
+        return status;
+    }
+
+    device->fpga_version.major = DUMMY_FPGA_MAJOR;
+    device->fpga_version.minor = DUMMY_FPGA_MINOR;
+    device->fpga_version.patch = DUMMY_FPGA_PATCH;
+    snprintf((char *) device->fpga_version.describe, BLADERF_VERSION_STR_MAX,
+             "%d.%d.%d-dummy",
+             DUMMY_FPGA_MAJOR, DUMMY_FPGA_MINOR, DUMMY_FPGA_PATCH);
+
+    log_verbose("Opened dummy device %s\n", device->ident.serial);
+    return 0;
 }
 
 
 static void dummy_close(struct bladerf *dev)
 {
-    /* Nothing to do */
+    struct bladerf_dummy *d = dummy_backend(dev);
+
+    if (d != NULL) {
+        free(d->lb_samples);
+        free(d);
+        dev->backend = NULL;
+    }
 }
 
 static bool dummy_matches(bladerf_backend backend)
 {
-    return false;
+    return backend == BLADERF_BACKEND_DUMMY;
 }
 
 static int dummy_load_fpga(struct bladerf *dev, uint8_t *image, size_t image_size)
@@ -55,7 +382,7 @@ static int dummy_load_fpga(struct bladerf *dev, uint8_t *image, size_t image_siz
 
 static int dummy_is_fpga_configured(struct bladerf *dev)
 {
-    return 0;
+    return 1;
 }
 
 static int dummy_erase_flash_blocks(struct bladerf *dev,
@@ -64,9 +391,11 @@ static int dummy_erase_flash_blocks(struct bladerf *dev,
     return 0;
 }
 
+/* The flash reads back as erased */
 static int dummy_read_flash_pages(struct bladerf *dev, uint8_t *buf,
                                   uint32_t page, uint32_t count)
 {
+    memset(buf, 0xff, (size_t) count * BLADERF_FLASH_PAGE_SIZE);
     return 0;
 }
 
@@ -88,85 +417,231 @@ static int dummy_jump_to_bootloader(struct bladerf *dev)
 
 static int dummy_get_cal(struct bladerf *dev, char *cal)
 {
-    return 0;
+    int status;
+
+    memset(cal, 0xff, CAL_BUFFER_SIZE);
+
+    status = add_field(cal, CAL_BUFFER_SIZE, "B", "40");
+    if (status == 0) {
+        status = add_field(cal, CAL_BUFFER_SIZE, "DAC", "32768");
+    }
+
+    return status;
 }
 
 static int dummy_get_otp(struct bladerf *dev, char *otp)
 {
-    return 0;
+    memset(otp, 0xff, OTP_BUFFER_SIZE);
+    return add_field(otp, OTP_BUFFER_SIZE, "S", dev->ident.serial);
 }
 
 static int dummy_get_device_speed(struct bladerf *dev,
                                  bladerf_dev_speed *device_speed)
 {
+    *device_speed = BLADERF_DEVICE_SPEED_SUPER;
     return 0;
 }
 
 static int dummy_config_gpio_write(struct bladerf *dev, uint32_t val)
 {
+    struct bladerf_dummy *d = dummy_backend(dev);
+
+    MUTEX_LOCK(&d->lock);
+    dev->ctrl_requests++;
+    d->config_gpio = val;
+    MUTEX_UNLOCK(&d->lock);
+
     return 0;
 }
 
 static int dummy_config_gpio_read(struct bladerf *dev, uint32_t *val)
 {
+    struct bladerf_dummy *d = dummy_backend(dev);
+
+    MUTEX_LOCK(&d->lock);
+    dev->ctrl_requests++;
+    *val = d->config_gpio;
+    MUTEX_UNLOCK(&d->lock);
+
     return 0;
 }
 
 static int dummy_expansion_gpio_write(struct bladerf *dev, uint32_t val)
 {
+    struct bladerf_dummy *d = dummy_backend(dev);
+
+    MUTEX_LOCK(&d->lock);
+    dev->ctrl_requests++;
+    d->xb_gpio = val;
+    MUTEX_UNLOCK(&d->lock);
+
     return 0;
 }
 
 static int dummy_expansion_gpio_read(struct bladerf *dev, uint32_t *val)
 {
+    struct bladerf_dummy *d = dummy_backend(dev);
+
+    MUTEX_LOCK(&d->lock);
+    dev->ctrl_requests++;
+    *val = d->xb_gpio;
+    MUTEX_UNLOCK(&d->lock);
+
     return 0;
 }
 
 static int dummy_expansion_gpio_dir_write(struct bladerf *dev, uint32_t val)
 {
+    struct bladerf_dummy *d = dummy_backend(dev);
+
+    MUTEX_LOCK(&d->lock);
+    dev->ctrl_requests++;
+    d->xb_gpio_dir = val;
+    MUTEX_UNLOCK(&d->lock);
+
     return 0;
 }
 
 static int dummy_expansion_gpio_dir_read(struct bladerf *dev, uint32_t *val)
 {
+    struct bladerf_dummy *d = dummy_backend(dev);
+
+    MUTEX_LOCK(&d->lock);
+    dev->ctrl_requests++;
+    *val = d->xb_gpio_dir;
+    MUTEX_UNLOCK(&d->lock);
+
     return 0;
 }
 
+static inline bool valid_correction(bladerf_module module,
+                                    bladerf_correction corr)
+{
+    return (module == BLADERF_MODULE_RX || module == BLADERF_MODULE_TX) &&
+           corr >= 0 && corr < 4;
+}
+
 int dummy_set_correction(struct bladerf *dev, bladerf_module module,
                           bladerf_correction corr, int16_t value)
 {
+    struct bladerf_dummy *d = dummy_backend(dev);
+
+    if (!valid_correction(module, corr)) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&d->lock);
+    dev->ctrl_requests++;
+    d->corrections[module][corr] = value;
+    MUTEX_UNLOCK(&d->lock);
+
     return 0;
 }
 
 int dummy_get_correction(struct bladerf *dev, bladerf_module module,
                           bladerf_correction corr, int16_t *value)
 {
+    struct bladerf_dummy *d = dummy_backend(dev);
+
+    if (!valid_correction(module, corr)) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&d->lock);
+    dev->ctrl_requests++;
+    *value = d->corrections[module][corr];
+    MUTEX_UNLOCK(&d->lock);
+
     return 0;
 }
 
 int dummy_get_timestamp(struct bladerf *dev, bladerf_module mod, uint64_t *val)
 {
+    struct bladerf_dummy *d = dummy_backend(dev);
+
+    if (mod != BLADERF_MODULE_RX && mod != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&d->lock);
+    dev->ctrl_requests++;
+    *val = dummy_counter_read(d, mod, dummy_time_ns());
+    MUTEX_UNLOCK(&d->lock);
+
     return 0;
 }
 
 
 static int dummy_si5338_read(struct bladerf *dev, uint8_t addr, uint8_t *data)
 {
+    struct bladerf_dummy *d = dummy_backend(dev);
+
+    MUTEX_LOCK(&d->lock);
+    dev->ctrl_requests++;
+    *data = d->si5338_regs[addr];
+    MUTEX_UNLOCK(&d->lock);
+
     return 0;
 }
 
 static int dummy_si5338_write(struct bladerf *dev, uint8_t addr, uint8_t data)
 {
+    struct bladerf_dummy *d = dummy_backend(dev);
+    const uint64_t now_ns = dummy_time_ns();
+    size_t i;
+
+    MUTEX_LOCK(&d->lock);
+    dev->ctrl_requests++;
+
+    /* Bring the counters up to date at the rate in effect thus far */
+    for (i = 0; i < NUM_MODULES; i++) {
+        dummy_counter_read(d, (bladerf_module) i, now_ns);
+    }
+
+    d->si5338_regs[addr] = data;
+    MUTEX_UNLOCK(&d->lock);
+
     return 0;
 }
 
 static int dummy_lms_write(struct bladerf *dev, uint8_t addr, uint8_t data)
 {
+    struct bladerf_dummy *d = dummy_backend(dev);
+
+    MUTEX_LOCK(&d->lock);
+    dev->ctrl_requests++;
+    d->lms_regs[addr & 0x7f] = data;
+    MUTEX_UNLOCK(&d->lock);
+
     return 0;
 }
 
 static int dummy_lms_read(struct bladerf *dev, uint8_t addr, uint8_t *data)
 {
+    struct bladerf_dummy *d = dummy_backend(dev);
+
+    addr &= 0x7f;
+
+    MUTEX_LOCK(&d->lock);
+    dev->ctrl_requests++;
+
+    if (addr == 0x1a || addr == 0x2a) {
+        /* TX and RX PLL VTUNE comparators, based upon VCOCAP */
+        const uint8_t vcocap = d->lms_regs[addr - 1] & 0x3f;
+
+        if (vcocap < DUMMY_VCOCAP_LOCK_MIN) {
+            *data = 0x80;   /* VTUNE high */
+        } else if (vcocap > DUMMY_VCOCAP_LOCK_MAX) {
+            *data = 0x40;   /* VTUNE low */
+        } else {
+            *data = 0x00;
+        }
+    } else {
+        *data = d->lms_regs[addr];
+    }
+
+    MUTEX_UNLOCK(&d->lock);
+
     return 0;
 }
 
@@ -182,12 +657,38 @@ static int dummy_xb_spi(struct bladerf *dev, uint32_t value)
 
 static int dummy_set_firmware_loopback(struct bladerf *dev, bool enable)
 {
-    return 0;
+    struct bladerf_dummy *d = dummy_backend(dev);
+    int status = 0;
+
+    MUTEX_LOCK(&d->lock);
+
+    if (enable && d->lb_samples == NULL) {
+        d->lb_samples = (int16_t *) malloc(DUMMY_LOOPBACK_LEN * 2 *
+                                           sizeof(d->lb_samples[0]));
+        if (d->lb_samples == NULL) {
+            status = BLADERF_ERR_MEM;
+        }
+    }
+
+    if (status == 0) {
+        d->fw_loopback = enable;
+        d->lb_head = 0;
+        d->lb_count = 0;
+    }
+
+    MUTEX_UNLOCK(&d->lock);
+
+    return status;
 }
 
 static int dummy_get_firmware_loopback(struct bladerf *dev, bool *is_enabled)
 {
-    *is_enabled = false;
+    struct bladerf_dummy *d = dummy_backend(dev);
+
+    MUTEX_LOCK(&d->lock);
+    *is_enabled = d->fw_loopback;
+    MUTEX_UNLOCK(&d->lock);
+
     return 0;
 }
 
@@ -196,26 +697,540 @@ int dummy_enable_module(struct bladerf *dev, bladerf_module m, bool enable)
     return 0;
 }
 
+static void dummy_free_stream_data(struct dummy_stream_data *data)
+{
+    pthread_cond_destroy(&data->changed);
+    free(data->queue);
+    free(data->submit_us);
+    free(data);
+}
+
 static int dummy_init_stream(struct bladerf_stream *stream, size_t num_transfers)
 {
+    struct dummy_stream_data *data;
+
+    data = (struct dummy_stream_data *) calloc(1, sizeof(*data));
+    if (data == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    if (pthread_cond_init(&data->changed, NULL) != 0) {
+        free(data);
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    data->num_transfers = num_transfers;
+    data->queue = (void **) calloc(num_transfers, sizeof(data->queue[0]));
+    data->submit_us =
+        (uint64_t *) calloc(num_transfers, sizeof(data->submit_us[0]));
+
+    if (data->queue == NULL || data->submit_us == NULL) {
+        dummy_free_stream_data(data);
+        return BLADERF_ERR_MEM;
+    }
+
+    data->latency_ns = dummy_backend(stream->dev)->latency_ns;
+    data->overrun_interval = dummy_backend(stream->dev)->overrun_interval;
+
+    stream->backend_data = data;
+    stream->batch_capable = true;
     return 0;
 }
 
+/* Does stream->transfer_limit allow another buffer to be put in flight? */
+static inline bool below_transfer_limit(struct bladerf_stream *stream)
+{
+    struct dummy_stream_data *data = stream->backend_data;
+    const unsigned int limit = ATOMIC_LOAD_ACQUIRE(&stream->transfer_limit);
+
+    return limit == 0 || data->count < limit;
+}
+
+/* Put a buffer in flight. The stream lock must be held. */
+static int queue_buffer(struct bladerf_stream *stream, void *buffer)
+{
+    struct dummy_stream_data *data = stream->backend_data;
+    size_t i;
+
+    if (data->count >= data->num_transfers) {
+        log_error("%s: No transfers available.\n", __FUNCTION__);
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    i = (data->head + data->count) % data->num_transfers;
+    data->queue[i] = buffer;
+    data->submit_us[i] = async_stats_time_us();
+    data->count++;
+
+    pthread_cond_signal(&data->changed);
+    return 0;
+}
+
+/* (Re)start the emulated device's progress from the current time. Samples
+ * that would have been received in the meantime are dropped. */
+static void restart_stream(struct bladerf_stream *stream)
+{
+    struct bladerf_dummy *d = dummy_backend(stream->dev);
+    struct dummy_stream_data *data = stream->backend_data;
+
+    const uint64_t next = data->timestamp + data->samples;
+
+    data->t0_ns = dummy_time_ns();
+    data->samples = 0;
+
+    MUTEX_LOCK(&d->lock);
+    data->timestamp = dummy_counter_read(d, stream->module, data->t0_ns);
+    if (data->completed != 0 && data->timestamp > next) {
+        data->lost += data->timestamp - next;
+    }
+    data->rate = d->counters[stream->module].rate;
+    MUTEX_UNLOCK(&d->lock);
+}
+
+/* Time at which the emulated device finishes the buffer at the head of the
+ * queue */
+static inline uint64_t next_completion_ns(const struct bladerf_stream *stream)
+{
+    const struct dummy_stream_data *data = stream->backend_data;
+    const double samples = (double) (data->samples +
+                                     data->samples_per_transfer);
+
+    return data->t0_ns + (uint64_t) (samples * 1e9 / data->rate) +
+           data->latency_ns;
+}
+
+/* The PRBS test pattern word following `x`, as in prbs_generator.vhd */
+static inline uint32_t prbs_next(uint32_t x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+/* Produce received samples, starting with the one at `timestamp`. In
+ * loopback mode, these are the oldest samples transmitted, followed by zeros
+ * if too few have been. Otherwise, the selected test pattern or a ramp of the
+ * timestamp is produced. */
+static void rx_samples(struct bladerf_dummy *d, int16_t *samples, size_t n,
+                       uint64_t timestamp)
+{
+    size_t i;
+    int rx_mux;
+
+    MUTEX_LOCK(&d->lock);
+
+    rx_mux = (d->config_gpio & BLADERF_GPIO_RX_MUX_MASK) >>
+             BLADERF_GPIO_RX_MUX_SHIFT;
+
+    if (d->fw_loopback) {
+        size_t to_copy = n < d->lb_count ? n : d->lb_count;
+
+        while (to_copy > 0) {
+            size_t len = DUMMY_LOOPBACK_LEN - d->lb_head;
+            if (len > to_copy) {
+                len = to_copy;
+            }
+
+            memcpy(samples, &d->lb_samples[2 * d->lb_head],
+                   len * 2 * sizeof(samples[0]));
+
+            d->lb_head = (d->lb_head + len) & (DUMMY_LOOPBACK_LEN - 1);
+            d->lb_count -= len;
+            samples += 2 * len;
+            n -= len;
+            to_copy -= len;
+        }
+
+        memset(samples, 0, n * 2 * sizeof(samples[0]));
+    } else if (rx_mux == BLADERF_RX_MUX_32BIT_COUNTER) {
+        for (i = 0; i < n; i++) {
+            const uint32_t count = (uint32_t) (timestamp + i);
+            samples[2 * i] = (int16_t) (count & 0xffff);
+            samples[2 * i + 1] = (int16_t) (count >> 16);
+        }
+    } else if (rx_mux == BLADERF_RX_MUX_PRBS) {
+        uint64_t t;
+
+        /* Step over any samples dropped since the last were produced, or
+         * restart the sequence, as the FPGA does when RX is re-enabled, after
+         * a long pause or when asked for earlier samples */
+        if (d->prbs == 0 || timestamp < d->prbs_timestamp ||
+            timestamp - d->prbs_timestamp > DUMMY_PRBS_MAX_STEP) {
+            d->prbs = 1;
+        } else {
+            for (t = d->prbs_timestamp; t < timestamp; t++) {
+                d->prbs = prbs_next(d->prbs);
+            }
+        }
+
+        for (i = 0; i < n; i++) {
+            samples[2 * i] = (int16_t) (d->prbs & 0xffff);
+            samples[2 * i + 1] = (int16_t) (d->prbs >> 16);
+            d->prbs = prbs_next(d->prbs);
+        }
+
+        d->prbs_timestamp = timestamp + n;
+    } else {
+        for (i = 0; i < n; i++) {
+            /* Sign-extend the low 12 bits of the timestamp */
+            const int16_t value = (int16_t) ((timestamp + i) << 4) >> 4;
+            samples[2 * i] = value;
+            samples[2 * i + 1] = value;
+        }
+    }
+
+    MUTEX_UNLOCK(&d->lock);
+}
+
+/* Consume transmitted samples. In loopback mode, these are queued for RX. */
+static void tx_samples(struct bladerf_dummy *d, const int16_t *samples,
+                       size_t n)
+{
+    MUTEX_LOCK(&d->lock);
+
+    if (d->fw_loopback) {
+        /* Only the most recent DUMMY_LOOPBACK_LEN samples can be kept */
+        if (n > DUMMY_LOOPBACK_LEN) {
+            samples += 2 * (n - DUMMY_LOOPBACK_LEN);
+            n = DUMMY_LOOPBACK_LEN;
+        }
+
+        while (n > 0) {
+            const size_t tail = (d->lb_head + d->lb_count) &
+                                (DUMMY_LOOPBACK_LEN - 1);
+            size_t len = DUMMY_LOOPBACK_LEN - tail;
+
+            if (len > n) {
+                len = n;
+            }
+
+            /* Overwrite the oldest samples when full */
+            if (d->lb_count + len > DUMMY_LOOPBACK_LEN) {
+                const size_t drop = d->lb_count + len - DUMMY_LOOPBACK_LEN;
+                d->lb_head = (d->lb_head + drop) & (DUMMY_LOOPBACK_LEN - 1);
+                d->lb_count -= drop;
+            }
+
+            memcpy(&d->lb_samples[2 * tail], samples,
+                   len * 2 * sizeof(samples[0]));
+
+            d->lb_count += len;
+            samples += 2 * len;
+            n -= len;
+        }
+    }
+
+    MUTEX_UNLOCK(&d->lock);
+}
+
+/* Produce the contents of a received buffer, or consume the contents of a
+ * transmitted one. Metadata headers are populated (RX) or skipped (TX).
+ * The first RX message reports the `lost` samples dropped before it, as the
+ * FPGA reports RX FIFO overflows. */
+static void process_buffer(struct bladerf_stream *stream, uint8_t *buffer,
+                           uint64_t timestamp, uint64_t lost)
+{
+    struct bladerf_dummy *d = dummy_backend(stream->dev);
+    const size_t bytes = async_stream_buf_bytes(stream);
+    const bool rx = stream->module == BLADERF_MODULE_RX;
+    size_t msg_size, offset;
+
+    if (stream->format == BLADERF_FORMAT_SC16_Q11_META) {
+        msg_size = stream->dev->msg_size;
+    } else {
+        msg_size = bytes;
+    }
+
+    for (offset = 0; offset + msg_size <= bytes; offset += msg_size) {
+        uint8_t *payload = &buffer[offset];
+        size_t n;
+
+        if (stream->format == BLADERF_FORMAT_SC16_Q11_META) {
+            if (rx) {
+                uint32_t flags = 0;
+
+                if (lost != 0) {
+                    flags = BLADERF_META_FLAG_RX_OVERFLOW |
+                        (uint32_t) (lost < BLADERF_META_FLAG_RX_DROPPED_MASK ?
+                                    lost : BLADERF_META_FLAG_RX_DROPPED_MASK);
+                    lost = 0;
+                }
+
+                metadata_set(payload, timestamp, flags);
+            }
+
+            payload += METADATA_HEADER_SIZE;
+            n = bytes_to_sc16q11(msg_size - METADATA_HEADER_SIZE);
+        } else {
+            n = bytes_to_sc16q11(msg_size);
+        }
+
+        if (rx) {
+            rx_samples(d, (int16_t *) payload, n, timestamp);
+        } else {
+            tx_samples(d, (const int16_t *) payload, n);
+        }
+
+        timestamp += n;
+    }
+}
+
+/* Act upon a buffer returned by a stream callback. The stream lock must be
+ * held. */
+static void handle_next_buffer(struct bladerf_stream *stream,
+                               void *next_buffer)
+{
+    if (next_buffer == BLADERF_STREAM_SHUTDOWN) {
+        stream->state = STREAM_SHUTTING_DOWN;
+    } else if (stream->state == STREAM_RUNNING &&
+               next_buffer != BLADERF_STREAM_NO_DATA &&
+               queue_buffer(stream, next_buffer) != 0) {
+        stream->error_code = BLADERF_ERR_UNEXPECTED;
+        stream->state = STREAM_SHUTTING_DOWN;
+    }
+}
+
+/* Complete the transfer at the head of the queue, and pass the buffer to
+ * the stream callback. The stream lock must be held. */
+static void complete_transfer(struct bladerf_stream *stream)
+{
+    struct dummy_stream_data *data = stream->backend_data;
+    struct bladerf_metadata metadata;
+    void *buffer, *next_buffer;
+    uint64_t now_us, cb_done_us;
+    size_t num_samples;
+
+    buffer = data->queue[data->head];
+    now_us = async_stats_time_us();
+
+    stream->stats.transfers++;
+    async_stats_hist_add(stream->stats.turnaround_hist,
+                         data->submit_us[data->head], now_us);
+
+    data->head = (data->head + 1) % data->num_transfers;
+    data->count--;
+    pthread_cond_signal(&stream->can_submit_buffer);
+
+    data->completed++;
+
+    if (stream->module == BLADERF_MODULE_RX && data->overrun_interval != 0 &&
+        data->completed % data->overrun_interval == 0) {
+        /* Emulate an overrun by skipping the samples of one transfer */
+        log_verbose("%s: Injecting an overrun.\n", __FUNCTION__);
+        data->timestamp += data->samples_per_transfer;
+        data->lost += data->samples_per_transfer;
+    }
+
+    process_buffer(stream, (uint8_t *) buffer,
+                   data->timestamp + data->samples, data->lost);
+    data->lost = 0;
+
+    data->samples += data->samples_per_transfer;
+
+    if (async_batch_enabled(stream)) {
+        /* Deliver the batch once it is full, or once the device would
+         * otherwise idle for want of the buffers it holds */
+        num_samples = bytes_to_samples(stream->format,
+                                       async_stream_buf_bytes(stream));
+
+        if (async_batch_add(stream, buffer, num_samples) || data->count == 0) {
+            const unsigned int n = async_batch_deliver(stream);
+            unsigned int i;
+
+            for (i = 0; i < n; i++) {
+                handle_next_buffer(stream, stream->batch_next[i]);
+            }
+        }
+
+        return;
+    }
+
+    num_samples = bytes_to_sc16q11(async_stream_buf_bytes(stream));
+
+    async_rx_metadata(stream, buffer,
+                      bytes_to_samples(stream->format,
+                                       async_stream_buf_bytes(stream)),
+                      &metadata);
+
+#   if !ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+    MUTEX_UNLOCK(&stream->lock);
+#   endif
+
+    next_buffer = stream->cb(stream->dev,
+                             stream,
+                             &metadata,
+                             buffer,
+                             num_samples,
+                             stream->user_data);
+
+    cb_done_us = async_stats_time_us();
+
+#   if !ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+    MUTEX_LOCK(&stream->lock);
+#   endif
+
+    async_stats_hist_add(stream->stats.callback_hist, now_us, cb_done_us);
+
+    handle_next_buffer(stream, next_buffer);
+}
+
 static int dummy_stream(struct bladerf_stream *stream, bladerf_module module)
 {
+    size_t i;
+    int status = 0;
+    void *buffer;
+    struct timespec deadline;
+    struct bladerf_metadata metadata;
+    struct bladerf *dev = stream->dev;
+    struct dummy_stream_data *data = stream->backend_data;
+
+    /* TX callbacks are given zeroed metadata */
+    memset(&metadata, 0, sizeof(metadata));
+
+    MUTEX_LOCK(&stream->lock);
+
+    data->head = 0;
+    data->count = 0;
+
+    /* With metadata, each message of the buffer begins with a header */
+    if (stream->format == BLADERF_FORMAT_SC16_Q11_META) {
+        const size_t msg_size = dev->msg_size;
+        data->samples_per_transfer =
+            (async_stream_buf_bytes(stream) / msg_size) *
+            bytes_to_sc16q11(msg_size - METADATA_HEADER_SIZE);
+    } else {
+        data->samples_per_transfer = stream->samples_per_buffer;
+    }
+
+    /* Set up initial set of buffers */
+    for (i = 0; i < data->num_transfers; i++) {
+        if (module == BLADERF_MODULE_TX) {
+            buffer = stream->cb(dev,
+                                stream,
+                                &metadata,
+                                NULL,
+                                stream->samples_per_buffer,
+                                stream->user_data);
+
+            if (buffer == BLADERF_STREAM_SHUTDOWN) {
+                stream->state = STREAM_SHUTTING_DOWN;
+                break;
+            }
+        } else {
+            buffer = stream->buffers[i];
+        }
+
+        if (buffer != BLADERF_STREAM_NO_DATA) {
+            status = queue_buffer(stream, buffer);
+            if (status < 0) {
+                stream->error_code = status;
+                stream->state = STREAM_SHUTTING_DOWN;
+                break;
+            }
+        }
+    }
+
+    restart_stream(stream);
+
+    while (stream->state == STREAM_RUNNING) {
+        if (data->count == 0) {
+            /* The device idles until it is given a buffer to work on */
+            pthread_cond_wait(&data->changed, &stream->lock);
+
+            if (data->count != 0) {
+                log_verbose("%s: Dummy stream was idle; dropping samples.\n",
+                            __FUNCTION__);
+                restart_stream(stream);
+            }
+
+            continue;
+        }
+
+        {
+            const uint64_t t_ns = next_completion_ns(stream);
+            deadline.tv_sec = (time_t) (t_ns / 1000000000);
+            deadline.tv_nsec = (long) (t_ns % 1000000000);
+        }
+
+        status = pthread_cond_timedwait(&data->changed, &stream->lock,
+                                        &deadline);
+
+        if (status == ETIMEDOUT) {
+            complete_transfer(stream);
+        } else if (status != 0) {
+            stream->error_code = BLADERF_ERR_UNEXPECTED;
+            stream->state = STREAM_SHUTTING_DOWN;
+        }
+    }
+
+    /* Any buffers still in flight are simply discarded */
+    data->count = 0;
+    stream->state = STREAM_DONE;
+    pthread_cond_broadcast(&stream->can_submit_buffer);
+
+    MUTEX_UNLOCK(&stream->lock);
+
     return 0;
 }
 
+/* The top-level code will have aquired the stream->lock for us */
 static int dummy_submit_stream_buffer(struct bladerf_stream *stream,
                                       void *buffer,
                                       unsigned int timeout_ms)
 {
-    return 0;
+    int status = 0;
+    struct dummy_stream_data *data = stream->backend_data;
+    struct timespec timeout_abs;
+
+    if (buffer == BLADERF_STREAM_SHUTDOWN) {
+        if (stream->state == STREAM_RUNNING) {
+            stream->state = STREAM_SHUTTING_DOWN;
+        }
+
+        pthread_cond_signal(&data->changed);
+        return 0;
+    }
+
+    if (timeout_ms != 0) {
+        status = populate_abs_timeout(&timeout_abs, timeout_ms);
+        if (status != 0) {
+            return BLADERF_ERR_UNEXPECTED;
+        }
+    }
+
+    while ((data->count == data->num_transfers ||
+            !below_transfer_limit(stream)) &&
+           stream->state == STREAM_RUNNING && status == 0) {
+
+        if (timeout_ms != 0) {
+            status = pthread_cond_timedwait(&stream->can_submit_buffer,
+                                            &stream->lock, &timeout_abs);
+        } else {
+            status = pthread_cond_wait(&stream->can_submit_buffer,
+                                       &stream->lock);
+        }
+    }
+
+    if (status == ETIMEDOUT) {
+        log_debug("%s: Timed out waiting for a transfer to become availble.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_TIMEOUT;
+    } else if (status != 0) {
+        return BLADERF_ERR_UNEXPECTED;
+    } else if (stream->state != STREAM_RUNNING) {
+        return BLADERF_ERR_UNEXPECTED;
+    } else {
+        return queue_buffer(stream, buffer);
+    }
 }
 
 void dummy_deinit_stream(struct bladerf_stream *stream)
 {
-    return;
+    if (stream->backend_data != NULL) {
+        dummy_free_stream_data(stream->backend_data);
+        stream->backend_data = NULL;
+    }
 }
 
 
@@ -0,0 +1,1635 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Network backend, providing access to a device attached to another host
+ * running a server (see bladerf_net_serve()).
+ *
+ * Servers are listed in the BLADERF_NET_SERVER environment variable, as a
+ * comma-separated list of host[:port] entries (IPv6 addresses may be given
+ * as [addr]:port), or paths of Unix domain sockets, which begin with '/'.
+ * Each server provides a single device, which is probed as a "net" device
+ * whose instance is the server's position in the list. Like the dummy
+ * backend, this backend is only used when explicitly requested, e.g., via a
+ * "net:" or "net:instance=1" device identifier.
+ *
+ * Control requests are performed over a persistent TCP connection, one
+ * request and response at a time. Register accesses are batched, such that
+ * a batch costs a single round trip. Each stream uses a TCP connection of
+ * its own, carrying frames of exactly one stream buffer, which are received
+ * straight into (or sent straight from) the stream's buffers.
+ *
+ * A server may share its device among several sessions. As other clients
+ * may then change the device's LMS6002D registers, none are cached.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netdb.h>
+
+#include "rel_assert.h"
+#include "bladerf_priv.h"
+#include "backend/backend.h"
+#include "backend/net/net_proto.h"
+#include "async.h"
+#include "conversions.h"
+#include "lms.h"
+#include "log.h"
+
+#ifndef ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+#   define ENABLE_LIBBLADERF_STREAM_CB_LOCKED 0
+#endif
+
+#define NET_ENV_SERVER          "BLADERF_NET_SERVER"
+
+/* Time allowed to establish a connection */
+#ifndef NET_CONNECT_TIMEOUT_MS
+#   define NET_CONNECT_TIMEOUT_MS   2000
+#endif
+
+/* Time allowed for a control request to complete. This accommodates
+ * lengthy operations, such as erasing the flash. */
+#ifndef NET_CTRL_TIMEOUT_MS
+#   define NET_CTRL_TIMEOUT_MS      60000
+#endif
+
+/* Time allowed for the server to accept or deliver a frame of samples */
+#ifndef NET_DATA_TIMEOUT_MS
+#   define NET_DATA_TIMEOUT_MS      5000
+#endif
+
+/* Stream transfer timeout */
+#define NET_TIMEOUT_MS          1000
+
+extern const struct backend_fns backend_fns_net;
+
+struct bladerf_net {
+    /* Control connection. Requests and n->req/n->resp are protected by
+     * dev->xfer_lock. */
+    int fd;
+    struct net_msg req;
+    struct net_msg resp;
+
+    /* Session established by the control connection, which data
+     * connections join */
+    uint32_t session;
+    char server[256];
+
+    bladerf_dev_speed speed;
+
+    /* Protects the following */
+    MUTEX stats_lock;
+    struct bladerf_net_stats stats;
+    double rtt_total_us;
+};
+
+struct net_stream_data {
+    int fd;                     /* Data connection */
+
+    /* Written to when the stream is shut down, to wake an RX stream that
+     * is waiting for samples */
+    int wake[2];
+
+    /* Signaled when buffers are submitted and when shutting down */
+    pthread_cond_t changed;
+
+    /* Buffers in flight, in submission order */
+    void **queue;
+    uint64_t *submit_us;
+    size_t num_transfers;
+    size_t head;
+    size_t count;
+
+    /* RX frames that arrive while no buffer is in flight are received
+     * here and discarded */
+    uint8_t *scratch;
+    uint64_t seq;               /* Next expected (RX) or sent (TX) */
+};
+
+static inline struct bladerf_net *net_backend(struct bladerf *dev)
+{
+    return (struct bladerf_net *) dev->backend;
+}
+
+static uint64_t net_time_us(void)
+{
+    struct timespec t;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &t) != 0) {
+        return 0;
+    }
+
+    return (uint64_t) t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+static void set_timeouts(int fd, unsigned int ms)
+{
+    struct timeval tv;
+
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+/* Split a host[:port] entry, where the host may be a bracketed IPv6
+ * address */
+static int parse_server(const char *entry, char *host, size_t host_len,
+                        char *port, size_t port_len)
+{
+    const char *colon;
+    size_t len;
+
+    if (entry[0] == '[') {
+        const char *end = strchr(entry, ']');
+        if (end == NULL) {
+            return BLADERF_ERR_INVAL;
+        }
+
+        entry++;
+        len = (size_t) (end - entry);
+        colon = (end[1] == ':') ? &end[1] : NULL;
+    } else {
+        colon = strrchr(entry, ':');
+        len = colon ? (size_t) (colon - entry) : strlen(entry);
+    }
+
+    if (len == 0 || len >= host_len) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    memcpy(host, entry, len);
+    host[len] = '\0';
+
+    if (colon != NULL && colon[1] != '\0') {
+        snprintf(port, port_len, "%s", &colon[1]);
+    } else {
+        snprintf(port, port_len, "%u", NET_DEFAULT_PORT);
+    }
+
+    return 0;
+}
+
+/* Get the `index`th entry of the server list, or return BLADERF_ERR_NODEV
+ * if there are fewer entries */
+static int get_server(unsigned int index, char *entry, size_t len)
+{
+    const char *list = getenv(NET_ENV_SERVER);
+    const char *end;
+    unsigned int i;
+
+    if (list == NULL) {
+        return BLADERF_ERR_NODEV;
+    }
+
+    for (i = 0; i < index; i++) {
+        list = strchr(list, ',');
+        if (list == NULL) {
+            return BLADERF_ERR_NODEV;
+        }
+        list++;
+    }
+
+    end = strchr(list, ',');
+    if (end == NULL) {
+        end = list + strlen(list);
+    }
+
+    if (end == list || (size_t) (end - list) >= len) {
+        return BLADERF_ERR_NODEV;
+    }
+
+    memcpy(entry, list, (size_t) (end - list));
+    entry[end - list] = '\0';
+    return 0;
+}
+
+/* Connect to a server on the local host */
+static int net_connect_path(const char *path, bool data, int *fd_out)
+{
+    struct sockaddr_un addr;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        log_debug("Invalid server address: %s\n", path);
+        return BLADERF_ERR_INVAL;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return BLADERF_ERR_NODEV;
+    }
+
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        log_debug("Failed to connect to %s: %s\n", path, strerror(errno));
+        close(fd);
+        return BLADERF_ERR_NODEV;
+    }
+
+    set_timeouts(fd, data ? NET_DATA_TIMEOUT_MS : NET_CTRL_TIMEOUT_MS);
+
+    *fd_out = fd;
+    return 0;
+}
+
+/* Connect to a server, with a timeout */
+static int net_connect(const char *server, bool data, int *fd_out)
+{
+    char host[256], port[16];
+    struct addrinfo hints, *res, *ai;
+    int status, fd = -1;
+
+    if (server[0] == '/') {
+        return net_connect_path(server, data, fd_out);
+    }
+
+    status = parse_server(server, host, sizeof(host), port, sizeof(port));
+    if (status != 0) {
+        log_debug("Invalid server address: %s\n", server);
+        return status;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    status = getaddrinfo(host, port, &hints, &res);
+    if (status != 0) {
+        log_debug("Failed to resolve %s: %s\n", host, gai_strerror(status));
+        return BLADERF_ERR_NODEV;
+    }
+
+    status = BLADERF_ERR_NODEV;
+
+    for (ai = res; ai != NULL && status != 0; ai = ai->ai_next) {
+        struct pollfd pfd;
+        int flags, err = 0;
+        socklen_t err_len = sizeof(err);
+
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+
+        flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            if (errno != EINPROGRESS) {
+                err = errno;
+            } else {
+                pfd.fd = fd;
+                pfd.events = POLLOUT;
+
+                if (poll(&pfd, 1, NET_CONNECT_TIMEOUT_MS) != 1) {
+                    err = ETIMEDOUT;
+                } else {
+                    getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+                }
+            }
+        }
+
+        if (err != 0) {
+            log_debug("Failed to connect to %s: %s\n", server, strerror(err));
+            close(fd);
+            fd = -1;
+            continue;
+        }
+
+        fcntl(fd, F_SETFL, flags);
+        net_config_socket(fd, data);
+        set_timeouts(fd, data ? NET_DATA_TIMEOUT_MS : NET_CTRL_TIMEOUT_MS);
+        status = 0;
+    }
+
+    freeaddrinfo(res);
+
+    *fd_out = fd;
+    return status;
+}
+
+/* Device identification provided by the server in response to a hello */
+struct net_hello {
+    uint32_t session;
+    bladerf_dev_speed speed;
+    char serial[BLADERF_SERIAL_LENGTH];
+    char fw_describe[BLADERF_VERSION_STR_MAX + 1];
+    uint16_t fpga_major, fpga_minor, fpga_patch;
+    char fpga_describe[BLADERF_VERSION_STR_MAX + 1];
+    uint8_t flags;
+};
+
+static int net_hello(int fd, net_role role, uint32_t session,
+                     struct net_hello *hello)
+{
+    struct net_msg msg;
+    struct net_header hdr;
+    int status;
+
+    net_msg_init(&msg);
+    net_put_u16(&msg, NET_PROTO_VERSION);
+    net_put_u8(&msg, (uint8_t) role);
+    net_put_u32(&msg, session);
+
+    status = net_send_msg(fd, NET_MSG_HELLO, 0, &msg, NULL, 0);
+    if (status == 0) {
+        status = net_recv_msg(fd, &hdr, &msg);
+    }
+
+    if (status == 0 && hdr.type != NET_MSG_HELLO) {
+        status = BLADERF_ERR_UNEXPECTED;
+    } else if (status == 0) {
+        status = hdr.status;
+    }
+
+    if (status == 0 && hello != NULL) {
+        const uint16_t version = net_get_u16(&msg);
+
+        hello->session = net_get_u32(&msg);
+        hello->speed = (bladerf_dev_speed) net_get_u8(&msg);
+        net_get_str(&msg, hello->serial, BLADERF_SERIAL_LENGTH - 1);
+        net_get_str(&msg, hello->fw_describe, BLADERF_VERSION_STR_MAX);
+        hello->fpga_major = net_get_u16(&msg);
+        hello->fpga_minor = net_get_u16(&msg);
+        hello->fpga_patch = net_get_u16(&msg);
+        net_get_str(&msg, hello->fpga_describe, BLADERF_VERSION_STR_MAX);
+        hello->flags = net_get_u8(&msg);
+
+        if (msg.error || version != NET_PROTO_VERSION) {
+            log_debug("Unsupported server (protocol v%u)\n", version);
+            status = BLADERF_ERR_UNSUPPORTED;
+        }
+    }
+
+    net_msg_free(&msg);
+    return status;
+}
+
+static int net_probe(backend_probe_target probe_target,
+                     struct bladerf_devinfo_list *info_list)
+{
+    char server[256];
+    struct net_hello hello;
+    struct bladerf_devinfo info;
+    unsigned int i;
+    int fd, status;
+
+    if (probe_target != BACKEND_PROBE_BLADERF) {
+        return 0;
+    }
+
+    for (i = 0; get_server(i, server, sizeof(server)) == 0; i++) {
+        status = net_connect(server, false, &fd);
+        if (status != 0) {
+            continue;
+        }
+
+        status = net_hello(fd, NET_ROLE_PROBE, 0, &hello);
+        close(fd);
+
+        if (status == 0) {
+            memset(&info, 0, sizeof(info));
+            info.backend = BLADERF_BACKEND_NET;
+            memcpy(info.serial, hello.serial, sizeof(info.serial));
+            info.usb_bus = 0;
+            info.usb_addr = 0;
+            info.instance = i;
+
+            status = bladerf_devinfo_list_add(info_list, &info);
+            if (status != 0) {
+                return status;
+            }
+        } else {
+            log_debug("Failed to probe %s: %s\n", server,
+                      bladerf_strerror(status));
+        }
+    }
+
+    return 0;
+}
+
+/* Open a session with the `index`th server, if its device matches */
+static int open_server(struct bladerf *dev, struct bladerf_devinfo *info,
+                       unsigned int index, const char *server)
+{
+    struct bladerf_net *n;
+    struct net_hello hello;
+    struct bladerf_devinfo ident;
+    int fd, status;
+
+    status = net_connect(server, false, &fd);
+    if (status != 0) {
+        return status;
+    }
+
+    status = net_hello(fd, NET_ROLE_CONTROL, 0, &hello);
+    if (status != 0) {
+        log_debug("%s refused the session: %s\n", server,
+                  bladerf_strerror(status));
+        close(fd);
+        return status;
+    }
+
+    memset(&ident, 0, sizeof(ident));
+    memcpy(ident.serial, hello.serial, sizeof(ident.serial));
+    ident.instance = index;
+
+    if (!bladerf_serial_matches(info, &ident)) {
+        close(fd);
+        return BLADERF_ERR_NODEV;
+    }
+
+    n = (struct bladerf_net *) calloc(1, sizeof(*n));
+    if (n == NULL) {
+        close(fd);
+        return BLADERF_ERR_MEM;
+    }
+
+    n->fd = fd;
+    n->session = hello.session;
+    n->speed = hello.speed;
+    snprintf(n->server, sizeof(n->server), "%s", server);
+    net_msg_init(&n->req);
+    net_msg_init(&n->resp);
+    MUTEX_INIT(&n->stats_lock);
+
+    dev->fn = &backend_fns_net;
+    dev->backend = n;
+
+    dev->ident.backend = BLADERF_BACKEND_NET;
+    dev->ident.usb_bus = 0;
+    dev->ident.usb_addr = 0;
+    dev->ident.instance = index;
+    memcpy(dev->ident.serial, hello.serial, sizeof(dev->ident.serial));
+
+    dev->transfer_timeout[BLADERF_MODULE_TX] = NET_TIMEOUT_MS;
+    dev->transfer_timeout[BLADERF_MODULE_RX] = NET_TIMEOUT_MS;
+
+    snprintf((char *) dev->fw_version.describe, BLADERF_VERSION_STR_MAX + 1,
+             "%s", hello.fw_describe);
+    status = str2version(dev->fw_version.describe, &dev->fw_version);
+    if (status != 0) {
+        log_debug("Invalid firmware version: %s\n", hello.fw_describe);
+        goto error;
+    }
+
+    dev->fpga_version.major = hello.fpga_major;
+    dev->fpga_version.minor = hello.fpga_minor;
+    dev->fpga_version.patch = hello.fpga_patch;
+    snprintf((char *) dev->fpga_version.describe, BLADERF_VERSION_STR_MAX + 1,
+             "%s", hello.fpga_describe);
+
+    if (hello.flags & NET_HELLO_SHARED) {
+        unsigned int i;
+
+        log_verbose("%s is shared with other sessions\n", server);
+        for (i = 0; i < LMS_NUM_REGISTERS; i++) {
+            lms_shadow_mark_volatile(dev, (uint8_t) i);
+        }
+    }
+
+    log_verbose("Opened %s on %s\n", dev->ident.serial, server);
+    return 0;
+
+error:
+    close(fd);
+    net_msg_free(&n->req);
+    net_msg_free(&n->resp);
+    free(n);
+    dev->fn = NULL;
+    dev->backend = NULL;
+    return status;
+}
+
+static int net_open(struct bladerf *dev, struct bladerf_devinfo *info)
+{
+    char server[256];
+    unsigned int i;
+    int status = BLADERF_ERR_NODEV;
+
+    /* Only explicit requests for a network device are honored */
+    if (info->backend != BLADERF_BACKEND_NET) {
+        return BLADERF_ERR_NODEV;
+    }
+
+    for (i = 0; status != 0 && get_server(i, server, sizeof(server)) == 0;
+         i++) {
+        if (info->instance == DEVINFO_INST_ANY || info->instance == i) {
+            status = open_server(dev, info, i, server);
+        }
+    }
+
+    return status;
+}
+
+static void net_close(struct bladerf *dev)
+{
+    struct bladerf_net *n = net_backend(dev);
+
+    if (n != NULL) {
+        close(n->fd);
+        net_msg_free(&n->req);
+        net_msg_free(&n->resp);
+        free(n);
+        dev->backend = NULL;
+    }
+}
+
+static bool net_matches(bladerf_backend backend)
+{
+    return backend == BLADERF_BACKEND_NET;
+}
+
+/* Begin a request, returning the message its arguments are to be appended
+ * to. This acquires dev->xfer_lock, which is released by end_request(). */
+static struct net_msg *begin_request(struct bladerf *dev)
+{
+    struct bladerf_net *n = net_backend(dev);
+
+    MUTEX_LOCK(&dev->xfer_lock);
+    net_msg_reset(&n->req);
+    return &n->req;
+}
+
+static void end_request(struct bladerf *dev)
+{
+    MUTEX_UNLOCK(&dev->xfer_lock);
+}
+
+/* Send the request begun by begin_request(), and receive its response into
+ * n->resp. dev->xfer_lock must be held. */
+static int transact(struct bladerf *dev, net_msg_type type)
+{
+    struct bladerf_net *n = net_backend(dev);
+    struct net_header hdr;
+    uint64_t t0, rtt;
+    int status;
+
+    t0 = net_time_us();
+
+    status = net_send_msg(n->fd, (uint16_t) type, 0, &n->req, NULL, 0);
+    if (status == 0) {
+        status = net_recv_msg(n->fd, &hdr, &n->resp);
+    }
+
+    if (status != 0) {
+        log_debug("Request %d to %s failed: %s\n", type, n->server,
+                  bladerf_strerror(status));
+        return status;
+    } else if (hdr.type != type) {
+        log_debug("Unexpected response type: %u\n", hdr.type);
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    rtt = net_time_us() - t0;
+    dev->ctrl_requests++;
+
+    MUTEX_LOCK(&n->stats_lock);
+    if (n->stats.requests == 0 || rtt < n->stats.rtt_min_us) {
+        n->stats.rtt_min_us = (double) rtt;
+    }
+    if (rtt > n->stats.rtt_max_us) {
+        n->stats.rtt_max_us = (double) rtt;
+    }
+    n->stats.requests++;
+    n->rtt_total_us += (double) rtt;
+    MUTEX_UNLOCK(&n->stats_lock);
+
+    return hdr.status;
+}
+
+/* Check that a response was as long as expected */
+static inline int check_response(struct bladerf *dev, int status)
+{
+    if (status == 0 && net_backend(dev)->resp.error) {
+        log_debug("Malformed response from server\n");
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    return status;
+}
+
+/* Perform a request with up to two 32-bit arguments, and no response
+ * payload */
+static int request_u32(struct bladerf *dev, net_msg_type type,
+                       unsigned int argc, uint32_t arg0, uint32_t arg1)
+{
+    struct net_msg *req = begin_request(dev);
+    int status;
+
+    if (argc > 0) {
+        net_put_u32(req, arg0);
+    }
+
+    if (argc > 1) {
+        net_put_u32(req, arg1);
+    }
+
+    status = transact(dev, type);
+    end_request(dev);
+
+    return status;
+}
+
+/* Perform a request with up to two 32-bit arguments, and a 64-bit result */
+static int request_result(struct bladerf *dev, net_msg_type type,
+                          unsigned int argc, uint32_t arg0, uint32_t arg1,
+                          uint64_t *result)
+{
+    struct bladerf_net *n = net_backend(dev);
+    struct net_msg *req = begin_request(dev);
+    int status;
+
+    if (argc > 0) {
+        net_put_u32(req, arg0);
+    }
+
+    if (argc > 1) {
+        net_put_u32(req, arg1);
+    }
+
+    status = transact(dev, type);
+    if (status == 0) {
+        *result = net_get_u64(&n->resp);
+        status = check_response(dev, status);
+    }
+
+    end_request(dev);
+    return status;
+}
+
+static int net_load_fpga(struct bladerf *dev, uint8_t *image,
+                         size_t image_size)
+{
+    struct bladerf_net *n = net_backend(dev);
+    struct net_msg *req;
+    int status;
+
+    req = begin_request(dev);
+    net_put_bytes(req, image, image_size);
+
+    status = transact(dev, NET_MSG_LOAD_FPGA);
+    if (status == 0) {
+        dev->fpga_version.major = net_get_u16(&n->resp);
+        dev->fpga_version.minor = net_get_u16(&n->resp);
+        dev->fpga_version.patch = net_get_u16(&n->resp);
+        net_get_str(&n->resp, (char *) dev->fpga_version.describe,
+                    BLADERF_VERSION_STR_MAX);
+        status = check_response(dev, status);
+    }
+
+    end_request(dev);
+    return status;
+}
+
+static int net_is_fpga_configured(struct bladerf *dev)
+{
+    uint64_t configured;
+    int status;
+
+    status = request_result(dev, NET_MSG_IS_FPGA_CONFIGURED, 0, 0, 0,
+                            &configured);
+
+    return status == 0 ? (configured != 0) : status;
+}
+
+static int net_erase_flash_blocks(struct bladerf *dev,
+                                  uint32_t eb, uint16_t count)
+{
+    return request_u32(dev, NET_MSG_ERASE_FLASH, 2, eb, count);
+}
+
+static int net_read_flash_pages(struct bladerf *dev, uint8_t *buf,
+                                uint32_t page, uint32_t count)
+{
+    struct bladerf_net *n = net_backend(dev);
+    struct net_msg *req = begin_request(dev);
+    int status;
+
+    net_put_u32(req, page);
+    net_put_u32(req, count);
+
+    status = transact(dev, NET_MSG_READ_FLASH);
+    if (status == 0) {
+        net_get_bytes(&n->resp, buf, (size_t) count * BLADERF_FLASH_PAGE_SIZE);
+        status = check_response(dev, status);
+    }
+
+    end_request(dev);
+    return status;
+}
+
+static int net_write_flash_pages(struct bladerf *dev, const uint8_t *buf,
+                                 uint32_t page, uint32_t count)
+{
+    struct net_msg *req = begin_request(dev);
+    int status;
+
+    net_put_u32(req, page);
+    net_put_u32(req, count);
+    net_put_bytes(req, buf, (size_t) count * BLADERF_FLASH_PAGE_SIZE);
+
+    status = transact(dev, NET_MSG_WRITE_FLASH);
+    end_request(dev);
+
+    return status;
+}
+
+static int net_device_reset(struct bladerf *dev)
+{
+    return request_u32(dev, NET_MSG_DEVICE_RESET, 0, 0, 0);
+}
+
+static int net_jump_to_bootloader(struct bladerf *dev)
+{
+    return request_u32(dev, NET_MSG_JUMP_TO_BOOTLOADER, 0, 0, 0);
+}
+
+static int get_region(struct bladerf *dev, net_msg_type type,
+                      char *buf, size_t len)
+{
+    struct bladerf_net *n = net_backend(dev);
+    int status;
+
+    begin_request(dev);
+
+    status = transact(dev, type);
+    if (status == 0) {
+        net_get_bytes(&n->resp, buf, len);
+        status = check_response(dev, status);
+    }
+
+    end_request(dev);
+    return status;
+}
+
+static int net_get_cal(struct bladerf *dev, char *cal)
+{
+    return get_region(dev, NET_MSG_GET_CAL, cal, CAL_BUFFER_SIZE);
+}
+
+static int net_get_otp(struct bladerf *dev, char *otp)
+{
+    return get_region(dev, NET_MSG_GET_OTP, otp, BLADERF_FLASH_PAGE_SIZE);
+}
+
+static int net_get_device_speed(struct bladerf *dev,
+                                bladerf_dev_speed *device_speed)
+{
+    *device_speed = net_backend(dev)->speed;
+    return 0;
+}
+
+static int gpio_read(struct bladerf *dev, net_gpio gpio, uint32_t *val)
+{
+    uint64_t result;
+    int status;
+
+    status = request_result(dev, NET_MSG_GPIO_READ, 1, gpio, 0, &result);
+    if (status == 0) {
+        *val = (uint32_t) result;
+    }
+
+    return status;
+}
+
+static int net_config_gpio_write(struct bladerf *dev, uint32_t val)
+{
+    return request_u32(dev, NET_MSG_GPIO_WRITE, 2, NET_GPIO_CONFIG, val);
+}
+
+static int net_config_gpio_read(struct bladerf *dev, uint32_t *val)
+{
+    return gpio_read(dev, NET_GPIO_CONFIG, val);
+}
+
+static int net_expansion_gpio_write(struct bladerf *dev, uint32_t val)
+{
+    return request_u32(dev, NET_MSG_GPIO_WRITE, 2, NET_GPIO_XB, val);
+}
+
+static int net_expansion_gpio_read(struct bladerf *dev, uint32_t *val)
+{
+    return gpio_read(dev, NET_GPIO_XB, val);
+}
+
+static int net_expansion_gpio_dir_write(struct bladerf *dev, uint32_t val)
+{
+    return request_u32(dev, NET_MSG_GPIO_WRITE, 2, NET_GPIO_XB_DIR, val);
+}
+
+static int net_expansion_gpio_dir_read(struct bladerf *dev, uint32_t *val)
+{
+    return gpio_read(dev, NET_GPIO_XB_DIR, val);
+}
+
+static int net_set_correction(struct bladerf *dev, bladerf_module module,
+                              bladerf_correction corr, int16_t value)
+{
+    struct net_msg *req = begin_request(dev);
+    int status;
+
+    net_put_u32(req, (uint32_t) module);
+    net_put_u32(req, (uint32_t) corr);
+    net_put_u16(req, (uint16_t) value);
+
+    status = transact(dev, NET_MSG_SET_CORRECTION);
+    end_request(dev);
+
+    return status;
+}
+
+static int net_get_correction(struct bladerf *dev, bladerf_module module,
+                              bladerf_correction corr, int16_t *value)
+{
+    uint64_t result;
+    int status;
+
+    status = request_result(dev, NET_MSG_GET_CORRECTION, 2, module, corr,
+                            &result);
+    if (status == 0) {
+        *value = (int16_t) (uint16_t) result;
+    }
+
+    return status;
+}
+
+static int net_get_timestamp(struct bladerf *dev, bladerf_module mod,
+                             uint64_t *value)
+{
+    return request_result(dev, NET_MSG_GET_TIMESTAMP, 1, mod, 0, value);
+}
+
+/* Perform a batch of register accesses with a single request */
+static int access_batch(struct bladerf *dev, net_msg_type type,
+                        struct backend_reg_access *regs, size_t count)
+{
+    struct bladerf_net *n = net_backend(dev);
+    struct net_msg *req = begin_request(dev);
+    size_t i;
+    int status;
+
+    net_put_u32(req, (uint32_t) count);
+    for (i = 0; i < count; i++) {
+        net_put_u8(req, regs[i].addr);
+        net_put_u8(req, regs[i].data);
+        net_put_u8(req, regs[i].write ? 1 : 0);
+    }
+
+    status = transact(dev, type);
+    if (status == 0) {
+        for (i = 0; i < count; i++) {
+            const uint8_t data = net_get_u8(&n->resp);
+            if (!regs[i].write) {
+                regs[i].data = data;
+            }
+        }
+
+        status = check_response(dev, status);
+    }
+
+    end_request(dev);
+    return status;
+}
+
+static int net_lms_access_batch(struct bladerf *dev,
+                                struct backend_reg_access *regs, size_t count)
+{
+    return access_batch(dev, NET_MSG_LMS_BATCH, regs, count);
+}
+
+static int net_si5338_access_batch(struct bladerf *dev,
+                                   struct backend_reg_access *regs,
+                                   size_t count)
+{
+    return access_batch(dev, NET_MSG_SI5338_BATCH, regs, count);
+}
+
+static int net_si5338_write(struct bladerf *dev, uint8_t addr, uint8_t data)
+{
+    struct backend_reg_access reg = { addr, data, true };
+    return access_batch(dev, NET_MSG_SI5338_BATCH, &reg, 1);
+}
+
+static int net_si5338_read(struct bladerf *dev, uint8_t addr, uint8_t *data)
+{
+    struct backend_reg_access reg = { addr, 0, false };
+    int status = access_batch(dev, NET_MSG_SI5338_BATCH, &reg, 1);
+
+    *data = reg.data;
+    return status;
+}
+
+static int net_lms_write(struct bladerf *dev, uint8_t addr, uint8_t data)
+{
+    struct backend_reg_access reg = { addr, data, true };
+    return access_batch(dev, NET_MSG_LMS_BATCH, &reg, 1);
+}
+
+static int net_lms_read(struct bladerf *dev, uint8_t addr, uint8_t *data)
+{
+    struct backend_reg_access reg = { addr, 0, false };
+    int status = access_batch(dev, NET_MSG_LMS_BATCH, &reg, 1);
+
+    *data = reg.data;
+    return status;
+}
+
+static int net_dac_write(struct bladerf *dev, uint16_t value)
+{
+    return request_u32(dev, NET_MSG_DAC_WRITE, 1, value, 0);
+}
+
+static int net_xb_spi(struct bladerf *dev, uint32_t value)
+{
+    return request_u32(dev, NET_MSG_XB_SPI, 1, value, 0);
+}
+
+static int net_set_firmware_loopback(struct bladerf *dev, bool enable)
+{
+    return request_u32(dev, NET_MSG_SET_LOOPBACK, 1, enable ? 1 : 0, 0);
+}
+
+static int net_get_firmware_loopback(struct bladerf *dev, bool *is_enabled)
+{
+    uint64_t result;
+    int status;
+
+    status = request_result(dev, NET_MSG_GET_LOOPBACK, 0, 0, 0, &result);
+    if (status == 0) {
+        *is_enabled = result != 0;
+    }
+
+    return status;
+}
+
+static int net_enable_module(struct bladerf *dev, bladerf_module m,
+                             bool enable)
+{
+    return request_u32(dev, NET_MSG_ENABLE_MODULE, 2, m, enable ? 1 : 0);
+}
+
+static void net_free_stream_data(struct net_stream_data *data)
+{
+    if (data->fd >= 0) {
+        close(data->fd);
+    }
+
+    if (data->wake[0] >= 0) {
+        close(data->wake[0]);
+        close(data->wake[1]);
+    }
+
+    pthread_cond_destroy(&data->changed);
+    free(data->queue);
+    free(data->submit_us);
+    free(data->scratch);
+    free(data);
+}
+
+static int net_init_stream(struct bladerf_stream *stream, size_t num_transfers)
+{
+    struct bladerf_net *n = net_backend(stream->dev);
+    struct net_stream_data *data;
+    int status;
+
+    data = (struct net_stream_data *) calloc(1, sizeof(*data));
+    if (data == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    data->fd = -1;
+    data->wake[0] = data->wake[1] = -1;
+
+    if (pthread_cond_init(&data->changed, NULL) != 0) {
+        free(data);
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    data->num_transfers = num_transfers;
+    data->queue = (void **) calloc(num_transfers, sizeof(data->queue[0]));
+    data->submit_us =
+        (uint64_t *) calloc(num_transfers, sizeof(data->submit_us[0]));
+    data->scratch = (uint8_t *) malloc(async_stream_buf_bytes(stream));
+
+    if (data->queue == NULL || data->submit_us == NULL ||
+        data->scratch == NULL) {
+        status = BLADERF_ERR_MEM;
+        goto error;
+    }
+
+    if (pipe(data->wake) != 0) {
+        data->wake[0] = data->wake[1] = -1;
+        status = BLADERF_ERR_UNEXPECTED;
+        goto error;
+    }
+
+    fcntl(data->wake[0], F_SETFL, O_NONBLOCK);
+
+    status = net_connect(n->server, true, &data->fd);
+    if (status == 0) {
+        status = net_hello(data->fd, NET_ROLE_DATA, n->session, NULL);
+    }
+
+    if (status != 0) {
+        log_debug("Failed to open data connection: %s\n",
+                  bladerf_strerror(status));
+        goto error;
+    }
+
+    stream->backend_data = data;
+    return 0;
+
+error:
+    net_free_stream_data(data);
+    return status;
+}
+
+/* Does stream->transfer_limit allow another buffer to be put in flight? */
+static inline bool below_transfer_limit(struct bladerf_stream *stream)
+{
+    struct net_stream_data *data = stream->backend_data;
+    const unsigned int limit = ATOMIC_LOAD_ACQUIRE(&stream->transfer_limit);
+
+    return limit == 0 || data->count < limit;
+}
+
+/* Put a buffer in flight. The stream lock must be held. */
+static int queue_buffer(struct bladerf_stream *stream, void *buffer)
+{
+    struct net_stream_data *data = stream->backend_data;
+    size_t i;
+
+    if (data->count >= data->num_transfers) {
+        log_error("%s: No transfers available.\n", __FUNCTION__);
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    i = (data->head + data->count) % data->num_transfers;
+    data->queue[i] = buffer;
+    data->submit_us[i] = async_stats_time_us();
+    data->count++;
+
+    pthread_cond_signal(&data->changed);
+    return 0;
+}
+
+/* Complete the transfer at the head of the queue, and pass the buffer to
+ * the stream callback. The stream lock must be held. */
+static void complete_transfer(struct bladerf_stream *stream)
+{
+    struct net_stream_data *data = stream->backend_data;
+    struct bladerf_metadata metadata;
+    const size_t bytes = async_stream_buf_bytes(stream);
+    void *buffer, *next_buffer;
+    uint64_t now_us, cb_done_us;
+
+    buffer = data->queue[data->head];
+    now_us = async_stats_time_us();
+
+    stream->stats.transfers++;
+    async_stats_hist_add(stream->stats.turnaround_hist,
+                         data->submit_us[data->head], now_us);
+
+    data->head = (data->head + 1) % data->num_transfers;
+    data->count--;
+    pthread_cond_signal(&stream->can_submit_buffer);
+
+    async_rx_metadata(stream, buffer, bytes_to_samples(stream->format, bytes),
+                      &metadata);
+
+#   if !ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+    MUTEX_UNLOCK(&stream->lock);
+#   endif
+
+    next_buffer = stream->cb(stream->dev,
+                             stream,
+                             &metadata,
+                             buffer,
+                             bytes_to_samples(stream->format, bytes),
+                             stream->user_data);
+
+    cb_done_us = async_stats_time_us();
+
+#   if !ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+    MUTEX_LOCK(&stream->lock);
+#   endif
+
+    async_stats_hist_add(stream->stats.callback_hist, now_us, cb_done_us);
+
+    if (next_buffer == BLADERF_STREAM_SHUTDOWN) {
+        stream->state = STREAM_SHUTTING_DOWN;
+    } else if (stream->state == STREAM_RUNNING &&
+               next_buffer != BLADERF_STREAM_NO_DATA &&
+               queue_buffer(stream, next_buffer) != 0) {
+        stream->error_code = BLADERF_ERR_UNEXPECTED;
+        stream->state = STREAM_SHUTTING_DOWN;
+    }
+}
+
+/* Receive a frame of samples into the buffer at the head of the queue, or
+ * discard it if there is none. The stream lock must be held, and is
+ * released while the samples are received. */
+static int rx_frame(struct bladerf_stream *stream,
+                    const struct net_header *hdr)
+{
+    struct bladerf_net *n = net_backend(stream->dev);
+    struct net_stream_data *data = stream->backend_data;
+    const size_t bytes = async_stream_buf_bytes(stream);
+    uint8_t seq_buf[NET_SEQ_SIZE];
+    uint64_t seq, lost;
+    uint8_t *dest;
+    int status;
+
+    if (hdr->len != NET_SEQ_SIZE + bytes) {
+        log_debug("%s: Unexpected frame length: %u\n", __FUNCTION__,
+                  hdr->len);
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    /* Only this thread removes buffers from the queue, so the buffer at its
+     * head remains in flight while the lock is released */
+    dest = (data->count > 0) ? (uint8_t *) data->queue[data->head]
+                             : data->scratch;
+
+    MUTEX_UNLOCK(&stream->lock);
+
+    status = net_recv_all(data->fd, seq_buf, sizeof(seq_buf));
+    if (status == 0) {
+        status = net_recv_all(data->fd, dest, bytes);
+    }
+
+    MUTEX_LOCK(&stream->lock);
+
+    if (status != 0) {
+        return status;
+    }
+
+    seq = net_get_le(seq_buf, NET_SEQ_SIZE);
+    lost = (seq > data->seq) ? (seq - data->seq) : 0;
+    data->seq = seq + 1;
+
+    if (dest == data->scratch) {
+        lost++;
+    }
+
+    MUTEX_LOCK(&n->stats_lock);
+    n->stats.rx_frames++;
+    n->stats.rx_frames_lost += lost;
+    n->stats.rx_bytes += bytes;
+    MUTEX_UNLOCK(&n->stats_lock);
+
+    if (dest != data->scratch) {
+        complete_transfer(stream);
+    }
+
+    return 0;
+}
+
+/* Send the buffer at the head of the queue. The stream lock must be held,
+ * and is released while the samples are sent. */
+static int tx_frame(struct bladerf_stream *stream)
+{
+    struct bladerf_net *n = net_backend(stream->dev);
+    struct net_stream_data *data = stream->backend_data;
+    const size_t bytes = async_stream_buf_bytes(stream);
+    void *buffer = data->queue[data->head];
+    struct net_msg seq;
+    uint8_t seq_buf[NET_SEQ_SIZE];
+    int status;
+
+    net_put_le(seq_buf, data->seq++, NET_SEQ_SIZE);
+
+    seq.data = seq_buf;
+    seq.len = seq.size = sizeof(seq_buf);
+    seq.pos = 0;
+    seq.error = false;
+
+    MUTEX_UNLOCK(&stream->lock);
+    status = net_send_msg(data->fd, NET_MSG_SAMPLES, 0, &seq, buffer, bytes);
+    MUTEX_LOCK(&stream->lock);
+
+    if (status == 0) {
+        MUTEX_LOCK(&n->stats_lock);
+        n->stats.tx_frames++;
+        n->stats.tx_bytes += bytes;
+        MUTEX_UNLOCK(&n->stats_lock);
+
+        complete_transfer(stream);
+    }
+
+    return status;
+}
+
+/* Check whether the server has ended a TX stream of its own accord. It only
+ * does so upon an error, which is returned in `status`. */
+static bool tx_stopped(struct bladerf_stream *stream, int *status)
+{
+    struct net_stream_data *data = stream->backend_data;
+    struct net_header hdr;
+    struct pollfd pfd;
+
+    pfd.fd = data->fd;
+    pfd.events = POLLIN;
+
+    if (poll(&pfd, 1, 0) <= 0) {
+        return false;
+    }
+
+    *status = net_recv_header(data->fd, &hdr);
+    if (*status == 0) {
+        *status = (hdr.type == NET_MSG_STREAM_STOPPED && hdr.status)
+                  ? hdr.status : BLADERF_ERR_UNEXPECTED;
+    }
+
+    return true;
+}
+
+/* Wait for the data connection to become readable, or for a wakeup. The
+ * stream lock must be held, and is released while waiting. */
+static bool wait_readable(struct bladerf_stream *stream)
+{
+    struct net_stream_data *data = stream->backend_data;
+    struct pollfd pfd[2];
+    int ret;
+
+    pfd[0].fd = data->fd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = data->wake[0];
+    pfd[1].events = POLLIN;
+
+    MUTEX_UNLOCK(&stream->lock);
+    ret = poll(pfd, 2, -1);
+    MUTEX_LOCK(&stream->lock);
+
+    return ret > 0 && (pfd[0].revents & (POLLIN | POLLHUP | POLLERR));
+}
+
+/* Ask the server to stop the stream, and wait for it to do so, discarding
+ * any samples received in the meantime */
+static int stop_stream(struct bladerf_stream *stream)
+{
+    struct net_stream_data *data = stream->backend_data;
+    const size_t bytes = async_stream_buf_bytes(stream);
+    struct net_header hdr;
+    int status;
+
+    status = net_send_msg(data->fd, NET_MSG_STREAM_STOP, 0, NULL, NULL, 0);
+
+    while (status == 0) {
+        status = net_recv_header(data->fd, &hdr);
+
+        if (status != 0) {
+            break;
+        } else if (hdr.type == NET_MSG_STREAM_STOPPED) {
+            return hdr.status;
+        } else if (hdr.type == NET_MSG_SAMPLES &&
+                   hdr.len == NET_SEQ_SIZE + bytes) {
+            uint8_t seq_buf[NET_SEQ_SIZE];
+
+            status = net_recv_all(data->fd, seq_buf, sizeof(seq_buf));
+            if (status == 0) {
+                status = net_recv_all(data->fd, data->scratch, bytes);
+            }
+        } else {
+            status = BLADERF_ERR_UNEXPECTED;
+        }
+    }
+
+    return status;
+}
+
+static int start_stream(struct bladerf_stream *stream, bladerf_module module)
+{
+    struct net_stream_data *data = stream->backend_data;
+    struct net_msg msg;
+    struct net_header hdr;
+    int status;
+
+    net_msg_init(&msg);
+    net_put_u32(&msg, (uint32_t) module);
+    net_put_u32(&msg, (uint32_t) stream->format);
+    net_put_u32(&msg, (uint32_t) stream->samples_per_buffer);
+    net_put_u32(&msg, (uint32_t) data->num_transfers);
+
+    status = net_send_msg(data->fd, NET_MSG_STREAM_START, 0, &msg, NULL, 0);
+    if (status == 0) {
+        status = net_recv_msg(data->fd, &hdr, &msg);
+    }
+
+    if (status == 0) {
+        status = (hdr.type == NET_MSG_STREAM_START) ? hdr.status
+                                                    : BLADERF_ERR_UNEXPECTED;
+    }
+
+    net_msg_free(&msg);
+    return status;
+}
+
+static int net_stream(struct bladerf_stream *stream, bladerf_module module)
+{
+    size_t i;
+    int status = 0;
+    void *buffer;
+    struct bladerf_metadata metadata;
+    struct bladerf *dev = stream->dev;
+    struct net_stream_data *data = stream->backend_data;
+    bool started = false;
+    uint8_t wake;
+
+    /* TX callbacks are given zeroed metadata */
+    memset(&metadata, 0, sizeof(metadata));
+
+    MUTEX_LOCK(&stream->lock);
+
+    data->head = 0;
+    data->count = 0;
+    data->seq = 0;
+
+    /* Discard any wakeup left over from a previous run */
+    while (read(data->wake[0], &wake, 1) == 1) {
+        continue;
+    }
+
+    /* Set up initial set of buffers */
+    for (i = 0; i < data->num_transfers; i++) {
+        if (module == BLADERF_MODULE_TX) {
+            buffer = stream->cb(dev,
+                                stream,
+                                &metadata,
+                                NULL,
+                                stream->samples_per_buffer,
+                                stream->user_data);
+
+            if (buffer == BLADERF_STREAM_SHUTDOWN) {
+                stream->state = STREAM_SHUTTING_DOWN;
+                break;
+            }
+        } else {
+            buffer = stream->buffers[i];
+        }
+
+        if (buffer != BLADERF_STREAM_NO_DATA) {
+            status = queue_buffer(stream, buffer);
+            if (status < 0) {
+                stream->error_code = status;
+                stream->state = STREAM_SHUTTING_DOWN;
+                break;
+            }
+        }
+    }
+
+    if (stream->state == STREAM_RUNNING) {
+        MUTEX_UNLOCK(&stream->lock);
+        status = start_stream(stream, module);
+        MUTEX_LOCK(&stream->lock);
+
+        if (status != 0) {
+            log_debug("%s: Failed to start stream: %s\n", __FUNCTION__,
+                      bladerf_strerror(status));
+            stream->error_code = status;
+            stream->state = STREAM_SHUTTING_DOWN;
+        } else {
+            started = true;
+        }
+    }
+
+    while (stream->state == STREAM_RUNNING) {
+        if (module == BLADERF_MODULE_RX) {
+            struct net_header hdr;
+
+            if (!wait_readable(stream) || stream->state != STREAM_RUNNING) {
+                continue;
+            }
+
+            MUTEX_UNLOCK(&stream->lock);
+            status = net_recv_header(data->fd, &hdr);
+            MUTEX_LOCK(&stream->lock);
+
+            if (status == 0 && hdr.type == NET_MSG_SAMPLES) {
+                status = rx_frame(stream, &hdr);
+            } else if (status == 0) {
+                /* The server only stops of its own accord upon an error */
+                status = (hdr.type == NET_MSG_STREAM_STOPPED && hdr.status)
+                         ? hdr.status : BLADERF_ERR_UNEXPECTED;
+                started = false;
+            }
+        } else if (data->count == 0) {
+            pthread_cond_wait(&data->changed, &stream->lock);
+        } else if (tx_stopped(stream, &status)) {
+            started = false;
+        } else {
+            status = tx_frame(stream);
+        }
+
+        if (status != 0) {
+            stream->error_code = status;
+            stream->state = STREAM_SHUTTING_DOWN;
+        }
+    }
+
+    /* Any buffers still in flight are simply discarded */
+    data->count = 0;
+
+    if (started) {
+        MUTEX_UNLOCK(&stream->lock);
+        status = stop_stream(stream);
+        MUTEX_LOCK(&stream->lock);
+
+        if (status != 0) {
+            log_debug("%s: Server stream ended with: %s\n", __FUNCTION__,
+                      bladerf_strerror(status));
+        }
+    }
+
+    stream->state = STREAM_DONE;
+    pthread_cond_broadcast(&stream->can_submit_buffer);
+
+    MUTEX_UNLOCK(&stream->lock);
+
+    return 0;
+}
+
+/* The top-level code will have aquired the stream->lock for us */
+static int net_submit_stream_buffer(struct bladerf_stream *stream,
+                                    void *buffer,
+                                    unsigned int timeout_ms)
+{
+    int status = 0;
+    struct net_stream_data *data = stream->backend_data;
+    struct timespec timeout_abs;
+
+    if (buffer == BLADERF_STREAM_SHUTDOWN) {
+        const uint8_t wake = 0;
+
+        if (stream->state == STREAM_RUNNING) {
+            stream->state = STREAM_SHUTTING_DOWN;
+        }
+
+        pthread_cond_signal(&data->changed);
+        if (write(data->wake[1], &wake, 1) != 1) {
+            log_debug("%s: Failed to wake stream\n", __FUNCTION__);
+        }
+        return 0;
+    }
+
+    if (timeout_ms != 0) {
+        status = populate_abs_timeout(&timeout_abs, timeout_ms);
+        if (status != 0) {
+            return BLADERF_ERR_UNEXPECTED;
+        }
+    }
+
+    while ((data->count == data->num_transfers ||
+            !below_transfer_limit(stream)) &&
+           stream->state == STREAM_RUNNING && status == 0) {
+
+        if (timeout_ms != 0) {
+            status = pthread_cond_timedwait(&stream->can_submit_buffer,
+                                            &stream->lock, &timeout_abs);
+        } else {
+            status = pthread_cond_wait(&stream->can_submit_buffer,
+                                       &stream->lock);
+        }
+    }
+
+    if (status == ETIMEDOUT) {
+        log_debug("%s: Timed out waiting for a transfer to become availble.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_TIMEOUT;
+    } else if (status != 0) {
+        return BLADERF_ERR_UNEXPECTED;
+    } else if (stream->state != STREAM_RUNNING) {
+        return BLADERF_ERR_UNEXPECTED;
+    } else {
+        return queue_buffer(stream, buffer);
+    }
+}
+
+static void net_deinit_stream(struct bladerf_stream *stream)
+{
+    if (stream->backend_data != NULL) {
+        net_free_stream_data(stream->backend_data);
+        stream->backend_data = NULL;
+    }
+}
+
+static int net_load_fw_from_bootloader(bladerf_backend backend,
+                                       uint8_t bus, uint8_t addr,
+                                       struct fx3_firmware *fw)
+{
+    return BLADERF_ERR_UNSUPPORTED;
+}
+
+static int net_get_net_stats(struct bladerf *dev,
+                             struct bladerf_net_stats *stats)
+{
+    struct bladerf_net *n = net_backend(dev);
+
+    MUTEX_LOCK(&n->stats_lock);
+
+    *stats = n->stats;
+    if (n->stats.requests != 0) {
+        stats->rtt_mean_us = n->rtt_total_us / n->stats.requests;
+    }
+
+    MUTEX_UNLOCK(&n->stats_lock);
+
+    return 0;
+}
+
+const struct backend_fns backend_fns_net = {
+    FIELD_INIT(.matches, net_matches),
+
+    FIELD_INIT(.probe, net_probe),
+
+    FIELD_INIT(.open, net_open),
+    FIELD_INIT(.close, net_close),
+
+    FIELD_INIT(.load_fpga, net_load_fpga),
+    FIELD_INIT(.is_fpga_configured, net_is_fpga_configured),
+
+    FIELD_INIT(.erase_flash_blocks, net_erase_flash_blocks),
+    FIELD_INIT(.read_flash_pages, net_read_flash_pages),
+    FIELD_INIT(.write_flash_pages, net_write_flash_pages),
+
+    FIELD_INIT(.device_reset, net_device_reset),
+    FIELD_INIT(.jump_to_bootloader, net_jump_to_bootloader),
+
+    FIELD_INIT(.get_cal, net_get_cal),
+    FIELD_INIT(.get_otp, net_get_otp),
+    FIELD_INIT(.get_device_speed, net_get_device_speed),
+
+    FIELD_INIT(.config_gpio_write, net_config_gpio_write),
+    FIELD_INIT(.config_gpio_read, net_config_gpio_read),
+
+    FIELD_INIT(.expansion_gpio_write, net_expansion_gpio_write),
+    FIELD_INIT(.expansion_gpio_read, net_expansion_gpio_read),
+    FIELD_INIT(.expansion_gpio_dir_write, net_expansion_gpio_dir_write),
+    FIELD_INIT(.expansion_gpio_dir_read, net_expansion_gpio_dir_read),
+
+    FIELD_INIT(.set_correction, net_set_correction),
+    FIELD_INIT(.get_correction, net_get_correction),
+
+    FIELD_INIT(.get_timestamp, net_get_timestamp),
+
+    FIELD_INIT(.si5338_write, net_si5338_write),
+    FIELD_INIT(.si5338_read, net_si5338_read),
+
+    FIELD_INIT(.lms_write, net_lms_write),
+    FIELD_INIT(.lms_read, net_lms_read),
+
+    FIELD_INIT(.dac_write, net_dac_write),
+
+    FIELD_INIT(.xb_spi, net_xb_spi),
+
+    FIELD_INIT(.set_firmware_loopback, net_set_firmware_loopback),
+    FIELD_INIT(.get_firmware_loopback, net_get_firmware_loopback),
+
+    FIELD_INIT(.enable_module, net_enable_module),
+
+    FIELD_INIT(.init_stream, net_init_stream),
+    FIELD_INIT(.stream, net_stream),
+    FIELD_INIT(.submit_stream_buffer, net_submit_stream_buffer),
+    FIELD_INIT(.deinit_stream, net_deinit_stream),
+
+    FIELD_INIT(.load_fw_from_bootloader, net_load_fw_from_bootloader),
+
+    FIELD_INIT(.lms_access_batch, net_lms_access_batch),
+    FIELD_INIT(.si5338_access_batch, net_si5338_access_batch),
+
+    FIELD_INIT(.get_net_stats, net_get_net_stats),
+};
@@ -0,0 +1,45 @@
+/**
+ * @file net.h
+ *
+ * @brief Network backend server
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BACKEND_NET_H_
+#define BACKEND_NET_H_
+
+#include <stdint.h>
+
+struct bladerf;
+struct bladerf_net_serve_config;
+
+/**
+ * Serve the device to network backend clients, on a TCP port or a Unix
+ * domain socket, until the specified number of sessions have ended. See
+ * bladerf_net_serve_with_config().
+ *
+ * The caller must not hold any of dev->ctrl_lock[].
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int net_serve(struct bladerf *dev,
+              const struct bladerf_net_serve_config *config);
+
+#endif
@@ -0,0 +1,306 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <libbladeRF.h>
+
+#include "backend/net/net_proto.h"
+#include "log.h"
+
+void net_msg_init(struct net_msg *msg)
+{
+    memset(msg, 0, sizeof(*msg));
+}
+
+void net_msg_reset(struct net_msg *msg)
+{
+    msg->len = 0;
+    msg->pos = 0;
+    msg->error = false;
+}
+
+void net_msg_free(struct net_msg *msg)
+{
+    free(msg->data);
+    net_msg_init(msg);
+}
+
+uint8_t * net_msg_append(struct net_msg *msg, size_t n)
+{
+    uint8_t *p;
+
+    if (msg->error) {
+        return NULL;
+    }
+
+    /* Storage is allocated even for empty payloads, such that the returned
+     * pointer is always valid */
+    if (msg->len + n > msg->size || msg->data == NULL) {
+        size_t size = msg->size ? msg->size : 64;
+
+        while (size < msg->len + n) {
+            size *= 2;
+        }
+
+        p = (uint8_t *) realloc(msg->data, size);
+        if (p == NULL) {
+            msg->error = true;
+            return NULL;
+        }
+
+        msg->data = p;
+        msg->size = size;
+    }
+
+    p = &msg->data[msg->len];
+    msg->len += n;
+    return p;
+}
+
+const uint8_t * net_msg_consume(struct net_msg *msg, size_t n)
+{
+    const uint8_t *p;
+
+    if (msg->error || n > msg->len - msg->pos) {
+        msg->error = true;
+        return NULL;
+    }
+
+    p = &msg->data[msg->pos];
+    msg->pos += n;
+    return p;
+}
+
+void net_put_bytes(struct net_msg *msg, const void *data, size_t n)
+{
+    uint8_t *p = net_msg_append(msg, n);
+    if (p != NULL) {
+        memcpy(p, data, n);
+    }
+}
+
+void net_get_bytes(struct net_msg *msg, void *data, size_t n)
+{
+    const uint8_t *p = net_msg_consume(msg, n);
+    if (p != NULL) {
+        memcpy(data, p, n);
+    } else {
+        memset(data, 0, n);
+    }
+}
+
+void net_put_str(struct net_msg *msg, const char *str)
+{
+    const size_t len = strlen(str);
+
+    net_put_u16(msg, (uint16_t) len);
+    net_put_bytes(msg, str, len);
+}
+
+void net_get_str(struct net_msg *msg, char *str, size_t max)
+{
+    const size_t len = net_get_u16(msg);
+    const uint8_t *p = net_msg_consume(msg, len);
+
+    if (p != NULL && len <= max) {
+        memcpy(str, p, len);
+        str[len] = '\0';
+    } else {
+        msg->error = true;
+        str[0] = '\0';
+    }
+}
+
+int net_send_all(int fd, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *) data;
+
+    while (len > 0) {
+        const ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            log_debug("%s: send failed: %s\n", __FUNCTION__, strerror(errno));
+            return BLADERF_ERR_IO;
+        }
+
+        p += n;
+        len -= (size_t) n;
+    }
+
+    return 0;
+}
+
+int net_recv_all(int fd, void *data, size_t len)
+{
+    uint8_t *p = (uint8_t *) data;
+
+    while (len > 0) {
+        const ssize_t n = recv(fd, p, len, 0);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n == 0) {
+            log_debug("%s: Connection closed by peer\n", __FUNCTION__);
+            return BLADERF_ERR_IO;
+        } else if (n < 0) {
+            log_debug("%s: recv failed: %s\n", __FUNCTION__, strerror(errno));
+            return BLADERF_ERR_IO;
+        }
+
+        p += n;
+        len -= (size_t) n;
+    }
+
+    return 0;
+}
+
+int net_send_msg(int fd, uint16_t type, int32_t status,
+                 const struct net_msg *msg, const void *extra, size_t len)
+{
+    uint8_t hdr[NET_HEADER_SIZE];
+    struct iovec iov[3];
+    struct msghdr mh;
+    const size_t msg_len = (msg != NULL) ? msg->len : 0;
+    size_t remaining = NET_HEADER_SIZE + msg_len + len;
+    size_t i;
+
+    if (msg != NULL && msg->error) {
+        return BLADERF_ERR_MEM;
+    }
+
+    net_put_le(&hdr[0], NET_PROTO_MAGIC, 4);
+    net_put_le(&hdr[4], type, 2);
+    net_put_le(&hdr[6], 0, 2);
+    net_put_le(&hdr[8], msg_len + len, 4);
+    net_put_le(&hdr[12], (uint32_t) status, 4);
+
+    iov[0].iov_base = hdr;
+    iov[0].iov_len = NET_HEADER_SIZE;
+    iov[1].iov_base = (msg != NULL) ? msg->data : NULL;
+    iov[1].iov_len = msg_len;
+    iov[2].iov_base = (void *) extra;
+    iov[2].iov_len = len;
+
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    mh.msg_iovlen = 3;
+
+    /* Payloads are sent straight from the caller's buffers, picking up
+     * where a partial send left off */
+    while (remaining > 0) {
+        ssize_t n = sendmsg(fd, &mh, MSG_NOSIGNAL);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n <= 0) {
+            log_debug("%s: sendmsg failed: %s\n", __FUNCTION__,
+                      strerror(errno));
+            return BLADERF_ERR_IO;
+        }
+
+        remaining -= (size_t) n;
+
+        for (i = 0; i < mh.msg_iovlen && n > 0; i++) {
+            if ((size_t) n >= mh.msg_iov[i].iov_len) {
+                n -= (ssize_t) mh.msg_iov[i].iov_len;
+                mh.msg_iov[i].iov_len = 0;
+            } else {
+                mh.msg_iov[i].iov_base = (uint8_t *) mh.msg_iov[i].iov_base + n;
+                mh.msg_iov[i].iov_len -= (size_t) n;
+                n = 0;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int net_recv_header(int fd, struct net_header *hdr)
+{
+    uint8_t buf[NET_HEADER_SIZE];
+    int status;
+
+    status = net_recv_all(fd, buf, sizeof(buf));
+    if (status != 0) {
+        return status;
+    }
+
+    hdr->magic = (uint32_t) net_get_le(&buf[0], 4);
+    hdr->type = (uint16_t) net_get_le(&buf[4], 2);
+    hdr->flags = (uint16_t) net_get_le(&buf[6], 2);
+    hdr->len = (uint32_t) net_get_le(&buf[8], 4);
+    hdr->status = (int32_t) (uint32_t) net_get_le(&buf[12], 4);
+
+    if (hdr->magic != NET_PROTO_MAGIC) {
+        log_debug("%s: Invalid magic: 0x%08x\n", __FUNCTION__, hdr->magic);
+        return BLADERF_ERR_IO;
+    } else if (hdr->len > NET_MAX_PAYLOAD) {
+        log_debug("%s: Payload too large: %u\n", __FUNCTION__, hdr->len);
+        return BLADERF_ERR_IO;
+    }
+
+    return 0;
+}
+
+int net_recv_msg(int fd, struct net_header *hdr, struct net_msg *msg)
+{
+    int status;
+    uint8_t *p;
+
+    status = net_recv_header(fd, hdr);
+    if (status != 0) {
+        return status;
+    }
+
+    net_msg_reset(msg);
+
+    p = net_msg_append(msg, hdr->len);
+    if (p == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    return net_recv_all(fd, p, hdr->len);
+}
+
+void net_config_socket(int fd, bool data)
+{
+    int one = 1;
+
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) != 0) {
+        log_debug("Failed to set TCP_NODELAY: %s\n", strerror(errno));
+    }
+
+    if (data) {
+        int size = NET_DATA_SOCKBUF;
+
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+}
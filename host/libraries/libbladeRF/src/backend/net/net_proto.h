@@ -0,0 +1,265 @@
+/**
+ * @file net_proto.h
+ *
+ * @brief Wire protocol shared by the network backend and its server
+ *
+ * A client holds one TCP connection for control requests, and opens one
+ * more per stream. Every message begins with a fixed-size header, followed
+ * by `len` bytes of payload. All values are little-endian.
+ *
+ * Control requests are answered with a message of the same type, whose
+ * header carries the BLADERF_ERR_* status of the operation. Data
+ * connections carry NET_MSG_SAMPLES frames, each holding a sequence number
+ * and exactly one stream buffer, such that gaps in the sequence denote
+ * buffers the server dropped.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BACKEND_NET_PROTO_H_
+#define BACKEND_NET_PROTO_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define NET_PROTO_MAGIC     0x4e524642  /* "BFRN" */
+#define NET_PROTO_VERSION   1
+
+/* TCP port used when a server address does not specify one */
+#ifndef NET_DEFAULT_PORT
+#   define NET_DEFAULT_PORT 5910
+#endif
+
+/* Largest payload accepted, which must accommodate an FPGA image */
+#ifndef NET_MAX_PAYLOAD
+#   define NET_MAX_PAYLOAD  (16 * 1024 * 1024)
+#endif
+
+/* Socket buffer size requested for data connections */
+#ifndef NET_DATA_SOCKBUF
+#   define NET_DATA_SOCKBUF (4 * 1024 * 1024)
+#endif
+
+#define NET_HEADER_SIZE     16
+
+/* Length of the sequence number preceding the samples of a frame */
+#define NET_SEQ_SIZE        8
+
+typedef enum {
+    NET_MSG_HELLO = 1,
+    NET_MSG_LOAD_FPGA,
+    NET_MSG_IS_FPGA_CONFIGURED,
+    NET_MSG_ERASE_FLASH,
+    NET_MSG_READ_FLASH,
+    NET_MSG_WRITE_FLASH,
+    NET_MSG_DEVICE_RESET,
+    NET_MSG_JUMP_TO_BOOTLOADER,
+    NET_MSG_GET_CAL,
+    NET_MSG_GET_OTP,
+    NET_MSG_GPIO_READ,
+    NET_MSG_GPIO_WRITE,
+    NET_MSG_SET_CORRECTION,
+    NET_MSG_GET_CORRECTION,
+    NET_MSG_GET_TIMESTAMP,
+    NET_MSG_LMS_BATCH,
+    NET_MSG_SI5338_BATCH,
+    NET_MSG_DAC_WRITE,
+    NET_MSG_XB_SPI,
+    NET_MSG_SET_LOOPBACK,
+    NET_MSG_GET_LOOPBACK,
+    NET_MSG_ENABLE_MODULE,
+
+    /* Data connection messages */
+    NET_MSG_STREAM_START = 64,  /* Answered once the stream is running */
+    NET_MSG_STREAM_STOP,        /* Not answered; see NET_MSG_STREAM_STOPPED */
+    NET_MSG_STREAM_STOPPED,     /* Final message of a stream */
+    NET_MSG_SAMPLES,
+} net_msg_type;
+
+/* Role of a connection, given in its NET_MSG_HELLO */
+typedef enum {
+    NET_ROLE_PROBE,     /* Identify the device, then disconnect */
+    NET_ROLE_CONTROL,   /* Control requests, for the duration of a session */
+    NET_ROLE_DATA,      /* A stream within the session */
+} net_role;
+
+/* Flags at the end of a server's NET_MSG_HELLO response */
+#define NET_HELLO_SHARED    0x01    /* Other sessions may use the device */
+
+/* GPIO registers accessed by NET_MSG_GPIO_READ and NET_MSG_GPIO_WRITE */
+typedef enum {
+    NET_GPIO_CONFIG,
+    NET_GPIO_XB,
+    NET_GPIO_XB_DIR,
+} net_gpio;
+
+struct net_header {
+    uint32_t magic;
+    uint16_t type;
+    uint16_t flags;     /* Reserved */
+    uint32_t len;       /* Payload length */
+    int32_t status;     /* Responses: 0 or a BLADERF_ERR_* value */
+};
+
+/**
+ * A message payload, which grows as values are appended, and is consumed
+ * as values are read. Overflows and underflows set `error`, and further
+ * accesses do nothing, such that a sequence of accesses need only be
+ * checked once.
+ */
+struct net_msg {
+    uint8_t *data;
+    size_t len;         /* Bytes appended or received */
+    size_t size;        /* Bytes allocated */
+    size_t pos;         /* Read position */
+    bool error;
+};
+
+static inline void net_put_le(uint8_t *p, uint64_t value, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        p[i] = (uint8_t) (value >> (8 * i));
+    }
+}
+
+static inline uint64_t net_get_le(const uint8_t *p, size_t n)
+{
+    size_t i;
+    uint64_t value = 0;
+
+    for (i = 0; i < n; i++) {
+        value |= (uint64_t) p[i] << (8 * i);
+    }
+
+    return value;
+}
+
+void net_msg_init(struct net_msg *msg);
+void net_msg_reset(struct net_msg *msg);
+void net_msg_free(struct net_msg *msg);
+
+/* Reserve space for `n` bytes, returning where they are to be written */
+uint8_t * net_msg_append(struct net_msg *msg, size_t n);
+
+/* Consume `n` bytes, returning where they may be read from */
+const uint8_t * net_msg_consume(struct net_msg *msg, size_t n);
+
+static inline void net_put_u8(struct net_msg *msg, uint8_t value)
+{
+    uint8_t *p = net_msg_append(msg, 1);
+    if (p != NULL) {
+        *p = value;
+    }
+}
+
+static inline void net_put_u16(struct net_msg *msg, uint16_t value)
+{
+    uint8_t *p = net_msg_append(msg, 2);
+    if (p != NULL) {
+        net_put_le(p, value, 2);
+    }
+}
+
+static inline void net_put_u32(struct net_msg *msg, uint32_t value)
+{
+    uint8_t *p = net_msg_append(msg, 4);
+    if (p != NULL) {
+        net_put_le(p, value, 4);
+    }
+}
+
+static inline void net_put_u64(struct net_msg *msg, uint64_t value)
+{
+    uint8_t *p = net_msg_append(msg, 8);
+    if (p != NULL) {
+        net_put_le(p, value, 8);
+    }
+}
+
+static inline uint8_t net_get_u8(struct net_msg *msg)
+{
+    const uint8_t *p = net_msg_consume(msg, 1);
+    return p != NULL ? *p : 0;
+}
+
+static inline uint16_t net_get_u16(struct net_msg *msg)
+{
+    const uint8_t *p = net_msg_consume(msg, 2);
+    return p != NULL ? (uint16_t) net_get_le(p, 2) : 0;
+}
+
+static inline uint32_t net_get_u32(struct net_msg *msg)
+{
+    const uint8_t *p = net_msg_consume(msg, 4);
+    return p != NULL ? (uint32_t) net_get_le(p, 4) : 0;
+}
+
+static inline uint64_t net_get_u64(struct net_msg *msg)
+{
+    const uint8_t *p = net_msg_consume(msg, 8);
+    return p != NULL ? net_get_le(p, 8) : 0;
+}
+
+/* Append and read raw bytes */
+void net_put_bytes(struct net_msg *msg, const void *data, size_t n);
+void net_get_bytes(struct net_msg *msg, void *data, size_t n);
+
+/* Append and read a string of up to `max` characters, which is always
+ * NUL-terminated when read */
+void net_put_str(struct net_msg *msg, const char *str);
+void net_get_str(struct net_msg *msg, char *str, size_t max);
+
+/**
+ * Send or receive exactly `len` bytes
+ *
+ * @return 0 on success, BLADERF_ERR_IO on failure, or if the peer closed
+ *         the connection
+ */
+int net_send_all(int fd, const void *data, size_t len);
+int net_recv_all(int fd, void *data, size_t len);
+
+/**
+ * Send a header, followed by the contents of `msg` (which may be NULL)
+ * and then `len` bytes from `extra` (which may also be NULL). This is
+ * performed with a single system call where possible.
+ */
+int net_send_msg(int fd, uint16_t type, int32_t status,
+                 const struct net_msg *msg, const void *extra, size_t len);
+
+/**
+ * Receive a header, validating its magic and length. The payload is not
+ * read.
+ */
+int net_recv_header(int fd, struct net_header *hdr);
+
+/**
+ * Receive a header and its payload into `msg`, replacing its contents
+ */
+int net_recv_msg(int fd, struct net_header *hdr, struct net_msg *msg);
+
+/**
+ * Configure a connected socket: disable Nagle's algorithm, and for data
+ * connections request large socket buffers
+ */
+void net_config_socket(int fd, bool data);
+
+#endif
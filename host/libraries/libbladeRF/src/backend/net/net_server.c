@@ -0,0 +1,1233 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Server side of the network backend, which performs the requests of a
+ * remote client on a local device. Unless given a local address to listen
+ * on, the server only accepts connections via the loopback interface.
+ *
+ * A client's control connection establishes a session, for which the
+ * device is reserved. Control requests are performed directly through the
+ * device's backend, with the control lock held, such that they are
+ * serialized with any use of the device by the server's own process.
+ * The library's register shadows are discarded at the start and end of
+ * each session, as the client maintains its own.
+ *
+ * Each of the session's data connections runs a stream on the device, with
+ * the client's format and buffer size. RX buffers are queued for sending as
+ * they are filled; when the network cannot keep up and no buffer is free,
+ * the oldest samples are kept and the newest buffer is dropped, which the
+ * client detects via the frames' sequence numbers. TX is lossless: frames
+ * are only read from the connection once a buffer is free to receive them.
+ *
+ * In shared mode, any number of control sessions may be active at once, all
+ * joining a single session ID. Their requests are serialized by the control
+ * lock as usual, and the device is left as it is when each ends.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netdb.h>
+
+#include "bladerf_priv.h"
+#include "backend/backend.h"
+#include "backend/net/net.h"
+#include "backend/net/net_proto.h"
+#include "lms.h"
+#include "si5338.h"
+#include "xb.h"
+#include "log.h"
+
+/* Number of RX buffers, beyond those in flight with the device, that may be
+ * queued for sending when the network falls behind, and of TX buffers that
+ * may be received ahead of the device */
+#ifndef NET_SERVER_QUEUE_LEN
+#   define NET_SERVER_QUEUE_LEN     16
+#endif
+
+/* Time allowed for a new connection to identify itself */
+#ifndef NET_SERVER_HELLO_TIMEOUT_MS
+#   define NET_SERVER_HELLO_TIMEOUT_MS  10000
+#endif
+
+/* Interval at which the accept loop checks whether it is done */
+#define NET_SERVER_POLL_MS          500
+
+/* Largest number of register accesses in a single batch */
+#define NET_SERVER_BATCH_MAX        4096
+
+struct net_server {
+    struct bladerf *dev;
+    bool shared;
+
+    /* Protects the following */
+    MUTEX lock;
+    pthread_cond_t changed;
+    unsigned int sessions_active;
+    uint32_t session;
+    unsigned int sessions_done;
+    unsigned int connections;   /* Connection threads running */
+};
+
+struct net_conn {
+    struct net_server *srv;
+    int fd;
+};
+
+/* A stream run on behalf of a data connection */
+struct net_server_stream {
+    struct bladerf *dev;
+    int fd;
+    bladerf_module module;
+    size_t bytes;               /* Per buffer */
+
+    struct bladerf_stream *stream;
+    void **buffers;
+    size_t num_buffers;
+    uint8_t *scratch;           /* Receives TX frames that are discarded */
+
+    pthread_t stream_thread;
+    pthread_t sender_thread;    /* RX only */
+    bool sender_started;
+
+    /* Serializes sending on the connection */
+    MUTEX send_lock;
+
+    /* Protects the following */
+    MUTEX lock;
+    pthread_cond_t changed;
+    bool stop;
+    void **free;                /* Buffers available to the server */
+    size_t num_free;
+    void **ready;               /* Ring of RX buffers to send, or TX buffers
+                                 * to transmit */
+    uint64_t *ready_seq;
+    size_t ready_head;
+    size_t ready_count;
+    uint64_t seq;
+};
+
+static int put_hello(struct bladerf *dev, struct net_msg *msg,
+                     uint32_t session, bool shared)
+{
+    net_put_u16(msg, NET_PROTO_VERSION);
+    net_put_u32(msg, session);
+    net_put_u8(msg, (uint8_t) dev->usb_speed);
+    net_put_str(msg, dev->ident.serial);
+    net_put_str(msg, dev->fw_version.describe);
+    net_put_u16(msg, dev->fpga_version.major);
+    net_put_u16(msg, dev->fpga_version.minor);
+    net_put_u16(msg, dev->fpga_version.patch);
+    net_put_str(msg, dev->fpga_version.describe);
+    net_put_u8(msg, shared ? NET_HELLO_SHARED : 0);
+
+    return 0;
+}
+
+static inline bool valid_module(uint32_t module)
+{
+    return module == BLADERF_MODULE_RX || module == BLADERF_MODULE_TX;
+}
+
+/* Perform a batch of register accesses, with the backend's batch function
+ * if it has one */
+static int access_batch(struct bladerf *dev, bool lms,
+                        struct backend_reg_access *regs, size_t count)
+{
+    int (*batch)(struct bladerf *, struct backend_reg_access *, size_t);
+    int (*write)(struct bladerf *, uint8_t, uint8_t);
+    int (*read)(struct bladerf *, uint8_t, uint8_t *);
+    size_t i;
+    int status = 0;
+
+    if (lms) {
+        batch = dev->fn->lms_access_batch;
+        write = dev->fn->lms_write;
+        read = dev->fn->lms_read;
+    } else {
+        batch = dev->fn->si5338_access_batch;
+        write = dev->fn->si5338_write;
+        read = dev->fn->si5338_read;
+    }
+
+    if (batch != NULL) {
+        return batch(dev, regs, count);
+    }
+
+    for (i = 0; i < count && status == 0; i++) {
+        if (regs[i].write) {
+            status = write(dev, regs[i].addr, regs[i].data);
+        } else {
+            status = read(dev, regs[i].addr, &regs[i].data);
+        }
+    }
+
+    return status;
+}
+
+static int handle_batch(struct bladerf *dev, bool lms,
+                        struct net_msg *req, struct net_msg *resp)
+{
+    struct backend_reg_access *regs;
+    const uint32_t count = net_get_u32(req);
+    uint32_t i;
+    int status;
+
+    if (count == 0 || count > NET_SERVER_BATCH_MAX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    regs = (struct backend_reg_access *) calloc(count, sizeof(regs[0]));
+    if (regs == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    for (i = 0; i < count; i++) {
+        regs[i].addr = net_get_u8(req);
+        regs[i].data = net_get_u8(req);
+        regs[i].write = net_get_u8(req) != 0;
+    }
+
+    if (req->error) {
+        status = BLADERF_ERR_INVAL;
+    } else {
+        status = access_batch(dev, lms, regs, count);
+    }
+
+    if (status == 0) {
+        for (i = 0; i < count; i++) {
+            net_put_u8(resp, regs[i].data);
+        }
+    }
+
+    free(regs);
+    return status;
+}
+
+static int gpio_access(struct bladerf *dev, uint32_t gpio, bool write,
+                       uint32_t *val)
+{
+    switch (gpio) {
+        case NET_GPIO_CONFIG:
+            return write ? dev->fn->config_gpio_write(dev, *val)
+                         : dev->fn->config_gpio_read(dev, val);
+
+        case NET_GPIO_XB:
+            return write ? dev->fn->expansion_gpio_write(dev, *val)
+                         : dev->fn->expansion_gpio_read(dev, val);
+
+        case NET_GPIO_XB_DIR:
+            return write ? dev->fn->expansion_gpio_dir_write(dev, *val)
+                         : dev->fn->expansion_gpio_dir_read(dev, val);
+
+        default:
+            return BLADERF_ERR_INVAL;
+    }
+}
+
+/* Perform a control request. The control lock must be held. */
+static int dispatch(struct bladerf *dev, uint16_t type,
+                    struct net_msg *req, struct net_msg *resp)
+{
+    int status;
+    uint32_t a, b, val;
+    uint64_t result = 0;
+    bool has_result = false;
+    uint8_t *p;
+    const uint8_t *data;
+
+    switch (type) {
+        case NET_MSG_LOAD_FPGA:
+            status = dev->fn->load_fpga(dev, req->data, req->len);
+            if (status == 0) {
+                net_put_u16(resp, dev->fpga_version.major);
+                net_put_u16(resp, dev->fpga_version.minor);
+                net_put_u16(resp, dev->fpga_version.patch);
+                net_put_str(resp, dev->fpga_version.describe);
+            }
+            return status;
+
+        case NET_MSG_IS_FPGA_CONFIGURED:
+            status = dev->fn->is_fpga_configured(dev);
+            if (status >= 0) {
+                result = (uint64_t) status;
+                has_result = true;
+                status = 0;
+            }
+            break;
+
+        case NET_MSG_ERASE_FLASH:
+            a = net_get_u32(req);
+            b = net_get_u32(req);
+            if (req->error || b > UINT16_MAX) {
+                return BLADERF_ERR_INVAL;
+            }
+            status = dev->fn->erase_flash_blocks(dev, a, (uint16_t) b);
+            break;
+
+        case NET_MSG_READ_FLASH:
+            a = net_get_u32(req);
+            b = net_get_u32(req);
+            if (req->error || b > NET_MAX_PAYLOAD / BLADERF_FLASH_PAGE_SIZE) {
+                return BLADERF_ERR_INVAL;
+            }
+
+            p = net_msg_append(resp, (size_t) b * BLADERF_FLASH_PAGE_SIZE);
+            if (p == NULL) {
+                return BLADERF_ERR_MEM;
+            }
+
+            status = dev->fn->read_flash_pages(dev, p, a, b);
+            break;
+
+        case NET_MSG_WRITE_FLASH:
+            a = net_get_u32(req);
+            b = net_get_u32(req);
+            data = net_msg_consume(req, (size_t) b * BLADERF_FLASH_PAGE_SIZE);
+            if (data == NULL) {
+                return BLADERF_ERR_INVAL;
+            }
+            status = dev->fn->write_flash_pages(dev, data, a, b);
+            break;
+
+        case NET_MSG_DEVICE_RESET:
+            status = dev->fn->device_reset(dev);
+            break;
+
+        case NET_MSG_JUMP_TO_BOOTLOADER:
+            status = dev->fn->jump_to_bootloader(dev);
+            break;
+
+        case NET_MSG_GET_CAL:
+        case NET_MSG_GET_OTP:
+            p = net_msg_append(resp, type == NET_MSG_GET_CAL ?
+                                     CAL_BUFFER_SIZE : BLADERF_FLASH_PAGE_SIZE);
+            if (p == NULL) {
+                return BLADERF_ERR_MEM;
+            }
+
+            if (type == NET_MSG_GET_CAL) {
+                status = dev->fn->get_cal(dev, (char *) p);
+            } else {
+                status = dev->fn->get_otp(dev, (char *) p);
+            }
+            break;
+
+        case NET_MSG_GPIO_READ:
+            a = net_get_u32(req);
+            status = gpio_access(dev, a, false, &val);
+            result = val;
+            has_result = true;
+            break;
+
+        case NET_MSG_GPIO_WRITE:
+            a = net_get_u32(req);
+            val = net_get_u32(req);
+            if (req->error) {
+                return BLADERF_ERR_INVAL;
+            }
+            status = gpio_access(dev, a, true, &val);
+            break;
+
+        case NET_MSG_SET_CORRECTION:
+            a = net_get_u32(req);
+            b = net_get_u32(req);
+            val = net_get_u16(req);
+            if (req->error || !valid_module(a)) {
+                return BLADERF_ERR_INVAL;
+            }
+            status = dev->fn->set_correction(dev, (bladerf_module) a,
+                                             (bladerf_correction) b,
+                                             (int16_t) val);
+            break;
+
+        case NET_MSG_GET_CORRECTION: {
+            int16_t value = 0;
+
+            a = net_get_u32(req);
+            b = net_get_u32(req);
+            if (req->error || !valid_module(a)) {
+                return BLADERF_ERR_INVAL;
+            }
+            status = dev->fn->get_correction(dev, (bladerf_module) a,
+                                             (bladerf_correction) b, &value);
+            result = (uint16_t) value;
+            has_result = true;
+            break;
+        }
+
+        case NET_MSG_GET_TIMESTAMP:
+            a = net_get_u32(req);
+            if (req->error || !valid_module(a)) {
+                return BLADERF_ERR_INVAL;
+            }
+            status = dev->fn->get_timestamp(dev, (bladerf_module) a, &result);
+            has_result = true;
+            break;
+
+        case NET_MSG_LMS_BATCH:
+        case NET_MSG_SI5338_BATCH:
+            return handle_batch(dev, type == NET_MSG_LMS_BATCH, req, resp);
+
+        case NET_MSG_DAC_WRITE:
+            a = net_get_u32(req);
+            if (req->error) {
+                return BLADERF_ERR_INVAL;
+            }
+            status = dev->fn->dac_write(dev, (uint16_t) a);
+            break;
+
+        case NET_MSG_XB_SPI:
+            a = net_get_u32(req);
+            if (req->error) {
+                return BLADERF_ERR_INVAL;
+            }
+            status = dev->fn->xb_spi(dev, a);
+            break;
+
+        case NET_MSG_SET_LOOPBACK:
+            a = net_get_u32(req);
+            if (req->error) {
+                return BLADERF_ERR_INVAL;
+            }
+            status = dev->fn->set_firmware_loopback(dev, a != 0);
+            break;
+
+        case NET_MSG_GET_LOOPBACK: {
+            bool enabled = false;
+
+            status = dev->fn->get_firmware_loopback(dev, &enabled);
+            result = enabled ? 1 : 0;
+            has_result = true;
+            break;
+        }
+
+        case NET_MSG_ENABLE_MODULE:
+            a = net_get_u32(req);
+            b = net_get_u32(req);
+            if (req->error || !valid_module(a)) {
+                return BLADERF_ERR_INVAL;
+            }
+            status = dev->fn->enable_module(dev, (bladerf_module) a, b != 0);
+            break;
+
+        default:
+            log_debug("%s: Unsupported request: %u\n", __FUNCTION__, type);
+            return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    if (status == 0 && req->error) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (status == 0 && has_result) {
+        net_put_u64(resp, result);
+    }
+
+    return status;
+}
+
+/* Discard the state of the device that the library has cached, and which
+ * a client may have changed underneath it. Any modules left enabled by a
+ * client are disabled. */
+static void reset_device_state(struct bladerf *dev, bool disable)
+{
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
+
+    if (disable) {
+        dev->fn->enable_module(dev, BLADERF_MODULE_RX, false);
+        dev->fn->enable_module(dev, BLADERF_MODULE_TX, false);
+    }
+
+    lms_shadow_invalidate(dev);
+    si5338_shadow_invalidate(dev);
+    xb_shadow_invalidate(dev);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
+}
+
+static void serve_control(struct net_server *srv, int fd)
+{
+    struct bladerf *dev = srv->dev;
+    struct net_msg req, resp;
+    struct net_header hdr;
+    int status;
+
+    net_msg_init(&req);
+    net_msg_init(&resp);
+
+    while (net_recv_msg(fd, &hdr, &req) == 0) {
+        net_msg_reset(&resp);
+
+        CTRL_LOCK(dev, CTRL_LOCK_ALL);
+        status = dispatch(dev, hdr.type, &req, &resp);
+        CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
+
+        if (resp.error) {
+            net_msg_reset(&resp);
+            status = BLADERF_ERR_MEM;
+        }
+
+        if (net_send_msg(fd, hdr.type, status, &resp, NULL, 0) != 0) {
+            break;
+        }
+    }
+
+    net_msg_free(&req);
+    net_msg_free(&resp);
+}
+
+/* Ask the stream to shut down */
+static void request_stop(struct net_server_stream *s)
+{
+    MUTEX_LOCK(&s->lock);
+    s->stop = true;
+    pthread_cond_broadcast(&s->changed);
+    MUTEX_UNLOCK(&s->lock);
+
+    bladerf_submit_stream_buffer(s->stream, BLADERF_STREAM_SHUTDOWN, 0);
+}
+
+static void *stream_callback(struct bladerf *dev,
+                             struct bladerf_stream *stream,
+                             struct bladerf_metadata *meta,
+                             void *samples, size_t num_samples,
+                             void *user_data)
+{
+    struct net_server_stream *s = (struct net_server_stream *) user_data;
+    void *next = BLADERF_STREAM_SHUTDOWN;
+
+    MUTEX_LOCK(&s->lock);
+
+    if (s->module == BLADERF_MODULE_RX) {
+        if (s->stop) {
+            next = BLADERF_STREAM_SHUTDOWN;
+        } else if (s->num_free > 0) {
+            const size_t i = (s->ready_head + s->ready_count) % s->num_buffers;
+
+            s->ready[i] = samples;
+            s->ready_seq[i] = s->seq++;
+            s->ready_count++;
+            next = s->free[--s->num_free];
+            pthread_cond_broadcast(&s->changed);
+        } else {
+            /* Drop these samples, leaving a gap in the sequence */
+            s->seq++;
+            next = samples;
+        }
+    } else {
+        /* Return the transmitted buffer, and wait for the next one */
+        if (samples != NULL) {
+            s->free[s->num_free++] = samples;
+            pthread_cond_broadcast(&s->changed);
+        }
+
+        while (!s->stop && s->ready_count == 0) {
+            pthread_cond_wait(&s->changed, &s->lock);
+        }
+
+        if (!s->stop) {
+            next = s->ready[s->ready_head];
+            s->ready_head = (s->ready_head + 1) % s->num_buffers;
+            s->ready_count--;
+        }
+    }
+
+    MUTEX_UNLOCK(&s->lock);
+    return next;
+}
+
+/* Send filled RX buffers to the client */
+static void *sender_task(void *arg)
+{
+    struct net_server_stream *s = (struct net_server_stream *) arg;
+    uint8_t seq_buf[NET_SEQ_SIZE];
+    struct net_msg seq;
+    void *buffer;
+    int status = 0;
+
+    net_msg_init(&seq);
+    seq.data = seq_buf;
+    seq.len = seq.size = sizeof(seq_buf);
+
+    MUTEX_LOCK(&s->lock);
+
+    while (status == 0) {
+        while (!s->stop && s->ready_count == 0) {
+            pthread_cond_wait(&s->changed, &s->lock);
+        }
+
+        if (s->stop) {
+            break;
+        }
+
+        buffer = s->ready[s->ready_head];
+        net_put_le(seq_buf, s->ready_seq[s->ready_head], NET_SEQ_SIZE);
+        s->ready_head = (s->ready_head + 1) % s->num_buffers;
+        s->ready_count--;
+
+        MUTEX_UNLOCK(&s->lock);
+
+        MUTEX_LOCK(&s->send_lock);
+        status = net_send_msg(s->fd, NET_MSG_SAMPLES, 0, &seq,
+                              buffer, s->bytes);
+        MUTEX_UNLOCK(&s->send_lock);
+
+        MUTEX_LOCK(&s->lock);
+        s->free[s->num_free++] = buffer;
+    }
+
+    MUTEX_UNLOCK(&s->lock);
+
+    if (status != 0) {
+        log_debug("%s: Failed to send samples: %s\n", __FUNCTION__,
+                  bladerf_strerror(status));
+        request_stop(s);
+    }
+
+    return NULL;
+}
+
+/* Run the stream, and report its end to the client once the sender has
+ * stopped, such that no samples follow */
+static void *stream_task(void *arg)
+{
+    struct net_server_stream *s = (struct net_server_stream *) arg;
+    int status;
+
+    status = bladerf_stream(s->stream, s->module);
+
+    MUTEX_LOCK(&s->lock);
+    if (!s->stop && status == 0) {
+        status = BLADERF_ERR_UNEXPECTED;
+    }
+    s->stop = true;
+    pthread_cond_broadcast(&s->changed);
+    MUTEX_UNLOCK(&s->lock);
+
+    if (s->sender_started) {
+        pthread_join(s->sender_thread, NULL);
+    }
+
+    if (status != 0) {
+        log_debug("%s: Stream ended with: %s\n", __FUNCTION__,
+                  bladerf_strerror(status));
+    }
+
+    MUTEX_LOCK(&s->send_lock);
+    net_send_msg(s->fd, NET_MSG_STREAM_STOPPED, status, NULL, NULL, 0);
+    MUTEX_UNLOCK(&s->send_lock);
+
+    return NULL;
+}
+
+static void free_server_stream(struct net_server_stream *s)
+{
+    if (s->stream != NULL) {
+        bladerf_deinit_stream(s->stream);
+    }
+
+    pthread_cond_destroy(&s->changed);
+    free(s->free);
+    free(s->ready);
+    free(s->ready_seq);
+    free(s->scratch);
+    free(s);
+}
+
+/* Start a stream with the parameters of a NET_MSG_STREAM_START request.
+ * On success, s->send_lock is returned held, such that the response may be
+ * sent before any samples. */
+static int start_server_stream(struct bladerf *dev, int fd,
+                               struct net_msg *req,
+                               struct net_server_stream **out)
+{
+    struct net_server_stream *s;
+    uint32_t module, format, samples_per_buffer, num_transfers;
+    size_t i;
+    int status;
+
+    module = net_get_u32(req);
+    format = net_get_u32(req);
+    samples_per_buffer = net_get_u32(req);
+    num_transfers = net_get_u32(req);
+
+    if (req->error || !valid_module(module) || num_transfers == 0 ||
+        num_transfers > UINT16_MAX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    s = (struct net_server_stream *) calloc(1, sizeof(*s));
+    if (s == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    s->dev = dev;
+    s->fd = fd;
+    s->module = (bladerf_module) module;
+    s->num_buffers = num_transfers + NET_SERVER_QUEUE_LEN;
+    MUTEX_INIT(&s->lock);
+    MUTEX_INIT(&s->send_lock);
+    pthread_cond_init(&s->changed, NULL);
+
+    status = bladerf_init_stream(&s->stream, dev, stream_callback,
+                                 &s->buffers, s->num_buffers,
+                                 (bladerf_format) format, samples_per_buffer,
+                                 num_transfers, s);
+    if (status != 0) {
+        s->stream = NULL;
+        goto error;
+    }
+
+    s->bytes = samples_to_bytes((bladerf_format) format, samples_per_buffer);
+    s->free = (void **) calloc(s->num_buffers, sizeof(s->free[0]));
+    s->ready = (void **) calloc(s->num_buffers, sizeof(s->ready[0]));
+    s->ready_seq = (uint64_t *) calloc(s->num_buffers, sizeof(uint64_t));
+    s->scratch = (uint8_t *) malloc(s->bytes);
+
+    if (s->free == NULL || s->ready == NULL || s->ready_seq == NULL ||
+        s->scratch == NULL) {
+        status = BLADERF_ERR_MEM;
+        goto error;
+    }
+
+    /* RX streams start with the first num_transfers buffers in flight */
+    for (i = (module == BLADERF_MODULE_RX) ? num_transfers : 0;
+         i < s->num_buffers; i++) {
+        s->free[s->num_free++] = s->buffers[i];
+    }
+
+    MUTEX_LOCK(&s->send_lock);
+
+    if (module == BLADERF_MODULE_RX) {
+        status = pthread_create(&s->sender_thread, NULL, sender_task, s);
+        if (status != 0) {
+            MUTEX_UNLOCK(&s->send_lock);
+            status = BLADERF_ERR_UNEXPECTED;
+            goto error;
+        }
+        s->sender_started = true;
+    }
+
+    status = pthread_create(&s->stream_thread, NULL, stream_task, s);
+    if (status != 0) {
+        MUTEX_UNLOCK(&s->send_lock);
+        status = BLADERF_ERR_UNEXPECTED;
+
+        if (s->sender_started) {
+            request_stop(s);
+            pthread_join(s->sender_thread, NULL);
+        }
+
+        goto error;
+    }
+
+    *out = s;
+    return 0;
+
+error:
+    free_server_stream(s);
+    return status;
+}
+
+static void stop_server_stream(struct net_server_stream *s)
+{
+    request_stop(s);
+    pthread_join(s->stream_thread, NULL);
+    free_server_stream(s);
+}
+
+/* Read and discard `len` bytes */
+static int skip_bytes(int fd, size_t len)
+{
+    uint8_t buf[4096];
+    int status = 0;
+
+    while (len > 0 && status == 0) {
+        const size_t n = len < sizeof(buf) ? len : sizeof(buf);
+        status = net_recv_all(fd, buf, n);
+        len -= n;
+    }
+
+    return status;
+}
+
+/* Receive a TX frame into a free buffer, waiting for one to become free.
+ * Frames are discarded once the stream has stopped. */
+static int receive_frame(struct net_server_stream *s,
+                         const struct net_header *hdr)
+{
+    uint8_t seq_buf[NET_SEQ_SIZE];
+    uint8_t *buffer;
+    int status;
+
+    if (hdr->len != NET_SEQ_SIZE + s->bytes) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    status = net_recv_all(s->fd, seq_buf, sizeof(seq_buf));
+    if (status != 0) {
+        return status;
+    }
+
+    MUTEX_LOCK(&s->lock);
+    while (!s->stop && s->num_free == 0) {
+        pthread_cond_wait(&s->changed, &s->lock);
+    }
+    buffer = s->stop ? s->scratch : (uint8_t *) s->free[--s->num_free];
+    MUTEX_UNLOCK(&s->lock);
+
+    status = net_recv_all(s->fd, buffer, s->bytes);
+
+    MUTEX_LOCK(&s->lock);
+    if (buffer != s->scratch) {
+        if (status == 0) {
+            const size_t i = (s->ready_head + s->ready_count) % s->num_buffers;
+            s->ready[i] = buffer;
+            s->ready_count++;
+            pthread_cond_broadcast(&s->changed);
+        } else {
+            s->free[s->num_free++] = buffer;
+        }
+    }
+    MUTEX_UNLOCK(&s->lock);
+
+    return status;
+}
+
+static void serve_data(struct bladerf *dev, int fd, bool shared)
+{
+    struct net_server_stream *s = NULL;
+    struct net_msg msg;
+    struct net_header hdr;
+    int status = 0;
+
+    net_msg_init(&msg);
+
+    while (status == 0 && net_recv_header(fd, &hdr) == 0) {
+        switch (hdr.type) {
+            case NET_MSG_STREAM_START: {
+                uint8_t *p;
+                int started;
+
+                net_msg_reset(&msg);
+                p = net_msg_append(&msg, hdr.len);
+                status = (p != NULL) ? net_recv_all(fd, p, hdr.len)
+                                     : BLADERF_ERR_MEM;
+                if (status != 0) {
+                    break;
+                }
+
+                if (s != NULL) {
+                    log_debug("%s: Stream is already running\n",
+                              __FUNCTION__);
+                    status = net_send_msg(fd, NET_MSG_STREAM_START,
+                                          BLADERF_ERR_INVAL, NULL, NULL, 0);
+                    break;
+                }
+
+                /* Shared devices' RX samples are distributed by other
+                 * means, and the module cannot be streamed twice */
+                if (shared && net_get_u32(&msg) == BLADERF_MODULE_RX) {
+                    log_debug("%s: RX streams are not permitted in shared "
+                              "mode\n", __FUNCTION__);
+                    status = net_send_msg(fd, NET_MSG_STREAM_START,
+                                          BLADERF_ERR_UNSUPPORTED,
+                                          NULL, NULL, 0);
+                    break;
+                }
+
+                msg.pos = 0;
+
+                started = start_server_stream(dev, fd, &msg, &s);
+                status = net_send_msg(fd, NET_MSG_STREAM_START, started,
+                                      NULL, NULL, 0);
+                if (started == 0) {
+                    MUTEX_UNLOCK(&s->send_lock);
+                }
+                break;
+            }
+
+            case NET_MSG_STREAM_STOP:
+                status = skip_bytes(fd, hdr.len);
+                if (s != NULL) {
+                    stop_server_stream(s);
+                    s = NULL;
+                }
+                break;
+
+            case NET_MSG_SAMPLES:
+                if (s != NULL && s->module == BLADERF_MODULE_TX) {
+                    status = receive_frame(s, &hdr);
+                } else {
+                    status = skip_bytes(fd, hdr.len);
+                }
+                break;
+
+            default:
+                log_debug("%s: Unexpected message: %u\n", __FUNCTION__,
+                          hdr.type);
+                status = BLADERF_ERR_INVAL;
+                break;
+        }
+    }
+
+    if (s != NULL) {
+        stop_server_stream(s);
+    }
+
+    net_msg_free(&msg);
+}
+
+static void *conn_task(void *arg)
+{
+    struct net_conn *conn = (struct net_conn *) arg;
+    struct net_server *srv = conn->srv;
+    struct bladerf *dev = srv->dev;
+    struct net_msg msg;
+    struct net_header hdr;
+    struct timeval tv;
+    uint16_t version;
+    uint32_t session;
+    net_role role;
+    int status;
+
+    net_msg_init(&msg);
+
+    status = net_recv_msg(conn->fd, &hdr, &msg);
+    if (status != 0 || hdr.type != NET_MSG_HELLO) {
+        goto out;
+    }
+
+    version = net_get_u16(&msg);
+    role = (net_role) net_get_u8(&msg);
+    session = net_get_u32(&msg);
+
+    /* Connections may remain idle once established */
+    memset(&tv, 0, sizeof(tv));
+    setsockopt(conn->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    MUTEX_LOCK(&srv->lock);
+
+    if (msg.error || version != NET_PROTO_VERSION) {
+        status = BLADERF_ERR_UNSUPPORTED;
+    } else if (role == NET_ROLE_CONTROL) {
+        if (srv->sessions_active != 0 && !srv->shared) {
+            status = BLADERF_ERR_NODEV;
+        } else {
+            if (srv->sessions_active++ == 0) {
+                srv->session++;
+            }
+            session = srv->session;
+        }
+    } else if (role == NET_ROLE_DATA) {
+        if (srv->sessions_active == 0 || session != srv->session) {
+            status = BLADERF_ERR_NODEV;
+        }
+    } else if (role != NET_ROLE_PROBE) {
+        status = BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_UNLOCK(&srv->lock);
+
+    net_msg_reset(&msg);
+    if (status == 0) {
+        CTRL_LOCK(dev, CTRL_LOCK_ALL);
+        put_hello(dev, &msg, role == NET_ROLE_CONTROL ? session : 0,
+                  srv->shared);
+        CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
+    }
+
+    if (status == 0 && role == NET_ROLE_CONTROL) {
+        log_info("Session started.\n");
+        if (!srv->shared) {
+            reset_device_state(dev, false);
+        }
+    }
+
+    if (net_send_msg(conn->fd, NET_MSG_HELLO, status, &msg, NULL, 0) == 0 &&
+        status == 0) {
+
+        if (role == NET_ROLE_CONTROL) {
+            serve_control(srv, conn->fd);
+        } else if (role == NET_ROLE_DATA) {
+            serve_data(dev, conn->fd, srv->shared);
+        }
+    }
+
+    if (status == 0 && role == NET_ROLE_CONTROL) {
+        /* Shared sessions leave the device to the others. The server's
+         * register shadows are still discarded, as clients' changes bypass
+         * them. */
+        reset_device_state(dev, !srv->shared);
+        log_info("Session ended.\n");
+
+        MUTEX_LOCK(&srv->lock);
+        srv->sessions_active--;
+        srv->sessions_done++;
+        pthread_cond_broadcast(&srv->changed);
+        MUTEX_UNLOCK(&srv->lock);
+    }
+
+out:
+    net_msg_free(&msg);
+    close(conn->fd);
+
+    MUTEX_LOCK(&srv->lock);
+    srv->connections--;
+    pthread_cond_broadcast(&srv->changed);
+    MUTEX_UNLOCK(&srv->lock);
+
+    free(conn);
+    return NULL;
+}
+
+/* Listen on the loopback interface, or on the local address `address`. An
+ * IPv6 wildcard address also accepts IPv4 clients, where supported. */
+static int listen_on(const char *address, uint16_t port, int *fd_out)
+{
+    struct addrinfo hints, *res, *ai;
+    char port_str[8];
+    const int one = 1, zero = 0;
+    int status, fd = -1;
+
+    if (address == NULL) {
+        address = "127.0.0.1";
+    }
+
+    snprintf(port_str, sizeof(port_str), "%u", port);
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+
+    status = getaddrinfo(address, port_str, &hints, &res);
+    if (status != 0) {
+        log_error("Failed to resolve %s: %s\n", address,
+                  gai_strerror(status));
+        return BLADERF_ERR_INVAL;
+    }
+
+    for (ai = res; ai != NULL && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (ai->ai_family == AF_INET6) {
+            setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+        }
+
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    freeaddrinfo(res);
+
+    if (fd < 0) {
+        log_error("Failed to bind to %s port %u: %s\n", address, port,
+                  strerror(errno));
+        return BLADERF_ERR_IO;
+    }
+
+    if (listen(fd, 8) != 0) {
+        log_error("Failed to listen on port %u: %s\n", port, strerror(errno));
+        close(fd);
+        return BLADERF_ERR_IO;
+    }
+
+    *fd_out = fd;
+    return 0;
+}
+
+/* Listen on a Unix domain socket, replacing a stale socket at `path` */
+static int listen_on_path(const char *path, int *fd_out)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        log_error("Socket path is too long: %s\n", path);
+        return BLADERF_ERR_INVAL;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        log_error("Failed to create socket: %s\n", strerror(errno));
+        return BLADERF_ERR_IO;
+    }
+
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        bool stale = false;
+
+        /* Only replace an existing socket if nothing is listening on it */
+        if (errno == EADDRINUSE && stat(path, &st) == 0 &&
+            S_ISSOCK(st.st_mode)) {
+            int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (probe >= 0) {
+                stale = connect(probe, (struct sockaddr *) &addr,
+                                sizeof(addr)) != 0 && errno == ECONNREFUSED;
+                close(probe);
+            }
+        }
+
+        if (!stale || unlink(path) != 0 ||
+            bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+            log_error("Failed to bind to %s: %s\n", path, strerror(errno));
+            close(fd);
+            return BLADERF_ERR_IO;
+        }
+    }
+
+    if (listen(fd, 8) != 0) {
+        log_error("Failed to listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        unlink(path);
+        return BLADERF_ERR_IO;
+    }
+
+    *fd_out = fd;
+    return 0;
+}
+
+int net_serve(struct bladerf *dev, const struct bladerf_net_serve_config *config)
+{
+    struct net_server srv;
+    struct pollfd pfd;
+    const uint16_t port = config->port ? config->port : NET_DEFAULT_PORT;
+    const unsigned int sessions = config->sessions;
+    bool done = false;
+    int status, fd;
+
+    if (config->path != NULL) {
+        status = listen_on_path(config->path, &fd);
+    } else {
+        status = listen_on(config->address, port, &fd);
+    }
+
+    if (status != 0) {
+        return status;
+    }
+
+    memset(&srv, 0, sizeof(srv));
+    srv.dev = dev;
+    srv.shared = config->shared;
+    MUTEX_INIT(&srv.lock);
+    pthread_cond_init(&srv.changed, NULL);
+
+    if (config->path != NULL) {
+        log_info("Serving %s on %s%s\n", dev->ident.serial, config->path,
+                 srv.shared ? " (shared)" : "");
+    } else {
+        log_info("Serving %s on %s port %u%s\n", dev->ident.serial,
+                 config->address != NULL ? config->address : "127.0.0.1",
+                 port, srv.shared ? " (shared)" : "");
+    }
+
+    while (!done) {
+        struct net_conn *conn;
+        struct timeval tv;
+        pthread_t thread;
+        int conn_fd;
+
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+
+        if (poll(&pfd, 1, NET_SERVER_POLL_MS) == 1) {
+            conn_fd = accept(fd, NULL, NULL);
+            if (conn_fd < 0) {
+                log_debug("accept failed: %s\n", strerror(errno));
+                continue;
+            }
+
+            conn = (struct net_conn *) calloc(1, sizeof(*conn));
+            if (conn == NULL) {
+                close(conn_fd);
+                continue;
+            }
+
+            tv.tv_sec = NET_SERVER_HELLO_TIMEOUT_MS / 1000;
+            tv.tv_usec = (NET_SERVER_HELLO_TIMEOUT_MS % 1000) * 1000;
+            setsockopt(conn_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+            if (config->path == NULL) {
+                net_config_socket(conn_fd, true);
+            }
+
+            conn->srv = &srv;
+            conn->fd = conn_fd;
+
+            MUTEX_LOCK(&srv.lock);
+            srv.connections++;
+            MUTEX_UNLOCK(&srv.lock);
+
+            if (pthread_create(&thread, NULL, conn_task, conn) != 0) {
+                log_debug("Failed to start connection thread\n");
+                close(conn_fd);
+                free(conn);
+
+                MUTEX_LOCK(&srv.lock);
+                srv.connections--;
+                MUTEX_UNLOCK(&srv.lock);
+            } else {
+                pthread_detach(thread);
+            }
+        }
+
+        MUTEX_LOCK(&srv.lock);
+        done = sessions != 0 && srv.sessions_done >= sessions;
+        MUTEX_UNLOCK(&srv.lock);
+    }
+
+    close(fd);
+    if (config->path != NULL) {
+        unlink(config->path);
+    }
+
+    /* Wait for the remaining connections to be closed by their clients */
+    MUTEX_LOCK(&srv.lock);
+    while (srv.connections != 0) {
+        pthread_cond_wait(&srv.changed, &srv.lock);
+    }
+    MUTEX_UNLOCK(&srv.lock);
+
+    pthread_cond_destroy(&srv.changed);
+    return 0;
+}
@@ -44,16 +44,54 @@ static const GUID driver_guid = {
     0x35D5D3F1, 0x9D0E, 0x4F62, 0xBC, 0xFB, 0xB0, 0xD4, 0x8E,0xA6, 0x34, 0x16
 };
 
+#ifndef ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+#   define ENABLE_LIBBLADERF_STREAM_CB_LOCKED 0
+#endif
+
+/* Interval at which a streaming thread checks for transfers that have
+ * exceeded the device's transfer timeout */
+#ifndef CYAPI_TIMEOUT_CHECK_MS
+#   define CYAPI_TIMEOUT_CHECK_MS 100
+#endif
+
+/* I/O completion port keys */
+#define CYAPI_KEY_XFER  0   /* Overlapped I/O on an endpoint handle */
+#define CYAPI_KEY_STOP  1   /* Request for the completion thread to exit */
+
 /* "Private data" for the CyAPI backend */
 struct bladerf_cyapi {
     CCyUSBDevice *dev;
     HANDLE mutex;
+
+    /* Stream transfers complete to this port, and are handled by a single
+     * thread for all of the device's streams */
+    HANDLE iocp;
+    pthread_t completion_thread;
+    bool completion_thread_running;
+
+    /* Protects the following items, which are accessed by the
+     * completion thread */
+    MUTEX streams_lock;
+    HANDLE iocp_handles[NUM_MODULES];               /* Associated handles */
+    struct bladerf_stream *streams[NUM_MODULES];    /* Active streams */
 };
 
+typedef enum {
+    TRANSFER_AVAIL = 0,
+    TRANSFER_IN_FLIGHT,
+    TRANSFER_IN_CALLBACK        /* Completed, and reserved for the buffer
+                                 * returned by the stream callback */
+} transfer_status;
+
 struct transfer {
-    OVERLAPPED event;           /* Transfer completion event handle */
+    OVERLAPPED event;           /* Transfer completion event handle. This
+                                 * must remain the first member, as
+                                 * completion packets are mapped back to their
+                                 * transfer via its address. */
     PUCHAR handle;              /* Handle for in-flight transfer */
     PUCHAR buffer;              /* Buffer associated with transfer */
+    transfer_status status;
+    uint64_t submit_time_us;    /* For turnaround statistics and timeouts */
 };
 
 struct stream_data {
@@ -63,9 +101,13 @@ struct stream_data {
 
     size_t num_transfers;       /* Max # of in-flight transfers */
     size_t num_avail;
-    size_t avail_i;             /* Index of next available transfer slot */
-    size_t inflight_i;          /* Index of in-flight transfer that is
-                                 * expected to finish next */
+    size_t avail_i;             /* Index at which to start searching for an
+                                 * available transfer slot */
+    bool aborted;               /* In-flight transfers have been aborted */
+
+    pthread_cond_t stream_done; /* Signaled when stream->state
+                                 * reaches STREAM_DONE */
+    bool stream_done_init;
 };
 
 static inline struct bladerf_cyapi * get_backend_data(void *driver)
@@ -192,6 +234,78 @@ static int cyapi_probe(backend_probe_target probe_target,
     return 0;
 }
 
+static void complete_transfer(struct bladerf_cyapi *cyapi, LPOVERLAPPED ov);
+
+static void *cyapi_completion_thread(void *arg)
+{
+    struct bladerf_cyapi *cyapi = (struct bladerf_cyapi *) arg;
+    DWORD len;
+    ULONG_PTR key;
+    LPOVERLAPPED ov;
+    BOOL success;
+
+    while (true) {
+        success = GetQueuedCompletionStatus(cyapi->iocp, &len, &key, &ov,
+                                            INFINITE);
+
+        if (ov != NULL) {
+            /* Failed transfers are reported via FinishDataXfer() */
+            complete_transfer(cyapi, ov);
+        } else if (!success) {
+            log_error("Failed to dequeue completion packet: %ld\n",
+                      GetLastError());
+            break;
+        } else if (key == CYAPI_KEY_STOP) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+static int start_completion_thread(struct bladerf_cyapi *cyapi)
+{
+    int status;
+
+    cyapi->iocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    if (cyapi->iocp == NULL) {
+        log_error("Failed to create I/O completion port: %ld\n",
+                  GetLastError());
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    MUTEX_INIT(&cyapi->streams_lock);
+
+    status = pthread_create(&cyapi->completion_thread, NULL,
+                            cyapi_completion_thread, cyapi);
+    if (status != 0) {
+        log_error("Failed to start CyAPI completion thread: %s\n",
+                  strerror(status));
+        CloseHandle(cyapi->iocp);
+        cyapi->iocp = NULL;
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    cyapi->completion_thread_running = true;
+    return 0;
+}
+
+static void stop_completion_thread(struct bladerf_cyapi *cyapi)
+{
+    if (!cyapi->completion_thread_running) {
+        return;
+    }
+
+    if (PostQueuedCompletionStatus(cyapi->iocp, 0, CYAPI_KEY_STOP, NULL)) {
+        pthread_join(cyapi->completion_thread, NULL);
+    } else {
+        log_error("Failed to stop CyAPI completion thread: %ld\n",
+                  GetLastError());
+    }
+
+    cyapi->completion_thread_running = false;
+}
+
 static int open_via_info(void **driver, backend_probe_target probe_target,
                          struct bladerf_devinfo *info_in,
                          struct bladerf_devinfo *info_out)
@@ -224,6 +338,12 @@ static int open_via_info(void **driver, backend_probe_target probe_target,
 
             status = open_device(dev, instance, &cyapi_data->mutex);
             if (status == 0) {
+                status = start_completion_thread(cyapi_data);
+                if (status != 0) {
+                    dev->Close();
+                    break;
+                }
+
                 cyapi_data->dev = dev;
                 *driver = cyapi_data;
                 if (info_out != NULL) {
@@ -273,9 +393,18 @@ static int cyapi_change_setting(void *driver, uint8_t setting)
 static void cyapi_close(void *driver)
 {
     struct bladerf_cyapi *cyapi_data = get_backend_data(driver);
+
+    /* The device's handle (and its association with the completion port)
+     * must be closed before the port itself is closed */
+    stop_completion_thread(cyapi_data);
     cyapi_data->dev->Close();
     delete cyapi_data->dev;
     CloseHandle(cyapi_data->mutex);
+
+    if (cyapi_data->iocp != NULL) {
+        CloseHandle(cyapi_data->iocp);
+    }
+
     free(driver);
 
 }
@@ -445,8 +574,16 @@ static int cyapi_deinit_stream(void *driver, struct bladerf_stream *stream)
     data =  get_stream_data(stream);
     assert(data != NULL);
 
-    for (unsigned int i = 0; i < data->num_transfers; i++) {
-        CloseHandle(data->transfers[i].event.hEvent);
+    if (data->transfers != NULL) {
+        for (unsigned int i = 0; i < data->num_transfers; i++) {
+            if (data->transfers[i].event.hEvent != NULL) {
+                CloseHandle(data->transfers[i].event.hEvent);
+            }
+        }
+    }
+
+    if (data->stream_done_init) {
+        pthread_cond_destroy(&data->stream_done);
     }
 
     free(data->transfers);
@@ -459,7 +596,6 @@ static int cyapi_init_stream(void *driver, struct bladerf_stream *stream,
                             size_t num_transfers)
 {
     int status = BLADERF_ERR_MEM;
-    CCyUSBDevice *dev = get_device(driver);
     struct stream_data *data;
 
     data = (struct stream_data *) calloc(1, sizeof(data[0]));
@@ -476,21 +612,27 @@ static int cyapi_init_stream(void *driver, struct bladerf_stream *stream,
         goto out;
     }
 
+    data->num_transfers = num_transfers;
+
     for (unsigned int i = 0; i < num_transfers; i++) {
         data->transfers[i].event.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
         if (data->transfers[i].event.hEvent == NULL) {
             log_debug("%s: Failed to create EventObject for transfer %u\n",
-                      (unsigned int) i);
+                      __FUNCTION__, (unsigned int) i);
             goto out;
         }
     }
 
-   data->num_transfers = num_transfers;
-   data->num_avail = num_transfers;
-   data->inflight_i = 0;
-   data->avail_i = 0;
+    if (pthread_cond_init(&data->stream_done, NULL) != 0) {
+        status = BLADERF_ERR_UNEXPECTED;
+        goto out;
+    }
+
+    data->stream_done_init = true;
+    data->num_avail = num_transfers;
+    data->avail_i = 0;
 
-   status = 0;
+    status = 0;
 
 out:
     if (status != 0) {
@@ -521,9 +663,101 @@ static inline int find_buf(void* ptr, struct bladerf_stream *stream)
 #define log_verbose(...)
 #endif
 
-static inline size_t next_idx(struct stream_data *data, size_t i)
+/* Associate an endpoint's handle with the device's completion port. A handle
+ * may only be associated once. */
+static int associate_handle(struct bladerf_cyapi *cyapi, HANDLE handle)
 {
-    return (i + 1) % data->num_transfers;
+    int status = 0;
+    size_t i;
+    bool associated = false;
+
+    MUTEX_LOCK(&cyapi->streams_lock);
+
+    for (i = 0; i < NUM_MODULES && !associated; i++) {
+        associated = (cyapi->iocp_handles[i] == handle);
+    }
+
+    if (!associated) {
+        i = 0;
+        while (i < NUM_MODULES && cyapi->iocp_handles[i] != NULL) {
+            i++;
+        }
+
+        if (i >= NUM_MODULES ||
+            CreateIoCompletionPort(handle, cyapi->iocp,
+                                   CYAPI_KEY_XFER, 0) == NULL) {
+
+            log_debug("Failed to associate handle with completion port: "
+                      "%ld\n", GetLastError());
+            status = BLADERF_ERR_UNEXPECTED;
+        } else {
+            cyapi->iocp_handles[i] = handle;
+        }
+    }
+
+    MUTEX_UNLOCK(&cyapi->streams_lock);
+    return status;
+}
+
+/* Find the stream transfer associated with an OVERLAPPED structure. Other
+ * I/O on the device's handle (e.g., control transfers performed by CyAPI)
+ * also completes to our port; NULL is returned for these. */
+static struct transfer *find_transfer(struct bladerf_cyapi *cyapi,
+                                      LPOVERLAPPED ov,
+                                      struct bladerf_stream **stream_out)
+{
+    struct transfer *ret = NULL;
+    const uintptr_t addr = (uintptr_t) ov;
+
+    MUTEX_LOCK(&cyapi->streams_lock);
+
+    for (size_t i = 0; i < NUM_MODULES && ret == NULL; i++) {
+        struct bladerf_stream *stream = cyapi->streams[i];
+
+        if (stream != NULL) {
+            struct stream_data *data = get_stream_data(stream);
+            const uintptr_t start = (uintptr_t) data->transfers;
+            const uintptr_t off = addr - start;
+
+            if (addr >= start &&
+                off < data->num_transfers * sizeof(data->transfers[0]) &&
+                off % sizeof(data->transfers[0]) == 0) {
+
+                ret = &data->transfers[off / sizeof(data->transfers[0])];
+                *stream_out = stream;
+            }
+        }
+    }
+
+    MUTEX_UNLOCK(&cyapi->streams_lock);
+    return ret;
+}
+
+/* Abort all in-flight transfers. Their completions are still delivered to
+ * the completion thread. */
+static inline void abort_transfers(struct bladerf_stream *stream)
+{
+    struct stream_data *data = get_stream_data(stream);
+
+    if (!data->aborted && data->num_avail != data->num_transfers) {
+        data->aborted = true;
+        data->ep->Abort();
+    }
+}
+
+/* End the stream once all transfers have been returned */
+static inline void check_stream_done(struct bladerf_stream *stream)
+{
+    struct stream_data *data = get_stream_data(stream);
+
+    if (stream->state == STREAM_SHUTTING_DOWN) {
+        if (data->num_avail == data->num_transfers) {
+            stream->state = STREAM_DONE;
+            pthread_cond_signal(&data->stream_done);
+        } else {
+            abort_transfers(stream);
+        }
+    }
 }
 
 /* Assumes a transfer is available and the stream lock is being held */
@@ -532,54 +766,239 @@ static int submit_transfer(struct bladerf_stream *stream, void *buffer)
     int status = 0;
     PUCHAR xfer;
     struct stream_data *data = get_stream_data(stream);
+    struct transfer *t = NULL;
 
     LONG buffer_size = (LONG) async_stream_buf_bytes(stream);
 
-    assert(data->transfers[data->avail_i].handle == NULL);
-    assert(data->transfers[data->avail_i].buffer == NULL);
     assert(data->num_avail != 0);
 
-    xfer = data->ep->BeginDataXfer((PUCHAR) buffer, buffer_size,
-                                   &data->transfers[data->avail_i].event);
+    for (size_t n = 0; n < data->num_transfers && t == NULL; n++) {
+        if (data->transfers[data->avail_i].status == TRANSFER_AVAIL) {
+            t = &data->transfers[data->avail_i];
+        }
+
+        data->avail_i = (data->avail_i + 1) % data->num_transfers;
+    }
+
+    if (t == NULL) {
+        log_debug("%s: No transfers available.\n", __FUNCTION__);
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    assert(t->handle == NULL);
+    assert(t->buffer == NULL);
+
+    t->submit_time_us = async_stats_time_us();
+    xfer = data->ep->BeginDataXfer((PUCHAR) buffer, buffer_size, &t->event);
 
     if (xfer != NULL) {
-        data->transfers[data->avail_i].handle = xfer;
-        data->transfers[data->avail_i].buffer = (PUCHAR) buffer;
+        t->handle = xfer;
+        t->buffer = (PUCHAR) buffer;
+        t->status = TRANSFER_IN_FLIGHT;
 
         log_verbose("Submitted buffer %p using transfer slot %u.\n",
-                    buffer, (unsigned int) data->avail_i);
+                    buffer, (unsigned int) (t - data->transfers));
 
-        data->avail_i = next_idx(data, data->avail_i);
         data->num_avail--;
     } else {
         status = BLADERF_ERR_UNEXPECTED;
         log_debug("Failed to submit buffer %p in transfer slot %u.\n",
-                  buffer, (unsigned int) data->avail_i);
+                  buffer, (unsigned int) (t - data->transfers));
     }
 
     return status;
 }
 
+/* Return a transfer to the pool of those available for submission */
+static inline void release_transfer(struct bladerf_stream *stream,
+                                    struct transfer *t)
+{
+    struct stream_data *data = get_stream_data(stream);
+
+    t->buffer = NULL;
+    t->handle = NULL;
+    t->status = TRANSFER_AVAIL;
+    data->num_avail++;
+    pthread_cond_signal(&stream->can_submit_buffer);
+}
+
+/* Executed by the completion thread for each completion packet */
+static void complete_transfer(struct bladerf_cyapi *cyapi, LPOVERLAPPED ov)
+{
+    struct bladerf_stream *stream = NULL;
+    struct transfer *t = find_transfer(cyapi, ov, &stream);
+    struct stream_data *data;
+    struct bladerf_metadata meta;
+    void *next_buffer;
+    LONG len = 0;
+    bool success;
+    uint64_t now_us;
+    uint64_t cb_done_us;
+
+    if (t == NULL) {
+        return;
+    }
+
+    data = get_stream_data(stream);
+
+    MUTEX_LOCK(&stream->lock);
+
+    now_us = async_stats_time_us();
+    assert(t->status == TRANSFER_IN_FLIGHT);
+
+    /* Reserve this transfer for the buffer returned by the callback, so
+     * that it cannot be claimed by a bladerf_submit_stream_buffer() caller
+     * while we execute the callback without holding the lock. */
+    t->status = TRANSFER_IN_CALLBACK;
+
+    log_verbose("Got transfer complete in slot %u (buffer %p)\n",
+                (unsigned int) (t - data->transfers), t->buffer);
+
+    success = data->ep->FinishDataXfer(t->buffer, len, &t->event, t->handle);
+
+    if (success) {
+        stream->stats.transfers++;
+        async_stats_hist_add(stream->stats.turnaround_hist,
+                             t->submit_time_us, now_us);
+    } else {
+        /* Aborted transfers are expected when tearing down the stream */
+        if (!data->aborted) {
+            stream->error_code = BLADERF_ERR_IO;
+            log_debug("Failed to finish transfer %u, buf=%p.\n",
+                      (unsigned int) (t - data->transfers), t->buffer);
+        }
+
+        stream->state = STREAM_SHUTTING_DOWN;
+    }
+
+    if (stream->state == STREAM_RUNNING) {
+
+        if ((size_t) len != async_stream_buf_bytes(stream)) {
+            log_warning("Received short transfer\n");
+            stream->stats.short_transfers++;
+        }
+
+        async_rx_metadata(stream, t->buffer,
+                          bytes_to_samples(stream->format, len), &meta);
+
+#       if !ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+        MUTEX_UNLOCK(&stream->lock);
+#       endif
+
+        next_buffer = stream->cb(stream->dev, stream, &meta, t->buffer,
+                                 bytes_to_samples(stream->format, len),
+                                 stream->user_data);
+
+        cb_done_us = async_stats_time_us();
+
+#       if !ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+        MUTEX_LOCK(&stream->lock);
+#       endif
+
+        async_stats_hist_add(stream->stats.callback_hist, now_us, cb_done_us);
+        release_transfer(stream, t);
+
+        if (next_buffer == BLADERF_STREAM_SHUTDOWN) {
+            stream->state = STREAM_SHUTTING_DOWN;
+        } else if (next_buffer != BLADERF_STREAM_NO_DATA &&
+                   stream->state == STREAM_RUNNING) {
+            int status = submit_transfer(stream, next_buffer);
+            if (status != 0) {
+                stream->error_code = status;
+                stream->state = STREAM_SHUTTING_DOWN;
+            }
+        }
+    } else {
+        release_transfer(stream, t);
+    }
+
+    check_stream_done(stream);
+
+    MUTEX_UNLOCK(&stream->lock);
+}
+
+/* Overlapped transfers do not time out on their own, so fail the stream if
+ * any transfer has been in flight longer than the device's transfer
+ * timeout */
+static void check_timeouts(struct bladerf_stream *stream)
+{
+    struct stream_data *data = get_stream_data(stream);
+    const uint64_t timeout_us =
+        (uint64_t) stream->dev->transfer_timeout[stream->module] * 1000;
+    const uint64_t now_us = async_stats_time_us();
+
+    if (timeout_us == 0 || stream->state != STREAM_RUNNING) {
+        return;
+    }
+
+    for (size_t i = 0; i < data->num_transfers; i++) {
+        const struct transfer *t = &data->transfers[i];
+
+        if (t->status == TRANSFER_IN_FLIGHT &&
+            now_us - t->submit_time_us >= timeout_us) {
+
+            log_debug("Steam timed out.\n");
+            stream->error_code = BLADERF_ERR_TIMEOUT;
+            stream->state = STREAM_SHUTTING_DOWN;
+            abort_transfers(stream);
+            break;
+        }
+    }
+}
+
+/* Callbacks execute on the completion thread, so apply the stream's
+ * scheduling options there. These are left in place after the stream ends,
+ * as the thread is shared by all of the device's streams. */
+static void apply_completion_thread_config(struct bladerf_cyapi *cyapi,
+                                           struct bladerf_stream *stream,
+                                           bladerf_module module)
+{
+    int status;
+    const struct bladerf_stream_thread_config *config =
+        &stream->thread_config[module];
+    const uint64_t cpus = async_thread_cpus(stream, module);
+
+    if (config->policy != BLADERF_SCHED_DEFAULT) {
+        const thread_sched_policy policy =
+            (config->policy == BLADERF_SCHED_FIFO) ?
+                THREAD_SCHED_FIFO : THREAD_SCHED_RR;
+
+        status = thread_set_sched(cyapi->completion_thread, policy,
+                                  config->priority);
+        if (status != 0) {
+            log_warning("Failed to set CyAPI completion thread priority: "
+                        "%s\n", strerror(status));
+        }
+    }
+
+    if (cpus != 0) {
+        status = thread_set_affinity(cyapi->completion_thread, cpus);
+        if (status != 0) {
+            log_warning("Failed to set CyAPI completion thread CPU "
+                        "affinity: %s\n", strerror(status));
+        }
+    }
+}
+
+static inline void set_active_stream(struct bladerf_cyapi *cyapi,
+                                     bladerf_module module,
+                                     struct bladerf_stream *stream)
+{
+    MUTEX_LOCK(&cyapi->streams_lock);
+    cyapi->streams[module] = stream;
+    MUTEX_UNLOCK(&cyapi->streams_lock);
+}
+
 static int cyapi_stream(void *driver, struct bladerf_stream *stream,
                        bladerf_module module)
 {
     int status;
-    int idx = 0;
-    long len;
     void *next_buffer;
-    ULONG timeout_ms;
-    bool success, done;
+    struct timespec timeout_abs;
     struct stream_data *data = get_stream_data(stream);
     struct bladerf_cyapi *cyapi = get_backend_data(driver);
     struct bladerf_metadata meta;
 
-    assert(stream->dev->transfer_timeout[stream->module] <= ULONG_MAX);
-    if (stream->dev->transfer_timeout[stream->module] == 0) {
-        timeout_ms = INFINITE;
-    } else {
-        timeout_ms = stream->dev->transfer_timeout[stream->module];
-    }
-
     switch (module) {
         case BLADERF_MODULE_RX:
             data->ep = get_ep(cyapi->dev, SAMPLE_EP_IN);
@@ -603,21 +1022,30 @@ static int cyapi_stream(void *driver, struct bladerf_stream *stream,
     data->ep->Abort();
     data->ep->Reset();
 
+    status = associate_handle(cyapi, data->ep->hDevice);
+    if (status != 0) {
+        return status;
+    }
+
+    apply_completion_thread_config(cyapi, stream, module);
+
     log_verbose("Starting stream...\n");
-    status = 0;
-    done = false;
     memset(&meta, 0, sizeof(meta));
+    data->aborted = false;
+    set_active_stream(cyapi, module, stream);
 
     MUTEX_LOCK(&stream->lock);
 
-    for (unsigned int i = 0; i < data->num_transfers && status == 0; i++) {
+    /* Set up initial set of buffers. All of these remain outstanding at once;
+     * their completions are handled by the device's completion thread. */
+    for (unsigned int i = 0; i < data->num_transfers; i++) {
         if (module == BLADERF_MODULE_TX) {
             next_buffer = stream->cb(stream->dev, stream, &meta, NULL,
                                      stream->samples_per_buffer,
                                      stream->user_data);
 
             if (next_buffer == BLADERF_STREAM_SHUTDOWN) {
-                done = true;
+                stream->state = STREAM_SHUTTING_DOWN;
                 break;
             } else if (next_buffer == BLADERF_STREAM_NO_DATA) {
                 continue;
@@ -627,99 +1055,38 @@ static int cyapi_stream(void *driver, struct bladerf_stream *stream,
         }
 
         status = submit_transfer(stream, next_buffer);
-    }
-
-    MUTEX_UNLOCK(&stream->lock);
-    if (status != 0) {
-        goto out;
-    }
-
-    while (!done) {
-        struct transfer *xfer;
-        size_t i;
-
-        i = data->inflight_i;
-        xfer = &data->transfers[i];
-        success = data->ep->WaitForXfer(&xfer->event, timeout_ms);
-
-        if (!success) {
-            status = BLADERF_ERR_TIMEOUT;
-            log_debug("Steam timed out.\n");
+        if (status != 0) {
+            stream->error_code = status;
+            stream->state = STREAM_SHUTTING_DOWN;
             break;
         }
-
-        len = 0;
-        next_buffer = NULL;
-
-        log_verbose("Got transfer complete in slot %u (buffer %p)\n",
-                    i, data->transfers[i].buffer);
-
-        MUTEX_LOCK(&stream->lock);
-        success = data->ep->FinishDataXfer(data->transfers[i].buffer, len,
-                                           &data->transfers[i].event,
-                                           xfer->handle);
-
-        if (success) {
-            next_buffer = stream->cb(stream->dev, stream, &meta,
-                                     data->transfers[i].buffer,
-                                     bytes_to_samples(stream->format, len),
-                                     stream->user_data);
-
-        } else {
-            done = true;
-            status = BLADERF_ERR_IO;
-            log_debug("Failed to finish transfer %u, buf=%p.\n",
-                      (unsigned int)i, &data->transfers[i].buffer);
-        }
-
-        data->transfers[i].buffer = NULL;
-        data->transfers[i].handle = NULL;
-        data->num_avail++;
-        pthread_cond_signal(&stream->can_submit_buffer);
-
-        if (next_buffer == BLADERF_STREAM_SHUTDOWN) {
-            done = true;
-        } else if (next_buffer != BLADERF_STREAM_NO_DATA) {
-            status = submit_transfer(stream, next_buffer);
-            done = (status != 0);
-        }
-
-        data->inflight_i = next_idx(data, data->inflight_i);
-        MUTEX_UNLOCK(&stream->lock);
     }
 
-out:
-
-    MUTEX_LOCK(&stream->lock);
-    stream->error_code = status;
-    stream->state = STREAM_SHUTTING_DOWN;
-
-    data->ep->Abort();
-    data->ep->Reset();
+    check_stream_done(stream);
 
-
-    for (unsigned int i = 0; i < data->num_transfers; i++) {
-        LONG len = 0;
-        if (data->transfers[i].handle != NULL) {
-            data->ep->FinishDataXfer(data->transfers[i].buffer, len,
-                                     &data->transfers[i].event,
-                                     data->transfers[i].handle);
-
-
-            data->transfers[i].buffer = NULL;
-            data->transfers[i].handle = NULL;
-            data->num_avail++;
+    /* Wait for the completion thread to bring the stream to completion,
+     * checking for transfers that have timed out along the way. */
+    while (stream->state != STREAM_DONE) {
+        if (populate_abs_timeout(&timeout_abs, CYAPI_TIMEOUT_CHECK_MS) != 0 ||
+            pthread_cond_timedwait(&data->stream_done, &stream->lock,
+                                   &timeout_abs) == ETIMEDOUT) {
+            check_timeouts(stream);
         }
     }
 
     assert(data->num_avail == data->num_transfers);
-
-    stream->state = STREAM_DONE;
     log_verbose("Stream done (error_code = %d)\n", stream->error_code);
     MUTEX_UNLOCK(&stream->lock);
 
-    return 0;
+    set_active_stream(cyapi, module, NULL);
+
+    if (data->aborted) {
+        data->ep->Reset();
+    }
+
+    return status;
 }
+
 /* The top-level code will have aquired the stream->lock for us */
 int cyapi_submit_stream_buffer(void *driver, struct bladerf_stream *stream,
                               void *buffer, unsigned int timeout_ms)
@@ -729,12 +1096,8 @@ int cyapi_submit_stream_buffer(void *driver, struct bladerf_stream *stream,
     struct stream_data *data = get_stream_data(stream);
 
     if (buffer == BLADERF_STREAM_SHUTDOWN) {
-        if (data->num_avail == data->num_transfers) {
-            stream->state = STREAM_DONE;
-        } else {
-            stream->state = STREAM_SHUTTING_DOWN;
-        }
-
+        stream->state = STREAM_SHUTTING_DOWN;
+        check_stream_done(stream);
         return 0;
     }
 
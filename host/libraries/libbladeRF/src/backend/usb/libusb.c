@@ -19,6 +19,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
 #include <errno.h>
 #include <libusb.h>
@@ -28,36 +29,100 @@
 #include "backend/usb/usb.h"
 #include "async.h"
 #include "log.h"
+#include "probes.h"
+
+#if !BLADERF_OS_WINDOWS
+#   include <unistd.h>  /* _POSIX_THREAD_CPUTIME */
+#endif
+
+#ifndef ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+#   define ENABLE_LIBBLADERF_STREAM_CB_LOCKED 0
+#endif
 
 #ifndef LIBUSB_HANDLE_EVENTS_TIMEOUT_NSEC
 #   define LIBUSB_HANDLE_EVENTS_TIMEOUT_NSEC    (15 * 1000)
 #endif
 
+/* Maintain a registry of attached devices via libusb hotplug events, rather
+ * than walking (and opening) every USB device each time we probe */
+#ifndef ENABLE_LIBUSB_HOTPLUG_REGISTRY
+#   if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000102)
+#       define ENABLE_LIBUSB_HOTPLUG_REGISTRY 1
+#   else
+#       define ENABLE_LIBUSB_HOTPLUG_REGISTRY 0
+#   endif
+#endif
+
 struct bladerf_lusb {
     libusb_device           *dev;
     libusb_device_handle    *handle;
     libusb_context          *context;
+
+    /* Services libusb events (i.e., transfer completions) for all of this
+     * device's streams, so that RX and TX do not contend for libusb's
+     * event handling lock */
+    pthread_t               event_thread;
+    bool                    event_thread_running;
+    volatile int            event_thread_stop;
+
+    /* Number of running streams configured to busy-poll. While non-zero,
+     * the event thread polls for events without blocking. */
+    volatile uint32_t       busy_poll_streams;
+
+    /* Event handling iterations. Only written by the event thread. */
+    volatile uint64_t       event_polls;
 };
 
 typedef enum {
     TRANSFER_UNINITIALIZED = 0,
     TRANSFER_AVAIL,
     TRANSFER_IN_FLIGHT,
-    TRANSFER_CANCEL_PENDING
+    TRANSFER_CANCEL_PENDING,
+    TRANSFER_IN_CALLBACK        /* Completed, and reserved for the buffer
+                                 * returned by the stream callback */
 } transfer_status;
 
+/* Passed to each transfer's callback, so that the transfer's index need
+ * not be searched for upon completion */
+struct lusb_transfer_ctx {
+    struct bladerf_stream *stream;
+    size_t idx;
+};
+
 struct lusb_stream_data {
     size_t num_transfers;               /* Total # of allocated transfers */
     size_t num_avail;                   /* # of currently available transfers */
     size_t i;                           /* Index to next transfer */
     struct libusb_transfer **transfers; /* Array of transfer metadata */
+    struct lusb_transfer_ctx *transfer_ctx; /* User data of each transfer */
     transfer_status *transfer_status;   /* Status of each transfer */
+    uint64_t *submit_time_us;           /* Submission time of each transfer,
+                                         * for turnaround statistics */
+    pthread_cond_t stream_done;         /* Signaled when stream->state
+                                         * reaches STREAM_DONE */
+
+    unsigned int bufs_per_xfer;         /* Max buffers covered by a transfer */
+    unsigned int *transfer_nbufs;       /* # buffers covered by each transfer */
+    uint8_t *gather_buf;                /* First of the buffers queued for the
+                                         * next transfer */
+    unsigned int gather_count;          /* # of buffers queued */
+
+    size_t bufs_in_flight;              /* # of buffers covered by in-flight
+                                         * transfers */
+    void **deferred;                    /* FIFO of buffers held back due to
+                                         * stream->transfer_limit */
+    size_t deferred_head;               /* Index of oldest deferred buffer */
+    size_t deferred_count;              /* # of deferred buffers */
 
    /* Warn the first time we get a transfer callback out of order.
     * This shouldn't happen normaly, but we've seen it intermittently on
     * libusb 1.0.19 for Windows. Further investigation required...
     */
     bool out_of_order_event;
+
+    /* The stream's buffer size satisfies the alignment requirement of the
+     * WinUSB RAW_IO pipe policy, which is used while it receives samples */
+    bool raw_io;
 };
 
 static inline struct bladerf_lusb * lusb_backend(struct bladerf *dev)
@@ -252,6 +317,325 @@ static bool device_is_probe_target(backend_probe_target probe_target,
     return is_probe_target;
 }
 
+#if ENABLE_LIBUSB_HOTPLUG_REGISTRY
+/* A bladeRF or FX3 bootloader reported by a hotplug arrival event.
+ *
+ * The serial number is read the first time the device is probed, rather than
+ * from the hotplug callback, in which blocking libusb calls should be
+ * avoided. Afterwards, the device is never opened again by the registry. */
+struct registry_entry {
+    libusb_device *dev;
+    uint8_t bus;
+    uint8_t addr;
+    bool is_bladerf;
+    bool is_bootloader;
+    bool have_serial;
+    char serial[BLADERF_SERIAL_LENGTH];
+};
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_once_t once;
+    bool active;
+
+    libusb_context *context;
+    pthread_t event_thread;
+
+    /* Sorted by bus, then address */
+    struct registry_entry *entries;
+    size_t count;
+    size_t size;
+} registry = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_ONCE_INIT, false,
+    NULL, 0, NULL, 0, 0
+};
+
+static void registry_add(libusb_device *dev)
+{
+    const uint8_t bus = libusb_get_bus_number(dev);
+    const uint8_t addr = libusb_get_device_address(dev);
+    struct registry_entry *entry;
+    size_t i;
+
+    if (registry.count == registry.size) {
+        const size_t new_size = registry.size ? 2 * registry.size : 8;
+        struct registry_entry *tmp;
+
+        tmp = realloc(registry.entries, new_size * sizeof(tmp[0]));
+        if (tmp == NULL) {
+            log_debug("Failed to grow device registry\n");
+            return;
+        }
+
+        registry.entries = tmp;
+        registry.size = new_size;
+    }
+
+    for (i = 0; i < registry.count; i++) {
+        const struct registry_entry *e = &registry.entries[i];
+        if (e->bus > bus || (e->bus == bus && e->addr > addr)) {
+            break;
+        }
+    }
+
+    memmove(&registry.entries[i + 1], &registry.entries[i],
+            (registry.count - i) * sizeof(registry.entries[0]));
+    registry.count++;
+
+    entry = &registry.entries[i];
+    memset(entry, 0, sizeof(entry[0]));
+    entry->dev = libusb_ref_device(dev);
+    entry->bus = bus;
+    entry->addr = addr;
+    entry->is_bladerf = device_is_bladerf(dev);
+    entry->is_bootloader = device_is_fx3_bootloader(dev);
+
+    log_verbose("Registry: device arrived on bus=%u, addr=%u\n", bus, addr);
+}
+
+static void registry_remove(libusb_device *dev)
+{
+    size_t i;
+
+    for (i = 0; i < registry.count; i++) {
+        if (registry.entries[i].dev == dev) {
+            log_verbose("Registry: device left bus=%u, addr=%u\n",
+                        registry.entries[i].bus, registry.entries[i].addr);
+
+            libusb_unref_device(registry.entries[i].dev);
+            memmove(&registry.entries[i], &registry.entries[i + 1],
+                    (registry.count - i - 1) * sizeof(registry.entries[0]));
+            registry.count--;
+            return;
+        }
+    }
+}
+
+static int LIBUSB_CALL registry_hotplug_cb(libusb_context *context,
+                                           libusb_device *dev,
+                                           libusb_hotplug_event event,
+                                           void *user_data)
+{
+    pthread_mutex_lock(&registry.lock);
+
+    if (event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) {
+        if (device_has_vid_pid(dev, USB_NUAND_VENDOR_ID,
+                                    USB_NUAND_BLADERF_PRODUCT_ID) ||
+            device_is_fx3_bootloader(dev)) {
+            registry_add(dev);
+        }
+    } else {
+        registry_remove(dev);
+    }
+
+    pthread_mutex_unlock(&registry.lock);
+
+    /* Keep the callback registered */
+    return 0;
+}
+
+static void *registry_event_thread(void *arg)
+{
+    int status;
+    struct timeval tv = { 1, 0 };
+
+    while (true) {
+        status = libusb_handle_events_timeout_completed(registry.context,
+                                                        &tv, NULL);
+
+        if (status < 0 && status != LIBUSB_ERROR_INTERRUPTED) {
+            log_debug("Registry: unexpected value from events processing: "
+                      "%d: %s\n", status, libusb_error_name(status));
+        }
+    }
+
+    return NULL;
+}
+
+/* The registry is created on the first probe and remains for the lifetime of
+ * the process. If hotplug events are not available, probes fall back to
+ * walking the device list. */
+static void registry_init(void)
+{
+    int status;
+
+    status = libusb_init(&registry.context);
+    if (status != 0) {
+        log_debug("Registry: could not initialize libusb: %s\n",
+                  libusb_error_name(status));
+        return;
+    }
+
+    if (!libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)) {
+        log_debug("Registry: hotplug events are not supported.\n");
+        goto fail;
+    }
+
+    /* Devices already attached are reported from within this call */
+    status = libusb_hotplug_register_callback(registry.context,
+                                              LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED |
+                                              LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT,
+                                              LIBUSB_HOTPLUG_ENUMERATE,
+                                              LIBUSB_HOTPLUG_MATCH_ANY,
+                                              LIBUSB_HOTPLUG_MATCH_ANY,
+                                              LIBUSB_HOTPLUG_MATCH_ANY,
+                                              registry_hotplug_cb, NULL, NULL);
+    if (status != LIBUSB_SUCCESS) {
+        log_debug("Registry: failed to register hotplug callback: %s\n",
+                  libusb_error_name(status));
+        goto fail;
+    }
+
+    status = pthread_create(&registry.event_thread, NULL,
+                            registry_event_thread, NULL);
+    if (status != 0) {
+        log_debug("Registry: failed to start event thread: %s\n",
+                  strerror(status));
+        goto fail;
+    }
+
+    pthread_detach(registry.event_thread);
+
+    pthread_mutex_lock(&registry.lock);
+    registry.active = true;
+    pthread_mutex_unlock(&registry.lock);
+
+    log_verbose("Using hotplug-driven device registry.\n");
+    return;
+
+fail:
+    pthread_mutex_lock(&registry.lock);
+    while (registry.count != 0) {
+        registry_remove(registry.entries[0].dev);
+    }
+    pthread_mutex_unlock(&registry.lock);
+
+    libusb_exit(registry.context);
+    registry.context = NULL;
+}
+
+static inline bool registry_entry_is_target(backend_probe_target target,
+                                            const struct registry_entry *e)
+{
+    switch (target) {
+        case BACKEND_PROBE_BLADERF:
+            return e->is_bladerf;
+
+        case BACKEND_PROBE_FX3_BOOTLOADER:
+            return e->is_bootloader;
+
+        default:
+            assert(!"Invalid probe target");
+            return false;
+    }
+}
+
+/* Fill in the serial number of devices that arrived since the last probe.
+ * The registry lock must be held. */
+static void registry_read_new_serials(void)
+{
+    size_t i;
+    struct bladerf_devinfo info;
+
+    for (i = 0; i < registry.count; i++) {
+        struct registry_entry *e = &registry.entries[i];
+
+        if (!e->have_serial && get_devinfo(e->dev, &info) == 0) {
+            memcpy(e->serial, info.serial, sizeof(e->serial));
+            e->have_serial = true;
+        }
+    }
+}
+
+static void registry_entry_to_devinfo(const struct registry_entry *e,
+                                      int instance,
+                                      struct bladerf_devinfo *info)
+{
+    memset(info, 0, sizeof(info[0]));
+    info->backend = BLADERF_BACKEND_LIBUSB;
+    info->usb_bus = e->bus;
+    info->usb_addr = e->addr;
+    info->instance = instance;
+    memcpy(info->serial, e->serial, sizeof(info->serial));
+}
+
+/* Returns BLADERF_ERR_UNSUPPORTED if the registry is not available */
+static int registry_probe(backend_probe_target probe_target,
+                          struct bladerf_devinfo_list *info_list)
+{
+    int status = 0;
+    size_t i;
+    int n;
+    struct bladerf_devinfo info;
+
+    pthread_once(&registry.once, registry_init);
+    pthread_mutex_lock(&registry.lock);
+
+    if (!registry.active) {
+        pthread_mutex_unlock(&registry.lock);
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    registry_read_new_serials();
+
+    for (i = 0, n = 0; i < registry.count && status == 0; i++) {
+        const struct registry_entry *e = &registry.entries[i];
+
+        if (!registry_entry_is_target(probe_target, e) || !e->have_serial) {
+            continue;
+        }
+
+        registry_entry_to_devinfo(e, n++, &info);
+        status = bladerf_devinfo_list_add(info_list, &info);
+        if (status != 0) {
+            log_error("Could not add device to list: %s\n",
+                      bladerf_strerror(status));
+        }
+    }
+
+    pthread_mutex_unlock(&registry.lock);
+    return status;
+}
+
+/* Look up the registry's information about the specified bladeRF, numbering
+ * instances as registry_probe() does. Returns false if the device is not
+ * known, or the registry is not available. */
+static bool registry_get_devinfo(libusb_device *dev,
+                                 struct bladerf_devinfo *info)
+{
+    const uint8_t bus = libusb_get_bus_number(dev);
+    const uint8_t addr = libusb_get_device_address(dev);
+    bool found = false;
+    size_t i;
+    int n;
+
+    pthread_once(&registry.once, registry_init);
+    pthread_mutex_lock(&registry.lock);
+
+    if (registry.active) {
+        registry_read_new_serials();
+
+        for (i = 0, n = 0; i < registry.count && !found; i++) {
+            const struct registry_entry *e = &registry.entries[i];
+
+            if (!e->is_bladerf || !e->have_serial) {
+                continue;
+            }
+
+            if (e->bus == bus && e->addr == addr) {
+                registry_entry_to_devinfo(e, n, info);
+                found = true;
+            }
+
+            n++;
+        }
+    }
+
+    pthread_mutex_unlock(&registry.lock);
+    return found;
+}
+#endif
+
 static int lusb_probe(backend_probe_target probe_target,
                       struct bladerf_devinfo_list *info_list)
 {
@@ -262,6 +646,13 @@ static int lusb_probe(backend_probe_target probe_target,
 
     libusb_context *context;
 
+#if ENABLE_LIBUSB_HOTPLUG_REGISTRY
+    status = registry_probe(probe_target, info_list);
+    if (status != BLADERF_ERR_UNSUPPORTED) {
+        return status;
+    }
+#endif
+
     /* Initialize libusb for device tree walking */
     status = libusb_init(&context);
     if (status) {
@@ -405,15 +796,24 @@ static int find_and_open_device(libusb_context *context,
         if (device_is_bladerf(list[i])) {
             log_verbose("Found a bladeRF (idx=%d)\n", i);
 
-            /* Open the USB device and get some information */
-            status = get_devinfo(list[i], &curr_info);
-            if (status < 0) {
-                log_debug("Could not open bladeRF device: %s\n",
-                        libusb_error_name(status) );
-                status = BLADERF_ERR_NODEV;
-                continue; /* Continue trying the next devices */
-            } else {
-                curr_info.instance = n++;
+#if ENABLE_LIBUSB_HOTPLUG_REGISTRY
+            /* Avoid opening devices (which may be in use) just to read
+             * their serial numbers, if the registry already knows them */
+            if (registry_get_devinfo(list[i], &curr_info)) {
+                n++;
+            } else
+#endif
+            {
+                /* Open the USB device and get some information */
+                status = get_devinfo(list[i], &curr_info);
+                if (status < 0) {
+                    log_debug("Could not open bladeRF device: %s\n",
+                            libusb_error_name(status) );
+                    status = BLADERF_ERR_NODEV;
+                    continue; /* Continue trying the next devices */
+                } else {
+                    curr_info.instance = n++;
+                }
             }
 
             /* Check to see if this matches the info struct */
@@ -490,6 +890,67 @@ static int reset_and_reopen(libusb_context *context,
 #endif
 
 
+static void *lusb_event_thread(void *arg)
+{
+    int status;
+    struct bladerf_lusb *lusb = (struct bladerf_lusb *) arg;
+    const struct timeval tv_block = { 0, LIBUSB_HANDLE_EVENTS_TIMEOUT_NSEC };
+    const struct timeval tv_poll = { 0, 0 };
+    struct timeval tv;
+
+    while (!ATOMIC_LOAD_ACQUIRE(&lusb->event_thread_stop)) {
+        tv = ATOMIC_LOAD_ACQUIRE(&lusb->busy_poll_streams) ? tv_poll : tv_block;
+
+        status = libusb_handle_events_timeout_completed(lusb->context,
+                                                        &tv, NULL);
+
+        ATOMIC_STORE_RELEASE(&lusb->event_polls, lusb->event_polls + 1);
+
+        if (status < 0 && status != LIBUSB_ERROR_INTERRUPTED) {
+            log_warning("unexpected value from events processing: "
+                        "%d: %s\n", status, libusb_error_name(status));
+        }
+    }
+
+    return NULL;
+}
+
+static int start_event_thread(struct bladerf_lusb *lusb)
+{
+    int status;
+
+    lusb->event_thread_stop = 0;
+
+    status = pthread_create(&lusb->event_thread, NULL,
+                            lusb_event_thread, lusb);
+    if (status != 0) {
+        log_error("Failed to start libusb event thread: %s\n",
+                  strerror(status));
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    lusb->event_thread_running = true;
+    return 0;
+}
+
+static void stop_event_thread(struct bladerf_lusb *lusb)
+{
+    if (!lusb->event_thread_running) {
+        return;
+    }
+
+    ATOMIC_STORE_RELEASE(&lusb->event_thread_stop, 1);
+
+    /* Otherwise, the thread notices our request once the current call to
+     * libusb_handle_events_timeout_completed() times out */
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+    libusb_interrupt_event_handler(lusb->context);
+#endif
+
+    pthread_join(lusb->event_thread, NULL);
+    lusb->event_thread_running = false;
+}
+
 static int lusb_open(void **driver,
                      struct bladerf_devinfo *info_in,
                      struct bladerf_devinfo *info_out)
@@ -540,6 +1001,17 @@ static int lusb_open(void **driver,
         }
 #       endif
 
+        if (status == 0) {
+            status = start_event_thread(lusb);
+
+            if (status != 0) {
+                libusb_release_interface(lusb->handle, 0);
+                libusb_close(lusb->handle);
+                libusb_exit(context);
+                free(lusb);
+            }
+        }
+
         if (status == 0) {
             *driver = (void *) lusb;
         }
@@ -563,6 +1035,8 @@ static void lusb_close(void *driver)
     int status;
     struct bladerf_lusb *lusb = (struct bladerf_lusb *) driver;
 
+    stop_event_thread(lusb);
+
     status = libusb_release_interface(lusb->handle, 0);
     if (status < 0) {
         log_error("Failed to release interface: %s\n",
@@ -855,45 +1329,114 @@ static inline void cancel_all_transfers(struct bladerf_stream *stream)
     }
 }
 
-static inline size_t transfer_idx(struct lusb_stream_data *stream_data,
-                                  struct libusb_transfer *transfer)
+static int queue_buffer(struct bladerf_stream *stream, void *buffer);
+static int submit_deferred_buffers(struct bladerf_stream *stream);
+static int flush_queued_buffers(struct bladerf_stream *stream);
+
+/* Return a transfer to the pool of those available for submission */
+static inline void release_transfer(struct bladerf_stream *stream,
+                                    size_t transfer_i)
 {
-    size_t i;
-    for (i = 0; i < stream_data->num_transfers; i++) {
-        if (stream_data->transfers[i] == transfer) {
-            return i;
+    struct lusb_stream_data *stream_data = stream->backend_data;
+
+    stream_data->transfer_status[transfer_i] = TRANSFER_AVAIL;
+    stream_data->num_avail++;
+    pthread_cond_signal(&stream->can_submit_buffer);
+}
+
+/* Act upon a buffer returned by a stream callback. The stream lock must be
+ * held. */
+static void handle_next_buffer(struct bladerf_stream *stream,
+                               void *next_buffer)
+{
+    if (next_buffer == BLADERF_STREAM_SHUTDOWN) {
+        stream->state = STREAM_SHUTTING_DOWN;
+    } else if (next_buffer != BLADERF_STREAM_NO_DATA &&
+               stream->state == STREAM_RUNNING) {
+        int status = queue_buffer(stream, next_buffer);
+        if (status != 0) {
+            /* If this fails, we probably have a serious problem...so
+             * just shut it down. */
+            stream->state = STREAM_SHUTTING_DOWN;
         }
     }
-
-    return UINT_MAX;
 }
 
-static int submit_transfer(struct bladerf_stream *stream, void *buffer);
+/* Add the buffers of a completed transfer to the stream's batch, delivering
+ * it to the batch callback when it is full, or when no other buffers remain
+ * in flight to complete it. The stream lock must be held. */
+static void batch_transfer_buffers(struct bladerf_stream *stream,
+                                   struct libusb_transfer *transfer,
+                                   unsigned int nbufs)
+{
+    struct lusb_stream_data *stream_data = stream->backend_data;
+    const size_t bytes_per_buffer = async_stream_buf_bytes(stream);
+    size_t remaining = transfer->actual_length;
+    unsigned int n, i, count;
+
+    for (n = 0; n < nbufs && stream->state == STREAM_RUNNING; n++) {
+        const size_t buf_bytes = remaining < bytes_per_buffer ?
+                                    remaining : bytes_per_buffer;
+        bool deliver;
+
+        remaining -= buf_bytes;
+
+        deliver = async_batch_add(stream,
+                                  transfer->buffer + n * bytes_per_buffer,
+                                  bytes_to_samples(stream->format, buf_bytes));
+
+        if (!deliver && n == nbufs - 1) {
+            deliver = stream_data->bufs_in_flight == 0 &&
+                      stream_data->gather_count == 0 &&
+                      stream_data->deferred_count == 0;
+        }
+
+        if (deliver) {
+            count = async_batch_deliver(stream);
+            for (i = 0; i < count; i++) {
+                handle_next_buffer(stream, stream->batch_next[i]);
+            }
+        }
+    }
+}
 
 static void LIBUSB_CALL lusb_stream_cb(struct libusb_transfer *transfer)
 {
-    struct bladerf_stream *stream = transfer->user_data;
+    const struct lusb_transfer_ctx *ctx = transfer->user_data;
+    struct bladerf_stream *stream = ctx->stream;
     void *next_buffer = NULL;
     struct bladerf_metadata metadata;
     struct lusb_stream_data *stream_data = stream->backend_data;
-    size_t transfer_i;
+    const size_t transfer_i = ctx->idx;
+    unsigned int nbufs;
+    bool released = false;
+    uint64_t now_us;
+    uint64_t cb_done_us;
 
-    /* Currently unused - zero out for out own debugging sanity... */
-    memset(&metadata, 0, sizeof(metadata));
+    PROBE4(xfer_complete, stream->module, transfer_i, transfer->status,
+           transfer->actual_length);
 
     MUTEX_LOCK(&stream->lock);
 
-    transfer_i = transfer_idx(stream_data, transfer);
+    now_us = async_stats_time_us();
+
+    assert(transfer_i < stream_data->num_transfers &&
+           stream_data->transfers[transfer_i] == transfer);
     assert(stream_data->transfer_status[transfer_i] == TRANSFER_IN_FLIGHT ||
            stream_data->transfer_status[transfer_i] == TRANSFER_CANCEL_PENDING);
 
-    if (transfer_i >= stream_data->num_transfers) {
-        log_error("Unable to find transfer");
-        stream->state = STREAM_SHUTTING_DOWN;
-    } else {
-        stream_data->transfer_status[transfer_i] = TRANSFER_AVAIL;
-        stream_data->num_avail++;
-        pthread_cond_signal(&stream->can_submit_buffer);
+    /* Reserve this transfer for the buffers returned by the callback, so
+     * that it cannot be claimed by a bladerf_submit_stream_buffer() caller
+     * while we execute the callback without holding the lock. */
+    stream_data->transfer_status[transfer_i] = TRANSFER_IN_CALLBACK;
+    nbufs = stream_data->transfer_nbufs[transfer_i];
+    stream_data->bufs_in_flight -= nbufs;
+
+    if (transfer->status == LIBUSB_TRANSFER_COMPLETED) {
+        stream->stats.transfers++;
+        async_stats_hist_add(stream->stats.turnaround_hist,
+                             stream_data->submit_time_us[transfer_i],
+                             now_us);
     }
 
     /* Check to see if the transfer has been cancelled or errored */
@@ -941,33 +1484,91 @@ static void LIBUSB_CALL lusb_stream_cb(struct libusb_transfer *transfer)
     }
 
     if (stream->state == STREAM_RUNNING) {
+        const size_t bytes_per_buffer = async_stream_buf_bytes(stream);
+        size_t remaining = transfer->actual_length;
+        unsigned int n;
 
         /* Sanity check for debugging purposes */
         if (transfer->length != transfer->actual_length) {
             log_warning( "Received short transfer\n" );
+            stream->stats.short_transfers++;
         }
 
-       /* Call user callback requesting more data to transmit */
-        next_buffer = stream->cb(
-                        stream->dev,
-                        stream,
-                        &metadata,
-                        transfer->buffer,
-                        bytes_to_sc16q11(transfer->actual_length),
-                        stream->user_data);
+        /* The batch holds the buffers themselves, so the transfer may carry
+         * those returned by the batch callback */
+        if (async_batch_enabled(stream)) {
+            release_transfer(stream, transfer_i);
+            released = true;
+            batch_transfer_buffers(stream, transfer, nbufs);
+        }
 
-        if (next_buffer == BLADERF_STREAM_SHUTDOWN) {
-            stream->state = STREAM_SHUTTING_DOWN;
-        } else if (next_buffer != BLADERF_STREAM_NO_DATA) {
-            int status = submit_transfer(stream, next_buffer);
-            if (status != 0) {
-                /* If this fails, we probably have a serious problem...so just
-                 * shut it down. */
-                stream->state = STREAM_SHUTTING_DOWN;
+        /* Deliver a callback for each of the buffers this transfer covered */
+        for (n = 0; n < nbufs && stream->state == STREAM_RUNNING &&
+                    !async_batch_enabled(stream); n++) {
+            const size_t buf_bytes = remaining < bytes_per_buffer ?
+                                        remaining : bytes_per_buffer;
+
+            remaining -= buf_bytes;
+
+            /* Only the transfer table and stream state are protected by the
+             * lock. Callbacks are serialized by the libusb event thread, so
+             * releasing the lock here does not allow concurrent callbacks. */
+#           if !ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+            MUTEX_UNLOCK(&stream->lock);
+#           endif
+
+            async_rx_metadata(stream, transfer->buffer + n * bytes_per_buffer,
+                              bytes_to_samples(stream->format, buf_bytes),
+                              &metadata);
+
+           /* Call user callback requesting more data to transmit */
+            next_buffer = stream->cb(
+                            stream->dev,
+                            stream,
+                            &metadata,
+                            transfer->buffer + n * bytes_per_buffer,
+                            bytes_to_samples(stream->format, buf_bytes),
+                            stream->user_data);
+
+            cb_done_us = async_stats_time_us();
+
+#           if !ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+            MUTEX_LOCK(&stream->lock);
+#           endif
+
+            async_stats_hist_add(stream->stats.callback_hist,
+                                 now_us, cb_done_us);
+            now_us = cb_done_us;
+
+            /* Once the last buffer has been handed back to the callback, the
+             * transfer is no longer needed and may carry the next buffers */
+            if (n == nbufs - 1) {
+                release_transfer(stream, transfer_i);
+                released = true;
             }
+
+            handle_next_buffer(stream, next_buffer);
+        }
+
+        /* Submit buffers that the transfer limit now permits, and don't
+         * hold onto a partially gathered transfer */
+        if (stream->state == STREAM_RUNNING &&
+            (submit_deferred_buffers(stream) != 0 ||
+             flush_queued_buffers(stream) != 0)) {
+            stream->state = STREAM_SHUTTING_DOWN;
         }
     }
 
+    if (!released) {
+        release_transfer(stream, transfer_i);
+    }
+
+    /* Buffers that were gathered but will never be submitted */
+    if (stream->state != STREAM_RUNNING) {
+        stream_data->gather_count = 0;
+        stream_data->deferred_count = 0;
+    }
+
 
     /* Check to see if all the transfers have been cancelled,
      * and if so, clean up the stream */
@@ -977,6 +1578,7 @@ static void LIBUSB_CALL lusb_stream_cb(struct libusb_transfer *transfer)
          * "available" states */
         if (stream_data->num_avail == stream_data->num_transfers) {
             stream->state = STREAM_DONE;
+            pthread_cond_signal(&stream_data->stream_done);
         } else {
             cancel_all_transfers(stream);
         }
@@ -1012,8 +1614,10 @@ get_next_available_transfer(struct lusb_stream_data *stream_data)
     return NULL;
 }
 
-/* Precondition: A transfer is available. */
-static int submit_transfer(struct bladerf_stream *stream, void *buffer)
+/* Submit a transfer covering `nbufs` buffers, which are contiguous in memory,
+ * starting at `buffer`. */
+static int submit_transfer(struct bladerf_stream *stream, void *buffer,
+                           unsigned int nbufs)
 {
     int status;
     struct bladerf_lusb *lusb = lusb_backend(stream->dev);
@@ -1025,20 +1629,26 @@ static int submit_transfer(struct bladerf_stream *stream, void *buffer)
         stream->module == BLADERF_MODULE_TX ? SAMPLE_EP_OUT : SAMPLE_EP_IN;
 
     transfer = get_next_available_transfer(stream_data);
-    assert(transfer != NULL);
+    if (transfer == NULL) {
+        log_error("%s: No transfers available.\n", __FUNCTION__);
+        return BLADERF_ERR_UNEXPECTED;
+    }
 
-    assert(bytes_per_buffer <= INT_MAX);
+    assert(bytes_per_buffer * nbufs <= INT_MAX);
     libusb_fill_bulk_transfer(transfer,
                               lusb->handle,
                               ep,
                               buffer,
-                              (int)bytes_per_buffer,
+                              (int)(bytes_per_buffer * nbufs),
                               lusb_stream_cb,
-                              stream,
+                              &stream_data->transfer_ctx[stream_data->i],
                               stream->dev->transfer_timeout[stream->module]);
 
     prev_idx = stream_data->i;
     stream_data->transfer_status[stream_data->i] = TRANSFER_IN_FLIGHT;
+    stream_data->transfer_nbufs[stream_data->i] = nbufs;
+    stream_data->bufs_in_flight += nbufs;
+    stream_data->submit_time_us[stream_data->i] = async_stats_time_us();
     stream_data->i = (stream_data->i + 1) % stream_data->num_transfers;
     assert(stream_data->num_avail != 0);
     stream_data->num_avail--;
@@ -1055,6 +1665,7 @@ static int submit_transfer(struct bladerf_stream *stream, void *buffer)
      *       lock schemes.
      */
     MUTEX_UNLOCK(&stream->lock);
+    PROBE3(xfer_submit, stream->module, prev_idx, transfer->length);
     status = libusb_submit_transfer(transfer);
     MUTEX_LOCK(&stream->lock);
 
@@ -1067,6 +1678,7 @@ static int submit_transfer(struct bladerf_stream *stream, void *buffer)
         assert(stream_data->transfer_status[prev_idx] == TRANSFER_IN_FLIGHT);
         stream_data->transfer_status[prev_idx] = TRANSFER_AVAIL;
         stream_data->num_avail++;
+        stream_data->bufs_in_flight -= nbufs;
         if (stream_data->i == 0) {
             stream_data->i = stream_data->num_transfers - 1;
         } else {
@@ -1077,6 +1689,185 @@ static int submit_transfer(struct bladerf_stream *stream, void *buffer)
     return error_conv(status);
 }
 
+/* Submit any buffers queued via queue_buffer() as a single transfer */
+static int flush_queued_buffers(struct bladerf_stream *stream)
+{
+    struct lusb_stream_data *stream_data = stream->backend_data;
+    const unsigned int count = stream_data->gather_count;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    stream_data->gather_count = 0;
+    return submit_transfer(stream, stream_data->gather_buf, count);
+}
+
+/* Combine a buffer into a single transfer with previously gathered buffers
+ * that immediately precede it in memory. The transfer is submitted once it
+ * covers the maximum number of buffers. */
+static int gather_buffer(struct bladerf_stream *stream, void *buffer)
+{
+    int status = 0;
+    struct lusb_stream_data *stream_data = stream->backend_data;
+    const size_t bytes_per_buffer = async_stream_buf_bytes(stream);
+
+    if (stream_data->gather_count != 0 &&
+        (uint8_t *) buffer != stream_data->gather_buf +
+                              stream_data->gather_count * bytes_per_buffer) {
+        status = flush_queued_buffers(stream);
+    }
+
+    if (status == 0) {
+        if (stream_data->gather_count == 0) {
+            stream_data->gather_buf = (uint8_t *) buffer;
+        }
+
+        stream_data->gather_count++;
+
+        if (stream_data->gather_count >= stream_data->bufs_per_xfer) {
+            status = flush_queued_buffers(stream);
+        }
+    }
+
+    return status;
+}
+
+/* Does stream->transfer_limit allow another buffer to be put in flight? */
+static inline bool below_transfer_limit(struct bladerf_stream *stream)
+{
+    struct lusb_stream_data *stream_data = stream->backend_data;
+    const unsigned int limit = ATOMIC_LOAD_ACQUIRE(&stream->transfer_limit);
+
+    return limit == 0 ||
+           stream_data->bufs_in_flight + stream_data->gather_count < limit;
+}
+
+/* Queue a buffer for submission. If the stream's transfer limit has been
+ * reached, the buffer is deferred until earlier transfers complete. */
+static int queue_buffer(struct bladerf_stream *stream, void *buffer)
+{
+    struct lusb_stream_data *stream_data = stream->backend_data;
+
+    if (stream_data->deferred_count == 0 && below_transfer_limit(stream)) {
+        return gather_buffer(stream, buffer);
+    }
+
+    if (stream_data->deferred_count >= stream_data->num_transfers) {
+        log_error("%s: Deferred buffer queue is full.\n", __FUNCTION__);
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    stream_data->deferred[(stream_data->deferred_head +
+                           stream_data->deferred_count) %
+                          stream_data->num_transfers] = buffer;
+    stream_data->deferred_count++;
+
+    return 0;
+}
+
+/* Submit deferred buffers, in order, while the transfer limit permits */
+static int submit_deferred_buffers(struct bladerf_stream *stream)
+{
+    int status = 0;
+    struct lusb_stream_data *stream_data = stream->backend_data;
+
+    while (status == 0 && stream_data->deferred_count != 0 &&
+           below_transfer_limit(stream)) {
+
+        void *buffer = stream_data->deferred[stream_data->deferred_head];
+
+        stream_data->deferred_head =
+            (stream_data->deferred_head + 1) % stream_data->num_transfers;
+        stream_data->deferred_count--;
+
+        status = gather_buffer(stream, buffer);
+    }
+
+    return status;
+}
+
+
+#if BLADERF_OS_WINDOWS && defined(HAVE_LIBUSB_RAW_IO)
+/* When libusb accesses the device via WinUSB, reads on a pipe are serialized
+ * under the default pipe policy, so that only one of the stream's transfers
+ * is outstanding at a time. With the RAW_IO policy, reads are passed directly
+ * to the host controller, but each must be a multiple of the endpoint's max
+ * packet size, and no larger than the pipe's max transfer size. */
+static bool raw_io_aligned(struct bladerf_lusb *lusb,
+                           struct bladerf_stream *stream)
+{
+    int max_packet;
+
+    if (libusb_endpoint_supports_raw_io(lusb->handle, SAMPLE_EP_IN) != 1) {
+        return false;
+    }
+
+    max_packet = libusb_get_max_packet_size(libusb_get_device(lusb->handle),
+                                            SAMPLE_EP_IN);
+
+    if (max_packet <= 0 || async_stream_buf_bytes(stream) % max_packet != 0) {
+        log_debug("Stream buffers of %zu bytes are not compatible with "
+                  "RAW_IO (max packet size = %d).\n",
+                  async_stream_buf_bytes(stream), max_packet);
+        return false;
+    }
+
+    return true;
+}
+
+/* Returns the number of buffers that may be combined into a transfer, which
+ * is 0 if RAW_IO could not be enabled */
+static unsigned int enable_raw_io(struct bladerf_lusb *lusb,
+                                  struct bladerf_stream *stream)
+{
+    int status;
+    int max_size;
+
+    status = libusb_endpoint_set_raw_io(lusb->handle, SAMPLE_EP_IN, 1);
+    if (status < 0) {
+        log_info("Failed to enable RAW_IO pipe policy: %s\n",
+                 libusb_error_name(status));
+        return 0;
+    }
+
+    max_size = libusb_get_max_raw_io_transfer_size(lusb->handle,
+                                                   SAMPLE_EP_IN);
+
+    if (max_size < 0 || (size_t) max_size < async_stream_buf_bytes(stream)) {
+        log_info("RAW_IO max transfer size (%d) is smaller than the stream's "
+                 "buffers.\n", max_size);
+        libusb_endpoint_set_raw_io(lusb->handle, SAMPLE_EP_IN, 0);
+        return 0;
+    }
+
+    log_verbose("Enabled RAW_IO pipe policy (max transfer size = %d).\n",
+                max_size);
+
+    return (unsigned int) (max_size / async_stream_buf_bytes(stream));
+}
+
+static void disable_raw_io(struct bladerf_lusb *lusb)
+{
+    libusb_endpoint_set_raw_io(lusb->handle, SAMPLE_EP_IN, 0);
+}
+#else
+static bool raw_io_aligned(struct bladerf_lusb *lusb,
+                           struct bladerf_stream *stream)
+{
+    return false;
+}
+
+static unsigned int enable_raw_io(struct bladerf_lusb *lusb,
+                                  struct bladerf_stream *stream)
+{
+    return 0;
+}
+
+static void disable_raw_io(struct bladerf_lusb *lusb)
+{
+}
+#endif
 
 static int lusb_init_stream(void *driver, struct bladerf_stream *stream,
                             size_t num_transfers)
@@ -1093,12 +1884,30 @@ static int lusb_init_stream(void *driver, struct bladerf_stream *stream,
 
     /* Backend stream information */
     stream->backend_data = stream_data;
+    stream->batch_capable = true;
     stream_data->transfers = NULL;
+    stream_data->transfer_ctx = NULL;
     stream_data->transfer_status = NULL;
+    stream_data->submit_time_us = NULL;
+    stream_data->transfer_nbufs = NULL;
+    stream_data->deferred = NULL;
+    stream_data->deferred_head = 0;
+    stream_data->deferred_count = 0;
+    stream_data->bufs_in_flight = 0;
+    stream_data->gather_buf = NULL;
+    stream_data->gather_count = 0;
+    stream_data->bufs_per_xfer = 1;
     stream_data->num_transfers = num_transfers;
     stream_data->num_avail = 0;
     stream_data->i = 0;
     stream_data->out_of_order_event = false;
+    stream_data->raw_io = raw_io_aligned(driver, stream);
+
+    if (pthread_cond_init(&stream_data->stream_done, NULL) != 0) {
+        free(stream_data);
+        stream->backend_data = NULL;
+        return BLADERF_ERR_UNEXPECTED;
+    }
 
     stream_data->transfers =
         malloc(num_transfers * sizeof(struct libusb_transfer *));
@@ -1109,6 +1918,20 @@ static int lusb_init_stream(void *driver, struct bladerf_stream *stream,
         goto error;
     }
 
+    stream_data->transfer_ctx =
+        calloc(num_transfers, sizeof(stream_data->transfer_ctx[0]));
+
+    if (stream_data->transfer_ctx == NULL) {
+        log_error("Failed to allocate libusb transfer contexts\n");
+        status = BLADERF_ERR_MEM;
+        goto error;
+    }
+
+    for (i = 0; i < num_transfers; i++) {
+        stream_data->transfer_ctx[i].stream = stream;
+        stream_data->transfer_ctx[i].idx = i;
+    }
+
     stream_data->transfer_status =
         calloc(num_transfers, sizeof(transfer_status));
 
@@ -1118,6 +1941,33 @@ static int lusb_init_stream(void *driver, struct bladerf_stream *stream,
         goto error;
     }
 
+    stream_data->submit_time_us =
+        calloc(num_transfers, sizeof(stream_data->submit_time_us[0]));
+
+    if (stream_data->submit_time_us == NULL) {
+        log_error("Failed to allocate libusb transfer time array\n");
+        status = BLADERF_ERR_MEM;
+        goto error;
+    }
+
+    stream_data->transfer_nbufs =
+        calloc(num_transfers, sizeof(stream_data->transfer_nbufs[0]));
+
+    if (stream_data->transfer_nbufs == NULL) {
+        log_error("Failed to allocate libusb transfer buffer count array\n");
+        status = BLADERF_ERR_MEM;
+        goto error;
+    }
+
+    stream_data->deferred =
+        calloc(num_transfers, sizeof(stream_data->deferred[0]));
+
+    if (stream_data->deferred == NULL) {
+        log_error("Failed to allocate libusb deferred buffer queue\n");
+        status = BLADERF_ERR_MEM;
+        goto error;
+    }
+
     /* Create the libusb transfers */
     for (i = 0; i < stream_data->num_transfers; i++) {
         stream_data->transfers[i] = libusb_alloc_transfer(0);
@@ -1147,7 +1997,12 @@ static int lusb_init_stream(void *driver, struct bladerf_stream *stream,
 
 error:
     if (status != 0) {
+        pthread_cond_destroy(&stream_data->stream_done);
+        free(stream_data->deferred);
+        free(stream_data->transfer_nbufs);
+        free(stream_data->submit_time_us);
         free(stream_data->transfer_status);
+        free(stream_data->transfer_ctx);
         free(stream_data->transfers);
         free(stream_data);
         stream->backend_data = NULL;
@@ -1156,6 +2011,40 @@ error:
     return status;
 }
 
+/* Stream callbacks execute on the event thread, so apply the stream's
+ * scheduling options there. These are left in place after the stream ends,
+ * as the thread is shared by all of the device's streams. */
+static void apply_event_thread_config(struct bladerf_lusb *lusb,
+                                      struct bladerf_stream *stream,
+                                      bladerf_module module)
+{
+    int status;
+    const struct bladerf_stream_thread_config *config =
+        &stream->thread_config[module];
+    const uint64_t cpus = async_thread_cpus(stream, module);
+
+    if (config->policy != BLADERF_SCHED_DEFAULT) {
+        const thread_sched_policy policy =
+            (config->policy == BLADERF_SCHED_FIFO) ?
+                THREAD_SCHED_FIFO : THREAD_SCHED_RR;
+
+        status = thread_set_sched(lusb->event_thread, policy,
+                                  config->priority);
+        if (status != 0) {
+            log_warning("Failed to set libusb event thread priority: %s\n",
+                        strerror(status));
+        }
+    }
+
+    if (cpus != 0) {
+        status = thread_set_affinity(lusb->event_thread, cpus);
+        if (status != 0) {
+            log_warning("Failed to set libusb event thread CPU affinity: "
+                        "%s\n", strerror(status));
+        }
+    }
+}
+
 static int lusb_stream(void *driver, struct bladerf_stream *stream,
                        bladerf_module module)
 {
@@ -1166,14 +2055,49 @@ static int lusb_stream(void *driver, struct bladerf_stream *stream,
     struct bladerf *dev = stream->dev;
     struct bladerf_lusb *lusb = (struct bladerf_lusb *) driver;
     struct lusb_stream_data *stream_data = stream->backend_data;
-    struct timeval tv = { 0, LIBUSB_HANDLE_EVENTS_TIMEOUT_NSEC };
+    const bool busy_poll = stream->thread_config[module].busy_poll;
+    unsigned int raw_io_bufs = 0;
 
-    /* Currently unused, so zero it out for a sanity check when debugging */
+    /* TX callbacks are given zeroed metadata */
     memset(&metadata, 0, sizeof(metadata));
 
+    apply_event_thread_config(lusb, stream, module);
+
+    if (module == BLADERF_MODULE_RX && stream_data->raw_io) {
+        raw_io_bufs = enable_raw_io(lusb, stream);
+    }
+
+    if (busy_poll) {
+        ATOMIC_INC_U32(&lusb->busy_poll_streams);
+
+        /* Don't wait out the event thread's current timeout */
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+        libusb_interrupt_event_handler(lusb->context);
+#endif
+    }
+
     MUTEX_LOCK(&stream->lock);
 
-    /* Set up initial set of buffers */
+    stream_data->gather_count = 0;
+    stream_data->deferred_head = 0;
+    stream_data->deferred_count = 0;
+    stream_data->bufs_per_xfer = stream->bufs_per_transfer[module];
+
+    if (stream_data->bufs_per_xfer == 0) {
+        stream_data->bufs_per_xfer = 1;
+    } else if (stream_data->bufs_per_xfer >
+               INT_MAX / async_stream_buf_bytes(stream)) {
+        stream_data->bufs_per_xfer =
+            (unsigned int) (INT_MAX / async_stream_buf_bytes(stream));
+    }
+
+    if (raw_io_bufs != 0 && stream_data->bufs_per_xfer > raw_io_bufs) {
+        stream_data->bufs_per_xfer = raw_io_bufs;
+    }
+
+    /* Set up initial set of buffers. Note that when multiple buffers are
+     * combined into a transfer, fewer than num_transfers transfers will be
+     * in flight, but the number of buffers in flight remains the same. */
     for (i = 0; i < stream_data->num_transfers; i++) {
         if (module == BLADERF_MODULE_TX) {
             buffer = stream->cb(dev,
@@ -1203,7 +2127,7 @@ static int lusb_stream(void *driver, struct bladerf_stream *stream,
         }
 
         if (buffer != BLADERF_STREAM_NO_DATA) {
-            status = submit_transfer(stream, buffer);
+            status = queue_buffer(stream, buffer);
 
             /* If we failed to submit any transfers, cancel everything in
              * flight.  We'll leave the stream in the running state so we can
@@ -1214,17 +2138,32 @@ static int lusb_stream(void *driver, struct bladerf_stream *stream,
             }
         }
     }
-    MUTEX_UNLOCK(&stream->lock);
 
-    /* This loop is required so libusb can do callbacks and whatnot */
+    if (status == 0 && stream->state == STREAM_RUNNING) {
+        status = flush_queued_buffers(stream);
+        if (status < 0) {
+            stream->error_code = status;
+            cancel_all_transfers(stream);
+        }
+    } else {
+        stream_data->gather_count = 0;
+        stream_data->deferred_count = 0;
+    }
+
+    /* The device's event thread executes our callbacks. We need only wait
+     * for them to bring the stream to completion. */
     while (stream->state != STREAM_DONE) {
-        status = libusb_handle_events_timeout(lusb->context, &tv);
+        pthread_cond_wait(&stream_data->stream_done, &stream->lock);
+    }
 
-        if (status < 0 && status != LIBUSB_ERROR_INTERRUPTED) {
-            log_warning("unexpected value from events processing: "
-                        "%d: %s\n", status, libusb_error_name(status));
-            status = error_conv(status);
-        }
+    MUTEX_UNLOCK(&stream->lock);
+
+    if (raw_io_bufs != 0) {
+        disable_raw_io(lusb);
+    }
+
+    if (busy_poll) {
+        ATOMIC_DEC_U32(&lusb->busy_poll_streams);
     }
 
     return status;
@@ -1240,6 +2179,7 @@ int lusb_submit_stream_buffer(void *driver, struct bladerf_stream *stream,
     if (buffer == BLADERF_STREAM_SHUTDOWN) {
         if (stream_data->num_avail == stream_data->num_transfers) {
             stream->state = STREAM_DONE;
+            pthread_cond_signal(&stream_data->stream_done);
         } else {
             stream->state = STREAM_SHUTTING_DOWN;
         }
@@ -1253,13 +2193,15 @@ int lusb_submit_stream_buffer(void *driver, struct bladerf_stream *stream,
             return BLADERF_ERR_UNEXPECTED;
         }
 
-        while (stream_data->num_avail == 0 && status == 0) {
+        while ((stream_data->num_avail == 0 || !below_transfer_limit(stream))
+               && status == 0) {
             status = pthread_cond_timedwait(&stream->can_submit_buffer,
                     &stream->lock,
                     &timeout_abs);
         }
     } else {
-        while (stream_data->num_avail == 0 && status == 0) {
+        while ((stream_data->num_avail == 0 || !below_transfer_limit(stream))
+               && status == 0) {
             status = pthread_cond_wait(&stream->can_submit_buffer,
                                        &stream->lock);
         }
@@ -1272,7 +2214,7 @@ int lusb_submit_stream_buffer(void *driver, struct bladerf_stream *stream,
     } else if (status != 0) {
         return BLADERF_ERR_UNEXPECTED;
     } else {
-        return submit_transfer(stream, buffer);
+        return submit_transfer(stream, buffer, 1);
     }
 }
 
@@ -1288,13 +2230,67 @@ static int lusb_deinit_stream(void *driver, struct bladerf_stream *stream)
     }
 
     free(stream_data->transfers);
+    free(stream_data->transfer_ctx);
     free(stream_data->transfer_status);
+    free(stream_data->submit_time_us);
+    free(stream_data->transfer_nbufs);
+    free(stream_data->deferred);
+    pthread_cond_destroy(&stream_data->stream_done);
     free(stream->backend_data);
 
     stream->backend_data = NULL;
     return 0;
 }
 
+/* libusb_dev_mem_alloc() was introduced in libusb 1.0.21 */
+#if defined(LIBUSB_API_VERSION) && (LIBUSB_API_VERSION >= 0x01000105)
+static void *lusb_alloc_dev_mem(void *driver, size_t len)
+{
+    struct bladerf_lusb *lusb = (struct bladerf_lusb *) driver;
+    unsigned char *mem = libusb_dev_mem_alloc(lusb->handle, len);
+
+    if (mem == NULL) {
+        log_debug("libusb_dev_mem_alloc() failed for %zu bytes\n", len);
+    } else {
+        memset(mem, 0, len);
+    }
+
+    return mem;
+}
+
+static void lusb_free_dev_mem(void *driver, void *mem, size_t len)
+{
+    struct bladerf_lusb *lusb = (struct bladerf_lusb *) driver;
+    libusb_dev_mem_free(lusb->handle, (unsigned char *) mem, len);
+}
+#else
+#   define lusb_alloc_dev_mem NULL
+#   define lusb_free_dev_mem NULL
+#endif
+
+static int lusb_get_event_stats(void *driver, uint64_t *polls,
+                                uint64_t *cpu_us)
+{
+    struct bladerf_lusb *lusb = (struct bladerf_lusb *) driver;
+
+    *polls = ATOMIC_LOAD_ACQUIRE(&lusb->event_polls);
+    *cpu_us = 0;
+
+#if defined(_POSIX_THREAD_CPUTIME) && (_POSIX_THREAD_CPUTIME >= 0)
+    if (lusb->event_thread_running) {
+        clockid_t clock;
+        struct timespec t;
+
+        if (pthread_getcpuclockid(lusb->event_thread, &clock) == 0 &&
+            clock_gettime(clock, &t) == 0) {
+            *cpu_us = (uint64_t) t.tv_sec * 1000000 + t.tv_nsec / 1000;
+        }
+    }
+#endif
+
+    return 0;
+}
+
 static const struct usb_fns libusb_fns = {
     FIELD_INIT(.probe, lusb_probe),
     FIELD_INIT(.open, lusb_open),
@@ -1310,6 +2306,9 @@ static const struct usb_fns libusb_fns = {
     FIELD_INIT(.deinit_stream, lusb_deinit_stream),
     FIELD_INIT(.open_bootloader, lusb_open_bootloader),
     FIELD_INIT(.close_bootloader, lusb_close_bootloader),
+    FIELD_INIT(.alloc_dev_mem, lusb_alloc_dev_mem),
+    FIELD_INIT(.free_dev_mem, lusb_free_dev_mem),
+    FIELD_INIT(.get_event_stats, lusb_get_event_stats),
 };
 
 const struct usb_driver usb_driver_libusb = {
@@ -0,0 +1,944 @@
+/*
+ * Linux kernel driver backend
+ *
+ * This backend uses the bladeRF kernel driver in host/drivers/linux. Device
+ * control is passed through to the driver, which manages the sample URBs
+ * itself. Streams exchange samples with the driver's sample rings, which are
+ * mapped into the stream's address space, so neither a libusb event thread
+ * nor a read()/write() call per buffer is required.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2014 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include "bladeRF.h"    /* Firmware and kernel driver interface */
+
+#include "backend/backend.h"
+#include "backend/usb/usb.h"
+#include "backend/usb/usb_linux_common.h"
+#include "async.h"
+#include "log.h"
+
+#ifndef ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+#   define ENABLE_LIBBLADERF_STREAM_CB_LOCKED 0
+#endif
+
+#ifndef LINUX_DEV_PATH
+#   define LINUX_DEV_PATH "/dev"
+#endif
+
+/* The driver's device nodes are listed under this directory of the device's
+ * first interface */
+#define LINUX_SYSFS_CLASS_DIR   "1.0/usbmisc"
+#define LINUX_DEV_NODE_PREFIX   "bladerf"
+
+struct bladerf_linux {
+    int fd;                 /* Kernel driver device node */
+};
+
+struct linux_stream_data {
+    size_t num_transfers;       /* # of buffers initially submitted */
+
+    /* FIFO of buffers awaiting samples (RX) or awaiting transmission (TX),
+     * and the time at which each was queued */
+    void **queue;
+    uint64_t *queued_us;
+    size_t queue_len;
+    size_t head;
+    size_t count;
+    size_t offset;              /* Bytes of the oldest buffer processed */
+
+    int wake_fd;                /* eventfd signaled when a buffer is
+                                 * submitted or a shutdown is requested */
+
+    /* This stream's mmap()'d ring */
+    uint8_t *ring;
+    size_t ring_len;
+    unsigned int num_bufs;
+    unsigned int buf_size;
+};
+
+/* A bladeRF bound to the kernel driver, gathered from sysfs */
+struct linux_dev_entry {
+    struct linux_usb_dev_entry usb;
+    char node[sizeof(LINUX_DEV_PATH) + 256];    /* Driver's device node */
+};
+
+/* Find the device node the driver has created for a device, if any */
+static bool find_dev_node(const char *sysfs_name, char *node, size_t node_len)
+{
+    char path[256];
+    DIR *dir;
+    struct dirent *ent;
+    bool found = false;
+
+    snprintf(path, sizeof(path), "%s/%s:%s",
+             LINUX_SYSFS_PATH, sysfs_name, LINUX_SYSFS_CLASS_DIR);
+
+    dir = opendir(path);
+    if (dir == NULL) {
+        return false;
+    }
+
+    while (!found && (ent = readdir(dir)) != NULL) {
+        if (!strncmp(ent->d_name, LINUX_DEV_NODE_PREFIX,
+                     strlen(LINUX_DEV_NODE_PREFIX))) {
+            snprintf(node, node_len, "%s/%s", LINUX_DEV_PATH, ent->d_name);
+            found = true;
+        }
+    }
+
+    closedir(dir);
+    return found;
+}
+
+/* Fill in devinfo for a device we are able to open */
+static int get_devinfo(const struct linux_dev_entry *e,
+                       struct bladerf_devinfo *info)
+{
+    return linux_usb_get_devinfo(&e->usb, e->node, BLADERF_BACKEND_LINUX, info);
+}
+
+struct for_each_state {
+    bool (*fn)(const struct linux_dev_entry *e, void *arg);
+    void *arg;
+};
+
+/* Pass on the devices that are bladeRFs bound to the kernel driver */
+static bool for_each_bladerf(const struct linux_usb_dev_entry *usb, void *arg)
+{
+    struct for_each_state *s = (struct for_each_state *) arg;
+    struct linux_dev_entry e;
+
+    if (usb->vid != USB_NUAND_VENDOR_ID ||
+        usb->pid != USB_NUAND_BLADERF_PRODUCT_ID ||
+        !find_dev_node(usb->sysfs_name, e.node, sizeof(e.node))) {
+        return false;
+    }
+
+    memcpy(&e.usb, usb, sizeof(e.usb));
+    return s->fn(&e, s->arg);
+}
+
+/* Iterate over the bladeRFs bound to the kernel driver. Iteration stops when
+ * `fn` returns true. */
+static int for_each_device(bool (*fn)(const struct linux_dev_entry *e,
+                                      void *arg),
+                           void *arg)
+{
+    struct for_each_state s;
+
+    s.fn = fn;
+    s.arg = arg;
+
+    return linux_usb_for_each_device(for_each_bladerf, &s);
+}
+
+struct probe_state {
+    struct bladerf_devinfo_list *list;
+    int n;
+    int status;
+};
+
+static bool probe_device(const struct linux_dev_entry *e, void *arg)
+{
+    struct probe_state *p = (struct probe_state *) arg;
+    struct bladerf_devinfo info;
+
+    /* We may not be able to open the device due to permissions.
+     * Therefore, just carry on. */
+    if (get_devinfo(e, &info) != 0) {
+        return false;
+    }
+
+    info.instance = p->n++;
+    p->status = bladerf_devinfo_list_add(p->list, &info);
+    if (p->status != 0) {
+        log_error("Could not add device to list: %s\n",
+                  bladerf_strerror(p->status));
+        return true;
+    }
+
+    log_verbose("Added instance %d to device list\n", info.instance);
+    return false;
+}
+
+static int linux_probe(backend_probe_target probe_target,
+                       struct bladerf_devinfo_list *info_list)
+{
+    int status;
+    struct probe_state p;
+
+    /* The driver does not bind to the FX3 bootloader */
+    if (probe_target != BACKEND_PROBE_BLADERF) {
+        return 0;
+    }
+
+    p.list = info_list;
+    p.n = 0;
+    p.status = 0;
+
+    status = for_each_device(probe_device, &p);
+    if (status == BLADERF_ERR_NODEV) {
+        /* No sysfs (e.g., in a container) -- there's nothing to find */
+        status = 0;
+    }
+
+    return status != 0 ? status : p.status;
+}
+
+struct find_state {
+    const struct bladerf_devinfo *info_in;
+    struct bladerf_devinfo *info_out;
+    struct bladerf_linux *lnx;
+    int n;
+    int status;
+};
+
+static bool find_device(const struct linux_dev_entry *e, void *arg)
+{
+    struct find_state *f = (struct find_state *) arg;
+    struct bladerf_devinfo curr_info;
+
+    if (get_devinfo(e, &curr_info) != 0) {
+        return false;
+    }
+
+    curr_info.instance = f->n++;
+
+    if (!bladerf_devinfo_matches(&curr_info, f->info_in)) {
+        return false;
+    }
+
+    f->lnx->fd = open(e->node, O_RDWR | O_CLOEXEC);
+    if (f->lnx->fd < 0) {
+        log_debug("Failed to open %s: %s\n", e->node, strerror(errno));
+
+        /* Continue trying the next matching device */
+        return false;
+    }
+
+    memcpy(f->info_out, &curr_info, sizeof(f->info_out[0]));
+    f->status = 0;
+    return true;
+}
+
+static int linux_open(void **driver,
+                      struct bladerf_devinfo *info_in,
+                      struct bladerf_devinfo *info_out)
+{
+    int status;
+    struct find_state f;
+    struct bladerf_linux *lnx = calloc(1, sizeof(lnx[0]));
+
+    if (lnx == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    lnx->fd = -1;
+
+    f.info_in = info_in;
+    f.info_out = info_out;
+    f.lnx = lnx;
+    f.n = 0;
+    f.status = BLADERF_ERR_NODEV;
+
+    status = for_each_device(find_device, &f);
+    if (status == 0) {
+        status = f.status;
+    }
+
+    if (status != 0) {
+        if (status == BLADERF_ERR_NODEV) {
+            log_debug("No devices available on the Linux driver backend.\n");
+        }
+
+        free(lnx);
+        return status;
+    }
+
+    *driver = (void *) lnx;
+    return 0;
+}
+
+static void linux_close(void *driver)
+{
+    struct bladerf_linux *lnx = (struct bladerf_linux *) driver;
+
+    close(lnx->fd);
+    free(lnx);
+}
+
+static int linux_open_bootloader(void **driver, uint8_t bus, uint8_t addr)
+{
+    *driver = NULL;
+    log_debug("The Linux kernel driver does not support the FX3 bootloader.\n");
+    return BLADERF_ERR_NODEV;
+}
+
+static void linux_close_bootloader(void *driver)
+{
+}
+
+static int linux_get_speed(void *driver, bladerf_dev_speed *device_speed)
+{
+    struct bladerf_linux *lnx = (struct bladerf_linux *) driver;
+    int is_super;
+
+    if (ioctl(lnx->fd, BLADE_GET_SPEED, &is_super) != 0) {
+        *device_speed = BLADERF_DEVICE_SPEED_UNKNOWN;
+        return linux_usb_errno_conv(errno);
+    }
+
+    /* The driver binds only to high and SuperSpeed devices */
+    *device_speed = is_super ? BLADERF_DEVICE_SPEED_SUPER :
+                               BLADERF_DEVICE_SPEED_HIGH;
+    return 0;
+}
+
+static int linux_change_setting(void *driver, uint8_t setting)
+{
+    struct bladerf_linux *lnx = (struct bladerf_linux *) driver;
+    unsigned int alt = setting;
+
+    if (ioctl(lnx->fd, BLADE_SET_INTERFACE, &alt) != 0) {
+        return linux_usb_errno_conv(errno);
+    }
+
+    return 0;
+}
+
+/* Returns the number of bytes transferred, or a negative errno value */
+static int do_control_transfer(void *driver,
+                               uint8_t bm_req_type, uint8_t request,
+                               uint16_t wvalue, uint16_t windex,
+                               void *buffer, uint16_t len, uint32_t timeout_ms)
+{
+    struct bladerf_linux *lnx = (struct bladerf_linux *) driver;
+    struct bladeRF_usb_control ctrl;
+    int status;
+
+    ctrl.request_type = bm_req_type;
+    ctrl.request = request;
+    ctrl.value = wvalue;
+    ctrl.index = windex;
+    ctrl.len = len;
+    ctrl.timeout_ms = timeout_ms;
+    ctrl.ptr = (unsigned char *) buffer;
+
+    status = ioctl(lnx->fd, BLADE_USB_CONTROL, &ctrl);
+    return status < 0 ? -errno : status;
+}
+
+static int linux_control_transfer(void *driver,
+                                  usb_target target_type, usb_request req_type,
+                                  usb_direction dir, uint8_t request,
+                                  uint16_t wvalue, uint16_t windex,
+                                  void *buffer, uint32_t buffer_len,
+                                  uint32_t timeout_ms)
+{
+    return linux_usb_control_transfer(do_control_transfer, driver,
+                                      BLADE_USB_CONTROL_MAX_LEN,
+                                      target_type, req_type, dir, request,
+                                      wvalue, windex, buffer, buffer_len,
+                                      timeout_ms);
+}
+
+static int linux_bulk_transfer(void *driver, uint8_t endpoint, void *buffer,
+                               uint32_t buffer_len, uint32_t timeout_ms)
+{
+    int status;
+    struct bladerf_linux *lnx = (struct bladerf_linux *) driver;
+    struct bladeRF_usb_bulk bulk;
+
+    bulk.endpoint = endpoint;
+    bulk.len = buffer_len;
+    bulk.timeout_ms = timeout_ms;
+    bulk.ptr = (unsigned char *) buffer;
+
+    status = ioctl(lnx->fd, BLADE_USB_BULK, &bulk);
+    if (status < 0) {
+        return linux_usb_errno_conv(errno);
+    } else if ((uint32_t) status != buffer_len) {
+        log_debug("Short bulk transfer: requeted=%u, transferred=%d\n",
+                  buffer_len, status);
+        return BLADERF_ERR_IO;
+    }
+
+    return 0;
+}
+
+static int linux_get_string_descriptor(void *driver, uint8_t index,
+                                       void *buffer, uint32_t buffer_len)
+{
+    return linux_usb_get_string_descriptor(do_control_transfer, driver, index,
+                                           buffer, buffer_len);
+}
+
+/* Wake the stream's thread to check for submitted buffers or shutdown */
+static inline void wake_stream(struct linux_stream_data *stream_data)
+{
+    const uint64_t one = 1;
+
+    if (write(stream_data->wake_fd, &one, sizeof(one)) != sizeof(one)) {
+        log_error("Failed to wake stream: %s\n", strerror(errno));
+    }
+}
+
+/* Wait for the ring to become ready (POLLIN or POLLOUT), or with `events`
+ * set to 0, for a buffer to be submitted. Called with stream->lock held,
+ * which is released while waiting. */
+static int wait_for_ring(struct bladerf_linux *lnx,
+                         struct bladerf_stream *stream, short events)
+{
+    struct linux_stream_data *stream_data = stream->backend_data;
+    const int timeout_ms = stream->dev->transfer_timeout[stream->module];
+    struct pollfd fds[2];
+    uint64_t val;
+    int n;
+
+    fds[0].fd = stream_data->wake_fd;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    fds[1].fd = lnx->fd;
+    fds[1].events = events;
+    fds[1].revents = 0;
+
+    MUTEX_UNLOCK(&stream->lock);
+
+    n = poll(fds, events != 0 ? 2 : 1,
+             (events != 0 && timeout_ms != 0) ? timeout_ms : -1);
+
+    if (n > 0 && (fds[0].revents & POLLIN) &&
+        read(stream_data->wake_fd, &val, sizeof(val)) < 0) {
+        log_debug("Failed to read stream's eventfd: %s\n", strerror(errno));
+    }
+
+    MUTEX_LOCK(&stream->lock);
+
+    if (n < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+
+        log_error("poll() failed: %s\n", strerror(errno));
+        return BLADERF_ERR_UNEXPECTED;
+    } else if (n == 0) {
+        log_debug("%s: Timed out waiting for the ring.\n", __FUNCTION__);
+        return BLADERF_ERR_TIMEOUT;
+    } else if (fds[1].revents & (POLLERR | POLLHUP)) {
+        return BLADERF_ERR_NODEV;
+    }
+
+    return 0;
+}
+
+static int queue_buffer(struct bladerf_stream *stream, void *buffer)
+{
+    struct linux_stream_data *stream_data = stream->backend_data;
+    size_t i;
+
+    if (stream_data->count >= stream_data->queue_len) {
+        log_error("%s: Buffer queue is full.\n", __FUNCTION__);
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    i = (stream_data->head + stream_data->count) % stream_data->queue_len;
+    stream_data->queue[i] = buffer;
+    stream_data->queued_us[i] = async_stats_time_us();
+    stream_data->count++;
+
+    return 0;
+}
+
+/* Hand the oldest queued buffer, which has been filled (RX) or copied to the
+ * ring (TX), to the stream callback, and queue the buffer it returns */
+static void complete_buffer(struct bladerf_stream *stream,
+                            struct bladerf_metadata *metadata)
+{
+    struct linux_stream_data *stream_data = stream->backend_data;
+    void *buffer = stream_data->queue[stream_data->head];
+    void *next_buffer;
+    uint64_t now_us, cb_done_us;
+
+    now_us = async_stats_time_us();
+    async_stats_hist_add(stream->stats.turnaround_hist,
+                         stream_data->queued_us[stream_data->head], now_us);
+    stream->stats.transfers++;
+
+    stream_data->head = (stream_data->head + 1) % stream_data->queue_len;
+    stream_data->count--;
+    stream_data->offset = 0;
+    pthread_cond_signal(&stream->can_submit_buffer);
+
+    async_rx_metadata(stream, buffer, stream->samples_per_buffer, metadata);
+
+#   if !ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+    MUTEX_UNLOCK(&stream->lock);
+#   endif
+
+    next_buffer = stream->cb(stream->dev,
+                             stream,
+                             metadata,
+                             buffer,
+                             stream->samples_per_buffer,
+                             stream->user_data);
+
+    cb_done_us = async_stats_time_us();
+
+#   if !ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+    MUTEX_LOCK(&stream->lock);
+#   endif
+
+    async_stats_hist_add(stream->stats.callback_hist, now_us, cb_done_us);
+
+    if (next_buffer == BLADERF_STREAM_SHUTDOWN) {
+        stream->state = STREAM_SHUTTING_DOWN;
+    } else if (next_buffer != BLADERF_STREAM_NO_DATA &&
+               queue_buffer(stream, next_buffer) != 0) {
+        stream->state = STREAM_SHUTTING_DOWN;
+    }
+}
+
+/* Copy ring buffers into queued stream buffers, in order */
+static int rx_stream(struct bladerf_linux *lnx, struct bladerf_stream *stream)
+{
+    int status = 0;
+    struct linux_stream_data *stream_data = stream->backend_data;
+    const size_t bytes_per_buffer = async_stream_buf_bytes(stream);
+    struct bladerf_metadata metadata;
+    struct bladeRF_ring_pos pos;
+    unsigned int released = 0;
+
+    while (stream->state == STREAM_RUNNING) {
+        pos.idx = 0;
+        pos.count = released;
+
+        if (ioctl(lnx->fd, BLADE_RX_RING_ADVANCE, &pos) != 0) {
+            status = linux_usb_errno_conv(errno);
+            log_debug("Failed to advance RX ring: %s\n", strerror(errno));
+            break;
+        }
+
+        released = 0;
+
+        if (pos.count == 0 || stream_data->count == 0) {
+            status = wait_for_ring(lnx, stream,
+                                   stream_data->count != 0 ? POLLIN : 0);
+            if (status != 0) {
+                break;
+            }
+
+            continue;
+        }
+
+        while (pos.count != 0 && stream_data->count != 0 &&
+               stream->state == STREAM_RUNNING) {
+
+            uint8_t *dst = (uint8_t *) stream_data->queue[stream_data->head];
+
+            memcpy(dst + stream_data->offset,
+                   stream_data->ring + (size_t) pos.idx * stream_data->buf_size,
+                   stream_data->buf_size);
+
+            pos.idx = (pos.idx + 1) % stream_data->num_bufs;
+            pos.count--;
+            released++;
+
+            stream_data->offset += stream_data->buf_size;
+            if (stream_data->offset >= bytes_per_buffer) {
+                complete_buffer(stream, &metadata);
+            }
+        }
+    }
+
+    /* Return the buffers we've read to the driver */
+    if (released != 0) {
+        pos.count = released;
+        if (ioctl(lnx->fd, BLADE_RX_RING_ADVANCE, &pos) != 0) {
+            log_debug("Failed to release RX buffers: %s\n", strerror(errno));
+        }
+    }
+
+    return status;
+}
+
+/* Copy queued stream buffers into the ring, in order. Buffers copied into
+ * the ring before the stream ends are still transmitted. */
+static int tx_stream(struct bladerf_linux *lnx, struct bladerf_stream *stream)
+{
+    int status = 0;
+    struct linux_stream_data *stream_data = stream->backend_data;
+    const size_t bytes_per_buffer = async_stream_buf_bytes(stream);
+    struct bladerf_metadata metadata;
+    struct bladeRF_ring_pos pos;
+    unsigned int filled = 0;
+
+    memset(&metadata, 0, sizeof(metadata));
+
+    while (true) {
+        pos.idx = 0;
+        pos.count = filled;
+
+        if (ioctl(lnx->fd, BLADE_TX_RING_ADVANCE, &pos) != 0) {
+            status = linux_usb_errno_conv(errno);
+            log_debug("Failed to advance TX ring: %s\n", strerror(errno));
+            break;
+        }
+
+        filled = 0;
+
+        if (stream->state != STREAM_RUNNING) {
+            break;
+        }
+
+        if (pos.count == 0 || stream_data->count == 0) {
+            status = wait_for_ring(lnx, stream,
+                                   stream_data->count != 0 ? POLLOUT : 0);
+            if (status != 0) {
+                break;
+            }
+
+            continue;
+        }
+
+        while (pos.count != 0 && stream_data->count != 0 &&
+               stream->state == STREAM_RUNNING) {
+
+            const uint8_t *src =
+                (const uint8_t *) stream_data->queue[stream_data->head];
+
+            memcpy(stream_data->ring + (size_t) pos.idx * stream_data->buf_size,
+                   src + stream_data->offset,
+                   stream_data->buf_size);
+
+            pos.idx = (pos.idx + 1) % stream_data->num_bufs;
+            pos.count--;
+            filled++;
+
+            stream_data->offset += stream_data->buf_size;
+            if (stream_data->offset >= bytes_per_buffer) {
+                complete_buffer(stream, &metadata);
+            }
+        }
+    }
+
+    return status;
+}
+
+/* Each stream buffer must consist of whole ring buffers, which must in turn
+ * consist of whole pages in order to be mapped. Otherwise, fall back to
+ * page-sized ring buffers, which the driver permits only while the device is
+ * not streaming. */
+static int check_ring_config(struct bladerf_linux *lnx,
+                             struct bladerf_stream *stream)
+{
+    struct bladeRF_ring_info info;
+    struct bladeRF_ring_config config;
+    const size_t bytes_per_buffer = async_stream_buf_bytes(stream);
+    const unsigned int page_size = (unsigned int) sysconf(_SC_PAGESIZE);
+
+    if (ioctl(lnx->fd, BLADE_RING_INFO, &info) != 0) {
+        log_debug("Failed to query ring configuration: %s\n", strerror(errno));
+        return linux_usb_errno_conv(errno);
+    }
+
+    if (bytes_per_buffer % info.buf_size == 0 &&
+        info.buf_size % page_size == 0) {
+        return 0;
+    }
+
+    config.num_bufs = info.num_bufs;
+    config.buf_size = page_size;
+
+    if (bytes_per_buffer % page_size != 0 ||
+        ioctl(lnx->fd, BLADE_SET_RING_CONFIG, &config) != 0) {
+        log_error("The kernel driver's %u-byte ring buffers do not evenly "
+                  "divide %zu-byte stream buffers. Reload the driver with "
+                  "buf_size=%u.\n", info.buf_size, bytes_per_buffer, page_size);
+        return BLADERF_ERR_INVAL;
+    }
+
+    log_debug("Changed the kernel driver's ring buffer size from %u to %u.\n",
+              info.buf_size, page_size);
+    return 0;
+}
+
+static int map_ring(struct bladerf_linux *lnx, struct bladerf_stream *stream,
+                    bladerf_module module)
+{
+    struct linux_stream_data *stream_data = stream->backend_data;
+    struct bladeRF_ring_info info;
+    void *ring;
+    off_t offset;
+    int prot;
+
+    if (ioctl(lnx->fd, BLADE_RING_INFO, &info) != 0) {
+        log_debug("Failed to query ring configuration: %s\n", strerror(errno));
+        return linux_usb_errno_conv(errno);
+    }
+
+    if (async_stream_buf_bytes(stream) % info.buf_size != 0) {
+        log_debug("Ring buffer size changed since stream initialization.\n");
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (module == BLADERF_MODULE_RX) {
+        offset = info.rx_offset;
+        prot = PROT_READ;
+    } else {
+        offset = info.tx_offset;
+        prot = PROT_READ | PROT_WRITE;
+    }
+
+    stream_data->num_bufs = info.num_bufs;
+    stream_data->buf_size = info.buf_size;
+    stream_data->ring_len = (size_t) info.num_bufs * info.buf_size;
+
+    ring = mmap(NULL, stream_data->ring_len, prot, MAP_SHARED, lnx->fd, offset);
+    if (ring == MAP_FAILED) {
+        log_error("Failed to map %s ring: %s\n",
+                  module == BLADERF_MODULE_RX ? "RX" : "TX", strerror(errno));
+        return linux_usb_errno_conv(errno);
+    }
+
+    stream_data->ring = (uint8_t *) ring;
+    return 0;
+}
+
+static void free_stream_data(struct linux_stream_data *stream_data)
+{
+    if (stream_data->wake_fd >= 0) {
+        close(stream_data->wake_fd);
+    }
+
+    free(stream_data->queue);
+    free(stream_data->queued_us);
+    free(stream_data);
+}
+
+static int linux_init_stream(void *driver, struct bladerf_stream *stream,
+                             size_t num_transfers)
+{
+    int status;
+    struct bladerf_linux *lnx = (struct bladerf_linux *) driver;
+    struct linux_stream_data *stream_data;
+
+    status = check_ring_config(lnx, stream);
+    if (status != 0) {
+        return status;
+    }
+
+    stream_data = calloc(1, sizeof(stream_data[0]));
+    if (stream_data == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    stream_data->num_transfers = num_transfers;
+    stream_data->queue_len = stream->num_buffers;
+    stream_data->queue = calloc(stream->num_buffers,
+                                sizeof(stream_data->queue[0]));
+    stream_data->queued_us = calloc(stream->num_buffers,
+                                    sizeof(stream_data->queued_us[0]));
+
+    stream_data->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+    if (stream_data->queue == NULL || stream_data->queued_us == NULL ||
+        stream_data->wake_fd < 0) {
+        log_error("Failed to allocate stream data\n");
+        free_stream_data(stream_data);
+        return BLADERF_ERR_MEM;
+    }
+
+    stream->backend_data = stream_data;
+    return 0;
+}
+
+static int linux_stream(void *driver, struct bladerf_stream *stream,
+                        bladerf_module module)
+{
+    size_t i;
+    int status;
+    void *buffer;
+    uint64_t val;
+    struct bladerf_metadata metadata;
+    struct bladerf_linux *lnx = (struct bladerf_linux *) driver;
+    struct linux_stream_data *stream_data = stream->backend_data;
+
+    memset(&metadata, 0, sizeof(metadata));
+
+    MUTEX_LOCK(&stream->lock);
+
+    stream_data->head = 0;
+    stream_data->count = 0;
+    stream_data->offset = 0;
+
+    /* Discard wakeups left over from a previous run */
+    if (read(stream_data->wake_fd, &val, sizeof(val)) < 0 && errno != EAGAIN) {
+        log_debug("Failed to read stream's eventfd: %s\n", strerror(errno));
+    }
+
+    status = map_ring(lnx, stream, module);
+
+    /* Set up initial set of buffers */
+    for (i = 0; status == 0 && i < stream_data->num_transfers; i++) {
+        if (module == BLADERF_MODULE_TX) {
+            buffer = stream->cb(stream->dev,
+                                stream,
+                                &metadata,
+                                NULL,
+                                stream->samples_per_buffer,
+                                stream->user_data);
+
+            if (buffer == BLADERF_STREAM_SHUTDOWN) {
+                stream->state = STREAM_SHUTTING_DOWN;
+                break;
+            }
+        } else {
+            buffer = stream->buffers[i];
+        }
+
+        if (buffer != BLADERF_STREAM_NO_DATA) {
+            status = queue_buffer(stream, buffer);
+        }
+    }
+
+    if (status == 0) {
+        if (module == BLADERF_MODULE_RX) {
+            status = rx_stream(lnx, stream);
+        } else {
+            status = tx_stream(lnx, stream);
+        }
+
+        if (status != 0) {
+            stream->error_code = status;
+            status = 0;
+        }
+    }
+
+    if (stream_data->ring != NULL) {
+        munmap(stream_data->ring, stream_data->ring_len);
+        stream_data->ring = NULL;
+    }
+
+    stream->state = STREAM_DONE;
+
+    /* Release any submitters waiting for space in the queue */
+    pthread_cond_broadcast(&stream->can_submit_buffer);
+
+    MUTEX_UNLOCK(&stream->lock);
+
+    return status;
+}
+
+/* The top-level code will have aquired the stream->lock for us */
+static int linux_submit_stream_buffer(void *driver,
+                                      struct bladerf_stream *stream,
+                                      void *buffer, unsigned int timeout_ms)
+{
+    int status = 0;
+    struct linux_stream_data *stream_data = stream->backend_data;
+    struct timespec timeout_abs;
+
+    if (buffer == BLADERF_STREAM_SHUTDOWN) {
+        if (stream->state == STREAM_RUNNING) {
+            stream->state = STREAM_SHUTTING_DOWN;
+        }
+
+        wake_stream(stream_data);
+        return 0;
+    }
+
+    if (timeout_ms != 0) {
+        status = populate_abs_timeout(&timeout_abs, timeout_ms);
+        if (status != 0) {
+            return BLADERF_ERR_UNEXPECTED;
+        }
+
+        while (stream_data->count >= stream_data->queue_len &&
+               stream->state == STREAM_RUNNING && status == 0) {
+            status = pthread_cond_timedwait(&stream->can_submit_buffer,
+                                            &stream->lock,
+                                            &timeout_abs);
+        }
+    } else {
+        while (stream_data->count >= stream_data->queue_len &&
+               stream->state == STREAM_RUNNING && status == 0) {
+            status = pthread_cond_wait(&stream->can_submit_buffer,
+                                       &stream->lock);
+        }
+    }
+
+    if (status == ETIMEDOUT) {
+        log_debug("%s: Timed out waiting for space in the queue.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_TIMEOUT;
+    } else if (status != 0 || stream->state != STREAM_RUNNING) {
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    status = queue_buffer(stream, buffer);
+    if (status == 0) {
+        wake_stream(stream_data);
+    }
+
+    return status;
+}
+
+static int linux_deinit_stream(void *driver, struct bladerf_stream *stream)
+{
+    free_stream_data(stream->backend_data);
+    stream->backend_data = NULL;
+    return 0;
+}
+
+static const struct usb_fns linux_fns = {
+    FIELD_INIT(.probe, linux_probe),
+    FIELD_INIT(.open, linux_open),
+    FIELD_INIT(.close, linux_close),
+    FIELD_INIT(.get_speed, linux_get_speed),
+    FIELD_INIT(.change_setting, linux_change_setting),
+    FIELD_INIT(.control_transfer, linux_control_transfer),
+    FIELD_INIT(.bulk_transfer, linux_bulk_transfer),
+    FIELD_INIT(.get_string_descriptor, linux_get_string_descriptor),
+    FIELD_INIT(.init_stream, linux_init_stream),
+    FIELD_INIT(.stream, linux_stream),
+    FIELD_INIT(.submit_stream_buffer, linux_submit_stream_buffer),
+    FIELD_INIT(.deinit_stream, linux_deinit_stream),
+    FIELD_INIT(.open_bootloader, linux_open_bootloader),
+    FIELD_INIT(.close_bootloader, linux_close_bootloader),
+    FIELD_INIT(.alloc_dev_mem, NULL),
+    FIELD_INIT(.free_dev_mem, NULL),
+};
+
+const struct usb_driver usb_driver_linux = {
+    FIELD_INIT(.id, BLADERF_BACKEND_LINUX),
+    FIELD_INIT(.fn, &linux_fns)
+};
@@ -30,10 +30,15 @@
 #include "backend/backend_config.h"
 #include "backend/usb/usb.h"
 #include "async.h"
+#include "trace.h"
+#include "probes.h"
+#include "numa_node.h"
+#include "lms.h"
 #include "bladeRF.h"    /* Firmware interface */
 #include "log.h"
 #include "version_compat.h"
 #include "minmax.h"
+#include "fpga.h"
 
 #if ENABLE_USB_DEV_RESET_ON_OPEN
 bool bladerf_usb_reset_device_on_open = true;
@@ -58,23 +63,116 @@ static inline struct bladerf_usb *usb_backend(struct bladerf *dev, void **driver
     return ret;
 }
 
+static bladerf_trace_target peripheral_trace_target(uint8_t peripheral)
+{
+    switch (peripheral) {
+        case UART_PKT_DEV_LMS:
+            return BLADERF_TRACE_TARGET_LMS;
 
-static int access_peripheral(struct bladerf *dev, uint8_t peripheral,
-                             usb_direction dir, struct uart_cmd *cmd,
-                             size_t len)
+        case UART_PKT_DEV_SI5338:
+            return BLADERF_TRACE_TARGET_SI5338;
+
+        case UART_PKT_DEV_VCTCXO:
+            return BLADERF_TRACE_TARGET_VCTCXO;
+
+        default:
+            return BLADERF_TRACE_TARGET_GPIO;
+    }
+}
+
+static bladerf_trace_target vendor_cmd_trace_target(uint8_t cmd)
+{
+    switch (cmd) {
+        case BLADE_USB_CMD_QUERY_FPGA_STATUS:
+        case BLADE_USB_CMD_BEGIN_PROG:
+        case BLADE_USB_CMD_END_PROG:
+            return BLADERF_TRACE_TARGET_FPGA;
+
+        case BLADE_USB_CMD_FLASH_READ:
+        case BLADE_USB_CMD_FLASH_WRITE:
+        case BLADE_USB_CMD_FLASH_ERASE:
+        case BLADE_USB_CMD_READ_OTP:
+        case BLADE_USB_CMD_WRITE_OTP:
+        case BLADE_USB_CMD_READ_PAGE_BUFFER:
+        case BLADE_USB_CMD_WRITE_PAGE_BUFFER:
+        case BLADE_USB_CMD_LOCK_OTP:
+        case BLADE_USB_CMD_READ_CAL_CACHE:
+        case BLADE_USB_CMD_INVALIDATE_CAL_CACHE:
+        case BLADE_USB_CMD_REFRESH_CAL_CACHE:
+        case BLADE_USB_CMD_FLASH_CRC32:
+            return BLADERF_TRACE_TARGET_FLASH;
+
+        default:
+            return BLADERF_TRACE_TARGET_FX3;
+    }
+}
+
+/* Control transfer to an open device, recorded in the device's trace. This
+ * acquires dev->xfer_lock, so the caller must not hold it. */
+static int control_transfer(struct bladerf *dev,
+                            usb_target target_type, usb_request req_type,
+                            usb_direction dir, uint8_t request,
+                            uint16_t wvalue, uint16_t windex,
+                            void *buffer, uint32_t buffer_len,
+                            uint32_t timeout_ms)
 {
     void *driver;
     struct bladerf_usb *usb = usb_backend(dev, &driver);
+    uint64_t start_ns;
+    int status;
+
+    MUTEX_LOCK(&dev->xfer_lock);
+    start_ns = trace_start(dev);
+    dev->ctrl_requests++;
+
+    status = usb->fn->control_transfer(driver, target_type, req_type, dir,
+                                       request, wvalue, windex,
+                                       buffer, buffer_len, timeout_ms);
+
+    trace_add(dev, start_ns, BLADERF_TRACE_CONTROL,
+              vendor_cmd_trace_target(request), request, buffer_len, status);
+    MUTEX_UNLOCK(&dev->xfer_lock);
 
+    return status;
+}
+
+/* Bulk transfer on the control path, recorded in the device's trace. For
+ * peripheral requests and ACKs, `buffer` must hold a whole packet. The caller
+ * must hold dev->xfer_lock. */
+static int bulk_transfer(struct bladerf *dev, bladerf_trace_target target,
+                         uint8_t endpoint, void *buffer, uint32_t buffer_len,
+                         uint32_t timeout_ms)
+{
+    void *driver;
+    struct bladerf_usb *usb = usb_backend(dev, &driver);
+    const uint64_t start_ns = trace_start(dev);
+    const bool peripheral = target != BLADERF_TRACE_TARGET_FPGA;
     int status;
+
+    status = usb->fn->bulk_transfer(driver, endpoint, buffer, buffer_len,
+                                    timeout_ms);
+
+    trace_add(dev, start_ns,
+              (endpoint & USB_DIR_DEVICE_TO_HOST) ? BLADERF_TRACE_BULK_IN :
+                                                    BLADERF_TRACE_BULK_OUT,
+              target, peripheral ? ((uint8_t *) buffer)[1] : 0,
+              buffer_len, status);
+
+    return status;
+}
+
+/* Populate `buf` with a peripheral access request */
+static void build_peripheral_request(uint8_t *buf, size_t buf_len,
+                                     uint8_t peripheral, usb_direction dir,
+                                     const struct uart_cmd *cmd, size_t len)
+{
     size_t i;
-    uint8_t buf[16] = { 0 };
     const uint8_t pkt_mode_dir = (dir == USB_DIR_HOST_TO_DEVICE) ?
                         UART_PKT_MODE_DIR_WRITE : UART_PKT_MODE_DIR_READ;
 
-    assert(len <= ((sizeof(buf) - 2) / 2));
+    assert(len <= ((buf_len - 2) / 2));
 
-    /* Populate the buffer for transfer */
+    memset(buf, 0, buf_len);
     buf[0] = UART_PKT_MAGIC;
     buf[1] = pkt_mode_dir | peripheral | (uint8_t)len;
 
@@ -82,78 +180,251 @@ static int access_peripheral(struct bladerf *dev, uint8_t peripheral,
         buf[i * 2 + 2] = cmd[i].addr;
         buf[i * 2 + 3] = cmd[i].data;
     }
+}
+
+static int access_peripheral(struct bladerf *dev, uint8_t peripheral,
+                             usb_direction dir, struct uart_cmd *cmd,
+                             size_t len)
+{
+    int status;
+    size_t i;
+    uint8_t buf[PERIPHERAL_PKT_SIZE];
+    const bladerf_trace_target target = peripheral_trace_target(peripheral);
+    uint64_t start_ns;
+
+    MUTEX_LOCK(&dev->xfer_lock);
+    start_ns = trace_start(dev);
+    PROBE3(periph_start, peripheral, dir, len);
+
+    /* Populate the buffer for transfer */
+    build_peripheral_request(buf, sizeof(buf), peripheral, dir, cmd, len);
+    dev->ctrl_requests++;
 
     /* Send the command */
-    status = usb->fn->bulk_transfer(driver, PERIPHERAL_EP_OUT,
-                                     buf, sizeof(buf),
-                                     PERIPHERAL_TIMEOUT_MS);
+    status = bulk_transfer(dev, target, PERIPHERAL_EP_OUT,
+                           buf, sizeof(buf),
+                           PERIPHERAL_TIMEOUT_MS);
     if (status != 0) {
         log_debug("Failed to write perperial access command: %s\n",
                   bladerf_strerror(status));
-        return status;
+    } else {
+        /* Read back the ACK. The command data is only used for a read
+         * operation, and is thrown away otherwise */
+        status = bulk_transfer(dev, target, PERIPHERAL_EP_IN,
+                               buf, sizeof(buf),
+                               PERIPHERAL_TIMEOUT_MS);
+
+        if (dir == UART_PKT_MODE_DIR_READ && status == 0) {
+            for (i = 0; i < len; i++) {
+                cmd[i].data = buf[i * 2 + 3];
+            }
+        }
     }
 
-    /* Read back the ACK. The command data is only used for a read operation,
-     * and is thrown away otherwise */
-    status = usb->fn->bulk_transfer(driver, PERIPHERAL_EP_IN,
-                                    buf, sizeof(buf),
-                                    PERIPHERAL_TIMEOUT_MS);
+    PROBE2(periph_end, peripheral, status);
+    trace_add(dev, start_ns, BLADERF_TRACE_PERIPHERAL, target,
+              buf[1], (uint32_t) len, status);
+    MUTEX_UNLOCK(&dev->xfer_lock);
+
+    return status;
+}
+
+/* A request that has been sent to the device but not yet acknowledged */
+struct pending_request {
+    size_t first;       /* Index of the first access in the request */
+    size_t count;       /* Number of accesses in the request */
+    usb_direction dir;
+};
+
+/* Perform a sequence of register accesses on a single peripheral.
+ *
+ * Consecutive accesses in the same direction are packed into a single request,
+ * and up to PERIPHERAL_PIPELINE_DEPTH requests are sent before their ACKs are
+ * collected. The device processes requests in order, so the accesses take
+ * effect in the order given, while the round trip latency is only incurred
+ * roughly once per PERIPHERAL_PIPELINE_DEPTH requests.
+ *
+ * As of FX3 firmware v1.9.0, the queued requests are sent to the device in a
+ * single bulk transfer. */
+static int access_peripheral_batch(struct bladerf *dev, uint8_t peripheral,
+                                   struct backend_reg_access *regs,
+                                   size_t count)
+{
+    int status = 0;
+    size_t next = 0;
+    size_t i, j;
+    size_t head = 0, num_pending = 0;
+    size_t out_len;
+    struct pending_request pending[PERIPHERAL_PIPELINE_DEPTH];
+    struct uart_cmd cmd[PERIPHERAL_MAX_CMDS];
+    uint8_t out[PERIPHERAL_PKT_SIZE * PERIPHERAL_PIPELINE_DEPTH];
+    uint8_t buf[PERIPHERAL_PKT_SIZE];
+
+    const bool coalesce = version_greater_or_equal(&dev->fw_version, 1, 9, 0);
+    const bladerf_trace_target target = peripheral_trace_target(peripheral);
+    uint64_t start_ns;
+
+    MUTEX_LOCK(&dev->xfer_lock);
+    start_ns = trace_start(dev);
+
+    while (status == 0 && (next < count || num_pending != 0)) {
+
+        /* Fill the pipeline */
+        out_len = 0;
+        while (status == 0 && next < count &&
+               num_pending < PERIPHERAL_PIPELINE_DEPTH) {
+
+            struct pending_request *req =
+                &pending[(head + num_pending) % PERIPHERAL_PIPELINE_DEPTH];
+
+            req->first = next;
+            req->dir = regs[next].write ? USB_DIR_HOST_TO_DEVICE :
+                                          USB_DIR_DEVICE_TO_HOST;
+
+            for (req->count = 0;
+                 req->count < PERIPHERAL_MAX_CMDS && next < count &&
+                    regs[next].write == regs[req->first].write;
+                 req->count++, next++) {
+
+                cmd[req->count].addr = regs[next].addr;
+                cmd[req->count].data = regs[next].write ? regs[next].data : 0xff;
+            }
+
+            build_peripheral_request(&out[out_len], PERIPHERAL_PKT_SIZE,
+                                     peripheral, req->dir, cmd, req->count);
+            dev->ctrl_requests++;
+            num_pending++;
+
+            if (coalesce) {
+                out_len += PERIPHERAL_PKT_SIZE;
+            } else {
+                status = bulk_transfer(dev, target, PERIPHERAL_EP_OUT,
+                                       out, PERIPHERAL_PKT_SIZE,
+                                       PERIPHERAL_TIMEOUT_MS);
+                if (status != 0) {
+                    log_debug("Failed to write perperial access command: %s\n",
+                              bladerf_strerror(status));
+                    num_pending--;
+                }
+            }
+        }
+
+        if (out_len != 0) {
+            status = bulk_transfer(dev, target, PERIPHERAL_EP_OUT,
+                                   out, out_len,
+                                   PERIPHERAL_TIMEOUT_MS);
+            if (status != 0) {
+                log_debug("Failed to write perperial access commands: %s\n",
+                          bladerf_strerror(status));
+                num_pending -= out_len / PERIPHERAL_PKT_SIZE;
+            }
+        }
+
+        /* Collect the oldest ACK. On failure, the remaining ACKs are still
+         * drained so that they are not mistaken for responses to later
+         * requests. */
+        if (num_pending != 0) {
+            const struct pending_request *req = &pending[head];
+            int ack_status;
+
+            ack_status = bulk_transfer(dev, target, PERIPHERAL_EP_IN,
+                                       buf, sizeof(buf),
+                                       PERIPHERAL_TIMEOUT_MS);
+
+            if (ack_status == 0 && req->dir == USB_DIR_DEVICE_TO_HOST) {
+                for (i = 0, j = req->first; i < req->count; i++, j++) {
+                    regs[j].data = buf[i * 2 + 3];
+                }
+            } else if (ack_status != 0) {
+                log_debug("Failed to read peripheral access ACK: %s\n",
+                          bladerf_strerror(ack_status));
+            }
+
+            if (status == 0) {
+                status = ack_status;
+            }
+
+            head = (head + 1) % PERIPHERAL_PIPELINE_DEPTH;
+            num_pending--;
+        }
 
-    if (dir == UART_PKT_MODE_DIR_READ && status == 0) {
-        for (i = 0; i < len; i++) {
-            cmd[i].data = buf[i * 2 + 3];
+        /* Don't bother submitting more requests after a failure, but finish
+         * draining any that are outstanding */
+        if (status != 0) {
+            next = count;
         }
     }
 
+    trace_add(dev, start_ns, BLADERF_TRACE_PERIPHERAL, target,
+              peripheral, (uint32_t) count, status);
+    MUTEX_UNLOCK(&dev->xfer_lock);
+
     return status;
 }
 
-static inline int gpio_read(struct bladerf *dev, uint8_t addr, uint32_t *data)
+/* Read `len` consecutive peripheral registers, starting at `addr`, using a
+ * single request. The bytes are assembled into `value`, least significant
+ * byte first. */
+static int peripheral_read_bytes(struct bladerf *dev, uint8_t peripheral,
+                                 uint8_t addr, size_t len, uint32_t *value)
 {
     int status;
     size_t i;
-    struct uart_cmd cmd;
-
-    *data = 0;
+    struct uart_cmd cmd[sizeof(*value)];
 
-    for (i = 0; i < sizeof(*data); i++) {
-        assert((addr + i) <= UINT8_MAX);
-        cmd.addr = (uint8_t)(addr + i);
-        cmd.data = 0xff;
+    assert(len <= ARRAY_SIZE(cmd));
+    assert((addr + len - 1) <= UINT8_MAX);
 
-        status = access_peripheral(dev, UART_PKT_DEV_GPIO,
-                                   USB_DIR_DEVICE_TO_HOST, &cmd, 1);
+    for (i = 0; i < len; i++) {
+        cmd[i].addr = (uint8_t)(addr + i);
+        cmd[i].data = 0xff;
+    }
 
-        if (status < 0) {
-            return status;
-        }
+    status = access_peripheral(dev, peripheral, USB_DIR_DEVICE_TO_HOST,
+                               cmd, len);
+    if (status != 0) {
+        return status;
+    }
 
-        *data |= (cmd.data << (i * 8));
+    *value = 0;
+    for (i = 0; i < len; i++) {
+        *value |= ((uint32_t)cmd[i].data << (i * 8));
     }
 
     return 0;
 }
 
-static inline int gpio_write(struct bladerf *dev, uint8_t addr, uint32_t data)
+/* Write `len` consecutive peripheral registers, starting at `addr`, using a
+ * single request. The bytes are taken from `value`, least significant
+ * byte first. */
+static int peripheral_write_bytes(struct bladerf *dev, uint8_t peripheral,
+                                  uint8_t addr, size_t len, uint32_t value)
 {
-    int status;
     size_t i;
-    struct uart_cmd cmd;
+    struct uart_cmd cmd[sizeof(value)];
 
-    for (i = 0; i < sizeof(data); i++) {
-        assert((addr + i) <= UINT8_MAX);
-        cmd.addr = (uint8_t)(addr + i);
-        cmd.data = (data >> (i * 8)) & 0xff;
+    assert(len <= ARRAY_SIZE(cmd));
+    assert((addr + len - 1) <= UINT8_MAX);
 
-        status = access_peripheral(dev, UART_PKT_DEV_GPIO,
-                                   USB_DIR_HOST_TO_DEVICE, &cmd, 1);
-
-        if (status < 0) {
-            return status;
-        }
+    for (i = 0; i < len; i++) {
+        cmd[i].addr = (uint8_t)(addr + i);
+        cmd[i].data = (value >> (i * 8)) & 0xff;
     }
 
-    return 0;
+    return access_peripheral(dev, peripheral, USB_DIR_HOST_TO_DEVICE,
+                             cmd, len);
+}
+
+static inline int gpio_read(struct bladerf *dev, uint8_t addr, uint32_t *data)
+{
+    return peripheral_read_bytes(dev, UART_PKT_DEV_GPIO, addr,
+                                 sizeof(*data), data);
+}
+
+static inline int gpio_write(struct bladerf *dev, uint8_t addr, uint32_t data)
+{
+    return peripheral_write_bytes(dev, UART_PKT_DEV_GPIO, addr,
+                                  sizeof(data), data);
 }
 
 static int load_fpga_version(struct bladerf *dev)
@@ -204,32 +475,41 @@ static int load_fpga_version(struct bladerf *dev)
 static inline int vendor_cmd_int_windex(struct bladerf *dev, uint8_t cmd,
                                         uint16_t windex, int32_t *val)
 {
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
+    return control_transfer(dev,
+                             USB_TARGET_DEVICE,
+                             USB_REQUEST_VENDOR,
+                             USB_DIR_DEVICE_TO_HOST,
+                             cmd, 0, windex,
+                             val, sizeof(uint32_t),
+                             CTRL_TIMEOUT_MS);
+}
 
-    return usb->fn->control_transfer(driver,
-                                      USB_TARGET_DEVICE,
-                                      USB_REQUEST_VENDOR,
-                                      USB_DIR_DEVICE_TO_HOST,
-                                      cmd, 0, windex,
-                                      val, sizeof(uint32_t),
-                                      CTRL_TIMEOUT_MS);
+/* Vendor command wrapper to get a 32-bit integer and supplies both wValue and
+ * wIndex */
+static inline int vendor_cmd_int_wvalue_windex(struct bladerf *dev, uint8_t cmd,
+                                               uint16_t wvalue, uint16_t windex,
+                                               int32_t *val)
+{
+    return control_transfer(dev,
+                             USB_TARGET_DEVICE,
+                             USB_REQUEST_VENDOR,
+                             USB_DIR_DEVICE_TO_HOST,
+                             cmd, wvalue, windex,
+                             val, sizeof(uint32_t),
+                             CTRL_TIMEOUT_MS);
 }
 
 /* Vendor command wrapper to get a 32-bit integer and supplies wValue */
 static inline int vendor_cmd_int_wvalue(struct bladerf *dev, uint8_t cmd,
                                         uint16_t wvalue, int32_t *val)
 {
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
-
-    return usb->fn->control_transfer(driver,
-                                      USB_TARGET_DEVICE,
-                                      USB_REQUEST_VENDOR,
-                                      USB_DIR_DEVICE_TO_HOST,
-                                      cmd, wvalue, 0,
-                                      val, sizeof(uint32_t),
-                                      CTRL_TIMEOUT_MS);
+    return control_transfer(dev,
+                             USB_TARGET_DEVICE,
+                             USB_REQUEST_VENDOR,
+                             USB_DIR_DEVICE_TO_HOST,
+                             cmd, wvalue, 0,
+                             val, sizeof(uint32_t),
+                             CTRL_TIMEOUT_MS);
 }
 
 
@@ -237,15 +517,12 @@ static inline int vendor_cmd_int_wvalue(struct bladerf *dev, uint8_t cmd,
 static inline int vendor_cmd_int(struct bladerf *dev, uint8_t cmd,
                                  usb_direction dir, int32_t *val)
 {
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
-
-    return usb->fn->control_transfer(driver,
-                                      USB_TARGET_DEVICE,
-                                      USB_REQUEST_VENDOR,
-                                      dir, cmd, 0, 0,
-                                      val, sizeof(int32_t),
-                                      CTRL_TIMEOUT_MS);
+    return control_transfer(dev,
+                             USB_TARGET_DEVICE,
+                             USB_REQUEST_VENDOR,
+                             dir, cmd, 0, 0,
+                             val, sizeof(int32_t),
+                             CTRL_TIMEOUT_MS);
 }
 
 static inline int change_setting(struct bladerf *dev, uint8_t setting)
@@ -337,7 +614,36 @@ static bool usb_matches(bladerf_backend backend)
     return backend == BLADERF_BACKEND_ANY ||
            backend == BLADERF_BACKEND_LINUX ||
            backend == BLADERF_BACKEND_LIBUSB ||
-           backend == BLADERF_BACKEND_CYPRESS;
+           backend == BLADERF_BACKEND_CYPRESS ||
+           backend == BLADERF_BACKEND_USBFS;
+}
+
+/* A device may be accessible via more than one USB driver (e.g., libusb and
+ * usbfs). Only list it for the first, and most preferred, of these. Entries
+ * in [usb_start, drv_start) were added by previously probed drivers. */
+static void remove_duplicate_devices(struct bladerf_devinfo_list *info_list,
+                                     size_t usb_start, size_t drv_start)
+{
+    size_t i, j, n;
+
+    for (i = n = drv_start; i < info_list->num_elt; i++) {
+        bool duplicate = false;
+
+        for (j = usb_start; j < drv_start && !duplicate; j++) {
+            duplicate = bladerf_bus_addr_matches(&info_list->elt[j],
+                                                 &info_list->elt[i]);
+        }
+
+        if (!duplicate) {
+            if (n != i) {
+                memcpy(&info_list->elt[n], &info_list->elt[i],
+                       sizeof(info_list->elt[n]));
+            }
+            n++;
+        }
+    }
+
+    info_list->num_elt = n;
 }
 
 static int usb_probe(backend_probe_target probe_target,
@@ -345,9 +651,13 @@ static int usb_probe(backend_probe_target probe_target,
 {
     int status;
     size_t i;
+    const size_t usb_start = info_list->num_elt;
 
     for (i = status = 0; i < ARRAY_SIZE(usb_driver_list); i++) {
+        const size_t drv_start = info_list->num_elt;
+
         status = usb_driver_list[i]->fn->probe(probe_target, info_list);
+        remove_duplicate_devices(info_list, usb_start, drv_start);
     }
 
     return status;
@@ -409,6 +719,8 @@ static int usb_open(struct bladerf *dev, struct bladerf_devinfo *info)
     dev->fn = &backend_fns_usb;
     dev->backend = usb;
 
+    usb->timestamp[0] = usb->timestamp[1] = 0;
+
     status = BLADERF_ERR_NODEV;
     for (i = 0; i < ARRAY_SIZE(usb_driver_list) && status == BLADERF_ERR_NODEV; i++) {
         if (info->backend == BLADERF_BACKEND_ANY ||
@@ -500,11 +812,12 @@ error:
     return status;
 }
 
-static int begin_fpga_programming(struct bladerf *dev)
+static int begin_fpga_programming(struct bladerf *dev, bool compressed)
 {
-    int result;
-    int status = vendor_cmd_int(dev, BLADE_USB_CMD_BEGIN_PROG,
-                                USB_DIR_DEVICE_TO_HOST, &result);
+    int32_t result;
+    const uint16_t flags = compressed ? BLADE_FPGA_LOAD_COMPRESSED : 0;
+    int status = vendor_cmd_int_wvalue(dev, BLADE_USB_CMD_BEGIN_PROG,
+                                       flags, &result);
 
     if (status != 0) {
         return status;
@@ -516,15 +829,85 @@ static int begin_fpga_programming(struct bladerf *dev)
     }
 }
 
+/* Poll the FPGA status to determine if programming was a success. The FPGA
+ * typically finishes configuring shortly after the last of the bitstream is
+ * sent, so polling starts out quickly and then backs off. */
+static int wait_for_fpga_configured(struct bladerf *dev)
+{
+    int status;
+    unsigned int delay_us = FPGA_CONFIG_POLL_MIN_US;
+    unsigned int waited_us = 0;
+
+    while (true) {
+        status = usb_is_fpga_configured(dev);
+        if (status == 1) {
+            log_verbose("FPGA configured after ~%u us\n", waited_us);
+            return 0;
+        } else if (status < 0) {
+            log_debug("Failed to determine if FPGA is loaded: %s\n",
+                      bladerf_strerror(status));
+            return status;
+        } else if (waited_us >= (FPGA_CONFIG_TIMEOUT_MS * 1000)) {
+            log_debug("Timeout while waiting for FPGA configuration status\n");
+            return BLADERF_ERR_TIMEOUT;
+        }
+
+        usleep(delay_us);
+        waited_us += delay_us;
+
+        delay_us *= 2;
+        if (delay_us > FPGA_CONFIG_POLL_MAX_US) {
+            delay_us = FPGA_CONFIG_POLL_MAX_US;
+        }
+    }
+}
+
+static int usb_get_fpga_load_time(struct bladerf *dev, unsigned int *ms)
+{
+    int status;
+    int32_t result;
+
+    if (version_less_than(&dev->fw_version, 1, 9, 0)) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    status = vendor_cmd_int(dev, BLADE_USB_CMD_GET_FPGA_LOAD_TIME,
+                            USB_DIR_DEVICE_TO_HOST, &result);
+    if (status != 0) {
+        return status;
+    }
+
+    result = LE32_TO_HOST(result);
+    if (result < 0) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    *ms = (unsigned int) result;
+    return 0;
+}
+
 static int usb_load_fpga(struct bladerf *dev, uint8_t *image, size_t image_size)
 {
     void *driver;
     struct bladerf_usb *usb = usb_backend(dev, &driver);
 
-    unsigned int wait_count;
     const unsigned int timeout_ms = (2 * CTRL_TIMEOUT_MS);
+    const bool fw_1_9 = version_greater_or_equal(&dev->fw_version, 1, 9, 0);
+    const bool compressed = fpga_is_compressed(dev, image_size);
+    bladerf_dev_speed speed = BLADERF_DEVICE_SPEED_UNKNOWN;
+    unsigned int load_ms;
     int status;
 
+    if (compressed) {
+        if (version_less_than(&dev->fw_version, 1, 10, 0)) {
+            log_warning("FX3 firmware v1.10.0 or later is required to load "
+                        "a compressed FPGA bitstream.\n");
+            return BLADERF_ERR_UPDATE_FW;
+        }
+
+        log_verbose("Loading a compressed FPGA bitstream\n");
+    }
+
     /* Switch to the FPGA configuration interface */
     status = change_setting(dev, USB_IF_CONFIG);
     if(status < 0) {
@@ -534,7 +917,7 @@ static int usb_load_fpga(struct bladerf *dev, uint8_t *image, size_t image_size)
     }
 
     /* Begin programming */
-    status = begin_fpga_programming(dev);
+    status = begin_fpga_programming(dev, compressed);
     if (status < 0) {
         log_debug("Failed to initiate FPGA programming: %s\n",
                   bladerf_strerror(status));
@@ -543,36 +926,43 @@ static int usb_load_fpga(struct bladerf *dev, uint8_t *image, size_t image_size)
 
     /* Send the file down */
     assert(image_size <= UINT32_MAX);
-    status = usb->fn->bulk_transfer(driver, PERIPHERAL_EP_OUT, image,
-                                    (uint32_t)image_size, timeout_ms);
+    MUTEX_LOCK(&dev->xfer_lock);
+    status = bulk_transfer(dev, BLADERF_TRACE_TARGET_FPGA, PERIPHERAL_EP_OUT,
+                           image, (uint32_t)image_size, timeout_ms);
     if (status < 0) {
         log_debug("Failed to write FPGA bitstream to FPGA: %s\n",
                   bladerf_strerror(status));
-        return status;
     }
 
-    /* Poll FPGA status to determine if programming was a success */
-    wait_count = 10;
-    status = 0;
+    /* The firmware receives several packets into each DMA buffer, so it
+     * needs a ZLP to commit a bitstream that ends on a packet boundary */
+    if (status == 0 && fw_1_9 && usb->fn->get_speed(driver, &speed) == 0) {
+        const size_t pkt_size =
+            (speed == BLADERF_DEVICE_SPEED_SUPER) ? 1024 : 512;
 
-    while (wait_count > 0 && status == 0) {
-        status = usb_is_fpga_configured(dev);
-        if (status == 1) {
-            break;
+        if ((image_size % pkt_size) == 0) {
+            status = bulk_transfer(dev, BLADERF_TRACE_TARGET_FPGA,
+                                   PERIPHERAL_EP_OUT, image, 0, timeout_ms);
+            if (status < 0) {
+                log_debug("Failed to terminate FPGA bitstream: %s\n",
+                          bladerf_strerror(status));
+            }
         }
-
-        usleep(200000);
-        wait_count--;
     }
+    MUTEX_UNLOCK(&dev->xfer_lock);
 
-    /* Failed to determine if FPGA is loaded */
     if (status < 0) {
-        log_debug("Failed to determine if FPGA is loaded: %s\n",
-                  bladerf_strerror(status));
         return status;
-    } else if (wait_count == 0 && status != 0) {
-        log_debug("Timeout while waiting for FPGA configuration status\n");
-        return BLADERF_ERR_TIMEOUT;
+    }
+
+    status = wait_for_fpga_configured(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    if (fw_1_9 && usb_get_fpga_load_time(dev, &load_ms) == 0) {
+        log_verbose("Device reports FPGA configuration took %u ms\n",
+                    load_ms);
     }
 
     return rflink_and_fpga_version_load(dev);
@@ -581,17 +971,15 @@ static int usb_load_fpga(struct bladerf *dev, uint8_t *image, size_t image_size)
 static inline int perform_erase(struct bladerf *dev, uint16_t block)
 {
     int status, erase_ret;
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
 
-    status = usb->fn->control_transfer(driver,
-                                        USB_TARGET_DEVICE,
-                                        USB_REQUEST_VENDOR,
-                                        USB_DIR_DEVICE_TO_HOST,
-                                        BLADE_USB_CMD_FLASH_ERASE,
-                                        0, block,
-                                        &erase_ret, sizeof(erase_ret),
-                                        CTRL_TIMEOUT_MS);
+    status = control_transfer(dev,
+                               USB_TARGET_DEVICE,
+                               USB_REQUEST_VENDOR,
+                               USB_DIR_DEVICE_TO_HOST,
+                               BLADE_USB_CMD_FLASH_ERASE,
+                               0, block,
+                               &erase_ret, sizeof(erase_ret),
+                               CTRL_TIMEOUT_MS);
 
 
     return status;
@@ -628,16 +1016,31 @@ error:
     return status != 0 ? status : restore_status;
 }
 
-static inline int read_page(struct bladerf *dev, uint8_t read_operation,
-                            uint16_t page, uint8_t *buf)
+/* Maximum number of flash pages that may be transferred via the firmware's
+ * page buffer with a single read or write request */
+static inline uint16_t flash_pages_per_request(struct bladerf *dev)
+{
+    if (version_greater_or_equal(&dev->fw_version, 1, 9, 0)) {
+        return BLADE_FLASH_MAX_PAGES_PER_REQ;
+    } else {
+        return 1;
+    }
+}
+
+/* Read `count` pages, which must not exceed flash_pages_per_request(). Only
+ * BLADE_USB_CMD_FLASH_READ supports a `count` larger than 1. */
+static inline int read_pages(struct bladerf *dev, uint8_t read_operation,
+                             uint16_t page, uint16_t count, uint8_t *buf)
 {
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
     int status;
     int32_t op_status;
     uint16_t read_size;
     uint16_t offset;
     uint8_t request;
+    const uint16_t len = count * BLADERF_FLASH_PAGE_SIZE;
+
+    assert(count == 1 || (read_operation == BLADE_USB_CMD_FLASH_READ &&
+                          count <= flash_pages_per_request(dev)));
 
     if (dev->usb_speed == BLADERF_DEVICE_SPEED_SUPER) {
         read_size = BLADERF_FLASH_PAGE_SIZE;
@@ -651,7 +1054,9 @@ static inline int read_page(struct bladerf *dev, uint8_t read_operation,
     if (read_operation == BLADE_USB_CMD_FLASH_READ ||
         read_operation == BLADE_USB_CMD_READ_OTP) {
 
-        status = vendor_cmd_int_windex(dev, read_operation, page, &op_status);
+        /* Firmware that predates multi-page support ignores wValue */
+        status = vendor_cmd_int_wvalue_windex(dev, read_operation,
+                                              count, page, &op_status);
         if (status != 0) {
             return status;
         } else if (op_status != 0) {
@@ -671,17 +1076,17 @@ static inline int read_page(struct bladerf *dev, uint8_t read_operation,
     }
 
     /* Retrieve data from the firmware page buffer */
-    for (offset = 0; offset < BLADERF_FLASH_PAGE_SIZE; offset += read_size) {
-        status = usb->fn->control_transfer(driver,
-                                           USB_TARGET_DEVICE,
-                                           USB_REQUEST_VENDOR,
-                                           USB_DIR_DEVICE_TO_HOST,
-                                           request,
-                                           0,
-                                           offset, /* in bytes */
-                                           buf + offset,
-                                           read_size,
-                                           CTRL_TIMEOUT_MS);
+    for (offset = 0; offset < len; offset += read_size) {
+        status = control_transfer(dev,
+                                  USB_TARGET_DEVICE,
+                                  USB_REQUEST_VENDOR,
+                                  USB_DIR_DEVICE_TO_HOST,
+                                  request,
+                                  0,
+                                  offset, /* in bytes */
+                                  buf + offset,
+                                  read_size,
+                                  CTRL_TIMEOUT_MS);
 
         if(status < 0) {
             log_debug("Failed to read page buffer at offset 0x%02x: %s\n",
@@ -698,12 +1103,13 @@ static int usb_read_flash_pages(struct bladerf *dev, uint8_t *buf,
 {
     int status;
     size_t n_read;
-    uint16_t i;
+    uint16_t i, n;
 
     /* 16-bit control transfer fields are used for these.
      * The current bladeRF build only has a 4MiB flash, anyway. */
     const uint16_t page = (uint16_t) page_u32;
     const uint16_t count = (uint16_t) count_u32;
+    const uint16_t max_per_req = flash_pages_per_request(dev);
 
     assert(page == page_u32);
     assert(count == count_u32);
@@ -715,16 +1121,18 @@ static int usb_read_flash_pages(struct bladerf *dev, uint8_t *buf,
 
     log_info("Reading %u pages starting at page %u\n", count, page);
 
-    for (n_read = i = 0; i < count; i++) {
-        log_info("Reading page %u%c", page + i, (i+1) == count ? '\n':'\r' );
+    for (n_read = i = 0; i < count; i += n) {
+        n = (uint16_t) uint_min(count - i, max_per_req);
 
-        status = read_page(dev, BLADE_USB_CMD_FLASH_READ,
-                           page + i, buf + n_read);
+        log_info("Reading page %u%c", page + i, (i+n) == count ? '\n':'\r' );
+
+        status = read_pages(dev, BLADE_USB_CMD_FLASH_READ,
+                            page + i, n, buf + n_read);
         if (status != 0) {
             goto error;
         }
 
-        n_read += BLADERF_FLASH_PAGE_SIZE;
+        n_read += n * BLADERF_FLASH_PAGE_SIZE;
     }
 
     log_info("Done reading %u pages\n", count);
@@ -734,14 +1142,17 @@ error:
     return status;
 }
 
-static int write_page(struct bladerf *dev, uint16_t page, const uint8_t *buf)
+/* Write `count` pages, which must not exceed flash_pages_per_request() */
+static int write_pages(struct bladerf *dev, uint16_t page, uint16_t count,
+                       const uint8_t *buf)
 {
     int status;
     int32_t commit_status;
     uint16_t offset;
     uint16_t write_size;
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
+    const uint16_t len = count * BLADERF_FLASH_PAGE_SIZE;
+
+    assert(count <= flash_pages_per_request(dev));
 
     if (dev->usb_speed == BLADERF_DEVICE_SPEED_SUPER) {
         write_size = BLADERF_FLASH_PAGE_SIZE;
@@ -755,17 +1166,17 @@ static int write_page(struct bladerf *dev, uint16_t page, const uint8_t *buf)
     /* Write the data to the firmware's page buffer.
      * Casting away the buffer's const-ness here is gross, but this buffer
      * will not be written to on an out transfer. */
-    for (offset = 0; offset < BLADERF_FLASH_PAGE_SIZE; offset += write_size) {
-        status = usb->fn->control_transfer(driver,
-                                            USB_TARGET_DEVICE,
-                                            USB_REQUEST_VENDOR,
-                                            USB_DIR_HOST_TO_DEVICE,
-                                            BLADE_USB_CMD_WRITE_PAGE_BUFFER,
-                                            0,
-                                            offset,
-                                            (uint8_t*)&buf[offset],
-                                            write_size,
-                                            CTRL_TIMEOUT_MS);
+    for (offset = 0; offset < len; offset += write_size) {
+        status = control_transfer(dev,
+                                   USB_TARGET_DEVICE,
+                                   USB_REQUEST_VENDOR,
+                                   USB_DIR_HOST_TO_DEVICE,
+                                   BLADE_USB_CMD_WRITE_PAGE_BUFFER,
+                                   0,
+                                   offset,
+                                   (uint8_t*)&buf[offset],
+                                   write_size,
+                                   CTRL_TIMEOUT_MS);
 
         if(status < 0) {
             log_error("Failed to write page buffer at offset 0x%02x "
@@ -775,9 +1186,9 @@ static int write_page(struct bladerf *dev, uint16_t page, const uint8_t *buf)
         }
     }
 
-    /* Commit the page to flash */
-    status = vendor_cmd_int_windex(dev, BLADE_USB_CMD_FLASH_WRITE,
-                                   page, &commit_status);
+    /* Commit the pages to flash */
+    status = vendor_cmd_int_wvalue_windex(dev, BLADE_USB_CMD_FLASH_WRITE,
+                                          count, page, &commit_status);
 
     if (status != 0) {
         log_error("Failed to commit page %u: %s\n", page,
@@ -799,13 +1210,14 @@ static int usb_write_flash_pages(struct bladerf *dev, const uint8_t *buf,
 
 {
     int status, restore_status;
-    uint16_t i;
+    uint16_t i, n;
     size_t n_written;
 
     /* 16-bit control transfer fields are used for these.
      * The current bladeRF build only has a 4MiB flash, anyway. */
     const uint16_t page = (uint16_t) page_u32;
     const uint16_t count = (uint16_t) count_u32;
+    const uint16_t max_per_req = flash_pages_per_request(dev);
 
     assert(page == page_u32);
     assert(count == count_u32);
@@ -818,15 +1230,17 @@ static int usb_write_flash_pages(struct bladerf *dev, const uint8_t *buf,
     log_info("Writing %u pages starting at page %u\n", count, page);
 
     n_written = 0;
-    for (i = 0; i < count; i++) {
-        log_info("Writing page %u%c", page + i, (i+1) == count ? '\n':'\r');
+    for (i = 0; i < count; i += n) {
+        n = (uint16_t) uint_min(count - i, max_per_req);
 
-        status = write_page(dev, page + i, buf + n_written);
+        log_info("Writing page %u%c", page + i, (i+n) == count ? '\n':'\r');
+
+        status = write_pages(dev, page + i, n, buf + n_written);
         if (status) {
             goto error;
         }
 
-        n_written += BLADERF_FLASH_PAGE_SIZE;
+        n_written += n * BLADERF_FLASH_PAGE_SIZE;
     }
     log_info("Done writing %u pages\n", count );
 
@@ -841,29 +1255,71 @@ error:
     }
 }
 
-static int usb_device_reset(struct bladerf *dev)
+static int usb_flash_crc32(struct bladerf *dev, uint32_t page_u32,
+                           uint32_t count_u32, uint32_t *crc)
 {
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
+    int status, restore_status;
+    struct bladerf_fx3_crc32 result;
+
+    /* 16-bit control transfer fields are used for these, as with
+     * usb_read_flash_pages() */
+    const uint16_t page = (uint16_t) page_u32;
+    const uint16_t count = (uint16_t) count_u32;
+
+    assert(page == page_u32);
+    assert(count == count_u32);
+
+    if (version_less_than(&dev->fw_version, 1, 9, 0)) {
+        return BLADERF_ERR_UNSUPPORTED;
+    } else if (count == 0 || count > BLADE_FLASH_CRC32_MAX_PAGES) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    status = change_setting(dev, USB_IF_SPI_FLASH);
+    if (status != 0) {
+        return status;
+    }
+
+    status = control_transfer(dev,
+                              USB_TARGET_DEVICE,
+                              USB_REQUEST_VENDOR,
+                              USB_DIR_DEVICE_TO_HOST,
+                              BLADE_USB_CMD_FLASH_CRC32,
+                              count, page,
+                              &result, sizeof(result),
+                              CTRL_TIMEOUT_MS);
+    if (status != 0) {
+        log_debug("Flash CRC request failed at page %u: %s\n",
+                  page, bladerf_strerror(status));
+    } else if (LE32_TO_HOST(result.status) != 0) {
+        log_debug("Firmware failed to compute CRC at page %u: %d\n",
+                  page, (int) LE32_TO_HOST(result.status));
+        status = BLADERF_ERR_UNEXPECTED;
+    } else {
+        *crc = LE32_TO_HOST(result.crc);
+    }
+
+    restore_status = restore_post_flash_setting(dev);
+    return status != 0 ? status : restore_status;
+}
 
-    return usb->fn->control_transfer(driver, USB_TARGET_DEVICE,
-                                      USB_REQUEST_VENDOR,
-                                      USB_DIR_HOST_TO_DEVICE,
-                                      BLADE_USB_CMD_RESET,
-                                      0, 0, 0, 0, CTRL_TIMEOUT_MS);
+static int usb_device_reset(struct bladerf *dev)
+{
+    return control_transfer(dev, USB_TARGET_DEVICE,
+                             USB_REQUEST_VENDOR,
+                             USB_DIR_HOST_TO_DEVICE,
+                             BLADE_USB_CMD_RESET,
+                             0, 0, 0, 0, CTRL_TIMEOUT_MS);
 
 }
 
 static int usb_jump_to_bootloader(struct bladerf *dev)
 {
-    void *driver;
-    struct bladerf_usb *usb = usb_backend(dev, &driver);
-
-    return usb->fn->control_transfer(driver, USB_TARGET_DEVICE,
-                                      USB_REQUEST_VENDOR,
-                                      USB_DIR_HOST_TO_DEVICE,
-                                      BLADE_USB_CMD_JUMP_TO_BOOTLOADER,
-                                      0, 0, 0, 0, CTRL_TIMEOUT_MS);
+    return control_transfer(dev, USB_TARGET_DEVICE,
+                             USB_REQUEST_VENDOR,
+                             USB_DIR_HOST_TO_DEVICE,
+                             BLADE_USB_CMD_JUMP_TO_BOOTLOADER,
+                             0, 0, 0, 0, CTRL_TIMEOUT_MS);
 }
 
 static int usb_get_cal(struct bladerf *dev, char *cal)
@@ -878,8 +1334,8 @@ static int usb_get_cal(struct bladerf *dev, char *cal)
         return status;
     }
 
-    status = read_page(dev, BLADE_USB_CMD_READ_CAL_CACHE,
-                       dummy_page, (uint8_t*)cal);
+    status = read_pages(dev, BLADE_USB_CMD_READ_CAL_CACHE,
+                        dummy_page, 1, (uint8_t*)cal);
 
     restore_status = restore_post_flash_setting(dev);
     return status == 0 ? restore_status : status;
@@ -895,7 +1351,8 @@ static int usb_get_otp(struct bladerf *dev, char *otp)
         return status;
     }
 
-    status = read_page(dev, BLADE_USB_CMD_READ_OTP, dummy_page, (uint8_t*)otp);
+    status = read_pages(dev, BLADE_USB_CMD_READ_OTP,
+                        dummy_page, 1, (uint8_t*)otp);
     restore_status = restore_post_flash_setting(dev);
     return status == 0 ? restore_status : status;
 }
@@ -983,9 +1440,7 @@ static int set_fpga_correction(struct bladerf *dev,
                                bladerf_correction corr,
                                uint8_t addr, int16_t value)
 {
-    int i;
     int status;
-    struct uart_cmd cmd;
 
     /* If this is a gain correction add in the 1.0 value so 0 correction yields
      * an unscaled gain */
@@ -993,13 +1448,8 @@ static int set_fpga_correction(struct bladerf *dev,
         value += (int16_t)4096;
     }
 
-    for (i = status = 0; status == 0 && i < 2; i++) {
-        cmd.addr = i + addr;
-
-        cmd.data = (value >> (i * 8)) & 0xff;
-        status = access_peripheral(dev, UART_PKT_DEV_GPIO,
-                                   USB_DIR_HOST_TO_DEVICE, &cmd, 1);
-    }
+    status = peripheral_write_bytes(dev, UART_PKT_DEV_GPIO, addr,
+                                    sizeof(value), (uint16_t)value);
 
     return status;
 }
@@ -1039,58 +1489,626 @@ static int usb_lms_read(struct bladerf *dev, uint8_t addr, uint8_t *data)
     return status;
 }
 
-static int set_lms_correction(struct bladerf *dev, bladerf_module module,
-                              uint8_t addr, int16_t value)
+static int usb_lms_access_batch(struct bladerf *dev,
+                                struct backend_reg_access *regs, size_t count)
 {
-    int status;
-    uint8_t tmp;
-
-    status = usb_lms_read(dev, addr, &tmp);
-    if (status != 0) {
-        return status;
-    }
+    return access_peripheral_batch(dev, UART_PKT_DEV_LMS, regs, count);
+}
 
-    /* Mask out any control bits in the RX DC correction area */
-    if (module == BLADERF_MODULE_RX) {
+/* Send `num_pkts` prepared peripheral requests, PERIPHERAL_PIPELINE_DEPTH at
+ * a time, and collect their ACKs. The last ACK is left in `ack`. */
+static int send_peripheral_requests(struct bladerf *dev, uint8_t *pkts,
+                                    size_t num_pkts, uint8_t *ack)
+{
+    int status = 0;
+    size_t i, n, sent;
+    const bool coalesce = version_greater_or_equal(&dev->fw_version, 1, 9, 0);
 
-        /* Bit 7 is unrelated to lms dc correction, save its state */
-        tmp = tmp & (1 << 7);
+    MUTEX_LOCK(&dev->xfer_lock);
 
-        /* RX only has 6 bits of scale to work with, remove normalization */
-        value >>= 5;
+    while (num_pkts != 0) {
+        n = min_sz(num_pkts, PERIPHERAL_PIPELINE_DEPTH);
+        sent = 0;
 
-        if (value < 0) {
-            value = (value <= -64) ? 0x3f :  (abs(value) & 0x3f);
-            /*This register uses bit 6 to denote a negative gain */
-            value |= (1 << 6);
+        if (coalesce) {
+            status = bulk_transfer(dev, BLADERF_TRACE_TARGET_LMS,
+                                   PERIPHERAL_EP_OUT,
+                                   pkts, n * PERIPHERAL_PKT_SIZE,
+                                   PERIPHERAL_TIMEOUT_MS);
+            if (status == 0) {
+                sent = n;
+            }
         } else {
-            value = (value >= 64) ? 0x3f : (value & 0x3f);
+            for (i = 0; i < n && status == 0; i++) {
+                status = bulk_transfer(dev, BLADERF_TRACE_TARGET_LMS,
+                                       PERIPHERAL_EP_OUT,
+                                       &pkts[i * PERIPHERAL_PKT_SIZE],
+                                       PERIPHERAL_PKT_SIZE,
+                                       PERIPHERAL_TIMEOUT_MS);
+                if (status == 0) {
+                    sent++;
+                }
+            }
         }
 
-        value |= tmp;
-    } else {
-
-        /* TX only has 7 bits of scale to work with, remove normalization */
-        value >>= 4;
-
-        /* LMS6002D 0x00 = -16, 0x80 = 0, 0xff = 15.9375 */
-        if (value >= 0) {
-            tmp = (value >= 128) ? 0x7f : (value & 0x7f);
-            /* Assert bit 7 for positive numbers */
-            value = (1 << 7) + tmp;
-        } else {
-            value = (value <= -128) ? 0x00 : (value & 0x7f);
+        if (status != 0) {
+            log_debug("Failed to write peripheral sequence request: %s\n",
+                      bladerf_strerror(status));
         }
-    }
 
-    status = usb_lms_write(dev, addr, (uint8_t)value);
-    if (status < 0) {
+        dev->ctrl_requests += sent;
+
+        /* Drain the ACKs of whatever was sent, even after a failure */
+        for (i = 0; i < sent; i++) {
+            int ack_status = bulk_transfer(dev, BLADERF_TRACE_TARGET_LMS,
+                                           PERIPHERAL_EP_IN,
+                                           ack, PERIPHERAL_PKT_SIZE,
+                                           PERIPHERAL_TIMEOUT_MS);
+            if (ack_status != 0) {
+                log_debug("Failed to read peripheral sequence ACK: %s\n",
+                          bladerf_strerror(ack_status));
+                if (status == 0) {
+                    status = ack_status;
+                }
+            }
+        }
+
+        if (status != 0) {
+            break;
+        }
+
+        pkts += n * PERIPHERAL_PKT_SIZE;
+        num_pkts -= n;
+    }
+
+    MUTEX_UNLOCK(&dev->xfer_lock);
+    return status;
+}
+
+static void build_sequence_request(uint8_t *buf, uint8_t request,
+                                   const uint8_t *payload, size_t len)
+{
+    memset(buf, 0, PERIPHERAL_PKT_SIZE);
+    buf[0] = UART_PKT_MAGIC;
+
+    /* The NIOS expects at least one command in every request */
+    buf[1] = UART_PKT_MODE_DIR_SEQ | request |
+             (uint8_t) (len == 0 ? 1 : (len + 1) / 2);
+
+    memcpy(&buf[2], payload, len);
+}
+
+/* Run a sequence of LMS6002D accesses on the NIOS. The program is appended
+ * in full-payload pieces, preceded by a clear and followed by the run
+ * request, all of which are pipelined. Results beyond those returned by the
+ * run request are fetched afterwards. */
+static int usb_lms_sequence(struct bladerf *dev, struct backend_seq_op *ops,
+                            unsigned int count)
+{
+    int status;
+    unsigned int i, r;
+    size_t len = 0, off, n;
+    size_t num_pkts = 0;
+    uint8_t prog[UART_PKT_SEQ_PROG_LEN];
+    uint8_t results[UART_PKT_SEQ_RESULTS_LEN];
+    unsigned int num_results, expected = 0;
+    uint8_t seq_status, completed;
+    uint8_t ack[PERIPHERAL_PKT_SIZE];
+
+    /* Clear, the program in pieces, and run */
+    uint8_t pkts[PERIPHERAL_PKT_SIZE *
+                 (2 + (UART_PKT_SEQ_PROG_LEN + 13) / 14)];
+
+    const size_t payload_len = PERIPHERAL_PKT_SIZE - 2;
+
+    for (i = 0; i < count; i++) {
+        const size_t op_len[] = { 3, 2, 4, 5 };
+        const uint8_t opcode[] = {
+            UART_PKT_SEQ_OP_WRITE, UART_PKT_SEQ_OP_READ,
+            UART_PKT_SEQ_OP_MODIFY, UART_PKT_SEQ_OP_POLL
+        };
+
+        if ((unsigned int) ops[i].type > BACKEND_SEQ_POLL) {
+            return BLADERF_ERR_INVAL;
+        } else if (len + op_len[ops[i].type] > sizeof(prog)) {
+            log_debug("LMS sequence does not fit in the NIOS program buffer\n");
+            return BLADERF_ERR_INVAL;
+        }
+
+        prog[len++] = opcode[ops[i].type];
+        prog[len++] = ops[i].addr;
+
+        switch (ops[i].type) {
+            case BACKEND_SEQ_WRITE:
+                prog[len++] = ops[i].data;
+                break;
+
+            case BACKEND_SEQ_READ:
+                expected++;
+                break;
+
+            case BACKEND_SEQ_MODIFY:
+                prog[len++] = ops[i].mask;
+                prog[len++] = ops[i].data;
+                break;
+
+            case BACKEND_SEQ_POLL:
+                prog[len++] = ops[i].mask;
+                prog[len++] = ops[i].data;
+                prog[len++] = ops[i].tries;
+                expected++;
+                break;
+        }
+    }
+
+    if (expected > UART_PKT_SEQ_RESULTS_LEN) {
+        log_debug("LMS sequence has too many results\n");
+        return BLADERF_ERR_INVAL;
+    }
+
+    build_sequence_request(&pkts[0], UART_PKT_SEQ_CLEAR, NULL, 0);
+    num_pkts++;
+
+    for (off = 0; off < len; off += n) {
+        n = min_sz(len - off, payload_len);
+        build_sequence_request(&pkts[num_pkts * PERIPHERAL_PKT_SIZE],
+                               UART_PKT_SEQ_APPEND, &prog[off], n);
+        num_pkts++;
+    }
+
+    build_sequence_request(&pkts[num_pkts * PERIPHERAL_PKT_SIZE],
+                           UART_PKT_SEQ_RUN, NULL, 0);
+    num_pkts++;
+
+    status = send_peripheral_requests(dev, pkts, num_pkts, ack);
+    if (status != 0) {
         return status;
     }
 
+    seq_status = ack[2];
+    completed = ack[3];
+    num_results = uint_min(ack[4], UART_PKT_SEQ_RESULTS_LEN);
+    memcpy(results, &ack[5], uint_min(num_results, UART_PKT_SEQ_RUN_RESULTS));
+
+    for (r = UART_PKT_SEQ_RUN_RESULTS; r < num_results; r += payload_len) {
+        uint8_t offset = (uint8_t) r;
+
+        build_sequence_request(pkts, UART_PKT_SEQ_RESULTS, &offset, 1);
+        status = send_peripheral_requests(dev, pkts, 1, ack);
+        if (status != 0) {
+            return status;
+        }
+
+        memcpy(&results[r], &ack[2], min_sz(num_results - r, payload_len));
+    }
+
+    for (i = 0, r = 0; i < count && r < num_results; i++) {
+        if (ops[i].type == BACKEND_SEQ_READ ||
+            ops[i].type == BACKEND_SEQ_POLL) {
+            ops[i].data = results[r++];
+        }
+    }
+
+    log_verbose("%s: %u ops, %u completed, status %u\n", __FUNCTION__,
+                count, completed, seq_status);
+
+    switch (seq_status) {
+        case UART_PKT_SEQ_STATUS_OK:
+            return 0;
+
+        case UART_PKT_SEQ_STATUS_TIMEOUT:
+            return BLADERF_ERR_TIMEOUT;
+
+        default:
+            log_debug("NIOS rejected LMS sequence: status %u\n", seq_status);
+            return BLADERF_ERR_UNEXPECTED;
+    }
+}
+
+/* FPGA image identifier register window, kept by the NIOS */
+#define IMAGE_ID_ADDR           64
+
+static int usb_get_fpga_image_id(struct bladerf *dev, uint64_t *id)
+{
+    int status;
+    uint32_t low, high;
+
+    status = peripheral_read_bytes(dev, UART_PKT_DEV_GPIO,
+                                   IMAGE_ID_ADDR, 4, &low);
+    if (status == 0) {
+        status = peripheral_read_bytes(dev, UART_PKT_DEV_GPIO,
+                                       IMAGE_ID_ADDR + 4, 4, &high);
+    }
+
+    if (status == 0) {
+        *id = ((uint64_t) high << 32) | low;
+    }
+
     return status;
 }
 
+static int usb_set_fpga_image_id(struct bladerf *dev, uint64_t id)
+{
+    int status;
+
+    status = peripheral_write_bytes(dev, UART_PKT_DEV_GPIO, IMAGE_ID_ADDR, 4,
+                                    (uint32_t) id);
+    if (status == 0) {
+        status = peripheral_write_bytes(dev, UART_PKT_DEV_GPIO,
+                                        IMAGE_ID_ADDR + 4, 4,
+                                        (uint32_t) (id >> 32));
+    }
+
+    return status;
+}
+
+/* RX DDC NCO phase increment register, kept by the NIOS */
+#define RX_NCO_ADDR             72
+
+static int usb_get_rx_nco(struct bladerf *dev, int32_t *dphase)
+{
+    int status;
+    uint32_t val;
+
+    status = peripheral_read_bytes(dev, UART_PKT_DEV_GPIO, RX_NCO_ADDR, 4,
+                                   &val);
+    if (status == 0) {
+        *dphase = (int32_t) val;
+    }
+
+    return status;
+}
+
+static int usb_set_rx_nco(struct bladerf *dev, int32_t dphase)
+{
+    return peripheral_write_bytes(dev, UART_PKT_DEV_GPIO, RX_NCO_ADDR, 4,
+                                  (uint32_t) dphase);
+}
+
+/* Channelizer RX channel mask register, kept by the NIOS */
+#define RX_CHANNELS_ADDR        76
+
+static int usb_get_rx_channels(struct bladerf *dev, uint32_t *mask)
+{
+    return peripheral_read_bytes(dev, UART_PKT_DEV_GPIO, RX_CHANNELS_ADDR, 4,
+                                 mask);
+}
+
+static int usb_set_rx_channels(struct bladerf *dev, uint32_t mask)
+{
+    return peripheral_write_bytes(dev, UART_PKT_DEV_GPIO, RX_CHANNELS_ADDR, 4,
+                                  mask);
+}
+
+/* RX tracking estimates. The NIOS captures both words when the first byte is
+ * read, so the DC word must be read first. */
+#define RX_TRACK_DC_ADDR        80
+#define RX_TRACK_IQ_ADDR        84
+
+static int usb_get_rx_tracking(struct bladerf *dev,
+                               struct bladerf_rx_tracking *state)
+{
+    int status;
+    uint32_t dc, iq;
+
+    status = peripheral_read_bytes(dev, UART_PKT_DEV_GPIO, RX_TRACK_DC_ADDR, 4,
+                                   &dc);
+    if (status != 0) {
+        return status;
+    }
+
+    status = peripheral_read_bytes(dev, UART_PKT_DEV_GPIO, RX_TRACK_IQ_ADDR, 4,
+                                   &iq);
+    if (status != 0) {
+        return status;
+    }
+
+    state->dc_i  = (int16_t) (dc & 0xffff);
+    state->dc_q  = (int16_t) (dc >> 16);
+    state->gain  = (int16_t) (iq & 0xffff);
+    state->phase = (int16_t) (iq >> 16);
+
+    return 0;
+}
+
+/* Sample format register, kept by the NIOS */
+#define SAMPLE_FMT_ADDR         88
+
+static int usb_get_sample_fmt(struct bladerf *dev, uint32_t *fmt)
+{
+    return peripheral_read_bytes(dev, UART_PKT_DEV_GPIO, SAMPLE_FMT_ADDR, 4,
+                                 fmt);
+}
+
+static int usb_set_sample_fmt(struct bladerf *dev, uint32_t fmt)
+{
+    return peripheral_write_bytes(dev, UART_PKT_DEV_GPIO, SAMPLE_FMT_ADDR, 4,
+                                  fmt);
+}
+
+/* Sample FIFO level marks and depths. The NIOS captures both words when the
+ * first byte is read, so the levels word must be read first. */
+#define FIFO_LEVELS_ADDR        92
+#define FIFO_DEPTH_ADDR         96
+
+static int usb_get_fifo_levels(struct bladerf *dev,
+                               struct bladerf_fifo_levels *levels)
+{
+    int status;
+    uint32_t marks, depths;
+
+    status = peripheral_read_bytes(dev, UART_PKT_DEV_GPIO, FIFO_LEVELS_ADDR, 4,
+                                   &marks);
+    if (status != 0) {
+        return status;
+    }
+
+    status = peripheral_read_bytes(dev, UART_PKT_DEV_GPIO, FIFO_DEPTH_ADDR, 4,
+                                   &depths);
+    if (status != 0) {
+        return status;
+    }
+
+    levels->rx_depth      = 1u << (depths & 0xff);
+    levels->rx_high_water = marks & 0xffff;
+    levels->tx_depth      = 1u << ((depths >> 8) & 0xff);
+    levels->tx_low_water  = marks >> 16;
+
+    return 0;
+}
+
+/* Late TX message count and worst lateness */
+#define TX_LATE_ADDR            116
+
+static int usb_get_tx_late(struct bladerf *dev, uint32_t *val)
+{
+    return peripheral_read_bytes(dev, UART_PKT_DEV_GPIO, TX_LATE_ADDR, 4, val);
+}
+
+#define TX_UNDERFLOWS_ADDR      120
+
+static int usb_get_tx_underflows(struct bladerf *dev, uint32_t *count)
+{
+    return peripheral_read_bytes(dev, UART_PKT_DEV_GPIO, TX_UNDERFLOWS_ADDR,
+                                 4, count);
+}
+
+/* Timestamp latch configuration, load value, and the snapshot of the RX
+ * time, TX time and status that the NIOS takes when its first byte is
+ * read */
+#define TIME_LATCH_CFG_ADDR     124
+#define TIME_LATCH_LOAD_ADDR    128
+#define TIME_LATCH_ADDR         136
+#define TIME_LATCH_LEN          20
+
+static int usb_set_time_latch(struct bladerf *dev, uint32_t cfg, uint64_t load)
+{
+    struct backend_reg_access regs[8 + 4];
+    size_t i;
+
+    /* The NIOS applies the configuration once its last byte is written, by
+     * which point the load value is in place */
+    for (i = 0; i < ARRAY_SIZE(regs); i++) {
+        regs[i].write = true;
+        if (i < 8) {
+            regs[i].addr = TIME_LATCH_LOAD_ADDR + (uint8_t) i;
+            regs[i].data = (load >> (8 * i)) & 0xff;
+        } else {
+            regs[i].addr = TIME_LATCH_CFG_ADDR + (uint8_t) (i - 8);
+            regs[i].data = (cfg >> (8 * (i - 8))) & 0xff;
+        }
+    }
+
+    return access_peripheral_batch(dev, UART_PKT_DEV_GPIO, regs,
+                                   ARRAY_SIZE(regs));
+}
+
+static int usb_get_time_latch(struct bladerf *dev, uint64_t *rx, uint64_t *tx,
+                              uint32_t *status_out)
+{
+    int status;
+    struct backend_reg_access regs[TIME_LATCH_LEN];
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(regs); i++) {
+        regs[i].write = false;
+        regs[i].addr = TIME_LATCH_ADDR + (uint8_t) i;
+        regs[i].data = 0xff;
+    }
+
+    status = access_peripheral_batch(dev, UART_PKT_DEV_GPIO, regs,
+                                     ARRAY_SIZE(regs));
+    if (status != 0) {
+        return status;
+    }
+
+    *rx = *tx = 0;
+    for (i = 0; i < sizeof(*rx); i++) {
+        *rx |= (uint64_t) regs[i].data << (8 * i);
+        *tx |= (uint64_t) regs[8 + i].data << (8 * i);
+    }
+
+    *status_out = 0;
+    for (i = 0; i < sizeof(*status_out); i++) {
+        *status_out |= (uint32_t) regs[16 + i].data << (8 * i);
+    }
+
+    return 0;
+}
+
+/* RX trigger registers */
+#define RX_TRIGGER_CTRL_ADDR    100
+#define RX_TRIGGER_LEVEL_ADDR   104
+#define RX_TRIGGER_POST_ADDR    108
+#define RX_TRIGGER_STATUS_ADDR  112
+
+static int usb_get_rx_trigger(struct bladerf *dev, uint32_t *ctrl,
+                              uint32_t *level, uint32_t *post)
+{
+    int status;
+
+    status = peripheral_read_bytes(dev, UART_PKT_DEV_GPIO, RX_TRIGGER_CTRL_ADDR,
+                                   4, ctrl);
+    if (status != 0) {
+        return status;
+    }
+
+    status = peripheral_read_bytes(dev, UART_PKT_DEV_GPIO,
+                                   RX_TRIGGER_LEVEL_ADDR, 4, level);
+    if (status != 0) {
+        return status;
+    }
+
+    return peripheral_read_bytes(dev, UART_PKT_DEV_GPIO, RX_TRIGGER_POST_ADDR,
+                                 4, post);
+}
+
+/* The control register is written last, so the trigger is only enabled once
+ * its settings are in place */
+static int usb_set_rx_trigger(struct bladerf *dev, uint32_t ctrl,
+                              uint32_t level, uint32_t post)
+{
+    int status;
+
+    status = peripheral_write_bytes(dev, UART_PKT_DEV_GPIO,
+                                    RX_TRIGGER_LEVEL_ADDR, 4, level);
+    if (status != 0) {
+        return status;
+    }
+
+    status = peripheral_write_bytes(dev, UART_PKT_DEV_GPIO,
+                                    RX_TRIGGER_POST_ADDR, 4, post);
+    if (status != 0) {
+        return status;
+    }
+
+    return peripheral_write_bytes(dev, UART_PKT_DEV_GPIO, RX_TRIGGER_CTRL_ADDR,
+                                  4, ctrl);
+}
+
+static int usb_get_rx_trigger_status(struct bladerf *dev, uint32_t *status)
+{
+    return peripheral_read_bytes(dev, UART_PKT_DEV_GPIO, RX_TRIGGER_STATUS_ADDR,
+                                 4, status);
+}
+
+/* Scheduled retune register window. See the NIOS lms_spi_controller
+ * firmware for a description of its layout. */
+#define RETUNE_ADDR             48
+#define RETUNE_ADDR_TIMESTAMP   (RETUNE_ADDR + 0)
+#define RETUNE_ADDR_PAYLOAD     (RETUNE_ADDR + 8)
+#define RETUNE_ADDR_CTRL        (RETUNE_ADDR + 15)
+#define RETUNE_FLAG_WRITES      0x80
+#define RETUNE_FLAG_XB200       0x40
+
+/* Stage and queue an entry in the FPGA's retune queue. `payload` holds the
+ * 6 bytes of window offsets 8 - 13, and `module` is written to offset 14. */
+static int queue_scheduled_entry(struct bladerf *dev, uint64_t timestamp,
+                                 const uint8_t payload[6], uint8_t module)
+{
+    int status;
+    uint32_t free_entries;
+
+    status = peripheral_read_bytes(dev, UART_PKT_DEV_GPIO, RETUNE_ADDR_CTRL,
+                                   1, &free_entries);
+    if (status != 0) {
+        return status;
+    }
+
+    if (free_entries == 0) {
+        log_debug("FPGA retune queue is full\n");
+        return BLADERF_ERR_QUEUE_FULL;
+    }
+
+    status = peripheral_write_bytes(dev, UART_PKT_DEV_GPIO,
+                                    RETUNE_ADDR_TIMESTAMP, 4,
+                                    (uint32_t)timestamp);
+    if (status != 0) {
+        return status;
+    }
+
+    status = peripheral_write_bytes(dev, UART_PKT_DEV_GPIO,
+                                    RETUNE_ADDR_TIMESTAMP + 4, 4,
+                                    (uint32_t)(timestamp >> 32));
+    if (status != 0) {
+        return status;
+    }
+
+    status = peripheral_write_bytes(dev, UART_PKT_DEV_GPIO,
+                                    RETUNE_ADDR_PAYLOAD, 4,
+                                    payload[0] |
+                                    (payload[1] << 8) |
+                                    (payload[2] << 16) |
+                                    ((uint32_t)payload[3] << 24));
+    if (status != 0) {
+        return status;
+    }
+
+    /* Writing the control byte queues the staged entry */
+    return peripheral_write_bytes(dev, UART_PKT_DEV_GPIO,
+                                  RETUNE_ADDR_PAYLOAD + 4, 4,
+                                  payload[4] |
+                                  (payload[5] << 8) |
+                                  ((uint32_t)module << 16));
+}
+
+static int usb_schedule_retune(struct bladerf *dev, bladerf_module module,
+                               uint64_t timestamp,
+                               const struct backend_retune *regs)
+{
+    uint8_t payload[6];
+
+    memcpy(payload, regs->pll, sizeof(regs->pll));
+    payload[4] = regs->freqsel;
+    payload[5] = regs->vcocap;
+
+    return queue_scheduled_entry(dev, timestamp, payload,
+                                 module == BLADERF_MODULE_RX ? 0 : 1);
+}
+
+static int usb_schedule_lms_writes(struct bladerf *dev, bladerf_module module,
+                                   uint64_t timestamp,
+                                   const struct backend_reg_access *regs,
+                                   size_t count)
+{
+    uint8_t payload[2 * BACKEND_SCHEDULED_WRITES_MAX];
+    size_t i;
+
+    if (count > BACKEND_SCHEDULED_WRITES_MAX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    /* Unused entries are denoted by an invalid address */
+    memset(payload, 0xff, sizeof(payload));
+
+    for (i = 0; i < count; i++) {
+        assert(regs[i].write && regs[i].addr < 0x80);
+        payload[2 * i] = regs[i].addr;
+        payload[2 * i + 1] = regs[i].data;
+    }
+
+    return queue_scheduled_entry(dev, timestamp, payload,
+                                 RETUNE_FLAG_WRITES |
+                                 (module == BLADERF_MODULE_RX ? 0 : 1));
+}
+
+static int usb_schedule_xb200(struct bladerf *dev, bladerf_module module,
+                              uint64_t timestamp, uint32_t gpio, bool mix)
+{
+    uint8_t payload[6];
+
+    payload[0] = gpio & 0xff;
+    payload[1] = (gpio >> 8) & 0xff;
+    payload[2] = (gpio >> 16) & 0xff;
+    payload[3] = (gpio >> 24) & 0xff;
+    payload[4] = mix ? 1 : 0;
+    payload[5] = 0;
+
+    return queue_scheduled_entry(dev, timestamp, payload,
+                                 RETUNE_FLAG_XB200 |
+                                 (module == BLADERF_MODULE_RX ? 0 : 1));
+}
+
 static int usb_set_correction(struct bladerf *dev, bladerf_module module,
                               bladerf_correction corr, int16_t value)
 {
@@ -1106,7 +2124,7 @@ static int usb_set_correction(struct bladerf *dev, bladerf_module module,
             break;
 
         case CORR_LMS:
-            status = set_lms_correction(dev, module, addr, value);
+            status = lms_set_dc_offset(dev, module, corr, value);
             break;
 
         default:
@@ -1121,20 +2139,17 @@ static int usb_set_correction(struct bladerf *dev, bladerf_module module,
 static int get_fpga_correction(struct bladerf *dev, bladerf_correction corr,
                                uint8_t addr, int16_t *value)
 {
-    int i;
     int status;
-    struct uart_cmd cmd;
+    uint32_t tmp;
 
-    *value = 0;
-    for (i = status = 0; status == 0 && i < 2; i++) {
-        cmd.addr = i + addr;
-        cmd.data = 0xff;
-        status = access_peripheral(dev, UART_PKT_DEV_GPIO,
-                                   USB_DIR_DEVICE_TO_HOST, &cmd, 1);
-
-        *value |= (cmd.data << (i * 8));
+    status = peripheral_read_bytes(dev, UART_PKT_DEV_GPIO, addr,
+                                   sizeof(*value), &tmp);
+    if (status != 0) {
+        return status;
     }
 
+    *value = (int16_t)(uint16_t)tmp;
+
     /* Gain corrections have an offset that needs to be accounted for */
     if (corr == BLADERF_CORR_FPGA_GAIN) {
         *value -= 4096;
@@ -1143,35 +2158,6 @@ static int get_fpga_correction(struct bladerf *dev, bladerf_correction corr,
     return status;
 }
 
-static int get_lms_correction(struct bladerf *dev,
-                                bladerf_module module,
-                                uint8_t addr, int16_t *value)
-{
-    uint8_t tmp;
-    int status;
-
-    status = usb_lms_read(dev, addr, &tmp);
-    if (status == 0) {
-        /* Mask out any control bits in the RX DC correction area */
-        if (module == BLADERF_MODULE_RX) {
-            tmp = tmp & 0x7f;
-            if (tmp & (1 << 6)) {
-                *value = -(int16_t)(tmp & 0x3f);
-            } else {
-                *value = (int16_t)(tmp & 0x3f);
-            }
-            /* Renormalize to 2048 */
-            *value <<= 5;
-        } else {
-            *value = (int16_t)tmp;
-            /* Renormalize to 2048 */
-            *value <<= 4;
-        }
-    }
-
-    return status;
-}
-
 static int usb_get_correction(struct bladerf *dev, bladerf_module module,
                               bladerf_correction corr, int16_t *value)
 {
@@ -1183,7 +2169,7 @@ static int usb_get_correction(struct bladerf *dev, bladerf_module module,
 
     switch (type) {
         case CORR_LMS:
-            status = get_lms_correction(dev, module, addr, value);
+            status = lms_get_dc_offset(dev, module, corr, value);
             break;
 
         case CORR_FPGA:
@@ -1197,50 +2183,57 @@ static int usb_get_correction(struct bladerf *dev, bladerf_module module,
     return status;
 }
 
+/* The NIOS limits a request to 7 registers, one shy of the 8 bytes of a
+ * timestamp. The FPGA latches a snapshot of the counter when its least
+ * significant byte is read, and serves each of the other bytes from that
+ * snapshot. Therefore, bytes 0-6 are read in one request, and the most
+ * significant byte is then read from the same snapshot only if the lower 56
+ * bits went backwards, indicating a wrap or a reset of the counter. */
+#define TIMESTAMP_LOW_BYTES 7
+#define TIMESTAMP_LOW_MASK  ((UINT64_C(1) << (8 * TIMESTAMP_LOW_BYTES)) - 1)
+
 int usb_get_timestamp(struct bladerf *dev, bladerf_module mod, uint64_t *value)
 {
+    void *driver;
+    struct bladerf_usb *usb = usb_backend(dev, &driver);
+    uint64_t *prev = &usb->timestamp[mod == BLADERF_MODULE_RX ? 0 : 1];
+
     int status = 0;
-    struct uart_cmd cmds[4];
-    uint8_t timestamp_bytes[8];
+    struct uart_cmd cmds[TIMESTAMP_LOW_BYTES];
+    const uint8_t base = (mod == BLADERF_MODULE_RX ? 16 : 24);
+    uint64_t low = 0, high = *prev & ~TIMESTAMP_LOW_MASK;
     size_t i;
 
     /* Offset 16 is the time tamer according to the Nios firmware */
-    cmds[0].addr = (mod == BLADERF_MODULE_RX ? 16 : 24);
-    cmds[1].addr = (mod == BLADERF_MODULE_RX ? 17 : 25);
-    cmds[2].addr = (mod == BLADERF_MODULE_RX ? 18 : 26);
-    cmds[3].addr = (mod == BLADERF_MODULE_RX ? 19 : 27);
-    cmds[0].data = cmds[1].data = cmds[2].data = cmds[3].data = 0xff;
+    for (i = 0; i < ARRAY_SIZE(cmds); i++) {
+        cmds[i].addr = base + (uint8_t) i;
+        cmds[i].data = 0xff;
+    }
 
     status = access_peripheral(dev, UART_PKT_DEV_GPIO, USB_DIR_DEVICE_TO_HOST,
                                cmds, ARRAY_SIZE(cmds));
     if (status != 0) {
         return status;
-    } else {
-        for (i = 0; i < 4; i++) {
-            timestamp_bytes[i] = cmds[i].data;
-        }
     }
 
-    cmds[0].addr = (mod == BLADERF_MODULE_RX ? 20 : 28);
-    cmds[1].addr = (mod == BLADERF_MODULE_RX ? 21 : 29);
-    cmds[2].addr = (mod == BLADERF_MODULE_RX ? 22 : 30);
-    cmds[3].addr = (mod == BLADERF_MODULE_RX ? 23 : 31);
-    cmds[0].data = cmds[1].data = cmds[2].data = cmds[3].data = 0xff;
+    for (i = 0; i < ARRAY_SIZE(cmds); i++) {
+        low |= (uint64_t) cmds[i].data << (8 * i);
+    }
 
-    status = access_peripheral(dev, UART_PKT_DEV_GPIO, USB_DIR_DEVICE_TO_HOST,
-                               cmds, ARRAY_SIZE(cmds));
+    if (low < (*prev & TIMESTAMP_LOW_MASK)) {
+        cmds[0].addr = base + TIMESTAMP_LOW_BYTES;
+        cmds[0].data = 0xff;
 
-    if (status) {
-        return status;
-    } else {
-        for (i = 0; i < 4; i++) {
-            timestamp_bytes[i + 4] = cmds[i].data;
+        status = access_peripheral(dev, UART_PKT_DEV_GPIO,
+                                   USB_DIR_DEVICE_TO_HOST, cmds, 1);
+        if (status != 0) {
+            return status;
         }
-    }
 
-    memcpy(value, timestamp_bytes, sizeof(*value));
-    *value = LE64_TO_HOST(*value);
+        high = (uint64_t) cmds[0].data << (8 * TIMESTAMP_LOW_BYTES);
+    }
 
+    *prev = *value = high | low;
     return 0;
 }
 
@@ -1276,32 +2269,35 @@ static int usb_si5338_read(struct bladerf *dev, uint8_t addr, uint8_t *data)
     return status;
 }
 
+static int usb_si5338_access_batch(struct bladerf *dev,
+                                   struct backend_reg_access *regs,
+                                   size_t count)
+{
+    return access_peripheral_batch(dev, UART_PKT_DEV_SI5338, regs, count);
+}
 
 static int usb_dac_write(struct bladerf *dev, uint16_t value)
 {
     int status;
-    struct uart_cmd cmd;
-    int base;
 
     /* FPGA v0.0.4 introduced a change to the location of the DAC registers */
     const bool legacy_location = version_less_than(&dev->fpga_version, 0, 0, 4);
 
-    base = legacy_location ? 0 : 34;
-
-    cmd.addr = base;
-    cmd.data = value & 0xff;
-    status = access_peripheral(dev, legacy_location ? UART_PKT_DEV_VCTCXO : UART_PKT_DEV_GPIO,
-                               USB_DIR_HOST_TO_DEVICE, &cmd, 1);
+    if (legacy_location) {
+        /* The legacy VCTCXO peripheral is accessed one byte at a time */
+        status = peripheral_write_bytes(dev, UART_PKT_DEV_VCTCXO, 0,
+                                        1, value & 0xff);
+        if (status < 0) {
+            return status;
+        }
 
-    if (status < 0) {
-        return status;
+        status = peripheral_write_bytes(dev, UART_PKT_DEV_VCTCXO, 1,
+                                        1, (value >> 8) & 0xff);
+    } else {
+        status = peripheral_write_bytes(dev, UART_PKT_DEV_GPIO, 34,
+                                        sizeof(value), value);
     }
 
-    cmd.addr = base + 1;
-    cmd.data = (value >> 8) & 0xff;
-    status = access_peripheral(dev, legacy_location ? UART_PKT_DEV_VCTCXO : UART_PKT_DEV_GPIO,
-                               USB_DIR_HOST_TO_DEVICE, &cmd, 1);
-
     return status;
 }
 
@@ -1311,6 +2307,18 @@ static int usb_xb_spi(struct bladerf *dev, uint32_t value)
     return gpio_write(dev, 36, value);
 }
 
+/* The firmware only (re)configures the sample endpoints and DMA channels
+ * when the RF link interface is selected */
+static int restart_rf_link(struct bladerf *dev)
+{
+    int status = change_setting(dev, USB_IF_NULL);
+    if (status == 0) {
+        status = change_setting(dev, USB_IF_RF_LINK);
+    }
+
+    return status;
+}
+
 static int usb_set_firmware_loopback(struct bladerf *dev, bool enable) {
     int result;
     int status;
@@ -1321,13 +2329,7 @@ static int usb_set_firmware_loopback(struct bladerf *dev, bool enable) {
         return status;
     }
 
-
-    status = change_setting(dev, USB_IF_NULL);
-    if (status == 0) {
-        status = change_setting(dev, USB_IF_RF_LINK);
-    }
-
-    return status;
+    return restart_rf_link(dev);
 }
 
 static int usb_get_firmware_loopback(struct bladerf *dev, bool *is_enabled)
@@ -1344,6 +2346,132 @@ static int usb_get_firmware_loopback(struct bladerf *dev, bool *is_enabled)
     return status;
 }
 
+static int usb_set_dma_config(struct bladerf *dev, unsigned int count,
+                              unsigned int size)
+{
+    int status;
+    int32_t fx3_ret = -1;
+
+    if (version_less_than(&dev->fw_version, 1, 9, 0)) {
+        return BLADERF_ERR_UNSUPPORTED;
+    } else if (count > BLADE_DMA_MAX_BUF_COUNT ||
+               size > BLADE_DMA_MAX_BUF_SIZE) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    status = vendor_cmd_int_wvalue_windex(dev, BLADE_USB_CMD_SET_DMA_CONFIG,
+                                          (uint16_t) count, (uint16_t) size,
+                                          &fx3_ret);
+    if (status != 0) {
+        return status;
+    }
+
+    fx3_ret = LE32_TO_HOST(fx3_ret);
+    if (fx3_ret != 0) {
+        log_debug("Firmware rejected DMA config of %u x %u bytes: %d\n",
+                  count, size, (int) fx3_ret);
+        return BLADERF_ERR_INVAL;
+    }
+
+    return restart_rf_link(dev);
+}
+
+static int usb_set_burst_len(struct bladerf *dev, unsigned int len)
+{
+    int status;
+    int32_t fx3_ret = -1;
+
+    if (version_less_than(&dev->fw_version, 1, 9, 0)) {
+        return BLADERF_ERR_UNSUPPORTED;
+    } else if (len > BLADE_MAX_BURST_LEN) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    status = vendor_cmd_int_wvalue(dev, BLADE_USB_CMD_SET_BURST_LEN,
+                                   (uint16_t) len, &fx3_ret);
+    if (status != 0) {
+        return status;
+    }
+
+    fx3_ret = LE32_TO_HOST(fx3_ret);
+    if (fx3_ret != 0) {
+        log_debug("Firmware rejected burst length of %u: %d\n",
+                  len, (int) fx3_ret);
+        return BLADERF_ERR_INVAL;
+    }
+
+    return restart_rf_link(dev);
+}
+
+static int usb_get_dma_config(struct bladerf *dev,
+                              struct bladerf_fx3_link_config *config)
+{
+    int status;
+    struct bladerf_fx3_dma_config cfg;
+
+    if (version_less_than(&dev->fw_version, 1, 9, 0)) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    status = control_transfer(dev,
+                              USB_TARGET_DEVICE,
+                              USB_REQUEST_VENDOR,
+                              USB_DIR_DEVICE_TO_HOST,
+                              BLADE_USB_CMD_GET_DMA_CONFIG,
+                              0, 0,
+                              &cfg, sizeof(cfg),
+                              CTRL_TIMEOUT_MS);
+    if (status == 0) {
+        config->buf_count = LE16_TO_HOST(cfg.count);
+        config->buf_size = LE16_TO_HOST(cfg.size);
+        config->burst_len = LE16_TO_HOST(cfg.burst_len);
+        config->max_packet_size = LE16_TO_HOST(cfg.packet_size);
+    }
+
+    return status;
+}
+
+static int usb_get_fx3_stats(struct bladerf *dev,
+                             struct bladerf_fx3_stats *stats, bool reset)
+{
+    int status;
+    struct bladerf_fx3_perf_counters c;
+
+    if (version_less_than(&dev->fw_version, 1, 9, 0)) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    status = control_transfer(dev,
+                              USB_TARGET_DEVICE,
+                              USB_REQUEST_VENDOR,
+                              USB_DIR_DEVICE_TO_HOST,
+                              BLADE_USB_CMD_GET_PERF_COUNTERS,
+                              reset ? 1 : 0, 0,
+                              &c, sizeof(c),
+                              CTRL_TIMEOUT_MS);
+    if (status != 0) {
+        return status;
+    }
+
+    stats->rx_prod_bytes        = LE64_TO_HOST(c.rx_prod_bytes);
+    stats->rx_cons_bytes        = LE64_TO_HOST(c.rx_cons_bytes);
+    stats->tx_prod_bytes        = LE64_TO_HOST(c.tx_prod_bytes);
+    stats->tx_cons_bytes        = LE64_TO_HOST(c.tx_cons_bytes);
+    stats->rx_overruns          = LE32_TO_HOST(c.rx_overruns);
+    stats->tx_underruns         = LE32_TO_HOST(c.tx_underruns);
+    stats->rx_dma_errors        = LE32_TO_HOST(c.rx_dma_errors);
+    stats->tx_dma_errors        = LE32_TO_HOST(c.tx_dma_errors);
+    stats->pib_errors           = LE32_TO_HOST(c.pib_errors);
+    stats->gpif_errors          = LE32_TO_HOST(c.gpif_errors);
+    stats->tx_ep_flow_control   = LE32_TO_HOST(c.tx_ep_flow_control);
+    stats->rx_ep_retries        = LE32_TO_HOST(c.rx_ep_retries);
+    stats->tx_ep_retries        = LE32_TO_HOST(c.tx_ep_retries);
+    stats->rx_ep_errors         = LE32_TO_HOST(c.rx_ep_errors);
+    stats->tx_ep_errors         = LE32_TO_HOST(c.tx_ep_errors);
+
+    return 0;
+}
+
 static int usb_enable_module(struct bladerf *dev, bladerf_module m, bool enable)
 {
     int status;
@@ -1410,6 +2538,46 @@ static void usb_deinit_stream(struct bladerf_stream *stream)
     usb->fn->deinit_stream(driver, stream);
 }
 
+static void *usb_alloc_stream_mem(struct bladerf *dev, size_t len)
+{
+    void *driver;
+    struct bladerf_usb *usb = usb_backend(dev, &driver);
+
+    if (usb->fn->alloc_dev_mem == NULL) {
+        return NULL;
+    }
+
+    return usb->fn->alloc_dev_mem(driver, len);
+}
+
+static void usb_free_stream_mem(struct bladerf *dev, void *mem, size_t len)
+{
+    void *driver;
+    struct bladerf_usb *usb = usb_backend(dev, &driver);
+
+    if (usb->fn->free_dev_mem != NULL) {
+        usb->fn->free_dev_mem(driver, mem, len);
+    }
+}
+
+static int usb_get_event_stats(struct bladerf *dev, uint64_t *polls,
+                               uint64_t *cpu_us)
+{
+    void *driver;
+    struct bladerf_usb *usb = usb_backend(dev, &driver);
+
+    if (usb->fn->get_event_stats == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    return usb->fn->get_event_stats(driver, polls, cpu_us);
+}
+
+static int usb_get_numa_node(struct bladerf *dev)
+{
+    return numa_usb_bus_node(dev->ident.usb_bus);
+}
+
 /*
  * Information about the boot image format and boot over USB caan be found in
  * Cypress AN76405: EZ-USB (R) FX3 (TM) Boot Options:
@@ -1630,4 +2798,39 @@ const struct backend_fns backend_fns_usb = {
     FIELD_INIT(.deinit_stream, usb_deinit_stream),
 
     FIELD_INIT(.load_fw_from_bootloader, usb_load_fw_from_bootloader),
+
+    FIELD_INIT(.alloc_stream_mem, usb_alloc_stream_mem),
+    FIELD_INIT(.free_stream_mem, usb_free_stream_mem),
+
+    FIELD_INIT(.lms_access_batch, usb_lms_access_batch),
+    FIELD_INIT(.si5338_access_batch, usb_si5338_access_batch),
+    FIELD_INIT(.schedule_retune, usb_schedule_retune),
+    FIELD_INIT(.schedule_lms_writes, usb_schedule_lms_writes),
+    FIELD_INIT(.get_fpga_image_id, usb_get_fpga_image_id),
+    FIELD_INIT(.set_fpga_image_id, usb_set_fpga_image_id),
+    FIELD_INIT(.flash_crc32, usb_flash_crc32),
+    FIELD_INIT(.set_dma_config, usb_set_dma_config),
+    FIELD_INIT(.set_burst_len, usb_set_burst_len),
+    FIELD_INIT(.get_dma_config, usb_get_dma_config),
+    FIELD_INIT(.get_fx3_stats, usb_get_fx3_stats),
+    FIELD_INIT(.get_fpga_load_time, usb_get_fpga_load_time),
+    FIELD_INIT(.get_rx_nco, usb_get_rx_nco),
+    FIELD_INIT(.set_rx_nco, usb_set_rx_nco),
+    FIELD_INIT(.get_rx_channels, usb_get_rx_channels),
+    FIELD_INIT(.set_rx_channels, usb_set_rx_channels),
+    FIELD_INIT(.get_rx_tracking, usb_get_rx_tracking),
+    FIELD_INIT(.get_sample_fmt, usb_get_sample_fmt),
+    FIELD_INIT(.set_sample_fmt, usb_set_sample_fmt),
+    FIELD_INIT(.get_fifo_levels, usb_get_fifo_levels),
+    FIELD_INIT(.get_tx_late, usb_get_tx_late),
+    FIELD_INIT(.get_tx_underflows, usb_get_tx_underflows),
+    FIELD_INIT(.set_time_latch, usb_set_time_latch),
+    FIELD_INIT(.get_time_latch, usb_get_time_latch),
+    FIELD_INIT(.get_rx_trigger, usb_get_rx_trigger),
+    FIELD_INIT(.set_rx_trigger, usb_set_rx_trigger),
+    FIELD_INIT(.get_rx_trigger_status, usb_get_rx_trigger_status),
+    FIELD_INIT(.schedule_xb200, usb_schedule_xb200),
+    FIELD_INIT(.lms_sequence, usb_lms_sequence),
+    FIELD_INIT(.get_event_stats, usb_get_event_stats),
+    FIELD_INIT(.get_numa_node, usb_get_numa_node),
 };
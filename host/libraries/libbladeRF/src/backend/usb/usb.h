@@ -49,6 +49,18 @@ extern bool bladerf_usb_reset_device_on_open;
 #   define PERIPHERAL_TIMEOUT_MS 250
 #endif
 
+/* Size of a peripheral access request or ACK, and the maximum number of
+ * register accesses that may be packed into one */
+#define PERIPHERAL_PKT_SIZE 16
+#define PERIPHERAL_MAX_CMDS 7
+
+/* Maximum number of peripheral access requests that may be awaiting an ACK.
+ * The FX3 buffers 10 ACKs; this must remain below that so the device never
+ * stalls waiting for the host to read an ACK. */
+#ifndef PERIPHERAL_PIPELINE_DEPTH
+#   define PERIPHERAL_PIPELINE_DEPTH 8
+#endif
+
 /* Be careful when lowering this value. The control request for flash erase
  * operations take some time */
 #ifndef CTRL_TIMEOUT_MS
@@ -59,6 +71,21 @@ extern bool bladerf_usb_reset_device_on_open;
 #   define BULK_TIMEOUT_MS  1000
 #endif
 
+/* After an FPGA bitstream is sent, its configuration status is polled with
+ * an exponentially increasing period, from FPGA_CONFIG_POLL_MIN_US up to
+ * FPGA_CONFIG_POLL_MAX_US, until FPGA_CONFIG_TIMEOUT_MS have elapsed */
+#ifndef FPGA_CONFIG_TIMEOUT_MS
+#   define FPGA_CONFIG_TIMEOUT_MS 2000
+#endif
+
+#ifndef FPGA_CONFIG_POLL_MIN_US
+#   define FPGA_CONFIG_POLL_MIN_US 500
+#endif
+
+#ifndef FPGA_CONFIG_POLL_MAX_US
+#   define FPGA_CONFIG_POLL_MAX_US 50000
+#endif
+
 /* Size of a host<->FPGA message in BYTES */
 #define USB_MSG_SIZE_SS    2048
 #define USB_MSG_SIZE_HS    1024
@@ -133,6 +160,13 @@ struct usb_fns {
 
     int (*open_bootloader)(void **driver, uint8_t bus, uint8_t addr);
     void (*close_bootloader)(void *driver);
+
+    /* Optional: DMA-able stream buffer memory. May be NULL. */
+    void * (*alloc_dev_mem)(void *driver, size_t len);
+    void (*free_dev_mem)(void *driver, void *mem, size_t len);
+
+    /* Optional: Event thread statistics. May be NULL. */
+    int (*get_event_stats)(void *driver, uint64_t *polls, uint64_t *cpu_us);
 };
 
 struct usb_driver {
@@ -143,6 +177,11 @@ struct usb_driver {
 struct bladerf_usb {
     const struct usb_fns *fn;
     void *driver;
+
+    /* Most recently read timestamp counter values, for RX and TX. The most
+     * significant byte of these is only re-read when the lower bytes wrap.
+     * The counters start at 0, so these start out in sync with the device. */
+    uint64_t timestamp[2];
 };
 
 #endif
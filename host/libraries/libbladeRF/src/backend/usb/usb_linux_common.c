@@ -0,0 +1,342 @@
+/*
+ * Helpers shared by the Linux usbfs and kernel driver backends
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2014 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <linux/usb/ch9.h>
+
+#include "backend/usb/usb_linux_common.h"
+#include "log.h"
+
+int linux_usb_errno_conv(int error)
+{
+    int ret;
+
+    switch (error) {
+        case 0:
+            ret = 0;
+            break;
+
+        case EIO:
+        case EPIPE:
+        case EPROTO:
+        case EILSEQ:
+        case EOVERFLOW:
+            ret = BLADERF_ERR_IO;
+            break;
+
+        case EINVAL:
+        case EPERM:
+            ret = BLADERF_ERR_INVAL;
+            break;
+
+        case EBUSY:
+        case ENODEV:
+        case ENOENT:
+        case ESHUTDOWN:
+            ret = BLADERF_ERR_NODEV;
+            break;
+
+        case ETIMEDOUT:
+            ret = BLADERF_ERR_TIMEOUT;
+            break;
+
+        case ENOMEM:
+            ret = BLADERF_ERR_MEM;
+            break;
+
+        case ENOTTY:
+        case ENOSYS:
+            ret = BLADERF_ERR_UNSUPPORTED;
+            break;
+
+        default:
+            ret = BLADERF_ERR_UNEXPECTED;
+    }
+
+    return ret;
+}
+
+ssize_t linux_usb_read_sysfs_attr(const char *sysfs_name, const char *attr,
+                                  void *buf, size_t buf_len)
+{
+    char path[256];
+    ssize_t n;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/%s/%s",
+             LINUX_SYSFS_PATH, sysfs_name, attr);
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    n = read(fd, buf, buf_len);
+    close(fd);
+
+    if (n < 0) {
+        return -1;
+    }
+
+    return n;
+}
+
+bool linux_usb_read_sysfs_str(const char *sysfs_name, const char *attr,
+                              char *buf, size_t buf_len)
+{
+    ssize_t n = linux_usb_read_sysfs_attr(sysfs_name, attr, buf, buf_len - 1);
+
+    if (n < 0) {
+        buf[0] = '\0';
+        return false;
+    }
+
+    buf[n] = '\0';
+    if (n > 0 && buf[n - 1] == '\n') {
+        buf[n - 1] = '\0';
+    }
+
+    return true;
+}
+
+bool linux_usb_read_sysfs_uint(const char *sysfs_name, const char *attr,
+                               int base, unsigned long *val)
+{
+    char buf[32];
+    char *end;
+
+    if (!linux_usb_read_sysfs_str(sysfs_name, attr, buf, sizeof(buf)) ||
+        buf[0] == '\0') {
+        return false;
+    }
+
+    *val = strtoul(buf, &end, base);
+    return *end == '\0';
+}
+
+static bool get_dev_entry(const char *sysfs_name,
+                          struct linux_usb_dev_entry *e)
+{
+    unsigned long vid, pid, bus, addr;
+
+    /* Interfaces (e.g., "1-1:1.0") are listed alongside devices */
+    if (sysfs_name[0] == '.' || strchr(sysfs_name, ':') != NULL ||
+        strlen(sysfs_name) >= sizeof(e->sysfs_name)) {
+        return false;
+    }
+
+    if (!linux_usb_read_sysfs_uint(sysfs_name, "idVendor", 16, &vid) ||
+        !linux_usb_read_sysfs_uint(sysfs_name, "idProduct", 16, &pid) ||
+        !linux_usb_read_sysfs_uint(sysfs_name, "busnum", 10, &bus) ||
+        !linux_usb_read_sysfs_uint(sysfs_name, "devnum", 10, &addr)) {
+        return false;
+    }
+
+    strcpy(e->sysfs_name, sysfs_name);
+    e->vid = (uint16_t) vid;
+    e->pid = (uint16_t) pid;
+    e->bus = (uint8_t) bus;
+    e->addr = (uint8_t) addr;
+
+    return true;
+}
+
+int linux_usb_for_each_device(bool (*fn)(const struct linux_usb_dev_entry *e,
+                                         void *arg),
+                              void *arg)
+{
+    DIR *dir;
+    struct dirent *ent;
+    struct linux_usb_dev_entry e;
+
+    dir = opendir(LINUX_SYSFS_PATH);
+    if (dir == NULL) {
+        log_debug("Failed to open %s: %s\n", LINUX_SYSFS_PATH, strerror(errno));
+        return BLADERF_ERR_NODEV;
+    }
+
+    while ((ent = readdir(dir)) != NULL) {
+        if (get_dev_entry(ent->d_name, &e) && fn(&e, arg)) {
+            break;
+        }
+    }
+
+    closedir(dir);
+    return 0;
+}
+
+int linux_usb_get_devinfo(const struct linux_usb_dev_entry *e,
+                          const char *node, bladerf_backend backend,
+                          struct bladerf_devinfo *info)
+{
+    if (access(node, R_OK | W_OK) != 0) {
+        log_debug("Couldn't populate devinfo - %s: %s\n",
+                  node, strerror(errno));
+        return BLADERF_ERR_NODEV;
+    }
+
+    info->backend = backend;
+    info->usb_bus = e->bus;
+    info->usb_addr = e->addr;
+
+    /* Consider a missing serial number to be non-fatal, otherwise firmware
+     * <= 1.1 wouldn't be able to get far enough to upgrade */
+    if (!linux_usb_read_sysfs_str(e->sysfs_name, "serial",
+                                  info->serial, BLADERF_SERIAL_LENGTH)) {
+        log_debug("Failed to retrieve serial number\n");
+        memset(info->serial, 0, BLADERF_SERIAL_LENGTH);
+    }
+
+    return 0;
+}
+
+uint8_t linux_usb_bm_request_type(usb_target target_type,
+                                  usb_request req_type,
+                                  usb_direction direction)
+{
+    uint8_t ret = 0;
+
+    switch (target_type) {
+        case USB_TARGET_DEVICE:
+            ret |= USB_RECIP_DEVICE;
+            break;
+
+        case USB_TARGET_INTERFACE:
+            ret |= USB_RECIP_INTERFACE;
+            break;
+
+        case USB_TARGET_ENDPOINT:
+            ret |= USB_RECIP_ENDPOINT;
+            break;
+
+        default:
+            ret |= USB_RECIP_OTHER;
+
+    }
+
+    switch (req_type) {
+        case USB_REQUEST_STANDARD:
+            ret |= USB_TYPE_STANDARD;
+            break;
+
+        case USB_REQUEST_CLASS:
+            ret |= USB_TYPE_CLASS;
+            break;
+
+        case USB_REQUEST_VENDOR:
+            ret |= USB_TYPE_VENDOR;
+            break;
+    }
+
+    switch (direction) {
+        case USB_DIR_HOST_TO_DEVICE:
+            ret |= USB_DIR_OUT;
+            break;
+
+        case USB_DIR_DEVICE_TO_HOST:
+            ret |= USB_DIR_IN;
+            break;
+    }
+
+    return ret;
+}
+
+int linux_usb_control_transfer(linux_usb_control_fn control, void *driver,
+                               uint32_t max_len,
+                               usb_target target_type, usb_request req_type,
+                               usb_direction dir, uint8_t request,
+                               uint16_t wvalue, uint16_t windex,
+                               void *buffer, uint32_t buffer_len,
+                               uint32_t timeout_ms)
+{
+    int status;
+    const uint8_t bm_req_type =
+        linux_usb_bm_request_type(target_type, req_type, dir);
+
+    if (buffer_len > max_len) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    status = control(driver, bm_req_type, request, wvalue, windex,
+                     buffer, (uint16_t) buffer_len, timeout_ms);
+
+    if (status >= 0 && (uint32_t)status == buffer_len) {
+        return 0;
+    }
+
+    log_debug("%s failed: status = %d\n", __FUNCTION__, status);
+    return status < 0 ? linux_usb_errno_conv(-status) : BLADERF_ERR_UNEXPECTED;
+}
+
+int linux_usb_get_string_descriptor(linux_usb_control_fn control,
+                                    void *driver, uint8_t index,
+                                    void *buffer, uint32_t buffer_len)
+{
+    int status;
+    const uint8_t req_type = USB_DIR_IN | USB_TYPE_STANDARD | USB_RECIP_DEVICE;
+    uint8_t desc[255];
+    uint16_t langid;
+    char *out = (char *) buffer;
+    uint32_t i, n;
+
+    if (buffer_len == 0) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    /* String descriptor 0 lists the supported language IDs */
+    status = control(driver, req_type, USB_REQ_GET_DESCRIPTOR,
+                     USB_DT_STRING << 8, 0,
+                     desc, sizeof(desc), CTRL_TIMEOUT_MS);
+    if (status < 4) {
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    langid = desc[2] | (desc[3] << 8);
+
+    status = control(driver, req_type, USB_REQ_GET_DESCRIPTOR,
+                     (USB_DT_STRING << 8) | index, langid,
+                     desc, sizeof(desc), CTRL_TIMEOUT_MS);
+    if (status < 2 || desc[1] != USB_DT_STRING || desc[0] > status) {
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    /* Convert from UTF-16LE, replacing non-ASCII characters */
+    n = (desc[0] - 2) / 2;
+    if (n >= buffer_len) {
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    for (i = 0; i < n; i++) {
+        const uint8_t lo = desc[2 + 2 * i];
+        const uint8_t hi = desc[3 + 2 * i];
+        out[i] = (hi == 0 && lo < 0x80) ? (char) lo : '?';
+    }
+
+    out[n] = '\0';
+    return n > 0 ? 0 : BLADERF_ERR_UNEXPECTED;
+}
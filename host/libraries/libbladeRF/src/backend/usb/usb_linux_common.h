@@ -0,0 +1,139 @@
+/*
+ * Helpers shared by the Linux usbfs and kernel driver backends, for finding
+ * devices via sysfs and issuing control transfers
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2014 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef BACKEND_USB_LINUX_COMMON_H_
+#define BACKEND_USB_LINUX_COMMON_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "backend/usb/usb.h"
+
+#ifndef LINUX_SYSFS_PATH
+#   define LINUX_SYSFS_PATH "/sys/bus/usb/devices"
+#endif
+
+/* Information about a device, gathered from sysfs without opening it */
+struct linux_usb_dev_entry {
+    char sysfs_name[64];    /* Device's entry in LINUX_SYSFS_PATH */
+    uint16_t vid;
+    uint16_t pid;
+    uint8_t bus;
+    uint8_t addr;
+};
+
+/**
+ * Issue a control transfer via a backend's device node
+ *
+ * @return The number of bytes transferred, or a negative errno value
+ */
+typedef int (*linux_usb_control_fn)(void *driver, uint8_t bm_req_type,
+                                    uint8_t request, uint16_t wvalue,
+                                    uint16_t windex, void *buffer,
+                                    uint16_t len, uint32_t timeout_ms);
+
+/**
+ * Convert an errno value to a libbladeRF error code
+ */
+int linux_usb_errno_conv(int error);
+
+/**
+ * Read a sysfs attribute of a USB device
+ *
+ * @return The attribute length, or -1 on failure
+ */
+ssize_t linux_usb_read_sysfs_attr(const char *sysfs_name, const char *attr,
+                                  void *buf, size_t buf_len);
+
+/**
+ * Read a sysfs attribute of a USB device as a string, without its trailing
+ * newline. `buf` is left empty on failure.
+ *
+ * @return true on success
+ */
+bool linux_usb_read_sysfs_str(const char *sysfs_name, const char *attr,
+                              char *buf, size_t buf_len);
+
+/**
+ * Read a sysfs attribute of a USB device as an unsigned integer in the
+ * specified base
+ *
+ * @return true on success
+ */
+bool linux_usb_read_sysfs_uint(const char *sysfs_name, const char *attr,
+                               int base, unsigned long *val);
+
+/**
+ * Iterate over the USB devices listed in sysfs. Iteration stops when `fn`
+ * returns true.
+ *
+ * @return 0 on success, BLADERF_ERR_NODEV if sysfs could not be read
+ */
+int linux_usb_for_each_device(bool (*fn)(const struct linux_usb_dev_entry *e,
+                                         void *arg),
+                              void *arg);
+
+/**
+ * Fill in devinfo for a device whose device node we are able to open
+ *
+ * @param[in]   e           Device
+ * @param[in]   node        Path of the backend's device node for it
+ * @param[in]   backend     Backend to report
+ * @param[out]  info        Device info
+ *
+ * @return 0 on success, BLADERF_ERR_NODEV if the node is not accessible
+ */
+int linux_usb_get_devinfo(const struct linux_usb_dev_entry *e,
+                          const char *node, bladerf_backend backend,
+                          struct bladerf_devinfo *info);
+
+/**
+ * Convert libbladeRF's control transfer parameters to a bmRequestType
+ */
+uint8_t linux_usb_bm_request_type(usb_target target_type,
+                                  usb_request req_type,
+                                  usb_direction direction);
+
+/**
+ * Implement usb_fns::control_transfer via a backend's control function,
+ * which accepts up to `max_len` bytes per transfer
+ */
+int linux_usb_control_transfer(linux_usb_control_fn control, void *driver,
+                               uint32_t max_len,
+                               usb_target target_type, usb_request req_type,
+                               usb_direction dir, uint8_t request,
+                               uint16_t wvalue, uint16_t windex,
+                               void *buffer, uint32_t buffer_len,
+                               uint32_t timeout_ms);
+
+/**
+ * Implement usb_fns::get_string_descriptor via a backend's control function,
+ * converting the descriptor to ASCII
+ */
+int linux_usb_get_string_descriptor(linux_usb_control_fn control,
+                                    void *driver, uint8_t index,
+                                    void *buffer, uint32_t buffer_len);
+
+#endif
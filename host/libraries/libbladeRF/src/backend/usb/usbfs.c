@@ -0,0 +1,1388 @@
+/*
+ * Linux usbfs backend
+ *
+ * This backend talks to the device through the kernel's usbfs interface
+ * (/dev/bus/usb) directly. Stream buffers are submitted as URBs and reaped
+ * by a single thread per device, avoiding libusb's event handling and
+ * transfer bookkeeping on the streaming path.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2014 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <limits.h>
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <linux/usbdevice_fs.h>
+#include <linux/usb/ch9.h>
+#include "bladeRF.h"    /* Firmware interface */
+
+#include "backend/backend.h"
+#include "backend/usb/usb.h"
+#include "backend/usb/usb_linux_common.h"
+#include "async.h"
+#include "log.h"
+
+#ifndef ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+#   define ENABLE_LIBBLADERF_STREAM_CB_LOCKED 0
+#endif
+
+#ifndef USBFS_DEV_PATH
+#   define USBFS_DEV_PATH "/dev/bus/usb"
+#endif
+
+/* Interval at which a streaming thread checks for transfers that have
+ * exceeded the device's transfer timeout. usbfs URBs have no timeout of
+ * their own. */
+#ifndef USBFS_TIMEOUT_CHECK_MS
+#   define USBFS_TIMEOUT_CHECK_MS 100
+#endif
+
+/* epoll_event.data tags */
+#define USBFS_EVENT_URB     0
+#define USBFS_EVENT_WAKE    1
+
+struct bladerf_usbfs {
+    int fd;                 /* usbfs device node */
+    uint8_t bus;
+    uint8_t addr;
+    char sysfs_name[64];    /* Device's entry in LINUX_SYSFS_PATH */
+
+    /* Reaps completed URBs for all of this device's streams */
+    int epoll_fd;
+    int wake_fd;            /* eventfd used to stop the reap thread */
+    pthread_t reap_thread;
+    bool reap_thread_running;
+};
+
+typedef enum {
+    TRANSFER_UNINITIALIZED = 0,
+    TRANSFER_AVAIL,
+    TRANSFER_IN_FLIGHT,
+    TRANSFER_CANCEL_PENDING,
+    TRANSFER_IN_CALLBACK        /* Completed, and reserved for the buffer
+                                 * returned by the stream callback */
+} transfer_status;
+
+struct usbfs_transfer {
+    struct usbdevfs_urb *urb;
+    struct bladerf_stream *stream;
+    transfer_status status;
+    uint64_t submit_time_us;    /* For turnaround statistics and timeouts */
+};
+
+struct usbfs_stream_data {
+    size_t num_transfers;               /* Total # of allocated transfers */
+    size_t num_avail;                   /* # of currently available transfers */
+    size_t i;                           /* Index to next transfer */
+    struct usbfs_transfer *transfers;   /* URBs are given a pointer to their
+                                         * entry, so no lookup is needed upon
+                                         * completion */
+    pthread_cond_t stream_done;         /* Signaled when stream->state
+                                         * reaches STREAM_DONE */
+
+    void **deferred;                    /* FIFO of buffers held back due to
+                                         * stream->transfer_limit */
+    size_t deferred_head;               /* Index of oldest deferred buffer */
+    size_t deferred_count;              /* # of deferred buffers */
+};
+
+static bool device_is_fx3_bootloader(const struct linux_usb_dev_entry *e)
+{
+    return (e->vid == USB_CYPRESS_VENDOR_ID && e->pid == USB_FX3_PRODUCT_ID) ||
+           (e->vid == USB_NUAND_VENDOR_ID &&
+            e->pid == USB_NUAND_BLADERF_BOOT_PRODUCT_ID);
+}
+
+/* Count the alternate settings of the first interface of the first
+ * configuration, using the raw descriptors exported via sysfs */
+static int count_altsettings(const struct linux_usb_dev_entry *e)
+{
+    uint8_t desc[4096];
+    ssize_t len;
+    size_t i, end;
+    int count = 0;
+
+    len = linux_usb_read_sysfs_attr(e->sysfs_name, "descriptors",
+                                    desc, sizeof(desc));
+    if (len < USB_DT_DEVICE_SIZE + USB_DT_CONFIG_SIZE) {
+        return -1;
+    }
+
+    i = USB_DT_DEVICE_SIZE;
+    end = i + (desc[i + 2] | (desc[i + 3] << 8));
+    if (end > (size_t) len) {
+        end = (size_t) len;
+    }
+
+    while (i + 2 < end && desc[i] != 0) {
+        if (desc[i + 1] == USB_DT_INTERFACE && desc[i + 2] == 0) {
+            count++;
+        }
+
+        i += desc[i];
+    }
+
+    return count;
+}
+
+static bool device_is_bladerf(const struct linux_usb_dev_entry *e)
+{
+    if (e->vid != USB_NUAND_VENDOR_ID ||
+        e->pid != USB_NUAND_BLADERF_PRODUCT_ID) {
+        return false;
+    }
+
+    /* As of firmware v0.4, we expect there to be 4 altsettings on the
+     * first interface. */
+    if (count_altsettings(e) != 4) {
+        log_warning("A bladeRF running incompatible firmware appears to be "
+                    "present on bus=%u, addr=%u. If this is true, a firmware "
+                    "update via the device's bootloader is required.\n\n",
+                    e->bus, e->addr);
+        return false;
+    }
+
+    return true;
+}
+
+static bool device_is_probe_target(backend_probe_target probe_target,
+                                   const struct linux_usb_dev_entry *e)
+{
+    bool is_probe_target = false;
+
+    switch (probe_target) {
+        case BACKEND_PROBE_BLADERF:
+            is_probe_target = device_is_bladerf(e);
+            if (is_probe_target) {
+                log_verbose("Found a bladeRF\n");
+            }
+            break;
+
+        case BACKEND_PROBE_FX3_BOOTLOADER:
+            is_probe_target = device_is_fx3_bootloader(e);
+            if (is_probe_target) {
+                log_verbose("Found an FX3 bootloader.\n");
+            }
+            break;
+
+        default:
+            assert(!"Invalid probe target");
+    }
+
+    return is_probe_target;
+}
+
+static inline void dev_node_path(char *buf, size_t buf_len,
+                                 uint8_t bus, uint8_t addr)
+{
+    snprintf(buf, buf_len, "%s/%03u/%03u", USBFS_DEV_PATH, bus, addr);
+}
+
+/* Fill in devinfo for a device we are able to open */
+static int get_devinfo(const struct linux_usb_dev_entry *e,
+                       struct bladerf_devinfo *info)
+{
+    char path[64];
+
+    dev_node_path(path, sizeof(path), e->bus, e->addr);
+    return linux_usb_get_devinfo(e, path, BLADERF_BACKEND_USBFS, info);
+}
+
+struct probe_state {
+    backend_probe_target target;
+    struct bladerf_devinfo_list *list;
+    int n;
+    int status;
+};
+
+static bool probe_device(const struct linux_usb_dev_entry *e, void *arg)
+{
+    struct probe_state *p = (struct probe_state *) arg;
+    struct bladerf_devinfo info;
+
+    if (!device_is_probe_target(p->target, e)) {
+        return false;
+    }
+
+    /* We may not be able to open the device due to permissions.
+     * Therefore, just carry on. */
+    if (get_devinfo(e, &info) != 0) {
+        return false;
+    }
+
+    info.instance = p->n++;
+    p->status = bladerf_devinfo_list_add(p->list, &info);
+    if (p->status != 0) {
+        log_error("Could not add device to list: %s\n",
+                  bladerf_strerror(p->status));
+        return true;
+    }
+
+    log_verbose("Added instance %d to device list\n", info.instance);
+    return false;
+}
+
+static int usbfs_probe(backend_probe_target probe_target,
+                       struct bladerf_devinfo_list *info_list)
+{
+    int status;
+    struct probe_state p;
+
+    p.target = probe_target;
+    p.list = info_list;
+    p.n = 0;
+    p.status = 0;
+
+    status = linux_usb_for_each_device(probe_device, &p);
+    if (status == BLADERF_ERR_NODEV) {
+        /* No sysfs (e.g., in a container) -- there's nothing to find */
+        status = 0;
+    }
+
+    return status != 0 ? status : p.status;
+}
+
+/* Open a device node and claim interface 0. Returns a BLADERF_ERR_* value. */
+static int open_device(struct bladerf_usbfs *usbfs)
+{
+    char path[64];
+    unsigned int iface = 0;
+    int status;
+
+    dev_node_path(path, sizeof(path), usbfs->bus, usbfs->addr);
+
+    usbfs->fd = open(path, O_RDWR | O_CLOEXEC);
+    if (usbfs->fd < 0) {
+        status = errno;
+        log_debug("Failed to open %s: %s\n", path, strerror(status));
+        return linux_usb_errno_conv(status);
+    }
+
+    if (ioctl(usbfs->fd, USBDEVFS_CLAIMINTERFACE, &iface) != 0) {
+        status = errno;
+        log_debug("Failed to claim interface 0 of %s: %s\n",
+                  path, strerror(status));
+        close(usbfs->fd);
+        usbfs->fd = -1;
+        return linux_usb_errno_conv(status);
+    }
+
+    return 0;
+}
+
+static void close_device(struct bladerf_usbfs *usbfs)
+{
+    unsigned int iface = 0;
+
+    if (usbfs->fd < 0) {
+        return;
+    }
+
+    if (ioctl(usbfs->fd, USBDEVFS_RELEASEINTERFACE, &iface) != 0) {
+        log_debug("Failed to release interface: %s\n", strerror(errno));
+    }
+
+    close(usbfs->fd);
+    usbfs->fd = -1;
+}
+
+struct find_state {
+    const struct bladerf_devinfo *info_in;
+    struct bladerf_devinfo *info_out;
+    struct bladerf_usbfs *usbfs;
+    int n;
+    int status;
+};
+
+static bool find_device(const struct linux_usb_dev_entry *e, void *arg)
+{
+    struct find_state *f = (struct find_state *) arg;
+    struct bladerf_devinfo curr_info;
+
+    if (!device_is_bladerf(e)) {
+        return false;
+    }
+
+    if (get_devinfo(e, &curr_info) != 0) {
+        return false;
+    }
+
+    curr_info.instance = f->n++;
+
+    if (!bladerf_devinfo_matches(&curr_info, f->info_in)) {
+        log_verbose("Devinfo doesn't match - skipping"
+                    "(instance=%d, serial=%d, bus/addr=%d\n",
+                    bladerf_instance_matches(&curr_info, f->info_in),
+                    bladerf_serial_matches(&curr_info, f->info_in),
+                    bladerf_bus_addr_matches(&curr_info, f->info_in));
+        return false;
+    }
+
+    f->usbfs->bus = e->bus;
+    f->usbfs->addr = e->addr;
+    strcpy(f->usbfs->sysfs_name, e->sysfs_name);
+
+    f->status = open_device(f->usbfs);
+    if (f->status != 0) {
+        /* Continue trying the next matching device */
+        f->status = BLADERF_ERR_NODEV;
+        return false;
+    }
+
+    memcpy(f->info_out, &curr_info, sizeof(f->info_out[0]));
+    return true;
+}
+
+static int find_and_open_device(struct bladerf_usbfs *usbfs,
+                                const struct bladerf_devinfo *info_in,
+                                struct bladerf_devinfo *info_out)
+{
+    int status;
+    struct find_state f;
+
+    f.info_in = info_in;
+    f.info_out = info_out;
+    f.usbfs = usbfs;
+    f.n = 0;
+    f.status = BLADERF_ERR_NODEV;
+
+    status = linux_usb_for_each_device(find_device, &f);
+    return status != 0 ? status : f.status;
+}
+
+#if ENABLE_USB_DEV_RESET_ON_OPEN
+static int reset_and_reopen(struct bladerf_usbfs *usbfs,
+                            struct bladerf_devinfo *info)
+{
+    int status;
+    struct bladerf_devinfo new_info;
+
+    if (ioctl(usbfs->fd, USBDEVFS_RESET, NULL) == 0) {
+        log_verbose("USB port reset succeeded for bladeRF %s\n", info->serial);
+        return 0;
+    }
+
+    status = errno;
+    if (status != ENODEV) {
+        log_verbose("Port reset failed for bladerf %s: %s\n",
+                    info->serial, strerror(status));
+        return BLADERF_ERR_IO;
+    }
+
+    /* The reset has caused the device to drop out and re-enumerate.
+     *
+     * We'll find it again via the info we gathered about it via its
+     * serial number, which is now stored in the devinfo
+     */
+    log_verbose("Re-scan required after port reset for bladeRF %s\n",
+                info->serial);
+
+    close_device(usbfs);
+
+    memcpy(&new_info, info, sizeof(new_info));
+    new_info.usb_bus  = DEVINFO_BUS_ANY;
+    new_info.usb_addr = DEVINFO_ADDR_ANY;
+
+    return find_and_open_device(usbfs, &new_info, info);
+}
+#endif
+
+static void complete_urb(struct usbdevfs_urb *urb);
+
+/* Reap all completed URBs. Returns false if the device has gone away. */
+static bool reap_urbs(struct bladerf_usbfs *usbfs)
+{
+    struct usbdevfs_urb *urb;
+
+    while (ioctl(usbfs->fd, USBDEVFS_REAPURBNDELAY, &urb) == 0) {
+        complete_urb(urb);
+    }
+
+    if (errno == ENODEV) {
+        log_debug("Device removed; no longer reaping URBs.\n");
+        return false;
+    } else if (errno != EAGAIN) {
+        log_warning("Unexpected error while reaping URBs: %s\n",
+                    strerror(errno));
+    }
+
+    return true;
+}
+
+static void *usbfs_reap_thread(void *arg)
+{
+    struct bladerf_usbfs *usbfs = (struct bladerf_usbfs *) arg;
+    struct epoll_event ev;
+    int n;
+
+    while (true) {
+        n = epoll_wait(usbfs->epoll_fd, &ev, 1, -1);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            log_error("epoll_wait() failed: %s\n", strerror(errno));
+            break;
+        } else if (n == 0) {
+            continue;
+        }
+
+        if (ev.data.u32 == USBFS_EVENT_WAKE) {
+            break;
+        }
+
+        /* Completed URBs, or the device has been disconnected */
+        if (!reap_urbs(usbfs)) {
+            epoll_ctl(usbfs->epoll_fd, EPOLL_CTL_DEL, usbfs->fd, NULL);
+        }
+    }
+
+    return NULL;
+}
+
+static int start_reap_thread(struct bladerf_usbfs *usbfs)
+{
+    int status;
+    struct epoll_event ev;
+
+    usbfs->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (usbfs->epoll_fd < 0) {
+        log_error("Failed to create epoll instance: %s\n", strerror(errno));
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    usbfs->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (usbfs->wake_fd < 0) {
+        log_error("Failed to create eventfd: %s\n", strerror(errno));
+        status = BLADERF_ERR_UNEXPECTED;
+        goto error;
+    }
+
+    /* usbfs reports completed URBs as the device node being writable */
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLOUT;
+    ev.data.u32 = USBFS_EVENT_URB;
+    if (epoll_ctl(usbfs->epoll_fd, EPOLL_CTL_ADD, usbfs->fd, &ev) != 0) {
+        log_error("Failed to add device to epoll set: %s\n", strerror(errno));
+        status = BLADERF_ERR_UNEXPECTED;
+        goto error;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.u32 = USBFS_EVENT_WAKE;
+    if (epoll_ctl(usbfs->epoll_fd, EPOLL_CTL_ADD, usbfs->wake_fd, &ev) != 0) {
+        log_error("Failed to add eventfd to epoll set: %s\n", strerror(errno));
+        status = BLADERF_ERR_UNEXPECTED;
+        goto error;
+    }
+
+    status = pthread_create(&usbfs->reap_thread, NULL,
+                            usbfs_reap_thread, usbfs);
+    if (status != 0) {
+        log_error("Failed to start usbfs reap thread: %s\n",
+                  strerror(status));
+        status = BLADERF_ERR_UNEXPECTED;
+        goto error;
+    }
+
+    usbfs->reap_thread_running = true;
+    return 0;
+
+error:
+    if (usbfs->wake_fd >= 0) {
+        close(usbfs->wake_fd);
+        usbfs->wake_fd = -1;
+    }
+
+    close(usbfs->epoll_fd);
+    usbfs->epoll_fd = -1;
+    return status;
+}
+
+static void stop_reap_thread(struct bladerf_usbfs *usbfs)
+{
+    const uint64_t one = 1;
+
+    if (usbfs->reap_thread_running) {
+        if (write(usbfs->wake_fd, &one, sizeof(one)) != sizeof(one)) {
+            log_error("Failed to wake usbfs reap thread: %s\n",
+                      strerror(errno));
+        } else {
+            pthread_join(usbfs->reap_thread, NULL);
+        }
+
+        usbfs->reap_thread_running = false;
+    }
+
+    if (usbfs->wake_fd >= 0) {
+        close(usbfs->wake_fd);
+        usbfs->wake_fd = -1;
+    }
+
+    if (usbfs->epoll_fd >= 0) {
+        close(usbfs->epoll_fd);
+        usbfs->epoll_fd = -1;
+    }
+}
+
+static struct bladerf_usbfs *alloc_usbfs(void)
+{
+    struct bladerf_usbfs *usbfs = calloc(1, sizeof(usbfs[0]));
+
+    if (usbfs != NULL) {
+        usbfs->fd = -1;
+        usbfs->epoll_fd = -1;
+        usbfs->wake_fd = -1;
+    }
+
+    return usbfs;
+}
+
+static int usbfs_open(void **driver,
+                      struct bladerf_devinfo *info_in,
+                      struct bladerf_devinfo *info_out)
+{
+    int status;
+    struct bladerf_usbfs *usbfs = alloc_usbfs();
+
+    if (usbfs == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    status = find_and_open_device(usbfs, info_in, info_out);
+    if (status != 0) {
+        if (status == BLADERF_ERR_NODEV) {
+            log_debug("No devices available on the usbfs backend.\n");
+        } else {
+            log_debug("Failed to open bladeRF on usbfs backend: %s\n",
+                      bladerf_strerror(status));
+        }
+
+        free(usbfs);
+        return status;
+    }
+
+#   if ENABLE_USB_DEV_RESET_ON_OPEN
+    if (bladerf_usb_reset_device_on_open) {
+        status = reset_and_reopen(usbfs, info_out);
+    }
+#   endif
+
+    if (status == 0) {
+        status = start_reap_thread(usbfs);
+    }
+
+    if (status != 0) {
+        close_device(usbfs);
+        free(usbfs);
+    } else {
+        *driver = (void *) usbfs;
+    }
+
+    return status;
+}
+
+static int usbfs_change_setting(void *driver, uint8_t setting)
+{
+    struct bladerf_usbfs *usbfs = (struct bladerf_usbfs *) driver;
+    struct usbdevfs_setinterface setintf;
+
+    setintf.interface = 0;
+    setintf.altsetting = setting;
+
+    if (ioctl(usbfs->fd, USBDEVFS_SETINTERFACE, &setintf) != 0) {
+        return linux_usb_errno_conv(errno);
+    }
+
+    return 0;
+}
+
+static void usbfs_close(void *driver)
+{
+    struct bladerf_usbfs *usbfs = (struct bladerf_usbfs *) driver;
+
+    stop_reap_thread(usbfs);
+    close_device(usbfs);
+    free(usbfs);
+}
+
+static void usbfs_close_bootloader(void *driver)
+{
+    struct bladerf_usbfs *usbfs = (struct bladerf_usbfs *) driver;
+
+    if (usbfs != NULL) {
+        close_device(usbfs);
+        free(usbfs);
+    }
+}
+
+struct bootloader_state {
+    uint8_t bus;
+    uint8_t addr;
+    struct bladerf_usbfs *usbfs;
+    int status;
+};
+
+static bool find_bootloader(const struct linux_usb_dev_entry *e, void *arg)
+{
+    struct bootloader_state *b = (struct bootloader_state *) arg;
+
+    if (!device_is_fx3_bootloader(e) ||
+        (b->bus != DEVINFO_BUS_ANY && b->bus != e->bus) ||
+        (b->addr != DEVINFO_ADDR_ANY && b->addr != e->addr)) {
+        return false;
+    }
+
+    b->usbfs->bus = e->bus;
+    b->usbfs->addr = e->addr;
+    strcpy(b->usbfs->sysfs_name, e->sysfs_name);
+
+    b->status = open_device(b->usbfs);
+    if (b->status == 0) {
+        log_verbose("Opened bootloader at %u:%u\n", e->bus, e->addr);
+    }
+
+    return true;
+}
+
+static int usbfs_open_bootloader(void **driver, uint8_t bus, uint8_t addr)
+{
+    int status;
+    struct bootloader_state b;
+
+    *driver = NULL;
+
+    b.bus = bus;
+    b.addr = addr;
+    b.status = BLADERF_ERR_NODEV;
+    b.usbfs = alloc_usbfs();
+
+    if (b.usbfs == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    status = linux_usb_for_each_device(find_bootloader, &b);
+    if (status == 0) {
+        status = b.status;
+    }
+
+    if (status != 0) {
+        usbfs_close_bootloader(b.usbfs);
+    } else {
+        *driver = b.usbfs;
+    }
+
+    return status;
+}
+
+static int usbfs_get_speed(void *driver, bladerf_dev_speed *device_speed)
+{
+    struct bladerf_usbfs *usbfs = (struct bladerf_usbfs *) driver;
+    char speed[16];
+    unsigned long mbps;
+    int status = 0;
+
+    *device_speed = BLADERF_DEVICE_SPEED_UNKNOWN;
+
+    /* Reported in Mbit/s, and "1.5" for low speed devices */
+    if (!linux_usb_read_sysfs_str(usbfs->sysfs_name, "speed",
+                                  speed, sizeof(speed))) {
+        log_debug("Failed to read device speed\n");
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    mbps = strtoul(speed, NULL, 10);
+    if (mbps >= 5000) {
+        *device_speed = BLADERF_DEVICE_SPEED_SUPER;
+    } else if (mbps == 480) {
+        *device_speed = BLADERF_DEVICE_SPEED_HIGH;
+    } else if (mbps == 12) {
+        log_debug("Full speed connection is not suppored.\n");
+        status = BLADERF_ERR_UNSUPPORTED;
+    } else if (mbps == 1) {
+        log_debug("Low speed connection is not supported.\n");
+        status = BLADERF_ERR_UNSUPPORTED;
+    } else {
+        log_debug("Unknown/unexpected device speed (%s)\n", speed);
+        status = BLADERF_ERR_UNEXPECTED;
+    }
+
+    return status;
+}
+
+/* Returns the number of bytes transferred, or a negative errno value */
+static int do_control_transfer(void *driver,
+                               uint8_t bm_req_type, uint8_t request,
+                               uint16_t wvalue, uint16_t windex,
+                               void *buffer, uint16_t len, uint32_t timeout_ms)
+{
+    struct bladerf_usbfs *usbfs = (struct bladerf_usbfs *) driver;
+    struct usbdevfs_ctrltransfer ctrl;
+    int status;
+
+    ctrl.bRequestType = bm_req_type;
+    ctrl.bRequest = request;
+    ctrl.wValue = wvalue;
+    ctrl.wIndex = windex;
+    ctrl.wLength = len;
+    ctrl.timeout = timeout_ms;
+    ctrl.data = buffer;
+
+    status = ioctl(usbfs->fd, USBDEVFS_CONTROL, &ctrl);
+    return status < 0 ? -errno : status;
+}
+
+static int usbfs_control_transfer(void *driver,
+                                  usb_target target_type, usb_request req_type,
+                                  usb_direction dir, uint8_t request,
+                                  uint16_t wvalue, uint16_t windex,
+                                  void *buffer, uint32_t buffer_len,
+                                  uint32_t timeout_ms)
+{
+    return linux_usb_control_transfer(do_control_transfer, driver, UINT16_MAX,
+                                      target_type, req_type, dir, request,
+                                      wvalue, windex, buffer, buffer_len,
+                                      timeout_ms);
+}
+
+static int usbfs_bulk_transfer(void *driver, uint8_t endpoint, void *buffer,
+                               uint32_t buffer_len, uint32_t timeout_ms)
+{
+    int status;
+    struct bladerf_usbfs *usbfs = (struct bladerf_usbfs *) driver;
+    struct usbdevfs_bulktransfer bulk;
+
+    bulk.ep = endpoint;
+    bulk.len = buffer_len;
+    bulk.timeout = timeout_ms;
+    bulk.data = buffer;
+
+    status = ioctl(usbfs->fd, USBDEVFS_BULK, &bulk);
+    if (status < 0) {
+        return linux_usb_errno_conv(errno);
+    } else if ((uint32_t) status != buffer_len) {
+        log_debug("Short bulk transfer: requeted=%u, transferred=%d\n",
+                  buffer_len, status);
+        return BLADERF_ERR_IO;
+    }
+
+    return 0;
+}
+
+static int usbfs_get_string_descriptor(void *driver, uint8_t index,
+                                       void *buffer, uint32_t buffer_len)
+{
+    return linux_usb_get_string_descriptor(do_control_transfer, driver, index,
+                                           buffer, buffer_len);
+}
+
+static inline void cancel_all_transfers(struct bladerf_stream *stream)
+{
+    size_t i;
+    struct bladerf_usbfs *usbfs;
+    struct usbfs_stream_data *stream_data = stream->backend_data;
+    struct bladerf_usb *usb = (struct bladerf_usb *) stream->dev->backend;
+
+    usbfs = (struct bladerf_usbfs *) usb->driver;
+
+    for (i = 0; i < stream_data->num_transfers; i++) {
+        struct usbfs_transfer *t = &stream_data->transfers[i];
+
+        if (t->status == TRANSFER_IN_FLIGHT) {
+            /* EINVAL implies the URB has already completed, and is
+             * awaiting reaping */
+            if (ioctl(usbfs->fd, USBDEVFS_DISCARDURB, t->urb) != 0 &&
+                errno != EINVAL) {
+                log_error("Error canceling transfer: %s\r\n",
+                          strerror(errno));
+            } else {
+                t->status = TRANSFER_CANCEL_PENDING;
+            }
+        }
+    }
+}
+
+static int queue_buffer(struct bladerf_stream *stream, void *buffer);
+static int submit_deferred_buffers(struct bladerf_stream *stream);
+
+/* Return a transfer to the pool of those available for submission */
+static inline void release_transfer(struct bladerf_stream *stream,
+                                    struct usbfs_transfer *t)
+{
+    struct usbfs_stream_data *stream_data = stream->backend_data;
+
+    t->status = TRANSFER_AVAIL;
+    stream_data->num_avail++;
+    pthread_cond_signal(&stream->can_submit_buffer);
+}
+
+/* End the stream once all transfers have been returned */
+static inline void check_stream_done(struct bladerf_stream *stream)
+{
+    struct usbfs_stream_data *stream_data = stream->backend_data;
+
+    if (stream->state == STREAM_SHUTTING_DOWN) {
+        stream_data->deferred_count = 0;
+
+        if (stream_data->num_avail == stream_data->num_transfers) {
+            stream->state = STREAM_DONE;
+            pthread_cond_signal(&stream_data->stream_done);
+        } else {
+            cancel_all_transfers(stream);
+        }
+    }
+}
+
+/* Executed by the reap thread for each completed URB */
+static void complete_urb(struct usbdevfs_urb *urb)
+{
+    struct usbfs_transfer *t = (struct usbfs_transfer *) urb->usercontext;
+    struct bladerf_stream *stream = t->stream;
+    void *next_buffer;
+    struct bladerf_metadata metadata;
+    uint64_t now_us;
+    uint64_t cb_done_us;
+
+    MUTEX_LOCK(&stream->lock);
+
+    now_us = async_stats_time_us();
+
+    assert(t->status == TRANSFER_IN_FLIGHT ||
+           t->status == TRANSFER_CANCEL_PENDING);
+
+    /* Reserve this transfer for the buffer returned by the callback, so
+     * that it cannot be claimed by a bladerf_submit_stream_buffer() caller
+     * while we execute the callback without holding the lock. */
+    t->status = TRANSFER_IN_CALLBACK;
+
+    switch (urb->status) {
+        case 0:
+            stream->stats.transfers++;
+            async_stats_hist_add(stream->stats.turnaround_hist,
+                                 t->submit_time_us, now_us);
+            break;
+
+        case -ENOENT:
+        case -ECONNRESET:
+            /* Discarded -- we expect this when tearing down the stream */
+            stream->state = STREAM_SHUTTING_DOWN;
+            break;
+
+        case -EPIPE:
+            log_error("Hit stall for buffer %p\n", urb->buffer);
+            stream->error_code = BLADERF_ERR_IO;
+            stream->state = STREAM_SHUTTING_DOWN;
+            break;
+
+        case -ENODEV:
+        case -ESHUTDOWN:
+            stream->error_code = BLADERF_ERR_NODEV;
+            stream->state = STREAM_SHUTTING_DOWN;
+            break;
+
+        default:
+            log_error("Got transfer error for buffer %p: %s\n",
+                      urb->buffer, strerror(-urb->status));
+            stream->error_code = BLADERF_ERR_IO;
+            stream->state = STREAM_SHUTTING_DOWN;
+            break;
+    }
+
+    if (stream->state == STREAM_RUNNING) {
+
+        /* Sanity check for debugging purposes */
+        if (urb->buffer_length != urb->actual_length) {
+            log_warning( "Received short transfer\n" );
+            stream->stats.short_transfers++;
+        }
+
+        async_rx_metadata(stream, urb->buffer,
+                          bytes_to_samples(stream->format, urb->actual_length),
+                          &metadata);
+
+#       if !ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+        MUTEX_UNLOCK(&stream->lock);
+#       endif
+
+        next_buffer = stream->cb(stream->dev,
+                                 stream,
+                                 &metadata,
+                                 urb->buffer,
+                                 bytes_to_samples(stream->format,
+                                                  urb->actual_length),
+                                 stream->user_data);
+
+        cb_done_us = async_stats_time_us();
+
+#       if !ENABLE_LIBBLADERF_STREAM_CB_LOCKED
+        MUTEX_LOCK(&stream->lock);
+#       endif
+
+        async_stats_hist_add(stream->stats.callback_hist, now_us, cb_done_us);
+        release_transfer(stream, t);
+
+        if (next_buffer == BLADERF_STREAM_SHUTDOWN) {
+            stream->state = STREAM_SHUTTING_DOWN;
+        } else if (stream->state == STREAM_RUNNING &&
+                   ((next_buffer != BLADERF_STREAM_NO_DATA &&
+                     queue_buffer(stream, next_buffer) != 0) ||
+                    submit_deferred_buffers(stream) != 0)) {
+            /* If this fails, we probably have a serious problem...so
+             * just shut it down. */
+            stream->state = STREAM_SHUTTING_DOWN;
+        }
+    } else {
+        release_transfer(stream, t);
+    }
+
+    check_stream_done(stream);
+
+    MUTEX_UNLOCK(&stream->lock);
+}
+
+static inline struct usbfs_transfer *
+get_next_available_transfer(struct usbfs_stream_data *stream_data)
+{
+    unsigned int n;
+    size_t i = stream_data->i;
+
+    for (n = 0; n < stream_data->num_transfers; n++) {
+        if (stream_data->transfers[i].status == TRANSFER_AVAIL) {
+            stream_data->i = (i + 1) % stream_data->num_transfers;
+            return &stream_data->transfers[i];
+        }
+
+        i = (i + 1) % stream_data->num_transfers;
+    }
+
+    return NULL;
+}
+
+static int submit_transfer(struct bladerf_stream *stream, void *buffer)
+{
+    int status;
+    struct bladerf_usb *usb = (struct bladerf_usb *) stream->dev->backend;
+    struct bladerf_usbfs *usbfs = (struct bladerf_usbfs *) usb->driver;
+    struct usbfs_stream_data *stream_data = stream->backend_data;
+    struct usbfs_transfer *t;
+    const size_t bytes_per_buffer = async_stream_buf_bytes(stream);
+
+    t = get_next_available_transfer(stream_data);
+    if (t == NULL) {
+        log_error("%s: No transfers available.\n", __FUNCTION__);
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    assert(bytes_per_buffer <= INT_MAX);
+    memset(t->urb, 0, sizeof(t->urb[0]));
+    t->urb->type = USBDEVFS_URB_TYPE_BULK;
+    t->urb->endpoint =
+        stream->module == BLADERF_MODULE_TX ? SAMPLE_EP_OUT : SAMPLE_EP_IN;
+    t->urb->buffer = buffer;
+    t->urb->buffer_length = (int) bytes_per_buffer;
+    t->urb->usercontext = t;
+
+    t->status = TRANSFER_IN_FLIGHT;
+    t->submit_time_us = async_stats_time_us();
+
+    /* Unlike libusb, submission does not contend with completion handling
+     * for any lock but our own, so the stream lock is retained here */
+    if (ioctl(usbfs->fd, USBDEVFS_SUBMITURB, t->urb) != 0) {
+        status = errno;
+        log_error("Failed to submit transfer in %s: %s\n",
+                  __FUNCTION__, strerror(status));
+
+        if (status == ENOMEM) {
+            log_error("The total size of in-flight transfers may exceed "
+                      "the usbfs limit (see the usbcore.usbfs_memory_mb "
+                      "kernel parameter).\n");
+        }
+
+        t->status = TRANSFER_AVAIL;
+        return linux_usb_errno_conv(status);
+    }
+
+    assert(stream_data->num_avail != 0);
+    stream_data->num_avail--;
+
+    return 0;
+}
+
+/* Does stream->transfer_limit allow another buffer to be put in flight? */
+static inline bool below_transfer_limit(struct bladerf_stream *stream)
+{
+    struct usbfs_stream_data *stream_data = stream->backend_data;
+    const unsigned int limit = ATOMIC_LOAD_ACQUIRE(&stream->transfer_limit);
+    const size_t in_flight = stream_data->num_transfers - stream_data->num_avail;
+
+    return limit == 0 || in_flight < limit;
+}
+
+/* Submit a buffer, or defer it until earlier transfers complete if the
+ * stream's transfer limit has been reached */
+static int queue_buffer(struct bladerf_stream *stream, void *buffer)
+{
+    struct usbfs_stream_data *stream_data = stream->backend_data;
+
+    if (stream_data->deferred_count == 0 && below_transfer_limit(stream)) {
+        return submit_transfer(stream, buffer);
+    }
+
+    if (stream_data->deferred_count >= stream_data->num_transfers) {
+        log_error("%s: Deferred buffer queue is full.\n", __FUNCTION__);
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    stream_data->deferred[(stream_data->deferred_head +
+                           stream_data->deferred_count) %
+                          stream_data->num_transfers] = buffer;
+    stream_data->deferred_count++;
+
+    return 0;
+}
+
+/* Submit deferred buffers, in order, while the transfer limit permits */
+static int submit_deferred_buffers(struct bladerf_stream *stream)
+{
+    int status = 0;
+    struct usbfs_stream_data *stream_data = stream->backend_data;
+
+    while (status == 0 && stream_data->deferred_count != 0 &&
+           below_transfer_limit(stream)) {
+
+        void *buffer = stream_data->deferred[stream_data->deferred_head];
+
+        stream_data->deferred_head =
+            (stream_data->deferred_head + 1) % stream_data->num_transfers;
+        stream_data->deferred_count--;
+
+        status = submit_transfer(stream, buffer);
+    }
+
+    return status;
+}
+
+static void free_stream_data(struct usbfs_stream_data *stream_data)
+{
+    size_t i;
+
+    if (stream_data->transfers != NULL) {
+        for (i = 0; i < stream_data->num_transfers; i++) {
+            free(stream_data->transfers[i].urb);
+        }
+    }
+
+    free(stream_data->transfers);
+    free(stream_data->deferred);
+    pthread_cond_destroy(&stream_data->stream_done);
+    free(stream_data);
+}
+
+static int usbfs_init_stream(void *driver, struct bladerf_stream *stream,
+                             size_t num_transfers)
+{
+    size_t i;
+    struct usbfs_stream_data *stream_data;
+
+    stream_data = calloc(1, sizeof(stream_data[0]));
+    if (stream_data == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    if (pthread_cond_init(&stream_data->stream_done, NULL) != 0) {
+        free(stream_data);
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    stream_data->num_transfers = num_transfers;
+    stream_data->transfers =
+        calloc(num_transfers, sizeof(stream_data->transfers[0]));
+    stream_data->deferred =
+        calloc(num_transfers, sizeof(stream_data->deferred[0]));
+
+    if (stream_data->transfers == NULL || stream_data->deferred == NULL) {
+        log_error("Failed to allocate usbfs transfers\n");
+        free_stream_data(stream_data);
+        return BLADERF_ERR_MEM;
+    }
+
+    for (i = 0; i < num_transfers; i++) {
+        struct usbfs_transfer *t = &stream_data->transfers[i];
+
+        t->urb = calloc(1, sizeof(t->urb[0]));
+        if (t->urb == NULL) {
+            log_error("Failed to allocate usbfs URBs\n");
+            free_stream_data(stream_data);
+            return BLADERF_ERR_MEM;
+        }
+
+        t->stream = stream;
+        t->status = TRANSFER_AVAIL;
+        stream_data->num_avail++;
+    }
+
+    stream->backend_data = stream_data;
+    return 0;
+}
+
+/* usbfs URBs have no timeout, so fail the stream if any transfer has
+ * been in flight longer than the device's transfer timeout */
+static void check_timeouts(struct bladerf_stream *stream)
+{
+    size_t i;
+    struct usbfs_stream_data *stream_data = stream->backend_data;
+    const uint64_t timeout_us =
+        (uint64_t) stream->dev->transfer_timeout[stream->module] * 1000;
+    const uint64_t now_us = async_stats_time_us();
+
+    if (timeout_us == 0 || stream->state != STREAM_RUNNING) {
+        return;
+    }
+
+    for (i = 0; i < stream_data->num_transfers; i++) {
+        const struct usbfs_transfer *t = &stream_data->transfers[i];
+
+        if (t->status == TRANSFER_IN_FLIGHT &&
+            now_us - t->submit_time_us >= timeout_us) {
+
+            log_debug("%s: Transfer timed out.\n", __FUNCTION__);
+            stream->error_code = BLADERF_ERR_TIMEOUT;
+            stream->state = STREAM_SHUTTING_DOWN;
+            cancel_all_transfers(stream);
+            break;
+        }
+    }
+}
+
+/* Completions execute on the reap thread, so apply the stream's
+ * scheduling options there. These are left in place after the stream ends,
+ * as the thread is shared by all of the device's streams. */
+static void apply_reap_thread_config(struct bladerf_usbfs *usbfs,
+                                     struct bladerf_stream *stream,
+                                     bladerf_module module)
+{
+    int status;
+    const struct bladerf_stream_thread_config *config =
+        &stream->thread_config[module];
+    const uint64_t cpus = async_thread_cpus(stream, module);
+
+    if (config->policy != BLADERF_SCHED_DEFAULT) {
+        const thread_sched_policy policy =
+            (config->policy == BLADERF_SCHED_FIFO) ?
+                THREAD_SCHED_FIFO : THREAD_SCHED_RR;
+
+        status = thread_set_sched(usbfs->reap_thread, policy,
+                                  config->priority);
+        if (status != 0) {
+            log_warning("Failed to set usbfs reap thread priority: %s\n",
+                        strerror(status));
+        }
+    }
+
+    if (cpus != 0) {
+        status = thread_set_affinity(usbfs->reap_thread, cpus);
+        if (status != 0) {
+            log_warning("Failed to set usbfs reap thread CPU affinity: "
+                        "%s\n", strerror(status));
+        }
+    }
+}
+
+static int usbfs_stream(void *driver, struct bladerf_stream *stream,
+                        bladerf_module module)
+{
+    size_t i;
+    int status = 0;
+    void *buffer;
+    struct timespec timeout_abs;
+    struct bladerf_metadata metadata;
+    struct bladerf *dev = stream->dev;
+    struct bladerf_usbfs *usbfs = (struct bladerf_usbfs *) driver;
+    struct usbfs_stream_data *stream_data = stream->backend_data;
+
+    /* TX callbacks are given zeroed metadata */
+    memset(&metadata, 0, sizeof(metadata));
+
+    apply_reap_thread_config(usbfs, stream, module);
+
+    MUTEX_LOCK(&stream->lock);
+
+    stream_data->deferred_head = 0;
+    stream_data->deferred_count = 0;
+
+    /* Set up initial set of buffers */
+    for (i = 0; i < stream_data->num_transfers; i++) {
+        if (module == BLADERF_MODULE_TX) {
+            buffer = stream->cb(dev,
+                                stream,
+                                &metadata,
+                                NULL,
+                                stream->samples_per_buffer,
+                                stream->user_data);
+
+            if (buffer == BLADERF_STREAM_SHUTDOWN) {
+                stream->state = STREAM_SHUTTING_DOWN;
+                break;
+            }
+        } else {
+            buffer = stream->buffers[i];
+        }
+
+        if (buffer != BLADERF_STREAM_NO_DATA) {
+            status = queue_buffer(stream, buffer);
+
+            /* If we failed to submit any transfers, cancel everything in
+             * flight and wait for the URBs to be reaped */
+            if (status < 0) {
+                stream->error_code = status;
+                stream->state = STREAM_SHUTTING_DOWN;
+                break;
+            }
+        }
+    }
+
+    check_stream_done(stream);
+
+    /* The device's reap thread executes our callbacks. We need only wait
+     * for them to bring the stream to completion, checking for transfers
+     * that have timed out along the way. */
+    while (stream->state != STREAM_DONE) {
+        if (populate_abs_timeout(&timeout_abs, USBFS_TIMEOUT_CHECK_MS) != 0 ||
+            pthread_cond_timedwait(&stream_data->stream_done, &stream->lock,
+                                   &timeout_abs) == ETIMEDOUT) {
+            check_timeouts(stream);
+        }
+    }
+
+    MUTEX_UNLOCK(&stream->lock);
+
+    return status;
+}
+
+/* The top-level code will have aquired the stream->lock for us */
+static int usbfs_submit_stream_buffer(void *driver,
+                                      struct bladerf_stream *stream,
+                                      void *buffer, unsigned int timeout_ms)
+{
+    int status = 0;
+    struct usbfs_stream_data *stream_data = stream->backend_data;
+    struct timespec timeout_abs;
+
+    if (buffer == BLADERF_STREAM_SHUTDOWN) {
+        stream->state = STREAM_SHUTTING_DOWN;
+        check_stream_done(stream);
+        return 0;
+    }
+
+    if (timeout_ms != 0) {
+        status = populate_abs_timeout(&timeout_abs, timeout_ms);
+        if (status != 0) {
+            return BLADERF_ERR_UNEXPECTED;
+        }
+
+        while ((stream_data->num_avail == 0 || !below_transfer_limit(stream))
+               && status == 0) {
+            status = pthread_cond_timedwait(&stream->can_submit_buffer,
+                    &stream->lock,
+                    &timeout_abs);
+        }
+    } else {
+        while ((stream_data->num_avail == 0 || !below_transfer_limit(stream))
+               && status == 0) {
+            status = pthread_cond_wait(&stream->can_submit_buffer,
+                                       &stream->lock);
+        }
+    }
+
+    if (status == ETIMEDOUT) {
+        log_debug("%s: Timed out waiting for a transfer to become availble.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_TIMEOUT;
+    } else if (status != 0) {
+        return BLADERF_ERR_UNEXPECTED;
+    } else {
+        return submit_transfer(stream, buffer);
+    }
+}
+
+static int usbfs_deinit_stream(void *driver, struct bladerf_stream *stream)
+{
+    free_stream_data(stream->backend_data);
+    stream->backend_data = NULL;
+    return 0;
+}
+
+/* Memory mapped from the device node is used directly by the host
+ * controller, avoiding a copy on each transfer (Linux >= 4.6) */
+static void *usbfs_alloc_dev_mem(void *driver, size_t len)
+{
+    struct bladerf_usbfs *usbfs = (struct bladerf_usbfs *) driver;
+    void *mem;
+
+    mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, usbfs->fd, 0);
+    if (mem == MAP_FAILED) {
+        log_debug("Failed to map %zu bytes of usbfs memory: %s\n",
+                  len, strerror(errno));
+        return NULL;
+    }
+
+    memset(mem, 0, len);
+    return mem;
+}
+
+static void usbfs_free_dev_mem(void *driver, void *mem, size_t len)
+{
+    munmap(mem, len);
+}
+
+static const struct usb_fns usbfs_fns = {
+    FIELD_INIT(.probe, usbfs_probe),
+    FIELD_INIT(.open, usbfs_open),
+    FIELD_INIT(.close, usbfs_close),
+    FIELD_INIT(.get_speed, usbfs_get_speed),
+    FIELD_INIT(.change_setting, usbfs_change_setting),
+    FIELD_INIT(.control_transfer, usbfs_control_transfer),
+    FIELD_INIT(.bulk_transfer, usbfs_bulk_transfer),
+    FIELD_INIT(.get_string_descriptor, usbfs_get_string_descriptor),
+    FIELD_INIT(.init_stream, usbfs_init_stream),
+    FIELD_INIT(.stream, usbfs_stream),
+    FIELD_INIT(.submit_stream_buffer, usbfs_submit_stream_buffer),
+    FIELD_INIT(.deinit_stream, usbfs_deinit_stream),
+    FIELD_INIT(.open_bootloader, usbfs_open_bootloader),
+    FIELD_INIT(.close_bootloader, usbfs_close_bootloader),
+    FIELD_INIT(.alloc_dev_mem, usbfs_alloc_dev_mem),
+    FIELD_INIT(.free_dev_mem, usbfs_free_dev_mem),
+};
+
+const struct usb_driver usb_driver_usbfs = {
+    FIELD_INIT(.id, BLADERF_BACKEND_USBFS),
+    FIELD_INIT(.fn, &usbfs_fns)
+};
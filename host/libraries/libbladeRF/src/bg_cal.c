@@ -0,0 +1,426 @@
+/*
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <math.h>
+#include <string.h>
+#include <libbladeRF.h>
+
+#include "bg_cal.h"
+#include "log.h"
+
+#ifndef M_PI
+#   define M_PI 3.14159265358979323846
+#endif
+
+/* Resolution of the LMS6002D's RX DC offset corrections, in
+ * BLADERF_CORR_LMS_DCOFF_* units */
+#define BG_CAL_DC_STEP 32
+
+/* Range of BLADERF_CORR_LMS_DCOFF_* values */
+#define BG_CAL_DC_MAX 2048
+
+/* Step made to learn the response of the DC offset to its correction */
+#ifndef BG_CAL_DC_PROBE
+#   define BG_CAL_DC_PROBE 128
+#endif
+
+/* DC offsets within this many SC16 Q11 units are left uncorrected */
+#ifndef BG_CAL_DC_TOLERANCE
+#   define BG_CAL_DC_TOLERANCE 2.0
+#endif
+
+/* Measured slopes smaller than this, in SC16 Q11 units of DC offset per unit
+ * of correction, are attributed to noise */
+#define BG_CAL_DC_SLOPE_MIN 1e-3
+
+/* Range of BLADERF_CORR_FPGA_* values */
+#define BG_CAL_IQ_MAX 4096
+
+/* Full scale of BLADERF_CORR_FPGA_PHASE, in radians */
+#define BG_CAL_PHASE_SCALE ((10.0 * M_PI / 180.0) / 4096.0)
+
+/* Gain and phase changes of fewer than this many units are not applied, so
+ * that noisy estimates do not cause a stream of writes */
+#ifndef BG_CAL_IQ_DEADBAND
+#   define BG_CAL_IQ_DEADBAND 2
+#endif
+
+/* Windows with a lower mean power, relative to full scale, are not used to
+ * estimate the IQ imbalance (-60 dBFS) */
+#define BG_CAL_IQ_POWER_MIN 1e-6
+
+/* Errors are corrected only when they exceed this many standard deviations of
+ * their estimate, as expected from the noise in a window */
+#ifndef BG_CAL_NOISE_SIGMAS
+#   define BG_CAL_NOISE_SIGMAS 3.0
+#endif
+
+/* Fraction of each estimated error that is corrected per update */
+#ifndef BG_CAL_LOOP_GAIN
+#   define BG_CAL_LOOP_GAIN 0.5
+#endif
+
+static inline long clamp(long x, long lo, long hi)
+{
+    return (x < lo) ? lo : ((x > hi) ? hi : x);
+}
+
+static inline long clamp_step(long next, long prev, unsigned int max_step)
+{
+    return clamp(next, prev - (long) max_step, prev + (long) max_step);
+}
+
+static void dc_init(struct bg_cal_dc *dc, int16_t x)
+{
+    memset(dc, 0, sizeof(*dc));
+    dc->x = x;
+}
+
+/* Update a DC offset search with the offset `y` measured with its current
+ * correction, returning the next correction. Offsets within `tolerance` are
+ * left uncorrected. */
+static int16_t dc_next(struct bg_cal_dc *dc, double y, double tolerance,
+                       unsigned int max_step)
+{
+    double dx;
+    long steps;
+
+    if (dc->have_prev && dc->x != dc->prev_x) {
+        const double s = (y - dc->prev_y) / (dc->x - dc->prev_x);
+
+        /* A change of sign is more likely the result of the signal or gain
+         * changing between measurements than of the response changing */
+        if (fabs(s) >= BG_CAL_DC_SLOPE_MIN &&
+            (dc->slope == 0.0 || (s > 0.0) == (dc->slope > 0.0))) {
+            dc->slope = (dc->slope == 0.0) ? s : 0.5 * (dc->slope + s);
+        }
+    }
+
+    dc->prev_x = dc->x;
+    dc->prev_y = y;
+    dc->have_prev = true;
+
+    if (fabs(y) <= tolerance) {
+        return dc->x;
+    }
+
+    if (dc->slope == 0.0) {
+        dx = (y > 0.0) ? -BG_CAL_DC_PROBE : BG_CAL_DC_PROBE;
+    } else {
+        dx = -BG_CAL_LOOP_GAIN * y / dc->slope;
+    }
+
+    if (max_step < BG_CAL_DC_STEP) {
+        max_step = BG_CAL_DC_STEP;
+    }
+
+    dx = (dx > max_step) ? max_step : ((dx < -(double) max_step) ?
+                                       -(double) max_step : dx);
+
+    steps = lrint(dx / BG_CAL_DC_STEP);
+
+    return (int16_t) clamp(dc->x + steps * BG_CAL_DC_STEP,
+                           -BG_CAL_DC_MAX, BG_CAL_DC_MAX);
+}
+
+/* Estimate the IQ imbalance from the variances and covariance of a window of
+ * `n` samples, and compute the next gain and phase corrections
+ *
+ * @pre lock is held */
+static void iq_next(struct bg_cal *cal, double n, double var_i, double var_q,
+                    double cov, int16_t *gain, int16_t *phase)
+{
+    const unsigned int max_step = cal->config.max_iq_step;
+    const double noise = BG_CAL_NOISE_SIGMAS / sqrt(n);
+    struct bladerf_rx_bg_cal_state *st = &cal->state;
+    double ratio, rho, g, t;
+    long next;
+
+    *gain = st->gain;
+    *phase = st->phase;
+
+    if (var_i + var_q < BG_CAL_IQ_POWER_MIN || var_i <= 0.0 || var_q <= 0.0) {
+        return;
+    }
+
+    ratio = sqrt(var_q / var_i);
+    rho = cov / sqrt(var_i * var_q);
+    rho = (rho > 1.0) ? 1.0 : ((rho < -1.0) ? -1.0 : rho);
+
+    st->gain_error_db = (float) (20.0 * log10(ratio));
+    st->phase_error_deg = (float) (asin(rho) * 180.0 / M_PI);
+
+    /* The FPGA scales I by the gain correction */
+    if (fabs(ratio - 1.0) > noise) {
+        g = (1.0 + st->gain / 4096.0) *
+            (1.0 + BG_CAL_LOOP_GAIN * (ratio - 1.0));
+        next = clamp_step(lrint(g * 4096.0) - 4096, st->gain, max_step);
+        next = clamp(next, -BG_CAL_IQ_MAX, BG_CAL_IQ_MAX);
+        if (labs(next - st->gain) >= BG_CAL_IQ_DEADBAND) {
+            *gain = (int16_t) next;
+        }
+    }
+
+    /* The FPGA adds tan(phase) times each component to the other, which
+     * changes their covariance by approximately tan(phase) * (var_i + var_q) */
+    if (fabs(rho) > noise) {
+        t = tan(st->phase * BG_CAL_PHASE_SCALE) -
+            BG_CAL_LOOP_GAIN * cov / (var_i + var_q);
+        next = clamp_step(lrint(atan(t) / BG_CAL_PHASE_SCALE), st->phase,
+                          max_step);
+        next = clamp(next, -BG_CAL_IQ_MAX, BG_CAL_IQ_MAX);
+        if (labs(next - st->phase) >= BG_CAL_IQ_DEADBAND) {
+            *phase = (int16_t) next;
+        }
+    }
+}
+
+/* Apply changed corrections, in one batch of LMS6002D writes
+ *
+ * @pre lock is held */
+static int bg_cal_apply(struct bladerf *dev, struct bg_cal *cal,
+                        int16_t dc_i, int16_t dc_q,
+                        int16_t gain, int16_t phase)
+{
+    int status, end_status;
+    uint64_t now;
+    struct bladerf_rx_bg_cal_state *st = &cal->state;
+
+    status = bladerf_batch_begin(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    if (dc_i != st->dc_i) {
+        status = bladerf_set_correction(dev, BLADERF_MODULE_RX,
+                                        BLADERF_CORR_LMS_DCOFF_I, dc_i);
+    }
+
+    if (status == 0 && dc_q != st->dc_q) {
+        status = bladerf_set_correction(dev, BLADERF_MODULE_RX,
+                                        BLADERF_CORR_LMS_DCOFF_Q, dc_q);
+    }
+
+    if (status == 0 && gain != st->gain) {
+        status = bladerf_set_correction(dev, BLADERF_MODULE_RX,
+                                        BLADERF_CORR_FPGA_GAIN, gain);
+    }
+
+    if (status == 0 && phase != st->phase) {
+        status = bladerf_set_correction(dev, BLADERF_MODULE_RX,
+                                        BLADERF_CORR_FPGA_PHASE, phase);
+    }
+
+    end_status = bladerf_batch_end(dev);
+    if (status == 0) {
+        status = end_status;
+    }
+
+    if (status == 0) {
+        status = bladerf_get_timestamp(dev, BLADERF_MODULE_RX, &now);
+    }
+
+    if (status != 0) {
+        return status;
+    }
+
+    st->dc_i = cal->dc[0].x = dc_i;
+    st->dc_q = cal->dc[1].x = dc_q;
+    st->gain = gain;
+    st->phase = phase;
+    st->updates++;
+
+    cal->settled = now + cal->config.settle;
+    return 0;
+}
+
+/* Evaluate a complete window
+ *
+ * @pre lock is held */
+static int bg_cal_update(struct bladerf *dev, struct bg_cal *cal)
+{
+    struct bladerf_rx_bg_cal_state *st = &cal->state;
+    const struct dsp_iq_stats *s = &cal->stats;
+    const double n = cal->count;
+    const double mean_i = s->i / n;
+    const double mean_q = s->q / n;
+    const double var_i = s->ii / n - mean_i * mean_i;
+    const double var_q = s->qq / n - mean_q * mean_q;
+    int16_t dc_i = st->dc_i, dc_q = st->dc_q;
+    int16_t gain = st->gain, phase = st->phase;
+
+    st->estimates++;
+    st->dc_i_error = (float) (mean_i * 2048.0);
+    st->dc_q_error = (float) (mean_q * 2048.0);
+
+    if (cal->config.flags & BLADERF_RX_BG_CAL_DC) {
+        const double tol_i = 2048.0 * BG_CAL_NOISE_SIGMAS *
+                             sqrt((var_i > 0.0 ? var_i : 0.0) / n);
+        const double tol_q = 2048.0 * BG_CAL_NOISE_SIGMAS *
+                             sqrt((var_q > 0.0 ? var_q : 0.0) / n);
+
+        dc_i = dc_next(&cal->dc[0], mean_i * 2048.0,
+                       (tol_i > BG_CAL_DC_TOLERANCE) ? tol_i :
+                                                       BG_CAL_DC_TOLERANCE,
+                       cal->config.max_dc_step);
+
+        dc_q = dc_next(&cal->dc[1], mean_q * 2048.0,
+                       (tol_q > BG_CAL_DC_TOLERANCE) ? tol_q :
+                                                       BG_CAL_DC_TOLERANCE,
+                       cal->config.max_dc_step);
+    }
+
+    if (cal->config.flags & BLADERF_RX_BG_CAL_IQ) {
+        iq_next(cal, n, var_i, var_q, s->iq / n - mean_i * mean_q,
+                &gain, &phase);
+    }
+
+    if (dc_i == st->dc_i && dc_q == st->dc_q &&
+        gain == st->gain && phase == st->phase) {
+        return 0;
+    }
+
+    log_verbose("%s: DC (%d, %d), gain %d, phase %d\n", __FUNCTION__,
+                dc_i, dc_q, gain, phase);
+
+    return bg_cal_apply(dev, cal, dc_i, dc_q, gain, phase);
+}
+
+void bg_cal_init(struct bg_cal *cal)
+{
+    memset(cal, 0, sizeof(*cal));
+    MUTEX_INIT(&cal->lock);
+}
+
+int bg_cal_config(struct bladerf *dev, struct bg_cal *cal,
+                  const struct bladerf_rx_bg_cal_config *config)
+{
+    int status = 0;
+    int16_t dc_i = 0, dc_q = 0, gain = 0, phase = 0;
+    const uint32_t flags = BLADERF_RX_BG_CAL_DC | BLADERF_RX_BG_CAL_IQ;
+
+    if (config != NULL &&
+        (config->flags == 0 || (config->flags & ~flags) != 0 ||
+         config->window == 0 ||
+         config->max_dc_step == 0 || config->max_iq_step == 0)) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&cal->lock);
+
+    cal->enabled = false;
+
+    if (config != NULL) {
+        /* Start from the corrections currently applied */
+        status = bladerf_get_correction(dev, BLADERF_MODULE_RX,
+                                        BLADERF_CORR_LMS_DCOFF_I, &dc_i);
+        if (status == 0) {
+            status = bladerf_get_correction(dev, BLADERF_MODULE_RX,
+                                            BLADERF_CORR_LMS_DCOFF_Q, &dc_q);
+        }
+
+        if (status == 0 && (config->flags & BLADERF_RX_BG_CAL_IQ)) {
+            status = bladerf_get_correction(dev, BLADERF_MODULE_RX,
+                                            BLADERF_CORR_FPGA_GAIN, &gain);
+        }
+
+        if (status == 0 && (config->flags & BLADERF_RX_BG_CAL_IQ)) {
+            status = bladerf_get_correction(dev, BLADERF_MODULE_RX,
+                                            BLADERF_CORR_FPGA_PHASE, &phase);
+        }
+
+        if (status == 0) {
+            cal->config = *config;
+            cal->settled = 0;
+            cal->count = 0;
+            memset(&cal->stats, 0, sizeof(cal->stats));
+
+            dc_init(&cal->dc[0], dc_i);
+            dc_init(&cal->dc[1], dc_q);
+
+            memset(&cal->state, 0, sizeof(cal->state));
+            cal->state.dc_i = dc_i;
+            cal->state.dc_q = dc_q;
+            cal->state.gain = gain;
+            cal->state.phase = phase;
+
+            cal->enabled = true;
+        }
+    }
+
+    MUTEX_UNLOCK(&cal->lock);
+    return status;
+}
+
+void bg_cal_get_state(struct bg_cal *cal,
+                      struct bladerf_rx_bg_cal_state *state)
+{
+    MUTEX_LOCK(&cal->lock);
+    *state = cal->state;
+    MUTEX_UNLOCK(&cal->lock);
+}
+
+int bg_cal_process(struct bladerf *dev, struct bg_cal *cal,
+                   const void *samples, bladerf_format format,
+                   const struct bladerf_metadata *meta)
+{
+    int status = 0;
+    unsigned int skip = 0, n;
+
+    if (format != BLADERF_FORMAT_SC16_Q11_META &&
+        format != BLADERF_FORMAT_CF32_META) {
+        return 0;
+    }
+
+    MUTEX_LOCK(&cal->lock);
+
+    if (!cal->enabled) {
+        MUTEX_UNLOCK(&cal->lock);
+        return 0;
+    }
+
+    /* Samples received before the most recent correction has settled do not
+     * reflect it */
+    if (meta->timestamp < cal->settled) {
+        skip = (cal->settled - meta->timestamp < meta->actual_count) ?
+               (unsigned int) (cal->settled - meta->timestamp) :
+               meta->actual_count;
+    }
+
+    n = meta->actual_count - skip;
+
+    if (format == BLADERF_FORMAT_SC16_Q11_META) {
+        const int16_t *s = (const int16_t *) samples;
+        dsp_iq_stats_sc16_q11(&s[2 * skip], n, &cal->stats);
+    } else {
+        const float *s = (const float *) samples;
+        dsp_iq_stats_cf32(&s[2 * skip], n, &cal->stats);
+    }
+
+    cal->count += n;
+
+    if (cal->count >= cal->config.window) {
+        status = bg_cal_update(dev, cal);
+
+        memset(&cal->stats, 0, sizeof(cal->stats));
+        cal->count = 0;
+    }
+
+    MUTEX_UNLOCK(&cal->lock);
+    return status;
+}
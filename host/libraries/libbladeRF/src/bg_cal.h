@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef BLADERF_BG_CAL_H_
+#define BLADERF_BG_CAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <libbladeRF.h>
+#include "thread.h"
+#include "dsp.h"
+
+struct bladerf;
+
+/* Secant search of one of the DC offset correction channels, whose resulting
+ * DC offset is approximately linear in the correction value */
+struct bg_cal_dc {
+    int16_t x;                  /* Applied correction */
+    int16_t prev_x;             /* Correction of the previous measurement */
+    double prev_y;              /* DC offset of the previous measurement */
+    bool have_prev;             /* `prev_x` and `prev_y` are valid */
+    double slope;               /* Change in DC offset per unit of correction,
+                                 * or 0.0 while it is not yet known */
+};
+
+struct bg_cal {
+    MUTEX lock;
+    bool enabled;
+    struct bladerf_rx_bg_cal_config config;
+
+    uint64_t settled;           /* Timestamp at which the most recent
+                                 * correction has settled */
+
+    struct dsp_iq_stats stats;  /* Statistics of the current window */
+    unsigned int count;         /* Number of samples in `stats` */
+
+    struct bg_cal_dc dc[2];     /* I and Q DC offset searches */
+    struct bladerf_rx_bg_cal_state state;
+};
+
+/**
+ * Initialize background calibration. It is disabled.
+ */
+void bg_cal_init(struct bg_cal *cal);
+
+/**
+ * Enable background calibration with the specified configuration, starting
+ * from the corrections currently applied, or disable it if `config` is NULL.
+ * The caller must not hold any of dev->ctrl_lock[].
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int bg_cal_config(struct bladerf *dev, struct bg_cal *cal,
+                  const struct bladerf_rx_bg_cal_config *config);
+
+/**
+ * Get the current state of background calibration
+ */
+void bg_cal_get_state(struct bg_cal *cal,
+                      struct bladerf_rx_bg_cal_state *state);
+
+/**
+ * Accumulate the statistics of received samples, and update the corrections
+ * at the end of each window. This does nothing if background calibration is
+ * disabled or `format` is not supported. The caller must not hold any of
+ * dev->ctrl_lock[] or dev->sync_lock[].
+ *
+ * @param   dev         Device handle
+ * @param   cal         Background calibration
+ * @param   samples     Samples returned by sync_rx()
+ * @param   format      Host format of `samples`
+ * @param   meta        Metadata returned by sync_rx()
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure to apply a correction
+ */
+int bg_cal_process(struct bladerf *dev, struct bg_cal *cal,
+                   const void *samples, bladerf_format format,
+                   const struct bladerf_metadata *meta);
+
+#endif
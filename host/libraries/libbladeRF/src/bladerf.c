@@ -29,6 +29,14 @@
 #include "async.h"
 #include "sync.h"
 #include "tuning.h"
+#include "trace.h"
+#include "repeater.h"
+#include "rx_pipeline.h"
+#include "bw_probe.h"
+#include "pattern.h"
+#include "dsp.h"
+#include "multi.h"
+#include "rx_share.h"
 #include "gain.h"
 #include "lms.h"
 #include "xb.h"
@@ -45,6 +53,8 @@
 #include "fpga.h"
 #include "flash_fields.h"
 #include "backend/usb/usb.h"
+#include "backend/backend_config.h"
+#include "backend/net/net.h"
 #include "fx3_fw.h"
 
 static int probe(backend_probe_target target_device,
@@ -85,12 +95,114 @@ void bladerf_free_device_list(struct bladerf_devinfo *devices)
     free(devices);
 }
 
+/* Read the VCTCXO trim and FPGA size from the calibration region of flash */
+static void open_cal_region(struct bladerf *dev)
+{
+    int status;
+
+    /* VCTCXO trim and FPGA size are non-fatal indicators that we've
+     * trashed the calibration region of flash. If these were made fatal,
+     * we wouldn't be able to open the device to restore them. */
+    status = get_and_cache_vctcxo_trim(dev);
+    if (status < 0) {
+        log_warning("Failed to get VCTCXO trim value: %s\n",
+                    bladerf_strerror(status));
+    }
+
+    status = get_and_cache_fpga_size(dev);
+    if (status < 0) {
+        log_warning("Failed to get FPGA size %s\n",
+                    bladerf_strerror(status));
+    }
+}
+
+/* Initialize the device if its FPGA is already configured. Otherwise, attempt
+ * to autoload an FPGA from the config search path. */
+static int open_fpga(struct bladerf *dev)
+{
+    int status;
+
+    status = FPGA_IS_CONFIGURED(dev);
+    if (status > 0) {
+        /* If the FPGA version check fails, just warn, but don't error out.
+         *
+         * If an error code caused this function to bail out, it would prevent a
+         * user from being able to unload and reflash a bitstream being
+         * "autoloaded" from SPI flash. */
+        fpga_check_version(dev);
+
+        status = init_device(dev);
+    } else {
+        /* Try searching for an FPGA in the config search path */
+        status = config_load_fpga(dev);
+    }
+
+    return status;
+}
+
+/* Perform the specified portions of the open that were deferred via
+ * BLADERF_OPEN_DEFER_* flags, and that remain outstanding. Each is only
+ * attempted once. The control lock must be held. */
+static int complete_deferred_open_locked(struct bladerf *dev, uint32_t which)
+{
+    int status = 0;
+    uint32_t todo;
+
+    /* Initializing the device requires the calibration region fields and
+     * the DC calibration tables */
+    if (which & BLADERF_OPEN_DEFER_FPGA) {
+        which |= BLADERF_OPEN_DEFER_CAL_REGION | BLADERF_OPEN_DEFER_DC_CALS;
+    }
+
+    todo = dev->deferred & which;
+    if (todo == 0) {
+        return 0;
+    }
+
+    dev->deferred &= ~todo;
+
+    if (todo & BLADERF_OPEN_DEFER_CAL_REGION) {
+        log_verbose("Reading deferred calibration region fields.\n");
+        open_cal_region(dev);
+    }
+
+    if (todo & BLADERF_OPEN_DEFER_DC_CALS) {
+        log_verbose("Loading deferred DC calibration tables.\n");
+        status = config_load_dc_cals(dev);
+    }
+
+    if (status == 0 && (todo & BLADERF_OPEN_DEFER_FPGA)) {
+        log_verbose("Performing deferred FPGA initialization.\n");
+        status = open_fpga(dev);
+    }
+
+    return status;
+}
+
+static int complete_deferred_open(struct bladerf *dev, uint32_t which)
+{
+    int status;
+
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
+    status = complete_deferred_open_locked(dev, which);
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
+
+    return status;
+}
+
 int bladerf_open_with_devinfo(struct bladerf **opened_device,
                               struct bladerf_devinfo *devinfo)
+{
+    return bladerf_open_with_flags(opened_device, devinfo, 0);
+}
+
+int bladerf_open_with_flags(struct bladerf **opened_device,
+                            struct bladerf_devinfo *devinfo, uint32_t flags)
 {
     struct bladerf *dev;
     struct bladerf_devinfo any_device;
     int status;
+    unsigned int i;
 
     if (devinfo == NULL) {
         bladerf_init_devinfo(&any_device);
@@ -104,9 +216,27 @@ int bladerf_open_with_devinfo(struct bladerf **opened_device,
         return BLADERF_ERR_MEM;
     }
 
-    MUTEX_INIT(&dev->ctrl_lock);
+    for (i = 0; i < NUM_CTRL_LOCKS; i++) {
+        MUTEX_INIT(&dev->ctrl_lock[i]);
+    }
+
+    MUTEX_INIT(&dev->xfer_lock);
     MUTEX_INIT(&dev->sync_lock[BLADERF_MODULE_RX]);
     MUTEX_INIT(&dev->sync_lock[BLADERF_MODULE_TX]);
+    MUTEX_INIT(&dev->sync_handle_lock[BLADERF_MODULE_RX]);
+    MUTEX_INIT(&dev->sync_handle_lock[BLADERF_MODULE_TX]);
+    MUTEX_INIT(&dev->stream_lock[BLADERF_MODULE_RX]);
+    MUTEX_INIT(&dev->stream_lock[BLADERF_MODULE_TX]);
+
+    ts_correlator_init(&dev->ts_corr[BLADERF_MODULE_RX], dev,
+                       BLADERF_MODULE_RX);
+    ts_correlator_init(&dev->ts_corr[BLADERF_MODULE_TX], dev,
+                       BLADERF_MODULE_TX);
+
+    hop_init(&dev->hop[BLADERF_MODULE_RX], dev, BLADERF_MODULE_RX);
+    hop_init(&dev->hop[BLADERF_MODULE_TX], dev, BLADERF_MODULE_TX);
+    agc_init(&dev->agc);
+    bg_cal_init(&dev->bg_cal);
 
     dev->fpga_version.describe = calloc(1, BLADERF_VERSION_STR_MAX + 1);
     if (dev->fpga_version.describe == NULL) {
@@ -179,51 +309,19 @@ int bladerf_open_with_devinfo(struct bladerf **opened_device,
         goto error;
     }
 
-    /* VCTCXO trim and FPGA size are non-fatal indicators that we've
-     * trashed the calibration region of flash. If these were made fatal,
-     * we wouldn't be able to open the device to restore them. */
-    status = get_and_cache_vctcxo_trim(dev);
-    if (status < 0) {
-        log_warning("Failed to get VCTCXO trim value: %s\n",
-                    bladerf_strerror(status));
-    }
-
-    status = get_and_cache_fpga_size(dev);
-    if (status < 0) {
-        log_warning("Failed to get FPGA size %s\n",
-                    bladerf_strerror(status));
-    }
-
     dev->rx_filter = -1;
     dev->tx_filter = -1;
 
     dev->module_format[BLADERF_MODULE_RX] = -1;
     dev->module_format[BLADERF_MODULE_TX] = -1;
 
-    /* Load any available calibration tables so that the LMS DC register
-     * configurations may be loaded in init_device */
-    status = config_load_dc_cals(dev);
-    if (status != 0) {
-        goto error;
-    }
-
-    status = FPGA_IS_CONFIGURED(dev);
-    if (status > 0) {
-        /* If the FPGA version check fails, just warn, but don't error out.
-         *
-         * If an error code caused this function to bail out, it would prevent a
-         * user from being able to unload and reflash a bitstream being
-         * "autoloaded" from SPI flash. */
-        fpga_check_version(dev);
-
-        status = init_device(dev);
-        if (status != 0) {
-            goto error;
-        }
-    } else {
-        /* Try searching for an FPGA in the config search path */
-        status = config_load_fpga(dev);
-    }
+    /* Perform everything that the caller has not asked us to defer. No other
+     * thread has access to the handle yet, so the control lock isn't needed.
+     *
+     * This loads any available calibration tables before init_device, so
+     * that their LMS DC register configurations may be applied. */
+    dev->deferred = BLADERF_OPEN_DEFER_ALL;
+    status = complete_deferred_open_locked(dev, ~flags & BLADERF_OPEN_DEFER_ALL);
 
 error:
     if (status < 0) {
@@ -253,14 +351,139 @@ int bladerf_open(struct bladerf **device, const char *dev_id)
     return status;
 }
 
+struct open_task {
+    pthread_t thread;
+    bool started;
+    struct bladerf_devinfo devinfo;
+    struct bladerf *dev;
+    int status;
+};
+
+static void *open_task(void *arg)
+{
+    struct open_task *task = (struct open_task *) arg;
+
+    task->status = bladerf_open_with_devinfo(&task->dev, &task->devinfo);
+    if (task->status != 0) {
+        log_debug("Failed to open %s: %s\n", task->devinfo.serial,
+                  bladerf_strerror(task->status));
+    }
+
+    return NULL;
+}
+
+int bladerf_open_many(struct bladerf **devices,
+                      struct bladerf_devinfo *devinfo,
+                      int *statuses, unsigned int n)
+{
+    struct open_task *tasks;
+    unsigned int i;
+    int status;
+    int num_opened = 0;
+
+    tasks = (struct open_task *) calloc(n, sizeof(tasks[0]));
+    if (tasks == NULL && n != 0) {
+        return BLADERF_ERR_MEM;
+    }
+
+    for (i = 0; i < n; i++) {
+        tasks[i].devinfo = devinfo[i];
+        tasks[i].status = BLADERF_ERR_UNEXPECTED;
+
+        status = pthread_create(&tasks[i].thread, NULL, open_task, &tasks[i]);
+        if (status == 0) {
+            tasks[i].started = true;
+        } else {
+            log_debug("Failed to start open thread: %s\n", strerror(status));
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        if (tasks[i].started) {
+            pthread_join(tasks[i].thread, NULL);
+        }
+
+        devices[i] = tasks[i].dev;
+        if (statuses != NULL) {
+            statuses[i] = tasks[i].status;
+        }
+
+        if (tasks[i].dev != NULL) {
+            num_opened++;
+        }
+    }
+
+    free(tasks);
+    return num_opened;
+}
+
+int bladerf_open_all(struct bladerf ***devices)
+{
+    struct bladerf_devinfo *list;
+    struct bladerf **opened;
+    int num_devices, num_opened;
+    int i, j;
+
+    *devices = NULL;
+
+    num_devices = bladerf_get_device_list(&list);
+    if (num_devices < 0) {
+        return num_devices;
+    }
+
+    opened = (struct bladerf **) calloc(num_devices, sizeof(opened[0]));
+    if (opened == NULL) {
+        bladerf_free_device_list(list);
+        return BLADERF_ERR_MEM;
+    }
+
+    num_opened = bladerf_open_many(opened, list, NULL, num_devices);
+    bladerf_free_device_list(list);
+
+    if (num_opened <= 0) {
+        free(opened);
+        return num_opened < 0 ? num_opened : BLADERF_ERR_NODEV;
+    }
+
+    /* Compact the list down to the devices that were opened */
+    for (i = j = 0; i < num_devices; i++) {
+        if (opened[i] != NULL) {
+            opened[j++] = opened[i];
+        }
+    }
+
+    *devices = opened;
+    return num_opened;
+}
+
+void bladerf_close_all(struct bladerf **devices, unsigned int n)
+{
+    unsigned int i;
+
+    if (devices != NULL) {
+        for (i = 0; i < n; i++) {
+            bladerf_close(devices[i]);
+        }
+
+        free(devices);
+    }
+}
+
 void bladerf_close(struct bladerf *dev)
 {
     if (dev) {
 
-        MUTEX_LOCK(&dev->ctrl_lock);
+        /* These acquire the control lock themselves */
+        ts_correlator_stop(&dev->ts_corr[BLADERF_MODULE_RX]);
+        ts_correlator_stop(&dev->ts_corr[BLADERF_MODULE_TX]);
+        hop_deinit(&dev->hop[BLADERF_MODULE_RX]);
+        hop_deinit(&dev->hop[BLADERF_MODULE_TX]);
+
+        CTRL_LOCK(dev, CTRL_LOCK_ALL);
         sync_deinit(dev->sync[BLADERF_MODULE_RX]);
         sync_deinit(dev->sync[BLADERF_MODULE_TX]);
 
+        lms_defer_flush(dev);
         dev->fn->close(dev);
 
         free((void *)dev->fpga_version.describe);
@@ -268,8 +491,12 @@ void bladerf_close(struct bladerf *dev)
 
         dc_cal_tbl_free(&dev->cal.dc_rx);
         dc_cal_tbl_free(&dev->cal.dc_tx);
+        trace_enable(dev, 0);
 
-        MUTEX_UNLOCK(&dev->ctrl_lock);
+        profile_free(&dev->profiles[BLADERF_MODULE_RX]);
+        profile_free(&dev->profiles[BLADERF_MODULE_TX]);
+
+        CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
         free(dev);
     }
 }
@@ -300,25 +527,117 @@ int bladerf_enable_module(struct bladerf *dev,
                 (m == BLADERF_MODULE_RX) ? "RX" : "TX",
                 enable ? "True" : "False") ;
 
-    MUTEX_LOCK(&dev->ctrl_lock);
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
 
     if (enable == false) {
+        /* A sync call in progress holds the sync_lock while it waits for
+         * buffers, so wake it first, rather than waiting out its timeout */
+        MUTEX_LOCK(&dev->sync_handle_lock[m]);
+        sync_shutdown(dev->sync[m]);
+        MUTEX_UNLOCK(&dev->sync_handle_lock[m]);
+
+        MUTEX_LOCK(&dev->sync_lock[m]);
+        MUTEX_LOCK(&dev->sync_handle_lock[m]);
         sync_deinit(dev->sync[m]);
         dev->sync[m] = NULL;
+        MUTEX_UNLOCK(&dev->sync_handle_lock[m]);
+        MUTEX_UNLOCK(&dev->sync_lock[m]);
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+
+    if (enable && dev->standby) {
+        log_debug("%s: Device is in standby.\n", __FUNCTION__);
+        CTRL_UNLOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (enable == false) {
         perform_format_deconfig(dev, m);
     }
 
     lms_enable_rffe(dev, m, enable);
-    status = dev->fn->enable_module(dev, m, enable);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    /* Settings written during a batch must be in place before streaming */
+    status = lms_defer_flush(dev);
+    if (status == 0) {
+        status = dev->fn->enable_module(dev, m, enable);
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_standby(struct bladerf *dev)
+{
+    int status;
+    unsigned int i;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    for (i = 0; i < NUM_MODULES; i++) {
+        hop_stop(&dev->hop[i]);
+
+        status = bladerf_enable_module(dev, (bladerf_module) i, false);
+        if (status != 0) {
+            return status;
+        }
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
+
+    if (!dev->standby) {
+        status = lms_standby(dev);
+        if (status == 0) {
+            status = si5338_enable_sample_clocks(dev, false);
+        }
+
+        /* Once the LMS6002D has been powered down, bladerf_resume() is
+         * required to bring it back up */
+        dev->standby = true;
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
+    return status;
+}
+
+int bladerf_resume(struct bladerf *dev)
+{
+    int status = 0;
+
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
+
+    if (dev->standby) {
+        status = si5338_enable_sample_clocks(dev, true);
+        if (status == 0) {
+            status = lms_resume(dev);
+        }
+
+        if (status == 0) {
+            dev->standby = false;
+        }
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
     return status;
 }
 
 int bladerf_set_loopback(struct bladerf *dev, bladerf_loopback l)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
 
     if (l == BLADERF_LB_FIRMWARE) {
         /* Firmware loopback was fully implemented in FW v1.7.1
@@ -370,7 +689,7 @@ int bladerf_set_loopback(struct bladerf *dev, bladerf_loopback l)
     }
 
 out:
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
     return status;
 }
 
@@ -379,7 +698,12 @@ int bladerf_get_loopback(struct bladerf *dev, bladerf_loopback *l)
     int status = BLADERF_ERR_UNEXPECTED;
     *l = BLADERF_LB_NONE;
 
-    MUTEX_LOCK(&dev->ctrl_lock);
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
 
     if (version_greater_or_equal(&dev->fw_version, 1, 7, 1)) {
         bool fw_lb_enabled;
@@ -393,7 +717,7 @@ int bladerf_get_loopback(struct bladerf *dev, bladerf_loopback *l)
         status = lms_get_loopback_mode(dev, l);
     }
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
     return status;
 }
 
@@ -402,11 +726,17 @@ int bladerf_set_rational_sample_rate(struct bladerf *dev, bladerf_module module,
                                      struct bladerf_rational_rate *actual)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_SI5338);
 
     status = si5338_set_rational_sample_rate(dev, module, rate, actual);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_SI5338);
     return status;
 }
 
@@ -414,11 +744,17 @@ int bladerf_set_sample_rate(struct bladerf *dev, bladerf_module module,
                             uint32_t rate, uint32_t *actual)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_SI5338);
 
     status = si5338_set_sample_rate(dev, module, rate, actual);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_SI5338);
     return status;
 }
 
@@ -426,11 +762,17 @@ int bladerf_get_rational_sample_rate(struct bladerf *dev, bladerf_module module,
                                      struct bladerf_rational_rate *rate)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_SI5338);
 
     status = si5338_get_rational_sample_rate(dev, module, rate);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_SI5338);
     return status;
 }
 
@@ -438,360 +780,2628 @@ int bladerf_get_sample_rate(struct bladerf *dev, bladerf_module module,
                             unsigned int *rate)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_SI5338);
 
     status = si5338_get_sample_rate(dev, module, rate);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_SI5338);
     return status;
 }
 
-int bladerf_get_sampling(struct bladerf *dev, bladerf_sampling *sampling)
+static inline int decimation_bits(bladerf_module module,
+                                  unsigned int *shift, uint32_t *mask)
 {
-    int status = 0;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    switch (module) {
+        case BLADERF_MODULE_RX:
+            *shift = BLADERF_GPIO_RX_DECIMATION_SHIFT;
+            *mask  = BLADERF_GPIO_RX_DECIMATION_MASK;
+            return 0;
 
-    status = lms_get_sampling(dev, sampling);
+        case BLADERF_MODULE_TX:
+            *shift = BLADERF_GPIO_TX_INTERPOLATION_SHIFT;
+            *mask  = BLADERF_GPIO_TX_INTERPOLATION_MASK;
+            return 0;
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
-    return status;
+        default:
+            return BLADERF_ERR_INVAL;
+    }
 }
 
-int bladerf_set_sampling(struct bladerf *dev, bladerf_sampling sampling)
+int bladerf_set_decimation(struct bladerf *dev, bladerf_module module,
+                           unsigned int factor)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    unsigned int shift;
+    uint32_t mask, gpio;
+    uint32_t rate_log2 = 0;
 
-    status = lms_select_sampling(dev, sampling);
+    status = decimation_bits(module, &shift, &mask);
+    if (status != 0) {
+        return status;
+    }
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
-    return status;
-}
+    if (factor == 0 || factor > BLADERF_DECIMATION_MAX ||
+        (factor & (factor - 1)) != 0) {
+        log_debug("Invalid decimation factor: %u\n", factor);
+        return BLADERF_ERR_INVAL;
+    }
+
+    while ((1u << rate_log2) < factor) {
+        rate_log2++;
+    }
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 5)) {
+        if (factor == 1) {
+            return 0;
+        }
+
+        log_warning("Decimation requires FPGA v0.1.5 or later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+
+    status = CONFIG_GPIO_READ(dev, &gpio);
+    if (status == 0) {
+        gpio = (gpio & ~mask) | (rate_log2 << shift);
+        status = CONFIG_GPIO_WRITE(dev, gpio);
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_get_decimation(struct bladerf *dev, bladerf_module module,
+                           unsigned int *factor)
+{
+    int status;
+    unsigned int shift;
+    uint32_t mask, gpio;
+
+    status = decimation_bits(module, &shift, &mask);
+    if (status != 0) {
+        return status;
+    }
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 5)) {
+        *factor = 1;
+        return 0;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = CONFIG_GPIO_READ(dev, &gpio);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    if (status == 0) {
+        *factor = 1u << ((gpio & mask) >> shift);
+    }
+
+    return status;
+}
+
+int bladerf_set_psd_averaging(struct bladerf *dev, unsigned int frames)
+{
+    int status;
+    uint32_t gpio;
+    uint32_t avg_log2 = 0;
+
+    if (frames == 0 || frames > BLADERF_PSD_AVERAGING_MAX ||
+        (frames & (frames - 1)) != 0) {
+        log_debug("Invalid number of frames to average: %u\n", frames);
+        return BLADERF_ERR_INVAL;
+    }
+
+    while ((1u << avg_log2) < frames) {
+        avg_log2++;
+    }
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 8)) {
+        log_warning("Power spectra require FPGA v0.1.8 or later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+
+    status = CONFIG_GPIO_READ(dev, &gpio);
+    if (status == 0) {
+        gpio = (gpio & ~BLADERF_GPIO_PSD_AVERAGING_MASK) |
+               (avg_log2 << BLADERF_GPIO_PSD_AVERAGING_SHIFT);
+        status = CONFIG_GPIO_WRITE(dev, gpio);
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_get_psd_averaging(struct bladerf *dev, unsigned int *frames)
+{
+    int status;
+    uint32_t gpio;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 8)) {
+        *frames = 1;
+        return 0;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = CONFIG_GPIO_READ(dev, &gpio);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    if (status == 0) {
+        *frames = 1u << ((gpio & BLADERF_GPIO_PSD_AVERAGING_MASK) >>
+                         BLADERF_GPIO_PSD_AVERAGING_SHIFT);
+    }
+
+    return status;
+}
+
+static int sc8_shift_check(struct bladerf *dev, bladerf_module module)
+{
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (dev->fn->get_sample_fmt == NULL || dev->fn->set_sample_fmt == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 11)) {
+        log_warning("8-bit samples require FPGA v0.1.11 or later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    return 0;
+}
+
+static inline unsigned int sc8_shift_pos(bladerf_module module)
+{
+    return (module == BLADERF_MODULE_RX) ? SAMPLE_FMT_RX_SC8_SHIFT_SHIFT :
+                                           SAMPLE_FMT_TX_SC8_SHIFT_SHIFT;
+}
+
+int bladerf_set_sc8_shift(struct bladerf *dev, bladerf_module module,
+                          unsigned int shift)
+{
+    int status;
+    uint32_t fmt;
+    const unsigned int pos = sc8_shift_pos(module);
+
+    if (shift > BLADERF_SC8_SHIFT_MAX) {
+        log_debug("Invalid 8-bit sample shift: %u\n", shift);
+        return BLADERF_ERR_INVAL;
+    }
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    status = sc8_shift_check(dev, module);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+
+    status = dev->fn->get_sample_fmt(dev, &fmt);
+    if (status == 0) {
+        fmt &= ~(SAMPLE_FMT_SC8_SHIFT_MASK << pos);
+        fmt |= (uint32_t) shift << pos;
+        status = dev->fn->set_sample_fmt(dev, fmt);
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_get_sc8_shift(struct bladerf *dev, bladerf_module module,
+                          unsigned int *shift)
+{
+    int status;
+    uint32_t fmt;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    status = sc8_shift_check(dev, module);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = dev->fn->get_sample_fmt(dev, &fmt);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    if (status == 0) {
+        *shift = (fmt >> sc8_shift_pos(module)) & SAMPLE_FMT_SC8_SHIFT_MASK;
+    }
+
+    return status;
+}
+
+static int tx_modulation_check(struct bladerf *dev)
+{
+    if (dev->fn->get_sample_fmt == NULL || dev->fn->set_sample_fmt == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 23)) {
+        log_warning("TX symbols require FPGA v0.1.23 or later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    return 0;
+}
+
+int bladerf_set_tx_modulation(struct bladerf *dev,
+                              bladerf_tx_modulation modulation)
+{
+    int status;
+    uint32_t fmt;
+
+    switch (modulation) {
+        case BLADERF_TX_MOD_BPSK:
+        case BLADERF_TX_MOD_QPSK:
+        case BLADERF_TX_MOD_8PSK:
+            break;
+
+        default:
+            log_debug("Invalid TX modulation: %d\n", modulation);
+            return BLADERF_ERR_INVAL;
+    }
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    status = tx_modulation_check(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+
+    status = dev->fn->get_sample_fmt(dev, &fmt);
+    if (status == 0) {
+        fmt &= ~(SAMPLE_FMT_TX_MOD_MASK << SAMPLE_FMT_TX_MOD_SHIFT);
+        fmt |= (uint32_t) modulation << SAMPLE_FMT_TX_MOD_SHIFT;
+        status = dev->fn->set_sample_fmt(dev, fmt);
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_get_tx_modulation(struct bladerf *dev,
+                              bladerf_tx_modulation *modulation)
+{
+    int status;
+    uint32_t fmt;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    status = tx_modulation_check(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = dev->fn->get_sample_fmt(dev, &fmt);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    if (status == 0) {
+        *modulation = (bladerf_tx_modulation)
+            ((fmt >> SAMPLE_FMT_TX_MOD_SHIFT) & SAMPLE_FMT_TX_MOD_MASK);
+    }
+
+    return status;
+}
+
+int bladerf_set_rx_tracking(struct bladerf *dev, uint32_t flags)
+{
+    int status;
+    uint32_t gpio;
+    const uint32_t mask = BLADERF_GPIO_RX_TRACK_DC | BLADERF_GPIO_RX_TRACK_IQ;
+
+    if ((flags & ~(BLADERF_RX_TRACK_DC | BLADERF_RX_TRACK_IQ)) != 0) {
+        log_debug("Invalid RX tracking flags: 0x%08x\n", flags);
+        return BLADERF_ERR_INVAL;
+    }
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 9)) {
+        if (flags == 0) {
+            return 0;
+        }
+
+        log_warning("RX tracking requires FPGA v0.1.9 or later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+
+    status = CONFIG_GPIO_READ(dev, &gpio);
+    if (status == 0) {
+        gpio &= ~mask;
+
+        if (flags & BLADERF_RX_TRACK_DC) {
+            gpio |= BLADERF_GPIO_RX_TRACK_DC;
+        }
+
+        if (flags & BLADERF_RX_TRACK_IQ) {
+            gpio |= BLADERF_GPIO_RX_TRACK_IQ;
+        }
+
+        status = CONFIG_GPIO_WRITE(dev, gpio);
+    }
+
+    if (status == 0) {
+        dev->rx_tracking = flags;
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_get_rx_tracking(struct bladerf *dev, uint32_t *flags)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    *flags = dev->rx_tracking;
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    return 0;
+}
+
+int bladerf_get_rx_tracking_state(struct bladerf *dev,
+                                  struct bladerf_rx_tracking *state)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    if (dev->fn->get_rx_tracking == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 9)) {
+        log_warning("RX tracking requires FPGA v0.1.9 or later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = dev->fn->get_rx_tracking(dev, state);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    if (status == 0) {
+        /* Report the gain as BLADERF_CORR_FPGA_GAIN does */
+        state->gain -= 4096;
+    }
+
+    return status;
+}
+
+int bladerf_get_fifo_levels(struct bladerf *dev,
+                            struct bladerf_fifo_levels *levels)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    if (dev->fn->get_fifo_levels == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 12)) {
+        log_warning("FIFO levels require FPGA v0.1.12 or later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = dev->fn->get_fifo_levels(dev, levels);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    if (status == 0 && levels->tx_low_water == 0xffff) {
+        levels->tx_low_water = levels->tx_depth;
+    }
+
+    return status;
+}
+
+int bladerf_get_tx_late(struct bladerf *dev, struct bladerf_tx_late *late)
+{
+    int status;
+    uint32_t val;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    if (dev->fn->get_tx_late == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 20)) {
+        log_warning("Late TX message counts require FPGA v0.1.20 or "
+                    "later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = dev->fn->get_tx_late(dev, &val);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    if (status == 0) {
+        late->count = val & 0xffff;
+        late->max_lateness = val >> 16;
+    }
+
+    return status;
+}
+
+static int rx_trigger_check(struct bladerf *dev)
+{
+    if (dev->fn->get_rx_trigger == NULL || dev->fn->set_rx_trigger == NULL ||
+        dev->fn->get_rx_trigger_status == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 14)) {
+        log_warning("RX triggers require FPGA v0.1.14 or later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    return 0;
+}
+
+int bladerf_set_rx_trigger(struct bladerf *dev,
+                           const struct bladerf_rx_trigger *trigger)
+{
+    int status;
+    uint32_t ctrl;
+
+    if (trigger->pre_samples > BLADERF_RX_TRIGGER_PRE_MAX) {
+        log_debug("Invalid pre-trigger length: %u\n", trigger->pre_samples);
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (trigger->source != BLADERF_RX_TRIGGER_POWER &&
+        trigger->source != BLADERF_RX_TRIGGER_EXTERNAL) {
+        log_debug("Invalid trigger source: %d\n", trigger->source);
+        return BLADERF_ERR_INVAL;
+    }
+
+    ctrl = trigger->pre_samples << RX_TRIGGER_CTRL_PRE_SHIFT;
+    if (trigger->enable) {
+        ctrl |= RX_TRIGGER_CTRL_ENABLE;
+    }
+    if (trigger->source == BLADERF_RX_TRIGGER_EXTERNAL) {
+        ctrl |= RX_TRIGGER_CTRL_EXTERNAL;
+    }
+    if (trigger->rearm) {
+        ctrl |= RX_TRIGGER_CTRL_REARM;
+    }
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    status = rx_trigger_check(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = dev->fn->set_rx_trigger(dev, ctrl, trigger->threshold,
+                                     trigger->post_samples);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    return status;
+}
+
+int bladerf_get_rx_trigger(struct bladerf *dev,
+                           struct bladerf_rx_trigger *trigger)
+{
+    int status;
+    uint32_t ctrl, level, post;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    status = rx_trigger_check(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = dev->fn->get_rx_trigger(dev, &ctrl, &level, &post);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    if (status == 0) {
+        trigger->enable = (ctrl & RX_TRIGGER_CTRL_ENABLE) != 0;
+        trigger->source = (ctrl & RX_TRIGGER_CTRL_EXTERNAL) ?
+                            BLADERF_RX_TRIGGER_EXTERNAL :
+                            BLADERF_RX_TRIGGER_POWER;
+        trigger->threshold = level;
+        trigger->pre_samples = (ctrl >> RX_TRIGGER_CTRL_PRE_SHIFT) &
+                                RX_TRIGGER_CTRL_PRE_MASK;
+        trigger->post_samples = post;
+        trigger->rearm = (ctrl & RX_TRIGGER_CTRL_REARM) != 0;
+    }
+
+    return status;
+}
+
+int bladerf_arm_rx_trigger(struct bladerf *dev)
+{
+    int status;
+    uint32_t ctrl, level, post;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    status = rx_trigger_check(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+
+    status = dev->fn->get_rx_trigger(dev, &ctrl, &level, &post);
+
+    /* The FPGA arms on a rising edge of the arm bit */
+    if (status == 0) {
+        ctrl &= ~RX_TRIGGER_CTRL_ARM;
+        status = dev->fn->set_rx_trigger(dev, ctrl, level, post);
+    }
+
+    if (status == 0) {
+        ctrl |= RX_TRIGGER_CTRL_ARM;
+        status = dev->fn->set_rx_trigger(dev, ctrl, level, post);
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    return status;
+}
+
+int bladerf_get_rx_trigger_state(struct bladerf *dev,
+                                 struct bladerf_rx_trigger_state *state)
+{
+    int status;
+    uint32_t reg;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    status = rx_trigger_check(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = dev->fn->get_rx_trigger_status(dev, &reg);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    if (status == 0) {
+        state->armed = (reg & RX_TRIGGER_STATUS_ARMED) != 0;
+        state->capturing = (reg & RX_TRIGGER_STATUS_CAPTURING) != 0;
+        state->triggers = reg & RX_TRIGGER_STATUS_COUNT_MASK;
+    }
+
+    return status;
+}
+
+int bladerf_set_rx_mux(struct bladerf *dev, bladerf_rx_mux mux)
+{
+    int status;
+    uint32_t gpio;
+
+    if (mux < BLADERF_RX_MUX_BASEBAND_LMS || mux > BLADERF_RX_MUX_PRBS) {
+        log_debug("Invalid RX mux: %d\n", mux);
+        return BLADERF_ERR_INVAL;
+    }
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    if (mux == BLADERF_RX_MUX_PRBS &&
+        version_less_than(&dev->fpga_version, 0, 1, 18)) {
+        log_warning("The PRBS RX mux requires FPGA v0.1.18 or later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+
+    status = CONFIG_GPIO_READ(dev, &gpio);
+    if (status == 0) {
+        gpio &= ~BLADERF_GPIO_RX_MUX_MASK;
+        gpio |= (uint32_t) mux << BLADERF_GPIO_RX_MUX_SHIFT;
+        status = CONFIG_GPIO_WRITE(dev, gpio);
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_get_rx_mux(struct bladerf *dev, bladerf_rx_mux *mux)
+{
+    int status;
+    uint32_t gpio;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = CONFIG_GPIO_READ(dev, &gpio);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    if (status == 0) {
+        const int val = (gpio & BLADERF_GPIO_RX_MUX_MASK) >>
+                        BLADERF_GPIO_RX_MUX_SHIFT;
+
+        *mux = val <= BLADERF_RX_MUX_PRBS ? (bladerf_rx_mux) val :
+                                            BLADERF_RX_MUX_INVALID;
+    } else {
+        *mux = BLADERF_RX_MUX_INVALID;
+    }
+
+    return status;
+}
+
+static int rx_channels_check(struct bladerf *dev)
+{
+    if (dev->fn->get_rx_channels == NULL || dev->fn->set_rx_channels == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 7)) {
+        log_warning("Channelizer channel selection requires "
+                    "FPGA v0.1.7 or later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    return 0;
+}
+
+int bladerf_set_rx_channels(struct bladerf *dev, uint32_t mask)
+{
+    int status;
+    unsigned int i, count = 0;
+
+    for (i = 0; i < BLADERF_CHANNELIZER_CHANNELS; i++) {
+        if (mask & (1u << i)) {
+            count++;
+        }
+    }
+
+    if (count == 0 || count > BLADERF_CHANNELIZER_MAX_SELECTED ||
+        (mask >> BLADERF_CHANNELIZER_CHANNELS) != 0) {
+        log_debug("Invalid channel mask: 0x%08x\n", mask);
+        return BLADERF_ERR_INVAL;
+    }
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    status = rx_channels_check(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = dev->fn->set_rx_channels(dev, mask);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    return status;
+}
+
+int bladerf_get_rx_channels(struct bladerf *dev, uint32_t *mask)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    status = rx_channels_check(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = dev->fn->get_rx_channels(dev, mask);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    return status;
+}
+
+int bladerf_get_sampling(struct bladerf *dev, bladerf_sampling *sampling)
+{
+    int status = 0;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = lms_get_sampling(dev, sampling);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_set_sampling(struct bladerf *dev, bladerf_sampling sampling)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = lms_select_sampling(dev, sampling);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_set_txvga2(struct bladerf *dev, int gain)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = lms_txvga2_set_gain(dev, gain);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_get_txvga2(struct bladerf *dev, int *gain)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = lms_txvga2_get_gain(dev, gain);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_set_txvga1(struct bladerf *dev, int gain)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = lms_txvga1_set_gain(dev, gain);
+    if (status == 0) {
+        status = tuning_update_dc_cal(dev, BLADERF_MODULE_TX);
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_get_txvga1(struct bladerf *dev, int *gain)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = lms_txvga1_get_gain(dev, gain);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+
+int bladerf_set_lna_gain(struct bladerf *dev, bladerf_lna_gain gain)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = lms_lna_set_gain(dev, gain);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_get_lna_gain(struct bladerf *dev, bladerf_lna_gain *gain)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = lms_lna_get_gain(dev, gain);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_set_rxvga1(struct bladerf *dev, int gain)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = lms_rxvga1_set_gain(dev, gain);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_get_rxvga1(struct bladerf *dev, int *gain)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = lms_rxvga1_get_gain(dev, gain);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_set_rxvga2(struct bladerf *dev, int gain)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = lms_rxvga2_set_gain(dev, gain);
+    if (status == 0) {
+        status = tuning_update_dc_cal(dev, BLADERF_MODULE_RX);
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_get_rxvga2(struct bladerf *dev, int *gain)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = lms_rxvga2_get_gain(dev, gain);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+
+int bladerf_set_gain(struct bladerf *dev, bladerf_module mod, int gain) {
+    int status;
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = gain_set(dev, mod, gain);
+    if (status == 0) {
+        status = tuning_update_dc_cal(dev, mod);
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_schedule_gain(struct bladerf *dev, bladerf_module mod,
+                          uint64_t timestamp, int gain)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    /* The FPGA's scheduled writes must follow any deferred writes */
+    status = lms_defer_flush(dev);
+    if (status == 0) {
+        status = gain_schedule(dev, mod, timestamp, gain);
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_enable_rx_agc(struct bladerf *dev,
+                          const struct bladerf_agc_config *config)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    return agc_config(dev, &dev->agc, config);
+}
+
+int bladerf_enable_rx_bg_cal(struct bladerf *dev,
+                             const struct bladerf_rx_bg_cal_config *config)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    return bg_cal_config(dev, &dev->bg_cal, config);
+}
+
+int bladerf_get_rx_bg_cal_state(struct bladerf *dev,
+                                struct bladerf_rx_bg_cal_state *state)
+{
+    bg_cal_get_state(&dev->bg_cal, state);
+    return 0;
+}
+
+int bladerf_set_bandwidth(struct bladerf *dev, bladerf_module module,
+                          unsigned int bandwidth,
+                          unsigned int *actual)
+{
+    int status;
+    lms_bw bw;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    if (bandwidth < BLADERF_BANDWIDTH_MIN) {
+        bandwidth = BLADERF_BANDWIDTH_MIN;
+        log_info("Clamping bandwidth to %dHz\n", bandwidth);
+    } else if (bandwidth > BLADERF_BANDWIDTH_MAX) {
+        bandwidth = BLADERF_BANDWIDTH_MAX;
+        log_info("Clamping bandwidth to %dHz\n", bandwidth);
+    }
+
+    bw = lms_uint2bw(bandwidth);
+
+    status = lms_lpf_enable(dev, module, true);
+    if (status != 0) {
+        goto out;
+    }
+
+    status = lms_set_bandwidth(dev, module, bw);
+    if (actual != NULL) {
+        if (status == 0) {
+            *actual = lms_bw2uint(bw);
+        } else {
+            *actual = 0;
+        }
+    }
+
+out:
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_get_bandwidth(struct bladerf *dev, bladerf_module module,
+                            unsigned int *bandwidth)
+{
+    int status;
+    lms_bw bw;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = lms_get_bandwidth( dev, module, &bw);
+
+    if (status == 0) {
+        *bandwidth = lms_bw2uint(bw);
+    } else {
+        *bandwidth = 0;
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_set_lpf_mode(struct bladerf *dev, bladerf_module module,
+                         bladerf_lpf_mode mode)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = lms_lpf_set_mode(dev, module, mode);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_get_lpf_mode(struct bladerf *dev, bladerf_module module,
+                         bladerf_lpf_mode *mode)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = lms_lpf_get_mode(dev, module, mode);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_get_config_snapshot(struct bladerf *dev,
+                                struct bladerf_config_snapshot *snapshot)
+{
+    int status;
+    lms_bw bw;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_SI5338 | CTRL_LOCK_GPIO);
+
+    /* The remaining LMS6002D reads are served from the register shadow */
+    status = lms_prefetch_config(dev);
+    if (status != 0) {
+        goto out;
+    }
+
+    status = tuning_get_freq(dev, BLADERF_MODULE_RX, &snapshot->rx_frequency);
+    if (status != 0) {
+        goto out;
+    }
+
+    status = tuning_get_freq(dev, BLADERF_MODULE_TX, &snapshot->tx_frequency);
+    if (status != 0) {
+        goto out;
+    }
+
+    status = lms_get_bandwidth(dev, BLADERF_MODULE_RX, &bw);
+    if (status != 0) {
+        goto out;
+    }
+
+    snapshot->rx_bandwidth = lms_bw2uint(bw);
+
+    status = lms_get_bandwidth(dev, BLADERF_MODULE_TX, &bw);
+    if (status != 0) {
+        goto out;
+    }
+
+    snapshot->tx_bandwidth = lms_bw2uint(bw);
+
+    status = lms_lpf_get_mode(dev, BLADERF_MODULE_RX, &snapshot->rx_lpf_mode);
+    if (status != 0) {
+        goto out;
+    }
+
+    status = lms_lpf_get_mode(dev, BLADERF_MODULE_TX, &snapshot->tx_lpf_mode);
+    if (status != 0) {
+        goto out;
+    }
+
+    /* Si5338 multisynth parameters are shadowed and read via batches */
+    status = si5338_get_rational_sample_rate(dev, BLADERF_MODULE_RX,
+                                             &snapshot->rx_samplerate);
+    if (status != 0) {
+        goto out;
+    }
+
+    status = si5338_get_rational_sample_rate(dev, BLADERF_MODULE_TX,
+                                             &snapshot->tx_samplerate);
+    if (status != 0) {
+        goto out;
+    }
+
+    status = lms_lna_get_gain(dev, &snapshot->lnagain);
+    if (status != 0) {
+        goto out;
+    }
+
+    status = lms_rxvga1_get_gain(dev, &snapshot->rxvga1);
+    if (status != 0) {
+        goto out;
+    }
+
+    status = lms_rxvga2_get_gain(dev, &snapshot->rxvga2);
+    if (status != 0) {
+        goto out;
+    }
+
+    status = lms_txvga1_get_gain(dev, &snapshot->txvga1);
+    if (status != 0) {
+        goto out;
+    }
+
+    status = lms_txvga2_get_gain(dev, &snapshot->txvga2);
+    if (status != 0) {
+        goto out;
+    }
+
+    snapshot->loopback = BLADERF_LB_NONE;
+    if (version_greater_or_equal(&dev->fw_version, 1, 7, 1)) {
+        bool fw_lb_enabled;
+        status = dev->fn->get_firmware_loopback(dev, &fw_lb_enabled);
+        if (status != 0) {
+            goto out;
+        } else if (fw_lb_enabled) {
+            snapshot->loopback = BLADERF_LB_FIRMWARE;
+        }
+    }
+
+    if (snapshot->loopback == BLADERF_LB_NONE) {
+        status = lms_get_loopback_mode(dev, &snapshot->loopback);
+        if (status != 0) {
+            goto out;
+        }
+    }
+
+    status = lms_get_sampling(dev, &snapshot->sampling);
+    if (status != 0) {
+        goto out;
+    }
+
+    status = CONFIG_GPIO_READ(dev, &snapshot->gpio);
+    if (status != 0) {
+        goto out;
+    }
+
+    snapshot->vctcxo_trim = dev->dac_trim;
+
+out:
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_SI5338 | CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_select_band(struct bladerf *dev, bladerf_module module,
+                        unsigned int frequency)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+
+    status = tuning_select_band(dev, module, frequency);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_set_frequency(struct bladerf *dev,
+                          bladerf_module module, unsigned int frequency)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+
+    status = tuning_set_freq(dev, module, frequency);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_set_frequency_both(struct bladerf *dev, unsigned int frequency)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+
+    status = tuning_set_freq_both(dev, frequency);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_get_frequency(struct bladerf *dev,
+                            bladerf_module module, unsigned int *frequency)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+
+    status = tuning_get_freq(dev, module, frequency);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_set_frequency_offset(struct bladerf *dev, bladerf_module module,
+                                 int32_t offset)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+
+    status = tuning_set_freq_offset(dev, module, offset);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_get_frequency_offset(struct bladerf *dev, bladerf_module module,
+                                 int32_t *offset)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+
+    status = tuning_get_freq_offset(dev, module, offset);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_get_quick_tune(struct bladerf *dev, bladerf_module module,
+                           struct bladerf_quick_tune *quick_tune)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+
+    status = tuning_get_quick_tune(dev, module, quick_tune);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_get_tuning_stats(struct bladerf *dev, bladerf_module module,
+                             struct bladerf_tuning_stats *stats)
+{
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+    tuning_get_stats(dev, module, stats);
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+
+    return 0;
+}
+
+int bladerf_reset_tuning_stats(struct bladerf *dev, bladerf_module module)
+{
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+    tuning_reset_stats(dev, module);
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+
+    return 0;
+}
+
+int bladerf_hop_config(struct bladerf *dev, bladerf_module module,
+                       const unsigned int *freqs, unsigned int num_freqs,
+                       uint64_t dwell_samples, bladerf_hop_mode mode)
+{
+    if ((module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) ||
+        freqs == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return hop_config(&dev->hop[module], freqs, num_freqs, dwell_samples,
+                      mode);
+}
+
+int bladerf_hop_start(struct bladerf *dev, bladerf_module module,
+                      uint64_t timestamp)
+{
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return hop_start(&dev->hop[module], timestamp);
+}
+
+int bladerf_hop_stop(struct bladerf *dev, bladerf_module module)
+{
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    hop_stop(&dev->hop[module]);
+    return 0;
+}
+
+int bladerf_get_hop_stats(struct bladerf *dev, bladerf_module module,
+                          struct bladerf_hop_stats *stats)
+{
+    if ((module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) ||
+        stats == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    hop_get_stats(&dev->hop[module], stats);
+    return 0;
+}
+
+static bool profile_args_valid(bladerf_module module, const char *name)
+{
+    return (module == BLADERF_MODULE_RX || module == BLADERF_MODULE_TX) &&
+           name != NULL && name[0] != '\0' &&
+           strlen(name) < BLADERF_PROFILE_NAME_LEN;
+}
+
+int bladerf_profile_define(struct bladerf *dev, bladerf_module module,
+                           const char *name,
+                           const struct bladerf_profile_config *config)
+{
+    int status;
+
+    if (!profile_args_valid(module, name)) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    if (config != NULL) {
+        struct bladerf_rational_rate rate = config->samplerate;
+
+        /* The gain is set last, so that the DC offset corrections captured
+         * are those for the final frequency and gain */
+        status = bladerf_set_rational_sample_rate(dev, module, &rate, NULL);
+        if (status == 0) {
+            status = bladerf_set_bandwidth(dev, module,
+                                           config->bandwidth, NULL);
+        }
+
+        if (status == 0) {
+            status = bladerf_set_frequency(dev, module, config->frequency);
+        }
+
+        if (status == 0) {
+            status = bladerf_set_gain(dev, module, config->gain);
+        }
+
+        if (status != 0) {
+            return status;
+        }
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_SI5338 | CTRL_LOCK_GPIO);
+
+    status = profile_capture(dev, module, name);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_SI5338 | CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_profile_apply(struct bladerf *dev, bladerf_module module,
+                          const char *name, uint64_t timestamp)
+{
+    int status;
+
+    if (!profile_args_valid(module, name)) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_SI5338 | CTRL_LOCK_GPIO);
+
+    status = profile_apply(dev, module, name, timestamp);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_SI5338 | CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_profile_remove(struct bladerf *dev, bladerf_module module,
+                           const char *name)
+{
+    int status;
+
+    if (!profile_args_valid(module, name)) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = profile_remove(dev, module, name);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_trace_enable(struct bladerf *dev, unsigned int num_records)
+{
+    int status;
+
+    MUTEX_LOCK(&dev->xfer_lock);
+    status = trace_enable(dev, num_records);
+    MUTEX_UNLOCK(&dev->xfer_lock);
+
+    return status;
+}
+
+int bladerf_trace_read(struct bladerf *dev,
+                       struct bladerf_trace_record *records,
+                       unsigned int max_records, unsigned int *num_records)
+{
+    int status;
+
+    *num_records = 0;
+
+    MUTEX_LOCK(&dev->xfer_lock);
+    status = trace_read(dev, records, max_records);
+    MUTEX_UNLOCK(&dev->xfer_lock);
+
+    if (status < 0) {
+        return status;
+    }
+
+    *num_records = (unsigned int) status;
+    return 0;
+}
+
+int bladerf_quick_retune(struct bladerf *dev, bladerf_module module,
+                         const struct bladerf_quick_tune *quick_tune)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+
+    status = tuning_quick_retune(dev, module, quick_tune);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_schedule_retune(struct bladerf *dev, bladerf_module module,
+                            uint64_t timestamp,
+                            const struct bladerf_quick_tune *quick_tune)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+
+    /* The FPGA's scheduled writes must follow any deferred writes */
+    status = lms_defer_flush(dev);
+    if (status == 0) {
+        status = tuning_schedule_retune(dev, module, timestamp, quick_tune);
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_set_stream_timeout(struct bladerf *dev, bladerf_module module,
+                               unsigned int timeout) {
+
+    if (dev) {
+        MUTEX_LOCK(&dev->stream_lock[module]);
+        dev->transfer_timeout[module] = timeout;
+        MUTEX_UNLOCK(&dev->stream_lock[module]);
+        return 0;
+
+    } else {
+        return BLADERF_ERR_INVAL;
+    }
+}
+
+int bladerf_get_stream_timeout(struct bladerf *dev, bladerf_module module,
+                               unsigned int *timeout) {
+    if (dev) {
+        MUTEX_LOCK(&dev->stream_lock[module]);
+        *timeout = dev->transfer_timeout[module];
+        MUTEX_UNLOCK(&dev->stream_lock[module]);
+        return 0;
+    } else {
+        return BLADERF_ERR_INVAL;
+    }
+}
+
+int bladerf_set_stream_thread_config(
+                            struct bladerf *dev,
+                            bladerf_module module,
+                            const struct bladerf_stream_thread_config *config)
+{
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (config != NULL) {
+        switch (config->policy) {
+            case BLADERF_SCHED_DEFAULT:
+            case BLADERF_SCHED_FIFO:
+            case BLADERF_SCHED_RR:
+                break;
+
+            default:
+                log_debug("Invalid scheduling policy: %d\n", config->policy);
+                return BLADERF_ERR_INVAL;
+        }
+    }
+
+    MUTEX_LOCK(&dev->stream_lock[module]);
+
+    if (config != NULL) {
+        dev->stream_thread_config[module] = *config;
+    } else {
+        memset(&dev->stream_thread_config[module], 0,
+               sizeof(dev->stream_thread_config[module]));
+    }
+
+    MUTEX_UNLOCK(&dev->stream_lock[module]);
+    return 0;
+}
+
+int bladerf_get_stream_thread_config(
+                            struct bladerf *dev,
+                            bladerf_module module,
+                            struct bladerf_stream_thread_config *config)
+{
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&dev->stream_lock[module]);
+    *config = dev->stream_thread_config[module];
+    MUTEX_UNLOCK(&dev->stream_lock[module]);
+
+    return 0;
+}
+
+int bladerf_set_stream_buffer_flags(struct bladerf *dev, uint32_t flags)
+{
+    const uint32_t valid = BLADERF_STREAM_BUFFERS_HUGEPAGES |
+                           BLADERF_STREAM_BUFFERS_LOCKED |
+                           BLADERF_STREAM_BUFFERS_DEVICE_MEM;
+
+    if ((flags & ~valid) != 0) {
+        log_debug("Invalid stream buffer flags: 0x%08x\n", flags);
+        return BLADERF_ERR_INVAL;
+    }
+
+    STREAM_LOCK_BOTH(dev);
+    dev->stream_buffer_flags = flags;
+    STREAM_UNLOCK_BOTH(dev);
+
+    return 0;
+}
+
+int bladerf_get_stream_buffer_flags(struct bladerf *dev, uint32_t *flags)
+{
+    STREAM_LOCK_BOTH(dev);
+    *flags = dev->stream_buffer_flags;
+    STREAM_UNLOCK_BOTH(dev);
+
+    return 0;
+}
+
+int bladerf_set_stream_buffers_per_transfer(struct bladerf *dev,
+                                           bladerf_module module,
+                                           unsigned int buffers_per_transfer)
+{
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&dev->stream_lock[module]);
+    dev->stream_bufs_per_transfer[module] = buffers_per_transfer;
+    MUTEX_UNLOCK(&dev->stream_lock[module]);
+
+    return 0;
+}
+
+int bladerf_get_stream_buffers_per_transfer(struct bladerf *dev,
+                                           bladerf_module module,
+                                           unsigned int *buffers_per_transfer)
+{
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&dev->stream_lock[module]);
+    *buffers_per_transfer = dev->stream_bufs_per_transfer[module] == 0 ?
+                                1 : dev->stream_bufs_per_transfer[module];
+    MUTEX_UNLOCK(&dev->stream_lock[module]);
+
+    return 0;
+}
+
+int bladerf_sync_config(struct bladerf *dev,
+                        bladerf_module module,
+                        bladerf_format format,
+                        unsigned int num_buffers,
+                        unsigned int buffer_size,
+                        unsigned int num_transfers,
+                        unsigned int stream_timeout)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    /* Only the format configuration touches state shared with the other
+     * module. The sync handle itself is private to this module, so setting
+     * it up does not hold off the other module's stream or control calls. */
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = perform_format_config(dev, module, format_wire(format));
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    if (status != 0) {
+        return status;
+    }
+
+    MUTEX_LOCK(&dev->sync_lock[module]);
+
+    MUTEX_LOCK(&dev->stream_lock[module]);
+    dev->transfer_timeout[module] = stream_timeout;
+    MUTEX_UNLOCK(&dev->stream_lock[module]);
+
+    status = sync_init(dev, module, format, num_buffers, buffer_size,
+            num_transfers, stream_timeout);
+
+    MUTEX_UNLOCK(&dev->sync_lock[module]);
+
+    if (status != 0) {
+        CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+        perform_format_deconfig(dev, module);
+        CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+    }
+
+    return status;
+}
+
+int bladerf_sync_config_auto(struct bladerf *dev,
+                             bladerf_module module,
+                             bladerf_format format,
+                             unsigned int sample_rate,
+                             unsigned int latency_us,
+                             const struct bladerf_bandwidth_probe_results *probe,
+                             struct bladerf_sync_auto_config *config)
+{
+    int status;
+    struct bladerf_sync_auto_config chosen;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    if (sample_rate == 0) {
+        status = bladerf_get_sample_rate(dev, module, &sample_rate);
+        if (status != 0) {
+            return status;
+        }
+    }
+
+    status = sync_choose_config(module, format, bladerf_device_speed(dev),
+                                sample_rate, latency_us, probe, &chosen);
+    if (status != 0) {
+        return status;
+    }
+
+    log_verbose("%s sync config for %u Hz within %u us: %u buffers of %u "
+                "samples, %u transfers, %u ms timeout (~%u us latency, "
+                "%u us in flight)\n",
+                module == BLADERF_MODULE_RX ? "RX" : "TX",
+                sample_rate, latency_us, chosen.num_buffers,
+                chosen.buffer_size, chosen.num_transfers,
+                chosen.stream_timeout, chosen.latency_us, chosen.margin_us);
+
+    status = bladerf_sync_config(dev, module, format, chosen.num_buffers,
+                                 chosen.buffer_size, chosen.num_transfers,
+                                 chosen.stream_timeout);
+
+    if (status == 0 && config != NULL) {
+        *config = chosen;
+    }
+
+    return status;
+}
+
+int bladerf_sync_resize(struct bladerf *dev,
+                        bladerf_module module,
+                        unsigned int num_buffers,
+                        unsigned int buffer_size,
+                        unsigned int num_transfers)
+{
+    int status;
 
-int bladerf_set_txvga2(struct bladerf *dev, int gain)
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&dev->sync_lock[module]);
+    status = sync_resize(dev, module, num_buffers, buffer_size, num_transfers);
+    MUTEX_UNLOCK(&dev->sync_lock[module]);
+
+    return status;
+}
+
+int bladerf_sync_autotune(struct bladerf *dev, bladerf_module module,
+                          bool enable, unsigned int min_transfers,
+                          unsigned int latency_budget_us)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
 
-    status = lms_txvga2_set_gain(dev, gain);
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&dev->sync_lock[module]);
+    status = sync_set_autotune(dev->sync[module], enable,
+                               min_transfers, latency_budget_us);
+    MUTEX_UNLOCK(&dev->sync_lock[module]);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
     return status;
 }
 
-int bladerf_get_txvga2(struct bladerf *dev, int *gain)
+int bladerf_sync_continuity_check(struct bladerf *dev, bool enable,
+                                  bladerf_discontinuity_cb cb,
+                                  void *user_data)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
 
-    status = lms_txvga2_get_gain(dev, gain);
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+    status = sync_set_continuity_check(dev->sync[BLADERF_MODULE_RX], enable,
+                                       cb, user_data);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
     return status;
 }
 
-int bladerf_set_txvga1(struct bladerf *dev, int gain)
+int bladerf_sync_underrun_callback(struct bladerf *dev,
+                                   bladerf_underrun_cb cb, void *user_data)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
 
-    status = lms_txvga1_set_gain(dev, gain);
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
+    status = sync_set_underrun_cb(dev->sync[BLADERF_MODULE_TX], cb, user_data);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
     return status;
 }
 
-int bladerf_get_txvga1(struct bladerf *dev, int *gain)
+int bladerf_sync_arm(struct bladerf *dev, bladerf_module module)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
 
-    status = lms_txvga1_get_gain(dev, gain);
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&dev->sync_lock[module]);
+    status = sync_arm(dev->sync[module]);
+    MUTEX_UNLOCK(&dev->sync_lock[module]);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
     return status;
 }
 
+int bladerf_sync_tx(struct bladerf *dev,
+                    void *samples, unsigned int num_samples,
+                    struct bladerf_metadata *metadata,
+                    unsigned int timeout_ms)
+{
+    int status;
 
-int bladerf_set_lna_gain(struct bladerf *dev, bladerf_lna_gain gain)
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
+    status = sync_tx(dev, samples, num_samples, metadata, timeout_ms);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
+
+    return status;
+}
+
+int bladerf_sync_tx_acquire(struct bladerf *dev,
+                            void **samples, unsigned int *num_samples,
+                            struct bladerf_metadata *metadata,
+                            unsigned int timeout_ms)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
 
-    status = lms_lna_set_gain(dev, gain);
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
+    status = sync_tx_acquire(dev, samples, num_samples, metadata, timeout_ms);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
     return status;
 }
 
-int bladerf_get_lna_gain(struct bladerf *dev, bladerf_lna_gain *gain)
+int bladerf_sync_tx_commit(struct bladerf *dev,
+                           void *samples, unsigned int num_samples,
+                           struct bladerf_metadata *metadata)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
 
-    status = lms_lna_get_gain(dev, gain);
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
+    status = sync_tx_commit(dev, samples, num_samples, metadata);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
     return status;
 }
 
-int bladerf_set_rxvga1(struct bladerf *dev, int gain)
+int bladerf_sync_tx_flush(struct bladerf *dev, unsigned int timeout_ms)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
 
-    status = lms_rxvga1_set_gain(dev, gain);
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
+    status = sync_tx_flush(dev, timeout_ms);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
     return status;
 }
 
-int bladerf_get_rxvga1(struct bladerf *dev, int *gain)
+int bladerf_sync_tx_autoflush(struct bladerf *dev, bool enable,
+                              unsigned int deadline_us)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
 
-    status = lms_rxvga1_get_gain(dev, gain);
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
+    status = sync_set_autoflush(dev->sync[BLADERF_MODULE_TX], enable,
+                                deadline_us);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
     return status;
 }
 
-int bladerf_set_rxvga2(struct bladerf *dev, int gain)
+int bladerf_sync_tx_bursts(struct bladerf *dev,
+                           struct bladerf_tx_burst *bursts,
+                           unsigned int num_bursts,
+                           unsigned int timeout_ms)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
 
-    status = lms_rxvga2_set_gain(dev, gain);
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
+    status = sync_tx_bursts(dev, bursts, num_bursts, timeout_ms);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
     return status;
 }
 
-int bladerf_get_rxvga2(struct bladerf *dev, int *gain)
+int bladerf_sync_tx_load_waveform(struct bladerf *dev, unsigned int id,
+                                  const int16_t *samples,
+                                  unsigned int num_samples,
+                                  unsigned int timeout_ms)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
 
-    status = lms_rxvga2_get_gain(dev, gain);
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
+    status = sync_tx_load_waveform(dev, id, samples, num_samples, timeout_ms);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
     return status;
 }
 
+int bladerf_sync_tx_play_waveform(struct bladerf *dev, unsigned int id,
+                                  uint64_t timestamp, unsigned int timeout_ms)
+{
+    int status;
+
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
+    status = sync_tx_play_waveform(dev, id, timestamp, timeout_ms);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
 
-int bladerf_set_gain(struct bladerf *dev, bladerf_module mod, int gain) {
+    return status;
+}
+
+int bladerf_sync_rx(struct bladerf *dev,
+                    void *samples, unsigned int num_samples,
+                    struct bladerf_metadata *metadata,
+                    unsigned int timeout_ms)
+{
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    bladerf_format format = BLADERF_FORMAT_SC16_Q11;
 
-    status = gain_set(dev, mod, gain);
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+
+    status = sync_rx(dev, samples, num_samples, metadata, timeout_ms);
+    if (status == 0 && dev->sync[BLADERF_MODULE_RX] != NULL) {
+        format = dev->sync[BLADERF_MODULE_RX]->stream_config.host_format;
+    }
+
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+
+    /* Gain changes and corrections require the control lock, which precedes
+     * the sync lock */
+    if (status == 0 && metadata != NULL) {
+        status = agc_process(dev, &dev->agc, samples, format, metadata);
+    }
+
+    if (status == 0 && metadata != NULL) {
+        status = bg_cal_process(dev, &dev->bg_cal, samples, format, metadata);
+    }
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
     return status;
 }
 
-int bladerf_set_bandwidth(struct bladerf *dev, bladerf_module module,
-                          unsigned int bandwidth,
-                          unsigned int *actual)
+int bladerf_sync_rx_try(struct bladerf *dev,
+                        void *samples, unsigned int num_samples,
+                        struct bladerf_metadata *metadata,
+                        unsigned int *num_read)
 {
     int status;
-    lms_bw bw;
+    bladerf_format format = BLADERF_FORMAT_SC16_Q11;
 
-    MUTEX_LOCK(&dev->ctrl_lock);
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
 
-    if (bandwidth < BLADERF_BANDWIDTH_MIN) {
-        bandwidth = BLADERF_BANDWIDTH_MIN;
-        log_info("Clamping bandwidth to %dHz\n", bandwidth);
-    } else if (bandwidth > BLADERF_BANDWIDTH_MAX) {
-        bandwidth = BLADERF_BANDWIDTH_MAX;
-        log_info("Clamping bandwidth to %dHz\n", bandwidth);
+    status = sync_rx_try(dev, samples, num_samples, metadata, num_read);
+    if (status == 0 && dev->sync[BLADERF_MODULE_RX] != NULL) {
+        format = dev->sync[BLADERF_MODULE_RX]->stream_config.host_format;
     }
 
-    bw = lms_uint2bw(bandwidth);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
 
-    status = lms_lpf_enable(dev, module, true);
-    if (status != 0) {
-        goto out;
+    if (status == 0 && metadata != NULL) {
+        status = agc_process(dev, &dev->agc, samples, format, metadata);
     }
 
-    status = lms_set_bandwidth(dev, module, bw);
-    if (actual != NULL) {
-        if (status == 0) {
-            *actual = lms_bw2uint(bw);
-        } else {
-            *actual = 0;
-        }
+    if (status == 0 && metadata != NULL) {
+        status = bg_cal_process(dev, &dev->bg_cal, samples, format, metadata);
     }
 
-out:
-    MUTEX_UNLOCK(&dev->ctrl_lock);
     return status;
 }
 
-int bladerf_get_bandwidth(struct bladerf *dev, bladerf_module module,
-                            unsigned int *bandwidth)
+int bladerf_sync_tx_try(struct bladerf *dev,
+                        void *samples, unsigned int num_samples,
+                        struct bladerf_metadata *metadata,
+                        unsigned int *num_written)
 {
     int status;
-    lms_bw bw;
 
-    MUTEX_LOCK(&dev->ctrl_lock);
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
+    status = sync_tx_try(dev, samples, num_samples, metadata, num_written);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
+
+    return status;
+}
 
-    status = lms_get_bandwidth( dev, module, &bw);
+int bladerf_sync_get_fd(struct bladerf *dev, bladerf_module module, int *fd)
+{
+    int status;
+
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&dev->sync_lock[module]);
+    status = sync_get_fd(dev->sync[module], fd);
+    MUTEX_UNLOCK(&dev->sync_lock[module]);
+
+    return status;
+}
+
+int bladerf_sync_trx(struct bladerf *dev,
+                     void *rx_samples, void *tx_samples,
+                     unsigned int num_samples,
+                     struct bladerf_metadata *rx_metadata,
+                     struct bladerf_metadata *tx_metadata,
+                     unsigned int timeout_ms)
+{
+    int status;
+
+    if (rx_samples == NULL || tx_samples == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    /* Queue the TX samples first, so they are in flight while we wait for
+     * RX samples to arrive */
+    status = bladerf_sync_tx(dev, tx_samples, num_samples, tx_metadata,
+                             timeout_ms);
 
     if (status == 0) {
-        *bandwidth = lms_bw2uint(bw);
-    } else {
-        *bandwidth = 0;
+        status = bladerf_sync_rx(dev, rx_samples, num_samples, rx_metadata,
+                                 timeout_ms);
+    }
+
+    return status;
+}
+
+int bladerf_sync_rx_multi(struct bladerf *dev,
+                          const struct bladerf_rx_iov *iov,
+                          struct bladerf_metadata *metadata,
+                          unsigned int iov_count,
+                          unsigned int timeout_ms)
+{
+    int status;
+
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+    status = sync_rx_multi(dev, iov, metadata, iov_count, timeout_ms);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+
+    return status;
+}
+
+int bladerf_sync_rx_acquire(struct bladerf *dev,
+                            void **samples, unsigned int *num_samples,
+                            struct bladerf_metadata *metadata,
+                            unsigned int timeout_ms)
+{
+    int status;
+
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+    status = sync_rx_acquire(dev, samples, num_samples, metadata, timeout_ms);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+
+    return status;
+}
+
+int bladerf_sync_rx_acquire_msgs(struct bladerf *dev, void **buffer,
+                                 struct bladerf_rx_msg *msgs,
+                                 unsigned int max_msgs,
+                                 unsigned int *num_msgs,
+                                 struct bladerf_metadata *metadata,
+                                 unsigned int timeout_ms)
+{
+    int status;
+
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+    status = sync_rx_acquire_msgs(dev, buffer, msgs, max_msgs, num_msgs,
+                                  metadata, timeout_ms);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+
+    return status;
+}
+
+int bladerf_sync_rx_release(struct bladerf *dev, void *samples)
+{
+    int status;
+
+    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+    status = sync_rx_release(dev, samples);
+    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+
+    return status;
+}
+
+int bladerf_get_stream_stats(struct bladerf *dev, bladerf_module module,
+                             struct bladerf_stream_stats *stats)
+{
+    int status;
+
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    MUTEX_LOCK(&dev->sync_lock[module]);
+    status = sync_get_stats(dev->sync[module], stats);
+    MUTEX_UNLOCK(&dev->sync_lock[module]);
+
+    return status;
+}
+
+int bladerf_repeater_start(struct bladerf *dev,
+                           const struct bladerf_repeater_config *config,
+                           struct bladerf_repeater **repeater)
+{
+    if (config == NULL || repeater == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return repeater_start(dev, config, repeater);
+}
+
+int bladerf_repeater_get_stats(struct bladerf_repeater *repeater,
+                               struct bladerf_repeater_stats *stats)
+{
+    if (repeater == NULL || stats == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return repeater_get_stats(repeater, stats);
+}
+
+int bladerf_repeater_stop(struct bladerf_repeater *repeater)
+{
+    if (repeater == NULL) {
+        return 0;
+    }
+
+    return repeater_stop(repeater);
+}
+
+int bladerf_rx_pipeline_start(struct bladerf *dev,
+                              const struct bladerf_rx_pipeline_config *config,
+                              struct bladerf_rx_pipeline **pipeline)
+{
+    if (config == NULL || pipeline == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return rx_pipeline_start(dev, config, pipeline);
+}
+
+int bladerf_rx_pipeline_get_stats(struct bladerf_rx_pipeline *pipeline,
+                                  struct bladerf_rx_pipeline_stats *stats)
+{
+    if (pipeline == NULL || stats == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    rx_pipeline_get_stats(pipeline, stats);
+    return 0;
+}
+
+int bladerf_rx_pipeline_stop(struct bladerf_rx_pipeline *pipeline)
+{
+    if (pipeline == NULL) {
+        return 0;
     }
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
-    return status;
+    return rx_pipeline_stop(pipeline);
+}
+
+int bladerf_repeater_stage_gain(struct bladerf_repeater_stage *stage,
+                                float gain)
+{
+    if (stage == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return dsp_gain_init(stage, gain);
+}
+
+int bladerf_repeater_stage_fir(struct bladerf_repeater_stage *stage,
+                               const float *taps, unsigned int num_taps)
+{
+    if (stage == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return dsp_fir_init(stage, taps, num_taps);
+}
+
+int bladerf_repeater_stage_nco(struct bladerf_repeater_stage *stage,
+                               double frequency)
+{
+    if (stage == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return dsp_nco_init(stage, frequency);
+}
+
+void bladerf_repeater_stage_free(struct bladerf_repeater_stage *stage)
+{
+    if (stage != NULL) {
+        dsp_deinit(stage);
+    }
+}
+
+int bladerf_bandwidth_probe(struct bladerf *dev,
+                            const struct bladerf_bandwidth_probe_config *config,
+                            struct bladerf_bandwidth_probe_results *results)
+{
+    if (config == NULL || results == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return bw_probe_run(dev, config, results);
+}
+
+int bladerf_pattern_check_init(struct bladerf_pattern_check *check,
+                               bladerf_pattern pattern)
+{
+    return pattern_check_init(check, pattern);
+}
+
+uint64_t bladerf_pattern_check(struct bladerf_pattern_check *check,
+                               const int16_t *samples,
+                               unsigned int num_samples)
+{
+    return pattern_check(check, samples, num_samples);
 }
 
-int bladerf_set_lpf_mode(struct bladerf *dev, bladerf_module module,
-                         bladerf_lpf_mode mode)
+int bladerf_set_mimo_mode(struct bladerf *dev, bladerf_mimo_mode mode)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
 
-    status = lms_lpf_set_mode(dev, module, mode);
+    CTRL_LOCK(dev, CTRL_LOCK_SI5338);
+    status = si5338_set_mimo_mode(dev, mode);
+    CTRL_UNLOCK(dev, CTRL_LOCK_SI5338);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
     return status;
 }
 
-int bladerf_get_lpf_mode(struct bladerf *dev, bladerf_module module,
-                         bladerf_lpf_mode *mode)
+int bladerf_multi_init(struct bladerf_multi **multi,
+                       struct bladerf *const *devs, unsigned int num_devs,
+                       const struct bladerf_multi_config *config)
 {
-    int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    if (multi == NULL || devs == NULL || config == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
 
-    status = lms_lpf_get_mode(dev, module, mode);
+    return multi_init(multi, devs, num_devs, config);
+}
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
-    return status;
+int bladerf_multi_start(struct bladerf_multi *multi)
+{
+    if (multi == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return multi_start(multi);
 }
 
-int bladerf_select_band(struct bladerf *dev, bladerf_module module,
-                        unsigned int frequency)
+int bladerf_multi_get_start(struct bladerf_multi *multi, unsigned int index,
+                            uint64_t *timestamp, double *uncertainty_us)
 {
-    int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    if (multi == NULL || timestamp == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
 
-    status = tuning_select_band(dev, module, frequency);
+    return multi_get_start(multi, index, timestamp, uncertainty_us);
+}
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
-    return status;
+int bladerf_multi_rx(struct bladerf_multi *multi, int16_t *samples,
+                     unsigned int num_samples,
+                     struct bladerf_metadata *metadata,
+                     unsigned int timeout_ms)
+{
+    if (multi == NULL || samples == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return multi_rx(multi, samples, num_samples, metadata, timeout_ms);
 }
 
-int bladerf_set_frequency(struct bladerf *dev,
-                          bladerf_module module, unsigned int frequency)
+int bladerf_multi_tx(struct bladerf_multi *multi, const int16_t *samples,
+                     unsigned int num_samples,
+                     struct bladerf_metadata *metadata,
+                     unsigned int timeout_ms)
 {
-    int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    if (multi == NULL || samples == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
 
-    status = tuning_set_freq(dev, module, frequency);
+    return multi_tx(multi, samples, num_samples, metadata, timeout_ms);
+}
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
-    return status;
+void bladerf_multi_deinit(struct bladerf_multi *multi)
+{
+    if (multi != NULL) {
+        multi_deinit(multi);
+    }
 }
 
-int bladerf_get_frequency(struct bladerf *dev,
-                            bladerf_module module, unsigned int *frequency)
+int bladerf_get_net_stats(struct bladerf *dev, struct bladerf_net_stats *stats)
 {
-    int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    if (stats == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
 
-    status = tuning_get_freq(dev, module, frequency);
+    if (dev->fn->get_net_stats == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
-    return status;
+    return dev->fn->get_net_stats(dev, stats);
 }
 
-int bladerf_set_stream_timeout(struct bladerf *dev, bladerf_module module,
-                               unsigned int timeout) {
+int bladerf_net_serve(struct bladerf *dev, uint16_t port,
+                      unsigned int sessions)
+{
+    struct bladerf_net_serve_config config;
 
-    if (dev) {
-        MUTEX_LOCK(&dev->ctrl_lock);
-        dev->transfer_timeout[module] = timeout;
-        MUTEX_UNLOCK(&dev->ctrl_lock);
-        return 0;
+    memset(&config, 0, sizeof(config));
+    config.port = port;
+    config.sessions = sessions;
 
-    } else {
+    return bladerf_net_serve_with_config(dev, &config);
+}
+
+int bladerf_net_serve_with_config(struct bladerf *dev,
+                                  const struct bladerf_net_serve_config *config)
+{
+#ifdef ENABLE_BACKEND_NET
+    int status;
+
+    if (config == NULL) {
         return BLADERF_ERR_INVAL;
     }
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    return net_serve(dev, config);
+#else
+    return BLADERF_ERR_UNSUPPORTED;
+#endif
 }
 
-int bladerf_get_stream_timeout(struct bladerf *dev, bladerf_module module,
-                               unsigned int *timeout) {
-    if (dev) {
-        MUTEX_LOCK(&dev->ctrl_lock);
-        *timeout = dev->transfer_timeout[module];
-        MUTEX_UNLOCK(&dev->ctrl_lock);
-        return 0;
-    } else {
+int bladerf_rx_share_start(struct bladerf *dev, const char *name,
+                           const struct bladerf_rx_share_config *config,
+                           struct bladerf_rx_share **share)
+{
+#ifdef ENABLE_LIBBLADERF_RX_SHARE
+    if (name == NULL || config == NULL || share == NULL) {
         return BLADERF_ERR_INVAL;
     }
+
+    return rx_share_start(dev, name, config, share);
+#else
+    return BLADERF_ERR_UNSUPPORTED;
+#endif
 }
 
-int bladerf_sync_config(struct bladerf *dev,
-                        bladerf_module module,
-                        bladerf_format format,
-                        unsigned int num_buffers,
-                        unsigned int buffer_size,
-                        unsigned int num_transfers,
-                        unsigned int stream_timeout)
+int bladerf_rx_share_get_stats(struct bladerf_rx_share *share,
+                               struct bladerf_rx_share_stats *stats)
 {
-    int status;
+#ifdef ENABLE_LIBBLADERF_RX_SHARE
+    if (share == NULL || stats == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
 
-    MUTEX_LOCK(&dev->ctrl_lock);
+    rx_share_get_stats(share, stats);
+    return 0;
+#else
+    return BLADERF_ERR_UNSUPPORTED;
+#endif
+}
 
-    status = perform_format_config(dev, module, format);
-    if (status == 0) {
-        MUTEX_LOCK(&dev->sync_lock[module]);
+int bladerf_rx_share_stop(struct bladerf_rx_share *share)
+{
+#ifdef ENABLE_LIBBLADERF_RX_SHARE
+    if (share == NULL) {
+        return 0;
+    }
 
-        dev->transfer_timeout[module] = stream_timeout;
+    return rx_share_stop(share);
+#else
+    return BLADERF_ERR_UNSUPPORTED;
+#endif
+}
 
-        status = sync_init(dev, module, format, num_buffers, buffer_size,
-                num_transfers, stream_timeout);
+int bladerf_rx_share_open(struct bladerf_rx_share_reader **reader,
+                          const char *name)
+{
+#ifdef ENABLE_LIBBLADERF_RX_SHARE
+    if (reader == NULL || name == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
 
-        if (status != 0) {
-            perform_format_deconfig(dev, module);
-        }
+    return rx_share_open(reader, name);
+#else
+    return BLADERF_ERR_UNSUPPORTED;
+#endif
+}
 
-        MUTEX_UNLOCK(&dev->sync_lock[module]);
+int bladerf_rx_share_read(struct bladerf_rx_share_reader *reader,
+                          struct bladerf_rx_share_slot *slot,
+                          unsigned int timeout_ms)
+{
+#ifdef ENABLE_LIBBLADERF_RX_SHARE
+    if (reader == NULL || slot == NULL) {
+        return BLADERF_ERR_INVAL;
     }
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
-    return status;
+    return rx_share_read(reader, slot, timeout_ms);
+#else
+    return BLADERF_ERR_UNSUPPORTED;
+#endif
 }
 
-int bladerf_sync_tx(struct bladerf *dev,
-                    void *samples, unsigned int num_samples,
-                    struct bladerf_metadata *metadata,
-                    unsigned int timeout_ms)
+bool bladerf_rx_share_release(struct bladerf_rx_share_reader *reader)
 {
-    int status;
-
-    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
-    status = sync_tx(dev, samples, num_samples, metadata, timeout_ms);
-    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_TX]);
+#ifdef ENABLE_LIBBLADERF_RX_SHARE
+    if (reader == NULL) {
+        return true;
+    }
 
-    return status;
+    return rx_share_release(reader);
+#else
+    return true;
+#endif
 }
 
-int bladerf_sync_rx(struct bladerf *dev,
-                    void *samples, unsigned int num_samples,
-                    struct bladerf_metadata *metadata,
-                    unsigned int timeout_ms)
+int bladerf_rx_share_get_reader_stats(
+                                struct bladerf_rx_share_reader *reader,
+                                struct bladerf_rx_share_reader_stats *stats)
 {
-    int status;
+#ifdef ENABLE_LIBBLADERF_RX_SHARE
+    if (reader == NULL || stats == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
 
-    MUTEX_LOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
-    status = sync_rx(dev, samples, num_samples, metadata, timeout_ms);
-    MUTEX_UNLOCK(&dev->sync_lock[BLADERF_MODULE_RX]);
+    rx_share_get_reader_stats(reader, stats);
+    return 0;
+#else
+    return BLADERF_ERR_UNSUPPORTED;
+#endif
+}
 
-    return status;
+void bladerf_rx_share_close(struct bladerf_rx_share_reader *reader)
+{
+#ifdef ENABLE_LIBBLADERF_RX_SHARE
+    if (reader != NULL) {
+        rx_share_close(reader);
+    }
+#endif
 }
 
 int bladerf_init_stream(struct bladerf_stream **stream,
@@ -805,22 +3415,46 @@ int bladerf_init_stream(struct bladerf_stream **stream,
                         void *data)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
 
-    status = async_init_stream(stream, dev, callback, buffers, num_buffers,
-                               format, samples_per_buffer, num_transfers, data);
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
-    return status;
+    return async_init_stream(stream, dev, callback, buffers, num_buffers,
+                             format, samples_per_buffer, num_transfers, data);
+}
+
+int bladerf_init_stream_with_buffers(struct bladerf_stream **stream,
+                                     struct bladerf *dev,
+                                     bladerf_stream_cb callback,
+                                     void **buffers,
+                                     size_t num_buffers,
+                                     bladerf_format format,
+                                     size_t samples_per_buffer,
+                                     size_t num_transfers,
+                                     void *data)
+{
+    int status;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    return async_init_stream_with_buffers(stream, dev, callback, buffers,
+                                          num_buffers, format,
+                                          samples_per_buffer, num_transfers,
+                                          data);
 }
 
 int bladerf_stream(struct bladerf_stream *stream, bladerf_module module)
 {
     int stream_status, fmt_status;
 
-    MUTEX_LOCK(&stream->dev->ctrl_lock);
+    CTRL_LOCK(stream->dev, CTRL_LOCK_GPIO);
     fmt_status = perform_format_config(stream->dev, module, stream->format);
-    MUTEX_UNLOCK(&stream->dev->ctrl_lock);
+    CTRL_UNLOCK(stream->dev, CTRL_LOCK_GPIO);
 
     if (fmt_status != 0) {
         return fmt_status;
@@ -830,9 +3464,9 @@ int bladerf_stream(struct bladerf_stream *stream, bladerf_module module)
      * be made in asyn_run_stream down through the backend code */
     stream_status = async_run_stream(stream, module);
 
-    MUTEX_LOCK(&stream->dev->ctrl_lock);
+    CTRL_LOCK(stream->dev, CTRL_LOCK_GPIO);
     fmt_status = perform_format_deconfig(stream->dev, module);
-    MUTEX_UNLOCK(&stream->dev->ctrl_lock);
+    CTRL_UNLOCK(stream->dev, CTRL_LOCK_GPIO);
 
     return stream_status == 0 ? fmt_status : stream_status;
 }
@@ -844,16 +3478,102 @@ int bladerf_submit_stream_buffer(struct bladerf_stream *stream,
     return async_submit_stream_buffer(stream, buffer, timeout_ms);
 }
 
+int bladerf_submit_stream_buffers(struct bladerf_stream *stream,
+                                  void **buffers,
+                                  unsigned int num_buffers,
+                                  unsigned int *num_submitted,
+                                  unsigned int timeout_ms)
+{
+    if (buffers == NULL && num_buffers != 0) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return async_submit_stream_buffers(stream, buffers, num_buffers,
+                                       num_submitted, timeout_ms);
+}
+
 void bladerf_deinit_stream(struct bladerf_stream *stream)
 {
+    /* The stream's resources are private to it, and its snapshot of the
+     * device's stream settings was taken by async_init_stream() */
     if (stream && stream->dev) {
-        struct bladerf *dev = stream->dev;
-        MUTEX_LOCK(&dev->ctrl_lock);
         async_deinit_stream(stream);
-        MUTEX_UNLOCK(&dev->ctrl_lock);
     }
 }
 
+int bladerf_set_stream_msg_index(struct bladerf_stream *stream, bool enable)
+{
+    if (stream == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return async_set_msg_index(stream, enable);
+}
+
+int bladerf_get_stream_msg_index(struct bladerf_stream *stream,
+                                 const struct bladerf_stream_msg **msgs,
+                                 unsigned int *num_msgs)
+{
+    if (stream == NULL || stream->msg_index == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    *msgs = stream->msg_index;
+    *num_msgs = stream->msg_index_count;
+    return 0;
+}
+
+int bladerf_set_stream_batch_callback(struct bladerf_stream *stream,
+                                      bladerf_stream_batch_cb callback,
+                                      unsigned int max_batch)
+{
+    if (stream == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return async_set_batch(stream, callback, max_batch);
+}
+
+void bladerf_unpack_sc16_q11(int16_t *samples, const void *packed,
+                             unsigned int num_samples)
+{
+    dsp_unpack_sc16_q11(samples, (const uint8_t *) packed, num_samples);
+}
+
+void bladerf_pack_sc16_q11(void *packed, const int16_t *samples,
+                           unsigned int num_samples)
+{
+    dsp_pack_sc16_q11((uint8_t *) packed, samples, num_samples);
+}
+
+void bladerf_convert_sc16q11_to_cf32(float *dst, const int16_t *src,
+                                     unsigned int num_samples)
+{
+    dsp_sc16_q11_to_cf32(dst, src, num_samples);
+}
+
+void bladerf_convert_cf32_to_sc16q11(int16_t *dst, const float *src,
+                                     unsigned int num_samples)
+{
+    dsp_cf32_to_sc16_q11(dst, src, num_samples);
+}
+
+void bladerf_convert_sc16q11_to_cs8(int8_t *dst, const int16_t *src,
+                                    unsigned int num_samples,
+                                    unsigned int shift)
+{
+    if (shift > BLADERF_SC8_SHIFT_MAX) {
+        shift = BLADERF_SC8_SHIFT_MAX;
+    }
+
+    dsp_sc16_q11_to_sc8_q7(dst, src, num_samples, shift);
+}
+
+const char *bladerf_convert_impl(void)
+{
+    return dsp_convert_impl();
+}
+
 
 /*------------------------------------------------------------------------------
  * Device Info
@@ -861,61 +3581,84 @@ void bladerf_deinit_stream(struct bladerf_stream *stream)
 
 int bladerf_get_serial(struct bladerf *dev, char *serial)
 {
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
     strcpy(serial, dev->ident.serial);
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
     return 0;
 }
 
 int bladerf_get_vctcxo_trim(struct bladerf *dev, uint16_t *trim)
 {
-    MUTEX_LOCK(&dev->ctrl_lock);
+    int status;
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
+
+    status = complete_deferred_open_locked(dev, BLADERF_OPEN_DEFER_CAL_REGION);
     *trim = dev->dac_trim;
-    MUTEX_UNLOCK(&dev->ctrl_lock);
-    return 0;
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
+    return status;
 }
 
 int bladerf_get_fpga_size(struct bladerf *dev, bladerf_fpga_size *size)
 {
-    MUTEX_LOCK(&dev->ctrl_lock);
+    int status;
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
+
+    status = complete_deferred_open_locked(dev, BLADERF_OPEN_DEFER_CAL_REGION);
     *size = dev->fpga_size;
-    MUTEX_UNLOCK(&dev->ctrl_lock);
-    return 0;
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
+    return status;
 }
 
 int bladerf_fw_version(struct bladerf *dev, struct bladerf_version *version)
 {
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
     memcpy(version, &dev->fw_version, sizeof(*version));
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
     return 0;
 }
 
 int bladerf_is_fpga_configured(struct bladerf *dev)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
 
     status = FPGA_IS_CONFIGURED(dev);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_get_fpga_load_time(struct bladerf *dev, unsigned int *ms)
+{
+    int status;
+
+    if (dev->fn->get_fpga_load_time == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = dev->fn->get_fpga_load_time(dev, ms);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
     return status;
 }
 
 int bladerf_fpga_version(struct bladerf *dev, struct bladerf_version *version)
 {
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
     memcpy(version, &dev->fpga_version, sizeof(*version));
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
     return 0;
 }
 
 bladerf_dev_speed bladerf_device_speed(struct bladerf *dev)
 {
     bladerf_dev_speed speed;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
     speed = dev->usb_speed;
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
     return speed;
 }
 
@@ -927,11 +3670,11 @@ int bladerf_erase_flash(struct bladerf *dev,
                         uint32_t erase_block, uint32_t count)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
 
     status = flash_erase(dev, erase_block, count);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
     return status;
 }
 
@@ -939,11 +3682,11 @@ int bladerf_read_flash(struct bladerf *dev, uint8_t *buf,
                        uint32_t page, uint32_t count)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
 
     status = flash_read(dev, buf, page, count);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
     return status;
 }
 
@@ -951,22 +3694,22 @@ int bladerf_write_flash(struct bladerf *dev, const uint8_t *buf,
                         uint32_t page, uint32_t count)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
 
     status = flash_write(dev, buf, page, count);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
     return status;
 }
 
 int bladerf_device_reset(struct bladerf *dev)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
 
     status = dev->fn->device_reset(dev);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
     return status;
 }
 
@@ -978,9 +3721,9 @@ int bladerf_jump_to_bootloader(struct bladerf *dev)
         return BLADERF_ERR_UNSUPPORTED;
     }
 
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
     status = dev->fn->jump_to_bootloader(dev);
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
     return status;
 }
 
@@ -999,13 +3742,12 @@ static inline bool valid_fw_size(size_t len)
 int bladerf_flash_firmware(struct bladerf *dev, const char *firmware_file)
 {
     int status;
-    uint8_t *buf = NULL;
-    size_t buf_size;
+    struct file_mapping map;
     const char env_override[] = "BLADERF_SKIP_FW_SIZE_CHECK";
 
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
 
-    status = file_read_buffer(firmware_file, &buf, &buf_size);
+    status = file_map(firmware_file, &map);
     if (status != 0) {
         goto out;
     }
@@ -1016,52 +3758,170 @@ int bladerf_flash_firmware(struct bladerf *dev, const char *firmware_file)
      *      using the bladerf image format currently used to backup/restore
      *      calibration data
      */
-    if (!getenv(env_override) && !valid_fw_size(buf_size)) {
+    if (!getenv(env_override) && !valid_fw_size(map.len)) {
         log_info("Detected potentially invalid firmware file.\n");
         log_info("Define BLADERF_SKIP_FW_SIZE_CHECK in your evironment "
                 "to skip this check.\n");
         status = BLADERF_ERR_INVAL;
     } else {
-        status = flash_write_fx3_fw(dev, &buf, buf_size);
+        status = flash_write_fx3_fw(dev, map.data, map.len);
+    }
+
+    file_unmap(&map);
+
+out:
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
+    return status;
+}
+
+int bladerf_load_fpga(struct bladerf *dev, const char *fpga_file)
+{
+    int status;
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
+
+    /* This supersedes any deferred FPGA autoload. The device initialization
+     * that follows the load requires anything else that was deferred. */
+    dev->deferred &= ~BLADERF_OPEN_DEFER_FPGA;
+    status = complete_deferred_open_locked(dev, BLADERF_OPEN_DEFER_ALL);
+
+    if (status == 0) {
+        status = fpga_load_from_file(dev, fpga_file);
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
+    return status;
+}
+
+/* Load an image that has already been checked by fpga_image_init() */
+static int load_fpga_image(struct bladerf *dev, const struct fpga_image *image)
+{
+    int status;
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
+
+    dev->deferred &= ~BLADERF_OPEN_DEFER_FPGA;
+    status = complete_deferred_open_locked(dev, BLADERF_OPEN_DEFER_ALL);
+
+    if (status == 0) {
+        status = fpga_load_image(dev, image);
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
+    return status;
+}
+
+int bladerf_load_fpga_from_buffer(struct bladerf *dev,
+                                  const uint8_t *buf, size_t len)
+{
+    struct fpga_image image;
+    int status;
+
+    status = fpga_image_init(&image, buf, len);
+    if (status != 0) {
+        return status;
+    }
+
+    return load_fpga_image(dev, &image);
+}
+
+struct load_task {
+    pthread_t thread;
+    bool started;
+    struct bladerf *dev;
+    const struct fpga_image *image;
+    int status;
+};
+
+static void *load_task(void *arg)
+{
+    struct load_task *task = (struct load_task *) arg;
+
+    task->status = load_fpga_image(task->dev, task->image);
+    if (task->status != 0) {
+        log_debug("Failed to load FPGA into %s: %s\n", task->dev->ident.serial,
+                  bladerf_strerror(task->status));
     }
 
-out:
-    MUTEX_UNLOCK(&dev->ctrl_lock);
-    free(buf);
-    return status;
+    return NULL;
 }
 
-int bladerf_load_fpga(struct bladerf *dev, const char *fpga_file)
+int bladerf_load_fpga_many(struct bladerf **devices, unsigned int n,
+                           const uint8_t *buf, size_t len, int *statuses)
 {
+    struct fpga_image image;
+    struct load_task *tasks;
+    unsigned int i;
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    int num_loaded = 0;
 
-    status = fpga_load_from_file(dev, fpga_file);
+    /* The image is checked and identified once, for all devices */
+    status = fpga_image_init(&image, buf, len);
+    if (status != 0) {
+        return status;
+    }
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
-    return status;
+    tasks = (struct load_task *) calloc(n, sizeof(tasks[0]));
+    if (tasks == NULL && n != 0) {
+        return BLADERF_ERR_MEM;
+    }
+
+    for (i = 0; i < n; i++) {
+        tasks[i].dev = devices[i];
+        tasks[i].image = &image;
+        tasks[i].status = BLADERF_ERR_NODEV;
+
+        if (devices[i] == NULL) {
+            continue;
+        }
+
+        tasks[i].status = BLADERF_ERR_UNEXPECTED;
+
+        status = pthread_create(&tasks[i].thread, NULL, load_task, &tasks[i]);
+        if (status == 0) {
+            tasks[i].started = true;
+        } else {
+            log_debug("Failed to start FPGA load thread: %s\n",
+                      strerror(status));
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        if (tasks[i].started) {
+            pthread_join(tasks[i].thread, NULL);
+        }
+
+        if (statuses != NULL) {
+            statuses[i] = tasks[i].status;
+        }
+
+        if (tasks[i].status == 0) {
+            num_loaded++;
+        }
+    }
+
+    free(tasks);
+    return num_loaded;
 }
 
 
 int bladerf_flash_fpga(struct bladerf *dev, const char *fpga_file)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
 
     status = fpga_write_to_flash(dev, fpga_file);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
     return status;
 }
 
 int bladerf_erase_stored_fpga(struct bladerf *dev)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
 
     status = flash_erase_fpga(dev);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
     return status;
 }
 
@@ -1101,6 +3961,10 @@ const char * bladerf_strerror(int error)
             return "A firmware update is required";
         case BLADERF_ERR_TIME_PAST:
             return "Requested timestamp is in the past";
+        case BLADERF_ERR_QUEUE_FULL:
+            return "Queue is full";
+        case BLADERF_ERR_WOULD_BLOCK:
+            return "Operation would block";
         case 0:
             return "Success";
         default:
@@ -1124,6 +3988,11 @@ void bladerf_log_set_verbosity(bladerf_log_level level)
 #endif
 }
 
+void bladerf_log_set_callback(bladerf_log_callback cb, void *user_data)
+{
+    log_set_callback(cb, user_data);
+}
+
 /*------------------------------------------------------------------------------
  * Device identifier information
  *----------------------------------------------------------------------------*/
@@ -1143,9 +4012,9 @@ void bladerf_init_devinfo(struct bladerf_devinfo *info)
 int bladerf_get_devinfo(struct bladerf *dev, struct bladerf_devinfo *info)
 {
     if (dev) {
-        MUTEX_LOCK(&dev->ctrl_lock);
+        CTRL_LOCK(dev, CTRL_LOCK_GPIO);
         memcpy(info, &dev->ident, sizeof(struct bladerf_devinfo));
-        MUTEX_UNLOCK(&dev->ctrl_lock);
+        CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
         return 0;
     } else {
         return BLADERF_ERR_INVAL;
@@ -1198,22 +4067,78 @@ const char * bladerf_backend_str(bladerf_backend backend)
 int bladerf_si5338_read(struct bladerf *dev, uint8_t address, uint8_t *val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_SI5338);
 
     status = dev->fn->si5338_read(dev,address,val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_SI5338);
     return status;
 }
 
 int bladerf_si5338_write(struct bladerf *dev, uint8_t address, uint8_t val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_SI5338);
 
     status = dev->fn->si5338_write(dev,address,val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    /* This may have changed a multisynth used for a sample clock */
+    si5338_shadow_invalidate(dev);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_SI5338);
+    return status;
+}
+
+/* Number of register accesses converted to the backend's representation at
+ * a time by bladerf_si5338_access() and bladerf_lms_access() */
+#define REG_ACCESS_CHUNK    128
+
+/* Perform `count` register accesses with `batch`, REG_ACCESS_CHUNK at a time */
+static int reg_access(struct bladerf *dev,
+                      int (*batch)(struct bladerf *dev,
+                                   struct backend_reg_access *regs,
+                                   size_t count),
+                      struct bladerf_reg_access *regs, unsigned int count)
+{
+    struct backend_reg_access chunk[REG_ACCESS_CHUNK];
+    unsigned int i, n;
+    int status = 0;
+
+    while (count != 0 && status == 0) {
+        n = count < REG_ACCESS_CHUNK ? count : REG_ACCESS_CHUNK;
+
+        for (i = 0; i < n; i++) {
+            chunk[i].addr = regs[i].address;
+            chunk[i].data = regs[i].value;
+            chunk[i].write = regs[i].write;
+        }
+
+        status = batch(dev, chunk, n);
+        if (status == 0) {
+            for (i = 0; i < n; i++) {
+                regs[i].value = chunk[i].data;
+            }
+        }
+
+        regs += n;
+        count -= n;
+    }
+
+    return status;
+}
+
+int bladerf_si5338_access(struct bladerf *dev,
+                          struct bladerf_reg_access *regs, unsigned int count)
+{
+    int status;
+    CTRL_LOCK(dev, CTRL_LOCK_SI5338);
+
+    status = reg_access(dev, si5338_access_batch, regs, count);
+
+    /* This may have changed a multisynth used for a sample clock */
+    si5338_shadow_invalidate(dev);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_SI5338);
     return status;
 }
 
@@ -1221,25 +4146,72 @@ int bladerf_si5338_write(struct bladerf *dev, uint8_t address, uint8_t val)
  * LMS register access and low-level functions
  *----------------------------------------------------------------------------*/
 
+int bladerf_batch_begin(struct bladerf *dev)
+{
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+    dev->lms_defer.depth++;
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+
+    return 0;
+}
+
+int bladerf_batch_end(struct bladerf *dev)
+{
+    int status;
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    if (dev->lms_defer.depth == 0) {
+        status = BLADERF_ERR_INVAL;
+    } else if (--dev->lms_defer.depth != 0) {
+        status = 0;
+    } else {
+        lms_defer_flush(dev);
+
+        /* Report the first failure of any flush during the batch */
+        status = dev->lms_defer.status;
+        dev->lms_defer.status = 0;
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
 int bladerf_lms_read(struct bladerf *dev, uint8_t address, uint8_t *val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
 
-    status = dev->fn->lms_read(dev,address,val);
+    /* This bypasses the register shadow, so deferred writes must land first */
+    status = lms_defer_flush(dev);
+    if (status == 0) {
+        status = dev->fn->lms_read(dev,address,val);
+    }
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
     return status;
 }
 
 int bladerf_lms_write(struct bladerf *dev, uint8_t address, uint8_t val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
+
+    status = LMS_WRITE(dev, address, val);
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
+    return status;
+}
+
+int bladerf_lms_access(struct bladerf *dev,
+                       struct bladerf_reg_access *regs, unsigned int count)
+{
+    int status;
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
 
-    status = dev->fn->lms_write(dev,address,val);
+    status = reg_access(dev, lms_access_batch, regs, count);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
     return status;
 }
 
@@ -1247,11 +4219,11 @@ int bladerf_lms_set_dc_cals(struct bladerf *dev,
                             const struct bladerf_lms_dc_cals *dc_cals)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
 
     status = lms_set_dc_cals(dev, dc_cals);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
     return status;
 }
 
@@ -1259,11 +4231,11 @@ int bladerf_lms_get_dc_cals(struct bladerf *dev,
                             struct bladerf_lms_dc_cals *dc_cals)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
 
     status = lms_get_dc_cals(dev, dc_cals);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
     return status;
 }
 
@@ -1274,22 +4246,25 @@ int bladerf_lms_get_dc_cals(struct bladerf *dev,
 int bladerf_config_gpio_read(struct bladerf *dev, uint32_t *val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
 
     status = CONFIG_GPIO_READ(dev, val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
     return status;
 }
 
 int bladerf_config_gpio_write(struct bladerf *dev, uint32_t val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
 
     status = CONFIG_GPIO_WRITE(dev, val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    /* This may have changed the expansion board selection */
+    dev->xb_shadow.attached_valid = false;
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
     return status;
 
 }
@@ -1300,22 +4275,34 @@ int bladerf_config_gpio_write(struct bladerf *dev, uint32_t val)
 int bladerf_expansion_attach(struct bladerf *dev, bladerf_xb xb)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
 
     status = xb_attach(dev, xb);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
     return status;
 }
 
 int bladerf_expansion_get_attached(struct bladerf *dev, bladerf_xb *xb)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
 
     status = xb_get_attached(dev, xb);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
     return status;
 }
 
@@ -1324,11 +4311,17 @@ int bladerf_xb200_set_filterbank(struct bladerf *dev,
                                  bladerf_xb200_filter filter)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
 
     status = xb200_set_filterbank(dev, mod, filter);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
     return status;
 }
 
@@ -1337,11 +4330,17 @@ int bladerf_xb200_get_filterbank(struct bladerf *dev,
                                  bladerf_xb200_filter *filter)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
 
     status = xb200_get_filterbank(dev, module, filter);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
     return status;
 }
 
@@ -1350,11 +4349,17 @@ int bladerf_xb200_set_path(struct bladerf *dev,
                            bladerf_xb200_path path)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
 
     status = xb200_set_path(dev, module, path);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
     return status;
 }
 
@@ -1363,11 +4368,17 @@ int bladerf_xb200_get_path(struct bladerf *dev,
                                      bladerf_xb200_path *path)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
 
     status = xb200_get_path(dev, module, path);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
     return status;
 }
 
@@ -1379,22 +4390,22 @@ int bladerf_xb200_get_path(struct bladerf *dev,
 int bladerf_expansion_gpio_read(struct bladerf *dev, uint32_t *val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
 
     status = XB_GPIO_READ(dev, val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
     return status;
 }
 
 int bladerf_expansion_gpio_write(struct bladerf *dev, uint32_t val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
 
-    status = XB_GPIO_WRITE(dev, val);
+    status = xb_gpio_write(dev, val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
     return status;
 }
 
@@ -1405,22 +4416,22 @@ int bladerf_expansion_gpio_write(struct bladerf *dev, uint32_t val)
 int bladerf_expansion_gpio_dir_read(struct bladerf *dev, uint32_t *val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
 
-    status = XB_GPIO_DIR_READ(dev, val);
+    status = xb_gpio_dir_read(dev, val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
     return status;
 }
 
 int bladerf_expansion_gpio_dir_write(struct bladerf *dev, uint32_t val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
 
-    status = XB_GPIO_DIR_WRITE(dev, val);
+    status = xb_gpio_dir_write(dev, val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
     return status;
 }
 
@@ -1431,11 +4442,17 @@ int bladerf_set_correction(struct bladerf *dev, bladerf_module module,
                            bladerf_correction corr, int16_t value)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
 
     status = dev->fn->set_correction(dev, module, corr, value);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
     return status;
 }
 
@@ -1443,11 +4460,17 @@ int bladerf_get_correction(struct bladerf *dev, bladerf_module module,
                            bladerf_correction corr, int16_t *value)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
 
     status = dev->fn->get_correction(dev, module, corr, value);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS | CTRL_LOCK_GPIO);
     return status;
 }
 
@@ -1457,11 +4480,159 @@ int bladerf_get_correction(struct bladerf *dev, bladerf_module module,
 int bladerf_get_timestamp(struct bladerf *dev, bladerf_module module, uint64_t *value)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_TS);
 
     status = dev->fn->get_timestamp(dev,module,value);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_TS);
+    return status;
+}
+
+int bladerf_enable_timestamp_correlation(struct bladerf *dev,
+                                         bladerf_module module,
+                                         unsigned int interval_ms)
+{
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (interval_ms == 0) {
+        ts_correlator_stop(&dev->ts_corr[module]);
+        return 0;
+    }
+
+    return ts_correlator_start(&dev->ts_corr[module], interval_ms);
+}
+
+int bladerf_estimate_timestamp(struct bladerf *dev, bladerf_module module,
+                               int64_t delta_us, uint64_t *timestamp)
+{
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return ts_correlator_estimate(&dev->ts_corr[module], delta_us, timestamp);
+}
+
+int bladerf_get_timestamp_correlation(struct bladerf *dev,
+                                bladerf_module module,
+                                struct bladerf_timestamp_correlation *info)
+{
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return ts_correlator_info(&dev->ts_corr[module], info);
+}
+
+static int time_latch_check(struct bladerf *dev)
+{
+    if (dev->fn->set_time_latch == NULL || dev->fn->get_time_latch == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 24)) {
+        log_warning("The timestamp latch requires FPGA v0.1.24 or later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    return 0;
+}
+
+int bladerf_config_time_latch(struct bladerf *dev,
+                              const struct bladerf_time_latch_config *config)
+{
+    int status;
+    uint32_t cfg;
+
+    switch (config->source) {
+        case BLADERF_TIME_LATCH_1PPS:
+        case BLADERF_TIME_LATCH_J51_1:
+        case BLADERF_TIME_LATCH_J51_2:
+            break;
+
+        case BLADERF_TIME_LATCH_XB_GPIO:
+            if (config->xb_gpio < 1 || config->xb_gpio > 32) {
+                log_debug("Invalid expansion GPIO: %u\n", config->xb_gpio);
+                return BLADERF_ERR_INVAL;
+            }
+            break;
+
+        default:
+            log_debug("Invalid time latch source: %d\n", config->source);
+            return BLADERF_ERR_INVAL;
+    }
+
+    switch (config->action) {
+        case BLADERF_TIME_LATCH_CAPTURE:
+        case BLADERF_TIME_LATCH_RESET:
+        case BLADERF_TIME_LATCH_LOAD:
+            break;
+
+        default:
+            log_debug("Invalid time latch action: %d\n", config->action);
+            return BLADERF_ERR_INVAL;
+    }
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    status = time_latch_check(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    cfg = ((uint32_t) config->source << TIME_LATCH_SOURCE_SHIFT) |
+          ((uint32_t) config->action << TIME_LATCH_ACTION_SHIFT) |
+          TIME_LATCH_ARM;
+
+    if (config->source == BLADERF_TIME_LATCH_XB_GPIO) {
+        cfg |= (config->xb_gpio - 1) << TIME_LATCH_XB_GPIO_SHIFT;
+    }
+
+    if (config->falling_edge) {
+        cfg |= TIME_LATCH_FALLING;
+    }
+
+    if (config->continuous) {
+        cfg |= TIME_LATCH_CONTINUOUS;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_TS);
+    status = dev->fn->set_time_latch(dev, cfg, config->load_value);
+    CTRL_UNLOCK(dev, CTRL_LOCK_TS);
+
+    return status;
+}
+
+int bladerf_get_time_latch(struct bladerf *dev, struct bladerf_time_latch *latch)
+{
+    int status;
+    uint32_t val;
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    status = time_latch_check(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_TS);
+    status = dev->fn->get_time_latch(dev, &latch->rx_time, &latch->tx_time,
+                                     &val);
+    CTRL_UNLOCK(dev, CTRL_LOCK_TS);
+
+    if (status == 0) {
+        latch->edges = val & TIME_LATCH_EDGES_MASK;
+        latch->pending = (val & (TIME_LATCH_RX_ARMED |
+                                 TIME_LATCH_TX_ARMED)) != 0;
+    }
+
     return status;
 }
 
@@ -1472,11 +4643,11 @@ int bladerf_get_timestamp(struct bladerf *dev, bladerf_module module, uint64_t *
 int bladerf_dac_write(struct bladerf *dev, uint16_t val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
 
     status = DAC_WRITE(dev, val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
     return status;
 }
 
@@ -1488,11 +4659,74 @@ int bladerf_dac_write(struct bladerf *dev, uint16_t val)
 int bladerf_xb_spi_write(struct bladerf *dev, uint32_t val)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
 
     status = XB_SPI_WRITE(dev, val);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+    return status;
+}
+
+int bladerf_set_fx3_dma_config(struct bladerf *dev, unsigned int count,
+                               unsigned int size)
+{
+    int status;
+
+    if (dev->fn->set_dma_config == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = dev->fn->set_dma_config(dev, count, size);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    return status;
+}
+
+int bladerf_set_fx3_burst_len(struct bladerf *dev, unsigned int len)
+{
+    int status;
+
+    if (dev->fn->set_burst_len == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = dev->fn->set_burst_len(dev, len);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    return status;
+}
+
+int bladerf_get_fx3_dma_config(struct bladerf *dev,
+                               struct bladerf_fx3_link_config *config)
+{
+    int status;
+
+    if (dev->fn->get_dma_config == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = dev->fn->get_dma_config(dev, config);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    return status;
+}
+
+int bladerf_get_fx3_stats(struct bladerf *dev, struct bladerf_fx3_stats *stats,
+                          bool reset)
+{
+    int status;
+
+    if (dev->fn->get_fx3_stats == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = dev->fn->get_fx3_stats(dev, stats, reset);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
     return status;
 }
 
@@ -1502,11 +4736,33 @@ int bladerf_xb_spi_write(struct bladerf *dev, uint32_t val)
 int bladerf_calibrate_dc(struct bladerf *dev, bladerf_cal_module module)
 {
     int status;
-    MUTEX_LOCK(&dev->ctrl_lock);
+
+    status = complete_deferred_open(dev, BLADERF_OPEN_DEFER_ALL);
+    if (status != 0) {
+        return status;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_LMS);
 
     status = lms_calibrate_dc(dev, module);
 
-    MUTEX_UNLOCK(&dev->ctrl_lock);
+    /* Save the results so they may be restored the next time this device is
+     * opened, without having to re-run the calibration */
+    if (status == 0) {
+        struct bladerf_lms_dc_cals cals;
+        int save_status = lms_get_dc_cals(dev, &cals);
+
+        if (save_status == 0) {
+            save_status = config_save_lms_dc_cals(dev, &cals);
+        }
+
+        if (save_status != 0 && save_status != BLADERF_ERR_UNSUPPORTED) {
+            log_debug("Failed to save LMS DC calibration values: %s\n",
+                      bladerf_strerror(save_status));
+        }
+    }
+
+    CTRL_UNLOCK(dev, CTRL_LOCK_LMS);
     return status;
 }
 
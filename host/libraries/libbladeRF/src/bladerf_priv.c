@@ -32,11 +32,13 @@
 #include "dc_cal_table.h"
 #include "xb.h"
 #include "version_compat.h"
+#include "config.h"
 
 static inline int apply_lms_dc_cals(struct bladerf *dev)
 {
     int status = 0;
-    struct bladerf_lms_dc_cals cals;
+    struct bladerf_lms_dc_cals cals, saved;
+    bool have_saved;
     const bool have_rx = BLADERF_HAS_RX_DC_CAL(dev);
     const bool have_tx = BLADERF_HAS_TX_DC_CAL(dev);
 
@@ -102,9 +104,19 @@ static inline int apply_lms_dc_cals(struct bladerf *dev)
         cals.tx_lpf_q   = reg_vals->tx_lpf_q;
     }
 
-    if (have_rx || have_tx) {
+    /* Prefer the results of the last bladerf_calibrate_dc() run on this
+     * device, if they were saved recently enough to still be valid */
+    have_saved = config_load_lms_dc_cals(dev, &saved) == 0;
+    if (have_saved) {
+        cals = saved;
+        log_verbose("Using saved LMS DC calibration register values.\n");
+    }
+
+    if (have_rx || have_tx || have_saved) {
         status = lms_set_dc_cals(dev, &cals);
+    }
 
+    if (have_rx || have_tx) {
         /* Force a re-tune so that we can apply the appropriate I/Q DC offset
          * values from our calibration table */
         if (status == 0) {
@@ -135,115 +147,132 @@ static inline int apply_lms_dc_cals(struct bladerf *dev)
     return status;
 }
 
-int init_device(struct bladerf *dev)
+/* Default LMS6002D configuration, applied when the FPGA has just been loaded
+ * and the LMS6002D has therefore just been released from reset. The bits set
+ * in `mask` are replaced with those in `value`. */
+static const struct {
+    uint8_t addr;
+    uint8_t mask;
+    uint8_t value;
+} lms_init_table[] = {
+    /* Disable the TX and RX front ends */
+    { 0x40, 0x02, 0x00 },
+    { 0x70, 0x01, 0x00 },
+
+    /* Set the internal LMS register to enable RX and TX */
+    { 0x05, 0xff, 0x3e },
+
+    /* LMS FAQ: Improve TX spurious emission performance */
+    { 0x47, 0xff, 0x40 },
+
+    /* LMS FAQ: Improve ADC performance */
+    { 0x59, 0xff, 0x29 },
+
+    /* LMS FAQ: Common mode voltage for ADC */
+    { 0x64, 0xff, 0x36 },
+
+    /* LMS FAQ: Higher LNA Gain */
+    { 0x79, 0xff, 0x37 },
+
+    /* Power down DC calibration comparators until they are need, as they
+     * have been shown to introduce undesirable artifacts into our signals.
+     * (This is documented in the LMS6 FAQ). */
+    { 0x3f, 0x80, 0x80 },   /* TX LPF DC cal comparator */
+    { 0x5f, 0x80, 0x80 },   /* RX LPF DC cal comparator */
+    { 0x6e, 0xc0, 0xc0 },   /* RXVGA2A/B DC cal comparators */
+};
+
+/* Bring up a device whose FPGA has just been loaded. The registers that the
+ * default configuration reads are fetched in two batches, and its LMS6002D
+ * writes are deferred by the caller, so they are sent together rather than
+ * one round trip at a time. */
+static int init_device_defaults(struct bladerf *dev)
 {
     int status;
-    uint32_t val;
+    struct lms_txn txn;
+    size_t i;
 
-    /* Readback the GPIO values to see if they are default or already set */
-    status = CONFIG_GPIO_READ( dev, &val );
+    /* Set the GPIO pins to enable the LMS and select the low band */
+    status = CONFIG_GPIO_WRITE(dev, 0x57);
     if (status != 0) {
-        log_debug("Failed to read GPIO config %s\n", bladerf_strerror(status));
         return status;
     }
 
-    if ((val & 0x7f) == 0) {
-        log_verbose( "Default GPIO value found - initializing device\n" );
-
-        /* Set the GPIO pins to enable the LMS and select the low band */
-        status = CONFIG_GPIO_WRITE(dev, 0x57);
-        if (status != 0) {
-            return status;
-        }
-
-        /* Disable the front ends */
-        status = lms_enable_rffe(dev, BLADERF_MODULE_TX, false);
-        if (status != 0) {
-            return status;
-        }
-
-        status = lms_enable_rffe(dev, BLADERF_MODULE_RX, false);
-        if (status != 0) {
-            return status;
-        }
-
-        /* Set the internal LMS register to enable RX and TX */
-        status = LMS_WRITE(dev, 0x05, 0x3e);
-        if (status != 0) {
-            return status;
-        }
+    /* Tuning reads the PLL registers, which are among these */
+    status = lms_prefetch_config(dev);
+    if (status != 0) {
+        return status;
+    }
 
-        /* LMS FAQ: Improve TX spurious emission performance */
-        status = LMS_WRITE(dev, 0x47, 0x40);
-        if (status != 0) {
-            return status;
-        }
+    lms_txn_begin(&txn, dev);
+    for (i = 0; i < ARRAY_SIZE(lms_init_table); i++) {
+        lms_txn_modify(&txn, lms_init_table[i].addr,
+                       lms_init_table[i].mask, lms_init_table[i].value);
+    }
 
-        /* LMS FAQ: Improve ADC performance */
-        status = LMS_WRITE(dev, 0x59, 0x29);
-        if (status != 0) {
-            return status;
-        }
+    status = lms_txn_commit(&txn);
+    if (status != 0) {
+        return status;
+    }
 
-        /* LMS FAQ: Common mode voltage for ADC */
-        status = LMS_WRITE(dev, 0x64, 0x36);
-        if (status != 0) {
-            return status;
-        }
+    /* Set a default samplerate */
+    status = si5338_set_sample_rate(dev, BLADERF_MODULE_TX, 1000000, NULL);
+    if (status != 0) {
+        return status;
+    }
 
-        /* LMS FAQ: Higher LNA Gain */
-        status = LMS_WRITE(dev, 0x79, 0x37);
-        if (status != 0) {
-            return status;
-        }
+    status = si5338_set_sample_rate(dev, BLADERF_MODULE_RX, 1000000, NULL);
+    if (status != 0) {
+        return status;
+    }
 
-        /* Power down DC calibration comparators until they are need, as they
-         * have been shown to introduce undesirable artifacts into our signals.
-         * (This is documented in the LMS6 FAQ). */
+    /* Set a default frequency of 1GHz */
+    status = tuning_set_freq_both(dev, 1000000000);
+    if (status != 0) {
+        return status;
+    }
 
-        status = lms_set(dev, 0x3f, 0x80);  /* TX LPF DC cal comparator */
-        if (status != 0) {
-            return status;
-        }
+    /* Set the calibrated VCTCXO DAC value */
+    return DAC_WRITE(dev, dev->dac_trim);
+}
 
-        status = lms_set(dev, 0x5f, 0x80);  /* RX LPF DC cal comparator */
-        if (status != 0) {
-            return status;
-        }
+int init_device(struct bladerf *dev)
+{
+    int status;
+    uint32_t val;
 
-        status = lms_set(dev, 0x6e, 0xc0);  /* RXVGA2A/B DC cal comparators */
-        if (status != 0) {
-            return status;
-        }
+    /* The FPGA may have just been (re)loaded, so nothing is known about the
+     * current state of the LMS6002D */
+    lms_shadow_invalidate(dev);
 
-        /* Set a default samplerate */
-        status = si5338_set_sample_rate(dev, BLADERF_MODULE_TX, 1000000, NULL);
-        if (status != 0) {
-            return status;
-        }
+    /* Readback the GPIO values to see if they are default or already set */
+    status = CONFIG_GPIO_READ( dev, &val );
+    if (status != 0) {
+        log_debug("Failed to read GPIO config %s\n", bladerf_strerror(status));
+        return status;
+    }
 
-        status = si5338_set_sample_rate(dev, BLADERF_MODULE_RX, 1000000, NULL);
-        if (status != 0) {
-            return status;
-        }
+    /* Waveform memory is cleared when the FPGA is loaded, and is otherwise
+     * unknown to a new session */
+    memset(dev->tx_waveforms, 0, sizeof(dev->tx_waveforms));
 
-        /* Set a default frequency of 1GHz */
-        status = tuning_set_freq(dev, BLADERF_MODULE_TX, 1000000000);
-        if (status != 0) {
-            return status;
+    /* Tracking may have been left enabled by a previous session */
+    dev->rx_tracking = 0;
+    if (!version_less_than(&dev->fpga_version, 0, 1, 9)) {
+        if (val & BLADERF_GPIO_RX_TRACK_DC) {
+            dev->rx_tracking |= BLADERF_RX_TRACK_DC;
         }
 
-        status = tuning_set_freq(dev, BLADERF_MODULE_RX, 1000000000);
-        if (status != 0) {
-            return status;
+        if (val & BLADERF_GPIO_RX_TRACK_IQ) {
+            dev->rx_tracking |= BLADERF_RX_TRACK_IQ;
         }
+    }
 
-        /* Set the calibrated VCTCXO DAC value */
-        status = DAC_WRITE(dev, dev->dac_trim);
-        if (status != 0) {
-            return status;
-        }
+    lms_defer_begin(dev);
 
+    if ((val & 0x7f) == 0) {
+        log_verbose( "Default GPIO value found - initializing device\n" );
+        status = init_device_defaults(dev);
     }
 
     /* Set up LMS DC offset register calibration and initial IQ settings,
@@ -253,9 +282,11 @@ int init_device(struct bladerf *dev)
      * as the user may change/update DC calibration tables without reloading the
      * FPGA.
      */
-    status = apply_lms_dc_cals(dev);
+    if (status == 0) {
+        status = apply_lms_dc_cals(dev);
+    }
 
-    return status;
+    return lms_defer_end(dev, status);
 }
 
 int populate_abs_timeout(struct timespec *t, unsigned int timeout_ms)
@@ -301,10 +332,15 @@ static inline int requires_timestamps(bladerf_format format, bool *required)
 
     switch (format) {
         case BLADERF_FORMAT_SC16_Q11_META:
+        case BLADERF_FORMAT_SC8_Q7_META:
             *required = true;
             break;
 
         case BLADERF_FORMAT_SC16_Q11:
+        case BLADERF_FORMAT_PSD_U32:
+        case BLADERF_FORMAT_SC16_Q11_PACKED:
+        case BLADERF_FORMAT_SC8_Q7:
+        case BLADERF_FORMAT_TX_SYMBOLS:
             *required = false;
             break;
 
@@ -315,6 +351,58 @@ static inline int requires_timestamps(bladerf_format format, bool *required)
     return status;
 }
 
+/* Select packed, 8-bit, unpacked samples or TX symbols for a module, on
+ * FPGAs that offer the choice */
+static int config_sample_fmt(struct bladerf *dev, bladerf_module module,
+                             bladerf_format format)
+{
+    int status;
+    uint32_t fmt, packed_bit, sc8_bit, symbols_bit;
+
+    if (dev->fn->get_sample_fmt == NULL || dev->fn->set_sample_fmt == NULL ||
+        version_less_than(&dev->fpga_version, 0, 1, 10)) {
+        return 0;
+    }
+
+    if (module == BLADERF_MODULE_RX) {
+        packed_bit = SAMPLE_FMT_RX_PACKED;
+        sc8_bit = SAMPLE_FMT_RX_SC8;
+        symbols_bit = 0;
+    } else {
+        packed_bit = SAMPLE_FMT_TX_PACKED;
+        sc8_bit = SAMPLE_FMT_TX_SC8;
+        symbols_bit = version_less_than(&dev->fpga_version, 0, 1, 23) ?
+                        0 : SAMPLE_FMT_TX_SYMBOLS;
+    }
+
+    status = dev->fn->get_sample_fmt(dev, &fmt);
+    if (status != 0) {
+        return status;
+    }
+
+    fmt &= ~(packed_bit | sc8_bit | symbols_bit);
+
+    switch (format) {
+        case BLADERF_FORMAT_SC16_Q11_PACKED:
+            fmt |= packed_bit;
+            break;
+
+        case BLADERF_FORMAT_SC8_Q7:
+        case BLADERF_FORMAT_SC8_Q7_META:
+            fmt |= sc8_bit;
+            break;
+
+        case BLADERF_FORMAT_TX_SYMBOLS:
+            fmt |= symbols_bit;
+            break;
+
+        default:
+            break;
+    }
+
+    return dev->fn->set_sample_fmt(dev, fmt);
+}
+
 int perform_format_config(struct bladerf *dev, bladerf_module module,
                           bladerf_format format)
 {
@@ -335,6 +423,60 @@ int perform_format_config(struct bladerf *dev, bladerf_module module,
         return BLADERF_ERR_UPDATE_FPGA;
     }
 
+    if (format == BLADERF_FORMAT_PSD_U32) {
+        if (module != BLADERF_MODULE_RX) {
+            log_debug("%s: Power spectra are only supported for RX\n",
+                      __FUNCTION__);
+            return BLADERF_ERR_INVAL;
+        }
+
+        if (version_less_than(&dev->fpga_version, 0, 1, 8)) {
+            log_warning("Power spectrum support requires "
+                        "FPGA v0.1.8 or later.\n");
+            return BLADERF_ERR_UPDATE_FPGA;
+        }
+    }
+
+    if (format == BLADERF_FORMAT_SC16_Q11_PACKED) {
+        if (version_less_than(&dev->fpga_version, 0, 1, 10)) {
+            log_warning("Packed samples require FPGA v0.1.10 or later.\n");
+            return BLADERF_ERR_UPDATE_FPGA;
+        }
+
+        if (dev->fn->set_sample_fmt == NULL) {
+            return BLADERF_ERR_UNSUPPORTED;
+        }
+    }
+
+    if (format == BLADERF_FORMAT_SC8_Q7 ||
+        format == BLADERF_FORMAT_SC8_Q7_META) {
+        if (version_less_than(&dev->fpga_version, 0, 1, 11)) {
+            log_warning("8-bit samples require FPGA v0.1.11 or later.\n");
+            return BLADERF_ERR_UPDATE_FPGA;
+        }
+
+        if (dev->fn->set_sample_fmt == NULL) {
+            return BLADERF_ERR_UNSUPPORTED;
+        }
+    }
+
+    if (format == BLADERF_FORMAT_TX_SYMBOLS) {
+        if (module != BLADERF_MODULE_TX) {
+            log_debug("%s: Symbols are only supported for TX\n",
+                      __FUNCTION__);
+            return BLADERF_ERR_INVAL;
+        }
+
+        if (version_less_than(&dev->fpga_version, 0, 1, 23)) {
+            log_warning("TX symbols require FPGA v0.1.23 or later.\n");
+            return BLADERF_ERR_UPDATE_FPGA;
+        }
+
+        if (dev->fn->set_sample_fmt == NULL) {
+            return BLADERF_ERR_UNSUPPORTED;
+        }
+    }
+
     switch (module) {
         case BLADERF_MODULE_RX:
             other = BLADERF_MODULE_TX;
@@ -368,8 +510,20 @@ int perform_format_config(struct bladerf *dev, bladerf_module module,
         gpio_val &= ~(BLADERF_GPIO_TIMESTAMP | BLADERF_GPIO_TIMESTAMP_DIV2);
     }
 
+    if (module == BLADERF_MODULE_RX) {
+        if (format == BLADERF_FORMAT_PSD_U32) {
+            gpio_val |= BLADERF_GPIO_PSD;
+        } else {
+            gpio_val &= ~BLADERF_GPIO_PSD;
+        }
+    }
+
     status = CONFIG_GPIO_WRITE(dev, gpio_val);
 
+    if (status == 0) {
+        status = config_sample_fmt(dev, module, format);
+    }
+
     if (status == 0) {
         dev->module_format[module] = format;
     }
@@ -48,6 +48,12 @@
 #include "flash.h"
 #include "backend/backend.h"
 #include "rel_assert.h"
+#include "ts_correlator.h"
+#include "hop.h"
+#include "profile.h"
+#include "agc.h"
+#include "bg_cal.h"
+#include "trace.h"
 
 /* 1 TX, 1 RX */
 #define NUM_MODULES 2
@@ -83,19 +89,172 @@ struct calibrations {
     struct dc_cal_tbl *dc_tx;
 };
 
+/* Number of addressable LMS6002D registers */
+#define LMS_NUM_REGISTERS 128
+
+/* Number of previously tuned frequencies, per module, for which the VCOCAP
+ * value is remembered */
+#ifndef LMS_VCOCAP_CACHE_SIZE
+#   define LMS_VCOCAP_CACHE_SIZE 64
+#endif
+
+struct lms_vcocap_cache {
+    struct {
+        uint32_t freq;
+        uint8_t vcocap;
+    } entries[LMS_VCOCAP_CACHE_SIZE];
+
+    size_t count;   /* Number of valid entries */
+    size_t next;    /* Entry to replace next, once the cache is full */
+};
+
+/* Write-through shadows of the expansion board state, maintained by xb.c.
+ * Each is filled in by the first read after being invalidated. */
+struct xb_shadow {
+    bool attached_valid;
+    bladerf_xb attached;
+
+    bool gpio_valid;
+    uint32_t gpio;
+
+    bool gpio_dir_valid;
+    uint32_t gpio_dir;
+};
+
+/* Number of LMS6002D writes that may be deferred by bladerf_batch_begin()
+ * before they are flushed to the device */
+#ifndef LMS_DEFER_MAX_OPS
+#   define LMS_DEFER_MAX_OPS 64
+#endif
+
+struct lms_defer {
+    unsigned int depth;     /* Number of unmatched bladerf_batch_begin() calls */
+    int status;             /* First error encountered by a flush */
+    size_t count;
+    uint8_t addr[LMS_DEFER_MAX_OPS];
+    uint8_t data[LMS_DEFER_MAX_OPS];
+};
+
+/* Number of Si5338 multisynth parameter registers */
+#define SI5338_MS_NUM_REGS 10
+
+/* Number of recently requested sample rates for which the computed Si5338
+ * multisynth register values are remembered */
+#ifndef SI5338_RATE_CACHE_SIZE
+#   define SI5338_RATE_CACHE_SIZE 8
+#endif
+
+/* Register values that program a multisynth to a particular rate */
+struct si5338_ms_regs {
+    uint8_t params[SI5338_MS_NUM_REGS];   /* MSx_P1, MSx_P2, MSx_P3 */
+    uint8_t r_div;                        /* Rx_DIV register */
+};
+
+struct si5338_rate_cache {
+    struct {
+        struct bladerf_rational_rate requested;
+        struct bladerf_rational_rate actual;
+        struct si5338_ms_regs regs;
+    } entries[SI5338_RATE_CACHE_SIZE];
+
+    size_t count;   /* Number of valid entries */
+    size_t next;    /* Entry to replace next, once the cache is full */
+};
+
+/* Last values written to, or read from, a module's multisynth registers */
+struct si5338_ms_shadow {
+    bool valid;
+    uint8_t enable;     /* Output enable register */
+    struct si5338_ms_regs regs;
+};
+
+/*
+ * Control lock domains
+ *
+ * Control operations on unrelated parts of the device take different locks,
+ * so that e.g., a DC calibration does not hold off timestamp reads from
+ * another thread. An operation holds the lock of every domain whose state it
+ * reads or modifies. Multiple locks are always acquired in the order below,
+ * and released in the reverse order:
+ *
+ *  CTRL_LOCK_LMS       LMS6002D registers, shadow, deferred writes, and the
+ *                      tuning state and statistics
+ *  CTRL_LOCK_SI5338    Si5338 registers and the sample rate caches
+ *  CTRL_LOCK_GPIO      FPGA registers (config GPIO, corrections, FIFOs, RX
+ *                      trigger), the VCTCXO DAC, and expansion boards
+ *  CTRL_LOCK_TS        Timestamp counter reads
+ *
+ * Operations that change the state of the entire device, such as flash
+ * accesses (which change the USB alt setting), FPGA loads, and stream setup,
+ * hold CTRL_LOCK_ALL. State that is only modified with CTRL_LOCK_ALL held
+ * (e.g., the device's versions) may be read while holding any one domain.
+ *
+ * dev->sync_lock[], dev->stream_lock[] and then dev->xfer_lock are acquired
+ * after these. The RX and TX instances of the per-module locks are
+ * independent, and when both are needed, RX is acquired first.
+ */
+#define CTRL_LOCK_LMS       (1 << 0)
+#define CTRL_LOCK_SI5338    (1 << 1)
+#define CTRL_LOCK_GPIO      (1 << 2)
+#define CTRL_LOCK_TS        (1 << 3)
+#define NUM_CTRL_LOCKS      4
+#define CTRL_LOCK_ALL       ((1 << NUM_CTRL_LOCKS) - 1)
+
+#define CTRL_LOCK(dev, domains)     ctrl_lock_acquire(dev, domains)
+#define CTRL_UNLOCK(dev, domains)   ctrl_lock_release(dev, domains)
+
+#define STREAM_LOCK_BOTH(dev) do { \
+    MUTEX_LOCK(&(dev)->stream_lock[BLADERF_MODULE_RX]); \
+    MUTEX_LOCK(&(dev)->stream_lock[BLADERF_MODULE_TX]); \
+} while (0)
+
+#define STREAM_UNLOCK_BOTH(dev) do { \
+    MUTEX_UNLOCK(&(dev)->stream_lock[BLADERF_MODULE_TX]); \
+    MUTEX_UNLOCK(&(dev)->stream_lock[BLADERF_MODULE_RX]); \
+} while (0)
+
+/* Extent of a waveform in the FPGA's TX waveform memory, in samples */
+struct tx_waveform {
+    uint16_t base;
+    uint16_t len;           /* 0 if no waveform is loaded */
+};
+
 struct bladerf {
 
-    /* Control lock - use this to ensure atomic access to control and
-     * configuration operations */
-    MUTEX ctrl_lock;
+    /* Control locks, one per CTRL_LOCK_* domain. Acquire these with
+     * CTRL_LOCK(), which takes them in the documented lock order. */
+    MUTEX ctrl_lock[NUM_CTRL_LOCKS];
+
+    /* Serializes the backend's transactions with the device, such as a
+     * peripheral request and its ACK, along with ctrl_requests and the
+     * trace buffer. This is acquired after any control or sync lock. */
+    MUTEX xfer_lock;
 
-    /* Ensure sync transfers occur atomically. If this is to be held in
-     * conjunction with ctrl_lock, ctrl_lock should be acquired BEFORE
-     * the relevant sync_lock[] */
+    /* Ensure sync transfers occur atomically, and guard the lifetime of the
+     * module's sync[] handle. If this is to be held in conjunction with any
+     * ctrl_lock[], the ctrl_lock[] should be acquired BEFORE the relevant
+     * sync_lock[] */
     MUTEX sync_lock[NUM_MODULES];
 
+    /* Guard the lifetime of the module's sync[] handle, like sync_lock[],
+     * for callers that must not wait for sync_lock[]: disabling a module
+     * wakes a sync call blocked while holding it. This is acquired after
+     * sync_lock[], and only held briefly, while the sync[] pointer is
+     * changed or used without sync_lock[]. */
+    MUTEX sync_handle_lock[NUM_MODULES];
+
+    /* Guard each module's stream settings: its transfer_timeout,
+     * stream_thread_config and stream_bufs_per_transfer. stream_buffer_flags
+     * is shared, and requires both. These are held only briefly, so a module
+     * may be reconfigured while the other is streaming. */
+    MUTEX stream_lock[NUM_MODULES];
+
     struct bladerf_devinfo ident;  /* Identifying information */
 
+    /* BLADERF_OPEN_DEFER_* flags denoting portions of the open that were
+     * deferred and have not yet been performed */
+    uint32_t deferred;
+
     uint16_t dac_trim;
     bladerf_fpga_size fpga_size;
 
@@ -116,6 +275,16 @@ struct bladerf {
     /* Stream transfer timeouts for RX and TX */
     int transfer_timeout[NUM_MODULES];
 
+    /* Scheduling options for stream threads */
+    struct bladerf_stream_thread_config stream_thread_config[NUM_MODULES];
+
+    /* BLADERF_STREAM_BUFFERS_* flags used when allocating stream buffers */
+    uint32_t stream_buffer_flags;
+
+    /* Max number of stream buffers a backend may cover with a single
+     * transfer. 0 and 1 both imply one buffer per transfer. */
+    unsigned int stream_bufs_per_transfer[NUM_MODULES];
+
     /* Synchronous interface handles */
     struct bladerf_sync *sync[NUM_MODULES];
 
@@ -128,10 +297,91 @@ struct bladerf {
     /* Track filterbank selection for TX autoselection */
     bladerf_xb200_filter tx_filter;
 
+    /* Expansion board attachment and GPIO state */
+    struct xb_shadow xb_shadow;
+
+    /* BLADERF_RX_TRACK_* loops enabled in the FPGA, cached so that retuning
+     * need not read them back */
+    uint32_t rx_tracking;
+
+    /* Waveforms loaded into the FPGA, protected by sync_lock[TX] */
+    struct tx_waveform tx_waveforms[BLADERF_TX_WAVEFORMS];
+
     /* Format currently being used with a module, or -1 if module is not used */
     bladerf_format module_format[NUM_MODULES];
+
+    /* Write-through cache of LMS6002D register values, maintained by lms.c */
+    uint8_t lms_shadow[LMS_NUM_REGISTERS];
+    bool lms_shadow_valid[LMS_NUM_REGISTERS];
+
+    /* Registers that the FPGA may modify on its own, due to scheduled
+     * updates, and that are therefore excluded from the shadow */
+    bool lms_shadow_volatile[LMS_NUM_REGISTERS];
+
+    /* LMS6002D writes deferred while a batch is open, maintained by lms.c */
+    struct lms_defer lms_defer;
+
+    /* VCOCAP values found for recently tuned frequencies */
+    struct lms_vcocap_cache vcocap_cache[NUM_MODULES];
+
+    /* Si5338 multisynth register values for recently requested sample rates,
+     * and the values currently programmed for each module */
+    struct si5338_rate_cache si5338_rate_cache;
+    struct si5338_ms_shadow si5338_shadow[NUM_MODULES];
+
+    /* Host clock to timestamp counter correlation, for RX and TX */
+    struct ts_correlator ts_corr[NUM_MODULES];
+
+    /* Frequency hopping engines, for RX and TX */
+    struct hopper hop[NUM_MODULES];
+
+    /* Operating profiles, for RX and TX. These are protected by
+     * CTRL_LOCK_LMS. */
+    struct profile_table profiles[NUM_MODULES];
+
+    /* Automatic gain control of received samples */
+    struct agc agc;
+
+    /* Background DC offset and IQ imbalance calibration of received samples */
+    struct bg_cal bg_cal;
+
+    /* Set by bladerf_standby() and cleared by bladerf_resume(). This is
+     * modified with CTRL_LOCK_ALL held. */
+    bool standby;
+
+    /* Number of control requests sent to the device, maintained by the
+     * backend */
+    uint64_t ctrl_requests;
+
+    /* Frequency change profiling, maintained by tuning.c */
+    struct bladerf_tuning_stats tuning_stats[NUM_MODULES];
+
+    /* Control path trace, recorded by the backend */
+    struct trace_buf trace;
 };
 
+static inline void ctrl_lock_acquire(struct bladerf *dev, unsigned int domains)
+{
+    unsigned int i;
+
+    for (i = 0; i < NUM_CTRL_LOCKS; i++) {
+        if (domains & (1 << i)) {
+            MUTEX_LOCK(&dev->ctrl_lock[i]);
+        }
+    }
+}
+
+static inline void ctrl_lock_release(struct bladerf *dev, unsigned int domains)
+{
+    unsigned int i;
+
+    for (i = NUM_CTRL_LOCKS; i-- > 0; ) {
+        if (domains & (1 << i)) {
+            MUTEX_UNLOCK(&dev->ctrl_lock[i]);
+        }
+    }
+}
+
 /*
  * Convert bytes to SC16Q11 samples
  */
@@ -158,8 +408,19 @@ static inline size_t samples_to_bytes(bladerf_format format, size_t n)
     switch (format) {
         case BLADERF_FORMAT_SC16_Q11:
         case BLADERF_FORMAT_SC16_Q11_META:
+        case BLADERF_FORMAT_PSD_U32:
+        case BLADERF_FORMAT_TX_SYMBOLS:
             return sc16q11_to_bytes(n);
 
+        case BLADERF_FORMAT_SC16_Q11_PACKED:
+            assert(n <= (SIZE_MAX / 3));
+            return 3 * n;
+
+        case BLADERF_FORMAT_SC8_Q7:
+        case BLADERF_FORMAT_SC8_Q7_META:
+            assert(n <= (SIZE_MAX / 2));
+            return 2 * n;
+
         default:
             assert(!"Invalid format");
             return 0;
@@ -172,14 +433,54 @@ static inline size_t bytes_to_samples(bladerf_format format, size_t n)
     switch (format) {
         case BLADERF_FORMAT_SC16_Q11:
         case BLADERF_FORMAT_SC16_Q11_META:
+        case BLADERF_FORMAT_PSD_U32:
+        case BLADERF_FORMAT_TX_SYMBOLS:
             return bytes_to_sc16q11(n);
 
+        /* Short transfers may end part way through a sample */
+        case BLADERF_FORMAT_SC16_Q11_PACKED:
+            return n / 3;
+
+        case BLADERF_FORMAT_SC8_Q7:
+        case BLADERF_FORMAT_SC8_Q7_META:
+            assert((n % 2) == 0);
+            return n / 2;
+
         default:
             assert(!"Invalid format");
             return 0;
     }
 }
 
+/* Format carried in buffers for a host format that the sync interface
+ * converts to and from */
+static inline bladerf_format format_wire(bladerf_format format)
+{
+    switch (format) {
+        case BLADERF_FORMAT_CF32:
+            return BLADERF_FORMAT_SC16_Q11;
+
+        case BLADERF_FORMAT_CF32_META:
+            return BLADERF_FORMAT_SC16_Q11_META;
+
+        default:
+            return format;
+    }
+}
+
+/* Does the provided format carry metadata headers? */
+static inline bool format_has_metadata(bladerf_format format)
+{
+    switch (format) {
+        case BLADERF_FORMAT_SC16_Q11_META:
+        case BLADERF_FORMAT_SC8_Q7_META:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
 /**
  * Initialize device registers - required after power-up, but safe
  * to call multiple times after power-up (e.g., multiple close and reopens)
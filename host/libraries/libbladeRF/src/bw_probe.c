@@ -0,0 +1,453 @@
+/*
+ * USB bandwidth probe
+ *
+ * With the FX3 in firmware loopback mode, every buffer transmitted by the
+ * host is returned over the RX endpoint. A TX thread streams blocks of zeros,
+ * each starting with a marker that carries a sequence number, while the
+ * calling thread receives them. The time each marker was handed to
+ * bladerf_sync_tx() is recorded in a ring, and the RX side searches every
+ * sample position for markers, as samples are not guaranteed to arrive
+ * aligned to the transmitted blocks.
+ *
+ * A marker consists of four samples, whose components are:
+ *
+ *   MARKER_0, MARKER_1, seq[7:0], seq[15:8], seq[23:16], seq[31:24],
+ *   MARKER_1, MARKER_0
+ *
+ * These lie within [-128, 127], such that they survive every sample format.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "log.h"
+#include "rel_assert.h"
+#include "thread.h"
+#include "bladerf_priv.h"
+#include "async.h"
+#include "metadata.h"
+#include "bw_probe.h"
+
+#define MARKER_0        0x5a
+#define MARKER_1        (-0x3c)
+#define MARKER_COMPS    8
+
+/* Number of outstanding markers whose transmit time is kept. This must cover
+ * every block that may be in flight at once. */
+#ifndef BW_PROBE_RING_LEN
+#   define BW_PROBE_RING_LEN 4096
+#endif
+
+struct marker_slot {
+    volatile uint32_t seq;
+    volatile uint64_t sent_us;
+};
+
+struct bw_probe {
+    struct bladerf *dev;
+    const struct bladerf_bandwidth_probe_config *config;
+    bool sc8;                   /* 8-bit sample components */
+    bool meta;                  /* Format carries metadata headers */
+    size_t block_bytes;         /* Size of a block in the caller's format */
+
+    void *tx_buf;
+    void *rx_buf;
+
+    struct marker_slot ring[BW_PROBE_RING_LEN];
+
+    volatile uint32_t measuring;    /* Set by RX once samples are flowing */
+    volatile uint32_t stop;         /* Set by RX at the end of the window */
+    volatile uint32_t tx_done;      /* Set by TX before it exits */
+    uint64_t tx_samples;            /* Transmitted during the measurement */
+    int tx_status;
+
+    uint64_t rx_samples;
+    bool seen_marker;
+    uint32_t last_seq;
+};
+
+static inline void set_comp(const struct bw_probe *p, void *buf, size_t i,
+                            int v)
+{
+    if (p->sc8) {
+        ((int8_t *) buf)[i] = (int8_t) v;
+    } else {
+        ((int16_t *) buf)[i] = (int16_t) v;
+    }
+}
+
+static inline int get_comp(const struct bw_probe *p, const void *buf,
+                           size_t i)
+{
+    if (p->sc8) {
+        return ((const int8_t *) buf)[i];
+    } else {
+        return ((const int16_t *) buf)[i];
+    }
+}
+
+static void write_marker(const struct bw_probe *p, void *buf, uint32_t seq)
+{
+    unsigned int i;
+
+    set_comp(p, buf, 0, MARKER_0);
+    set_comp(p, buf, 1, MARKER_1);
+
+    for (i = 0; i < 4; i++) {
+        set_comp(p, buf, 2 + i, (int8_t) (seq >> (8 * i)));
+    }
+
+    set_comp(p, buf, 6, MARKER_1);
+    set_comp(p, buf, 7, MARKER_0);
+}
+
+/* Number of bytes sent over USB to carry n samples */
+static uint64_t wire_bytes(const struct bw_probe *p, uint64_t n)
+{
+    const bladerf_format format = p->config->format;
+
+    if (p->meta) {
+        const size_t msg_size = p->dev->msg_size;
+        const size_t per_msg =
+            bytes_to_samples(format, msg_size - METADATA_HEADER_SIZE);
+
+        return n * msg_size / per_msg;
+    } else {
+        return samples_to_bytes(format, (size_t) 1) * n;
+    }
+}
+
+static void *tx_thread(void *arg)
+{
+    struct bw_probe *p = (struct bw_probe *) arg;
+    const struct bladerf_bandwidth_probe_config *c = p->config;
+    struct bladerf_metadata meta;
+    uint32_t seq = 0;
+    int status = 0;
+
+    while (!ATOMIC_LOAD_ACQUIRE(&p->stop)) {
+        struct marker_slot *slot = &p->ring[seq % BW_PROBE_RING_LEN];
+
+        write_marker(p, p->tx_buf, seq);
+
+        slot->sent_us = async_stats_time_us();
+        ATOMIC_STORE_RELEASE(&slot->seq, seq);
+
+        memset(&meta, 0, sizeof(meta));
+        if (seq == 0) {
+            meta.flags = BLADERF_META_FLAG_TX_BURST_START |
+                         BLADERF_META_FLAG_TX_NOW;
+        }
+
+        status = bladerf_sync_tx(p->dev, p->tx_buf, c->buffer_size,
+                                 p->meta ? &meta : NULL, c->timeout_ms);
+        if (status != 0) {
+            log_debug("%s: TX failed: %s\n", __FUNCTION__,
+                      bladerf_strerror(status));
+            break;
+        }
+
+        if (ATOMIC_LOAD_ACQUIRE(&p->measuring) &&
+            !ATOMIC_LOAD_ACQUIRE(&p->stop)) {
+            p->tx_samples += c->buffer_size;
+        }
+
+        seq++;
+    }
+
+    /* Close out the burst, so that the sync interface flushes it */
+    if (status == 0 && p->meta && seq != 0) {
+        memset(p->tx_buf, 0, p->block_bytes);
+        memset(&meta, 0, sizeof(meta));
+        meta.flags = BLADERF_META_FLAG_TX_BURST_END;
+
+        status = bladerf_sync_tx(p->dev, p->tx_buf, c->buffer_size, &meta,
+                                 c->timeout_ms);
+    }
+
+    p->tx_status = status;
+    ATOMIC_STORE_RELEASE(&p->tx_done, 1);
+    return NULL;
+}
+
+/* Locate markers within n received samples, and account for their latency */
+static void rx_find_markers(struct bw_probe *p, unsigned int n,
+                            uint64_t now_us,
+                            struct bladerf_bandwidth_probe_results *r)
+{
+    const void *buf = p->rx_buf;
+    size_t i;
+
+    for (i = 0; i + MARKER_COMPS <= 2 * (size_t) n; i += 2) {
+        uint32_t seq = 0;
+        unsigned int j;
+        const struct marker_slot *slot;
+
+        if (get_comp(p, buf, i) != MARKER_0 ||
+            get_comp(p, buf, i + 1) != MARKER_1 ||
+            get_comp(p, buf, i + 6) != MARKER_1 ||
+            get_comp(p, buf, i + 7) != MARKER_0) {
+            continue;
+        }
+
+        for (j = 0; j < 4; j++) {
+            seq |= (uint32_t) (uint8_t) get_comp(p, buf, i + 2 + j) << (8 * j);
+        }
+
+        /* Ignore markers whose slot has since been reused */
+        slot = &p->ring[seq % BW_PROBE_RING_LEN];
+        if (ATOMIC_LOAD_ACQUIRE(&slot->seq) == seq) {
+            const uint64_t sent_us = slot->sent_us;
+            const uint64_t latency = now_us > sent_us ? now_us - sent_us : 0;
+
+            if (ATOMIC_LOAD_ACQUIRE(&p->measuring)) {
+                r->markers++;
+                r->latency_total_us += latency;
+
+                if (latency < r->latency_min_us) {
+                    r->latency_min_us = latency;
+                }
+
+                if (latency > r->latency_max_us) {
+                    r->latency_max_us = latency;
+                }
+
+                async_stats_hist_add(r->latency_hist, sent_us, now_us);
+            }
+        }
+
+        if (p->seen_marker && seq > p->last_seq + 1) {
+            r->markers_lost += seq - p->last_seq - 1;
+        }
+
+        if (!p->seen_marker || seq > p->last_seq) {
+            p->last_seq = seq;
+            p->seen_marker = true;
+        }
+
+        i += MARKER_COMPS - 2;
+    }
+}
+
+static int rx_loop(struct bw_probe *p,
+                   struct bladerf_bandwidth_probe_results *r)
+{
+    const struct bladerf_bandwidth_probe_config *c = p->config;
+    const uint64_t duration_us = (uint64_t) c->duration_ms * 1000;
+    struct bladerf_metadata meta;
+    uint64_t start_us = 0, now_us = 0;
+    int status = 0;
+
+    while (!ATOMIC_LOAD_ACQUIRE(&p->tx_done)) {
+        unsigned int n = c->buffer_size;
+
+        memset(&meta, 0, sizeof(meta));
+        meta.flags = BLADERF_META_FLAG_RX_NOW;
+
+        status = bladerf_sync_rx(p->dev, p->rx_buf, c->buffer_size,
+                                 p->meta ? &meta : NULL, c->timeout_ms);
+        if (status != 0) {
+            /* Once TX has stopped, loopback samples may cease to arrive */
+            if (ATOMIC_LOAD_ACQUIRE(&p->stop)) {
+                status = 0;
+            } else {
+                log_debug("%s: RX failed: %s\n", __FUNCTION__,
+                          bladerf_strerror(status));
+            }
+            break;
+        }
+
+        now_us = async_stats_time_us();
+
+        if (p->meta) {
+            n = meta.actual_count;
+        }
+
+        /* Keep receiving once the window has ended, until TX is done, so
+         * that it is not left waiting for buffers to be looped back */
+        if (ATOMIC_LOAD_ACQUIRE(&p->stop)) {
+            continue;
+        }
+
+        rx_find_markers(p, n, now_us, r);
+
+        if (!ATOMIC_LOAD_ACQUIRE(&p->measuring)) {
+            start_us = now_us;
+            ATOMIC_STORE_RELEASE(&p->measuring, 1);
+        } else {
+            p->rx_samples += n;
+
+            if (now_us - start_us >= duration_us) {
+                r->elapsed_us = now_us - start_us;
+                ATOMIC_STORE_RELEASE(&p->stop, 1);
+            }
+        }
+    }
+
+    ATOMIC_STORE_RELEASE(&p->stop, 1);
+    return status;
+}
+
+static int check_config(const struct bladerf_bandwidth_probe_config *c)
+{
+    switch (c->format) {
+        case BLADERF_FORMAT_SC16_Q11:
+        case BLADERF_FORMAT_SC16_Q11_META:
+        case BLADERF_FORMAT_SC16_Q11_PACKED:
+        case BLADERF_FORMAT_SC8_Q7:
+        case BLADERF_FORMAT_SC8_Q7_META:
+            break;
+
+        default:
+            log_debug("%s: Unsupported format: %d\n", __FUNCTION__,
+                      c->format);
+            return BLADERF_ERR_INVAL;
+    }
+
+    if (c->duration_ms == 0 || c->buffer_size < MARKER_COMPS / 2) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    return 0;
+}
+
+static int run(struct bw_probe *p, struct bladerf_bandwidth_probe_results *r)
+{
+    const struct bladerf_bandwidth_probe_config *c = p->config;
+    const bladerf_module modules[2] = { BLADERF_MODULE_RX, BLADERF_MODULE_TX };
+    pthread_t thread;
+    int status = 0;
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(modules) && status == 0; i++) {
+        status = bladerf_sync_config(p->dev, modules[i], c->format,
+                                     c->num_buffers, c->buffer_size,
+                                     c->num_transfers, c->timeout_ms);
+    }
+
+    for (i = 0; i < ARRAY_SIZE(modules) && status == 0; i++) {
+        status = bladerf_enable_module(p->dev, modules[i], true);
+    }
+
+    if (status != 0) {
+        goto out;
+    }
+
+    status = pthread_create(&thread, NULL, tx_thread, p);
+    if (status != 0) {
+        log_debug("%s: Failed to start TX thread: %s\n", __FUNCTION__,
+                  strerror(status));
+        status = BLADERF_ERR_UNEXPECTED;
+        goto out;
+    }
+
+    status = rx_loop(p, r);
+    pthread_join(thread, NULL);
+
+    if (status == 0) {
+        status = p->tx_status;
+    }
+
+out:
+    bladerf_enable_module(p->dev, BLADERF_MODULE_RX, false);
+    bladerf_enable_module(p->dev, BLADERF_MODULE_TX, false);
+    return status;
+}
+
+int bw_probe_run(struct bladerf *dev,
+                 const struct bladerf_bandwidth_probe_config *config,
+                 struct bladerf_bandwidth_probe_results *results)
+{
+    int status;
+    bladerf_loopback prev_loopback;
+    struct bw_probe *p;
+
+    memset(results, 0, sizeof(results[0]));
+
+    status = check_config(config);
+    if (status != 0) {
+        return status;
+    }
+
+    p = (struct bw_probe *) calloc(1, sizeof(p[0]));
+    if (p == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    p->dev = dev;
+    p->config = config;
+    p->sc8 = config->format == BLADERF_FORMAT_SC8_Q7 ||
+             config->format == BLADERF_FORMAT_SC8_Q7_META;
+    p->meta = format_has_metadata(config->format);
+    p->block_bytes = (size_t) config->buffer_size * 2 * (p->sc8 ? 1 : 2);
+
+    p->tx_buf = calloc(1, p->block_bytes);
+    p->rx_buf = calloc(1, p->block_bytes);
+    if (p->tx_buf == NULL || p->rx_buf == NULL) {
+        status = BLADERF_ERR_MEM;
+        goto out;
+    }
+
+    status = bladerf_get_loopback(dev, &prev_loopback);
+    if (status != 0) {
+        goto out;
+    }
+
+    status = bladerf_set_loopback(dev, BLADERF_LB_FIRMWARE);
+    if (status != 0) {
+        goto out;
+    }
+
+    results->latency_min_us = UINT64_MAX;
+    status = run(p, results);
+
+    if (bladerf_set_loopback(dev, prev_loopback) != 0) {
+        log_warning("Failed to restore the previous loopback mode.\n");
+    }
+
+    if (status == 0 && results->elapsed_us == 0) {
+        status = BLADERF_ERR_UNEXPECTED;
+    }
+
+    if (status == 0) {
+        const uint64_t elapsed = results->elapsed_us;
+        const uint64_t samples = p->tx_samples < p->rx_samples ?
+                                    p->tx_samples : p->rx_samples;
+
+        results->tx_bytes = wire_bytes(p, p->tx_samples);
+        results->rx_bytes = wire_bytes(p, p->rx_samples);
+        results->tx_bytes_per_sec = results->tx_bytes * 1000000 / elapsed;
+        results->rx_bytes_per_sec = results->rx_bytes * 1000000 / elapsed;
+        results->samples_per_sec = samples * 1000000 / elapsed;
+    }
+
+    if (results->markers == 0) {
+        results->latency_min_us = 0;
+    }
+
+out:
+    free(p->tx_buf);
+    free(p->rx_buf);
+    free(p);
+    return status;
+}
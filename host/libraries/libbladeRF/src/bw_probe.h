@@ -0,0 +1,40 @@
+/**
+ * @file bw_probe.h
+ *
+ * @brief Measurement of the host/USB path's throughput and latency, via the
+ *        FX3's firmware loopback
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BLADERF_BW_PROBE_H_
+#define BLADERF_BW_PROBE_H_
+
+#include "libbladeRF.h"
+
+/**
+ * Run a bandwidth probe. The caller must not hold any of dev->ctrl_lock[].
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int bw_probe_run(struct bladerf *dev,
+                 const struct bladerf_bandwidth_probe_config *config,
+                 struct bladerf_bandwidth_probe_results *results);
+
+#endif
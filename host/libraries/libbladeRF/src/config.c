@@ -19,6 +19,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include "bladerf_priv.h"
 #include "dc_cal_table.h"
 #include "fpga.h"
@@ -46,12 +48,20 @@ static inline void load_dc_cal(struct bladerf *dev, const char *file)
     switch (img->type) {
         case BLADERF_IMAGE_TYPE_RX_DC_CAL:
             dc_cal_tbl_free(&dev->cal.dc_rx);
-            dev->cal.dc_rx = dc_cal_tbl_load(img->data, img->length);
+            dev->cal.dc_rx = dc_cal_tbl_load_in_place(img->data, img->length);
+            if (dev->cal.dc_rx != NULL) {
+                /* Now owned by the table */
+                img->data = NULL;
+            }
             break;
 
         case BLADERF_IMAGE_TYPE_TX_DC_CAL:
             dc_cal_tbl_free(&dev->cal.dc_tx);
-            dev->cal.dc_tx = dc_cal_tbl_load(img->data, img->length);
+            dev->cal.dc_tx = dc_cal_tbl_load_in_place(img->data, img->length);
+            if (dev->cal.dc_tx != NULL) {
+                /* Now owned by the table */
+                img->data = NULL;
+            }
             break;
 
         default:
@@ -117,3 +127,195 @@ int config_load_dc_cals(struct bladerf *dev)
     free(filename);
     return 0;
 }
+
+#ifdef ENABLE_LIBBLADERF_LMS_DC_CAL_CACHE
+
+/* Saved LMS DC calibration values older than this (in seconds) are ignored */
+#ifndef LMS_DC_CAL_CACHE_MAX_AGE
+#   define LMS_DC_CAL_CACHE_MAX_AGE (7 * 24 * 60 * 60)
+#endif
+
+#define LMS_DC_CAL_FILE_SUFFIX  "_lms_dc_cals.txt"
+#define LMS_DC_CAL_FILE_VERSION 1
+
+/* Number of fields in struct bladerf_lms_dc_cals */
+#define LMS_DC_CAL_NUM_FIELDS 10
+
+static const char *lms_dc_cal_field_names[LMS_DC_CAL_NUM_FIELDS] = {
+    "lpf_tuning", "tx_lpf_i", "tx_lpf_q", "rx_lpf_i", "rx_lpf_q",
+    "dc_ref", "rxvga2a_i", "rxvga2a_q", "rxvga2b_i", "rxvga2b_q",
+};
+
+static void lms_dc_cal_fields(struct bladerf_lms_dc_cals *cals,
+                              int16_t *fields[LMS_DC_CAL_NUM_FIELDS])
+{
+    fields[0] = &cals->lpf_tuning;
+    fields[1] = &cals->tx_lpf_i;
+    fields[2] = &cals->tx_lpf_q;
+    fields[3] = &cals->rx_lpf_i;
+    fields[4] = &cals->rx_lpf_q;
+    fields[5] = &cals->dc_ref;
+    fields[6] = &cals->rxvga2a_i;
+    fields[7] = &cals->rxvga2a_q;
+    fields[8] = &cals->rxvga2b_i;
+    fields[9] = &cals->rxvga2b_q;
+}
+
+static inline void lms_dc_cal_filename(struct bladerf *dev, char *filename,
+                                       size_t len)
+{
+    memset(filename, 0, len);
+    strncat(filename, dev->ident.serial, len - 1);
+    strncat(filename, LMS_DC_CAL_FILE_SUFFIX, len - 1 - strlen(filename));
+}
+
+int config_load_lms_dc_cals(struct bladerf *dev,
+                            struct bladerf_lms_dc_cals *cals)
+{
+    int status = BLADERF_ERR_NO_FILE;
+    char filename[BLADERF_SERIAL_LENGTH + sizeof(LMS_DC_CAL_FILE_SUFFIX)];
+    char line[81];
+    char *full_path;
+    FILE *f;
+    int16_t *fields[LMS_DC_CAL_NUM_FIELDS];
+    bool have_field[LMS_DC_CAL_NUM_FIELDS];
+    long version = -1;
+    long timestamp = -1;
+    size_t i;
+    time_t now;
+
+    lms_dc_cal_filename(dev, filename, sizeof(filename));
+    full_path = file_find(filename);
+    if (full_path == NULL) {
+        return BLADERF_ERR_NO_FILE;
+    }
+
+    f = fopen(full_path, "r");
+    if (f == NULL) {
+        log_debug("Failed to open %s\n", full_path);
+        free(full_path);
+        return BLADERF_ERR_IO;
+    }
+
+    lms_dc_cal_fields(cals, fields);
+    memset(have_field, 0, sizeof(have_field));
+
+    while (fgets(line, sizeof(line), f) != NULL) {
+        char name[32];
+        long value;
+
+        if (line[0] == '#' || sscanf(line, "%31[^=]=%ld", name, &value) != 2) {
+            continue;
+        }
+
+        if (!strcmp(name, "version")) {
+            version = value;
+        } else if (!strcmp(name, "timestamp")) {
+            timestamp = value;
+        } else {
+            for (i = 0; i < LMS_DC_CAL_NUM_FIELDS; i++) {
+                if (!strcmp(name, lms_dc_cal_field_names[i]) &&
+                    value >= -1 && value <= 0xff) {
+                    *fields[i] = (int16_t) value;
+                    have_field[i] = true;
+                }
+            }
+        }
+    }
+
+    fclose(f);
+
+    if (version != LMS_DC_CAL_FILE_VERSION) {
+        log_debug("%s: unsupported version (%ld)\n", full_path, version);
+        goto out;
+    }
+
+    for (i = 0; i < LMS_DC_CAL_NUM_FIELDS; i++) {
+        if (!have_field[i]) {
+            log_debug("%s: missing %s\n", full_path, lms_dc_cal_field_names[i]);
+            goto out;
+        }
+    }
+
+    now = time(NULL);
+    if (timestamp < 0 || now < (time_t) timestamp ||
+        (now - (time_t) timestamp) > LMS_DC_CAL_CACHE_MAX_AGE) {
+        log_debug("%s is stale; ignoring it.\n", full_path);
+        goto out;
+    }
+
+    log_debug("Loaded LMS DC calibration values from %s\n", full_path);
+    status = 0;
+
+out:
+    free(full_path);
+    return status;
+}
+
+int config_save_lms_dc_cals(struct bladerf *dev,
+                            const struct bladerf_lms_dc_cals *cals)
+{
+    int status = 0;
+    char filename[BLADERF_SERIAL_LENGTH + sizeof(LMS_DC_CAL_FILE_SUFFIX)];
+    struct bladerf_lms_dc_cals tmp = *cals;
+    int16_t *fields[LMS_DC_CAL_NUM_FIELDS];
+    char *full_path;
+    FILE *f;
+    size_t i;
+
+    lms_dc_cal_filename(dev, filename, sizeof(filename));
+    full_path = file_user_config_path(filename);
+    if (full_path == NULL) {
+        return BLADERF_ERR_IO;
+    }
+
+    f = fopen(full_path, "w");
+    if (f == NULL) {
+        log_debug("Failed to open %s for writing\n", full_path);
+        free(full_path);
+        return BLADERF_ERR_IO;
+    }
+
+    lms_dc_cal_fields(&tmp, fields);
+
+    if (fprintf(f, "# bladeRF LMS6002D DC calibration register values\n"
+                   "version=%d\ntimestamp=%ld\n",
+                LMS_DC_CAL_FILE_VERSION, (long) time(NULL)) < 0) {
+        status = BLADERF_ERR_IO;
+    }
+
+    for (i = 0; i < LMS_DC_CAL_NUM_FIELDS && status == 0; i++) {
+        if (fprintf(f, "%s=%d\n", lms_dc_cal_field_names[i], *fields[i]) < 0) {
+            status = BLADERF_ERR_IO;
+        }
+    }
+
+    if (fclose(f) != 0) {
+        status = BLADERF_ERR_IO;
+    }
+
+    if (status == 0) {
+        log_debug("Saved LMS DC calibration values to %s\n", full_path);
+    } else {
+        log_debug("Failed to write %s\n", full_path);
+    }
+
+    free(full_path);
+    return status;
+}
+
+#else
+
+int config_load_lms_dc_cals(struct bladerf *dev,
+                            struct bladerf_lms_dc_cals *cals)
+{
+    return BLADERF_ERR_UNSUPPORTED;
+}
+
+int config_save_lms_dc_cals(struct bladerf *dev,
+                            const struct bladerf_lms_dc_cals *cals)
+{
+    return BLADERF_ERR_UNSUPPORTED;
+}
+
+#endif
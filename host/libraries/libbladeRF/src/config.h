@@ -50,4 +50,37 @@ int config_load_dc_cals(struct bladerf *dev);
  */
 int config_load_fpga(struct bladerf *dev);
 
+/**
+ * Load the LMS DC calibration register values most recently saved for this
+ * device via config_save_lms_dc_cals().
+ *
+ * Values that are older than LMS_DC_CAL_CACHE_MAX_AGE seconds are considered
+ * stale and are not loaded, as the DC offsets drift with temperature and
+ * component aging.
+ *
+ * @param[in]   dev     Device handle
+ * @param[out]  cals    Populated with saved values on success
+ *
+ * @return  0 on success,
+ *          BLADERF_ERR_NO_FILE if no (fresh) values are available,
+ *          BLADERF_ERR_UNSUPPORTED if this support is not enabled,
+ *          BLADERF_ERR_* values on other failures
+ */
+int config_load_lms_dc_cals(struct bladerf *dev,
+                            struct bladerf_lms_dc_cals *cals);
+
+/**
+ * Save LMS DC calibration register values to the user's bladeRF configuration
+ * directory, keyed by the device's serial number.
+ *
+ * @param[in]   dev     Device handle
+ * @param[in]   cals    Values to save
+ *
+ * @return  0 on success,
+ *          BLADERF_ERR_UNSUPPORTED if this support is not enabled,
+ *          BLADERF_ERR_* values on other failures
+ */
+int config_save_lms_dc_cals(struct bladerf *dev,
+                            const struct bladerf_lms_dc_cals *cals);
+
 #endif
@@ -42,12 +42,39 @@
  *        [uint32_t: Frequency]
  *        [int16_t:  DC I correction value]
  *        [int16_t:  DC Q correction value]
+ *
+ * Version 2 tables carry a precomputed lookup index, and are laid out such
+ * that a table may be used directly from the buffer it is loaded into. In
+ * place of the start of table entries at 0x0018, they contain:
+ *
+ * 0x0018 [uint32_t: Index bucket size, in Hz]
+ * 0x001c [uint32_t: Number of index buckets]
+ * 0x0020 [Start of table entries, formatted as above and sorted by frequency]
+ *
+ * The table entries are followed by the index, which is an array of uint32_t
+ * values. Element n is the index of the entry in effect at
+ * (first entry frequency + n * bucket size).
+ *
+ * Version 3 tables add a gain axis, in order to account for DC offsets that
+ * vary with the gain of the stage following the DC correction (RXVGA2 for
+ * RX, TXVGA1 for TX). In place of the table entries at 0x0020, they contain:
+ *
+ * 0x0020 [uint32_t: Number of gains, G]
+ * 0x0024 [int32_t:  Strictly increasing gains, in dB, repeated G times]
+ * 0x0024 + 4G [Table entries]
+ *
+ * The table entries are G consecutive groups of "Number of entries" entries,
+ * one group per gain, in the order of the gains. Each group must contain the
+ * same frequencies. The index, which follows the entries, applies to all
+ * groups.
+ *
+ * Tables are stored within a bladeRF image, whose SHA256 checksum covers the
+ * table contents.
  */
 
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
-#include <float.h>
 
 #include "dc_cal_table.h"
 #include "host_config.h"
@@ -65,7 +92,16 @@
 
 #define DC_CAL_TBL_MAGIC        0x1ab1
 
+/* Frequency span (Hz) covered by each entry of a table's lookup index */
+#ifndef DC_CAL_TBL_BUCKET_SIZE
+#   define DC_CAL_TBL_BUCKET_SIZE 1000000
+#endif
+
+#define DC_CAL_TBL_VERSION      3
+
 #define DC_CAL_TBL_META_SIZE    0x18
+#define DC_CAL_TBL_V2_META_SIZE 0x20
+#define DC_CAL_TBL_V3_META_SIZE 0x24
 #define DC_CAL_TBL_ENTRY_SIZE   (sizeof(uint32_t) + 2 * sizeof(int16_t))
 #define DC_CAL_TBL_MIN_SIZE     (DC_CAL_TBL_META_SIZE + DC_CAL_TBL_ENTRY_SIZE)
 
@@ -119,11 +155,76 @@ static unsigned int find_entry(const struct dc_cal_tbl *tbl,
 }
 
 
+/* Constant-time lookup via the table's bucket index. Only entries within the
+ * frequency's bucket need to be stepped over. */
+static inline unsigned int bucket_lookup(const struct dc_cal_tbl *tbl,
+                                         unsigned int freq)
+{
+    unsigned int b, idx;
+
+    if (freq <= tbl->entries[0].freq) {
+        return 0;
+    }
+
+    b = (freq - tbl->entries[0].freq) / DC_CAL_TBL_BUCKET_SIZE;
+    if (b >= tbl->n_buckets) {
+        return tbl->n_entries - 1;
+    }
+
+    idx = tbl->bucket_idx[b];
+    while (idx < (tbl->n_entries - 1) && tbl->entries[idx + 1].freq <= freq) {
+        idx++;
+    }
+
+    return idx;
+}
+
+/* Build the bucket index used by bucket_lookup(). If the table is not
+ * sorted, no index is built and lookups fall back to find_entry(). */
+static void build_bucket_index(struct dc_cal_tbl *tbl)
+{
+    unsigned int b, idx, f_min, f_max;
+
+    tbl->bucket_idx = NULL;
+    tbl->n_buckets = 0;
+
+    for (idx = 1; idx < tbl->n_entries; idx++) {
+        if (tbl->entries[idx].freq < tbl->entries[idx - 1].freq) {
+            log_debug("DC cal table is not sorted; not indexing it.\n");
+            return;
+        }
+    }
+
+    f_min = tbl->entries[0].freq;
+    f_max = tbl->entries[tbl->n_entries - 1].freq;
+
+    tbl->n_buckets = (f_max - f_min) / DC_CAL_TBL_BUCKET_SIZE + 1;
+    tbl->bucket_idx = malloc(tbl->n_buckets * sizeof(tbl->bucket_idx[0]));
+    if (tbl->bucket_idx == NULL) {
+        tbl->n_buckets = 0;
+        return;
+    }
+
+    for (b = 0, idx = 0; b < tbl->n_buckets; b++) {
+        const unsigned int f = f_min + b * DC_CAL_TBL_BUCKET_SIZE;
+
+        while (idx < (tbl->n_entries - 1) && tbl->entries[idx + 1].freq <= f) {
+            idx++;
+        }
+
+        tbl->bucket_idx[b] = idx;
+    }
+}
+
 unsigned int dc_cal_tbl_lookup(const struct dc_cal_tbl *tbl, unsigned int freq)
 {
     unsigned int ret = 0;
     bool limit = false; /* Hit a limit before finding a match */
 
+    if (tbl->bucket_idx != NULL) {
+        return bucket_lookup(tbl, freq);
+    }
+
     /* First check if we're at a nearby change. This is generally the case
      * when the frequecy change */
     if (tbl->n_entries > SHORT_SEARCH) {
@@ -142,11 +243,107 @@ unsigned int dc_cal_tbl_lookup(const struct dc_cal_tbl *tbl, unsigned int freq)
     return find_entry(tbl, tbl->curr_idx, 0, tbl->n_entries - 1, freq, &limit);
 }
 
-struct dc_cal_tbl * dc_cal_tbl_load(uint8_t *buf, size_t buf_len)
+static inline uint32_t read_le32(const uint8_t *buf)
+{
+    uint32_t tmp;
+    memcpy(&tmp, buf, sizeof(tmp));
+    return LE32_TO_HOST(tmp);
+}
+
+/* Check that every gain plane covers the same, sorted, frequencies, and that
+ * the gain axis is strictly increasing */
+static bool axes_valid(const struct dc_cal_tbl *tbl)
+{
+    uint32_t i, g;
+
+    for (i = 1; i < tbl->n_entries; i++) {
+        if (tbl->entries[i].freq < tbl->entries[i - 1].freq) {
+            return false;
+        }
+    }
+
+    for (g = 1; g < tbl->n_gains; g++) {
+        const struct dc_cal_entry *plane = &tbl->entries[g * tbl->n_entries];
+
+        if (tbl->gains[g] <= tbl->gains[g - 1]) {
+            return false;
+        }
+
+        for (i = 0; i < tbl->n_entries; i++) {
+            if (plane[i].freq != tbl->entries[i].freq) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/* Use a version 2+ table's entries, gain axis, and index directly from the
+ * buffer it was loaded into. Returns false if this is not possible on this
+ * host. */
+static bool use_in_place(struct dc_cal_tbl *tbl, uint8_t *buf,
+                         size_t gains_off, size_t entries_off,
+                         uint32_t bucket_size, uint32_t n_buckets)
+{
+    uint32_t i;
+    const size_t index_off =
+        entries_off + DC_CAL_TBL_ENTRY_SIZE * tbl->n_entries * tbl->n_gains;
+
+    if (BLADERF_BIG_ENDIAN ||
+        sizeof(tbl->entries[0]) != DC_CAL_TBL_ENTRY_SIZE ||
+        sizeof(tbl->bucket_idx[0]) != sizeof(uint32_t) ||
+        sizeof(tbl->gains[0]) != sizeof(int32_t) ||
+        bucket_size != DC_CAL_TBL_BUCKET_SIZE ||
+        ((uintptr_t) buf % sizeof(uint32_t)) != 0) {
+        return false;
+    }
+
+    tbl->entries = (struct dc_cal_entry *) &buf[entries_off];
+    tbl->bucket_idx = (unsigned int *) &buf[index_off];
+    tbl->n_buckets = n_buckets;
+    tbl->gains = (gains_off != 0) ? (int *) &buf[gains_off] : NULL;
+
+    /* Don't trust the stored index to cover the table or stay within it */
+    if (!axes_valid(tbl)) {
+        goto invalid;
+    }
+
+    if (n_buckets != (tbl->entries[tbl->n_entries - 1].freq -
+                      tbl->entries[0].freq) / DC_CAL_TBL_BUCKET_SIZE + 1) {
+        goto invalid;
+    }
+
+    for (i = 0; i < n_buckets; i++) {
+        if (tbl->bucket_idx[i] >= tbl->n_entries) {
+            goto invalid;
+        }
+    }
+
+    return true;
+
+invalid:
+    log_debug("Invalid DC cal table index; rebuilding it.\n");
+    tbl->entries = NULL;
+    tbl->bucket_idx = NULL;
+    tbl->n_buckets = 0;
+    tbl->gains = NULL;
+    return false;
+}
+
+static struct dc_cal_tbl * load(uint8_t *buf, size_t buf_len, bool in_place)
 {
     struct dc_cal_tbl *ret;
     uint32_t i;
     uint16_t magic;
+    uint8_t *entries;
+    uint32_t bucket_size = 0;
+    uint32_t n_buckets = 0;
+    uint32_t n_gains = 1;
+    size_t gains_off = 0;
+    size_t entries_off = DC_CAL_TBL_META_SIZE;
+    size_t avail;
+    uint8_t *const buf_start = buf;
 
     if (buf_len < DC_CAL_TBL_MIN_SIZE) {
         return NULL;
@@ -159,34 +356,62 @@ struct dc_cal_tbl * dc_cal_tbl_load(uint8_t *buf, size_t buf_len)
     }
     buf += sizeof(magic);
 
-    ret = malloc(sizeof(ret[0]));
+    ret = calloc(1, sizeof(ret[0]));
     if (ret == NULL) {
         return NULL;
     }
 
     buf += sizeof(uint32_t); /* Skip reserved bytes */
 
-    memcpy(&ret->version, buf, sizeof(ret->version));
-    ret->version = LE32_TO_HOST(ret->version);
+    ret->version = read_le32(buf);
     buf += sizeof(ret->version);
 
-    memcpy(&ret->n_entries, buf, sizeof(ret->n_entries));
-    ret->n_entries = LE32_TO_HOST(ret->n_entries);
+    ret->n_entries = read_le32(buf);
     buf += sizeof(ret->n_entries);
 
-    if (buf_len <
-         (DC_CAL_TBL_META_SIZE + DC_CAL_TBL_ENTRY_SIZE * ret->n_entries) ) {
+    if (ret->version > DC_CAL_TBL_VERSION) {
+        log_debug("Unsupported DC cal table version: %u\n", ret->version);
+        goto error;
+    }
 
-        free(ret);
-        return NULL;
+    if (ret->version >= 2) {
+        if (buf_len < DC_CAL_TBL_V2_META_SIZE) {
+            goto error;
+        }
+
+        bucket_size = read_le32(&buf_start[DC_CAL_TBL_META_SIZE]);
+        n_buckets = read_le32(&buf_start[DC_CAL_TBL_META_SIZE + 4]);
+        entries_off = DC_CAL_TBL_V2_META_SIZE;
     }
 
-    ret->entries = malloc(sizeof(ret->entries[0]) * ret->n_entries);
-    if (ret->entries == NULL) {
-        free(ret);
-        return NULL;
+    if (ret->version >= 3) {
+        if (buf_len < DC_CAL_TBL_V3_META_SIZE) {
+            goto error;
+        }
+
+        n_gains = read_le32(&buf_start[DC_CAL_TBL_V2_META_SIZE]);
+        if (n_gains == 0 || n_gains > (buf_len - DC_CAL_TBL_V3_META_SIZE) /
+                                        sizeof(int32_t)) {
+            goto error;
+        }
+
+        gains_off = DC_CAL_TBL_V3_META_SIZE;
+        entries_off = gains_off + n_gains * sizeof(int32_t);
+    }
+
+    avail = buf_len - entries_off;
+    if (ret->n_entries == 0 ||
+        ret->n_entries > avail / DC_CAL_TBL_ENTRY_SIZE / n_gains) {
+        goto error;
+    }
+
+    avail -= (size_t) ret->n_entries * n_gains * DC_CAL_TBL_ENTRY_SIZE;
+    if (n_buckets > avail / sizeof(uint32_t)) {
+        goto error;
     }
 
+    ret->n_gains = n_gains;
+
     ret->reg_vals.lpf_tuning = *buf++;
     ret->reg_vals.tx_lpf_i = *buf++;
     ret->reg_vals.tx_lpf_q = *buf++;
@@ -199,22 +424,69 @@ struct dc_cal_tbl * dc_cal_tbl_load(uint8_t *buf, size_t buf_len)
     ret->reg_vals.rxvga2b_q = *buf++;
 
     ret->curr_idx = ret->n_entries / 2;
-    for (i = 0; i < ret->n_entries; i++) {
-        memcpy(&ret->entries[i].freq, buf, sizeof(uint32_t));
-        buf += sizeof(uint32_t);
 
-        memcpy(&ret->entries[i].dc_i, buf, sizeof(int16_t));
-        buf += sizeof(int16_t);
+    if (in_place && ret->version >= 2 &&
+        use_in_place(ret, buf_start, gains_off, entries_off,
+                     bucket_size, n_buckets)) {
+        ret->buf = buf_start;
+        return ret;
+    }
+
+    ret->entries = malloc(sizeof(ret->entries[0]) * ret->n_entries * n_gains);
+    if (ret->entries == NULL) {
+        goto error;
+    }
+
+    if (gains_off != 0) {
+        ret->gains = malloc(sizeof(ret->gains[0]) * n_gains);
+        if (ret->gains == NULL) {
+            goto error;
+        }
+
+        for (i = 0; i < n_gains; i++) {
+            ret->gains[i] = (int32_t) read_le32(&buf_start[gains_off + 4 * i]);
+        }
+    }
+
+    entries = &buf_start[entries_off];
+    for (i = 0; i < ret->n_entries * n_gains; i++) {
+        int16_t tmp;
+
+        ret->entries[i].freq = read_le32(entries);
+        entries += sizeof(uint32_t);
 
-        memcpy(&ret->entries[i].dc_q, buf, sizeof(int16_t));
-        buf += sizeof(int16_t);
+        memcpy(&tmp, entries, sizeof(int16_t));
+        ret->entries[i].dc_i = LE16_TO_HOST(tmp);
+        entries += sizeof(int16_t);
 
-        ret->entries[i].freq = LE32_TO_HOST(ret->entries[i].freq);
-        ret->entries[i].dc_i = LE32_TO_HOST(ret->entries[i].dc_i);
-        ret->entries[i].dc_q = LE32_TO_HOST(ret->entries[i].dc_q);
+        memcpy(&tmp, entries, sizeof(int16_t));
+        ret->entries[i].dc_q = LE16_TO_HOST(tmp);
+        entries += sizeof(int16_t);
     }
 
+    if (n_gains > 1 && !axes_valid(ret)) {
+        log_debug("DC cal table gain planes are inconsistent.\n");
+        goto error;
+    }
+
+    build_bucket_index(ret);
     return ret;
+
+error:
+    free(ret->entries);
+    free(ret->gains);
+    free(ret);
+    return NULL;
+}
+
+struct dc_cal_tbl * dc_cal_tbl_load(uint8_t *buf, size_t buf_len)
+{
+    return load(buf, buf_len, false);
+}
+
+struct dc_cal_tbl * dc_cal_tbl_load_in_place(uint8_t *buf, size_t buf_len)
+{
+    return load(buf, buf_len, true);
 }
 
 /* Interpolate a y value given two points and a desired x value
@@ -223,57 +495,101 @@ struct dc_cal_tbl * dc_cal_tbl_load(uint8_t *buf, size_t buf_len)
  *
  * Returns
  */
-static inline unsigned int interp(unsigned int x0, unsigned int y0,
-                           unsigned int x1, unsigned int y1,
-                           unsigned int x)
+static inline int interp(unsigned int x0, int y0,
+                         unsigned int x1, int y1,
+                         unsigned int x)
 {
     const float num = (float) y1 - y0;
     const float den = (float) x1 - x0;
-    const float m = den == 0 ? FLT_MAX : num / den;
-    const float y = (x - x0) * m + y0;
+    const float m = den == 0 ? 0 : num / den;
+    const float y = ((float) x - x0) * m + y0;
 
-    return (unsigned int) y;
+    return (int) y;
 }
 
-static inline void dc_cal_interp(const struct dc_cal_tbl *tbl,
+static inline void dc_cal_interp(const struct dc_cal_entry *entries,
                                  unsigned int idx_low,
                                  unsigned int idx_high,
                                  unsigned int freq,
                                  int16_t *dc_i, int16_t *dc_q)
 {
-    const unsigned int f_low = tbl->entries[idx_low].freq;
-    const unsigned int f_high = tbl->entries[idx_high].freq;
+    const unsigned int f_low = entries[idx_low].freq;
+    const unsigned int f_high = entries[idx_high].freq;
 
-    *dc_i = (int16_t) interp(f_low, tbl->entries[idx_low].dc_i,
-                             f_high, tbl->entries[idx_low].dc_i,
+    *dc_i = (int16_t) interp(f_low, entries[idx_low].dc_i,
+                             f_high, entries[idx_high].dc_i,
                              freq);
 
-    *dc_q = (int16_t) interp(f_low, tbl->entries[idx_low].dc_q,
-                             f_high, tbl->entries[idx_low].dc_q,
+    *dc_q = (int16_t) interp(f_low, entries[idx_low].dc_q,
+                             f_high, entries[idx_high].dc_q,
                              freq);
 }
 
+/* Values at the specified frequency, from a single gain plane. `idx` is the
+ * result of dc_cal_tbl_lookup(), which is shared by all planes. */
+static void plane_vals(const struct dc_cal_tbl *tbl, unsigned int plane,
+                       unsigned int idx, unsigned int freq,
+                       int16_t *dc_i, int16_t *dc_q)
+{
+    const struct dc_cal_entry *entries = &tbl->entries[plane * tbl->n_entries];
+
+    if (entries[idx].freq >= freq || idx == (tbl->n_entries - 1)) {
+        /* Exact match, or outside of the table's range. Extrapolating from
+         * the outermost entries could produce wildly inaccurate values, so
+         * the nearest entry is used instead. */
+        *dc_i = entries[idx].dc_i;
+        *dc_q = entries[idx].dc_q;
+    } else {
+        dc_cal_interp(entries, idx, idx + 1, freq, dc_i, dc_q);
+    }
+}
+
 void dc_cal_tbl_vals(const struct dc_cal_tbl *tbl, unsigned int freq,
-                     int16_t *dc_i, int16_t *dc_q)
+                     int gain, int16_t *dc_i, int16_t *dc_q)
 {
     const unsigned int idx = dc_cal_tbl_lookup(tbl, freq);
+    int16_t i_low, q_low, i_high, q_high;
+    unsigned int g;
+    unsigned int g_span;
 
-    if (tbl->entries[idx].freq == freq) {
-        /* Exact match */
-        *dc_i = tbl->entries[idx].dc_i;
-        *dc_q = tbl->entries[idx].dc_q;
+    if (tbl->n_gains <= 1 || gain <= tbl->gains[0]) {
+        plane_vals(tbl, 0, idx, freq, dc_i, dc_q);
+        return;
+    }
+
+    for (g = 1; g < (tbl->n_gains - 1) && tbl->gains[g] < gain; g++);
+
+    if (gain >= tbl->gains[g]) {
+        /* Beyond the highest gain in the table */
+        plane_vals(tbl, g, idx, freq, dc_i, dc_q);
         return;
-    } else if (idx == (tbl->n_entries - 1)) {
-        dc_cal_interp(tbl, idx - 1, idx, freq, dc_i, dc_q);
-    } else {
-        dc_cal_interp(tbl, idx, idx + 1, freq, dc_i, dc_q);
     }
+
+    plane_vals(tbl, g - 1, idx, freq, &i_low, &q_low);
+    plane_vals(tbl, g, idx, freq, &i_high, &q_high);
+
+    /* Gains may be negative, so interpolate over offsets from the lower
+     * plane's gain */
+    g_span = (unsigned int) (tbl->gains[g] - tbl->gains[g - 1]);
+
+    *dc_i = (int16_t) interp(0, i_low, g_span, i_high,
+                             (unsigned int) (gain - tbl->gains[g - 1]));
+
+    *dc_q = (int16_t) interp(0, q_low, g_span, q_high,
+                             (unsigned int) (gain - tbl->gains[g - 1]));
 }
 
 void dc_cal_tbl_free(struct dc_cal_tbl **tbl)
 {
     if (*tbl != NULL) {
-        free((*tbl)->entries);
+        if ((*tbl)->buf != NULL) {
+            free((*tbl)->buf);
+        } else {
+            free((*tbl)->entries);
+            free((*tbl)->bucket_idx);
+            free((*tbl)->gains);
+        }
+
         free(*tbl);
         *tbl = NULL;
     }
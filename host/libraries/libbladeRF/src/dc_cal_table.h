@@ -39,6 +39,22 @@ struct dc_cal_tbl {
 
     unsigned int curr_idx;
     struct dc_cal_entry *entries;  /* Sorted (increasing) by freq */
+
+    /* Index of the entry in effect at the start of each
+     * DC_CAL_TBL_BUCKET_SIZE Hz bucket, starting at entries[0].freq.
+     * NULL if no index has been built. */
+    unsigned int *bucket_idx;
+    unsigned int n_buckets;
+
+    /* Gains (dB) with which each group of n_entries entries is associated,
+     * when the table has more than one. The groups follow one another in
+     * `entries`, and each covers the same frequencies. */
+    int *gains;
+    unsigned int n_gains;
+
+    /* When non-NULL, `entries`, `bucket_idx`, and `gains` point into this
+     * buffer, which is owned by the table */
+    uint8_t *buf;
 };
 
 extern struct dc_cal_tbl rx_cal_test;
@@ -54,16 +70,19 @@ extern struct dc_cal_tbl rx_cal_test;
 unsigned int dc_cal_tbl_lookup(const struct dc_cal_tbl *tbl, unsigned int freq);
 
 /**
- * Get the DC cal values associated with the specified frequencies. If the
- * specified frequency is not in the table, the DC calibration values will
- * be interpolated from surrounding entries.
+ * Get the DC cal values associated with the specified frequency and gain. If
+ * the specified frequency or gain is not in the table, the DC calibration
+ * values will be interpolated from surrounding entries.
  *
  * @param[in]  tbl      Table to search
  * @param[in]  freq     Desired frequency
- * @param[out] vals     Found or interpolated DC calibration values
+ * @param[in]  gain     Gain (dB) of the stage the table's gain axis
+ *                      describes. Ignored if the table has no gain axis.
+ * @param[out] dc_i     Found or interpolated DC I calibration value
+ * @param[out] dc_q     Found or interpolated DC Q calibration value
  */
 void dc_cal_tbl_vals(const struct dc_cal_tbl *tbl, unsigned int freq,
-                     int16_t *dc_i, int16_t *dc_q);
+                     int gain, int16_t *dc_i, int16_t *dc_q);
 
 /**
  * Load a DC calibration table from the provided data
@@ -75,6 +94,21 @@ void dc_cal_tbl_vals(const struct dc_cal_tbl *tbl, unsigned int freq,
  */
 struct dc_cal_tbl * dc_cal_tbl_load(uint8_t *buf, size_t buf_len);
 
+/**
+ * Load a DC calibration table, using its contents directly from the provided
+ * buffer when possible.
+ *
+ * On success, the table takes ownership of `buf`, which must have been
+ * allocated with malloc() and must not be accessed by the caller afterwards.
+ * On failure, the caller retains ownership of `buf`.
+ *
+ * @param   buf   Packed table data
+ * @param   len   Length of packed data, in bytes
+ *
+ * @return Loaded table
+ */
+struct dc_cal_tbl * dc_cal_tbl_load_in_place(uint8_t *buf, size_t buf_len);
+
 /**
  * Free a DC calibration table
  *
@@ -0,0 +1,1235 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2014 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "log.h"
+#include "dsp.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define DSP_SSE2 1
+#   include <emmintrin.h>
+#else
+#   define DSP_SSE2 0
+#endif
+
+/* AVX2 versions of the sample format conversions are compiled in via
+ * function attributes, and used if AVX2 is available at runtime */
+#if DSP_SSE2 && ((defined(__GNUC__) && __GNUC__ >= 5) || defined(__clang__))
+#   define DSP_AVX2 1
+#   include <immintrin.h>
+#else
+#   define DSP_AVX2 0
+#endif
+
+#if !DSP_SSE2 && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#   define DSP_NEON 1
+#   include <arm_neon.h>
+#else
+#   define DSP_NEON 0
+#endif
+
+#ifndef M_PI
+#   define M_PI 3.14159265358979323846
+#endif
+
+#define SAMPLE_MAX  2047
+#define SAMPLE_MIN  (-2048)
+
+/* Gain is applied as a Q3.12 multiplier */
+#define GAIN_SHIFT  12
+
+/* FIR taps are Q15 */
+#define FIR_SHIFT   15
+
+static inline int16_t saturate(int32_t x)
+{
+    if (x > SAMPLE_MAX) {
+        return SAMPLE_MAX;
+    } else if (x < SAMPLE_MIN) {
+        return SAMPLE_MIN;
+    } else {
+        return (int16_t) x;
+    }
+}
+
+static inline float saturate_f(float x)
+{
+    if (x > (float) SAMPLE_MAX) {
+        return (float) SAMPLE_MAX;
+    } else if (x < (float) SAMPLE_MIN) {
+        return (float) SAMPLE_MIN;
+    } else {
+        return x;
+    }
+}
+
+/******************************************************************************
+ * Gain
+ ******************************************************************************/
+
+struct dsp_gain {
+    int16_t gain;
+};
+
+static void gain_generic(int16_t *s, unsigned int n, int16_t gain)
+{
+    const int32_t round = 1 << (GAIN_SHIFT - 1);
+    unsigned int k;
+
+    for (k = 0; k < 2 * n; k++) {
+        s[k] = saturate((s[k] * gain + round) >> GAIN_SHIFT);
+    }
+}
+
+static void gain_process(int16_t *s, unsigned int n, void *user_data)
+{
+    const int16_t gain = ((struct dsp_gain *) user_data)->gain;
+    unsigned int k = 0;
+
+#if DSP_SSE2
+    const __m128i g = _mm_set1_epi16(gain);
+    const __m128i round = _mm_set1_epi32(1 << (GAIN_SHIFT - 1));
+    const __m128i max = _mm_set1_epi16(SAMPLE_MAX);
+    const __m128i min = _mm_set1_epi16(SAMPLE_MIN);
+
+    for (; k + 4 <= n; k += 4) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) &s[2 * k]);
+        const __m128i lo = _mm_mullo_epi16(v, g);
+        const __m128i hi = _mm_mulhi_epi16(v, g);
+
+        __m128i p0 = _mm_unpacklo_epi16(lo, hi);
+        __m128i p1 = _mm_unpackhi_epi16(lo, hi);
+        __m128i out;
+
+        p0 = _mm_srai_epi32(_mm_add_epi32(p0, round), GAIN_SHIFT);
+        p1 = _mm_srai_epi32(_mm_add_epi32(p1, round), GAIN_SHIFT);
+
+        out = _mm_packs_epi32(p0, p1);
+        out = _mm_min_epi16(_mm_max_epi16(out, min), max);
+        _mm_storeu_si128((__m128i *) &s[2 * k], out);
+    }
+#elif DSP_NEON
+    const int16x8_t max = vdupq_n_s16(SAMPLE_MAX);
+    const int16x8_t min = vdupq_n_s16(SAMPLE_MIN);
+
+    for (; k + 4 <= n; k += 4) {
+        const int16x8_t v = vld1q_s16(&s[2 * k]);
+        const int32x4_t p0 = vmull_n_s16(vget_low_s16(v), gain);
+        const int32x4_t p1 = vmull_n_s16(vget_high_s16(v), gain);
+
+        int16x8_t out = vcombine_s16(vqmovn_s32(vrshrq_n_s32(p0, GAIN_SHIFT)),
+                                     vqmovn_s32(vrshrq_n_s32(p1, GAIN_SHIFT)));
+
+        out = vminq_s16(vmaxq_s16(out, min), max);
+        vst1q_s16(&s[2 * k], out);
+    }
+#endif
+
+    gain_generic(&s[2 * k], n - k, gain);
+}
+
+int dsp_gain_init(struct bladerf_repeater_stage *stage, float gain)
+{
+    struct dsp_gain *g;
+    const long q = lroundf(gain * (1 << GAIN_SHIFT));
+
+    if (!(gain >= 0.0f) || q > INT16_MAX) {
+        log_debug("%s: Gain must be within [0, 8)\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    g = calloc(1, sizeof(*g));
+    if (g == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    g->gain = (int16_t) q;
+
+    stage->name = "gain";
+    stage->process = gain_process;
+    stage->user_data = g;
+    return 0;
+}
+
+/******************************************************************************
+ * FIR filter
+ ******************************************************************************/
+
+struct dsp_fir {
+    unsigned int num_taps;
+    int16_t taps[DSP_FIR_MAX_TAPS];
+
+    /* 16-bit lane pairs of (tap, 0) and (0, tap), selecting the I and Q
+     * values of SC16 Q11 samples when used with _mm_madd_epi16() */
+    int32_t sel_i[DSP_FIR_MAX_TAPS];
+    int32_t sel_q[DSP_FIR_MAX_TAPS];
+
+    /* The final (num_taps - 1) samples of the previous block, followed by
+     * the current block */
+    int16_t scratch[2 * (DSP_FIR_MAX_TAPS - 1 + DSP_FIR_BLOCK_LEN)];
+};
+
+/* Filter n samples from `in`, which is preceded by (num_taps - 1) samples
+ * of history, into `out` */
+static void fir_generic(const struct dsp_fir *f, const int16_t *in,
+                        int16_t *out, unsigned int n)
+{
+    const int32_t round = 1 << (FIR_SHIFT - 1);
+    unsigned int k, t;
+
+    for (k = 0; k < n; k++) {
+        int32_t acc_i = round, acc_q = round;
+
+        for (t = 0; t < f->num_taps; t++) {
+            const int16_t *x = &in[2 * ((int) k - (int) t)];
+            acc_i += f->taps[t] * x[0];
+            acc_q += f->taps[t] * x[1];
+        }
+
+        out[2 * k]     = saturate(acc_i >> FIR_SHIFT);
+        out[2 * k + 1] = saturate(acc_q >> FIR_SHIFT);
+    }
+}
+
+static void fir_block(const struct dsp_fir *f, const int16_t *in,
+                      int16_t *out, unsigned int n)
+{
+    unsigned int k = 0;
+
+#if DSP_SSE2
+    const __m128i round = _mm_set1_epi32(1 << (FIR_SHIFT - 1));
+    const __m128i max = _mm_set1_epi16(SAMPLE_MAX);
+    const __m128i min = _mm_set1_epi16(SAMPLE_MIN);
+    unsigned int t;
+
+    for (; k + 4 <= n; k += 4) {
+        __m128i acc_i = round, acc_q = round, i16, q16;
+
+        for (t = 0; t < f->num_taps; t++) {
+            const __m128i x = _mm_loadu_si128(
+                                (const __m128i *) &in[2 * ((int) k - (int) t)]);
+
+            acc_i = _mm_add_epi32(acc_i,
+                        _mm_madd_epi16(x, _mm_set1_epi32(f->sel_i[t])));
+            acc_q = _mm_add_epi32(acc_q,
+                        _mm_madd_epi16(x, _mm_set1_epi32(f->sel_q[t])));
+        }
+
+        acc_i = _mm_srai_epi32(acc_i, FIR_SHIFT);
+        acc_q = _mm_srai_epi32(acc_q, FIR_SHIFT);
+
+        i16 = _mm_packs_epi32(acc_i, acc_i);
+        q16 = _mm_packs_epi32(acc_q, acc_q);
+
+        i16 = _mm_min_epi16(_mm_max_epi16(i16, min), max);
+        q16 = _mm_min_epi16(_mm_max_epi16(q16, min), max);
+
+        _mm_storeu_si128((__m128i *) &out[2 * k], _mm_unpacklo_epi16(i16, q16));
+    }
+#elif DSP_NEON
+    const int16x4_t max = vdup_n_s16(SAMPLE_MAX);
+    const int16x4_t min = vdup_n_s16(SAMPLE_MIN);
+    unsigned int t;
+
+    for (; k + 4 <= n; k += 4) {
+        int32x4_t acc_i = vdupq_n_s32(0), acc_q = vdupq_n_s32(0);
+        int16x4x2_t result;
+
+        for (t = 0; t < f->num_taps; t++) {
+            const int16x4x2_t x = vld2_s16(&in[2 * ((int) k - (int) t)]);
+            acc_i = vmlal_n_s16(acc_i, x.val[0], f->taps[t]);
+            acc_q = vmlal_n_s16(acc_q, x.val[1], f->taps[t]);
+        }
+
+        result.val[0] = vqmovn_s32(vrshrq_n_s32(acc_i, FIR_SHIFT));
+        result.val[1] = vqmovn_s32(vrshrq_n_s32(acc_q, FIR_SHIFT));
+
+        result.val[0] = vmin_s16(vmax_s16(result.val[0], min), max);
+        result.val[1] = vmin_s16(vmax_s16(result.val[1], min), max);
+
+        vst2_s16(&out[2 * k], result);
+    }
+#endif
+
+    fir_generic(f, &in[2 * k], &out[2 * k], n - k);
+}
+
+static void fir_process(int16_t *s, unsigned int n, void *user_data)
+{
+    struct dsp_fir *f = (struct dsp_fir *) user_data;
+    const unsigned int history = f->num_taps - 1;
+    int16_t *block = &f->scratch[2 * history];
+
+    while (n != 0) {
+        const unsigned int len = n < DSP_FIR_BLOCK_LEN ? n : DSP_FIR_BLOCK_LEN;
+
+        /* The input must remain intact while it is filtered in place */
+        memcpy(block, s, 2 * sizeof(s[0]) * len);
+        fir_block(f, block, s, len);
+
+        /* Retain the final `history` samples, which may include some of
+         * the previous history if this block is shorter than it */
+        memmove(f->scratch, &f->scratch[2 * len], 2 * sizeof(s[0]) * history);
+
+        s += 2 * len;
+        n -= len;
+    }
+}
+
+int dsp_fir_init(struct bladerf_repeater_stage *stage,
+                 const float *taps, unsigned int num_taps)
+{
+    struct dsp_fir *f;
+    long sum = 0;
+    unsigned int t;
+
+    if (taps == NULL || num_taps == 0 || num_taps > DSP_FIR_MAX_TAPS) {
+        log_debug("%s: # taps must be within [1, %u]\n",
+                  __FUNCTION__, DSP_FIR_MAX_TAPS);
+        return BLADERF_ERR_INVAL;
+    }
+
+    f = calloc(1, sizeof(*f));
+    if (f == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    f->num_taps = num_taps;
+
+    for (t = 0; t < num_taps; t++) {
+        const long q = lroundf(taps[t] * (1 << FIR_SHIFT));
+
+        if (!(q > INT16_MIN && q <= INT16_MAX)) {
+            log_debug("%s: Tap %u is not within (-1, 1)\n", __FUNCTION__, t);
+            free(f);
+            return BLADERF_ERR_INVAL;
+        }
+
+        f->taps[t] = (int16_t) q;
+        f->sel_i[t] = (int32_t) (uint16_t) q;
+        f->sel_q[t] = (int32_t) ((uint32_t) (uint16_t) q << 16);
+        sum += labs(q);
+    }
+
+    /* Ensures the 32-bit accumulators cannot overflow */
+    if (sum >= (16L << FIR_SHIFT)) {
+        log_debug("%s: Sum of tap magnitudes must be less than 16\n",
+                  __FUNCTION__);
+        free(f);
+        return BLADERF_ERR_INVAL;
+    }
+
+    stage->name = "fir";
+    stage->process = fir_process;
+    stage->user_data = f;
+    return 0;
+}
+
+/******************************************************************************
+ * NCO mixer
+ ******************************************************************************/
+
+/* Samples processed per vector, each with its own lane of the rotator */
+#define NCO_LANES   4
+
+struct dsp_nco {
+    double frequency;       /* Cycles per sample */
+    double phase;           /* Phase of the next sample, in cycles */
+};
+
+/* Mix n samples, where the sample at index k is rotated by
+ * (re[k % NCO_LANES], im[k % NCO_LANES]), and each lane is rotated by
+ * (step_re, step_im) after every NCO_LANES samples */
+static void nco_generic(int16_t *s, unsigned int n, float *re, float *im,
+                        float step_re, float step_im)
+{
+    unsigned int k, l;
+
+    for (k = 0; k < n; k += NCO_LANES) {
+        for (l = 0; l < NCO_LANES && k + l < n; l++) {
+            const float i = s[2 * (k + l)];
+            const float q = s[2 * (k + l) + 1];
+            const float r = re[l] * step_re - im[l] * step_im;
+
+            s[2 * (k + l)]     = (int16_t) lrintf(saturate_f(i * re[l] -
+                                                             q * im[l]));
+            s[2 * (k + l) + 1] = (int16_t) lrintf(saturate_f(i * im[l] +
+                                                             q * re[l]));
+
+            im[l] = re[l] * step_im + im[l] * step_re;
+            re[l] = r;
+        }
+    }
+}
+
+static void nco_process(int16_t *s, unsigned int n, void *user_data)
+{
+    struct dsp_nco *nco = (struct dsp_nco *) user_data;
+    const double step = 2 * M_PI * nco->frequency * NCO_LANES;
+    const float step_re = (float) cos(step);
+    const float step_im = (float) sin(step);
+    float re[NCO_LANES], im[NCO_LANES];
+    unsigned int k = 0, l;
+
+    /* The rotator is re-derived from the exact phase for each call, so
+     * rounding errors do not accumulate */
+    for (l = 0; l < NCO_LANES; l++) {
+        const double phase = 2 * M_PI * (nco->phase + l * nco->frequency);
+        re[l] = (float) cos(phase);
+        im[l] = (float) sin(phase);
+    }
+
+#if DSP_SSE2
+    {
+        __m128 vre = _mm_loadu_ps(re), vim = _mm_loadu_ps(im);
+        const __m128 sre = _mm_set1_ps(step_re), sim = _mm_set1_ps(step_im);
+        const __m128 max = _mm_set1_ps((float) SAMPLE_MAX);
+        const __m128 min = _mm_set1_ps((float) SAMPLE_MIN);
+        const __m128i mask_i = _mm_set1_epi32(0x0000ffff);
+
+        for (; k + NCO_LANES <= n; k += NCO_LANES) {
+            const __m128i v = _mm_loadu_si128((const __m128i *) &s[2 * k]);
+            const __m128 i = _mm_cvtepi32_ps(
+                                _mm_srai_epi32(_mm_slli_epi32(v, 16), 16));
+            const __m128 q = _mm_cvtepi32_ps(_mm_srai_epi32(v, 16));
+            __m128 oi, oq, r;
+
+            oi = _mm_sub_ps(_mm_mul_ps(i, vre), _mm_mul_ps(q, vim));
+            oq = _mm_add_ps(_mm_mul_ps(i, vim), _mm_mul_ps(q, vre));
+            oi = _mm_min_ps(_mm_max_ps(oi, min), max);
+            oq = _mm_min_ps(_mm_max_ps(oq, min), max);
+
+            _mm_storeu_si128((__m128i *) &s[2 * k],
+                _mm_or_si128(_mm_and_si128(_mm_cvtps_epi32(oi), mask_i),
+                             _mm_slli_epi32(_mm_cvtps_epi32(oq), 16)));
+
+            r = _mm_sub_ps(_mm_mul_ps(vre, sre), _mm_mul_ps(vim, sim));
+            vim = _mm_add_ps(_mm_mul_ps(vre, sim), _mm_mul_ps(vim, sre));
+            vre = r;
+        }
+
+        _mm_storeu_ps(re, vre);
+        _mm_storeu_ps(im, vim);
+    }
+#elif DSP_NEON
+    {
+        float32x4_t vre = vld1q_f32(re), vim = vld1q_f32(im);
+        const float32x4_t max = vdupq_n_f32((float) SAMPLE_MAX);
+        const float32x4_t min = vdupq_n_f32((float) SAMPLE_MIN);
+
+        for (; k + NCO_LANES <= n; k += NCO_LANES) {
+            const int16x4x2_t v = vld2_s16(&s[2 * k]);
+            const float32x4_t i = vcvtq_f32_s32(vmovl_s16(v.val[0]));
+            const float32x4_t q = vcvtq_f32_s32(vmovl_s16(v.val[1]));
+            float32x4_t oi, oq, r;
+            int16x4x2_t out;
+
+            oi = vmlsq_f32(vmulq_f32(i, vre), q, vim);
+            oq = vmlaq_f32(vmulq_f32(i, vim), q, vre);
+            oi = vminq_f32(vmaxq_f32(oi, min), max);
+            oq = vminq_f32(vmaxq_f32(oq, min), max);
+
+#if defined(__aarch64__)
+            out.val[0] = vmovn_s32(vcvtnq_s32_f32(oi));
+            out.val[1] = vmovn_s32(vcvtnq_s32_f32(oq));
+#else
+            /* Round half to even, as lrintf() does. vcvtq_s32_f32()
+             * truncates, but NEON arithmetic always rounds to nearest even,
+             * so adding and removing 1.5 * 2^23 leaves the value rounded to
+             * an integer. The samples are saturated well within range. */
+            {
+                const float32x4_t magic = vdupq_n_f32(12582912.0f);
+                const float32x4_t ri = vsubq_f32(vaddq_f32(oi, magic), magic);
+                const float32x4_t rq = vsubq_f32(vaddq_f32(oq, magic), magic);
+
+                out.val[0] = vmovn_s32(vcvtq_s32_f32(ri));
+                out.val[1] = vmovn_s32(vcvtq_s32_f32(rq));
+            }
+#endif
+            vst2_s16(&s[2 * k], out);
+
+            r = vmlsq_n_f32(vmulq_n_f32(vre, step_re), vim, step_im);
+            vim = vmlaq_n_f32(vmulq_n_f32(vre, step_im), vim, step_re);
+            vre = r;
+        }
+
+        vst1q_f32(re, vre);
+        vst1q_f32(im, vim);
+    }
+#endif
+
+    nco_generic(&s[2 * k], n - k, re, im, step_re, step_im);
+
+    nco->phase += nco->frequency * n;
+    nco->phase -= floor(nco->phase);
+}
+
+int dsp_nco_init(struct bladerf_repeater_stage *stage, double frequency)
+{
+    struct dsp_nco *nco;
+
+    if (!(frequency >= -0.5 && frequency <= 0.5)) {
+        log_debug("%s: Frequency must be within [-0.5, 0.5] cycles/sample\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    nco = calloc(1, sizeof(*nco));
+    if (nco == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    nco->frequency = frequency;
+    nco->phase = 0.0;
+
+    stage->name = "nco";
+    stage->process = nco_process;
+    stage->user_data = nco;
+    return 0;
+}
+
+/******************************************************************************
+ * Packed sample conversion
+ ******************************************************************************/
+
+/* Each packed sample is a little endian 24-bit value, with I in its lower 12
+ * bits and Q in its upper 12 bits */
+
+static void unpack_generic(int16_t *dst, const uint8_t *src, unsigned int n)
+{
+    unsigned int k;
+
+    for (k = 0; k < n; k++) {
+        const int32_t v = src[3 * k] | (src[3 * k + 1] << 8) |
+                          (src[3 * k + 2] << 16);
+
+        dst[2 * k]     = (int16_t) (((v & 0xfff) ^ 0x800) - 0x800);
+        dst[2 * k + 1] = (int16_t) ((((v >> 12) & 0xfff) ^ 0x800) - 0x800);
+    }
+}
+
+static void pack_generic(uint8_t *dst, const int16_t *src, unsigned int n)
+{
+    unsigned int k;
+
+    for (k = 0; k < n; k++) {
+        const uint32_t v = ((uint16_t) src[2 * k] & 0xfff) |
+                           (((uint16_t) src[2 * k + 1] & 0xfff) << 12);
+
+        dst[3 * k]     = (uint8_t) v;
+        dst[3 * k + 1] = (uint8_t) (v >> 8);
+        dst[3 * k + 2] = (uint8_t) (v >> 16);
+    }
+}
+
+void dsp_unpack_sc16_q11(int16_t *dst, const uint8_t *src, unsigned int n)
+{
+    unsigned int k = 0;
+
+#if DSP_SSE2
+    const __m128i mask = _mm_set1_epi32(0xffff);
+
+    /* Each iteration loads 16 bytes but consumes 12, so stop short of the
+     * end of the input */
+    for (; k + 6 <= n; k += 4) {
+        const __m128i v = _mm_loadu_si128((const __m128i *) &src[3 * k]);
+
+        /* Move sample j's 24 bits into 32-bit lane j */
+        const __m128i s01 = _mm_unpacklo_epi32(v, _mm_srli_si128(v, 3));
+        const __m128i s23 = _mm_unpacklo_epi32(_mm_srli_si128(v, 6),
+                                               _mm_srli_si128(v, 9));
+        const __m128i s = _mm_unpacklo_epi64(s01, s23);
+
+        /* Sign extend each component from 12 bits */
+        const __m128i i = _mm_srai_epi32(_mm_slli_epi32(s, 20), 20);
+        const __m128i q = _mm_srai_epi32(_mm_slli_epi32(s, 8), 20);
+
+        _mm_storeu_si128((__m128i *) &dst[2 * k],
+                         _mm_or_si128(_mm_and_si128(i, mask),
+                                      _mm_slli_epi32(q, 16)));
+    }
+#elif DSP_NEON
+    for (; k + 16 <= n; k += 16) {
+        /* Byte j of each sample lands in b.val[j] */
+        const uint8x16x3_t b = vld3q_u8(&src[3 * k]);
+        int k2;
+
+        for (k2 = 0; k2 < 2; k2++) {
+            const uint8x8_t b0 = k2 ? vget_high_u8(b.val[0]) : vget_low_u8(b.val[0]);
+            const uint8x8_t b1 = k2 ? vget_high_u8(b.val[1]) : vget_low_u8(b.val[1]);
+            const uint8x8_t b2 = k2 ? vget_high_u8(b.val[2]) : vget_low_u8(b.val[2]);
+            const uint16x8_t w1 = vmovl_u8(b1);
+            int16x8x2_t out;
+
+            /* Place each 12-bit component in the top of a 16-bit lane, and
+             * shift it back down to sign extend it */
+            const uint16x8_t i = vorrq_u16(vshlq_n_u16(vmovl_u8(b0), 4),
+                                           vshlq_n_u16(w1, 12));
+            const uint16x8_t q = vorrq_u16(vshlq_n_u16(vshrq_n_u16(w1, 4), 4),
+                                           vshlq_n_u16(vmovl_u8(b2), 8));
+
+            out.val[0] = vshrq_n_s16(vreinterpretq_s16_u16(i), 4);
+            out.val[1] = vshrq_n_s16(vreinterpretq_s16_u16(q), 4);
+            vst2q_s16(&dst[2 * (k + 8 * k2)], out);
+        }
+    }
+#endif
+
+    unpack_generic(&dst[2 * k], &src[3 * k], n - k);
+}
+
+void dsp_pack_sc16_q11(uint8_t *dst, const int16_t *src, unsigned int n)
+{
+    unsigned int k = 0;
+
+#if DSP_NEON
+    const uint16x8_t mask = vdupq_n_u16(0xfff);
+
+    for (; k + 8 <= n; k += 8) {
+        const int16x8x2_t v = vld2q_s16(&src[2 * k]);
+        const uint16x8_t i = vandq_u16(vreinterpretq_u16_s16(v.val[0]), mask);
+        const uint16x8_t q = vandq_u16(vreinterpretq_u16_s16(v.val[1]), mask);
+        uint8x8x3_t out;
+
+        out.val[0] = vmovn_u16(i);
+        out.val[1] = vmovn_u16(vorrq_u16(vshrq_n_u16(i, 8),
+                                         vshlq_n_u16(q, 4)));
+        out.val[2] = vmovn_u16(vshrq_n_u16(q, 4));
+        vst3_u8(&dst[3 * k], out);
+    }
+#endif
+
+    pack_generic(&dst[3 * k], &src[2 * k], n - k);
+}
+
+/******************************************************************************
+ * Floating point sample conversion
+ ******************************************************************************/
+
+/* Full scale SC16 Q11 values map to [-1.0, 1.0) */
+#define CF32_SCALE      2048.0f
+
+static void to_cf32_generic(float *dst, const int16_t *src, unsigned int n)
+{
+    const float scale = 1.0f / CF32_SCALE;
+    unsigned int k;
+
+    for (k = 0; k < 2 * n; k++) {
+        dst[k] = src[k] * scale;
+    }
+}
+
+static void from_cf32_generic(int16_t *dst, const float *src, unsigned int n)
+{
+    unsigned int k;
+
+    for (k = 0; k < 2 * n; k++) {
+        /* Ordered so that NaNs saturate high, as with the SIMD versions */
+        float x = src[k] * CF32_SCALE;
+        x = x < (float) SAMPLE_MAX ? x : (float) SAMPLE_MAX;
+        x = x > (float) SAMPLE_MIN ? x : (float) SAMPLE_MIN;
+        dst[k] = (int16_t) lrintf(x);
+    }
+}
+
+#if DSP_AVX2
+__attribute__((target("avx2")))
+static unsigned int to_cf32_avx2(float *dst, const int16_t *src,
+                                 unsigned int n)
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / CF32_SCALE);
+    unsigned int k;
+
+    for (k = 0; k + 4 <= n; k += 4) {
+        const __m256i v = _mm256_cvtepi16_epi32(
+                            _mm_loadu_si128((const __m128i *) &src[2 * k]));
+
+        _mm256_storeu_ps(&dst[2 * k],
+                         _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+
+    return k;
+}
+
+__attribute__((target("avx2")))
+static unsigned int from_cf32_avx2(int16_t *dst, const float *src,
+                                   unsigned int n)
+{
+    const __m256 scale = _mm256_set1_ps(CF32_SCALE);
+    const __m256 hi = _mm256_set1_ps((float) SAMPLE_MAX);
+    const __m256 lo = _mm256_set1_ps((float) SAMPLE_MIN);
+    unsigned int k;
+
+    for (k = 0; k + 8 <= n; k += 8) {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(&src[2 * k]), scale);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(&src[2 * k + 8]), scale);
+        __m256i v;
+
+        a = _mm256_max_ps(_mm256_min_ps(a, hi), lo);
+        b = _mm256_max_ps(_mm256_min_ps(b, hi), lo);
+
+        /* The pack operates within 128-bit lanes, so restore the order */
+        v = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        v = _mm256_permute4x64_epi64(v, 0xd8);
+
+        _mm256_storeu_si256((__m256i *) &dst[2 * k], v);
+    }
+
+    return k;
+}
+#endif
+
+void dsp_sc16_q11_to_cf32(float *dst, const int16_t *src, unsigned int n)
+{
+    unsigned int k = 0;
+
+#if DSP_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        k = to_cf32_avx2(dst, src, n);
+    } else
+#endif
+    {
+#if DSP_SSE2
+        const __m128 scale = _mm_set1_ps(1.0f / CF32_SCALE);
+
+        for (; k + 4 <= n; k += 4) {
+            const __m128i v = _mm_loadu_si128((const __m128i *) &src[2 * k]);
+
+            /* Sign extend each component into a 32-bit lane */
+            const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+            const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+            _mm_storeu_ps(&dst[2 * k],
+                          _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+            _mm_storeu_ps(&dst[2 * k + 4],
+                          _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+        }
+#elif DSP_NEON
+        const float32x4_t scale = vdupq_n_f32(1.0f / CF32_SCALE);
+
+        for (; k + 4 <= n; k += 4) {
+            const int16x8_t v = vld1q_s16(&src[2 * k]);
+
+            vst1q_f32(&dst[2 * k],
+                      vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))),
+                                scale));
+            vst1q_f32(&dst[2 * k + 4],
+                      vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))),
+                                scale));
+        }
+#endif
+    }
+
+    to_cf32_generic(&dst[2 * k], &src[2 * k], n - k);
+}
+
+void dsp_cf32_to_sc16_q11(int16_t *dst, const float *src, unsigned int n)
+{
+    unsigned int k = 0;
+
+#if DSP_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        k = from_cf32_avx2(dst, src, n);
+    } else
+#endif
+    {
+#if DSP_SSE2
+        const __m128 scale = _mm_set1_ps(CF32_SCALE);
+        const __m128 hi = _mm_set1_ps((float) SAMPLE_MAX);
+        const __m128 lo = _mm_set1_ps((float) SAMPLE_MIN);
+
+        for (; k + 4 <= n; k += 4) {
+            __m128 a = _mm_mul_ps(_mm_loadu_ps(&src[2 * k]), scale);
+            __m128 b = _mm_mul_ps(_mm_loadu_ps(&src[2 * k + 4]), scale);
+
+            a = _mm_max_ps(_mm_min_ps(a, hi), lo);
+            b = _mm_max_ps(_mm_min_ps(b, hi), lo);
+
+            _mm_storeu_si128((__m128i *) &dst[2 * k],
+                             _mm_packs_epi32(_mm_cvtps_epi32(a),
+                                             _mm_cvtps_epi32(b)));
+        }
+#elif DSP_NEON && defined(__aarch64__)
+        const float32x4_t hi = vdupq_n_f32((float) SAMPLE_MAX);
+        const float32x4_t lo = vdupq_n_f32((float) SAMPLE_MIN);
+
+        for (; k + 4 <= n; k += 4) {
+            float32x4_t a = vmulq_n_f32(vld1q_f32(&src[2 * k]), CF32_SCALE);
+            float32x4_t b = vmulq_n_f32(vld1q_f32(&src[2 * k + 4]),
+                                        CF32_SCALE);
+
+            a = vmaxq_f32(vminq_f32(a, hi), lo);
+            b = vmaxq_f32(vminq_f32(b, hi), lo);
+
+            /* Round to nearest, as lrintf() does */
+            vst1q_s16(&dst[2 * k],
+                      vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)),
+                                   vqmovn_s32(vcvtnq_s32_f32(b))));
+        }
+#endif
+    }
+
+    from_cf32_generic(&dst[2 * k], &src[2 * k], n - k);
+}
+
+/******************************************************************************
+ * 8-bit sample conversion
+ ******************************************************************************/
+
+static void to_sc8_q7_generic(int8_t *dst, const int16_t *src,
+                              unsigned int n, unsigned int shift)
+{
+    const int32_t round = (shift == 0) ? 0 : (1 << (shift - 1));
+    unsigned int k;
+
+    for (k = 0; k < 2 * n; k++) {
+        int32_t x = ((int32_t) src[k] + round) >> shift;
+        x = x < INT8_MAX ? x : INT8_MAX;
+        x = x > INT8_MIN ? x : INT8_MIN;
+        dst[k] = (int8_t) x;
+    }
+}
+
+void dsp_sc16_q11_to_sc8_q7(int8_t *dst, const int16_t *src, unsigned int n,
+                            unsigned int shift)
+{
+    unsigned int k = 0;
+
+#if DSP_SSE2
+    const __m128i round = _mm_set1_epi32((shift == 0) ? 0 : (1 << (shift - 1)));
+    const __m128i count = _mm_cvtsi32_si128((int) shift);
+    __m128i p[2];
+    int j;
+
+    for (; k + 8 <= n; k += 8) {
+        for (j = 0; j < 2; j++) {
+            const __m128i v =
+                _mm_loadu_si128((const __m128i *) &src[2 * k + 8 * j]);
+
+            /* Widen before rounding, so that it cannot overflow */
+            __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+            __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+
+            lo = _mm_sra_epi32(_mm_add_epi32(lo, round), count);
+            hi = _mm_sra_epi32(_mm_add_epi32(hi, round), count);
+
+            p[j] = _mm_packs_epi32(lo, hi);
+        }
+
+        _mm_storeu_si128((__m128i *) &dst[2 * k], _mm_packs_epi16(p[0], p[1]));
+    }
+#elif DSP_NEON
+    /* A rounding shift left by a negative amount is a rounding shift right,
+     * computed without intermediate overflow */
+    const int16x8_t count = vdupq_n_s16(-(int16_t) shift);
+
+    for (; k + 8 <= n; k += 8) {
+        const int16x8_t a = vrshlq_s16(vld1q_s16(&src[2 * k]), count);
+        const int16x8_t b = vrshlq_s16(vld1q_s16(&src[2 * k + 8]), count);
+
+        vst1q_s8(&dst[2 * k], vcombine_s8(vqmovn_s16(a), vqmovn_s16(b)));
+    }
+#endif
+
+    to_sc8_q7_generic(&dst[2 * k], &src[2 * k], n - k, shift);
+}
+
+/******************************************************************************
+ * Power measurement
+ ******************************************************************************/
+
+static uint64_t power_sc16_q11_generic(const int16_t *src, unsigned int n)
+{
+    uint64_t sum = 0;
+    unsigned int k;
+
+    for (k = 0; k < 2 * n; k++) {
+        sum += (uint64_t) ((int32_t) src[k] * src[k]);
+    }
+
+    return sum;
+}
+
+#if DSP_AVX2
+__attribute__((target("avx2")))
+static unsigned int power_sc16_q11_avx2(const int16_t *src, unsigned int n,
+                                        uint64_t *sum)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = zero;
+    uint64_t lanes[4];
+    unsigned int k;
+
+    for (k = 0; k + 8 <= n; k += 8) {
+        const __m256i v = _mm256_loadu_si256((const __m256i *) &src[2 * k]);
+        const __m256i m = _mm256_madd_epi16(v, v);
+
+        /* I^2 + Q^2 fits in 32 bits only when treated as unsigned */
+        acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(m, zero));
+        acc = _mm256_add_epi64(acc, _mm256_unpackhi_epi32(m, zero));
+    }
+
+    _mm256_storeu_si256((__m256i *) lanes, acc);
+    *sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    return k;
+}
+#endif
+
+uint64_t dsp_power_sc16_q11(const int16_t *src, unsigned int n)
+{
+    unsigned int k = 0;
+    uint64_t sum = 0;
+
+#if DSP_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        k = power_sc16_q11_avx2(src, n, &sum);
+    } else
+#endif
+    {
+#if DSP_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        __m128i acc = zero;
+        uint64_t lanes[2];
+
+        for (; k + 4 <= n; k += 4) {
+            const __m128i v = _mm_loadu_si128((const __m128i *) &src[2 * k]);
+            const __m128i m = _mm_madd_epi16(v, v);
+
+            /* I^2 + Q^2 fits in 32 bits only when treated as unsigned */
+            acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(m, zero));
+            acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(m, zero));
+        }
+
+        _mm_storeu_si128((__m128i *) lanes, acc);
+        sum = lanes[0] + lanes[1];
+#elif DSP_NEON
+        int64x2_t acc = vdupq_n_s64(0);
+
+        for (; k + 4 <= n; k += 4) {
+            const int16x8_t v = vld1q_s16(&src[2 * k]);
+
+            acc = vpadalq_s32(acc, vmull_s16(vget_low_s16(v),
+                                             vget_low_s16(v)));
+            acc = vpadalq_s32(acc, vmull_s16(vget_high_s16(v),
+                                             vget_high_s16(v)));
+        }
+
+        sum = (uint64_t) (vgetq_lane_s64(acc, 0) + vgetq_lane_s64(acc, 1));
+#endif
+    }
+
+    return sum + power_sc16_q11_generic(&src[2 * k], n - k);
+}
+
+/* Single precision partial sums are folded into the total at this interval,
+ * in samples, to limit the loss of precision */
+#define POWER_BLOCK_LEN 1024
+
+double dsp_power_cf32(const float *src, unsigned int n)
+{
+    double sum = 0.0;
+    unsigned int k = 0;
+
+    while (k < n) {
+        const unsigned int end = (n - k > POWER_BLOCK_LEN) ?
+                                 k + POWER_BLOCK_LEN : n;
+        float block = 0.0f;
+
+#if DSP_SSE2
+        __m128 acc = _mm_setzero_ps();
+        float lanes[4];
+
+        for (; k + 2 <= end; k += 2) {
+            const __m128 v = _mm_loadu_ps(&src[2 * k]);
+            acc = _mm_add_ps(acc, _mm_mul_ps(v, v));
+        }
+
+        _mm_storeu_ps(lanes, acc);
+        block = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif DSP_NEON
+        float32x4_t acc = vdupq_n_f32(0.0f);
+
+        for (; k + 2 <= end; k += 2) {
+            const float32x4_t v = vld1q_f32(&src[2 * k]);
+            acc = vmlaq_f32(acc, v, v);
+        }
+
+        block = (vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 1)) +
+                (vgetq_lane_f32(acc, 2) + vgetq_lane_f32(acc, 3));
+#endif
+
+        for (; k < end; k++) {
+            block += src[2 * k] * src[2 * k] + src[2 * k + 1] * src[2 * k + 1];
+        }
+
+        sum += block;
+    }
+
+    return sum;
+}
+
+/******************************************************************************
+ * IQ statistics
+ ******************************************************************************/
+
+/* Integer sums of SC16 Q11 samples */
+struct iq_sums {
+    int64_t i, q;
+    int64_t ii, qq, iq;
+};
+
+static void iq_sums_sc16_q11_generic(const int16_t *src, unsigned int n,
+                                     struct iq_sums *s)
+{
+    unsigned int k;
+
+    for (k = 0; k < n; k++) {
+        const int32_t i = src[2 * k];
+        const int32_t q = src[2 * k + 1];
+
+        s->i += i;
+        s->q += q;
+        s->ii += i * i;
+        s->qq += q * q;
+        s->iq += i * q;
+    }
+}
+
+/* 32-bit lane sums are folded into the totals at this interval, in samples.
+ * A lane accumulates one product of at most 2048^2 per 4 samples, so this
+ * is well within range. */
+#define STATS_BLOCK_LEN 1024
+
+void dsp_iq_stats_sc16_q11(const int16_t *src, unsigned int n,
+                           struct dsp_iq_stats *stats)
+{
+    const double scale = 1.0 / 2048.0;
+    struct iq_sums s;
+    unsigned int k = 0;
+
+    memset(&s, 0, sizeof(s));
+
+#if DSP_SSE2
+    {
+        /* Select the I or Q of each pair when multiplied and summed */
+        const __m128i sel_i = _mm_set1_epi32(0x00000001);
+        const __m128i sel_q = _mm_set1_epi32(0x00010000);
+        const __m128i mask_i = _mm_set1_epi32(0x0000ffff);
+
+        while (k + 4 <= n) {
+            const unsigned int end = (n - k > STATS_BLOCK_LEN) ?
+                                     k + STATS_BLOCK_LEN : n;
+            __m128i acc_i = _mm_setzero_si128();
+            __m128i acc_q = _mm_setzero_si128();
+            __m128i acc_ii = _mm_setzero_si128();
+            __m128i acc_qq = _mm_setzero_si128();
+            __m128i acc_iq = _mm_setzero_si128();
+            int32_t lanes[5][4];
+            unsigned int j;
+
+            for (; k + 4 <= end; k += 4) {
+                const __m128i v = _mm_loadu_si128((const __m128i *) &src[2 * k]);
+                const __m128i vi = _mm_and_si128(v, mask_i);
+                const __m128i vq = _mm_andnot_si128(mask_i, v);
+
+                /* (Q, I) pairs */
+                const __m128i swapped = _mm_shufflehi_epi16(
+                    _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1)),
+                    _MM_SHUFFLE(2, 3, 0, 1));
+
+                acc_i = _mm_add_epi32(acc_i, _mm_madd_epi16(v, sel_i));
+                acc_q = _mm_add_epi32(acc_q, _mm_madd_epi16(v, sel_q));
+                acc_ii = _mm_add_epi32(acc_ii, _mm_madd_epi16(vi, v));
+                acc_qq = _mm_add_epi32(acc_qq, _mm_madd_epi16(vq, v));
+                acc_iq = _mm_add_epi32(acc_iq, _mm_madd_epi16(vi, swapped));
+            }
+
+            _mm_storeu_si128((__m128i *) lanes[0], acc_i);
+            _mm_storeu_si128((__m128i *) lanes[1], acc_q);
+            _mm_storeu_si128((__m128i *) lanes[2], acc_ii);
+            _mm_storeu_si128((__m128i *) lanes[3], acc_qq);
+            _mm_storeu_si128((__m128i *) lanes[4], acc_iq);
+
+            for (j = 0; j < 4; j++) {
+                s.i += lanes[0][j];
+                s.q += lanes[1][j];
+                s.ii += lanes[2][j];
+                s.qq += lanes[3][j];
+                s.iq += lanes[4][j];
+            }
+        }
+    }
+#elif DSP_NEON
+    {
+        int64x2_t acc_i = vdupq_n_s64(0);
+        int64x2_t acc_q = vdupq_n_s64(0);
+        int64x2_t acc_ii = vdupq_n_s64(0);
+        int64x2_t acc_qq = vdupq_n_s64(0);
+        int64x2_t acc_iq = vdupq_n_s64(0);
+
+        for (; k + 8 <= n; k += 8) {
+            const int16x8x2_t v = vld2q_s16(&src[2 * k]);
+            const int16x4_t i_lo = vget_low_s16(v.val[0]);
+            const int16x4_t i_hi = vget_high_s16(v.val[0]);
+            const int16x4_t q_lo = vget_low_s16(v.val[1]);
+            const int16x4_t q_hi = vget_high_s16(v.val[1]);
+
+            acc_i = vpadalq_s32(acc_i, vpaddlq_s16(v.val[0]));
+            acc_q = vpadalq_s32(acc_q, vpaddlq_s16(v.val[1]));
+            acc_ii = vpadalq_s32(acc_ii, vmull_s16(i_lo, i_lo));
+            acc_ii = vpadalq_s32(acc_ii, vmull_s16(i_hi, i_hi));
+            acc_qq = vpadalq_s32(acc_qq, vmull_s16(q_lo, q_lo));
+            acc_qq = vpadalq_s32(acc_qq, vmull_s16(q_hi, q_hi));
+            acc_iq = vpadalq_s32(acc_iq, vmull_s16(i_lo, q_lo));
+            acc_iq = vpadalq_s32(acc_iq, vmull_s16(i_hi, q_hi));
+        }
+
+        s.i = vgetq_lane_s64(acc_i, 0) + vgetq_lane_s64(acc_i, 1);
+        s.q = vgetq_lane_s64(acc_q, 0) + vgetq_lane_s64(acc_q, 1);
+        s.ii = vgetq_lane_s64(acc_ii, 0) + vgetq_lane_s64(acc_ii, 1);
+        s.qq = vgetq_lane_s64(acc_qq, 0) + vgetq_lane_s64(acc_qq, 1);
+        s.iq = vgetq_lane_s64(acc_iq, 0) + vgetq_lane_s64(acc_iq, 1);
+    }
+#endif
+
+    iq_sums_sc16_q11_generic(&src[2 * k], n - k, &s);
+
+    stats->i += s.i * scale;
+    stats->q += s.q * scale;
+    stats->ii += s.ii * scale * scale;
+    stats->qq += s.qq * scale * scale;
+    stats->iq += s.iq * scale * scale;
+}
+
+void dsp_iq_stats_cf32(const float *src, unsigned int n,
+                       struct dsp_iq_stats *stats)
+{
+    unsigned int k = 0;
+
+    while (k < n) {
+        const unsigned int end = (n - k > POWER_BLOCK_LEN) ?
+                                 k + POWER_BLOCK_LEN : n;
+        float i = 0.0f, q = 0.0f, ii = 0.0f, qq = 0.0f, iq = 0.0f;
+
+#if DSP_SSE2
+        __m128 acc = _mm_setzero_ps();
+        __m128 acc_sq = _mm_setzero_ps();
+        __m128 acc_x = _mm_setzero_ps();
+        float lanes[3][4];
+
+        for (; k + 2 <= end; k += 2) {
+            const __m128 v = _mm_loadu_ps(&src[2 * k]);
+            const __m128 swapped = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+
+            acc = _mm_add_ps(acc, v);
+            acc_sq = _mm_add_ps(acc_sq, _mm_mul_ps(v, v));
+            acc_x = _mm_add_ps(acc_x, _mm_mul_ps(v, swapped));
+        }
+
+        _mm_storeu_ps(lanes[0], acc);
+        _mm_storeu_ps(lanes[1], acc_sq);
+        _mm_storeu_ps(lanes[2], acc_x);
+
+        /* I lanes are even, Q lanes odd. Each I*Q appears twice. */
+        i = lanes[0][0] + lanes[0][2];
+        q = lanes[0][1] + lanes[0][3];
+        ii = lanes[1][0] + lanes[1][2];
+        qq = lanes[1][1] + lanes[1][3];
+        iq = lanes[2][0] + lanes[2][2];
+#elif DSP_NEON
+        float32x4_t acc_i = vdupq_n_f32(0.0f);
+        float32x4_t acc_q = vdupq_n_f32(0.0f);
+        float32x4_t acc_ii = vdupq_n_f32(0.0f);
+        float32x4_t acc_qq = vdupq_n_f32(0.0f);
+        float32x4_t acc_iq = vdupq_n_f32(0.0f);
+
+        for (; k + 4 <= end; k += 4) {
+            const float32x4x2_t v = vld2q_f32(&src[2 * k]);
+
+            acc_i = vaddq_f32(acc_i, v.val[0]);
+            acc_q = vaddq_f32(acc_q, v.val[1]);
+            acc_ii = vmlaq_f32(acc_ii, v.val[0], v.val[0]);
+            acc_qq = vmlaq_f32(acc_qq, v.val[1], v.val[1]);
+            acc_iq = vmlaq_f32(acc_iq, v.val[0], v.val[1]);
+        }
+
+        i = (vgetq_lane_f32(acc_i, 0) + vgetq_lane_f32(acc_i, 1)) +
+            (vgetq_lane_f32(acc_i, 2) + vgetq_lane_f32(acc_i, 3));
+        q = (vgetq_lane_f32(acc_q, 0) + vgetq_lane_f32(acc_q, 1)) +
+            (vgetq_lane_f32(acc_q, 2) + vgetq_lane_f32(acc_q, 3));
+        ii = (vgetq_lane_f32(acc_ii, 0) + vgetq_lane_f32(acc_ii, 1)) +
+             (vgetq_lane_f32(acc_ii, 2) + vgetq_lane_f32(acc_ii, 3));
+        qq = (vgetq_lane_f32(acc_qq, 0) + vgetq_lane_f32(acc_qq, 1)) +
+             (vgetq_lane_f32(acc_qq, 2) + vgetq_lane_f32(acc_qq, 3));
+        iq = (vgetq_lane_f32(acc_iq, 0) + vgetq_lane_f32(acc_iq, 1)) +
+             (vgetq_lane_f32(acc_iq, 2) + vgetq_lane_f32(acc_iq, 3));
+#endif
+
+        for (; k < end; k++) {
+            const float si = src[2 * k];
+            const float sq = src[2 * k + 1];
+
+            i += si;
+            q += sq;
+            ii += si * si;
+            qq += sq * sq;
+            iq += si * sq;
+        }
+
+        stats->i += i;
+        stats->q += q;
+        stats->ii += ii;
+        stats->qq += qq;
+        stats->iq += iq;
+    }
+}
+
+void dsp_deinit(struct bladerf_repeater_stage *stage)
+{
+    free(stage->user_data);
+    memset(stage, 0, sizeof(*stage));
+}
+
+const char *dsp_impl(void)
+{
+#if DSP_SSE2
+    return "sse2";
+#elif DSP_NEON
+    return "neon";
+#else
+    return "generic";
+#endif
+}
+
+const char *dsp_convert_impl(void)
+{
+#if DSP_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        return "avx2";
+    }
+#endif
+
+    return dsp_impl();
+}
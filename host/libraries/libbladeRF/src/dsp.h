@@ -0,0 +1,148 @@
+/**
+ * @file dsp.h
+ *
+ * @brief SC16 Q11 sample processing kernels for repeater stages, and
+ *        packed sample conversion
+ *
+ * Each kernel processes interleaved (I, Q) samples in place, saturating its
+ * results to the 12-bit range of SC16 Q11 samples, [-2048, 2047]. Kernels are
+ * implemented with SSE2 or NEON when the host supports them, falling back to
+ * portable C otherwise.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2014 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BLADERF_DSP_H_
+#define BLADERF_DSP_H_
+
+#include "libbladeRF.h"
+
+/* Largest supported FIR filter */
+#define DSP_FIR_MAX_TAPS        128
+
+/* Samples filtered per pass through the FIR filter's scratch buffer */
+#define DSP_FIR_BLOCK_LEN       1024
+
+/**
+ * Initialize a stage that scales samples by `gain`, which must be within
+ * [0, 8).
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL or BLADERF_ERR_MEM on failure
+ */
+int dsp_gain_init(struct bladerf_repeater_stage *stage, float gain);
+
+/**
+ * Initialize a stage that applies a FIR filter with real-valued taps to the
+ * I and Q components of samples. Each tap must be within (-1, 1), and the
+ * sum of their magnitudes must be less than 16.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL or BLADERF_ERR_MEM on failure
+ */
+int dsp_fir_init(struct bladerf_repeater_stage *stage,
+                 const float *taps, unsigned int num_taps);
+
+/**
+ * Initialize a stage that shifts samples by `frequency`, in cycles per
+ * sample, which must be within [-0.5, 0.5].
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL or BLADERF_ERR_MEM on failure
+ */
+int dsp_nco_init(struct bladerf_repeater_stage *stage, double frequency);
+
+/**
+ * Unpack `n` samples of the ::BLADERF_FORMAT_SC16_Q11_PACKED format, 3 bytes
+ * each, into SC16 Q11 samples
+ */
+void dsp_unpack_sc16_q11(int16_t *dst, const uint8_t *src, unsigned int n);
+
+/**
+ * Pack `n` SC16 Q11 samples into the ::BLADERF_FORMAT_SC16_Q11_PACKED format.
+ * Only the lower 12 bits of each component are kept.
+ */
+void dsp_pack_sc16_q11(uint8_t *dst, const int16_t *src, unsigned int n);
+
+/**
+ * Convert `n` SC16 Q11 samples to interleaved floats, scaled so that full
+ * scale is [-1.0, 1.0)
+ */
+void dsp_sc16_q11_to_cf32(float *dst, const int16_t *src, unsigned int n);
+
+/**
+ * Convert `n` interleaved float samples to SC16 Q11, rounding to the nearest
+ * value and saturating to [-2048, 2047]
+ */
+void dsp_cf32_to_sc16_q11(int16_t *dst, const float *src, unsigned int n);
+
+/**
+ * Convert `n` SC16 Q11 samples to 8-bit samples, dividing them by 2^`shift`,
+ * rounding, and saturating to [-128, 127]. `shift` must be at most 15.
+ */
+void dsp_sc16_q11_to_sc8_q7(int8_t *dst, const int16_t *src, unsigned int n,
+                            unsigned int shift);
+
+/**
+ * @return The sum of I^2 + Q^2 over `n` SC16 Q11 samples
+ */
+uint64_t dsp_power_sc16_q11(const int16_t *src, unsigned int n);
+
+/**
+ * @return The sum of I^2 + Q^2 over `n` interleaved float samples
+ */
+double dsp_power_cf32(const float *src, unsigned int n);
+
+/**
+ * Sums over received samples, from which their DC offset and IQ imbalance
+ * are estimated. Samples are scaled so that full scale is [-1.0, 1.0).
+ */
+struct dsp_iq_stats {
+    double i, q;            /* Sums of I and Q */
+    double ii, qq, iq;      /* Sums of I^2, Q^2, and I * Q */
+};
+
+/**
+ * Add the statistics of `n` SC16 Q11 samples to `stats`
+ */
+void dsp_iq_stats_sc16_q11(const int16_t *src, unsigned int n,
+                           struct dsp_iq_stats *stats);
+
+/**
+ * Add the statistics of `n` interleaved float samples to `stats`
+ */
+void dsp_iq_stats_cf32(const float *src, unsigned int n,
+                       struct dsp_iq_stats *stats);
+
+/**
+ * Free a stage initialized by one of the above functions
+ */
+void dsp_deinit(struct bladerf_repeater_stage *stage);
+
+/**
+ * @return Name of the SIMD implementation in use ("sse2", "neon", or
+ *         "generic")
+ */
+const char *dsp_impl(void);
+
+/**
+ * @return Name of the SIMD implementation used by the sample format
+ *         conversions, which may be selected at runtime ("avx2", or one of
+ *         the names returned by dsp_impl())
+ */
+const char *dsp_convert_impl(void);
+
+#endif
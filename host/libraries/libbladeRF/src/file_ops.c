@@ -32,6 +32,22 @@
 #include "minmax.h"
 #include "log.h"
 #include "rel_assert.h"
+#include "thread.h"
+
+/* Map files into memory, rather than reading them into heap buffers */
+#ifndef ENABLE_FILE_MMAP
+#   if BLADERF_OS_LINUX || BLADERF_OS_OSX
+#       define ENABLE_FILE_MMAP 1
+#   else
+#       define ENABLE_FILE_MMAP 0
+#   endif
+#endif
+
+#if ENABLE_FILE_MMAP
+#   include <fcntl.h>
+#   include <unistd.h>
+#   include <sys/mman.h>
+#endif
 
 /* Paths to search for bladeRF files */
 struct search_path_entries {
@@ -150,6 +166,80 @@ out:
     return status;
 }
 
+int file_map(const char *filename, struct file_mapping *map)
+{
+#if ENABLE_FILE_MMAP
+    int fd;
+    struct stat st;
+    void *data;
+
+    map->data = NULL;
+    map->len = 0;
+    map->mapped = false;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        int errno_val = errno;
+        return errno_val == ENOENT ? BLADERF_ERR_NO_FILE : BLADERF_ERR_IO;
+    }
+
+    if (fstat(fd, &st) != 0) {
+        log_verbose("fstat failed: %s\n", strerror(errno));
+        close(fd);
+        return BLADERF_ERR_IO;
+    }
+
+    /* Empty files and special files cannot be mapped, so read these as
+     * we would otherwise */
+    if (!S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return file_read_buffer(filename, &map->data, &map->len);
+    }
+
+    data = mmap(NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE, fd, 0);
+
+    /* The mapping remains valid after the descriptor is closed */
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        log_debug("Failed to map \"%s\": %s\n", filename, strerror(errno));
+        return file_read_buffer(filename, &map->data, &map->len);
+    }
+
+    /* Callers generally make a single pass over the contents */
+    madvise(data, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+    map->data = (uint8_t *) data;
+    map->len = (size_t) st.st_size;
+    map->mapped = true;
+    return 0;
+#else
+    map->data = NULL;
+    map->len = 0;
+    map->mapped = false;
+
+    return file_read_buffer(filename, &map->data, &map->len);
+#endif
+}
+
+void file_unmap(struct file_mapping *map)
+{
+#if ENABLE_FILE_MMAP
+    if (map->mapped) {
+        munmap(map->data, map->len);
+    } else {
+        free(map->data);
+    }
+#else
+    free(map->data);
+#endif
+
+    map->data = NULL;
+    map->len = 0;
+    map->mapped = false;
+}
+
 /* Remove the last entry in a path. This is used to strip the executable name
 * from a path to get the directory that the executable resides in. */
 static size_t strip_last_path_entry(char *buf, char dir_delim)
@@ -167,6 +257,7 @@ static size_t strip_last_path_entry(char *buf, char dir_delim)
 #if BLADERF_OS_LINUX || BLADERF_OS_OSX
 #define ACCESS_FILE_EXISTS F_OK
 #define DIR_DELIMETER '/'
+#define MKDIR(path) mkdir(path, 0755)
 
 static const struct search_path_entries search_paths[] = {
     { false, "" },
@@ -228,7 +319,9 @@ static inline size_t get_binary_dir(char *buf, size_t max_len)
 #elif BLADERF_OS_WINDOWS
 #define ACCESS_FILE_EXISTS 0
 #define DIR_DELIMETER '\\'
+#define MKDIR(path) _mkdir(path)
 #include <shlobj.h>
+#include <direct.h>
 
 static const struct search_path_entries search_paths[] = {
     { false, "" },
@@ -365,11 +458,220 @@ static inline size_t get_install_dir(char *buf, size_t max_len)
  * arbitrary, but "sufficiently" large max buffer size for paths */
 #define PATH_MAX_LEN    4096
 
-char *file_find(const char *filename)
+/* Number of file_find() results that are remembered, such that a repeated
+ * lookup of a file need only confirm that the file is unchanged */
+#ifndef FILE_FIND_CACHE_SIZE
+#   define FILE_FIND_CACHE_SIZE 8
+#endif
+
+/* Optional index of "<filename> <full path>" lines, consulted before the
+ * search directories. The BLADERF_SEARCH_INDEX environment variable
+ * overrides this location. */
+#ifndef FILE_FIND_INDEX
+#   if BLADERF_OS_LINUX || BLADERF_OS_OSX
+#       define FILE_FIND_INDEX "/etc/Nuand/bladeRF/search_index"
+#   else
+#       define FILE_FIND_INDEX ""
+#   endif
+#endif
+
+struct file_find_cache_entry {
+    char *filename;         /* NULL if this entry is unused */
+    char *full_path;
+    char *search_dir;       /* BLADERF_SEARCH_DIR at the time of the lookup */
+    struct stat st;         /* Used to detect that the file has changed */
+};
+
+static struct {
+    MUTEX lock;
+    struct file_find_cache_entry entries[FILE_FIND_CACHE_SIZE];
+    size_t next;            /* Entry to replace next, if none are unused */
+} file_find_cache = { PTHREAD_MUTEX_INITIALIZER, { { NULL } }, 0 };
+
+static inline bool str_matches(const char *a, const char *b)
+{
+    if (a == NULL || b == NULL) {
+        return a == b;
+    } else {
+        return strcmp(a, b) == 0;
+    }
+}
+
+static inline bool same_file(const struct stat *a, const struct stat *b)
+{
+    return a->st_dev == b->st_dev && a->st_ino == b->st_ino &&
+           a->st_size == b->st_size && a->st_mtime == b->st_mtime;
+}
+
+static char *strdup_or_null(const char *str)
+{
+    char *ret;
+
+    if (str == NULL) {
+        return NULL;
+    }
+
+    ret = (char *) malloc(strlen(str) + 1);
+    if (ret != NULL) {
+        strcpy(ret, str);
+    }
+
+    return ret;
+}
+
+static void cache_entry_clear(struct file_find_cache_entry *entry)
+{
+    free(entry->filename);
+    free(entry->full_path);
+    free(entry->search_dir);
+    memset(entry, 0, sizeof(*entry));
+}
+
+/* Look up a previous result, returning a heap-allocated copy of its path if
+ * the file it refers to still exists and has not changed */
+static char *cache_lookup(const char *filename, const char *search_dir)
+{
+    size_t i;
+    char *full_path = NULL;
+    struct stat st;
+
+    MUTEX_LOCK(&file_find_cache.lock);
+
+    for (i = 0; i < FILE_FIND_CACHE_SIZE; i++) {
+        struct file_find_cache_entry *entry = &file_find_cache.entries[i];
+
+        if (entry->filename == NULL ||
+            strcmp(entry->filename, filename) != 0 ||
+            !str_matches(entry->search_dir, search_dir)) {
+            continue;
+        }
+
+        if (stat(entry->full_path, &st) == 0 && same_file(&st, &entry->st)) {
+            full_path = strdup_or_null(entry->full_path);
+        } else {
+            log_verbose("Cached location of %s is stale.\n", filename);
+            cache_entry_clear(entry);
+        }
+
+        break;
+    }
+
+    MUTEX_UNLOCK(&file_find_cache.lock);
+    return full_path;
+}
+
+static void cache_insert(const char *filename, const char *search_dir,
+                         const char *full_path)
+{
+    size_t i;
+    struct file_find_cache_entry *entry = NULL;
+    struct stat st;
+
+    if (stat(full_path, &st) != 0) {
+        return;
+    }
+
+    MUTEX_LOCK(&file_find_cache.lock);
+
+    for (i = 0; i < FILE_FIND_CACHE_SIZE && entry == NULL; i++) {
+        if (file_find_cache.entries[i].filename == NULL) {
+            entry = &file_find_cache.entries[i];
+        }
+    }
+
+    if (entry == NULL) {
+        entry = &file_find_cache.entries[file_find_cache.next];
+        file_find_cache.next = (file_find_cache.next + 1) % FILE_FIND_CACHE_SIZE;
+        cache_entry_clear(entry);
+    }
+
+    entry->filename = strdup_or_null(filename);
+    entry->full_path = strdup_or_null(full_path);
+    entry->search_dir = strdup_or_null(search_dir);
+    entry->st = st;
+
+    if (entry->filename == NULL || entry->full_path == NULL ||
+        (search_dir != NULL && entry->search_dir == NULL)) {
+        cache_entry_clear(entry);
+    }
+
+    MUTEX_UNLOCK(&file_find_cache.lock);
+}
+
+/* Look up a file in the search index, returning a heap-allocated copy of its
+ * path if the index lists it and it exists */
+static char *index_lookup(const char *filename)
+{
+    FILE *f;
+    char *line;
+    char *full_path = NULL;
+    const char *index = getenv("BLADERF_SEARCH_INDEX");
+
+    if (index == NULL) {
+        index = FILE_FIND_INDEX;
+    }
+
+    if (index[0] == '\0') {
+        return NULL;
+    }
+
+    f = fopen(index, "r");
+    if (f == NULL) {
+        return NULL;
+    }
+
+    line = (char *) malloc(PATH_MAX_LEN + FILENAME_MAX + 2);
+    if (line == NULL) {
+        fclose(f);
+        return NULL;
+    }
+
+    while (full_path == NULL &&
+           fgets(line, PATH_MAX_LEN + FILENAME_MAX + 2, f) != NULL) {
+        struct stat st;
+        char *path;
+
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (line[0] == '#') {
+            continue;
+        }
+
+        /* The path is the remainder of the line, and may contain spaces */
+        path = line + strcspn(line, " \t");
+        if (*path == '\0') {
+            continue;
+        }
+
+        *path++ = '\0';
+        path += strspn(path, " \t");
+
+        if (strcmp(line, filename) != 0) {
+            continue;
+        }
+
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+            full_path = strdup_or_null(path);
+        } else {
+            log_debug("Ignoring stale %s entry for %s: %s\n",
+                      index, filename, path);
+        }
+    }
+
+    free(line);
+    fclose(f);
+    return full_path;
+}
+
+static char *file_search(const char *filename, const char *env_var)
 {
     size_t i, max_len;
     char *full_path = (char*) calloc(PATH_MAX_LEN + 1, 1);
-    const char *env_var = getenv("BLADERF_SEARCH_DIR");
+    char *index_path;
+
+    if (full_path == NULL) {
+        return NULL;
+    }
 
     /* Check directory specified by environment variable */
     if (env_var != NULL) {
@@ -386,6 +688,13 @@ char *file_find(const char *filename)
         }
     }
 
+    /* Check the search index, if one is present */
+    index_path = index_lookup(filename);
+    if (index_path != NULL) {
+        free(full_path);
+        return index_path;
+    }
+
     /* Check the directory containing the currently running binary */
     memset(full_path, 0, PATH_MAX_LEN);
     max_len = PATH_MAX_LEN - 1;
@@ -458,6 +767,22 @@ char *file_find(const char *filename)
     return NULL;
 }
 
+char *file_find(const char *filename)
+{
+    const char *search_dir = getenv("BLADERF_SEARCH_DIR");
+    char *full_path;
+
+    full_path = cache_lookup(filename, search_dir);
+    if (full_path == NULL) {
+        full_path = file_search(filename, search_dir);
+        if (full_path != NULL) {
+            cache_insert(filename, search_dir, full_path);
+        }
+    }
+
+    return full_path;
+}
+
 int file_find_and_read(const char *filename, uint8_t **buf, size_t *size)
 {
     int status;
@@ -473,3 +798,70 @@ int file_find_and_read(const char *filename, uint8_t **buf, size_t *size)
         return BLADERF_ERR_NO_FILE;
     }
 }
+
+/* Create each directory along the provided path that does not already exist.
+ * Only entries followed by a delimiter are treated as directories. The path is
+ * temporarily modified, but restored before returning. */
+static int mkdir_path(char *path)
+{
+    size_t i;
+    const size_t len = strlen(path);
+
+    for (i = 1; i < len; i++) {
+        const char c = path[i];
+
+        if (c == '/' || c == DIR_DELIMETER) {
+            path[i] = '\0';
+
+            if (access(path, ACCESS_FILE_EXISTS) == -1 && MKDIR(path) != 0) {
+                log_debug("Failed to create %s: %s\n", path, strerror(errno));
+                path[i] = c;
+                return BLADERF_ERR_IO;
+            }
+
+            path[i] = c;
+        }
+    }
+
+    return 0;
+}
+
+char *file_user_config_path(const char *filename)
+{
+    size_t i, max_len;
+    char *full_path = (char*) calloc(PATH_MAX_LEN + 1, 1);
+
+    if (full_path == NULL) {
+        return NULL;
+    }
+
+    /* The first home-relative search path is the user's config directory */
+    for (i = 0; i < ARRAY_SIZE(search_paths); i++) {
+        if (search_paths[i].prepend_home) {
+            break;
+        }
+    }
+
+    if (i >= ARRAY_SIZE(search_paths) ||
+        get_home_dir(full_path, PATH_MAX_LEN) == 0) {
+        goto error;
+    }
+
+    max_len = PATH_MAX_LEN - strlen(full_path);
+    if (max_len < strlen(search_paths[i].path) + strlen(filename)) {
+        log_debug("Path to %s would be truncated.\n", filename);
+        goto error;
+    }
+
+    strncat(full_path, search_paths[i].path, max_len);
+    if (mkdir_path(full_path) != 0) {
+        goto error;
+    }
+
+    strncat(full_path, filename, PATH_MAX_LEN - strlen(full_path));
+    return full_path;
+
+error:
+    free(full_path);
+    return NULL;
+}
@@ -31,6 +31,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 /**
  * Read file contents into a buffer allocated internally and returned to the
@@ -48,6 +49,40 @@
  */
 int file_read_buffer(const char *filename, uint8_t **buf, size_t *size);
 
+/**
+ * File contents made available by file_map()
+ */
+struct file_mapping {
+    uint8_t *data;      /**< File contents */
+    size_t len;         /**< Length of data, in bytes */
+    bool mapped;        /**< Data was mapped, rather than read into the heap */
+};
+
+/**
+ * Make a file's contents available in memory, without reading them into a
+ * heap-allocated buffer where possible.
+ *
+ * Where supported, the file is mapped privately; the contents are paged in
+ * on demand and may be modified without affecting the file. Otherwise, this
+ * falls back to file_read_buffer().
+ *
+ * The caller is responsible for releasing the contents via file_unmap().
+ *
+ * @param[in]   filename    File to map
+ * @param[out]  map         Upon success, describes the file contents
+ *
+ * @return 0 on success, negative BLADERF_ERR_* value on failure
+ */
+int file_map(const char *filename, struct file_mapping *map);
+
+/**
+ * Release file contents obtained via file_map(). This is a no-op if `map'
+ * does not hold any contents.
+ *
+ * @param[in]   map         File contents to release
+ */
+void file_unmap(struct file_mapping *map);
+
 /**
  * Write to an open file stream.
  *
@@ -87,6 +122,15 @@ ssize_t file_size(FILE *f);
  * the full path is returned. There is a chance that the file will be removed
  * in between this call indicating it exists and attempting to open it.
  *
+ * The directory specified by the BLADERF_SEARCH_DIR environment variable is
+ * checked first, followed by the search index (see FILE_FIND_INDEX), if one
+ * exists, and then the remaining search directories.
+ *
+ * Results are cached, such that a repeated search for the same file only
+ * checks that the previously found file is unchanged. A file added to a
+ * higher-priority directory will therefore not be found until the
+ * previously found file is changed or removed.
+ *
  * @param   filename    File to search for
  *
  * @return Full path if the file is found, NULL otherwise.
@@ -105,4 +149,17 @@ char *file_find(const char *filename);
  */
 int file_find_and_read(const char *filename, uint8_t **buf, size_t *size);
 
+/**
+ * Get the full path of the specified file in the user's bladeRF configuration
+ * directory (e.g., ~/.config/Nuand/bladeRF/ on Linux), creating the directory
+ * if it does not yet exist. The file itself is not created.
+ *
+ * The caller is responsible for freeing the returned path.
+ *
+ * @param   filename    Name of file
+ *
+ * @return Full path on success, NULL on failure
+ */
+char *file_user_config_path(const char *filename);
+
 #endif
@@ -29,7 +29,10 @@
 #include "rel_assert.h"
 #include "flash.h"
 #include "flash_fields.h"
+#include "fpga.h"
+#include "version_compat.h"
 #include "log.h"
+#include "crc32.h"
 
 static inline int check_eb_access(uint32_t erase_block, uint32_t count)
 {
@@ -100,105 +103,196 @@ int flash_write(struct bladerf *dev, const uint8_t *buf,
     return status;
 }
 
-static inline int verify_flash(struct bladerf *dev, uint8_t *readback_buf,
-                               uint8_t *image, uint32_t page, uint32_t count)
+/* Determine whether `count` pages of flash, starting at `page`, contain the
+ * provided data. Where supported, this compares a CRC-32 computed by the
+ * device, so that the pages need not be read back. Otherwise, they are read
+ * back into readback_buf. */
+static int flash_matches(struct bladerf *dev, uint8_t *readback_buf,
+                         const uint8_t *data, uint32_t page, uint32_t count,
+                         bool *match)
 {
-    int status = 0;
-    size_t i;
+    int status;
+    uint32_t crc;
     const size_t len = count * BLADERF_FLASH_PAGE_SIZE;
 
-    log_info("Verifying %u pages, starting at page %u\n", count, page);
-    status = flash_read(dev, readback_buf, page, count);
+    if (dev->fn->flash_crc32 != NULL) {
+        status = dev->fn->flash_crc32(dev, page, count, &crc);
+        if (status == 0) {
+            *match = (crc == crc32_update(0, data, len));
+            return 0;
+        } else if (status != BLADERF_ERR_UNSUPPORTED) {
+            log_debug("Failed to get CRC of pages %u-%u: %s\n",
+                      page, page + count - 1, bladerf_strerror(status));
+            return status;
+        }
+    }
 
-    if (status < 0) {
+    status = flash_read(dev, readback_buf, page, count);
+    if (status != 0) {
         log_debug("Failed to read from flash: %s\n", bladerf_strerror(status));
         return status;
     }
 
-    for (i = 0; i < len; i++) {
-        if (image[i] != readback_buf[i]) {
-            status = BLADERF_ERR_UNEXPECTED;
-            log_info("Flash verification failed at byte %llu. "
-                     "Read %02x, expected %02x\n",
-                     i, readback_buf[i], image[i]);
-            break;
+    *match = (memcmp(readback_buf, data, len) == 0);
+    return 0;
+}
+
+static inline bool page_is_erased(const uint8_t *page)
+{
+    size_t i;
+
+    for (i = 0; i < BLADERF_FLASH_PAGE_SIZE; i++) {
+        if (page[i] != 0xff) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/* Write the pages of a freshly erased block, skipping runs of pages that
+ * would only be written with the erased value */
+static int write_erased_block(struct bladerf *dev, const uint8_t *data,
+                              uint32_t page)
+{
+    int status = 0;
+    uint32_t i, run;
+    const uint32_t num_pages = BLADERF_FLASH_EB_SIZE / BLADERF_FLASH_PAGE_SIZE;
+
+    for (i = 0; i < num_pages && status == 0; i += run) {
+        const uint8_t *run_data = data + i * BLADERF_FLASH_PAGE_SIZE;
+        const bool erased = page_is_erased(run_data);
+
+        run = 1;
+        while ((i + run) < num_pages &&
+               page_is_erased(run_data + run * BLADERF_FLASH_PAGE_SIZE) ==
+               erased) {
+            run++;
+        }
+
+        if (!erased) {
+            status = flash_write(dev, run_data, page + i, run);
         }
     }
 
     return status;
 }
 
-int flash_write_fx3_fw(struct bladerf *dev, uint8_t **image, size_t len)
+/* Update `num_ebs` erase blocks, starting at erase block `eb`, to contain the
+ * provided data, which must be `num_ebs` erase blocks in length.
+ *
+ * Each block is first checked against the data. Only blocks whose contents
+ * differ are erased, written, and verified, so updating a region with a
+ * largely unchanged image is much faster than rewriting all of it. */
+static int flash_update_ebs(struct bladerf *dev, const uint8_t *data,
+                            uint32_t eb, uint32_t num_ebs)
 {
-    int status;
+    int status = 0;
+    uint32_t i;
+    uint32_t num_updated = 0;
     uint8_t *readback_buf;
-    uint8_t *padded_image;
-    uint32_t padded_image_len;
+    bool match;
+    const uint32_t pages_per_eb = BLADERF_FLASH_EB_SIZE /
+                                  BLADERF_FLASH_PAGE_SIZE;
 
-    /* Pad firwmare data out to a page size */
-    const uint32_t page_size = BLADERF_FLASH_PAGE_SIZE;
-    const uint32_t padding_len =
-        (len % page_size == 0) ? 0 : page_size - (len % page_size);
-
-    if (len >= (UINT32_MAX - padding_len)) {
-        return BLADERF_ERR_INVAL;
+    status = check_eb_access(eb, num_ebs);
+    if (status != 0) {
+        return status;
     }
 
-    padded_image_len = (uint32_t) len + padding_len;
-
-    readback_buf = (uint8_t*) malloc(padded_image_len);
+    readback_buf = (uint8_t *) malloc(BLADERF_FLASH_EB_SIZE);
     if (readback_buf == NULL) {
         return BLADERF_ERR_MEM;
     }
 
-    padded_image = (uint8_t *) realloc(*image, padded_image_len);
-    if (padded_image == NULL) {
-        status = BLADERF_ERR_MEM;
-        goto error;
-    }
+    for (i = 0; i < num_ebs && status == 0; i++) {
+        const uint8_t *block = data + i * BLADERF_FLASH_EB_SIZE;
+        const uint32_t page = (eb + i) * pages_per_eb;
+
+        status = flash_matches(dev, readback_buf, block, page, pages_per_eb,
+                               &match);
+        if (status != 0) {
+            break;
+        } else if (match) {
+            log_verbose("Erase block %u is unchanged.\n", eb + i);
+            continue;
+        }
 
-    *image = padded_image;
+        status = flash_erase(dev, eb + i, 1);
+        if (status != 0) {
+            log_debug("Failed to erase block %u: %s\n",
+                      eb + i, bladerf_strerror(status));
+            break;
+        }
 
-    /* Clear the padded region */
-    memset(padded_image + len, 0xFF, padded_image_len - len);
+        status = write_erased_block(dev, block, page);
+        if (status != 0) {
+            log_debug("Failed to write erase block %u: %s\n",
+                      eb + i, bladerf_strerror(status));
+            break;
+        }
 
-    /* Erase the entire firmware region */
-    status = flash_erase(dev, BLADERF_FLASH_EB_FIRMWARE,
-                         BLADERF_FLASH_EB_LEN_FIRMWARE);
+        log_info("Verifying erase block %u\n", eb + i);
+        status = flash_matches(dev, readback_buf, block, page, pages_per_eb,
+                               &match);
+        if (status != 0) {
+            break;
+        } else if (!match) {
+            log_info("Flash verification failed for erase block %u.\n",
+                     eb + i);
+            status = BLADERF_ERR_UNEXPECTED;
+            break;
+        }
 
-    if (status != 0) {
-        log_debug("Failed to erase firmware region: %s\n",
-                  bladerf_strerror(status));
-        goto error;
+        num_updated++;
     }
 
-    /* Convert the image length to pages */
-    padded_image_len /= BLADERF_FLASH_PAGE_SIZE;
+    if (status == 0) {
+        log_info("Updated %u of %u erase blocks.\n", num_updated, num_ebs);
+    }
 
-    /* Write the firmware image to flash */
-    status = flash_write(dev, padded_image,
-                         BLADERF_FLASH_PAGE_FIRMWARE, padded_image_len);
+    free(readback_buf);
+    return status;
+}
 
-    if (status < 0) {
-        log_debug("Failed to write firmware: %s\n", bladerf_strerror(status));
-        goto error;
+int flash_write_fx3_fw(struct bladerf *dev, const uint8_t *image, size_t len)
+{
+    int status;
+    uint8_t *padded_image;
+
+    /* The entire firmware region is written, with the unused remainder
+     * set to the erased value */
+    const size_t region_len = BLADERF_FLASH_BYTE_LEN_FIRMWARE;
+
+    if (len > region_len) {
+        log_debug("Firmware image (%llu bytes) is larger than the firmware "
+                  "region of flash.\n", (unsigned long long) len);
+        return BLADERF_ERR_INVAL;
     }
 
-    /* Read back and double-check what we just wrote */
-    status = verify_flash(dev, readback_buf, padded_image,
-                          BLADERF_FLASH_PAGE_FIRMWARE, padded_image_len);
+    padded_image = (uint8_t *) malloc(region_len);
+    if (padded_image == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    memcpy(padded_image, image, len);
 
+    /* Clear the padded region */
+    memset(padded_image + len, 0xFF, region_len - len);
+
+    status = flash_update_ebs(dev, padded_image, BLADERF_FLASH_EB_FIRMWARE,
+                              BLADERF_FLASH_EB_LEN_FIRMWARE);
     if (status != 0) {
-        log_debug("Flash verification failed: %s\n", bladerf_strerror(status));
+        log_debug("Failed to write firmware: %s\n", bladerf_strerror(status));
     }
 
-error:
-    free(readback_buf);
+    free(padded_image);
     return status;
 }
 
 static inline void fill_fpga_metadata_page(uint8_t *metadata,
-                                           size_t actual_bitstream_len)
+                                           size_t actual_bitstream_len,
+                                           bool compressed)
 {
     char len_str[10];
     int idx = 0;
@@ -211,95 +305,65 @@ static inline void fill_fpga_metadata_page(uint8_t *metadata,
 
     encode_field((char *)metadata, BLADERF_FLASH_PAGE_SIZE,
                  &idx, "LEN", len_str);
+
+    /* The autoloader treats a bitstream without this field as
+     * uncompressed */
+    if (compressed) {
+        encode_field((char *)metadata, BLADERF_FLASH_PAGE_SIZE,
+                     &idx, "CMP", "1");
+    }
 }
 
 int flash_write_fpga_bitstream(struct bladerf *dev,
-                               uint8_t **bitstream, size_t len)
+                               const uint8_t *bitstream, size_t len)
 {
     int status;
-    uint8_t *readback_buf;
-    uint8_t *padded_bitstream;
-    uint8_t metadata[BLADERF_FLASH_PAGE_SIZE];
-    uint32_t padded_bitstream_len;
-
-    /* Pad data to be page-aligned */
-    const uint32_t page_size = BLADERF_FLASH_PAGE_SIZE;
-    const uint32_t padding_len =
-        (len % page_size == 0) ? 0 : page_size - (len % page_size);
-
-    if (len >= (UINT32_MAX - padding_len)) {
+    uint8_t *data;
+    size_t data_len;
+    uint32_t num_ebs;
+    const bool compressed = fpga_is_compressed(dev, len);
+
+    /* The metadata page is followed by the bitstream. Only the erase blocks
+     * that these occupy are written, rather than the entire FPGA region; the
+     * autoloader only reads the number of bytes specified by the metadata.
+     * The remainder of the last block is set to the erased value. */
+    if (len > (BLADERF_FLASH_BYTE_LEN_FPGA - BLADERF_FLASH_PAGE_SIZE)) {
+        log_debug("FPGA bitstream (%llu bytes) is larger than the FPGA "
+                  "region of flash.\n", (unsigned long long) len);
         return BLADERF_ERR_INVAL;
     }
 
-    padded_bitstream_len = (uint32_t) len + padding_len;
-
-    /* Fill in metadata with the *actual* FPGA bitstream length */
-    fill_fpga_metadata_page(metadata, len);
-
-    readback_buf = (uint8_t*) malloc(padded_bitstream_len);
-    if (readback_buf == NULL) {
-        return BLADERF_ERR_MEM;
-    }
-
-    padded_bitstream = (uint8_t*) realloc(*bitstream, padded_bitstream_len);
-    if (padded_bitstream == NULL) {
-        status = BLADERF_ERR_MEM;
-        goto error;
-    }
-
-    *bitstream = padded_bitstream;
-
-    /* Clear the padded region */
-    memset(padded_bitstream + len, 0xFF, padded_bitstream_len - len);
-
-    /* Erase FPGA metadata and bitstream region */
-    status = flash_erase(dev, BLADERF_FLASH_EB_FPGA, BLADERF_FLASH_EB_LEN_FPGA);
-    if (status != 0) {
-        log_debug("Failed to erase FPGA meta & bitstream regions: %s\n",
-                  bladerf_strerror(status));
-        goto error;
+    /* Older firmware would attempt to autoload it as uncompressed */
+    if (compressed && version_less_than(&dev->fw_version, 1, 10, 0)) {
+        log_warning("FX3 firmware v1.10.0 or later is required to autoload "
+                    "a compressed FPGA bitstream.\n");
+        return BLADERF_ERR_UPDATE_FW;
     }
 
-    /* Write the metadata page */
-    status = flash_write(dev, metadata, BLADERF_FLASH_PAGE_FPGA, 1);
-    if (status != 0) {
-        log_debug("Failed to write FPGA metadata page: %s\n",
-                  bladerf_strerror(status));
-        goto error;
-    }
+    num_ebs = (uint32_t) ((BLADERF_FLASH_PAGE_SIZE + len +
+                           BLADERF_FLASH_EB_SIZE - 1) / BLADERF_FLASH_EB_SIZE);
 
-    /* Convert the padded bitstream length to pages */
-    padded_bitstream_len /= BLADERF_FLASH_PAGE_SIZE;
+    data_len = (size_t) num_ebs * BLADERF_FLASH_EB_SIZE;
 
-    /* Write the padded bitstream */
-    status = flash_write(dev, padded_bitstream, BLADERF_FLASH_PAGE_FPGA + 1,
-                         padded_bitstream_len);
-    if (status != 0) {
-        log_debug("Failed to write bitstream: %s\n",
-                  bladerf_strerror(status));
-        goto error;
+    data = (uint8_t *) malloc(data_len);
+    if (data == NULL) {
+        return BLADERF_ERR_MEM;
     }
 
-    /* Read back and verify metadata */
-    status = verify_flash(dev, readback_buf, metadata,
-                          BLADERF_FLASH_PAGE_FPGA, 1);
-    if (status != 0) {
-        log_debug("Failed to verify metadata: %s\n", bladerf_strerror(status));
-        goto error;
-    }
+    /* Fill in metadata with the *actual* FPGA bitstream length */
+    fill_fpga_metadata_page(data, len, compressed);
 
-    /* Read back and verify the bitstream data */
-    status = verify_flash(dev, readback_buf, padded_bitstream,
-                          BLADERF_FLASH_PAGE_FPGA + 1, padded_bitstream_len);
+    memcpy(data + BLADERF_FLASH_PAGE_SIZE, bitstream, len);
+    memset(data + BLADERF_FLASH_PAGE_SIZE + len, 0xFF,
+           data_len - BLADERF_FLASH_PAGE_SIZE - len);
 
+    status = flash_update_ebs(dev, data, BLADERF_FLASH_EB_FPGA, num_ebs);
     if (status != 0) {
-        log_debug("Failed to verify bitstream data: %s\n",
+        log_debug("Failed to write FPGA metadata and bitstream: %s\n",
                   bladerf_strerror(status));
-        goto error;
     }
 
-error:
-    free(readback_buf);
+    free(data);
     return status;
 }
 
@@ -133,28 +133,30 @@ int flash_write(struct bladerf *dev, const uint8_t *buf,
  *
  * This function does no validation of the data (i.e., that it's valid FW).
  *
+ * Erase blocks that already contain the desired data are not rewritten.
+ *
  * @param   dev             bladeRF handle
- * @param   image           Firmware image data. Buffer will be
- *                          realloc'd as needed to pad the image data.
+ * @param   image           Firmware image data
  * @param   len             Length of firmware to write, in bytes
  *
  * @return 0 on success, BLADERF_ERR_* value on failure
  */
-int flash_write_fx3_fw(struct bladerf *dev, uint8_t **image, size_t len);
+int flash_write_fx3_fw(struct bladerf *dev, const uint8_t *image, size_t len);
 
 /**
  * Write the provided FPGA bitstream to flash and enable autoloading via
  * writing the associated metadata.
  *
+ * Erase blocks that already contain the desired data are not rewritten.
+ *
  * @param   dev             bladeRF handle
- * @param   bitstream       FPGA bitstream data. Buffer will be realloc'd as
- *                          needed to pad the image data.
+ * @param   bitstream       FPGA bitstream data
  * @param   len             Length of the bitstream data
  *
  * @return 0 on success, BLADERF_ERR_* value on failure
  */
 int flash_write_fpga_bitstream(struct bladerf *dev,
-                               uint8_t **bitstream, size_t len);
+                               const uint8_t *bitstream, size_t len);
 
 /**
  * Erase FPGA metadata and bitstream regions of flash
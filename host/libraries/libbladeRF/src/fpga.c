@@ -24,6 +24,7 @@
 #include "file_ops.h"
 #include "log.h"
 #include "flash.h"
+#include "sha256.h"
 
 int fpga_check_version(struct bladerf *dev)
 {
@@ -70,9 +71,31 @@ int fpga_check_version(struct bladerf *dev)
     return status;
 }
 
+/* Length of an uncompressed bitstream for each FPGA size */
+#define FPGA_UNCOMPRESSED_LEN_40KLE     1191788
+#define FPGA_UNCOMPRESSED_LEN_115KLE    3571462
+
+/* Smallest plausible bitstream, compressed or not */
+#define FPGA_MIN_LEN                    (256 * 1024)
+
+bool fpga_is_compressed(const struct bladerf *dev, size_t len)
+{
+    size_t raw_len;
+
+    if (dev->fpga_size == BLADERF_FPGA_115KLE) {
+        raw_len = FPGA_UNCOMPRESSED_LEN_115KLE;
+    } else {
+        raw_len = FPGA_UNCOMPRESSED_LEN_40KLE;
+    }
+
+    /* The length of an uncompressed bitstream depends only upon the device,
+     * whereas compression typically saves a third or more of it */
+    return len < (raw_len - raw_len / 8);
+}
+
 static inline bool valid_fpga_size(size_t len)
 {
-    if (len < (1 * 1024 * 1024)) {
+    if (len < FPGA_MIN_LEN) {
         return false;
     } else if (len > BLADERF_FLASH_BYTE_LEN_FPGA) {
         return false;
@@ -81,57 +104,137 @@ static inline bool valid_fpga_size(size_t len)
     }
 }
 
-int fpga_load_from_file(struct bladerf *dev, const char *fpga_file)
+/* Identify an FPGA image by the leading bytes of its SHA-256 digest */
+static uint64_t fpga_image_id(const uint8_t *buf, size_t len)
+{
+    SHA256_CTX ctx;
+    uint8_t digest[SHA256_DIGEST_SIZE];
+    uint64_t id = 0;
+    size_t i;
+
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, buf, len);
+    SHA256_Final(digest, &ctx);
+
+    for (i = 0; i < sizeof(id); i++) {
+        id |= (uint64_t) digest[i] << (i * 8);
+    }
+
+    /* These denote a freshly configured FPGA, and one that lacks support
+     * for image identifiers, respectively */
+    if (id == 0 || id == UINT64_MAX) {
+        id = 1;
+    }
+
+    return id;
+}
+
+/* Determine whether the FPGA is already running the specified image */
+static bool fpga_image_loaded(struct bladerf *dev, uint64_t id)
 {
-    uint8_t *buf = NULL;
-    size_t  buf_size;
     int status;
+    uint64_t loaded_id;
+    const char env_override[] = "BLADERF_FORCE_FPGA_LOAD";
 
+    if (dev->fn->get_fpga_image_id == NULL || getenv(env_override)) {
+        return false;
+    }
+
+    status = FPGA_IS_CONFIGURED(dev);
+    if (status <= 0) {
+        return false;
+    }
+
+    status = dev->fn->get_fpga_image_id(dev, &loaded_id);
+    if (status != 0) {
+        log_debug("Failed to read FPGA image ID: %s\n",
+                  bladerf_strerror(status));
+        return false;
+    }
+
+    return loaded_id == id;
+}
+
+int fpga_image_init(struct fpga_image *image, const uint8_t *data, size_t len)
+{
     /* TODO sanity check FPGA:
      *  - Check for x40 vs x115 and verify FPGA image size
      *  - Known header/footer on images?
      *  - Checksum/hash?
      */
-    status = file_read_buffer(fpga_file, &buf, &buf_size);
-    if (status != 0) {
-        goto error;
+    if (data == NULL || !valid_fpga_size(len)) {
+        return BLADERF_ERR_INVAL;
     }
 
-    if (!valid_fpga_size(buf_size)) {
-        status = BLADERF_ERR_INVAL;
-        goto error;
-    }
+    image->data = data;
+    image->len = len;
+    image->id = fpga_image_id(data, len);
 
-    status = dev->fn->load_fpga(dev, buf, buf_size);
-    if (status != 0) {
-        goto error;
+    return 0;
+}
+
+int fpga_load_image(struct bladerf *dev, const struct fpga_image *image)
+{
+    int status;
+
+    /* Reloading the running image would only reset the FPGA's state. The
+     * device is still reinitialized below, as it would be after a load. */
+    if (fpga_image_loaded(dev, image->id)) {
+        log_debug("FPGA image is already loaded. Skipping FPGA load.\n");
+    } else {
+        /* The backend only reads the image, which may be shared by several
+         * concurrent loads */
+        status = dev->fn->load_fpga(dev, (uint8_t *) image->data, image->len);
+        if (status != 0) {
+            return status;
+        }
+
+        if (dev->fn->set_fpga_image_id != NULL) {
+            status = dev->fn->set_fpga_image_id(dev, image->id);
+            if (status != 0) {
+                log_debug("Failed to store FPGA image ID: %s\n",
+                          bladerf_strerror(status));
+            }
+        }
     }
 
     status = fpga_check_version(dev);
     if (status != 0) {
-        goto error;
+        return status;
     }
 
-    status = init_device(dev);
+    return init_device(dev);
+}
+
+int fpga_load_from_file(struct bladerf *dev, const char *fpga_file)
+{
+    struct file_mapping map;
+    struct fpga_image image;
+    int status;
+
+    status = file_map(fpga_file, &map);
     if (status != 0) {
-        goto error;
+        return status;
+    }
+
+    status = fpga_image_init(&image, map.data, map.len);
+    if (status == 0) {
+        status = fpga_load_image(dev, &image);
     }
 
-error:
-    free(buf);
+    file_unmap(&map);
     return status;
 }
 
 int fpga_write_to_flash(struct bladerf *dev, const char *fpga_file)
 {
     int status;
-    size_t buf_size;
-    uint8_t *buf = NULL;
+    struct file_mapping map;
     const char env_override[] = "BLADERF_SKIP_FPGA_SIZE_CHECK";
 
-    status = file_read_buffer(fpga_file, &buf, &buf_size);
+    status = file_map(fpga_file, &map);
     if (status == 0) {
-        if (!getenv(env_override) && !valid_fpga_size(buf_size)) {
+        if (!getenv(env_override) && !valid_fpga_size(map.len)) {
             log_warning("Detected potentially invalid firmware file.\n");
 
             /* You probably don't want to do this unless you know what you're
@@ -141,10 +244,10 @@ int fpga_write_to_flash(struct bladerf *dev, const char *fpga_file)
                       "to skip this check.\n");
             status = BLADERF_ERR_INVAL;
         } else {
-            status = flash_write_fpga_bitstream(dev, &buf, buf_size);
+            status = flash_write_fpga_bitstream(dev, map.data, map.len);
         }
     }
 
-    free(buf);
+    file_unmap(&map);
     return status;
 }
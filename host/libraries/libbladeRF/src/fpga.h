@@ -40,6 +40,51 @@
  */
 int fpga_check_version(struct bladerf *dev);
 
+/**
+ * Determine whether an FPGA bitstream was generated with on-chip
+ * decompression enabled. Such bitstreams are identified by being shorter
+ * than an uncompressed bitstream for the device's FPGA size.
+ *
+ * @param   dev         Device handle
+ * @param   len         Length of the bitstream, in bytes
+ *
+ * @return true if the bitstream is compressed, false otherwise
+ */
+bool fpga_is_compressed(const struct bladerf *dev, size_t len);
+
+/**
+ * An FPGA bitstream held in memory, which has been checked and identified
+ */
+struct fpga_image {
+    const uint8_t *data;
+    size_t len;
+    uint64_t id;        /* Identifier stored in the FPGA upon loading */
+};
+
+/**
+ * Check an in-memory FPGA bitstream and compute its identifier. The image
+ * refers to, rather than copies, the provided data.
+ *
+ * @param[out]  image   Image to initialize
+ * @param[in]   data    RBF contents
+ * @param[in]   len     Length of `data`, in bytes
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if the bitstream is invalid
+ */
+int fpga_image_init(struct fpga_image *image, const uint8_t *data, size_t len);
+
+/**
+ * Load an FPGA image, unless it is already running, and initialize the
+ * device. The image is not modified, so one image may be loaded into several
+ * devices concurrently.
+ *
+ * @param   dev         Device handle
+ * @param   image       Image initialized via fpga_image_init()
+ *
+ * @return 0 on success, BLADERF_ERR_* values on failure
+ */
+int fpga_load_image(struct bladerf *dev, const struct fpga_image *image);
+
 /**
  * Load an FPGA bitstream from the specified RBF
  *
@@ -20,70 +20,37 @@
 
 #include "gain.h"
 #include "lms.h"
+#include "log.h"
+#include "version_compat.h"
 
-static inline int set_rx_gain_combo(struct bladerf *dev,
-                                     bladerf_lna_gain lnagain,
-                                     int rxvga1, int rxvga2)
-{
-    int status;
-    status = lms_lna_set_gain(dev, lnagain);
-    if (status < 0) {
-        return status;
-    }
-
-    status = lms_rxvga1_set_gain(dev, rxvga1);
-    if (status < 0) {
-        return status;
-    }
-
-    return lms_rxvga2_set_gain(dev, rxvga2);
-}
-
-static int set_rx_gain(struct bladerf *dev, int gain)
+static void rx_gain_stages(int gain, bladerf_lna_gain *lnagain,
+                           int *rxvga1, int *rxvga2)
 {
     if (gain <= BLADERF_LNA_GAIN_MID_DB) {
-        return set_rx_gain_combo(dev,
-                                 BLADERF_LNA_GAIN_BYPASS,
-                                 BLADERF_RXVGA1_GAIN_MIN,
-                                 BLADERF_RXVGA2_GAIN_MIN);
+        *lnagain = BLADERF_LNA_GAIN_BYPASS;
+        *rxvga1  = BLADERF_RXVGA1_GAIN_MIN;
+        *rxvga2  = BLADERF_RXVGA2_GAIN_MIN;
     } else if (gain <= BLADERF_LNA_GAIN_MID_DB + BLADERF_RXVGA1_GAIN_MIN) {
-        return set_rx_gain_combo(dev,
-                                 BLADERF_LNA_GAIN_MID_DB,
-                                 BLADERF_RXVGA1_GAIN_MIN,
-                                 BLADERF_RXVGA2_GAIN_MIN);
+        *lnagain = BLADERF_LNA_GAIN_MID;
+        *rxvga1  = BLADERF_RXVGA1_GAIN_MIN;
+        *rxvga2  = BLADERF_RXVGA2_GAIN_MIN;
     } else if (gain <= (BLADERF_LNA_GAIN_MAX_DB + BLADERF_RXVGA1_GAIN_MAX)) {
-        return set_rx_gain_combo(dev,
-                                 BLADERF_LNA_GAIN_MID,
-                                 gain - BLADERF_LNA_GAIN_MID_DB,
-                                 BLADERF_RXVGA2_GAIN_MIN);
+        *lnagain = BLADERF_LNA_GAIN_MID;
+        *rxvga1  = gain - BLADERF_LNA_GAIN_MID_DB;
+        *rxvga2  = BLADERF_RXVGA2_GAIN_MIN;
     } else if (gain < (BLADERF_LNA_GAIN_MAX_DB + BLADERF_RXVGA1_GAIN_MAX + BLADERF_RXVGA2_GAIN_MAX)) {
-        return set_rx_gain_combo(dev,
-                BLADERF_LNA_GAIN_MAX,
-                BLADERF_RXVGA1_GAIN_MAX,
-                gain - (BLADERF_LNA_GAIN_MAX_DB + BLADERF_RXVGA1_GAIN_MAX));
+        *lnagain = BLADERF_LNA_GAIN_MAX;
+        *rxvga1  = BLADERF_RXVGA1_GAIN_MAX;
+        *rxvga2  = gain - (BLADERF_LNA_GAIN_MAX_DB + BLADERF_RXVGA1_GAIN_MAX);
     } else {
-        return set_rx_gain_combo(dev,
-                                 BLADERF_LNA_GAIN_MAX,
-                                 BLADERF_RXVGA1_GAIN_MAX,
-                                 BLADERF_RXVGA2_GAIN_MAX);
+        *lnagain = BLADERF_LNA_GAIN_MAX;
+        *rxvga1  = BLADERF_RXVGA1_GAIN_MAX;
+        *rxvga2  = BLADERF_RXVGA2_GAIN_MAX;
     }
 }
 
-static inline int set_tx_gain_combo(struct bladerf *dev, int txvga1, int txvga2)
+static void tx_gain_stages(int gain, int *txvga1, int *txvga2)
 {
-    int status;
-
-    status = lms_txvga1_set_gain(dev, txvga1);
-    if (status == 0) {
-        status = lms_txvga2_set_gain(dev, txvga2);
-    }
-
-    return status;
-}
-
-static int set_tx_gain(struct bladerf *dev, int gain)
-{
-    int status;
     const int max_gain =
         (BLADERF_TXVGA1_GAIN_MAX - BLADERF_TXVGA1_GAIN_MIN)
             + BLADERF_TXVGA2_GAIN_MAX;
@@ -93,28 +60,39 @@ static int set_tx_gain(struct bladerf *dev, int gain)
     }
 
     if (gain <= BLADERF_TXVGA2_GAIN_MAX) {
-        status = set_tx_gain_combo(dev, BLADERF_TXVGA1_GAIN_MIN, gain);
+        *txvga1 = BLADERF_TXVGA1_GAIN_MIN;
+        *txvga2 = gain;
     } else if (gain <= max_gain) {
-        status = set_tx_gain_combo(dev,
-                    BLADERF_TXVGA1_GAIN_MIN + gain - BLADERF_TXVGA2_GAIN_MAX,
-                    BLADERF_TXVGA2_GAIN_MAX);
+        *txvga1 = BLADERF_TXVGA1_GAIN_MIN + gain - BLADERF_TXVGA2_GAIN_MAX;
+        *txvga2 = BLADERF_TXVGA2_GAIN_MAX;
     } else {
-        status = set_tx_gain_combo(dev,
-                                   BLADERF_TXVGA1_GAIN_MAX,
-                                   BLADERF_TXVGA2_GAIN_MAX);
+        *txvga1 = BLADERF_TXVGA1_GAIN_MAX;
+        *txvga2 = BLADERF_TXVGA2_GAIN_MAX;
     }
-
-    return status;
 }
 
-int gain_set(struct bladerf *dev, bladerf_module module, int gain)
+/* Compute the LMS register writes required to apply the specified system
+ * gain. `regs` must have room for BACKEND_SCHEDULED_WRITES_MAX entries. */
+static int gain_regs(struct bladerf *dev, bladerf_module module, int gain,
+                     struct backend_reg_access *regs, size_t *count)
 {
     int status;
 
     if (module == BLADERF_MODULE_TX) {
-        status = set_tx_gain(dev, gain);
+        int txvga1, txvga2;
+
+        tx_gain_stages(gain, &txvga1, &txvga2);
+        status = lms_get_tx_gain_regs(dev, txvga1, txvga2, regs);
+        *count = LMS_TX_GAIN_NUM_REGS;
+
     } else if (module == BLADERF_MODULE_RX) {
-        status = set_rx_gain(dev, gain);
+        bladerf_lna_gain lnagain;
+        int rxvga1, rxvga2;
+
+        rx_gain_stages(gain, &lnagain, &rxvga1, &rxvga2);
+        status = lms_get_rx_gain_regs(dev, lnagain, rxvga1, rxvga2, regs);
+        *count = LMS_RX_GAIN_NUM_REGS;
+
     } else {
         status = BLADERF_ERR_INVAL;
     }
@@ -122,3 +100,45 @@ int gain_set(struct bladerf *dev, bladerf_module module, int gain)
     return status;
 }
 
+int gain_set(struct bladerf *dev, bladerf_module module, int gain)
+{
+    int status;
+    size_t count;
+    struct backend_reg_access regs[BACKEND_SCHEDULED_WRITES_MAX];
+
+    status = gain_regs(dev, module, gain, regs, &count);
+    if (status == 0) {
+        status = lms_access_batch(dev, regs, count);
+    }
+
+    return status;
+}
+
+int gain_schedule(struct bladerf *dev, bladerf_module module,
+                  uint64_t timestamp, int gain)
+{
+    int status;
+    size_t i, count;
+    struct backend_reg_access regs[BACKEND_SCHEDULED_WRITES_MAX];
+
+    if (dev->fn->schedule_lms_writes == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 4)) {
+        log_warning("Scheduled gain changes require FPGA v0.1.4 or later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    status = gain_regs(dev, module, gain, regs, &count);
+    if (status != 0) {
+        return status;
+    }
+
+    /* The FPGA will write these registers behind our back */
+    for (i = 0; i < count; i++) {
+        lms_shadow_mark_volatile(dev, regs[i].addr);
+    }
+
+    return dev->fn->schedule_lms_writes(dev, module, timestamp, regs, count);
+}
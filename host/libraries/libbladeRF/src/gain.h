@@ -38,6 +38,20 @@
  */
 int gain_set(struct bladerf *dev, bladerf_module module, int gain);
 
+/**
+ * Queue a change of system gain for the specified module, to be applied by
+ * the FPGA once the module's timestamp counter reaches `timestamp`
+ *
+ * @param   dev         Device handle
+ * @param   module      Module to configure
+ * @param   timestamp   Timestamp at which to apply the gain
+ * @param   gain        Desired gain
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int gain_schedule(struct bladerf *dev, bladerf_module module,
+                  uint64_t timestamp, int gain);
+
 /* TODO gain_get() */
 
 #endif
@@ -0,0 +1,399 @@
+/*
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <libbladeRF.h>
+
+#include "bladerf_priv.h"
+#include "hop.h"
+#include "log.h"
+
+#ifdef CLOCK_MONOTONIC
+#   define HOP_CLOCK CLOCK_MONOTONIC
+#else
+#   define HOP_CLOCK CLOCK_REALTIME
+#endif
+
+static int host_time_us(uint64_t *t_us)
+{
+    struct timespec t;
+
+    if (clock_gettime(HOP_CLOCK, &t) != 0) {
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    *t_us = (uint64_t) t.tv_sec * 1000000 + t.tv_nsec / 1000;
+    return 0;
+}
+
+static inline uint64_t samples_to_us(const struct hopper *h, uint64_t n)
+{
+    return (uint64_t) (n * 1e6 / h->rate);
+}
+
+/* Wait for up to `us` microseconds, or until a stop is requested. The caller
+ * must hold h->lock. */
+static void wait_us(struct hopper *h, uint64_t us)
+{
+    static const long nsec_per_sec = 1000 * 1000 * 1000;
+    struct timespec t;
+
+    if (clock_gettime(CLOCK_REALTIME, &t) != 0) {
+        return;
+    }
+
+    t.tv_sec += (time_t) (us / 1000000);
+    t.tv_nsec += (long) (us % 1000000) * 1000;
+
+    if (t.tv_nsec >= nsec_per_sec) {
+        t.tv_sec += t.tv_nsec / nsec_per_sec;
+        t.tv_nsec %= nsec_per_sec;
+    }
+
+    pthread_cond_timedwait(&h->stop_requested, &h->lock, &t);
+}
+
+static void record(struct hopper *h, int64_t margin, uint64_t request_us)
+{
+    struct bladerf_hop_stats *s = &h->stats;
+
+    MUTEX_LOCK(&h->lock);
+
+    if (s->hops == 0 || margin < s->margin_min) {
+        s->margin_min = margin;
+    }
+
+    if (s->hops == 0 || margin > s->margin_max) {
+        s->margin_max = margin;
+    }
+
+    if (margin < 0) {
+        s->late++;
+    }
+
+    if (request_us > s->request_us_max) {
+        s->request_us_max = request_us;
+    }
+
+    s->hops++;
+    h->margin_total += (double) margin;
+    h->request_us_total += (double) request_us;
+
+    MUTEX_UNLOCK(&h->lock);
+}
+
+/* Retune to, or queue, the next hop and note how far ahead of its timestamp
+ * this completed */
+static int hop_once(struct hopper *h)
+{
+    int status;
+    uint64_t t0, t1, now;
+    const struct bladerf_quick_tune *qt = &h->tunes[h->next_index];
+
+    status = host_time_us(&t0);
+    if (status != 0) {
+        return status;
+    }
+
+    if (h->mode == BLADERF_HOP_HOST) {
+        status = bladerf_quick_retune(h->dev, h->module, qt);
+    } else {
+        status = bladerf_schedule_retune(h->dev, h->module,
+                                         h->next_timestamp, qt);
+    }
+
+    if (status != 0) {
+        return status;
+    }
+
+    status = host_time_us(&t1);
+    if (status == 0) {
+        status = bladerf_get_timestamp(h->dev, h->module, &now);
+    }
+
+    if (status != 0) {
+        return status;
+    }
+
+    record(h, (int64_t) (h->next_timestamp - now), t1 - t0);
+
+    h->next_timestamp += h->dwell;
+    h->next_index = (h->next_index + 1) % h->num_tunes;
+
+    return 0;
+}
+
+/* The timestamp at which the next hop should be performed or queued */
+static inline uint64_t act_at(const struct hopper *h)
+{
+    const uint64_t lead = (HOP_QUEUE_AHEAD - 1) * h->dwell;
+
+    if (h->mode == BLADERF_HOP_HOST) {
+        return h->next_timestamp;
+    } else if (h->next_timestamp < lead) {
+        return 0;
+    } else {
+        return h->next_timestamp - lead;
+    }
+}
+
+static void *hop_task(void *arg)
+{
+    struct hopper *h = (struct hopper *) arg;
+    int status = 0;
+    bool stop = false;
+
+    while (!stop) {
+        uint64_t now, target, us;
+
+        status = bladerf_get_timestamp(h->dev, h->module, &now);
+        if (status != 0) {
+            break;
+        }
+
+        target = act_at(h);
+        us = (now < target) ? samples_to_us(h, target - now) : 0;
+
+        MUTEX_LOCK(&h->lock);
+
+        if (h->mode == BLADERF_HOP_HOST && us > HOP_SPIN_US) {
+            wait_us(h, us - HOP_SPIN_US);
+        } else if (h->mode == BLADERF_HOP_SCHEDULED && us > 0) {
+            wait_us(h, us);
+        }
+
+        stop = h->stop;
+        MUTEX_UNLOCK(&h->lock);
+
+        if (stop || now < target) {
+            continue;
+        }
+
+        status = hop_once(h);
+
+        if (status == BLADERF_ERR_QUEUE_FULL) {
+            /* Wait for the FPGA to perform a hop, freeing an entry */
+            MUTEX_LOCK(&h->lock);
+            if (!h->stop) {
+                wait_us(h, samples_to_us(h, h->dwell));
+            }
+            MUTEX_UNLOCK(&h->lock);
+            status = 0;
+        } else if (status != 0) {
+            break;
+        }
+    }
+
+    if (status != 0) {
+        log_debug("%s: Stopped hopping: %s\n", __FUNCTION__,
+                  bladerf_strerror(status));
+
+        MUTEX_LOCK(&h->lock);
+        h->stats.status = status;
+        MUTEX_UNLOCK(&h->lock);
+    }
+
+    return NULL;
+}
+
+void hop_init(struct hopper *h, struct bladerf *dev, bladerf_module module)
+{
+    memset(h, 0, sizeof(*h));
+
+    h->dev = dev;
+    h->module = module;
+
+    MUTEX_INIT(&h->ctl_lock);
+    MUTEX_INIT(&h->lock);
+    pthread_cond_init(&h->stop_requested, NULL);
+}
+
+int hop_config(struct hopper *h, const unsigned int *freqs,
+               unsigned int num_freqs, uint64_t dwell, bladerf_hop_mode mode)
+{
+    int status = 0;
+    unsigned int i;
+    struct bladerf_quick_tune *tunes;
+
+    if (num_freqs == 0 || dwell == 0 ||
+        (mode != BLADERF_HOP_HOST && mode != BLADERF_HOP_SCHEDULED)) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    tunes = calloc(num_freqs, sizeof(tunes[0]));
+    if (tunes == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    MUTEX_LOCK(&h->ctl_lock);
+
+    if (h->running) {
+        log_debug("%s: Hopping must be stopped first\n", __FUNCTION__);
+        status = BLADERF_ERR_INVAL;
+        goto out;
+    }
+
+    /* Tuning each channel once finds its VCOCAP and DC correction values */
+    for (i = 0; i < num_freqs && status == 0; i++) {
+        status = bladerf_set_frequency(h->dev, h->module, freqs[i]);
+        if (status == 0) {
+            status = bladerf_get_quick_tune(h->dev, h->module, &tunes[i]);
+        }
+    }
+
+    if (status != 0) {
+        goto out;
+    }
+
+    /* The FPGA does not switch bands when performing a scheduled retune */
+    if (mode == BLADERF_HOP_SCHEDULED) {
+        const bool high = tunes[0].frequency >= BLADERF_BAND_HIGH;
+
+        for (i = 1; i < num_freqs; i++) {
+            if ((tunes[i].frequency >= BLADERF_BAND_HIGH) != high) {
+                log_debug("%s: %u Hz is not in the same band as %u Hz\n",
+                          __FUNCTION__, freqs[i], freqs[0]);
+                status = BLADERF_ERR_INVAL;
+                goto out;
+            }
+        }
+    }
+
+    status = bladerf_quick_retune(h->dev, h->module, &tunes[0]);
+    if (status != 0) {
+        goto out;
+    }
+
+    free(h->tunes);
+    h->tunes = tunes;
+    h->num_tunes = num_freqs;
+    h->dwell = dwell;
+    h->mode = mode;
+    tunes = NULL;
+
+out:
+    MUTEX_UNLOCK(&h->ctl_lock);
+    free(tunes);
+    return status;
+}
+
+int hop_start(struct hopper *h, uint64_t timestamp)
+{
+    int status;
+    unsigned int rate;
+    uint64_t now;
+
+    MUTEX_LOCK(&h->ctl_lock);
+
+    if (h->running || h->tunes == NULL) {
+        log_debug("%s: Hopping is %s\n", __FUNCTION__,
+                  h->running ? "already running" : "not configured");
+        status = BLADERF_ERR_INVAL;
+        goto out;
+    }
+
+    status = bladerf_get_sample_rate(h->dev, h->module, &rate);
+    if (status != 0) {
+        goto out;
+    } else if (rate == 0) {
+        status = BLADERF_ERR_UNEXPECTED;
+        goto out;
+    }
+
+    status = bladerf_get_timestamp(h->dev, h->module, &now);
+    if (status != 0) {
+        goto out;
+    }
+
+    h->rate = rate;
+    h->next_timestamp = (timestamp == BLADERF_HOP_NOW) ? now : timestamp;
+    h->next_index = 0;
+
+    MUTEX_LOCK(&h->lock);
+    memset(&h->stats, 0, sizeof(h->stats));
+    h->margin_total = 0;
+    h->request_us_total = 0;
+    h->stop = false;
+    MUTEX_UNLOCK(&h->lock);
+
+    /* Queue the first hop here, so that a lack of FPGA support is reported
+     * to the caller */
+    if (h->mode == BLADERF_HOP_SCHEDULED) {
+        status = hop_once(h);
+        if (status != 0) {
+            goto out;
+        }
+    }
+
+    status = pthread_create(&h->thread, NULL, hop_task, h);
+    if (status != 0) {
+        log_error("Failed to start hopping thread: %s\n", strerror(status));
+        status = BLADERF_ERR_UNEXPECTED;
+        goto out;
+    }
+
+    h->running = true;
+
+out:
+    MUTEX_UNLOCK(&h->ctl_lock);
+    return status;
+}
+
+void hop_stop(struct hopper *h)
+{
+    MUTEX_LOCK(&h->ctl_lock);
+
+    if (h->running) {
+        MUTEX_LOCK(&h->lock);
+        h->stop = true;
+        pthread_cond_signal(&h->stop_requested);
+        MUTEX_UNLOCK(&h->lock);
+
+        pthread_join(h->thread, NULL);
+        h->running = false;
+    }
+
+    MUTEX_UNLOCK(&h->ctl_lock);
+}
+
+void hop_get_stats(struct hopper *h, struct bladerf_hop_stats *stats)
+{
+    MUTEX_LOCK(&h->lock);
+
+    *stats = h->stats;
+
+    if (h->stats.hops != 0) {
+        stats->margin_mean = h->margin_total / h->stats.hops;
+        stats->request_us_mean = h->request_us_total / h->stats.hops;
+    }
+
+    MUTEX_UNLOCK(&h->lock);
+}
+
+void hop_deinit(struct hopper *h)
+{
+    hop_stop(h);
+
+    MUTEX_LOCK(&h->ctl_lock);
+    free(h->tunes);
+    h->tunes = NULL;
+    h->num_tunes = 0;
+    MUTEX_UNLOCK(&h->ctl_lock);
+}
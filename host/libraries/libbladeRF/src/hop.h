@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef BLADERF_HOP_H_
+#define BLADERF_HOP_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <libbladeRF.h>
+#include "thread.h"
+
+/* In BLADERF_HOP_HOST mode, the hop thread sleeps until it is within this
+ * many microseconds of a hop, and then polls the timestamp counter */
+#ifndef HOP_SPIN_US
+#   define HOP_SPIN_US 2000
+#endif
+
+/* In BLADERF_HOP_SCHEDULED mode, up to this many hops are kept queued in the
+ * FPGA. The queue is shared with other scheduled retunes and gain changes,
+ * and holds 16 entries. */
+#ifndef HOP_QUEUE_AHEAD
+#   define HOP_QUEUE_AHEAD 8
+#endif
+
+struct bladerf;
+
+struct hopper {
+    struct bladerf *dev;
+    bladerf_module module;
+
+    /* Serializes configuration, starting and stopping of the thread */
+    MUTEX ctl_lock;
+    bool running;
+    pthread_t thread;
+
+    /* Set by hop_config(), and only read while running */
+    struct bladerf_quick_tune *tunes;
+    unsigned int num_tunes;
+    uint64_t dwell;
+    bladerf_hop_mode mode;
+    double rate;                /* Sample rate, for converting to time */
+
+    /* Owned by the thread while running */
+    uint64_t next_timestamp;    /* Timestamp of the next hop */
+    unsigned int next_index;    /* Channel of the next hop */
+
+    /* Protects all of the following */
+    MUTEX lock;
+    pthread_cond_t stop_requested;
+    bool stop;
+    struct bladerf_hop_stats stats;
+    double margin_total;
+    double request_us_total;
+};
+
+/**
+ * Initialize a hopper. It is unconfigured and stopped.
+ *
+ * @param   h           Hopper to initialize
+ * @param   dev         Device handle
+ * @param   module      Module to hop
+ */
+void hop_init(struct hopper *h, struct bladerf *dev, bladerf_module module);
+
+/**
+ * Capture the quick tune parameters of each channel, leaving the module
+ * tuned to the first. The hopper must be stopped. The caller must not hold
+ * any of dev->ctrl_lock[].
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int hop_config(struct hopper *h, const unsigned int *freqs,
+               unsigned int num_freqs, uint64_t dwell, bladerf_hop_mode mode);
+
+/**
+ * Start hopping, with the first hop at `timestamp`. The caller must not hold
+ * any of dev->ctrl_lock[].
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int hop_start(struct hopper *h, uint64_t timestamp);
+
+/**
+ * Stop hopping, if the hopper is running. Hops already queued in the FPGA
+ * are still performed. The caller must not hold any of dev->ctrl_lock[].
+ */
+void hop_stop(struct hopper *h);
+
+/**
+ * Get the hopper's statistics
+ */
+void hop_get_stats(struct hopper *h, struct bladerf_hop_stats *stats);
+
+/**
+ * Stop the hopper and free its channels
+ */
+void hop_deinit(struct hopper *h);
+
+#endif
@@ -91,32 +91,31 @@ static void sha256_buffer(const char *buf, size_t len,
     SHA256_Final((uint8_t*)digest, &ctx);
 }
 
-static int verify_checksum(uint8_t *buf, size_t buf_len)
+/* Verify the checksum of a serialized image. The checksum is computed with
+ * the checksum field treated as zeros, so it is streamed around that field
+ * rather than cleared in (a copy of) the buffer. */
+static int verify_checksum(const uint8_t *buf, size_t buf_len)
 {
-    char checksum_expected[SHA256_DIGEST_SIZE];
-    char checksum_calc[SHA256_DIGEST_SIZE];
+    SHA256_CTX ctx;
+    const size_t checksum_end = BLADERF_IMAGE_MAGIC_LEN + SHA256_DIGEST_SIZE;
+    static const uint8_t zeros[SHA256_DIGEST_SIZE] = { 0 };
+    uint8_t checksum_calc[SHA256_DIGEST_SIZE];
 
     if (buf_len <= CALC_IMAGE_SIZE(0)) {
         log_debug("Provided buffer isn't a full image\n");
         return BLADERF_ERR_INVAL;
     }
 
-    /* Backup and clear the expected checksum before we calculate the
-     * expected checksum */
-    memcpy(checksum_expected, &buf[BLADERF_IMAGE_MAGIC_LEN],
-           sizeof(checksum_expected));
-
-    memset(&buf[BLADERF_IMAGE_MAGIC_LEN], 0, SHA256_DIGEST_SIZE);
-
-    sha256_buffer((const char *)buf, buf_len, checksum_calc);
+    SHA256_Init(&ctx);
+    SHA256_Update(&ctx, buf, BLADERF_IMAGE_MAGIC_LEN);
+    SHA256_Update(&ctx, zeros, sizeof(zeros));
+    SHA256_Update(&ctx, &buf[checksum_end], buf_len - checksum_end);
+    SHA256_Final(checksum_calc, &ctx);
 
-    if (memcmp(checksum_expected, checksum_calc, SHA256_DIGEST_SIZE) != 0) {
+    if (memcmp(&buf[BLADERF_IMAGE_MAGIC_LEN], checksum_calc,
+               SHA256_DIGEST_SIZE) != 0) {
         return BLADERF_ERR_CHECKSUM;
     } else {
-        /* Restore the buffer's checksum so the caller can still use it */
-        memcpy(&buf[BLADERF_IMAGE_MAGIC_LEN], checksum_expected,
-               sizeof(checksum_expected));
-
         return 0;
     }
 }
@@ -139,14 +138,14 @@ static bool image_type_is_valid(bladerf_image_type type) {
     }
 }
 
-/* Serialize image contents and fill in checksum */
-static size_t pack_image(struct bladerf_image *img, uint8_t *buf)
+/* Serialize image metadata, with the checksum field cleared. The image's
+ * data follows the CALC_IMAGE_SIZE(0) bytes that this produces. */
+static size_t pack_header(const struct bladerf_image *img, uint8_t *buf)
 {
     size_t i = 0;
     uint16_t ver_field;
     uint32_t type, len, addr;
     uint64_t timestamp;
-    char checksum[BLADERF_IMAGE_CHECKSUM_LEN];
 
     memcpy(&buf[i], img->magic, BLADERF_IMAGE_MAGIC_LEN);
     i += BLADERF_IMAGE_MAGIC_LEN;
@@ -188,6 +187,15 @@ static size_t pack_image(struct bladerf_image *img, uint8_t *buf)
     memcpy(&buf[i], &len, sizeof(len));
     i += sizeof(len);
 
+    return i;
+}
+
+/* Serialize image contents and fill in checksum */
+static size_t pack_image(struct bladerf_image *img, uint8_t *buf)
+{
+    size_t i = pack_header(img, buf);
+    char checksum[BLADERF_IMAGE_CHECKSUM_LEN];
+
     memcpy(&buf[i], img->data, img->length);
     i += img->length;
 
@@ -197,17 +205,13 @@ static size_t pack_image(struct bladerf_image *img, uint8_t *buf)
     return i;
 }
 
-/* Unpack flash image from file and validate fields */
-static int unpack_image(struct bladerf_image *img, uint8_t *buf, size_t len)
+/* Unpack and validate the CALC_IMAGE_SIZE(0) bytes of image metadata at the
+ * start of `buf`. img->data is not modified. */
+static int unpack_header(struct bladerf_image *img, const uint8_t *buf)
 {
     size_t i = 0;
     uint32_t type;
 
-    /* Ensure we have at least a full set of metadata */
-    if (len < CALC_IMAGE_SIZE(0)) {
-        return BLADERF_ERR_INVAL;
-    }
-
     memcpy(img->magic, &buf[i], BLADERF_IMAGE_MAGIC_LEN);
     img->magic[BLADERF_IMAGE_MAGIC_LEN] = '\0';
     if (strncmp(img->magic, image_magic, BLADERF_IMAGE_MAGIC_LEN)) {
@@ -260,26 +264,45 @@ static int unpack_image(struct bladerf_image *img, uint8_t *buf, size_t len)
     i += sizeof(img->length);
     img->length = BE32_TO_HOST(img->length);
 
+    return 0;
+}
+
+/* Unpack flash image from file and validate fields. On success, img->data
+ * is a heap-allocated copy of the image's data. */
+static int unpack_image(struct bladerf_image *img, const uint8_t *buf,
+                        size_t len)
+{
+    int status;
+    const size_t i = CALC_IMAGE_SIZE(0);
+
+    /* Ensure we have at least a full set of metadata */
+    if (len < CALC_IMAGE_SIZE(0)) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    status = unpack_header(img, buf);
+    if (status != 0) {
+        return status;
+    }
+
     if (len != CALC_IMAGE_SIZE(img->length)) {
         log_debug("Image contains more or less data than expected\n");
         return BLADERF_ERR_INVAL;
     }
 
-    /* Just slide the data over */
-    memmove(&buf[0], &buf[i], img->length);
-    img->data = buf;
+    img->data = (uint8_t *) malloc(img->length);
+    if (img->data == NULL) {
+        return BLADERF_ERR_MEM;
+    }
 
+    memcpy(img->data, &buf[i], img->length);
     return 0;
 }
 
 
-int bladerf_image_write(struct bladerf_image *img, const char *file)
+/* Check the metadata of an image that is to be written */
+static int check_image_metadata(const struct bladerf_image *img)
 {
-    int rv;
-    FILE *f = NULL;
-    uint8_t *buf = NULL;
-    size_t buf_len;
-
     /* Ensure the format identifier is correct */
     if (memcmp(img->magic, image_magic, BLADERF_IMAGE_MAGIC_LEN) != 0) {
 #ifdef LOGGING_ENABLED
@@ -297,6 +320,33 @@ int bladerf_image_write(struct bladerf_image *img, const char *file)
         return BLADERF_ERR_INVAL;
     }
 
+    /* If the type is RAW, we should only allow erase-block aligned
+     * addresses and lengths */
+    if (img->type == BLADERF_IMAGE_TYPE_RAW) {
+        if (img->address % BLADERF_FLASH_EB_SIZE != 0) {
+            log_debug("Image address must be erase block-aligned for RAW.\n");
+            return BLADERF_ERR_INVAL;
+        } else if (img->length % BLADERF_FLASH_EB_SIZE != 0) {
+            log_debug("Image length must be erase block-aligned for RAW.\n");
+            return BLADERF_ERR_INVAL;
+        }
+    }
+
+    return 0;
+}
+
+int bladerf_image_write(struct bladerf_image *img, const char *file)
+{
+    int rv;
+    FILE *f = NULL;
+    uint8_t *buf = NULL;
+    size_t buf_len;
+
+    rv = check_image_metadata(img);
+    if (rv != 0) {
+        return rv;
+    }
+
     /* Just to be tiny bit paranoid... */
     if (!img->data) {
         log_debug("Image data pointer is NULL\n");
@@ -310,20 +360,6 @@ int bladerf_image_write(struct bladerf_image *img, const char *file)
         return BLADERF_ERR_MEM;
     }
 
-    /* If the type is RAW, we should only allow erase-block aligned
-     * addresses and lengths */
-    if (img->type == BLADERF_IMAGE_TYPE_RAW) {
-        if (img->address % BLADERF_FLASH_EB_SIZE != 0) {
-            log_debug("Image address must be erase block-aligned for RAW.\n");
-            rv = BLADERF_ERR_INVAL;
-            goto error;
-        } else if (img->length % BLADERF_FLASH_EB_SIZE != 0) {
-            log_debug("Image length must be erase block-aligned for RAW.\n");
-            rv = BLADERF_ERR_INVAL;
-            goto error;
-        }
-    }
-
     pack_image(img, buf);
 
     f = fopen(file, "wb");
@@ -345,30 +381,243 @@ error:
 
 int bladerf_image_read(struct bladerf_image *img, const char *file)
 {
-    int rv = -1;
-    uint8_t *buf = NULL;
-    size_t buf_len;
+    int rv;
+    struct file_mapping map;
 
-    rv = file_read_buffer(file, &buf, &buf_len);
+    rv = file_map(file, &map);
     if (rv < 0) {
-        goto bladerf_image_read_out;
+        return rv;
     }
 
-    rv = verify_checksum(buf, buf_len);
-    if (rv < 0) {
-        goto bladerf_image_read_out;
+    rv = verify_checksum(map.data, map.len);
+    if (rv == 0) {
+        rv = unpack_image(img, map.data, map.len);
     }
 
-    /* Note: On success, buf->data = buf, with the data memmove'd over.
-     *       Static analysis tools might indicate a false postive leak when
-     *       buf goes out of scope with rv == 0 */
-    rv = unpack_image(img, buf, buf_len);
+    file_unmap(&map);
+    return rv;
+}
 
-bladerf_image_read_out:
+struct bladerf_image_stream {
+    FILE *f;
+    bool writing;
+    SHA256_CTX ctx;         /* Checksum of the file written thus far */
+    uint32_t length;        /* Length of the image's data */
+    uint32_t offset;        /* Bytes of data written or read thus far */
+    int status;             /* First error encountered while writing */
+};
+
+int bladerf_image_stream_create(struct bladerf_image_stream **stream,
+                                const struct bladerf_image *img,
+                                const char *file)
+{
+    int rv;
+    struct bladerf_image_stream *s;
+    uint8_t header[CALC_IMAGE_SIZE(0)];
+
+    *stream = NULL;
+
+    rv = check_image_metadata(img);
     if (rv != 0) {
-        free(buf);
+        return rv;
+    }
+
+    s = (struct bladerf_image_stream *) calloc(1, sizeof(*s));
+    if (s == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    s->f = fopen(file, "wb");
+    if (s->f == NULL) {
+        log_debug("Failed to open \"%s\": %s\n", file, strerror(errno));
+        free(s);
+        return BLADERF_ERR_IO;
+    }
+
+    s->writing = true;
+    s->length = img->length;
+
+    /* The checksum field is filled in once all of the data has been
+     * written, and is treated as zeros when computing the checksum */
+    pack_header(img, header);
+    SHA256_Init(&s->ctx);
+    SHA256_Update(&s->ctx, header, sizeof(header));
+
+    rv = file_write(s->f, header, sizeof(header));
+    if (rv != 0) {
+        fclose(s->f);
+        free(s);
+        return rv;
+    }
+
+    *stream = s;
+    return 0;
+}
+
+int bladerf_image_stream_open(struct bladerf_image_stream **stream,
+                              struct bladerf_image *img, const char *file)
+{
+    int rv;
+    struct bladerf_image_stream *s;
+    uint8_t header[CALC_IMAGE_SIZE(0)];
+    uint8_t chunk[4096];
+    uint8_t checksum[SHA256_DIGEST_SIZE];
+    static const uint8_t zeros[SHA256_DIGEST_SIZE] = { 0 };
+    const size_t checksum_end = BLADERF_IMAGE_MAGIC_LEN + SHA256_DIGEST_SIZE;
+    size_t n;
+    uint32_t remaining;
+
+    *stream = NULL;
+
+    s = (struct bladerf_image_stream *) calloc(1, sizeof(*s));
+    if (s == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    s->f = fopen(file, "rb");
+    if (s->f == NULL) {
+        log_debug("Failed to open \"%s\": %s\n", file, strerror(errno));
+        free(s);
+        return BLADERF_ERR_IO;
+    }
+
+    rv = file_read(s->f, (char *) header, sizeof(header));
+    if (rv != 0) {
+        goto error;
+    }
+
+    rv = unpack_header(img, header);
+    if (rv != 0) {
+        goto error;
+    }
+
+    /* Verify the checksum over the entire file up front, such that none of
+     * the data of a corrupted image is provided */
+    SHA256_Init(&s->ctx);
+    SHA256_Update(&s->ctx, header, BLADERF_IMAGE_MAGIC_LEN);
+    SHA256_Update(&s->ctx, zeros, sizeof(zeros));
+    SHA256_Update(&s->ctx, &header[checksum_end],
+                  sizeof(header) - checksum_end);
+
+    for (remaining = img->length; remaining != 0; remaining -= n) {
+        n = remaining < sizeof(chunk) ? remaining : sizeof(chunk);
+
+        rv = file_read(s->f, (char *) chunk, n);
+        if (rv != 0) {
+            log_debug("Image contains less data than expected\n");
+            rv = BLADERF_ERR_INVAL;
+            goto error;
+        }
+
+        SHA256_Update(&s->ctx, chunk, n);
+    }
+
+    if (fread(chunk, 1, 1, s->f) != 0) {
+        log_debug("Image contains more data than expected\n");
+        rv = BLADERF_ERR_INVAL;
+        goto error;
+    }
+
+    SHA256_Final(checksum, &s->ctx);
+    if (memcmp(img->checksum, checksum, SHA256_DIGEST_SIZE) != 0) {
+        rv = BLADERF_ERR_CHECKSUM;
+        goto error;
+    }
+
+    if (fseek(s->f, (long) sizeof(header), SEEK_SET) != 0) {
+        log_debug("fseek failed: %s\n", strerror(errno));
+        rv = BLADERF_ERR_IO;
+        goto error;
+    }
+
+    s->writing = false;
+    s->length = img->length;
+    *stream = s;
+    return 0;
+
+error:
+    fclose(s->f);
+    free(s);
+    return rv;
+}
+
+int bladerf_image_stream_write(struct bladerf_image_stream *s,
+                               const uint8_t *data, size_t len)
+{
+    int rv;
+
+    if (!s->writing || len > (s->length - s->offset)) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (s->status != 0) {
+        return s->status;
+    }
+
+    SHA256_Update(&s->ctx, data, len);
+
+    rv = file_write(s->f, (uint8_t *) data, len);
+    if (rv != 0) {
+        s->status = rv;
+        return rv;
+    }
+
+    s->offset += (uint32_t) len;
+    return 0;
+}
+
+int bladerf_image_stream_read(struct bladerf_image_stream *s,
+                              uint8_t *data, size_t len)
+{
+    int rv;
+
+    if (s->writing || len > (s->length - s->offset)) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    rv = file_read(s->f, (char *) data, len);
+    if (rv != 0) {
+        return rv;
+    }
+
+    s->offset += (uint32_t) len;
+    return 0;
+}
+
+int bladerf_image_stream_close(struct bladerf_image_stream *s)
+{
+    int rv = 0;
+    uint8_t checksum[SHA256_DIGEST_SIZE];
+
+    if (s == NULL) {
+        return 0;
+    }
+
+    if (s->writing) {
+        if (s->status != 0) {
+            rv = s->status;
+        } else if (s->offset != s->length) {
+            log_debug("Image stream closed after %u of %u bytes\n",
+                      s->offset, s->length);
+            rv = BLADERF_ERR_INVAL;
+        } else {
+            SHA256_Final(checksum, &s->ctx);
+
+            if (fseek(s->f, BLADERF_IMAGE_MAGIC_LEN, SEEK_SET) != 0) {
+                log_debug("fseek failed: %s\n", strerror(errno));
+                rv = BLADERF_ERR_IO;
+            } else {
+                rv = file_write(s->f, checksum, sizeof(checksum));
+            }
+        }
+    }
+
+    if (fclose(s->f) != 0 && rv == 0 && s->writing) {
+        log_debug("Failed to close image file: %s\n", strerror(errno));
+        rv = BLADERF_ERR_IO;
     }
 
+    free(s);
     return rv;
 }
 
@@ -39,11 +39,15 @@
  *  http://www.limemicro.com/download/FAQ_v1.0r10.pdf
  *
  */
+#include <stdlib.h>
+#include <string.h>
 #include <libbladeRF.h>
 #include "lms.h"
 #include "bladerf_priv.h"
+#include "tuning.h"
 #include "log.h"
 #include "rel_assert.h"
+#include "version_compat.h"
 
 #define kHz(x) (x * 1000)
 #define MHz(x) (x * 1000000)
@@ -235,21 +239,16 @@ static inline int is_loopback_enabled(struct bladerf *dev)
     return loopback != BLADERF_LB_NONE;
 }
 
-static int write_pll_config(struct bladerf *dev, bladerf_module module,
-                                     uint32_t frequency, uint8_t freqsel)
+/* Compute the value of the PLL configuration register (base + 5) */
+static int get_pll_config(struct bladerf *dev, bladerf_module module,
+                          uint32_t frequency, uint8_t freqsel,
+                          uint8_t *regval)
 {
     int status;
-    uint8_t regval;
     uint8_t selout;
-    uint8_t addr;
-
-    if (module == BLADERF_MODULE_TX) {
-        addr = 0x15;
-    } else {
-        addr = 0x25;
-    }
+    const uint8_t addr = (module == BLADERF_MODULE_TX) ? 0x15 : 0x25;
 
-    status = LMS_READ(dev, addr, &regval);
+    status = LMS_READ(dev, addr, regval);
     if (status != 0) {
         return status;
     }
@@ -262,10 +261,25 @@ static int write_pll_config(struct bladerf *dev, bladerf_module module,
     if (status == 0) {
         /* Loopback not enabled - update the PLL output buffer. */
         selout = (frequency < BLADERF_BAND_HIGH ? 1 : 2);
-        regval = (freqsel << 2) | selout;
+        *regval = (freqsel << 2) | selout;
     } else {
         /* Loopback is enabled - don't touch PLL output buffer. */
-        regval = (regval & ~0xfc) | (freqsel << 2);
+        *regval = (*regval & ~0xfc) | (freqsel << 2);
+    }
+
+    return 0;
+}
+
+static int write_pll_config(struct bladerf *dev, bladerf_module module,
+                                     uint32_t frequency, uint8_t freqsel)
+{
+    int status;
+    uint8_t regval;
+    const uint8_t addr = (module == BLADERF_MODULE_TX) ? 0x15 : 0x25;
+
+    status = get_pll_config(dev, module, frequency, freqsel, &regval);
+    if (status != 0) {
+        return status;
     }
 
     return LMS_WRITE(dev, addr, regval);
@@ -508,6 +522,9 @@ int lms_soft_reset(struct bladerf *dev)
 
     int status = LMS_WRITE(dev, 0x05, 0x12);
 
+    /* All registers return to their defaults */
+    lms_shadow_invalidate(dev);
+
     if (status == 0) {
         status = LMS_WRITE(dev, 0x05, 0x32);
     }
@@ -867,6 +884,80 @@ int lms_txvga1_get_gain(struct bladerf *dev, int *gain)
     return status;
 }
 
+static inline int clamp_gain(const char *stage, int gain, int min, int max)
+{
+    if (gain > max) {
+        log_info("Clamping %s gain to %ddB\n", stage, max);
+        return max;
+    } else if (gain < min) {
+        log_info("Clamping %s gain to %ddB\n", stage, min);
+        return min;
+    } else {
+        return gain;
+    }
+}
+
+static inline void gain_reg(struct backend_reg_access *reg,
+                            uint8_t addr, uint8_t data)
+{
+    reg->addr = addr;
+    reg->data = data;
+    reg->write = true;
+}
+
+int lms_get_rx_gain_regs(struct bladerf *dev, bladerf_lna_gain lnagain,
+                         int rxvga1, int rxvga2,
+                         struct backend_reg_access *regs)
+{
+    int status;
+    uint8_t data;
+
+    if (lnagain != BLADERF_LNA_GAIN_BYPASS && lnagain != BLADERF_LNA_GAIN_MID &&
+        lnagain != BLADERF_LNA_GAIN_MAX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    status = LMS_READ(dev, 0x75, &data);
+    if (status != 0) {
+        return status;
+    }
+
+    rxvga1 = clamp_gain("RXVGA1", rxvga1,
+                        BLADERF_RXVGA1_GAIN_MIN, BLADERF_RXVGA1_GAIN_MAX);
+
+    rxvga2 = clamp_gain("RXVGA2", rxvga2,
+                        BLADERF_RXVGA2_GAIN_MIN, BLADERF_RXVGA2_GAIN_MAX);
+
+    gain_reg(&regs[0], 0x75, (data & ~(3 << 6)) | ((lnagain & 3) << 6));
+    gain_reg(&regs[1], 0x76, rxvga1_lut_val2code[rxvga1]);
+    gain_reg(&regs[2], 0x65, rxvga2 / 3);
+
+    return 0;
+}
+
+int lms_get_tx_gain_regs(struct bladerf *dev, int txvga1, int txvga2,
+                         struct backend_reg_access *regs)
+{
+    int status;
+    uint8_t data;
+
+    status = LMS_READ(dev, 0x45, &data);
+    if (status != 0) {
+        return status;
+    }
+
+    txvga1 = clamp_gain("TXVGA1", txvga1,
+                        BLADERF_TXVGA1_GAIN_MIN, BLADERF_TXVGA1_GAIN_MAX);
+
+    txvga2 = clamp_gain("TXVGA2", txvga2,
+                        BLADERF_TXVGA2_GAIN_MIN, BLADERF_TXVGA2_GAIN_MAX);
+
+    gain_reg(&regs[0], 0x41, txvga1 + 35);
+    gain_reg(&regs[1], 0x45, (data & ~(0x1f << 3)) | ((txvga2 & 0x1f) << 3));
+
+    return 0;
+}
+
 static inline int enable_lna_power(struct bladerf *dev, bool enable)
 {
     int status;
@@ -1153,24 +1244,12 @@ static int loopback_rx(struct bladerf *dev, bladerf_loopback mode)
 /* Configure "switches" in loopback path */
 static int loopback_path(struct bladerf *dev, bladerf_loopback mode)
 {
-    int status;
-    uint8_t loopbben, lben_lbrf;
-
-    status = LMS_READ(dev, 0x46, &loopbben);
-    if (status != 0) {
-        return status;
-    }
-
-    status = LMS_READ(dev, 0x08, &lben_lbrf);
-    if (status != 0) {
-        return status;
-    }
+    struct lms_txn txn;
 
-    /* Default to baseband loopback being disabled  */
-    loopbben &= ~LOOBBBEN_MASK;
-
-    /* Default to RF and BB loopback options being disabled */
-    lben_lbrf &= ~(LBRFEN_MASK | LBEN_MASK);
+    /* Default to baseband loopback being disabled, and to RF and BB loopback
+     * options being disabled */
+    uint8_t loopbben = 0;
+    uint8_t lben_lbrf = 0;
 
     switch(mode) {
         case BLADERF_LB_BB_TXLPF_RXVGA2:
@@ -1212,12 +1291,11 @@ static int loopback_path(struct bladerf *dev, bladerf_loopback mode)
             return BLADERF_ERR_INVAL;
     }
 
-    status = LMS_WRITE(dev, 0x46, loopbben);
-    if (status == 0) {
-        status = LMS_WRITE(dev, 0x08, lben_lbrf);
-    }
+    lms_txn_begin(&txn, dev);
+    lms_txn_modify(&txn, 0x46, LOOBBBEN_MASK, loopbben);
+    lms_txn_modify(&txn, 0x08, LBRFEN_MASK | LBEN_MASK, lben_lbrf);
 
-    return status;
+    return lms_txn_commit(&txn);
 }
 
 
@@ -1445,43 +1523,22 @@ int lms_get_frequency(struct bladerf *dev, bladerf_module mod,
 {
     const uint8_t base = (mod == BLADERF_MODULE_RX) ? 0x20 : 0x10;
     int status;
-    uint8_t data;
-
-    status = LMS_READ(dev, base + 0, &data);
-    if (status != 0) {
-        return status;
-    }
-
-    f->nint = ((uint16_t)data) << 1;
-
-    status = LMS_READ(dev, base + 1, &data);
-    if (status != 0) {
-        return status;
-    }
-
-    f->nint |= (data & 0x80) >> 7;
-    f->nfrac = ((uint32_t)data & 0x7f) << 16;
-
-    status = LMS_READ(dev, base + 2, &data);
-    if (status != 0) {
-        return status;
-    }
-
-    f->nfrac |= ((uint32_t)data)<<8;
+    uint8_t data[6];
 
-    status = LMS_READ(dev, base + 3, &data);
+    /* PLL registers base + 0 through base + 5, with FREQSEL in base + 5 */
+    status = lms_read_burst(dev, base, data, sizeof(data));
     if (status != 0) {
         return status;
     }
 
-    f->nfrac |= data;
+    f->nint = ((uint16_t)data[0]) << 1;
+    f->nint |= (data[1] & 0x80) >> 7;
 
-    status = LMS_READ(dev, base + 5, &data);
-    if (status != 0) {
-        return status;
-    }
+    f->nfrac = ((uint32_t)data[1] & 0x7f) << 16;
+    f->nfrac |= ((uint32_t)data[2])<<8;
+    f->nfrac |= data[3];
 
-    f->freqsel = (data>>2);
+    f->freqsel = (data[5]>>2);
     f->x = 1 << ((f->freqsel & 7) - 3);
     f->reference = 38400000;
 
@@ -1491,157 +1548,276 @@ int lms_get_frequency(struct bladerf *dev, bladerf_module mod,
 #define VCO_HIGH 0x02
 #define VCO_NORM 0x00
 #define VCO_LOW 0x01
-static inline int tune_vcocap(struct bladerf *dev, uint8_t base, uint8_t data)
+
+/* Steps of a VCOCAP search. Each step tests one VCOCAP value. */
+typedef enum {
+    VCOCAP_CACHED,      /* Check the value found for this frequency before */
+    VCOCAP_COARSE,      /* Binary search for a value at which VTUNE is normal */
+    VCOCAP_LOWER,       /* Walk down to the lower limit of the normal range */
+    VCOCAP_UPPER_START, /* Return to the value found by the coarse search */
+    VCOCAP_UPPER,       /* Walk up to the upper limit of the normal range */
+    VCOCAP_VERIFY,      /* Check the middle of the normal range */
+    VCOCAP_DONE
+} vcocap_phase;
+
+/* State of a VCOCAP search for one PLL. Searches are driven one step at a
+ * time by run_vcocap_searches(), so that those of both PLLs may proceed in
+ * lock-step. */
+struct vcocap_search {
+    bladerf_module module;
+    uint8_t base;       /* PLL register base address */
+    uint8_t data;       /* Register base + 9, without the VCOCAP field */
+    vcocap_phase phase;
+    uint8_t probe;      /* Value to test in the next step */
+
+    uint8_t vcocap;
+    uint8_t step;
+    unsigned int iterations;
+    int start, stop;
+
+    int status;         /* Nonzero if the search failed */
+};
+
+static void vcocap_search_coarse(struct vcocap_search *s)
 {
-    int start_i = -1, stop_i = -1;
-    int i;
-    uint8_t vcocap = 32;
-    uint8_t step = vcocap >> 1;
-    uint8_t vtune;
-    int status;
+    s->phase = VCOCAP_COARSE;
+    s->vcocap = 32;
+    s->step = s->vcocap >> 1;
+    s->iterations = 0;
+    s->probe = s->vcocap;
+}
 
-    status = LMS_READ(dev, base + 9, &data);
-    if (status != 0) {
-        return status;
+static void vcocap_search_init(struct vcocap_search *s, bladerf_module module,
+                               uint8_t base, uint8_t data,
+                               bool cached, uint8_t cached_vcocap)
+{
+    memset(s, 0, sizeof(*s));
+    s->module = module;
+    s->base = base;
+    s->data = data & ~0x3f;
+
+    if (cached) {
+        s->phase = VCOCAP_CACHED;
+        s->vcocap = s->probe = cached_vcocap;
+    } else {
+        vcocap_search_coarse(s);
     }
+}
 
-    data &= ~(0x3f);
-    for (i = 0; i < 6; i++) {
-        status = LMS_WRITE(dev, base + 9, vcocap | data);
-        if (status != 0) {
-            return status;
-        }
+static void vcocap_search_upper_done(struct vcocap_search *s)
+{
+    s->stop -= 1;
+    log_verbose( "Found upper limit VCOCAP: %d\n", s->stop );
 
-        status = LMS_READ(dev, base + 10, &vtune);
-        if (status != 0) {
-            return status;
-        }
+    s->vcocap = (uint8_t) ((s->start + s->stop) >> 1);
+    log_verbose( "Goldilocks VCOCAP: %d\n", s->vcocap );
+
+    s->phase = VCOCAP_VERIFY;
+    s->probe = s->vcocap;
+}
 
-        vtune >>= 6;
+static void vcocap_search_lower_done(struct vcocap_search *s)
+{
+    s->start += 1;
+    log_verbose( "Found lower limit VCOCAP: %d\n", s->start );
+
+    s->phase = VCOCAP_UPPER_START;
+    s->probe = s->vcocap;
+}
 
-        if (vtune == VCO_NORM) {
-            log_verbose( "Found normal at VCOCAP: %d\n", vcocap );
+/* Advance a search, given the VTUNE comparator value read with s->probe
+ * applied */
+static void vcocap_search_step(struct vcocap_search *s, uint8_t vtune)
+{
+    switch (s->phase) {
+        case VCOCAP_CACHED:
+            if (vtune == VCO_NORM) {
+                log_verbose("Using cached VCOCAP: %d\n", s->vcocap);
+                s->phase = VCOCAP_DONE;
+            } else {
+                /* e.g., due to a temperature change */
+                log_verbose("Cached VCOCAP %d is no longer valid (VTUNE=%d)\n",
+                            s->vcocap, vtune);
+                vcocap_search_coarse(s);
+            }
             break;
-        } else if (vtune == VCO_HIGH) {
-            log_verbose( "Too high: %d -> %d\n", vcocap, vcocap + step );
-            vcocap += step ;
-        } else if (vtune == VCO_LOW) {
-            log_verbose( "Too low: %d -> %d\n", vcocap, vcocap - step );
-            vcocap -= step ;
-        } else {
-            log_error( "Invalid VTUNE value encountered: 0x%02x\n", vtune );
-            return BLADERF_ERR_UNEXPECTED;
-        }
 
-        step >>= 1;
-    }
+        case VCOCAP_COARSE:
+            if (vtune == VCO_NORM) {
+                log_verbose( "Found normal at VCOCAP: %d\n", s->vcocap );
+                s->start = s->stop = s->vcocap;
+                if (s->start > 0) {
+                    s->phase = VCOCAP_LOWER;
+                    s->probe = (uint8_t) --s->start;
+                } else {
+                    vcocap_search_lower_done(s);
+                }
+                break;
+            } else if (vtune == VCO_HIGH) {
+                log_verbose( "Too high: %d -> %d\n", s->vcocap, s->vcocap + s->step );
+                s->vcocap += s->step;
+            } else if (vtune == VCO_LOW) {
+                log_verbose( "Too low: %d -> %d\n", s->vcocap, s->vcocap - s->step );
+                s->vcocap -= s->step;
+            } else {
+                log_error( "Invalid VTUNE value encountered: 0x%02x\n", vtune );
+                s->status = BLADERF_ERR_UNEXPECTED;
+                s->phase = VCOCAP_DONE;
+                break;
+            }
 
-    if (vtune != VCO_NORM) {
-        log_debug( "VTUNE is not locked at the end of initial loop\n" );
-        return BLADERF_ERR_UNEXPECTED;
-    }
+            s->step >>= 1;
 
-    start_i = stop_i = vcocap;
-    while (start_i > 0 && vtune != VCO_HIGH) {
-        start_i -= 1;
+            if (++s->iterations == 6) {
+                log_debug( "VTUNE is not locked at the end of initial loop\n" );
+                s->status = BLADERF_ERR_UNEXPECTED;
+                s->phase = VCOCAP_DONE;
+            } else {
+                s->probe = s->vcocap;
+            }
+            break;
 
-        status = LMS_WRITE(dev, base + 9, start_i | data);
-        if (status != 0) {
-            return status;
-        }
+        case VCOCAP_LOWER:
+            if (s->start > 0 && vtune != VCO_HIGH) {
+                s->probe = (uint8_t) --s->start;
+            } else {
+                vcocap_search_lower_done(s);
+            }
+            break;
 
-        status = LMS_READ(dev, base + 10, &vtune);
-        if (status != 0) {
-            return status;
-        }
+        case VCOCAP_UPPER_START:
+        case VCOCAP_UPPER:
+            if (s->stop < 64 && vtune != VCO_LOW) {
+                s->phase = VCOCAP_UPPER;
+                s->probe = (uint8_t) ++s->stop;
+            } else {
+                vcocap_search_upper_done(s);
+            }
+            break;
+
+        case VCOCAP_VERIFY:
+            log_verbose( "VTUNE: %d\n", vtune );
+            if (vtune != VCO_NORM) {
+                s->status = BLADERF_ERR_UNEXPECTED;
+                log_warning("VCOCAP could not converge and VTUNE is not "
+                            "locked - %d\n", vtune);
+            }
+            s->phase = VCOCAP_DONE;
+            break;
 
-        vtune >>= 6;
+        default:
+            assert(!"Invalid VCOCAP search phase");
+            break;
     }
+}
 
-    start_i += 1;
-    log_verbose( "Found lower limit VCOCAP: %d\n", start_i );
+/* Run VCOCAP searches to completion. Each step applies the values being
+ * tested by all unfinished searches, and reads back their VTUNE comparators,
+ * in a single batch. Thus, searching for both PLLs takes no more round
+ * trips than searching for one.
+ *
+ * Returns an error if register access fails. The outcome of each search is
+ * left in its `status` field. */
+static int run_vcocap_searches(struct bladerf *dev,
+                               struct vcocap_search *searches, size_t n)
+{
+    struct backend_reg_access regs[2 * NUM_MODULES];
+    struct vcocap_search *active[NUM_MODULES];
+    size_t i, num_active;
+    int status;
 
-    status = LMS_WRITE(dev, base + 9, vcocap | data );
-    if (status != 0) {
-        return status;
-    }
+    assert(n <= NUM_MODULES);
 
-    status = LMS_READ(dev, base + 10, &vtune);
-    if (status != 0) {
-        return status;
-    }
+    while (true) {
+        num_active = 0;
+        for (i = 0; i < n; i++) {
+            if (searches[i].phase != VCOCAP_DONE) {
+                active[num_active++] = &searches[i];
+            }
+        }
 
-    vtune >>= 6;
+        if (num_active == 0) {
+            return 0;
+        }
 
-    while (stop_i < 64 && vtune != VCO_LOW) {
-        stop_i += 1;
+        for (i = 0; i < num_active; i++) {
+            regs[i].addr = active[i]->base + 9;
+            regs[i].data = active[i]->probe | active[i]->data;
+            regs[i].write = true;
 
-        status = LMS_WRITE(dev, base + 9, stop_i | data);
-        if (status != 0) {
-            return status;
+            regs[num_active + i].addr = active[i]->base + 10;
+            regs[num_active + i].data = 0;
+            regs[num_active + i].write = false;
         }
 
-        status = LMS_READ(dev, base + 10, &vtune);
+        status = lms_access_batch(dev, regs, 2 * num_active);
         if (status != 0) {
             return status;
         }
 
-        vtune >>= 6;
+        for (i = 0; i < num_active; i++) {
+            vcocap_search_step(active[i], regs[num_active + i].data >> 6);
+        }
     }
+}
 
-    stop_i -= 1;
-    log_verbose( "Found upper limit VCOCAP: %d\n", stop_i );
-
-    vcocap = (start_i + stop_i) >> 1;
+static inline struct lms_vcocap_cache *vcocap_cache(struct bladerf *dev,
+                                                    bladerf_module mod)
+{
+    return &dev->vcocap_cache[mod == BLADERF_MODULE_RX ? 0 : 1];
+}
 
-    log_verbose( "Goldilocks VCOCAP: %d\n", vcocap );
+static bool vcocap_cache_lookup(struct bladerf *dev, bladerf_module mod,
+                                uint32_t freq, uint8_t *vcocap)
+{
+    const struct lms_vcocap_cache *cache = vcocap_cache(dev, mod);
+    size_t i;
 
-    status = LMS_WRITE(dev, base + 9, vcocap | data );
-    if (status != 0) {
-        return status;
+    for (i = 0; i < cache->count; i++) {
+        if (cache->entries[i].freq == freq) {
+            *vcocap = cache->entries[i].vcocap;
+            return true;
+        }
     }
 
-    status = LMS_READ(dev, base + 10, &vtune);
-    if (status != 0) {
-        return status;
+    return false;
+}
+
+static void vcocap_cache_store(struct bladerf *dev, bladerf_module mod,
+                               uint32_t freq, uint8_t vcocap)
+{
+    struct lms_vcocap_cache *cache = vcocap_cache(dev, mod);
+    size_t i;
+
+    for (i = 0; i < cache->count; i++) {
+        if (cache->entries[i].freq == freq) {
+            cache->entries[i].vcocap = vcocap;
+            return;
+        }
     }
 
-    vtune >>= 6;
-    log_verbose( "VTUNE: %d\n", vtune );
-    if (vtune != VCO_NORM) {
-        status = BLADERF_ERR_UNEXPECTED;
-        log_warning("VCOCAP could not converge and VTUNE is not locked - %d\n",
-                    vtune);
+    if (cache->count < LMS_VCOCAP_CACHE_SIZE) {
+        i = cache->count++;
+    } else {
+        i = cache->next;
+        cache->next = (cache->next + 1) % LMS_VCOCAP_CACHE_SIZE;
     }
 
-    return status;
+    cache->entries[i].freq = freq;
+    cache->entries[i].vcocap = vcocap;
 }
 
-/* Set the frequency of a module */
-int lms_set_frequency(struct bladerf *dev, bladerf_module mod, uint32_t freq)
+/* Compute the PLL configuration for a frequency */
+static void calc_pll(uint32_t freq, struct lms_freq *f)
 {
-    /* Select the base address based on which PLL we are configuring */
-    const uint8_t base = (mod == BLADERF_MODULE_RX) ? 0x20 : 0x10;
     const uint64_t ref_clock = 38400000;
     uint8_t freqsel = bands[0].value;
     uint16_t nint;
     uint32_t nfrac;
-    struct lms_freq f;
-    uint8_t data;
     uint64_t vco_x;
     uint64_t temp;
-    int status, dsm_status;
     uint8_t i = 0;
 
-    /* Clamp out of range values */
-    if (freq < BLADERF_FREQUENCY_MIN) {
-        freq = BLADERF_FREQUENCY_MIN;
-        log_info("Clamping frequency to %uHz\n", freq);
-    } else if (freq > BLADERF_FREQUENCY_MAX) {
-        freq = BLADERF_FREQUENCY_MAX;
-        log_info("Clamping frequency to %uHz\n", freq);
-    }
-
     /* Figure out freqsel */
 
     while(i < 16) {
@@ -1665,202 +1841,1005 @@ int lms_set_frequency(struct bladerf *dev, bladerf_module mod, uint32_t freq)
     nfrac = (uint32_t)temp;
 
     assert(vco_x <= UINT8_MAX);
-    f.x = (uint8_t)vco_x;
-    f.nint = nint;
-    f.nfrac = nfrac;
-    f.freqsel = freqsel;
+    f->x = (uint8_t)vco_x;
+    f->nint = nint;
+    f->nfrac = nfrac;
+    f->freqsel = freqsel;
     assert(ref_clock <= UINT32_MAX);
-    f.reference = (uint32_t)ref_clock;
-    lms_print_frequency(&f);
+    f->reference = (uint32_t)ref_clock;
+    lms_print_frequency(f);
+}
 
-    /* Turn on the DSMs */
-    status = LMS_READ(dev, 0x09, &data);
-    if (status == 0) {
-        data |= 0x05;
-        status = LMS_WRITE(dev, 0x09, data);
+/* Tune the PLLs of the specified modules to the same frequency. The PLL
+ * configuration is computed once, both PLLs are written in one transaction,
+ * and their VCOCAP searches proceed together. */
+static int set_frequency(struct bladerf *dev, const bladerf_module *mods,
+                         size_t n, uint32_t freq)
+{
+    struct vcocap_search searches[NUM_MODULES];
+    uint8_t bases[NUM_MODULES];
+    uint8_t pll_config, vcocap, data;
+    struct lms_freq f;
+    struct lms_txn txn;
+    struct tuning_timer vcocap_timer;
+    bool cached;
+    int status, dsm_status;
+    size_t i;
+
+    assert(n >= 1 && n <= NUM_MODULES);
+
+    /* Clamp out of range values */
+    if (freq < BLADERF_FREQUENCY_MIN) {
+        freq = BLADERF_FREQUENCY_MIN;
+        log_info("Clamping frequency to %uHz\n", freq);
+    } else if (freq > BLADERF_FREQUENCY_MAX) {
+        freq = BLADERF_FREQUENCY_MAX;
+        log_info("Clamping frequency to %uHz\n", freq);
     }
 
+    calc_pll(freq, &f);
+
+    /* Turn on the DSMs */
+    status = lms_set(dev, 0x09, 0x05);
     if (status != 0) {
         log_debug("Failed to turn on DSMs\n");
         return status;
     }
 
-    status = write_pll_config(dev, mod, freq, freqsel);
-    if (status != 0) {
-        goto lms_set_frequency_error;
-    }
+    lms_txn_begin(&txn, dev);
 
-    data = nint >> 1;
-    status = LMS_WRITE(dev, base + 0, data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
-    }
+    for (i = 0; i < n && status == 0; i++) {
+        /* Select the base address based on which PLL we are configuring */
+        bases[i] = (mods[i] == BLADERF_MODULE_RX) ? 0x20 : 0x10;
 
-    data = ((nint & 1) << 7) | ((nfrac >> 16) & 0x7f);
-    status = LMS_WRITE(dev, base + 1, data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
-    }
+        status = get_pll_config(dev, mods[i], freq, f.freqsel, &pll_config);
+        if (status != 0) {
+            break;
+        }
 
-    data = ((nfrac >> 8) & 0xff);
-    status = LMS_WRITE(dev, base + 2, data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
-    }
+        lms_txn_write(&txn, bases[i] + 5, pll_config);
 
-    data = (nfrac & 0xff);
-    status = LMS_WRITE(dev, base + 3, data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
-    }
+        lms_txn_write(&txn, bases[i] + 0, f.nint >> 1);
+        lms_txn_write(&txn, bases[i] + 1,
+                      ((f.nint & 1) << 7) | ((f.nfrac >> 16) & 0x7f));
+        lms_txn_write(&txn, bases[i] + 2, ((f.nfrac >> 8) & 0xff));
+        lms_txn_write(&txn, bases[i] + 3, (f.nfrac & 0xff));
 
-    /* Set the PLL Ichp, Iup and Idn currents */
-    status = LMS_READ(dev, base + 6, &data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
+        /* Set the PLL Ichp, Iup and Idn currents */
+        lms_txn_modify(&txn, bases[i] + 6, 0x1f, 0x0c);
+        lms_txn_clear(&txn, bases[i] + 7, 0x1f);
+        lms_txn_clear(&txn, bases[i] + 8, 0x1f);
     }
 
-    data &= ~(0x1f);
-    data |= 0x0c;
-
-    status = LMS_WRITE(dev, base + 6, data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
+    if (status == 0) {
+        status = lms_txn_commit(&txn);
     }
 
-    status = LMS_READ(dev, base + 7, &data);
     if (status != 0) {
         goto lms_set_frequency_error;
     }
 
-    data &= ~(0x1f);
-    // data |= 3;
+    /* Use the VCOCAP found the last time we tuned to this frequency, if it
+     * still works. Otherwise, loop through the VCOCAP to figure out optimal
+     * values. */
+    tuning_timer_start(dev, &vcocap_timer);
 
-    status = LMS_WRITE(dev, base + 7, data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
-    }
+    for (i = 0; i < n; i++) {
+        status = LMS_READ(dev, bases[i] + 9, &data);
+        if (status != 0) {
+            goto lms_set_frequency_error;
+        }
 
-    status = LMS_READ(dev, base + 8, &data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
+        cached = vcocap_cache_lookup(dev, mods[i], freq, &vcocap);
+        vcocap_search_init(&searches[i], mods[i], bases[i], data,
+                           cached, vcocap);
     }
 
-    data &= ~(0x1f);
-    // data |= 3;
-    status = LMS_WRITE(dev, base + 8, data);
-    if (status != 0) {
-        goto lms_set_frequency_error;
+    status = run_vcocap_searches(dev, searches, n);
+
+    for (i = 0; i < n && status == 0; i++) {
+        status = searches[i].status;
+        if (status == 0) {
+            vcocap_cache_store(dev, mods[i], freq, searches[i].vcocap);
+        }
     }
 
-    /* Loop through the VCOCAP to figure out optimal values */
-    status = tune_vcocap(dev, base, data);
+    for (i = 0; i < n && status == 0; i++) {
+        tuning_timer_stop(dev, mods[i], BLADERF_TUNING_PHASE_VCOCAP,
+                          &vcocap_timer);
+    }
 
 lms_set_frequency_error:
     /* Turn off the DSMs */
-    dsm_status = LMS_READ(dev, 0x09, &data);
-    if (dsm_status == 0) {
-        data &= ~(0x05);
-        dsm_status = LMS_WRITE(dev, 0x09, data);
-    }
+    dsm_status = lms_clear(dev, 0x09, 0x05);
 
     return (status == 0) ? dsm_status : status;
 }
 
-int lms_dump_registers(struct bladerf *dev)
+/* Set the frequency of a module */
+int lms_set_frequency(struct bladerf *dev, bladerf_module mod, uint32_t freq)
 {
-    int status = 0;
-    uint8_t data,i;
-    const uint16_t num_reg = sizeof(lms_reg_dumpset);
+    return set_frequency(dev, &mod, 1, freq);
+}
 
-    for (i = 0; i < num_reg; i++) {
-        status = LMS_READ(dev, lms_reg_dumpset[i], &data);
+int lms_set_frequency_both(struct bladerf *dev, uint32_t freq)
+{
+    static const bladerf_module mods[NUM_MODULES] = {
+        BLADERF_MODULE_RX, BLADERF_MODULE_TX
+    };
+
+    return set_frequency(dev, mods, NUM_MODULES, freq);
+}
+
+/* Registers whose values are changed by the hardware, or that contain
+ * self-clearing control bits, must always be accessed on the device */
+static inline bool lms_reg_cacheable(uint8_t addr)
+{
+    if (addr >= LMS_NUM_REGISTERS) {
+        return false;
+    }
+
+    switch (addr) {
+        /* DC calibration value, status, count, and control registers */
+        case 0x00: case 0x01: case 0x02: case 0x03:
+        case 0x30: case 0x31: case 0x32: case 0x33:
+        case 0x50: case 0x51: case 0x52: case 0x53:
+        case 0x60: case 0x61: case 0x62: case 0x63:
+
+        /* TX and RX PLL VTUNE comparators */
+        case 0x1a:
+        case 0x2a:
+            return false;
+
+        default:
+            return true;
+    }
+}
+
+static inline void lms_shadow_store(struct bladerf *dev,
+                                    uint8_t addr, uint8_t data)
+{
+    if (lms_reg_cacheable(addr) && !dev->lms_shadow_volatile[addr]) {
+        dev->lms_shadow[addr] = data;
+        dev->lms_shadow_valid[addr] = true;
+    }
+}
+
+static inline bool lms_shadow_load(struct bladerf *dev,
+                                   uint8_t addr, uint8_t *data)
+{
+    if (lms_reg_cacheable(addr) && dev->lms_shadow_valid[addr] &&
+        !dev->lms_shadow_volatile[addr]) {
+        *data = dev->lms_shadow[addr];
+        return true;
+    }
+
+    return false;
+}
+
+void lms_shadow_invalidate(struct bladerf *dev)
+{
+    memset(dev->lms_shadow_valid, 0, sizeof(dev->lms_shadow_valid));
+}
+
+void lms_shadow_mark_volatile(struct bladerf *dev, uint8_t addr)
+{
+    if (addr < LMS_NUM_REGISTERS) {
+        dev->lms_shadow_volatile[addr] = true;
+        dev->lms_shadow_valid[addr] = false;
+    }
+}
+
+/* Queue a write while a batch is open */
+static int lms_defer_write(struct bladerf *dev, uint8_t addr, uint8_t data)
+{
+    struct lms_defer *defer = &dev->lms_defer;
+    int status;
+
+    if (defer->count == LMS_DEFER_MAX_OPS) {
+        status = lms_defer_flush(dev);
         if (status != 0) {
-            log_debug("Failed to read LMS @ 0x%02x\n", lms_reg_dumpset[i]);
             return status;
-        } else {
-            log_debug("LMS[0x%02x] = 0x%02x\n", lms_reg_dumpset[i], data);
         }
     }
 
+    defer->addr[defer->count] = addr;
+    defer->data[defer->count] = data;
+    defer->count++;
+
+    /* Subsequent reads see the value the register will have */
+    lms_shadow_store(dev, addr, data);
+    return 0;
+}
+
+int lms_read(struct bladerf *dev, uint8_t addr, uint8_t *data)
+{
+    int status;
+
+    if (lms_shadow_load(dev, addr, data)) {
+        return 0;
+    }
+
+    /* The read may depend upon the side effects of deferred writes */
+    status = lms_defer_flush(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    status = dev->fn->lms_read(dev, addr, data);
+    if (status == 0) {
+        lms_shadow_store(dev, addr, *data);
+    }
+
     return status;
 }
 
-/* Reference LMS6002D calibration guide, section 4.1 flow chart */
-static int lms_dc_cal_loop(struct bladerf *dev, uint8_t base,
-                           uint8_t cal_address, uint8_t dc_cntval,
-                           uint8_t *dc_regval)
+int lms_write(struct bladerf *dev, uint8_t addr, uint8_t data)
 {
     int status;
-    uint8_t i, val;
-    bool done = false;
-    const unsigned int max_cal_count = 25;
 
-    log_debug("Calibrating module %2.2x:%2.2x\n", base, cal_address);
+    if (dev->lms_defer.depth != 0) {
+        return lms_defer_write(dev, addr, data);
+    }
 
-    /* Set the calibration address for the block, and start it up */
-    status = LMS_READ(dev, base + 0x03, &val);
+    status = dev->fn->lms_write(dev, addr, data);
+
+    if (status == 0) {
+        lms_shadow_store(dev, addr, data);
+    } else if (addr < LMS_NUM_REGISTERS) {
+        /* The write may or may not have taken effect */
+        dev->lms_shadow_valid[addr] = false;
+    }
+
+    return status;
+}
+
+static int lms_access_batch_now(struct bladerf *dev,
+                                struct backend_reg_access *regs, size_t count)
+{
+    int status = 0;
+    size_t i;
+
+    if (dev->fn->lms_access_batch != NULL) {
+        status = dev->fn->lms_access_batch(dev, regs, count);
+    } else {
+        for (i = 0; i < count && status == 0; i++) {
+            if (regs[i].write) {
+                status = dev->fn->lms_write(dev, regs[i].addr, regs[i].data);
+            } else {
+                status = dev->fn->lms_read(dev, regs[i].addr, &regs[i].data);
+            }
+        }
+    }
+
+    /* On failure, it is unknown which of the writes took effect */
+    for (i = 0; i < count; i++) {
+        if (status == 0) {
+            lms_shadow_store(dev, regs[i].addr, regs[i].data);
+        } else if (regs[i].write && regs[i].addr < LMS_NUM_REGISTERS) {
+            dev->lms_shadow_valid[regs[i].addr] = false;
+        }
+    }
+
+    return status;
+}
+
+int lms_access_batch(struct bladerf *dev,
+                     struct backend_reg_access *regs, size_t count)
+{
+    bool writes_only = true;
+    size_t i;
+    int status;
+
+    for (i = 0; i < count; i++) {
+        writes_only = writes_only && regs[i].write;
+    }
+
+    if (dev->lms_defer.depth != 0 && writes_only) {
+        for (i = 0, status = 0; i < count && status == 0; i++) {
+            status = lms_defer_write(dev, regs[i].addr, regs[i].data);
+        }
+
+        return status;
+    }
+
+    status = lms_defer_flush(dev);
     if (status != 0) {
         return status;
     }
 
-    val &= ~(0x07);
-    val |= cal_address&0x07;
+    return lms_access_batch_now(dev, regs, count);
+}
+
+int lms_read_burst(struct bladerf *dev, uint8_t addr,
+                   uint8_t *data, size_t len)
+{
+    struct backend_reg_access regs[LMS_NUM_REGISTERS];
+    size_t i, n = 0;
+    int status;
+
+    if (len > LMS_NUM_REGISTERS || addr + len > LMS_NUM_REGISTERS) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    for (i = 0; i < len; i++) {
+        if (!lms_shadow_load(dev, (uint8_t) (addr + i), &data[i])) {
+            regs[n].addr = (uint8_t) (addr + i);
+            regs[n].data = 0;
+            regs[n].write = false;
+            n++;
+        }
+    }
+
+    if (n == 0) {
+        return 0;
+    }
 
-    status = LMS_WRITE(dev, base + 0x03, val);
+    status = lms_access_batch(dev, regs, n);
     if (status != 0) {
         return status;
     }
 
-    /* Set and latch the DC_CNTVAL  */
-    status = LMS_WRITE(dev, base + 0x02, dc_cntval);
+    for (i = 0; i < n; i++) {
+        data[regs[i].addr - addr] = regs[i].data;
+    }
+
+    return 0;
+}
+
+int lms_write_burst(struct bladerf *dev, uint8_t addr,
+                    const uint8_t *data, size_t len)
+{
+    struct backend_reg_access regs[LMS_NUM_REGISTERS];
+    size_t i;
+
+    if (len > LMS_NUM_REGISTERS || addr + len > LMS_NUM_REGISTERS) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    for (i = 0; i < len; i++) {
+        regs[i].addr = (uint8_t) (addr + i);
+        regs[i].data = data[i];
+        regs[i].write = true;
+    }
+
+    return lms_access_batch(dev, regs, len);
+}
+
+/* Run a sequence of accesses on the device, for FPGA versions with the
+ * NIOS II sequence engine. As with lms_access_batch_now(), the shadow is
+ * updated with the values written and read. */
+static int lms_sequence(struct bladerf *dev,
+                        struct backend_seq_op *ops, unsigned int count)
+{
+    int status;
+    unsigned int i;
+
+    status = lms_defer_flush(dev);
     if (status != 0) {
         return status;
     }
 
-    val |= (1 << 4);
-    status = LMS_WRITE(dev, base + 0x03, val);
+    status = dev->fn->lms_sequence(dev, ops, count);
+
+    for (i = 0; i < count; i++) {
+        const uint8_t addr = ops[i].addr;
+        const bool writes = ops[i].type == BACKEND_SEQ_WRITE ||
+                            ops[i].type == BACKEND_SEQ_MODIFY;
+
+        if (status == 0 && ops[i].type != BACKEND_SEQ_MODIFY) {
+            lms_shadow_store(dev, addr, ops[i].data);
+        } else if (writes && addr < LMS_NUM_REGISTERS) {
+            /* The new value is unknown, or may not have been written */
+            dev->lms_shadow_valid[addr] = false;
+        }
+    }
+
+    return status;
+}
+
+static inline bool have_lms_sequence(struct bladerf *dev)
+{
+    return dev->fn->lms_sequence != NULL &&
+           !version_less_than(&dev->fpga_version, 0, 1, 16);
+}
+
+/* Registers read by the getters covered by lms_prefetch_config() */
+static const uint8_t lms_config_regs[] = {
+    0x08, 0x09,                         /* Loopback, sampling */
+    0x10, 0x11, 0x12, 0x13, 0x15,       /* TX PLL */
+    0x20, 0x21, 0x22, 0x23, 0x25,       /* RX PLL */
+    0x34, 0x35,                         /* TX LPF */
+    0x41, 0x45, 0x46,                   /* TXVGA1, TXVGA2, TX loopback */
+    0x54, 0x55,                         /* RX LPF */
+    0x64, 0x65,                         /* RXVGA2 */
+    0x75, 0x76,                         /* LNA, RXVGA1 */
+};
+
+int lms_prefetch_config(struct bladerf *dev)
+{
+    struct backend_reg_access regs[ARRAY_SIZE(lms_config_regs)];
+    size_t i, n = 0;
+    uint8_t data;
+
+    for (i = 0; i < ARRAY_SIZE(lms_config_regs); i++) {
+        const uint8_t addr = lms_config_regs[i];
+
+        if (!dev->lms_shadow_volatile[addr] &&
+            !lms_shadow_load(dev, addr, &data)) {
+            regs[n].addr = addr;
+            regs[n].data = 0;
+            regs[n].write = false;
+            n++;
+        }
+    }
+
+    if (n == 0) {
+        return 0;
+    }
+
+    return lms_access_batch(dev, regs, n);
+}
+
+int lms_standby(struct bladerf *dev)
+{
+    struct backend_reg_access regs[LMS_NUM_REGISTERS];
+    size_t n = 0;
+    unsigned int addr;
+    uint8_t data;
+    int status = 0;
+
+    /* Complete the shadow, so that lms_resume() can restore every register
+     * it covers */
+    for (addr = 0; addr < LMS_NUM_REGISTERS; addr++) {
+        if (lms_reg_cacheable(addr) && !dev->lms_shadow_volatile[addr] &&
+            !lms_shadow_load(dev, addr, &data)) {
+            regs[n].addr = (uint8_t) addr;
+            regs[n].data = 0;
+            regs[n].write = false;
+            n++;
+        }
+    }
+
+    if (n != 0) {
+        status = lms_access_batch(dev, regs, n);
+    }
+
+    if (status == 0) {
+        status = lms_power_down(dev);
+    }
+
+    return status;
+}
+
+int lms_resume(struct bladerf *dev)
+{
+    struct backend_reg_access regs[LMS_NUM_REGISTERS];
+    size_t n = 0;
+    unsigned int addr;
+    uint8_t data;
+    int status;
+
+    status = LMS_READ(dev, 0x05, &data);
     if (status != 0) {
         return status;
     }
 
-    val &= ~(1 << 4);
-    status = LMS_WRITE(dev, base + 0x03, val);
+    /* Skip the chip ID and the top-level control, which is written last so
+     * that the rest of the configuration is in place at power up */
+    for (addr = 0; addr < LMS_NUM_REGISTERS; addr++) {
+        if (addr != 0x04 && addr != 0x05 &&
+            lms_shadow_load(dev, addr, &regs[n].data)) {
+            regs[n].addr = (uint8_t) addr;
+            regs[n].write = true;
+            n++;
+        }
+    }
+
+    regs[n].addr = 0x05;
+    regs[n].data = data | (1 << 4);
+    regs[n].write = true;
+    n++;
+
+    return lms_access_batch(dev, regs, n);
+}
+
+int lms_defer_flush(struct bladerf *dev)
+{
+    struct lms_defer *defer = &dev->lms_defer;
+    struct backend_reg_access regs[LMS_DEFER_MAX_OPS];
+    size_t i;
+    int status;
+
+    if (defer->count == 0) {
+        return 0;
+    }
+
+    for (i = 0; i < defer->count; i++) {
+        regs[i].addr = defer->addr[i];
+        regs[i].data = defer->data[i];
+        regs[i].write = true;
+    }
+
+    log_verbose("%s: Flushing %u deferred writes\n", __FUNCTION__,
+                (unsigned int) defer->count);
+
+    status = lms_access_batch_now(dev, regs, defer->count);
+    defer->count = 0;
+
+    if (status != 0 && defer->status == 0) {
+        defer->status = status;
+    }
+
+    return status;
+}
+
+void lms_defer_begin(struct bladerf *dev)
+{
+    dev->lms_defer.depth++;
+}
+
+int lms_defer_end(struct bladerf *dev, int status)
+{
+    int flush_status;
+
+    if (--dev->lms_defer.depth != 0) {
+        return status;
+    }
+
+    flush_status = lms_defer_flush(dev);
+
+    /* Report the first failure of any flush while deferring */
+    if (status == 0) {
+        status = (dev->lms_defer.status != 0) ? dev->lms_defer.status
+                                              : flush_status;
+    }
+
+    dev->lms_defer.status = 0;
+    return status;
+}
+
+/* Get the register address and field for the specified DC offset, given a
+ * value normalized to [-2048, 2048] */
+static void dc_offset_field(bladerf_module module, bladerf_correction corr,
+                            int16_t value, uint8_t *addr, uint8_t *mask,
+                            uint8_t *data)
+{
+    if (module == BLADERF_MODULE_RX) {
+        *addr = (corr == BLADERF_CORR_LMS_DCOFF_I) ? 0x71 : 0x72;
+
+        /* Bit 7 is unrelated to lms dc correction, save its state */
+        *mask = 0x7f;
+
+        /* RX only has 6 bits of scale to work with, remove normalization */
+        value >>= 5;
+
+        if (value < 0) {
+            value = (value <= -64) ? 0x3f :  (abs(value) & 0x3f);
+            /*This register uses bit 6 to denote a negative gain */
+            value |= (1 << 6);
+        } else {
+            value = (value >= 64) ? 0x3f : (value & 0x3f);
+        }
+
+        *data = (uint8_t) value;
+    } else {
+        *addr = (corr == BLADERF_CORR_LMS_DCOFF_I) ? 0x42 : 0x43;
+        *mask = 0xff;
+
+        /* TX only has 7 bits of scale to work with, remove normalization */
+        value >>= 4;
+
+        /* LMS6002D 0x00 = -16, 0x80 = 0, 0xff = 15.9375 */
+        if (value >= 0) {
+            /* Assert bit 7 for positive numbers */
+            *data = (1 << 7) | ((value >= 128) ? 0x7f : (value & 0x7f));
+        } else {
+            *data = (value <= -128) ? 0x00 : (value & 0x7f);
+        }
+    }
+}
+
+int lms_set_dc_offset(struct bladerf *dev, bladerf_module module,
+                      bladerf_correction corr, int16_t value)
+{
+    uint8_t addr, mask, data;
+    struct lms_txn txn;
+
+    dc_offset_field(module, corr, value, &addr, &mask, &data);
+
+    lms_txn_begin(&txn, dev);
+    lms_txn_modify(&txn, addr, mask, data);
+    return lms_txn_commit(&txn);
+}
+
+int lms_set_dc_offsets(struct bladerf *dev, bladerf_module module,
+                       int16_t dc_i, int16_t dc_q)
+{
+    uint8_t addr, mask, data, current;
+    struct lms_txn txn;
+
+    lms_txn_begin(&txn, dev);
+
+    /* Only write the values that differ from the shadowed register values */
+    dc_offset_field(module, BLADERF_CORR_LMS_DCOFF_I, dc_i, &addr, &mask, &data);
+    if (!lms_shadow_load(dev, addr, &current) || (current & mask) != data) {
+        lms_txn_modify(&txn, addr, mask, data);
+    }
+
+    dc_offset_field(module, BLADERF_CORR_LMS_DCOFF_Q, dc_q, &addr, &mask, &data);
+    if (!lms_shadow_load(dev, addr, &current) || (current & mask) != data) {
+        lms_txn_modify(&txn, addr, mask, data);
+    }
+
+    return lms_txn_commit(&txn);
+}
+
+int lms_get_dc_offset(struct bladerf *dev, bladerf_module module,
+                      bladerf_correction corr, int16_t *value)
+{
+    uint8_t tmp;
+    int status;
+
+    if (module == BLADERF_MODULE_RX) {
+        status = LMS_READ(dev, (corr == BLADERF_CORR_LMS_DCOFF_I) ? 0x71 : 0x72,
+                          &tmp);
+    } else {
+        status = LMS_READ(dev, (corr == BLADERF_CORR_LMS_DCOFF_I) ? 0x42 : 0x43,
+                          &tmp);
+    }
+
+    if (status == 0) {
+        /* Mask out any control bits in the RX DC correction area */
+        if (module == BLADERF_MODULE_RX) {
+            tmp = tmp & 0x7f;
+            if (tmp & (1 << 6)) {
+                *value = -(int16_t)(tmp & 0x3f);
+            } else {
+                *value = (int16_t)(tmp & 0x3f);
+            }
+            /* Renormalize to 2048 */
+            *value <<= 5;
+        } else {
+            *value = (int16_t)tmp;
+            /* Renormalize to 2048 */
+            *value <<= 4;
+        }
+    }
+
+    return status;
+}
+
+int lms_get_quick_tune(struct bladerf *dev, bladerf_module mod,
+                       struct bladerf_quick_tune *quick_tune)
+{
+    const uint8_t base = (mod == BLADERF_MODULE_RX) ? 0x20 : 0x10;
+    struct lms_freq f;
+    uint8_t data;
+    int status;
+
+    status = lms_get_frequency(dev, mod, &f);
     if (status != 0) {
         return status;
     }
 
+    if (f.x == 0) {
+        return BLADERF_ERR_INVAL;
+    }
 
-    /* Start the calibration by toggling DC_START_CLBR */
-    val |= (1 << 5);
-    status = LMS_WRITE(dev, base + 0x03, val);
+    status = LMS_READ(dev, base + 9, &data);
+    if (status != 0) {
+        return status;
+    }
+
+    quick_tune->frequency = lms_frequency_to_hz(&f);
+    quick_tune->nint = f.nint;
+    quick_tune->nfrac = f.nfrac;
+    quick_tune->freqsel = f.freqsel;
+    quick_tune->vcocap = data & 0x3f;
+
+    return 0;
+}
+
+int lms_set_quick_tune(struct bladerf *dev, bladerf_module mod,
+                       const struct bladerf_quick_tune *quick_tune)
+{
+    const uint8_t base = (mod == BLADERF_MODULE_RX) ? 0x20 : 0x10;
+    const uint16_t nint = quick_tune->nint;
+    const uint32_t nfrac = quick_tune->nfrac;
+    struct lms_txn txn;
+    int status, dsm_status;
+
+    /* Turn on the DSMs */
+    status = lms_set(dev, 0x09, 0x05);
+    if (status != 0) {
+        log_debug("Failed to turn on DSMs\n");
+        return status;
+    }
+
+    status = write_pll_config(dev, mod, quick_tune->frequency,
+                              quick_tune->freqsel);
+
+    if (status == 0) {
+        lms_txn_begin(&txn, dev);
+
+        lms_txn_write(&txn, base + 0, nint >> 1);
+        lms_txn_write(&txn, base + 1,
+                      ((nint & 1) << 7) | ((nfrac >> 16) & 0x7f));
+        lms_txn_write(&txn, base + 2, ((nfrac >> 8) & 0xff));
+        lms_txn_write(&txn, base + 3, (nfrac & 0xff));
+
+        /* Set the PLL Ichp, Iup and Idn currents, as lms_set_frequency()
+         * does */
+        lms_txn_modify(&txn, base + 6, 0x1f, 0x0c);
+        lms_txn_clear(&txn, base + 7, 0x1f);
+        lms_txn_clear(&txn, base + 8, 0x1f);
+
+        lms_txn_modify(&txn, base + 9, 0x3f, quick_tune->vcocap);
+
+        status = lms_txn_commit(&txn);
+    }
+
+    /* Turn off the DSMs */
+    dsm_status = lms_clear(dev, 0x09, 0x05);
+
+    return (status == 0) ? dsm_status : status;
+}
+
+int lms_get_retune_regs(struct bladerf *dev, bladerf_module mod,
+                        const struct bladerf_quick_tune *quick_tune,
+                        struct backend_retune *regs)
+{
+    const uint16_t nint = quick_tune->nint;
+    const uint32_t nfrac = quick_tune->nfrac;
+
+    regs->pll[0] = nint >> 1;
+    regs->pll[1] = ((nint & 1) << 7) | ((nfrac >> 16) & 0x7f);
+    regs->pll[2] = ((nfrac >> 8) & 0xff);
+    regs->pll[3] = (nfrac & 0xff);
+    regs->vcocap = quick_tune->vcocap & 0x3f;
+
+    return get_pll_config(dev, mod, quick_tune->frequency,
+                          quick_tune->freqsel, &regs->freqsel);
+}
+
+void lms_txn_begin(struct lms_txn *txn, struct bladerf *dev)
+{
+    txn->dev = dev;
+    txn->status = 0;
+    txn->num_ops = 0;
+}
+
+void lms_txn_modify(struct lms_txn *txn, uint8_t addr,
+                    uint8_t mask, uint8_t value)
+{
+    if (txn->num_ops == LMS_TXN_MAX_OPS) {
+        lms_txn_commit(txn);
+    }
+
+    txn->ops[txn->num_ops].addr = addr;
+    txn->ops[txn->num_ops].mask = mask;
+    txn->ops[txn->num_ops].value = value & mask;
+    txn->num_ops++;
+}
+
+void lms_txn_write(struct lms_txn *txn, uint8_t addr, uint8_t value)
+{
+    lms_txn_modify(txn, addr, 0xff, value);
+}
+
+int lms_txn_commit(struct lms_txn *txn)
+{
+    /* Reads are followed by the writes produced from them */
+    struct backend_reg_access regs[2 * LMS_TXN_MAX_OPS];
+    size_t num_reads = 0;
+    size_t i, j;
+    int status;
+
+    if (txn->status != 0 || txn->num_ops == 0) {
+        txn->num_ops = 0;
+        return txn->status;
+    }
+
+    /* Read each register that is modified before being fully overwritten,
+     * and for which no cached value is available */
+    for (i = 0; i < txn->num_ops; i++) {
+        uint8_t cached;
+        bool needed = (txn->ops[i].mask != 0xff) &&
+                      !lms_shadow_load(txn->dev, txn->ops[i].addr, &cached);
+
+        for (j = 0; needed && j < i; j++) {
+            if (txn->ops[j].addr == txn->ops[i].addr) {
+                needed = false;
+            }
+        }
+
+        for (j = 0; needed && j < num_reads; j++) {
+            if (regs[j].addr == txn->ops[i].addr) {
+                needed = false;
+            }
+        }
+
+        if (needed) {
+            regs[num_reads].addr = txn->ops[i].addr;
+            regs[num_reads].data = 0;
+            regs[num_reads].write = false;
+            num_reads++;
+        }
+    }
+
+    if (num_reads != 0) {
+        status = lms_access_batch(txn->dev, regs, num_reads);
+        if (status != 0) {
+            goto out;
+        }
+    }
+
+    /* Apply each operation to the most recent value of its register, and
+     * queue the resulting write */
+    for (i = 0; i < txn->num_ops; i++) {
+        uint8_t current = 0;
+        bool found = false;
+
+        for (j = i; j > 0 && !found; j--) {
+            if (regs[num_reads + j - 1].addr == txn->ops[i].addr) {
+                current = regs[num_reads + j - 1].data;
+                found = true;
+            }
+        }
+
+        for (j = 0; j < num_reads && !found; j++) {
+            if (regs[j].addr == txn->ops[i].addr) {
+                current = regs[j].data;
+                found = true;
+            }
+        }
+
+        if (!found) {
+            found = lms_shadow_load(txn->dev, txn->ops[i].addr, &current);
+        }
+
+        assert(found || txn->ops[i].mask == 0xff);
+
+        current = (current & ~txn->ops[i].mask) | txn->ops[i].value;
+
+        regs[num_reads + i].addr = txn->ops[i].addr;
+        regs[num_reads + i].data = current;
+        regs[num_reads + i].write = true;
+    }
+
+    status = lms_access_batch(txn->dev, &regs[num_reads], txn->num_ops);
+
+out:
+    txn->status = status;
+    txn->num_ops = 0;
+    return status;
+}
+
+int lms_dump_registers(struct bladerf *dev)
+{
+    int status = 0;
+    size_t i;
+    const size_t num_reg = sizeof(lms_reg_dumpset);
+    struct backend_reg_access regs[sizeof(lms_reg_dumpset)];
+
+    for (i = 0; i < num_reg; i++) {
+        regs[i].addr = lms_reg_dumpset[i];
+        regs[i].data = 0;
+        regs[i].write = false;
+    }
+
+    status = lms_access_batch(dev, regs, num_reg);
     if (status != 0) {
+        log_debug("Failed to read LMS registers: %s\n",
+                  bladerf_strerror(status));
         return status;
     }
 
-    val &= ~(1 << 5);
-    status = LMS_WRITE(dev, base + 0x03, val);
+    for (i = 0; i < num_reg; i++) {
+        log_debug("LMS[0x%02x] = 0x%02x\n", regs[i].addr, regs[i].data);
+    }
+
+    return status;
+}
+
+static inline void cal_regs(struct backend_reg_access *regs, size_t *i,
+                            uint8_t addr, uint8_t data, bool write)
+{
+    regs[*i].addr = addr;
+    regs[*i].data = data;
+    regs[*i].write = write;
+    (*i)++;
+}
+
+/* Reference LMS6002D calibration guide, section 4.1 flow chart */
+static int lms_dc_cal_loop(struct bladerf *dev, uint8_t base,
+                           uint8_t cal_address, uint8_t dc_cntval,
+                           uint8_t *dc_regval)
+{
+    int status;
+    uint8_t val;
+    size_t i, poll;
+    unsigned int n;
+    bool done = false;
+    const unsigned int max_cal_count = 25;
+    struct backend_reg_access regs[8];
+
+    log_debug("Calibrating module %2.2x:%2.2x\n", base, cal_address);
+
+    /* Set the calibration address for the block, and start it up */
+    status = LMS_READ(dev, base + 0x03, &val);
     if (status != 0) {
         return status;
     }
 
+    val &= ~(0x07);
+    val |= cal_address&0x07;
+
+    i = 0;
+    cal_regs(regs, &i, base + 0x03, val, true);
+
+    /* Set and latch the DC_CNTVAL  */
+    cal_regs(regs, &i, base + 0x02, dc_cntval, true);
+    cal_regs(regs, &i, base + 0x03, val | (1 << 4), true);
+    cal_regs(regs, &i, base + 0x03, val, true);
+
+    /* Start the calibration by toggling DC_START_CLBR */
+    cal_regs(regs, &i, base + 0x03, val | (1 << 5), true);
+    cal_regs(regs, &i, base + 0x03, val, true);
+
+    /* The calibration generally completes well before the next access
+     * reaches the device, so the first poll of DC_CLBR_DONE and read of
+     * DC_REGVAL are included in the same batch. */
+    poll = i;
+    cal_regs(regs, &i, base + 0x01, 0, false);
+    cal_regs(regs, &i, base, 0, false);
+
+    assert(i <= ARRAY_SIZE(regs));
+
+    /* With the NIOS sequence engine, DC_CLBR_DONE is polled on the device,
+     * and the whole calibration takes a single round trip */
+    if (have_lms_sequence(dev)) {
+        struct backend_seq_op ops[ARRAY_SIZE(regs)];
+
+        for (n = 0; n < i; n++) {
+            ops[n].type = regs[n].write ? BACKEND_SEQ_WRITE : BACKEND_SEQ_READ;
+            ops[n].addr = regs[n].addr;
+            ops[n].data = regs[n].data;
+        }
+
+        ops[poll].type = BACKEND_SEQ_POLL;
+        ops[poll].mask = 0x02;
+        ops[poll].data = 0;
+        ops[poll].tries = max_cal_count;
+
+        status = lms_sequence(dev, ops, (unsigned int) i);
+        if (status == 0) {
+            *dc_regval = ops[poll + 1].data & 0x3f;
+            log_debug( "DC_REGVAL: %d\n", *dc_regval );
+        } else if (status == BLADERF_ERR_TIMEOUT) {
+            log_warning("DC calibration loop did not converge.\n");
+            status = BLADERF_ERR_UNEXPECTED;
+        }
+
+        return status;
+    }
+
     /* Main loop checking the calibration */
-    for (i = 0 ; i < max_cal_count && !done; i++) {
-        /* Read active low DC_CLBR_DONE */
-        status = LMS_READ(dev, base + 0x01, &val);
+    for (n = 0 ; n < max_cal_count && !done; n++) {
+        status = lms_access_batch(dev, &regs[n == 0 ? 0 : poll],
+                                  n == 0 ? i : i - poll);
         if (status != 0) {
             return status;
         }
 
-        /* Check if calibration is done */
-        if (((val >> 1) & 1) == 0) {
+        /* Check if active low DC_CLBR_DONE indicates calibration is done */
+        if (((regs[poll].data >> 1) & 1) == 0) {
             done = true;
+
             /* Per LMS FAQ item 4.7, we should check DC_REG_VAL, as
              * DC_LOCK is not a reliable indicator */
-            status = LMS_READ(dev, base, dc_regval);
-            if (status == 0) {
-                *dc_regval &= 0x3f;
-            }
+            *dc_regval = regs[poll + 1].data & 0x3f;
         }
     }
 
@@ -2146,26 +3125,14 @@ static inline int dc_cal_submodule(struct bladerf *dev,
     if (module == BLADERF_DC_CAL_LPF_TUNING) {
         /* Special case for LPF tuning module where results are
          * written to TX/RX LPF DCCAL */
+        struct lms_txn txn;
 
         /* Set the DC level to RX and TX DCCAL modules */
-        status = LMS_READ(dev, 0x35, &val);
-        if (status == 0) {
-            val &= ~(0x3f);
-            val |= dc_regval;
-            status = LMS_WRITE(dev, 0x35, val);
-        }
-
-        if (status != 0) {
-            return status;
-        }
-
-        status = LMS_READ(dev, 0x55, &val);
-        if (status == 0) {
-            val &= ~(0x3f);
-            val |= dc_regval;
-            status = LMS_WRITE(dev, 0x55, val);
-        }
+        lms_txn_begin(&txn, dev);
+        lms_txn_modify(&txn, 0x35, 0x3f, dc_regval);
+        lms_txn_modify(&txn, 0x55, 0x3f, dc_regval);
 
+        status = lms_txn_commit(&txn);
         if (status != 0) {
             return status;
         }
@@ -2233,6 +3200,7 @@ static inline int dc_cal_module_deinit(struct bladerf *dev,
                                        struct dc_cal_state *state)
 {
     int status = 0;
+    struct lms_txn txn;
 
     switch (module) {
         case BLADERF_DC_CAL_LPF_TUNING:
@@ -2248,20 +3216,18 @@ static inline int dc_cal_module_deinit(struct bladerf *dev,
             break;
 
         case BLADERF_DC_CAL_RXVGA2:
+            lms_txn_begin(&txn, dev);
+
             /* Restore defaults: VGA2GAINA = 1, VGA2GAINB = 0 */
-            status = LMS_WRITE(dev, 0x68, 0x01);
-            if (status != 0) {
-                return status;
-            }
+            lms_txn_write(&txn, 0x68, 0x01);
 
             /* Disable decode control signals: RXVGA2 Decode = 0 */
-            status = lms_clear(dev, 0x64, (1 << 0));
-            if (status != 0) {
-                return status;
-            }
+            lms_txn_clear(&txn, 0x64, (1 << 0));
 
             /* Power DC comparitors down, per FAQ 5.26 (rev 1.0r10) */
-            status = lms_set(dev, 0x6e, (3 << 6));
+            lms_txn_set(&txn, 0x6e, (3 << 6));
+
+            status = lms_txn_commit(&txn);
             if (status != 0) {
                 return status;
             }
@@ -2475,29 +3441,6 @@ static int set_dc_cal_value(struct bladerf *dev, uint8_t base,
     return 0;
 }
 
-static int get_dc_cal_value(struct bladerf *dev, uint8_t base,
-                             uint8_t dc_addr, int16_t *value)
-{
-    int status;
-    uint8_t regval;
-
-    /* Keep reset inactive, cal disable, load addr */
-    status = LMS_WRITE(dev, base + 3, (0x08 | dc_addr));
-    if (status != 0) {
-        return status;
-    }
-
-    /* Fetch value from DC_REGVAL */
-    status = LMS_READ(dev, base, &regval);
-    if (status != 0) {
-        *value = -1;
-        return status;
-    }
-
-    *value = regval;
-    return 0;
-}
-
 int lms_set_dc_cals(struct bladerf *dev,
                      const struct bladerf_lms_dc_cals *dc_cals)
 {
@@ -2635,56 +3578,55 @@ int lms_set_dc_cals(struct bladerf *dev,
 int lms_get_dc_cals(struct bladerf *dev, struct bladerf_lms_dc_cals *dc_cals)
 {
     int status;
-
-    status = get_dc_cal_value(dev, 0x00, 0, &dc_cals->lpf_tuning);
-    if (status != 0) {
-        return status;
-    }
-
-    status = get_dc_cal_value(dev, 0x30, 0, &dc_cals->tx_lpf_i);
-    if (status != 0) {
-        return status;
-    }
-
-    status = get_dc_cal_value(dev, 0x30, 1, &dc_cals->tx_lpf_q);
-    if (status != 0) {
-        return status;
-    }
-
-    status = get_dc_cal_value(dev, 0x50, 0, &dc_cals->rx_lpf_i);
-    if (status != 0) {
-        return status;
-    }
-
-    status = get_dc_cal_value(dev, 0x50, 1, &dc_cals->rx_lpf_q);
-    if (status != 0) {
-        return status;
-    }
-
-    status = get_dc_cal_value(dev, 0x60, 0, &dc_cals->dc_ref);
-    if (status != 0) {
-        return status;
-    }
-
-    status = get_dc_cal_value(dev, 0x60, 1, &dc_cals->rxvga2a_i);
-    if (status != 0) {
-        return status;
-    }
-
-    status = get_dc_cal_value(dev, 0x60, 2, &dc_cals->rxvga2a_q);
-    if (status != 0) {
-        return status;
-    }
-
-    status = get_dc_cal_value(dev, 0x60, 3, &dc_cals->rxvga2b_i);
-    if (status != 0) {
-        return status;
-    }
-
-    status = get_dc_cal_value(dev, 0x60, 4, &dc_cals->rxvga2b_q);
-    if (status != 0) {
-        return status;
-    }
+    size_t i;
+
+    /* DC calibration values are read back in the order of the fields in
+     * struct bladerf_lms_dc_cals */
+    static const struct {
+        uint8_t base;
+        uint8_t dc_addr;
+    } cals[] = {
+        { 0x00, 0 },    /* LPF tuning */
+        { 0x30, 0 },    /* TX LPF I */
+        { 0x30, 1 },    /* TX LPF Q */
+        { 0x50, 0 },    /* RX LPF I */
+        { 0x50, 1 },    /* RX LPF Q */
+        { 0x60, 0 },    /* DC reference */
+        { 0x60, 1 },    /* RXVGA2A I */
+        { 0x60, 2 },    /* RXVGA2A Q */
+        { 0x60, 3 },    /* RXVGA2B I */
+        { 0x60, 4 },    /* RXVGA2B Q */
+    };
+
+    struct backend_reg_access regs[2 * ARRAY_SIZE(cals)];
+
+    /* For each value: keep reset inactive, cal disable, load addr, and then
+     * fetch the value from DC_REGVAL */
+    for (i = 0; i < ARRAY_SIZE(cals); i++) {
+        regs[2 * i].addr = cals[i].base + 3;
+        regs[2 * i].data = 0x08 | cals[i].dc_addr;
+        regs[2 * i].write = true;
+
+        regs[2 * i + 1].addr = cals[i].base;
+        regs[2 * i + 1].data = 0;
+        regs[2 * i + 1].write = false;
+    }
+
+    status = lms_access_batch(dev, regs, ARRAY_SIZE(regs));
+    if (status != 0) {
+        return status;
+    }
+
+    dc_cals->lpf_tuning = regs[1].data;
+    dc_cals->tx_lpf_i   = regs[3].data;
+    dc_cals->tx_lpf_q   = regs[5].data;
+    dc_cals->rx_lpf_i   = regs[7].data;
+    dc_cals->rx_lpf_q   = regs[9].data;
+    dc_cals->dc_ref     = regs[11].data;
+    dc_cals->rxvga2a_i  = regs[13].data;
+    dc_cals->rxvga2a_q  = regs[15].data;
+    dc_cals->rxvga2b_i  = regs[17].data;
+    dc_cals->rxvga2b_q  = regs[19].data;
 
     return 0;
 }
@@ -28,8 +28,67 @@
 #include <libbladeRF.h>
 #include "bladerf_priv.h"
 
-#define LMS_WRITE(dev, addr, value) dev->fn->lms_write(dev, addr, value)
-#define LMS_READ(dev, addr, value)  dev->fn->lms_read(dev, addr, value)
+#define LMS_WRITE(dev, addr, value) lms_write(dev, addr, value)
+#define LMS_READ(dev, addr, value)  lms_read(dev, addr, value)
+
+/**
+ * Read an LMS6002D register. The value is returned from the host-side register
+ * shadow when available, and fetched from the device otherwise.
+ *
+ * Registers reflecting hardware status (e.g., DC calibration results and
+ * VTUNE comparators) are never cached.
+ *
+ * @param[in]   dev     Device handle
+ * @param[in]   addr    Register address
+ * @param[out]  data    Register value
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_read(struct bladerf *dev, uint8_t addr, uint8_t *data);
+
+/**
+ * Write an LMS6002D register, updating the host-side register shadow
+ *
+ * @param[in]   dev     Device handle
+ * @param[in]   addr    Register address
+ * @param[in]   data    Register value
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_write(struct bladerf *dev, uint8_t addr, uint8_t data);
+
+/**
+ * Discard all cached LMS6002D register values. This must be called whenever
+ * the device's registers may have changed without the use of lms_write(),
+ * such as after a reset.
+ *
+ * @param[in]   dev     Device handle
+ */
+void lms_shadow_invalidate(struct bladerf *dev);
+
+/**
+ * Permanently exclude a register from the host-side register shadow, for
+ * the lifetime of the device handle. This is used for registers that the FPGA
+ * may write on its own, such as those targeted by scheduled updates.
+ *
+ * @param[in]   dev     Device handle
+ * @param[in]   addr    Register address
+ */
+void lms_shadow_mark_volatile(struct bladerf *dev, uint8_t addr);
+
+/**
+ * Read the registers that describe the device's RF configuration (frequency,
+ * bandwidth, LPF mode, gains, loopback, and sampling) into the register
+ * shadow, using a single batched access for all of those not already cached.
+ * The associated lms_*_get_*() calls are then served from the shadow.
+ *
+ * Volatile registers are skipped, as their values could not be retained.
+ *
+ * @param[in]   dev     Device handle
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_prefetch_config(struct bladerf *dev);
 
 
 /**
@@ -562,6 +621,322 @@ int lms_get_frequency(struct bladerf *dev, bladerf_module mod,
 int lms_set_frequency(struct bladerf *dev,
                       bladerf_module mod, uint32_t freq);
 
+/**
+ * Set the frequency of both modules in Hz. The PLL configuration is computed
+ * once, and the two modules' register writes and VCOCAP searches share
+ * control transfers.
+ *
+ * @param[in]   dev     Device handle
+ * @param[in]   freq    Frequency in Hz to tune
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_set_frequency_both(struct bladerf *dev, uint32_t freq);
+
+/**
+ * Perform a sequence of LMS6002D register accesses, in order.
+ *
+ * If supported by the backend, these accesses are pipelined to the device
+ * and only the final access is waited upon. This is considerably faster than
+ * issuing individual LMS_READ() and LMS_WRITE() calls for long sequences.
+ *
+ * @param[in]       dev     Device handle
+ * @param[inout]    regs    Register accesses. The `data` field of each read
+ *                          access is updated upon success.
+ * @param[in]       count   Number of entries in `regs`
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_access_batch(struct bladerf *dev,
+                     struct backend_reg_access *regs, size_t count);
+
+/**
+ * Read `len` consecutive LMS6002D registers, starting at `addr`.
+ *
+ * Registers held in the shadow are not read from the device. The remaining
+ * reads are issued as a single batch, which the FPGA performs as SPI bursts
+ * over runs of consecutive registers.
+ *
+ * @param[in]   dev     Device handle
+ * @param[in]   addr    First register address
+ * @param[out]  data    Register values
+ * @param[in]   len     Number of registers. `addr + len` may not exceed
+ *                      LMS_NUM_REGISTERS.
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_read_burst(struct bladerf *dev, uint8_t addr,
+                   uint8_t *data, size_t len);
+
+/**
+ * Write `len` consecutive LMS6002D registers, starting at `addr`, as a single
+ * batch. See lms_read_burst().
+ *
+ * @param[in]   dev     Device handle
+ * @param[in]   addr    First register address
+ * @param[in]   data    Register values
+ * @param[in]   len     Number of registers. `addr + len` may not exceed
+ *                      LMS_NUM_REGISTERS.
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_write_burst(struct bladerf *dev, uint8_t addr,
+                    const uint8_t *data, size_t len);
+
+/**
+ * Read any registers missing from the register shadow, and then power down
+ * the LMS6002D. Register contents are retained while powered down.
+ *
+ * @param[in]   dev     Device handle
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_standby(struct bladerf *dev);
+
+/**
+ * Power up the LMS6002D following lms_standby(), rewriting each shadowed
+ * register in a single batch. Volatile registers, which are not shadowed,
+ * are left as they were retained by the device.
+ *
+ * @param[in]   dev     Device handle
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_resume(struct bladerf *dev);
+
+/**
+ * Send any LMS6002D writes deferred while a batch is open (see
+ * bladerf_batch_begin()). Reads not served by the register shadow, and other
+ * accesses whose ordering matters, flush the deferred writes first.
+ *
+ * If the flush fails, its error is also retained, to be reported by
+ * bladerf_batch_end().
+ *
+ * @param[in]   dev     Device handle
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_defer_flush(struct bladerf *dev);
+
+/**
+ * Defer LMS6002D writes for the duration of an internal sequence, as
+ * bladerf_batch_begin() does. This nests within any batch the caller has
+ * open, in which case the writes are sent when that batch ends.
+ *
+ * @param[in]   dev     Device handle
+ */
+void lms_defer_begin(struct bladerf *dev);
+
+/**
+ * End a deferral started by lms_defer_begin(), flushing the deferred writes
+ * if no other deferral or batch remains open
+ *
+ * @param[in]   dev     Device handle
+ * @param[in]   status  Status of the deferred sequence
+ *
+ * @return `status` if it is nonzero, and otherwise the first failure of any
+ *         flush during the deferral
+ */
+int lms_defer_end(struct bladerf *dev, int status);
+
+#ifndef LMS_TXN_MAX_OPS
+#   define LMS_TXN_MAX_OPS 32
+#endif
+
+/**
+ * LMS6002D register transaction
+ *
+ * A transaction collects a sequence of register writes and read-modify-write
+ * operations, which are sent to the device when the transaction is committed.
+ * The registers needed by read-modify-write operations are all read in a
+ * single batch, the modifications are applied in order, and the resulting
+ * writes are then issued in a second batch. Thus, a transaction costs
+ * roughly two pipelined batches rather than one round trip per access.
+ *
+ * Because all reads precede all writes, a transaction must not contain
+ * operations whose outcome depends upon the side effects of an earlier write
+ * in the same transaction (e.g., reading back status bits).
+ */
+struct lms_txn {
+    struct bladerf *dev;
+    int status;
+    size_t num_ops;
+
+    struct {
+        uint8_t addr;
+        uint8_t mask;   /* Bits to replace; 0xff for a plain write */
+        uint8_t value;
+    } ops[LMS_TXN_MAX_OPS];
+};
+
+/**
+ * Begin a register transaction
+ *
+ * @param[out]  txn     Transaction to initialize
+ * @param[in]   dev     Device handle
+ */
+void lms_txn_begin(struct lms_txn *txn, struct bladerf *dev);
+
+/**
+ * Queue a write of `value` to the register at `addr`
+ *
+ * If the transaction is full, the queued operations are committed first.
+ * Any resulting error is reported by lms_txn_commit().
+ */
+void lms_txn_write(struct lms_txn *txn, uint8_t addr, uint8_t value);
+
+/**
+ * Queue a read-modify-write of the register at `addr`, replacing the bits
+ * set in `mask` with those in `value`
+ */
+void lms_txn_modify(struct lms_txn *txn, uint8_t addr,
+                    uint8_t mask, uint8_t value);
+
+/**
+ * Queue setting the bits in `mask` in the register at `addr`
+ */
+static inline void lms_txn_set(struct lms_txn *txn, uint8_t addr, uint8_t mask)
+{
+    lms_txn_modify(txn, addr, mask, mask);
+}
+
+/**
+ * Queue clearing the bits in `mask` in the register at `addr`
+ */
+static inline void lms_txn_clear(struct lms_txn *txn,
+                                 uint8_t addr, uint8_t mask)
+{
+    lms_txn_modify(txn, addr, mask, 0x00);
+}
+
+/**
+ * Send all queued operations to the device
+ *
+ * The transaction may continue to be used after this call.
+ *
+ * @param[in]   txn     Transaction to commit
+ *
+ * @return 0 on success, or the BLADERF_ERR_* value of the first failure to
+ *         occur during the transaction
+ */
+int lms_txn_commit(struct lms_txn *txn);
+
+/**
+ * Fetch the PLL and VCOCAP configuration of the specified module
+ *
+ * Only the `frequency`, `nint`, `nfrac`, `freqsel`, and `vcocap` fields
+ * are populated.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   mod         Module to query
+ * @param[out]  quick_tune  Quick retune parameters
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_get_quick_tune(struct bladerf *dev, bladerf_module mod,
+                       struct bladerf_quick_tune *quick_tune);
+
+/**
+ * Apply the PLL and VCOCAP configuration from lms_get_quick_tune()
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   mod         Module to configure
+ * @param[in]   quick_tune  Quick retune parameters
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_set_quick_tune(struct bladerf *dev, bladerf_module mod,
+                       const struct bladerf_quick_tune *quick_tune);
+
+/**
+ * Set an LMS6002D DC offset correction
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to configure
+ * @param[in]   corr        BLADERF_CORR_LMS_DCOFF_I or BLADERF_CORR_LMS_DCOFF_Q
+ * @param[in]   value       Correction value, normalized to [-2048, 2048]
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_set_dc_offset(struct bladerf *dev, bladerf_module module,
+                      bladerf_correction corr, int16_t value);
+
+/**
+ * Set both LMS6002D DC offset corrections of a module in a single transaction.
+ * Registers already holding the requested values are not written.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to configure
+ * @param[in]   dc_i        I correction value, normalized to [-2048, 2048]
+ * @param[in]   dc_q        Q correction value, normalized to [-2048, 2048]
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_set_dc_offsets(struct bladerf *dev, bladerf_module module,
+                       int16_t dc_i, int16_t dc_q);
+
+/**
+ * Get an LMS6002D DC offset correction
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to query
+ * @param[in]   corr        BLADERF_CORR_LMS_DCOFF_I or BLADERF_CORR_LMS_DCOFF_Q
+ * @param[out]  value       Correction value, normalized to [-2048, 2048]
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_get_dc_offset(struct bladerf *dev, bladerf_module module,
+                      bladerf_correction corr, int16_t *value);
+
+/* Number of registers written to configure the RX and TX gain stages */
+#define LMS_RX_GAIN_NUM_REGS 3
+#define LMS_TX_GAIN_NUM_REGS 2
+
+/**
+ * Compute the register writes that configure all RX gain stages. These may be
+ * applied via lms_access_batch(). Out of range VGA gains are clamped.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   lnagain     LNA gain (bypass, mid or max)
+ * @param[in]   rxvga1      RXVGA1 gain in dB
+ * @param[in]   rxvga2      RXVGA2 gain in dB
+ * @param[out]  regs        Populated with LMS_RX_GAIN_NUM_REGS writes
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_get_rx_gain_regs(struct bladerf *dev, bladerf_lna_gain lnagain,
+                         int rxvga1, int rxvga2,
+                         struct backend_reg_access *regs);
+
+/**
+ * Compute the register writes that configure all TX gain stages. These may be
+ * applied via lms_access_batch(). Out of range gains are clamped.
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   txvga1      TXVGA1 gain in dB
+ * @param[in]   txvga2      TXVGA2 gain in dB
+ * @param[out]  regs        Populated with LMS_TX_GAIN_NUM_REGS writes
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_get_tx_gain_regs(struct bladerf *dev, int txvga1, int txvga2,
+                         struct backend_reg_access *regs);
+
+/**
+ * Compute the register values that the FPGA writes to perform a scheduled
+ * retune with the provided quick retune parameters
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   mod         Module to retune
+ * @param[in]   quick_tune  Quick retune parameters
+ * @param[out]  regs        Register values
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int lms_get_retune_regs(struct bladerf *dev, bladerf_module mod,
+                        const struct bladerf_quick_tune *quick_tune,
+                        struct backend_retune *regs);
+
 /**
  * Read back every register from the LMS6002D device.
  *
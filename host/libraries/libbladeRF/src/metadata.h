@@ -37,6 +37,10 @@
  *  0x0c |      Flags      |    4 bytes, Little-endian uint32_t
  *       +-----------------+
  *
+ * The remainder of the message holds samples of 4 bytes each, or of 2 bytes
+ * each with the 8-bit SC8 Q7 format. A message therefore carries 252 or 508
+ * SC16 Q11 samples, or 504 or 1016 SC8 Q7 samples.
+ *
  * The term "buffer" is used to describe a block of of data received from or
  * sent to the device. The size of a "buffer" (in bytes) is always a multiple
  * of the size of a "message." Said another way, a buffer will always evenly
@@ -71,6 +75,73 @@
  *
  */
 
+/*
+ * The channelizer FPGA image tags each RX message via the reserved word:
+ *
+ *   [31:24]    METADATA_CHANNEL_TAG_MARKER
+ *   [19:16]    Channel of the first sample in the message
+ *   [15:0]     Mask of channels being streamed
+ *
+ * Other images leave an arbitrary, untagged value here.
+ */
+#define METADATA_CHANNEL_TAG_MARKER 0xc4
+
+/*
+ * FPGA v0.1.13 and later accept gated TX messages, in which the reserved
+ * word holds:
+ *
+ *   [31]       METADATA_TX_GATED
+ *   [15:0]     Number of 32-bit sample words following the header
+ *
+ * Only those words are transmitted, and the FPGA sends zeros until the next
+ * message's timestamp. A gated message with no words is discarded without
+ * taking any time.
+ *
+ * FPGA v0.1.20 and later also accept, gated or not:
+ *
+ *   [30]       METADATA_TX_DROP_LATE
+ *
+ * A timed message that arrives after its timestamp has passed is then
+ * discarded, with zeros sent in its place, rather than transmitted late.
+ *
+ * FPGA v0.1.22 and later also accept gated waveform messages:
+ *
+ *   [29]       METADATA_TX_PLAY
+ *   [28]       METADATA_TX_LOAD
+ *   [19:16]    Waveform ID
+ *
+ * A load message's words are written to the FPGA's waveform memory rather
+ * than transmitted, starting once the previous message has been sent, and its
+ * timestamp field instead holds:
+ *
+ *   [15:0]     Waveform memory address of the message's first word
+ *   [31:16]    Waveform memory address of the waveform's first sample
+ *   [47:32]    Waveform length, in samples
+ *
+ * A play message normally has no words, and transmits the waveform at its
+ * timestamp.
+ */
+#define METADATA_TX_GATED       (1u << 31)
+#define METADATA_TX_DROP_LATE   (1u << 30)
+#define METADATA_TX_PLAY        (1u << 29)
+#define METADATA_TX_LOAD        (1u << 28)
+#define METADATA_TX_WORDS_MASK  0xffff
+
+#define METADATA_TX_WAVEFORM_ID(id) (((uint32_t) (id) & 0xf) << 16)
+#define METADATA_TX_LOAD_ADDR(addr, base, len) \
+    (((uint64_t) (len) << 32) | ((uint64_t) (base) << 16) | (uint64_t) (addr))
+
+/*
+ * FPGA v0.1.19 and later report RX FIFO overflows in the flags word of the
+ * first RX message written after samples were dropped:
+ *
+ *   [31]       Zero
+ *   [30]       BLADERF_META_FLAG_RX_OVERFLOW
+ *   [29:0]     Number of samples dropped, saturating
+ *
+ * Earlier images set every bit of this word.
+ */
+
 /* Components of the metadata header */
 #define METADATA_RESV_SIZE      (sizeof(uint32_t))
 #define METADATA_TIMESTAMP_SIZE (sizeof(uint64_t))
@@ -95,6 +166,33 @@ static inline uint64_t metadata_get_timestamp(const uint8_t *header)
    return ret;
 }
 
+static inline uint32_t metadata_get_resv(const uint8_t *header)
+{
+   uint32_t ret;
+   assert(sizeof(ret) == METADATA_RESV_SIZE);
+   memcpy(&ret, &header[METADATA_RESV_OFFSET], METADATA_RESV_SIZE);
+   return LE32_TO_HOST(ret);
+}
+
+/* Returns the channel mask of a channelizer tagged header, or 0 if the
+ * header is not tagged */
+static inline uint16_t metadata_get_channel_mask(const uint8_t *header)
+{
+   const uint32_t resv = metadata_get_resv(header);
+
+   if ((resv >> 24) == METADATA_CHANNEL_TAG_MARKER) {
+      return resv & 0xffff;
+   } else {
+      return 0;
+   }
+}
+
+/* Returns the channel of the first sample in a channelizer tagged header */
+static inline uint8_t metadata_get_channel(const uint8_t *header)
+{
+   return (metadata_get_resv(header) >> 16) & 0xf;
+}
+
 static inline uint32_t metadata_get_flags(const uint8_t *header)
 {
    uint32_t ret;
@@ -124,4 +222,28 @@ static inline void metadata_set(uint8_t *header,
            METADATA_FLAGS_SIZE);
 }
 
+static inline void metadata_set_tx_words(uint8_t *header, uint32_t words)
+{
+    uint32_t resv = HOST_TO_LE32((metadata_get_resv(header) &
+                                  METADATA_TX_DROP_LATE) |
+                                 METADATA_TX_GATED |
+                                 (words & METADATA_TX_WORDS_MASK));
+
+    memcpy(&header[METADATA_RESV_OFFSET], &resv, METADATA_RESV_SIZE);
+}
+
+static inline void metadata_set_resv(uint8_t *header, uint32_t resv)
+{
+    resv = HOST_TO_LE32(resv);
+    memcpy(&header[METADATA_RESV_OFFSET], &resv, METADATA_RESV_SIZE);
+}
+
+static inline void metadata_set_tx_drop_late(uint8_t *header)
+{
+    uint32_t resv = HOST_TO_LE32(metadata_get_resv(header) |
+                                 METADATA_TX_DROP_LATE);
+
+    memcpy(&header[METADATA_RESV_OFFSET], &resv, METADATA_RESV_SIZE);
+}
+
 #endif
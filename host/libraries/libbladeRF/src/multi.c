@@ -0,0 +1,585 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ *
+ * Each device streams through its own synchronous interface, using the
+ * SC16 Q11 META format. A session tracks a single position, `pos`, in
+ * samples since its start, and device i's sample at `pos` is the one with
+ * timestamp (start_i + pos).
+ *
+ * Before the first read, each device's stale samples are drained in turn, up
+ * to its start timestamp. Waiting on one device for the start would otherwise
+ * leave the others unread, such that they drop the samples at the start.
+ *
+ * Reads request each device's samples by timestamp. If a device dropped the
+ * samples at `pos`, its read fails with BLADERF_ERR_TIME_PAST, and the
+ * session skips ahead on every device until all of them have samples
+ * available.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "log.h"
+#include "bladerf_priv.h"
+#include "async.h"
+#include "multi.h"
+
+/* Bytes per SC16 Q11 sample */
+#define SAMPLE_SIZE (2 * sizeof(int16_t))
+
+struct multi_device {
+    struct bladerf *dev;
+    int16_t *buf;               /* One buffer of this device's samples */
+    uint64_t start;             /* Timestamp of the session's first sample */
+    double uncertainty_us;
+    bool enabled;               /* Module has been enabled */
+    bool correlating;           /* Timestamp correlation was started */
+};
+
+struct bladerf_multi {
+    struct multi_device *devs;
+    unsigned int num_devs;
+    struct bladerf_multi_config config;
+
+    bool started;
+    bool primed;                /* RX only */
+    bool burst_started;         /* TX only */
+    bool ended;                 /* TX only */
+    uint64_t pos;
+};
+
+int multi_init(struct bladerf_multi **multi, struct bladerf *const *devs,
+               unsigned int num_devs, const struct bladerf_multi_config *config)
+{
+    struct bladerf_multi *m;
+    unsigned int i;
+    int status = 0;
+
+    *multi = NULL;
+
+    if (num_devs == 0) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (config->module != BLADERF_MODULE_RX &&
+        config->module != BLADERF_MODULE_TX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (config->buffer_size == 0 || config->buffer_size % 1024 != 0) {
+        log_debug("%s: Buffer size must be a multiple of 1024\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    for (i = 0; i < num_devs; i++) {
+        if (devs[i] == NULL) {
+            return BLADERF_ERR_INVAL;
+        }
+    }
+
+    m = calloc(1, sizeof(*m));
+    if (m == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    m->devs = calloc(num_devs, sizeof(m->devs[0]));
+    if (m->devs == NULL) {
+        free(m);
+        return BLADERF_ERR_MEM;
+    }
+
+    m->num_devs = num_devs;
+    m->config = *config;
+
+    if (m->config.start_delay_ms == 0) {
+        m->config.start_delay_ms = MULTI_DEFAULT_START_DELAY_MS;
+    }
+
+    for (i = 0; i < num_devs; i++) {
+        m->devs[i].dev = devs[i];
+        m->devs[i].buf = malloc(config->buffer_size * SAMPLE_SIZE);
+        if (m->devs[i].buf == NULL) {
+            status = BLADERF_ERR_MEM;
+            goto error;
+        }
+    }
+
+    /* Clocking is configured before any of the streams are started, as
+     * changing a device's reference disturbs its sample clock */
+    if (config->mimo_clock) {
+        for (i = 0; i < num_devs && status == 0; i++) {
+            status = bladerf_set_mimo_mode(devs[i], i == 0 ?
+                                           BLADERF_MIMO_MASTER :
+                                           BLADERF_MIMO_SLAVE);
+        }
+
+        if (status != 0) {
+            log_debug("%s: Failed to configure MIMO clocking on device %u: "
+                      "%s\n", __FUNCTION__, i - 1, bladerf_strerror(status));
+            goto error;
+        }
+    }
+
+    for (i = 0; i < num_devs; i++) {
+        struct multi_device *d = &m->devs[i];
+
+        status = bladerf_sync_config(d->dev, config->module,
+                                     BLADERF_FORMAT_SC16_Q11_META,
+                                     config->num_buffers,
+                                     config->buffer_size,
+                                     config->num_transfers,
+                                     config->stream_timeout);
+        if (status != 0) {
+            goto error;
+        }
+
+        status = bladerf_enable_module(d->dev, config->module, true);
+        if (status != 0) {
+            goto error;
+        }
+        d->enabled = true;
+
+        if (config->align == BLADERF_MULTI_ALIGN_HOST_CLOCK) {
+            status = bladerf_enable_timestamp_correlation(d->dev,
+                                                          config->module,
+                                                          MULTI_CORR_INTERVAL_MS);
+            if (status != 0) {
+                goto error;
+            }
+            d->correlating = true;
+        }
+    }
+
+    *multi = m;
+    return 0;
+
+error:
+    multi_deinit(m);
+    return status;
+}
+
+/* Start every device at the same timestamp, far enough beyond the latest of
+ * their current timestamps */
+static int start_by_timestamp(struct bladerf_multi *m)
+{
+    const bladerf_module module = m->config.module;
+    uint64_t latest = 0, ts, delay;
+    unsigned int rate, i;
+    int status;
+
+    status = bladerf_get_sample_rate(m->devs[0].dev, module, &rate);
+    if (status != 0) {
+        return status;
+    }
+
+    for (i = 0; i < m->num_devs; i++) {
+        status = bladerf_get_timestamp(m->devs[i].dev, module, &ts);
+        if (status != 0) {
+            return status;
+        }
+
+        if (ts > latest) {
+            latest = ts;
+        }
+    }
+
+    delay = (uint64_t) m->config.start_delay_ms * rate / 1000;
+
+    for (i = 0; i < m->num_devs; i++) {
+        m->devs[i].start = latest + delay;
+        m->devs[i].uncertainty_us = 0;
+    }
+
+    return 0;
+}
+
+/* Start every device at the timestamp it is estimated to have at the same
+ * host time */
+static int start_by_host_clock(struct bladerf_multi *m)
+{
+    const bladerf_module module = m->config.module;
+    const int64_t delay_us = (int64_t) m->config.start_delay_ms * 1000;
+    const uint64_t t0 = async_stats_time_us();
+    struct bladerf_timestamp_correlation info;
+    unsigned int i;
+    int status;
+
+    for (i = 0; i < m->num_devs; i++) {
+        struct multi_device *d = &m->devs[i];
+
+        /* Account for the time spent on the previous devices, so that all
+         * estimates refer to t0 + delay_us */
+        const int64_t elapsed_us = (int64_t) (async_stats_time_us() - t0);
+
+        status = bladerf_estimate_timestamp(d->dev, module,
+                                            delay_us - elapsed_us, &d->start);
+        if (status != 0) {
+            return status;
+        }
+
+        status = bladerf_get_timestamp_correlation(d->dev, module, &info);
+        if (status != 0) {
+            return status;
+        }
+
+        d->uncertainty_us = info.uncertainty_us;
+    }
+
+    return 0;
+}
+
+int multi_start(struct bladerf_multi *m)
+{
+    unsigned int i;
+    int status;
+
+    if (m->started) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (m->config.align == BLADERF_MULTI_ALIGN_TIMESTAMP) {
+        status = start_by_timestamp(m);
+    } else {
+        status = start_by_host_clock(m);
+    }
+
+    if (status != 0) {
+        return status;
+    }
+
+    for (i = 0; i < m->num_devs; i++) {
+        log_debug("%s: Device %u starts at t=%"PRIu64" (+/- %.1f us)\n",
+                  __FUNCTION__, i, m->devs[i].start,
+                  m->devs[i].uncertainty_us);
+    }
+
+    m->pos = 0;
+    m->started = true;
+    return 0;
+}
+
+int multi_get_start(struct bladerf_multi *m, unsigned int index,
+                    uint64_t *timestamp, double *uncertainty_us)
+{
+    if (!m->started || index >= m->num_devs) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    *timestamp = m->devs[index].start;
+
+    if (uncertainty_us != NULL) {
+        *uncertainty_us = m->devs[index].uncertainty_us;
+    }
+
+    return 0;
+}
+
+/* Discard each device's samples preceding its start timestamp, in turns of
+ * at most a buffer per device */
+static int rx_prime(struct bladerf_multi *m, unsigned int timeout_ms)
+{
+    struct bladerf_metadata meta;
+    uint64_t remaining;
+    unsigned int i, n, num_ready = 0;
+    bool *ready;
+    int status = 0;
+
+    ready = calloc(m->num_devs, sizeof(ready[0]));
+    if (ready == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    while (num_ready < m->num_devs && status == 0) {
+        for (i = 0; i < m->num_devs && status == 0; i++) {
+            struct multi_device *d = &m->devs[i];
+
+            if (ready[i]) {
+                continue;
+            }
+
+            /* The first read of a single sample determines the timestamp
+             * at which the device's samples are currently being read */
+            memset(&meta, 0, sizeof(meta));
+            meta.flags = BLADERF_META_FLAG_RX_NOW;
+
+            status = bladerf_sync_rx(d->dev, d->buf, 1, &meta, timeout_ms);
+            if (status != 0) {
+                break;
+            }
+
+            if (meta.timestamp + 1 >= d->start) {
+                /* If the start has been passed, rx_chunk() skips ahead */
+                ready[i] = true;
+                num_ready++;
+                continue;
+            }
+
+            remaining = d->start - (meta.timestamp + 1);
+            n = remaining < m->config.buffer_size ?
+                    (unsigned int) remaining : m->config.buffer_size;
+
+            if (n != 0) {
+                status = bladerf_sync_rx(d->dev, d->buf, n, &meta, timeout_ms);
+            }
+
+            if (n == remaining) {
+                ready[i] = true;
+                num_ready++;
+            }
+        }
+    }
+
+    free(ready);
+    return status;
+}
+
+/* Read up to `n` samples per device at the current position, interleaving
+ * them into `out`. `*actual` is updated with the number of samples per device
+ * written to `out`, which is less than `n` if a device dropped samples during
+ * the read.
+ *
+ * If the samples at the current position were dropped by a device, the session
+ * skips ahead if `may_skip` is set, adding the number of samples skipped to
+ * `*skipped`. Otherwise, 0 samples are read. */
+static int rx_chunk(struct bladerf_multi *m, int16_t *out, unsigned int n,
+                    bool may_skip, unsigned int *actual, uint64_t *skipped,
+                    unsigned int timeout_ms)
+{
+    struct bladerf_metadata meta;
+    unsigned int i, k, count, attempts = 0;
+    int status;
+
+    *actual = 0;
+
+retry:
+    count = n;
+
+    for (i = 0; i < m->num_devs; i++) {
+        struct multi_device *d = &m->devs[i];
+
+        memset(&meta, 0, sizeof(meta));
+        meta.timestamp = d->start + m->pos;
+
+        status = bladerf_sync_rx(d->dev, d->buf, n, &meta, timeout_ms);
+
+        if (status == BLADERF_ERR_TIME_PAST) {
+            log_debug("%s: Device %u dropped samples at t=%"PRIu64"\n",
+                      __FUNCTION__, i, meta.timestamp);
+
+            if (!may_skip) {
+                return 0;
+            }
+
+            if (++attempts > MULTI_MAX_RESYNC) {
+                log_debug("%s: Failed to realign devices\n", __FUNCTION__);
+                return BLADERF_ERR_IO;
+            }
+
+            /* Devices before this one have now consumed these samples, so
+             * skipping them keeps every device's reads contiguous */
+            m->pos += n;
+            *skipped += n;
+            goto retry;
+
+        } else if (status != 0) {
+            return status;
+        }
+
+        if ((meta.status & BLADERF_META_STATUS_OVERRUN) &&
+            meta.actual_count < count) {
+            count = meta.actual_count;
+        }
+    }
+
+    for (k = 0; k < count; k++) {
+        for (i = 0; i < m->num_devs; i++) {
+            memcpy(&out[2 * (k * m->num_devs + i)], &m->devs[i].buf[2 * k],
+                   SAMPLE_SIZE);
+        }
+    }
+
+    m->pos += count;
+    *actual = count;
+    return 0;
+}
+
+int multi_rx(struct bladerf_multi *m, int16_t *samples,
+             unsigned int num_samples, struct bladerf_metadata *metadata,
+             unsigned int timeout_ms)
+{
+    unsigned int done = 0, n, actual;
+    uint64_t skipped = 0;
+    uint64_t first = 0;
+    int status = 0;
+
+    if (!m->started || m->config.module != BLADERF_MODULE_RX) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (!m->primed) {
+        status = rx_prime(m, timeout_ms);
+        if (status != 0) {
+            return status;
+        }
+
+        m->primed = true;
+    }
+
+    while (done < num_samples) {
+        n = num_samples - done;
+        if (n > m->config.buffer_size) {
+            n = m->config.buffer_size;
+        }
+
+        status = rx_chunk(m, &samples[2 * done * m->num_devs], n, done == 0,
+                          &actual, &skipped, timeout_ms);
+        if (status != 0) {
+            return status;
+        }
+
+        if (done == 0) {
+            /* This accounts for any samples skipped at the start */
+            first = m->pos - actual;
+        }
+
+        done += actual;
+
+        /* Return what is contiguous, leaving the gap to the next call */
+        if (actual < n) {
+            break;
+        }
+    }
+
+    if (metadata != NULL) {
+        metadata->timestamp = first;
+        metadata->status = 0;
+        metadata->actual_count = done;
+        metadata->dropped_samples = skipped;
+
+        if (skipped != 0 || done < num_samples) {
+            metadata->status |= BLADERF_META_STATUS_OVERRUN;
+        }
+    }
+
+    return 0;
+}
+
+/* Transmit the two zero samples that end a burst on every device */
+static int end_burst(struct bladerf_multi *m, unsigned int timeout_ms)
+{
+    int16_t zeros[4] = { 0, 0, 0, 0 };
+    struct bladerf_metadata meta;
+    unsigned int i;
+    int status = 0;
+
+    for (i = 0; i < m->num_devs; i++) {
+        int tmp;
+
+        memset(&meta, 0, sizeof(meta));
+        meta.flags = BLADERF_META_FLAG_TX_BURST_END;
+
+        tmp = bladerf_sync_tx(m->devs[i].dev, zeros, 2, &meta, timeout_ms);
+        if (tmp != 0 && status == 0) {
+            status = tmp;
+        }
+    }
+
+    m->ended = true;
+    return status;
+}
+
+int multi_tx(struct bladerf_multi *m, const int16_t *samples,
+             unsigned int num_samples, struct bladerf_metadata *metadata,
+             unsigned int timeout_ms)
+{
+    struct bladerf_metadata meta;
+    unsigned int done = 0, n, i, k;
+    int status;
+
+    if (!m->started || m->config.module != BLADERF_MODULE_TX || m->ended) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    while (done < num_samples) {
+        n = num_samples - done;
+        if (n > m->config.buffer_size) {
+            n = m->config.buffer_size;
+        }
+
+        for (i = 0; i < m->num_devs; i++) {
+            struct multi_device *d = &m->devs[i];
+
+            for (k = 0; k < n; k++) {
+                memcpy(&d->buf[2 * k],
+                       &samples[2 * ((done + k) * m->num_devs + i)],
+                       SAMPLE_SIZE);
+            }
+
+            memset(&meta, 0, sizeof(meta));
+            if (!m->burst_started) {
+                meta.timestamp = d->start;
+                meta.flags = BLADERF_META_FLAG_TX_BURST_START;
+            }
+
+            status = bladerf_sync_tx(d->dev, d->buf, n, &meta, timeout_ms);
+            if (status != 0) {
+                return status;
+            }
+        }
+
+        m->burst_started = true;
+        m->pos += n;
+        done += n;
+    }
+
+    if (metadata != NULL && (metadata->flags & BLADERF_META_FLAG_TX_BURST_END)) {
+        return end_burst(m, timeout_ms);
+    }
+
+    return 0;
+}
+
+void multi_deinit(struct bladerf_multi *m)
+{
+    unsigned int i;
+
+    if (m->burst_started && !m->ended) {
+        end_burst(m, m->config.stream_timeout);
+    }
+
+    for (i = 0; i < m->num_devs; i++) {
+        struct multi_device *d = &m->devs[i];
+
+        if (d->correlating) {
+            bladerf_enable_timestamp_correlation(d->dev, m->config.module, 0);
+        }
+
+        if (d->enabled) {
+            bladerf_enable_module(d->dev, m->config.module, false);
+        }
+
+        free(d->buf);
+    }
+
+    free(m->devs);
+    free(m);
+}
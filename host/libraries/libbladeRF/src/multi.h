@@ -0,0 +1,93 @@
+/**
+ * @file multi.h
+ *
+ * @brief Time-aligned streaming with multiple devices
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BLADERF_MULTI_H_
+#define BLADERF_MULTI_H_
+
+#include "libbladeRF.h"
+
+/* Start delay used when the configuration specifies 0 */
+#ifndef MULTI_DEFAULT_START_DELAY_MS
+#   define MULTI_DEFAULT_START_DELAY_MS 100
+#endif
+
+/* Period of the timestamp correlation used by BLADERF_MULTI_ALIGN_HOST_CLOCK */
+#ifndef MULTI_CORR_INTERVAL_MS
+#   define MULTI_CORR_INTERVAL_MS 50
+#endif
+
+/* Number of times a read may skip ahead to get past dropped samples before
+ * giving up */
+#ifndef MULTI_MAX_RESYNC
+#   define MULTI_MAX_RESYNC 16
+#endif
+
+/**
+ * Create a session and arm each device's stream. The caller must not hold
+ * any device's control lock.
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int multi_init(struct bladerf_multi **multi, struct bladerf *const *devs,
+               unsigned int num_devs, const struct bladerf_multi_config *config);
+
+/**
+ * Schedule the start of each device's stream
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int multi_start(struct bladerf_multi *multi);
+
+/**
+ * Get a device's start timestamp
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on failure
+ */
+int multi_get_start(struct bladerf_multi *multi, unsigned int index,
+                    uint64_t *timestamp, double *uncertainty_us);
+
+/**
+ * Receive interleaved samples from all devices
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int multi_rx(struct bladerf_multi *multi, int16_t *samples,
+             unsigned int num_samples, struct bladerf_metadata *metadata,
+             unsigned int timeout_ms);
+
+/**
+ * Transmit interleaved samples on all devices
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int multi_tx(struct bladerf_multi *multi, const int16_t *samples,
+             unsigned int num_samples, struct bladerf_metadata *metadata,
+             unsigned int timeout_ms);
+
+/**
+ * End the session and free it
+ */
+void multi_deinit(struct bladerf_multi *multi);
+
+#endif
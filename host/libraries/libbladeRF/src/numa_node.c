@@ -0,0 +1,199 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_config.h"
+#include "numa_node.h"
+#include "log.h"
+
+#if BLADERF_OS_LINUX
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#define NUMA_SYSFS_NODES "/sys/devices/system/node"
+
+#ifndef MPOL_PREFERRED
+#   define MPOL_PREFERRED 1
+#endif
+
+/* Read the first line of a sysfs attribute */
+static bool read_attr(const char *path, char *buf, size_t len)
+{
+    bool ok;
+    FILE *f = fopen(path, "r");
+
+    if (f == NULL) {
+        return false;
+    }
+
+    ok = fgets(buf, (int) len, f) != NULL;
+    fclose(f);
+
+    return ok;
+}
+
+/* Parse a sysfs list (e.g., "0-7,16-23") into a bitmask of its first 64
+ * entries, and count all of its entries */
+static bool parse_list(const char *str, uint64_t *mask, unsigned int *count)
+{
+    char *end;
+    unsigned long first, last, i;
+
+    *mask = 0;
+    *count = 0;
+
+    while (*str != '\0' && *str != '\n') {
+        first = strtoul(str, &end, 10);
+        if (end == str) {
+            return false;
+        }
+
+        last = first;
+        str = end;
+
+        if (*str == '-') {
+            str++;
+            last = strtoul(str, &end, 10);
+            if (end == str || last < first) {
+                return false;
+            }
+            str = end;
+        }
+
+        for (i = first; i <= last; i++) {
+            if (i < 64) {
+                *mask |= UINT64_C(1) << i;
+            }
+            (*count)++;
+        }
+
+        if (*str == ',') {
+            str++;
+        }
+    }
+
+    return true;
+}
+
+static unsigned int num_nodes(void)
+{
+    char buf[256];
+    uint64_t mask;
+    unsigned int count;
+
+    if (!read_attr(NUMA_SYSFS_NODES "/online", buf, sizeof(buf)) ||
+        !parse_list(buf, &mask, &count)) {
+        return 1;
+    }
+
+    return count;
+}
+
+int numa_usb_bus_node(unsigned int bus)
+{
+    char path[128];
+    char buf[32];
+    int node;
+
+    if (num_nodes() < 2) {
+        return -1;
+    }
+
+    /* The root hub's parent is the host controller's PCI device */
+    snprintf(path, sizeof(path), "/sys/bus/usb/devices/usb%u/../numa_node",
+             bus);
+
+    if (!read_attr(path, buf, sizeof(buf))) {
+        log_debug("Failed to read NUMA node of USB bus %u\n", bus);
+        return -1;
+    }
+
+    node = atoi(buf);
+    return (node >= 0) ? node : -1;
+}
+
+uint64_t numa_node_cpus(int node)
+{
+    char path[128];
+    char buf[1024];
+    uint64_t mask;
+    unsigned int count;
+
+    if (node < 0) {
+        return 0;
+    }
+
+    snprintf(path, sizeof(path), NUMA_SYSFS_NODES "/node%d/cpulist", node);
+
+    if (!read_attr(path, buf, sizeof(buf)) ||
+        !parse_list(buf, &mask, &count)) {
+        return 0;
+    }
+
+    return mask;
+}
+
+bool numa_bind_memory(void *mem, size_t size, int node)
+{
+#ifdef SYS_mbind
+    unsigned long nodemask;
+    const unsigned long maxnode = 8 * sizeof(nodemask);
+
+    if (node < 0 || (unsigned long) node >= maxnode) {
+        return false;
+    }
+
+    nodemask = 1UL << node;
+
+    /* The kernel considers maxnode - 1 bits of the mask */
+    if (syscall(SYS_mbind, mem, size, MPOL_PREFERRED, &nodemask,
+                maxnode + 1, 0) != 0) {
+        log_debug("mbind() failed: %s\n", strerror(errno));
+        return false;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+#else
+
+int numa_usb_bus_node(unsigned int bus)
+{
+    return -1;
+}
+
+uint64_t numa_node_cpus(int node)
+{
+    return 0;
+}
+
+bool numa_bind_memory(void *mem, size_t size, int node)
+{
+    return false;
+}
+
+#endif
@@ -0,0 +1,62 @@
+/**
+ * @file numa_node.h
+ *
+ * @brief NUMA placement of stream buffers and threads
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BLADERF_NUMA_NODE_H_
+#define BLADERF_NUMA_NODE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * Get the NUMA node of the host controller of a USB bus
+ *
+ * @param   bus     USB bus number
+ *
+ * @return node number, or -1 if it is unknown or the host has only one node
+ */
+int numa_usb_bus_node(unsigned int bus);
+
+/**
+ * Get the CPUs of a NUMA node
+ *
+ * @param   node    Node number
+ *
+ * @return bitmask of the node's CPUs (0 through 63), or 0 if unknown
+ */
+uint64_t numa_node_cpus(int node);
+
+/**
+ * Set the preferred NUMA node of a region of memory that has not yet been
+ * touched, such that its pages are allocated on that node where possible
+ *
+ * @param   mem     Page-aligned start of the region
+ * @param   size    Size of the region, in bytes
+ * @param   node    Node number
+ *
+ * @return true on success, false if this is not supported or failed
+ */
+bool numa_bind_memory(void *mem, size_t size, int node);
+
+#endif
@@ -0,0 +1,248 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <string.h>
+
+#include "log.h"
+#include "pattern.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   define PATTERN_SSE2 1
+#   include <emmintrin.h>
+#else
+#   define PATTERN_SSE2 0
+#endif
+
+#if !PATTERN_SSE2 && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#   define PATTERN_NEON 1
+#   include <arm_neon.h>
+#else
+#   define PATTERN_NEON 0
+#endif
+
+/* The 32-bit word carried by sample i */
+static inline uint32_t word_at(const int16_t *samples, unsigned int i)
+{
+    return (uint16_t) samples[2 * i] |
+           ((uint32_t) (uint16_t) samples[2 * i + 1] << 16);
+}
+
+static inline uint32_t next_word(bladerf_pattern pattern, uint32_t x)
+{
+    if (pattern == BLADERF_PATTERN_COUNTER) {
+        return x + 1;
+    }
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+/* Starting at sample i, whose predecessor is sample i - 1, find the first
+ * sample that does not follow its predecessor. Returns n if all do. */
+static unsigned int find_break(bladerf_pattern pattern,
+                               const int16_t *samples,
+                               unsigned int i, unsigned int n)
+{
+#if PATTERN_SSE2
+    const __m128i one = _mm_set1_epi32(1);
+
+    /* Each vector of 4 words is compared with the vector of their
+     * predecessors, loaded one sample earlier */
+    for (; i + 4 <= n; i += 4) {
+        const __m128i cur = _mm_loadu_si128((const __m128i *) &samples[2 * i]);
+        __m128i x = _mm_loadu_si128((const __m128i *) &samples[2 * (i - 1)]);
+
+        if (pattern == BLADERF_PATTERN_COUNTER) {
+            x = _mm_add_epi32(x, one);
+        } else {
+            x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+            x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+            x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+        }
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(x, cur)) != 0xffff) {
+            break;
+        }
+    }
+#elif PATTERN_NEON
+    const uint32x4_t one = vdupq_n_u32(1);
+
+    for (; i + 4 <= n; i += 4) {
+        const uint32x4_t cur = vreinterpretq_u32_s16(vld1q_s16(&samples[2 * i]));
+        uint32x4_t x = vreinterpretq_u32_s16(vld1q_s16(&samples[2 * (i - 1)]));
+        uint32x2_t eq;
+
+        if (pattern == BLADERF_PATTERN_COUNTER) {
+            x = vaddq_u32(x, one);
+        } else {
+            x = veorq_u32(x, vshlq_n_u32(x, 13));
+            x = veorq_u32(x, vshrq_n_u32(x, 17));
+            x = veorq_u32(x, vshlq_n_u32(x, 5));
+        }
+
+        eq = vmovn_u64(vreinterpretq_u64_u32(vceqq_u32(x, cur)));
+        if (vget_lane_u64(vreinterpret_u64_u32(eq), 0) != UINT64_MAX) {
+            break;
+        }
+    }
+#endif
+
+    /* The remainder, and the vector in which a break was found */
+    for (; i < n; i++) {
+        if (word_at(samples, i) != next_word(pattern, word_at(samples, i - 1))) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+/* Number of samples dropped between `last` and `w`, or 0 if `w` does not lie
+ * within max_gap samples of where the pattern should be */
+static uint32_t find_gap(const struct bladerf_pattern_check *c,
+                         uint32_t last, uint32_t w)
+{
+    uint32_t x, gap;
+
+    if (c->pattern == BLADERF_PATTERN_COUNTER) {
+        gap = w - last - 1;
+        return gap <= c->max_gap ? gap : 0;
+    }
+
+    /* The sequence has no shortcut, so step through it */
+    x = next_word(c->pattern, last);
+    for (gap = 1; gap <= c->max_gap; gap++) {
+        x = next_word(c->pattern, x);
+        if (x == w) {
+            return gap;
+        }
+    }
+
+    return 0;
+}
+
+/* Classify a sample that may not follow the last. Returns 1 if it is faulty. */
+static unsigned int check_word(struct bladerf_pattern_check *c, uint32_t w)
+{
+    const uint32_t expected = next_word(c->pattern, c->last);
+    const bool resync = c->resync;
+    uint32_t gap;
+
+    c->resync = false;
+
+    if (w == expected) {
+        c->last = w;
+        return 0;
+    }
+
+    if (resync && w == next_word(c->pattern, c->resync_last)) {
+        /* The samples carry on from the erroneous one. If it lay further
+         * along the pattern, it followed a gap rather than being an error.
+         * This is only searched for once confirmed here, since stepping
+         * through the PRBS for every erroneous sample would be costly. */
+        if (c->pattern == BLADERF_PATTERN_PRBS) {
+            gap = find_gap(c, c->resync_from, c->resync_last);
+            if (gap != 0) {
+                c->errors--;
+                c->gaps++;
+                c->dropped += gap;
+            }
+        }
+
+        c->last = w;
+        return 0;
+    }
+
+    if (w == c->last) {
+        c->duplicates++;
+        return 1;
+    }
+
+    if (c->pattern == BLADERF_PATTERN_COUNTER) {
+        gap = find_gap(c, c->last, w);
+        if (gap != 0) {
+            c->gaps++;
+            c->dropped += gap;
+            c->last = w;
+            return 1;
+        }
+    }
+
+    /* Expect the next sample to carry on from where this one should have
+     * been, or else from this one */
+    c->errors++;
+    c->resync = true;
+    c->resync_from = c->last;
+    c->resync_last = w;
+    c->last = expected;
+    return 1;
+}
+
+int pattern_check_init(struct bladerf_pattern_check *check,
+                       bladerf_pattern pattern)
+{
+    if (pattern != BLADERF_PATTERN_COUNTER && pattern != BLADERF_PATTERN_PRBS) {
+        log_debug("Invalid test pattern: %d\n", pattern);
+        return BLADERF_ERR_INVAL;
+    }
+
+    memset(check, 0, sizeof(*check));
+    check->pattern = pattern;
+    check->max_gap = BLADERF_PATTERN_MAX_GAP_DEFAULT;
+    return 0;
+}
+
+uint64_t pattern_check(struct bladerf_pattern_check *c,
+                       const int16_t *samples, unsigned int n)
+{
+    uint64_t faults = 0;
+    unsigned int i = 0;
+
+    if (n == 0) {
+        return 0;
+    }
+
+    if (!c->synced) {
+        c->last = word_at(samples, 0);
+        c->synced = true;
+        i = 1;
+    }
+
+    while (i < n) {
+        /* Once the pattern is followed into the buffer, its samples need only
+         * be compared with each other */
+        if (i > 0 && !c->resync && c->last == word_at(samples, i - 1)) {
+            i = find_break(c->pattern, samples, i, n);
+            c->last = word_at(samples, i - 1);
+            if (i == n) {
+                break;
+            }
+        }
+
+        faults += check_word(c, word_at(samples, i));
+        i++;
+    }
+
+    c->samples += n;
+    return faults;
+}
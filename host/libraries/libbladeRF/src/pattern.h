@@ -0,0 +1,46 @@
+/**
+ * @file pattern.h
+ *
+ * @brief Verification of the FPGA's RX test patterns
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BLADERF_PATTERN_H_
+#define BLADERF_PATTERN_H_
+
+#include "libbladeRF.h"
+
+/**
+ * Initialize a pattern check
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL for an invalid pattern
+ */
+int pattern_check_init(struct bladerf_pattern_check *check,
+                       bladerf_pattern pattern);
+
+/**
+ * Check `n` SC16 Q11 samples against the check's pattern
+ *
+ * @return Number of faulty samples found
+ */
+uint64_t pattern_check(struct bladerf_pattern_check *check,
+                       const int16_t *samples, unsigned int n);
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * @file probes.h
+ *
+ * @brief Static tracepoints (USDT probes)
+ *
+ * When libbladeRF is built with ENABLE_LIBBLADERF_USDT, these expand to
+ * SystemTap SDT probes in the "libbladeRF" provider, which tools such as
+ * bpftrace and perf can attach to at run time. A probe that nothing is
+ * attached to costs a single no-op instruction. Otherwise, they expand to
+ * nothing.
+ *
+ * Probes and their arguments:
+ *
+ *  xfer_submit         module, transfer index, length (bytes)
+ *  xfer_complete       module, transfer index, libusb status,
+ *                      actual length (bytes)
+ *  sync_rx_entry       number of samples, timeout (ms)
+ *  sync_rx_return      status, number of samples returned
+ *  sync_tx_entry       number of samples, timeout (ms)
+ *  sync_tx_return      status, number of samples written
+ *  sync_buf_complete   module, buffer index, ring fill level
+ *  sync_buf_resubmit   module, buffer index
+ *  sync_worker_state   module, new state (sync_worker_state)
+ *  periph_start        peripheral, direction, number of accesses
+ *  periph_end          peripheral, status
+ *
+ * For example, to histogram peripheral access latency:
+ *
+ *  bpftrace -e '
+ *    usdt:/usr/lib/libbladeRF.so:libbladeRF:periph_start { @t[tid] = nsecs; }
+ *    usdt:/usr/lib/libbladeRF.so:libbladeRF:periph_end /@t[tid]/ {
+ *        @us = hist((nsecs - @t[tid]) / 1000); delete(@t[tid]); }'
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BLADERF_PROBES_H_
+#define BLADERF_PROBES_H_
+
+#ifdef ENABLE_LIBBLADERF_USDT
+#   include <sys/sdt.h>
+
+#   define PROBE2(name, a, b) \
+        DTRACE_PROBE2(libbladeRF, name, a, b)
+
+#   define PROBE3(name, a, b, c) \
+        DTRACE_PROBE3(libbladeRF, name, a, b, c)
+
+#   define PROBE4(name, a, b, c, d) \
+        DTRACE_PROBE4(libbladeRF, name, a, b, c, d)
+#else
+#   define PROBE2(name, a, b)           do {} while (0)
+#   define PROBE3(name, a, b, c)        do {} while (0)
+#   define PROBE4(name, a, b, c, d)     do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,456 @@
+/*
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <libbladeRF.h>
+
+#include "bladerf_priv.h"
+#include "profile.h"
+#include "lms.h"
+#include "si5338.h"
+#include "tuning.h"
+#include "version_compat.h"
+#include "log.h"
+
+/* Largest number of gain stage registers of either module */
+#define PROFILE_GAIN_REGS_MAX LMS_RX_GAIN_NUM_REGS
+
+/* LPF control registers, base + 0 and base + 1 */
+#define PROFILE_LPF_REGS 2
+
+struct profile {
+    char name[BLADERF_PROFILE_NAME_LEN];
+
+    /* PLL, VCOCAP, DC offset corrections, and XB-200 path and filter */
+    struct bladerf_quick_tune tune;
+
+    /* Sample clock multisynth */
+    struct si5338_ms_regs rate_regs;
+
+    /* LPF bandwidth, enable, and bypass */
+    uint8_t lpf[PROFILE_LPF_REGS];
+
+    /* Gain of each stage, in dB (or as a bladerf_lna_gain, for the LNA), and
+     * the register writes that apply them, in the same order */
+    int stages[PROFILE_GAIN_REGS_MAX];
+    struct backend_reg_access gain_regs[PROFILE_GAIN_REGS_MAX];
+    size_t num_stages;
+};
+
+static inline uint8_t lpf_reg(bladerf_module module)
+{
+    return (module == BLADERF_MODULE_RX) ? 0x54 : 0x34;
+}
+
+static struct profile *find(struct profile_table *table, const char *name)
+{
+    size_t i;
+
+    for (i = 0; i < table->count; i++) {
+        if (strcmp(table->entries[i].name, name) == 0) {
+            return &table->entries[i];
+        }
+    }
+
+    return NULL;
+}
+
+/* Get the current gain of each stage, in the order of the registers
+ * produced by lms_get_rx_gain_regs() and lms_get_tx_gain_regs() */
+static int get_stages(struct bladerf *dev, bladerf_module module,
+                      int *stages, size_t *count)
+{
+    int status;
+
+    if (module == BLADERF_MODULE_RX) {
+        bladerf_lna_gain lna;
+
+        status = lms_lna_get_gain(dev, &lna);
+        if (status == 0) {
+            stages[0] = (int) lna;
+            status = lms_rxvga1_get_gain(dev, &stages[1]);
+        }
+
+        if (status == 0) {
+            status = lms_rxvga2_get_gain(dev, &stages[2]);
+        }
+
+        *count = LMS_RX_GAIN_NUM_REGS;
+    } else {
+        status = lms_txvga1_get_gain(dev, &stages[0]);
+        if (status == 0) {
+            status = lms_txvga2_get_gain(dev, &stages[1]);
+        }
+
+        *count = LMS_TX_GAIN_NUM_REGS;
+    }
+
+    return status;
+}
+
+static int capture(struct bladerf *dev, bladerf_module module,
+                   struct profile *p)
+{
+    const uint8_t lpf = lpf_reg(module);
+    int status;
+    size_t i;
+
+    /* The LMS6002D reads below are then served from the register shadow */
+    status = lms_prefetch_config(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    status = tuning_get_quick_tune(dev, module, &p->tune);
+    if (status != 0) {
+        return status;
+    }
+
+    status = si5338_get_rate_regs(dev, module, &p->rate_regs);
+    if (status != 0) {
+        return status;
+    }
+
+    for (i = 0; i < PROFILE_LPF_REGS; i++) {
+        status = lms_read(dev, (uint8_t) (lpf + i), &p->lpf[i]);
+        if (status != 0) {
+            return status;
+        }
+    }
+
+    status = get_stages(dev, module, p->stages, &p->num_stages);
+    if (status != 0) {
+        return status;
+    }
+
+    if (module == BLADERF_MODULE_RX) {
+        return lms_get_rx_gain_regs(dev, (bladerf_lna_gain) p->stages[0],
+                                    p->stages[1], p->stages[2],
+                                    p->gain_regs);
+    } else {
+        return lms_get_tx_gain_regs(dev, p->stages[0], p->stages[1],
+                                    p->gain_regs);
+    }
+}
+
+/* Divide the gain register writes that differ from the current values into
+ * those that reduce a stage's gain, and those that do not */
+static int split_gains(struct bladerf *dev, bladerf_module module,
+                       const struct profile *p,
+                       struct backend_reg_access *lower, size_t *num_lower,
+                       struct backend_reg_access *other, size_t *num_other)
+{
+    int current[PROFILE_GAIN_REGS_MAX];
+    size_t i, count;
+    uint8_t data;
+    int status;
+
+    *num_lower = *num_other = 0;
+
+    status = get_stages(dev, module, current, &count);
+    if (status != 0) {
+        return status;
+    }
+
+    for (i = 0; i < p->num_stages; i++) {
+        status = lms_read(dev, p->gain_regs[i].addr, &data);
+        if (status != 0) {
+            return status;
+        } else if (data == p->gain_regs[i].data) {
+            continue;
+        }
+
+        if (p->stages[i] < current[i]) {
+            lower[(*num_lower)++] = p->gain_regs[i];
+        } else {
+            other[(*num_other)++] = p->gain_regs[i];
+        }
+    }
+
+    return 0;
+}
+
+/* Queue the LPF register writes that differ from the current values */
+static int lpf_writes(struct bladerf *dev, bladerf_module module,
+                      const struct profile *p,
+                      struct backend_reg_access *regs, size_t *count)
+{
+    const uint8_t lpf = lpf_reg(module);
+    uint8_t data;
+    int status;
+    size_t i;
+
+    for (i = 0; i < PROFILE_LPF_REGS; i++) {
+        status = lms_read(dev, (uint8_t) (lpf + i), &data);
+        if (status != 0) {
+            return status;
+        }
+
+        if (data != p->lpf[i]) {
+            regs[*count].addr = (uint8_t) (lpf + i);
+            regs[*count].data = p->lpf[i];
+            regs[*count].write = true;
+            (*count)++;
+        }
+    }
+
+    return 0;
+}
+
+/* The switch is ordered to avoid passing through states with more gain, or
+ * at other frequencies, than either profile: gain reductions go first, and
+ * gain increases are made once the PLL, band, and filters are in place. */
+static int apply_now(struct bladerf *dev, bladerf_module module,
+                     const struct profile *p)
+{
+    struct backend_reg_access lower[PROFILE_GAIN_REGS_MAX];
+    struct backend_reg_access other[PROFILE_GAIN_REGS_MAX];
+    struct backend_reg_access regs[PROFILE_LPF_REGS + PROFILE_GAIN_REGS_MAX];
+    size_t num_lower, num_gains, num_regs;
+    int status;
+
+    status = lms_prefetch_config(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    status = split_gains(dev, module, p, lower, &num_lower,
+                         other, &num_gains);
+    if (status != 0) {
+        return status;
+    }
+
+    /* Filter changes precede gain increases */
+    num_regs = 0;
+    status = lpf_writes(dev, module, p, regs, &num_regs);
+    if (status != 0) {
+        return status;
+    }
+
+    memcpy(&regs[num_regs], other, num_gains * sizeof(regs[0]));
+    num_regs += num_gains;
+
+    if (num_lower != 0) {
+        status = lms_access_batch(dev, lower, num_lower);
+        if (status != 0) {
+            return status;
+        }
+    }
+
+    status = si5338_set_rate_regs(dev, module, &p->rate_regs);
+    if (status != 0) {
+        return status;
+    }
+
+    /* The remaining LMS6002D writes are deferred, and sent in one batch.
+     * Those of the XB-200 and band selection GPIOs are not, and therefore
+     * precede them. */
+    lms_defer_begin(dev);
+
+    status = tuning_quick_retune(dev, module, &p->tune);
+    if (status == 0 && num_regs != 0) {
+        status = lms_access_batch(dev, regs, num_regs);
+    }
+
+    return lms_defer_end(dev, status);
+}
+
+/* Queue LMS6002D writes in the FPGA, BACKEND_SCHEDULED_WRITES_MAX per entry */
+static int schedule_writes(struct bladerf *dev, bladerf_module module,
+                           uint64_t timestamp,
+                           const struct backend_reg_access *regs, size_t count)
+{
+    int status = 0;
+    size_t i, n;
+
+    /* The FPGA will write these registers behind our back */
+    for (i = 0; i < count; i++) {
+        lms_shadow_mark_volatile(dev, regs[i].addr);
+    }
+
+    for (i = 0; i < count && status == 0; i += n) {
+        n = count - i;
+        if (n > BACKEND_SCHEDULED_WRITES_MAX) {
+            n = BACKEND_SCHEDULED_WRITES_MAX;
+        }
+
+        status = dev->fn->schedule_lms_writes(dev, module, timestamp,
+                                              &regs[i], n);
+    }
+
+    return status;
+}
+
+static int apply_scheduled(struct bladerf *dev, bladerf_module module,
+                           const struct profile *p, uint64_t timestamp)
+{
+    struct backend_reg_access lower[PROFILE_GAIN_REGS_MAX];
+    struct backend_reg_access other[PROFILE_GAIN_REGS_MAX];
+    struct backend_reg_access regs[PROFILE_LPF_REGS + PROFILE_GAIN_REGS_MAX];
+    size_t num_lower, num_gains, num_lpf;
+    unsigned int frequency;
+    int status;
+
+    if (dev->fn->schedule_retune == NULL ||
+        dev->fn->schedule_lms_writes == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 4)) {
+        log_warning("Scheduled profile changes require FPGA v0.1.4 or "
+                    "later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    if (!si5338_rate_regs_match(dev, module, &p->rate_regs)) {
+        log_debug("%s: Profile \"%s\" changes the sample rate, which cannot "
+                  "be scheduled.\n", __FUNCTION__, p->name);
+        return BLADERF_ERR_INVAL;
+    }
+
+    status = tuning_get_freq(dev, module, &frequency);
+    if (status != 0) {
+        return status;
+    }
+
+    if ((frequency >= BLADERF_BAND_HIGH) !=
+        (p->tune.frequency >= BLADERF_BAND_HIGH)) {
+        log_debug("%s: Profile \"%s\" changes the band, which cannot be "
+                  "scheduled.\n", __FUNCTION__, p->name);
+        return BLADERF_ERR_INVAL;
+    }
+
+    /* The FPGA's scheduled writes must follow any deferred writes */
+    status = lms_defer_flush(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    status = lms_prefetch_config(dev);
+    if (status != 0) {
+        return status;
+    }
+
+    status = split_gains(dev, module, p, lower, &num_lower,
+                         other, &num_gains);
+    if (status != 0) {
+        return status;
+    }
+
+    num_lpf = 0;
+    status = lpf_writes(dev, module, p, regs, &num_lpf);
+    if (status != 0) {
+        return status;
+    }
+
+    memcpy(&regs[num_lpf], other, num_gains * sizeof(regs[0]));
+
+    /* These queue entries are all applied at the same timestamp, in order */
+    status = schedule_writes(dev, module, timestamp, lower, num_lower);
+    if (status != 0) {
+        return status;
+    }
+
+    status = tuning_schedule_retune(dev, module, timestamp, &p->tune);
+    if (status != 0) {
+        return status;
+    }
+
+    return schedule_writes(dev, module, timestamp, regs, num_lpf + num_gains);
+}
+
+int profile_capture(struct bladerf *dev, bladerf_module module,
+                    const char *name)
+{
+    struct profile_table *table = &dev->profiles[module];
+    struct profile p, *entry;
+    int status;
+
+    memset(&p, 0, sizeof(p));
+    strncpy(p.name, name, sizeof(p.name) - 1);
+
+    status = capture(dev, module, &p);
+    if (status != 0) {
+        return status;
+    }
+
+    entry = find(table, name);
+    if (entry == NULL) {
+        struct profile *entries;
+
+        entries = realloc(table->entries,
+                          (table->count + 1) * sizeof(entries[0]));
+        if (entries == NULL) {
+            return BLADERF_ERR_MEM;
+        }
+
+        table->entries = entries;
+        entry = &table->entries[table->count++];
+    }
+
+    *entry = p;
+
+    log_verbose("%s: Captured %s profile \"%s\" at %u Hz\n", __FUNCTION__,
+                module == BLADERF_MODULE_RX ? "RX" : "TX", name,
+                p.tune.frequency);
+
+    return 0;
+}
+
+int profile_apply(struct bladerf *dev, bladerf_module module,
+                  const char *name, uint64_t timestamp)
+{
+    const struct profile *p = find(&dev->profiles[module], name);
+
+    if (p == NULL) {
+        log_debug("%s: No profile named \"%s\"\n", __FUNCTION__, name);
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (timestamp == BLADERF_PROFILE_NOW) {
+        return apply_now(dev, module, p);
+    } else {
+        return apply_scheduled(dev, module, p, timestamp);
+    }
+}
+
+int profile_remove(struct bladerf *dev, bladerf_module module,
+                   const char *name)
+{
+    struct profile_table *table = &dev->profiles[module];
+    struct profile *p = find(table, name);
+    size_t i;
+
+    if (p == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    i = (size_t) (p - table->entries);
+    memmove(p, p + 1, (table->count - i - 1) * sizeof(*p));
+    table->count--;
+
+    return 0;
+}
+
+void profile_free(struct profile_table *table)
+{
+    free(table->entries);
+    table->entries = NULL;
+    table->count = 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef BLADERF_PROFILE_H_
+#define BLADERF_PROFILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <libbladeRF.h>
+
+struct bladerf;
+struct profile;
+
+/* Operating profiles defined for a module */
+struct profile_table {
+    struct profile *entries;
+    size_t count;
+};
+
+/*
+ * The following must be called with CTRL_LOCK_LMS, CTRL_LOCK_SI5338, and
+ * CTRL_LOCK_GPIO held.
+ */
+
+/**
+ * Capture the current configuration of a module as the named profile,
+ * replacing any existing profile of the same name
+ *
+ * @param   dev         Device handle
+ * @param   module      Module to capture
+ * @param   name        Profile name
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int profile_capture(struct bladerf *dev, bladerf_module module,
+                    const char *name);
+
+/**
+ * Apply a profile
+ *
+ * @param   dev         Device handle
+ * @param   module      Module to configure
+ * @param   name        Profile name
+ * @param   timestamp   Timestamp at which to apply the profile, or
+ *                      BLADERF_PROFILE_NOW
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int profile_apply(struct bladerf *dev, bladerf_module module,
+                  const char *name, uint64_t timestamp);
+
+/**
+ * Remove a profile
+ *
+ * @param   dev         Device handle
+ * @param   module      Module the profile belongs to
+ * @param   name        Profile name
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if no such profile exists
+ */
+int profile_remove(struct bladerf *dev, bladerf_module module,
+                   const char *name);
+
+/**
+ * Free all of a module's profiles
+ *
+ * @param   table       Profiles to free
+ */
+void profile_free(struct profile_table *table);
+
+#endif
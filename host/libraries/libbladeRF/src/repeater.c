@@ -0,0 +1,629 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2014 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ *
+ * The RX stream owns the buffer pool. The TX stream is initialized with the
+ * same buffers, followed by `num_transfers` buffers of zeros that it sends
+ * when no received buffer is ready.
+ *
+ * Buffers circulate through two single-producer, single-consumer FIFOs:
+ *
+ *   RX callback --(ready)--> TX callback --(free)--> RX callback
+ *
+ * Only one callback per module runs at a time, so each FIFO index is only
+ * ever written by one callback, and no locking is required between them.
+ * Each FIFO has room for every buffer in the pool, so a push never fails.
+ *
+ * When the RX callback finds no free buffer, TX is holding every other
+ * buffer, and the just-received buffer is resubmitted for reception.
+ *
+ * Processing stages run in the RX callback, before a buffer is pushed to
+ * the ready FIFO. In delayed mode, each is called once per message, skipping
+ * the metadata headers.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#include "log.h"
+#include "rel_assert.h"
+#include "bladerf_priv.h"
+#include "async.h"
+#include "metadata.h"
+#include "repeater.h"
+
+struct repeater_fifo
+{
+    void **bufs;
+    uint64_t *times_us;             /* Time each buffer was pushed */
+    unsigned int slots;             /* One more than the capacity */
+
+    volatile unsigned int head;     /* Next to pop. Written by the consumer */
+    volatile unsigned int tail;     /* Next to push. Written by the producer */
+};
+
+struct bladerf_repeater
+{
+    struct bladerf *dev;
+    uint64_t delay;                 /* 0 implies no timestamps */
+    size_t buf_bytes;
+    unsigned int buf_samples;
+    unsigned int msg_per_buf;
+    unsigned int samples_per_msg;
+
+    struct bladerf_stream *rx_stream;
+    struct bladerf_stream *tx_stream;
+    void **buffers;                 /* Owned by rx_stream */
+    void **tx_buffers;              /* buffers, followed by the silence */
+
+    uint8_t *silence;               /* num_silence buffers of zeros */
+    unsigned int num_silence;
+    unsigned int silence_idx;       /* Next to send. Only used by TX */
+
+    struct bladerf_repeater_stage stages[BLADERF_REPEATER_MAX_STAGES];
+    unsigned int num_stages;
+    uint64_t budget_us;             /* Duration of one buffer */
+
+    struct repeater_fifo ready;     /* RX -> TX */
+    struct repeater_fifo free;      /* TX -> RX */
+
+    pthread_t rx_thread;
+    pthread_t tx_thread;
+    bool configured;                /* Module formats may have been set */
+    bool rx_running;
+    bool tx_running;
+    int rx_status;
+    int tx_status;
+
+    volatile bool stop;
+
+    /* Timestamp following the most recently received buffer. Written by RX */
+    volatile uint64_t rx_timestamp;
+
+    /* A buffer has been relayed, so a lack of buffers is an underrun.
+     * Only used by TX */
+    bool relaying;
+
+    /* `dropped` and the stage statistics are written by RX, and the
+     * remainder by TX. These are read
+     * by repeater_get_stats() via ATOMIC_LOAD_ACQUIRE(). */
+    struct bladerf_repeater_stats stats;
+};
+
+static int fifo_init(struct repeater_fifo *f, unsigned int capacity)
+{
+    f->slots = capacity + 1;
+    f->head = 0;
+    f->tail = 0;
+
+    f->bufs = calloc(f->slots, sizeof(f->bufs[0]));
+    f->times_us = calloc(f->slots, sizeof(f->times_us[0]));
+
+    if (f->bufs == NULL || f->times_us == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    return 0;
+}
+
+static void fifo_deinit(struct repeater_fifo *f)
+{
+    free(f->bufs);
+    free(f->times_us);
+}
+
+static inline void fifo_push(struct repeater_fifo *f, void *buf,
+                             uint64_t time_us)
+{
+    const unsigned int tail = f->tail;
+    const unsigned int next = (tail + 1) % f->slots;
+
+    assert(next != ATOMIC_LOAD_ACQUIRE(&f->head));
+
+    f->bufs[tail] = buf;
+    f->times_us[tail] = time_us;
+    ATOMIC_STORE_RELEASE(&f->tail, next);
+}
+
+/* Returns NULL if the FIFO is empty */
+static inline void *fifo_pop(struct repeater_fifo *f, uint64_t *time_us)
+{
+    const unsigned int head = f->head;
+    void *buf;
+
+    if (head == ATOMIC_LOAD_ACQUIRE(&f->tail)) {
+        return NULL;
+    }
+
+    buf = f->bufs[head];
+    *time_us = f->times_us[head];
+    ATOMIC_STORE_RELEASE(&f->head, (head + 1) % f->slots);
+
+    return buf;
+}
+
+static inline bool is_silence(const struct bladerf_repeater *r,
+                              const void *buf)
+{
+    const uint8_t *p = (const uint8_t *) buf;
+    return p >= r->silence && p < r->silence + r->num_silence * r->buf_bytes;
+}
+
+/* Rewrite each message header of a received buffer for transmission
+ * `delay` samples after it was received */
+static inline void delay_buffer(struct bladerf_repeater *r, uint8_t *buf)
+{
+    const size_t msg_size = r->dev->msg_size;
+    uint64_t timestamp = 0;
+    unsigned int i;
+
+    for (i = 0; i < r->msg_per_buf; i++) {
+        uint8_t *header = buf + i * msg_size;
+
+        timestamp = metadata_get_timestamp(header);
+        metadata_set(header, timestamp + r->delay, 0);
+    }
+
+    ATOMIC_STORE_RELEASE(&r->rx_timestamp, timestamp + r->samples_per_msg);
+}
+
+/* Run each processing stage over a received buffer */
+static inline void process_buffer(struct bladerf_repeater *r, uint8_t *buf)
+{
+    struct bladerf_repeater_stats *stats = &r->stats;
+    const size_t msg_size = r->dev->msg_size;
+    uint64_t start_us, end_us, elapsed_us, total_us = 0;
+    unsigned int i, j;
+
+    for (i = 0; i < r->num_stages; i++) {
+        const struct bladerf_repeater_stage *stage = &r->stages[i];
+
+        start_us = async_stats_time_us();
+
+        if (r->delay == 0) {
+            stage->process((int16_t *) buf, r->buf_samples, stage->user_data);
+        } else {
+            for (j = 0; j < r->msg_per_buf; j++) {
+                int16_t *samples = (int16_t *)
+                    (buf + j * msg_size + METADATA_HEADER_SIZE);
+
+                stage->process(samples, r->samples_per_msg, stage->user_data);
+            }
+        }
+
+        end_us = async_stats_time_us();
+        elapsed_us = (end_us > start_us) ? (end_us - start_us) : 0;
+        total_us += elapsed_us;
+
+        ATOMIC_STORE_RELEASE(&stats->stage_total_us[i],
+                             stats->stage_total_us[i] + elapsed_us);
+
+        if (elapsed_us > stats->stage_max_us[i]) {
+            ATOMIC_STORE_RELEASE(&stats->stage_max_us[i], elapsed_us);
+        }
+    }
+
+    if (total_us > r->budget_us) {
+        log_verbose("%s: Stages took %"PRIu64" us of a %"PRIu64" us budget\n",
+                    __FUNCTION__, total_us, r->budget_us);
+        ATOMIC_STORE_RELEASE(&stats->budget_exceeded,
+                             stats->budget_exceeded + 1);
+    }
+}
+
+static void *rx_callback(struct bladerf *dev,
+                         struct bladerf_stream *stream,
+                         struct bladerf_metadata *meta,
+                         void *samples,
+                         size_t num_samples,
+                         void *user_data)
+{
+    struct bladerf_repeater *r = (struct bladerf_repeater *) user_data;
+    uint64_t unused;
+    void *next;
+
+    if (ATOMIC_LOAD_ACQUIRE(&r->stop)) {
+        return BLADERF_STREAM_SHUTDOWN;
+    }
+
+    next = fifo_pop(&r->free, &unused);
+    if (next == NULL) {
+        log_verbose("%s: No free buffers. Dropping samples.\n", __FUNCTION__);
+        ATOMIC_STORE_RELEASE(&r->stats.dropped, r->stats.dropped + 1);
+        return samples;
+    }
+
+    if (r->num_stages != 0) {
+        process_buffer(r, (uint8_t *) samples);
+    }
+
+    if (r->delay != 0) {
+        delay_buffer(r, (uint8_t *) samples);
+    }
+
+    fifo_push(&r->ready, samples, async_stats_time_us());
+    return next;
+}
+
+static void *tx_callback(struct bladerf *dev,
+                         struct bladerf_stream *stream,
+                         struct bladerf_metadata *meta,
+                         void *samples,
+                         size_t num_samples,
+                         void *user_data)
+{
+    struct bladerf_repeater *r = (struct bladerf_repeater *) user_data;
+    struct bladerf_repeater_stats *stats = &r->stats;
+    uint64_t rx_us, now_us, elapsed_us;
+    void *next;
+
+    if (ATOMIC_LOAD_ACQUIRE(&r->stop)) {
+        return BLADERF_STREAM_SHUTDOWN;
+    }
+
+    /* The first callbacks we get have samples=NULL */
+    if (samples != NULL && !is_silence(r, samples)) {
+        fifo_push(&r->free, samples, 0);
+    }
+
+    next = fifo_pop(&r->ready, &rx_us);
+    if (next == NULL) {
+        if (r->relaying) {
+            ATOMIC_STORE_RELEASE(&stats->underruns, stats->underruns + 1);
+        }
+
+        /* At most num_transfers buffers are in flight, so the silence buffer
+         * being reused here has already been sent */
+        next = r->silence + r->silence_idx * r->buf_bytes;
+        r->silence_idx = (r->silence_idx + 1) % r->num_silence;
+        return next;
+    }
+
+    r->relaying = true;
+
+    now_us = async_stats_time_us();
+    elapsed_us = (now_us > rx_us) ? (now_us - rx_us) : 0;
+
+    async_stats_hist_add(stats->latency_hist, rx_us, now_us);
+
+    ATOMIC_STORE_RELEASE(&stats->latency_total_us,
+                         stats->latency_total_us + elapsed_us);
+
+    if (elapsed_us > stats->latency_max_us) {
+        ATOMIC_STORE_RELEASE(&stats->latency_max_us, elapsed_us);
+    }
+
+    if (r->delay != 0) {
+        const int64_t margin = (int64_t)
+            (metadata_get_timestamp((const uint8_t *) next) -
+             ATOMIC_LOAD_ACQUIRE(&r->rx_timestamp));
+
+        if (margin < 0) {
+            ATOMIC_STORE_RELEASE(&stats->late, stats->late + 1);
+        }
+
+        if (margin < stats->min_margin) {
+            ATOMIC_STORE_RELEASE(&stats->min_margin, margin);
+        }
+    }
+
+    ATOMIC_STORE_RELEASE(&stats->buffers, stats->buffers + 1);
+    return next;
+}
+
+static void *rx_thread(void *arg)
+{
+    struct bladerf_repeater *r = (struct bladerf_repeater *) arg;
+
+    r->rx_status = async_run_stream(r->rx_stream, BLADERF_MODULE_RX);
+    if (r->rx_status != 0) {
+        log_debug("%s: RX stream failed: %s\n",
+                  __FUNCTION__, bladerf_strerror(r->rx_status));
+    }
+
+    return NULL;
+}
+
+static void *tx_thread(void *arg)
+{
+    struct bladerf_repeater *r = (struct bladerf_repeater *) arg;
+
+    r->tx_status = async_run_stream(r->tx_stream, BLADERF_MODULE_TX);
+    if (r->tx_status != 0) {
+        log_debug("%s: TX stream failed: %s\n",
+                  __FUNCTION__, bladerf_strerror(r->tx_status));
+    }
+
+    return NULL;
+}
+
+static int init_buffers(struct bladerf_repeater *r,
+                        const struct bladerf_repeater_config *c,
+                        bladerf_format format)
+{
+    unsigned int i, j;
+    int status;
+
+    status = bladerf_init_stream(&r->rx_stream, r->dev, rx_callback,
+                                 &r->buffers, c->num_buffers, format,
+                                 c->buffer_size, c->num_transfers, r);
+    if (status != 0) {
+        return status;
+    }
+
+    r->num_silence = c->num_transfers;
+    r->silence = calloc(r->num_silence, r->buf_bytes);
+    r->tx_buffers = calloc(c->num_buffers + r->num_silence,
+                           sizeof(r->tx_buffers[0]));
+
+    if (r->silence == NULL || r->tx_buffers == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    /* Zeros are sent as soon as possible, as they carry no timing */
+    if (r->delay != 0) {
+        for (i = 0; i < r->num_silence; i++) {
+            for (j = 0; j < r->msg_per_buf; j++) {
+                metadata_set(r->silence + i * r->buf_bytes +
+                             j * r->dev->msg_size, 0, 0);
+            }
+        }
+    }
+
+    memcpy(r->tx_buffers, r->buffers,
+           c->num_buffers * sizeof(r->tx_buffers[0]));
+
+    for (i = 0; i < r->num_silence; i++) {
+        r->tx_buffers[c->num_buffers + i] = r->silence + i * r->buf_bytes;
+    }
+
+    status = bladerf_init_stream_with_buffers(&r->tx_stream, r->dev,
+                                              tx_callback, r->tx_buffers,
+                                              c->num_buffers + r->num_silence,
+                                              format, c->buffer_size,
+                                              c->num_transfers, r);
+    if (status != 0) {
+        return status;
+    }
+
+    status = fifo_init(&r->ready, c->num_buffers);
+    if (status == 0) {
+        status = fifo_init(&r->free, c->num_buffers);
+    }
+
+    if (status != 0) {
+        return status;
+    }
+
+    /* The RX stream starts out by submitting the first num_transfers
+     * buffers */
+    for (i = c->num_transfers; i < c->num_buffers; i++) {
+        fifo_push(&r->free, r->buffers[i], 0);
+    }
+
+    return 0;
+}
+
+/* Stop any running streams, and free everything allocated for `r` */
+static int cleanup(struct bladerf_repeater *r)
+{
+    int status = 0;
+
+    ATOMIC_STORE_RELEASE(&r->stop, true);
+
+    if (r->rx_running) {
+        pthread_join(r->rx_thread, NULL);
+        status = r->rx_status;
+    }
+
+    if (r->tx_running) {
+        pthread_join(r->tx_thread, NULL);
+        if (status == 0) {
+            status = r->tx_status;
+        }
+    }
+
+    /* This also deconfigures the modules' formats */
+    if (r->configured) {
+        bladerf_enable_module(r->dev, BLADERF_MODULE_RX, false);
+        bladerf_enable_module(r->dev, BLADERF_MODULE_TX, false);
+    }
+
+    /* The TX stream uses the RX stream's buffers */
+    if (r->tx_stream != NULL) {
+        bladerf_deinit_stream(r->tx_stream);
+    }
+
+    if (r->rx_stream != NULL) {
+        bladerf_deinit_stream(r->rx_stream);
+    }
+
+    fifo_deinit(&r->ready);
+    fifo_deinit(&r->free);
+    free(r->tx_buffers);
+    free(r->silence);
+    free(r);
+
+    return status;
+}
+
+int repeater_start(struct bladerf *dev,
+                   const struct bladerf_repeater_config *config,
+                   struct bladerf_repeater **repeater)
+{
+    struct bladerf_repeater *r;
+    bladerf_format format;
+    unsigned int i;
+    int status;
+
+    *repeater = NULL;
+
+    if (config->buffer_size == 0 || config->buffer_size % 1024 != 0) {
+        log_debug("%s: Buffer size must be a multiple of 1024\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (config->num_transfers == 0 ||
+        config->num_buffers <= 2 * config->num_transfers) {
+        log_debug("%s: # buffers must exceed twice the # transfers\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (config->num_stages > BLADERF_REPEATER_MAX_STAGES ||
+        (config->num_stages != 0 && config->stages == NULL)) {
+        log_debug("%s: At most %u stages are supported\n",
+                  __FUNCTION__, BLADERF_REPEATER_MAX_STAGES);
+        return BLADERF_ERR_INVAL;
+    }
+
+    for (i = 0; i < config->num_stages; i++) {
+        if (config->stages[i].process == NULL) {
+            log_debug("%s: Stage %u has no process function\n",
+                      __FUNCTION__, i);
+            return BLADERF_ERR_INVAL;
+        }
+    }
+
+    format = (config->delay != 0) ? BLADERF_FORMAT_SC16_Q11_META :
+                                    BLADERF_FORMAT_SC16_Q11;
+
+    r = calloc(1, sizeof(*r));
+    if (r == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    r->dev = dev;
+    r->delay = config->delay;
+    r->buf_bytes = samples_to_bytes(format, config->buffer_size);
+    r->buf_samples = config->buffer_size;
+    r->msg_per_buf = (unsigned int) (r->buf_bytes / dev->msg_size);
+    r->samples_per_msg = (unsigned int)
+        bytes_to_sc16q11(dev->msg_size - METADATA_HEADER_SIZE);
+    r->stats.min_margin = INT64_MAX;
+
+    if (config->num_stages != 0) {
+        unsigned int rate;
+
+        memcpy(r->stages, config->stages,
+               config->num_stages * sizeof(r->stages[0]));
+        r->num_stages = config->num_stages;
+
+        status = bladerf_get_sample_rate(dev, BLADERF_MODULE_RX, &rate);
+        if (status != 0) {
+            goto error;
+        }
+
+        r->budget_us = (rate != 0) ?
+            (uint64_t) config->buffer_size * 1000000 / rate : UINT64_MAX;
+    }
+
+    status = init_buffers(r, config, format);
+    if (status != 0) {
+        goto error;
+    }
+
+    r->configured = true;
+
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
+    status = perform_format_config(dev, BLADERF_MODULE_RX, format);
+    if (status == 0) {
+        status = perform_format_config(dev, BLADERF_MODULE_TX, format);
+    }
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
+
+    if (status != 0) {
+        goto error;
+    }
+
+    status = bladerf_enable_module(dev, BLADERF_MODULE_RX, true);
+    if (status == 0) {
+        status = bladerf_enable_module(dev, BLADERF_MODULE_TX, true);
+    }
+
+    if (status != 0) {
+        goto error;
+    }
+
+    /* Start TX first, so that it is sending zeros by the time received
+     * buffers become ready */
+    if (pthread_create(&r->tx_thread, NULL, tx_thread, r) != 0) {
+        status = BLADERF_ERR_UNEXPECTED;
+        goto error;
+    }
+    r->tx_running = true;
+
+    if (pthread_create(&r->rx_thread, NULL, rx_thread, r) != 0) {
+        status = BLADERF_ERR_UNEXPECTED;
+        goto error;
+    }
+    r->rx_running = true;
+
+    log_debug("%s: Started with %u buffers of %u samples, %u transfers, "
+              "delay=%"PRIu64"\n", __FUNCTION__, config->num_buffers,
+              config->buffer_size, config->num_transfers, config->delay);
+
+    for (i = 0; i < r->num_stages; i++) {
+        log_debug("%s: Stage %u: %s\n", __FUNCTION__, i,
+                  r->stages[i].name ? r->stages[i].name : "(unnamed)");
+    }
+
+    *repeater = r;
+    return 0;
+
+error:
+    cleanup(r);
+    return status;
+}
+
+int repeater_get_stats(struct bladerf_repeater *r,
+                       struct bladerf_repeater_stats *stats)
+{
+    unsigned int i;
+
+    stats->buffers = ATOMIC_LOAD_ACQUIRE(&r->stats.buffers);
+    stats->dropped = ATOMIC_LOAD_ACQUIRE(&r->stats.dropped);
+    stats->underruns = ATOMIC_LOAD_ACQUIRE(&r->stats.underruns);
+    stats->late = ATOMIC_LOAD_ACQUIRE(&r->stats.late);
+    stats->min_margin = ATOMIC_LOAD_ACQUIRE(&r->stats.min_margin);
+    stats->latency_max_us = ATOMIC_LOAD_ACQUIRE(&r->stats.latency_max_us);
+    stats->latency_total_us = ATOMIC_LOAD_ACQUIRE(&r->stats.latency_total_us);
+
+    for (i = 0; i < BLADERF_STREAM_STATS_HIST_LEN; i++) {
+        stats->latency_hist[i] = ATOMIC_LOAD_ACQUIRE(&r->stats.latency_hist[i]);
+    }
+
+    for (i = 0; i < BLADERF_REPEATER_MAX_STAGES; i++) {
+        stats->stage_total_us[i] =
+            ATOMIC_LOAD_ACQUIRE(&r->stats.stage_total_us[i]);
+        stats->stage_max_us[i] = ATOMIC_LOAD_ACQUIRE(&r->stats.stage_max_us[i]);
+    }
+
+    stats->budget_exceeded = ATOMIC_LOAD_ACQUIRE(&r->stats.budget_exceeded);
+
+    return 0;
+}
+
+int repeater_stop(struct bladerf_repeater *r)
+{
+    return cleanup(r);
+}
@@ -0,0 +1,55 @@
+/**
+ * @file repeater.h
+ *
+ * @brief Full-duplex repeater, relaying RX buffers to TX without copying
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2014 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BLADERF_REPEATER_H_
+#define BLADERF_REPEATER_H_
+
+#include "libbladeRF.h"
+
+/**
+ * Start relaying samples. The caller must not hold any of dev->ctrl_lock[].
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int repeater_start(struct bladerf *dev,
+                   const struct bladerf_repeater_config *config,
+                   struct bladerf_repeater **repeater);
+
+/**
+ * Retrieve statistics from a running repeater
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int repeater_get_stats(struct bladerf_repeater *repeater,
+                       struct bladerf_repeater_stats *stats);
+
+/**
+ * Stop relaying samples and free the repeater. The caller must not hold
+ * any of dev->ctrl_lock[].
+ *
+ * @return 0 on success, or the first stream error encountered
+ */
+int repeater_stop(struct bladerf_repeater *repeater);
+
+#endif
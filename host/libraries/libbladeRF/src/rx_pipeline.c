@@ -0,0 +1,542 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ *
+ * The RX stream owns the buffer pool. Each received buffer is assigned the
+ * next sequence number, and its state is kept in slot `seq % num_buffers`
+ * of a reorder window. As no more than `num_buffers` buffers can be between
+ * reception and delivery, slots are never reused while occupied.
+ *
+ *   RX callback --(worker queues)--> workers --(window)--> delivery
+ *       ^                                                      |
+ *       +-----------------------(free)-------------------------+
+ *
+ * The RX callback queues sequence numbers to each worker's queue in turn.
+ * A worker takes the oldest entry of its own queue, or failing that, the
+ * oldest entry of the fullest other queue. Workers that find every queue
+ * empty block on `work_ready`.
+ *
+ * When a worker completes the buffer at the head of the window, it takes on
+ * the role of delivering buffers, and continues to do so while the head of
+ * the window is complete, including buffers completed by other workers in
+ * the meantime. Only one worker delivers at a time, so deliveries are
+ * ordered and never overlap. Delivered buffers are pushed to the free stack,
+ * which the RX callback pops its next buffer from.
+ *
+ * When the RX callback finds no free buffer, the workers and delivery are
+ * holding every other buffer, and the just-received buffer is resubmitted
+ * for reception.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+#include "log.h"
+#include "rel_assert.h"
+#include "bladerf_priv.h"
+#include "async.h"
+#include "rx_pipeline.h"
+
+struct pipeline_slot {
+    void *samples;
+    unsigned int num_samples;
+    struct bladerf_metadata meta;
+    void *result;
+    uint64_t rx_us;                 /* Time the buffer was received */
+    bool done;                      /* Processed, and awaiting delivery */
+};
+
+/* FIFO of sequence numbers. Each has room for every buffer in the pool. */
+struct pipeline_queue {
+    MUTEX lock;
+    uint64_t *seqs;
+    unsigned int head;
+    unsigned int count;
+};
+
+struct pipeline_worker {
+    struct bladerf_rx_pipeline *p;
+    unsigned int idx;
+    pthread_t thread;
+    bool running;
+};
+
+struct bladerf_rx_pipeline {
+    struct bladerf *dev;
+    struct bladerf_stream *stream;
+    void **buffers;                 /* Owned by stream */
+    unsigned int num_buffers;
+
+    bladerf_rx_pipeline_work_fn work;
+    bladerf_rx_pipeline_deliver_fn deliver;
+    void *user_data;
+
+    struct pipeline_queue *queues;  /* One per worker */
+    struct pipeline_worker *workers;
+    unsigned int num_workers;
+
+    pthread_t rx_thread;
+    bool configured;                /* Module format may have been set */
+    bool rx_running;
+    int rx_status;
+
+    volatile bool stop;             /* RX callback is to shut down */
+
+    /* The following are protected by `lock` */
+    MUTEX lock;
+    pthread_cond_t work_ready;
+    unsigned int pending;           /* Queued, but not yet taken */
+    bool rx_done;                   /* No more buffers will be queued */
+    struct pipeline_slot *window;
+    uint64_t next_seq;              /* Assigned to the next received buffer.
+                                     * Only used by the RX callback. */
+    uint64_t next_delivery;         /* Head of the window */
+    bool delivering;                /* A worker is delivering buffers */
+    void **free_bufs;               /* Stack of buffers to receive into */
+    unsigned int num_free;
+    struct bladerf_rx_pipeline_stats stats;
+};
+
+static void queue_push(struct pipeline_queue *q, unsigned int capacity,
+                       uint64_t seq)
+{
+    MUTEX_LOCK(&q->lock);
+    assert(q->count < capacity);
+    q->seqs[(q->head + q->count) % capacity] = seq;
+    q->count++;
+    MUTEX_UNLOCK(&q->lock);
+}
+
+static bool queue_pop(struct pipeline_queue *q, unsigned int capacity,
+                      uint64_t *seq)
+{
+    bool popped = false;
+
+    MUTEX_LOCK(&q->lock);
+    if (q->count != 0) {
+        *seq = q->seqs[q->head];
+        q->head = (q->head + 1) % capacity;
+        q->count--;
+        popped = true;
+    }
+    MUTEX_UNLOCK(&q->lock);
+
+    return popped;
+}
+
+/* Take the next buffer for worker `idx` to process, from its own queue or
+ * from another's. The counts read while choosing a victim are only a hint,
+ * so they are read without locking. */
+static bool take_work(struct bladerf_rx_pipeline *p, unsigned int idx,
+                      uint64_t *seq, bool *stolen)
+{
+    unsigned int i, victim, most;
+
+    if (queue_pop(&p->queues[idx], p->num_buffers, seq)) {
+        *stolen = false;
+        return true;
+    }
+
+    do {
+        victim = idx;
+        most = 0;
+
+        for (i = 0; i < p->num_workers; i++) {
+            const unsigned int count =
+                ATOMIC_LOAD_ACQUIRE(&p->queues[i].count);
+
+            if (i != idx && count > most) {
+                victim = i;
+                most = count;
+            }
+        }
+
+        if (victim != idx &&
+            queue_pop(&p->queues[victim], p->num_buffers, seq)) {
+            *stolen = true;
+            return true;
+        }
+    } while (victim != idx);
+
+    return false;
+}
+
+/* Deliver buffers from the head of the window while they are complete, and
+ * return them to the free stack. The caller must hold p->lock. */
+static void deliver_ready(struct bladerf_rx_pipeline *p)
+{
+    struct pipeline_slot *slot = &p->window[p->next_delivery % p->num_buffers];
+    uint64_t now_us, elapsed_us;
+
+    p->delivering = true;
+
+    while (slot->done) {
+        if (p->deliver != NULL) {
+            MUTEX_UNLOCK(&p->lock);
+            p->deliver(slot->samples, slot->num_samples, &slot->meta,
+                       slot->result, p->user_data);
+            MUTEX_LOCK(&p->lock);
+        }
+
+        now_us = async_stats_time_us();
+        elapsed_us = (now_us > slot->rx_us) ? (now_us - slot->rx_us) : 0;
+
+        p->stats.buffers++;
+        p->stats.latency_total_us += elapsed_us;
+        if (elapsed_us > p->stats.latency_max_us) {
+            p->stats.latency_max_us = elapsed_us;
+        }
+
+        slot->done = false;
+        p->free_bufs[p->num_free++] = slot->samples;
+
+        p->next_delivery++;
+        slot = &p->window[p->next_delivery % p->num_buffers];
+    }
+
+    p->delivering = false;
+}
+
+static void *worker_task(void *arg)
+{
+    struct pipeline_worker *w = (struct pipeline_worker *) arg;
+    struct bladerf_rx_pipeline *p = w->p;
+    struct pipeline_slot *slot;
+    uint64_t seq;
+    bool stolen;
+    void *result;
+
+    while (true) {
+        if (!take_work(p, w->idx, &seq, &stolen)) {
+            MUTEX_LOCK(&p->lock);
+            while (p->pending == 0 && !p->rx_done) {
+                pthread_cond_wait(&p->work_ready, &p->lock);
+            }
+
+            if (p->pending == 0) {
+                /* Everything received has been processed */
+                MUTEX_UNLOCK(&p->lock);
+                break;
+            }
+
+            MUTEX_UNLOCK(&p->lock);
+            continue;
+        }
+
+        MUTEX_LOCK(&p->lock);
+        p->pending--;
+        if (stolen) {
+            p->stats.stolen++;
+        }
+        slot = &p->window[seq % p->num_buffers];
+        MUTEX_UNLOCK(&p->lock);
+
+        /* Nothing else accesses the slot until it is marked done */
+        result = p->work(slot->samples, slot->num_samples, &slot->meta,
+                         w->idx, p->user_data);
+
+        MUTEX_LOCK(&p->lock);
+        slot->result = result;
+        slot->done = true;
+
+        if (!p->delivering && seq == p->next_delivery) {
+            deliver_ready(p);
+        }
+        MUTEX_UNLOCK(&p->lock);
+    }
+
+    return NULL;
+}
+
+static void *rx_callback(struct bladerf *dev,
+                         struct bladerf_stream *stream,
+                         struct bladerf_metadata *meta,
+                         void *samples,
+                         size_t num_samples,
+                         void *user_data)
+{
+    struct bladerf_rx_pipeline *p = (struct bladerf_rx_pipeline *) user_data;
+    struct pipeline_slot *slot;
+    uint64_t seq;
+    void *next;
+
+    if (ATOMIC_LOAD_ACQUIRE(&p->stop)) {
+        return BLADERF_STREAM_SHUTDOWN;
+    }
+
+    MUTEX_LOCK(&p->lock);
+
+    if (p->num_free == 0) {
+        p->stats.dropped++;
+        MUTEX_UNLOCK(&p->lock);
+
+        log_verbose("%s: No free buffers. Dropping samples.\n", __FUNCTION__);
+        return samples;
+    }
+
+    next = p->free_bufs[--p->num_free];
+
+    seq = p->next_seq++;
+    slot = &p->window[seq % p->num_buffers];
+    assert(!slot->done);
+
+    slot->samples = samples;
+    slot->num_samples = (unsigned int) num_samples;
+    slot->meta = *meta;
+    slot->rx_us = async_stats_time_us();
+
+    /* Queued before `pending` is visible, so that a worker woken for it
+     * will find it */
+    queue_push(&p->queues[seq % p->num_workers], p->num_buffers, seq);
+    p->pending++;
+    pthread_cond_signal(&p->work_ready);
+
+    MUTEX_UNLOCK(&p->lock);
+
+    return next;
+}
+
+static void *rx_thread(void *arg)
+{
+    struct bladerf_rx_pipeline *p = (struct bladerf_rx_pipeline *) arg;
+
+    p->rx_status = async_run_stream(p->stream, BLADERF_MODULE_RX);
+    if (p->rx_status != 0) {
+        log_debug("%s: RX stream failed: %s\n",
+                  __FUNCTION__, bladerf_strerror(p->rx_status));
+    }
+
+    return NULL;
+}
+
+static int init_pipeline(struct bladerf_rx_pipeline *p,
+                         const struct bladerf_rx_pipeline_config *c)
+{
+    unsigned int i;
+    int status;
+
+    status = bladerf_init_stream(&p->stream, p->dev, rx_callback,
+                                 &p->buffers, c->num_buffers, c->format,
+                                 c->buffer_size, c->num_transfers, p);
+    if (status != 0) {
+        return status;
+    }
+
+    p->window = calloc(c->num_buffers, sizeof(p->window[0]));
+    p->free_bufs = calloc(c->num_buffers, sizeof(p->free_bufs[0]));
+    p->queues = calloc(c->num_workers, sizeof(p->queues[0]));
+    p->workers = calloc(c->num_workers, sizeof(p->workers[0]));
+
+    if (p->window == NULL || p->free_bufs == NULL ||
+        p->queues == NULL || p->workers == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    p->num_workers = c->num_workers;
+
+    for (i = 0; i < c->num_workers; i++) {
+        MUTEX_INIT(&p->queues[i].lock);
+        p->workers[i].p = p;
+        p->workers[i].idx = i;
+    }
+
+    for (i = 0; i < c->num_workers; i++) {
+        p->queues[i].seqs = calloc(c->num_buffers, sizeof(uint64_t));
+        if (p->queues[i].seqs == NULL) {
+            return BLADERF_ERR_MEM;
+        }
+    }
+
+    /* The RX stream starts out by submitting the first num_transfers
+     * buffers */
+    for (i = c->num_transfers; i < c->num_buffers; i++) {
+        p->free_bufs[p->num_free++] = p->buffers[i];
+    }
+
+    return 0;
+}
+
+/* Stop the stream and the workers, and free everything allocated for `p` */
+static int cleanup(struct bladerf_rx_pipeline *p)
+{
+    int status = 0;
+    unsigned int i;
+
+    ATOMIC_STORE_RELEASE(&p->stop, true);
+
+    if (p->rx_running) {
+        pthread_join(p->rx_thread, NULL);
+        status = p->rx_status;
+    }
+
+    /* Let the workers finish off what has already been received */
+    MUTEX_LOCK(&p->lock);
+    p->rx_done = true;
+    pthread_cond_broadcast(&p->work_ready);
+    MUTEX_UNLOCK(&p->lock);
+
+    for (i = 0; i < p->num_workers; i++) {
+        if (p->workers[i].running) {
+            pthread_join(p->workers[i].thread, NULL);
+        }
+    }
+
+    /* This also deconfigures the module's format */
+    if (p->configured) {
+        bladerf_enable_module(p->dev, BLADERF_MODULE_RX, false);
+    }
+
+    if (p->stream != NULL) {
+        bladerf_deinit_stream(p->stream);
+    }
+
+    if (p->queues != NULL) {
+        for (i = 0; i < p->num_workers; i++) {
+            pthread_mutex_destroy(&p->queues[i].lock);
+            free(p->queues[i].seqs);
+        }
+    }
+
+    pthread_cond_destroy(&p->work_ready);
+    pthread_mutex_destroy(&p->lock);
+
+    free(p->queues);
+    free(p->workers);
+    free(p->free_bufs);
+    free(p->window);
+    free(p);
+
+    return status;
+}
+
+int rx_pipeline_start(struct bladerf *dev,
+                      const struct bladerf_rx_pipeline_config *config,
+                      struct bladerf_rx_pipeline **pipeline)
+{
+    struct bladerf_rx_pipeline *p;
+    unsigned int i;
+    int status;
+
+    *pipeline = NULL;
+
+    if (config->buffer_size == 0 || config->buffer_size % 1024 != 0) {
+        log_debug("%s: Buffer size must be a multiple of 1024\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (config->num_transfers == 0 ||
+        config->num_buffers <= config->num_transfers) {
+        log_debug("%s: # buffers must exceed the # transfers\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (config->num_workers == 0 ||
+        config->num_workers > BLADERF_RX_PIPELINE_MAX_WORKERS) {
+        log_debug("%s: Between 1 and %u workers are supported\n",
+                  __FUNCTION__, BLADERF_RX_PIPELINE_MAX_WORKERS);
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (config->work == NULL) {
+        log_debug("%s: A work function is required\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    p = calloc(1, sizeof(*p));
+    if (p == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    p->dev = dev;
+    p->num_buffers = config->num_buffers;
+    p->work = config->work;
+    p->deliver = config->deliver;
+    p->user_data = config->user_data;
+
+    MUTEX_INIT(&p->lock);
+    if (pthread_cond_init(&p->work_ready, NULL) != 0) {
+        pthread_mutex_destroy(&p->lock);
+        free(p);
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    status = init_pipeline(p, config);
+    if (status != 0) {
+        goto error;
+    }
+
+    for (i = 0; i < p->num_workers; i++) {
+        if (pthread_create(&p->workers[i].thread, NULL, worker_task,
+                           &p->workers[i]) != 0) {
+            status = BLADERF_ERR_UNEXPECTED;
+            goto error;
+        }
+        p->workers[i].running = true;
+    }
+
+    p->configured = true;
+
+    CTRL_LOCK(dev, CTRL_LOCK_ALL);
+    status = perform_format_config(dev, BLADERF_MODULE_RX, config->format);
+    CTRL_UNLOCK(dev, CTRL_LOCK_ALL);
+
+    if (status != 0) {
+        goto error;
+    }
+
+    status = bladerf_enable_module(dev, BLADERF_MODULE_RX, true);
+    if (status != 0) {
+        goto error;
+    }
+
+    if (pthread_create(&p->rx_thread, NULL, rx_thread, p) != 0) {
+        status = BLADERF_ERR_UNEXPECTED;
+        goto error;
+    }
+    p->rx_running = true;
+
+    log_debug("%s: Started with %u buffers of %u samples, %u transfers, "
+              "%u workers\n", __FUNCTION__, config->num_buffers,
+              config->buffer_size, config->num_transfers,
+              config->num_workers);
+
+    *pipeline = p;
+    return 0;
+
+error:
+    cleanup(p);
+    return status;
+}
+
+void rx_pipeline_get_stats(struct bladerf_rx_pipeline *p,
+                           struct bladerf_rx_pipeline_stats *stats)
+{
+    MUTEX_LOCK(&p->lock);
+    *stats = p->stats;
+    MUTEX_UNLOCK(&p->lock);
+}
+
+int rx_pipeline_stop(struct bladerf_rx_pipeline *p)
+{
+    return cleanup(p);
+}
@@ -0,0 +1,55 @@
+/**
+ * @file rx_pipeline.h
+ *
+ * @brief Processing of received buffers by a pool of worker threads, with
+ *        results delivered in reception order
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BLADERF_RX_PIPELINE_H_
+#define BLADERF_RX_PIPELINE_H_
+
+#include "libbladeRF.h"
+
+/**
+ * Start the workers and the RX stream. The caller must not hold any of
+ * dev->ctrl_lock[].
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int rx_pipeline_start(struct bladerf *dev,
+                      const struct bladerf_rx_pipeline_config *config,
+                      struct bladerf_rx_pipeline **pipeline);
+
+/**
+ * Retrieve statistics from a running pipeline
+ */
+void rx_pipeline_get_stats(struct bladerf_rx_pipeline *pipeline,
+                           struct bladerf_rx_pipeline_stats *stats);
+
+/**
+ * Stop the RX stream, drain the workers, and free the pipeline. The caller
+ * must not hold any of dev->ctrl_lock[].
+ *
+ * @return 0 on success, or the error that ended the RX stream
+ */
+int rx_pipeline_stop(struct bladerf_rx_pipeline *pipeline);
+
+#endif
@@ -0,0 +1,634 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ *
+ *
+ * The ring is a POSIX shared memory object holding a header, followed by
+ * `num_slots` slots of `slot_size` samples. The publisher receives into
+ * slot `seq % num_slots` with the sync interface, and then advances
+ * `write_seq`. It never waits for readers: each reader keeps its own cursor,
+ * and a reader that falls more than a ring behind skips ahead, counting the
+ * slots it lost.
+ *
+ * Readers are handed pointers into the ring, so a slot may be overwritten
+ * while a slow reader is still using it. Each slot is therefore tagged with
+ * the sequence number of its contents, in the manner of a seqlock. Before
+ * rewriting a slot, the publisher tags it with a sequence number that maps to
+ * a different slot, which no reader of this slot can be expecting. Upon
+ * release, a reader checks that the tag still matches the sequence number it
+ * read, and otherwise knows that the samples it was given were (possibly
+ * partially) overwritten.
+ *
+ * Sequence numbers are 32 bits wide, so that they are accessed atomically on
+ * all targets, and wrap around. As `num_slots` is a power of two, slot
+ * indices remain consistent across the wrap.
+ *
+ * Readers block on a process-shared condition variable. The publisher only
+ * signals it when readers are waiting, so publishing a slot costs no system
+ * calls when all readers are keeping up without blocking.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "log.h"
+#include "rel_assert.h"
+#include "bladerf_priv.h"
+#include "rx_share.h"
+
+#define RX_SHARE_MAGIC      0x52584642  /* "BFXR" */
+#define RX_SHARE_VERSION    1
+
+/* Alignment of the header and of each slot's samples */
+#define RX_SHARE_ALIGN      64
+
+/* Largest name accepted, including the leading '/' */
+#define RX_SHARE_NAME_MAX   64
+
+/* Timeout of each sync RX call, which bounds the time taken to stop */
+#ifndef RX_SHARE_TIMEOUT_MS
+#   define RX_SHARE_TIMEOUT_MS  1000
+#endif
+
+#define ROUND_UP(x, n)      ((((x) + (n) - 1) / (n)) * (n))
+
+struct rx_share_header {
+    /* Written once, before `magic` is set */
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_slots;
+    uint32_t slot_size;             /* Samples per slot */
+    uint64_t slot_stride;           /* Bytes from one slot to the next */
+    uint64_t slots_offset;          /* Offset of the first slot */
+
+    volatile uint32_t write_seq;    /* Slots published, modulo 2^32 */
+    volatile uint32_t running;      /* Cleared when the publisher stops */
+    volatile uint32_t waiters;      /* Readers blocked on `published`.
+                                     * Protected by `lock`. */
+
+    pthread_mutex_t lock;
+    pthread_cond_t published;
+};
+
+struct rx_share_slot_header {
+    volatile uint32_t seq;          /* Sequence number of the contents */
+    uint32_t num_samples;
+    uint32_t status;
+    uint32_t reserved;
+    uint64_t timestamp;
+};
+
+struct bladerf_rx_share {
+    struct bladerf *dev;
+    char name[RX_SHARE_NAME_MAX];
+    struct rx_share_header *hdr;
+    size_t size;
+
+    pthread_t thread;
+    volatile bool stop;
+    int status;                     /* First RX error */
+
+    volatile uint64_t slots;
+    volatile uint64_t overruns;
+    volatile uint64_t timeouts;
+};
+
+struct bladerf_rx_share_reader {
+    struct rx_share_header *hdr;
+    size_t size;
+
+    uint32_t cursor;                /* Next sequence number to read */
+    uint32_t held;                  /* Sequence number of the held slot */
+    bool holding;
+    bool lost;                      /* Slots skipped since the last read */
+
+    struct bladerf_rx_share_reader_stats stats;
+};
+
+static inline struct rx_share_slot_header *get_slot(struct rx_share_header *h,
+                                                    uint32_t seq)
+{
+    const uint32_t index = seq & (h->num_slots - 1);
+    uint8_t *base = (uint8_t *) h + h->slots_offset;
+
+    return (struct rx_share_slot_header *) (base + index * h->slot_stride);
+}
+
+static inline int16_t *slot_samples(struct rx_share_slot_header *slot)
+{
+    return (int16_t *) ((uint8_t *) slot + RX_SHARE_ALIGN);
+}
+
+/* Normalize a ring name to the "/name" form expected by shm_open() */
+static int shm_name(const char *name, char *buf)
+{
+    const char *base = (name[0] == '/') ? &name[1] : name;
+
+    if (base[0] == '\0' || strchr(base, '/') != NULL ||
+        strlen(base) + 2 > RX_SHARE_NAME_MAX) {
+        log_debug("Invalid RX share name: %s\n", name);
+        return BLADERF_ERR_INVAL;
+    }
+
+    snprintf(buf, RX_SHARE_NAME_MAX, "/%s", base);
+    return 0;
+}
+
+/* Lock the header, recovering the lock if a reader died while holding it.
+ * The lock only protects the wait bookkeeping, which a reader leaves
+ * consistent before it can be killed. */
+static void share_lock(struct rx_share_header *h)
+{
+    if (pthread_mutex_lock(&h->lock) == EOWNERDEAD) {
+        pthread_mutex_consistent(&h->lock);
+    }
+}
+
+static void share_unlock(struct rx_share_header *h)
+{
+    pthread_mutex_unlock(&h->lock);
+}
+
+static void wake_readers(struct rx_share_header *h, bool force)
+{
+    /* Pairs with the fence in wait_published(), such that either the reader
+     * sees the new write_seq, or we see the reader waiting */
+    ATOMIC_FENCE();
+
+    if (force || ATOMIC_LOAD_ACQUIRE(&h->waiters) != 0) {
+        share_lock(h);
+        pthread_cond_broadcast(&h->published);
+        share_unlock(h);
+    }
+}
+
+static void *publish_task(void *arg)
+{
+    struct bladerf_rx_share *s = (struct bladerf_rx_share *) arg;
+    struct rx_share_header *h = s->hdr;
+    struct bladerf_metadata meta;
+    uint32_t seq = 0;
+    int status = 0;
+
+    while (!ATOMIC_LOAD_ACQUIRE(&s->stop)) {
+        struct rx_share_slot_header *slot = get_slot(h, seq);
+
+        /* Invalidate the slot for any reader still holding its previous
+         * contents, before they are touched */
+        ATOMIC_STORE_RELEASE(&slot->seq, seq - 1);
+        ATOMIC_FENCE();
+
+        memset(&meta, 0, sizeof(meta));
+        meta.flags = BLADERF_META_FLAG_RX_NOW;
+
+        status = bladerf_sync_rx(s->dev, slot_samples(slot), h->slot_size,
+                                 &meta, RX_SHARE_TIMEOUT_MS);
+
+        if (status == BLADERF_ERR_TIMEOUT) {
+            s->timeouts++;
+            status = 0;
+            continue;
+        } else if (status != 0) {
+            log_debug("RX share stopping on error: %s\n",
+                      bladerf_strerror(status));
+            break;
+        }
+
+        slot->num_samples = meta.actual_count;
+        slot->status = meta.status;
+        slot->timestamp = meta.timestamp;
+
+        if (meta.status & BLADERF_META_STATUS_OVERRUN) {
+            s->overruns++;
+        }
+
+        ATOMIC_STORE_RELEASE(&slot->seq, seq);
+        ATOMIC_STORE_RELEASE(&h->write_seq, ++seq);
+        s->slots++;
+
+        wake_readers(h, false);
+    }
+
+    s->status = status;
+
+    ATOMIC_STORE_RELEASE(&h->running, 0);
+    wake_readers(h, true);
+
+    return NULL;
+}
+
+static int init_header(struct rx_share_header *h,
+                       const struct bladerf_rx_share_config *config,
+                       uint64_t slot_stride, uint64_t slots_offset)
+{
+    pthread_mutexattr_t mattr;
+    pthread_condattr_t cattr;
+    int ret;
+
+    h->version = RX_SHARE_VERSION;
+    h->num_slots = config->num_slots;
+    h->slot_size = config->slot_size;
+    h->slot_stride = slot_stride;
+    h->slots_offset = slots_offset;
+    h->write_seq = 0;
+    h->running = 1;
+    h->waiters = 0;
+
+    pthread_mutexattr_init(&mattr);
+    ret = pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+    if (ret == 0) {
+        ret = pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+    }
+    if (ret == 0) {
+        ret = pthread_mutex_init(&h->lock, &mattr);
+    }
+    pthread_mutexattr_destroy(&mattr);
+
+    if (ret != 0) {
+        log_debug("Failed to create shared mutex: %s\n", strerror(ret));
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    pthread_condattr_init(&cattr);
+    ret = pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+    if (ret == 0) {
+        ret = pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    }
+    if (ret == 0) {
+        ret = pthread_cond_init(&h->published, &cattr);
+    }
+    pthread_condattr_destroy(&cattr);
+
+    if (ret != 0) {
+        log_debug("Failed to create shared condition: %s\n", strerror(ret));
+        pthread_mutex_destroy(&h->lock);
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    /* Readers check the magic before anything else */
+    ATOMIC_STORE_RELEASE(&h->magic, RX_SHARE_MAGIC);
+    return 0;
+}
+
+int rx_share_start(struct bladerf *dev, const char *name,
+                   const struct bladerf_rx_share_config *config,
+                   struct bladerf_rx_share **share)
+{
+    struct bladerf_rx_share *s;
+    uint64_t slot_stride, slots_offset;
+    int fd, status;
+
+    *share = NULL;
+
+    if (config->num_slots < 2 ||
+        (config->num_slots & (config->num_slots - 1)) != 0 ||
+        config->slot_size == 0 || config->slot_size > (1 << 24)) {
+        log_debug("Invalid RX share configuration\n");
+        return BLADERF_ERR_INVAL;
+    }
+
+    s = (struct bladerf_rx_share *) calloc(1, sizeof(*s));
+    if (s == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
+    s->dev = dev;
+
+    status = shm_name(name, s->name);
+    if (status != 0) {
+        free(s);
+        return status;
+    }
+
+    slot_stride = RX_SHARE_ALIGN +
+                  ROUND_UP((uint64_t) config->slot_size * 2 * sizeof(int16_t),
+                           RX_SHARE_ALIGN);
+    slots_offset = ROUND_UP(sizeof(struct rx_share_header), RX_SHARE_ALIGN);
+    s->size = (size_t) (slots_offset + slot_stride * config->num_slots);
+
+    /* A ring left behind by a publisher that exited uncleanly is replaced */
+    shm_unlink(s->name);
+
+    fd = shm_open(s->name, O_RDWR | O_CREAT | O_EXCL, 0666);
+    if (fd < 0) {
+        log_debug("Failed to create %s: %s\n", s->name, strerror(errno));
+        free(s);
+        return BLADERF_ERR_IO;
+    }
+
+    if (ftruncate(fd, (off_t) s->size) != 0) {
+        log_debug("Failed to size %s: %s\n", s->name, strerror(errno));
+        status = BLADERF_ERR_MEM;
+    } else {
+        s->hdr = (struct rx_share_header *) mmap(NULL, s->size,
+                                                 PROT_READ | PROT_WRITE,
+                                                 MAP_SHARED, fd, 0);
+        if (s->hdr == MAP_FAILED) {
+            log_debug("Failed to map %s: %s\n", s->name, strerror(errno));
+            s->hdr = NULL;
+            status = BLADERF_ERR_MEM;
+        }
+    }
+
+    close(fd);
+
+    if (status == 0) {
+        status = init_header(s->hdr, config, slot_stride, slots_offset);
+    }
+
+    if (status == 0) {
+        status = bladerf_sync_config(dev, BLADERF_MODULE_RX,
+                                     BLADERF_FORMAT_SC16_Q11_META,
+                                     config->num_buffers, config->buffer_size,
+                                     config->num_transfers,
+                                     RX_SHARE_TIMEOUT_MS);
+    }
+
+    if (status == 0) {
+        status = bladerf_enable_module(dev, BLADERF_MODULE_RX, true);
+    }
+
+    if (status == 0) {
+        if (pthread_create(&s->thread, NULL, publish_task, s) != 0) {
+            bladerf_enable_module(dev, BLADERF_MODULE_RX, false);
+            status = BLADERF_ERR_UNEXPECTED;
+        }
+    }
+
+    if (status != 0) {
+        if (s->hdr != NULL) {
+            munmap(s->hdr, s->size);
+        }
+        shm_unlink(s->name);
+        free(s);
+        return status;
+    }
+
+    log_verbose("Publishing RX samples to %s (%u slots of %u samples)\n",
+                s->name, config->num_slots, config->slot_size);
+
+    *share = s;
+    return 0;
+}
+
+void rx_share_get_stats(struct bladerf_rx_share *share,
+                        struct bladerf_rx_share_stats *stats)
+{
+    stats->slots = share->slots;
+    stats->overruns = share->overruns;
+    stats->timeouts = share->timeouts;
+}
+
+int rx_share_stop(struct bladerf_rx_share *share)
+{
+    int status;
+
+    ATOMIC_STORE_RELEASE(&share->stop, true);
+    pthread_join(share->thread, NULL);
+
+    status = bladerf_enable_module(share->dev, BLADERF_MODULE_RX, false);
+    if (share->status != 0) {
+        status = share->status;
+    }
+
+    /* Readers keep their mappings, and see that the ring has stopped */
+    munmap(share->hdr, share->size);
+    shm_unlink(share->name);
+    free(share);
+
+    return status;
+}
+
+int rx_share_open(struct bladerf_rx_share_reader **reader, const char *name)
+{
+    struct bladerf_rx_share_reader *r;
+    struct rx_share_header *h;
+    char path[RX_SHARE_NAME_MAX];
+    struct stat st;
+    size_t size;
+    int fd, status;
+
+    *reader = NULL;
+
+    status = shm_name(name, path);
+    if (status != 0) {
+        return status;
+    }
+
+    fd = shm_open(path, O_RDWR, 0);
+    if (fd < 0) {
+        log_debug("Failed to open %s: %s\n", path, strerror(errno));
+        return (errno == ENOENT) ? BLADERF_ERR_NODEV : BLADERF_ERR_IO;
+    }
+
+    if (fstat(fd, &st) != 0 ||
+        (size_t) st.st_size < sizeof(struct rx_share_header)) {
+        close(fd);
+        return BLADERF_ERR_IO;
+    }
+
+    size = (size_t) st.st_size;
+    h = (struct rx_share_header *) mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (h == MAP_FAILED) {
+        log_debug("Failed to map %s: %s\n", path, strerror(errno));
+        return BLADERF_ERR_MEM;
+    }
+
+    if (ATOMIC_LOAD_ACQUIRE(&h->magic) != RX_SHARE_MAGIC ||
+        h->version != RX_SHARE_VERSION ||
+        h->num_slots == 0 || (h->num_slots & (h->num_slots - 1)) != 0 ||
+        h->slots_offset + h->slot_stride * h->num_slots > size) {
+        log_debug("%s is not a valid RX share\n", path);
+        munmap(h, size);
+        return BLADERF_ERR_INVAL;
+    }
+
+    r = (struct bladerf_rx_share_reader *) calloc(1, sizeof(*r));
+    if (r == NULL) {
+        munmap(h, size);
+        return BLADERF_ERR_MEM;
+    }
+
+    r->hdr = h;
+    r->size = size;
+
+    /* Begin with the next slot published */
+    r->cursor = ATOMIC_LOAD_ACQUIRE(&h->write_seq);
+
+    *reader = r;
+    return 0;
+}
+
+/* Wait for a slot beyond the reader's cursor to be published, until the
+ * given deadline (or indefinitely if NULL) */
+static int wait_published(struct bladerf_rx_share_reader *r,
+                          const struct timespec *deadline)
+{
+    struct rx_share_header *h = r->hdr;
+    int ret = 0;
+
+    share_lock(h);
+    h->waiters++;
+    ATOMIC_FENCE();
+
+    while (ret != ETIMEDOUT &&
+           ATOMIC_LOAD_ACQUIRE(&h->write_seq) == r->cursor &&
+           ATOMIC_LOAD_ACQUIRE(&h->running)) {
+
+        if (deadline != NULL) {
+            ret = pthread_cond_timedwait(&h->published, &h->lock, deadline);
+        } else {
+            ret = pthread_cond_wait(&h->published, &h->lock);
+        }
+
+        if (ret == EOWNERDEAD) {
+            pthread_mutex_consistent(&h->lock);
+            ret = 0;
+        }
+    }
+
+    h->waiters--;
+    share_unlock(h);
+
+    return (ret == ETIMEDOUT) ? BLADERF_ERR_TIMEOUT : 0;
+}
+
+int rx_share_read(struct bladerf_rx_share_reader *r,
+                  struct bladerf_rx_share_slot *slot,
+                  unsigned int timeout_ms)
+{
+    struct rx_share_header *h = r->hdr;
+    struct timespec deadline;
+    int status;
+
+    if (r->holding) {
+        rx_share_release(r);
+    }
+
+    if (timeout_ms != 0) {
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    for (;;) {
+        const uint32_t write_seq = ATOMIC_LOAD_ACQUIRE(&h->write_seq);
+        const uint32_t behind = write_seq - r->cursor;
+        struct rx_share_slot_header *s;
+
+        if (behind == 0) {
+            if (!ATOMIC_LOAD_ACQUIRE(&h->running)) {
+                return BLADERF_ERR_NODEV;
+            }
+
+            status = wait_published(r, timeout_ms != 0 ? &deadline : NULL);
+            if (status != 0) {
+                return status;
+            }
+
+            continue;
+        }
+
+        if (behind > h->num_slots) {
+            /* Lapped by the publisher. Resume halfway back around the
+             * ring, allowing some slack before being lapped again. */
+            const uint32_t resume = write_seq - h->num_slots / 2;
+
+            r->stats.slots_lost += resume - r->cursor;
+            r->cursor = resume;
+            r->lost = true;
+            continue;
+        }
+
+        s = get_slot(h, r->cursor);
+
+        if (ATOMIC_LOAD_ACQUIRE(&s->seq) != r->cursor) {
+            /* Overwritten since write_seq was read */
+            r->stats.slots_lost++;
+            r->cursor++;
+            r->lost = true;
+            continue;
+        }
+
+        slot->samples = slot_samples(s);
+        slot->num_samples = s->num_samples;
+        slot->timestamp = s->timestamp;
+        slot->status = s->status;
+        slot->seq = r->cursor;
+
+        if (r->lost) {
+            slot->status |= BLADERF_META_STATUS_OVERRUN;
+            r->lost = false;
+        }
+
+        r->held = r->cursor;
+        r->holding = true;
+        r->cursor++;
+        r->stats.slots_read++;
+
+        return 0;
+    }
+}
+
+bool rx_share_release(struct bladerf_rx_share_reader *r)
+{
+    bool intact;
+
+    if (!r->holding) {
+        return true;
+    }
+
+    /* Ensure the caller's accesses to the samples are complete before
+     * checking whether they were overwritten */
+    ATOMIC_FENCE();
+    intact = ATOMIC_LOAD_ACQUIRE(&get_slot(r->hdr, r->held)->seq) == r->held;
+
+    if (!intact) {
+        r->stats.slots_overwritten++;
+    }
+
+    r->holding = false;
+    return intact;
+}
+
+void rx_share_get_reader_stats(struct bladerf_rx_share_reader *r,
+                               struct bladerf_rx_share_reader_stats *stats)
+{
+    *stats = r->stats;
+}
+
+void rx_share_close(struct bladerf_rx_share_reader *r)
+{
+    munmap(r->hdr, r->size);
+    free(r);
+}
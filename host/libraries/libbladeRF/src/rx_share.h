@@ -0,0 +1,85 @@
+/**
+ * @file rx_share.h
+ *
+ * @brief Publication of received samples to other processes, through a
+ *        shared-memory ring
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BLADERF_RX_SHARE_H_
+#define BLADERF_RX_SHARE_H_
+
+#include "libbladeRF.h"
+
+/**
+ * Create the ring and start publishing received samples to it. The caller
+ * must not hold any of dev->ctrl_lock[].
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int rx_share_start(struct bladerf *dev, const char *name,
+                   const struct bladerf_rx_share_config *config,
+                   struct bladerf_rx_share **share);
+
+/**
+ * Retrieve a publisher's statistics
+ */
+void rx_share_get_stats(struct bladerf_rx_share *share,
+                        struct bladerf_rx_share_stats *stats);
+
+/**
+ * Stop publishing, and remove the ring. Readers that still have it mapped
+ * see it end.
+ *
+ * @return 0 on success, or the first RX error encountered
+ */
+int rx_share_stop(struct bladerf_rx_share *share);
+
+/**
+ * Map an existing ring
+ *
+ * @return 0 on success, BLADERF_ERR_NODEV if no ring of the given name
+ *         exists, or another BLADERF_ERR_* value on failure
+ */
+int rx_share_open(struct bladerf_rx_share_reader **reader, const char *name);
+
+/**
+ * Wait for the next slot, and hold it for the caller
+ *
+ * @return 0 on success, BLADERF_ERR_TIMEOUT, or BLADERF_ERR_NODEV if the
+ *         publisher has stopped and all slots have been read
+ */
+int rx_share_read(struct bladerf_rx_share_reader *reader,
+                  struct bladerf_rx_share_slot *slot,
+                  unsigned int timeout_ms);
+
+/**
+ * Release the slot held by rx_share_read()
+ *
+ * @return true if the slot was not overwritten while it was held
+ */
+bool rx_share_release(struct bladerf_rx_share_reader *reader);
+
+void rx_share_get_reader_stats(struct bladerf_rx_share_reader *reader,
+                               struct bladerf_rx_share_reader_stats *stats);
+
+void rx_share_close(struct bladerf_rx_share_reader *reader);
+
+#endif
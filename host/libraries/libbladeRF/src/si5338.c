@@ -216,39 +216,54 @@ static void si5338_pack_regs(struct si5338_multisynth *ms)
     return ;
 }
 
-static int si5338_write_multisynth(struct bladerf *dev,
-                                   struct si5338_multisynth *ms)
+int si5338_access_batch(struct bladerf *dev,
+                        struct backend_reg_access *regs, size_t count)
 {
-    int i, status;
-    uint8_t r_power, r_count, val;
-
-    log_verbose("Writing MS%d\n", ms->index);
+    int status = 0;
+    size_t i;
 
-    /* Write out the enables */
-    status = SI5338_READ(dev, 36 + ms->index, &val);
-    if (status < 0) {
-        si5338_read_error(status, bladerf_strerror(status));
-        return status;
-    }
-    val &= ~(7);
-    val |= ms->enable;
-    log_verbose("Wrote enable register: 0x%2.2x\n", val);
-    status = SI5338_WRITE(dev, 36 + ms->index, val);
-    if (status < 0) {
-        si5338_write_error(status, bladerf_strerror(status));
-        return status;
+    if (dev->fn->si5338_access_batch != NULL) {
+        return dev->fn->si5338_access_batch(dev, regs, count);
     }
 
-    /* Write out the registers */
-    for (i = 0 ; i < 10 ; i++) {
-        status = SI5338_WRITE(dev, ms->base + i, *(ms->regs+i));
-        if (status < 0) {
-            si5338_write_error(status, bladerf_strerror(status));
-            return status;
+    for (i = 0; i < count && status == 0; i++) {
+        if (regs[i].write) {
+            status = SI5338_WRITE(dev, regs[i].addr, regs[i].data);
+        } else {
+            status = SI5338_READ(dev, regs[i].addr, &regs[i].data);
         }
-        log_verbose("Wrote regs[%d]: 0x%2.2x\n", i, *(ms->regs+i));
     }
 
+    return status;
+}
+
+static inline void queue_write(struct backend_reg_access *regs, size_t *count,
+                               uint16_t addr, uint8_t data)
+{
+    assert(addr <= UINT8_MAX);
+    regs[*count].addr = (uint8_t) addr;
+    regs[*count].data = data;
+    regs[*count].write = true;
+    (*count)++;
+}
+
+static inline struct si5338_ms_shadow *ms_shadow(struct bladerf *dev,
+                                                 struct si5338_multisynth *ms)
+{
+    /* MS1 clocks RX and MS2 clocks TX */
+    assert(ms->index == 1 || ms->index == 2);
+    return &dev->si5338_shadow[ms->index - 1];
+}
+
+/* Get the register values for a calculated multisynth configuration */
+static void si5338_get_regs(const struct si5338_multisynth *ms,
+                            struct si5338_ms_regs *regs)
+{
+    uint8_t r_power;
+    uint32_t r_count;
+
+    memcpy(regs->params, ms->regs, sizeof(regs->params));
+
     /* Calculate r_power from c_count */
     r_power = 0;
     r_count = ms->r >> 1 ;
@@ -258,54 +273,126 @@ static int si5338_write_multisynth(struct bladerf *dev,
     }
 
     /* Set the r value to the log2(r_count) to match Figure 18 */
-    val = 0xc0;
-    val |= (r_power<<2);
+    regs->r_div = 0xc0 | (r_power << 2);
+}
+
+/* Program a multisynth, writing only the registers whose values differ from
+ * those last written to the part */
+static int si5338_write_multisynth(struct bladerf *dev,
+                                   struct si5338_multisynth *ms,
+                                   const struct si5338_ms_regs *ms_regs)
+{
+    struct si5338_ms_shadow *shadow = ms_shadow(dev, ms);
+    struct backend_reg_access regs[SI5338_MS_NUM_REGS + 2];
+    size_t i, count = 0;
+    uint8_t enable;
+    int status;
 
-    log_verbose("Wrote r register: 0x%2.2x\n", val);
+    log_verbose("Writing MS%d\n", ms->index);
 
-    status = SI5338_WRITE(dev, 31 + ms->index, val);
+    /* The enable register contains other settings, so its current value is
+     * required if it is not already known */
+    if (shadow->valid) {
+        enable = shadow->enable;
+    } else {
+        status = SI5338_READ(dev, 36 + ms->index, &enable);
+        if (status < 0) {
+            si5338_read_error(status, bladerf_strerror(status));
+            return status;
+        }
+    }
+
+    enable &= ~(7);
+    enable |= ms->enable;
+
+    if (!shadow->valid || enable != shadow->enable) {
+        queue_write(regs, &count, 36 + ms->index, enable);
+    }
+
+    for (i = 0; i < SI5338_MS_NUM_REGS; i++) {
+        if (!shadow->valid ||
+            ms_regs->params[i] != shadow->regs.params[i]) {
+            queue_write(regs, &count, ms->base + i, ms_regs->params[i]);
+        }
+    }
+
+    if (!shadow->valid || ms_regs->r_div != shadow->regs.r_div) {
+        queue_write(regs, &count, 31 + ms->index, ms_regs->r_div);
+    }
+
+    for (i = 0; i < count; i++) {
+        log_verbose("Writing reg %d: 0x%2.2x\n", regs[i].addr, regs[i].data);
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    status = si5338_access_batch(dev, regs, count);
     if (status < 0) {
         si5338_write_error(status, bladerf_strerror(status));
+
+        /* It is unknown which of the writes took effect */
+        shadow->valid = false;
+        return status;
     }
 
-    return status ;
+    shadow->valid = true;
+    shadow->enable = enable;
+    shadow->regs = *ms_regs;
+
+    return 0;
 }
 
 static int si5338_read_multisynth(struct bladerf *dev,
                                   struct si5338_multisynth *ms)
 {
-    int i, status;
+    struct si5338_ms_shadow *shadow = ms_shadow(dev, ms);
+    struct backend_reg_access regs[SI5338_MS_NUM_REGS + 2];
+    int status;
+    size_t i;
     uint8_t val;
 
     log_verbose("Reading MS%d\n", ms->index);
 
-    /* Read the enable bits */
-    status = SI5338_READ(dev, 36 + ms->index, &val);
-    if (status < 0) {
-        si5338_read_error(status, bladerf_strerror(status));
-        return status ;
+    /* Enable bits, multisynth registers, and RxDIV value */
+    regs[0].addr = 36 + ms->index;
+    for (i = 0; i < SI5338_MS_NUM_REGS; i++) {
+        assert(ms->base + i <= UINT8_MAX);
+        regs[i + 1].addr = (uint8_t) (ms->base + i);
     }
-    ms->enable = val&7;
-    log_verbose("Read enable register: 0x%2.2x\n", val);
+    regs[SI5338_MS_NUM_REGS + 1].addr = 31 + ms->index;
 
-    /* Read all of the multisynth registers */
-    for (i = 0; i < 10; i++) {
-        status = SI5338_READ(dev, ms->base + i, ms->regs+i);
-        if (status < 0) {
-            si5338_read_error(status, bladerf_strerror(status));
-            return status;
-        }
-        log_verbose("Read regs[%d]: 0x%2.2x\n", i, *(ms->regs+i));
+    for (i = 0; i < ARRAY_SIZE(regs); i++) {
+        regs[i].data = 0xff;
+        regs[i].write = false;
     }
 
-    /* Populate the RxDIV value from the register */
-    status = SI5338_READ(dev, 31 + ms->index, &val);
+    status = si5338_access_batch(dev, regs, ARRAY_SIZE(regs));
     if (status < 0) {
         si5338_read_error(status, bladerf_strerror(status));
         return status;
     }
+
+    val = regs[0].data;
+    ms->enable = val&7;
+    log_verbose("Read enable register: 0x%2.2x\n", val);
+
+    for (i = 0; i < SI5338_MS_NUM_REGS; i++) {
+        ms->regs[i] = regs[i + 1].data;
+        log_verbose("Read regs[%d]: 0x%2.2x\n", i, ms->regs[i]);
+    }
+
     /* RxDIV is stored as a power of 2, so restore it on readback */
+    val = regs[SI5338_MS_NUM_REGS + 1].data;
     log_verbose("Read r register: 0x%2.2x\n", val);
+
+    /* Keep track of what is now known to be programmed */
+    shadow->valid = true;
+    shadow->enable = regs[0].data;
+    memcpy(shadow->regs.params, ms->regs, sizeof(shadow->regs.params));
+    shadow->regs.r_div = val;
+
     val = (val>>2)&7;
     ms->r = (1<<val);
 
@@ -315,6 +402,51 @@ static int si5338_read_multisynth(struct bladerf *dev,
     return 0;
 }
 
+static inline bool rates_equal(const struct bladerf_rational_rate *a,
+                               const struct bladerf_rational_rate *b)
+{
+    return a->integer == b->integer && a->num == b->num && a->den == b->den;
+}
+
+static bool si5338_rate_cache_lookup(struct bladerf *dev,
+                                     const struct bladerf_rational_rate *req,
+                                     struct si5338_ms_regs *regs,
+                                     struct bladerf_rational_rate *actual)
+{
+    const struct si5338_rate_cache *cache = &dev->si5338_rate_cache;
+    size_t i;
+
+    for (i = 0; i < cache->count; i++) {
+        if (rates_equal(&cache->entries[i].requested, req)) {
+            *regs = cache->entries[i].regs;
+            *actual = cache->entries[i].actual;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void si5338_rate_cache_store(struct bladerf *dev,
+                                    const struct bladerf_rational_rate *req,
+                                    const struct si5338_ms_regs *regs,
+                                    const struct bladerf_rational_rate *actual)
+{
+    struct si5338_rate_cache *cache = &dev->si5338_rate_cache;
+    size_t i;
+
+    if (cache->count < SI5338_RATE_CACHE_SIZE) {
+        i = cache->count++;
+    } else {
+        i = cache->next;
+        cache->next = (cache->next + 1) % SI5338_RATE_CACHE_SIZE;
+    }
+
+    cache->entries[i].requested = *req;
+    cache->entries[i].regs = *regs;
+    cache->entries[i].actual = *actual;
+}
+
 static void si5338_calculate_samplerate(struct si5338_multisynth *ms,
                                         struct bladerf_rational_rate *rate)
 {
@@ -417,11 +549,21 @@ static int si5338_calculate_multisynth(struct si5338_multisynth *ms,
     return 0;
 }
 
+void si5338_shadow_invalidate(struct bladerf *dev)
+{
+    size_t i;
+
+    for (i = 0; i < NUM_MODULES; i++) {
+        dev->si5338_shadow[i].valid = false;
+    }
+}
+
 int si5338_set_rational_sample_rate(struct bladerf *dev, bladerf_module module,
                                     struct bladerf_rational_rate *rate,
                                     struct bladerf_rational_rate *actual_ret)
 {
     struct si5338_multisynth ms;
+    struct si5338_ms_regs regs;
     struct bladerf_rational_rate req;
     struct bladerf_rational_rate actual;
     int status;
@@ -448,25 +590,89 @@ int si5338_set_rational_sample_rate(struct bladerf *dev, bladerf_module module,
     /* Update the base address register */
     si5338_update_base(&ms);
 
-    /* Calculate multisynth values */
-    status = si5338_calculate_multisynth(&ms, &req);
-    if(status != 0) {
-        return status;
+    if (si5338_rate_cache_lookup(dev, &req, &regs, &actual)) {
+        log_verbose("Using cached MS%d values\n", ms.index);
+    } else {
+        /* Calculate multisynth values */
+        status = si5338_calculate_multisynth(&ms, &req);
+        if(status != 0) {
+            return status;
+        }
+
+        /* Get the actual rate */
+        si5338_calculate_samplerate(&ms, &actual);
+        si5338_get_regs(&ms, &regs);
+        si5338_rate_cache_store(dev, &req, &regs, &actual);
     }
 
-    /* Get the actual rate */
-    si5338_calculate_samplerate(&ms, &actual);
     if (actual_ret) {
         memcpy(actual_ret, &actual, sizeof(*actual_ret));
     }
 
     /* Program it to the part */
-    status = si5338_write_multisynth(dev, &ms);
+    status = si5338_write_multisynth(dev, &ms, &regs);
 
     /* Done */
     return status ;
 }
 
+/* Set up the index, base address, and output enables of the multisynth that
+ * clocks the specified module */
+static void si5338_module_ms(struct si5338_multisynth *ms,
+                             bladerf_module module)
+{
+    ms->enable = SI5338_EN_A;
+    if (module == BLADERF_MODULE_TX) {
+        ms->enable |= SI5338_EN_B;
+    }
+
+    ms->index = (module == BLADERF_MODULE_RX) ? 1 : 2;
+    si5338_update_base(ms);
+}
+
+int si5338_get_rate_regs(struct bladerf *dev, bladerf_module module,
+                         struct si5338_ms_regs *regs)
+{
+    struct si5338_multisynth ms;
+    struct si5338_ms_shadow *shadow;
+    int status;
+
+    si5338_module_ms(&ms, module);
+    shadow = ms_shadow(dev, &ms);
+
+    if (!shadow->valid) {
+        status = si5338_read_multisynth(dev, &ms);
+        if (status != 0) {
+            return status;
+        }
+    }
+
+    *regs = shadow->regs;
+    return 0;
+}
+
+int si5338_set_rate_regs(struct bladerf *dev, bladerf_module module,
+                         const struct si5338_ms_regs *regs)
+{
+    struct si5338_multisynth ms;
+
+    si5338_module_ms(&ms, module);
+    return si5338_write_multisynth(dev, &ms, regs);
+}
+
+bool si5338_rate_regs_match(struct bladerf *dev, bladerf_module module,
+                            const struct si5338_ms_regs *regs)
+{
+    struct si5338_multisynth ms;
+    const struct si5338_ms_shadow *shadow;
+
+    si5338_module_ms(&ms, module);
+    shadow = ms_shadow(dev, &ms);
+
+    return shadow->valid &&
+           memcmp(&shadow->regs, regs, sizeof(*regs)) == 0;
+}
+
 int si5338_set_sample_rate(struct bladerf *dev, bladerf_module module,
                            uint32_t rate, uint32_t *actual)
 {
@@ -546,3 +752,66 @@ int si5338_get_sample_rate(struct bladerf *dev, bladerf_module module,
     return 0;
 }
 
+
+int si5338_set_mimo_mode(struct bladerf *dev, bladerf_mimo_mode mode)
+{
+    struct backend_reg_access regs[4];
+    size_t count = 0;
+    int status;
+
+    switch (mode) {
+        case BLADERF_MIMO_SLAVE:
+            /* Take the reference clock from the MIMO clock input */
+            queue_write(regs, &count, 6, 0x04);
+            queue_write(regs, &count, 28, 0x2b);
+            queue_write(regs, &count, 29, 0x28);
+            queue_write(regs, &count, 30, 0xa8);
+            break;
+
+        case BLADERF_MIMO_MASTER:
+            /* Drive the reference clock onto the MIMO clock output */
+            queue_write(regs, &count, 39, 0x01);
+            queue_write(regs, &count, 34, 0x22);
+            break;
+
+        default:
+            return BLADERF_ERR_INVAL;
+    }
+
+    status = si5338_access_batch(dev, regs, count);
+    if (status < 0) {
+        si5338_write_error(status, bladerf_strerror(status));
+    }
+
+    si5338_shadow_invalidate(dev);
+    return status;
+}
+
+int si5338_enable_sample_clocks(struct bladerf *dev, bool enable)
+{
+    /* Output enable register. Setting a bit disables the associated output;
+     * CLK1 and CLK2 are driven by MS1 and MS2. */
+    const uint8_t addr = 230;
+    const uint8_t mask = (1 << 1) | (1 << 2);
+    uint8_t data;
+    int status;
+
+    status = SI5338_READ(dev, addr, &data);
+    if (status < 0) {
+        si5338_read_error(status, bladerf_strerror(status));
+        return status;
+    }
+
+    if (enable) {
+        data &= ~mask;
+    } else {
+        data |= mask;
+    }
+
+    status = SI5338_WRITE(dev, addr, data);
+    if (status < 0) {
+        si5338_write_error(status, bladerf_strerror(status));
+    }
+
+    return status;
+}
@@ -40,4 +40,90 @@ int si5338_get_sample_rate(struct bladerf *dev, bladerf_module module, unsigned
 int si5338_set_rational_sample_rate(struct bladerf *dev, bladerf_module module, struct bladerf_rational_rate *rate, struct bladerf_rational_rate *actual);
 int si5338_get_rational_sample_rate(struct bladerf *dev, bladerf_module module, struct bladerf_rational_rate *rate);
 
+/**
+ * Get the multisynth register values currently programmed for a module's
+ * sample clock. These are read from the device only if they are not already
+ * known.
+ *
+ * @param[in]   dev     Device handle
+ * @param[in]   module  Module to query
+ * @param[out]  regs    Register values
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int si5338_get_rate_regs(struct bladerf *dev, bladerf_module module,
+                         struct si5338_ms_regs *regs);
+
+/**
+ * Program a module's sample clock with register values obtained from
+ * si5338_get_rate_regs(). Only the registers whose values differ from those
+ * currently programmed are written.
+ *
+ * @param[in]   dev     Device handle
+ * @param[in]   module  Module to configure
+ * @param[in]   regs    Register values
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int si5338_set_rate_regs(struct bladerf *dev, bladerf_module module,
+                         const struct si5338_ms_regs *regs);
+
+/**
+ * Check whether a module's sample clock is known to be programmed with the
+ * specified register values
+ *
+ * @param[in]   dev     Device handle
+ * @param[in]   module  Module to check
+ * @param[in]   regs    Register values
+ *
+ * @return true if the values are programmed, false if they differ or the
+ *         programmed values are not known
+ */
+bool si5338_rate_regs_match(struct bladerf *dev, bladerf_module module,
+                            const struct si5338_ms_regs *regs);
+
+/**
+ * Discard the host's record of the values programmed to the multisynths used
+ * for the sample clocks. This must be called when these registers may have
+ * been changed without the use of the above functions.
+ *
+ * @param[in]   dev     Device handle
+ */
+void si5338_shadow_invalidate(struct bladerf *dev);
+
+/**
+ * Perform a sequence of register accesses, in order, using the backend's batch
+ * support when it is available
+ *
+ * @param[in]       dev     Device handle
+ * @param[inout]    regs    Register accesses. The `data` field of each read
+ *                          access is updated upon success.
+ * @param[in]       count   Number of entries in `regs`
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int si5338_access_batch(struct bladerf *dev,
+                        struct backend_reg_access *regs, size_t count);
+
+/**
+ * Configure the clock generator as the source or recipient of a MIMO clock
+ *
+ * @param[in]   dev     Device handle
+ * @param[in]   mode    MIMO clock mode
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int si5338_set_mimo_mode(struct bladerf *dev, bladerf_mimo_mode mode);
+
+/**
+ * Enable or disable the outputs of the multisynths used for the RX and TX
+ * sample clocks. Their configuration is retained while disabled.
+ *
+ * @param[in]   dev     Device handle
+ * @param[in]   enable  Set to `true` to enable, `false` to disable
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int si5338_enable_sample_clocks(struct bladerf *dev, bool enable);
+
 #endif
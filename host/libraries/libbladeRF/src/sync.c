@@ -16,6 +16,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
  */
 #include <errno.h>
+#include <inttypes.h>
 
 /* Only switch on the verbose debug prints in this file when we *really* want
  * them. Otherwise, compile them out to avoid excessive log level checks
@@ -32,12 +33,94 @@
 #include "sync_worker.h"
 #include "minmax.h"
 #include "metadata.h"
+#include "dsp.h"
+#include "version_compat.h"
+#include "probes.h"
 #include "rel_assert.h"
 
+#if BLADERF_OS_LINUX
+#   include <sys/eventfd.h>
+#endif
+
+#if !BLADERF_OS_WINDOWS
+#   include <unistd.h>
+#   include <fcntl.h>
+#endif
+
+/* Default period to busy-wait for a buffer before blocking */
+#ifndef SYNC_SPIN_WAIT_US
+#   define SYNC_SPIN_WAIT_US 0
+#endif
+
+/* Period at which the worker's state is checked while busy-polling for a
+ * buffer, such that stream errors are noticed before the call times out */
+#ifndef SYNC_POLL_STATE_CHECK_US
+#   define SYNC_POLL_STATE_CHECK_US 1000
+#endif
+
+/* Time that sync_choose_config() keeps in flight, by default, to ride out
+ * scheduling delays on the host. Less throughput headroom is left at High
+ * Speed, so a stall there is more likely to result in an overrun. */
+#define SYNC_AUTO_MARGIN_SS_US      1000
+#define SYNC_AUTO_MARGIN_HS_US      2000
+
+/* Practical USB throughput, used to warn of sample rates that will not be
+ * sustained */
+#define SYNC_AUTO_SS_BYTES_PER_SEC  320000000u
+#define SYNC_AUTO_HS_BYTES_PER_SEC  35000000u
+
+#define SYNC_AUTO_MIN_XFERS         4
+#define SYNC_AUTO_MAX_XFERS         32
+#define SYNC_AUTO_MAX_BUFFER        65536   /* Samples */
+#define SYNC_AUTO_MIN_TIMEOUT_MS    1000
+
 static inline size_t samples2bytes(struct bladerf_sync *s, size_t n) {
     return s->stream_config.bytes_per_sample * n;
 }
 
+static inline size_t user_samples2bytes(struct bladerf_sync *s, size_t n) {
+    return s->ops.user_bytes_per_sample * n;
+}
+
+/* Are the caller's samples converted on their way to or from the buffers?
+ * If so, samples cannot be lent out in place. */
+static inline bool converts_samples(struct bladerf_sync *s) {
+    return s->stream_config.host_format == BLADERF_FORMAT_SC16_Q11_PACKED ||
+           s->stream_config.host_format != s->stream_config.format;
+}
+
+/* Copy samples between a caller and a buffer, converting them as needed.
+ * One of these is selected by select_sync_ops() for the handle's format. */
+static void copy_samples_4(uint8_t *dest, const uint8_t *src, unsigned int n)
+{
+    memcpy(dest, src, 4 * (size_t) n);
+}
+
+static void copy_samples_2(uint8_t *dest, const uint8_t *src, unsigned int n)
+{
+    memcpy(dest, src, 2 * (size_t) n);
+}
+
+static void copy_unpack(uint8_t *dest, const uint8_t *src, unsigned int n)
+{
+    dsp_unpack_sc16_q11((int16_t *) dest, src, n);
+}
+
+static void copy_pack(uint8_t *dest, const uint8_t *src, unsigned int n)
+{
+    dsp_pack_sc16_q11(dest, (const int16_t *) src, n);
+}
+
+static void copy_to_cf32(uint8_t *dest, const uint8_t *src, unsigned int n)
+{
+    dsp_sc16_q11_to_cf32((float *) dest, (const int16_t *) src, n);
+}
+
+static void copy_from_cf32(uint8_t *dest, const uint8_t *src, unsigned int n)
+{
+    dsp_cf32_to_sc16_q11((int16_t *) dest, (const float *) src, n);
+}
+
 static inline unsigned int msg_per_buf(struct bladerf *dev,
                                        size_t buf_size, size_t bytes_per_sample) {
 
@@ -53,29 +136,225 @@ static inline unsigned int samples_per_msg(struct bladerf *dev, size_t bytes_per
     return (unsigned int) n;
 }
 
-int sync_init(struct bladerf *dev,
-              bladerf_module module,
-              bladerf_format format,
-              unsigned int num_buffers,
-              unsigned int buffer_size,
-              unsigned int num_transfers,
-              unsigned int stream_timeout)
 
+/* Query the statistics of the backend's event thread, which are 0 if the
+ * backend does not provide them */
+static void get_event_stats(struct bladerf *dev, uint64_t *polls,
+                            uint64_t *cpu_us)
 {
-    struct bladerf_sync *sync;
-    int status = 0;
-    size_t i, bytes_per_sample;
+    *polls = 0;
+    *cpu_us = 0;
+
+    if (dev->fn->get_event_stats != NULL) {
+        dev->fn->get_event_stats(dev, polls, cpu_us);
+    }
+}
+
+/* Read the FPGA's TX FIFO underflow count. Returns false if the backend or
+ * FPGA does not provide it. */
+static bool get_fpga_underflows(struct bladerf *dev, uint32_t *count)
+{
+    int status;
+
+    if (dev->fn->get_tx_underflows == NULL ||
+        version_less_than(&dev->fpga_version, 0, 1, 21)) {
+        return false;
+    }
+
+    CTRL_LOCK(dev, CTRL_LOCK_GPIO);
+    status = dev->fn->get_tx_underflows(dev, count);
+    CTRL_UNLOCK(dev, CTRL_LOCK_GPIO);
+
+    if (status != 0) {
+        log_debug("Failed to read TX underflow count: %s\n",
+                  bladerf_strerror(status));
+    }
+
+    return status == 0;
+}
+
+/* Create the readiness descriptor. It is initially signalled, so that an
+ * event loop makes a first non-blocking call to learn the actual state. */
+static int ready_fd_create(struct buffer_mgmt *b)
+{
+#if BLADERF_OS_LINUX
+    b->ready_fd[0] = b->ready_fd[1] = eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (b->ready_fd[0] < 0) {
+        log_debug("Failed to create eventfd: %s\n", strerror(errno));
+        return BLADERF_ERR_IO;
+    }
+
+    return 0;
+#elif BLADERF_OS_WINDOWS
+    return BLADERF_ERR_UNSUPPORTED;
+#else
+    const char c = 0;
+    int i;
+
+    if (pipe(b->ready_fd) != 0) {
+        log_debug("Failed to create pipe: %s\n", strerror(errno));
+        b->ready_fd[0] = b->ready_fd[1] = -1;
+        return BLADERF_ERR_IO;
+    }
+
+    for (i = 0; i < 2; i++) {
+        fcntl(b->ready_fd[i], F_SETFL,
+              fcntl(b->ready_fd[i], F_GETFL) | O_NONBLOCK);
+        fcntl(b->ready_fd[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    if (write(b->ready_fd[1], &c, 1) != 1) {
+        log_debug("Failed to signal pipe: %s\n", strerror(errno));
+    }
+
+    return 0;
+#endif
+}
+
+static void ready_fd_close(struct buffer_mgmt *b)
+{
+#if !BLADERF_OS_WINDOWS
+    if (b->ready_fd[0] >= 0) {
+        close(b->ready_fd[0]);
+
+        if (b->ready_fd[1] != b->ready_fd[0]) {
+            close(b->ready_fd[1]);
+        }
+    }
+#endif
+
+    b->ready_fd[0] = b->ready_fd[1] = -1;
+}
+
+/* Clear any pending signal on the readiness descriptor */
+static void ready_fd_drain(struct buffer_mgmt *b)
+{
+#if BLADERF_OS_LINUX
+    uint64_t count;
+
+    if (read(b->ready_fd[0], &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        log_debug("Failed to read eventfd: %s\n", strerror(errno));
+    }
+#elif !BLADERF_OS_WINDOWS
+    char c[64];
+
+    while (read(b->ready_fd[0], c, sizeof(c)) > 0);
+#endif
+}
+
+void sync_signal_ready_fd(struct buffer_mgmt *b)
+{
+    if (ATOMIC_LOAD_ACQUIRE(&b->fd_armed)) {
+        ATOMIC_STORE_RELEASE(&b->fd_armed, 0);
+
+#if BLADERF_OS_LINUX
+        {
+            const uint64_t one = 1;
+            if (write(b->ready_fd[1], &one, sizeof(one)) < 0) {
+                log_debug("Failed to signal eventfd: %s\n", strerror(errno));
+            }
+        }
+#elif !BLADERF_OS_WINDOWS
+        {
+            const char c = 0;
+            if (write(b->ready_fd[1], &c, 1) < 0 && errno != EAGAIN) {
+                log_debug("Failed to signal pipe: %s\n", strerror(errno));
+            }
+        }
+#endif
+    }
+}
+
+static int rx_loop(struct bladerf_sync *s, const struct bladerf_rx_iov *iov,
+                   unsigned int iov_count,
+                   struct bladerf_metadata *user_meta,
+                   unsigned int timeout_ms, unsigned int *num_returned);
+
+static int rx_loop_meta(struct bladerf_sync *s,
+                        const struct bladerf_rx_iov *iov,
+                        unsigned int iov_count,
+                        struct bladerf_metadata *metadata,
+                        unsigned int timeout_ms, unsigned int *num_returned);
+
+static int tx_write_loop(struct bladerf_sync *s, const uint8_t *samples_src,
+                         unsigned int num_samples, bool flush,
+                         unsigned int timeout_ms, unsigned int *num_written);
+
+static int tx_write_loop_meta(struct bladerf_sync *s,
+                              const uint8_t *samples_src,
+                              unsigned int num_samples, bool flush,
+                              unsigned int timeout_ms,
+                              unsigned int *num_written);
+
+/* Select the hot loops and sample copy for the handle's module and format */
+static void select_sync_ops(struct bladerf_sync *s)
+{
+    const struct stream_config *c = &s->stream_config;
+    const bool rx = c->module == BLADERF_MODULE_RX;
+
+    if (format_has_metadata(c->format)) {
+        s->ops.rx = rx_loop_meta;
+        s->ops.tx_write = tx_write_loop_meta;
+    } else {
+        s->ops.rx = rx_loop;
+        s->ops.tx_write = tx_write_loop;
+    }
+
+    switch (c->host_format) {
+        case BLADERF_FORMAT_SC16_Q11_PACKED:
+            s->ops.copy = rx ? copy_unpack : copy_pack;
+            s->ops.user_bytes_per_sample = sc16q11_to_bytes(1);
+            break;
+
+        case BLADERF_FORMAT_CF32:
+        case BLADERF_FORMAT_CF32_META:
+            s->ops.copy = rx ? copy_to_cf32 : copy_from_cf32;
+            s->ops.user_bytes_per_sample = 2 * sc16q11_to_bytes(1);
+            break;
+
+        default:
+            s->ops.copy = c->bytes_per_sample == 2 ? copy_samples_2
+                                                   : copy_samples_4;
+            s->ops.user_bytes_per_sample = c->bytes_per_sample;
+            break;
+    }
+}
+
+/* Validate a sync configuration, and determine its wire format's sample
+ * size */
+static int check_config(bladerf_module module, bladerf_format format,
+                        unsigned int num_buffers, unsigned int buffer_size,
+                        unsigned int num_transfers, size_t *bytes_per_sample_out)
+{
+    size_t bytes_per_sample;
+
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        log_debug("Invalid bladerf_module value encountered: %d", module);
+        return BLADERF_ERR_INVAL;
+    }
 
     if (num_transfers >= num_buffers) {
         return BLADERF_ERR_INVAL;
     }
 
-    switch (format) {
+    /* Float samples are carried as SC16 Q11 and converted by sync calls */
+    switch (format_wire(format)) {
         case BLADERF_FORMAT_SC16_Q11:
         case BLADERF_FORMAT_SC16_Q11_META:
+        case BLADERF_FORMAT_PSD_U32:
+        case BLADERF_FORMAT_TX_SYMBOLS:
             bytes_per_sample = 4;
             break;
 
+        case BLADERF_FORMAT_SC16_Q11_PACKED:
+            bytes_per_sample = 3;
+            break;
+
+        case BLADERF_FORMAT_SC8_Q7:
+        case BLADERF_FORMAT_SC8_Q7_META:
+            bytes_per_sample = 2;
+            break;
+
         default:
             log_debug("Invalid format value: %d\n", format);
             return BLADERF_ERR_INVAL;
@@ -86,41 +365,60 @@ int sync_init(struct bladerf *dev,
         return BLADERF_ERR_INVAL;
     }
 
-    /* Deallocate any existing sync handle for this module */
-    switch (module) {
-        case BLADERF_MODULE_TX:
-        case BLADERF_MODULE_RX:
-            sync_deinit(dev->sync[module]);
-            sync = dev->sync[module] =
-                (struct bladerf_sync *) calloc(1, sizeof(struct bladerf_sync));
-
-            if (dev->sync[module] == NULL) {
-                status = BLADERF_ERR_MEM;
-            }
-            break;
+    *bytes_per_sample_out = bytes_per_sample;
+    return 0;
+}
 
-        default:
-            log_debug("Invalid bladerf_module value encountered: %d", module);
-            status = BLADERF_ERR_INVAL;
-    }
+/* Allocate and initialize a sync handle, without installing it in `dev` */
+static int sync_create(struct bladerf *dev,
+                       bladerf_module module,
+                       bladerf_format host_format,
+                       unsigned int num_buffers,
+                       unsigned int buffer_size,
+                       unsigned int num_transfers,
+                       unsigned int stream_timeout,
+                       struct bladerf_sync **sync_out)
+{
+    struct bladerf_sync *sync;
+    int status;
+    size_t bytes_per_sample;
+    const bladerf_format format = format_wire(host_format);
 
+    status = check_config(module, host_format, num_buffers, buffer_size,
+                          num_transfers, &bytes_per_sample);
     if (status != 0) {
         return status;
     }
 
+    sync = (struct bladerf_sync *) calloc(1, sizeof(struct bladerf_sync));
+    if (sync == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
     sync->dev = dev;
     sync->state = SYNC_STATE_CHECK_WORKER;
 
     sync->buf_mgmt.num_buffers = num_buffers;
-    sync->buf_mgmt.resubmit_count = 0;
+    sync->buf_mgmt.resubmitting = false;
+    sync->buf_mgmt.ready_fd[0] = sync->buf_mgmt.ready_fd[1] = -1;
+
+    sync->stats.fill_min = num_buffers;
 
     sync->stream_config.module = module;
     sync->stream_config.format = format;
+    sync->stream_config.host_format = host_format;
     sync->stream_config.samples_per_buffer = buffer_size;
     sync->stream_config.num_xfers = num_transfers;
     sync->stream_config.timeout_ms = stream_timeout;
+    sync->stream_config.spin_wait_us = SYNC_SPIN_WAIT_US;
+    sync->stream_config.busy_poll = dev->stream_thread_config[module].busy_poll;
     sync->stream_config.bytes_per_sample = bytes_per_sample;
 
+    select_sync_ops(sync);
+
+    get_event_stats(dev, &sync->stats.event_polls_base,
+                    &sync->stats.event_cpu_us_base);
+
     sync->meta.state = SYNC_META_STATE_HEADER;
     sync->meta.msg_per_buf = msg_per_buf(dev, buffer_size, bytes_per_sample);
     sync->meta.samples_per_msg = samples_per_msg(dev, bytes_per_sample);
@@ -137,57 +435,140 @@ int sync_init(struct bladerf *dev,
     MUTEX_INIT(&sync->buf_mgmt.lock);
     pthread_cond_init(&sync->buf_mgmt.buf_ready, NULL);
 
-    sync->buf_mgmt.status = (sync_buffer_status*) malloc(num_buffers * sizeof(sync_buffer_status));
-    if (sync->buf_mgmt.status == NULL) {
-        status = BLADERF_ERR_MEM;
-    } else {
-        switch (module) {
-            case BLADERF_MODULE_RX:
-                /* When starting up an RX stream, the first 'num_transfers'
-                 * transfers will be submitted to the USB layer to grab data */
-                sync->buf_mgmt.prod_i = num_transfers;
-                sync->buf_mgmt.cons_i = 0;
-                sync->buf_mgmt.partial_off = 0;
-
-                for (i = 0; i < num_buffers; i++) {
-                    if (i < num_transfers) {
-                        sync->buf_mgmt.status[i] = SYNC_BUFFER_IN_FLIGHT;
-                    } else {
-                        sync->buf_mgmt.status[i] = SYNC_BUFFER_EMPTY;
-                    }
-                }
-
-                sync->meta.msg_timestamp = 0;
-                sync->meta.msg_flags = 0;
+    switch (module) {
+        case BLADERF_MODULE_RX:
+            /* When starting up an RX stream, the first 'num_transfers'
+             * transfers will be submitted to the USB layer to grab data */
+            sync->buf_mgmt.submitted = num_transfers;
+            sync->buf_mgmt.submitted_idx = num_transfers;
+            sync->buf_mgmt.completed = 0;
+            sync->buf_mgmt.completed_idx = 0;
+            sync->buf_mgmt.consumed = 0;
+            sync->buf_mgmt.consumed_idx = 0;
+            sync->buf_mgmt.partial_off = 0;
+
+            sync->meta.msg_timestamp = 0;
+            sync->meta.msg_flags = 0;
+
+            /* Earlier FPGAs leave arbitrary values in RX header flags */
+            sync->meta.overflow_flags =
+                format_has_metadata(format) &&
+                !version_less_than(&dev->fpga_version, 0, 1, 19);
 
-                break;
+            break;
 
-            case BLADERF_MODULE_TX:
-                sync->buf_mgmt.prod_i = 0;
-                sync->buf_mgmt.cons_i = 0;
-                sync->buf_mgmt.partial_off = 0;
+        case BLADERF_MODULE_TX:
+            sync->buf_mgmt.submitted = 0;
+            sync->buf_mgmt.submitted_idx = 0;
+            sync->buf_mgmt.completed = 0;
+            sync->buf_mgmt.completed_idx = 0;
+            sync->buf_mgmt.consumed = 0;
+            sync->buf_mgmt.consumed_idx = 0;
+            sync->buf_mgmt.partial_off = 0;
+
+            sync->meta.in_burst = false;
+            sync->meta.now = false;
+            sync->meta.gated = format_has_metadata(format) &&
+                !version_less_than(&dev->fpga_version, 0, 1, 13);
+            sync->meta.late_policy = format_has_metadata(format) &&
+                !version_less_than(&dev->fpga_version, 0, 1, 20);
+            sync->meta.drop_late = false;
+            sync->meta.burst_ended = false;
+
+            sync->stats.fpga_underflows_valid =
+                get_fpga_underflows(dev, &sync->stats.fpga_underflows_base);
+
+            sync->buf_mgmt.after_burst =
+                (bool *) calloc(num_buffers, sizeof(bool));
+
+            if (sync->buf_mgmt.after_burst == NULL) {
+                free(sync);
+                return BLADERF_ERR_MEM;
+            }
 
-                for (i = 0; i < num_buffers; i++) {
-                    sync->buf_mgmt.status[i] = SYNC_BUFFER_EMPTY;
-                }
+            break;
 
-                sync->meta.in_burst = false;
-                sync->meta.now = false;
+        default:
+            break;
+    }
 
-                break;
-        }
+    status = sync_worker_init(sync);
 
-        status = sync_worker_init(sync);
+    /* The worker is not left behind on failure, so there is no stream to
+     * shut down */
+    if (status != 0) {
+        free(sync->buf_mgmt.after_burst);
+        free(sync);
+        return status;
     }
 
+    *sync_out = sync;
+    return 0;
+}
+
+int sync_init(struct bladerf *dev,
+              bladerf_module module,
+              bladerf_format format,
+              unsigned int num_buffers,
+              unsigned int buffer_size,
+              unsigned int num_transfers,
+              unsigned int stream_timeout)
+
+{
+    struct bladerf_sync *sync = NULL;
+    int status;
+    size_t bytes_per_sample;
+
+    status = check_config(module, format, num_buffers, buffer_size,
+                          num_transfers, &bytes_per_sample);
     if (status != 0) {
-        sync_deinit(dev->sync[module]);
-        dev->sync[module] = NULL;
+        return status;
+    }
+
+    /* Deallocate any existing sync handle for this module first, so that
+     * its buffers are released before allocating new ones */
+    MUTEX_LOCK(&dev->sync_handle_lock[module]);
+    sync_deinit(dev->sync[module]);
+    dev->sync[module] = NULL;
+    MUTEX_UNLOCK(&dev->sync_handle_lock[module]);
+
+    status = sync_create(dev, module, format, num_buffers, buffer_size,
+                         num_transfers, stream_timeout, &sync);
+
+    if (status == 0) {
+        MUTEX_LOCK(&dev->sync_handle_lock[module]);
+        dev->sync[module] = sync;
+        MUTEX_UNLOCK(&dev->sync_handle_lock[module]);
     }
 
     return status;
 }
 
+void sync_shutdown(struct bladerf_sync *sync)
+{
+    struct buffer_mgmt *b;
+
+    if (sync == NULL) {
+        return;
+    }
+
+    b = &sync->buf_mgmt;
+
+    ATOMIC_STORE_RELEASE(&b->shutdown, 1);
+    sync_worker_submit_request(sync->worker, SYNC_WORKER_STOP);
+
+    /* A waiter checks the flag with the lock held before blocking, so it
+     * either sees the flag or is woken here */
+    MUTEX_LOCK(&b->lock);
+    pthread_cond_broadcast(&b->buf_ready);
+    MUTEX_UNLOCK(&b->lock);
+
+    if (b->ready_fd[0] >= 0) {
+        ATOMIC_STORE_RELEASE(&b->fd_armed, 1);
+        sync_signal_ready_fd(b);
+    }
+}
+
 void sync_deinit(struct bladerf_sync *sync)
 {
     if (sync != NULL) {
@@ -200,758 +581,3047 @@ void sync_deinit(struct bladerf_sync *sync)
         sync_worker_deinit(sync->worker, &sync->buf_mgmt.lock,
                            &sync->buf_mgmt.buf_ready);
 
-         /* De-allocate our buffer management resources */
-        free(sync->buf_mgmt.status);
+        ready_fd_close(&sync->buf_mgmt);
+        free(sync->buf_mgmt.after_burst);
         free(sync);
     }
 }
 
-static int wait_for_buffer(struct buffer_mgmt *b, unsigned int timeout_ms,
-                           const char *dbg_name, unsigned int dbg_idx)
+static inline uint64_t sync_auto_us(uint64_t samples, unsigned int rate)
 {
-    int status;
-    struct timespec timeout;
-
-    if (timeout_ms == 0) {
-        log_verbose("%s: Infinite wait for [%d] to fill.\n", dbg_name, dbg_idx);
-        status = pthread_cond_wait(&b->buf_ready, &b->lock);
-    } else {
-        log_verbose("%s: Timed wait for [%d] to fill.\n", dbg_name, dbg_idx);
-        status = populate_abs_timeout(&timeout, timeout_ms);
-        if (status == 0) {
-            status = pthread_cond_timedwait(&b->buf_ready, &b->lock, &timeout);
-        }
-    }
-
-    if (status == ETIMEDOUT) {
-        status = BLADERF_ERR_TIMEOUT;
-    } else if (status != 0) {
-        status = BLADERF_ERR_UNEXPECTED;
-    }
-
-    return status;
+    return (samples * 1000000 + rate - 1) / rate;
 }
 
-#ifndef SYNC_WORKER_START_TIMEOUT_MS
-#   define SYNC_WORKER_START_TIMEOUT_MS 250
-#endif
-
-/* Returns # of samples left in a message (SC16Q11 mode only) */
-static inline unsigned int left_in_msg(struct bladerf_sync *s)
+/* Largest buffer, in whole DMA granules, holding no more than `us` of
+ * samples */
+static inline uint64_t sync_auto_buffer(uint64_t us, unsigned int rate,
+                                        unsigned int granule)
 {
-    size_t ret = s->meta.samples_per_msg - s->meta.curr_msg_off;
-    assert(ret <= UINT_MAX);
+    uint64_t size = us * rate / 1000000;
 
-    return (unsigned int) ret;
+    size = u64_min(size, SYNC_AUTO_MAX_BUFFER);
+    return size - (size % granule);
 }
 
-static inline void advance_rx_buffer(struct buffer_mgmt *b)
+int sync_choose_config(bladerf_module module, bladerf_format format,
+                       bladerf_dev_speed speed, unsigned int sample_rate,
+                       unsigned int latency_us,
+                       const struct bladerf_bandwidth_probe_results *probe,
+                       struct bladerf_sync_auto_config *config)
 {
-    log_verbose("%s: Marking buf[%u] empty.\n", __FUNCTION__, b->cons_i);
+    unsigned int bytes_per_sample, granule, n;
+    uint64_t margin_us, capacity, size = 0, buffer_us;
+    unsigned int xfers = 0;
 
-    b->status[b->cons_i] = SYNC_BUFFER_EMPTY;
-    b->cons_i = (b->cons_i + 1) % b->num_buffers;
-}
+    if ((module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) ||
+        sample_rate == 0 || latency_us == 0) {
+        return BLADERF_ERR_INVAL;
+    }
 
-static inline unsigned int timestamp_to_msg(struct bladerf_sync *s, uint64_t t)
-{
-    uint64_t m =  t / s->meta.samples_per_msg;
-    assert(m <= UINT_MAX);
-    return (unsigned int) m;
-}
+    switch (format_wire(format)) {
+        case BLADERF_FORMAT_SC16_Q11:
+        case BLADERF_FORMAT_SC16_Q11_META:
+        case BLADERF_FORMAT_PSD_U32:
+        case BLADERF_FORMAT_TX_SYMBOLS:
+            bytes_per_sample = 4;
+            break;
 
-int sync_rx(struct bladerf *dev, void *samples, unsigned num_samples,
-            struct bladerf_metadata *user_meta, unsigned int timeout_ms)
-{
-    struct bladerf_sync *s = dev->sync[BLADERF_MODULE_RX];
-    struct buffer_mgmt *b;
+        case BLADERF_FORMAT_SC16_Q11_PACKED:
+            bytes_per_sample = 3;
+            break;
 
-    int status = 0;
-    bool exit_early = false;
-    bool copied_data = false;
-    unsigned int samples_returned = 0;
-    uint8_t *samples_dest = (uint8_t*)samples;
-    uint8_t *buf_src = NULL;
-    unsigned int samples_to_copy = 0;
-    unsigned int samples_per_buffer = 0;
-    uint64_t target_timestamp = UINT64_MAX;
+        case BLADERF_FORMAT_SC8_Q7:
+        case BLADERF_FORMAT_SC8_Q7_META:
+            bytes_per_sample = 2;
+            break;
 
-    if (s == NULL || samples == NULL) {
-        log_debug("NULL pointer passed to %s\n", __FUNCTION__);
-        return BLADERF_ERR_INVAL;
-    } else if (s->stream_config.format == BLADERF_FORMAT_SC16_Q11_META) {
-        if (user_meta == NULL) {
-            log_debug("NULL metadata pointer passed to %s\n", __FUNCTION__);
+        default:
+            log_debug("Invalid format value: %d\n", format);
             return BLADERF_ERR_INVAL;
-        } else {
-            user_meta->status = 0;
-            target_timestamp = user_meta->timestamp;
-        }
     }
 
-    b = &s->buf_mgmt;
-    samples_per_buffer = s->stream_config.samples_per_buffer;
+    /* Buffers must be a multiple of 4 KiB (see sync_init()) */
+    granule = 4096 / (bytes_per_sample & (~bytes_per_sample + 1));
 
-    log_verbose("%s: Requests %u samples.\n", __FUNCTION__, num_samples);
+    if (speed == BLADERF_DEVICE_SPEED_SUPER) {
+        margin_us = SYNC_AUTO_MARGIN_SS_US;
+        capacity = SYNC_AUTO_SS_BYTES_PER_SEC / bytes_per_sample;
+    } else {
+        margin_us = SYNC_AUTO_MARGIN_HS_US;
+        capacity = SYNC_AUTO_HS_BYTES_PER_SEC / bytes_per_sample;
+    }
 
-    while (!exit_early && samples_returned < num_samples && status == 0) {
+    if (probe != NULL && probe->samples_per_sec != 0) {
+        capacity = probe->samples_per_sec;
 
-        switch (s->state) {
-            case SYNC_STATE_CHECK_WORKER: {
-                int stream_error;
-                sync_worker_state worker_state =
-                    sync_worker_get_state(s->worker, &stream_error);
-
-                /* Propagate stream error back to the caller.
-                 * They can call this function again to restart the stream and
-                 * try again.
-                 */
-                if (stream_error != 0) {
-                    status = stream_error;
-                } else {
-                    if (worker_state == SYNC_WORKER_STATE_IDLE) {
-                        log_debug("%s: Worker is idle. Going to reset buf "
-                                  "mgmt.\n", __FUNCTION__);
-                        s->state = SYNC_STATE_RESET_BUF_MGMT;
-                    } else if (worker_state == SYNC_WORKER_STATE_RUNNING) {
-                        s->state = SYNC_STATE_WAIT_FOR_BUFFER;
-                    } else {
-                        status = BLADERF_ERR_UNEXPECTED;
-                        log_debug("%s: Unexpected worker state=%d\n",
-                                __FUNCTION__, worker_state);
-                    }
-                }
+        if (probe->markers != 0 &&
+            probe->latency_max_us - probe->latency_min_us > margin_us) {
+            margin_us = probe->latency_max_us - probe->latency_min_us;
+        }
+    }
 
+    if (sample_rate > capacity) {
+        log_warning("%u samples/s exceeds the %"PRIu64" samples/s expected "
+                    "to be sustained.\n", sample_rate, capacity);
+    }
+
+    if (module == BLADERF_MODULE_RX) {
+        /* In-flight RX transfers are empty, so a sample is delayed only by
+         * the buffer it lands in, and one completed buffer awaiting a read */
+        size = sync_auto_buffer(latency_us / 2, sample_rate, granule);
+        if (size == 0) {
+            size = granule;
+        }
+
+        buffer_us = sync_auto_us(size, sample_rate);
+        xfers = (unsigned int) ((margin_us + buffer_us - 1) / buffer_us);
+        xfers = uint_max(xfers, SYNC_AUTO_MIN_XFERS);
+        xfers = uint_min(xfers, SYNC_AUTO_MAX_XFERS);
+
+        /* Buffers beyond those in flight absorb stalls in the caller's reads
+         * without adding latency while it keeps up */
+        config->num_buffers = 2 * xfers;
+        config->latency_us = (unsigned int) (2 * buffer_us);
+    } else {
+        uint64_t best_margin = 0, best_size = 0;
+        unsigned int best_xfers = 0;
+
+        /* Every buffer queued for TX delays the samples that follow it, and
+         * one buffer beyond those in flight is filled by the caller. Fewer
+         * transfers allow larger buffers within the budget, so use the
+         * fewest that keep the margin in flight. */
+        for (n = SYNC_AUTO_MIN_XFERS; n <= SYNC_AUTO_MAX_XFERS; n++) {
+            const uint64_t n_size = sync_auto_buffer(latency_us / (n + 1),
+                                                     sample_rate, granule);
+            const uint64_t n_margin = n * sync_auto_us(n_size, sample_rate);
+
+            if (n_size == 0) {
                 break;
+            } else if (n_margin >= margin_us) {
+                size = n_size;
+                xfers = n;
+                break;
+            } else if (n_margin > best_margin) {
+                best_margin = n_margin;
+                best_size = n_size;
+                best_xfers = n;
             }
+        }
 
-            case SYNC_STATE_RESET_BUF_MGMT:
-                MUTEX_LOCK(&b->lock);
-                /* When the RX stream starts up, it will submit the first T
-                 * transfers, so the consumer index must be reset to 0 */
-                b->cons_i = 0;
-                MUTEX_UNLOCK(&b->lock);
-                log_debug("%s: Reset buf_mgmt consumer index\n", __FUNCTION__);
-                s->state = SYNC_STATE_START_WORKER;
-                break;
+        if (xfers == 0 && best_xfers != 0) {
+            size = best_size;
+            xfers = best_xfers;
+        } else if (xfers == 0) {
+            /* Even the smallest buffers exceed the budget, so come as close
+             * to it as a pair of transfers allows */
+            size = granule;
+            buffer_us = sync_auto_us(size, sample_rate);
+            xfers = (unsigned int) (latency_us / buffer_us);
+            xfers = uint_max(xfers > 0 ? xfers - 1 : 0, 2);
+            xfers = uint_min(xfers, SYNC_AUTO_MIN_XFERS);
+        }
 
+        buffer_us = sync_auto_us(size, sample_rate);
+        config->num_buffers = xfers + 1;
+        config->latency_us = (unsigned int) ((xfers + 1) * buffer_us);
+    }
 
-            case SYNC_STATE_START_WORKER:
-                sync_worker_submit_request(s->worker, SYNC_WORKER_START);
+    config->buffer_size = (unsigned int) size;
+    config->num_transfers = xfers;
+    config->margin_us = (unsigned int) (xfers * buffer_us);
+    config->stream_timeout =
+        uint_max(SYNC_AUTO_MIN_TIMEOUT_MS,
+                 (unsigned int) (4 * config->num_buffers * buffer_us / 1000));
+
+    if (config->latency_us > latency_us) {
+        log_warning("%s buffering of %u us exceeds the requested %u us.\n",
+                    module == BLADERF_MODULE_RX ? "RX" : "TX",
+                    config->latency_us, latency_us);
+    } else if (config->margin_us < margin_us) {
+        log_warning("Only %u us of %s samples can be kept in flight, where "
+                    "%"PRIu64" us is recommended. Overruns may occur.\n",
+                    config->margin_us,
+                    module == BLADERF_MODULE_RX ? "RX" : "TX", margin_us);
+    }
 
-                status = sync_worker_wait_for_state(
-                                                s->worker,
-                                                SYNC_WORKER_STATE_RUNNING,
-                                                SYNC_WORKER_START_TIMEOUT_MS);
+    return 0;
+}
 
-                if (status == 0) {
-                    s->state = SYNC_STATE_WAIT_FOR_BUFFER;
-                    log_debug("%s: Worker is now running.\n", __FUNCTION__);
-                } else {
-                    log_debug("%s: Failed to start worker, (%d)\n",
-                              __FUNCTION__, status);
-                }
-                break;
+int sync_resize(struct bladerf *dev, bladerf_module module,
+                unsigned int num_buffers, unsigned int buffer_size,
+                unsigned int num_transfers)
+{
+    int status;
+    struct bladerf_sync *s = NULL;
+    struct bladerf_sync *prev;
 
-            case SYNC_STATE_WAIT_FOR_BUFFER:
-                MUTEX_LOCK(&b->lock);
-
-                /* Check the buffer state, as the worker may have produced one
-                 * since we last queried the status */
-                if (b->status[b->cons_i] == SYNC_BUFFER_FULL) {
-                    s->state = SYNC_STATE_BUFFER_READY;
-                    log_verbose("%s: buffer %u is ready to consume\n",
-                                __FUNCTION__, b->cons_i);
-                } else {
-                    status = wait_for_buffer(b, timeout_ms,
-                                             __FUNCTION__, b->cons_i);
+    if (module != BLADERF_MODULE_RX && module != BLADERF_MODULE_TX) {
+        log_debug("Invalid bladerf_module value encountered: %d", module);
+        return BLADERF_ERR_INVAL;
+    }
 
-                    if (status == 0) {
-                        if (b->status[b->cons_i] != SYNC_BUFFER_FULL) {
-                            s->state = SYNC_STATE_CHECK_WORKER;
-                        } else {
-                            s->state = SYNC_STATE_BUFFER_READY;
-                            log_verbose("%s: buffer %u is ready to consume\n",
-                                        __FUNCTION__, b->cons_i);
-                        }
-                    }
-                }
+    prev = dev->sync[module];
+    if (prev == NULL) {
+        log_debug("%s: Sync interface has not been configured\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
 
-                MUTEX_UNLOCK(&b->lock);
-                break;
+    if (prev->loan.samples != NULL) {
+        log_debug("%s: Samples are still lent out to the caller\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
 
-            case SYNC_STATE_BUFFER_READY:
-                MUTEX_LOCK(&b->lock);
-                b->status[b->cons_i] = SYNC_BUFFER_PARTIAL;
-                b->partial_off = 0;
-                MUTEX_UNLOCK(&b->lock);
-
-                switch (s->stream_config.format) {
-                    case BLADERF_FORMAT_SC16_Q11:
-                        s->state = SYNC_STATE_USING_BUFFER;
-                        break;
+    log_debug("%s: Resizing %s pool to %u buffers of %u samples, "
+              "%u transfers\n", __FUNCTION__, module2str(module),
+              num_buffers, buffer_size, num_transfers);
 
-                    case BLADERF_FORMAT_SC16_Q11_META:
-                        s->state = SYNC_STATE_USING_BUFFER_META;
-                        s->meta.curr_msg_off = 0;
-                        s->meta.msg_num = 0;
-                        break;
+    /* The new handle is built alongside the current one, which remains in
+     * use should this fail */
+    status = sync_create(dev, module, prev->stream_config.host_format,
+                         num_buffers, buffer_size, num_transfers,
+                         prev->stream_config.timeout_ms, &s);
 
-                    default:
-                        assert(!"Invalid stream format");
-                        status = BLADERF_ERR_UNEXPECTED;
-                }
-                break;
+    if (status != 0) {
+        return status;
+    }
 
-            case SYNC_STATE_USING_BUFFER: /* SC16Q11 buffers w/o metadata */
-                MUTEX_LOCK(&b->lock);
+    /* Only the configuration and bookkeeping that outlive the buffer pool
+     * are carried over */
+    s->stream_config.spin_wait_us = prev->stream_config.spin_wait_us;
+
+    /* The readiness descriptor is handed over to the new handle, as event
+     * loops may have registered it */
+    s->buf_mgmt.ready_fd[0] = prev->buf_mgmt.ready_fd[0];
+    s->buf_mgmt.ready_fd[1] = prev->buf_mgmt.ready_fd[1];
+    prev->buf_mgmt.ready_fd[0] = prev->buf_mgmt.ready_fd[1] = -1;
+
+    s->stats.overruns = prev->stats.overruns;
+    s->stats.resubmissions = prev->stats.resubmissions;
+    s->stats.underruns = prev->stats.underruns;
+    s->stats.overruns_reported = prev->stats.overruns_reported;
+    s->stats.underruns_reported = prev->stats.underruns_reported;
+    s->stats.discontinuities = prev->stats.discontinuities;
+    s->stats.dropped_samples = prev->stats.dropped_samples;
+    s->stats.fpga_overflows = prev->stats.fpga_overflows;
+    s->stats.fpga_dropped_samples = prev->stats.fpga_dropped_samples;
+    s->stats.spin_waits = prev->stats.spin_waits;
+    s->stats.blocking_waits = prev->stats.blocking_waits;
+    memcpy(s->stats.wait_hist, prev->stats.wait_hist,
+           sizeof(s->stats.wait_hist));
+    s->stats.event_polls_base = prev->stats.event_polls_base;
+    s->stats.event_cpu_us_base = prev->stats.event_cpu_us_base;
+    s->stats.fpga_underflows_valid = prev->stats.fpga_underflows_valid;
+    s->stats.fpga_underflows_base = prev->stats.fpga_underflows_base;
+
+    s->autotune.enabled = prev->autotune.enabled;
+    s->autotune.latency_budget_us = prev->autotune.latency_budget_us;
+    s->autotune.min_xfers = uint_min(prev->autotune.min_xfers, num_transfers);
+
+    /* The expected timestamp is only retained below, if our place in the
+     * stream is kept. Otherwise, it is re-established when restarting. */
+    s->continuity = prev->continuity;
+    s->underrun = prev->underrun;
+    s->autoflush.enabled = prev->autoflush.enabled;
+    s->autoflush.deadline_us = prev->autoflush.deadline_us;
+
+    if (module == BLADERF_MODULE_RX && prev->meta.contiguous) {
+        /* Samples buffered in the old pool are discarded. By keeping our
+         * place in the stream, the next sync_rx() reports these as a
+         * discontinuity rather than silently resuming. */
+        s->meta.curr_timestamp = prev->meta.curr_timestamp;
+        s->meta.contiguous = true;
+        s->state = SYNC_STATE_START_WORKER;
+    }
 
-                buf_src = (uint8_t*)b->buffers[b->cons_i];
+    MUTEX_LOCK(&dev->sync_handle_lock[module]);
+    sync_deinit(prev);
+    dev->sync[module] = s;
+    MUTEX_UNLOCK(&dev->sync_handle_lock[module]);
 
-                samples_to_copy = uint_min(num_samples - samples_returned,
-                                           samples_per_buffer - b->partial_off);
+    return 0;
+}
 
-                memcpy(samples_dest + samples2bytes(s, samples_returned),
-                       buf_src + samples2bytes(s, b->partial_off),
-                       samples2bytes(s, samples_to_copy));
+/* Index of the buffer currently being emptied by sync_rx() */
+static inline unsigned int cons_idx(const struct buffer_mgmt *b)
+{
+    return b->consumed_idx;
+}
 
-                b->partial_off += samples_to_copy;
-                samples_returned += samples_to_copy;
+/* Index of the buffer currently being filled by sync_tx() */
+static inline unsigned int prod_idx(const struct buffer_mgmt *b)
+{
+    return b->submitted_idx;
+}
 
-                log_verbose("%s: Provided %u samples to caller\n",
-                            __FUNCTION__, samples_to_copy);
+/* Returns true once sync_shutdown() has been called on the handle */
+static inline bool sync_is_shutdown(struct bladerf_sync *s)
+{
+    return ATOMIC_LOAD_ACQUIRE(&s->buf_mgmt.shutdown) != 0;
+}
 
-                /* We've finished consuming this buffer and can start looking
-                 * for available samples in the next buffer */
-                if (b->partial_off >= samples_per_buffer) {
+/* Returns true if the worker has produced a buffer for us to empty (RX),
+ * or has returned a buffer for us to fill (TX). */
+static inline bool buffer_available(struct bladerf_sync *s)
+{
+    struct buffer_mgmt *b = &s->buf_mgmt;
+    const unsigned int completed = ATOMIC_LOAD_ACQUIRE(&b->completed);
 
-                    /* Check for symptom of out-of-bounds accesses */
-                    assert(b->partial_off == samples_per_buffer);
+    if (s->stream_config.module == BLADERF_MODULE_RX) {
+        return completed != b->consumed;
+    } else {
+        return (b->submitted - completed) < b->num_buffers;
+    }
+}
 
-                    advance_rx_buffer(b);
-                    s->state = SYNC_STATE_WAIT_FOR_BUFFER;
-                }
+/* Busy-wait for up to the configured spin period for a buffer, to avoid
+ * the cost of blocking and being woken when the worker is expected to
+ * produce (or free) a buffer shortly.
+ *
+ * Returns true if a buffer became available. */
+static bool spin_for_buffer(struct bladerf_sync *s)
+{
+    int status;
+    int64_t elapsed_us;
+    unsigned int i;
+    struct timespec start, now;
+    const unsigned int spin_us = s->stream_config.spin_wait_us;
 
-                MUTEX_UNLOCK(&b->lock);
-                break;
+    if (spin_us == 0) {
+        return false;
+    }
 
+    status = clock_gettime(CLOCK_REALTIME, &start);
+    if (status != 0) {
+        return false;
+    }
 
-            case SYNC_STATE_USING_BUFFER_META: /* SC16Q11 buffers w/ metadata */
-                MUTEX_LOCK(&b->lock);
+    do {
+        /* Amortize the cost of the clock query over a few checks */
+        for (i = 0; i < 64; i++) {
+            if (buffer_available(s)) {
+                return true;
+            }
+        }
 
-                switch (s->meta.state) {
-                    case SYNC_META_STATE_HEADER:
+        status = clock_gettime(CLOCK_REALTIME, &now);
+        if (status != 0) {
+            return false;
+        }
 
-                        assert(s->meta.msg_num < s->meta.msg_per_buf);
+        elapsed_us = (int64_t) (now.tv_sec - start.tv_sec) * 1000000 +
+                     (now.tv_nsec - start.tv_nsec) / 1000;
 
-                        buf_src = (uint8_t*)b->buffers[b->cons_i];
+    } while (elapsed_us < spin_us);
 
-                        s->meta.curr_msg =
-                            buf_src + dev->msg_size * s->meta.msg_num;
+    return buffer_available(s);
+}
 
-                        s->meta.msg_timestamp =
-                            metadata_get_timestamp(s->meta.curr_msg);
+/* Busy-wait for a buffer until one is available or timeout_ms elapses (0
+ * implies no timeout), in place of blocking. The worker's state is checked
+ * periodically, as it cannot wake us upon stream errors and shutdown.
+ *
+ * A return value of 0 does not guarantee that a buffer is available; the
+ * worker may have stopped running. */
+static int poll_for_buffer(struct bladerf_sync *s, unsigned int timeout_ms)
+{
+    unsigned int i;
+    uint64_t now_us, elapsed_us;
+    const uint64_t timeout_us = (uint64_t) timeout_ms * 1000;
+    const uint64_t start_us = async_stats_time_us();
+    uint64_t next_check_us = SYNC_POLL_STATE_CHECK_US;
+
+    while (true) {
+        /* Amortize the cost of the clock query over a few checks */
+        for (i = 0; i < 64; i++) {
+            if (buffer_available(s)) {
+                return 0;
+            }
+        }
 
-                        s->meta.msg_flags =
-                            metadata_get_flags(s->meta.curr_msg);
+        /* Guard against the realtime clock being stepped backwards */
+        now_us = async_stats_time_us();
+        elapsed_us = (now_us > start_us) ? (now_us - start_us) : 0;
 
-                        s->meta.curr_msg_off = 0;
+        if (timeout_us != 0 && elapsed_us >= timeout_us) {
+            return buffer_available(s) ? 0 : BLADERF_ERR_TIMEOUT;
+        }
 
-                        /* We've encountered a discontinuity and need to return
-                         * what we have so far, setting the status flags */
-                        if (copied_data &&
-                            s->meta.msg_timestamp != s->meta.curr_timestamp) {
+        if (elapsed_us >= next_check_us) {
+            next_check_us = elapsed_us + SYNC_POLL_STATE_CHECK_US;
 
-                            user_meta->status |= BLADERF_META_STATUS_OVERRUN;
-                            exit_early = true;
-                            log_debug("Sample discontinuity detected @ "
-                                      "buffer %u, message %u: Expected t=%llu, "
-                                      "got t=%llu\n",
-                                      b->cons_i, s->meta.msg_num,
-                                      (unsigned long long)s->meta.curr_timestamp,
-                                      (unsigned long long)s->meta.msg_timestamp);
+            if (sync_worker_get_state(s->worker, NULL) !=
+                    SYNC_WORKER_STATE_RUNNING || sync_is_shutdown(s)) {
+                return 0;
+            }
+        }
+    }
+}
 
-                        } else {
-                            log_verbose("Got header for message %u: "
-                                        "t_new=%u, t_old=%u\n",
-                                        s->meta.msg_num,
-                                        s->meta.msg_timestamp,
-                                        s->meta.curr_timestamp);
-                        }
+/* Block on the buf_ready condition until the worker signals it, or
+ * timeout_ms elapses (0 implies no timeout) */
+static int block_for_buffer(struct bladerf_sync *s, unsigned int timeout_ms,
+                            const char *dbg_name, unsigned int dbg_idx)
+{
+    int status = 0;
+    struct timespec timeout;
+    struct buffer_mgmt *b = &s->buf_mgmt;
 
-                        s->meta.curr_timestamp = s->meta.msg_timestamp;
-                        s->meta.state = SYNC_META_STATE_SAMPLES;
-                        break;
+    MUTEX_LOCK(&b->lock);
 
-                    case SYNC_META_STATE_SAMPLES:
-                        if (!copied_data &&
-                            (user_meta->flags & BLADERF_META_FLAG_RX_NOW) == 0 &&
-                            target_timestamp < s->meta.curr_timestamp) {
+    /* Announce that we're about to block, and then re-check. This pairs with
+     * notify_buffer_ready() in the worker, such that either we see its update
+     * or it sees our flag and signals buf_ready (which it may only do once
+     * we're waiting, as it must acquire the lock). */
+    ATOMIC_STORE_RELEASE(&b->waiting, 1);
+    ATOMIC_FENCE();
+
+    if (!buffer_available(s) && !ATOMIC_LOAD_ACQUIRE(&b->shutdown)) {
+        if (timeout_ms == 0) {
+            log_verbose("%s: Infinite wait for [%d] to fill.\n", dbg_name, dbg_idx);
+            status = pthread_cond_wait(&b->buf_ready, &b->lock);
+        } else {
+            log_verbose("%s: Timed wait for [%d] to fill.\n", dbg_name, dbg_idx);
+            status = populate_abs_timeout(&timeout, timeout_ms);
+            if (status == 0) {
+                status = pthread_cond_timedwait(&b->buf_ready, &b->lock, &timeout);
+            }
+        }
+    }
 
-                            log_debug("Current timestamp is %llu, "
-                                      "target=%llu (user=%llu)\n",
-                                      (unsigned long long)s->meta.curr_timestamp,
-                                      (unsigned long long)target_timestamp,
-                                      (unsigned long long)user_meta->timestamp);
+    ATOMIC_STORE_RELEASE(&b->waiting, 0);
+    MUTEX_UNLOCK(&b->lock);
 
-                            status = BLADERF_ERR_TIME_PAST;
-                        } else if ((user_meta->flags & BLADERF_META_FLAG_RX_NOW) ||
-                                   target_timestamp == s->meta.curr_timestamp) {
+    if (status == ETIMEDOUT) {
+        status = BLADERF_ERR_TIMEOUT;
+    } else if (status != 0) {
+        status = BLADERF_ERR_UNEXPECTED;
+    }
 
-                            /* Copy the request amount up to the end of a
-                             * this message in the current buffer */
-                            samples_to_copy =
-                                uint_min(num_samples - samples_returned,
-                                         left_in_msg(s));
+    return status;
+}
 
-                            memcpy(samples_dest + samples2bytes(s, samples_returned),
-                                   s->meta.curr_msg +
-                                        METADATA_HEADER_SIZE +
-                                        samples2bytes(s, s->meta.curr_msg_off),
-                                   samples2bytes(s, samples_to_copy));
+/* Check for a buffer without waiting, on behalf of a non-blocking call. If
+ * there is none, arm the readiness descriptor, if it exists, for the worker
+ * to signal. As with wait_for_buffer(), a return value of 0 does not
+ * guarantee that a buffer is available; the worker may have stopped. */
+static int try_for_buffer(struct bladerf_sync *s)
+{
+    struct buffer_mgmt *b = &s->buf_mgmt;
 
-                            samples_returned += samples_to_copy;
-                            s->meta.curr_msg_off += samples_to_copy;
+    if (buffer_available(s)) {
+        return 0;
+    }
 
-                            if (!copied_data &&
-                                (user_meta->flags & BLADERF_META_FLAG_RX_NOW)) {
+    if (b->ready_fd[0] >= 0) {
+        ready_fd_drain(b);
 
-                                /* Provide the user with the timestamp at the
-                                 * first returned sample when the
-                                 * NOW flag has been provided */
-                                user_meta->timestamp = s->meta.curr_timestamp;
-                                log_verbose("Updated user meta timestamp with: "
-                                            "%llu\n", (unsigned long long)
-                                            user_meta->timestamp);
-                            }
+        /* Pairs with the fences in the worker's notify_buffer_ready() and
+         * state changes, such that either we see its update or it sees our
+         * flag and signals the descriptor */
+        ATOMIC_STORE_RELEASE(&b->fd_armed, 1);
+        ATOMIC_FENCE();
 
-                            copied_data = true;
-                            s->meta.curr_timestamp += samples_to_copy;
+        if (buffer_available(s)) {
+            return 0;
+        }
+    }
 
-                            /* We've begun copying samples, so our target will
-                             * just keep tracking the current timestamp. */
-                            target_timestamp = s->meta.curr_timestamp;
+    /* The worker cannot signal us if it is no longer running */
+    if (sync_worker_get_state(s->worker, NULL) != SYNC_WORKER_STATE_RUNNING) {
+        return 0;
+    }
 
-                            log_verbose("After copying samples, t=%llu\n",
-                                        (unsigned long long)s->meta.curr_timestamp);
+    return BLADERF_ERR_WOULD_BLOCK;
+}
 
-                            if (left_in_msg(s) == 0) {
-                                assert(s->meta.curr_msg_off == s->meta.samples_per_msg);
+/* Wait for the worker to produce (RX) or free (TX) a buffer. When
+ * busy-polling, this spins for up to timeout_ms. Otherwise, it first spins
+ * for the configured period and then blocks on the buf_ready condition.
+ *
+ * A return value of 0 does not guarantee that a buffer is available; the
+ * worker also signals buf_ready upon stream errors and shutdown. If the
+ * handle is shut down by sync_shutdown(), BLADERF_ERR_INVAL is returned. */
+static int wait_for_buffer(struct bladerf_sync *s, unsigned int timeout_ms,
+                           const char *dbg_name, unsigned int dbg_idx)
+{
+    int status = 0;
+    bool blocked = false;
+    uint64_t start_us;
 
-                                s->meta.state = SYNC_META_STATE_HEADER;
-                                s->meta.msg_num++;
+    if (sync_is_shutdown(s)) {
+        return BLADERF_ERR_INVAL;
+    }
 
-                                if (s->meta.msg_num >= s->meta.msg_per_buf) {
-                                    assert(s->meta.msg_num == s->meta.msg_per_buf);
-                                    advance_rx_buffer(b);
-                                    s->meta.msg_num = 0;
-                                    s->state = SYNC_STATE_WAIT_FOR_BUFFER;
-                                }
-                            }
+    if (s->nonblock) {
+        status = try_for_buffer(s);
+        return sync_is_shutdown(s) ? BLADERF_ERR_INVAL : status;
+    }
 
-                        } else {
-                            const uint64_t time_delta =
-                                target_timestamp - s->meta.curr_timestamp;
+    start_us = async_stats_time_us();
 
-                            uint64_t left_in_buffer =
-                                (uint64_t) s->meta.samples_per_msg *
-                                    (s->meta.msg_per_buf - s->meta.msg_num);
+    if (s->stream_config.busy_poll) {
+        status = poll_for_buffer(s, timeout_ms);
+    } else if (!spin_for_buffer(s)) {
+        status = block_for_buffer(s, timeout_ms, dbg_name, dbg_idx);
+        blocked = true;
+    }
 
-                            /* Account for current position in buffer */
-                            left_in_buffer -= s->meta.curr_msg_off;
+    if (blocked) {
+        s->stats.blocking_waits++;
+    } else if (status == 0 && buffer_available(s)) {
+        s->stats.spin_waits++;
+    }
 
-                            if (time_delta >= left_in_buffer) {
-                                /* Discard the remainder of this buffer */
-                                advance_rx_buffer(b);
-                                s->state = SYNC_STATE_WAIT_FOR_BUFFER;
-                                s->meta.state = SYNC_META_STATE_HEADER;
+    async_stats_hist_add(s->stats.wait_hist, start_us, async_stats_time_us());
 
-                                log_verbose("%s: Discarding rest of buffer.\n",
-                                            __FUNCTION__);
+    if (sync_is_shutdown(s)) {
+        status = BLADERF_ERR_INVAL;
+    }
 
-                            } else if (time_delta <= left_in_msg(s)) {
-                                /* Fast forward within the current message */
-                                assert(time_delta <= SIZE_MAX);
-                                s->meta.curr_msg_off += (size_t) time_delta;
-                                s->meta.curr_timestamp += time_delta;
+    return status;
+}
 
-                                log_verbose("%s: Seeking within message (t=%llu)\n",
-                                            __FUNCTION__,
-                                            s->meta.curr_timestamp);
-                            } else {
-                                s->meta.state = SYNC_META_STATE_HEADER;
+#ifndef SYNC_WORKER_START_TIMEOUT_MS
+#   define SYNC_WORKER_START_TIMEOUT_MS 250
+#endif
+
+/* Returns # of samples left in a message (SC16Q11 mode only) */
+static inline unsigned int left_in_msg(struct bladerf_sync *s)
+{
+    size_t ret = s->meta.samples_per_msg - s->meta.curr_msg_off;
+    assert(ret <= UINT_MAX);
+
+    return (unsigned int) ret;
+}
+
+static inline void advance_rx_buffer(struct buffer_mgmt *b)
+{
+    log_verbose("%s: Marking buf[%u] empty.\n", __FUNCTION__, cons_idx(b));
+
+    /* Hand the buffer back to the worker, after we're done reading it */
+    b->consumed_idx = sync_buf_next(b, b->consumed_idx);
+    ATOMIC_STORE_RELEASE(&b->consumed, b->consumed + 1);
+}
+
+static inline unsigned int timestamp_to_msg(struct bladerf_sync *s, uint64_t t)
+{
+    uint64_t m =  t / s->meta.samples_per_msg;
+    assert(m <= UINT_MAX);
+    return (unsigned int) m;
+}
+
+/* Step the RX state machine through the states that precede the consumption
+ * of samples from a filled buffer: starting the worker, waiting for a buffer,
+ * and preparing a buffer for use. */
+static int rx_buffer_state_step(struct bladerf_sync *s, unsigned int timeout_ms)
+{
+    int status = 0;
+    struct buffer_mgmt *b = &s->buf_mgmt;
+
+    switch (s->state) {
+        case SYNC_STATE_CHECK_WORKER: {
+            int stream_error;
+            sync_worker_state worker_state =
+                sync_worker_get_state(s->worker, &stream_error);
+
+            /* Propagate stream error back to the caller.
+             * They can call this function again to restart the stream and
+             * try again.
+             */
+            if (sync_is_shutdown(s)) {
+                status = BLADERF_ERR_INVAL;
+            } else if (stream_error != 0) {
+                status = stream_error;
+            } else {
+                if (worker_state == SYNC_WORKER_STATE_IDLE) {
+                    log_debug("%s: Worker is idle. Going to reset buf "
+                              "mgmt.\n", __FUNCTION__);
+                    s->state = SYNC_STATE_RESET_BUF_MGMT;
+                } else if (worker_state == SYNC_WORKER_STATE_RUNNING) {
+                    s->state = SYNC_STATE_WAIT_FOR_BUFFER;
+                } else {
+                    status = BLADERF_ERR_UNEXPECTED;
+                    log_debug("%s: Unexpected worker state=%d\n",
+                            __FUNCTION__, worker_state);
+                }
+            }
+
+            break;
+        }
+
+        case SYNC_STATE_RESET_BUF_MGMT:
+            /* When the RX stream starts up, it will submit the first T
+             * transfers, so the consumer count must be reset to 0. The
+             * worker is idle, so it is not reading this. */
+            ATOMIC_STORE_RELEASE(&b->consumed, 0);
+            b->consumed_idx = 0;
+            s->meta.contiguous = false;
+            s->continuity.valid = false;
+            log_debug("%s: Reset buf_mgmt consumer index\n", __FUNCTION__);
+            s->state = SYNC_STATE_START_WORKER;
+            break;
+
+
+        case SYNC_STATE_START_WORKER:
+            sync_worker_submit_request(s->worker, SYNC_WORKER_START);
+
+            status = sync_worker_wait_for_state(
+                                            s->worker,
+                                            SYNC_WORKER_STATE_RUNNING,
+                                            SYNC_WORKER_START_TIMEOUT_MS);
+
+            if (status == 0) {
+                s->state = SYNC_STATE_WAIT_FOR_BUFFER;
+                log_debug("%s: Worker is now running.\n", __FUNCTION__);
+            } else {
+                log_debug("%s: Failed to start worker, (%d)\n",
+                          __FUNCTION__, status);
+            }
+            break;
+
+        case SYNC_STATE_WAIT_FOR_BUFFER:
+            /* Check the buffer state, as the worker may have produced one
+             * since we last queried the status */
+            if (buffer_available(s)) {
+                s->state = SYNC_STATE_BUFFER_READY;
+                log_verbose("%s: buffer %u is ready to consume\n",
+                            __FUNCTION__, cons_idx(b));
+            } else {
+                status = wait_for_buffer(s, timeout_ms,
+                                         __FUNCTION__, cons_idx(b));
+
+                if (status == 0) {
+                    if (!buffer_available(s)) {
+                        s->state = SYNC_STATE_CHECK_WORKER;
+                    } else {
+                        s->state = SYNC_STATE_BUFFER_READY;
+                        log_verbose("%s: buffer %u is ready to consume\n",
+                                    __FUNCTION__, cons_idx(b));
+                    }
+                }
+            }
+            break;
+
+        case SYNC_STATE_BUFFER_READY:
+            b->partial_off = 0;
+
+            switch (s->stream_config.format) {
+                case BLADERF_FORMAT_SC16_Q11:
+                case BLADERF_FORMAT_PSD_U32:
+                case BLADERF_FORMAT_SC16_Q11_PACKED:
+                case BLADERF_FORMAT_SC8_Q7:
+                case BLADERF_FORMAT_TX_SYMBOLS:
+                    s->state = SYNC_STATE_USING_BUFFER;
+                    break;
+
+                case BLADERF_FORMAT_SC16_Q11_META:
+                case BLADERF_FORMAT_SC8_Q7_META:
+                    s->state = SYNC_STATE_USING_BUFFER_META;
+                    s->meta.curr_msg_off = 0;
+                    s->meta.msg_num = 0;
+                    break;
+
+                default:
+                    assert(!"Invalid stream format");
+                    status = BLADERF_ERR_UNEXPECTED;
+            }
+            break;
+
+        default:
+            assert(!"Invalid state");
+            status = BLADERF_ERR_UNEXPECTED;
+    }
+
+    return status;
+}
+
+/* Verify that the current message immediately follows the previous one.
+ * Unlike the discontinuity check in rx_load_msg_header(), this is independent
+ * of how many samples the caller has consumed, so it reports every gap in the
+ * received stream, including those within a single sync_rx() call. */
+static inline void rx_check_continuity(struct bladerf_sync *s)
+{
+    struct sync_continuity *c = &s->continuity;
+    const uint64_t ts = s->meta.msg_timestamp;
+
+    if (c->valid && ts != c->next_timestamp) {
+        s->stats.discontinuities++;
+
+        if (ts > c->next_timestamp) {
+            s->stats.dropped_samples += ts - c->next_timestamp;
+        }
+
+        log_verbose("%s: Expected timestamp 0x%016"PRIx64", got 0x%016"PRIx64
+                    "\n", __FUNCTION__, c->next_timestamp, ts);
+
+        if (c->cb != NULL) {
+            c->cb(s->dev, c->next_timestamp, ts, c->cb_data);
+        }
+    }
+
+    c->next_timestamp = ts + s->meta.samples_per_msg;
+    c->valid = true;
+}
+
+/* Load the header of the current message in the current buffer.
+ *
+ * Returns true if the message's timestamp does not follow the last
+ * sample consumed (i.e., a discontinuity occurred). */
+static inline bool rx_load_msg_header(struct bladerf_sync *s)
+{
+    struct buffer_mgmt *b = &s->buf_mgmt;
+    uint8_t *buf_src = (uint8_t*)b->buffers[cons_idx(b)];
+
+    assert(s->meta.msg_num < s->meta.msg_per_buf);
+
+    s->meta.curr_msg = buf_src + s->dev->msg_size * s->meta.msg_num;
+    s->meta.msg_timestamp = metadata_get_timestamp(s->meta.curr_msg);
+    s->meta.msg_flags = s->meta.overflow_flags ?
+                        metadata_get_flags(s->meta.curr_msg) : 0;
+    s->meta.msg_chan_mask = metadata_get_channel_mask(s->meta.curr_msg);
+    s->meta.msg_chan = metadata_get_channel(s->meta.curr_msg);
+    s->meta.curr_msg_off = 0;
+
+    if (s->continuity.enabled) {
+        rx_check_continuity(s);
+    }
+
+    return s->meta.msg_timestamp != s->meta.curr_timestamp;
+}
+
+/* Account for messages passed over while seeking, so that the continuity
+ * checker expects the message that follows them */
+static inline void rx_skip_msgs(struct bladerf_sync *s, unsigned int n)
+{
+    s->continuity.next_timestamp += (uint64_t) s->meta.samples_per_msg * n;
+}
+
+/* Hand any available buffers that end before the target timestamp back to
+ * the worker. Only the first and last message headers of each buffer are
+ * read, so gaps within a skipped buffer are reported to the continuity
+ * checker as a single discontinuity.
+ *
+ * Returns the number of buffers skipped. */
+static unsigned int rx_skip_buffers(struct bladerf_sync *s, uint64_t target)
+{
+    struct buffer_mgmt *b = &s->buf_mgmt;
+    const size_t last_off = s->dev->msg_size * (s->meta.msg_per_buf - 1);
+    const unsigned int completed = ATOMIC_LOAD_ACQUIRE(&b->completed);
+    unsigned int consumed = b->consumed;
+    unsigned int idx = b->consumed_idx;
+    unsigned int n;
+
+    while (consumed != completed) {
+        const uint8_t *buf = b->buffers[idx];
+        const uint64_t first = metadata_get_timestamp(buf);
+        const uint64_t last = metadata_get_timestamp(buf + last_off);
+
+        /* The target lies within, or before, this buffer */
+        if (last + s->meta.samples_per_msg > target) {
+            break;
+        }
+
+        if (s->continuity.enabled) {
+            s->meta.msg_timestamp = first;
+            rx_check_continuity(s);
+
+            if (s->meta.msg_per_buf > 1) {
+                rx_skip_msgs(s, s->meta.msg_per_buf - 2);
+                s->meta.msg_timestamp = last;
+                rx_check_continuity(s);
+            }
+        }
+
+        s->meta.curr_timestamp = last + s->meta.samples_per_msg;
+        consumed++;
+        idx = sync_buf_next(b, idx);
+    }
+
+    n = consumed - b->consumed;
+    if (n != 0) {
+        log_verbose("%s: Skipping %u buffers (t=%llu)\n", __FUNCTION__, n,
+                    (unsigned long long) s->meta.curr_timestamp);
+
+        b->consumed_idx = idx;
+        ATOMIC_STORE_RELEASE(&b->consumed, consumed);
+    }
+
+    return n;
+}
+
+/* Report the channelizer channel of the sample at the current message
+ * offset. Samples cycle through the channels set in the mask, in ascending
+ * order, starting from the message's first channel. */
+static void rx_report_channel(struct bladerf_sync *s,
+                              struct bladerf_metadata *user_meta)
+{
+    const uint16_t mask = s->meta.msg_chan_mask;
+    unsigned int count = 0, pos = 0, i;
+    size_t target;
+
+    user_meta->channel_mask = mask;
+    user_meta->channel = 0;
+
+    if (mask == 0) {
+        return;
+    }
+
+    for (i = 0; i < 16; i++) {
+        if (mask & (1 << i)) {
+            if (i < s->meta.msg_chan) {
+                pos++;
+            }
+            count++;
+        }
+    }
+
+    target = (pos + s->meta.curr_msg_off) % count;
+
+    for (i = 0; i < 16; i++) {
+        if (mask & (1 << i)) {
+            if (target == 0) {
+                user_meta->channel = i;
+                break;
+            }
+            target--;
+        }
+    }
+}
+
+/* Number of samples missing between the last sample consumed and the
+ * start of the current message */
+static inline uint64_t rx_msg_gap(struct bladerf_sync *s)
+{
+    if (s->meta.msg_timestamp > s->meta.curr_timestamp) {
+        return s->meta.msg_timestamp - s->meta.curr_timestamp;
+    } else {
+        return 0;
+    }
+}
+
+/* Report the samples the FPGA dropped before the current message, when its
+ * header flags an RX FIFO overflow */
+static inline void rx_report_fpga_overflow(struct bladerf_sync *s,
+                                           struct bladerf_metadata *user_meta)
+{
+    if (s->meta.msg_flags & BLADERF_META_FLAG_RX_OVERFLOW) {
+        user_meta->status |= BLADERF_META_STATUS_FPGA_OVERFLOW;
+        user_meta->fpga_dropped_samples =
+            s->meta.msg_flags & BLADERF_META_FLAG_RX_DROPPED_MASK;
+    }
+}
+
+/* Returns the number of overruns that have occurred since this was last
+ * called, for reporting to the API caller */
+static inline uint32_t rx_report_overruns(struct bladerf_sync *s)
+{
+    const uint64_t overruns = ATOMIC_LOAD_ACQUIRE(&s->stats.overruns);
+    const uint64_t n = overruns - s->stats.overruns_reported;
+
+    s->stats.overruns_reported = overruns;
+    return n > UINT32_MAX ? UINT32_MAX : (uint32_t) n;
+}
+
+/* Metadata of range `i` of a receive request, if any was provided */
+static inline struct bladerf_metadata *rx_range_meta(
+                                        struct bladerf_metadata *user_meta,
+                                        unsigned int i)
+{
+    return user_meta != NULL ? &user_meta[i] : NULL;
+}
+
+/* Clear the outputs of a range's metadata, as a receive loop begins to
+ * fill the range */
+static inline void rx_range_begin(struct bladerf_sync *s,
+                                  struct bladerf_metadata *user_meta)
+{
+    if (user_meta != NULL && format_has_metadata(s->stream_config.format)) {
+        user_meta->status = 0;
+        user_meta->dropped_samples = 0;
+        user_meta->fpga_dropped_samples = 0;
+        user_meta->channel_mask = 0;
+        user_meta->channel = 0;
+    }
+}
+
+/* Report the results of a range, once a receive loop is done with it */
+static inline void rx_range_end(struct bladerf_sync *s,
+                                struct bladerf_metadata *user_meta,
+                                unsigned int samples_returned)
+{
+    if (user_meta != NULL) {
+        user_meta->actual_count = samples_returned;
+        user_meta->overruns = rx_report_overruns(s);
+    }
+}
+
+/* Receive loop for formats without metadata, copying from the current
+ * buffer until each of the `iov_count` ranges has been filled. The number
+ * of samples returned in the last range that was worked on is provided via
+ * `num_returned`. */
+static int rx_loop(struct bladerf_sync *s, const struct bladerf_rx_iov *iov,
+                   unsigned int iov_count,
+                   struct bladerf_metadata *user_meta,
+                   unsigned int timeout_ms, unsigned int *num_returned)
+{
+    struct buffer_mgmt *b = &s->buf_mgmt;
+    const unsigned int samples_per_buffer = s->stream_config.samples_per_buffer;
+
+    int status = 0;
+    unsigned int range = 0;
+    uint8_t *samples_dest = (uint8_t *) iov[0].samples;
+    unsigned int num_samples = iov[0].num_samples;
+    struct bladerf_metadata *range_meta = rx_range_meta(user_meta, 0);
+    unsigned int samples_returned = 0;
+    uint8_t *buf_src = NULL;
+    unsigned int samples_to_copy = 0;
+
+    rx_range_begin(s, range_meta);
+
+    while (status == 0) {
+
+        /* Move on to the next range once this one is filled */
+        if (samples_returned == num_samples) {
+            rx_range_end(s, range_meta, samples_returned);
+
+            if (++range == iov_count) {
+                break;
+            }
+
+            samples_dest = (uint8_t *) iov[range].samples;
+            num_samples = iov[range].num_samples;
+            range_meta = rx_range_meta(user_meta, range);
+            samples_returned = 0;
+
+            rx_range_begin(s, range_meta);
+            continue;
+        }
+
+        switch (s->state) {
+            case SYNC_STATE_CHECK_WORKER:
+            case SYNC_STATE_RESET_BUF_MGMT:
+            case SYNC_STATE_START_WORKER:
+            case SYNC_STATE_WAIT_FOR_BUFFER:
+            case SYNC_STATE_BUFFER_READY:
+                status = rx_buffer_state_step(s, timeout_ms);
+                break;
+
+            case SYNC_STATE_USING_BUFFER:
+                buf_src = (uint8_t*)b->buffers[cons_idx(b)];
+
+                samples_to_copy = uint_min(num_samples - samples_returned,
+                                           samples_per_buffer - b->partial_off);
+
+                s->ops.copy(samples_dest + user_samples2bytes(s, samples_returned),
+                            buf_src + samples2bytes(s, b->partial_off),
+                            samples_to_copy);
+
+                b->partial_off += samples_to_copy;
+                samples_returned += samples_to_copy;
+
+                log_verbose("%s: Provided %u samples to caller\n",
+                            __FUNCTION__, samples_to_copy);
+
+                /* We've finished consuming this buffer and can start looking
+                 * for available samples in the next buffer */
+                if (b->partial_off >= samples_per_buffer) {
+
+                    /* Check for symptom of out-of-bounds accesses */
+                    assert(b->partial_off == samples_per_buffer);
+
+                    advance_rx_buffer(b);
+                    s->state = SYNC_STATE_WAIT_FOR_BUFFER;
+                }
+                break;
+
+            default:
+                assert(!"Invalid state");
+                status = BLADERF_ERR_UNEXPECTED;
+        }
+    }
+
+    if (status != 0) {
+        rx_range_end(s, range_meta, samples_returned);
+    }
+
+    *num_returned = samples_returned;
+    return status;
+}
+
+/* Receive loop for metadata formats, which walks the messages of each buffer
+ * and seeks to the timestamp requested in the metadata of each of the
+ * `iov_count` ranges in turn. A range ends early at a discontinuity, and the
+ * next range picks up following it. The number of samples returned in the
+ * last range that was worked on is provided via `num_returned`. */
+static int rx_loop_meta(struct bladerf_sync *s,
+                        const struct bladerf_rx_iov *iov,
+                        unsigned int iov_count,
+                        struct bladerf_metadata *metadata,
+                        unsigned int timeout_ms, unsigned int *num_returned)
+{
+    struct buffer_mgmt *b = &s->buf_mgmt;
+
+    int status = 0;
+    unsigned int range = 0;
+    uint8_t *samples_dest = (uint8_t *) iov[0].samples;
+    unsigned int num_samples = iov[0].num_samples;
+    struct bladerf_metadata *user_meta = &metadata[0];
+    bool exit_early = false;
+    bool copied_data = false;
+    bool discontinuity = false;
+    unsigned int samples_returned = 0;
+    unsigned int samples_to_copy = 0;
+    uint64_t target_timestamp = user_meta->timestamp;
+
+    rx_range_begin(s, user_meta);
+
+    while (status == 0) {
+
+        /* Move on to the next range once this one is filled, or has been
+         * cut short by a discontinuity */
+        if (exit_early || samples_returned == num_samples) {
+            rx_range_end(s, user_meta, samples_returned);
+
+            if (++range == iov_count) {
+                break;
+            }
+
+            samples_dest = (uint8_t *) iov[range].samples;
+            num_samples = iov[range].num_samples;
+            user_meta = &metadata[range];
+            exit_early = false;
+            copied_data = false;
+            samples_returned = 0;
+            target_timestamp = user_meta->timestamp;
+
+            rx_range_begin(s, user_meta);
+            continue;
+        }
+
+        switch (s->state) {
+            case SYNC_STATE_CHECK_WORKER:
+            case SYNC_STATE_RESET_BUF_MGMT:
+            case SYNC_STATE_START_WORKER:
+            case SYNC_STATE_WAIT_FOR_BUFFER:
+            case SYNC_STATE_BUFFER_READY:
+                status = rx_buffer_state_step(s, timeout_ms);
+                break;
+
+            case SYNC_STATE_USING_BUFFER_META:
+                switch (s->meta.state) {
+                    case SYNC_META_STATE_HEADER:
+                        discontinuity = rx_load_msg_header(s);
+
+                        /* We've encountered a discontinuity and need to return
+                         * what we have so far, setting the status flags.
+                         *
+                         * If we have yet to return any samples in this call,
+                         * we can only consider this to be a gap if the caller
+                         * is reading contiguously from previous calls. */
+                        if (discontinuity &&
+                            (copied_data ||
+                             ((user_meta->flags & BLADERF_META_FLAG_RX_NOW) &&
+                              s->meta.contiguous))) {
+
+                            user_meta->status |= BLADERF_META_STATUS_OVERRUN;
+                            user_meta->dropped_samples = rx_msg_gap(s);
+                            rx_report_fpga_overflow(s, user_meta);
+
+                            if (!copied_data) {
+                                user_meta->timestamp = s->meta.msg_timestamp;
+                            }
+
+                            exit_early = true;
+                            log_debug("Sample discontinuity detected @ "
+                                      "buffer %u, message %u: Expected t=%llu, "
+                                      "got t=%llu\n",
+                                      cons_idx(b), s->meta.msg_num,
+                                      (unsigned long long)s->meta.curr_timestamp,
+                                      (unsigned long long)s->meta.msg_timestamp);
+
+                        } else {
+                            log_verbose("Got header for message %u: "
+                                        "t_new=%u, t_old=%u\n",
+                                        s->meta.msg_num,
+                                        s->meta.msg_timestamp,
+                                        s->meta.curr_timestamp);
+                        }
+
+                        s->meta.curr_timestamp = s->meta.msg_timestamp;
+                        s->meta.state = SYNC_META_STATE_SAMPLES;
+                        break;
+
+                    case SYNC_META_STATE_SAMPLES:
+                        if (!copied_data &&
+                            (user_meta->flags & BLADERF_META_FLAG_RX_NOW) == 0 &&
+                            target_timestamp < s->meta.curr_timestamp) {
+
+                            log_debug("Current timestamp is %llu, "
+                                      "target=%llu (user=%llu)\n",
+                                      (unsigned long long)s->meta.curr_timestamp,
+                                      (unsigned long long)target_timestamp,
+                                      (unsigned long long)user_meta->timestamp);
+
+                            status = BLADERF_ERR_TIME_PAST;
+                        } else if ((user_meta->flags & BLADERF_META_FLAG_RX_NOW) ||
+                                   target_timestamp == s->meta.curr_timestamp) {
+
+                            if (!copied_data) {
+                                rx_report_channel(s, user_meta);
+                            }
+
+                            /* Copy the request amount up to the end of a
+                             * this message in the current buffer */
+                            samples_to_copy =
+                                uint_min(num_samples - samples_returned,
+                                         left_in_msg(s));
+
+                            s->ops.copy(samples_dest +
+                                          user_samples2bytes(s, samples_returned),
+                                        s->meta.curr_msg +
+                                          METADATA_HEADER_SIZE +
+                                          samples2bytes(s, s->meta.curr_msg_off),
+                                        samples_to_copy);
+
+                            samples_returned += samples_to_copy;
+                            s->meta.curr_msg_off += samples_to_copy;
+
+                            if (!copied_data &&
+                                (user_meta->flags & BLADERF_META_FLAG_RX_NOW)) {
+
+                                /* Provide the user with the timestamp at the
+                                 * first returned sample when the
+                                 * NOW flag has been provided */
+                                user_meta->timestamp = s->meta.curr_timestamp;
+                                log_verbose("Updated user meta timestamp with: "
+                                            "%llu\n", (unsigned long long)
+                                            user_meta->timestamp);
+                            }
+
+                            copied_data = true;
+                            s->meta.contiguous = true;
+                            s->meta.curr_timestamp += samples_to_copy;
+
+                            /* We've begun copying samples, so our target will
+                             * just keep tracking the current timestamp. */
+                            target_timestamp = s->meta.curr_timestamp;
+
+                            log_verbose("After copying samples, t=%llu\n",
+                                        (unsigned long long)s->meta.curr_timestamp);
+
+                            if (left_in_msg(s) == 0) {
+                                assert(s->meta.curr_msg_off == s->meta.samples_per_msg);
+
+                                s->meta.state = SYNC_META_STATE_HEADER;
+                                s->meta.msg_num++;
+
+                                if (s->meta.msg_num >= s->meta.msg_per_buf) {
+                                    assert(s->meta.msg_num == s->meta.msg_per_buf);
+                                    advance_rx_buffer(b);
+                                    s->meta.msg_num = 0;
+                                    s->state = SYNC_STATE_WAIT_FOR_BUFFER;
+                                }
+                            }
+
+                        } else {
+                            const uint64_t time_delta =
+                                target_timestamp - s->meta.curr_timestamp;
+
+                            uint64_t left_in_buffer =
+                                (uint64_t) s->meta.samples_per_msg *
+                                    (s->meta.msg_per_buf - s->meta.msg_num);
+
+                            /* Account for current position in buffer */
+                            left_in_buffer -= s->meta.curr_msg_off;
+
+                            if (time_delta >= left_in_buffer) {
+                                /* Discard the remainder of this buffer, and
+                                 * any others already received that end
+                                 * before the target */
+                                rx_skip_msgs(s, s->meta.msg_per_buf -
+                                                s->meta.msg_num - 1);
+                                advance_rx_buffer(b);
+                                rx_skip_buffers(s, target_timestamp);
+                                s->state = SYNC_STATE_WAIT_FOR_BUFFER;
+                                s->meta.state = SYNC_META_STATE_HEADER;
+
+                                log_verbose("%s: Discarding rest of buffer.\n",
+                                            __FUNCTION__);
+
+                            } else if (time_delta <= left_in_msg(s)) {
+                                /* Fast forward within the current message */
+                                assert(time_delta <= SIZE_MAX);
+                                s->meta.curr_msg_off += (size_t) time_delta;
+                                s->meta.curr_timestamp += time_delta;
+
+                                log_verbose("%s: Seeking within message (t=%llu)\n",
+                                            __FUNCTION__,
+                                            s->meta.curr_timestamp);
+                            } else {
+                                /* The target is at least one message
+                                 * beyond the current one */
+                                const unsigned int skip = timestamp_to_msg(s,
+                                        s->meta.curr_msg_off + time_delta);
+
+                                s->meta.state = SYNC_META_STATE_HEADER;
+
+                                rx_skip_msgs(s, skip - 1);
+                                s->meta.msg_num += skip;
+
+                                log_verbose("%s: Seeking to message %u.\n",
+                                            __FUNCTION__, s->meta.msg_num);
+                            }
+                        }
+                        break;
+
+                    default:
+                        assert(!"Invalid state");
+                        status = BLADERF_ERR_UNEXPECTED;
+                }
+                break;
+
+            default:
+                assert(!"Invalid state");
+                status = BLADERF_ERR_UNEXPECTED;
+        }
+    }
+
+    if (status != 0) {
+        rx_range_end(s, user_meta, samples_returned);
+    }
+
+    *num_returned = samples_returned;
+    return status;
+}
+
+/* Receive samples into each of `iov_count` ranges, with the corresponding
+ * entries of `user_meta`. The request is validated as a whole before any
+ * samples are received. `num_returned` (if non-NULL) is set to the number of
+ * samples returned in the last range that was worked on. */
+static int rx_samples(struct bladerf *dev, const struct bladerf_rx_iov *iov,
+                      unsigned int iov_count,
+                      struct bladerf_metadata *user_meta,
+                      unsigned int timeout_ms, unsigned int *num_returned)
+{
+    struct bladerf_sync *s = dev->sync[BLADERF_MODULE_RX];
+    int status = 0;
+    unsigned int i;
+    unsigned int samples_returned = 0;
+
+    assert(iov_count != 0);
+
+    if (s == NULL) {
+        log_debug("NULL pointer passed to %s\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (s->loan.samples != NULL) {
+        log_debug("%s: Acquired samples have not yet been released.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (format_has_metadata(s->stream_config.format) &&
+               user_meta == NULL) {
+        log_debug("NULL metadata pointer passed to %s\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    for (i = 0; i < iov_count; i++) {
+        if (iov[i].samples == NULL) {
+            log_debug("NULL pointer passed to %s\n", __FUNCTION__);
+            return BLADERF_ERR_INVAL;
+        }
+    }
+
+    log_verbose("%s: Requests %u samples (%u ranges).\n", __FUNCTION__,
+                iov[0].num_samples, iov_count);
+
+    status = s->ops.rx(s, iov, iov_count, user_meta, timeout_ms,
+                       &samples_returned);
+
+    if (num_returned != NULL) {
+        *num_returned = samples_returned;
+    }
+
+    return status;
+}
+
+int sync_rx(struct bladerf *dev, void *samples, unsigned num_samples,
+            struct bladerf_metadata *user_meta, unsigned int timeout_ms)
+{
+    const struct bladerf_rx_iov iov = { samples, num_samples };
+    unsigned int returned = 0;
+    int status;
+
+    PROBE2(sync_rx_entry, num_samples, timeout_ms);
+    status = rx_samples(dev, &iov, 1, user_meta, timeout_ms, &returned);
+    PROBE2(sync_rx_return, status, returned);
+
+    return status;
+}
+
+int sync_rx_try(struct bladerf *dev, void *samples, unsigned int num_samples,
+                struct bladerf_metadata *user_meta,
+                unsigned int *num_transferred)
+{
+    struct bladerf_sync *s = dev->sync[BLADERF_MODULE_RX];
+    const struct bladerf_rx_iov iov = { samples, num_samples };
+    int status;
+
+    *num_transferred = 0;
+
+    if (s == NULL) {
+        log_debug("%s: Sync interface is not configured.\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    s->nonblock = true;
+    status = rx_samples(dev, &iov, 1, user_meta, 0, num_transferred);
+    s->nonblock = false;
+
+    /* A partial read is not a failure */
+    if (status == BLADERF_ERR_WOULD_BLOCK && *num_transferred != 0) {
+        status = 0;
+    }
+
+    return status;
+}
+
+int sync_rx_multi(struct bladerf *dev, const struct bladerf_rx_iov *iov,
+                  struct bladerf_metadata *metadata, unsigned int iov_count,
+                  unsigned int timeout_ms)
+{
+    if (iov == NULL) {
+        log_debug("NULL pointer passed to %s\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (iov_count == 0) {
+        return 0;
+    }
+
+    return rx_samples(dev, iov, iov_count, metadata, timeout_ms, NULL);
+}
+
+int sync_rx_acquire(struct bladerf *dev, void **samples,
+                    unsigned int *num_samples,
+                    struct bladerf_metadata *user_meta,
+                    unsigned int timeout_ms)
+{
+    struct bladerf_sync *s = dev->sync[BLADERF_MODULE_RX];
+    struct buffer_mgmt *b;
+    bool discontinuity = false;
+    int status = 0;
+
+    if (s == NULL || samples == NULL || num_samples == NULL) {
+        log_debug("NULL pointer passed to %s\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (s->loan.samples != NULL) {
+        log_debug("%s: Previously acquired samples have not been released.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (converts_samples(s)) {
+        log_debug("%s: Converted samples cannot be lent.\n", __FUNCTION__);
+        return BLADERF_ERR_UNSUPPORTED;
+    } else if (format_has_metadata(s->stream_config.format)) {
+        if (user_meta == NULL) {
+            log_debug("NULL metadata pointer passed to %s\n", __FUNCTION__);
+            return BLADERF_ERR_INVAL;
+        } else {
+            user_meta->status = 0;
+            user_meta->dropped_samples = 0;
+            user_meta->fpga_dropped_samples = 0;
+            user_meta->channel_mask = 0;
+            user_meta->channel = 0;
+        }
+    }
+
+    b = &s->buf_mgmt;
+
+    while (status == 0 && s->loan.samples == NULL) {
+        switch (s->state) {
+            case SYNC_STATE_CHECK_WORKER:
+            case SYNC_STATE_RESET_BUF_MGMT:
+            case SYNC_STATE_START_WORKER:
+            case SYNC_STATE_WAIT_FOR_BUFFER:
+            case SYNC_STATE_BUFFER_READY:
+                status = rx_buffer_state_step(s, timeout_ms);
+                break;
+
+            case SYNC_STATE_USING_BUFFER:
+                s->loan.samples = (uint8_t*)b->buffers[cons_idx(b)] +
+                                    samples2bytes(s, b->partial_off);
+
+                s->loan.num_samples =
+                    s->stream_config.samples_per_buffer - b->partial_off;
+                break;
+
+            case SYNC_STATE_USING_BUFFER_META:
+                if (s->meta.state == SYNC_META_STATE_HEADER) {
+                    if (rx_load_msg_header(s) && s->meta.contiguous) {
+                        log_debug("Sample discontinuity detected @ "
+                                  "buffer %u, message %u: Expected t=%llu, "
+                                  "got t=%llu\n",
+                                  cons_idx(b), s->meta.msg_num,
+                                  (unsigned long long)s->meta.curr_timestamp,
+                                  (unsigned long long)s->meta.msg_timestamp);
+
+                        discontinuity = true;
+                        user_meta->dropped_samples = rx_msg_gap(s);
+                        rx_report_fpga_overflow(s, user_meta);
+                    }
+
+                    s->meta.curr_timestamp = s->meta.msg_timestamp;
+                    s->meta.state = SYNC_META_STATE_SAMPLES;
+                }
+
+                s->loan.samples = s->meta.curr_msg + METADATA_HEADER_SIZE +
+                                    samples2bytes(s, s->meta.curr_msg_off);
+
+                s->loan.num_samples = left_in_msg(s);
+
+                user_meta->timestamp = s->meta.curr_timestamp;
+                rx_report_channel(s, user_meta);
+                if (discontinuity) {
+                    user_meta->status |= BLADERF_META_STATUS_OVERRUN;
+                }
+                break;
+        }
+    }
+
+    if (status == 0) {
+        *samples = s->loan.samples;
+        *num_samples = s->loan.num_samples;
+
+        log_verbose("%s: Lent %u samples to caller\n",
+                    __FUNCTION__, s->loan.num_samples);
+    }
+
+    if (user_meta) {
+        user_meta->actual_count = (status == 0) ? s->loan.num_samples : 0;
+        user_meta->overruns = rx_report_overruns(s);
+    }
+
+    return status;
+}
+
+int sync_rx_acquire_msgs(struct bladerf *dev, void **buffer,
+                         struct bladerf_rx_msg *msgs, unsigned int max_msgs,
+                         unsigned int *num_msgs,
+                         struct bladerf_metadata *user_meta,
+                         unsigned int timeout_ms)
+{
+    struct bladerf_sync *s = dev->sync[BLADERF_MODULE_RX];
+    unsigned int i, n, total = 0;
+    bool discontinuity = false;
+    int status = 0;
+
+    if (s == NULL || buffer == NULL || msgs == NULL || num_msgs == NULL ||
+        user_meta == NULL) {
+        log_debug("NULL pointer passed to %s\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (max_msgs == 0) {
+        return BLADERF_ERR_INVAL;
+    } else if (s->loan.samples != NULL) {
+        log_debug("%s: Previously acquired samples have not been released.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (!format_has_metadata(s->stream_config.format)) {
+        log_debug("%s: Stream format does not carry metadata.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_UNSUPPORTED;
+    } else if (converts_samples(s)) {
+        log_debug("%s: Converted samples cannot be lent.\n", __FUNCTION__);
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    user_meta->status = 0;
+    user_meta->dropped_samples = 0;
+    user_meta->fpga_dropped_samples = 0;
+    user_meta->channel_mask = 0;
+    user_meta->channel = 0;
+
+    while (status == 0 && s->state != SYNC_STATE_USING_BUFFER_META) {
+        status = rx_buffer_state_step(s, timeout_ms);
+    }
+
+    if (status == 0) {
+        const unsigned int first = s->meta.msg_num;
+
+        n = s->meta.msg_per_buf - first;
+        if (n > max_msgs) {
+            n = max_msgs;
+        }
+
+        /* Walk the lent messages' headers, leaving the state as though the
+         * samples of all but the last message have been consumed. The last
+         * message is accounted for by sync_rx_release(). */
+        for (i = 0; i < n; i++) {
+            s->meta.msg_num = first + i;
+
+            if (s->meta.state == SYNC_META_STATE_HEADER) {
+                if (rx_load_msg_header(s) && s->meta.contiguous && i == 0) {
+                    log_debug("Sample discontinuity detected @ "
+                              "buffer %u, message %u: Expected t=%llu, "
+                              "got t=%llu\n",
+                              cons_idx(&s->buf_mgmt), s->meta.msg_num,
+                              (unsigned long long)s->meta.curr_timestamp,
+                              (unsigned long long)s->meta.msg_timestamp);
+
+                    discontinuity = true;
+                    user_meta->dropped_samples = rx_msg_gap(s);
+                    rx_report_fpga_overflow(s, user_meta);
+                }
+
+                s->meta.curr_timestamp = s->meta.msg_timestamp;
+            }
+
+            msgs[i].timestamp = s->meta.curr_timestamp;
+            msgs[i].flags = s->meta.msg_flags;
+            msgs[i].samples = s->meta.curr_msg + METADATA_HEADER_SIZE +
+                                samples2bytes(s, s->meta.curr_msg_off);
+            msgs[i].num_samples = left_in_msg(s);
+
+            if (i == 0) {
+                /* A message already partially consumed is lent from the
+                 * first unconsumed sample, rather than its header */
+                s->loan.samples = (s->meta.curr_msg_off == 0) ?
+                                    s->meta.curr_msg :
+                                    (uint8_t *) msgs[0].samples;
+
+                user_meta->timestamp = s->meta.curr_timestamp;
+                rx_report_channel(s, user_meta);
+            }
+
+            total += msgs[i].num_samples;
+
+            s->meta.curr_timestamp += left_in_msg(s);
+            s->meta.curr_msg_off = 0;
+            s->meta.state = SYNC_META_STATE_HEADER;
+        }
+
+        s->loan.num_samples = total;
+        s->loan.num_msgs = n;
+
+        if (discontinuity) {
+            user_meta->status |= BLADERF_META_STATUS_OVERRUN;
+        }
+
+        *buffer = s->loan.samples;
+        *num_msgs = n;
+
+        log_verbose("%s: Lent %u messages (%u samples) to caller\n",
+                    __FUNCTION__, n, total);
+    }
+
+    user_meta->actual_count = (status == 0) ? total : 0;
+    user_meta->overruns = rx_report_overruns(s);
+
+    return status;
+}
+
+int sync_rx_release(struct bladerf *dev, void *samples)
+{
+    struct bladerf_sync *s = dev->sync[BLADERF_MODULE_RX];
+    struct buffer_mgmt *b;
+    int status = 0;
+
+    if (s == NULL || samples == NULL) {
+        log_debug("NULL pointer passed to %s\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (samples != s->loan.samples) {
+        log_debug("%s: Provided samples are not the current loan.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    b = &s->buf_mgmt;
+
+    switch (s->state) {
+        case SYNC_STATE_USING_BUFFER:
+            b->partial_off += s->loan.num_samples;
+            assert(b->partial_off == s->stream_config.samples_per_buffer);
+
+            advance_rx_buffer(b);
+            s->state = SYNC_STATE_WAIT_FOR_BUFFER;
+            break;
+
+        case SYNC_STATE_USING_BUFFER_META:
+            /* sync_rx_acquire_msgs() has already stepped past the samples
+             * of the messages it lent */
+            if (s->loan.num_msgs == 0) {
+                s->meta.curr_msg_off += s->loan.num_samples;
+                s->meta.curr_timestamp += s->loan.num_samples;
+                assert(left_in_msg(s) == 0);
+            }
+
+            s->meta.state = SYNC_META_STATE_HEADER;
+            s->meta.msg_num++;
+
+            if (s->meta.msg_num >= s->meta.msg_per_buf) {
+                assert(s->meta.msg_num == s->meta.msg_per_buf);
+                advance_rx_buffer(b);
+                s->meta.msg_num = 0;
+                s->state = SYNC_STATE_WAIT_FOR_BUFFER;
+            }
+            break;
+
+        default:
+            assert(!"Invalid state");
+            status = BLADERF_ERR_UNEXPECTED;
+    }
+
+    s->loan.samples = NULL;
+    s->loan.num_samples = 0;
+    s->loan.num_msgs = 0;
+    s->meta.contiguous = true;
+
+    return status;
+}
+
+static int advance_tx_buffer(struct bladerf_sync *s, struct buffer_mgmt *b)
+{
+    int status;
+    const unsigned int idx = prod_idx(b);
+
+    log_verbose("%s: Marking buf[%u] full\n", __FUNCTION__, idx);
+
+    /* The worker does not count the device idling between bursts as an
+     * underrun */
+    b->after_burst[idx] = s->meta.burst_ended;
+
+    /* The buffer must be accounted for as in-flight before it is submitted,
+     * as its callback may occur before async_submit_stream_buffer() returns */
+    ATOMIC_STORE_RELEASE(&b->submitted, b->submitted + 1);
+
+    status = async_submit_stream_buffer(s->worker->stream,
+                                        b->buffers[idx],
+                                        s->stream_config.timeout_ms);
+
+    if (status == 0) {
+        b->submitted_idx = sync_buf_next(b, idx);
+        s->meta.burst_ended = false;
+
+        /* Go handle the next buffer, if we have one available.  Otherwise,
+         * check up on the worker's state and restart it if needed. */
+        if (buffer_available(s)) {
+            s->state = SYNC_STATE_BUFFER_READY;
+        } else {
+            s->state = SYNC_STATE_CHECK_WORKER;
+        }
+    } else {
+        /* The buffer was not submitted, so we still own it */
+        ATOMIC_STORE_RELEASE(&b->submitted, b->submitted - 1);
+
+        /* The stream is being torn down under us by sync_shutdown() */
+        if (sync_is_shutdown(s)) {
+            status = BLADERF_ERR_INVAL;
+        }
+
+        log_debug("%s: Failed to advance buffer: %s\n",
+                  __FUNCTION__, bladerf_strerror(status));
+    }
+
+    return status;
+}
+
+/* Process the burst-related flags provided to sync_tx() or sync_tx_acquire()
+ * at the start of a call. */
+static int tx_meta_begin(struct bladerf_sync *s,
+                         struct bladerf_metadata *user_meta)
+{
+    if (user_meta->flags & BLADERF_META_FLAG_TX_BURST_START) {
+        bool now = user_meta->flags & BLADERF_META_FLAG_TX_NOW;
+
+        if (s->meta.in_burst) {
+            log_debug("%s: BURST_START provided while already in a burst.\n",
+                      __FUNCTION__);
+            return BLADERF_ERR_INVAL;
+        } else if (!now && user_meta->timestamp < s->meta.curr_timestamp) {
+            log_debug("Provided timestamp=%llu is in past: "
+                      "current=%llu\n",
+                      (unsigned long long)user_meta->timestamp,
+                      (unsigned long long)s->meta.curr_timestamp);
+
+            return BLADERF_ERR_TIME_PAST;
+        } else {
+            s->meta.in_burst = true;
+            s->meta.drop_late = s->meta.late_policy &&
+                (user_meta->flags & BLADERF_META_FLAG_TX_DROP_LATE);
+
+            if (now) {
+                s->meta.now = true;
+                log_verbose("%s: Starting burst \"now\"\n",
+                            __FUNCTION__);
+            } else {
+                s->meta.curr_timestamp = user_meta->timestamp;
+                log_verbose("%s: Starting burst @ %llu\n", __FUNCTION__,
+                            (unsigned long long)s->meta.curr_timestamp);
+            }
+        }
+    } else if (user_meta->flags & BLADERF_META_FLAG_TX_NOW) {
+        log_debug("%s: The TX_NOW was specified without BURST_START.\n",
+                __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    user_meta->status = 0;
+    return 0;
+}
+
+/* Check whether the caller's metadata requests that the current burst be
+ * ended, and thus that the current buffer be flushed. */
+static int tx_meta_check_end(struct bladerf_sync *s,
+                             struct bladerf_metadata *user_meta, bool *flush)
+{
+    *flush = false;
+
+    if (user_meta->flags & BLADERF_META_FLAG_TX_BURST_END) {
+        if (s->meta.in_burst) {
+            *flush = true;
+        } else {
+            log_debug("%s: BURST_END provided while not in a burst.\n",
+                      __FUNCTION__);
+            return BLADERF_ERR_INVAL;
+        }
+    }
+
+    return 0;
+}
+
+/* Leave the current burst if the caller's metadata ended it, and report any
+ * underruns that have been counted since the previous call. A burst is not
+ * ended by a non-blocking call that could not write all of its samples
+ * (`partial`), as the caller continues it with the remainder. */
+static inline void tx_meta_end(struct bladerf_sync *s,
+                               struct bladerf_metadata *user_meta,
+                               bool partial)
+{
+    uint64_t underruns;
+
+    if (!format_has_metadata(s->stream_config.format)) {
+        return;
+    }
+
+    if ((user_meta->flags & BLADERF_META_FLAG_TX_BURST_END) && !partial) {
+        s->meta.in_burst = false;
+        s->meta.now = false;
+        s->meta.drop_late = false;
+        s->meta.burst_ended = true;
+    }
+
+    underruns = ATOMIC_LOAD_ACQUIRE(&s->stats.underruns);
+
+    user_meta->status &= ~BLADERF_META_STATUS_UNDERRUN;
+    if (underruns != s->stats.underruns_reported) {
+        user_meta->status |= BLADERF_META_STATUS_UNDERRUN;
+        s->stats.underruns_reported = underruns;
+    }
+}
+
+/* Step the TX state machine through the states that precede the filling of
+ * an available buffer: starting the worker, waiting for an empty buffer,
+ * and preparing a buffer for use. */
+static int tx_buffer_state_step(struct bladerf_sync *s, unsigned int timeout_ms)
+{
+    int status = 0;
+    struct buffer_mgmt *b = &s->buf_mgmt;
+
+    switch (s->state) {
+        case SYNC_STATE_CHECK_WORKER: {
+            int stream_error;
+            sync_worker_state worker_state =
+                sync_worker_get_state(s->worker, &stream_error);
+
+            if (sync_is_shutdown(s)) {
+                status = BLADERF_ERR_INVAL;
+            } else if (stream_error != 0) {
+                status = stream_error;
+            } else {
+                if (worker_state == SYNC_WORKER_STATE_IDLE) {
+                    /* No need to reset any buffer managment for TX since
+                     * the TX stream does not submit an initial set of
+                     * buffers.  Therefore the RESET_BUF_MGMT state is
+                     * skipped here. */
+                    s->state = SYNC_STATE_START_WORKER;
+                }
+            }
+            break;
+        }
+
+        case SYNC_STATE_RESET_BUF_MGMT:
+            assert(!"Bug");
+            break;
+
+        case SYNC_STATE_START_WORKER:
+            sync_worker_submit_request(s->worker, SYNC_WORKER_START);
+
+            status = sync_worker_wait_for_state(
+                    s->worker,
+                    SYNC_WORKER_STATE_RUNNING,
+                    SYNC_WORKER_START_TIMEOUT_MS);
+
+            if (status == 0) {
+                s->state = SYNC_STATE_WAIT_FOR_BUFFER;
+                log_debug("%s: Worker is now running.\n", __FUNCTION__);
+            }
+            break;
+
+        case SYNC_STATE_WAIT_FOR_BUFFER:
+            /* Check the buffer state, as the worker may have consumed one
+             * since we last queried the status */
+            if (buffer_available(s)) {
+                s->state = SYNC_STATE_BUFFER_READY;
+            } else {
+                status = wait_for_buffer(s, timeout_ms,
+                                         __FUNCTION__, prod_idx(b));
+            }
+            break;
+
+        case SYNC_STATE_BUFFER_READY:
+            b->partial_off = 0;
+
+            switch (s->stream_config.format) {
+                case BLADERF_FORMAT_SC16_Q11:
+                case BLADERF_FORMAT_PSD_U32:
+                case BLADERF_FORMAT_SC16_Q11_PACKED:
+                case BLADERF_FORMAT_SC8_Q7:
+                case BLADERF_FORMAT_TX_SYMBOLS:
+                    s->state = SYNC_STATE_USING_BUFFER;
+                    break;
+
+                case BLADERF_FORMAT_SC16_Q11_META:
+                case BLADERF_FORMAT_SC8_Q7_META:
+                    s->state = SYNC_STATE_USING_BUFFER_META;
+                    s->meta.curr_msg_off = 0;
+                    s->meta.msg_num = 0;
+                    break;
+
+                default:
+                    assert(!"Invalid stream format");
+                    status = BLADERF_ERR_UNEXPECTED;
+            }
+            break;
+
+        default:
+            assert(!"Invalid state");
+            status = BLADERF_ERR_UNEXPECTED;
+    }
+
+    return status;
+}
+
+/* Lay out the header of the current message in the current buffer. */
+static inline void tx_fill_msg_header(struct bladerf_sync *s)
+{
+    struct buffer_mgmt *b = &s->buf_mgmt;
+    uint8_t *buf_dest = (uint8_t*)b->buffers[prod_idx(b)];
+
+    s->meta.curr_msg = buf_dest + s->dev->msg_size * s->meta.msg_num;
+
+    log_verbose("%s: Set curr_msg to: %p (buf @ %p)\n",
+                 __FUNCTION__, s->meta.curr_msg, buf_dest);
+
+    s->meta.curr_msg_off = 0;
+
+    if (s->meta.now) {
+        metadata_set(s->meta.curr_msg, 0, 0);
+    } else {
+        metadata_set(s->meta.curr_msg, s->meta.curr_timestamp, 0);
+    }
+
+    if (s->meta.drop_late) {
+        metadata_set_tx_drop_late(s->meta.curr_msg);
+    }
+
+    s->meta.state = SYNC_META_STATE_SAMPLES;
+
+    log_verbose("%s: Filled in header (t=%llu)\n",
+                __FUNCTION__, (unsigned long long)s->meta.curr_timestamp);
+}
+
+/* End the current message after the samples written to it thus far. The
+ * FPGA transmits zeros from there until the next message's timestamp, so the
+ * timeline only advances by any sample needed to complete the last word. */
+static void tx_gate_msg(struct bladerf_sync *s)
+{
+    const size_t bytes = samples2bytes(s, s->meta.curr_msg_off);
+    const size_t words = (bytes + 3) / 4;
+    const size_t pad = words * 4 - bytes;
+
+    memset(s->meta.curr_msg + METADATA_HEADER_SIZE + bytes, 0, pad);
+    metadata_set_tx_words(s->meta.curr_msg, (uint32_t) words);
+
+    if (s->meta.curr_msg_off != 0) {
+        s->meta.curr_timestamp += pad / s->stream_config.bytes_per_sample;
+    }
+
+    log_verbose("%s: Gated message after %u words\n",
+                __FUNCTION__, (unsigned int) words);
+
+    s->meta.curr_msg_off = s->meta.samples_per_msg;
+}
+
+/* Copy samples into buffers, submitting them as they are filled. If `flush`
+ * is set, the remainder of the current buffer is zeroed and submitted after
+ * all samples have been written. A NULL `samples_src` writes `num_samples`
+ * zeros.
+ *
+ * tx_write_loop() handles formats without metadata, and tx_write_loop_meta()
+ * those with it. The handle's ops select between them. */
+static int tx_write_loop(struct bladerf_sync *s, const uint8_t *samples_src,
+                         unsigned int num_samples, bool flush,
+                         unsigned int timeout_ms, unsigned int *num_written)
+{
+    struct buffer_mgmt *b = &s->buf_mgmt;
+
+    int status = 0;
+    unsigned int samples_written = 0;
+    unsigned int samples_to_copy = 0;
+    const unsigned int samples_per_buffer = s->stream_config.samples_per_buffer;
+    uint8_t *buf_dest = NULL;
+
+    /* Without messages to pad, there is nothing further to flush here */
+    (void) flush;
+
+    while (status == 0 && samples_written < num_samples) {
+
+        switch (s->state) {
+            case SYNC_STATE_CHECK_WORKER:
+            case SYNC_STATE_RESET_BUF_MGMT:
+            case SYNC_STATE_START_WORKER:
+            case SYNC_STATE_WAIT_FOR_BUFFER:
+            case SYNC_STATE_BUFFER_READY:
+                status = tx_buffer_state_step(s, timeout_ms);
+                break;
+
+            case SYNC_STATE_USING_BUFFER:
+                buf_dest = (uint8_t*)b->buffers[prod_idx(b)];
+                samples_to_copy = uint_min(num_samples - samples_written,
+                                           samples_per_buffer - b->partial_off);
+
+                if (samples_src != NULL) {
+                    s->ops.copy(buf_dest + samples2bytes(s, b->partial_off),
+                                samples_src + user_samples2bytes(s, samples_written),
+                                samples_to_copy);
+                } else {
+                    memset(buf_dest + samples2bytes(s, b->partial_off), 0,
+                           samples2bytes(s, samples_to_copy));
+                }
+
+                b->partial_off += samples_to_copy;
+                samples_written += samples_to_copy;
+
+                log_verbose("%s: Buffered %u samples from caller\n",
+                            __FUNCTION__, samples_to_copy);
+
+                if (b->partial_off >= samples_per_buffer) {
+                    /* Check for symptom of out-of-bounds accesses */
+                    assert(b->partial_off == samples_per_buffer);
+
+                    /* Submit buffer and advance to the next one */
+                    status = advance_tx_buffer(s, b);
+                }
+                break;
+
+            default:
+                assert(!"Invalid state");
+                status = BLADERF_ERR_UNEXPECTED;
+        }
+    }
+
+    if (num_written != NULL) {
+        *num_written = samples_written;
+    }
+
+    return status;
+}
+
+static int tx_write_loop_meta(struct bladerf_sync *s,
+                              const uint8_t *samples_src,
+                              unsigned int num_samples, bool flush,
+                              unsigned int timeout_ms,
+                              unsigned int *num_written)
+{
+    struct buffer_mgmt *b = &s->buf_mgmt;
+
+    int status = 0;
+    unsigned int samples_written = 0;
+    unsigned int samples_to_copy = 0;
+
+    while (status == 0 && ((samples_written < num_samples) || flush) ) {
+
+        switch (s->state) {
+            case SYNC_STATE_CHECK_WORKER:
+            case SYNC_STATE_RESET_BUF_MGMT:
+            case SYNC_STATE_START_WORKER:
+            case SYNC_STATE_WAIT_FOR_BUFFER:
+            case SYNC_STATE_BUFFER_READY:
+                status = tx_buffer_state_step(s, timeout_ms);
+                break;
+
+            case SYNC_STATE_USING_BUFFER_META: /* SC16Q11 buffers w/ metadata */
+                switch (s->meta.state) {
+
+                    case SYNC_META_STATE_HEADER:
+                        tx_fill_msg_header(s);
+                        break;
+
+                    case SYNC_META_STATE_SAMPLES:
+                        samples_to_copy =
+                            uint_min(num_samples - samples_written,
+                                     left_in_msg(s));
+
+                        if (samples_to_copy != 0) {
+                            uint8_t *msg_dest =
+                                s->meta.curr_msg + METADATA_HEADER_SIZE +
+                                samples2bytes(s, s->meta.curr_msg_off);
+
+                            /* We have user data (or zeros) to copy into the
+                             * current message within the buffer */
+                            if (samples_src != NULL) {
+                                s->ops.copy(msg_dest,
+                                            samples_src +
+                                              user_samples2bytes(s, samples_written),
+                                            samples_to_copy);
+                            } else {
+                                memset(msg_dest, 0,
+                                       samples2bytes(s, samples_to_copy));
+                            }
+
+                            s->meta.curr_msg_off += samples_to_copy;
+                            s->meta.curr_timestamp += samples_to_copy;
+                            samples_written += samples_to_copy;
+
+                            log_verbose("%s: Copied %u samples. "
+                                        "Currrent message offset is now: %u\n",
+                                        __FUNCTION__, samples_to_copy,
+                                        s->meta.curr_msg_off);
+
+                        }
+
+                        if (left_in_msg(s) != 0 && flush && s->meta.gated) {
+                            /* End this message here, and skip any that
+                             * remain in the buffer */
+                            assert(num_samples == samples_written);
+                            tx_gate_msg(s);
+                        } else if (left_in_msg(s) != 0 && flush) {
+                            /* We're ending this buffer early and need to
+                             * flush the remaining samples by setting all
+                             * samples in the messages to (0 + 0j) */
+                            const unsigned int to_zero = left_in_msg(s);
+
+                            const size_t off =
+                                METADATA_HEADER_SIZE +
+                                samples2bytes(s, s->meta.curr_msg_off);
+
+                            /* If we're here, we should have already copied
+                             * all requested data to the buffer */
+                            assert(num_samples == samples_written);
+
+                            memset(s->meta.curr_msg + off, 0,
+                                   samples2bytes(s, to_zero));
+
+                            log_verbose("%s: Flushed %u samples @ %u (0x%08x)\n",
+                                        __FUNCTION__,
+                                        to_zero, s->meta.curr_msg_off, off);
+
+                            s->meta.curr_msg_off += to_zero;
+                            s->meta.curr_timestamp += to_zero;
+
+                        }
+
+                        if (left_in_msg(s) == 0) {
+                            s->meta.msg_num++;
+                            s->meta.state = SYNC_META_STATE_HEADER;
+
+                            log_verbose("%s: Advancing to next message (%u)\n",
+                                        __FUNCTION__, s->meta.msg_num);
+                        }
+
+                        if (s->meta.msg_num >= s->meta.msg_per_buf) {
+                            assert(s->meta.msg_num == s->meta.msg_per_buf);
+
+                            /* Submit buffer of samples for transmission */
+                            status = advance_tx_buffer(s, b);
+
+                            s->meta.msg_num = 0;
+                            s->state = SYNC_STATE_WAIT_FOR_BUFFER;
+
+                            /* We want to clear the flush flag if we've written
+                             * all of our data, but keep it set if we have more
+                             * data and need wrap around to another buffer */
+                            flush = flush && (samples_written != num_samples);
+                        }
+
+                        break;
+
+                    default:
+                        assert(!"Invalid state");
+                        status = BLADERF_ERR_UNEXPECTED;
+                }
+                break;
+
+            default:
+                assert(!"Invalid state");
+                status = BLADERF_ERR_UNEXPECTED;
+        }
+    }
+
+    if (num_written != NULL) {
+        *num_written = samples_written;
+    }
+
+    return status;
+}
+
+static inline int tx_write_samples_count(struct bladerf_sync *s,
+                                         const uint8_t *samples_src,
+                                         unsigned int num_samples, bool flush,
+                                         unsigned int timeout_ms,
+                                         unsigned int *num_written)
+{
+    return s->ops.tx_write(s, samples_src, num_samples, flush, timeout_ms,
+                           num_written);
+}
+
+static inline int tx_write_samples(struct bladerf_sync *s,
+                                   const uint8_t *samples_src,
+                                   unsigned int num_samples, bool flush,
+                                   unsigned int timeout_ms)
+{
+    return tx_write_samples_count(s, samples_src, num_samples, flush,
+                                  timeout_ms, NULL);
+}
+
+/* Samples are waiting in a partially filled buffer */
+static bool tx_buffer_partial(const struct bladerf_sync *s)
+{
+    switch (s->state) {
+        case SYNC_STATE_USING_BUFFER:
+            return s->buf_mgmt.partial_off != 0;
+
+        case SYNC_STATE_USING_BUFFER_META:
+            return s->meta.msg_num != 0 ||
+                   s->meta.state == SYNC_META_STATE_SAMPLES;
+
+        default:
+            return false;
+    }
+}
+
+/* Zero the remainder of a partially filled buffer and submit it */
+static int tx_flush(struct bladerf_sync *s, unsigned int timeout_ms)
+{
+    const unsigned int samples_per_buffer = s->stream_config.samples_per_buffer;
+
+    if (!tx_buffer_partial(s)) {
+        return 0;
+    }
+
+    s->autoflush.start_us = 0;
+
+    if (s->state == SYNC_STATE_USING_BUFFER) {
+        return tx_write_samples(s, NULL,
+                                samples_per_buffer - s->buf_mgmt.partial_off,
+                                false, timeout_ms);
+    } else {
+        return tx_write_samples(s, NULL, 0, true, timeout_ms);
+    }
+}
+
+/* Flush a partially filled buffer once its samples have waited for longer
+ * than the auto-flush deadline. The wait is timed from the first call that
+ * left samples in the buffer. */
+static int tx_autoflush(struct bladerf_sync *s, unsigned int timeout_ms)
+{
+    struct sync_autoflush *f = &s->autoflush;
+    uint64_t now_us;
+
+    if (!f->enabled) {
+        return 0;
+    }
+
+    if (!tx_buffer_partial(s)) {
+        f->start_us = 0;
+        return 0;
+    }
+
+    now_us = async_stats_time_us();
+
+    if (f->start_us == 0) {
+        f->start_us = now_us;
+    }
+
+    if (now_us - f->start_us < f->deadline_us) {
+        return 0;
+    }
+
+    log_verbose("%s: Flushing buffer after %"PRIu64" us\n", __FUNCTION__,
+                now_us - f->start_us);
+
+    return tx_flush(s, timeout_ms);
+}
+
+/* Transmit samples, setting `num_written` (if non-NULL) to the number of
+ * samples written */
+static int tx_samples(struct bladerf *dev, void *samples,
+                      unsigned int num_samples,
+                      struct bladerf_metadata *user_meta,
+                      unsigned int timeout_ms, unsigned int *num_written)
+{
+    struct bladerf_sync *s = dev->sync[BLADERF_MODULE_TX];
+    unsigned int written = 0;
+    int status = 0;
+    bool flush = false;
+
+    if (s == NULL || samples == NULL) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (s->loan.samples != NULL) {
+        log_debug("%s: Acquired samples have not yet been committed.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (format_has_metadata(s->stream_config.format)) {
+        if (user_meta == NULL) {
+            log_debug("NULL metadata pointer passed to %s\n", __FUNCTION__);
+            return BLADERF_ERR_INVAL;
+        }
+
+        log_verbose("%s: called for %u samples.\n", __FUNCTION__, num_samples);
+
+        status = tx_meta_begin(s, user_meta);
+        if (status == 0) {
+            status = tx_meta_check_end(s, user_meta, &flush);
+        }
+
+        if (status != 0) {
+            return status;
+        }
+    }
+
+    status = tx_write_samples_count(s, (const uint8_t *) samples, num_samples,
+                                    flush, timeout_ms, &written);
+
+    tx_meta_end(s, user_meta,
+                status == BLADERF_ERR_WOULD_BLOCK && written != num_samples);
+
+    if (status == 0) {
+        status = tx_autoflush(s, timeout_ms);
+    }
+
+    if (num_written != NULL) {
+        *num_written = written;
+    }
+
+    return status;
+}
+
+int sync_tx(struct bladerf *dev, void *samples, unsigned int num_samples,
+             struct bladerf_metadata *user_meta, unsigned int timeout_ms)
+{
+    unsigned int written = 0;
+    int status;
+
+    PROBE2(sync_tx_entry, num_samples, timeout_ms);
+    status = tx_samples(dev, samples, num_samples, user_meta, timeout_ms,
+                        &written);
+    PROBE2(sync_tx_return, status, written);
+
+    return status;
+}
+
+int sync_tx_try(struct bladerf *dev, void *samples, unsigned int num_samples,
+                struct bladerf_metadata *user_meta,
+                unsigned int *num_transferred)
+{
+    struct bladerf_sync *s = dev->sync[BLADERF_MODULE_TX];
+    int status = 0;
+
+    *num_transferred = 0;
+
+    if (s == NULL) {
+        log_debug("%s: Sync interface is not configured.\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    s->nonblock = true;
+
+    /* Check for space before the caller's burst flags are acted upon, so
+     * that a call that writes nothing has no effect */
+    if (s->state == SYNC_STATE_CHECK_WORKER ||
+        s->state == SYNC_STATE_WAIT_FOR_BUFFER) {
+        status = try_for_buffer(s);
+    }
+
+    if (status == 0) {
+        status = tx_samples(dev, samples, num_samples, user_meta, 0,
+                            num_transferred);
+    }
+
+    s->nonblock = false;
+
+    /* A partial write is not a failure */
+    if (status == BLADERF_ERR_WOULD_BLOCK && *num_transferred != 0) {
+        status = 0;
+    }
+
+    return status;
+}
+
+int sync_get_fd(struct bladerf_sync *s, int *fd)
+{
+    int status = 0;
+
+    if (s == NULL) {
+        log_debug("%s: Sync interface is not configured.\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (s->buf_mgmt.ready_fd[0] < 0) {
+        status = ready_fd_create(&s->buf_mgmt);
+    }
+
+    if (status == 0) {
+        *fd = s->buf_mgmt.ready_fd[0];
+    }
+
+    return status;
+}
+
+static int tx_burst_cmp(const void *a, const void *b)
+{
+    const struct bladerf_tx_burst *burst_a = (const struct bladerf_tx_burst *) a;
+    const struct bladerf_tx_burst *burst_b = (const struct bladerf_tx_burst *) b;
+
+    if (burst_a->timestamp < burst_b->timestamp) {
+        return -1;
+    } else if (burst_a->timestamp > burst_b->timestamp) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+/* Samples remaining in the message currently being filled, or 0 if we're at
+ * a message boundary (i.e., the next header has not yet been written) */
+static inline unsigned int tx_msg_remaining(struct bladerf_sync *s)
+{
+    if (s->state == SYNC_STATE_USING_BUFFER_META &&
+        s->meta.state == SYNC_META_STATE_SAMPLES) {
+        return left_in_msg(s);
+    } else {
+        return 0;
+    }
+}
+
+int sync_tx_bursts(struct bladerf *dev, struct bladerf_tx_burst *bursts,
+                   unsigned int num_bursts, unsigned int timeout_ms)
+{
+    struct bladerf_sync *s = dev->sync[BLADERF_MODULE_TX];
+    int status = 0;
+    unsigned int i;
+
+    if (s == NULL || bursts == NULL) {
+        log_debug("NULL pointer passed to %s\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (!format_has_metadata(s->stream_config.format)) {
+        log_debug("%s: Bursts require a metadata format.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (s->loan.samples != NULL) {
+        log_debug("%s: Acquired samples have not yet been committed.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (s->meta.in_burst) {
+        log_debug("%s: A burst started via sync_tx() is still in progress.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (num_bursts == 0) {
+        return 0;
+    }
+
+    qsort(bursts, num_bursts, sizeof(bursts[0]), tx_burst_cmp);
+
+    /* Validate the whole schedule before writing anything */
+    if (bursts[0].timestamp < s->meta.curr_timestamp) {
+        log_debug("%s: First burst @ %llu is in the past: current=%llu\n",
+                  __FUNCTION__, (unsigned long long) bursts[0].timestamp,
+                  (unsigned long long) s->meta.curr_timestamp);
+        return BLADERF_ERR_TIME_PAST;
+    }
+
+    for (i = 0; i < num_bursts; i++) {
+        if (bursts[i].samples == NULL && bursts[i].num_samples != 0) {
+            log_debug("%s: Burst %u has NULL samples.\n", __FUNCTION__, i);
+            return BLADERF_ERR_INVAL;
+        }
+
+        if (i > 0 && bursts[i].timestamp <
+                     bursts[i - 1].timestamp + bursts[i - 1].num_samples) {
+            log_debug("%s: Burst @ %llu overlaps the preceding burst.\n",
+                      __FUNCTION__, (unsigned long long) bursts[i].timestamp);
+            return BLADERF_ERR_INVAL;
+        }
+    }
+
+    s->meta.in_burst = true;
+    s->meta.now = false;
+    s->meta.drop_late = false;
+
+    for (i = 0; i < num_bursts && status == 0; i++) {
+        const uint64_t gap = bursts[i].timestamp - s->meta.curr_timestamp;
+        const unsigned int remaining = tx_msg_remaining(s);
+
+        if (gap <= remaining) {
+            /* Pad the gap with zeros within the current message */
+            status = tx_write_samples(s, NULL, (unsigned int) gap, false,
+                                      timeout_ms);
+        } else {
+            /* Pad out (or end) the current message and start the next one at
+             * the burst's timestamp, rather than flushing the entire buffer */
+            if (s->meta.gated && remaining != 0) {
+                tx_gate_msg(s);
+            } else {
+                status = tx_write_samples(s, NULL, remaining, false,
+                                          timeout_ms);
+            }
+            s->meta.curr_timestamp = bursts[i].timestamp;
+        }
+
+        if (status == 0) {
+            status = tx_write_samples(s, (const uint8_t *) bursts[i].samples,
+                                      bursts[i].num_samples, false,
+                                      timeout_ms);
+        }
+    }
+
+    /* Submit everything scheduled thus far */
+    if (status == 0 && s->state == SYNC_STATE_USING_BUFFER_META) {
+        status = tx_write_samples(s, NULL, 0, true, timeout_ms);
+    }
+
+    s->meta.in_burst = false;
+
+    return status;
+}
+
+/* End the message currently being filled, if any, such that the next
+ * message written is at a message boundary */
+static int tx_end_msg(struct bladerf_sync *s)
+{
+    struct buffer_mgmt *b = &s->buf_mgmt;
+
+    if (s->state != SYNC_STATE_USING_BUFFER_META ||
+        s->meta.state != SYNC_META_STATE_SAMPLES) {
+        return 0;
+    }
+
+    if (s->meta.curr_msg_off == 0) {
+        /* Nothing has been written after the header, so it may be reused */
+        s->meta.state = SYNC_META_STATE_HEADER;
+        return 0;
+    }
+
+    tx_gate_msg(s);
+
+    s->meta.msg_num++;
+    s->meta.state = SYNC_META_STATE_HEADER;
+
+    if (s->meta.msg_num >= s->meta.msg_per_buf) {
+        s->meta.msg_num = 0;
+        s->state = SYNC_STATE_WAIT_FOR_BUFFER;
+        return advance_tx_buffer(s, b);
+    }
+
+    return 0;
+}
+
+/* Write a gated message whose reserved word is `resv`, and whose timestamp
+ * field is `field`, followed by `num_words` words. The buffer is submitted
+ * once it has been filled. */
+static int tx_write_cmd_msg(struct bladerf_sync *s, uint32_t resv,
+                            uint64_t field, const uint32_t *words,
+                            unsigned int num_words, unsigned int timeout_ms)
+{
+    struct buffer_mgmt *b = &s->buf_mgmt;
+    int status;
+
+    status = tx_end_msg(s);
+
+    while (status == 0 && s->state != SYNC_STATE_USING_BUFFER_META) {
+        status = tx_buffer_state_step(s, timeout_ms);
+    }
+
+    if (status != 0) {
+        return status;
+    }
+
+    s->meta.curr_msg = (uint8_t *) b->buffers[prod_idx(b)] +
+                       s->dev->msg_size * s->meta.msg_num;
+
+    metadata_set(s->meta.curr_msg, field, 0);
+    metadata_set_resv(s->meta.curr_msg, METADATA_TX_GATED | resv |
+                                        (num_words & METADATA_TX_WORDS_MASK));
+
+    if (num_words != 0) {
+        memcpy(s->meta.curr_msg + METADATA_HEADER_SIZE, words,
+               num_words * sizeof(words[0]));
+    }
+
+    log_verbose("%s: Wrote command message 0x%08x with %u words\n",
+                __FUNCTION__, resv, num_words);
+
+    s->meta.msg_num++;
+
+    if (s->meta.msg_num >= s->meta.msg_per_buf) {
+        s->meta.msg_num = 0;
+        s->state = SYNC_STATE_WAIT_FOR_BUFFER;
+        status = advance_tx_buffer(s, b);
+    }
+
+    return status;
+}
+
+static int tx_waveform_check(struct bladerf_sync *s, unsigned int id)
+{
+    if (s == NULL) {
+        return BLADERF_ERR_INVAL;
+    } else if (!format_has_metadata(s->stream_config.format)) {
+        log_debug("%s: Waveforms require a metadata format.\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (s->loan.samples != NULL) {
+        log_debug("%s: Acquired samples have not yet been committed.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (s->meta.in_burst) {
+        log_debug("%s: A burst started via sync_tx() is still in progress.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (id >= BLADERF_TX_WAVEFORMS) {
+        log_debug("%s: Invalid waveform ID: %u\n", __FUNCTION__, id);
+        return BLADERF_ERR_INVAL;
+    } else if (version_less_than(&s->dev->fpga_version, 0, 1, 22)) {
+        log_debug("%s: Waveforms require FPGA v0.1.22 or later.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    return 0;
+}
+
+/* Find the lowest address at which `len` samples fit in waveform memory
+ * without overlapping any waveform other than `id` */
+static bool tx_waveform_alloc(const struct tx_waveform *waveforms,
+                              unsigned int id, unsigned int len,
+                              unsigned int *base)
+{
+    unsigned int addr = 0;
+    unsigned int i = 0;
+
+    while (i < BLADERF_TX_WAVEFORMS) {
+        const unsigned int start = waveforms[i].base;
+        const unsigned int end = start + waveforms[i].len;
+
+        if (i != id && waveforms[i].len != 0 &&
+            addr < end && start < addr + len) {
+            /* Move past this waveform, and check the others again */
+            addr = end;
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+
+    if (addr + len > BLADERF_TX_WAVEFORM_MAX_SAMPLES) {
+        return false;
+    }
+
+    *base = addr;
+    return true;
+}
+
+int sync_tx_load_waveform(struct bladerf *dev, unsigned int id,
+                          const int16_t *samples, unsigned int num_samples,
+                          unsigned int timeout_ms)
+{
+    struct bladerf_sync *s = dev->sync[BLADERF_MODULE_TX];
+    const unsigned int words_per_msg =
+        (unsigned int) (dev->msg_size - METADATA_HEADER_SIZE) / 4;
+    uint32_t words[BLADERF_TX_WAVEFORM_MAX_SAMPLES];
+    unsigned int base = 0;
+    unsigned int off = 0;
+    unsigned int i;
+    int status;
+
+    status = tx_waveform_check(s, id);
+    if (status != 0) {
+        return status;
+    }
+
+    if (samples == NULL && num_samples != 0) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (!tx_waveform_alloc(dev->tx_waveforms, id, num_samples, &base)) {
+        log_debug("%s: Insufficient waveform memory for %u samples.\n",
+                  __FUNCTION__, num_samples);
+        return BLADERF_ERR_MEM;
+    }
+
+    for (i = 0; i < num_samples; i++) {
+        const uint16_t i_le = HOST_TO_LE16((uint16_t) samples[2 * i]);
+        const uint16_t q_le = HOST_TO_LE16((uint16_t) samples[2 * i + 1]);
+
+        memcpy(&words[i], &i_le, sizeof(i_le));
+        memcpy((uint8_t *) &words[i] + sizeof(i_le), &q_le, sizeof(q_le));
+    }
+
+    /* The FPGA records the waveform's extent from each message, so that an
+     * empty load removes the waveform with a single header */
+    do {
+        const unsigned int n = uint_min(num_samples - off, words_per_msg);
+        const uint32_t resv = METADATA_TX_LOAD | METADATA_TX_WAVEFORM_ID(id);
+        const uint64_t field =
+            METADATA_TX_LOAD_ADDR(base + off, base, num_samples);
+
+        status = tx_write_cmd_msg(s, resv, field, &words[off], n, timeout_ms);
+        off += n;
+    } while (status == 0 && off < num_samples);
+
+    if (status == 0) {
+        dev->tx_waveforms[id].base = (uint16_t) base;
+        dev->tx_waveforms[id].len = (uint16_t) num_samples;
+    } else {
+        /* The FPGA's copy may now be incomplete */
+        dev->tx_waveforms[id].len = 0;
+    }
+
+    return status;
+}
+
+int sync_tx_play_waveform(struct bladerf *dev, unsigned int id,
+                          uint64_t timestamp, unsigned int timeout_ms)
+{
+    struct bladerf_sync *s = dev->sync[BLADERF_MODULE_TX];
+    int status;
+
+    status = tx_waveform_check(s, id);
+    if (status != 0) {
+        return status;
+    }
+
+    if (dev->tx_waveforms[id].len == 0) {
+        log_debug("%s: Waveform %u has not been loaded.\n", __FUNCTION__, id);
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (timestamp < s->meta.curr_timestamp) {
+        log_debug("%s: Playback @ %llu is in the past: current=%llu\n",
+                  __FUNCTION__, (unsigned long long) timestamp,
+                  (unsigned long long) s->meta.curr_timestamp);
+        return BLADERF_ERR_TIME_PAST;
+    }
+
+    status = tx_write_cmd_msg(s, METADATA_TX_PLAY |
+                                 METADATA_TX_WAVEFORM_ID(id),
+                              timestamp, NULL, 0, timeout_ms);
+
+    if (status == 0) {
+        s->meta.now = false;
+        s->meta.curr_timestamp = timestamp + dev->tx_waveforms[id].len;
+    }
+
+    return status;
+}
+
+int sync_tx_acquire(struct bladerf *dev, void **samples,
+                    unsigned int *num_samples,
+                    struct bladerf_metadata *user_meta,
+                    unsigned int timeout_ms)
+{
+    struct bladerf_sync *s = dev->sync[BLADERF_MODULE_TX];
+    struct buffer_mgmt *b;
+    int status = 0;
+
+    if (s == NULL || samples == NULL || num_samples == NULL) {
+        log_debug("NULL pointer passed to %s\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (s->loan.samples != NULL) {
+        log_debug("%s: Previously acquired samples have not been committed.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (converts_samples(s)) {
+        log_debug("%s: Converted samples cannot be lent.\n", __FUNCTION__);
+        return BLADERF_ERR_UNSUPPORTED;
+    }
 
-                                s->meta.msg_num += timestamp_to_msg(s, time_delta);
+    if (format_has_metadata(s->stream_config.format)) {
+        if (user_meta == NULL) {
+            log_debug("NULL metadata pointer passed to %s\n", __FUNCTION__);
+            return BLADERF_ERR_INVAL;
+        }
 
-                                log_verbose("%s: Seeking to message %u.\n",
-                                            __FUNCTION__, s->meta.msg_num);
-                            }
-                        }
-                        break;
+        status = tx_meta_begin(s, user_meta);
+        if (status != 0) {
+            return status;
+        }
+    }
 
-                    default:
-                        assert(!"Invalid state");
-                        status = BLADERF_ERR_UNEXPECTED;
-                }
+    b = &s->buf_mgmt;
 
-                MUTEX_UNLOCK(&b->lock);
+    while (status == 0 && s->loan.samples == NULL) {
+        switch (s->state) {
+            case SYNC_STATE_CHECK_WORKER:
+            case SYNC_STATE_RESET_BUF_MGMT:
+            case SYNC_STATE_START_WORKER:
+            case SYNC_STATE_WAIT_FOR_BUFFER:
+            case SYNC_STATE_BUFFER_READY:
+                status = tx_buffer_state_step(s, timeout_ms);
                 break;
-        }
-    }
 
-    if (user_meta) {
-        user_meta->actual_count = samples_returned;
-    }
+            case SYNC_STATE_USING_BUFFER:
+                s->loan.samples = (uint8_t*)b->buffers[prod_idx(b)] +
+                                    samples2bytes(s, b->partial_off);
 
-    return status;
-}
+                s->loan.num_samples =
+                    s->stream_config.samples_per_buffer - b->partial_off;
+                break;
 
-/* Assumes buffer lock is held */
-static int advance_tx_buffer(struct bladerf_sync *s, struct buffer_mgmt *b)
-{
-    int status;
+            case SYNC_STATE_USING_BUFFER_META:
+                if (s->meta.state == SYNC_META_STATE_HEADER) {
+                    tx_fill_msg_header(s);
+                }
 
-    log_verbose("%s: Marking buf[%u] full\n", __FUNCTION__, b->prod_i);
-    b->status[b->prod_i] = SYNC_BUFFER_IN_FLIGHT;
+                s->loan.samples = s->meta.curr_msg + METADATA_HEADER_SIZE +
+                                    samples2bytes(s, s->meta.curr_msg_off);
 
-    /* This call may block and it results in a per-stream lock being held, so
-     * the buffer lock must be dropped.
-     *
-     * A callback may occur in the meantime, but this will not touch the status
-     * for this this buffer, or the producer index.
-     */
-    MUTEX_UNLOCK(&b->lock);
-    status = async_submit_stream_buffer(s->worker->stream,
-                                        b->buffers[b->prod_i],
-                                        s->stream_config.timeout_ms);
-    MUTEX_LOCK(&b->lock);
+                s->loan.num_samples = left_in_msg(s);
+                break;
+        }
+    }
 
     if (status == 0) {
-        b->prod_i = (b->prod_i + 1) % b->num_buffers;
+        *samples = s->loan.samples;
+        *num_samples = s->loan.num_samples;
 
-        /* Go handle the next buffer, if we have one available.  Otherwise,
-         * check up on the worker's state and restart it if needed. */
-        if (b->status[b->prod_i] == SYNC_BUFFER_EMPTY) {
-            s->state = SYNC_STATE_BUFFER_READY;
-        } else {
-            s->state = SYNC_STATE_CHECK_WORKER;
-        }
-    } else {
-        log_debug("%s: Failed to advance buffer: %s\n",
-                  __FUNCTION__, bladerf_strerror(status));
+        log_verbose("%s: Lent %u samples to caller\n",
+                    __FUNCTION__, s->loan.num_samples);
     }
 
     return status;
 }
 
-int sync_tx(struct bladerf *dev, void *samples, unsigned int num_samples,
-             struct bladerf_metadata *user_meta, unsigned int timeout_ms)
+int sync_tx_commit(struct bladerf *dev, void *samples,
+                   unsigned int num_samples,
+                   struct bladerf_metadata *user_meta)
 {
     struct bladerf_sync *s = dev->sync[BLADERF_MODULE_TX];
-    struct buffer_mgmt *b = NULL;
-
-    int status = 0;
-    unsigned int samples_written = 0;
-    unsigned int samples_to_copy = 0;
-    unsigned int samples_per_buffer = 0;
-    uint8_t *samples_src = (uint8_t*)samples;
-    uint8_t *buf_dest = NULL;
+    struct buffer_mgmt *b;
     bool flush = false;
+    int status = 0;
 
     if (s == NULL || samples == NULL) {
+        log_debug("NULL pointer passed to %s\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (samples != s->loan.samples) {
+        log_debug("%s: Provided samples are not the current loan.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    } else if (num_samples > s->loan.num_samples) {
+        log_debug("%s: Committing %u samples, but only %u were lent.\n",
+                  __FUNCTION__, num_samples, s->loan.num_samples);
         return BLADERF_ERR_INVAL;
     }
 
-    if (s->stream_config.format == BLADERF_FORMAT_SC16_Q11_META) {
+    if (format_has_metadata(s->stream_config.format)) {
         if (user_meta == NULL) {
             log_debug("NULL metadata pointer passed to %s\n", __FUNCTION__);
             return BLADERF_ERR_INVAL;
         }
 
-        log_verbose("%s: called for %u samples.\n", __FUNCTION__, num_samples);
-
-        if (user_meta->flags & BLADERF_META_FLAG_TX_BURST_START) {
-            bool now = user_meta->flags & BLADERF_META_FLAG_TX_NOW;
-
-            if (s->meta.in_burst) {
-                log_debug("%s: BURST_START provided while already in a burst.\n",
-                          __FUNCTION__);
-                return BLADERF_ERR_INVAL;
-            } else if (!now && user_meta->timestamp < s->meta.curr_timestamp) {
-                log_debug("Provided timestamp=%llu is in past: "
-                          "current=%llu\n",
-                          (unsigned long long)user_meta->timestamp,
-                          (unsigned long long)s->meta.curr_timestamp);
-
-                return BLADERF_ERR_TIME_PAST;
-            } else {
-                s->meta.in_burst = true;
-                if (now) {
-                    s->meta.now = true;
-                    log_verbose("%s: Starting burst \"now\"\n",
-                                __FUNCTION__);
-                } else {
-                    s->meta.curr_timestamp = user_meta->timestamp;
-                    log_verbose("%s: Starting burst @ %llu\n", __FUNCTION__,
-                                (unsigned long long)s->meta.curr_timestamp);
-                }
-            }
-        } else if (user_meta->flags & BLADERF_META_FLAG_TX_NOW) {
-            log_debug("%s: The TX_NOW was specified without BURST_START.\n",
-                    __FUNCTION__);
-            return BLADERF_ERR_INVAL;
-        }
-
-        if (user_meta->flags & BLADERF_META_FLAG_TX_BURST_END) {
-            if (s->meta.in_burst) {
-                flush = true;
-            } else {
-                log_debug("%s: BURST_END provided while not in a burst.\n",
-                          __FUNCTION__);
-                return BLADERF_ERR_INVAL;
-            }
+        status = tx_meta_check_end(s, user_meta, &flush);
+        if (status != 0) {
+            return status;
         }
-
-        user_meta->status = 0;
     }
 
     b = &s->buf_mgmt;
-    samples_per_buffer = s->stream_config.samples_per_buffer;
 
-    while (status == 0 && ((samples_written < num_samples) || flush) ) {
+    s->loan.samples = NULL;
+    s->loan.num_samples = 0;
 
-        switch (s->state) {
-            case SYNC_STATE_CHECK_WORKER: {
-                int stream_error;
-                sync_worker_state worker_state =
-                    sync_worker_get_state(s->worker, &stream_error);
+    switch (s->state) {
+        case SYNC_STATE_USING_BUFFER:
+            b->partial_off += num_samples;
 
-                if (stream_error != 0) {
-                    status = stream_error;
-                } else {
-                    if (worker_state == SYNC_WORKER_STATE_IDLE) {
-                        /* No need to reset any buffer managment for TX since
-                         * the TX stream does not submit an initial set of
-                         * buffers.  Therefore the RESET_BUF_MGMT state is
-                         * skipped here. */
-                        s->state = SYNC_STATE_START_WORKER;
-                    }
-                }
-                break;
+            if (b->partial_off >= s->stream_config.samples_per_buffer) {
+                assert(b->partial_off == s->stream_config.samples_per_buffer);
+                status = advance_tx_buffer(s, b);
             }
+            break;
 
-            case SYNC_STATE_RESET_BUF_MGMT:
-                assert(!"Bug");
-                break;
-
-            case SYNC_STATE_START_WORKER:
-                sync_worker_submit_request(s->worker, SYNC_WORKER_START);
-
-                status = sync_worker_wait_for_state(
-                        s->worker,
-                        SYNC_WORKER_STATE_RUNNING,
-                        SYNC_WORKER_START_TIMEOUT_MS);
-
-                if (status == 0) {
-                    s->state = SYNC_STATE_WAIT_FOR_BUFFER;
-                    log_debug("%s: Worker is now running.\n", __FUNCTION__);
-                }
-                break;
-
-            case SYNC_STATE_WAIT_FOR_BUFFER:
-                MUTEX_LOCK(&b->lock);
+        case SYNC_STATE_USING_BUFFER_META:
+            s->meta.curr_msg_off += num_samples;
+            s->meta.curr_timestamp += num_samples;
 
-                /* Check the buffer state, as the worker may have consumed one
-                 * since we last queried the status */
-                if (b->status[b->prod_i] == SYNC_BUFFER_EMPTY) {
-                    s->state = SYNC_STATE_BUFFER_READY;
-                } else {
-                    status = wait_for_buffer(b, timeout_ms,
-                                             __FUNCTION__, b->prod_i);
-                }
+            if (left_in_msg(s) == 0) {
+                s->meta.msg_num++;
+                s->meta.state = SYNC_META_STATE_HEADER;
+            }
 
-                MUTEX_UNLOCK(&b->lock);
-                break;
+            if (s->meta.msg_num >= s->meta.msg_per_buf) {
+                assert(s->meta.msg_num == s->meta.msg_per_buf);
 
-            case SYNC_STATE_BUFFER_READY:
-                MUTEX_LOCK(&b->lock);
-                b->status[b->prod_i] = SYNC_BUFFER_PARTIAL;
-                b->partial_off = 0;
-                MUTEX_UNLOCK(&b->lock);
-
-                switch (s->stream_config.format) {
-                    case BLADERF_FORMAT_SC16_Q11:
-                        s->state = SYNC_STATE_USING_BUFFER;
-                        break;
+                status = advance_tx_buffer(s, b);
 
-                    case BLADERF_FORMAT_SC16_Q11_META:
-                        s->state = SYNC_STATE_USING_BUFFER_META;
-                        s->meta.curr_msg_off = 0;
-                        s->meta.msg_num = 0;
-                        break;
+                s->meta.msg_num = 0;
+                s->state = SYNC_STATE_WAIT_FOR_BUFFER;
+            }
+            break;
 
-                    default:
-                        assert(!"Invalid stream format");
-                        status = BLADERF_ERR_UNEXPECTED;
-                }
-                break;
+        default:
+            assert(!"Invalid state");
+            status = BLADERF_ERR_UNEXPECTED;
+    }
 
+    /* Zero and submit the remainder of a partially filled buffer */
+    if (status == 0 && flush && s->state == SYNC_STATE_USING_BUFFER_META) {
+        status = tx_write_samples(s, NULL, 0, true,
+                                  s->stream_config.timeout_ms);
+    }
 
-            case SYNC_STATE_USING_BUFFER:
-                MUTEX_LOCK(&b->lock);
+    tx_meta_end(s, user_meta, false);
 
-                buf_dest = (uint8_t*)b->buffers[b->prod_i];
-                samples_to_copy = uint_min(num_samples - samples_written,
-                                           samples_per_buffer - b->partial_off);
+    if (status == 0) {
+        status = tx_autoflush(s, s->stream_config.timeout_ms);
+    }
 
-                memcpy(buf_dest + samples2bytes(s, b->partial_off),
-                        samples_src + samples2bytes(s, samples_written),
-                        samples2bytes(s, samples_to_copy));
+    return status;
+}
 
-                b->partial_off += samples_to_copy;
-                samples_written += samples_to_copy;
+int sync_tx_flush(struct bladerf *dev, unsigned int timeout_ms)
+{
+    struct bladerf_sync *s = dev->sync[BLADERF_MODULE_TX];
 
-                log_verbose("%s: Buffered %u samples from caller\n",
-                            __FUNCTION__, samples_to_copy);
+    if (s == NULL) {
+        log_debug("%s: Sync interface is not configured.\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
 
-                if (b->partial_off >= samples_per_buffer) {
-                    /* Check for symptom of out-of-bounds accesses */
-                    assert(b->partial_off == samples_per_buffer);
+    if (s->loan.samples != NULL) {
+        log_debug("%s: Acquired samples have not yet been committed.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
 
-                    /* Submit buffer and advance to the next one */
-                    status = advance_tx_buffer(s, b);
-                }
+    return tx_flush(s, timeout_ms);
+}
 
-                MUTEX_UNLOCK(&b->lock);
-                break;
+int sync_set_autoflush(struct bladerf_sync *s, bool enable,
+                       unsigned int deadline_us)
+{
+    if (s == NULL || s->stream_config.module != BLADERF_MODULE_TX) {
+        log_debug("%s: TX sync interface is not configured.\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
 
-            case SYNC_STATE_USING_BUFFER_META: /* SC16Q11 buffers w/ metadata */
-                MUTEX_LOCK(&b->lock);
+    s->autoflush.enabled = enable;
+    s->autoflush.deadline_us = deadline_us;
+    s->autoflush.start_us = 0;
 
-                switch (s->meta.state) {
+    return 0;
+}
 
-                    case SYNC_META_STATE_HEADER:
-                        buf_dest = (uint8_t*)b->buffers[b->prod_i];
+int sync_set_autotune(struct bladerf_sync *s, bool enable,
+                      unsigned int min_transfers,
+                      unsigned int latency_budget_us)
+{
+    if (s == NULL) {
+        log_debug("%s: Sync interface is not configured.\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
 
-                        s->meta.curr_msg =
-                            buf_dest + dev->msg_size * s->meta.msg_num;
+    if (enable && (min_transfers == 0 ||
+                   min_transfers > s->stream_config.num_xfers)) {
+        log_debug("%s: min_transfers must be within [1, %u]\n",
+                  __FUNCTION__, s->stream_config.num_xfers);
+        return BLADERF_ERR_INVAL;
+    }
 
-                        log_verbose("%s: Set curr_msg to: %p (buf @ %p)\n",
-                                     __FUNCTION__, s->meta.curr_msg, buf_dest);
+    /* The worker reads this configuration when it starts the stream */
+    if (sync_worker_get_state(s->worker, NULL) == SYNC_WORKER_STATE_RUNNING) {
+        log_debug("%s: Autotuning will be (re)configured when the %s stream "
+                  "is restarted.\n", __FUNCTION__, MODULE_STR(s));
+    }
 
-                        s->meta.curr_msg_off = 0;
+    MUTEX_LOCK(&s->worker->state_lock);
+    s->autotune.enabled = enable;
+    s->autotune.min_xfers = min_transfers;
+    s->autotune.latency_budget_us = latency_budget_us;
+    MUTEX_UNLOCK(&s->worker->state_lock);
 
-                        if (s->meta.now) {
-                            metadata_set(s->meta.curr_msg, 0, 0);
-                        } else {
-                            metadata_set(s->meta.curr_msg,
-                                         s->meta.curr_timestamp, 0);
-                        }
+    return 0;
+}
 
-                        s->meta.state = SYNC_META_STATE_SAMPLES;
+int sync_set_continuity_check(struct bladerf_sync *s, bool enable,
+                              bladerf_discontinuity_cb cb, void *user_data)
+{
+    if (s == NULL) {
+        log_debug("%s: Sync interface is not configured.\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
 
-                        log_verbose("%s: Filled in header (t=%llu)\n",
-                                    __FUNCTION__,
-                                    (unsigned long long)s->meta.curr_timestamp);
-                        break;
+    if (enable && (s->stream_config.module != BLADERF_MODULE_RX ||
+                   !format_has_metadata(s->stream_config.format))) {
+        log_debug("%s: Continuity checking requires RX metadata.\n",
+                  __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
 
-                    case SYNC_META_STATE_SAMPLES:
-                        samples_to_copy =
-                            uint_min(num_samples - samples_written,
-                                     left_in_msg(s));
+    /* The first message checked establishes the expected timestamp */
+    s->continuity.enabled = enable;
+    s->continuity.cb = cb;
+    s->continuity.cb_data = user_data;
+    s->continuity.valid = false;
 
-                        if (samples_to_copy != 0) {
-                            /* We have user data to copy into the current
-                             * message within the buffer */
-                            memcpy(s->meta.curr_msg + METADATA_HEADER_SIZE +
-                                        samples2bytes(s, s->meta.curr_msg_off),
-                                   samples_src + samples2bytes(s, samples_written),
-                                   samples2bytes(s, samples_to_copy));
+    return 0;
+}
 
-                            s->meta.curr_msg_off += samples_to_copy;
-                            s->meta.curr_timestamp += samples_to_copy;
-                            samples_written += samples_to_copy;
+int sync_set_underrun_cb(struct bladerf_sync *s, bladerf_underrun_cb cb,
+                         void *user_data)
+{
+    if (s == NULL || s->stream_config.module != BLADERF_MODULE_TX) {
+        log_debug("%s: TX sync interface is not configured.\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
 
-                            log_verbose("%s: Copied %u samples. "
-                                        "Currrent message offset is now: %u\n",
-                                        __FUNCTION__, samples_to_copy,
-                                        s->meta.curr_msg_off);
+    MUTEX_LOCK(&s->buf_mgmt.lock);
+    s->underrun.cb = cb;
+    s->underrun.cb_data = user_data;
+    MUTEX_UNLOCK(&s->buf_mgmt.lock);
 
-                        }
+    return 0;
+}
 
-                        if (left_in_msg(s) != 0 && flush) {
-                            /* We're ending this buffer early and need to
-                             * flush the remaining samples by setting all
-                             * samples in the messages to (0 + 0j) */
-                            const unsigned int to_zero = left_in_msg(s);
+int sync_arm(struct bladerf_sync *s)
+{
+    int status = 0;
 
-                            const size_t off =
-                                METADATA_HEADER_SIZE +
-                                samples2bytes(s, s->meta.curr_msg_off);
+    if (s == NULL) {
+        log_debug("%s: Sync interface is not configured.\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
 
-                            /* If we're here, we should have already copied
-                             * all requested data to the buffer */
-                            assert(num_samples == samples_written);
+    /* Step through the same states the first RX or TX call would, stopping
+     * once the worker is running and the stream's transfers are in flight.
+     * None of these states block on sample data, so no timeout applies. */
+    while (status == 0 && s->state < SYNC_STATE_WAIT_FOR_BUFFER) {
+        if (s->stream_config.module == BLADERF_MODULE_RX) {
+            status = rx_buffer_state_step(s, 0);
+        } else {
+            status = tx_buffer_state_step(s, 0);
+        }
+    }
 
-                            memset(s->meta.curr_msg + off, 0,
-                                   samples2bytes(s, to_zero));
+    if (status == 0) {
+        log_debug("%s: %s stream is armed\n", __FUNCTION__, MODULE_STR(s));
+    }
 
-                            log_verbose("%s: Flushed %u samples @ %u (0x%08x)\n",
-                                        __FUNCTION__,
-                                        to_zero, s->meta.curr_msg_off, off);
+    return status;
+}
 
-                            s->meta.curr_msg_off += to_zero;
-                            s->meta.curr_timestamp += to_zero;
+int sync_get_stats(struct bladerf_sync *s, struct bladerf_stream_stats *stats)
+{
+    struct bladerf_stream *stream;
 
-                        }
+    if (s == NULL) {
+        log_debug("%s: Sync interface is not configured.\n", __FUNCTION__);
+        return BLADERF_ERR_INVAL;
+    }
 
-                        if (left_in_msg(s) == 0) {
-                            s->meta.msg_num++;
-                            s->meta.state = SYNC_META_STATE_HEADER;
+    memset(stats, 0, sizeof(*stats));
+    stats->overruns = ATOMIC_LOAD_ACQUIRE(&s->stats.overruns);
+    stats->resubmissions = ATOMIC_LOAD_ACQUIRE(&s->stats.resubmissions);
+    stats->underruns = ATOMIC_LOAD_ACQUIRE(&s->stats.underruns);
+    stats->discontinuities = s->stats.discontinuities;
+    stats->dropped_samples = s->stats.dropped_samples;
+    stats->fpga_overflows = ATOMIC_LOAD_ACQUIRE(&s->stats.fpga_overflows);
+    stats->fpga_dropped_samples =
+        ATOMIC_LOAD_ACQUIRE(&s->stats.fpga_dropped_samples);
+
+    if (s->stats.fpga_underflows_valid) {
+        uint32_t count;
+
+        /* The FPGA's 32-bit count is reported relative to sync_init() */
+        if (get_fpga_underflows(s->dev, &count)) {
+            stats->fpga_underruns = count - s->stats.fpga_underflows_base;
+        }
+    }
 
-                            log_verbose("%s: Advancing to next message (%u)\n",
-                                        __FUNCTION__, s->meta.msg_num);
-                        }
+    stats->fill_current = ATOMIC_LOAD_ACQUIRE(&s->stats.fill_current);
+    stats->fill_min = ATOMIC_LOAD_ACQUIRE(&s->stats.fill_min);
+    stats->fill_max = ATOMIC_LOAD_ACQUIRE(&s->stats.fill_max);
 
-                        if (s->meta.msg_num >= s->meta.msg_per_buf) {
-                            assert(s->meta.msg_num == s->meta.msg_per_buf);
+    /* No fill level has been recorded if we haven't started streaming */
+    if (stats->fill_min > stats->fill_max) {
+        stats->fill_min = stats->fill_max;
+    }
 
-                            /* Submit buffer of samples for transmission */
-                            status = advance_tx_buffer(s, b);
+    stream = s->worker->stream;
 
-                            s->meta.msg_num = 0;
-                            s->state = SYNC_STATE_WAIT_FOR_BUFFER;
+    MUTEX_LOCK(&stream->lock);
+    stats->transfers = stream->stats.transfers;
+    stats->short_transfers = stream->stats.short_transfers;
 
-                            /* We want to clear the flush flag if we've written
-                             * all of our data, but keep it set if we have more
-                             * data and need wrap around to another buffer */
-                            flush = flush && (samples_written != num_samples);
-                        }
+    memcpy(stats->callback_hist, stream->stats.callback_hist,
+           sizeof(stats->callback_hist));
 
-                        break;
+    memcpy(stats->turnaround_hist, stream->stats.turnaround_hist,
+           sizeof(stats->turnaround_hist));
+    MUTEX_UNLOCK(&stream->lock);
 
-                    default:
-                        assert(!"Invalid state");
-                        status = BLADERF_ERR_UNEXPECTED;
-                }
+    /* Fixed when the stream is initialized */
+    stats->numa_node = stream->numa_node;
+    stats->numa_buffers = stream->arena.numa_bound;
+    stats->thread_cpus = async_thread_cpus(stream, s->stream_config.module);
 
-                MUTEX_UNLOCK(&b->lock);
-                break;
-        }
-    }
+    stats->spin_waits = s->stats.spin_waits;
+    stats->blocking_waits = s->stats.blocking_waits;
+    memcpy(stats->wait_hist, s->stats.wait_hist, sizeof(stats->wait_hist));
 
-    if (s->stream_config.format == BLADERF_FORMAT_SC16_Q11_META &&
-        (user_meta->flags & BLADERF_META_FLAG_TX_BURST_END)) {
-        s->meta.in_burst = false;
-        s->meta.now = false;
-    }
+    get_event_stats(s->dev, &stats->event_polls, &stats->event_cpu_us);
+    stats->event_polls -= u64_min(stats->event_polls,
+                                  s->stats.event_polls_base);
+    stats->event_cpu_us -= u64_min(stats->event_cpu_us,
+                                   s->stats.event_cpu_us_base);
 
-    return status;
+    return 0;
 }
 
 unsigned int sync_buf2idx(struct buffer_mgmt *b, void *addr)
 {
     unsigned int i;
+    const uintptr_t base = (uintptr_t) b->buffers[0];
+    const uintptr_t p = (uintptr_t) addr;
+
+    /* Stream buffers are carved out of a single region at a fixed stride, so
+     * the index can be computed directly. The result is verified, falling
+     * back to a search for buffers that were allocated otherwise. */
+    if (b->num_buffers > 1 && p >= base) {
+        const uintptr_t stride = (uintptr_t) b->buffers[1] - base;
+
+        if (stride != 0 && (p - base) % stride == 0 &&
+            (p - base) / stride < b->num_buffers) {
+
+            i = (unsigned int) ((p - base) / stride);
+            if (b->buffers[i] == addr) {
+                return i;
+            }
+        }
+    }
 
     for (i = 0; i < b->num_buffers; i++) {
         if (b->buffers[i] == addr) {
@@ -966,4 +3636,3 @@ unsigned int sync_buf2idx(struct buffer_mgmt *b, void *addr)
     log_critical("Bug: Buffer not found.");
     return 0;
 }
-
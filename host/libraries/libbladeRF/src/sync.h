@@ -27,52 +27,138 @@
 
 #define MODULE_STR(s) module2str(s->stream_config.module)
 
+/* Fields written by the worker and fields written by the API side are kept
+ * on separate cache lines, so that each side's updates do not evict lines
+ * the other side is using. A full line of padding separates two groups
+ * regardless of how the enclosing structure happens to be aligned. */
+#ifndef SYNC_CACHE_LINE_SIZE
+#   define SYNC_CACHE_LINE_SIZE 64
+#endif
+
+#define SYNC_CACHE_PAD(name) char name[SYNC_CACHE_LINE_SIZE]
+
 /* These parameters are only written during sync_init */
 struct stream_config
 {
     bladerf_format format;
+
+    /* Format of the caller's samples. This differs from the format used in
+     * the buffers when sync calls convert samples. */
+    bladerf_format host_format;
     bladerf_module module;
 
     unsigned int samples_per_buffer;
     unsigned int num_xfers;
     unsigned int timeout_ms;
 
+    /* Time to busy-wait for a buffer before blocking on buf_ready.
+     * 0 implies blocking immediately. */
+    unsigned int spin_wait_us;
+
+    /* Spin for buffers until they're available or the call's timeout
+     * elapses, rather than blocking on buf_ready */
+    bool busy_poll;
+
     size_t bytes_per_sample;
 };
 
-typedef enum {
-    SYNC_BUFFER_EMPTY = 0,      /**< Buffer contains no data */
-    SYNC_BUFFER_PARTIAL,        /**< sync_rx/tx is currently emptying/filling */
-    SYNC_BUFFER_FULL,           /**< Buffer is full of data */
-    SYNC_BUFFER_IN_FLIGHT,      /**< Currently being transferred */
-} sync_buffer_status;
-
 typedef enum {
     SYNC_META_STATE_HEADER,       /**< Extract the metadata header */
     SYNC_META_STATE_SAMPLES,      /**< Process samples */
 } sync_meta_state;
 
+/* Buffer ownership is tracked via free-running counters, forming a
+ * single-producer/single-consumer ring between the worker's stream
+ * callbacks and the API-side sync_rx()/sync_tx() calls. Each counter is
+ * written by only one side and read by the other, so no lock is required
+ * in the data path. The counters may wrap, and their differences remain
+ * valid when they do. The buffer referred to by each counter is tracked by
+ * its owner as a separate index, wrapping at the number of buffers, as the
+ * counter modulo a number of buffers that isn't a power of two isn't
+ * continuous across the counter wrapping.
+ *
+ * RX:  [consumed, completed)   Filled buffers, ready to be (or being)
+ *                              emptied by the API
+ *      [completed, submitted)  In flight
+ *      [submitted, consumed+N) Empty, available for submission
+ *
+ * TX:  [completed, submitted)  In flight
+ *      [submitted, completed+N) Empty, available to be (or being) filled
+ *                               by the API
+ *
+ * The lock and condition variable are only used when the API side must
+ * block for a buffer, and for worker state transitions.
+ */
 struct buffer_mgmt {
-    sync_buffer_status *status;
-
+    /* Read-mostly */
     void **buffers;
     unsigned int num_buffers;
 
-    unsigned int prod_i;        /**< Producer index - next buffer to fill */
-    unsigned int cons_i;        /**< Consumer index - next buffer to empty */
+    bool *after_burst;          /**< TX: Set for each buffer that is the first
+                                 *   to be submitted after a burst ended.
+                                 *   Written by the API before the buffer is
+                                 *   submitted */
+
+    int ready_fd[2];                /**< Readiness descriptor for event
+                                     *   loops, as read and write ends (the
+                                     *   same eventfd on Linux), or -1 if it
+                                     *   has not been created */
+
+    SYNC_CACHE_PAD(pad_worker);
+
+    /* Written by the worker */
+    volatile unsigned int completed;  /**< Buffers returned by the stream */
+    unsigned int completed_idx;       /**< Index of the next buffer to be
+                                       *   returned by the stream */
+
+    /* Set upon a SW RX overrun, until the buffer that overran is returned
+     * again. The buffers returned before it were in flight behind it, so
+     * they're invalid and require resubmission. */
+    bool resubmitting;
+
+    SYNC_CACHE_PAD(pad_submitted);
+
+    volatile unsigned int submitted;  /**< Buffers submitted to the stream.
+                                       *   Written by the worker (RX) or
+                                       *   the API (TX) */
+    unsigned int submitted_idx;       /**< Index of the next buffer to be
+                                       *   submitted. Only accessed by the
+                                       *   side that owns `submitted` */
+
+    SYNC_CACHE_PAD(pad_api);
+
+    /* Written by the API */
+    volatile unsigned int consumed;   /**< Buffers emptied by the API (RX) */
+    unsigned int consumed_idx;        /**< Index of the buffer being
+                                       *   emptied by the API (RX) */
     unsigned int partial_off;   /**< Current index into partial buffer */
 
-    /* In the event of a SW RX overrun, this count is used to determine
-     * how many more transfers should be considered invalid and require
-     * resubmission */
-    unsigned int resubmit_count;
+    SYNC_CACHE_PAD(pad_wait);
 
+    /* Used by both sides only when the API side must wait */
+    volatile unsigned int waiting;  /**< Set while the API side is blocked
+                                     *   on buf_ready */
+
+    volatile unsigned int fd_armed; /**< Set by the API side when a
+                                     *   non-blocking call found no buffer,
+                                     *   so that the worker signals
+                                     *   ready_fd once one is available */
+
+    volatile unsigned int shutdown; /**< Set by sync_shutdown(). Sync calls
+                                     *   fail once this is set */
 
     MUTEX lock;
     pthread_cond_t  buf_ready;  /**< Buffer produced by RX callback, or
                                  *   buffer emptied by TX callback */
 };
 
+/* The index of the buffer following buffer `idx` */
+static inline unsigned int sync_buf_next(const struct buffer_mgmt *b,
+                                         unsigned int idx)
+{
+    return idx + 1 == b->num_buffers ? 0 : idx + 1;
+}
+
 /* State of API-side sync interface */
 typedef enum {
     SYNC_STATE_CHECK_WORKER,
@@ -84,29 +170,52 @@ typedef enum {
     SYNC_STATE_USING_BUFFER_META
 } sync_state;
 
+/* Metadata processing state. Apart from the message geometry, which the
+ * worker also reads, this is owned by the API side. */
 struct sync_meta
 {
+    unsigned int msg_per_buf;     /* Number of data messages per buffer */
+    unsigned int samples_per_msg; /* Number of samples within a message */
+
+    SYNC_CACHE_PAD(pad_state);
+
     sync_meta_state state;        /* State of metadata processing */
 
     uint8_t *curr_msg;            /* Points to current message in the buffer */
     size_t   curr_msg_off;        /* Offset into current message (samples),
                                    * ignoring the 4-samples worth of metadata */
-    unsigned int msg_per_buf;     /* Number of data messages per buffer */
     unsigned int msg_num;         /* Which message within the buffer are we in?
                                    * Range is: 0 to msg_per_buf   */
-    unsigned int samples_per_msg; /* Number of samples within a message */
 
     union {
         /* Used only for RX */
         struct {
             uint64_t msg_timestamp; /* Timestamp contained in the current message */
             uint32_t msg_flags;     /* Flags for the current message */
+            bool overflow_flags;    /* The FPGA reports RX FIFO overflows
+                                     * in msg_flags. Otherwise, msg_flags
+                                     * is 0. */
+            uint16_t msg_chan_mask; /* Channelizer channels in the current
+                                     * message, or 0 if untagged */
+            uint8_t msg_chan;       /* Channel of the message's first sample */
+            bool contiguous;        /* Samples have been returned since the
+                                     * stream was (re)started, so subsequent
+                                     * timestamps are expected to be
+                                     * contiguous */
         };
 
         /* Used only for TX */
         struct {
             bool in_burst;
             bool now;
+            bool gated;             /* The FPGA blanks the time between
+                                     * messages, so messages may be ended
+                                     * early instead of padded with zeros */
+            bool late_policy;       /* The FPGA can drop late messages */
+            bool drop_late;         /* Drop the current burst's messages if
+                                     * they arrive late */
+            bool burst_ended;       /* A burst has ended since the last
+                                     * buffer was submitted */
         };
     };
 
@@ -114,13 +223,166 @@ struct sync_meta
                                  * consumed up to */
 };
 
+/* Samples lent directly to the API caller via the zero-copy functions */
+struct sync_loan
+{
+    uint8_t *samples;           /* Start of lent samples. NULL if there is no
+                                 * outstanding loan */
+    unsigned int num_samples;   /* Number of samples lent */
+    unsigned int num_msgs;      /* Number of whole messages lent by
+                                 * sync_rx_acquire_msgs(), or 0 */
+};
+
+/* Stream statistics. The counters are only written by the worker, and may
+ * be read by the API side via ATOMIC_LOAD_ACQUIRE(). */
+struct sync_stats
+{
+    volatile uint64_t overruns;         /* RX overruns */
+    volatile uint64_t resubmissions;    /* RX transfers resubmitted due to an
+                                         * overrun */
+    volatile uint64_t underruns;        /* TX underruns */
+    bool tx_drained;                    /* All TX buffers have been sent.
+                                         * Only accessed by the worker. */
+
+    /* Buffer ring fill level. For RX, the number of filled buffers available
+     * to the API. For TX, the number of buffers awaiting transmission. */
+    volatile unsigned int fill_current;
+    volatile unsigned int fill_min;
+    volatile unsigned int fill_max;
+
+    /* FPGA RX FIFO overflows reported by message headers, and the samples
+     * dropped across them. Written by the worker */
+    volatile uint64_t fpga_overflows;
+    volatile uint64_t fpga_dropped_samples;
+
+    SYNC_CACHE_PAD(pad_api);
+
+    uint64_t overruns_reported;         /* Overruns reported to the API caller
+                                         * via metadata. Written by the API */
+    uint64_t underruns_reported;        /* Underruns reported to the API
+                                         * caller via metadata. Written by
+                                         * the API */
+
+    uint64_t discontinuities;           /* RX timestamp discontinuities found
+                                         * by the continuity checker. Written
+                                         * by the API */
+    uint64_t dropped_samples;           /* Samples missing across forward
+                                         * discontinuities. Written by the API */
+
+    /* Waits for a buffer by the API side. Written by the API */
+    uint64_t spin_waits;                /* Satisfied while spinning */
+    uint64_t blocking_waits;            /* Blocked on buf_ready */
+    uint64_t wait_hist[BLADERF_STREAM_STATS_HIST_LEN];
+
+    /* Backend event thread statistics at sync_init(), which are reported
+     * relative to these */
+    uint64_t event_polls_base;
+    uint64_t event_cpu_us_base;
+
+    /* FPGA TX FIFO underflow count at sync_init(), which is reported
+     * relative to this. Only valid if the FPGA provides the count. */
+    bool fpga_underflows_valid;
+    uint32_t fpga_underflows_base;
+};
+
+/* Optional RX timestamp continuity checking, performed as each message header
+ * is loaded. Owned by the API side. */
+struct sync_continuity
+{
+    bool enabled;
+    bladerf_discontinuity_cb cb;    /* May be NULL */
+    void *cb_data;
+
+    bool valid;                     /* next_timestamp has been established */
+    uint64_t next_timestamp;        /* Expected timestamp of next message */
+};
+
+/* Optional TX underrun notification. Written by the API side with
+ * buf_mgmt.lock held, and read by the worker with it held. */
+struct sync_underrun
+{
+    bladerf_underrun_cb cb;         /* May be NULL */
+    void *cb_data;
+};
+
+/* Automatic submission of partially filled TX buffers. Owned by the API
+ * side. */
+struct sync_autoflush
+{
+    bool enabled;
+    unsigned int deadline_us;       /* Longest time samples may be held in a
+                                     * partially filled buffer */
+    uint64_t start_us;              /* Time at which the current buffer was
+                                     * found to be partially filled, or 0 */
+};
+
+/* Automatic adjustment of the number of in-flight transfers. The
+ * configuration is written by the API side only while the worker is idle.
+ * The remaining items are owned by the worker. */
+struct sync_autotune
+{
+    bool enabled;
+    unsigned int min_xfers;         /* Lower bound on in-flight transfers.
+                                     * The upper bound is num_xfers. */
+    unsigned int latency_budget_us; /* Target upper bound on buffering
+                                     * latency. 0 implies no budget. */
+
+    unsigned int limit;             /* Current in-flight transfer limit */
+    uint64_t last_us;               /* Time of the previous completion */
+    uint64_t interval_sum_us;       /* Sum of intervals in this window */
+    uint64_t interval_max_us;       /* Largest interval in this window */
+    unsigned int intervals;         /* # of intervals in this window */
+    uint64_t overruns;              /* Overrun count at window start */
+};
+
+/* Format-specific implementations of the sync calls' hot loops, selected
+ * once by sync_init() so that RX and TX calls need not re-examine the
+ * format for each buffer or message they copy */
+struct bladerf_sync;
+
+typedef void (*sync_copy_fn)(uint8_t *dest, const uint8_t *src,
+                             unsigned int n);
+
+struct sync_ops {
+    int (*rx)(struct bladerf_sync *s, const struct bladerf_rx_iov *iov,
+              unsigned int iov_count, struct bladerf_metadata *user_meta,
+              unsigned int timeout_ms, unsigned int *num_returned);
+
+    int (*tx_write)(struct bladerf_sync *s, const uint8_t *samples_src,
+                    unsigned int num_samples, bool flush,
+                    unsigned int timeout_ms, unsigned int *num_written);
+
+    sync_copy_fn copy;              /* Caller <-> buffer sample copy */
+    size_t user_bytes_per_sample;   /* Size of a caller's sample */
+};
+
+/* Members are grouped by the thread that writes them: read-mostly
+ * configuration first, then the buffer ring (which is itself split by
+ * writer), the worker's statistics and autotuning state, and finally the
+ * API side's state. */
 struct bladerf_sync {
     struct bladerf *dev;
-    sync_state state;
-    struct buffer_mgmt buf_mgmt;
     struct stream_config stream_config;
+    struct sync_ops ops;
     struct sync_worker *worker;
-    struct sync_meta meta;
+    struct sync_underrun underrun;
+
+    struct buffer_mgmt buf_mgmt;
+
+    SYNC_CACHE_PAD(pad_worker);
+
+    struct sync_autotune autotune;
+    struct sync_stats stats;        /* API-written counters are last */
+
+    SYNC_CACHE_PAD(pad_api);
+
+    struct sync_meta meta;          /* Read-mostly geometry is first */
+    sync_state state;
+    struct sync_loan loan;
+    struct sync_continuity continuity;
+    struct sync_autoflush autoflush;
+    bool nonblock;                  /* The current API call must not wait
+                                     * for a buffer */
 };
 
 /**
@@ -140,6 +402,29 @@ int sync_init(struct bladerf *dev,
               unsigned int num_transfers,
               unsigned int stream_timeout);
 
+/**
+ * Choose synchronous interface buffering, as described for
+ * bladerf_sync_config_auto(). This does not touch the device.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on invalid parameters
+ */
+int sync_choose_config(bladerf_module module, bladerf_format format,
+                       bladerf_dev_speed speed, unsigned int sample_rate,
+                       unsigned int latency_us,
+                       const struct bladerf_bandwidth_probe_results *probe,
+                       struct bladerf_sync_auto_config *config);
+
+/**
+ * Wake any sync call waiting on the handle, and cause it and any later calls
+ * to fail, such that the caller of sync_deinit() need not wait out their
+ * timeouts for the module's sync_lock. This does not require the sync_lock,
+ * but the handle's lifetime must be guarded by the module's
+ * sync_handle_lock.
+ *
+ * @param   sync    Handle to shut down. NULL is ignored.
+ */
+void sync_shutdown(struct bladerf_sync *sync);
+
 /**
  * Deinitialize the sync handle. This tears down and deallocates the underlying
  * asynchronous stream.
@@ -148,6 +433,21 @@ int sync_init(struct bladerf *dev,
  */
 void sync_deinit(struct bladerf_sync *sync);
 
+/**
+ * Replace the buffer pool of an already-configured sync handle, retaining its
+ * format, timeouts, and statistics. The module's format configuration and
+ * enable state are left untouched. Any samples held in the current pool are
+ * discarded.
+ *
+ * The new pool is allocated before the current one is released, so both
+ * briefly coexist. On failure, the existing handle is left intact.
+ *
+ * @return 0 or BLADERF_ERR_* value on failure
+ */
+int sync_resize(struct bladerf *dev, bladerf_module module,
+                unsigned int num_buffers, unsigned int buffer_size,
+                unsigned int num_transfers);
+
 
 int sync_rx(struct bladerf *dev, void *samples, unsigned int num_samples,
              struct bladerf_metadata *metadata, unsigned int timeout_ms);
@@ -155,6 +455,218 @@ int sync_rx(struct bladerf *dev, void *samples, unsigned int num_samples,
 int sync_tx(struct bladerf *dev, void *samples, unsigned int num_samples,
              struct bladerf_metadata *metadata, unsigned int timeout_ms);
 
+/**
+ * Non-blocking variants of sync_rx() and sync_tx(), which transfer only the
+ * samples that fit in buffers that are already available. The number of
+ * samples transferred is returned via `num_transferred`.
+ *
+ * @return 0 if any samples were transferred, BLADERF_ERR_WOULD_BLOCK if
+ *         none could be, or a BLADERF_ERR_* value on failure
+ */
+int sync_rx_try(struct bladerf *dev, void *samples, unsigned int num_samples,
+                struct bladerf_metadata *metadata,
+                unsigned int *num_transferred);
+
+int sync_tx_try(struct bladerf *dev, void *samples, unsigned int num_samples,
+                struct bladerf_metadata *metadata,
+                unsigned int *num_transferred);
+
+/**
+ * Get the handle's readiness descriptor, creating it if needed
+ *
+ * @return 0 on success, BLADERF_ERR_UNSUPPORTED on platforms without one,
+ *         or BLADERF_ERR_IO if it could not be created
+ */
+int sync_get_fd(struct bladerf_sync *s, int *fd);
+
+/**
+ * Signal the readiness descriptor, if the API side has armed it. Called by
+ * the worker after updating the ring's counters or its state.
+ */
+void sync_signal_ready_fd(struct buffer_mgmt *b);
+
+/**
+ * Receive into each of `iov_count` ranges, with the corresponding entry of
+ * `metadata` (if non-NULL), as sync_rx() would for each in turn. The request
+ * is validated once, and a single pass of the receive loop fills the ranges.
+ * Stops at the first failure.
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int sync_rx_multi(struct bladerf *dev, const struct bladerf_rx_iov *iov,
+                  struct bladerf_metadata *metadata, unsigned int iov_count,
+                  unsigned int timeout_ms);
+
+/**
+ * Lend the caller the next available run of received samples, in place.
+ *
+ * In ::BLADERF_FORMAT_SC16_Q11 mode, this is the remainder of the current
+ * buffer. In ::BLADERF_FORMAT_SC16_Q11_META mode, this is the remainder of
+ * the current message, as samples are not contiguous across message headers.
+ *
+ * The underlying buffer is not returned to the worker until
+ * sync_rx_release() is called.
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int sync_rx_acquire(struct bladerf *dev, void **samples,
+                    unsigned int *num_samples,
+                    struct bladerf_metadata *metadata,
+                    unsigned int timeout_ms);
+
+/**
+ * Lend the caller up to `max_msgs` of the remaining messages in the current
+ * buffer, in place, along with the location and metadata of each message's
+ * samples. Only metadata formats are supported.
+ *
+ * The loan is returned via sync_rx_release().
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int sync_rx_acquire_msgs(struct bladerf *dev, void **buffer,
+                         struct bladerf_rx_msg *msgs, unsigned int max_msgs,
+                         unsigned int *num_msgs,
+                         struct bladerf_metadata *metadata,
+                         unsigned int timeout_ms);
+
+/**
+ * Return samples previously lent by sync_rx_acquire() or
+ * sync_rx_acquire_msgs()
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if `samples` is not the
+ *         outstanding loan.
+ */
+int sync_rx_release(struct bladerf *dev, void *samples);
+
+/**
+ * Lend the caller the next available run of empty TX buffer space, in place.
+ *
+ * In ::BLADERF_FORMAT_SC16_Q11 mode, this is the remainder of the current
+ * buffer. In ::BLADERF_FORMAT_SC16_Q11_META mode, this is the remainder of
+ * the current message, whose header will have already been filled in.
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int sync_tx_acquire(struct bladerf *dev, void **samples,
+                    unsigned int *num_samples,
+                    struct bladerf_metadata *metadata,
+                    unsigned int timeout_ms);
+
+/**
+ * Commit `num_samples` samples written to space lent by sync_tx_acquire(),
+ * submitting the associated buffer if it has been filled (or flushed, via
+ * BLADERF_META_FLAG_TX_BURST_END).
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if `samples` is not the outstanding
+ *         loan or `num_samples` exceeds the lent amount, or a BLADERF_ERR_*
+ *         value on other failures.
+ */
+int sync_tx_commit(struct bladerf *dev, void *samples,
+                   unsigned int num_samples,
+                   struct bladerf_metadata *metadata);
+
+/**
+ * Zero the remainder of a partially filled TX buffer and submit it.
+ * This has no effect if no samples are waiting in a buffer.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if TX is not configured or
+ *         samples are lent out, or a BLADERF_ERR_* value on failure
+ */
+int sync_tx_flush(struct bladerf *dev, unsigned int timeout_ms);
+
+/**
+ * Configure automatic flushing of partially filled TX buffers by sync_tx()
+ * and sync_tx_commit(), once their samples have waited `deadline_us`.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if the handle is not configured
+ *         for TX
+ */
+int sync_set_autoflush(struct bladerf_sync *s, bool enable,
+                       unsigned int deadline_us);
+
+/**
+ * Sort `bursts` by timestamp, and write them to the TX buffers as a single
+ * schedule, zero-filling the gaps between bursts. Bursts share messages and
+ * buffers, with only the final buffer being flushed.
+ *
+ * @return 0 on success, BLADERF_ERR_TIME_PAST if the earliest burst precedes
+ *         the current timestamp, BLADERF_ERR_INVAL on overlapping bursts or
+ *         other invalid parameters, or a BLADERF_ERR_* value on other failures.
+ */
+int sync_tx_bursts(struct bladerf *dev, struct bladerf_tx_burst *bursts,
+                   unsigned int num_bursts, unsigned int timeout_ms);
+
+/**
+ * Write a waveform to the FPGA's waveform memory under the specified ID,
+ * replacing any waveform previously loaded under it. An empty waveform
+ * removes it.
+ *
+ * @return 0 on success, BLADERF_ERR_MEM if waveform memory has insufficient
+ *         space, BLADERF_ERR_UPDATE_FPGA if the FPGA does not support
+ *         waveforms, BLADERF_ERR_INVAL on invalid parameters, or a
+ *         BLADERF_ERR_* value on other failures.
+ */
+int sync_tx_load_waveform(struct bladerf *dev, unsigned int id,
+                          const int16_t *samples, unsigned int num_samples,
+                          unsigned int timeout_ms);
+
+/**
+ * Schedule transmission of a loaded waveform at the specified timestamp
+ *
+ * @return 0 on success, BLADERF_ERR_TIME_PAST if `timestamp` precedes the
+ *         current timestamp, BLADERF_ERR_UPDATE_FPGA if the FPGA does not
+ *         support waveforms, BLADERF_ERR_INVAL if no such waveform is loaded
+ *         or on other invalid parameters, or a BLADERF_ERR_* value on other
+ *         failures.
+ */
+int sync_tx_play_waveform(struct bladerf *dev, unsigned int id,
+                          uint64_t timestamp, unsigned int timeout_ms);
+
+/**
+ * Configure automatic tuning of the number of in-flight transfers. This takes
+ * effect the next time the underlying stream is started.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL on invalid parameters
+ */
+int sync_set_autotune(struct bladerf_sync *s, bool enable,
+                      unsigned int min_transfers,
+                      unsigned int latency_budget_us);
+
+/**
+ * Configure RX timestamp continuity checking. This takes effect at the next
+ * message header processed, which establishes the expected timestamp.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if the handle is not configured
+ *         for RX with metadata
+ */
+int sync_set_continuity_check(struct bladerf_sync *s, bool enable,
+                              bladerf_discontinuity_cb cb, void *user_data);
+
+/**
+ * Set the function called by the worker for each TX underrun it counts.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if the handle is not configured
+ *         for TX
+ */
+int sync_set_underrun_cb(struct bladerf_sync *s, bladerf_underrun_cb cb,
+                         void *user_data);
+
+/**
+ * Start the worker and its underlying stream, if they are not already
+ * running, without waiting for or consuming any samples.
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if the sync handle is NULL, or a
+ *         BLADERF_ERR_* value if the stream could not be started
+ */
+int sync_arm(struct bladerf_sync *s);
+
+/**
+ * Retrieve stream statistics
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if the sync handle is NULL
+ */
+int sync_get_stats(struct bladerf_sync *s, struct bladerf_stream_stats *stats);
+
 unsigned int sync_buf2idx(struct buffer_mgmt *b, void *addr);
 
 void * sync_idx2buf(struct buffer_mgmt *b, unsigned int idx);
@@ -35,9 +35,169 @@
 #include "sync.h"
 #include "sync_worker.h"
 #include "conversions.h"
+#include "metadata.h"
+#include "probes.h"
 
 void *sync_worker_task(void *arg);
 
+/* Wake the API side if it has given up spinning and is blocked waiting for
+ * a buffer. This must be called after the ring's counters are updated. */
+static inline void notify_buffer_ready(struct buffer_mgmt *b)
+{
+    /* Pairs with the fence in the API side's wait_for_buffer(), ensuring that
+     * either we see the waiting flag or the API sees our counter update. */
+    ATOMIC_FENCE();
+
+    if (ATOMIC_LOAD_ACQUIRE(&b->waiting)) {
+        MUTEX_LOCK(&b->lock);
+        pthread_cond_signal(&b->buf_ready);
+        MUTEX_UNLOCK(&b->lock);
+    }
+
+    sync_signal_ready_fd(b);
+}
+
+/* Record the current number of filled buffers in the ring */
+static inline void update_fill_stats(struct sync_stats *stats,
+                                     unsigned int fill)
+{
+    ATOMIC_STORE_RELEASE(&stats->fill_current, fill);
+
+    if (fill < stats->fill_min) {
+        ATOMIC_STORE_RELEASE(&stats->fill_min, fill);
+    }
+
+    if (fill > stats->fill_max) {
+        ATOMIC_STORE_RELEASE(&stats->fill_max, fill);
+    }
+}
+
+/* Number of completion intervals evaluated per autotuning decision */
+#ifndef SYNC_AUTOTUNE_WINDOW
+#   define SYNC_AUTOTUNE_WINDOW 64
+#endif
+
+/* Prepare autotuning state for a new stream */
+static void autotune_reset(struct bladerf_sync *s)
+{
+    struct sync_autotune *t = &s->autotune;
+
+    t->limit = s->stream_config.num_xfers;
+    t->last_us = 0;
+    t->interval_sum_us = 0;
+    t->interval_max_us = 0;
+    t->intervals = 0;
+    t->overruns = s->stats.overruns;
+
+    async_set_transfer_limit(s->worker->stream, t->enabled ? t->limit : 0);
+}
+
+/* Track completion timing, and periodically adjust the number of in-flight
+ * transfers. Enough transfers are kept in flight to span the longest
+ * observed gap between completions, with overruns forcing an increase. When
+ * a latency budget is specified, the number of transfers is kept within it,
+ * accounting for the buffers already waiting in the ring. */
+static void autotune_update(struct bladerf_sync *s, unsigned int fill)
+{
+    struct sync_autotune *t = &s->autotune;
+    const uint64_t now_us = async_stats_time_us();
+    uint64_t mean_us;
+    unsigned int target;
+
+    if (!t->enabled) {
+        return;
+    }
+
+    if (t->last_us != 0 && now_us > t->last_us) {
+        const uint64_t interval = now_us - t->last_us;
+
+        t->interval_sum_us += interval;
+        t->intervals++;
+
+        if (interval > t->interval_max_us) {
+            t->interval_max_us = interval;
+        }
+    }
+
+    t->last_us = now_us;
+
+    if (t->intervals < SYNC_AUTOTUNE_WINDOW) {
+        return;
+    }
+
+    mean_us = t->interval_sum_us / t->intervals;
+
+    if (mean_us != 0) {
+        uint64_t needed = (t->interval_max_us + mean_us - 1) / mean_us + 1;
+
+        if (s->stats.overruns != t->overruns && needed <= t->limit) {
+            needed = t->limit + 1;
+        }
+
+        if (t->latency_budget_us != 0) {
+            const uint64_t budget = t->latency_budget_us / mean_us;
+            const uint64_t allowed = budget > fill ? budget - fill : 0;
+
+            if (needed > allowed) {
+                needed = allowed;
+            }
+        }
+
+        if (needed < t->min_xfers) {
+            needed = t->min_xfers;
+        } else if (needed > s->stream_config.num_xfers) {
+            needed = s->stream_config.num_xfers;
+        }
+
+        /* Respond to increased demand immediately, but back off gradually */
+        target = (unsigned int) needed;
+        if (target < t->limit) {
+            target = t->limit - 1;
+        }
+
+        if (target != t->limit) {
+            log_debug("%s worker: In-flight transfer limit %u -> %u "
+                      "(mean=%lluus, max=%lluus)\n", MODULE_STR(s),
+                      t->limit, target, (unsigned long long) mean_us,
+                      (unsigned long long) t->interval_max_us);
+
+            t->limit = target;
+            async_set_transfer_limit(s->worker->stream, target);
+        }
+    }
+
+    t->interval_sum_us = 0;
+    t->interval_max_us = 0;
+    t->intervals = 0;
+    t->overruns = s->stats.overruns;
+}
+
+/* Account for FPGA RX FIFO overflows reported by a received buffer's
+ * message headers, including buffers that are about to be dropped */
+static void rx_update_overflow_stats(struct bladerf_sync *s,
+                                     const struct bladerf_metadata *meta,
+                                     const uint8_t *samples)
+{
+    uint64_t overflows = s->stats.fpga_overflows;
+    unsigned int i;
+
+    if (!(meta->status & BLADERF_META_STATUS_FPGA_OVERFLOW)) {
+        return;
+    }
+
+    for (i = 0; i < s->meta.msg_per_buf; i++) {
+        const uint8_t *msg = samples + s->dev->msg_size * i;
+        if (metadata_get_flags(msg) & BLADERF_META_FLAG_RX_OVERFLOW) {
+            overflows++;
+        }
+    }
+
+    ATOMIC_STORE_RELEASE(&s->stats.fpga_overflows, overflows);
+    ATOMIC_STORE_RELEASE(&s->stats.fpga_dropped_samples,
+                         s->stats.fpga_dropped_samples +
+                         meta->fpga_dropped_samples);
+}
+
 static void *rx_callback(struct bladerf *dev,
                          struct bladerf_stream *stream,
                          struct bladerf_metadata *meta,
@@ -48,6 +208,8 @@ static void *rx_callback(struct bladerf *dev,
     unsigned int requests;      /* Pending requests */
     unsigned int next_idx;
     unsigned int samples_idx;
+    unsigned int submitted, consumed;
+    void *oldest;               /* Oldest in-flight buffer */
     void *next_buf = NULL;      /* Next buffer to submit for reception */
 
     struct bladerf_sync *s = (struct bladerf_sync *)user_data;
@@ -57,9 +219,7 @@ static void *rx_callback(struct bladerf *dev,
     /* Check if the caller has requested us to shut down. We'll keep the
      * SHUTDOWN bit set through our transition into the IDLE state so we
      * can act on it there. */
-    MUTEX_LOCK(&w->request_lock);
-    requests = w->requests;
-    MUTEX_UNLOCK(&w->request_lock);
+    requests = ATOMIC_LOAD_ACQUIRE(&w->requests);
 
     if (requests & SYNC_WORKER_STOP) {
         log_verbose("%s worker: Got STOP request upon entering callback. "
@@ -67,50 +227,101 @@ static void *rx_callback(struct bladerf *dev,
         return NULL;
     }
 
-    MUTEX_LOCK(&b->lock);
+    rx_update_overflow_stats(s, meta, (const uint8_t *) samples);
+
+    samples_idx = b->completed_idx;
+    oldest = b->buffers[samples_idx];
 
-    /* Get the index of the buffer that was just filled */
-    samples_idx = sync_buf2idx(b, samples);
+    if (b->resubmitting && samples != oldest) {
+        /* We're still recovering from an overrun at this point. This buffer
+         * was in flight behind the one that overran, and the resubmissions
+         * have rotated the order in which they return, so it can only be
+         * identified by its address. Just turn around and resubmit it. */
+        samples_idx = sync_buf2idx(b, samples);
 
-    if (b->resubmit_count == 0) {
-        if (b->status[b->prod_i] == SYNC_BUFFER_EMPTY) {
+        ATOMIC_STORE_RELEASE(&s->stats.resubmissions,
+                             s->stats.resubmissions + 1);
 
-            /* This buffer is now ready for the consumer */
-            b->status[samples_idx] = SYNC_BUFFER_FULL;
-            pthread_cond_signal(&b->buf_ready);
+        PROBE2(sync_buf_resubmit, BLADERF_MODULE_RX, samples_idx);
+        log_verbose("Resubmitting buffer %u\r\n", samples_idx);
 
-            /* Update the state of the buffer being submitted next */
-            next_idx = b->prod_i;
-            b->status[next_idx] = SYNC_BUFFER_IN_FLIGHT;
-            next_buf = b->buffers[next_idx];
+        autotune_update(s, s->stats.fill_current);
+        return samples;
+    }
 
-            /* Advance to the next buffer for the next callback */
-            b->prod_i = (next_idx + 1) % b->num_buffers;
+    /* Otherwise, buffers are returned in the order they were submitted, so
+     * the buffer that was just filled is the oldest in-flight buffer. This
+     * is also the case once the buffer that overran has come back around,
+     * after everything that was in flight behind it. */
+    b->resubmitting = false;
+    assert(oldest == samples);
 
-            log_verbose("%s worker: buf[%u] = full, buf[%u] = in_flight\n",
-                        MODULE_STR(s), samples_idx, next_idx);
+    submitted = b->submitted;
+    consumed = ATOMIC_LOAD_ACQUIRE(&b->consumed);
 
-        } else {
-            /* TODO propgate back the RX Overrun to the sync_rx() caller */
-            log_debug("RX overrun @ buffer %u\r\n", samples_idx);
+    if (submitted - consumed < b->num_buffers) {
+
+        /* This buffer is now ready for the consumer */
+        b->completed_idx = sync_buf_next(b, samples_idx);
+        ATOMIC_STORE_RELEASE(&b->completed, b->completed + 1);
+        notify_buffer_ready(b);
+
+        update_fill_stats(&s->stats, b->completed - consumed);
+        PROBE3(sync_buf_complete, BLADERF_MODULE_RX, samples_idx,
+               b->completed - consumed);
+
+        /* Submit the next empty buffer */
+        next_idx = b->submitted_idx;
+        next_buf = b->buffers[next_idx];
+        b->submitted_idx = sync_buf_next(b, next_idx);
+        b->submitted = submitted + 1;
+
+        log_verbose("%s worker: buf[%u] = full, buf[%u] = in_flight\n",
+                    MODULE_STR(s), samples_idx, next_idx);
 
-            next_buf = samples;
-            b->resubmit_count = s->stream_config.num_xfers - 1;
-        }
     } else {
-        /* We're still recovering from an overrun at this point. Just
-         * turn around and resubmit this buffer */
+        log_debug("RX overrun @ buffer %u\r\n", samples_idx);
+
+        update_fill_stats(&s->stats, b->completed - consumed);
+
+        /* The API side reports this to the sync_rx() caller */
+        ATOMIC_STORE_RELEASE(&s->stats.overruns, s->stats.overruns + 1);
+        ATOMIC_STORE_RELEASE(&s->stats.resubmissions,
+                             s->stats.resubmissions + 1);
+
+        /* The buffers in flight behind this one hold samples following the
+         * ones we're dropping, so they're dropped too as they return. This
+         * buffer remains the oldest in flight. */
         next_buf = samples;
-        b->resubmit_count--;
-        log_verbose("Resubmitting buffer %u (%u resubmissions left)\r\n",
-                    samples_idx, b->resubmit_count);
+        b->resubmitting = true;
+        PROBE2(sync_buf_resubmit, BLADERF_MODULE_RX, samples_idx);
     }
 
+    autotune_update(s, s->stats.fill_current);
 
-    MUTEX_UNLOCK(&b->lock);
     return next_buf;
 }
 
+/* Count a TX underrun, and notify the caller's callback, if any */
+static void tx_underrun(struct bladerf_sync *s)
+{
+    struct buffer_mgmt *b = &s->buf_mgmt;
+    const uint64_t underruns = s->stats.underruns + 1;
+    bladerf_underrun_cb cb;
+    void *cb_data;
+
+    ATOMIC_STORE_RELEASE(&s->stats.underruns, underruns);
+
+    MUTEX_LOCK(&b->lock);
+    cb = s->underrun.cb;
+    cb_data = s->underrun.cb_data;
+    MUTEX_UNLOCK(&b->lock);
+
+    if (cb != NULL) {
+        cb(s->dev, underruns, cb_data);
+    }
+}
+
 static void *tx_callback(struct bladerf *dev,
                          struct bladerf_stream *stream,
                          struct bladerf_metadata *meta,
@@ -119,7 +330,6 @@ static void *tx_callback(struct bladerf *dev,
                          void *user_data)
 {
     unsigned int requests;      /* Pending requests */
-    unsigned int completed_idx; /* Index of completed buffer */
 
     struct bladerf_sync *s = (struct bladerf_sync *)user_data;
     struct sync_worker  *w = s->worker;
@@ -128,9 +338,7 @@ static void *tx_callback(struct bladerf *dev,
     /* Check if the caller has requested us to shut down. We'll keep the
      * SHUTDOWN bit set through our transition into the IDLE state so we
      * can act on it there. */
-    MUTEX_LOCK(&w->request_lock);
-    requests = w->requests;
-    MUTEX_UNLOCK(&w->request_lock);
+    requests = ATOMIC_LOAD_ACQUIRE(&w->requests);
 
     if (requests & SYNC_WORKER_STOP) {
         log_verbose("%s worker: Got STOP request upon entering callback. "
@@ -142,18 +350,41 @@ static void *tx_callback(struct bladerf *dev,
     /* Mark the last transfer as being completed. Note that the first
      * callbacks we get have samples=NULL */
     if (samples != NULL) {
+        unsigned int fill;
+        const unsigned int samples_idx = b->completed_idx;
 
-        MUTEX_LOCK(&b->lock);
+        /* TX buffers are never resubmitted, so they're returned in the
+         * order they were submitted */
+        assert(b->completed != ATOMIC_LOAD_ACQUIRE(&b->submitted));
+        assert(b->buffers[samples_idx] == samples);
 
-        completed_idx = sync_buf2idx(b, samples);
-        assert(b->status[completed_idx] == SYNC_BUFFER_IN_FLIGHT);
-        b->status[completed_idx] = SYNC_BUFFER_EMPTY;
+        log_verbose("%s worker: Buffer %u emptied.\r\n",
+                    MODULE_STR(s), samples_idx);
 
-        pthread_cond_signal(&b->buf_ready);
-        MUTEX_UNLOCK(&b->lock);
+        /* This buffer was submitted after the previous ones had all been
+         * sent, so the device ran out of samples in the meantime. Running
+         * out between bursts is expected. */
+        if (s->stats.tx_drained) {
+            s->stats.tx_drained = false;
 
-        log_verbose("%s worker: Buffer %u emptied.\r\n",
-                    MODULE_STR(s), completed_idx);
+            if (!b->after_burst[samples_idx]) {
+                tx_underrun(s);
+            }
+        }
+
+        b->completed_idx = sync_buf_next(b, samples_idx);
+        ATOMIC_STORE_RELEASE(&b->completed, b->completed + 1);
+        notify_buffer_ready(b);
+
+        /* The caller accounts for buffers as submitted before submitting
+         * them, so nothing more is on the way if this reaches 0 */
+        fill = ATOMIC_LOAD_ACQUIRE(&b->submitted) - b->completed;
+        update_fill_stats(&s->stats, fill);
+        PROBE3(sync_buf_complete, BLADERF_MODULE_TX, samples_idx, fill);
+        s->stats.tx_drained = (fill == 0);
+
+        /* Queued TX buffers are bounded by the transfer limit itself */
+        autotune_update(s, 0);
     }
 
     return BLADERF_STREAM_NO_DATA;
@@ -267,7 +498,7 @@ void sync_worker_deinit(struct sync_worker *w,
 void sync_worker_submit_request(struct sync_worker *w, unsigned int request)
 {
     MUTEX_LOCK(&w->request_lock);
-    w->requests |= request;
+    ATOMIC_STORE_RELEASE(&w->requests, w->requests | request);
     pthread_cond_signal(&w->requests_pending);
     MUTEX_UNLOCK(&w->request_lock);
 }
@@ -344,8 +575,12 @@ sync_worker_state sync_worker_get_state(struct sync_worker *w,
     return ret;
 }
 
-static void set_state(struct sync_worker *w, sync_worker_state state)
+static void set_state(struct bladerf_sync *s, sync_worker_state state)
 {
+    struct sync_worker *w = s->worker;
+
+    PROBE2(sync_worker_state, s->stream_config.module, state);
+
     MUTEX_LOCK(&w->state_lock);
     w->state = state;
     pthread_cond_signal(&w->state_changed);
@@ -357,7 +592,6 @@ static sync_worker_state exec_idle_state(struct bladerf_sync *s)
 {
     sync_worker_state next_state = SYNC_WORKER_STATE_IDLE;
     unsigned int requests;
-    unsigned int i;
 
     MUTEX_LOCK(&s->worker->request_lock);
 
@@ -369,7 +603,7 @@ static sync_worker_state exec_idle_state(struct bladerf_sync *s)
     }
 
     requests = s->worker->requests;
-    s->worker->requests = 0;
+    ATOMIC_STORE_RELEASE(&s->worker->requests, 0);
     MUTEX_UNLOCK(&s->worker->request_lock);
 
     if (requests & SYNC_WORKER_STOP) {
@@ -381,29 +615,32 @@ static sync_worker_state exec_idle_state(struct bladerf_sync *s)
     } else if (requests & SYNC_WORKER_START) {
         log_verbose("%s worker: Got request to start\n",
                 module2str(s->stream_config.module));
+
+        MUTEX_LOCK(&s->worker->state_lock);
+        autotune_reset(s);
+        MUTEX_UNLOCK(&s->worker->state_lock);
+
         MUTEX_LOCK(&s->buf_mgmt.lock);
 
         if (s->stream_config.module == BLADERF_MODULE_TX) {
             /* If we've previously timed out on a stream, we'll likely have some
             * stale buffers marked "in-flight" that have since been cancelled. */
-            for (i = 0; i < s->buf_mgmt.num_buffers; i++) {
-                if (s->buf_mgmt.status[i] == SYNC_BUFFER_IN_FLIGHT) {
-                    s->buf_mgmt.status[i] = SYNC_BUFFER_EMPTY;
-                }
-            }
+            s->buf_mgmt.completed_idx = s->buf_mgmt.submitted_idx;
+            ATOMIC_STORE_RELEASE(&s->buf_mgmt.completed,
+                                 ATOMIC_LOAD_ACQUIRE(&s->buf_mgmt.submitted));
 
             pthread_cond_signal(&s->buf_mgmt.buf_ready);
         } else {
             assert(s->stream_config.module == BLADERF_MODULE_RX);
-            s->buf_mgmt.prod_i = s->stream_config.num_xfers;
-
-            for (i = 0; i < s->buf_mgmt.num_buffers; i++) {
-                if (i < s->stream_config.num_xfers) {
-                    s->buf_mgmt.status[i] = SYNC_BUFFER_IN_FLIGHT;
-                } else if (s->buf_mgmt.status[i] == SYNC_BUFFER_IN_FLIGHT) {
-                    s->buf_mgmt.status[i] = SYNC_BUFFER_EMPTY;
-                }
-            }
+
+            /* The stream will submit the first 'num_xfers' buffers. The API
+             * side resets its consumer count prior to requesting a start. */
+            s->buf_mgmt.resubmitting = false;
+            s->buf_mgmt.completed_idx = 0;
+            s->buf_mgmt.submitted_idx = s->stream_config.num_xfers;
+            ATOMIC_STORE_RELEASE(&s->buf_mgmt.completed, 0);
+            ATOMIC_STORE_RELEASE(&s->buf_mgmt.submitted,
+                                 s->stream_config.num_xfers);
         }
 
         MUTEX_UNLOCK(&s->buf_mgmt.lock);
@@ -447,7 +684,7 @@ void *sync_worker_task(void *arg)
     struct bladerf_sync *s = (struct bladerf_sync *)arg;
 
     log_verbose("%s worker: task started\n", MODULE_STR(s));
-    set_state(s->worker, state);
+    set_state(s, state);
     log_verbose("%s worker: task state set\n", MODULE_STR(s));
 
     while (state != SYNC_WORKER_STATE_STOPPED) {
@@ -455,25 +692,30 @@ void *sync_worker_task(void *arg)
         switch (state) {
             case SYNC_WORKER_STATE_STARTUP:
                 assert(!"Worker in unexepected state, shutting down. (STARTUP)");
-                set_state(s->worker, SYNC_WORKER_STATE_SHUTTING_DOWN);
+                set_state(s, SYNC_WORKER_STATE_SHUTTING_DOWN);
                 break;
 
             case SYNC_WORKER_STATE_IDLE:
                 state = exec_idle_state(s);
-                set_state(s->worker, state);
+                set_state(s, state);
                 break;
 
             case SYNC_WORKER_STATE_RUNNING:
                 exec_running_state(s);
                 state = SYNC_WORKER_STATE_IDLE;
-                set_state(s->worker, state);
+                set_state(s, state);
+
+                /* Wake an event loop, so that its next call to the API
+                 * side handles the stream having stopped */
+                ATOMIC_FENCE();
+                sync_signal_ready_fd(&s->buf_mgmt);
                 break;
 
             case SYNC_WORKER_STATE_SHUTTING_DOWN:
                 log_verbose("%s worker: Shutting down...\n", MODULE_STR(s));
 
                 state = SYNC_WORKER_STATE_STOPPED;
-                set_state(s->worker, state);
+                set_state(s, state);
                 break;
 
             case SYNC_WORKER_STATE_STOPPED:
@@ -482,7 +724,7 @@ void *sync_worker_task(void *arg)
 
             default:
                 assert(!"Worker in unexepected state, shutting down. (UNKNOWN)");
-                set_state(s->worker, SYNC_WORKER_STATE_SHUTTING_DOWN);
+                set_state(s, SYNC_WORKER_STATE_SHUTTING_DOWN);
                 break;
         }
     }
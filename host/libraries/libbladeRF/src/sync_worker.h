@@ -63,8 +63,11 @@ struct sync_worker {
 
     /* The requests lock should always be acquired AFTER
      * the sync->buf_mgmt.lock
+     *
+     * Requests are only modified while holding the request lock, but may be
+     * polled without it (via ATOMIC_LOAD_ACQUIRE) from the stream callbacks.
      */
-    unsigned int requests;
+    volatile unsigned int requests;
     pthread_cond_t requests_pending;
     MUTEX request_lock;
 };
@@ -0,0 +1,127 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <libbladeRF.h>
+
+#include "bladerf_priv.h"
+#include "trace.h"
+#include "minmax.h"
+
+/* The same clock as async_stats_time_us(), so that records can be lined up
+ * with the stream and tuning histograms */
+static inline uint64_t trace_time_ns(void)
+{
+    struct timespec t;
+
+    if (clock_gettime(CLOCK_REALTIME, &t) != 0) {
+        return 0;
+    }
+
+    return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+int trace_enable(struct bladerf *dev, unsigned int num_records)
+{
+    struct trace_buf *t = &dev->trace;
+    struct bladerf_trace_record *records = NULL;
+
+    if (num_records > TRACE_MAX_RECORDS) {
+        return BLADERF_ERR_INVAL;
+    }
+
+    if (num_records != 0) {
+        records = calloc(num_records, sizeof(records[0]));
+        if (records == NULL) {
+            return BLADERF_ERR_MEM;
+        }
+    }
+
+    free(t->records);
+    t->records = records;
+    t->len = num_records;
+    t->first = 0;
+    t->count = 0;
+
+    return 0;
+}
+
+uint64_t trace_start(struct bladerf *dev)
+{
+    if (dev->trace.records == NULL) {
+        return 0;
+    }
+
+    return trace_time_ns();
+}
+
+void trace_add(struct bladerf *dev, uint64_t start_ns,
+               bladerf_trace_type type, bladerf_trace_target target,
+               uint8_t request, uint32_t length, int status)
+{
+    struct trace_buf *t = &dev->trace;
+    struct bladerf_trace_record *r;
+    uint64_t end_ns;
+
+    if (start_ns == 0 || t->records == NULL) {
+        return;
+    }
+
+    end_ns = trace_time_ns();
+
+    /* Overwrite the oldest record once the buffer is full */
+    if (t->count == t->len) {
+        r = &t->records[t->first];
+        t->first = (t->first + 1) % t->len;
+    } else {
+        r = &t->records[(t->first + t->count) % t->len];
+        t->count++;
+    }
+
+    r->start_ns = start_ns;
+    r->duration_ns = (end_ns > start_ns) ?
+                     (uint32_t) u64_min(end_ns - start_ns, UINT32_MAX) : 0;
+    r->type = type;
+    r->target = target;
+    r->request = request;
+    r->length = length;
+    r->status = status;
+}
+
+int trace_read(struct bladerf *dev, struct bladerf_trace_record *records,
+               unsigned int max_records)
+{
+    struct trace_buf *t = &dev->trace;
+    unsigned int i;
+    const unsigned int n = uint_min(max_records, t->count);
+
+    if (t->records == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    for (i = 0; i < n; i++) {
+        records[i] = t->records[t->first];
+        t->first = (t->first + 1) % t->len;
+    }
+
+    t->count -= n;
+    return (int) n;
+}
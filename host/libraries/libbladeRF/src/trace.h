@@ -0,0 +1,100 @@
+/**
+ * @file trace.h
+ *
+ * @brief Control path tracing
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BLADERF_TRACE_H_
+#define BLADERF_TRACE_H_
+
+#include <stdint.h>
+#include <libbladeRF.h>
+
+/* Largest trace buffer that bladerf_trace_enable() will allocate */
+#ifndef TRACE_MAX_RECORDS
+#   define TRACE_MAX_RECORDS (1024 * 1024)
+#endif
+
+/* Ring buffer of the most recent control path operations */
+struct trace_buf {
+    struct bladerf_trace_record *records;
+    unsigned int len;       /* Capacity of `records` */
+    unsigned int first;     /* Index of the oldest record */
+    unsigned int count;     /* Number of records held */
+};
+
+/**
+ * Allocate a device's trace buffer, replacing any existing buffer and its
+ * records, or free it when `num_records` is 0.
+ *
+ * The caller must hold the device's control lock.
+ *
+ * @param   dev             Device handle
+ * @param   num_records     Capacity of the new buffer
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if `num_records` exceeds
+ *         TRACE_MAX_RECORDS, or BLADERF_ERR_MEM
+ */
+int trace_enable(struct bladerf *dev, unsigned int num_records);
+
+/**
+ * Get the start time of an operation that is about to be traced
+ *
+ * @param   dev     Device handle
+ *
+ * @return  Current time in ns, or 0 if tracing is not enabled. This is to be
+ *          passed to trace_add() once the operation completes.
+ */
+uint64_t trace_start(struct bladerf *dev);
+
+/**
+ * Record a completed operation. This is a no-op if `start_ns` is 0.
+ *
+ * The caller must hold the device's control lock.
+ *
+ * @param   dev         Device handle
+ * @param   start_ns    Value returned by trace_start()
+ * @param   type        Kind of operation
+ * @param   target      Target of the operation
+ * @param   request     See bladerf_trace_record::request
+ * @param   length      See bladerf_trace_record::length
+ * @param   status      Result of the operation
+ */
+void trace_add(struct bladerf *dev, uint64_t start_ns,
+               bladerf_trace_type type, bladerf_trace_target target,
+               uint8_t request, uint32_t length, int status);
+
+/**
+ * Remove up to `max_records` of the oldest records from the trace buffer
+ *
+ * The caller must hold the device's control lock.
+ *
+ * @param   dev             Device handle
+ * @param   records         Populated with the records, oldest first
+ * @param   max_records     Capacity of `records`
+ *
+ * @return  Number of records read, or BLADERF_ERR_UNSUPPORTED if tracing is
+ *          not enabled
+ */
+int trace_read(struct bladerf *dev, struct bladerf_trace_record *records,
+               unsigned int max_records);
+
+#endif
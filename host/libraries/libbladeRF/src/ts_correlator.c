@@ -0,0 +1,413 @@
+/*
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <libbladeRF.h>
+
+#include "bladerf_priv.h"
+#include "ts_correlator.h"
+#include "si5338.h"
+#include "log.h"
+
+#ifdef CLOCK_MONOTONIC
+#   define TS_CORR_CLOCK CLOCK_MONOTONIC
+#else
+#   define TS_CORR_CLOCK CLOCK_REALTIME
+#endif
+
+#define NSEC_PER_SEC 1000000000.0
+
+static int host_time_ns(int64_t *t_ns)
+{
+    struct timespec t;
+
+    if (clock_gettime(TS_CORR_CLOCK, &t) != 0) {
+        return BLADERF_ERR_UNEXPECTED;
+    }
+
+    *t_ns = (int64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+    return 0;
+}
+
+static inline double abs_d(double x)
+{
+    return x < 0 ? -x : x;
+}
+
+/* Read the timestamp counter, noting when the read occurred. Of
+ * TS_CORR_PROBES reads, the one with the shortest round trip is used, as
+ * its midpoint is the most certain. */
+static int measure(struct ts_correlator *c, struct ts_corr_point *p,
+                   int64_t *rtt_ns)
+{
+    int status = 0;
+    unsigned int i;
+
+    *rtt_ns = INT64_MAX;
+
+    for (i = 0; i < TS_CORR_PROBES && status == 0; i++) {
+        int64_t t0, t1;
+        uint64_t timestamp;
+
+        CTRL_LOCK(c->dev, CTRL_LOCK_TS);
+
+        status = host_time_ns(&t0);
+        if (status == 0) {
+            status = c->dev->fn->get_timestamp(c->dev, c->module, &timestamp);
+        }
+
+        if (status == 0) {
+            status = host_time_ns(&t1);
+        }
+
+        CTRL_UNLOCK(c->dev, CTRL_LOCK_TS);
+
+        if (status == 0 && (t1 - t0) < *rtt_ns) {
+            *rtt_ns = t1 - t0;
+            p->t_ns = t0 + *rtt_ns / 2;
+            p->timestamp = timestamp;
+        }
+    }
+
+    return status;
+}
+
+/* Fetch the sample rate the counter is nominally running at, or 0 if
+ * it cannot be determined */
+static double read_nominal_rate(struct ts_correlator *c)
+{
+    int status;
+    struct bladerf_rational_rate rate;
+
+    CTRL_LOCK(c->dev, CTRL_LOCK_SI5338);
+    status = si5338_get_rational_sample_rate(c->dev, c->module, &rate);
+    CTRL_UNLOCK(c->dev, CTRL_LOCK_SI5338);
+
+    if (status != 0) {
+        log_debug("%s: Failed to read sample rate: %s\n",
+                  __FUNCTION__, bladerf_strerror(status));
+        return 0.0;
+    }
+
+    return (double) rate.integer +
+           (rate.den != 0 ? (double) rate.num / rate.den : 0.0);
+}
+
+static inline const struct ts_corr_point *point(const struct ts_correlator *c,
+                                                size_t i)
+{
+    return &c->points[(c->head + i) % TS_CORR_WINDOW];
+}
+
+/* Offset of the counter from c->ref.timestamp at time t_ns, per the fit */
+static inline double predict(const struct ts_correlator *c, int64_t t_ns)
+{
+    return c->offset + c->slope * (double) (t_ns - c->ref.t_ns);
+}
+
+/* Least-squares fit of the counter to the host's clock, over all points.
+ * Values are taken relative to the oldest point to retain precision. */
+static void update_fit(struct ts_correlator *c)
+{
+    size_t i;
+    double mean_x = 0, mean_y = 0;
+    double s_xx = 0, s_xy = 0;
+    const double n = (double) c->num_points;
+
+    c->ref = *point(c, 0);
+
+    if (c->num_points < 2) {
+        c->offset = 0;
+        c->slope = c->nominal_rate / NSEC_PER_SEC;
+        return;
+    }
+
+    for (i = 0; i < c->num_points; i++) {
+        mean_x += (double) (point(c, i)->t_ns - c->ref.t_ns);
+        mean_y += (double) (point(c, i)->timestamp - c->ref.timestamp);
+    }
+
+    mean_x /= n;
+    mean_y /= n;
+
+    for (i = 0; i < c->num_points; i++) {
+        const double dx = (double) (point(c, i)->t_ns - c->ref.t_ns) - mean_x;
+        const double dy =
+            (double) (point(c, i)->timestamp - c->ref.timestamp) - mean_y;
+
+        s_xx += dx * dx;
+        s_xy += dx * dy;
+    }
+
+    if (s_xx > 0) {
+        c->slope = s_xy / s_xx;
+    }
+
+    c->offset = mean_y - c->slope * mean_x;
+}
+
+/* Add a measurement to the fit. Returns true if the measurement was
+ * inconsistent with the fit, and the fit was restarted from it. */
+static bool add_point(struct ts_correlator *c, const struct ts_corr_point *p,
+                      int64_t rtt_ns)
+{
+    bool restart = false;
+
+    if (c->num_points != 0) {
+        const struct ts_corr_point *last = point(c, c->num_points - 1);
+
+        const double tolerance =
+            (TS_CORR_MAX_ERROR_US * 1000.0 + rtt_ns) * c->slope + 1;
+
+        const double error =
+            (double) (int64_t) (p->timestamp - c->ref.timestamp) -
+            predict(c, p->t_ns);
+
+        if (p->timestamp < last->timestamp || abs_d(error) > tolerance) {
+            log_debug("%s: Restarting %s fit (error: %.0f ticks)\n",
+                      __FUNCTION__,
+                      c->module == BLADERF_MODULE_RX ? "RX" : "TX", error);
+            restart = true;
+            c->num_points = 0;
+            c->head = 0;
+        }
+    }
+
+    if (c->num_points == TS_CORR_WINDOW) {
+        c->points[c->head] = *p;
+        c->head = (c->head + 1) % TS_CORR_WINDOW;
+    } else {
+        c->points[(c->head + c->num_points) % TS_CORR_WINDOW] = *p;
+        c->num_points++;
+    }
+
+    c->uncertainty_ns = rtt_ns / 2.0;
+    update_fit(c);
+
+    return restart;
+}
+
+/* Take a measurement and update the fit with it */
+static int update(struct ts_correlator *c)
+{
+    int status;
+    int64_t rtt_ns;
+    struct ts_corr_point p;
+    bool restarted;
+
+    status = measure(c, &p, &rtt_ns);
+    if (status != 0) {
+        return status;
+    }
+
+    MUTEX_LOCK(&c->lock);
+    restarted = add_point(c, &p, rtt_ns);
+    MUTEX_UNLOCK(&c->lock);
+
+    /* A sample rate change is one possible reason for a restart */
+    if (restarted) {
+        const double rate = read_nominal_rate(c);
+
+        MUTEX_LOCK(&c->lock);
+        c->nominal_rate = rate;
+        if (c->num_points < 2) {
+            update_fit(c);
+        }
+        MUTEX_UNLOCK(&c->lock);
+    }
+
+    return 0;
+}
+
+static void *ts_correlator_task(void *arg)
+{
+    struct ts_correlator *c = (struct ts_correlator *) arg;
+    struct timespec timeout;
+    int status;
+
+    MUTEX_LOCK(&c->lock);
+
+    while (!c->stop) {
+        status = populate_abs_timeout(&timeout, c->interval_ms);
+        if (status != 0) {
+            log_error("%s: Failed to compute timeout\n", __FUNCTION__);
+            break;
+        }
+
+        status = pthread_cond_timedwait(&c->stop_requested, &c->lock,
+                                        &timeout);
+
+        if (c->stop) {
+            break;
+        } else if (status != ETIMEDOUT) {
+            /* Interval changed, or a spurious wakeup */
+            continue;
+        }
+
+        MUTEX_UNLOCK(&c->lock);
+
+        status = update(c);
+        if (status != 0) {
+            log_debug("%s: Failed to read timestamp: %s\n",
+                      __FUNCTION__, bladerf_strerror(status));
+        }
+
+        MUTEX_LOCK(&c->lock);
+    }
+
+    MUTEX_UNLOCK(&c->lock);
+    return NULL;
+}
+
+void ts_correlator_init(struct ts_correlator *corr, struct bladerf *dev,
+                        bladerf_module module)
+{
+    memset(corr, 0, sizeof(*corr));
+
+    corr->dev = dev;
+    corr->module = module;
+
+    MUTEX_INIT(&corr->ctl_lock);
+    MUTEX_INIT(&corr->lock);
+    pthread_cond_init(&corr->stop_requested, NULL);
+}
+
+int ts_correlator_start(struct ts_correlator *corr, unsigned int interval_ms)
+{
+    int status = 0;
+    double rate;
+
+    MUTEX_LOCK(&corr->ctl_lock);
+
+    if (corr->running) {
+        MUTEX_LOCK(&corr->lock);
+        corr->interval_ms = interval_ms;
+        pthread_cond_signal(&corr->stop_requested);
+        MUTEX_UNLOCK(&corr->lock);
+        goto out;
+    }
+
+    rate = read_nominal_rate(corr);
+
+    MUTEX_LOCK(&corr->lock);
+    corr->stop = false;
+    corr->interval_ms = interval_ms;
+    corr->num_points = 0;
+    corr->head = 0;
+    corr->nominal_rate = rate;
+    MUTEX_UNLOCK(&corr->lock);
+
+    status = update(corr);
+    if (status != 0) {
+        goto out;
+    }
+
+    status = pthread_create(&corr->thread, NULL, ts_correlator_task, corr);
+    if (status != 0) {
+        log_error("Failed to start timestamp correlator thread: %s\n",
+                  strerror(status));
+        status = BLADERF_ERR_UNEXPECTED;
+        goto out;
+    }
+
+    corr->running = true;
+
+out:
+    if (status != 0) {
+        MUTEX_LOCK(&corr->lock);
+        corr->num_points = 0;
+        MUTEX_UNLOCK(&corr->lock);
+    }
+
+    MUTEX_UNLOCK(&corr->ctl_lock);
+    return status;
+}
+
+void ts_correlator_stop(struct ts_correlator *corr)
+{
+    MUTEX_LOCK(&corr->ctl_lock);
+
+    if (corr->running) {
+        MUTEX_LOCK(&corr->lock);
+        corr->stop = true;
+        pthread_cond_signal(&corr->stop_requested);
+        MUTEX_UNLOCK(&corr->lock);
+
+        pthread_join(corr->thread, NULL);
+        corr->running = false;
+
+        MUTEX_LOCK(&corr->lock);
+        corr->num_points = 0;
+        MUTEX_UNLOCK(&corr->lock);
+    }
+
+    MUTEX_UNLOCK(&corr->ctl_lock);
+}
+
+int ts_correlator_estimate(struct ts_correlator *corr, int64_t delta_us,
+                           uint64_t *timestamp)
+{
+    int status;
+    int64_t now;
+    double offset;
+
+    status = host_time_ns(&now);
+    if (status != 0) {
+        return status;
+    }
+
+    MUTEX_LOCK(&corr->lock);
+
+    if (corr->num_points == 0) {
+        status = BLADERF_ERR_INVAL;
+    } else {
+        offset = predict(corr, now + delta_us * 1000);
+
+        if (offset < 0 && (uint64_t) (-offset) > corr->ref.timestamp) {
+            *timestamp = 0;
+        } else {
+            *timestamp = corr->ref.timestamp +
+                         (int64_t) (offset < 0 ? offset - 0.5 : offset + 0.5);
+        }
+    }
+
+    MUTEX_UNLOCK(&corr->lock);
+    return status;
+}
+
+int ts_correlator_info(struct ts_correlator *corr,
+                       struct bladerf_timestamp_correlation *info)
+{
+    int status = 0;
+
+    MUTEX_LOCK(&corr->lock);
+
+    if (corr->num_points == 0) {
+        status = BLADERF_ERR_INVAL;
+    } else {
+        info->num_points = (unsigned int) corr->num_points;
+        info->rate = corr->slope * NSEC_PER_SEC;
+        info->drift_ppm = corr->nominal_rate > 0 ?
+                    (info->rate / corr->nominal_rate - 1.0) * 1e6 : 0.0;
+        info->uncertainty_us = corr->uncertainty_ns / 1000.0;
+    }
+
+    MUTEX_UNLOCK(&corr->lock);
+    return status;
+}
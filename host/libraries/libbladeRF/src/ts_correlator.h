@@ -0,0 +1,145 @@
+/**
+ * @file ts_correlator.h
+ *
+ * @brief Correlation of the host's clock with a module's timestamp counter
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+#ifndef BLADERF_TS_CORRELATOR_H_
+#define BLADERF_TS_CORRELATOR_H_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <libbladeRF.h>
+#include "thread.h"
+
+/* Max number of measurements used to fit the relationship between the host's
+ * clock and a timestamp counter */
+#ifndef TS_CORR_WINDOW
+#   define TS_CORR_WINDOW 16
+#endif
+
+/* Number of timestamp reads performed for each measurement. The read with
+ * the shortest round trip is used. */
+#ifndef TS_CORR_PROBES
+#   define TS_CORR_PROBES 3
+#endif
+
+/* A measurement deviating from the current fit by more than this, in
+ * microseconds, is taken to indicate that the counter was reset or that the
+ * sample rate changed. The fit is restarted when this occurs. */
+#ifndef TS_CORR_MAX_ERROR_US
+#   define TS_CORR_MAX_ERROR_US 1000
+#endif
+
+struct bladerf;
+
+struct ts_corr_point {
+    int64_t t_ns;           /* Host clock at the midpoint of the read */
+    uint64_t timestamp;     /* Timestamp counter value */
+};
+
+struct ts_correlator {
+    struct bladerf *dev;
+    bladerf_module module;
+
+    /* Serializes starting and stopping of the thread */
+    MUTEX ctl_lock;
+    bool running;
+    pthread_t thread;
+
+    /* Protects all of the following */
+    MUTEX lock;
+    pthread_cond_t stop_requested;
+    bool stop;
+    unsigned int interval_ms;
+
+    /* Recent measurements, oldest first, in a ring starting at `head` */
+    struct ts_corr_point points[TS_CORR_WINDOW];
+    size_t num_points;
+    size_t head;
+
+    /* Current fit: timestamp = ref.timestamp + offset + slope * (t - ref.t_ns),
+     * with slope in ticks per nanosecond */
+    struct ts_corr_point ref;
+    double offset;
+    double slope;
+
+    double nominal_rate;    /* Sample rate when the fit was (re)started */
+    double uncertainty_ns;  /* Half the round trip of the latest measurement */
+};
+
+/**
+ * Initialize a correlator. It is stopped until ts_correlator_start() is called.
+ *
+ * @param   corr        Correlator to initialize
+ * @param   dev         Device handle
+ * @param   module      Module whose timestamp counter is to be tracked
+ */
+void ts_correlator_init(struct ts_correlator *corr, struct bladerf *dev,
+                        bladerf_module module);
+
+/**
+ * Take an initial measurement and start measuring periodically. If the
+ * correlator is already running, only its interval is changed.
+ *
+ * The caller must not hold the device's control lock.
+ *
+ * @param   corr        Correlator
+ * @param   interval_ms Period between measurements
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int ts_correlator_start(struct ts_correlator *corr, unsigned int interval_ms);
+
+/**
+ * Stop a correlator, if it is running. The caller must not hold the device's
+ * control lock.
+ *
+ * @param   corr        Correlator
+ */
+void ts_correlator_stop(struct ts_correlator *corr);
+
+/**
+ * Estimate the timestamp counter's value at a time relative to now
+ *
+ * @param       corr        Correlator
+ * @param       delta_us    Offset from the current time, in microseconds
+ * @param[out]  timestamp   Estimated counter value
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if the correlator is not running,
+ *         or BLADERF_ERR_UNEXPECTED if the host's clock could not be read
+ */
+int ts_correlator_estimate(struct ts_correlator *corr, int64_t delta_us,
+                           uint64_t *timestamp);
+
+/**
+ * Get the state of the current fit
+ *
+ * @param       corr    Correlator
+ * @param[out]  info    Correlation status
+ *
+ * @return 0 on success, BLADERF_ERR_INVAL if the correlator is not running
+ */
+int ts_correlator_info(struct ts_correlator *corr,
+                       struct bladerf_timestamp_correlation *info);
+
+#endif
@@ -16,6 +16,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <string.h>
+
 #include "libbladeRF.h"
 #include "tuning.h"
 #include "bladerf_priv.h"
@@ -23,6 +25,51 @@
 #include "xb.h"
 #include "dc_cal_table.h"
 #include "log.h"
+#include "version_compat.h"
+#include "async.h"
+#include "si5338.h"
+
+#if BLADERF_TUNING_STATS_HIST_LEN != BLADERF_STREAM_STATS_HIST_LEN
+#   error "Tuning and stream stats histograms are expected to be binned alike"
+#endif
+
+void tuning_timer_start(struct bladerf *dev, struct tuning_timer *t)
+{
+    t->start_us = async_stats_time_us();
+    t->requests = dev->ctrl_requests;
+}
+
+void tuning_timer_stop(struct bladerf *dev, bladerf_module module,
+                       bladerf_tuning_phase phase,
+                       const struct tuning_timer *t)
+{
+    struct bladerf_tuning_phase_stats *s =
+        &dev->tuning_stats[module].phases[phase];
+    const uint64_t now_us = async_stats_time_us();
+    const uint64_t elapsed_us = (now_us > t->start_us) ?
+                                (now_us - t->start_us) : 0;
+
+    s->count++;
+    s->total_us += elapsed_us;
+    s->requests += dev->ctrl_requests - t->requests;
+
+    if (elapsed_us > s->max_us) {
+        s->max_us = elapsed_us;
+    }
+
+    async_stats_hist_add(s->hist, t->start_us, now_us);
+}
+
+void tuning_get_stats(struct bladerf *dev, bladerf_module module,
+                      struct bladerf_tuning_stats *stats)
+{
+    *stats = dev->tuning_stats[module];
+}
+
+void tuning_reset_stats(struct bladerf *dev, bladerf_module module)
+{
+    memset(&dev->tuning_stats[module], 0, sizeof(dev->tuning_stats[module]));
+}
 
 
 int tuning_select_band(struct bladerf *dev, bladerf_module module,
@@ -58,73 +105,204 @@ int tuning_select_band(struct bladerf *dev, bladerf_module module,
     return CONFIG_GPIO_WRITE(dev, gpio);
 }
 
-int tuning_set_freq(struct bladerf *dev, bladerf_module module,
-                    unsigned int frequency)
+/* DC calibration table lookups are skipped while the FPGA tracks the RX DC
+ * offset */
+static inline bool dc_cal_tracked(struct bladerf *dev, bladerf_module module)
+{
+    return module == BLADERF_MODULE_RX &&
+           (dev->rx_tracking & BLADERF_RX_TRACK_DC) != 0;
+}
+
+/* Apply the DC offset correction for the specified LMS frequency, from the
+ * module's DC calibration table */
+static int apply_dc_cal(struct bladerf *dev, bladerf_module module,
+                        const struct dc_cal_tbl *dc_cal,
+                        unsigned int frequency)
 {
     int status;
-    bladerf_xb attached;
     int16_t dc_i, dc_q;
-    const struct dc_cal_tbl *dc_cal =
-        (module == BLADERF_MODULE_RX) ? dev->cal.dc_rx : dev->cal.dc_tx;
+    int gain = 0;
 
-    status = xb_get_attached(dev, &attached);
-    if (status) {
+    if (dc_cal->n_gains > 1) {
+        /* The gain axis describes the stage following the DC correction */
+        if (module == BLADERF_MODULE_RX) {
+            status = lms_rxvga2_get_gain(dev, &gain);
+        } else {
+            status = lms_txvga1_get_gain(dev, &gain);
+        }
+
+        if (status != 0) {
+            return status;
+        }
+    }
+
+    dc_cal_tbl_vals(dc_cal, frequency, gain, &dc_i, &dc_q);
+
+    status = lms_set_dc_offsets(dev, module, dc_i, dc_q);
+    if (status != 0) {
         return status;
     }
 
-    if (attached == BLADERF_XB_200) {
+    log_verbose("Set %s DC offset cal (I, Q) to: (%d, %d)\n",
+                (module == BLADERF_MODULE_RX) ? "RX" : "TX", dc_i, dc_q);
 
-        if (frequency < BLADERF_FREQUENCY_MIN) {
+    return 0;
+}
 
-            status = xb200_set_path(dev, module, BLADERF_XB200_MIX);
-            if (status) {
-                return status;
-            }
+/* Route the XB-200 for a module's frequency, and map the frequency to the one
+ * the LMS6002D must be tuned to */
+static int xb200_route(struct bladerf *dev, bladerf_module module,
+                       unsigned int *frequency)
+{
+    int status;
+    struct tuning_timer phase;
 
-            status = xb200_auto_filter_selection(dev, module, frequency);
-            if (status) {
-                return status;
-            }
+    tuning_timer_start(dev, &phase);
 
-            frequency = 1248000000 - frequency;
+    if (*frequency < BLADERF_FREQUENCY_MIN) {
 
-        } else {
-            status = xb200_set_path(dev, module, BLADERF_XB200_BYPASS);
-            if (status)
-                return status;
+        status = xb200_set_path(dev, module, BLADERF_XB200_MIX);
+        if (status) {
+            return status;
         }
+
+        status = xb200_auto_filter_selection(dev, module, *frequency);
+        if (status) {
+            return status;
+        }
+
+        *frequency = 1248000000 - *frequency;
+
+    } else {
+        status = xb200_set_path(dev, module, BLADERF_XB200_BYPASS);
+        if (status)
+            return status;
     }
 
-    status = lms_set_frequency(dev, module, frequency);
-    if (status != 0) {
+    tuning_timer_stop(dev, module, BLADERF_TUNING_PHASE_XB200, &phase);
+    return 0;
+}
+
+/* Tune one module, or both RX and TX to the same frequency */
+static int set_freq(struct bladerf *dev, const bladerf_module *modules,
+                    size_t n, unsigned int frequency)
+{
+    int status;
+    size_t i;
+    bladerf_xb attached;
+    struct tuning_timer total, phase[NUM_MODULES];
+    const struct bladerf_tuning_phase_stats *vcocap[NUM_MODULES];
+    uint64_t vcocap_us[NUM_MODULES], vcocap_requests[NUM_MODULES];
+    unsigned int lms_freq = frequency;
+
+    tuning_timer_start(dev, &total);
+
+    status = xb_get_attached(dev, &attached);
+    if (status) {
         return status;
     }
 
-    status = tuning_select_band(dev, module, frequency);
+    if (attached == BLADERF_XB_200) {
+        for (i = 0; i < n; i++) {
+            lms_freq = frequency;
+            status = xb200_route(dev, modules[i], &lms_freq);
+            if (status != 0) {
+                return status;
+            }
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        vcocap[i] = &dev->tuning_stats[modules[i]]
+                        .phases[BLADERF_TUNING_PHASE_VCOCAP];
+        vcocap_us[i] = vcocap[i]->total_us;
+        vcocap_requests[i] = vcocap[i]->requests;
+        tuning_timer_start(dev, &phase[i]);
+    }
+
+    if (n == 1) {
+        status = lms_set_frequency(dev, modules[0], lms_freq);
+    } else {
+        status = lms_set_frequency_both(dev, lms_freq);
+    }
+
     if (status != 0) {
         return status;
     }
 
-    if (dc_cal != NULL) {
-        dc_cal_tbl_vals(dc_cal, frequency, &dc_i, &dc_q);
+    /* The VCOCAP selection is accounted for separately, by lms.c */
+    for (i = 0; i < n; i++) {
+        phase[i].start_us += vcocap[i]->total_us - vcocap_us[i];
+        phase[i].requests += vcocap[i]->requests - vcocap_requests[i];
+        tuning_timer_stop(dev, modules[i], BLADERF_TUNING_PHASE_PLL, &phase[i]);
+    }
+
+    for (i = 0; i < n; i++) {
+        const bladerf_module module = modules[i];
+        const struct dc_cal_tbl *dc_cal =
+            (module == BLADERF_MODULE_RX) ? dev->cal.dc_rx : dev->cal.dc_tx;
+
+        tuning_timer_start(dev, &phase[i]);
 
-        status = dev->fn->set_correction(dev, module,
-                                         BLADERF_CORR_LMS_DCOFF_I, dc_i);
+        status = tuning_select_band(dev, module, lms_freq);
         if (status != 0) {
             return status;
         }
 
-        status = dev->fn->set_correction(dev, module,
-                                         BLADERF_CORR_LMS_DCOFF_Q, dc_q);
-        if (status != 0) {
-            return status;
+        tuning_timer_stop(dev, module, BLADERF_TUNING_PHASE_BAND, &phase[i]);
+
+        if (dc_cal != NULL && !dc_cal_tracked(dev, module)) {
+            tuning_timer_start(dev, &phase[i]);
+
+            status = apply_dc_cal(dev, module, dc_cal, lms_freq);
+            if (status != 0) {
+                return status;
+            }
+
+            tuning_timer_stop(dev, module, BLADERF_TUNING_PHASE_DC_CAL,
+                              &phase[i]);
         }
+    }
 
-        log_verbose("Set %s DC offset cal (I, Q) to: (%d, %d)\n",
-                    (module == BLADERF_MODULE_RX) ? "RX" : "TX", dc_i, dc_q);
+    for (i = 0; i < n; i++) {
+        tuning_timer_stop(dev, modules[i], BLADERF_TUNING_PHASE_TOTAL, &total);
     }
 
-    return status;
+    return 0;
+}
+
+int tuning_set_freq(struct bladerf *dev, bladerf_module module,
+                    unsigned int frequency)
+{
+    return set_freq(dev, &module, 1, frequency);
+}
+
+int tuning_set_freq_both(struct bladerf *dev, unsigned int frequency)
+{
+    static const bladerf_module modules[] = {
+        BLADERF_MODULE_RX, BLADERF_MODULE_TX
+    };
+
+    return set_freq(dev, modules, ARRAY_SIZE(modules), frequency);
+}
+
+int tuning_update_dc_cal(struct bladerf *dev, bladerf_module module)
+{
+    int status;
+    struct lms_freq f;
+    const struct dc_cal_tbl *dc_cal =
+        (module == BLADERF_MODULE_RX) ? dev->cal.dc_rx : dev->cal.dc_tx;
+
+    if (dc_cal == NULL || dc_cal->n_gains <= 1 || dc_cal_tracked(dev, module)) {
+        return 0;
+    }
+
+    status = lms_get_frequency(dev, module, &f);
+    if (status != 0) {
+        return status;
+    }
+
+    return apply_dc_cal(dev, module, dc_cal, lms_frequency_to_hz(&f));
 }
 
 int tuning_get_freq(struct bladerf *dev, bladerf_module module,
@@ -167,5 +345,251 @@ int tuning_get_freq(struct bladerf *dev, bladerf_module module,
     return rv;
 }
 
+int tuning_get_quick_tune(struct bladerf *dev, bladerf_module module,
+                          struct bladerf_quick_tune *quick_tune)
+{
+    int status;
+    bladerf_xb attached;
+
+    status = lms_get_quick_tune(dev, module, quick_tune);
+    if (status != 0) {
+        return status;
+    }
+
+    status = lms_get_dc_offset(dev, module, BLADERF_CORR_LMS_DCOFF_I,
+                               &quick_tune->dc_i);
+    if (status != 0) {
+        return status;
+    }
+
+    status = lms_get_dc_offset(dev, module, BLADERF_CORR_LMS_DCOFF_Q,
+                               &quick_tune->dc_q);
+    if (status != 0) {
+        return status;
+    }
+
+    status = xb_get_attached(dev, &attached);
+    if (status != 0) {
+        return status;
+    }
+
+    quick_tune->xb200 = (attached == BLADERF_XB_200);
+    quick_tune->xb200_path = BLADERF_XB200_BYPASS;
+    quick_tune->xb200_filter = BLADERF_XB200_CUSTOM;
+
+    if (quick_tune->xb200) {
+        status = xb200_get_path(dev, module, &quick_tune->xb200_path);
+        if (status != 0) {
+            return status;
+        }
+
+        status = xb200_get_filterbank(dev, module, &quick_tune->xb200_filter);
+    }
+
+    return status;
+}
+
+/* XB-200 settings are only applied if they were captured and the board is
+ * still attached */
+static int quick_tune_xb200(struct bladerf *dev,
+                            const struct bladerf_quick_tune *quick_tune,
+                            bool *apply)
+{
+    int status;
+    bladerf_xb attached;
+
+    *apply = false;
+
+    if (!quick_tune->xb200) {
+        return 0;
+    }
+
+    status = xb_get_attached(dev, &attached);
+    if (status == 0) {
+        *apply = (attached == BLADERF_XB_200);
+    }
+
+    return status;
+}
+
+int tuning_quick_retune(struct bladerf *dev, bladerf_module module,
+                        const struct bladerf_quick_tune *quick_tune)
+{
+    int status;
+    bool xb200;
+    struct tuning_timer t;
+
+    tuning_timer_start(dev, &t);
+
+    status = quick_tune_xb200(dev, quick_tune, &xb200);
+    if (status != 0) {
+        return status;
+    }
+
+    if (xb200) {
+        status = xb200_set_state(dev, module, quick_tune->xb200_path,
+                                 quick_tune->xb200_filter);
+        if (status != 0) {
+            return status;
+        }
+    }
+
+    status = lms_set_quick_tune(dev, module, quick_tune);
+    if (status != 0) {
+        return status;
+    }
+
+    status = tuning_select_band(dev, module, quick_tune->frequency);
+    if (status != 0) {
+        return status;
+    }
+
+    status = lms_set_dc_offsets(dev, module, quick_tune->dc_i, quick_tune->dc_q);
+    if (status == 0) {
+        tuning_timer_stop(dev, module, BLADERF_TUNING_PHASE_QUICK, &t);
+    }
+
+    return status;
+}
+
+int tuning_schedule_retune(struct bladerf *dev, bladerf_module module,
+                           uint64_t timestamp,
+                           const struct bladerf_quick_tune *quick_tune)
+{
+    static const uint8_t retune_reg_offsets[] = { 0, 1, 2, 3, 5, 9 };
+    int status;
+    bool xb200;
+    size_t i;
+    uint8_t base;
+    struct backend_retune regs;
+
+    if (dev->fn->schedule_retune == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 3)) {
+        log_warning("Scheduled retunes require FPGA v0.1.3 or later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    status = lms_get_retune_regs(dev, module, quick_tune, &regs);
+    if (status != 0) {
+        return status;
+    }
+
+    /* The FPGA will write these registers behind our back */
+    base = (module == BLADERF_MODULE_RX) ? 0x20 : 0x10;
+    for (i = 0; i < ARRAY_SIZE(retune_reg_offsets); i++) {
+        lms_shadow_mark_volatile(dev, base + retune_reg_offsets[i]);
+    }
+    lms_shadow_mark_volatile(dev, 0x09);
+
+    status = dev->fn->schedule_retune(dev, module, timestamp, &regs);
+    if (status != 0) {
+        return status;
+    }
+
+    status = quick_tune_xb200(dev, quick_tune, &xb200);
+    if (status == 0 && xb200) {
+        status = xb200_schedule_state(dev, module, timestamp,
+                                      quick_tune->xb200_path,
+                                      quick_tune->xb200_filter);
+    }
+
+    return status;
+}
+
+/* The DDC shifts the spectrum by dphase / 2^32 of the sample rate, so a
+ * signal at +offset is brought to DC by a negative phase increment. */
+static int freq_offset_check(struct bladerf *dev, bladerf_module module)
+{
+    if (module != BLADERF_MODULE_RX) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    if (dev->fn->set_rx_nco == NULL || dev->fn->get_rx_nco == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
+    }
+
+    if (version_less_than(&dev->fpga_version, 0, 1, 6)) {
+        log_warning("Frequency offsets require FPGA v0.1.6 or later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    return 0;
+}
+
+int tuning_set_freq_offset(struct bladerf *dev, bladerf_module module,
+                           int32_t offset)
+{
+    int status;
+    unsigned int rate;
+    int64_t num;
+    int32_t dphase;
+
+    status = freq_offset_check(dev, module);
+    if (status != 0) {
+        return status;
+    }
+
+    status = si5338_get_sample_rate(dev, module, &rate);
+    if (status != 0) {
+        return status;
+    }
+
+    if (rate == 0 || (int64_t) offset * 2 >= (int64_t) rate ||
+        (int64_t) offset * 2 <= -(int64_t) rate) {
+        log_debug("Frequency offset %d Hz is outside of +/- %u/2 Hz\n",
+                  offset, rate);
+        return BLADERF_ERR_INVAL;
+    }
+
+    /* Round to the nearest phase increment */
+    num = -(int64_t) offset * ((int64_t) 1 << 32);
+    if (num >= 0) {
+        num += rate / 2;
+    } else {
+        num -= rate / 2;
+    }
+
+    dphase = (int32_t) (num / (int64_t) rate);
+
+    log_verbose("%s: offset=%d Hz, dphase=%d\n", __FUNCTION__,
+                offset, dphase);
+
+    return dev->fn->set_rx_nco(dev, dphase);
+}
+
+int tuning_get_freq_offset(struct bladerf *dev, bladerf_module module,
+                           int32_t *offset)
+{
+    int status;
+    unsigned int rate;
+    int32_t dphase;
+    int64_t num;
 
+    status = freq_offset_check(dev, module);
+    if (status != 0) {
+        return status;
+    }
+
+    status = si5338_get_sample_rate(dev, module, &rate);
+    if (status != 0) {
+        return status;
+    }
 
+    status = dev->fn->get_rx_nco(dev, &dphase);
+    if (status != 0) {
+        return status;
+    }
+
+    num = -(int64_t) dphase * (int64_t) rate;
+    if (num >= 0) {
+        num += (int64_t) 1 << 31;
+    } else {
+        num -= (int64_t) 1 << 31;
+    }
+
+    *offset = (int32_t) (num / ((int64_t) 1 << 32));
+    return 0;
+}
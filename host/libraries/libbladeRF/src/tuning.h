@@ -25,6 +25,36 @@
 #ifndef BLADERF_TUNING_H_
 #define BLADERF_TUNING_H_
 
+#include <stdint.h>
+#include "libbladeRF.h"
+
+/* Start of a tuning phase being profiled */
+struct tuning_timer {
+    uint64_t start_us;
+    uint64_t requests;      /* dev->ctrl_requests at the start */
+};
+
+/**
+ * Begin timing a tuning phase
+ *
+ * @param[in]   dev     Device handle
+ * @param[out]  t       Timer to start
+ */
+void tuning_timer_start(struct bladerf *dev, struct tuning_timer *t);
+
+/**
+ * Account for a tuning phase, from the time its timer was started, in the
+ * module's tuning statistics
+ *
+ * @param   dev     Device handle
+ * @param   module  Module being tuned
+ * @param   phase   Phase that was performed
+ * @param   t       Timer started at the beginning of the phase
+ */
+void tuning_timer_stop(struct bladerf *dev, bladerf_module module,
+                       bladerf_tuning_phase phase,
+                       const struct tuning_timer *t);
+
 /**
  * Configure the device for operation in the high or low band, based
  * upon the provided frequency
@@ -49,6 +79,47 @@ int tuning_select_band(struct bladerf *dev, bladerf_module module,
  */
 int tuning_set_freq(struct bladerf *dev, bladerf_module module,
                     unsigned int frequency);
+
+/**
+ * Tune both RX and TX to the specified frequency, sharing the PLL
+ * configuration and VCOCAP searches' control transfers between the modules
+ *
+ * @param   dev         Device handle
+ * @param   frequency   Desired frequency
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int tuning_set_freq_both(struct bladerf *dev, unsigned int frequency);
+/**
+ * Re-apply the DC offset correction from the module's DC calibration table,
+ * following a change in gain. This is a no-op if the table does not
+ * account for gain.
+ *
+ * @param   dev         Device handle
+ * @param   module      Module to update
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int tuning_update_dc_cal(struct bladerf *dev, bladerf_module module);
+
+/**
+ * Get a module's frequency change statistics
+ *
+ * @param[in]   dev     Device handle
+ * @param[in]   module  Module to query
+ * @param[out]  stats   Module's statistics
+ */
+void tuning_get_stats(struct bladerf *dev, bladerf_module module,
+                      struct bladerf_tuning_stats *stats);
+
+/**
+ * Clear a module's frequency change statistics
+ *
+ * @param   dev     Device handle
+ * @param   module  Module to reset statistics for
+ */
+void tuning_reset_stats(struct bladerf *dev, bladerf_module module);
+
 /**
  * Get the current frequency that the specified module is tuned to
  *
@@ -61,5 +132,65 @@ int tuning_set_freq(struct bladerf *dev, bladerf_module module,
 int tuning_get_freq(struct bladerf *dev, bladerf_module module,
                     unsigned int *frequency);
 
+/**
+ * Fetch the parameters needed to quickly return to the current frequency
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to query
+ * @param[out]  quick_tune  Quick retune parameters
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int tuning_get_quick_tune(struct bladerf *dev, bladerf_module module,
+                          struct bladerf_quick_tune *quick_tune);
+
+/**
+ * Retune using parameters from tuning_get_quick_tune()
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to configure
+ * @param[in]   quick_tune  Quick retune parameters
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int tuning_quick_retune(struct bladerf *dev, bladerf_module module,
+                        const struct bladerf_quick_tune *quick_tune);
+/**
+ * Queue a retune to be performed by the FPGA at the specified timestamp
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to retune
+ * @param[in]   timestamp   Timestamp at which to retune
+ * @param[in]   quick_tune  Quick retune parameters
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int tuning_schedule_retune(struct bladerf *dev, bladerf_module module,
+                           uint64_t timestamp,
+                           const struct bladerf_quick_tune *quick_tune);
+
+/**
+ * Apply a fine frequency offset using the FPGA's digital down-converter
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to configure
+ * @param[in]   offset      Offset in Hz, less than half the sample rate
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int tuning_set_freq_offset(struct bladerf *dev, bladerf_module module,
+                           int32_t offset);
+
+/**
+ * Get the fine frequency offset applied by the FPGA's digital down-converter
+ *
+ * @param[in]   dev         Device handle
+ * @param[in]   module      Module to query
+ * @param[out]  offset      Offset in Hz
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+int tuning_get_freq_offset(struct bladerf *dev, bladerf_module module,
+                           int32_t *offset);
 
 #endif
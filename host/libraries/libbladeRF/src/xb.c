@@ -61,6 +61,72 @@
 #define BLADERF_XB_RX_MASK   0x30000000
 #define BLADERF_XB_RX_SHIFT  28
 
+void xb_shadow_invalidate(struct bladerf *dev)
+{
+    memset(&dev->xb_shadow, 0, sizeof(dev->xb_shadow));
+}
+
+int xb_gpio_read(struct bladerf *dev, uint32_t *val)
+{
+    int status;
+
+    if (dev->xb_shadow.gpio_valid) {
+        *val = dev->xb_shadow.gpio;
+        return 0;
+    }
+
+    status = XB_GPIO_READ(dev, val);
+    if (status == 0) {
+        dev->xb_shadow.gpio = *val;
+        dev->xb_shadow.gpio_valid = true;
+    }
+
+    return status;
+}
+
+int xb_gpio_write(struct bladerf *dev, uint32_t val)
+{
+    int status;
+
+    status = XB_GPIO_WRITE(dev, val);
+
+    /* A failed write may or may not have taken effect */
+    dev->xb_shadow.gpio = val;
+    dev->xb_shadow.gpio_valid = (status == 0);
+
+    return status;
+}
+
+int xb_gpio_dir_read(struct bladerf *dev, uint32_t *val)
+{
+    int status;
+
+    if (dev->xb_shadow.gpio_dir_valid) {
+        *val = dev->xb_shadow.gpio_dir;
+        return 0;
+    }
+
+    status = XB_GPIO_DIR_READ(dev, val);
+    if (status == 0) {
+        dev->xb_shadow.gpio_dir = *val;
+        dev->xb_shadow.gpio_dir_valid = true;
+    }
+
+    return status;
+}
+
+int xb_gpio_dir_write(struct bladerf *dev, uint32_t val)
+{
+    int status;
+
+    status = XB_GPIO_DIR_WRITE(dev, val);
+
+    dev->xb_shadow.gpio_dir = val;
+    dev->xb_shadow.gpio_dir_valid = (status == 0);
+
+    return status;
+}
+
 static int xb200_attach(struct bladerf *dev) {
     int status = 0;
     uint32_t val;
@@ -87,13 +153,11 @@ static int xb200_attach(struct bladerf *dev) {
     val |= 0x80000000;
     if ((status = CONFIG_GPIO_WRITE(dev, val)))
         return status;
-    if ((status = XB_GPIO_READ(dev, &val)))
-        return status;
 
-    if ((status = XB_GPIO_DIR_WRITE(dev, 0x3C00383E)))
+    if ((status = xb_gpio_dir_write(dev, 0x3C00383E)))
         return status;
 
-    if ((status = XB_GPIO_WRITE(dev, 0x800)))
+    if ((status = xb_gpio_write(dev, 0x800)))
         return status;
 
     // Load ADF4351 registers via SPI
@@ -121,7 +185,7 @@ static int xb200_attach(struct bladerf *dev) {
     else {
         log_debug("  MUXOUT Bit not set: FAIL\n");
     }
-    status = XB_GPIO_WRITE(dev, 0x3C000800);
+    status = xb_gpio_write(dev, 0x3C000800);
 
     return status;
 }
@@ -130,7 +194,7 @@ int xb200_enable(struct bladerf *dev, bool enable) {
     int status;
     uint32_t val, orig;
 
-    status = XB_GPIO_READ(dev, &orig);
+    status = xb_gpio_read(dev, &orig);
     if (status)
         return status;
 
@@ -143,7 +207,7 @@ int xb200_enable(struct bladerf *dev, bool enable) {
     if (status || (val == orig))
         return status;
 
-    return XB_GPIO_WRITE(dev, val);
+    return xb_gpio_write(dev, val);
 }
 
 int xb_attach(struct bladerf *dev, bladerf_xb xb) {
@@ -206,6 +270,9 @@ int xb_attach(struct bladerf *dev, bladerf_xb xb) {
             break;
     }
 
+    /* Attaching reconfigures both the config and expansion GPIOs */
+    xb_shadow_invalidate(dev);
+
     return status;
 }
 
@@ -213,11 +280,19 @@ int xb_get_attached(struct bladerf *dev, bladerf_xb *xb) {
     int status;
     uint32_t val;
 
+    if (dev->xb_shadow.attached_valid) {
+        *xb = dev->xb_shadow.attached;
+        return 0;
+    }
+
     status = CONFIG_GPIO_READ(dev, &val);
     if (status)
         return status;
 
     *xb = (val >> 30) & 0x3;
+
+    dev->xb_shadow.attached = *xb;
+    dev->xb_shadow.attached_valid = true;
     return 0;
 }
 
@@ -225,7 +300,7 @@ int xb200_get_filterbank(struct bladerf *dev, bladerf_module module, bladerf_xb2
     int status;
     uint32_t val;
 
-    status = XB_GPIO_READ(dev, &val);
+    status = xb_gpio_read(dev, &val);
     if (status)
         return status;
 
@@ -247,13 +322,13 @@ int xb200_set_filterbank(struct bladerf *dev, bladerf_module module, bladerf_xb2
         }
     }
 
-    status = XB_GPIO_READ(dev, &orig);
+    status = xb_gpio_read(dev, &orig);
     val = orig & ~bits;
     val |= filter << ((module == BLADERF_MODULE_RX) ? BLADERF_XB_RX_SHIFT : BLADERF_XB_TX_SHIFT);
     if (status || (orig == val))
         return status;
 
-    return XB_GPIO_WRITE(dev, val);
+    return xb_gpio_write(dev, val);
 }
 
 int xb200_auto_filter_selection(struct bladerf *dev, bladerf_module mod, unsigned int frequency) {
@@ -297,10 +372,40 @@ int xb200_auto_filter_selection(struct bladerf *dev, bladerf_module mod, unsigne
     return status;
 }
 
-int xb200_set_path(struct bladerf *dev, bladerf_module module, bladerf_xb200_path path) {
-    int status;
-    uint32_t val;
+#define LMS_RX_SWAP 0x40
+#define LMS_TX_SWAP 0x08
+
+static uint32_t xb200_path_bits(uint32_t val, bladerf_module module,
+                                bladerf_xb200_path path)
+{
+    val &= ~((module == BLADERF_MODULE_RX) ? (BLADERF_XB_CONFIG_RX_BYPASS_MASK | BLADERF_XB_RX_ENABLE) : (BLADERF_XB_CONFIG_TX_BYPASS_MASK | BLADERF_XB_TX_ENABLE));
+    if (module == BLADERF_MODULE_RX)
+        val |= (path == BLADERF_XB200_MIX) ? (BLADERF_XB_RX_ENABLE | BLADERF_XB_CONFIG_RX_PATH_MIX) : BLADERF_XB_CONFIG_RX_PATH_BYPASS;
+    else
+        val |= (path == BLADERF_XB200_MIX) ? (BLADERF_XB_TX_ENABLE | BLADERF_XB_CONFIG_TX_PATH_MIX) : BLADERF_XB_CONFIG_TX_PATH_BYPASS;
 
+    return val;
+}
+
+static uint32_t xb200_filter_bits(uint32_t val, bladerf_module module,
+                                  bladerf_xb200_filter filter)
+{
+    if (module == BLADERF_MODULE_RX) {
+        val &= ~BLADERF_XB_RX_MASK;
+        val |= (filter << BLADERF_XB_RX_SHIFT) & BLADERF_XB_RX_MASK;
+    } else {
+        val &= ~BLADERF_XB_TX_MASK;
+        val |= (filter << BLADERF_XB_TX_SHIFT) & BLADERF_XB_TX_MASK;
+    }
+
+    return val;
+}
+
+/* The LMS6002D swaps its RX or TX path to route through the XB-200 mixer */
+static int xb200_set_lms_swap(struct bladerf *dev, bladerf_module module,
+                              bladerf_xb200_path path)
+{
+    int status;
     uint8_t lval, lorig = 0;
 
     status = LMS_READ( dev, 0x5A, &lorig );
@@ -308,49 +413,122 @@ int xb200_set_path(struct bladerf *dev, bladerf_module module, bladerf_xb200_pat
         return status;
     lval = lorig;
 
-#define LMS_RX_SWAP 0x40
-#define LMS_TX_SWAP 0x08
-
     if (path == BLADERF_XB200_MIX)
         lval |= (module == BLADERF_MODULE_RX) ? LMS_RX_SWAP : LMS_TX_SWAP;
     else
         lval &= ~((module == BLADERF_MODULE_RX) ? LMS_RX_SWAP : LMS_TX_SWAP);
 
+    if (lval == lorig)
+        return 0;
+
+    return LMS_WRITE(dev, 0x5A, lval);
+}
+
+/* Read the expansion GPIO outputs, first powering up the XB-200 if needed */
+static int xb200_gpio_read_on(struct bladerf *dev, uint32_t *val)
+{
+    int status;
+
+    status = xb_gpio_read(dev, val);
     if (status)
         return status;
 
-    status = LMS_WRITE(dev, 0x5A, lval);
+    if (!(*val & BLADERF_XB_RF_ON)) {
+        status = xb200_attach(dev);
+        if (status)
+            return status;
+
+        status = xb_gpio_read(dev, val);
+    }
+
+    return status;
+}
+
+int xb200_set_path(struct bladerf *dev, bladerf_module module, bladerf_xb200_path path) {
+    int status;
+    uint32_t val, orig;
+
+    status = xb200_set_lms_swap(dev, module, path);
     if (status)
         return status;
 
-    status = XB_GPIO_READ(dev, &val);
+    status = xb200_gpio_read_on(dev, &orig);
     if (status)
         return status;
 
-    status = XB_GPIO_READ(dev, &val);
+    val = xb200_path_bits(orig | BLADERF_XB_RF_ON, module, path);
+    if (val == orig)
+        return 0;
+
+    return xb_gpio_write(dev, val);
+}
+
+int xb200_set_state(struct bladerf *dev, bladerf_module module,
+                    bladerf_xb200_path path, bladerf_xb200_filter filter)
+{
+    int status;
+    uint32_t val, orig;
+
+    status = xb200_set_lms_swap(dev, module, path);
     if (status)
         return status;
-    if (!(val & BLADERF_XB_RF_ON)) {
-        status = xb200_attach(dev);
-        if (status)
-            return status;
+
+    status = xb200_gpio_read_on(dev, &orig);
+    if (status)
+        return status;
+
+    val = xb200_path_bits(orig | BLADERF_XB_RF_ON, module, path);
+    val = xb200_filter_bits(val, module, filter);
+    if (val == orig)
+        return 0;
+
+    return xb_gpio_write(dev, val);
+}
+
+int xb200_schedule_state(struct bladerf *dev, bladerf_module module,
+                         uint64_t timestamp, bladerf_xb200_path path,
+                         bladerf_xb200_filter filter)
+{
+    int status;
+    uint32_t val, orig;
+
+    status = xb_gpio_read(dev, &orig);
+    if (status)
+        return status;
+
+    val = xb200_path_bits(orig, module, path);
+    val = xb200_filter_bits(val, module, filter);
+    if (val == orig)
+        return 0;
+
+    if (dev->fn->schedule_xb200 == NULL) {
+        return BLADERF_ERR_UNSUPPORTED;
     }
-    val |= BLADERF_XB_RF_ON;
 
-    val &= ~((module == BLADERF_MODULE_RX) ? (BLADERF_XB_CONFIG_RX_BYPASS_MASK | BLADERF_XB_RX_ENABLE) : (BLADERF_XB_CONFIG_TX_BYPASS_MASK | BLADERF_XB_TX_ENABLE));
-    if (module == BLADERF_MODULE_RX)
-        val |= (path == BLADERF_XB200_MIX) ? (BLADERF_XB_RX_ENABLE | BLADERF_XB_CONFIG_RX_PATH_MIX) : BLADERF_XB_CONFIG_RX_PATH_BYPASS;
-    else
-        val |= (path == BLADERF_XB200_MIX) ? (BLADERF_XB_TX_ENABLE | BLADERF_XB_CONFIG_TX_PATH_MIX) : BLADERF_XB_CONFIG_TX_PATH_BYPASS;
+    if (version_less_than(&dev->fpga_version, 0, 1, 15)) {
+        log_warning("Scheduled XB-200 changes require FPGA v0.1.15 or later.\n");
+        return BLADERF_ERR_UPDATE_FPGA;
+    }
+
+    status = dev->fn->schedule_xb200(dev, module, timestamp, val,
+                                     path == BLADERF_XB200_MIX);
+    if (status)
+        return status;
 
-    return XB_GPIO_WRITE(dev, val);
+    /* The shadow describes the state once the queued changes are applied,
+     * so that later hops only schedule what differs from their
+     * predecessor. The FPGA will write the LMS swap bits behind our back. */
+    dev->xb_shadow.gpio = val;
+    lms_shadow_mark_volatile(dev, 0x5A);
+
+    return 0;
 }
 
 int xb200_get_path(struct bladerf *dev, bladerf_module module, bladerf_xb200_path *path) {
     int status;
     uint32_t val;
 
-    status = XB_GPIO_READ(dev, &val);
+    status = xb_gpio_read(dev, &val);
     if (status)
         return status;
     if (module == BLADERF_MODULE_RX)
@@ -34,6 +34,55 @@
 #define XB_GPIO_DIR_READ(dev, val)  dev->fn->expansion_gpio_dir_read(dev, val)
 #define XB_GPIO_DIR_WRITE(dev, val) dev->fn->expansion_gpio_dir_write(dev, val)
 
+/**
+ * Discard the shadowed expansion board state, so that it is next read back
+ * from the device
+ *
+ * @param       dev         Device handle
+ */
+void xb_shadow_invalidate(struct bladerf *dev);
+
+/**
+ * Read the expansion GPIO outputs, from the shadow when possible. Input pins
+ * read back as last written, so use XB_GPIO_READ() to sample them.
+ *
+ * @param       dev         Device handle
+ * @param[out]  val         GPIO register value
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int xb_gpio_read(struct bladerf *dev, uint32_t *val);
+
+/**
+ * Write the expansion GPIO register, updating its shadow
+ *
+ * @param       dev         Device handle
+ * @param       val         GPIO register value
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int xb_gpio_write(struct bladerf *dev, uint32_t val);
+
+/**
+ * Read the expansion GPIO direction register, from the shadow when possible
+ *
+ * @param       dev         Device handle
+ * @param[out]  val         Direction register value
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int xb_gpio_dir_read(struct bladerf *dev, uint32_t *val);
+
+/**
+ * Write the expansion GPIO direction register, updating its shadow
+ *
+ * @param       dev         Device handle
+ * @param       val         Direction register value
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int xb_gpio_dir_write(struct bladerf *dev, uint32_t val);
+
 /**
  * Attach and enable an expansion board's features
  *
@@ -45,7 +94,8 @@
 int xb_attach(struct bladerf *dev, bladerf_xb xb);
 
 /**
- * Determine which expansion board is attached
+ * Determine which expansion board is attached. This is only read from the
+ * device once after each xb_shadow_invalidate().
  *
  * @param       dev         Device handle
  * @param       xb          Expansion board
@@ -105,6 +155,38 @@ int xb200_set_path(struct bladerf *dev,
                    bladerf_module module,
                    bladerf_xb200_path path);
 
+/**
+ * Apply an XB-200 signal path and filter bank selection, only writing the
+ * registers whose values change
+ *
+ * @param       dev         Device handle
+ * @param       module      Module to configure
+ * @param       path        XB-200 signal path
+ * @param       filter      XB-200 filter bank, other than an automatic
+ *                          selection
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int xb200_set_state(struct bladerf *dev, bladerf_module module,
+                    bladerf_xb200_path path, bladerf_xb200_filter filter);
+
+/**
+ * Queue an XB-200 signal path and filter bank change in the FPGA, if it
+ * differs from the previously applied or scheduled state
+ *
+ * @param       dev         Device handle
+ * @param       module      Module to configure
+ * @param       timestamp   Timestamp at which to apply the change
+ * @param       path        XB-200 signal path
+ * @param       filter      XB-200 filter bank, other than an automatic
+ *                          selection
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int xb200_schedule_state(struct bladerf *dev, bladerf_module module,
+                         uint64_t timestamp, bladerf_xb200_path path,
+                         bladerf_xb200_filter filter);
+
 /**
  * Get the current XB-200 signal path
  *
@@ -0,0 +1,190 @@
+/*
+ * Heap allocation counters
+ *
+ * The executable's definitions of the allocator's entry points take
+ * precedence over the C library's, including for calls made by libbladeRF.
+ * Each call is counted while armed, and forwarded to the next definition in
+ * the lookup order, found via dlsym(RTLD_NEXT, ...).
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <dlfcn.h>
+
+#include "thread.h"
+#include "alloc_hooks.h"
+
+static void *(*real_malloc)(size_t);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static void (*real_free)(void *);
+
+static volatile uint32_t armed;
+static volatile uint32_t count;
+static void * volatile first_caller;
+
+/* dlsym() may itself allocate memory. Such requests, made while the real
+ * functions are being looked up, are served from a zero-filled static pool
+ * whose memory is never released. */
+#define BOOTSTRAP_POOL_SIZE 8192
+static uint8_t bootstrap_pool[BOOTSTRAP_POOL_SIZE]
+    __attribute__((aligned(16)));
+static size_t bootstrap_used;
+static bool resolving;
+
+static void *bootstrap_alloc(size_t size)
+{
+    void *ret;
+
+    size = (size + 15) & ~((size_t) 15);
+    if (size > BOOTSTRAP_POOL_SIZE - bootstrap_used) {
+        return NULL;
+    }
+
+    ret = &bootstrap_pool[bootstrap_used];
+    bootstrap_used += size;
+    return ret;
+}
+
+static inline bool from_bootstrap(const void *ptr)
+{
+    const uint8_t *p = (const uint8_t *) ptr;
+    return p >= bootstrap_pool && p < bootstrap_pool + BOOTSTRAP_POOL_SIZE;
+}
+
+static void resolve(void)
+{
+    resolving = true;
+    *(void **) &real_calloc = dlsym(RTLD_NEXT, "calloc");
+    *(void **) &real_malloc = dlsym(RTLD_NEXT, "malloc");
+    *(void **) &real_realloc = dlsym(RTLD_NEXT, "realloc");
+    *(void **) &real_free = dlsym(RTLD_NEXT, "free");
+    resolving = false;
+}
+
+/* Look up the real functions before any threads are created */
+__attribute__((constructor)) static void alloc_hooks_init(void)
+{
+    if (real_free == NULL) {
+        resolve();
+    }
+}
+
+static inline void record(void *caller)
+{
+    if (ATOMIC_LOAD_ACQUIRE(&armed)) {
+        if (ATOMIC_CAS_U32(&count, 0, 1)) {
+            first_caller = caller;
+        } else {
+            ATOMIC_INC_U32(&count);
+        }
+    }
+}
+
+void *malloc(size_t size)
+{
+    if (real_malloc == NULL) {
+        if (resolving) {
+            return bootstrap_alloc(size);
+        }
+        resolve();
+    }
+
+    record(__builtin_return_address(0));
+    return real_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    if (real_calloc == NULL) {
+        if (resolving) {
+            return (size == 0 || n <= SIZE_MAX / size) ?
+                        bootstrap_alloc(n * size) : NULL;
+        }
+        resolve();
+    }
+
+    record(__builtin_return_address(0));
+    return real_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (real_realloc == NULL) {
+        resolve();
+    }
+
+    record(__builtin_return_address(0));
+
+    if (from_bootstrap(ptr)) {
+        void *ret = real_malloc(size);
+        if (ret != NULL) {
+            const size_t avail = (size_t)
+                (bootstrap_pool + BOOTSTRAP_POOL_SIZE - (uint8_t *) ptr);
+            memcpy(ret, ptr, size < avail ? size : avail);
+        }
+        return ret;
+    }
+
+    return real_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    if (ptr == NULL || from_bootstrap(ptr)) {
+        return;
+    }
+
+    if (real_free == NULL) {
+        resolve();
+    }
+
+    record(__builtin_return_address(0));
+    real_free(ptr);
+}
+
+void alloc_hooks_arm(void)
+{
+    first_caller = NULL;
+    ATOMIC_STORE_RELEASE(&count, 0);
+    ATOMIC_STORE_RELEASE(&armed, 1);
+}
+
+unsigned int alloc_hooks_disarm(void)
+{
+    ATOMIC_STORE_RELEASE(&armed, 0);
+    return ATOMIC_LOAD_ACQUIRE(&count);
+}
+
+void *alloc_hooks_first_caller(void)
+{
+    return first_caller;
+}
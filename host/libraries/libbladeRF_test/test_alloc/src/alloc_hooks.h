@@ -0,0 +1,50 @@
+/*
+ * Heap allocation counters, implemented by interposing the C library's
+ * allocator
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef ALLOC_HOOKS_H_
+#define ALLOC_HOOKS_H_
+
+/**
+ * Begin counting calls to malloc(), calloc(), realloc(), and free(), made by
+ * any thread in the process. Frees of NULL pointers are not counted.
+ */
+void alloc_hooks_arm(void);
+
+/**
+ * Stop counting
+ *
+ * @return Number of calls counted since alloc_hooks_arm()
+ */
+unsigned int alloc_hooks_disarm(void);
+
+/**
+ * @return Return address of the first call counted since alloc_hooks_arm(),
+ *         or NULL if there were none
+ */
+void *alloc_hooks_first_caller(void);
+
+#endif
@@ -0,0 +1,378 @@
+/*
+ * This program verifies that libbladeRF does not allocate or free heap
+ * memory once streaming has been set up. RX and TX are streamed via the
+ * synchronous interface, while control calls are made between the transfers,
+ * and any allocator call made by any thread in the meantime fails the test.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <getopt.h>
+#include <dlfcn.h>
+#include <libbladeRF.h>
+
+#include "conversions.h"
+#include "test_common.h"
+#include "alloc_hooks.h"
+
+#define TEST_OPTIONS_STR    TEST_OPTIONS_BASE"t:w:c:"
+
+/* Number of samples per sync_rx() and sync_tx() call */
+#define BLOCK_SIZE  4096
+
+#ifdef CLOCK_MONOTONIC
+#   define TEST_CLOCK CLOCK_MONOTONIC
+#else
+#   define TEST_CLOCK CLOCK_REALTIME
+#endif
+
+struct app_params {
+    struct device_config dev_config;
+    unsigned int duration_ms;
+    unsigned int warmup_ms;
+    unsigned int ctrl_interval;
+};
+
+static struct option app_long_options[] = {
+    { "duration",       required_argument,  0,      't' },
+    { "warmup",         required_argument,  0,      'w' },
+    { "ctrl-interval",  required_argument,  0,      'c' },
+    { NULL,             0,                  0,      0 },
+};
+
+static const bladerf_format formats[] = {
+    BLADERF_FORMAT_SC16_Q11,
+    BLADERF_FORMAT_SC16_Q11_META,
+};
+
+int app_handle_args(int argc, char **argv,
+                    struct option *long_options, struct app_params *p)
+{
+    int c;
+    bool ok;
+
+    optind = 1;
+    c = getopt_long(argc, argv, TEST_OPTIONS_STR, long_options, NULL);
+    while (c >= 0) {
+
+        switch (c) {
+            case 't':
+                p->duration_ms = str2uint(optarg, 1, UINT_MAX, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Invalid duration: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'w':
+                p->warmup_ms = str2uint(optarg, 0, UINT_MAX, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Invalid warm-up time: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'c':
+                p->ctrl_interval = str2uint(optarg, 0, UINT_MAX, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Invalid control interval: %s\n", optarg);
+                    return -1;
+                }
+                break;
+        }
+
+        c = getopt_long(argc, argv, TEST_OPTIONS_STR, long_options, NULL);
+    }
+
+    return 0;
+}
+
+void print_usage(const char *argv0)
+{
+    printf("%s: Check for heap allocations while streaming\n", argv0);
+    printf("\n");
+    printf("For each sample format, RX and TX are streamed for a warm-up\n");
+    printf("period, after which any call to malloc(), calloc(), realloc(),\n");
+    printf("or free() made while streaming continues fails the test. Control\n");
+    printf("calls, such as bladerf_set_frequency(), are made periodically\n");
+    printf("between transfers. By default, the dummy device is used.\n");
+    printf("\n");
+    printf("Test-specific options:\n");
+    printf("  -t, --duration <ms>       Time to check for allocations (2000).\n");
+    printf("  -w, --warmup <ms>         Time to stream beforehand (250).\n");
+    printf("  -c, --ctrl-interval <n>   Make control calls every n transfers,\n");
+    printf("                            or never if 0 (8).\n");
+    printf("\n");
+    test_print_common_help();
+    printf("\n");
+}
+
+static inline unsigned int elapsed_ms(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(TEST_CLOCK, &now);
+
+    return (unsigned int) ((now.tv_sec - start->tv_sec) * 1000 +
+                           (now.tv_nsec - start->tv_nsec) / 1000000);
+}
+
+/* Control calls that are expected to be usable while streaming */
+static int ctrl_calls(struct bladerf *dev, struct app_params *p,
+                      unsigned int iteration)
+{
+    int status;
+    unsigned int freq;
+    uint64_t timestamp;
+    struct bladerf_stream_stats stats;
+
+    /* Alternate between the configured frequencies and 1 MHz above them */
+    const unsigned int offset = (iteration & 1) ? 1000000 : 0;
+
+    status = bladerf_set_frequency(dev, BLADERF_MODULE_RX,
+                                   p->dev_config.rx_frequency + offset);
+
+    if (status == 0) {
+        status = bladerf_set_frequency(dev, BLADERF_MODULE_TX,
+                                       p->dev_config.tx_frequency + offset);
+    }
+
+    if (status == 0) {
+        status = bladerf_get_frequency(dev, BLADERF_MODULE_RX, &freq);
+    }
+
+    if (status == 0) {
+        status = bladerf_get_timestamp(dev, BLADERF_MODULE_RX, &timestamp);
+    }
+
+    if (status == 0) {
+        status = bladerf_get_stream_stats(dev, BLADERF_MODULE_RX, &stats);
+    }
+
+    if (status != 0) {
+        fprintf(stderr, "Control call failed: %s\n",
+                bladerf_strerror(status));
+    }
+
+    return status;
+}
+
+/* Stream RX and TX for the specified time. If ctrl_interval is non-zero,
+ * control calls are made every ctrl_interval iterations. */
+static int stream(struct bladerf *dev, struct app_params *p,
+                  bladerf_format format, int16_t *samples,
+                  unsigned int duration_ms, unsigned int ctrl_interval,
+                  bool *tx_started)
+{
+    int status = 0;
+    unsigned int i;
+    struct bladerf_metadata meta;
+    struct timespec start;
+    const bool has_meta = format == BLADERF_FORMAT_SC16_Q11_META;
+    const unsigned int timeout_ms = p->dev_config.sync_timeout_ms;
+
+    clock_gettime(TEST_CLOCK, &start);
+
+    for (i = 0; status == 0 && elapsed_ms(&start) < duration_ms; i++) {
+        memset(&meta, 0, sizeof(meta));
+        meta.flags = BLADERF_META_FLAG_RX_NOW;
+
+        status = bladerf_sync_rx(dev, samples, BLOCK_SIZE,
+                                 has_meta ? &meta : NULL, timeout_ms);
+        if (status != 0) {
+            fprintf(stderr, "RX failed: %s\n", bladerf_strerror(status));
+            break;
+        }
+
+        memset(&meta, 0, sizeof(meta));
+        if (!*tx_started) {
+            meta.flags = BLADERF_META_FLAG_TX_BURST_START |
+                         BLADERF_META_FLAG_TX_NOW;
+        }
+
+        status = bladerf_sync_tx(dev, samples, BLOCK_SIZE,
+                                 has_meta ? &meta : NULL, timeout_ms);
+        if (status != 0) {
+            fprintf(stderr, "TX failed: %s\n", bladerf_strerror(status));
+            break;
+        }
+
+        *tx_started = true;
+
+        if (ctrl_interval != 0 && i % ctrl_interval == 0) {
+            status = ctrl_calls(dev, p, i / ctrl_interval);
+        }
+    }
+
+    return status;
+}
+
+static int run_format(struct bladerf *dev, struct app_params *p,
+                      bladerf_format format, int16_t *samples)
+{
+    int status;
+    unsigned int count;
+    bool tx_started = false;
+    const char *name = format == BLADERF_FORMAT_SC16_Q11_META ?
+                            "SC16 Q11 with metadata" : "SC16 Q11";
+
+    status = test_perform_sync_config(dev, BLADERF_MODULE_RX, format,
+                                      &p->dev_config, true);
+    if (status == 0) {
+        status = test_perform_sync_config(dev, BLADERF_MODULE_TX, format,
+                                          &p->dev_config, true);
+    }
+
+    if (status != 0) {
+        return -1;
+    }
+
+    /* Exercise the control calls up front, so that any state they set up
+     * on first use, as well as the stream startup, precedes the check */
+    status = stream(dev, p, format, samples, p->warmup_ms, 1, &tx_started);
+    if (status != 0) {
+        goto out;
+    }
+
+    printf("%-24s ", name);
+    fflush(stdout);
+
+    alloc_hooks_arm();
+    status = stream(dev, p, format, samples, p->duration_ms,
+                    p->ctrl_interval, &tx_started);
+    count = alloc_hooks_disarm();
+
+    if (status != 0) {
+        printf("Streaming failed.\n");
+    } else if (count != 0) {
+        Dl_info info;
+        void *caller = alloc_hooks_first_caller();
+
+        printf("FAILED: %u allocator call(s).\n", count);
+
+        if (caller != NULL && dladdr(caller, &info) != 0 &&
+            info.dli_sname != NULL) {
+            printf("  First call made from %s() in %s\n",
+                   info.dli_sname, info.dli_fname);
+        } else {
+            printf("  First call made from %p\n", caller);
+        }
+
+        status = -1;
+    } else {
+        printf("Pass.\n");
+    }
+
+out:
+    bladerf_enable_module(dev, BLADERF_MODULE_RX, false);
+    bladerf_enable_module(dev, BLADERF_MODULE_TX, false);
+    return status;
+}
+
+int main(int argc, char *argv[])
+{
+    int status;
+    unsigned int i;
+    struct bladerf *dev = NULL;
+    struct app_params params;
+    struct option *options = NULL;
+    int16_t *samples = NULL;
+
+    test_init_device_config(&params.dev_config);
+    params.duration_ms = 2000;
+    params.warmup_ms = 250;
+    params.ctrl_interval = 8;
+
+    options = test_get_long_options(app_long_options);
+    if (options == NULL) {
+        status = -1;
+        goto error_no_dev;
+    }
+
+    status = test_handle_args(argc, argv,
+                              TEST_OPTIONS_STR, options,
+                              &params.dev_config);
+    if (status < 0) {
+        status = -1;
+        goto error_no_dev;
+    } else if (status > 0) {
+        print_usage(argv[0]);
+        status = 0;
+        goto error_no_dev;
+    }
+
+    status = app_handle_args(argc, argv, options, &params);
+    if (status != 0) {
+        status = -1;
+        goto error_no_dev;
+    }
+
+    if (params.dev_config.device_specifier == NULL) {
+        params.dev_config.device_specifier = strdup("dummy:");
+        if (params.dev_config.device_specifier == NULL) {
+            perror("strdup");
+            status = -1;
+            goto error_no_dev;
+        }
+    }
+
+    samples = calloc(BLOCK_SIZE, 2 * sizeof(samples[0]));
+    if (samples == NULL) {
+        perror("calloc");
+        status = -1;
+        goto error_no_dev;
+    }
+
+    status = bladerf_open(&dev, params.dev_config.device_specifier);
+    if (status != 0) {
+        fprintf(stderr, "Unable to open device: %s\n",
+                bladerf_strerror(status));
+        status = -1;
+        goto error_no_dev;
+    }
+
+    status = test_apply_device_config(dev, &params.dev_config);
+
+    for (i = 0; i < ARRAY_SIZE(formats) && status == 0; i++) {
+        status = run_format(dev, &params, formats[i], samples);
+    }
+
+    bladerf_close(dev);
+
+error_no_dev:
+    free(samples);
+    test_deinit_device_config(&params.dev_config);
+    free(options);
+    return status;
+}
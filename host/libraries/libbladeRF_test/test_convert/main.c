@@ -0,0 +1,354 @@
+/*
+ * This program measures the throughput of libbladeRF's sample format
+ * conversions, next to the scalar loops they replace, and checks that both
+ * produce the same results. No device is required.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2014 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <getopt.h>
+#include <libbladeRF.h>
+#include "host_config.h"
+
+#if BLADERF_OS_WINDOWS || BLADERF_OS_OSX
+#include "clock_gettime.h"
+#else
+#include <time.h>
+#endif
+
+#include "conversions.h"
+
+#ifdef CLOCK_MONOTONIC
+#   define BENCH_CLOCK CLOCK_MONOTONIC
+#else
+#   define BENCH_CLOCK CLOCK_REALTIME
+#endif
+
+#define OPTIONS_STR "n:i:h"
+
+static struct option long_options[] = {
+    { "samples",    required_argument,  0,      'n' },
+    { "iterations", required_argument,  0,      'i' },
+    { "help",       no_argument,        0,      'h' },
+    { NULL,         0,                  0,      0 },
+};
+
+struct buffers {
+    int16_t *sc16;
+    float *cf32;
+    uint8_t *out;
+    uint8_t *ref;
+    unsigned int n;
+};
+
+/* A conversion to measure. run() converts the input buffer into `out`, and
+ * returns the number of bytes it produced. */
+struct bench {
+    const char *name;
+    size_t (*run)(struct buffers *b, uint8_t *out, bool scalar);
+    size_t in_bytes_per_sample;
+};
+
+/* Scalar versions, as commonly written by applications */
+
+static void scalar_unpack(int16_t *out, const uint8_t *in, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        const uint32_t v = in[3 * i] | (in[3 * i + 1] << 8) |
+                           ((uint32_t) in[3 * i + 2] << 16);
+
+        out[2 * i]     = (int16_t) ((int32_t) (v << 20) >> 20);
+        out[2 * i + 1] = (int16_t) ((int32_t) (v << 8) >> 20);
+    }
+}
+
+static void scalar_pack(uint8_t *out, const int16_t *in, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        const uint32_t v = ((uint16_t) in[2 * i] & 0xfff) |
+                           (((uint16_t) in[2 * i + 1] & 0xfff) << 12);
+
+        out[3 * i]     = (uint8_t) v;
+        out[3 * i + 1] = (uint8_t) (v >> 8);
+        out[3 * i + 2] = (uint8_t) (v >> 16);
+    }
+}
+
+static void scalar_to_cf32(float *out, const int16_t *in, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < 2 * n; i++) {
+        out[i] = in[i] / 2048.0f;
+    }
+}
+
+static void scalar_from_cf32(int16_t *out, const float *in, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < 2 * n; i++) {
+        float x = in[i] * 2048.0f;
+
+        if (x > 2047.0f) {
+            x = 2047.0f;
+        } else if (x < -2048.0f) {
+            x = -2048.0f;
+        }
+
+        out[i] = (int16_t) lrintf(x);
+    }
+}
+
+static void scalar_to_cs8(int8_t *out, const int16_t *in, unsigned int n)
+{
+    unsigned int i;
+
+    for (i = 0; i < 2 * n; i++) {
+        int32_t x = ((int32_t) in[i] + 8) >> BLADERF_SC8_SHIFT_DEFAULT;
+
+        if (x > INT8_MAX) {
+            x = INT8_MAX;
+        } else if (x < INT8_MIN) {
+            x = INT8_MIN;
+        }
+
+        out[i] = (int8_t) x;
+    }
+}
+
+/* The packed input is taken from the start of the float buffer, which is
+ * overwritten with packed samples before the unpack benchmark is run */
+static size_t run_unpack(struct buffers *b, uint8_t *out, bool scalar)
+{
+    if (scalar) {
+        scalar_unpack((int16_t *) out, (const uint8_t *) b->cf32, b->n);
+    } else {
+        bladerf_unpack_sc16_q11((int16_t *) out, b->cf32, b->n);
+    }
+
+    return 4 * (size_t) b->n;
+}
+
+static size_t run_pack(struct buffers *b, uint8_t *out, bool scalar)
+{
+    if (scalar) {
+        scalar_pack(out, b->sc16, b->n);
+    } else {
+        bladerf_pack_sc16_q11(out, b->sc16, b->n);
+    }
+
+    return 3 * (size_t) b->n;
+}
+
+static size_t run_to_cf32(struct buffers *b, uint8_t *out, bool scalar)
+{
+    if (scalar) {
+        scalar_to_cf32((float *) out, b->sc16, b->n);
+    } else {
+        bladerf_convert_sc16q11_to_cf32((float *) out, b->sc16, b->n);
+    }
+
+    return 8 * (size_t) b->n;
+}
+
+static size_t run_from_cf32(struct buffers *b, uint8_t *out, bool scalar)
+{
+    if (scalar) {
+        scalar_from_cf32((int16_t *) out, b->cf32, b->n);
+    } else {
+        bladerf_convert_cf32_to_sc16q11((int16_t *) out, b->cf32, b->n);
+    }
+
+    return 4 * (size_t) b->n;
+}
+
+static size_t run_to_cs8(struct buffers *b, uint8_t *out, bool scalar)
+{
+    if (scalar) {
+        scalar_to_cs8((int8_t *) out, b->sc16, b->n);
+    } else {
+        bladerf_convert_sc16q11_to_cs8((int8_t *) out, b->sc16, b->n,
+                                       BLADERF_SC8_SHIFT_DEFAULT);
+    }
+
+    return 2 * (size_t) b->n;
+}
+
+static const struct bench benches[] = {
+    { "sc16q11_to_cf32",    run_to_cf32,    4 },
+    { "cf32_to_sc16q11",    run_from_cf32,  8 },
+    { "sc16q11_to_cs8",     run_to_cs8,     4 },
+    { "pack_sc16q11",       run_pack,       4 },
+    { "unpack_sc16q11",     run_unpack,     3 },
+};
+
+static inline double elapsed_s(const struct timespec *start,
+                               const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) +
+           (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Best throughput over all iterations, in GB/s of input and output */
+static double measure(const struct bench *bench, struct buffers *b,
+                      uint8_t *out, bool scalar, unsigned int iterations,
+                      size_t *out_bytes)
+{
+    unsigned int i;
+    double best = 0;
+    struct timespec start, end;
+
+    for (i = 0; i < iterations; i++) {
+        double t;
+
+        clock_gettime(BENCH_CLOCK, &start);
+        *out_bytes = bench->run(b, out, scalar);
+        clock_gettime(BENCH_CLOCK, &end);
+
+        t = elapsed_s(&start, &end);
+        if (t > 0 && (best == 0 || t < best)) {
+            best = t;
+        }
+    }
+
+    if (best == 0) {
+        return 0;
+    }
+
+    return (bench->in_bytes_per_sample * (double) b->n + *out_bytes) /
+           best / 1e9;
+}
+
+static void print_usage(const char *argv0)
+{
+    printf("%s: Measure the throughput of sample format conversions\n", argv0);
+    printf("\n");
+    printf("Each libbladeRF conversion is reported with the SIMD\n");
+    printf("implementation selected at runtime, next to an equivalent\n");
+    printf("scalar loop. Throughput counts bytes both read and written.\n");
+    printf("\n");
+    printf("Options:\n");
+    printf("  -n, --samples <value>     Samples per conversion (%u).\n", 1u << 20);
+    printf("  -i, --iterations <value>  Iterations per conversion (100).\n");
+    printf("  -h, --help                Show this text.\n");
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int c;
+    bool ok;
+    size_t i;
+    int status = 0;
+    unsigned int iterations = 100;
+    struct buffers b;
+
+    b.n = 1u << 20;
+
+    while ((c = getopt_long(argc, argv, OPTIONS_STR,
+                            long_options, NULL)) >= 0) {
+        switch (c) {
+            case 'n':
+                b.n = str2uint(optarg, 1, UINT_MAX / 8, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Invalid # samples: %s\n", optarg);
+                    return 1;
+                }
+                break;
+
+            case 'i':
+                iterations = str2uint(optarg, 1, UINT_MAX, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Invalid # iterations: %s\n", optarg);
+                    return 1;
+                }
+                break;
+
+            case 'h':
+                print_usage(argv[0]);
+                return 0;
+
+            default:
+                return 1;
+        }
+    }
+
+    b.sc16 = malloc(4 * (size_t) b.n);
+    b.cf32 = malloc(8 * (size_t) b.n);
+    b.out = malloc(8 * (size_t) b.n);
+    b.ref = malloc(8 * (size_t) b.n);
+
+    if (!b.sc16 || !b.cf32 || !b.out || !b.ref) {
+        fprintf(stderr, "Failed to allocate buffers.\n");
+        status = 1;
+        goto out;
+    }
+
+    /* Full scale samples, and floats that exercise saturation */
+    srand(1);
+    for (i = 0; i < 2 * (size_t) b.n; i++) {
+        b.sc16[i] = (int16_t) ((rand() % 4096) - 2048);
+        b.cf32[i] = ((rand() % 5000) - 2500) / 2000.0f;
+    }
+
+    printf("%-18s %-8s %10s %10s\n", "kernel", "impl", "GB/s", "scalar");
+
+    for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        size_t out_bytes, ref_bytes;
+        double simd, scalar;
+
+        /* The unpack benchmark, which is run last, reads packed samples */
+        if (benches[i].run == run_unpack) {
+            bladerf_pack_sc16_q11(b.cf32, b.sc16, b.n);
+        }
+
+        simd = measure(&benches[i], &b, b.out, false, iterations, &out_bytes);
+        scalar = measure(&benches[i], &b, b.ref, true, iterations, &ref_bytes);
+
+        printf("%-18s %-8s %10.2f %10.2f\n", benches[i].name,
+               bladerf_convert_impl(), simd, scalar);
+
+        if (out_bytes != ref_bytes || memcmp(b.out, b.ref, out_bytes) != 0) {
+            fprintf(stderr, "%s: Output differs from the scalar version.\n",
+                    benches[i].name);
+            status = 1;
+        }
+    }
+
+out:
+    free(b.sc16);
+    free(b.cf32);
+    free(b.out);
+    free(b.ref);
+    return status;
+}
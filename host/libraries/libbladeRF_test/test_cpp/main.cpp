@@ -23,15 +23,76 @@
  * THE SOFTWARE.
  *
  * This program is intended to verify that C++ programs build against
- * libbladeRF without any unintended dependencies.
+ * libbladeRF without any unintended dependencies, and that the C++ interface
+ * compiles. If a device identifier is provided, a few buffers are received
+ * and transmitted via the C++ interface's zero-copy handles.
  */
 #include <iostream>
 #include <libbladeRF.h>
+#include <libbladeRF.hpp>
+
+/* Compile all members of the C++ interface's stream templates */
+template class bladeRF::rx_stream<BLADERF_FORMAT_SC16_Q11>;
+template class bladeRF::rx_stream<BLADERF_FORMAT_SC16_Q11_META>;
+template class bladeRF::rx_stream<BLADERF_FORMAT_SC8_Q7_META>;
+template class bladeRF::tx_stream<BLADERF_FORMAT_SC16_Q11>;
+template class bladeRF::tx_stream<BLADERF_FORMAT_SC16_Q11_META>;
+template class bladeRF::tx_stream<BLADERF_FORMAT_SC8_Q7>;
+template class bladeRF::rx_buffer<BLADERF_FORMAT_SC16_Q11_META>;
+template class bladeRF::tx_buffer<BLADERF_FORMAT_SC16_Q11_META>;
+
+static void stream(const char *identifier)
+{
+    bladeRF::device dev(identifier);
+    unsigned int i;
+
+    {
+        bladeRF::rx_stream<BLADERF_FORMAT_SC16_Q11> rx(dev, 16, 8192, 8, 3500);
+        unsigned long long count = 0;
+
+        for (i = 0; i < 16; i++) {
+            bladeRF::rx_buffer<BLADERF_FORMAT_SC16_Q11> buf = rx.acquire(5000);
+            count += buf.samples().size();
+        }
+
+        std::cout << "Received " << count << " samples" << std::endl;
+    }
+
+    {
+        bladeRF::tx_stream<BLADERF_FORMAT_SC16_Q11> tx(dev, 16, 8192, 8, 3500);
+        unsigned long long count = 0;
+
+        for (i = 0; i < 16; i++) {
+            bladeRF::tx_buffer<BLADERF_FORMAT_SC16_Q11> buf = tx.acquire();
+            bladeRF::span<bladeRF::sc16> samples = buf.samples();
+
+            for (bladeRF::sc16 &s : samples) {
+                s.i = 0;
+                s.q = 0;
+            }
+
+            count += samples.size();
+            buf.commit(static_cast<unsigned int>(samples.size()));
+        }
+
+        std::cout << "Transmitted " << count << " samples" << std::endl;
+    }
+}
 
 int main(int argc, char *argv[])
 {
     struct bladerf_version version;
     bladerf_version(&version);
     std::cout << "libbladeRF " << version.describe << std::endl;
+
+    if (argc > 1) {
+        try {
+            stream(argv[1]);
+        } catch (const bladeRF::error &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
     return 0;
 }
@@ -0,0 +1,394 @@
+/*
+ * This program measures the latency of common control-path operations,
+ * reporting percentiles for each as JSON. Running it against each backend
+ * (e.g., -d libusb: and -d cypress:) and each release allows regressions in
+ * retune and register access times to be caught.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2014 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <libbladeRF.h>
+#include "host_config.h"
+
+#if BLADERF_OS_WINDOWS || BLADERF_OS_OSX
+#include "clock_gettime.h"
+#else
+#include <time.h>
+#endif
+
+#include "conversions.h"
+#include "test_common.h"
+
+#define TEST_OPTIONS_STR    TEST_OPTIONS_BASE"i:o:S:"
+
+#ifdef CLOCK_MONOTONIC
+#   define BENCH_CLOCK CLOCK_MONOTONIC
+#else
+#   define BENCH_CLOCK CLOCK_REALTIME
+#endif
+
+struct app_params {
+    struct device_config dev_config;
+    unsigned int iterations;
+    char *output;
+    uint64_t randval_seed;
+    uint64_t randval_state;
+};
+
+static struct option app_long_options[] = {
+    { "iterations", required_argument,  0,      'i' },
+    { "output",     required_argument,  0,      'o' },
+    { "seed",       required_argument,  0,      'S' },
+    { NULL,         0,                  0,      0 },
+};
+
+/* An operation to measure. `i` is the current iteration. */
+struct bench {
+    const char *name;
+    int (*run)(struct bladerf *dev, struct app_params *p, unsigned int i);
+};
+
+static int bench_set_frequency(struct bladerf *dev, struct app_params *p,
+                               unsigned int i)
+{
+    uint64_t tmp = randval_update(&p->randval_state);
+    unsigned int freq = BLADERF_FREQUENCY_MIN +
+               (unsigned int) (tmp % (BLADERF_FREQUENCY_MAX -
+                                      BLADERF_FREQUENCY_MIN));
+
+    return bladerf_set_frequency(dev, BLADERF_MODULE_RX, freq);
+}
+
+static int bench_set_gain(struct bladerf *dev, struct app_params *p,
+                          unsigned int i)
+{
+    /* Sweep across the full RX gain range */
+    return bladerf_set_gain(dev, BLADERF_MODULE_RX, (int) (i % 60));
+}
+
+static int bench_set_sample_rate(struct bladerf *dev, struct app_params *p,
+                                 unsigned int i)
+{
+    const unsigned int rate = (i & 1) ? 2000000 : 1000000;
+    return bladerf_set_sample_rate(dev, BLADERF_MODULE_RX, rate, NULL);
+}
+
+static int bench_get_timestamp(struct bladerf *dev, struct app_params *p,
+                               unsigned int i)
+{
+    uint64_t ts;
+    return bladerf_get_timestamp(dev, BLADERF_MODULE_RX, &ts);
+}
+
+static int bench_lms_read(struct bladerf *dev, struct app_params *p,
+                          unsigned int i)
+{
+    uint8_t val;
+
+    /* Chip ID register */
+    return bladerf_lms_read(dev, 0x04, &val);
+}
+
+static int bench_si5338_read(struct bladerf *dev, struct app_params *p,
+                             unsigned int i)
+{
+    uint8_t val;
+
+    /* Revision ID register */
+    return bladerf_si5338_read(dev, 0, &val);
+}
+
+static int bench_config_gpio_read(struct bladerf *dev, struct app_params *p,
+                                  unsigned int i)
+{
+    uint32_t val;
+    return bladerf_config_gpio_read(dev, &val);
+}
+
+static const struct bench benches[] = {
+    { "bladerf_set_frequency",      bench_set_frequency },
+    { "bladerf_set_gain",           bench_set_gain },
+    { "bladerf_set_sample_rate",    bench_set_sample_rate },
+    { "bladerf_get_timestamp",      bench_get_timestamp },
+    { "bladerf_lms_read",           bench_lms_read },
+    { "bladerf_si5338_read",        bench_si5338_read },
+    { "bladerf_config_gpio_read",   bench_config_gpio_read },
+};
+
+int app_handle_args(int argc, char **argv,
+                    struct option *long_options, struct app_params *p)
+{
+    int c;
+    bool ok;
+
+    optind = 1;
+    c = getopt_long(argc, argv, TEST_OPTIONS_STR, long_options, NULL);
+    while (c >= 0) {
+
+        switch (c) {
+            case 'i':
+                p->iterations = str2uint(optarg, 1, UINT_MAX, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Invalid # iterations: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'o':
+                p->output = optarg;
+                break;
+
+            case 'S':
+                p->randval_seed = str2uint64(optarg, 0, UINT64_MAX, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Invalid seed value: %s\n", optarg);
+                    return -1;
+                }
+                break;
+        }
+
+        c = getopt_long(argc, argv, TEST_OPTIONS_STR, long_options, NULL);
+    }
+
+    return 0;
+}
+
+void print_usage(const char *argv0)
+{
+    printf("%s: Measure the latency of control-path operations\n", argv0);
+    printf("\n");
+    printf("Results are reported as JSON. To compare backends, run this\n");
+    printf("program with -d libusb: and -d cypress:.\n");
+    printf("\n");
+    printf("Test-specific options:\n");
+    printf("  -i, --iterations <value>  Number of iterations per operation.\n");
+    printf("  -o, --output <file>       Write JSON results to <file>, rather\n");
+    printf("                             than stdout.\n");
+    printf("  -S, --seed <value>        PRNG seed for random frequencies.\n");
+    printf("\n");
+    test_print_common_help();
+    printf("\n");
+}
+
+static inline double elapsed_us(const struct timespec *start,
+                                const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e6 +
+           (end->tv_nsec - start->tv_nsec) / 1e3;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted samples */
+static inline double percentile(const double *sorted, unsigned int n, double p)
+{
+    unsigned int idx = (unsigned int) (p / 100.0 * n + 0.5);
+
+    if (idx > 0) {
+        idx--;
+    }
+
+    return sorted[idx < n ? idx : n - 1];
+}
+
+static int run_bench(struct bladerf *dev, struct app_params *p,
+                     const struct bench *b, double *samples, FILE *out,
+                     bool last)
+{
+    int status;
+    unsigned int i;
+    struct timespec start, end;
+    double sum = 0;
+
+    for (i = 0; i < p->iterations; i++) {
+        clock_gettime(BENCH_CLOCK, &start);
+        status = b->run(dev, p, i);
+        clock_gettime(BENCH_CLOCK, &end);
+
+        if (status != 0) {
+            fprintf(stderr, "%s failed @ iteration %u: %s\n",
+                    b->name, i, bladerf_strerror(status));
+            return -1;
+        }
+
+        samples[i] = elapsed_us(&start, &end);
+        sum += samples[i];
+    }
+
+    qsort(samples, p->iterations, sizeof(samples[0]), compare_double);
+
+    fprintf(out, "    {\n");
+    fprintf(out, "      \"name\": \"%s\",\n", b->name);
+    fprintf(out, "      \"min_us\": %.3f,\n", samples[0]);
+    fprintf(out, "      \"mean_us\": %.3f,\n", sum / p->iterations);
+    fprintf(out, "      \"p50_us\": %.3f,\n",
+            percentile(samples, p->iterations, 50.0));
+    fprintf(out, "      \"p99_us\": %.3f,\n",
+            percentile(samples, p->iterations, 99.0));
+    fprintf(out, "      \"p999_us\": %.3f,\n",
+            percentile(samples, p->iterations, 99.9));
+    fprintf(out, "      \"max_us\": %.3f\n", samples[p->iterations - 1]);
+    fprintf(out, "    }%s\n", last ? "" : ",");
+
+    return 0;
+}
+
+int run_test(struct bladerf *dev, struct app_params *p)
+{
+    int status = 0;
+    size_t i;
+    double *samples;
+    FILE *out = stdout;
+    struct bladerf_devinfo info;
+    struct bladerf_version lib_ver, fw_ver, fpga_ver;
+
+    samples = calloc(p->iterations, sizeof(samples[0]));
+    if (samples == NULL) {
+        perror("calloc");
+        return -1;
+    }
+
+    status = bladerf_get_devinfo(dev, &info);
+    if (status == 0) {
+        status = bladerf_fw_version(dev, &fw_ver);
+    }
+    if (status == 0) {
+        status = bladerf_fpga_version(dev, &fpga_ver);
+    }
+    if (status != 0) {
+        fprintf(stderr, "Failed to query device info: %s\n",
+                bladerf_strerror(status));
+        status = -1;
+        goto out;
+    }
+
+    bladerf_version(&lib_ver);
+
+    if (p->output != NULL) {
+        out = fopen(p->output, "w");
+        if (out == NULL) {
+            perror(p->output);
+            status = -1;
+            goto out;
+        }
+    }
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"backend\": \"%s\",\n", bladerf_backend_str(info.backend));
+    fprintf(out, "  \"serial\": \"%s\",\n", info.serial);
+    fprintf(out, "  \"libbladeRF_version\": \"%s\",\n", lib_ver.describe);
+    fprintf(out, "  \"fw_version\": \"%s\",\n", fw_ver.describe);
+    fprintf(out, "  \"fpga_version\": \"%s\",\n", fpga_ver.describe);
+    fprintf(out, "  \"iterations\": %u,\n", p->iterations);
+    fprintf(out, "  \"results\": [\n");
+
+    for (i = 0; i < ARRAY_SIZE(benches) && status == 0; i++) {
+        if (out != stdout) {
+            printf("Running %s...\n", benches[i].name);
+        }
+
+        status = run_bench(dev, p, &benches[i], samples, out,
+                           i == (ARRAY_SIZE(benches) - 1));
+    }
+
+    fprintf(out, "  ]\n");
+    fprintf(out, "}\n");
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+out:
+    free(samples);
+    return status;
+}
+
+int main(int argc, char *argv[])
+{
+    int status;
+    struct bladerf *dev = NULL;
+    struct app_params params;
+    struct option *options = NULL;
+
+    test_init_device_config(&params.dev_config);
+    params.iterations = 1000;
+    params.output = NULL;
+    params.randval_seed = 1;
+
+    options = test_get_long_options(app_long_options);
+    if (options == NULL) {
+        status = -1;
+        goto error_no_dev;
+    }
+
+    status = test_handle_args(argc, argv,
+                              TEST_OPTIONS_STR, options,
+                              &params.dev_config);
+    if (status < 0) {
+        status = -1;
+        goto error_no_dev;
+    } else if (status > 0) {
+        print_usage(argv[0]);
+        status = 0;
+        goto error_no_dev;
+    }
+
+    status = app_handle_args(argc, argv, options, &params);
+    if (status != 0) {
+        status = -1;
+        goto error_no_dev;
+    }
+
+    randval_init(&params.randval_state, params.randval_seed);
+
+    status = bladerf_open(&dev, params.dev_config.device_specifier);
+    if (status != 0) {
+        fprintf(stderr, "Unable to open device: %s\n",
+                bladerf_strerror(status));
+        status = -1;
+        goto error_no_dev;
+    }
+
+    status = test_apply_device_config(dev, &params.dev_config);
+    if (status == 0) {
+        status = run_test(dev, &params);
+    }
+
+    bladerf_close(dev);
+
+error_no_dev:
+    test_deinit_device_config(&params.dev_config);
+    free(options);
+    return status;
+}
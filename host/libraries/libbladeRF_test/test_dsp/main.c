@@ -0,0 +1,260 @@
+/*
+ * This program checks that the repeater's built-in gain, FIR filter and NCO
+ * stages produce the same results with their SIMD kernels as with their
+ * generic code, including for samples whose results lie exactly halfway
+ * between two integers. No device is required.
+ *
+ * The stages process vectors of 4 samples with SIMD, when available, and
+ * leave any remainder to the generic code. Processing a buffer one sample at
+ * a time therefore yields the generic code's results, to compare with those
+ * of processing it in larger calls.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <libbladeRF.h>
+
+/* Not a multiple of 4, so that the SIMD kernels leave a remainder, and
+ * spanning several of the FIR stage's internal blocks */
+#define NUM_SAMPLES     (3 * 1024 + 3)
+
+/* Size of the calls made to the NCO stage. Its oscillator is derived from
+ * the exact phase at the start of each call, and stepped with single
+ * precision arithmetic within it, so calls of a single vector see the same
+ * oscillator values as calls of a single sample. */
+#define NCO_CALL_LEN    4
+
+typedef enum {
+    STAGE_GAIN,
+    STAGE_FIR,
+    STAGE_NCO,
+} stage_type;
+
+typedef enum {
+    INPUT_RANDOM,
+    INPUT_HALFWAY,
+} input_type;
+
+struct test_case {
+    const char *name;
+    stage_type type;
+    input_type input;
+    double param;   /* Gain, or NCO frequency */
+};
+
+/* Taps of 0.5 put the result exactly halfway between two integers whenever
+ * the sum of the two samples filtered is odd */
+static const float halfway_taps[] = { 0.5f, 0.5f };
+
+static const float lowpass_taps[] = {
+    -0.0123f, 0.0271f, 0.0843f, 0.1650f, 0.2336f, 0.2601f,
+     0.2336f, 0.1650f, 0.0843f, 0.0271f, -0.0123f
+};
+
+static const struct test_case tests[] = {
+    /* Gains of 0.5 and 1.5 put odd samples exactly halfway */
+    { "gain 0.5",       STAGE_GAIN, INPUT_HALFWAY,  0.5f },
+    { "gain 1.5",       STAGE_GAIN, INPUT_HALFWAY,  1.5f },
+    { "gain 3.7",       STAGE_GAIN, INPUT_RANDOM,   3.7f },
+    { "fir halfway",    STAGE_FIR,  INPUT_HALFWAY,  0.0f },
+    { "fir lowpass",    STAGE_FIR,  INPUT_RANDOM,   0.0f },
+
+    /* At 1/6 cycles per sample, the oscillator takes the values 1, 0.5,
+     * -0.5 and -1 in its real part, so odd samples are scaled to exactly
+     * halfway */
+    { "nco halfway",    STAGE_NCO,  INPUT_HALFWAY,  1.0 / 6 },
+    { "nco 0.1234",     STAGE_NCO,  INPUT_RANDOM,   0.1234 },
+    { "nco -0.3",       STAGE_NCO,  INPUT_RANDOM,   -0.3 },
+};
+
+static void fill_random(int16_t *s, unsigned int n)
+{
+    uint32_t lcg = 1;
+    unsigned int k;
+
+    for (k = 0; k < 2 * n; k++) {
+        lcg = lcg * 1664525 + 1013904223;
+        s[k] = (int16_t) ((lcg >> 20) & 0xfff) - 2048;
+    }
+}
+
+/* Alternate between samples with an odd I and a zero Q, and vice versa,
+ * sweeping the odd values across the full range */
+static void fill_halfway(int16_t *s, unsigned int n)
+{
+    unsigned int k;
+
+    for (k = 0; k < n; k++) {
+        const int16_t odd = (int16_t) (-2047 + 2 * (int) ((k / 2) % 2048));
+
+        s[2 * k]     = (k % 2 == 0) ? odd : 0;
+        s[2 * k + 1] = (k % 2 == 0) ? 0 : odd;
+    }
+}
+
+static int stage_init(struct bladerf_repeater_stage *stage,
+                      const struct test_case *t)
+{
+    switch (t->type) {
+        case STAGE_GAIN:
+            return bladerf_repeater_stage_gain(stage, (float) t->param);
+
+        case STAGE_FIR:
+            if (t->input == INPUT_HALFWAY) {
+                return bladerf_repeater_stage_fir(stage, halfway_taps,
+                            sizeof(halfway_taps) / sizeof(halfway_taps[0]));
+            } else {
+                return bladerf_repeater_stage_fir(stage, lowpass_taps,
+                            sizeof(lowpass_taps) / sizeof(lowpass_taps[0]));
+            }
+
+        case STAGE_NCO:
+            return bladerf_repeater_stage_nco(stage, t->param);
+
+        default:
+            return BLADERF_ERR_INVAL;
+    }
+}
+
+/* Run a freshly initialized stage over `s`, in calls of up to `call_len`
+ * samples */
+static int run_stage(const struct test_case *t, int16_t *s, unsigned int n,
+                     unsigned int call_len)
+{
+    struct bladerf_repeater_stage stage;
+    unsigned int k, len;
+    int status;
+
+    status = stage_init(&stage, t);
+    if (status != 0) {
+        return status;
+    }
+
+    for (k = 0; k < n; k += len) {
+        len = n - k < call_len ? n - k : call_len;
+        stage.process(&s[2 * k], len, stage.user_data);
+    }
+
+    bladerf_repeater_stage_free(&stage);
+    return 0;
+}
+
+/* The NCO's products are computed in single precision, which the compiler
+ * may or may not fuse, so its results may differ by one where they are not
+ * exact. They are exact for a component whose input had a zero in the
+ * other component, such as those of the INPUT_HALFWAY samples. */
+static bool nco_matches(const int16_t *in, const int16_t *simd,
+                        const int16_t *generic, unsigned int k)
+{
+    const bool exact = in[k ^ 1] == 0;
+    const int diff = abs(simd[k] - generic[k]);
+
+    return exact ? diff == 0 : diff <= 1;
+}
+
+static bool run(const struct test_case *t)
+{
+    const size_t size = 2 * NUM_SAMPLES * sizeof(int16_t);
+    int16_t *in, *simd, *generic;
+    unsigned int k, mismatches = 0;
+    int status;
+    bool pass = true;
+
+    in = malloc(size);
+    simd = malloc(size);
+    generic = malloc(size);
+
+    if (in == NULL || simd == NULL || generic == NULL) {
+        perror("malloc");
+        pass = false;
+        goto out;
+    }
+
+    if (t->input == INPUT_HALFWAY) {
+        fill_halfway(in, NUM_SAMPLES);
+    } else {
+        fill_random(in, NUM_SAMPLES);
+    }
+
+    memcpy(simd, in, size);
+    memcpy(generic, in, size);
+
+    status = run_stage(t, simd, NUM_SAMPLES,
+                       t->type == STAGE_NCO ? NCO_CALL_LEN : NUM_SAMPLES);
+    if (status == 0) {
+        status = run_stage(t, generic, NUM_SAMPLES, 1);
+    }
+
+    if (status != 0) {
+        fprintf(stderr, "%s: Failed to initialize stage: %s\n",
+                t->name, bladerf_strerror(status));
+        pass = false;
+        goto out;
+    }
+
+    for (k = 0; k < 2 * NUM_SAMPLES; k++) {
+        const bool match = t->type == STAGE_NCO ?
+                            nco_matches(in, simd, generic, k) :
+                            simd[k] == generic[k];
+
+        if (!match) {
+            if (mismatches++ < 4) {
+                fprintf(stderr, "%s: sample %u %c: input %d, "
+                        "SIMD %d, generic %d\n", t->name, k / 2,
+                        (k % 2 == 0) ? 'I' : 'Q', in[k],
+                        simd[k], generic[k]);
+            }
+        }
+    }
+
+    if (mismatches != 0) {
+        fprintf(stderr, "%s: %u mismatches\n", t->name, mismatches);
+        pass = false;
+    } else {
+        printf("%s: OK\n", t->name);
+    }
+
+out:
+    free(in);
+    free(simd);
+    free(generic);
+    return pass;
+}
+
+int main(void)
+{
+    unsigned int i;
+    bool pass = true;
+
+    for (i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        pass = run(&tests[i]) && pass;
+    }
+
+    printf("%s\n", pass ? "Passed." : "Failed.");
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
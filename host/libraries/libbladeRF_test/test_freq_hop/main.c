@@ -3,6 +3,9 @@
  * RX/TX calls within the same thread. This was written to investigate
  * lockups reported with the bladeRF and third-party software.
  *
+ * With --profile, the time spent in each phase of the frequency changes, and
+ * the number of control requests each performs, are reported as well.
+ *
  * This file is part of the bladeRF project:
  *   http://www.github.com/nuand/bladeRF
  *
@@ -43,6 +46,24 @@ struct app_params {
     uint64_t iterations;
     uint64_t randval_seed;
     uint64_t randval_state;
+    bool profile;
+    unsigned int quick_channels;    /* 0 to tune via bladerf_set_frequency */
+};
+
+/* Channels visited via bladerf_quick_retune(), for each module */
+struct quick_channels {
+    struct bladerf_quick_tune *rx;
+    struct bladerf_quick_tune *tx;
+};
+
+static const char *phase_names[BLADERF_TUNING_NUM_PHASES] = {
+    "xb200",
+    "pll",
+    "vcocap",
+    "band",
+    "dc_cal",
+    "total",
+    "quick",
 };
 
 static struct option app_long_options[] = {
@@ -50,6 +71,8 @@ static struct option app_long_options[] = {
     { "tx",         no_argument,        0,      2 },
     { "iterations", required_argument,  0,      'i' },
     { "seed",       required_argument,  0,      'S' },
+    { "profile",    no_argument,        0,      3 },
+    { "quick",      required_argument,  0,      4 },
     { NULL,         0,                  0,      0 },
 };
 
@@ -72,6 +95,19 @@ int app_handle_args(int argc, char **argv,
                 p->tx = true;
                 break;
 
+            case 3:
+                p->profile = true;
+                break;
+
+            case 4:
+                p->quick_channels = str2uint(optarg, 1, 1024, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Invalid # of quick tune channels: %s\n",
+                            optarg);
+                    return -1;
+                }
+                break;
+
             case 'i':
                 p->iterations = str2uint64(optarg, 1, UINT64_MAX, &ok);
                 if (!ok) {
@@ -105,6 +141,11 @@ void print_usage(const char *argv0)
     printf("  --rx                      Enable bladerf_sync_rx() calls.\n");
     printf("  --tx                      Enable bladerf_sync_tx() calls.\n");
     printf("                             Requires device to be in loopback mode.\n");
+    printf("  --profile                 Report the time spent in, and control\n");
+    printf("                             requests made by, each tuning phase.\n");
+    printf("  --quick <n>               Capture quick tune parameters for <n>\n");
+    printf("                             random channels, and hop amongst them\n");
+    printf("                             via bladerf_quick_retune().\n");
     printf("\n");
     test_print_common_help();
     printf("\n");
@@ -126,6 +167,136 @@ static unsigned int next_freq(struct app_params *p)
     return (unsigned int) tmp;
 }
 
+/* Tune a module to the next frequency, or to the next quick tune channel */
+static int hop(struct bladerf *dev, struct app_params *p,
+               bladerf_module module, const struct bladerf_quick_tune *quick,
+               uint64_t iteration)
+{
+    int status;
+    const char *module_str = (module == BLADERF_MODULE_RX) ? "RX" : "TX";
+
+    if (quick != NULL) {
+        const unsigned int ch =
+            (unsigned int) (randval_update(&p->randval_state) %
+                            p->quick_channels);
+
+        status = bladerf_quick_retune(dev, module, &quick[ch]);
+        if (status != 0) {
+            fprintf(stderr,
+                    "Failed to quick retune %s to %u @ iteration %"PRIu64": %s\n",
+                    module_str, quick[ch].frequency, iteration,
+                    bladerf_strerror(status));
+        }
+    } else {
+        const unsigned int freq = next_freq(p);
+
+        status = bladerf_set_frequency(dev, module, freq);
+        if (status != 0) {
+            fprintf(stderr,
+                    "Failed to set %s frequency to %u @ iteration %"PRIu64": %s\n",
+                    module_str, freq, iteration, bladerf_strerror(status));
+        }
+    }
+
+    return status;
+}
+
+/* Tune to random frequencies and capture their quick tune parameters */
+static struct bladerf_quick_tune *init_quick_channels(struct bladerf *dev,
+                                                      struct app_params *p,
+                                                      bladerf_module module)
+{
+    int status = 0;
+    unsigned int i;
+    struct bladerf_quick_tune *quick;
+
+    quick = calloc(p->quick_channels, sizeof(quick[0]));
+    if (quick == NULL) {
+        perror("calloc");
+        return NULL;
+    }
+
+    for (i = 0; i < p->quick_channels && status == 0; i++) {
+        const unsigned int freq = next_freq(p);
+
+        status = bladerf_set_frequency(dev, module, freq);
+        if (status == 0) {
+            status = bladerf_get_quick_tune(dev, module, &quick[i]);
+        }
+
+        if (status != 0) {
+            fprintf(stderr, "Failed to capture quick tune for %u Hz: %s\n",
+                    freq, bladerf_strerror(status));
+        }
+    }
+
+    if (status != 0) {
+        free(quick);
+        quick = NULL;
+    }
+
+    return quick;
+}
+
+static void print_histogram(const struct bladerf_tuning_phase_stats *s)
+{
+    unsigned int i;
+
+    for (i = 0; i < BLADERF_TUNING_STATS_HIST_LEN; i++) {
+        if (s->hist[i] == 0) {
+            continue;
+        }
+
+        if (i == BLADERF_TUNING_STATS_HIST_LEN - 1) {
+            printf("      [%7u,     inf) us: %"PRIu64"\n",
+                   1u << (i - 1), s->hist[i]);
+        } else {
+            printf("      [%7u, %7u) us: %"PRIu64"\n",
+                   i == 0 ? 0 : 1u << (i - 1), 1u << i, s->hist[i]);
+        }
+    }
+}
+
+static int print_profile(struct bladerf *dev, bladerf_module module)
+{
+    int status;
+    unsigned int i;
+    struct bladerf_tuning_stats stats;
+
+    status = bladerf_get_tuning_stats(dev, module, &stats);
+    if (status != 0) {
+        fprintf(stderr, "Failed to get tuning stats: %s\n",
+                bladerf_strerror(status));
+        return status;
+    }
+
+    printf("%s tuning profile:\n", module == BLADERF_MODULE_RX ? "RX" : "TX");
+    printf("  %-8s %10s %12s %12s %14s\n",
+           "Phase", "Count", "Mean (us)", "Max (us)", "Requests/call");
+
+    for (i = 0; i < BLADERF_TUNING_NUM_PHASES; i++) {
+        const struct bladerf_tuning_phase_stats *s = &stats.phases[i];
+
+        if (s->count == 0) {
+            continue;
+        }
+
+        printf("  %-8s %10"PRIu64" %12.1f %12"PRIu64" %14.2f\n",
+               phase_names[i], s->count, (double) s->total_us / s->count,
+               s->max_us, (double) s->requests / s->count);
+    }
+
+    for (i = 0; i < BLADERF_TUNING_NUM_PHASES; i++) {
+        if (stats.phases[i].count != 0) {
+            printf("\n  %s:\n", phase_names[i]);
+            print_histogram(&stats.phases[i]);
+        }
+    }
+
+    printf("\n");
+    return 0;
+}
+
 int run_test(struct bladerf *dev, struct app_params *p)
 {
     int status = 0;
@@ -134,6 +305,8 @@ int run_test(struct bladerf *dev, struct app_params *p)
 
     int16_t *rx_samples = NULL;
     int16_t *tx_samples = NULL;
+    struct quick_channels quick = { NULL, NULL };
+    const bool tune_rx = p->rx || (!p->rx && !p->tx);
 
     if (p->rx) {
         rx_samples = calloc(p->dev_config.samples_per_buffer, 2 * sizeof(int16_t));
@@ -167,6 +340,28 @@ int run_test(struct bladerf *dev, struct app_params *p)
         }
     }
 
+    if (p->quick_channels != 0) {
+        if (tune_rx) {
+            quick.rx = init_quick_channels(dev, p, BLADERF_MODULE_RX);
+            if (quick.rx == NULL) {
+                status = -1;
+                goto out;
+            }
+        }
+
+        if (p->tx) {
+            quick.tx = init_quick_channels(dev, p, BLADERF_MODULE_TX);
+            if (quick.tx == NULL) {
+                status = -1;
+                goto out;
+            }
+        }
+    }
+
+    /* Only account for the hops themselves */
+    bladerf_reset_tuning_stats(dev, BLADERF_MODULE_RX);
+    bladerf_reset_tuning_stats(dev, BLADERF_MODULE_TX);
+
     for (iteration = 0; iteration < p->iterations; iteration++) {
         if (iteration % 50 == 0) {
             printf("\rIteration: %16"PRIu64" of %-16"PRIu64,
@@ -176,13 +371,9 @@ int run_test(struct bladerf *dev, struct app_params *p)
 
         /* Tune the RX module if we're RX'ing data, or if no data
          * reception/transmission has been requested */
-        if (p->rx || (!p->rx && !p->tx)) {
-            unsigned int freq = next_freq(p);
-            status = bladerf_set_frequency(dev, BLADERF_MODULE_RX, freq);
+        if (tune_rx) {
+            status = hop(dev, p, BLADERF_MODULE_RX, quick.rx, iteration);
             if (status != 0) {
-                fprintf(stderr,
-                        "Failed to set RX frequency to %u @ iteration %"PRIu64": %s\n",
-                        freq, iteration, bladerf_strerror(status));
                 status = -1;
                 goto out;
             }
@@ -204,14 +395,10 @@ int run_test(struct bladerf *dev, struct app_params *p)
         }
 
         if (p->tx) {
-            unsigned int freq = next_freq(p);
             const unsigned int to_tx = p->dev_config.samples_per_buffer;
 
-            status = bladerf_set_frequency(dev, BLADERF_MODULE_TX, freq);
+            status = hop(dev, p, BLADERF_MODULE_TX, quick.tx, iteration);
             if (status != 0) {
-                fprintf(stderr,
-                        "Failed to set TX frequency to %u @ iteration %"PRIu64": %s\n",
-                        freq, iteration, bladerf_strerror(status));
                 status = -1;
                 goto out;
             }
@@ -234,6 +421,18 @@ int run_test(struct bladerf *dev, struct app_params *p)
 out:
     printf("\n");
 
+    if (status == 0 && p->profile) {
+        printf("\n");
+
+        if (tune_rx && print_profile(dev, BLADERF_MODULE_RX) != 0) {
+            status = -1;
+        }
+
+        if (p->tx && print_profile(dev, BLADERF_MODULE_TX) != 0) {
+            status = -1;
+        }
+    }
+
     if (p->rx) {
         disable_status = bladerf_enable_module(dev, BLADERF_MODULE_RX, false);
         if (disable_status != 0) {
@@ -258,6 +457,8 @@ out:
         }
     }
 
+    free(quick.rx);
+    free(quick.tx);
     free(rx_samples);
     free(tx_samples);
     return status;
@@ -275,6 +476,8 @@ int main(int argc, char *argv[])
     params.randval_seed = 1;
     params.rx = false;
     params.tx = false;
+    params.profile = false;
+    params.quick_channels = 0;
 
     options = test_get_long_options(app_long_options);
     if (options == NULL) {
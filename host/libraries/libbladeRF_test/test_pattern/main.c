@@ -0,0 +1,307 @@
+/*
+ * This program feeds bladerf_pattern_check() generated samples carrying a
+ * known set of faults, and verifies that each is classified and counted as
+ * expected. It also checks that garbage input, in which nearly every sample
+ * is erroneous, is checked within a bounded time. No device is required.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <libbladeRF.h>
+#include "host_config.h"
+
+#if BLADERF_OS_WINDOWS || BLADERF_OS_OSX
+#include "clock_gettime.h"
+#else
+#include <time.h>
+#endif
+
+#if !BLADERF_OS_WINDOWS
+#include <unistd.h>
+#endif
+
+#ifdef CLOCK_MONOTONIC
+#   define TEST_CLOCK CLOCK_MONOTONIC
+#else
+#   define TEST_CLOCK CLOCK_REALTIME
+#endif
+
+/* Samples in each generated stream, and where its fault is placed */
+#define NUM_SAMPLES     (1 << 20)
+#define FAULT_AT        (NUM_SAMPLES / 2 + 3)
+#define GAP             10000
+
+/* Samples are checked in chunks of this size, so that faults fall at
+ * arbitrary offsets into a buffer and the vectorized comparisons' tails are
+ * exercised */
+#define CHUNK           1021
+
+/* Garbage input must be checked within this time. Without a bound on the
+ * per-sample cost, a PRBS check may step through up to max_gap words of the
+ * pattern for every sample. */
+#define NUM_GARBAGE     (1 << 22)
+#define MAX_GARBAGE_MS  2000
+
+/* The whole test is aborted if it takes longer than this */
+#define WATCHDOG_S      60
+
+typedef enum {
+    FAULT_NONE,
+    FAULT_GAP,
+    FAULT_CORRUPT,
+    FAULT_DUPLICATE,
+    FAULT_RESTART,
+} fault;
+
+struct expected {
+    uint64_t errors;
+    uint64_t gaps;
+    uint64_t dropped;
+    uint64_t duplicates;
+};
+
+struct test_case {
+    const char *name;
+    fault fault;
+    struct expected expected;
+};
+
+static const struct test_case tests[] = {
+    { "clean",      FAULT_NONE,       { 0, 0, 0,   0 } },
+    { "gap",        FAULT_GAP,        { 0, 1, GAP, 0 } },
+    { "corrupt",    FAULT_CORRUPT,    { 1, 0, 0,   0 } },
+    { "duplicate",  FAULT_DUPLICATE,  { 0, 0, 0,   1 } },
+    { "restart",    FAULT_RESTART,    { 1, 0, 0,   0 } },
+};
+
+static inline uint32_t next_word(bladerf_pattern pattern, uint32_t x)
+{
+    if (pattern == BLADERF_PATTERN_COUNTER) {
+        return x + 1;
+    }
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+static inline void put_word(int16_t *samples, unsigned int i, uint32_t w)
+{
+    samples[2 * i]     = (int16_t) (w & 0xffff);
+    samples[2 * i + 1] = (int16_t) (w >> 16);
+}
+
+static inline double elapsed_ms(const struct timespec *start,
+                                const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000.0 +
+           (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/* Fill `samples` with NUM_SAMPLES of the pattern, carrying the specified
+ * fault. Returns the number of samples generated. */
+static unsigned int generate(int16_t *samples, bladerf_pattern pattern,
+                             fault f)
+{
+    uint32_t x = 0x12345678;
+    unsigned int i, n = 0;
+
+    for (i = 0; i < NUM_SAMPLES; i++) {
+        if (i == FAULT_AT) {
+            switch (f) {
+                case FAULT_GAP: {
+                    unsigned int j;
+                    for (j = 0; j < GAP; j++) {
+                        x = next_word(pattern, x);
+                    }
+                    break;
+                }
+
+                case FAULT_CORRUPT:
+                    put_word(samples, n++, x ^ 0x00a50000);
+                    x = next_word(pattern, x);
+                    continue;
+
+                case FAULT_DUPLICATE:
+                    put_word(samples, n++, x);
+                    break;
+
+                case FAULT_RESTART:
+                    /* Carry on from an unrelated point of the pattern */
+                    x = 0x9e3779b9;
+                    break;
+
+                default:
+                    break;
+            }
+        }
+
+        put_word(samples, n++, x);
+        x = next_word(pattern, x);
+    }
+
+    return n;
+}
+
+static uint64_t check(struct bladerf_pattern_check *c,
+                      const int16_t *samples, unsigned int n)
+{
+    uint64_t faults = 0;
+    unsigned int i, to_check;
+
+    for (i = 0; i < n; i += to_check) {
+        to_check = n - i < CHUNK ? n - i : CHUNK;
+        faults += bladerf_pattern_check(c, &samples[2 * i], to_check);
+    }
+
+    return faults;
+}
+
+static bool run(int16_t *samples, bladerf_pattern pattern,
+                const struct test_case *t)
+{
+    const char *name = pattern == BLADERF_PATTERN_PRBS ? "prbs" : "counter";
+    const struct expected *e = &t->expected;
+    struct bladerf_pattern_check c;
+    unsigned int n;
+    uint64_t faults;
+    int status;
+
+    n = generate(samples, pattern, t->fault);
+
+    status = bladerf_pattern_check_init(&c, pattern);
+    if (status != 0) {
+        fprintf(stderr, "Failed to initialize check: %s\n",
+                bladerf_strerror(status));
+        return false;
+    }
+
+    faults = check(&c, samples, n);
+
+    if (c.samples != n || c.errors != e->errors || c.gaps != e->gaps ||
+        c.dropped != e->dropped || c.duplicates != e->duplicates ||
+        faults != e->errors + e->gaps + e->duplicates) {
+
+        fprintf(stderr, "%s, %s: got %llu faults: %llu errors, %llu gaps "
+                "(%llu dropped), %llu duplicates\n", name, t->name,
+                (unsigned long long) faults,
+                (unsigned long long) c.errors,
+                (unsigned long long) c.gaps,
+                (unsigned long long) c.dropped,
+                (unsigned long long) c.duplicates);
+
+        fprintf(stderr, "%s, %s: expected %llu errors, %llu gaps "
+                "(%llu dropped), %llu duplicates\n", name, t->name,
+                (unsigned long long) e->errors,
+                (unsigned long long) e->gaps,
+                (unsigned long long) e->dropped,
+                (unsigned long long) e->duplicates);
+
+        return false;
+    }
+
+    printf("%s, %s: OK\n", name, t->name);
+    return true;
+}
+
+static bool run_garbage(int16_t *samples, bladerf_pattern pattern)
+{
+    const char *name = pattern == BLADERF_PATTERN_PRBS ? "prbs" : "counter";
+    struct bladerf_pattern_check c;
+    struct timespec start, end;
+    uint32_t lcg = 1;
+    uint64_t faults;
+    double ms;
+    unsigned int i;
+
+    /* An LCG does not follow either pattern */
+    for (i = 0; i < NUM_GARBAGE; i++) {
+        lcg = lcg * 1664525 + 1013904223;
+        put_word(samples, i, lcg);
+    }
+
+    bladerf_pattern_check_init(&c, pattern);
+
+    clock_gettime(TEST_CLOCK, &start);
+    faults = check(&c, samples, NUM_GARBAGE);
+    clock_gettime(TEST_CLOCK, &end);
+
+    ms = elapsed_ms(&start, &end);
+    printf("%s, garbage: %llu faults in %u samples, checked in %.1f ms\n",
+           name, (unsigned long long) faults, NUM_GARBAGE, ms);
+
+    if (faults < NUM_GARBAGE / 2) {
+        fprintf(stderr, "%s, garbage: expected most samples to be faulty\n",
+                name);
+        return false;
+    }
+
+    if (ms > MAX_GARBAGE_MS) {
+        fprintf(stderr, "%s, garbage: took longer than %u ms\n",
+                name, MAX_GARBAGE_MS);
+        return false;
+    }
+
+    return true;
+}
+
+int main(void)
+{
+    static const bladerf_pattern patterns[] = {
+        BLADERF_PATTERN_COUNTER, BLADERF_PATTERN_PRBS
+    };
+
+    int16_t *samples;
+    unsigned int i, j;
+    bool pass = true;
+
+#if !BLADERF_OS_WINDOWS
+    alarm(WATCHDOG_S);
+#endif
+
+    /* Room for the largest stream: garbage, or a duplicated sample */
+    samples = malloc((NUM_GARBAGE + 1) * 2 * sizeof(int16_t));
+    if (samples == NULL) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < sizeof(patterns) / sizeof(patterns[0]); i++) {
+        for (j = 0; j < sizeof(tests) / sizeof(tests[0]); j++) {
+            pass = run(samples, patterns[i], &tests[j]) && pass;
+        }
+
+        pass = run_garbage(samples, patterns[i]) && pass;
+    }
+
+    free(samples);
+
+    printf("%s\n", pass ? "Passed." : "Failed.");
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
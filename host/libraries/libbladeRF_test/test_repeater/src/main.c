@@ -30,7 +30,7 @@
 #include "conversions.h"    /* Conversion routines from host/common */
 #include "repeater.h"
 
-#define OPTARG_STR "d:s:t:r:S:b:B:T:v:h"
+#define OPTARG_STR "d:s:t:r:S:b:B:T:D:g:F:v:h"
 
 static struct option long_options[] = {
     { "device",         required_argument,  0,  'd'},
@@ -40,6 +40,9 @@ static struct option long_options[] = {
     { "num-samples",    required_argument,  0,  'S'},
     { "num-buffers",    required_argument,  0,  'B'},
     { "num-transfers",  required_argument,  0,  'T'},
+    { "delay",          required_argument,  0,  'D'},
+    { "gain",           required_argument,  0,  'g'},
+    { "shift",          required_argument,  0,  'F'},
     { "verbosity",      required_argument,  0,  'v'},
     { "help",           no_argument,        0,  'h'},
     { 0,                0,                  0,  0},
@@ -84,10 +87,23 @@ static void usage(const char *argv0)
                                         DEFAULT_NUM_BUFFERS);
 
     printf("  -T, --num-transfers <n>   Number of transfers to use. Default is %d.\n"
-           "                            This value should be *at least* 2 less than the\n"
-           "                            number of buffers being used.\n\n",
+           "                            The number of buffers must be greater than\n"
+           "                            twice this value. Fewer transfers reduce the\n"
+           "                            RX to TX latency.\n\n",
                                         DEFAULT_NUM_TRANSFERS);
 
+    printf("  -D, --delay <n>           Retransmit each sample exactly <n> samples\n"
+           "                            after it was received, using timestamps.\n"
+           "                            By default, samples are retransmitted as\n"
+           "                            soon as possible.\n\n");
+
+    printf("  -g, --gain <gain>         Scale received samples by a linear gain,\n"
+           "                            within [0, 8), before retransmitting them.\n\n");
+
+    printf("  -F, --shift <freq>        Shift received samples by <freq> Hz before\n"
+           "                            retransmitting them. Must be within half\n"
+           "                            of the sample rate.\n\n");
+
     printf("  -v, --verbosity <level>   Set libbladeRF verbosity level.\n\n");
 
     printf("  -h, --help                Show this text\n\n");
@@ -190,6 +206,30 @@ static int handle_args(int argc, char *argv[], struct repeater_config *config)
                 }
                 break;
 
+            case 'D':
+                config->delay = str2uint64(optarg, 1, UINT64_MAX, &conv_ok);
+                if (!conv_ok) {
+                    fprintf(stderr, "\nError: Invalid delay: %s\n\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'g':
+                config->gain = (float) str2double(optarg, 0.0, 8.0, &conv_ok);
+                if (!conv_ok || config->gain >= 8.0f) {
+                    fprintf(stderr, "\nError: Invalid gain: %s\n\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'F':
+                config->shift = str2double(optarg, -INT_MAX, INT_MAX, &conv_ok);
+                if (!conv_ok) {
+                    fprintf(stderr, "\nError: Invalid shift: %s\n\n", optarg);
+                    return -1;
+                }
+                break;
+
             case 'v':
                 if (!strcasecmp(optarg, "critical")) {
                     config->verbosity = BLADERF_LOG_LEVEL_CRITICAL;
@@ -226,9 +266,9 @@ static int handle_args(int argc, char *argv[], struct repeater_config *config)
         return -1;
     }
 
-    if (config->num_buffers < (config->num_transfers + 2)) {
+    if (config->num_buffers <= 2 * config->num_transfers) {
         fprintf(stderr, "\nError: "
-                "# buffers (%u) must be at least 2 greater than "
+                "# buffers (%u) must be greater than twice "
                 "# transfers (%u)\n\n", config->num_buffers,
                 config->num_transfers);
         return -1;
@@ -20,55 +20,19 @@
  *
  *
  *
- * This file implements the guts of the simple full-duplex repeater.
- *
- * We run two threads to block on bladerf_stream() calls and handle
- * callbacks, while the "main" thread waits for user input to shut down.
- *
- * When starting a TX stream, an initial set of callbacks are immediately fired
- * off to fill the initial set of transfers. Before starting the TX stream, we
- * first wait to start the RX stream has filled enough buffers to account for
- * the initial set of TX transfers. This is referred to as the "prefill count"
- * in this code.
- *
- * We set the prefill count halfway between the total number of buffers and
- * transfers:
- *
- *                           +---------+  <-- # buffers (32)
- *                           |         |
- *                           +---------+  <-- prefill count (24)
- *                           |         |
- *                           +---------+  <-- # transfers (16)
- *                           |         |
- *                           |         |
- *                           +---------+  0
- *
- *
- *
- * Although we designate each thread "RX" or "TX", note that these threads
- * may receive callbacks for the other module. Therefore, the callbacks
- * cannot block [1] and must be implemented in a thread-safe manner;
- * accesses to buffer management data are locked via a mutex.
- *
- * [1] If a TX callback were to block to wait for RX buffers to
- *     fill more, deadlock could occur because two TX callbacks could be fired
- *     off before an RX callback is exectuted to release the TX callbacks.
- *
- *
- * Overruns and underruns are not handled intelligently in this simple test.
- * If either occur (they shouldn't), the associated tasks shut down and wait
- * for the user to terminate the program.
+ * This file implements the user interface of the simple full-duplex repeater.
+ * Samples are relayed by libbladeRF's repeater (see bladerf_repeater_start()),
+ * while the main thread waits for user input to adjust gains, report
+ * statistics, or shut down.
  */
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <pthread.h>
+#include <inttypes.h>
 #include <libbladeRF.h>
-#include "rel_assert.h"
 
 #include "repeater.h"
-#include "minmax.h"
 
 #if BLADERF_OS_WINDOWS
 #include <conio.h>
@@ -149,13 +113,6 @@ static char get_key()
 
 #endif
 
-/* Thread-safe wrapper around fprintf(stderr, ...) */
-#define print_error(repeater_, ...) do { \
-    pthread_mutex_lock(&repeater_->stderr_lock); \
-    fprintf(stderr, __VA_ARGS__); \
-    pthread_mutex_unlock(&repeater_->stderr_lock); \
-} while (0)
-
 #define GAIN_TXVGA1_MIN     -35
 #define GAIN_TXVGA1_MAX     4
 #define GAIN_TXVGA2_MIN     0
@@ -175,43 +132,19 @@ static char get_key()
 #define KEY_INC_RXVGA2      '8'
 #define KEY_DEC_LNAGAIN     '9'
 #define KEY_INC_LNAGAIN     '0'
+#define KEY_STATS           's'
 #define KEY_QUIT            'q'
 #define KEY_HELP            'h'
 
 
-struct buf_mgmt
-{
-    int rx_idx;         /* Next sample buffer to RX into. < 0 indicates stop */
-    int tx_idx;         /* Next sample buffer to TX from. < 0 indicates stop */
-    size_t num_filled;  /* Number of buffers filled with RX data awaiting TX */
-
-    size_t prefill_count;   /* Since the initial set of TX callbacks will look
-                               to fill all available transfers, we must
-                               ensure that the RX task has prefilled a
-                               sufficient number of buffers */
-
-    void **samples;         /* Sample buffers */
-    size_t num_buffers;     /* # of sample buffers */
-
-    /* Used to signal the TX thread when a few samplse have been buffered up */
-    pthread_cond_t  samples_available;
-
-    pthread_mutex_t lock;
-};
-
 struct repeater
 {
     struct bladerf *device;
+    struct bladerf_repeater *engine;
 
-    pthread_t rx_task;
-    struct bladerf_stream *rx_stream;
-
-    pthread_t tx_task;
-    struct bladerf_stream *tx_stream;
-
-    pthread_mutex_t stderr_lock;
-
-    struct buf_mgmt buf_mgmt;
+    /** Processing stages used by engine */
+    struct bladerf_repeater_stage stages[BLADERF_REPEATER_MAX_STAGES];
+    unsigned int num_stages;
 
     int gain_txvga1;            /**< TX VGA1 gain */
     int gain_txvga2;            /**< TX VGA2 gain */
@@ -232,6 +165,9 @@ void repeater_config_init(struct repeater_config *c)
     c->num_buffers = DEFAULT_NUM_BUFFERS;
     c->num_transfers = DEFAULT_NUM_TRANSFERS;
     c->samples_per_buffer = DEFAULT_SAMPLES_PER_BUFFER;
+    c->delay = 0;
+    c->gain = 1.0f;
+    c->shift = 0.0;
 
     c->verbosity = BLADERF_LOG_LEVEL_INFO;
 }
@@ -242,158 +178,10 @@ void repeater_config_deinit(struct repeater_config *c)
     c->device_str = NULL;
 }
 
-static void *tx_stream_callback(struct bladerf *dev,
-                                struct bladerf_stream *stream,
-                                struct bladerf_metadata *meta,
-                                void *samples,
-                                size_t num_samples,
-                                void *user_data)
-{
-    void *ret;
-    struct repeater *repeater = (struct repeater *)user_data;
-
-    pthread_mutex_lock(&repeater->buf_mgmt.lock);
-
-    if (repeater->buf_mgmt.tx_idx < 0) {
-        ret = NULL;
-    } else {
-
-        /* We shouldn't encounter underruns, but for the sake of simplicity
-         * in this test/example, we'll just error out if we hit one */
-        if (repeater->buf_mgmt.num_filled == 0) {
-            ret = NULL;
-            print_error(repeater,
-                        "TX underrun encountered. Terminating TX task.\r\n");
-        } else {
-
-            ret = repeater->buf_mgmt.samples[repeater->buf_mgmt.tx_idx++];
-
-            if (repeater->buf_mgmt.tx_idx >= (int)repeater->buf_mgmt.num_buffers) {
-                repeater->buf_mgmt.tx_idx = 0;
-            }
-
-            repeater->buf_mgmt.num_filled--;
-        }
-    }
-
-    pthread_mutex_unlock(&repeater->buf_mgmt.lock);
-
-    return ret;
-}
-
-void * tx_task_run(void *repeater_)
-{
-    int status;
-    struct repeater *repeater = (struct repeater *)repeater_;
-    bool exit_early = false;
-
-    /* Wait for RX task to buffer up some samples before we begin
-     * consuming them */
-    pthread_mutex_lock(&repeater->buf_mgmt.lock);
-    while(repeater->buf_mgmt.num_filled < repeater->buf_mgmt.prefill_count &&
-          repeater->buf_mgmt.tx_idx >= 0) {
-
-        status = pthread_cond_wait(&repeater->buf_mgmt.samples_available,
-                          &repeater->buf_mgmt.lock);
-
-        if (status != 0) {
-            print_error(repeater, "TX startup wait failed (%d)\n", status);
-            exit_early = true;
-        }
-    }
-
-    exit_early |= repeater->buf_mgmt.tx_idx < 0;
-    pthread_mutex_unlock(&repeater->buf_mgmt.lock);
-
-    if (!exit_early) {
-        /* Call stream */
-        status = bladerf_stream(repeater->tx_stream, BLADERF_MODULE_TX);
-
-        if (status < 0) {
-            print_error(repeater, "TX stream failure: %s\r\n",
-                    bladerf_strerror(status));
-        }
-    } else {
-        printf("EARLY EXIT\r\n");
-    }
-
-    return NULL;
-}
-
-static void *rx_stream_callback(struct bladerf *dev,
-                                struct bladerf_stream *stream,
-                                struct bladerf_metadata *meta,
-                                void *samples,
-                                size_t num_samples,
-                                void *user_data)
-{
-    struct repeater *repeater = (struct repeater *)user_data;
-    void *ret;
-
-    pthread_mutex_lock(&repeater->buf_mgmt.lock);
-
-    if (repeater->buf_mgmt.rx_idx < 0) {
-        ret = NULL;
-    } else {
-        ret = repeater->buf_mgmt.samples[repeater->buf_mgmt.rx_idx++];
-
-        /* Wrap back around */
-        if (repeater->buf_mgmt.rx_idx >= (int)repeater->buf_mgmt.num_buffers) {
-            repeater->buf_mgmt.rx_idx = 0;
-        }
-
-        if (repeater->buf_mgmt.num_filled >= 2 * repeater->buf_mgmt.num_buffers) {
-            /* We shouldn't encounter overruns, but if we do, we'll just
-             * error out of the program, for the sake of simplicity */
-            print_error(repeater,
-                        "RX Overrun encountered. Terminating RX task.\r\n");
-            ret = NULL;
-        } else {
-            repeater->buf_mgmt.num_filled++;
-        }
-        pthread_cond_signal(&repeater->buf_mgmt.samples_available);
-    }
-
-    pthread_mutex_unlock(&repeater->buf_mgmt.lock);
-
-    return ret;
-}
-
-void * rx_task_run(void *repeater_)
-{
-    int status;
-    struct repeater *repeater = (struct repeater *)repeater_;
-
-    status = bladerf_stream(repeater->rx_stream, BLADERF_MODULE_RX);
-    if (status < 0) {
-        print_error(repeater, "RX stream failure: %s\r\n", bladerf_strerror(status));
-    }
-
-    return NULL;
-}
-
 static inline void repeater_init(struct repeater *repeater,
                                  struct repeater_config *config)
 {
     memset(repeater, 0, sizeof(*repeater));
-
-    pthread_mutex_init(&repeater->stderr_lock, NULL);
-    pthread_mutex_init(&repeater->buf_mgmt.lock, NULL);
-    pthread_cond_init(&repeater->buf_mgmt.samples_available, NULL);
-
-    repeater->buf_mgmt.num_filled = 0;
-    repeater->buf_mgmt.num_buffers = config->num_buffers;
-
-    /* We must prefill, at a minimum, 1 + the number of TX transfers,
-     * since the intial set of TX callbacks will look to populate each
-     * transfer. Below, we try to set the prefill count halfway between
-     * the number of buffers and the number of transfers. */
-    repeater->buf_mgmt.prefill_count = config->num_transfers;
-    repeater->buf_mgmt.prefill_count +=
-        (repeater->buf_mgmt.num_buffers - config->num_transfers) / 2;
-
-    assert(repeater->buf_mgmt.prefill_count != 0);
-
     bladerf_log_set_verbosity(config->verbosity);
 }
 
@@ -484,25 +272,6 @@ static int init_device(struct repeater *repeater, struct repeater_config *config
         printf("Set RX frequency to %d Hz\r\n", config->rx_freq);
     }
 
-    status = bladerf_enable_module(repeater->device, BLADERF_MODULE_RX, true);
-    if (status < 0) {
-        fprintf(stderr, "Failed to enable RX module: %s\r\n",
-                bladerf_strerror(status));
-        goto init_device_error;
-    } else {
-        printf("Enabled RX module\r\n");
-    }
-
-    status = bladerf_enable_module(repeater->device, BLADERF_MODULE_TX, true);
-    if (status < 0) {
-        bladerf_enable_module(repeater->device, BLADERF_MODULE_RX, false);
-        fprintf(stderr, "Failed to enable TX module: %s\r\n",
-                bladerf_strerror(status));
-        goto init_device_error;
-    } else {
-        printf("Enabled TX module\r\n");
-    }
-
     status = bladerf_get_txvga1(repeater->device, &repeater->gain_txvga1);
     if (status < 0) {
         fprintf(stderr, "Failed to get TXVGA1 gain: %s\r\n",
@@ -557,129 +326,147 @@ init_device_error:
     return status;
 }
 
-static int init_streams(struct repeater *repeater,
+static void free_stages(struct repeater *repeater)
+{
+    unsigned int i;
+
+    for (i = 0; i < repeater->num_stages; i++) {
+        bladerf_repeater_stage_free(&repeater->stages[i]);
+    }
+
+    repeater->num_stages = 0;
+}
+
+static int start_engine(struct repeater *repeater,
                         struct repeater_config *config)
 {
     int status;
+    struct bladerf_repeater_config engine_config;
 
-    status = bladerf_init_stream(&repeater->rx_stream,
-                                 repeater->device,
-                                 rx_stream_callback,
-                                 &repeater->buf_mgmt.samples,
-                                 config->num_buffers,
-                                 BLADERF_FORMAT_SC16_Q11,
-                                 config->samples_per_buffer,
-                                 config->num_transfers,
-                                 repeater);
-    if (status < 0) {
-        fprintf(stderr, "Failed to initialize RX stream: %s\r\n",
-                bladerf_strerror(status));
-        return status;
-    } else {
-        repeater->buf_mgmt.rx_idx = 0;
+    repeater->num_stages = 0;
+
+    if (config->gain != 1.0f) {
+        status = bladerf_repeater_stage_gain(
+                    &repeater->stages[repeater->num_stages], config->gain);
+        if (status < 0) {
+            fprintf(stderr, "Failed to create gain stage: %s\r\n",
+                    bladerf_strerror(status));
+            goto out;
+        }
+        repeater->num_stages++;
+    }
+
+    if (config->shift != 0.0) {
+        status = bladerf_repeater_stage_nco(
+                    &repeater->stages[repeater->num_stages],
+                    config->shift / config->sample_rate);
+        if (status < 0) {
+            fprintf(stderr, "Failed to create frequency shift stage: %s\r\n",
+                    bladerf_strerror(status));
+            goto out;
+        }
+        repeater->num_stages++;
     }
 
+    engine_config.num_buffers = config->num_buffers;
+    engine_config.buffer_size = config->samples_per_buffer;
+    engine_config.num_transfers = config->num_transfers;
+    engine_config.delay = config->delay;
+    engine_config.stages = repeater->stages;
+    engine_config.num_stages = repeater->num_stages;
 
-    status = bladerf_init_stream(&repeater->tx_stream,
-                                 repeater->device,
-                                 tx_stream_callback,
-                                 NULL,
-                                 config->num_buffers,
-                                 BLADERF_FORMAT_SC16_Q11,
-                                 config->samples_per_buffer,
-                                 config->num_transfers,
-                                 repeater);
+    status = bladerf_repeater_start(repeater->device, &engine_config,
+                                    &repeater->engine);
     if (status < 0) {
-        fprintf(stderr, "Failed to initialize TX stream: %s\r\n",
+        fprintf(stderr, "Failed to start repeater: %s\r\n",
                 bladerf_strerror(status));
-        return status;
-    } else {
-        repeater->buf_mgmt.tx_idx = 0;
     }
 
-    repeater->buf_mgmt.num_buffers = config->num_buffers;
+out:
+    if (status < 0) {
+        free_stages(repeater);
+    }
 
-    return 0;
+    return status;
 }
 
-static int start_tasks(struct repeater *repeater)
+static void stop_engine(struct repeater *repeater)
 {
     int status;
 
-    status = pthread_create(&repeater->rx_task, NULL, rx_task_run, repeater);
-    if (status < 0) {
-        return -1;
-    }
+    printf("Stopping repeater...\r\n");
+
+    status = bladerf_repeater_stop(repeater->engine);
+    repeater->engine = NULL;
+    free_stages(repeater);
 
-    status = pthread_create(&repeater->tx_task, NULL, tx_task_run, repeater);
     if (status < 0) {
-        pthread_cancel(repeater->rx_task);
-        pthread_join(repeater->rx_task, NULL);
-        return -1;
+        fprintf(stderr, "Stream failure: %s\r\n", bladerf_strerror(status));
     }
-
-    return 0;
-}
-
-static void stop_tasks(struct repeater *repeater)
-{
-    print_error(repeater, "Stoppping RX and tasks...\r\n");
-    pthread_mutex_lock(&repeater->buf_mgmt.lock);
-    repeater->buf_mgmt.tx_idx = -1;
-    repeater->buf_mgmt.rx_idx = -1;
-    pthread_mutex_unlock(&repeater->buf_mgmt.lock);
-    pthread_join(repeater->rx_task, NULL);
-
-    /* Fire off the "samples available" signal to the TX thread, in case
-     * it is still awaiting for the prefill completion */
-    pthread_mutex_lock(&repeater->buf_mgmt.lock);
-    pthread_cond_signal(&repeater->buf_mgmt.samples_available);
-    pthread_mutex_unlock(&repeater->buf_mgmt.lock);
-    pthread_join(repeater->tx_task, NULL);
-
 }
 
 static void deinit(struct repeater *repeater)
 {
-
     if (repeater->device) {
-        if (repeater->rx_stream) {
-            bladerf_deinit_stream(repeater->rx_stream);
-        }
-
-        if (repeater->tx_stream) {
-            bladerf_deinit_stream(repeater->tx_stream);
-        }
-
-        bladerf_enable_module(repeater->device, BLADERF_MODULE_RX, false);
-        bladerf_enable_module(repeater->device, BLADERF_MODULE_TX, false);
-
         bladerf_close(repeater->device);
         repeater->device = NULL;
     }
 }
 
-static int init(struct repeater *repeater, struct repeater_config *config)
+static void repeater_print_stats(struct repeater *repeater,
+                                 struct repeater_config *config)
 {
     int status;
+    unsigned int i;
+    struct bladerf_repeater_stats stats;
 
-    repeater_init(repeater, config);
-
-    /* Configure the bladeRF */
-    status = init_device(repeater, config);
+    status = bladerf_repeater_get_stats(repeater->engine, &stats);
     if (status < 0) {
-        fprintf(stderr, "Failed to initialize device.\r\n");
-        return -1;
+        fprintf(stderr, "Failed to get statistics: %s\r\n",
+                bladerf_strerror(status));
+        return;
     }
 
-    /* Allocate streams */
-    status = init_streams(repeater, config);
-    if (status < 0) {
-        fprintf(stderr, "Failed to allocate streams.\r\n");
-        return -1;
+    printf("\r\nBuffers relayed: %"PRIu64"\r\n", stats.buffers);
+    printf("Dropped (RX):    %"PRIu64"\r\n", stats.dropped);
+    printf("Underruns (TX):  %"PRIu64"\r\n", stats.underruns);
+
+    if (config->delay != 0) {
+        printf("Late buffers:    %"PRIu64"\r\n", stats.late);
+        if (stats.buffers != 0) {
+            printf("Minimum margin:  %"PRId64" samples (%.1f us)\r\n",
+                   stats.min_margin,
+                   stats.min_margin * 1e6 / config->sample_rate);
+        }
     }
 
-    return 0;
+    if (stats.buffers != 0) {
+        printf("RX->TX latency:  mean %.1f us, max %"PRIu64" us\r\n",
+               (double) stats.latency_total_us / stats.buffers,
+               stats.latency_max_us);
+
+        for (i = 0; i < BLADERF_STREAM_STATS_HIST_LEN; i++) {
+            if (stats.latency_hist[i] != 0) {
+                printf("  [%7u, %7u) us: %"PRIu64"\r\n",
+                       i == 0 ? 0 : 1u << (i - 1), 1u << i,
+                       stats.latency_hist[i]);
+            }
+        }
+
+        for (i = 0; i < repeater->num_stages; i++) {
+            printf("Stage %-8s   mean %.1f us, max %"PRIu64" us\r\n",
+                   repeater->stages[i].name,
+                   (double) stats.stage_total_us[i] / stats.buffers,
+                   stats.stage_max_us[i]);
+        }
+
+        if (repeater->num_stages != 0) {
+            printf("Over budget:     %"PRIu64" buffers\r\n",
+                   stats.budget_exceeded);
+        }
+    }
+
+    printf("\r\n");
 }
 
 static void repeater_help()
@@ -701,6 +488,7 @@ static void repeater_help()
     printf("LNA Gain: Decrement = %c, Increment = %c\r\n",
             KEY_DEC_LNAGAIN, KEY_INC_LNAGAIN);
 
+    printf("Statistics: s\r\n");
     printf("Quit: q\r\n");
     printf("Hotkey list: h\r\n\r\n");
 }
@@ -719,7 +507,8 @@ static const char *lnagain2str(bladerf_lna_gain gain)
     }
 }
 
-static int repeater_handle_key(struct repeater *repeater, char key)
+static int repeater_handle_key(struct repeater *repeater,
+                               struct repeater_config *config, char key)
 {
     int status = 0;
 
@@ -887,6 +676,10 @@ static int repeater_handle_key(struct repeater *repeater, char key)
             }
             break;
 
+        case KEY_STATS:
+            repeater_print_stats(repeater, config);
+            break;
+
         case KEY_HELP:
             repeater_help();
             break;
@@ -909,23 +702,25 @@ int repeater_run(struct repeater_config *config)
         return 1;
     }
 
-    status = init(&repeater, config);
-    if (status == 0) {
+    repeater_init(&repeater, config);
 
-        /* Start tasks and wait for a key press to shut down */
-        status = start_tasks(&repeater);
-        if (status < 0) {
-            fprintf(stderr, "Failed to start tasks.\r\n");
-        } else {
+    /* Configure the bladeRF */
+    status = init_device(&repeater, config);
+    if (status < 0) {
+        fprintf(stderr, "Failed to initialize device.\r\n");
+    } else {
+        /* Start relaying and wait for a key press to shut down */
+        status = start_engine(&repeater, config);
+        if (status == 0) {
             repeater_help();
             do {
                 key = get_key();
-                repeater_handle_key(&repeater, key);
+                repeater_handle_key(&repeater, config, key);
             } while (key != KEY_QUIT);
-        }
 
-        /* Stop tasks */
-        stop_tasks(&repeater);
+            repeater_print_stats(&repeater, config);
+            stop_engine(&repeater);
+        }
 
         deinit(&repeater);
     }
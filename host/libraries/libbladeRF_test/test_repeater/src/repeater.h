@@ -21,8 +21,11 @@
 #ifndef REPEATER_H__
 #define REPEATER_H__
 
+#include <stdint.h>
+#include <libbladeRF.h>
+
 #define DEFAULT_NUM_BUFFERS         32
-#define DEFAULT_NUM_TRANSFERS       16
+#define DEFAULT_NUM_TRANSFERS       8
 #define DEFAULT_SAMPLES_PER_BUFFER  8192
 #define DEFAULT_SAMPLE_RATE         1000000
 #define DEFAULT_FREQUENCY           1000000000
@@ -43,6 +46,12 @@ struct repeater_config
     int num_buffers;            /**< Number of buffers to allocate and use */
     int num_transfers;          /**< Number of transfers to allocate and use */
     int samples_per_buffer;     /**< Number of SC16Q11 samples per buffer */
+    uint64_t delay;             /**< RX to TX delay, in samples. 0 relays
+                                 *   samples as soon as they are received */
+    float gain;                 /**< Digital gain applied to received samples.
+                                 *   1.0 disables the gain stage. */
+    double shift;               /**< Frequency shift applied to received
+                                 *   samples, in Hz. 0 disables it. */
 
 
     bladerf_log_level verbosity;    /** Library verbosity */
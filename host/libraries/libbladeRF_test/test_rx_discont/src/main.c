@@ -28,6 +28,7 @@
 #include <string.h>
 #include <errno.h>
 #include <limits.h>
+#include <inttypes.h>
 
 #include <libbladeRF.h>
 #include <getopt.h>
@@ -40,15 +41,15 @@
 #define NUM_XFERS   31
 #define TIMEOUT_MS  2500
 
-#define RESET_EXPECTED  UINT32_MAX
-
-#define OPTSTR "hs:i:t:v"
+#define OPTSTR "hd:s:i:p:v"
 const struct option long_options[] = {
     { "help",           no_argument,        0,          'h' },
     { "device",         required_argument,  0,          'd' },
     { "samplerate",     required_argument,  0,          's' },
     { "iterations",     required_argument,  0,          'i' },
+    { "pattern",        required_argument,  0,          'p' },
     { "verbose",        no_argument,        0,          'v' },
+    { NULL,             0,                  0,          0   },
 };
 
 const struct numeric_suffix freq_suffixes[] = {
@@ -69,6 +70,7 @@ const struct numeric_suffix count_suffixes[] = {
 struct app_params {
     unsigned int samplerate;
     unsigned int iterations;
+    bladerf_pattern pattern;
     char *device_str;
 };
 
@@ -79,14 +81,15 @@ static void print_usage(const char *argv0)
     printf("\n");
     printf("Options:\n");
     printf("    -s, --samplerate <value>    Use the specified sample rate.\n");
-    printf("    -t, --test <test name>      Run the specified test.\n");
+    printf("    -p, --pattern <pattern>     Check the specified pattern.\n");
     printf("    -i, --iterations <count>    Run the specified number of iterations\n");
     printf("    -d, --device <devstr>       Device argument string\n");
     printf("    -h, --help                  Print this help text.\n");
     printf("\n");
-    printf("Available tests:\n");
-    printf("    rx_counter  -   Received samples are derived from the internal\n"
-           "                    FPGA counter. Gaps are reported.\n");
+    printf("Available patterns:\n");
+    printf("    counter     -   The FPGA's 32-bit counter (default).\n");
+    printf("    prbs        -   The FPGA's pseudorandom sequence. This requires\n"
+           "                    FPGA v0.1.18 or later.\n");
     printf("\n");
 }
 
@@ -99,6 +102,7 @@ int handle_cmdline(int argc, char *argv[], struct app_params *p)
 
     p->samplerate = 1000000;
     p->iterations = 10000;
+    p->pattern = BLADERF_PATTERN_COUNTER;
     p->device_str = NULL;
 
     while ((c = getopt_long(argc, argv, OPTSTR, long_options, &idx)) >= 0) {
@@ -133,6 +137,17 @@ int handle_cmdline(int argc, char *argv[], struct app_params *p)
                 p->device_str = optarg;
                 break;
 
+            case 'p':
+                if (!strcasecmp(optarg, "counter")) {
+                    p->pattern = BLADERF_PATTERN_COUNTER;
+                } else if (!strcasecmp(optarg, "prbs")) {
+                    p->pattern = BLADERF_PATTERN_PRBS;
+                } else {
+                    fprintf(stderr, "Invalid pattern: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
             case 'v':
                 bladerf_log_set_verbosity(BLADERF_LOG_LEVEL_VERBOSE);
                 break;
@@ -149,12 +164,12 @@ int handle_cmdline(int argc, char *argv[], struct app_params *p)
 int run_test(struct bladerf *dev, struct app_params *p)
 {
     int status;
-    uint32_t gpio_val, gpio_backup;
-    unsigned int i, j;
-    uint32_t *data = NULL;
-    unsigned int discontinuities = 0;
-    unsigned int sample_num = 0;
-    unsigned int count_exp = RESET_EXPECTED;
+    bladerf_rx_mux mux_backup;
+    unsigned int i;
+    int16_t *data = NULL;
+    uint64_t faults;
+    struct bladerf_pattern_check check;
+    struct bladerf_stream_stats stats;
     const unsigned int update_interval = p->samplerate / BUFFER_SIZE;
 
     status = bladerf_sync_config(dev,
@@ -171,25 +186,25 @@ int run_test(struct bladerf *dev, struct app_params *p)
         return status;
     }
 
-    status = bladerf_config_gpio_read(dev, &gpio_val);
+    status = bladerf_get_rx_mux(dev, &mux_backup);
     if (status != 0) {
-        fprintf(stderr, "Failed to read device IO configuration: %s\n",
+        fprintf(stderr, "Failed to read RX mux: %s\n",
                 bladerf_strerror(status));
         return status;
     }
 
-    /* TODO use API macro (in upcoming changeset) */
-    gpio_backup = gpio_val;
-    gpio_val |= 0x200;
-
-    status = bladerf_config_gpio_write(dev, gpio_val);
+    status = bladerf_set_rx_mux(dev, p->pattern == BLADERF_PATTERN_PRBS ?
+                                     BLADERF_RX_MUX_PRBS :
+                                     BLADERF_RX_MUX_32BIT_COUNTER);
     if (status != 0) {
-        fprintf(stderr, "Failed to write device IO configuration: %s\n",
+        fprintf(stderr, "Failed to set RX mux: %s\n",
                 bladerf_strerror(status));
         return status;
     }
 
-    data = malloc(BUFFER_SIZE * sizeof(data[0]));
+    bladerf_pattern_check_init(&check, p->pattern);
+
+    data = malloc(2 * BUFFER_SIZE * sizeof(data[0]));
     if (data == NULL) {
         perror("malloc");
         status = BLADERF_ERR_UNEXPECTED;
@@ -214,34 +229,33 @@ int run_test(struct bladerf *dev, struct app_params *p)
         status = bladerf_sync_rx(dev, data, BUFFER_SIZE, NULL, TIMEOUT_MS);
         if (status != 0) {
             fprintf(stderr, "\nRX failed: %s\n", bladerf_strerror(status));
+            break;
         }
 
-        for (j = 0; j < BUFFER_SIZE; j++) {
-            if (count_exp != RESET_EXPECTED) {
-                if (count_exp != data[j]) {
-                    fprintf(stderr, "\nDiscontinuity @ sample %u\n",
-                            sample_num + j);
-                    fprintf(stderr, "   Expected 0x%08x, Got 0x%08x\n",
-                            count_exp, data[j]);
-
-                    count_exp = UINT32_MAX;
-                    discontinuities++;
-                } else {
-                    count_exp++;
-                }
-            } else {
-                count_exp = data[j] + 1;
-            }
+        faults = bladerf_pattern_check(&check, data, BUFFER_SIZE);
+        if (faults != 0) {
+            fprintf(stderr, "\n%" PRIu64 " faulty samples in buffer %u\n",
+                    faults, i);
         }
+    }
 
-        sample_num += BUFFER_SIZE;
+    if (bladerf_get_stream_stats(dev, BLADERF_MODULE_RX, &stats) != 0) {
+        memset(&stats, 0, sizeof(stats));
     }
 
-    printf("\n\nDone. %u discontinuities encountered.\n", discontinuities);
+    printf("\n\nDone. %" PRIu64 " samples checked.\n", check.samples);
+    printf("  Errors:          %" PRIu64 "\n", check.errors);
+    printf("  Duplicates:      %" PRIu64 "\n", check.duplicates);
+    printf("  Gaps:            %" PRIu64 " (%" PRIu64 " samples)\n",
+           check.gaps, check.dropped);
+    printf("  Host overruns:   %" PRIu64 " (%" PRIu64 " samples)\n",
+           stats.overruns, stats.resubmissions * BUFFER_SIZE);
+
+    bladerf_enable_module(dev, BLADERF_MODULE_RX, false);
 
 out:
-    if (bladerf_config_gpio_write(dev, gpio_backup) != 0) {
-        fprintf(stderr, "Failed to restore device IO configuration\n");
+    if (bladerf_set_rx_mux(dev, mux_backup) != 0) {
+        fprintf(stderr, "Failed to restore RX mux\n");
     }
 
     free(data);
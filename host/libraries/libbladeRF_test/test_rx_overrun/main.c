@@ -0,0 +1,196 @@
+/*
+ * This program forces RX overruns, by pausing between bursts of sync_rx()
+ * calls, and verifies that the samples received after each recovery are
+ * contiguous, with every discontinuity reported.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <inttypes.h>
+#include <libbladeRF.h>
+#include "host_config.h"
+
+#if !BLADERF_OS_WINDOWS
+#include <unistd.h>
+#endif
+
+/* The stream is configured such that the buffers fill in a few milliseconds,
+ * so that each pause overruns them. Use the dummy backend ("dummy:") to run
+ * this without hardware. */
+#define SAMPLERATE      10000000
+#define NUM_BUFFERS     16
+#define BUFFER_SIZE     4096
+#define NUM_XFERS       8
+#define TIMEOUT_MS      3000
+
+#define ITERATIONS      20
+#define READS           4       /* Back-to-back reads following each pause */
+#define PAUSE_US        200000
+
+int main(int argc, char *argv[])
+{
+    int status;
+    unsigned int i, j;
+    struct bladerf *dev;
+    struct bladerf_metadata meta;
+    struct bladerf_stream_stats stats;
+    int16_t *samples;
+    uint64_t next_ts = 0;
+    uint64_t overruns = 0;
+    unsigned int discontinuities = 0;
+    bool have_ts = false;
+
+    samples = malloc(2 * sizeof(int16_t) * BUFFER_SIZE);
+    if (samples == NULL) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+
+    status = bladerf_open(&dev, argc > 1 ? argv[1] : NULL);
+    if (status != 0) {
+        fprintf(stderr, "Failed to open device: %s\n",
+                bladerf_strerror(status));
+        free(samples);
+        return EXIT_FAILURE;
+    }
+
+    status = bladerf_set_sample_rate(dev, BLADERF_MODULE_RX, SAMPLERATE,
+                                     NULL);
+    if (status != 0) {
+        fprintf(stderr, "Failed to set sample rate: %s\n",
+                bladerf_strerror(status));
+        goto out;
+    }
+
+    status = bladerf_sync_config(dev, BLADERF_MODULE_RX,
+                                 BLADERF_FORMAT_SC16_Q11_META,
+                                 NUM_BUFFERS, BUFFER_SIZE, NUM_XFERS,
+                                 TIMEOUT_MS);
+    if (status != 0) {
+        fprintf(stderr, "Failed to configure RX: %s\n",
+                bladerf_strerror(status));
+        goto out;
+    }
+
+    status = bladerf_enable_module(dev, BLADERF_MODULE_RX, true);
+    if (status != 0) {
+        fprintf(stderr, "Failed to enable RX: %s\n",
+                bladerf_strerror(status));
+        goto out;
+    }
+
+    /* Each pause overruns the buffers, after which the worker must recover
+     * and hand out contiguous samples again. Samples that are handed out
+     * from the wrong buffer show up as a timestamp that goes backwards, or
+     * as a gap that isn't reported, or whose size is misreported. */
+    for (i = 0; i < ITERATIONS && status == 0; i++) {
+        for (j = 0; j < READS; j++) {
+            memset(&meta, 0, sizeof(meta));
+            meta.flags = BLADERF_META_FLAG_RX_NOW;
+
+            status = bladerf_sync_rx(dev, samples, BUFFER_SIZE, &meta,
+                                     TIMEOUT_MS);
+            if (status != 0) {
+                fprintf(stderr, "RX failed @ iteration %u: %s\n",
+                        i, bladerf_strerror(status));
+                break;
+            }
+
+            overruns += meta.overruns;
+
+            if (meta.status & BLADERF_META_STATUS_OVERRUN) {
+                discontinuities++;
+            }
+
+            if (meta.actual_count == 0) {
+                /* A gap ahead of the first sample. The timestamp is that of
+                 * the first sample following it. */
+                if (!(meta.status & BLADERF_META_STATUS_OVERRUN)) {
+                    fprintf(stderr, "No samples @ iteration %u\n", i);
+                    status = BLADERF_ERR_UNEXPECTED;
+                    break;
+                }
+
+                next_ts = meta.timestamp;
+                have_ts = true;
+                continue;
+            }
+
+            if (have_ts && meta.timestamp != next_ts) {
+                fprintf(stderr, "%s @ iteration %u: expected %" PRIu64
+                        ", got %" PRIu64 "\n",
+                        meta.timestamp < next_ts ?
+                            "Timestamp went backwards" :
+                            "Unreported discontinuity",
+                        i, next_ts, meta.timestamp);
+                status = BLADERF_ERR_UNEXPECTED;
+                break;
+            }
+
+            /* A reported gap follows the samples that were returned */
+            next_ts = meta.timestamp + meta.actual_count;
+            if (meta.status & BLADERF_META_STATUS_OVERRUN) {
+                next_ts += meta.dropped_samples;
+            }
+
+            have_ts = true;
+        }
+
+        usleep(PAUSE_US);
+    }
+
+    if (status == 0) {
+        status = bladerf_get_stream_stats(dev, BLADERF_MODULE_RX, &stats);
+        if (status != 0) {
+            fprintf(stderr, "Failed to get stream stats: %s\n",
+                    bladerf_strerror(status));
+        }
+    }
+
+    if (status == 0) {
+        printf("Overruns: %" PRIu64 " reported, %" PRIu64 " counted, "
+               "%u discontinuities\n", overruns, stats.overruns,
+               discontinuities);
+
+        if (stats.overruns == 0 || overruns == 0 || discontinuities == 0) {
+            fprintf(stderr, "No overruns were detected.\n");
+            status = BLADERF_ERR_UNEXPECTED;
+        }
+    }
+
+out:
+    bladerf_close(dev);
+    free(samples);
+
+    if (status == 0) {
+        printf("Passed.\n");
+        return EXIT_SUCCESS;
+    } else {
+        return EXIT_FAILURE;
+    }
+}
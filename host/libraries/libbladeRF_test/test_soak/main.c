@@ -0,0 +1,840 @@
+/*
+ * This program streams RX and TX for an extended period, while periodically
+ * retuning and changing gains, and records resource usage, stream errors and
+ * control latencies as CSV at a fixed interval. Plotting the columns over a
+ * multi-hour run reveals leaks and latency creep in the streaming and control
+ * paths that short tests do not.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <libbladeRF.h>
+#include "host_config.h"
+
+#if BLADERF_OS_WINDOWS || BLADERF_OS_OSX
+#include "clock_gettime.h"
+#else
+#include <time.h>
+#endif
+
+#include "conversions.h"
+#include "test_common.h"
+
+#define TEST_OPTIONS_STR    TEST_OPTIONS_BASE"D:I:C:o:S:"
+
+#ifdef CLOCK_MONOTONIC
+#   define SOAK_CLOCK CLOCK_MONOTONIC
+#else
+#   define SOAK_CLOCK CLOCK_REALTIME
+#endif
+
+#define DEFAULT_DURATION_S      (8 * 60 * 60)
+#define DEFAULT_INTERVAL_S      60
+#define DEFAULT_CTRL_PERIOD_MS  250
+#define BLOCK_SIZE              4096
+
+struct app_params {
+    struct device_config dev_config;
+    unsigned int duration_s;
+    unsigned int interval_s;
+    unsigned int ctrl_period_ms;
+    char *output;
+    uint64_t randval_seed;
+    uint64_t randval_state;
+};
+
+static struct option app_long_options[] = {
+    { "duration",       required_argument,  0,      'D' },
+    { "interval",       required_argument,  0,      'I' },
+    { "ctrl-period",    required_argument,  0,      'C' },
+    { "output",         required_argument,  0,      'o' },
+    { "seed",           required_argument,  0,      'S' },
+    { NULL,             0,                  0,      0 },
+};
+
+/* A streaming thread. The fields following `lock` are protected by it. */
+struct stream_task {
+    struct bladerf *dev;
+    bladerf_module module;
+    unsigned int timeout_ms;
+    pthread_t thread;
+
+    pthread_mutex_t lock;
+    uint64_t samples;
+    uint64_t last_timestamp;    /* RX only */
+    double cpu_s;               /* Thread CPU time, < 0 if unavailable */
+    int status;
+    bool done;
+};
+
+/* A periodic control-path operation. `i` is the # of times it has run. */
+struct ctrl_op {
+    const char *name;
+    int (*run)(struct bladerf *dev, struct app_params *p, unsigned int i);
+};
+
+/* Latencies of a control operation within the current interval, in us */
+struct ctrl_latencies {
+    double *values;
+    size_t count;
+    size_t len;
+    unsigned int runs;
+};
+
+/* Cumulative values, from which each interval's row is computed */
+struct snapshot {
+    struct timespec time;
+    double process_cpu_s;
+    double rx_cpu_s;
+    double tx_cpu_s;
+    uint64_t rx_samples;
+    uint64_t tx_samples;
+    struct bladerf_stream_stats rx;
+    struct bladerf_stream_stats tx;
+};
+
+static volatile bool soak_quit;
+
+#if BLADERF_OS_WINDOWS
+static void ctrlc_handler(int signal)
+{
+    soak_quit = true;
+}
+
+static void init_signal_handling()
+{
+    void *sigint_prev, *sigterm_prev;
+
+    sigint_prev = signal(SIGINT, ctrlc_handler);
+    sigterm_prev = signal(SIGTERM, ctrlc_handler);
+
+    if (sigint_prev == SIG_ERR || sigterm_prev == SIG_ERR) {
+        fprintf(stderr, "Warning: Failed to initialize Ctrl-C handlers.");
+    }
+}
+
+#else
+static void ctrlc_handler(int signal, siginfo_t *info, void *unused) {
+    soak_quit = true;
+}
+
+static void init_signal_handling()
+{
+    struct sigaction sigact;
+
+    sigemptyset(&sigact.sa_mask);
+    sigact.sa_sigaction = ctrlc_handler;
+    sigact.sa_flags = SA_SIGINFO;
+
+    sigaction(SIGINT, &sigact, NULL);
+    sigaction(SIGTERM, &sigact, NULL);
+}
+#endif
+
+static inline double elapsed_s(const struct timespec *start,
+                               const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) +
+           (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static inline bool time_reached(const struct timespec *now,
+                                const struct timespec *t)
+{
+    return now->tv_sec > t->tv_sec ||
+           (now->tv_sec == t->tv_sec && now->tv_nsec >= t->tv_nsec);
+}
+
+static void time_add_ms(struct timespec *t, unsigned int ms)
+{
+    t->tv_sec += ms / 1000;
+    t->tv_nsec += (long) (ms % 1000) * 1000000;
+
+    if (t->tv_nsec >= 1000000000) {
+        t->tv_sec++;
+        t->tv_nsec -= 1000000000;
+    }
+}
+
+/* Returns CPU time consumed by the specified clock, or -1 if unavailable */
+static double cpu_time_s(clockid_t clock)
+{
+    struct timespec t;
+
+    if (clock_gettime(clock, &t) != 0) {
+        return -1.0;
+    }
+
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static double thread_cpu_time_s(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    return cpu_time_s(CLOCK_THREAD_CPUTIME_ID);
+#else
+    return -1.0;
+#endif
+}
+
+static double process_cpu_time_s(void)
+{
+#ifdef CLOCK_PROCESS_CPUTIME_ID
+    return cpu_time_s(CLOCK_PROCESS_CPUTIME_ID);
+#else
+    return -1.0;
+#endif
+}
+
+/* Resident set size of this process in KiB, or -1 if unavailable */
+static long rss_kib(void)
+{
+#if BLADERF_OS_LINUX
+    long pages = -1;
+    FILE *f = fopen("/proc/self/statm", "r");
+
+    if (f != NULL) {
+        if (fscanf(f, "%*s %ld", &pages) != 1) {
+            pages = -1;
+        }
+        fclose(f);
+    }
+
+    return pages < 0 ? -1 : pages * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+    return -1;
+#endif
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted samples */
+static inline double percentile(const double *sorted, size_t n, double p)
+{
+    size_t idx = (size_t) (p / 100.0 * n + 0.5);
+
+    if (idx > 0) {
+        idx--;
+    }
+
+    return sorted[idx < n ? idx : n - 1];
+}
+
+static inline const char * module_str(bladerf_module m)
+{
+    return m == BLADERF_MODULE_RX ? "RX" : "TX";
+}
+
+static unsigned int random_frequency(struct app_params *p)
+{
+    uint64_t tmp = randval_update(&p->randval_state);
+
+    return BLADERF_FREQUENCY_MIN +
+           (unsigned int) (tmp % (BLADERF_FREQUENCY_MAX -
+                                  BLADERF_FREQUENCY_MIN));
+}
+
+static int ctrl_rx_freq(struct bladerf *dev, struct app_params *p,
+                        unsigned int i)
+{
+    return bladerf_set_frequency(dev, BLADERF_MODULE_RX, random_frequency(p));
+}
+
+static int ctrl_tx_freq(struct bladerf *dev, struct app_params *p,
+                        unsigned int i)
+{
+    return bladerf_set_frequency(dev, BLADERF_MODULE_TX, random_frequency(p));
+}
+
+static int ctrl_rx_gain(struct bladerf *dev, struct app_params *p,
+                        unsigned int i)
+{
+    /* Sweep across the full RX gain range */
+    return bladerf_set_gain(dev, BLADERF_MODULE_RX, (int) (i % 60));
+}
+
+static int ctrl_tx_gain(struct bladerf *dev, struct app_params *p,
+                        unsigned int i)
+{
+    const int range = BLADERF_TXVGA2_GAIN_MAX - BLADERF_TXVGA2_GAIN_MIN + 1;
+    return bladerf_set_txvga2(dev, BLADERF_TXVGA2_GAIN_MIN + (int) (i % range));
+}
+
+static int ctrl_timestamp(struct bladerf *dev, struct app_params *p,
+                          unsigned int i)
+{
+    uint64_t ts;
+    return bladerf_get_timestamp(dev, BLADERF_MODULE_RX, &ts);
+}
+
+static const struct ctrl_op ctrl_ops[] = {
+    { "rx_freq",    ctrl_rx_freq },
+    { "tx_freq",    ctrl_tx_freq },
+    { "rx_gain",    ctrl_rx_gain },
+    { "tx_gain",    ctrl_tx_gain },
+    { "timestamp",  ctrl_timestamp },
+};
+
+static int ctrl_record(struct ctrl_latencies *l, double us)
+{
+    if (l->count == l->len) {
+        const size_t len = l->len ? 2 * l->len : 64;
+        double *values = realloc(l->values, len * sizeof(values[0]));
+
+        if (values == NULL) {
+            perror("realloc");
+            return -1;
+        }
+
+        l->values = values;
+        l->len = len;
+    }
+
+    l->values[l->count++] = us;
+    return 0;
+}
+
+static void *stream_task_run(void *arg)
+{
+    int status = 0;
+    struct stream_task *t = (struct stream_task *) arg;
+    const bool rx = t->module == BLADERF_MODULE_RX;
+    struct bladerf_metadata meta;
+    bool first = true;
+    int16_t *samples;
+
+    samples = calloc(BLOCK_SIZE, 2 * sizeof(samples[0]));
+    if (samples == NULL) {
+        perror("calloc");
+        status = BLADERF_ERR_MEM;
+        goto out;
+    }
+
+    while (!soak_quit) {
+        memset(&meta, 0, sizeof(meta));
+
+        if (rx) {
+            meta.flags = BLADERF_META_FLAG_RX_NOW;
+            status = bladerf_sync_rx(t->dev, samples, BLOCK_SIZE, &meta,
+                                     t->timeout_ms);
+        } else {
+            if (first) {
+                meta.flags = BLADERF_META_FLAG_TX_BURST_START |
+                             BLADERF_META_FLAG_TX_NOW;
+            }
+
+            status = bladerf_sync_tx(t->dev, samples, BLOCK_SIZE, &meta,
+                                     t->timeout_ms);
+        }
+
+        if (status != 0) {
+            fprintf(stderr, "%s sync call failed: %s\n",
+                    module_str(t->module), bladerf_strerror(status));
+            break;
+        }
+
+        first = false;
+
+        pthread_mutex_lock(&t->lock);
+        if (rx) {
+            t->samples += meta.actual_count;
+            t->last_timestamp = meta.timestamp;
+        } else {
+            t->samples += BLOCK_SIZE;
+        }
+        t->cpu_s = thread_cpu_time_s();
+        pthread_mutex_unlock(&t->lock);
+    }
+
+    /* Close out the burst so the TX stream shuts down cleanly */
+    if (!rx && !first && status == 0) {
+        memset(samples, 0, BLOCK_SIZE * 2 * sizeof(samples[0]));
+        memset(&meta, 0, sizeof(meta));
+        meta.flags = BLADERF_META_FLAG_TX_BURST_END;
+
+        status = bladerf_sync_tx(t->dev, samples, BLOCK_SIZE, &meta,
+                                 t->timeout_ms);
+        if (status != 0) {
+            fprintf(stderr, "Failed to end TX burst: %s\n",
+                    bladerf_strerror(status));
+        }
+    }
+
+out:
+    free(samples);
+
+    pthread_mutex_lock(&t->lock);
+    t->status = status;
+    t->done = true;
+    pthread_mutex_unlock(&t->lock);
+
+    return NULL;
+}
+
+static int take_snapshot(struct bladerf *dev, struct stream_task *tasks,
+                         struct snapshot *s)
+{
+    int status;
+
+    clock_gettime(SOAK_CLOCK, &s->time);
+    s->process_cpu_s = process_cpu_time_s();
+
+    pthread_mutex_lock(&tasks[0].lock);
+    s->rx_cpu_s = tasks[0].cpu_s;
+    s->rx_samples = tasks[0].samples;
+    pthread_mutex_unlock(&tasks[0].lock);
+
+    pthread_mutex_lock(&tasks[1].lock);
+    s->tx_cpu_s = tasks[1].cpu_s;
+    s->tx_samples = tasks[1].samples;
+    pthread_mutex_unlock(&tasks[1].lock);
+
+    status = bladerf_get_stream_stats(dev, BLADERF_MODULE_RX, &s->rx);
+    if (status == 0) {
+        status = bladerf_get_stream_stats(dev, BLADERF_MODULE_TX, &s->tx);
+    }
+
+    if (status != 0) {
+        fprintf(stderr, "Failed to read stream stats: %s\n",
+                bladerf_strerror(status));
+    }
+
+    return status;
+}
+
+/* CPU usage over an interval as a percentage, or -1 if unavailable */
+static inline double cpu_pct(double start, double end, double elapsed)
+{
+    return (start < 0 || end < 0 || elapsed <= 0) ? -1.0 :
+           100.0 * (end - start) / elapsed;
+}
+
+static void print_csv_header(FILE *out)
+{
+    size_t i;
+
+    fprintf(out, "elapsed_s,rss_kib,process_cpu_pct,rx_thread_cpu_pct,"
+                 "tx_thread_cpu_pct,event_cpu_pct,rx_msps,tx_msps,"
+                 "rx_overruns,rx_discontinuities,rx_dropped_samples,"
+                 "rx_fpga_overflows,rx_timestamp,tx_underruns,"
+                 "tx_fpga_underruns,ctrl_errors");
+
+    for (i = 0; i < ARRAY_SIZE(ctrl_ops); i++) {
+        fprintf(out, ",%s_p50_us,%s_p99_us,%s_max_us", ctrl_ops[i].name,
+                ctrl_ops[i].name, ctrl_ops[i].name);
+    }
+
+    fprintf(out, "\n");
+}
+
+static void print_csv_row(FILE *out, const struct timespec *start,
+                          const struct snapshot *prev,
+                          const struct snapshot *curr,
+                          uint64_t rx_timestamp, unsigned int ctrl_errors,
+                          struct ctrl_latencies *lat)
+{
+    size_t i;
+    const double dt = elapsed_s(&prev->time, &curr->time);
+
+    fprintf(out, "%.1f,%ld,%.2f,%.2f,%.2f,%.2f,%.3f,%.3f,"
+                 "%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64",%"PRIu64","
+                 "%"PRIu64",%"PRIu64",%u",
+            elapsed_s(start, &curr->time), rss_kib(),
+            cpu_pct(prev->process_cpu_s, curr->process_cpu_s, dt),
+            cpu_pct(prev->rx_cpu_s, curr->rx_cpu_s, dt),
+            cpu_pct(prev->tx_cpu_s, curr->tx_cpu_s, dt),
+            cpu_pct(prev->rx.event_cpu_us / 1e6,
+                    curr->rx.event_cpu_us / 1e6, dt),
+            dt > 0 ? (curr->rx_samples - prev->rx_samples) / dt / 1e6 : 0,
+            dt > 0 ? (curr->tx_samples - prev->tx_samples) / dt / 1e6 : 0,
+            curr->rx.overruns - prev->rx.overruns,
+            curr->rx.discontinuities - prev->rx.discontinuities,
+            curr->rx.dropped_samples - prev->rx.dropped_samples,
+            curr->rx.fpga_overflows - prev->rx.fpga_overflows,
+            rx_timestamp,
+            curr->tx.underruns - prev->tx.underruns,
+            curr->tx.fpga_underruns - prev->tx.fpga_underruns,
+            ctrl_errors);
+
+    for (i = 0; i < ARRAY_SIZE(ctrl_ops); i++) {
+        if (lat[i].count == 0) {
+            fprintf(out, ",,,");
+            continue;
+        }
+
+        qsort(lat[i].values, lat[i].count, sizeof(lat[i].values[0]),
+              compare_double);
+
+        fprintf(out, ",%.1f,%.1f,%.1f",
+                percentile(lat[i].values, lat[i].count, 50.0),
+                percentile(lat[i].values, lat[i].count, 99.0),
+                lat[i].values[lat[i].count - 1]);
+
+        lat[i].count = 0;
+    }
+
+    fprintf(out, "\n");
+    fflush(out);
+}
+
+static int start_streams(struct bladerf *dev, struct app_params *p,
+                         struct stream_task *tasks)
+{
+    int status;
+    size_t i;
+
+    for (i = 0; i < 2; i++) {
+        status = test_perform_sync_config(dev, tasks[i].module,
+                                          BLADERF_FORMAT_SC16_Q11_META,
+                                          &p->dev_config, false);
+        if (status != 0) {
+            return -1;
+        }
+    }
+
+    status = bladerf_sync_continuity_check(dev, true, NULL, NULL);
+    if (status != 0) {
+        fprintf(stderr, "Failed to enable RX continuity checking: %s\n",
+                bladerf_strerror(status));
+        return -1;
+    }
+
+    for (i = 0; i < 2; i++) {
+        status = bladerf_enable_module(dev, tasks[i].module, true);
+        if (status != 0) {
+            fprintf(stderr, "Failed to enable %s module: %s\n",
+                    module_str(tasks[i].module), bladerf_strerror(status));
+            return -1;
+        }
+    }
+
+    for (i = 0; i < 2; i++) {
+        status = pthread_create(&tasks[i].thread, NULL, stream_task_run,
+                                &tasks[i]);
+        if (status != 0) {
+            fprintf(stderr, "Failed to start %s thread: %s\n",
+                    module_str(tasks[i].module), strerror(status));
+            soak_quit = true;
+
+            if (i > 0) {
+                pthread_join(tasks[0].thread, NULL);
+            }
+
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int run_test(struct bladerf *dev, struct app_params *p)
+{
+    int status = 0;
+    size_t i;
+    FILE *out = stdout;
+    struct stream_task tasks[2];
+    struct ctrl_latencies lat[ARRAY_SIZE(ctrl_ops)];
+    struct snapshot prev, curr;
+    struct timespec start, end, now, next_ctrl, next_row, call_start;
+    unsigned int ctrl_errors = 0, ctrl_count = 0;
+    uint64_t rx_timestamp;
+    bool streaming = false;
+    bool quit = false;
+
+    memset(tasks, 0, sizeof(tasks));
+    memset(lat, 0, sizeof(lat));
+
+    for (i = 0; i < 2; i++) {
+        tasks[i].dev = dev;
+        tasks[i].module = i == 0 ? BLADERF_MODULE_RX : BLADERF_MODULE_TX;
+        tasks[i].timeout_ms = p->dev_config.sync_timeout_ms;
+        tasks[i].cpu_s = -1.0;
+        pthread_mutex_init(&tasks[i].lock, NULL);
+    }
+
+    if (p->output != NULL) {
+        out = fopen(p->output, "w");
+        if (out == NULL) {
+            perror(p->output);
+            status = -1;
+            goto out;
+        }
+    }
+
+    init_signal_handling();
+
+    status = start_streams(dev, p, tasks);
+    if (status != 0) {
+        goto out;
+    }
+
+    streaming = true;
+
+    status = take_snapshot(dev, tasks, &prev);
+    if (status != 0) {
+        status = -1;
+        goto out;
+    }
+
+    print_csv_header(out);
+
+    start = end = next_ctrl = next_row = prev.time;
+    time_add_ms(&next_row, p->interval_s * 1000);
+    time_add_ms(&end, p->duration_s * 1000);
+
+    while (!quit) {
+        clock_gettime(SOAK_CLOCK, &now);
+        quit = soak_quit || time_reached(&now, &end);
+
+        for (i = 0; i < 2; i++) {
+            pthread_mutex_lock(&tasks[i].lock);
+            quit = quit || tasks[i].done;
+            pthread_mutex_unlock(&tasks[i].lock);
+        }
+
+        if (!quit && time_reached(&now, &next_ctrl)) {
+            const size_t n = ctrl_count % ARRAY_SIZE(ctrl_ops);
+            const struct ctrl_op *op = &ctrl_ops[n];
+            struct ctrl_latencies *l = &lat[n];
+
+            clock_gettime(SOAK_CLOCK, &call_start);
+            status = op->run(dev, p, l->runs++);
+            clock_gettime(SOAK_CLOCK, &now);
+
+            if (status != 0) {
+                fprintf(stderr, "%s failed: %s\n",
+                        op->name, bladerf_strerror(status));
+                ctrl_errors++;
+            } else if (ctrl_record(l, elapsed_s(&call_start, &now) * 1e6)) {
+                status = -1;
+                break;
+            }
+
+            ctrl_count++;
+            time_add_ms(&next_ctrl, p->ctrl_period_ms);
+        }
+
+        if (quit || time_reached(&now, &next_row)) {
+            status = take_snapshot(dev, tasks, &curr);
+            if (status != 0) {
+                status = -1;
+                break;
+            }
+
+            pthread_mutex_lock(&tasks[0].lock);
+            rx_timestamp = tasks[0].last_timestamp;
+            pthread_mutex_unlock(&tasks[0].lock);
+
+            print_csv_row(out, &start, &prev, &curr, rx_timestamp,
+                          ctrl_errors, lat);
+
+            ctrl_errors = 0;
+            prev = curr;
+            time_add_ms(&next_row, p->interval_s * 1000);
+        }
+
+        if (!quit) {
+            usleep(1000);
+        }
+    }
+
+out:
+    if (streaming) {
+        soak_quit = true;
+
+        for (i = 0; i < 2; i++) {
+            pthread_join(tasks[i].thread, NULL);
+            if (status == 0 && tasks[i].status != 0) {
+                status = -1;
+            }
+
+            bladerf_enable_module(dev, tasks[i].module, false);
+        }
+    }
+
+    for (i = 0; i < 2; i++) {
+        pthread_mutex_destroy(&tasks[i].lock);
+    }
+
+    for (i = 0; i < ARRAY_SIZE(ctrl_ops); i++) {
+        free(lat[i].values);
+    }
+
+    if (out != stdout && out != NULL) {
+        fclose(out);
+    }
+
+    return status;
+}
+
+int app_handle_args(int argc, char **argv,
+                    struct option *long_options, struct app_params *p)
+{
+    int c;
+    bool ok;
+
+    optind = 1;
+    c = getopt_long(argc, argv, TEST_OPTIONS_STR, long_options, NULL);
+    while (c >= 0) {
+
+        switch (c) {
+            case 'D':
+                p->duration_s = str2uint(optarg, 1, UINT_MAX / 1000, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Invalid duration: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'I':
+                p->interval_s = str2uint(optarg, 1, UINT_MAX / 1000, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Invalid interval: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'C':
+                p->ctrl_period_ms = str2uint(optarg, 1, UINT_MAX, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Invalid control period: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'o':
+                p->output = optarg;
+                break;
+
+            case 'S':
+                p->randval_seed = str2uint64(optarg, 0, UINT64_MAX, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Invalid seed value: %s\n", optarg);
+                    return -1;
+                }
+                break;
+        }
+
+        c = getopt_long(argc, argv, TEST_OPTIONS_STR, long_options, NULL);
+    }
+
+    return 0;
+}
+
+void print_usage(const char *argv0)
+{
+    printf("%s: Long-duration RX/TX soak test\n", argv0);
+    printf("\n");
+    printf("RX and TX are streamed while the control path is exercised,\n");
+    printf("and one CSV row of resource usage, stream errors and control\n");
+    printf("latencies is written per interval. Press Ctrl-C to end early.\n");
+    printf("\n");
+    printf("Test-specific options:\n");
+    printf("  -D, --duration <s>        Test duration, in seconds.\n");
+    printf("                             Default: %u\n", DEFAULT_DURATION_S);
+    printf("  -I, --interval <s>        Interval between CSV rows, in seconds.\n");
+    printf("                             Default: %u\n", DEFAULT_INTERVAL_S);
+    printf("  -C, --ctrl-period <ms>    Period of retune and gain changes,\n");
+    printf("                             in ms. Default: %u\n",
+           DEFAULT_CTRL_PERIOD_MS);
+    printf("  -o, --output <file>       Write CSV to <file>, rather than\n");
+    printf("                             stdout.\n");
+    printf("  -S, --seed <value>        PRNG seed for random frequencies.\n");
+    printf("\n");
+    test_print_common_help();
+    printf("\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int status;
+    struct bladerf *dev = NULL;
+    struct app_params params;
+    struct option *options = NULL;
+
+    test_init_device_config(&params.dev_config);
+    params.duration_s = DEFAULT_DURATION_S;
+    params.interval_s = DEFAULT_INTERVAL_S;
+    params.ctrl_period_ms = DEFAULT_CTRL_PERIOD_MS;
+    params.output = NULL;
+    params.randval_seed = 1;
+
+    options = test_get_long_options(app_long_options);
+    if (options == NULL) {
+        status = -1;
+        goto error_no_dev;
+    }
+
+    status = test_handle_args(argc, argv,
+                              TEST_OPTIONS_STR, options,
+                              &params.dev_config);
+    if (status < 0) {
+        status = -1;
+        goto error_no_dev;
+    } else if (status > 0) {
+        print_usage(argv[0]);
+        status = 0;
+        goto error_no_dev;
+    }
+
+    status = app_handle_args(argc, argv, options, &params);
+    if (status != 0) {
+        status = -1;
+        goto error_no_dev;
+    }
+
+    randval_init(&params.randval_state, params.randval_seed);
+
+    status = bladerf_open(&dev, params.dev_config.device_specifier);
+    if (status != 0) {
+        fprintf(stderr, "Unable to open device: %s\n",
+                bladerf_strerror(status));
+        status = -1;
+        goto error_no_dev;
+    }
+
+    status = test_apply_device_config(dev, &params.dev_config);
+    if (status == 0) {
+        status = run_test(dev, &params);
+    }
+
+    bladerf_close(dev);
+
+error_no_dev:
+    test_deinit_device_config(&params.dev_config);
+    free(options);
+    return status;
+}
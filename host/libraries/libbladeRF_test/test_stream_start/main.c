@@ -0,0 +1,326 @@
+/*
+ * This program measures the time from enabling the RX module to the
+ * return of the first bladerf_sync_rx() call, both when the synchronous
+ * stream is started by that call, and when it has been armed in advance via
+ * bladerf_sync_arm().
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <getopt.h>
+#include <libbladeRF.h>
+#include "host_config.h"
+
+#if BLADERF_OS_WINDOWS || BLADERF_OS_OSX
+#include "clock_gettime.h"
+#else
+#include <time.h>
+#endif
+
+#include "conversions.h"
+#include "test_common.h"
+
+#define TEST_OPTIONS_STR    TEST_OPTIONS_BASE"i:n:"
+
+#ifdef CLOCK_MONOTONIC
+#   define BENCH_CLOCK CLOCK_MONOTONIC
+#else
+#   define BENCH_CLOCK CLOCK_REALTIME
+#endif
+
+struct app_params {
+    struct device_config dev_config;
+    unsigned int iterations;
+    unsigned int num_samples;
+};
+
+static struct option app_long_options[] = {
+    { "iterations", required_argument,  0,      'i' },
+    { "samples",    required_argument,  0,      'n' },
+    { NULL,         0,                  0,      0 },
+};
+
+struct results {
+    double *ttfs_us;    /* Enable -> first samples returned */
+    double *prep_us;    /* Work done before the enable */
+};
+
+int app_handle_args(int argc, char **argv,
+                    struct option *long_options, struct app_params *p)
+{
+    int c;
+    bool ok;
+
+    optind = 1;
+    c = getopt_long(argc, argv, TEST_OPTIONS_STR, long_options, NULL);
+    while (c >= 0) {
+
+        switch (c) {
+            case 'i':
+                p->iterations = str2uint(optarg, 1, UINT_MAX, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Invalid # iterations: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'n':
+                p->num_samples = str2uint(optarg, 1, UINT_MAX / 4, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Invalid # samples: %s\n", optarg);
+                    return -1;
+                }
+                break;
+        }
+
+        c = getopt_long(argc, argv, TEST_OPTIONS_STR, long_options, NULL);
+    }
+
+    return 0;
+}
+
+void print_usage(const char *argv0)
+{
+    printf("%s: Measure the RX time-to-first-sample\n", argv0);
+    printf("\n");
+    printf("Each iteration configures the RX synchronous interface, enables\n");
+    printf("the RX module, and reads samples. The time from the enable to\n");
+    printf("the return of the first read is reported with a cold start, in\n");
+    printf("which the read starts the stream, and with the stream armed via\n");
+    printf("bladerf_sync_arm() before the enable.\n");
+    printf("\n");
+    printf("Test-specific options:\n");
+    printf("  -i, --iterations <value>  Number of iterations per mode (100).\n");
+    printf("  -n, --samples <value>     Samples in the first read (1).\n");
+    printf("\n");
+    test_print_common_help();
+    printf("\n");
+}
+
+static inline double elapsed_us(const struct timespec *start,
+                                const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e6 +
+           (end->tv_nsec - start->tv_nsec) / 1e3;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted samples */
+static inline double percentile(const double *sorted, unsigned int n, double p)
+{
+    unsigned int idx = (unsigned int) (p / 100.0 * n + 0.5);
+
+    if (idx > 0) {
+        idx--;
+    }
+
+    return sorted[idx < n ? idx : n - 1];
+}
+
+static void print_stats(const char *name, double *samples, unsigned int n)
+{
+    unsigned int i;
+    double sum = 0;
+
+    for (i = 0; i < n; i++) {
+        sum += samples[i];
+    }
+
+    qsort(samples, n, sizeof(samples[0]), compare_double);
+
+    printf("%-12s %10.1f %10.1f %10.1f %10.1f %10.1f\n", name,
+           samples[0], sum / n, percentile(samples, n, 50.0),
+           percentile(samples, n, 99.0), samples[n - 1]);
+}
+
+static int run_once(struct bladerf *dev, struct app_params *p,
+                    int16_t *samples, bool armed, double *prep_us,
+                    double *ttfs_us)
+{
+    int status;
+    struct timespec t0, t1, t2;
+
+    status = test_perform_sync_config(dev, BLADERF_MODULE_RX,
+                                      BLADERF_FORMAT_SC16_Q11,
+                                      &p->dev_config, false);
+    if (status != 0) {
+        return -1;
+    }
+
+    clock_gettime(BENCH_CLOCK, &t0);
+
+    if (armed) {
+        status = bladerf_sync_arm(dev, BLADERF_MODULE_RX);
+        if (status != 0) {
+            fprintf(stderr, "Failed to arm RX stream: %s\n",
+                    bladerf_strerror(status));
+            return -1;
+        }
+    }
+
+    clock_gettime(BENCH_CLOCK, &t1);
+
+    status = bladerf_enable_module(dev, BLADERF_MODULE_RX, true);
+    if (status != 0) {
+        fprintf(stderr, "Failed to enable RX module: %s\n",
+                bladerf_strerror(status));
+        return -1;
+    }
+
+    status = bladerf_sync_rx(dev, samples, p->num_samples, NULL,
+                             p->dev_config.sync_timeout_ms);
+
+    clock_gettime(BENCH_CLOCK, &t2);
+
+    bladerf_enable_module(dev, BLADERF_MODULE_RX, false);
+
+    if (status != 0) {
+        fprintf(stderr, "First RX failed: %s\n", bladerf_strerror(status));
+        return -1;
+    }
+
+    *prep_us = elapsed_us(&t0, &t1);
+    *ttfs_us = elapsed_us(&t1, &t2);
+    return 0;
+}
+
+int run_test(struct bladerf *dev, struct app_params *p)
+{
+    int status = 0;
+    unsigned int i;
+    int16_t *samples;
+    struct results cold, armed;
+
+    samples = malloc(2 * sizeof(int16_t) * p->num_samples);
+    cold.ttfs_us = calloc(p->iterations, sizeof(double));
+    cold.prep_us = calloc(p->iterations, sizeof(double));
+    armed.ttfs_us = calloc(p->iterations, sizeof(double));
+    armed.prep_us = calloc(p->iterations, sizeof(double));
+
+    if (!samples || !cold.ttfs_us || !cold.prep_us ||
+        !armed.ttfs_us || !armed.prep_us) {
+        perror("malloc");
+        status = -1;
+        goto out;
+    }
+
+    /* Alternate between the two, so that both see the same conditions */
+    for (i = 0; i < p->iterations && status == 0; i++) {
+        status = run_once(dev, p, samples, false,
+                          &cold.prep_us[i], &cold.ttfs_us[i]);
+
+        if (status == 0) {
+            status = run_once(dev, p, samples, true,
+                              &armed.prep_us[i], &armed.ttfs_us[i]);
+        }
+    }
+
+    if (status != 0) {
+        fprintf(stderr, "Failed @ iteration %u\n", i);
+        goto out;
+    }
+
+    printf("Time from enable to first %u sample(s), over %u iterations:\n\n",
+           p->num_samples, p->iterations);
+
+    printf("%-12s %10s %10s %10s %10s %10s\n",
+           "us", "min", "mean", "p50", "p99", "max");
+
+    print_stats("cold", cold.ttfs_us, p->iterations);
+    print_stats("armed", armed.ttfs_us, p->iterations);
+    print_stats("arm call", armed.prep_us, p->iterations);
+
+out:
+    free(samples);
+    free(cold.ttfs_us);
+    free(cold.prep_us);
+    free(armed.ttfs_us);
+    free(armed.prep_us);
+    return status;
+}
+
+int main(int argc, char *argv[])
+{
+    int status;
+    struct bladerf *dev = NULL;
+    struct app_params params;
+    struct option *options = NULL;
+
+    test_init_device_config(&params.dev_config);
+    params.iterations = 100;
+    params.num_samples = 1;
+
+    options = test_get_long_options(app_long_options);
+    if (options == NULL) {
+        status = -1;
+        goto error_no_dev;
+    }
+
+    status = test_handle_args(argc, argv,
+                              TEST_OPTIONS_STR, options,
+                              &params.dev_config);
+    if (status < 0) {
+        status = -1;
+        goto error_no_dev;
+    } else if (status > 0) {
+        print_usage(argv[0]);
+        status = 0;
+        goto error_no_dev;
+    }
+
+    status = app_handle_args(argc, argv, options, &params);
+    if (status != 0) {
+        status = -1;
+        goto error_no_dev;
+    }
+
+    status = bladerf_open(&dev, params.dev_config.device_specifier);
+    if (status != 0) {
+        fprintf(stderr, "Unable to open device: %s\n",
+                bladerf_strerror(status));
+        status = -1;
+        goto error_no_dev;
+    }
+
+    status = test_apply_device_config(dev, &params.dev_config);
+    if (status == 0) {
+        status = run_test(dev, &params);
+    }
+
+    bladerf_close(dev);
+
+error_no_dev:
+    test_deinit_device_config(&params.dev_config);
+    free(options);
+    return status;
+}
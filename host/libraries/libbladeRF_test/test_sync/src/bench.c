@@ -0,0 +1,848 @@
+/*
+ * Sync interface throughput benchmark
+ *
+ * Each combination of the swept stream parameters and sample formats is
+ * configured in turn, and samples are streamed for a warm-up period followed
+ * by a measurement window. The achieved sample rate, CPU usage, sync call
+ * latency, and overruns/underruns within the window are reported as JSON or
+ * CSV, such that runs may be compared across hosts, backends, and releases.
+ *
+ * When RX reads several blocks per iteration, each configuration is also run
+ * once with a bladerf_sync_rx() call per block and once with a single
+ * bladerf_sync_rx_multi() call, to compare their per-call overhead.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2014 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <libbladeRF.h>
+#include "host_config.h"
+
+#if BLADERF_OS_WINDOWS || BLADERF_OS_OSX
+#include "clock_gettime.h"
+#else
+#include <time.h>
+#endif
+
+#include "rel_assert.h"
+#include "test.h"
+#include "log.h"
+
+#ifdef CLOCK_MONOTONIC
+#   define BENCH_CLOCK CLOCK_MONOTONIC
+#else
+#   define BENCH_CLOCK CLOCK_REALTIME
+#endif
+
+/* Extra latency slots allocated beyond the # of sync calls expected from the
+ * sample rate, as calls return early when samples are already buffered */
+#define BENCH_LATENCY_MARGIN    4096
+
+/* Results for one module in one configuration */
+struct bench_result {
+    int status;                 /* First failure, or 0 */
+
+    uint64_t samples;
+    double elapsed_s;
+    double thread_cpu_s;        /* < 0 if unavailable */
+    double process_cpu_s;       /* < 0 if unavailable. Includes the
+                                 *   library's worker threads. */
+
+    uint64_t overruns;
+    uint64_t underruns;
+    uint64_t discontinuities;   /* RX metadata: # of gaps in timestamps */
+    uint64_t dropped_samples;   /* RX metadata: # of samples in gaps */
+
+    uint64_t spin_waits;        /* Waits for a buffer satisfied by spinning */
+    uint64_t blocking_waits;    /* Waits for a buffer that blocked */
+    double event_cpu_s;         /* Backend event thread CPU time, shared
+                                 *   by RX and TX */
+
+    double *latencies;          /* Per iteration, in us */
+    size_t num_latencies;
+    size_t max_latencies;
+};
+
+struct bench_task {
+    struct bladerf *dev;
+    bladerf_module module;
+    bladerf_format format;
+    unsigned int block_size;
+    unsigned int timeout_ms;
+
+    /* RX: # of blocks read per iteration, and whether they're read via a
+     * single bladerf_sync_rx_multi() call */
+    unsigned int iov_count;
+    bool rx_multi;
+
+    /* Absolute BENCH_CLOCK times bounding the measurement window */
+    struct timespec window_start;
+    struct timespec window_end;
+
+    pthread_t thread;
+    struct bench_result result;
+};
+
+static volatile bool bench_quit;
+
+#if BLADERF_OS_WINDOWS
+static void ctrlc_handler(int signal)
+{
+    bench_quit = true;
+}
+
+static void init_signal_handling()
+{
+    void *sigint_prev, *sigterm_prev;
+
+    sigint_prev = signal(SIGINT, ctrlc_handler);
+    sigterm_prev = signal(SIGTERM, ctrlc_handler);
+
+    if (sigint_prev == SIG_ERR || sigterm_prev == SIG_ERR) {
+        fprintf(stderr, "Warning: Failed to initialize Ctrl-C handlers.");
+    }
+}
+
+#else
+static void ctrlc_handler(int signal, siginfo_t *info, void *unused) {
+    bench_quit = true;
+}
+
+static void init_signal_handling()
+{
+    struct sigaction sigact;
+
+    sigemptyset(&sigact.sa_mask);
+    sigact.sa_sigaction = ctrlc_handler;
+    sigact.sa_flags = SA_SIGINFO;
+
+    sigaction(SIGINT, &sigact, NULL);
+    sigaction(SIGTERM, &sigact, NULL);
+}
+#endif
+
+static inline double elapsed_s(const struct timespec *start,
+                               const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) +
+           (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static inline bool time_reached(const struct timespec *now,
+                                const struct timespec *t)
+{
+    return now->tv_sec > t->tv_sec ||
+           (now->tv_sec == t->tv_sec && now->tv_nsec >= t->tv_nsec);
+}
+
+static void time_add_ms(struct timespec *t, unsigned int ms)
+{
+    t->tv_sec += ms / 1000;
+    t->tv_nsec += (long) (ms % 1000) * 1000000;
+
+    if (t->tv_nsec >= 1000000000) {
+        t->tv_sec++;
+        t->tv_nsec -= 1000000000;
+    }
+}
+
+/* Returns CPU time consumed by the specified clock, or -1 if unavailable */
+static double cpu_time_s(clockid_t clock)
+{
+    struct timespec t;
+
+    if (clock_gettime(clock, &t) != 0) {
+        return -1.0;
+    }
+
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static double thread_cpu_time_s(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+    return cpu_time_s(CLOCK_THREAD_CPUTIME_ID);
+#else
+    return -1.0;
+#endif
+}
+
+static double process_cpu_time_s(void)
+{
+#ifdef CLOCK_PROCESS_CPUTIME_ID
+    return cpu_time_s(CLOCK_PROCESS_CPUTIME_ID);
+#else
+    return -1.0;
+#endif
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    const double x = *(const double *) a;
+    const double y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted samples */
+static inline double percentile(const double *sorted, size_t n, double p)
+{
+    size_t idx = (size_t) (p / 100.0 * n + 0.5);
+
+    if (idx > 0) {
+        idx--;
+    }
+
+    return sorted[idx < n ? idx : n - 1];
+}
+
+static const char * module_str(bladerf_module m)
+{
+    return m == BLADERF_MODULE_RX ? "rx" : "tx";
+}
+
+static const char * format_str(bladerf_format f)
+{
+    return f == BLADERF_FORMAT_SC16_Q11_META ? "sc16q11_meta" : "sc16q11";
+}
+
+static const char * mode_str(bench_mode m)
+{
+    switch (m) {
+        case BENCH_RX:
+            return "rx";
+        case BENCH_TX:
+            return "tx";
+        case BENCH_TRX:
+            return "trx";
+        default:
+            return "none";
+    }
+}
+
+static int stream_stats(struct bench_task *t, struct bladerf_stream_stats *s)
+{
+    int status = bladerf_get_stream_stats(t->dev, t->module, s);
+    if (status != 0) {
+        log_error("Failed to read %s stream stats: %s\n",
+                  module_str(t->module), bladerf_strerror(status));
+    }
+
+    return status;
+}
+
+static void *bench_task_run(void *arg)
+{
+    int status = 0;
+    struct bench_task *t = (struct bench_task *) arg;
+    struct bench_result *r = &t->result;
+    const bool meta = t->format == BLADERF_FORMAT_SC16_Q11_META;
+    const bool rx = t->module == BLADERF_MODULE_RX;
+    struct bladerf_metadata metadata;
+    struct bladerf_metadata *rx_meta;
+    struct bladerf_rx_iov *iov;
+    struct bladerf_stream_stats stats_start, stats_end;
+    struct timespec now, call_start, start;
+    double thread_cpu = -1.0, process_cpu = -1.0;
+    bool measuring = false;
+    bool first = true;
+    unsigned int i;
+    int16_t *samples;
+
+    samples = calloc((size_t) t->block_size * t->iov_count,
+                     2 * sizeof(samples[0]));
+    iov = calloc(t->iov_count, sizeof(iov[0]));
+    rx_meta = calloc(t->iov_count, sizeof(rx_meta[0]));
+
+    if (samples == NULL || iov == NULL || rx_meta == NULL) {
+        perror("calloc");
+        free(samples);
+        free(iov);
+        free(rx_meta);
+        r->status = BLADERF_ERR_MEM;
+        return NULL;
+    }
+
+    for (i = 0; i < t->iov_count; i++) {
+        iov[i].samples = samples + (size_t) 2 * t->block_size * i;
+        iov[i].num_samples = t->block_size;
+    }
+
+    memset(&stats_start, 0, sizeof(stats_start));
+    memset(&stats_end, 0, sizeof(stats_end));
+
+    while (!bench_quit) {
+        clock_gettime(BENCH_CLOCK, &now);
+
+        if (!measuring && time_reached(&now, &t->window_start)) {
+            status = stream_stats(t, &stats_start);
+            if (status != 0) {
+                break;
+            }
+
+            thread_cpu = thread_cpu_time_s();
+            process_cpu = process_cpu_time_s();
+            clock_gettime(BENCH_CLOCK, &start);
+            measuring = true;
+        } else if (measuring && time_reached(&now, &t->window_end)) {
+            break;
+        }
+
+        memset(&metadata, 0, sizeof(metadata));
+
+        for (i = 0; i < t->iov_count; i++) {
+            memset(&rx_meta[i], 0, sizeof(rx_meta[i]));
+            rx_meta[i].flags = BLADERF_META_FLAG_RX_NOW;
+        }
+
+        clock_gettime(BENCH_CLOCK, &call_start);
+
+        if (rx && t->rx_multi) {
+            status = bladerf_sync_rx_multi(t->dev, iov, meta ? rx_meta : NULL,
+                                           t->iov_count, t->timeout_ms);
+        } else if (rx) {
+            for (i = 0; i < t->iov_count && status == 0; i++) {
+                status = bladerf_sync_rx(t->dev, iov[i].samples,
+                                         iov[i].num_samples,
+                                         meta ? &rx_meta[i] : NULL,
+                                         t->timeout_ms);
+            }
+        } else {
+            if (first) {
+                metadata.flags = BLADERF_META_FLAG_TX_BURST_START |
+                                 BLADERF_META_FLAG_TX_NOW;
+            }
+
+            status = bladerf_sync_tx(t->dev, samples, t->block_size,
+                                     meta ? &metadata : NULL, t->timeout_ms);
+        }
+
+        clock_gettime(BENCH_CLOCK, &now);
+
+        if (status != 0) {
+            log_error("%s sync call failed: %s\n",
+                      module_str(t->module), bladerf_strerror(status));
+            break;
+        }
+
+        first = false;
+
+        if (!measuring) {
+            continue;
+        }
+
+        if (r->num_latencies < r->max_latencies) {
+            r->latencies[r->num_latencies++] =
+                elapsed_s(&call_start, &now) * 1e6;
+        }
+
+        if (rx && meta) {
+            for (i = 0; i < t->iov_count; i++) {
+                r->samples += rx_meta[i].actual_count;
+
+                if (rx_meta[i].status & BLADERF_META_STATUS_OVERRUN) {
+                    r->discontinuities++;
+                    r->dropped_samples += rx_meta[i].dropped_samples;
+                }
+            }
+        } else {
+            r->samples += (uint64_t) t->block_size * t->iov_count;
+        }
+    }
+
+    if (measuring) {
+        struct timespec end;
+        double cpu;
+
+        clock_gettime(BENCH_CLOCK, &end);
+        r->elapsed_s = elapsed_s(&start, &end);
+
+        cpu = thread_cpu_time_s();
+        r->thread_cpu_s = (thread_cpu < 0 || cpu < 0) ? -1.0 :
+                          cpu - thread_cpu;
+
+        cpu = process_cpu_time_s();
+        r->process_cpu_s = (process_cpu < 0 || cpu < 0) ? -1.0 :
+                           cpu - process_cpu;
+
+        if (status == 0) {
+            status = stream_stats(t, &stats_end);
+        }
+
+        if (status == 0) {
+            r->overruns = stats_end.overruns - stats_start.overruns;
+            r->underruns = stats_end.underruns - stats_start.underruns;
+            r->spin_waits = stats_end.spin_waits - stats_start.spin_waits;
+            r->blocking_waits = stats_end.blocking_waits -
+                                stats_start.blocking_waits;
+            r->event_cpu_s = (stats_end.event_cpu_us -
+                              stats_start.event_cpu_us) / 1e6;
+        }
+    } else if (status == 0 && !bench_quit) {
+        /* Only reached if the window ended before it started */
+        status = BLADERF_ERR_UNEXPECTED;
+    }
+
+    /* Close out the burst so the TX stream shuts down cleanly */
+    if (!rx && meta && !first && status == 0) {
+        memset(samples, 0, t->block_size * 2 * sizeof(samples[0]));
+        memset(&metadata, 0, sizeof(metadata));
+        metadata.flags = BLADERF_META_FLAG_TX_BURST_END;
+
+        status = bladerf_sync_tx(t->dev, samples, t->block_size, &metadata,
+                                 t->timeout_ms);
+        if (status != 0) {
+            log_error("Failed to end TX burst: %s\n",
+                      bladerf_strerror(status));
+        }
+    }
+
+    free(samples);
+    free(iov);
+    free(rx_meta);
+    r->status = status;
+    return NULL;
+}
+
+static void print_csv_header(FILE *out)
+{
+    fprintf(out, "mode,module,format,buffer_size,buffer_count,num_xfers,"
+                 "block_size,iov,call,samplerate,status,samples,elapsed_s,msps,"
+                 "thread_cpu_pct,process_cpu_pct,event_cpu_pct,"
+                 "overruns,underruns,discontinuities,dropped_samples,"
+                 "spin_waits,blocking_waits,latency_mean_us,"
+                 "latency_p50_us,latency_p90_us,latency_p99_us,"
+                 "latency_max_us\n");
+}
+
+/* Print a JSON number, or null if the value is unavailable */
+static void print_json_value(FILE *out, const char *name, double value,
+                             const char *suffix)
+{
+    if (value < 0) {
+        fprintf(out, "      \"%s\": null%s\n", name, suffix);
+    } else {
+        fprintf(out, "      \"%s\": %.3f%s\n", name, value, suffix);
+    }
+}
+
+static void print_csv_value(FILE *out, double value)
+{
+    if (value < 0) {
+        fprintf(out, ",");
+    } else {
+        fprintf(out, ",%.3f", value);
+    }
+}
+
+static void print_result(FILE *out, const struct test_params *p,
+                         const struct bench_task *t,
+                         unsigned int buffer_size, unsigned int buffer_count,
+                         unsigned int num_xfers, bool first)
+{
+    const struct bench_result *r = &t->result;
+    double msps = -1.0, thread_pct = -1.0, process_pct = -1.0;
+    double event_pct = -1.0;
+    double mean = -1.0, p50 = -1.0, p90 = -1.0, p99 = -1.0, max = -1.0;
+    const char *status_str = r->status == 0 ? "ok" :
+                             bladerf_strerror(r->status);
+    const char *call_str = t->module != BLADERF_MODULE_RX ? "sync_tx" :
+                           t->rx_multi ? "sync_rx_multi" : "sync_rx";
+
+    if (r->elapsed_s > 0) {
+        msps = r->samples / r->elapsed_s / 1e6;
+
+        if (r->thread_cpu_s >= 0) {
+            thread_pct = 100.0 * r->thread_cpu_s / r->elapsed_s;
+        }
+
+        if (r->process_cpu_s >= 0) {
+            process_pct = 100.0 * r->process_cpu_s / r->elapsed_s;
+        }
+
+        event_pct = 100.0 * r->event_cpu_s / r->elapsed_s;
+    }
+
+    if (r->num_latencies > 0) {
+        size_t i;
+        double sum = 0;
+
+        for (i = 0; i < r->num_latencies; i++) {
+            sum += r->latencies[i];
+        }
+
+        mean = sum / r->num_latencies;
+        p50 = percentile(r->latencies, r->num_latencies, 50.0);
+        p90 = percentile(r->latencies, r->num_latencies, 90.0);
+        p99 = percentile(r->latencies, r->num_latencies, 99.0);
+        max = r->latencies[r->num_latencies - 1];
+    }
+
+    if (p->bench_format == BENCH_FORMAT_CSV) {
+        fprintf(out, "%s,%s,%s,%u,%u,%u,%u,%u,%s,%u,%s,%" PRIu64,
+                mode_str(p->bench), module_str(t->module),
+                format_str(t->format), buffer_size, buffer_count, num_xfers,
+                t->block_size, t->iov_count, call_str, p->samplerate,
+                status_str, r->samples);
+
+        print_csv_value(out, r->elapsed_s);
+        print_csv_value(out, msps);
+        print_csv_value(out, thread_pct);
+        print_csv_value(out, process_pct);
+        print_csv_value(out, event_pct);
+
+        fprintf(out, ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64,
+                r->overruns, r->underruns, r->discontinuities,
+                r->dropped_samples);
+
+        fprintf(out, ",%" PRIu64 ",%" PRIu64, r->spin_waits,
+                r->blocking_waits);
+
+        print_csv_value(out, mean);
+        print_csv_value(out, p50);
+        print_csv_value(out, p90);
+        print_csv_value(out, p99);
+        print_csv_value(out, max);
+        fprintf(out, "\n");
+    } else {
+        fprintf(out, "%s    {\n", first ? "" : ",\n");
+        fprintf(out, "      \"module\": \"%s\",\n", module_str(t->module));
+        fprintf(out, "      \"format\": \"%s\",\n", format_str(t->format));
+        fprintf(out, "      \"buffer_size\": %u,\n", buffer_size);
+        fprintf(out, "      \"buffer_count\": %u,\n", buffer_count);
+        fprintf(out, "      \"num_xfers\": %u,\n", num_xfers);
+        fprintf(out, "      \"iov\": %u,\n", t->iov_count);
+        fprintf(out, "      \"call\": \"%s\",\n", call_str);
+        fprintf(out, "      \"status\": \"%s\",\n", status_str);
+        fprintf(out, "      \"samples\": %" PRIu64 ",\n", r->samples);
+        print_json_value(out, "elapsed_s", r->elapsed_s, ",");
+        print_json_value(out, "msps", msps, ",");
+        print_json_value(out, "thread_cpu_pct", thread_pct, ",");
+        print_json_value(out, "process_cpu_pct", process_pct, ",");
+        print_json_value(out, "event_cpu_pct", event_pct, ",");
+        fprintf(out, "      \"overruns\": %" PRIu64 ",\n", r->overruns);
+        fprintf(out, "      \"underruns\": %" PRIu64 ",\n", r->underruns);
+        fprintf(out, "      \"discontinuities\": %" PRIu64 ",\n",
+                r->discontinuities);
+        fprintf(out, "      \"dropped_samples\": %" PRIu64 ",\n",
+                r->dropped_samples);
+        fprintf(out, "      \"spin_waits\": %" PRIu64 ",\n", r->spin_waits);
+        fprintf(out, "      \"blocking_waits\": %" PRIu64 ",\n",
+                r->blocking_waits);
+        print_json_value(out, "latency_mean_us", mean, ",");
+        print_json_value(out, "latency_p50_us", p50, ",");
+        print_json_value(out, "latency_p90_us", p90, ",");
+        print_json_value(out, "latency_p99_us", p99, ",");
+        print_json_value(out, "latency_max_us", max, "");
+        fprintf(out, "    }");
+    }
+
+    fflush(out);
+}
+
+/* Run one configuration on each of the benchmark's modules */
+static int bench_config(struct bladerf *dev, struct test_params *p,
+                        struct bench_task *tasks, size_t num_tasks,
+                        bladerf_format format, unsigned int buffer_size,
+                        unsigned int buffer_count, unsigned int num_xfers)
+{
+    int status = 0;
+    size_t i;
+    size_t num_enabled = 0;
+    size_t num_started = 0;
+    struct timespec window_start;
+    uint64_t expected_calls;
+
+    /* Leave room for calls returning early while buffers drain */
+    expected_calls = (uint64_t) p->samplerate * p->bench_duration_ms / 1000 /
+                     p->block_size / p->bench_iov;
+
+    for (i = 0; i < num_tasks; i++) {
+        struct bench_result *r = &tasks[i].result;
+
+        memset(r, 0, sizeof(*r));
+        r->max_latencies = (size_t) (2 * expected_calls + BENCH_LATENCY_MARGIN);
+        r->latencies = calloc(r->max_latencies, sizeof(r->latencies[0]));
+        if (r->latencies == NULL) {
+            perror("calloc");
+            return BLADERF_ERR_MEM;
+        }
+
+        tasks[i].format = format;
+    }
+
+    for (i = 0; i < num_tasks && status == 0; i++) {
+        status = bladerf_sync_config(dev, tasks[i].module, format,
+                                     buffer_count, buffer_size, num_xfers,
+                                     p->timeout_ms);
+        if (status != 0) {
+            log_error("Failed to configure %s: %s\n",
+                      module_str(tasks[i].module), bladerf_strerror(status));
+            break;
+        }
+
+        status = bladerf_enable_module(dev, tasks[i].module, true);
+        if (status != 0) {
+            log_error("Failed to enable %s: %s\n",
+                      module_str(tasks[i].module), bladerf_strerror(status));
+            break;
+        }
+
+        num_enabled++;
+    }
+
+    if (status == 0) {
+        clock_gettime(BENCH_CLOCK, &window_start);
+        time_add_ms(&window_start, p->bench_warmup_ms);
+
+        for (i = 0; i < num_tasks; i++) {
+            tasks[i].window_start = window_start;
+            tasks[i].window_end = window_start;
+            time_add_ms(&tasks[i].window_end, p->bench_duration_ms);
+
+            if (pthread_create(&tasks[i].thread, NULL,
+                               bench_task_run, &tasks[i]) != 0) {
+                log_error("Failed to start %s task\n",
+                          module_str(tasks[i].module));
+                status = BLADERF_ERR_UNEXPECTED;
+                bench_quit = true;
+                break;
+            }
+
+            num_started++;
+        }
+
+        for (i = 0; i < num_started; i++) {
+            pthread_join(tasks[i].thread, NULL);
+            if (tasks[i].result.num_latencies > 0) {
+                qsort(tasks[i].result.latencies,
+                      tasks[i].result.num_latencies,
+                      sizeof(tasks[i].result.latencies[0]), compare_double);
+            }
+        }
+    }
+
+    /* Report configuration failures in each module's result */
+    for (i = 0; i < num_tasks; i++) {
+        if (tasks[i].result.status == 0) {
+            tasks[i].result.status = status;
+        }
+    }
+
+    for (i = 0; i < num_enabled; i++) {
+        int disable_status = bladerf_enable_module(dev, tasks[i].module, false);
+        if (disable_status != 0) {
+            log_error("Failed to disable %s: %s\n",
+                      module_str(tasks[i].module),
+                      bladerf_strerror(disable_status));
+        }
+    }
+
+    return 0;
+}
+
+int bench_run(struct test_params *p)
+{
+    int status;
+    struct bladerf *dev;
+    struct bladerf_devinfo info;
+    struct bladerf_version lib_ver, fw_ver, fpga_ver;
+    struct bench_task tasks[2];
+    size_t num_tasks = 0;
+    size_t i;
+    unsigned int f, n, m;
+    bool first = true;
+    FILE *out = stdout;
+    const bool rx = p->bench == BENCH_RX || p->bench == BENCH_TRX;
+    const bool tx = p->bench == BENCH_TX || p->bench == BENCH_TRX;
+    const unsigned int num_configs = p->sweep_buffer_size.count *
+                                     p->sweep_buffer_count.count *
+                                     p->sweep_xfers.count;
+    const unsigned int num_methods = p->bench_iov > 1 ? 2 : 1;
+
+    assert(p->bench != BENCH_NONE);
+
+    dev = test_init_device(p, rx, tx);
+    if (dev == NULL) {
+        return -1;
+    }
+
+    status = bladerf_get_devinfo(dev, &info);
+    if (status == 0) {
+        status = bladerf_fw_version(dev, &fw_ver);
+    }
+    if (status == 0) {
+        status = bladerf_fpga_version(dev, &fpga_ver);
+    }
+    if (status != 0) {
+        log_error("Failed to query device info: %s\n",
+                  bladerf_strerror(status));
+        bladerf_close(dev);
+        return -1;
+    }
+
+    bladerf_version(&lib_ver);
+
+    if (p->bench_output != NULL) {
+        out = fopen(p->bench_output, "w");
+        if (out == NULL) {
+            perror(p->bench_output);
+            bladerf_close(dev);
+            return -1;
+        }
+    }
+
+    memset(tasks, 0, sizeof(tasks));
+
+    if (rx) {
+        tasks[num_tasks++].module = BLADERF_MODULE_RX;
+    }
+
+    if (tx) {
+        tasks[num_tasks++].module = BLADERF_MODULE_TX;
+    }
+
+    for (i = 0; i < num_tasks && status == 0; i++) {
+        tasks[i].dev = dev;
+        tasks[i].block_size = p->block_size;
+        tasks[i].timeout_ms = p->timeout_ms;
+        tasks[i].iov_count = tasks[i].module == BLADERF_MODULE_RX ?
+                             p->bench_iov : 1;
+
+        if (p->bench_busy_poll) {
+            struct bladerf_stream_thread_config config;
+
+            status = bladerf_get_stream_thread_config(dev, tasks[i].module,
+                                                      &config);
+            if (status == 0) {
+                config.busy_poll = true;
+                status = bladerf_set_stream_thread_config(dev,
+                                                          tasks[i].module,
+                                                          &config);
+            }
+
+            if (status != 0) {
+                log_error("Failed to enable busy-polling: %s\n",
+                          bladerf_strerror(status));
+            }
+        }
+    }
+
+    if (status != 0) {
+        if (out != stdout) {
+            fclose(out);
+        }
+
+        bladerf_close(dev);
+        return -1;
+    }
+
+    init_signal_handling();
+
+    if (p->bench_format == BENCH_FORMAT_CSV) {
+        print_csv_header(out);
+    } else {
+        fprintf(out, "{\n");
+        fprintf(out, "  \"backend\": \"%s\",\n",
+                bladerf_backend_str(info.backend));
+        fprintf(out, "  \"serial\": \"%s\",\n", info.serial);
+        fprintf(out, "  \"libbladeRF_version\": \"%s\",\n", lib_ver.describe);
+        fprintf(out, "  \"fw_version\": \"%s\",\n", fw_ver.describe);
+        fprintf(out, "  \"fpga_version\": \"%s\",\n", fpga_ver.describe);
+        fprintf(out, "  \"mode\": \"%s\",\n", mode_str(p->bench));
+        fprintf(out, "  \"samplerate\": %u,\n", p->samplerate);
+        fprintf(out, "  \"block_size\": %u,\n", p->block_size);
+        fprintf(out, "  \"iov\": %u,\n", p->bench_iov);
+        fprintf(out, "  \"duration_ms\": %u,\n", p->bench_duration_ms);
+        fprintf(out, "  \"warmup_ms\": %u,\n", p->bench_warmup_ms);
+        fprintf(out, "  \"busy_poll\": %s,\n",
+                p->bench_busy_poll ? "true" : "false");
+        fprintf(out, "  \"results\": [\n");
+    }
+
+    for (f = 0; f < p->num_formats && status == 0 && !bench_quit; f++) {
+        for (n = 0; n < num_configs && status == 0 && !bench_quit; n++) {
+            const unsigned int x = n % p->sweep_xfers.count;
+            const unsigned int c = (n / p->sweep_xfers.count) %
+                                   p->sweep_buffer_count.count;
+            const unsigned int b = n / p->sweep_xfers.count /
+                                   p->sweep_buffer_count.count;
+
+            const unsigned int buffer_size = p->sweep_buffer_size.values[b];
+            const unsigned int buffer_count = p->sweep_buffer_count.values[c];
+            const unsigned int num_xfers = p->sweep_xfers.values[x];
+
+            /* The sync interface requires a buffer that is not in flight */
+            if (num_xfers >= buffer_count) {
+                log_info("Skipping %u transfers with %u buffers.\n",
+                         num_xfers, buffer_count);
+                continue;
+            }
+
+            for (m = 0; m < num_methods && status == 0 && !bench_quit; m++) {
+                for (i = 0; i < num_tasks; i++) {
+                    tasks[i].rx_multi = (m == 1);
+                }
+
+                if (out != stdout) {
+                    printf("Running %s: buffer_size=%u buffer_count=%u "
+                           "num_xfers=%u%s...\n", format_str(p->formats[f]),
+                           buffer_size, buffer_count, num_xfers,
+                           m == 1 ? " (sync_rx_multi)" : "");
+                }
+
+                status = bench_config(dev, p, tasks, num_tasks, p->formats[f],
+                                      buffer_size, buffer_count, num_xfers);
+
+                for (i = 0; i < num_tasks; i++) {
+                    if (status == 0) {
+                        print_result(out, p, &tasks[i], buffer_size,
+                                     buffer_count, num_xfers, first);
+                        first = false;
+                    }
+
+                    free(tasks[i].result.latencies);
+                    tasks[i].result.latencies = NULL;
+                }
+            }
+        }
+    }
+
+    if (p->bench_format == BENCH_FORMAT_JSON) {
+        fprintf(out, "%s  ]\n", first ? "" : "\n");
+        fprintf(out, "}\n");
+    }
+
+    if (out != stdout) {
+        fclose(out);
+    }
+
+    bladerf_set_loopback(dev, BLADERF_LB_NONE);
+    bladerf_close(dev);
+
+    return status == 0 ? 0 : -1;
+}
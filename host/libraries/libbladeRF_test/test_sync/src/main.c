@@ -31,6 +31,7 @@
 
 #include <libbladeRF.h>
 #include <getopt.h>
+#include "host_config.h"
 
 #include "conversions.h"
 #include "log.h"
@@ -65,6 +66,16 @@ const struct option long_options[] = {
     { "buffer-count",   required_argument,  0,  'C' },
     { "timeout",        required_argument,  0,  'T' },
 
+    /* Benchmark configuration */
+    { "bench",          required_argument,  0,  3   },
+    { "duration",       required_argument,  0,  4   },
+    { "warmup",         required_argument,  0,  5   },
+    { "formats",        required_argument,  0,  6   },
+    { "bench-output",   required_argument,  0,  7   },
+    { "bench-format",   required_argument,  0,  8   },
+    { "iov",            required_argument,  0,  9   },
+    { "busy-poll",      no_argument,        0,  10  },
+
     /* Verbosity options */
     { "verbosity",      required_argument,  0,  1,  },
     { "lib-verbosity",  required_argument,  0,  2,  },
@@ -98,6 +109,65 @@ const struct numeric_suffix count_suffixes[] = {
 
 const unsigned int num_count_suffixes = sizeof(count_suffixes) / sizeof(count_suffixes[0]);
 
+/* Parse a comma-separated list of values into a sweep */
+static bool parse_sweep(const char *str, struct bench_sweep *sweep)
+{
+    char *copy, *tok, *saveptr;
+    bool ok = true;
+
+    copy = strdup(str);
+    if (copy == NULL) {
+        perror("strdup");
+        return false;
+    }
+
+    sweep->count = 0;
+
+    for (tok = strtok_r(copy, ",", &saveptr); tok != NULL && ok;
+         tok = strtok_r(NULL, ",", &saveptr)) {
+
+        if (sweep->count >= BENCH_SWEEP_MAX) {
+            log_error("At most %u values may be swept.\n", BENCH_SWEEP_MAX);
+            ok = false;
+        } else {
+            sweep->values[sweep->count++] = str2uint(tok, 1, UINT_MAX, &ok);
+        }
+    }
+
+    free(copy);
+    return ok && sweep->count > 0;
+}
+
+static bool parse_formats(const char *str, struct test_params *p)
+{
+    char *copy, *tok, *saveptr;
+    bool ok = true;
+
+    copy = strdup(str);
+    if (copy == NULL) {
+        perror("strdup");
+        return false;
+    }
+
+    p->num_formats = 0;
+
+    for (tok = strtok_r(copy, ",", &saveptr); tok != NULL && ok;
+         tok = strtok_r(NULL, ",", &saveptr)) {
+
+        if (p->num_formats >= ARRAY_SIZE(p->formats)) {
+            ok = false;
+        } else if (!strcasecmp(tok, "sc16q11")) {
+            p->formats[p->num_formats++] = BLADERF_FORMAT_SC16_Q11;
+        } else if (!strcasecmp(tok, "sc16q11_meta")) {
+            p->formats[p->num_formats++] = BLADERF_FORMAT_SC16_Q11_META;
+        } else {
+            ok = false;
+        }
+    }
+
+    free(copy);
+    return ok && p->num_formats > 0;
+}
 
 static void print_usage(const char *argv0)
 {
@@ -133,6 +203,26 @@ static void print_usage(const char *argv0)
 
     printf("\n");
 
+    printf("Benchmark options:\n");
+    printf("    --bench <rx|tx|trx>         Measure sync throughput on the specified\n");
+    printf("                                module(s), rather than using files.\n");
+    printf("    --duration <ms>             Measurement window per configuration.\n");
+    printf("                                Default = %u.\n", DEFAULT_BENCH_DURATION);
+    printf("    --warmup <ms>               Time streamed before each measurement\n");
+    printf("                                window. Default = %u.\n", DEFAULT_BENCH_WARMUP);
+    printf("    --formats <list>            Comma-separated sample formats to test:\n");
+    printf("                                  sc16q11, sc16q11_meta\n");
+    printf("                                Default = sc16q11.\n");
+    printf("    --bench-output <file>       Write results to <file>, rather than stdout.\n");
+    printf("    --bench-format <json|csv>   Result format. Default = json.\n");
+    printf("    --iov <n>                   RX: Read <n> blocks per iteration, once\n");
+    printf("                                with a bladerf_sync_rx() call per block,\n");
+    printf("                                and once with bladerf_sync_rx_multi().\n");
+    printf("                                Latencies are per iteration. Default = 1.\n");
+    printf("    --busy-poll                 Busy-poll for buffers and transfer\n");
+    printf("                                completions, rather than blocking.\n");
+    printf("\n");
+
     printf("Misc options:\n");
     printf("    -h, --help                  Show this help text\n");
     printf("    --verbosity <level>         Set test verbosity (Default: warning)\n");
@@ -148,6 +238,13 @@ static void print_usage(const char *argv0)
     printf("    When transmitting, the input file size (in samples) should be a multiple\n");
     printf("    of <block-size>, and at least 1 block. Otherwise, samples will be truncated.\n");
     printf("\n");
+    printf("    With --bench, -X, -B, and -C accept comma-separated lists of values,\n");
+    printf("    and every combination (with fewer transfers than buffers) is measured.\n");
+    printf("    For trx, RX and TX stream concurrently and are reported separately.\n");
+    printf("    The process CPU usage includes libbladeRF's worker threads. Use\n");
+    printf("    -d dummy: to measure host overhead without hardware, on builds with\n");
+    printf("    the dummy backend enabled.\n");
+    printf("\n");
 }
 
 int handle_cmdline(int argc, char *argv[], struct test_params *p)
@@ -182,6 +279,69 @@ int handle_cmdline(int argc, char *argv[], struct test_params *p)
                 }
                 break;
 
+            case 3:
+                if (!strcasecmp(optarg, "rx")) {
+                    p->bench = BENCH_RX;
+                } else if (!strcasecmp(optarg, "tx")) {
+                    p->bench = BENCH_TX;
+                } else if (!strcasecmp(optarg, "trx")) {
+                    p->bench = BENCH_TRX;
+                } else {
+                    log_error("Invalid benchmark mode: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 4:
+                p->bench_duration_ms = str2uint(optarg, 1, UINT_MAX, &ok);
+                if (!ok) {
+                    log_error("Invalid benchmark duration: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 5:
+                p->bench_warmup_ms = str2uint(optarg, 0, UINT_MAX, &ok);
+                if (!ok) {
+                    log_error("Invalid benchmark warm-up time: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 6:
+                if (!parse_formats(optarg, p)) {
+                    log_error("Invalid format list: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 7:
+                p->bench_output = optarg;
+                break;
+
+            case 8:
+                if (!strcasecmp(optarg, "json")) {
+                    p->bench_format = BENCH_FORMAT_JSON;
+                } else if (!strcasecmp(optarg, "csv")) {
+                    p->bench_format = BENCH_FORMAT_CSV;
+                } else {
+                    log_error("Invalid benchmark output format: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 9:
+                p->bench_iov = str2uint(optarg, 1, BENCH_IOV_MAX, &ok);
+                if (!ok) {
+                    log_error("Invalid number of blocks: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 10:
+                p->bench_busy_poll = true;
+                break;
+
             case 'h':
                 return 1;
 
@@ -294,24 +454,21 @@ int handle_cmdline(int argc, char *argv[], struct test_params *p)
                 break;
 
             case 'X':
-                p->num_xfers = str2uint(optarg, 1, UINT_MAX, &ok);
-                if (!ok) {
+                if (!parse_sweep(optarg, &p->sweep_xfers)) {
                     log_error("Invalid stream transfer count: %s\n", optarg);
                     return -1;
                 }
                 break;
 
             case 'B':
-                p->stream_buffer_size = str2uint(optarg, 1, UINT_MAX, &ok);
-                if (!ok) {
+                if (!parse_sweep(optarg, &p->sweep_buffer_size)) {
                     log_error("Invalid stream buffer size: %s\n", optarg);
                     return -1;
                 }
                 break;
 
             case 'C':
-                p->stream_buffer_count = str2uint(optarg, 1, UINT_MAX, &ok);
-                if (!ok) {
+                if (!parse_sweep(optarg, &p->sweep_buffer_count)) {
                     log_error("Invalid stream buffer count: %s\n", optarg);
                     return -1;
                 }
@@ -327,9 +484,48 @@ int handle_cmdline(int argc, char *argv[], struct test_params *p)
         }
     }
 
-    if (p->in_file == NULL && p->out_file == NULL) {
+    if (p->bench_iov > 1 && p->bench != BENCH_RX) {
+        log_error("--iov requires --bench rx.\n");
+        return -1;
+    }
+
+    if (p->bench != BENCH_NONE) {
+        if (p->in_file != NULL || p->out_file != NULL) {
+            log_error("Input and output files may not be used with --bench.\n");
+            return -1;
+        }
+    } else if (p->in_file == NULL && p->out_file == NULL) {
         log_error("An input or output file is required.\n");
         return -1;
+    } else if (p->sweep_xfers.count > 1 || p->sweep_buffer_size.count > 1 ||
+               p->sweep_buffer_count.count > 1) {
+        log_error("Lists of stream parameters require --bench.\n");
+        return -1;
+    }
+
+    /* The first (or only) value of each sweep configures the file tests */
+    if (p->sweep_xfers.count == 0) {
+        p->sweep_xfers.values[p->sweep_xfers.count++] = p->num_xfers;
+    } else {
+        p->num_xfers = p->sweep_xfers.values[0];
+    }
+
+    if (p->sweep_buffer_size.count == 0) {
+        p->sweep_buffer_size.values[p->sweep_buffer_size.count++] =
+            p->stream_buffer_size;
+    } else {
+        p->stream_buffer_size = p->sweep_buffer_size.values[0];
+    }
+
+    if (p->sweep_buffer_count.count == 0) {
+        p->sweep_buffer_count.values[p->sweep_buffer_count.count++] =
+            p->stream_buffer_count;
+    } else {
+        p->stream_buffer_count = p->sweep_buffer_count.values[0];
+    }
+
+    if (p->num_formats == 0) {
+        p->formats[p->num_formats++] = BLADERF_FORMAT_SC16_Q11;
     }
 
     if (p->frequency == 0) {
@@ -363,7 +559,11 @@ int main(int argc, char *argv[])
     status = handle_cmdline(argc, argv, &p);
 
     if (status == 0) {
-        status = test_run(&p);
+        if (p.bench != BENCH_NONE) {
+            status = bench_run(&p);
+        } else {
+            status = test_run(&p);
+        }
     } else if (status > 0) {
         print_usage(argv[0]);
         status = 0;
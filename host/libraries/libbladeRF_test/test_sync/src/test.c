@@ -98,6 +98,11 @@ void test_init_params(struct test_params *p)
     p->stream_buffer_count = DEFAULT_STREAM_BUFFERS;
     p->stream_buffer_size = DEFAULT_STREAM_SAMPLES;
     p->timeout_ms = DEFAULT_STREAM_TIMEOUT;
+
+    p->bench_duration_ms = DEFAULT_BENCH_DURATION;
+    p->bench_warmup_ms = DEFAULT_BENCH_WARMUP;
+    p->bench_format = BENCH_FORMAT_JSON;
+    p->bench_iov = 1;
 }
 
 static int init_module(struct bladerf *dev, struct test_params *p,
@@ -137,7 +142,7 @@ static int init_module(struct bladerf *dev, struct test_params *p,
     return status;
 }
 
-static struct bladerf * initialize_device(struct test_params *p)
+struct bladerf * test_init_device(struct test_params *p, bool rx, bool tx)
 {
     struct bladerf *dev;
     int status = bladerf_open(&dev, p->device_str);
@@ -154,28 +159,28 @@ static struct bladerf * initialize_device(struct test_params *p)
         log_error("Failed to check FPGA state: %s\n",
                   bladerf_strerror(fpga_loaded));
         status = -1;
-        goto initialize_device_out;
+        goto test_init_device_out;
     } else if (fpga_loaded == 0) {
         log_error("The device's FPGA is not loaded.\n");
         status = -1;
-        goto initialize_device_out;
+        goto test_init_device_out;
     }
 
-    if (p->out_file) {
+    if (rx) {
         status = init_module(dev, p, BLADERF_MODULE_RX);
         if (status != 0) {
             log_error("Failed to init RX module: %s\n",
                       bladerf_strerror(status));
-            goto initialize_device_out;
+            goto test_init_device_out;
         }
     }
 
-    if (p->in_file) {
+    if (tx) {
         status = init_module(dev, p, BLADERF_MODULE_TX);
         if (status != 0) {
             log_error("Failed to init TX module: %s\n",
                       bladerf_strerror(status));
-            goto initialize_device_out;
+            goto test_init_device_out;
         }
     }
 
@@ -187,7 +192,7 @@ static struct bladerf * initialize_device(struct test_params *p)
         log_debug("Set loopback to %d\n", p->loopback);
     }
 
-initialize_device_out:
+test_init_device_out:
     if (status != 0) {
         bladerf_close(dev);
         dev = NULL;
@@ -375,7 +380,7 @@ int test_run(struct test_params *p)
         return -1;
     }
 
-    dev = initialize_device(p);
+    dev = test_init_device(p, p->out_file != NULL, p->in_file != NULL);
     if (dev == NULL) {
         return -1;
     }
@@ -23,6 +23,7 @@
  * THE SOFTWARE.
  */
 #include <stdio.h>
+#include <stdbool.h>
 #include <libbladeRF.h>
 
 /* Device config defaults */
@@ -42,6 +43,33 @@
 
 #define SYNC_TIMEOUT_MS         500
 
+/* Benchmark defaults */
+#define DEFAULT_BENCH_DURATION  2000    /* ms per configuration */
+#define DEFAULT_BENCH_WARMUP    250     /* ms */
+
+/* Maximum # of blocks read per RX iteration, via --iov */
+#define BENCH_IOV_MAX           1024
+
+/* Maximum # of values in each swept stream parameter's list */
+#define BENCH_SWEEP_MAX         16
+
+typedef enum {
+    BENCH_NONE = 0,
+    BENCH_RX,
+    BENCH_TX,
+    BENCH_TRX,
+} bench_mode;
+
+typedef enum {
+    BENCH_FORMAT_JSON,
+    BENCH_FORMAT_CSV,
+} bench_output_format;
+
+struct bench_sweep {
+    unsigned int values[BENCH_SWEEP_MAX];
+    unsigned int count;
+};
+
 struct test_params {
     const char *device_str;
     unsigned int samplerate;
@@ -59,8 +87,32 @@ struct test_params {
     unsigned int stream_buffer_count;
     unsigned int stream_buffer_size;    /* Units of samples */
     unsigned int timeout_ms;
+
+    /* Benchmark config. Each combination of the swept stream parameters
+     * and sample formats is measured in turn. */
+    bench_mode bench;
+    unsigned int bench_duration_ms;
+    unsigned int bench_warmup_ms;
+    struct bench_sweep sweep_xfers;
+    struct bench_sweep sweep_buffer_count;
+    struct bench_sweep sweep_buffer_size;
+    bladerf_format formats[2];
+    unsigned int num_formats;
+    const char *bench_output;       /* NULL for stdout */
+    bench_output_format bench_format;
+    unsigned int bench_iov;         /* RX blocks per iteration. With more
+                                     * than 1, each configuration is run
+                                     * with a bladerf_sync_rx() call per
+                                     * block, and then with a single
+                                     * bladerf_sync_rx_multi() call. */
+    bool bench_busy_poll;           /* Busy-poll, rather than block */
 };
 
 void test_init_params(struct test_params *p);
 
 int test_run(struct test_params *p);
+
+/* Open the device and configure the modules that are to be used */
+struct bladerf * test_init_device(struct test_params *p, bool rx, bool tx);
+
+int bench_run(struct test_params *p);
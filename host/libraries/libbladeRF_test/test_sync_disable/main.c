@@ -0,0 +1,247 @@
+/*
+ * This program disables a module while another thread is blocked in a
+ * bladerf_sync_rx() or bladerf_sync_tx() call on it, and verifies that the
+ * blocked call is woken and fails promptly, rather than holding off the
+ * disable until its timeout expires (or forever, with no timeout).
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <libbladeRF.h>
+#include "host_config.h"
+
+#if BLADERF_OS_WINDOWS || BLADERF_OS_OSX
+#include "clock_gettime.h"
+#else
+#include <time.h>
+#endif
+
+#if !BLADERF_OS_WINDOWS
+#include <unistd.h>
+#endif
+
+#ifdef CLOCK_MONOTONIC
+#   define TEST_CLOCK CLOCK_MONOTONIC
+#else
+#   define TEST_CLOCK CLOCK_REALTIME
+#endif
+
+/* Each call requests about 10 seconds of samples, so that it is still in
+ * progress when the module is disabled. Use the dummy backend ("dummy:") to
+ * run this without hardware. */
+#define SAMPLERATE      500000
+#define NUM_SAMPLES     (10 * SAMPLERATE)
+#define NUM_BUFFERS     16
+#define BUFFER_SIZE     8192
+#define NUM_XFERS       8
+#define STREAM_TIMEOUT  3000
+
+#define PAUSE_US        200000
+
+/* Allowed time from disabling the module to it and the blocked call
+ * returning */
+#define MAX_RETURN_MS   1000
+
+/* The whole test is aborted if it takes longer than this, as a module that
+ * cannot be disabled would otherwise hang it */
+#define WATCHDOG_S      60
+
+struct call {
+    struct bladerf *dev;
+    bladerf_module module;
+    unsigned int timeout_ms;
+    int16_t *samples;
+    int status;
+    struct timespec returned;
+};
+
+static inline double elapsed_ms(const struct timespec *start,
+                                const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1000.0 +
+           (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void *call_task(void *arg)
+{
+    struct call *c = (struct call *) arg;
+
+    if (c->module == BLADERF_MODULE_RX) {
+        c->status = bladerf_sync_rx(c->dev, c->samples, NUM_SAMPLES, NULL,
+                                    c->timeout_ms);
+    } else {
+        c->status = bladerf_sync_tx(c->dev, c->samples, NUM_SAMPLES, NULL,
+                                    c->timeout_ms);
+    }
+
+    clock_gettime(TEST_CLOCK, &c->returned);
+    return NULL;
+}
+
+static bool run(struct bladerf *dev, int16_t *samples, bladerf_module module,
+                unsigned int timeout_ms)
+{
+    const char *name = module == BLADERF_MODULE_RX ? "RX" : "TX";
+    struct call c;
+    struct timespec start, end;
+    pthread_t thread;
+    double disable_ms, return_ms;
+    int status;
+    bool pass = true;
+
+    status = bladerf_sync_config(dev, module, BLADERF_FORMAT_SC16_Q11,
+                                 NUM_BUFFERS, BUFFER_SIZE, NUM_XFERS,
+                                 STREAM_TIMEOUT);
+    if (status != 0) {
+        fprintf(stderr, "Failed to configure %s sync interface: %s\n",
+                name, bladerf_strerror(status));
+        return false;
+    }
+
+    status = bladerf_enable_module(dev, module, true);
+    if (status != 0) {
+        fprintf(stderr, "Failed to enable %s: %s\n",
+                name, bladerf_strerror(status));
+        return false;
+    }
+
+    memset(&c, 0, sizeof(c));
+    c.dev = dev;
+    c.module = module;
+    c.timeout_ms = timeout_ms;
+    c.samples = samples;
+
+    status = pthread_create(&thread, NULL, call_task, &c);
+    if (status != 0) {
+        fprintf(stderr, "Failed to create thread: %s\n", strerror(status));
+        bladerf_enable_module(dev, module, false);
+        return false;
+    }
+
+    /* Let the call get underway and block on the stream */
+    usleep(PAUSE_US);
+
+    clock_gettime(TEST_CLOCK, &start);
+    status = bladerf_enable_module(dev, module, false);
+    clock_gettime(TEST_CLOCK, &end);
+
+    pthread_join(thread, NULL);
+
+    disable_ms = elapsed_ms(&start, &end);
+    return_ms = elapsed_ms(&start, &c.returned);
+
+    printf("%s, timeout %u ms: disabled in %.1f ms, call returned %s "
+           "after %.1f ms\n", name, timeout_ms, disable_ms,
+           bladerf_strerror(c.status), return_ms);
+
+    if (status != 0) {
+        fprintf(stderr, "Failed to disable %s: %s\n",
+                name, bladerf_strerror(status));
+        pass = false;
+    }
+
+    if (c.status != BLADERF_ERR_INVAL) {
+        fprintf(stderr, "Expected the %s call to fail with \"%s\"\n",
+                name, bladerf_strerror(BLADERF_ERR_INVAL));
+        pass = false;
+    }
+
+    if (disable_ms > MAX_RETURN_MS || return_ms > MAX_RETURN_MS) {
+        fprintf(stderr, "Disabling %s was held off by the blocked call\n",
+                name);
+        pass = false;
+    }
+
+    /* The handle is gone, so further calls fail without blocking */
+    status = module == BLADERF_MODULE_RX ?
+        bladerf_sync_rx(dev, samples, BUFFER_SIZE, NULL, timeout_ms) :
+        bladerf_sync_tx(dev, samples, BUFFER_SIZE, NULL, timeout_ms);
+
+    if (status != BLADERF_ERR_INVAL) {
+        fprintf(stderr, "Expected a %s call after disabling to fail with "
+                "\"%s\", got \"%s\"\n", name,
+                bladerf_strerror(BLADERF_ERR_INVAL), bladerf_strerror(status));
+        pass = false;
+    }
+
+    return pass;
+}
+
+int main(int argc, char *argv[])
+{
+    static const unsigned int timeouts[] = { 0, 5000 };
+    static const bladerf_module modules[] = {
+        BLADERF_MODULE_RX, BLADERF_MODULE_TX
+    };
+
+    int status;
+    unsigned int i, j;
+    struct bladerf *dev;
+    int16_t *samples;
+    bool pass = true;
+
+#if !BLADERF_OS_WINDOWS
+    alarm(WATCHDOG_S);
+#endif
+
+    samples = calloc(NUM_SAMPLES, 2 * sizeof(int16_t));
+    if (samples == NULL) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+
+    status = bladerf_open(&dev, argc > 1 ? argv[1] : NULL);
+    if (status != 0) {
+        fprintf(stderr, "Failed to open device: %s\n",
+                bladerf_strerror(status));
+        free(samples);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < sizeof(modules) / sizeof(modules[0]); i++) {
+        status = bladerf_set_sample_rate(dev, modules[i], SAMPLERATE, NULL);
+        if (status != 0) {
+            fprintf(stderr, "Failed to set sample rate: %s\n",
+                    bladerf_strerror(status));
+            pass = false;
+        }
+    }
+
+    for (i = 0; pass && i < sizeof(modules) / sizeof(modules[0]); i++) {
+        for (j = 0; j < sizeof(timeouts) / sizeof(timeouts[0]); j++) {
+            pass = run(dev, samples, modules[i], timeouts[j]) && pass;
+        }
+    }
+
+    bladerf_close(dev);
+    free(samples);
+
+    printf("%s\n", pass ? "Passed." : "Failed.");
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,214 @@
+/*
+ * This program resizes a streaming module's synchronous interface, and
+ * verifies that a resize that fails, whether for invalid parameters or for
+ * want of memory, leaves the existing configuration in effect: sync calls
+ * continue to succeed, and the readiness descriptor remains the same.
+ *
+ * Use the dummy backend ("dummy:") to run this without hardware.
+ *
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <libbladeRF.h>
+
+#define SAMPLERATE      1000000
+#define NUM_BUFFERS     16
+#define BUFFER_SIZE     8192
+#define NUM_XFERS       8
+#define STREAM_TIMEOUT  3000
+#define TIMEOUT_MS      3000
+
+/* Samples transferred by each sync call */
+#define NUM_SAMPLES     (4 * BUFFER_SIZE)
+
+struct resize {
+    const char *name;
+    unsigned int num_buffers;
+    unsigned int buffer_size;
+    unsigned int num_transfers;
+    int expected;   /* Expected status */
+};
+
+static const struct resize resizes[] = {
+    { "invalid",    NUM_BUFFERS, BUFFER_SIZE, NUM_BUFFERS,
+                    BLADERF_ERR_INVAL },
+
+    /* Buffers that could not fit in the address space */
+    { "too large",  UINT_MAX, BUFFER_SIZE, NUM_XFERS,
+                    BLADERF_ERR_MEM },
+
+    { "grow",       2 * NUM_BUFFERS, 2 * BUFFER_SIZE, NUM_XFERS, 0 },
+    { "shrink",     NUM_BUFFERS / 2, BUFFER_SIZE, NUM_XFERS / 2, 0 },
+};
+
+static int transfer(struct bladerf *dev, bladerf_module module,
+                    int16_t *samples)
+{
+    if (module == BLADERF_MODULE_RX) {
+        return bladerf_sync_rx(dev, samples, NUM_SAMPLES, NULL, TIMEOUT_MS);
+    } else {
+        return bladerf_sync_tx(dev, samples, NUM_SAMPLES, NULL, TIMEOUT_MS);
+    }
+}
+
+/* Get the module's readiness descriptor, or -1 if this is unsupported */
+static int get_fd(struct bladerf *dev, bladerf_module module, int *fd)
+{
+    int status = bladerf_sync_get_fd(dev, module, fd);
+
+    if (status == BLADERF_ERR_UNSUPPORTED) {
+        *fd = -1;
+        status = 0;
+    }
+
+    return status;
+}
+
+static bool run(struct bladerf *dev, bladerf_module module, int16_t *samples)
+{
+    const char *name = module == BLADERF_MODULE_RX ? "RX" : "TX";
+    unsigned int i;
+    int status, fd, resized_fd;
+    bool pass = true;
+
+    status = bladerf_sync_config(dev, module, BLADERF_FORMAT_SC16_Q11,
+                                 NUM_BUFFERS, BUFFER_SIZE, NUM_XFERS,
+                                 STREAM_TIMEOUT);
+    if (status != 0) {
+        fprintf(stderr, "Failed to configure %s sync interface: %s\n",
+                name, bladerf_strerror(status));
+        return false;
+    }
+
+    status = bladerf_enable_module(dev, module, true);
+    if (status != 0) {
+        fprintf(stderr, "Failed to enable %s: %s\n",
+                name, bladerf_strerror(status));
+        return false;
+    }
+
+    status = transfer(dev, module, samples);
+    if (status == 0) {
+        status = get_fd(dev, module, &fd);
+    }
+
+    if (status != 0) {
+        fprintf(stderr, "%s: Failed to start streaming: %s\n",
+                name, bladerf_strerror(status));
+        bladerf_enable_module(dev, module, false);
+        return false;
+    }
+
+    for (i = 0; i < sizeof(resizes) / sizeof(resizes[0]); i++) {
+        const struct resize *r = &resizes[i];
+
+        status = bladerf_sync_resize(dev, module, r->num_buffers,
+                                     r->buffer_size, r->num_transfers);
+
+        if (status != r->expected) {
+            fprintf(stderr, "%s, %s: resize returned \"%s\", expected "
+                    "\"%s\"\n", name, r->name, bladerf_strerror(status),
+                    bladerf_strerror(r->expected));
+            pass = false;
+        }
+
+        /* Whether or not the resize succeeded, streaming continues */
+        status = transfer(dev, module, samples);
+        if (status != 0) {
+            fprintf(stderr, "%s, %s: sync call after resize failed: %s\n",
+                    name, r->name, bladerf_strerror(status));
+            pass = false;
+            continue;
+        }
+
+        status = get_fd(dev, module, &resized_fd);
+        if (status != 0 || resized_fd != fd) {
+            fprintf(stderr, "%s, %s: readiness descriptor was not retained\n",
+                    name, r->name);
+            pass = false;
+            continue;
+        }
+
+        printf("%s, %s: OK\n", name, r->name);
+    }
+
+    status = bladerf_enable_module(dev, module, false);
+    if (status != 0) {
+        fprintf(stderr, "Failed to disable %s: %s\n",
+                name, bladerf_strerror(status));
+        pass = false;
+    }
+
+    return pass;
+}
+
+int main(int argc, char *argv[])
+{
+    static const bladerf_module modules[] = {
+        BLADERF_MODULE_RX, BLADERF_MODULE_TX
+    };
+
+    int status;
+    unsigned int i;
+    struct bladerf *dev;
+    int16_t *samples;
+    bool pass = true;
+
+    samples = calloc(NUM_SAMPLES, 2 * sizeof(int16_t));
+    if (samples == NULL) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+
+    status = bladerf_open(&dev, argc > 1 ? argv[1] : NULL);
+    if (status != 0) {
+        fprintf(stderr, "Failed to open device: %s\n",
+                bladerf_strerror(status));
+        free(samples);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < sizeof(modules) / sizeof(modules[0]); i++) {
+        status = bladerf_set_sample_rate(dev, modules[i], SAMPLERATE, NULL);
+        if (status != 0) {
+            fprintf(stderr, "Failed to set sample rate: %s\n",
+                    bladerf_strerror(status));
+            pass = false;
+        }
+    }
+
+    for (i = 0; pass && i < sizeof(modules) / sizeof(modules[0]); i++) {
+        pass = run(dev, modules[i], samples) && pass;
+    }
+
+    bladerf_close(dev);
+    free(samples);
+
+    printf("%s\n", pass ? "Passed." : "Failed.");
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -52,6 +52,7 @@ DECLARE_TEST(rx_scheduled);
 DECLARE_TEST(tx_onoff);
 DECLARE_TEST(tx_onoff_nowsched);
 DECLARE_TEST(tx_gmsk_bursts);
+DECLARE_TEST(tx_lead);
 DECLARE_TEST(loopback_onoff);
 DECLARE_TEST(format_mismatch);
 DECLARE_TEST(readback);
@@ -62,6 +63,7 @@ static const struct test *tests[] = {
     TEST(tx_onoff),
     TEST(tx_onoff_nowsched),
     TEST(tx_gmsk_bursts),
+    TEST(tx_lead),
     TEST(loopback_onoff),
     TEST(format_mismatch),
     TEST(readback),
@@ -124,6 +126,8 @@ static void usage(const char *argv0)
     printf("                                Requires external verification.\n");
     printf("         tx_gmsk_bursts       Transmits GMSK bursts.\n");
     printf("                                Requires external verification.\n");
+    printf("         tx_lead              Find the minimum lead time for scheduled\n");
+    printf("                                TX bursts. Requires FPGA v0.1.20.\n");
     printf("         loopback_onoff       Transmits ON-OFF bursts which are verified\n");
     printf("                                via baseband loopback to the RX module.\n");
     printf("         format_mismatch      Exercise checking of conflicting formats.\n");
@@ -0,0 +1,291 @@
+/*
+ * This file is part of the bladeRF project:
+ *   http://www.github.com/nuand/bladeRF
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <libbladeRF.h>
+#include "test_timestamps.h"
+
+/* This test measures how far ahead of the current TX timestamp a burst must
+ * be scheduled for it to be transmitted on time, for a number of buffer and
+ * transfer configurations.
+ *
+ * Each burst is scheduled a fixed lead time after a freshly read timestamp,
+ * and is allowed to finish before the next one, so every burst sees an empty
+ * pipeline. The FPGA's late message count decides whether a lead time was
+ * sufficient, so this requires FPGA v0.1.20 or later.
+ */
+
+#define MAGNITUDE   2000
+#define BURST_LEN   1000    /* Samples per burst, fitting a single message */
+#define BURSTS      16      /* Bursts sent at each candidate lead time */
+
+#define LEAD_START_US       1000
+#define LEAD_MAX_US         1000000
+#define LEAD_RESOLUTION_US  50
+
+struct test_case {
+    unsigned int num_buffers;
+    unsigned int buf_len;
+    unsigned int num_xfers;
+};
+
+static const struct test_case tests[] = {
+    { 2,    1024,   1  },
+    { 4,    1024,   2  },
+    { 16,   1024,   8  },
+    { 4,    4096,   2  },
+    { 16,   4096,   8  },
+    { 4,    16384,  2  },
+    { 16,   16384,  8  },
+    { 32,   32768,  16 },
+};
+
+static inline uint64_t us_to_samples(unsigned int us, unsigned int samplerate)
+{
+    return ((uint64_t) us * samplerate + 999999) / 1000000;
+}
+
+static inline double samples_to_us(uint64_t samples, unsigned int samplerate)
+{
+    return samples * 1e6 / samplerate;
+}
+
+/* Send BURSTS bursts, each `lead` samples after the current timestamp, and
+ * count how many messages were late */
+static int try_lead(struct bladerf *dev, struct app_params *p,
+                    int16_t *samples, uint64_t lead, unsigned int *late)
+{
+    int status;
+    unsigned int i;
+    struct bladerf_metadata meta;
+    struct bladerf_tx_late before, after;
+
+    status = bladerf_get_tx_late(dev, &before);
+    if (status != 0) {
+        fprintf(stderr, "Failed to read late TX count: %s\n",
+                bladerf_strerror(status));
+        return status;
+    }
+
+    memset(&meta, 0, sizeof(meta));
+
+    for (i = 0; i < BURSTS && status == 0; i++) {
+        status = bladerf_get_timestamp(dev, BLADERF_MODULE_TX,
+                                       &meta.timestamp);
+        if (status != 0) {
+            fprintf(stderr, "Failed to get timestamp: %s\n",
+                    bladerf_strerror(status));
+            break;
+        }
+
+        meta.timestamp += lead;
+        meta.flags = BLADERF_META_FLAG_TX_BURST_START |
+                     BLADERF_META_FLAG_TX_BURST_END;
+
+        status = bladerf_sync_tx(dev, samples, BURST_LEN + 2, &meta,
+                                 p->timeout_ms);
+        if (status != 0) {
+            fprintf(stderr, "TX failed @ burst %u: %s\n",
+                    i, bladerf_strerror(status));
+            break;
+        }
+
+        status = wait_for_timestamp(dev, BLADERF_MODULE_TX,
+                                    meta.timestamp + BURST_LEN + 2,
+                                    p->timeout_ms);
+        if (status != 0) {
+            fprintf(stderr, "Failed to wait for burst %u: %s\n",
+                    i, bladerf_strerror(status));
+        }
+    }
+
+    if (status == 0) {
+        status = bladerf_get_tx_late(dev, &after);
+        if (status != 0) {
+            fprintf(stderr, "Failed to read late TX count: %s\n",
+                    bladerf_strerror(status));
+        } else {
+            /* The FPGA's count is 16 bits wide */
+            *late = (after.count - before.count) & 0xffff;
+        }
+    }
+
+    return status;
+}
+
+/* Find the minimum lead time for which no bursts are late, in samples.
+ * The search first doubles the lead until it is sufficient, and then bisects
+ * down to LEAD_RESOLUTION_US. */
+static int run(struct bladerf *dev, struct app_params *p,
+               const struct test_case *t, int16_t *samples,
+               uint64_t *min_lead, unsigned int *max_lateness)
+{
+    int status, status_out;
+    struct app_params case_params;
+    struct bladerf_tx_late late_total;
+    const uint64_t lead_max = us_to_samples(LEAD_MAX_US, p->samplerate);
+    const uint64_t resolution = us_to_samples(LEAD_RESOLUTION_US,
+                                              p->samplerate);
+    uint64_t lo = 0, hi, mid;
+    unsigned int late = 0;
+
+    memcpy(&case_params, p, sizeof(case_params));
+    case_params.num_buffers = t->num_buffers;
+    case_params.num_xfers = t->num_xfers;
+
+    status = perform_sync_init(dev, BLADERF_MODULE_TX, t->buf_len,
+                               &case_params);
+    if (status != 0) {
+        goto out;
+    }
+
+    hi = us_to_samples(LEAD_START_US, p->samplerate);
+
+    for (;;) {
+        status = try_lead(dev, p, samples, hi, &late);
+        if (status != 0) {
+            goto out;
+        }
+
+        printf("  Lead %8.1f us: %u late\n",
+               samples_to_us(hi, p->samplerate), late);
+
+        if (late == 0) {
+            break;
+        } else if (hi >= lead_max) {
+            fprintf(stderr, "Bursts are still late with a %u us lead.\n",
+                    LEAD_MAX_US);
+            status = BLADERF_ERR_TIMEOUT;
+            goto out;
+        }
+
+        lo = hi;
+        hi *= 2;
+        if (hi > lead_max) {
+            hi = lead_max;
+        }
+    }
+
+    while ((hi - lo) > resolution) {
+        mid = lo + (hi - lo) / 2;
+
+        status = try_lead(dev, p, samples, mid, &late);
+        if (status != 0) {
+            goto out;
+        }
+
+        printf("  Lead %8.1f us: %u late\n",
+               samples_to_us(mid, p->samplerate), late);
+
+        if (late == 0) {
+            hi = mid;
+        } else {
+            lo = mid;
+        }
+    }
+
+    *min_lead = hi;
+
+    /* The worst lateness covers every attempt since TX was enabled */
+    status = bladerf_get_tx_late(dev, &late_total);
+    if (status == 0) {
+        *max_lateness = late_total.max_lateness;
+    } else {
+        fprintf(stderr, "Failed to read late TX count: %s\n",
+                bladerf_strerror(status));
+    }
+
+out:
+    status_out = bladerf_enable_module(dev, BLADERF_MODULE_TX, false);
+    if (status_out != 0) {
+        fprintf(stderr, "Failed to disable TX module: %s\n",
+                bladerf_strerror(status_out));
+    }
+
+    return first_error(status, status_out);
+}
+
+int test_fn_tx_lead(struct bladerf *dev, struct app_params *p)
+{
+    int status = 0;
+    size_t i;
+    int16_t *samples;
+    uint64_t min_lead[ARRAY_SIZE(tests)];
+    unsigned int max_lateness[ARRAY_SIZE(tests)];
+    struct bladerf_tx_late late;
+
+    /* Bail out early, rather than after configuring the first test case */
+    status = bladerf_get_tx_late(dev, &late);
+    if (status != 0) {
+        fprintf(stderr, "Failed to read late TX count: %s\n",
+                bladerf_strerror(status));
+        fprintf(stderr, "This test requires FPGA v0.1.20 or later.\n");
+        return status;
+    }
+
+    samples = calloc(2 * sizeof(int16_t), BURST_LEN + 2);
+    if (samples == NULL) {
+        perror("calloc");
+        return BLADERF_ERR_MEM;
+    }
+
+    /* Leave the last two samples zero */
+    for (i = 0; i < (2 * BURST_LEN); i += 2) {
+        samples[i] = samples[i + 1] = MAGNITUDE;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(tests) && status == 0; i++) {
+        printf("\nTest %u: %u buffers of %u samples, %u transfers\n",
+               (unsigned int) i + 1, tests[i].num_buffers,
+               tests[i].buf_len, tests[i].num_xfers);
+
+        status = run(dev, p, &tests[i], samples,
+                     &min_lead[i], &max_lateness[i]);
+    }
+
+    if (status == 0) {
+        printf("\nMinimum TX lead time @ %u Hz\n", p->samplerate);
+        printf("---------------------------------------------------------\n");
+        printf(" Buffers  Buf len  Xfers  Lead (samples)  Lead (us)  Worst\n");
+
+        for (i = 0; i < ARRAY_SIZE(tests); i++) {
+            printf(" %7u  %7u  %5u  %14"PRIu64"  %9.1f  %5u\n",
+                   tests[i].num_buffers, tests[i].buf_len,
+                   tests[i].num_xfers, min_lead[i],
+                   samples_to_us(min_lead[i], p->samplerate),
+                   max_lateness[i]);
+        }
+
+        printf("\n'Worst' is the greatest lateness seen during a search, "
+               "in samples.\n");
+    }
+
+    free(samples);
+    return status;
+}
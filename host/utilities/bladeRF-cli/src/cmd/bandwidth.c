@@ -0,0 +1,160 @@
+/*
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <limits.h>
+
+#include "rxtx_impl.h"
+
+/* Time measured if none is given */
+#ifndef BANDWIDTH_DEFAULT_DURATION_MS
+#   define BANDWIDTH_DEFAULT_DURATION_MS 2000
+#endif
+
+static const struct numeric_suffix bandwidth_time_suffixes[] = {
+    { FIELD_INIT(.suffix, "ms"), FIELD_INIT(.multiplier, 1) },
+    { FIELD_INIT(.suffix, "s"), FIELD_INIT(.multiplier, 1000) },
+};
+
+static const struct {
+    const char *name;
+    const char *desc;
+    bladerf_format format;
+} bandwidth_formats[] = {
+    { "sc16", "SC16 Q11", BLADERF_FORMAT_SC16_Q11 },
+    { "sc16_meta", "SC16 Q11 with metadata", BLADERF_FORMAT_SC16_Q11_META },
+    { "sc12", "12-bit packed SC16 Q11", BLADERF_FORMAT_SC16_Q11_PACKED },
+    { "sc8", "SC8 Q7", BLADERF_FORMAT_SC8_Q7 },
+    { "sc8_meta", "SC8 Q7 with metadata", BLADERF_FORMAT_SC8_Q7_META },
+};
+
+/* Upper bound of the latency histogram bin holding the specified
+ * percentile */
+static uint64_t hist_percentile_us(const uint64_t *hist, uint64_t count,
+                                   unsigned int pct)
+{
+    const uint64_t target = (count * pct + 99) / 100;
+    uint64_t total = 0;
+    unsigned int i;
+
+    for (i = 0; i < BLADERF_STREAM_STATS_HIST_LEN - 1; i++) {
+        total += hist[i];
+        if (total >= target) {
+            break;
+        }
+    }
+
+    return (uint64_t) 1 << i;
+}
+
+static void bandwidth_print(const struct bladerf_bandwidth_probe_config *c,
+                            const char *format_desc,
+                            const struct bladerf_bandwidth_probe_results *r)
+{
+    printf("\n");
+    printf("  Format:             %s\n", format_desc);
+    printf("  Buffers:            %u x %u samples, %u transfers\n",
+           c->num_buffers, c->buffer_size, c->num_transfers);
+    printf("  Duration:           %.3f s\n", r->elapsed_us / 1e6);
+    printf("  TX throughput:      %.2f MB/s\n", r->tx_bytes_per_sec / 1e6);
+    printf("  RX throughput:      %.2f MB/s\n", r->rx_bytes_per_sec / 1e6);
+    printf("  Sustained rate:     %" PRIu64 " samples/s\n", r->samples_per_sec);
+
+    if (r->markers != 0) {
+        printf("  Round-trip latency: min %" PRIu64 " us, mean %" PRIu64
+               " us, max %" PRIu64 " us\n", r->latency_min_us,
+               r->latency_total_us / r->markers, r->latency_max_us);
+        printf("                      p50 < %" PRIu64 " us, p99 < %" PRIu64
+               " us\n", hist_percentile_us(r->latency_hist, r->markers, 50),
+               hist_percentile_us(r->latency_hist, r->markers, 99));
+        printf("  Markers:            %" PRIu64 " received, %" PRIu64
+               " lost\n", r->markers, r->markers_lost);
+    } else {
+        printf("  Round-trip latency: no markers were received\n");
+    }
+
+    printf("\n");
+}
+
+int cmd_bandwidth(struct cli_state *state, int argc, char **argv)
+{
+    int status;
+    int i;
+    size_t f = 0;
+    struct bladerf_bandwidth_probe_config config;
+    struct bladerf_bandwidth_probe_results results;
+
+    if (argc > 3) {
+        return CLI_RET_NARGS;
+    }
+
+    memset(&config, 0, sizeof(config));
+    config.format = bandwidth_formats[f].format;
+    config.duration_ms = BANDWIDTH_DEFAULT_DURATION_MS;
+
+    for (i = 1; i < argc; i++) {
+        bool ok;
+        size_t j;
+
+        for (j = 0; j < ARRAY_SIZE(bandwidth_formats); j++) {
+            if (!strcasecmp(argv[i], bandwidth_formats[j].name)) {
+                break;
+            }
+        }
+
+        if (j < ARRAY_SIZE(bandwidth_formats)) {
+            f = j;
+            config.format = bandwidth_formats[f].format;
+            continue;
+        }
+
+        config.duration_ms = str2uint_suffix(argv[i], 1, UINT_MAX,
+                                    bandwidth_time_suffixes,
+                                    (int) ARRAY_SIZE(bandwidth_time_suffixes),
+                                    &ok);
+        if (!ok) {
+            cli_err(state, argv[0], "Invalid duration or format: \"%s\"\n",
+                    argv[i]);
+            return CLI_RET_INVPARAM;
+        }
+    }
+
+    /* Stream with the buffering that the rx command is configured for */
+    MUTEX_LOCK(&state->rx->data_mgmt.lock);
+    config.num_buffers = state->rx->data_mgmt.num_buffers;
+    config.buffer_size = state->rx->data_mgmt.samples_per_buffer;
+    config.num_transfers = state->rx->data_mgmt.num_transfers;
+    config.timeout_ms = state->rx->data_mgmt.timeout_ms;
+    MUTEX_UNLOCK(&state->rx->data_mgmt.lock);
+
+    printf("\n  Streaming through the FX3 firmware loopback for %.1f s...\n",
+           config.duration_ms / 1000.0);
+    fflush(stdout);
+
+    status = bladerf_bandwidth_probe(state->dev, &config, &results);
+    if (status != 0) {
+        state->last_lib_error = status;
+        return CLI_RET_LIBBLADERF;
+    }
+
+    bandwidth_print(&config, bandwidth_formats[f].desc, &results);
+    return CLI_RET_OK;
+}
@@ -303,20 +303,24 @@ static int cal_iq_correction_params(struct cli_state *s, int argc , char **argv)
     }
 }
 
+/* Handles "table" (current device) and "tables" (all attached devices) */
 static int cal_table(struct cli_state *s, int argc, char **argv)
 {
     int status;
     bool ok;
     bladerf_module module;
-    char *filename = NULL;
-    size_t filename_len = 1024;
+    struct dc_tbl_plan plan;
 
     /* The XB-200 does not affect the minimum, as we're tuning the LMS here. */
     unsigned int f_min = BLADERF_FREQUENCY_MIN;
     unsigned int f_inc = 2500000;
     unsigned int f_max = BLADERF_FREQUENCY_MAX;
 
-    if (argc == 4 || argc == 6 || argc == 7) {
+    /* Optional gain axis */
+    int *gains = NULL;
+    unsigned int n_gains = 0;
+
+    if (argc == 4 || argc == 6 || argc == 7 || argc == 10) {
         /* Only DC tables are currently supported.
          * IQ tables may be added in the future */
         if (strcasecmp(argv[2], "dc")) {
@@ -368,44 +372,76 @@ static int cal_table(struct cli_state *s, int argc, char **argv)
 
     }
 
+    if (argc == 10) {
+        int g, g_min, g_max, g_inc;
+        const int min = (module == BLADERF_MODULE_RX) ?
+                            BLADERF_RXVGA2_GAIN_MIN : BLADERF_TXVGA1_GAIN_MIN;
+        const int max = (module == BLADERF_MODULE_RX) ?
+                            BLADERF_RXVGA2_GAIN_MAX : BLADERF_TXVGA1_GAIN_MAX;
+
+        g_min = str2int(argv[7], min, max, &ok);
+        if (!ok) {
+            cli_err(s, argv[0], "Invalid min gain (%s)\n", argv[7]);
+            return CLI_RET_INVPARAM;
+        }
+
+        g_max = str2int(argv[8], g_min, max, &ok);
+        if (!ok) {
+            cli_err(s, argv[0], "Invalid max gain (%s)\n", argv[8]);
+            return CLI_RET_INVPARAM;
+        }
+
+        g_inc = str2int(argv[9], 1, max - min, &ok);
+        if (!ok) {
+            cli_err(s, argv[0], "Invalid gain increment (%s)\n", argv[9]);
+            return CLI_RET_INVPARAM;
+        }
+
+        n_gains = (g_max - g_min) / g_inc + 1;
+        gains = calloc(n_gains, sizeof(gains[0]));
+        if (gains == NULL) {
+            return CLI_RET_MEM;
+        }
+
+        for (g = 0; g < (int) n_gains; g++) {
+            gains[g] = g_min + g * g_inc;
+        }
+    }
+
     if (f_min >= f_max) {
         cli_err(s, argv[0], "Low frequency cannot be >= high frequency\n");
-        return CLI_RET_INVPARAM;
+        status = CLI_RET_INVPARAM;
+        goto out;
     }
 
     if (((f_max - f_min) / f_inc) == 0) {
         cli_err(s, argv[0], "The specified frequency increment would yield "
                             "an empty table.\n");
 
-        return CLI_RET_INVPARAM;
-    }
-
-    filename = calloc(1, filename_len + 1);
-    if (filename == NULL) {
-        return CLI_RET_MEM;
-    }
-
-    status = bladerf_get_serial(s->dev, filename);
-    if (status != 0) {
+        status = CLI_RET_INVPARAM;
         goto out;
     }
 
-    filename_len -= strlen(filename);
-    if (module == BLADERF_MODULE_RX) {
-        strncat(filename, "_dc_rx.tbl", filename_len);
+    plan.module = module;
+    plan.f_low = f_min;
+    plan.f_inc = f_inc;
+    plan.f_high = f_max;
+    plan.gains = gains;
+    plan.n_gains = n_gains;
+
+    if (!strcasecmp(argv[1], "tables")) {
+        status = calibrate_dc_gen_tbls(s, &plan);
     } else {
-        strncat(filename, "_dc_tx.tbl", filename_len);
+        status = calibrate_dc_gen_tbl(s, &plan, false);
     }
 
-    status = calibrate_dc_gen_tbl(s, module, filename, f_min, f_inc, f_max);
-
-out:
     if (status != 0) {
         s->last_lib_error = status;
         status = CLI_RET_LIBBLADERF;
     }
 
-    free(filename);
+out:
+    free(gains);
     return status;
 }
 
@@ -418,7 +454,8 @@ int cmd_calibrate(struct cli_state *state, int argc, char **argv)
     if (argc >= 2) {
         if (!strcasecmp(argv[1], "lms")) {
             status = cal_lms(state, argc, argv);
-        } else if (!strcasecmp(argv[1], "table")) {
+        } else if (!strcasecmp(argv[1], "table") ||
+                   !strcasecmp(argv[1], "tables")) {
             status = cal_table(state, argc, argv);
         } else if (!strcasecmp(argv[1], "dc")) {
             status = cal_dc_correction_params(state, argc, argv);
@@ -60,20 +60,50 @@
 int calibrate_dc(struct cli_state *state, unsigned int ops);
 
 /**
- * Generate a DC offset calibration table
+ * Frequencies and gains at which to generate a DC offset calibration table
+ */
+struct dc_tbl_plan {
+    bladerf_module module;  /**< Module to calibrate */
+    unsigned int f_low;     /**< Lowest frequency in the table */
+    unsigned int f_inc;     /**< Frequency to increment by at each step */
+    unsigned int f_high;    /**< Max frequency in the table */
+
+    /** Increasing RXVGA2 (RX) or TXVGA1 (TX) gains to calibrate each
+     *  frequency at. May be NULL if `n_gains` is 0, in which case the current
+     *  gain is used and the table does not account for gain. */
+    const int *gains;
+    unsigned int n_gains;   /**< Number of elements in `gains` */
+};
+
+/**
+ * Generate a DC offset calibration table, written to
+ * <serial>_dc_<rx|tx>.tbl in the current working directory.
+ *
+ * Progress is checkpointed to <serial>_dc_<rx|tx>.tbl.part, from which
+ * generation of the same table is resumed if it was interrupted.
  *
  * @param   state       CLI state handle
- * @param   module      Module to calibrate
- * @param   filename    Output filename for table file
- * @param   f_low       Lowest frequency in the table to start at
- * @param   f_inc       Frequency to increment by at each calibration step
- * @param   f_high      Max frequency in the calibration table
+ * @param   plan        Frequencies and gains to calibrate at
+ * @param   concurrent  Other tables are being generated concurrently, so
+ *                      per-frequency progress output should be suppressed
  *
  * @return 0 on success, BLADERF_ERR_* value on failure
  */
-int calibrate_dc_gen_tbl(struct cli_state *state, bladerf_module module,
-                         const char *filename, unsigned int f_low,
-                         unsigned f_inc, unsigned int f_high);
+int calibrate_dc_gen_tbl(struct cli_state *state,
+                         const struct dc_tbl_plan *plan, bool concurrent);
+
+/**
+ * Generate DC offset calibration tables for all attached devices, in
+ * parallel. The currently opened device is used if it is among them; other
+ * devices are opened and closed as needed.
+ *
+ * @param   state       CLI state handle
+ * @param   plan        Frequencies and gains to calibrate each device at
+ *
+ * @return 0 on success, or the first BLADERF_ERR_* value encountered
+ */
+int calibrate_dc_gen_tbls(struct cli_state *state,
+                          const struct dc_tbl_plan *plan);
 
 
 #endif
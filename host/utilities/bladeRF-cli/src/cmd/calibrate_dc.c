@@ -18,6 +18,7 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #include <pthread.h>
+#include <stdio.h>
 #include <string.h>
 #include <math.h>
 #include <limits.h>
@@ -25,6 +26,7 @@
 #include "calibrate.h"
 #include "common.h"
 #include "rel_assert.h"
+#include "sample_stats.h"
 #include "thread.h"
 
 #define CAL_SAMPLERATE  3000000u
@@ -40,6 +42,9 @@
 
 #define UPPER_BAND      15000000u
 
+#define DC_TBL_ENTRY_SIZE   (sizeof(uint32_t) +   /* Frequency */ \
+                             2 * sizeof(int16_t)) /* DC I and Q values */
+
 struct cal_tx_task {
     struct cli_state *s;
     int16_t *samples;
@@ -137,38 +142,10 @@ static inline int intersection(struct cli_state *s,
     return 0;
 }
 
-/* Compute variance via incremental Online algorithm */
-static void variance(int16_t *samples, float *var_i, float *var_q)
-{
-    unsigned int i;
-
-    float n;
-    float mean_i, delta_i, m2_i;
-    float mean_q, delta_q, m2_q;
-
-    n = mean_i = mean_q = delta_i = delta_q = m2_i = m2_q = 0.0f;
-
-    for (i = 0; i < 2 * CAL_BUF_LEN; i += 2) {
-        n += 1;
-
-        delta_i = samples[i] - mean_i;
-        mean_i = mean_i + delta_i / n;
-        m2_i = m2_i + delta_i * (samples[i] - mean_i);
-
-        delta_q = samples[i + 1] - mean_q;
-        mean_q = mean_q + delta_q / n;
-        m2_q = m2_q + delta_q * (samples[i + 1] - mean_q);
-    }
-
-    *var_i = m2_i / (n - 1);
-    *var_q = m2_q / (n - 1);
-}
-
 static int rx_avg(struct bladerf *dev, int16_t *samples,
                   int16_t *avg_i, int16_t *avg_q)
 {
     int status;
-    int64_t accum_i, accum_q;
     unsigned int i;
 
     /* Flush out samples and read a buffer's worth of data */
@@ -179,21 +156,97 @@ static int rx_avg(struct bladerf *dev, int16_t *samples,
         }
     }
 
-    for (i = 0, accum_i = accum_q = 0; i < 2 * CAL_BUF_LEN; i += 2) {
-        accum_i += samples[i];
-        accum_q += samples[i + 1];
+    sample_dc(samples, CAL_BUF_LEN, avg_i, avg_q);
+
+    assert(*avg_i < (1 << 12) && *avg_i >= (-(1 << 12)));
+    assert(*avg_q < (1 << 12) && *avg_q >= (-(1 << 12)));
+
+    return 0;
+}
+
+/* RX DC correction values are applied to the LMS6002D in steps of this size,
+ * so searching at a finer granularity yields nothing new */
+#define CAL_RX_DC_STEP      32
+
+/* Max number of refinement captures made by calibrate_dc_rx() */
+#define CAL_RX_MAX_ITER     5
+
+/* Secant search state for one of the RX DC correction channels. The
+ * resulting DC offset of each channel is approximately linear in its
+ * correction value, and independent of the other channel's. */
+struct rx_dc_search {
+    int16_t x0, x1;         /* Two most recently tested correction values */
+    int16_t y0, y1;         /* Resulting average sample values */
+    int16_t best_x, best_y; /* Best (smallest DC offset) result thus far */
+    bool done;
+};
+
+static void rx_dc_search_update(struct rx_dc_search *srch,
+                                int16_t x, int16_t y)
+{
+    srch->x0 = srch->x1;
+    srch->y0 = srch->y1;
+    srch->x1 = x;
+    srch->y1 = y;
+
+    if (abs(y) < abs(srch->best_y)) {
+        srch->best_x = x;
+        srch->best_y = y;
     }
+}
+
+static void rx_dc_search_init(struct rx_dc_search *srch,
+                              int16_t x0, int16_t y0, int16_t x1, int16_t y1)
+{
+    srch->x1 = x0;
+    srch->y1 = y0;
+    srch->best_x = x0;
+    srch->best_y = y0;
+    srch->done = false;
 
-    accum_i /= CAL_BUF_LEN;
-    accum_q /= CAL_BUF_LEN;
+    rx_dc_search_update(srch, x1, y1);
+}
 
-    assert(accum_i < (1 << 12) && accum_i >= (-(1 << 12)) );
-    assert(accum_q < (1 << 12) && accum_i >= (-(1 << 12)) );
+/* Register code that a correction value maps to (rounded down, as done by
+ * libbladeRF) */
+static inline int rx_dc_code(int16_t x)
+{
+    if (x < 0) {
+        return -((-x + CAL_RX_DC_STEP - 1) / CAL_RX_DC_STEP);
+    } else {
+        return x / CAL_RX_DC_STEP;
+    }
+}
 
-    *avg_i = (int16_t) accum_i;
-    *avg_q = (int16_t) accum_q;
+/* Get the next correction value to test. Returns false once the search
+ * cannot make further progress. */
+static bool rx_dc_search_next(struct rx_dc_search *srch, int16_t *next)
+{
+    int16_t x;
 
-    return 0;
+    if (srch->done) {
+        return false;
+    }
+
+    if (interpolate(srch->x0, srch->x1, srch->y0, srch->y1, &x) != 0) {
+        srch->done = true;
+        return false;
+    }
+
+    if (x > CAL_DC_MAX) {
+        x = CAL_DC_MAX;
+    } else if (x < CAL_DC_MIN) {
+        x = CAL_DC_MIN;
+    }
+
+    if (rx_dc_code(x) == rx_dc_code(srch->x0) ||
+        rx_dc_code(x) == rx_dc_code(srch->x1)) {
+        srch->done = true;
+        return false;
+    }
+
+    *next = x;
+    return true;
 }
 
 int calibrate_dc_rx(struct cli_state *s,
@@ -205,9 +258,10 @@ int calibrate_dc_rx(struct cli_state *s,
     int16_t dc_i0, dc_q0, dc_i1, dc_q1;
     int16_t avg_i0, avg_q0, avg_i1, avg_q1;
 
-    int16_t test_i[7], test_q[7];
-    int16_t tmp_i, tmp_q, min_i, min_q;
-    unsigned int min_i_idx, min_q_idx, n;
+    struct rx_dc_search srch_i, srch_q;
+    int16_t next_i, next_q, tmp_i, tmp_q;
+    bool more_i, more_q;
+    unsigned int n;
 
     samples = (int16_t*) malloc(CAL_BUF_LEN * 2 * sizeof(samples[0]));
     if (samples == NULL) {
@@ -259,53 +313,41 @@ int calibrate_dc_rx(struct cli_state *s,
         goto out;
     }
 
-    status = interpolate(dc_i0, dc_i1, avg_i0, avg_i1, dc_i);
-    if (status != 0) {
+    if (avg_i0 == avg_i1) {
         cli_err(s, "Error", "RX I values appear to be stuck @ %d\n", avg_i0);
+        status = BLADERF_ERR_UNEXPECTED;
         goto out;
     }
 
-    status = interpolate(dc_q0, dc_q1, avg_q0, avg_q1, dc_q);
-    if (status != 0) {
+    if (avg_q0 == avg_q1) {
         cli_err(s, "Error", "RX Q values appear to be stuck @ %d\n", avg_q0);
+        status = BLADERF_ERR_UNEXPECTED;
         goto out;
     }
 
-    test_i[0] = *dc_i;
-    test_i[1] = test_i[0] + 96;
-    test_i[2] = test_i[0] + 64;
-    test_i[3] = test_i[0] + 32;
-    test_i[4] = test_i[0] - 32;
-    test_i[5] = test_i[0] - 64;
-    test_i[6] = test_i[0] - 96;
-
-    test_q[0] = *dc_q;
-    test_q[1] = test_q[0] + 96;
-    test_q[2] = test_q[0] + 64;
-    test_q[3] = test_q[0] + 32;
-    test_q[4] = test_q[0] - 32;
-    test_q[5] = test_q[0] - 64;
-    test_q[6] = test_q[0] - 96;
+    rx_dc_search_init(&srch_i, dc_i0, avg_i0, dc_i1, avg_i1);
+    rx_dc_search_init(&srch_q, dc_q0, avg_q0, dc_q1, avg_q1);
 
-    min_i_idx = min_q_idx = 0;
-    min_i = min_q = INT16_MAX;
+    /* Refine both channels' estimates with each capture, until neither
+     * can be improved upon. This typically requires 1-2 captures, rather
+     * than sweeping a fixed set of points around the initial estimate. */
+    for (n = 0; n < CAL_RX_MAX_ITER; n++) {
+        more_i = rx_dc_search_next(&srch_i, &next_i);
+        more_q = rx_dc_search_next(&srch_q, &next_q);
 
-    for (n = 0; n < 7; n++) {
+        if (!more_i && !more_q) {
+            break;
+        }
 
-        if (test_i[n] > CAL_DC_MAX) {
-            test_i[n] = CAL_DC_MAX;
-        } else if (test_i[n] < CAL_DC_MIN) {
-            test_i[n] = CAL_DC_MIN;
+        if (!more_i) {
+            next_i = srch_i.best_x;
         }
 
-        if (test_q[n] > CAL_DC_MAX) {
-            test_q[n] = CAL_DC_MAX;
-        } else if (test_q[n] < CAL_DC_MIN) {
-            test_q[n] = CAL_DC_MIN;
+        if (!more_q) {
+            next_q = srch_q.best_x;
         }
 
-        /* See where we're at now... */
-        status = set_rx_dc(s->dev, test_i[n], test_q[n]);
+        status = set_rx_dc(s->dev, next_i, next_q);
         if (status != 0) {
             goto out;
         }
@@ -315,26 +357,24 @@ int calibrate_dc_rx(struct cli_state *s,
             goto out;
         }
 
-        if (abs(tmp_i) < abs(min_i)) {
-            min_i = tmp_i;
-            min_i_idx = n;
+        if (more_i) {
+            rx_dc_search_update(&srch_i, next_i, tmp_i);
         }
 
-        if (abs(tmp_q) < abs(min_q)) {
-            min_q = tmp_q;
-            min_q_idx = n;
+        if (more_q) {
+            rx_dc_search_update(&srch_q, next_q, tmp_q);
         }
     }
 
-    *dc_i = test_i[min_i_idx];
-    *dc_q = test_q[min_q_idx];
+    *dc_i = srch_i.best_x;
+    *dc_q = srch_q.best_x;
 
     if (avg_i) {
-        *avg_i = min_i;
+        *avg_i = srch_i.best_y;
     }
 
     if (avg_q) {
-        *avg_q = min_q;
+        *avg_q = srch_q.best_y;
     }
 
     status = set_rx_dc(s->dev, *dc_i, *dc_q);
@@ -439,7 +479,7 @@ int rx_avg_magnitude(struct bladerf *dev, int16_t *samples,
         }
     }
 
-    variance(samples, &var_i, &var_q);
+    sample_variance(samples, CAL_BUF_LEN, &var_i, &var_q);
     *avg_magnitude = (float) sqrt(var_i + var_q);
     return status;
 }
@@ -711,46 +751,307 @@ static inline int restore_settings(struct bladerf *dev, bladerf_module module,
     return status;
 }
 
+/* Calibrate at the current gain and the specified frequency */
+static int calibrate_entry(struct cli_state *s, bladerf_module module,
+                           unsigned int f, bool concurrent,
+                           int16_t *dc_i, int16_t *dc_q)
+{
+    int status;
+
+    if (!concurrent) {
+        printf("  Calibrating @ %u Hz...", f);
+    }
+
+    status = bladerf_set_frequency(s->dev, module, f);
+    if (status != 0) {
+        return status;
+    }
+
+    if (module == BLADERF_MODULE_RX) {
+        int16_t error_i, error_q;
+        status = calibrate_dc_rx(s, dc_i, dc_q, &error_i, &error_q);
+        if (!concurrent) {
+            printf("    I=%-4d (avg: %-4d), Q=%-4d (avg: %-4d)\r",
+                    *dc_i, error_i, *dc_q, error_q);
+        }
+    } else {
+        float error_i, error_q;
+        status = calibrate_dc_tx(s, dc_i, dc_q, &error_i, &error_q);
+        if (!concurrent) {
+            printf("    I=%-4d (avg: %3.3f), Q=%-4d (avg: %3.3f)\r",
+                    *dc_i, error_i, *dc_q, error_q);
+        }
+    }
+
+    if (!concurrent) {
+        fflush(stdout);
+    }
+
+    return status;
+}
+
+static inline void put_entry(uint8_t *buf, uint32_t freq,
+                             int16_t dc_i, int16_t dc_q)
+{
+    freq = HOST_TO_LE32(freq);
+    dc_i = HOST_TO_LE16(dc_i);
+    dc_q = HOST_TO_LE16(dc_q);
+
+    memcpy(&buf[0], &freq, sizeof(freq));
+    memcpy(&buf[4], &dc_i, sizeof(dc_i));
+    memcpy(&buf[6], &dc_q, sizeof(dc_q));
+}
+
+static inline void get_entry(const uint8_t *buf, uint32_t *freq,
+                             int16_t *dc_i, int16_t *dc_q)
+{
+    memcpy(freq, &buf[0], sizeof(*freq));
+    memcpy(dc_i, &buf[4], sizeof(*dc_i));
+    memcpy(dc_q, &buf[6], sizeof(*dc_q));
+
+    *freq = LE32_TO_HOST(*freq);
+    *dc_i = LE16_TO_HOST(*dc_i);
+    *dc_q = LE16_TO_HOST(*dc_q);
+}
+
+/* Table generation progress is recorded in a text checkpoint file, named
+ * after the table file, so that an interrupted run may be resumed. It
+ * consists of a line describing the table being generated, followed by a
+ * "<gain> <frequency> <dc_i> <dc_q>" line per calibrated entry. */
+#define CKPT_SUFFIX     ".part"
+#define CKPT_LINE_LEN   512
+
+static void ckpt_header(const struct dc_tbl_plan *plan,
+                        const struct bladerf_lms_dc_cals *cals,
+                        char *hdr, size_t len)
+{
+    unsigned int g;
+    size_t n;
+
+    snprintf(hdr, len, "bladeRF DC table checkpoint: %s %u %u %u "
+             "%d %d %d %d %d %d %d %d %d %d gains",
+             plan->module == BLADERF_MODULE_RX ? "rx" : "tx",
+             plan->f_low, plan->f_inc, plan->f_high,
+             cals->lpf_tuning, cals->tx_lpf_i, cals->tx_lpf_q,
+             cals->rx_lpf_i, cals->rx_lpf_q, cals->dc_ref,
+             cals->rxvga2a_i, cals->rxvga2a_q,
+             cals->rxvga2b_i, cals->rxvga2b_q);
+
+    for (g = 0; g < plan->n_gains; g++) {
+        n = strlen(hdr);
+        snprintf(&hdr[n], len - n, " %d", plan->gains[g]);
+    }
+
+    n = strlen(hdr);
+    snprintf(&hdr[n], len - n, "\n");
+}
+
+/* Restore the entries and per-gain-plane gains recorded in a checkpoint, if
+ * it describes the table being generated. Returns the number of entries
+ * restored. */
+static unsigned int ckpt_restore(const char *filename, const char *hdr,
+                                 const struct dc_tbl_plan *plan,
+                                 unsigned int n_frequencies,
+                                 unsigned int n_entries,
+                                 uint8_t *entries, int *plane_gains)
+{
+    FILE *f;
+    char line[CKPT_LINE_LEN];
+    unsigned int n = 0;
+
+    f = fopen(filename, "r");
+    if (f == NULL) {
+        return 0;
+    }
+
+    if (fgets(line, sizeof(line), f) == NULL || strcmp(line, hdr) != 0) {
+        fclose(f);
+        return 0;
+    }
+
+    while (n < n_entries && fgets(line, sizeof(line), f) != NULL) {
+        int gain, dc_i, dc_q;
+        unsigned int freq;
+        const unsigned int plane = n / n_frequencies;
+        const unsigned int expected_freq =
+            plan->f_low + (n % n_frequencies) * plan->f_inc;
+
+        /* Stop at an incomplete or inconsistent line; the remainder of the
+         * table is regenerated */
+        if (strchr(line, '\n') == NULL ||
+            sscanf(line, "%d %u %d %d", &gain, &freq, &dc_i, &dc_q) != 4 ||
+            freq != expected_freq ||
+            dc_i < CAL_DC_MIN || dc_i > CAL_DC_MAX ||
+            dc_q < CAL_DC_MIN || dc_q > CAL_DC_MAX ||
+            ((n % n_frequencies) != 0 && gain != plane_gains[plane])) {
+            break;
+        }
+
+        plane_gains[plane] = gain;
+        put_entry(&entries[n * DC_TBL_ENTRY_SIZE], freq,
+                  (int16_t) dc_i, (int16_t) dc_q);
+        n++;
+    }
+
+    fclose(f);
+    return n;
+}
+
+static inline void ckpt_append(FILE *ckpt, int gain, uint32_t freq,
+                               int16_t dc_i, int16_t dc_q)
+{
+    if (ckpt != NULL) {
+        fprintf(ckpt, "%d %u %d %d\n", gain, freq, dc_i, dc_q);
+        fflush(ckpt);
+    }
+}
+
+/* (Re)create a checkpoint file, containing any restored entries */
+static FILE *ckpt_create(const char *filename, const char *hdr,
+                         unsigned int n_frequencies, unsigned int n_done,
+                         const uint8_t *entries, const int *plane_gains)
+{
+    unsigned int n;
+    FILE *ckpt = fopen(filename, "w");
+
+    if (ckpt == NULL) {
+        return NULL;
+    }
+
+    fputs(hdr, ckpt);
+
+    for (n = 0; n < n_done; n++) {
+        uint32_t freq;
+        int16_t dc_i, dc_q;
+
+        get_entry(&entries[n * DC_TBL_ENTRY_SIZE], &freq, &dc_i, &dc_q);
+        ckpt_append(ckpt, plane_gains[n / n_frequencies], freq, dc_i, dc_q);
+    }
+
+    return ckpt;
+}
+
+/* Set the gain of the stage that a DC table's gain axis describes, and
+ * return the gain that was actually applied */
+static int set_tbl_gain(struct bladerf *dev, bladerf_module module, int gain,
+                        int *actual)
+{
+    int status;
+
+    if (module == BLADERF_MODULE_RX) {
+        status = bladerf_set_rxvga2(dev, gain);
+        if (status == 0) {
+            status = bladerf_get_rxvga2(dev, actual);
+        }
+    } else {
+        status = bladerf_set_txvga1(dev, gain);
+        if (status == 0) {
+            status = bladerf_get_txvga1(dev, actual);
+        }
+    }
+
+    return status;
+}
+
+static int get_tbl_gain(struct bladerf *dev, bladerf_module module, int *gain)
+{
+    if (module == BLADERF_MODULE_RX) {
+        return bladerf_get_rxvga2(dev, gain);
+    } else {
+        return bladerf_get_txvga1(dev, gain);
+    }
+}
+
 /* See libbladeRF's dc_cal_table.c for the packed table data format */
-int calibrate_dc_gen_tbl(struct cli_state *s, bladerf_module module,
-                         const char *filename, unsigned int f_low,
-                         unsigned f_inc, unsigned int f_high)
+int calibrate_dc_gen_tbl(struct cli_state *s, const struct dc_tbl_plan *plan,
+                         bool concurrent)
 {
     int retval, status;
-    size_t off;
+    size_t off, gains_off, entries_off;
     struct bladerf_lms_dc_cals lms_dc_cals;
-    unsigned int f;
+    unsigned int g, k, n_done;
+    uint32_t b;
     struct settings settings;
     bladerf_loopback loopback_backup;
+    int gain_backup;
     struct bladerf_image *image = NULL;
+    int *plane_gains = NULL;
+    FILE *ckpt = NULL;
+    char serial[BLADERF_SERIAL_LENGTH];
+    char filename[BLADERF_SERIAL_LENGTH + 32];
+    char ckpt_filename[sizeof(filename) + sizeof(CKPT_SUFFIX)];
+    char ckpt_hdr[CKPT_LINE_LEN];
+
+    const bladerf_module module = plan->module;
+    const unsigned int n_gains = plan->n_gains;
 
     const uint16_t magic = HOST_TO_LE16(0x1ab1);
     const uint32_t reserved = HOST_TO_LE32(0x00000000);
-    const uint32_t tbl_version = HOST_TO_LE32(0x00000001);
+
+    /* Gain axes are only supported by version 3 tables. Version 2 is
+     * otherwise used, for the sake of older libbladeRF versions. */
+    const uint32_t tbl_version = HOST_TO_LE32(n_gains > 0 ? 3 : 2);
+    const uint32_t n_gains_le = HOST_TO_LE32(n_gains);
+    const unsigned int n_planes = n_gains > 0 ? n_gains : 1;
+    const size_t gain_axis_size =
+        n_gains > 0 ? sizeof(n_gains_le) + n_gains * sizeof(int32_t) : 0;
 
     const size_t lms_data_size = 10; /* 10 uint8_t register values */
 
-    const uint32_t n_frequencies = (f_high - f_low) / f_inc + 1;
+    const uint32_t n_frequencies =
+        (plan->f_high - plan->f_low) / plan->f_inc + 1;
     const uint32_t n_frequencies_le = HOST_TO_LE32(n_frequencies);
+    const unsigned int n_entries = n_planes * n_frequencies;
 
-    const size_t entry_size = sizeof(uint32_t) +   /* Frequency */
-                              2 * sizeof(int16_t); /* DC I and Q valus */
+    const size_t table_size = n_entries * DC_TBL_ENTRY_SIZE;
 
-    const size_t table_size = n_frequencies * entry_size;
+    /* Lookup index, bucketed in the same manner as libbladeRF */
+    const uint32_t bucket_size = 1000000;
+    const uint32_t bucket_size_le = HOST_TO_LE32(bucket_size);
+    const uint32_t n_buckets =
+        ((n_frequencies - 1) * plan->f_inc) / bucket_size + 1;
+    const uint32_t n_buckets_le = HOST_TO_LE32(n_buckets);
+    const size_t index_size = n_buckets * sizeof(uint32_t);
 
     const size_t data_size = sizeof(magic) + sizeof(reserved) +
                              sizeof(tbl_version) + sizeof(n_frequencies_le) +
-                             lms_data_size + table_size;
+                             lms_data_size + sizeof(bucket_size_le) +
+                             sizeof(n_buckets_le) + gain_axis_size +
+                             table_size + index_size;
 
     assert(data_size <= UINT_MAX);
 
+    status = bladerf_get_serial(s->dev, serial);
+    if (status != 0) {
+        return status;
+    }
+
+    snprintf(filename, sizeof(filename), "%s_dc_%s.tbl", serial,
+             module == BLADERF_MODULE_RX ? "rx" : "tx");
+
+    snprintf(ckpt_filename, sizeof(ckpt_filename), "%s" CKPT_SUFFIX,
+             filename);
+
+    plane_gains = calloc(n_planes, sizeof(plane_gains[0]));
+    if (plane_gains == NULL) {
+        return BLADERF_ERR_MEM;
+    }
+
     status = backup_and_update_settings(s->dev, module, &settings);
     if (status != 0) {
+        free(plane_gains);
         return status;
     }
 
     status = bladerf_get_loopback(s->dev, &loopback_backup);
     if (status != 0) {
+        free(plane_gains);
+        return status;
+    }
+
+    status = get_tbl_gain(s->dev, module, &gain_backup);
+    if (status != 0) {
+        free(plane_gains);
         return status;
     }
 
@@ -772,10 +1073,7 @@ int calibrate_dc_gen_tbl(struct cli_state *s, bladerf_module module,
         goto out;
     }
 
-    status = bladerf_get_serial(s->dev, image->serial);
-    if (status != 0) {
-        goto out;
-    }
+    memcpy(image->serial, serial, sizeof(serial));
 
     if (module == BLADERF_MODULE_RX) {
         status = bladerf_set_loopback(s->dev, BLADERF_LB_NONE);
@@ -809,57 +1107,145 @@ int calibrate_dc_gen_tbl(struct cli_state *s, bladerf_module module,
     image->data[off++] = (uint8_t)lms_dc_cals.rxvga2b_i;
     image->data[off++] = (uint8_t)lms_dc_cals.rxvga2b_q;
 
-    putchar('\n');
+    memcpy(&image->data[off], &bucket_size_le, sizeof(bucket_size_le));
+    off += sizeof(bucket_size_le);
+
+    memcpy(&image->data[off], &n_buckets_le, sizeof(n_buckets_le));
+    off += sizeof(n_buckets_le);
+
+    gains_off = off + sizeof(n_gains_le);
+    if (n_gains > 0) {
+        memcpy(&image->data[off], &n_gains_le, sizeof(n_gains_le));
+        off += gain_axis_size;
+    } else {
+        plane_gains[0] = gain_backup;
+    }
+
+    entries_off = off;
+
+    ckpt_header(plan, &lms_dc_cals, ckpt_hdr, sizeof(ckpt_hdr));
+    n_done = ckpt_restore(ckpt_filename, ckpt_hdr, plan, n_frequencies,
+                          n_entries, &image->data[entries_off], plane_gains);
+
+    if (n_done > 0) {
+        printf("  %s: Resuming from %s (%u of %u entries complete).\n",
+               serial, ckpt_filename, n_done, n_entries);
+    }
+
+    ckpt = ckpt_create(ckpt_filename, ckpt_hdr, n_frequencies, n_done,
+                       &image->data[entries_off], plane_gains);
+    if (ckpt == NULL) {
+        printf("  %s: Warning: Failed to create checkpoint file %s.\n",
+               serial, ckpt_filename);
+    }
+
+    if (!concurrent) {
+        putchar('\n');
+    }
 
-    for (f = f_low; f <= f_high; f += f_inc) {
-        const uint32_t frequency = HOST_TO_LE32((uint32_t)f);
+    for (k = n_done; k < n_entries; k++) {
+        const unsigned int i = k % n_frequencies;
+        const unsigned int f = plan->f_low + i * plan->f_inc;
         int16_t dc_i, dc_q;
 
-        printf("  Calibrating @ %u Hz...", f);
+        g = k / n_frequencies;
 
-        status = bladerf_set_frequency(s->dev, module, f);
-        if (status != 0) {
-            goto out;
-        }
+        if (n_gains > 0 && (k == n_done || i == 0)) {
+            int actual;
 
-        if (module == BLADERF_MODULE_RX) {
-            int16_t error_i, error_q;
-            status = calibrate_dc_rx(s, &dc_i, &dc_q, &error_i, &error_q);
-            printf("    I=%-4d (avg: %-4d), Q=%-4d (avg: %-4d)\r",
-                    dc_i, error_i, dc_q, error_q);
-        } else {
-            float error_i, error_q;
-            status = calibrate_dc_tx(s, &dc_i, &dc_q, &error_i, &error_q);
-            printf("    I=%-4d (avg: %3.3f), Q=%-4d (avg: %3.3f)\r",
-                    dc_i, error_i, dc_q, error_q);
+            status = set_tbl_gain(s->dev, module, plan->gains[g], &actual);
+            if (status != 0) {
+                goto out;
+            }
+
+            if (i != 0 && actual != plane_gains[g]) {
+                /* Resuming part-way through a gain plane */
+                cli_err(s, "calibrate", "%s: Gain of %d dB does not match "
+                        "checkpoint's %d dB.\n", serial, actual,
+                        plane_gains[g]);
+                status = BLADERF_ERR_INVAL;
+                goto out;
+            }
+
+            /* The table's gains must be strictly increasing, which may not
+             * be the case if requested gains were rounded to the same value */
+            if (i == 0 && g > 0 && actual <= plane_gains[g - 1]) {
+                cli_err(s, "calibrate", "Gains of %d dB and %d dB are not "
+                        "distinct.\n", plan->gains[g - 1], plan->gains[g]);
+                status = BLADERF_ERR_INVAL;
+                goto out;
+            }
+
+            plane_gains[g] = actual;
+
+            if (!concurrent) {
+                printf("\n  Calibrating at a gain of %d dB:\n", actual);
+            }
         }
 
+        status = calibrate_entry(s, module, f, concurrent, &dc_i, &dc_q);
         if (status != 0) {
             goto out;
         }
 
-        fflush(stdout);
+        put_entry(&image->data[entries_off + k * DC_TBL_ENTRY_SIZE],
+                  f, dc_i, dc_q);
+
+        ckpt_append(ckpt, plane_gains[g], f, dc_i, dc_q);
+
+        if (concurrent && ((k + 1) * 10 / n_entries) != (k * 10 / n_entries)) {
+            printf("  %s: %u%% complete\n", serial, (k + 1) * 100 / n_entries);
+        }
+    }
+
+    for (g = 0; g < n_gains; g++) {
+        const int32_t gain_le = HOST_TO_LE32(plane_gains[g]);
+        memcpy(&image->data[gains_off + g * sizeof(gain_le)], &gain_le,
+               sizeof(gain_le));
+    }
 
-        dc_i = HOST_TO_LE16(dc_i);
-        dc_q = HOST_TO_LE16(dc_q);
+    off = entries_off + table_size;
 
-        memcpy(&image->data[off], &frequency, sizeof(frequency));
-        off += sizeof(frequency);
+    /* Entries are evenly spaced, so the entry in effect at the start of each
+     * bucket may be computed directly */
+    for (b = 0; b < n_buckets; b++) {
+        uint64_t idx = ((uint64_t) b * bucket_size) / plan->f_inc;
+        uint32_t idx_le;
 
-        memcpy(&image->data[off], &dc_i, sizeof(dc_i));
-        off += sizeof(dc_i);
+        if (idx >= n_frequencies) {
+            idx = n_frequencies - 1;
+        }
 
-        memcpy(&image->data[off], &dc_q, sizeof(dc_q));
-        off += sizeof(dc_q);
+        idx_le = HOST_TO_LE32((uint32_t) idx);
+        memcpy(&image->data[off], &idx_le, sizeof(idx_le));
+        off += sizeof(idx_le);
     }
 
     status = bladerf_image_write(image, filename);
+    if (status == 0 && ckpt != NULL) {
+        fclose(ckpt);
+        ckpt = NULL;
+        remove(ckpt_filename);
+    }
 
-    printf("\n  Done.\n\n");
+    if (concurrent) {
+        printf("  %s: Done.\n", serial);
+    } else {
+        printf("\n  Done.\n\n");
+    }
 
 out:
     retval = status;
 
+    if (ckpt != NULL) {
+        fclose(ckpt);
+    }
+
+    if (n_gains > 0) {
+        status = set_tbl_gain(s->dev, module, gain_backup, &gain_backup);
+        retval = first_error(retval, status);
+    }
+
     if (module == BLADERF_MODULE_RX) {
         status = bladerf_set_loopback(s->dev, loopback_backup);
         retval = first_error(retval, status);
@@ -872,9 +1258,131 @@ out:
     retval = first_error(retval, status);
 
     bladerf_free_image(image);
+    free(plane_gains);
     return retval;
 }
 
+struct gen_tbl_worker {
+    /* Copy of the CLI state, referring to this worker's device. Only the
+     * device handle and error reporting fields are used by the calibration
+     * routines. */
+    struct cli_state state;
+    struct bladerf_devinfo *devinfo;
+    const struct dc_tbl_plan *plan;
+
+    bool opened;    /* Device was opened for table generation */
+    bool started;
+    pthread_t thread;
+    int status;
+};
+
+static void *gen_tbl_worker_fn(void *arg)
+{
+    struct gen_tbl_worker *w = (struct gen_tbl_worker *) arg;
+    w->status = calibrate_dc_gen_tbl(&w->state, w->plan, true);
+    return NULL;
+}
+
+int calibrate_dc_gen_tbls(struct cli_state *s, const struct dc_tbl_plan *plan)
+{
+    int status = 0;
+    int n_devices, i;
+    struct bladerf_devinfo *devices = NULL;
+    struct bladerf_devinfo current;
+    struct gen_tbl_worker *workers = NULL;
+
+    n_devices = bladerf_get_device_list(&devices);
+    if (n_devices < 0) {
+        return n_devices;
+    }
+
+    workers = calloc(n_devices, sizeof(workers[0]));
+    if (workers == NULL) {
+        bladerf_free_device_list(devices);
+        return BLADERF_ERR_MEM;
+    }
+
+    if (s->dev != NULL) {
+        status = bladerf_get_devinfo(s->dev, &current);
+        if (status != 0) {
+            goto out;
+        }
+    }
+
+    putchar('\n');
+
+    for (i = 0; i < n_devices; i++) {
+        struct gen_tbl_worker *w = &workers[i];
+
+        w->state = *s;
+        w->devinfo = &devices[i];
+        w->plan = plan;
+
+        if (s->dev != NULL &&
+            !strcmp(devices[i].serial, current.serial)) {
+            w->state.dev = s->dev;
+        } else {
+            w->status = bladerf_open_with_devinfo(&w->state.dev, &devices[i]);
+            if (w->status != 0) {
+                printf("  %s: Failed to open device: %s\n",
+                       devices[i].serial, bladerf_strerror(w->status));
+                continue;
+            }
+
+            w->opened = true;
+        }
+
+        if (bladerf_is_fpga_configured(w->state.dev) != 1) {
+            printf("  %s: FPGA is not loaded. Skipping device.\n",
+                   devices[i].serial);
+            w->status = BLADERF_ERR_NODEV;
+            continue;
+        }
+
+        printf("  %s: Generating table...\n", devices[i].serial);
+
+        if (pthread_create(&w->thread, NULL, gen_tbl_worker_fn, w) != 0) {
+            w->status = BLADERF_ERR_UNEXPECTED;
+            continue;
+        }
+
+        w->started = true;
+    }
+
+    for (i = 0; i < n_devices; i++) {
+        if (workers[i].started) {
+            pthread_join(workers[i].thread, NULL);
+        }
+    }
+
+    putchar('\n');
+
+    for (i = 0; i < n_devices; i++) {
+        struct gen_tbl_worker *w = &workers[i];
+
+        if (w->status != 0) {
+            printf("  %s: Failed: %s\n", w->devinfo->serial,
+                   bladerf_strerror(w->status));
+            status = first_error(status, w->status);
+        } else {
+            printf("  %s: Succeeded.\n", w->devinfo->serial);
+        }
+    }
+
+    putchar('\n');
+
+out:
+    for (i = 0; i < n_devices; i++) {
+        if (workers[i].opened) {
+            bladerf_close(workers[i].state.dev);
+        }
+    }
+
+    free(workers);
+    bladerf_free_device_list(devices);
+    return status;
+}
+
 int calibrate_dc(struct cli_state *s, unsigned int ops)
 {
     int retval = 0;
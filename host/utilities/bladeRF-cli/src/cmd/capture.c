@@ -0,0 +1,1158 @@
+/*
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ *
+ * A capture receives from several devices at once, each through its own RX
+ * thread, and writes each device's samples to its own file. Files are written
+ * by one thread per disk, such that devices recording to different disks do
+ * not wait on each other, and devices sharing a disk do not compete for it.
+ *
+ * Each device has a fixed pool of buffers. Its RX thread fills free buffers
+ * and queues them to the writer of the file's disk, which returns them to the
+ * pool once written. If a writer falls behind such that a device's pool is
+ * exhausted, that device's samples are discarded, and counted, until a buffer
+ * is returned; the device's stream itself is never stalled.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <libbladeRF.h>
+
+#include "host_config.h"
+
+#if BLADERF_OS_WINDOWS || BLADERF_OS_OSX
+#include "clock_gettime.h"
+#else
+#include <time.h>
+#endif
+
+#include "cmd.h"
+#include "capture.h"
+#include "conversions.h"
+#include "thread.h"
+
+/* Defaults for the optional parameters */
+#ifndef CAPTURE_DEFAULT_BUFFERS
+#   define CAPTURE_DEFAULT_BUFFERS  32
+#endif
+
+#ifndef CAPTURE_DEFAULT_SAMPLES
+#   define CAPTURE_DEFAULT_SAMPLES  32768
+#endif
+
+#ifndef CAPTURE_DEFAULT_XFERS
+#   define CAPTURE_DEFAULT_XFERS    16
+#endif
+
+#ifndef CAPTURE_DEFAULT_TIMEOUT
+#   define CAPTURE_DEFAULT_TIMEOUT  1000
+#endif
+
+#ifndef CAPTURE_DEFAULT_QUEUE
+#   define CAPTURE_DEFAULT_QUEUE    64
+#endif
+
+/* Bytes per SC16 Q11 sample */
+#define CAPTURE_SAMPLE_SIZE (2 * sizeof(int16_t))
+
+#ifndef NSEC_PER_SEC
+#   define NSEC_PER_SEC 1000000000
+#endif
+
+struct capture_dev;
+
+struct capture_buf {
+    struct capture_buf *next;
+    struct capture_dev *dev;        /* Device whose samples these are */
+    unsigned int count;             /* # of samples held */
+    int16_t *samples;
+};
+
+/* FIFO of buffers */
+struct capture_queue {
+    struct capture_buf *head;
+    struct capture_buf *tail;
+};
+
+struct capture_writer {
+    struct capture *cap;
+    pthread_t thread;
+    bool started;
+
+    uint64_t disk;                  /* Device ID of the disk written to */
+    struct capture_queue queue;     /* Buffers awaiting writing */
+    unsigned int producers;         /* RX threads still queuing buffers */
+    pthread_cond_t cond;            /* Signals queue and producer changes */
+
+    bool failed;                    /* A write failed */
+    int error;                      /* errno value of the failed write */
+};
+
+struct capture_dev {
+    struct capture *cap;
+    char *id;                       /* Device identifier */
+    char *path;                     /* Output file */
+    struct bladerf *dev;
+
+    FILE *file;
+    struct capture_writer *writer;
+    pthread_t thread;
+    bool started;
+    bool enabled;                   /* RX module enabled outside of a
+                                     * multi-device session */
+
+    struct capture_buf *bufs;       /* Pool of bufs[0..queue], where
+                                     * bufs[queue] is a spare into which
+                                     * discarded samples are received */
+    int16_t *samples;
+    struct capture_queue free;      /* Buffers available for samples */
+
+    uint64_t start;                 /* Start timestamp, if aligned */
+    double uncertainty_us;
+
+    /* Statistics, accessed while holding the capture's lock */
+    uint64_t received;              /* # of samples written to `free` bufs */
+    uint64_t discarded;             /* # of samples with no buffer free */
+    unsigned int overruns;          /* # of reads that reported overruns */
+    int status;                     /* First RX error, BLADERF_ERR_* */
+};
+
+struct capture_params {
+    uint64_t n;                     /* Samples per device, 0 = unlimited */
+    unsigned int buffers;
+    unsigned int samples;
+    unsigned int xfers;
+    unsigned int timeout_ms;
+    unsigned int queue;             /* Buffers in each device's pool */
+
+    unsigned int samplerate;        /* Settings applied at start, */
+    unsigned int frequency;         /* if nonzero */
+    unsigned int bandwidth;
+    bool gain_set;
+    int gain;
+
+    bool align;                     /* Align via a multi-device session */
+    bladerf_multi_align align_method;
+    bool mimo_clock;
+};
+
+struct capture {
+    struct capture_dev devs[CAPTURE_MAX_DEVS];
+    unsigned int num_devs;
+
+    struct capture_writer writers[CAPTURE_MAX_DEVS];
+    unsigned int num_writers;
+
+    struct capture_params params;
+    struct bladerf_multi *multi;
+
+    pthread_mutex_t lock;
+    pthread_cond_t done;            /* Signalled as writers finish */
+    bool running;                   /* Threads have been started */
+    bool stop;                      /* Threads should stop */
+    unsigned int writers_active;
+    bool waiting;                   /* A "capture wait" is blocked */
+};
+
+static void queue_push(struct capture_queue *q, struct capture_buf *buf)
+{
+    buf->next = NULL;
+
+    if (q->tail == NULL) {
+        q->head = buf;
+    } else {
+        q->tail->next = buf;
+    }
+
+    q->tail = buf;
+}
+
+static struct capture_buf *queue_pop(struct capture_queue *q)
+{
+    struct capture_buf *buf = q->head;
+
+    if (buf != NULL) {
+        q->head = buf->next;
+        if (q->head == NULL) {
+            q->tail = NULL;
+        }
+    }
+
+    return buf;
+}
+
+static void *capture_rx_task(void *arg)
+{
+    struct capture_dev *d = (struct capture_dev *) arg;
+    struct capture *cap = d->cap;
+    const struct capture_params *p = &cap->params;
+    struct capture_buf *spare = &d->bufs[p->queue];
+    struct capture_writer *w = d->writer;
+    struct bladerf_metadata meta;
+    uint64_t remaining = p->n;
+    bool first = true;
+    bool stop;
+    int status = 0;
+
+    MUTEX_LOCK(&cap->lock);
+    stop = cap->stop;
+    MUTEX_UNLOCK(&cap->lock);
+
+    while (!stop && (p->n == 0 || remaining != 0)) {
+        struct capture_buf *buf;
+        unsigned int to_rx = p->samples;
+
+        if (p->n != 0 && remaining < to_rx) {
+            to_rx = (unsigned int) remaining;
+        }
+
+        MUTEX_LOCK(&cap->lock);
+        buf = queue_pop(&d->free);
+        MUTEX_UNLOCK(&cap->lock);
+
+        if (buf == NULL) {
+            buf = spare;
+        }
+
+        memset(&meta, 0, sizeof(meta));
+        if (first && p->align) {
+            /* Samples preceding the start are discarded by the library */
+            meta.timestamp = d->start;
+        } else {
+            meta.flags = BLADERF_META_FLAG_RX_NOW;
+        }
+
+        status = bladerf_sync_rx(d->dev, buf->samples, to_rx, &meta,
+                                 p->timeout_ms);
+
+        if (status == BLADERF_ERR_TIME_PAST) {
+            /* The start passed before we got to it. Continue with whatever
+             * is available now. */
+            meta.flags = BLADERF_META_FLAG_RX_NOW;
+            meta.status = BLADERF_META_STATUS_OVERRUN;
+            status = bladerf_sync_rx(d->dev, buf->samples, to_rx, &meta,
+                                     p->timeout_ms);
+        }
+
+        if (status != 0) {
+            if (buf != spare) {
+                MUTEX_LOCK(&cap->lock);
+                queue_push(&d->free, buf);
+                MUTEX_UNLOCK(&cap->lock);
+            }
+            break;
+        }
+
+        first = false;
+        buf->count = meta.actual_count;
+
+        if (p->n != 0) {
+            remaining -= meta.actual_count;
+        }
+
+        MUTEX_LOCK(&cap->lock);
+
+        if (meta.status & BLADERF_META_STATUS_OVERRUN) {
+            d->overruns++;
+        }
+
+        if (buf == spare) {
+            d->discarded += buf->count;
+        } else {
+            d->received += buf->count;
+            queue_push(&w->queue, buf);
+            pthread_cond_signal(&w->cond);
+        }
+
+        stop = cap->stop;
+        MUTEX_UNLOCK(&cap->lock);
+    }
+
+    MUTEX_LOCK(&cap->lock);
+    d->status = status;
+    w->producers--;
+    pthread_cond_signal(&w->cond);
+    MUTEX_UNLOCK(&cap->lock);
+
+    return NULL;
+}
+
+static void *capture_writer_task(void *arg)
+{
+    struct capture_writer *w = (struct capture_writer *) arg;
+    struct capture *cap = w->cap;
+    struct capture_buf *buf;
+    bool failed = false;
+
+    MUTEX_LOCK(&cap->lock);
+
+    for (;;) {
+        while (w->queue.head == NULL && w->producers != 0) {
+            pthread_cond_wait(&w->cond, &cap->lock);
+        }
+
+        buf = queue_pop(&w->queue);
+        if (buf == NULL) {
+            break;
+        }
+
+        MUTEX_UNLOCK(&cap->lock);
+
+        /* Once a write has failed, buffers are only returned, until every
+         * device has stopped */
+        if (!failed && fwrite(buf->samples, CAPTURE_SAMPLE_SIZE, buf->count,
+                              buf->dev->file) != buf->count) {
+            failed = true;
+        }
+
+        MUTEX_LOCK(&cap->lock);
+        queue_push(&buf->dev->free, buf);
+
+        if (failed && !w->failed) {
+            w->failed = true;
+            w->error = errno;
+            cap->stop = true;
+        }
+    }
+
+    cap->writers_active--;
+    pthread_cond_broadcast(&cap->done);
+    MUTEX_UNLOCK(&cap->lock);
+
+    return NULL;
+}
+
+static void capture_params_init(struct capture_params *p)
+{
+    memset(p, 0, sizeof(*p));
+    p->buffers = CAPTURE_DEFAULT_BUFFERS;
+    p->samples = CAPTURE_DEFAULT_SAMPLES;
+    p->xfers = CAPTURE_DEFAULT_XFERS;
+    p->timeout_ms = CAPTURE_DEFAULT_TIMEOUT;
+    p->queue = CAPTURE_DEFAULT_QUEUE;
+    p->align_method = BLADERF_MULTI_ALIGN_TIMESTAMP;
+}
+
+static struct capture *capture_alloc(void)
+{
+    struct capture *cap = calloc(1, sizeof(*cap));
+
+    if (cap != NULL) {
+        MUTEX_INIT(&cap->lock);
+        pthread_cond_init(&cap->done, NULL);
+        capture_params_init(&cap->params);
+    }
+
+    return cap;
+}
+
+/* Wait for a started capture's threads, disable the devices' RX modules, and
+ * close the files. The capture's statistics are kept until the next start. */
+static void capture_finish(struct capture *cap)
+{
+    unsigned int i;
+
+    if (!cap->running) {
+        return;
+    }
+
+    MUTEX_LOCK(&cap->lock);
+    cap->stop = true;
+    MUTEX_UNLOCK(&cap->lock);
+
+    for (i = 0; i < cap->num_devs; i++) {
+        struct capture_dev *d = &cap->devs[i];
+
+        if (d->started) {
+            pthread_join(d->thread, NULL);
+            d->started = false;
+        }
+    }
+
+    for (i = 0; i < cap->num_writers; i++) {
+        struct capture_writer *w = &cap->writers[i];
+
+        if (w->started) {
+            pthread_join(w->thread, NULL);
+            w->started = false;
+        }
+
+        pthread_cond_destroy(&w->cond);
+    }
+
+    bladerf_multi_deinit(cap->multi);
+    cap->multi = NULL;
+
+    for (i = 0; i < cap->num_devs; i++) {
+        struct capture_dev *d = &cap->devs[i];
+
+        if (d->enabled) {
+            bladerf_enable_module(d->dev, BLADERF_MODULE_RX, false);
+            d->enabled = false;
+        }
+
+        if (d->file != NULL) {
+            fclose(d->file);
+            d->file = NULL;
+        }
+
+        free(d->bufs);
+        free(d->samples);
+        d->bufs = NULL;
+        d->samples = NULL;
+    }
+
+    cap->running = false;
+}
+
+static void capture_clear(struct capture *cap)
+{
+    unsigned int i;
+
+    capture_finish(cap);
+
+    for (i = 0; i < cap->num_devs; i++) {
+        bladerf_close(cap->devs[i].dev);
+        free(cap->devs[i].id);
+        free(cap->devs[i].path);
+    }
+
+    memset(cap->devs, 0, sizeof(cap->devs));
+    cap->num_devs = 0;
+}
+
+void capture_free(struct capture *cap)
+{
+    if (cap != NULL) {
+        capture_clear(cap);
+        pthread_cond_destroy(&cap->done);
+        pthread_mutex_destroy(&cap->lock);
+        free(cap);
+    }
+}
+
+bool capture_release_wait(struct capture *cap)
+{
+    bool was_waiting = false;
+
+    if (cap != NULL) {
+        MUTEX_LOCK(&cap->lock);
+        was_waiting = cap->waiting;
+        cap->waiting = false;
+        pthread_cond_broadcast(&cap->done);
+        MUTEX_UNLOCK(&cap->lock);
+    }
+
+    return was_waiting;
+}
+
+static bool capture_done(struct capture *cap)
+{
+    bool done;
+
+    MUTEX_LOCK(&cap->lock);
+    done = cap->writers_active == 0;
+    MUTEX_UNLOCK(&cap->lock);
+
+    return done;
+}
+
+/* Open the device's file, and assign it to the writer of the file's disk */
+static int capture_open_file(struct cli_state *s, struct capture *cap,
+                             struct capture_dev *d)
+{
+    struct stat st;
+    unsigned int i;
+    int status;
+
+    status = expand_and_open(d->path, "wb", &d->file);
+    if (status != 0) {
+        cli_err(s, "capture", "Failed to open %s\n", d->path);
+        return CLI_RET_CMD_HANDLED;
+    }
+
+    /* Buffers are large enough that stdio's buffering only adds a copy */
+    setvbuf(d->file, NULL, _IONBF, 0);
+
+    if (fstat(fileno(d->file), &st) != 0) {
+        cli_err(s, "capture", "Failed to stat %s: %s\n", d->path,
+                strerror(errno));
+        return CLI_RET_CMD_HANDLED;
+    }
+
+    for (i = 0; i < cap->num_writers; i++) {
+        if (cap->writers[i].disk == (uint64_t) st.st_dev) {
+            d->writer = &cap->writers[i];
+            return 0;
+        }
+    }
+
+    d->writer = &cap->writers[cap->num_writers++];
+    memset(d->writer, 0, sizeof(*d->writer));
+    d->writer->cap = cap;
+    d->writer->disk = (uint64_t) st.st_dev;
+    pthread_cond_init(&d->writer->cond, NULL);
+
+    return 0;
+}
+
+static int capture_alloc_bufs(struct capture *cap, struct capture_dev *d)
+{
+    const struct capture_params *p = &cap->params;
+    unsigned int i;
+
+    d->bufs = calloc(p->queue + 1, sizeof(d->bufs[0]));
+    d->samples = malloc((size_t) (p->queue + 1) * p->samples *
+                        CAPTURE_SAMPLE_SIZE);
+
+    if (d->bufs == NULL || d->samples == NULL) {
+        return CLI_RET_MEM;
+    }
+
+    memset(&d->free, 0, sizeof(d->free));
+
+    for (i = 0; i <= p->queue; i++) {
+        d->bufs[i].dev = d;
+        d->bufs[i].samples = d->samples + (size_t) 2 * i * p->samples;
+
+        if (i < p->queue) {
+            queue_push(&d->free, &d->bufs[i]);
+        }
+    }
+
+    return 0;
+}
+
+/* Apply the configured settings to each device */
+static int capture_apply_settings(struct cli_state *s, struct capture *cap)
+{
+    const struct capture_params *p = &cap->params;
+    unsigned int i, actual;
+    int status = 0;
+
+    for (i = 0; i < cap->num_devs && status == 0; i++) {
+        struct bladerf *dev = cap->devs[i].dev;
+
+        if (p->samplerate != 0) {
+            status = bladerf_set_sample_rate(dev, BLADERF_MODULE_RX,
+                                             p->samplerate, &actual);
+        }
+
+        if (status == 0 && p->frequency != 0) {
+            status = bladerf_set_frequency(dev, BLADERF_MODULE_RX,
+                                           p->frequency);
+        }
+
+        if (status == 0 && p->bandwidth != 0) {
+            status = bladerf_set_bandwidth(dev, BLADERF_MODULE_RX,
+                                           p->bandwidth, &actual);
+        }
+
+        if (status == 0 && p->gain_set) {
+            status = bladerf_set_gain(dev, BLADERF_MODULE_RX, p->gain);
+        }
+
+        if (status != 0) {
+            cli_err(s, "capture", "Failed to configure device %u: %s\n",
+                    i, bladerf_strerror(status));
+        }
+    }
+
+    return status == 0 ? 0 : CLI_RET_CMD_HANDLED;
+}
+
+/* Configure and enable each device's stream. With alignment, this is through
+ * a multi-device session, and each RX thread begins at the device's start
+ * timestamp. */
+static int capture_start_streams(struct cli_state *s, struct capture *cap)
+{
+    const struct capture_params *p = &cap->params;
+    struct bladerf *devs[CAPTURE_MAX_DEVS];
+    struct bladerf_multi_config config;
+    unsigned int i;
+    int status = 0;
+
+    if (!p->align) {
+        for (i = 0; i < cap->num_devs && status == 0; i++) {
+            struct capture_dev *d = &cap->devs[i];
+
+            status = bladerf_sync_config(d->dev, BLADERF_MODULE_RX,
+                                         BLADERF_FORMAT_SC16_Q11_META,
+                                         p->buffers, p->samples, p->xfers,
+                                         p->timeout_ms);
+
+            if (status == 0) {
+                status = bladerf_enable_module(d->dev, BLADERF_MODULE_RX,
+                                               true);
+                d->enabled = (status == 0);
+            }
+        }
+
+        goto out;
+    }
+
+    for (i = 0; i < cap->num_devs; i++) {
+        devs[i] = cap->devs[i].dev;
+    }
+
+    memset(&config, 0, sizeof(config));
+    config.module = BLADERF_MODULE_RX;
+    config.num_buffers = p->buffers;
+    config.buffer_size = p->samples;
+    config.num_transfers = p->xfers;
+    config.stream_timeout = p->timeout_ms;
+    config.mimo_clock = p->mimo_clock;
+    config.align = p->align_method;
+
+    status = bladerf_multi_init(&cap->multi, devs, cap->num_devs, &config);
+
+    if (status == 0) {
+        status = bladerf_multi_start(cap->multi);
+    }
+
+    for (i = 0; i < cap->num_devs && status == 0; i++) {
+        status = bladerf_multi_get_start(cap->multi, i, &cap->devs[i].start,
+                                         &cap->devs[i].uncertainty_us);
+    }
+
+out:
+    if (status != 0) {
+        cli_err(s, "capture", "Failed to start streaming: %s\n",
+                bladerf_strerror(status));
+        return CLI_RET_CMD_HANDLED;
+    }
+
+    return 0;
+}
+
+static int capture_start(struct cli_state *s, struct capture *cap)
+{
+    unsigned int i;
+    int status;
+
+    if (cap->running) {
+        if (!capture_done(cap)) {
+            cli_err(s, "capture", "A capture is already running.\n");
+            return CLI_RET_STATE;
+        }
+
+        capture_finish(cap);
+    }
+
+    if (cap->num_devs == 0) {
+        cli_err(s, "capture", "No devices have been added.\n");
+        return CLI_RET_STATE;
+    }
+
+    status = capture_apply_settings(s, cap);
+    if (status != 0) {
+        return status;
+    }
+
+    cap->running = true;
+    cap->stop = false;
+    cap->num_writers = 0;
+
+    for (i = 0; i < cap->num_devs && status == 0; i++) {
+        struct capture_dev *d = &cap->devs[i];
+
+        d->writer = NULL;
+        d->received = 0;
+        d->discarded = 0;
+        d->overruns = 0;
+        d->status = 0;
+        d->start = 0;
+        d->uncertainty_us = 0;
+
+        status = capture_open_file(s, cap, d);
+        if (status == 0) {
+            status = capture_alloc_bufs(cap, d);
+        }
+    }
+
+    if (status == 0) {
+        status = capture_start_streams(s, cap);
+    }
+
+    if (status != 0) {
+        capture_finish(cap);
+        return status;
+    }
+
+    for (i = 0; i < cap->num_devs; i++) {
+        cap->devs[i].writer->producers++;
+    }
+
+    cap->writers_active = 0;
+
+    for (i = 0; i < cap->num_writers && status == 0; i++) {
+        struct capture_writer *w = &cap->writers[i];
+
+        status = pthread_create(&w->thread, NULL, capture_writer_task, w);
+        if (status == 0) {
+            w->started = true;
+            cap->writers_active++;
+        }
+    }
+
+    for (i = 0; i < cap->num_devs && status == 0; i++) {
+        struct capture_dev *d = &cap->devs[i];
+
+        status = pthread_create(&d->thread, NULL, capture_rx_task, d);
+        if (status == 0) {
+            d->started = true;
+        }
+    }
+
+    if (status != 0) {
+        /* Writers of the devices that were not started still count them
+         * as producers */
+        MUTEX_LOCK(&cap->lock);
+        for (i = 0; i < cap->num_devs; i++) {
+            if (!cap->devs[i].started) {
+                cap->devs[i].writer->producers--;
+                pthread_cond_signal(&cap->devs[i].writer->cond);
+            }
+        }
+        MUTEX_UNLOCK(&cap->lock);
+
+        cli_err(s, "capture", "Failed to start capture threads.\n");
+        capture_finish(cap);
+        return CLI_RET_CMD_HANDLED;
+    }
+
+    printf("\n  Capturing from %u device%s, with %u writer%s.\n\n",
+           cap->num_devs, cap->num_devs == 1 ? "" : "s",
+           cap->num_writers, cap->num_writers == 1 ? "" : "s");
+
+    return 0;
+}
+
+static void capture_print_results(struct capture *cap)
+{
+    unsigned int i;
+
+    printf("\n");
+
+    MUTEX_LOCK(&cap->lock);
+    for (i = 0; i < cap->num_devs; i++) {
+        const struct capture_dev *d = &cap->devs[i];
+
+        printf("  [%u] %s -> %s", i, d->id, d->path);
+        if (d->writer != NULL) {
+            printf(" (writer %u)", (unsigned int) (d->writer - cap->writers));
+        }
+        printf("\n");
+
+        if (d->writer == NULL) {
+            /* Not yet part of a capture */
+            continue;
+        }
+
+        if (cap->params.align) {
+            printf("      Start: %" PRIu64 " (+/- %.1f us)\n", d->start,
+                   d->uncertainty_us);
+        }
+
+        printf("      Samples: %" PRIu64 ", overruns: %u, discarded: %"
+               PRIu64 "\n", d->received, d->overruns, d->discarded);
+
+        if (d->status != 0) {
+            printf("      Error: %s\n", bladerf_strerror(d->status));
+        }
+
+        if (d->writer->failed) {
+            printf("      Error: Failed to write to file: %s\n",
+                   strerror(d->writer->error));
+        }
+    }
+    MUTEX_UNLOCK(&cap->lock);
+
+    printf("\n");
+}
+
+static void capture_print_state(struct capture *cap)
+{
+    const struct capture_params *p = &cap->params;
+
+    printf("\n  State: %s\n", !cap->running ? "Idle" :
+           capture_done(cap) ? "Done" : "Running");
+
+    if (p->n) {
+        printf("  # Samples: %" PRIu64 " per device\n", p->n);
+    } else {
+        printf("  # Samples: infinite\n");
+    }
+
+    printf("  # Buffers: %u\n", p->buffers);
+    printf("  # Samples per buffer: %u\n", p->samples);
+    printf("  # Transfers: %u\n", p->xfers);
+    printf("  Timeout (ms): %u\n", p->timeout_ms);
+    printf("  Queue: %u buffers per device\n", p->queue);
+
+    if (p->samplerate) {
+        printf("  Sample rate: %u\n", p->samplerate);
+    }
+
+    if (p->frequency) {
+        printf("  Frequency: %u\n", p->frequency);
+    }
+
+    if (p->bandwidth) {
+        printf("  Bandwidth: %u\n", p->bandwidth);
+    }
+
+    if (p->gain_set) {
+        printf("  Gain: %d\n", p->gain);
+    }
+
+    if (p->align) {
+        printf("  Alignment: %s%s\n",
+               p->align_method == BLADERF_MULTI_ALIGN_TIMESTAMP ?
+               "timestamp" : "host clock",
+               p->mimo_clock ? ", MIMO clock" : "");
+    } else {
+        printf("  Alignment: off\n");
+    }
+
+    capture_print_results(cap);
+}
+
+static int capture_config(struct cli_state *s, struct capture *cap,
+                          int argc, char **argv)
+{
+    struct capture_params *p = &cap->params;
+    int i;
+    bool ok;
+
+    if (argc == 2) {
+        capture_print_state(cap);
+        return 0;
+    }
+
+    if (cap->running && !capture_done(cap)) {
+        cli_err(s, argv[0], "Cannot configure a running capture.\n");
+        return CLI_RET_STATE;
+    }
+
+    for (i = 2; i < argc; i++) {
+        char *val = strchr(argv[i], '=');
+
+        if (val == NULL) {
+            cli_err(s, argv[0], "Expected <param>=<value>: %s\n", argv[i]);
+            return CLI_RET_INVPARAM;
+        }
+
+        *val++ = '\0';
+
+        if (!strcasecmp(argv[i], "n")) {
+            p->n = str2uint64_suffix(val, 0, UINT64_MAX, freq_suffixes,
+                                     NUM_FREQ_SUFFIXES, &ok);
+        } else if (!strcasecmp(argv[i], "buffers")) {
+            p->buffers = str2uint_suffix(val, 4, UINT_MAX, freq_suffixes,
+                                         NUM_FREQ_SUFFIXES, &ok);
+        } else if (!strcasecmp(argv[i], "samples")) {
+            p->samples = str2uint_suffix(val, 1024, UINT_MAX / 4,
+                                         freq_suffixes, NUM_FREQ_SUFFIXES,
+                                         &ok);
+            ok = ok && (p->samples % 1024) == 0;
+        } else if (!strcasecmp(argv[i], "xfers")) {
+            p->xfers = str2uint_suffix(val, 1, UINT_MAX, freq_suffixes,
+                                       NUM_FREQ_SUFFIXES, &ok);
+        } else if (!strcasecmp(argv[i], "timeout")) {
+            p->timeout_ms = str2uint(val, 1, UINT_MAX, &ok);
+        } else if (!strcasecmp(argv[i], "queue")) {
+            p->queue = str2uint(val, 1, 65536, &ok);
+        } else if (!strcasecmp(argv[i], "samplerate")) {
+            p->samplerate = str2uint_suffix(val, BLADERF_SAMPLERATE_MIN,
+                                            BLADERF_SAMPLERATE_REC_MAX,
+                                            freq_suffixes, NUM_FREQ_SUFFIXES,
+                                            &ok);
+        } else if (!strcasecmp(argv[i], "frequency")) {
+            p->frequency = str2uint_suffix(val, BLADERF_FREQUENCY_MIN,
+                                           BLADERF_FREQUENCY_MAX,
+                                           freq_suffixes, NUM_FREQ_SUFFIXES,
+                                           &ok);
+        } else if (!strcasecmp(argv[i], "bandwidth")) {
+            p->bandwidth = str2uint_suffix(val, BLADERF_BANDWIDTH_MIN,
+                                           BLADERF_BANDWIDTH_MAX,
+                                           freq_suffixes, NUM_FREQ_SUFFIXES,
+                                           &ok);
+        } else if (!strcasecmp(argv[i], "gain")) {
+            if (!strcasecmp(val, "off")) {
+                p->gain_set = false;
+                ok = true;
+            } else {
+                p->gain = str2int(val, INT_MIN, INT_MAX, &ok);
+                p->gain_set = ok;
+            }
+        } else if (!strcasecmp(argv[i], "align")) {
+            ok = true;
+            if (!strcasecmp(val, "off")) {
+                p->align = false;
+            } else if (!strcasecmp(val, "timestamp")) {
+                p->align = true;
+                p->align_method = BLADERF_MULTI_ALIGN_TIMESTAMP;
+            } else if (!strcasecmp(val, "host")) {
+                p->align = true;
+                p->align_method = BLADERF_MULTI_ALIGN_HOST_CLOCK;
+            } else {
+                ok = false;
+            }
+        } else if (!strcasecmp(argv[i], "mimo")) {
+            ok = true;
+            if (!strcasecmp(val, "on")) {
+                p->mimo_clock = true;
+            } else if (!strcasecmp(val, "off")) {
+                p->mimo_clock = false;
+            } else {
+                ok = false;
+            }
+        } else {
+            cli_err(s, argv[0], "Invalid parameter: %s\n", argv[i]);
+            return CLI_RET_INVPARAM;
+        }
+
+        if (!ok) {
+            cli_err(s, argv[0], "Invalid %s value: %s\n", argv[i], val);
+            return CLI_RET_INVPARAM;
+        }
+    }
+
+    if (p->xfers >= p->buffers) {
+        cli_err(s, argv[0], "The number of transfers must be less than the "
+                "number of buffers.\n");
+        return CLI_RET_INVPARAM;
+    }
+
+    return 0;
+}
+
+/* Open the devices of <device> <file> pairs, concurrently */
+static int capture_add(struct cli_state *s, struct capture *cap,
+                       int argc, char **argv)
+{
+    struct bladerf_devinfo info[CAPTURE_MAX_DEVS];
+    struct bladerf *devs[CAPTURE_MAX_DEVS];
+    int statuses[CAPTURE_MAX_DEVS];
+    unsigned int n, i;
+    int status;
+
+    if (argc < 4 || (argc % 2) != 0) {
+        return CLI_RET_NARGS;
+    }
+
+    if (cap->running) {
+        cli_err(s, argv[0], "Stop the capture before adding devices.\n");
+        return CLI_RET_STATE;
+    }
+
+    n = (unsigned int) (argc - 2) / 2;
+    if (cap->num_devs + n > CAPTURE_MAX_DEVS) {
+        cli_err(s, argv[0], "At most %u devices may be added.\n",
+                CAPTURE_MAX_DEVS);
+        return CLI_RET_INVPARAM;
+    }
+
+    for (i = 0; i < n; i++) {
+        status = bladerf_get_devinfo_from_str(argv[2 + 2 * i], &info[i]);
+        if (status != 0) {
+            cli_err(s, argv[0], "Invalid device identifier: %s\n",
+                    argv[2 + 2 * i]);
+            return CLI_RET_INVPARAM;
+        }
+    }
+
+    status = bladerf_open_many(devs, info, statuses, n);
+    if (status < 0) {
+        s->last_lib_error = status;
+        return CLI_RET_LIBBLADERF;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (devs[i] == NULL) {
+            cli_err(s, argv[0], "Failed to open %s: %s\n", argv[2 + 2 * i],
+                    bladerf_strerror(statuses[i]));
+            status = CLI_RET_CMD_HANDLED;
+        }
+    }
+
+    if (status == CLI_RET_CMD_HANDLED) {
+        for (i = 0; i < n; i++) {
+            if (devs[i] != NULL) {
+                bladerf_close(devs[i]);
+            }
+        }
+        return status;
+    }
+
+    for (i = 0; i < n; i++) {
+        struct capture_dev *d = &cap->devs[cap->num_devs];
+
+        memset(d, 0, sizeof(*d));
+        d->cap = cap;
+        d->dev = devs[i];
+        d->id = strdup(argv[2 + 2 * i]);
+        d->path = strdup(argv[3 + 2 * i]);
+
+        if (d->id == NULL || d->path == NULL) {
+            free(d->id);
+            free(d->path);
+            for ( ; i < n; i++) {
+                bladerf_close(devs[i]);
+            }
+            return CLI_RET_MEM;
+        }
+
+        cap->num_devs++;
+    }
+
+    return 0;
+}
+
+static int capture_wait(struct cli_state *s, struct capture *cap,
+                        int argc, char **argv)
+{
+    bool ok;
+    unsigned int timeout_ms = 0;
+    struct timespec timeout_abs;
+    int status = 0;
+
+    static const struct numeric_suffix times[] = {
+        { "ms", 1 },
+        { "s", 1000 },
+        { "m", 60 * 1000 },
+        { "h", 60 * 60 * 1000 },
+    };
+
+    if (argc > 3) {
+        return CLI_RET_NARGS;
+    }
+
+    if (argc == 3) {
+        timeout_ms = str2uint_suffix(argv[2], 0, UINT_MAX, times,
+                                     sizeof(times)/sizeof(times[0]), &ok);
+
+        if (!ok) {
+            cli_err(s, argv[0], "Invalid wait timeout: \"%s\"\n", argv[2]);
+            return CLI_RET_INVPARAM;
+        }
+    }
+
+    if (!cap->running) {
+        return 0;
+    }
+
+    if (timeout_ms != 0) {
+        status = clock_gettime(CLOCK_REALTIME, &timeout_abs);
+        if (status != 0) {
+            return CLI_RET_UNKNOWN;
+        }
+
+        timeout_abs.tv_sec += timeout_ms / 1000;
+        timeout_abs.tv_nsec += (timeout_ms % 1000) * 1000 * 1000;
+
+        if (timeout_abs.tv_nsec >= NSEC_PER_SEC) {
+            timeout_abs.tv_sec += timeout_abs.tv_nsec / NSEC_PER_SEC;
+            timeout_abs.tv_nsec %= NSEC_PER_SEC;
+        }
+    }
+
+    /* The capture's threads don't use the device control lock, but release
+     * it anyway, as with "rx wait" */
+    MUTEX_UNLOCK(&s->dev_lock);
+
+    MUTEX_LOCK(&cap->lock);
+    cap->waiting = true;
+
+    while (cap->waiting && cap->writers_active != 0 && status == 0) {
+        if (timeout_ms != 0) {
+            status = pthread_cond_timedwait(&cap->done, &cap->lock,
+                                            &timeout_abs);
+        } else {
+            status = pthread_cond_wait(&cap->done, &cap->lock);
+        }
+    }
+
+    cap->waiting = false;
+    MUTEX_UNLOCK(&cap->lock);
+
+    MUTEX_LOCK(&s->dev_lock);
+
+    if (status != 0 && status != ETIMEDOUT) {
+        return CLI_RET_UNKNOWN;
+    }
+
+    if (capture_done(cap)) {
+        capture_finish(cap);
+        capture_print_results(cap);
+    }
+
+    return 0;
+}
+
+int cmd_capture(struct cli_state *state, int argc, char **argv)
+{
+    struct capture *cap;
+
+    if (state->capture == NULL) {
+        state->capture = capture_alloc();
+        if (state->capture == NULL) {
+            return CLI_RET_MEM;
+        }
+    }
+
+    cap = state->capture;
+
+    if (argc == 1) {
+        capture_print_state(cap);
+        return 0;
+    }
+
+    if (!strcasecmp(argv[1], "add")) {
+        return capture_add(state, cap, argc, argv);
+    } else if (!strcasecmp(argv[1], "clear")) {
+        capture_clear(cap);
+        return 0;
+    } else if (!strcasecmp(argv[1], "config")) {
+        return capture_config(state, cap, argc, argv);
+    } else if (!strcasecmp(argv[1], "start")) {
+        return capture_start(state, cap);
+    } else if (!strcasecmp(argv[1], "stop")) {
+        if (!cap->running) {
+            cli_err(state, argv[0], "No capture is running.\n");
+            return CLI_RET_STATE;
+        }
+
+        capture_finish(cap);
+        capture_print_results(cap);
+        return 0;
+    } else if (!strcasecmp(argv[1], "wait")) {
+        return capture_wait(state, cap, argc, argv);
+    }
+
+    cli_err(state, argv[0], "Invalid command: \"%s\"\n", argv[1]);
+    return CLI_RET_INVPARAM;
+}
@@ -0,0 +1,48 @@
+/*
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef CMD_CAPTURE_H_
+#define CMD_CAPTURE_H_
+
+#include <stdbool.h>
+
+/* Maximum number of devices in a capture */
+#ifndef CAPTURE_MAX_DEVS
+#   define CAPTURE_MAX_DEVS 16
+#endif
+
+struct capture;
+
+/**
+ * Stop any running capture, close the capture's devices, and free it
+ *
+ * @param   cap     Capture state. May be NULL.
+ */
+void capture_free(struct capture *cap);
+
+/**
+ * Unblock a "capture wait" command
+ *
+ * @param   cap     Capture state. May be NULL.
+ *
+ * @return true if a command was waiting
+ */
+bool capture_release_wait(struct capture *cap);
+
+#endif
@@ -31,7 +31,9 @@
 #include "doc/cmd_help.h"
 
 #define DECLARE_CMD(x) int cmd_##x (struct cli_state *, int, char **)
+DECLARE_CMD(bandwidth);
 DECLARE_CMD(calibrate);
+DECLARE_CMD(capture);
 DECLARE_CMD(clear);
 DECLARE_CMD(echo);
 DECLARE_CMD(erase);
@@ -52,8 +54,12 @@ DECLARE_CMD(print);
 DECLARE_CMD(probe);
 DECLARE_CMD(recover);
 DECLARE_CMD(run);
+DECLARE_CMD(serve);
 DECLARE_CMD(set);
 DECLARE_CMD(rx);
+DECLARE_CMD(sweep);
+DECLARE_CMD(trace);
+DECLARE_CMD(trx);
 DECLARE_CMD(tx);
 DECLARE_CMD(version);
 
@@ -70,7 +76,9 @@ struct cmd {
     bool        allow_while_streaming;
 };
 
+static const char *cmd_names_bandwidth[] = { "bandwidth", "bw", NULL };
 static const char *cmd_names_calibrate[] = { "calibrate", "cal", NULL };
+static const char *cmd_names_capture[] = { "capture", NULL };
 static const char *cmd_names_clear[] = { "clear", "cls", NULL };
 static const char *cmd_names_echo[] = { "echo", NULL };
 static const char *cmd_names_erase[] = { "erase", "e", NULL };
@@ -93,11 +101,24 @@ static const char *cmd_names_quit[] = { "quit", "q", "exit", "x", NULL };
 static const char *cmd_names_rec[] = { "recover", "r", NULL };
 static const char *cmd_names_run[] = { "run", NULL };
 static const char *cmd_names_rx[] = { "rx", "receive", NULL };
+static const char *cmd_names_serve[] = { "serve", NULL };
+static const char *cmd_names_sweep[] = { "sweep", NULL };
+static const char *cmd_names_trace[] = { "trace", NULL };
+static const char *cmd_names_trx[] = { "trx", NULL };
 static const char *cmd_names_tx[] = { "tx", "transmit", NULL };
 static const char *cmd_names_set[] = { "set", "s", NULL };
 static const char *cmd_names_ver[] = { "version", "ver", "v", NULL };
 
 static const struct cmd cmd_table[] = {
+    {
+        FIELD_INIT(.names, cmd_names_bandwidth),
+        FIELD_INIT(.exec, cmd_bandwidth),
+        FIELD_INIT(.desc, "Measure USB throughput via the firmware loopback"),
+        FIELD_INIT(.help, CLI_CMD_HELPTEXT_bandwidth),
+        FIELD_INIT(.requires_device, true),
+        FIELD_INIT(.requires_fpga, true),
+        FIELD_INIT(.allow_while_streaming, false),
+    },
     {
         FIELD_INIT(.names, cmd_names_calibrate),
         FIELD_INIT(.exec, cmd_calibrate),
@@ -107,6 +128,15 @@ static const struct cmd cmd_table[] = {
         FIELD_INIT(.requires_fpga, true),
         FIELD_INIT(.allow_while_streaming, false),
     },
+    {
+        FIELD_INIT(.names, cmd_names_capture),
+        FIELD_INIT(.exec, cmd_capture),
+        FIELD_INIT(.desc, "Receive from several devices at once"),
+        FIELD_INIT(.help, CLI_CMD_HELPTEXT_capture),
+        FIELD_INIT(.requires_device, false),
+        FIELD_INIT(.requires_fpga, false),
+        FIELD_INIT(.allow_while_streaming, true),
+    },
     {
         FIELD_INIT(.names, cmd_names_clear),
         FIELD_INIT(.exec, cmd_clear),
@@ -305,6 +335,42 @@ static const struct cmd cmd_table[] = {
         FIELD_INIT(.requires_fpga, true),
         FIELD_INIT(.allow_while_streaming, true),   /* Can rx while tx'ing */
     },
+    {
+        FIELD_INIT(.names, cmd_names_serve),
+        FIELD_INIT(.exec, cmd_serve),
+        FIELD_INIT(.desc, "Serve the device to network backend clients"),
+        FIELD_INIT(.help, CLI_CMD_HELPTEXT_serve),
+        FIELD_INIT(.requires_device, true),
+        FIELD_INIT(.requires_fpga, true),
+        FIELD_INIT(.allow_while_streaming, false),
+    },
+    {
+        FIELD_INIT(.names, cmd_names_sweep),
+        FIELD_INIT(.exec, cmd_sweep),
+        FIELD_INIT(.desc, "Sweep the RX frequency and measure a wideband spectrum"),
+        FIELD_INIT(.help, CLI_CMD_HELPTEXT_sweep),
+        FIELD_INIT(.requires_device, true),
+        FIELD_INIT(.requires_fpga, true),
+        FIELD_INIT(.allow_while_streaming, false),
+    },
+    {
+        FIELD_INIT(.names, cmd_names_trace),
+        FIELD_INIT(.exec, cmd_trace),
+        FIELD_INIT(.desc, "Trace control path USB transactions"),
+        FIELD_INIT(.help, CLI_CMD_HELPTEXT_trace),
+        FIELD_INIT(.requires_device, true),
+        FIELD_INIT(.requires_fpga, false),
+        FIELD_INIT(.allow_while_streaming, true),
+    },
+    {
+        FIELD_INIT(.names, cmd_names_trx),
+        FIELD_INIT(.exec, cmd_trx),
+        FIELD_INIT(.desc, "Start RX and TX together, at a common timestamp"),
+        FIELD_INIT(.help, CLI_CMD_HELPTEXT_trx),
+        FIELD_INIT(.requires_device, true),
+        FIELD_INIT(.requires_fpga, true),
+        FIELD_INIT(.allow_while_streaming, true),
+    },
     {
         FIELD_INIT(.names, cmd_names_tx),
         FIELD_INIT(.exec, cmd_tx),
@@ -30,6 +30,7 @@
 #include "minmax.h"
 #include "conversions.h"
 #include "rel_assert.h"
+#include "flash_pipe.h"
 
 #define lib_error(status, ...) do { \
     state->last_lib_error = (status); \
@@ -37,15 +38,43 @@
     status = CLI_RET_LIBBLADERF; \
 } while (0)
 
+/* Flash is read one erase block at a time */
+#define BACKUP_CHUNK_LEN BLADERF_FLASH_EB_SIZE
+
+/* Write chunks of the image to its file, as they are read from flash */
+static int write_chunks(struct flash_pipe *pipe, void *arg)
+{
+    struct bladerf_image_stream *stream = (struct bladerf_image_stream *) arg;
+    uint8_t *chunk;
+    size_t len;
+    int status;
+
+    while ((chunk = flash_pipe_receive(pipe, &len)) != NULL) {
+        status = bladerf_image_stream_write(stream, chunk, len);
+        if (status != 0) {
+            return status;
+        }
+
+        flash_pipe_release(pipe);
+    }
+
+    return 0;
+}
+
 int cmd_flash_backup(struct cli_state *state, int argc, char **argv)
 {
     int status = 0;
     struct bladerf_devinfo info;
     struct bladerf_image *image = NULL;
+    struct bladerf_image_stream *stream = NULL;
+    struct flash_pipe *pipe = NULL;
     bladerf_image_type image_type;
-    uint32_t address, length, page, count;
+    uint32_t address, length, page, count, offset, n;
+    uint8_t *chunk;
     char *filename = NULL;
     bool ok;
+    bool created = false;
+    int write_status;
 
     if (argc != 3 && argc != 4) {
         return CLI_RET_NARGS;
@@ -95,7 +124,8 @@ int cmd_flash_backup(struct cli_state *state, int argc, char **argv)
         image_type = BLADERF_IMAGE_TYPE_RAW;
     }
 
-    image = bladerf_alloc_image(image_type, address, length);
+    /* The data is streamed to the file, rather than held in the image */
+    image = bladerf_alloc_image(image_type, address, 0);
     if (!image) {
         status = CLI_RET_MEM;
         goto out;
@@ -108,24 +138,73 @@ int cmd_flash_backup(struct cli_state *state, int argc, char **argv)
     }
 
     strncpy(image->serial, info.serial, BLADERF_SERIAL_LENGTH);
+    image->length = length;
 
-    page = BLADERF_FLASH_TO_PAGES(address);
-    count = BLADERF_FLASH_TO_PAGES(length);
+    status = bladerf_image_stream_create(&stream, image, filename);
+    if (status < 0) {
+        lib_error(status, "Failed to create image file.");
+        goto out;
+    }
+
+    created = true;
+
+    pipe = flash_pipe_start(BACKUP_CHUNK_LEN, write_chunks, stream);
+    if (!pipe) {
+        status = CLI_RET_MEM;
+        goto out;
+    }
 
+    /* Read the next chunk from flash while the previous ones are written,
+     * and checksummed, by the pipe's thread */
+    for (offset = 0; offset < length; offset += n) {
+        n = u32_min(length - offset, BACKUP_CHUNK_LEN);
+
+        chunk = flash_pipe_acquire(pipe);
+        if (!chunk) {
+            break;
+        }
+
+        page = BLADERF_FLASH_TO_PAGES(address + offset);
+        count = BLADERF_FLASH_TO_PAGES(n);
+
+        status = bladerf_read_flash(state->dev, chunk, page, count);
+        if (status < 0) {
+            flash_pipe_abort(pipe);
+            break;
+        }
+
+        flash_pipe_submit(pipe, n);
+    }
+
+    flash_pipe_close(pipe);
+    write_status = flash_pipe_finish(pipe);
 
-    status = bladerf_read_flash(state->dev, image->data, page, count);
     if (status < 0) {
         lib_error(status, "Failed to read flash region");
         goto out;
     }
 
-    status = bladerf_image_write(image, filename);
-    if (status < 0) {
+    if (write_status == 0) {
+        write_status = bladerf_image_stream_close(stream);
+    } else {
+        bladerf_image_stream_close(stream);
+    }
+    stream = NULL;
+
+    if (write_status < 0) {
+        status = write_status;
         lib_error(status, "Failed to write image file.");
         goto out;
     }
 
 out:
+    bladerf_image_stream_close(stream);
+
+    /* Don't leave an incomplete image behind */
+    if (status != 0 && created) {
+        remove(filename);
+    }
+
     if (image) {
         bladerf_free_image(image);
     }
@@ -0,0 +1,182 @@
+/*
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdlib.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "flash_pipe.h"
+
+struct flash_pipe {
+    pthread_t thread;
+    flash_pipe_fn fn;
+    void *arg;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;            /* Signals changes to the fields below */
+
+    uint8_t *chunks[FLASH_PIPE_CHUNKS];
+    size_t lens[FLASH_PIPE_CHUNKS];
+    size_t chunk_len;
+    unsigned int head;              /* Next chunk to receive */
+    unsigned int tail;              /* Next chunk to acquire */
+    unsigned int filled;            /* Chunks submitted, but not released */
+    bool closed;
+    bool aborted;
+};
+
+static void *flash_pipe_thread(void *arg)
+{
+    struct flash_pipe *pipe = (struct flash_pipe *) arg;
+    int status = pipe->fn(pipe, pipe->arg);
+
+    if (status != 0) {
+        flash_pipe_abort(pipe);
+    }
+
+    return (void *) (intptr_t) status;
+}
+
+static void flash_pipe_free(struct flash_pipe *pipe)
+{
+    unsigned int i;
+
+    for (i = 0; i < FLASH_PIPE_CHUNKS; i++) {
+        free(pipe->chunks[i]);
+    }
+
+    pthread_cond_destroy(&pipe->cond);
+    pthread_mutex_destroy(&pipe->lock);
+    free(pipe);
+}
+
+struct flash_pipe *flash_pipe_start(size_t chunk_len,
+                                    flash_pipe_fn fn, void *arg)
+{
+    struct flash_pipe *pipe;
+    unsigned int i;
+
+    pipe = (struct flash_pipe *) calloc(1, sizeof(*pipe));
+    if (pipe == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&pipe->lock, NULL);
+    pthread_cond_init(&pipe->cond, NULL);
+    pipe->fn = fn;
+    pipe->arg = arg;
+    pipe->chunk_len = chunk_len;
+
+    for (i = 0; i < FLASH_PIPE_CHUNKS; i++) {
+        pipe->chunks[i] = (uint8_t *) malloc(chunk_len);
+        if (pipe->chunks[i] == NULL) {
+            flash_pipe_free(pipe);
+            return NULL;
+        }
+    }
+
+    if (pthread_create(&pipe->thread, NULL, flash_pipe_thread, pipe) != 0) {
+        flash_pipe_free(pipe);
+        return NULL;
+    }
+
+    return pipe;
+}
+
+int flash_pipe_finish(struct flash_pipe *pipe)
+{
+    void *ret;
+
+    pthread_join(pipe->thread, &ret);
+    flash_pipe_free(pipe);
+
+    return (int) (intptr_t) ret;
+}
+
+uint8_t *flash_pipe_acquire(struct flash_pipe *pipe)
+{
+    uint8_t *chunk = NULL;
+
+    pthread_mutex_lock(&pipe->lock);
+
+    while (!pipe->aborted && pipe->filled == FLASH_PIPE_CHUNKS) {
+        pthread_cond_wait(&pipe->cond, &pipe->lock);
+    }
+
+    if (!pipe->aborted) {
+        chunk = pipe->chunks[pipe->tail];
+    }
+
+    pthread_mutex_unlock(&pipe->lock);
+    return chunk;
+}
+
+void flash_pipe_submit(struct flash_pipe *pipe, size_t len)
+{
+    pthread_mutex_lock(&pipe->lock);
+    pipe->lens[pipe->tail] = len;
+    pipe->tail = (pipe->tail + 1) % FLASH_PIPE_CHUNKS;
+    pipe->filled++;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+void flash_pipe_close(struct flash_pipe *pipe)
+{
+    pthread_mutex_lock(&pipe->lock);
+    pipe->closed = true;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+uint8_t *flash_pipe_receive(struct flash_pipe *pipe, size_t *len)
+{
+    uint8_t *chunk = NULL;
+
+    pthread_mutex_lock(&pipe->lock);
+
+    while (!pipe->aborted && !pipe->closed && pipe->filled == 0) {
+        pthread_cond_wait(&pipe->cond, &pipe->lock);
+    }
+
+    if (!pipe->aborted && pipe->filled != 0) {
+        chunk = pipe->chunks[pipe->head];
+        *len = pipe->lens[pipe->head];
+    }
+
+    pthread_mutex_unlock(&pipe->lock);
+    return chunk;
+}
+
+void flash_pipe_release(struct flash_pipe *pipe)
+{
+    pthread_mutex_lock(&pipe->lock);
+    pipe->head = (pipe->head + 1) % FLASH_PIPE_CHUNKS;
+    pipe->filled--;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+}
+
+void flash_pipe_abort(struct flash_pipe *pipe)
+{
+    pthread_mutex_lock(&pipe->lock);
+    pipe->aborted = true;
+    pthread_cond_broadcast(&pipe->cond);
+    pthread_mutex_unlock(&pipe->lock);
+}
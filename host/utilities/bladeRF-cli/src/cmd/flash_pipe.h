@@ -0,0 +1,83 @@
+/*
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef CMD_FLASH_PIPE_H_
+#define CMD_FLASH_PIPE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Passes chunks of a flash image, in order, between the command's thread
+ * and a thread that performs the file I/O, such that file accesses overlap
+ * flash accesses. Either side may be the producer. */
+struct flash_pipe;
+
+/* Number of chunks in a pipe */
+#ifndef FLASH_PIPE_CHUNKS
+#   define FLASH_PIPE_CHUNKS 4
+#endif
+
+/* Function run by a pipe's thread
+ *
+ * @return 0 on success, BLADERF_ERR_* value on failure
+ */
+typedef int (*flash_pipe_fn)(struct flash_pipe *pipe, void *arg);
+
+/* Allocate a pipe of FLASH_PIPE_CHUNKS chunks of `chunk_len` bytes, and start
+ * a thread running `fn`.
+ *
+ * @return pipe on success, NULL on failure
+ */
+struct flash_pipe *flash_pipe_start(size_t chunk_len,
+                                    flash_pipe_fn fn, void *arg);
+
+/* Wait for the pipe's thread to return, and free the pipe
+ *
+ * @return The value returned by the thread's function
+ */
+int flash_pipe_finish(struct flash_pipe *pipe);
+
+/* Get the next empty chunk, waiting for one to become available
+ *
+ * @return chunk of `chunk_len` bytes, or NULL if the pipe was aborted
+ */
+uint8_t *flash_pipe_acquire(struct flash_pipe *pipe);
+
+/* Pass the chunk returned by flash_pipe_acquire() to the consumer, after
+ * filling in `len` bytes of it */
+void flash_pipe_submit(struct flash_pipe *pipe, size_t len);
+
+/* Denote that the producer will submit no more chunks */
+void flash_pipe_close(struct flash_pipe *pipe);
+
+/* Get the next submitted chunk, waiting for one to become available
+ *
+ * @return chunk, of which `len` bytes are valid, or NULL if the pipe was
+ *         closed and all of its chunks have been received, or if it was
+ *         aborted
+ */
+uint8_t *flash_pipe_receive(struct flash_pipe *pipe, size_t *len);
+
+/* Return the chunk obtained via flash_pipe_receive() to the producer */
+void flash_pipe_release(struct flash_pipe *pipe);
+
+/* Stop both sides of the pipe, upon failure */
+void flash_pipe_abort(struct flash_pipe *pipe);
+
+#endif
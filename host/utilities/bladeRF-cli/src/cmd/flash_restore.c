@@ -30,6 +30,10 @@
 #include "input.h"
 #include "minmax.h"
 #include "conversions.h"
+#include "flash_pipe.h"
+
+/* Flash is written one erase block at a time */
+#define RESTORE_CHUNK_LEN BLADERF_FLASH_EB_SIZE
 
 struct options {
     char *file;
@@ -37,6 +41,40 @@ struct options {
     bool override_defaults;
 };
 
+struct reader {
+    struct bladerf_image_stream *stream;
+    uint32_t len;                   /* Bytes of the image to read */
+};
+
+/* Read chunks of the image from its file, ahead of them being written
+ * to flash */
+static int read_chunks(struct flash_pipe *pipe, void *arg)
+{
+    struct reader *r = (struct reader *) arg;
+    uint32_t offset, n;
+    uint8_t *chunk;
+    int status;
+
+    for (offset = 0; offset < r->len; offset += n) {
+        n = u32_min(r->len - offset, RESTORE_CHUNK_LEN);
+
+        chunk = flash_pipe_acquire(pipe);
+        if (!chunk) {
+            break;
+        }
+
+        status = bladerf_image_stream_read(r->stream, chunk, n);
+        if (status != 0) {
+            return status;
+        }
+
+        flash_pipe_submit(pipe, n);
+    }
+
+    flash_pipe_close(pipe);
+    return 0;
+}
+
 static int parse_argv(struct cli_state *state, int argc, char **argv,
                       struct options *opt)
 {
@@ -111,10 +149,15 @@ static inline int erase_region(struct bladerf *dev, struct bladerf_image *img,
 
 int cmd_flash_restore(struct cli_state *state, int argc, char **argv)
 {
-    int rv;
+    int rv, read_status;
     struct bladerf_image *image = NULL;
+    struct bladerf_image_stream *stream = NULL;
+    struct flash_pipe *pipe;
+    struct reader reader;
     struct options opt;
-    uint32_t addr, len, page, count;
+    uint32_t addr, len, page, count, offset;
+    uint8_t *chunk;
+    size_t n;
 
     memset(&opt, 0, sizeof(opt));
 
@@ -128,7 +171,9 @@ int cmd_flash_restore(struct cli_state *state, int argc, char **argv)
         goto cmd_flash_restore_out;
     }
 
-    rv = bladerf_image_read(image, opt.file);
+    /* The image's checksum is verified up front, and its data is then read
+     * from the file as it is written to flash */
+    rv = bladerf_image_stream_open(&stream, image, opt.file);
     if (rv < 0) {
         state->last_lib_error = rv;
         rv = CLI_RET_LIBBLADERF;
@@ -156,11 +201,38 @@ int cmd_flash_restore(struct cli_state *state, int argc, char **argv)
         goto cmd_flash_restore_out;
     }
 
-    page = BLADERF_FLASH_TO_PAGES(addr);
-    count = BLADERF_FLASH_TO_PAGES(len);
+    reader.stream = stream;
+    reader.len = len;
+
+    pipe = flash_pipe_start(RESTORE_CHUNK_LEN, read_chunks, &reader);
+    if (!pipe) {
+        rv = CLI_RET_MEM;
+        goto cmd_flash_restore_out;
+    }
+
+    offset = 0;
+    while ((chunk = flash_pipe_receive(pipe, &n)) != NULL) {
+        page = BLADERF_FLASH_TO_PAGES(addr + offset);
+        count = BLADERF_FLASH_TO_PAGES(n);
+
+        rv = bladerf_write_flash(state->dev, chunk, page, count);
+        if (rv < 0) {
+            flash_pipe_abort(pipe);
+            break;
+        }
+
+        offset += (uint32_t) n;
+        flash_pipe_release(pipe);
+    }
+
+    read_status = flash_pipe_finish(pipe);
+    if (rv >= 0 && read_status < 0) {
+        rv = read_status;
+    }
 
-    rv = bladerf_write_flash(state->dev, image->data, page, count);
     if (rv < 0) {
+        state->last_lib_error = rv;
+        rv = CLI_RET_LIBBLADERF;
         cli_err(state, argv[0],
         "Failed to restore flash region.\n"
         "\n"
@@ -174,6 +246,7 @@ int cmd_flash_restore(struct cli_state *state, int argc, char **argv)
     rv = CLI_RET_OK;
 
 cmd_flash_restore_out:
+    bladerf_image_stream_close(stream);
     free(opt.file);
     bladerf_free_image(image);
     return rv;
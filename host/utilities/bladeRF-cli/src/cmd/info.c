@@ -29,6 +29,10 @@ int cmd_info(struct cli_state *state, int argc, char **argv)
     bool fpga_loaded;
     struct bladerf_devinfo info;
     bladerf_dev_speed usb_speed;
+    struct bladerf_fx3_link_config link;
+    bool have_link_config;
+    unsigned int load_ms;
+    bool have_load_time;
     const char *backend_str;
 
     status = bladerf_get_devinfo(state->dev, &info);
@@ -60,6 +64,11 @@ int cmd_info(struct cli_state *state, int argc, char **argv)
 
     usb_speed = bladerf_device_speed(state->dev);
 
+    /* Not available with older firmware */
+    have_link_config = bladerf_get_fx3_dma_config(state->dev, &link) == 0;
+    have_load_time = fpga_loaded &&
+                     bladerf_get_fpga_load_time(state->dev, &load_ms) == 0;
+
     printf("\n");
     printf("  Serial #:                 %s\n", info.serial);
     printf("  VCTCXO DAC calibration:   0x%.4x\n", dac_trim);
@@ -69,9 +78,18 @@ int cmd_info(struct cli_state *state, int argc, char **argv)
         printf("  FPGA size:                Unknown\n");
     }
     printf("  FPGA loaded:              %s\n", fpga_loaded ? "yes" : "no");
+    if (have_load_time) {
+        printf("  FPGA load time:           %u ms\n", load_ms);
+    }
     printf("  USB bus:                  %d\n", info.usb_bus);
     printf("  USB address:              %d\n", info.usb_addr);
     printf("  USB speed:                %s\n", devspeed2str(usb_speed));
+    if (have_link_config) {
+        printf("  USB burst length:         %u x %u bytes\n",
+               link.burst_len, link.max_packet_size);
+        printf("  FX3 DMA buffers:          %u x %u bytes\n",
+               link.buf_count, link.buf_size);
+    }
     printf("  Backend:                  %s\n", backend_str);
     printf("  Instance:                 %d\n", info.instance);
 
@@ -30,35 +30,15 @@ int cmd_mimo(struct cli_state *state, int argc, char **argv)
     }
 
     if (!strcasecmp(argv[1], "slave")) {
-        status = bladerf_si5338_write(state->dev, 6, 4);
-        if (status != 0) {
-            goto out;
-        }
-
-        status |= bladerf_si5338_write(state->dev, 28, 0x2b);
-        if (status != 0) {
-            goto out;
-        }
-
-        status |= bladerf_si5338_write(state->dev, 29, 0x28);
-        if (status != 0) {
-            goto out;
-        }
-
-        status |= bladerf_si5338_write(state->dev, 30, 0xa8);
+        status = bladerf_set_mimo_mode(state->dev, BLADERF_MIMO_SLAVE);
         if (status != 0) {
             goto out;
         }
 
         printf("\n  Successfully set device to slave MIMO mode.\n\n");
 
-    } else if (!strcmp(argv[1], "master")) {
-        status |= bladerf_si5338_write(state->dev, 39, 1);
-        if (status != 0) {
-            goto out;
-        }
-
-        status |= bladerf_si5338_write(state->dev, 34, 0x22);
+    } else if (!strcasecmp(argv[1], "master")) {
+        status = bladerf_set_mimo_mode(state->dev, BLADERF_MIMO_MASTER);
         if (status != 0) {
             goto out;
         }
@@ -37,92 +37,175 @@ static inline bool matches_si5338(const char *str)
     return strcasecmp("si", str) == 0 || strcasecmp("si5338", str) == 0;
 }
 
+/* Parse an address, or an inclusive range of addresses, <first>-<last>,
+ * appending the addresses to `regs`. */
+static bool parse_range(const char *str, size_t len, unsigned int max_address,
+                        struct bladerf_reg_access *regs, unsigned int *count)
+{
+    char buf[32];
+    char *sep;
+    unsigned int first, last, address;
+    bool ok;
+
+    if (len == 0 || len >= sizeof(buf)) {
+        return false;
+    }
+
+    memcpy(buf, str, len);
+    buf[len] = '\0';
+
+    sep = strchr(buf, '-');
+    if (sep != NULL) {
+        *sep = '\0';
+    }
+
+    first = str2uint(buf, 0, max_address, &ok);
+    if (!ok) {
+        return false;
+    }
+
+    last = first;
+    if (sep != NULL) {
+        last = str2uint(sep + 1, first, max_address, &ok);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    for (address = first; address <= last; address++) {
+        if (*count >= MAX_NUM_ADDRESSES) {
+            return false;
+        }
+
+        regs[*count].address = (uint8_t) address;
+        regs[*count].value = 0;
+        regs[*count].write = false;
+        (*count)++;
+    }
+
+    return true;
+}
+
+/* Parse a comma-separated list of addresses and address ranges, populating
+ * `regs` with reads of those addresses. Returns the number of reads, or 0 if
+ * `str` is invalid. */
+static unsigned int parse_address_list(const char *str,
+                                       unsigned int max_address,
+                                       struct bladerf_reg_access *regs)
+{
+    unsigned int count = 0;
+    const char *end;
+
+    do {
+        end = strchr(str, ',');
+        if (end == NULL) {
+            end = str + strlen(str);
+        }
+
+        if (!parse_range(str, end - str, max_address, regs, &count)) {
+            return 0;
+        }
+
+        str = end + 1;
+    } while (*end != '\0');
+
+    return count;
+}
+
 int cmd_peek(struct cli_state *state, int argc, char **argv)
 {
     /* Valid commands:
-        peek dac <address> [num addresses]
         peek lms <address> [num addresses]
         peek si  <address> [num addresses]
+
+       <address> may also be a comma-separated list of addresses and
+       inclusive ranges (<first>-<last>), in which case [num addresses] may
+       not be provided. All of the registers are read in a single batch.
     */
-    int rv = CLI_RET_OK;
-    bool ok;
-    int (*f)(struct bladerf *, uint8_t, uint8_t *);
-    unsigned int count, address, max_address;
-
-    if( argc == 3 || argc == 4 ) {
-        count = 1;
-
-        /* Parse the number of addresses */
-        if( argc == 4 ) {
-            count = str2uint( argv[3], 0, MAX_NUM_ADDRESSES, &ok );
-            if( !ok ) {
-                cli_err(state, argv[0],
-                        "Invalid number of addresses provided (%s)\n", argv[3]);
-                return CLI_RET_INVPARAM;
-            }
+    struct bladerf_reg_access regs[MAX_NUM_ADDRESSES];
+    int (*f)(struct bladerf *, struct bladerf_reg_access *, unsigned int);
+    unsigned int count, num, max_address, i;
+    bool ok, lms;
+    int status;
+
+    if (argc != 3 && argc != 4) {
+        cli_err(state, argv[0], "Invalid number of arguments (%d)\n",  argc);
+        return CLI_RET_INVPARAM;
+    }
+
+    /* Are we reading from the LMS6002D */
+    if (matches_lms6002d(argv[1])) {
+        f = bladerf_lms_access;
+        max_address = LMS_MAX_ADDRESS;
+        lms = true;
+    }
+
+    /* Are we reading from the Si5338? */
+    else if (matches_si5338(argv[1])) {
+        f = bladerf_si5338_access;
+        max_address = SI_MAX_ADDRESS;
+        lms = false;
+    }
+
+    /* I guess we aren't reading from anything :( */
+    else {
+        cli_err(state, argv[0], "%s is not a peekable device\n", argv[1]);
+        return CLI_RET_INVPARAM;
+    }
+
+    /* Parse the address(es) */
+    count = parse_address_list(argv[2], max_address, regs);
+    if (count == 0) {
+        invalid_address(state, argv[0], argv[2]);
+        return CLI_RET_INVPARAM;
+    }
+
+    /* Parse the number of addresses */
+    if (argc == 4) {
+        if (count != 1 || strchr(argv[2], '-') != NULL) {
+            cli_err(state, argv[0], "The number of addresses may only be "
+                    "provided with a single address\n");
+            return CLI_RET_INVPARAM;
         }
 
-        /* Are we reading from the LMS6002D */
-        if (matches_lms6002d(argv[1])) {
-            /* Parse address */
-            address = str2uint( argv[2], 0, LMS_MAX_ADDRESS, &ok );
-            if( !ok ) {
-                invalid_address(state, argv[0], argv[2]);
-                rv = CLI_RET_INVPARAM;
-            } else {
-                f = bladerf_lms_read;
-                max_address = LMS_MAX_ADDRESS;
-            }
+        num = str2uint(argv[3], 0, MAX_NUM_ADDRESSES, &ok);
+        if (!ok) {
+            cli_err(state, argv[0],
+                    "Invalid number of addresses provided (%s)\n", argv[3]);
+            return CLI_RET_INVPARAM;
         }
 
-        /* Are we reading from the Si5338? */
-        else if (matches_si5338(argv[1])) {
-            /* Parse address */
-            address = str2uint( argv[2], 0, SI_MAX_ADDRESS, &ok );
-            if( !ok ) {
-                invalid_address(state, argv[0], argv[2]);
-                rv = CLI_RET_INVPARAM;
-            } else {
-                f = bladerf_si5338_read;
-                max_address = SI_MAX_ADDRESS;
+        for (count = 0; count < num; count++) {
+            if (regs[0].address + count > max_address) {
+                break;
             }
-        }
 
-        /* I guess we aren't reading from anything :( */
-        else {
-            cli_err(state, argv[0], "%s is not a peekable device\n", argv[1]);
-            rv = CLI_RET_INVPARAM;
+            regs[count].address = (uint8_t) (regs[0].address + count);
+            regs[count].value = 0;
+            regs[count].write = false;
         }
+    }
 
-        /* Loop over the addresses and output the values */
-        if( rv == CLI_RET_OK && f ) {
-            int status;
-            uint8_t val;
-
-            putchar('\n');
+    if (count != 0) {
+        status = f(state->dev, regs, count);
+        if (status < 0) {
+            state->last_lib_error = status;
+            return CLI_RET_LIBBLADERF;
+        }
+    }
 
-            for(; count > 0 && address < max_address; count-- ) {
-                status = f( state->dev, (uint8_t)address, &val );
-                if (status < 0) {
-                    state->last_lib_error = status;
-                    rv = CLI_RET_LIBBLADERF;
-                } else {
-                    printf( "  0x%2.2x: 0x%2.2x\n", address, val );
+    /* Output the values */
+    putchar('\n');
 
-                    if (matches_lms6002d(argv[1])) {
-                        lms_reg_info(address, val);
-                    }
+    for (i = 0; i < count; i++) {
+        printf( "  0x%2.2x: 0x%2.2x\n", regs[i].address, regs[i].value );
 
-                    address++;
-                    putchar('\n');
-                }
-            }
+        if (lms) {
+            lms_reg_info(regs[i].address, regs[i].value);
         }
 
-    } else {
-        cli_err(state, argv[0], "Invalid number of arguments (%d)\n",  argc);
-        rv = CLI_RET_INVPARAM;
+        putchar('\n');
     }
-    return rv;
-}
 
+    return CLI_RET_OK;
+}
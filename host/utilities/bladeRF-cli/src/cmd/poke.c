@@ -25,98 +25,177 @@
 #include "peekpoke.h"
 #include "conversions.h"
 
+/* Parse an <address>=<value> pair */
+static bool parse_pair(const char *str, unsigned int max_address,
+                       struct bladerf_reg_access *reg)
+{
+    char buf[32];
+    char *sep;
+    unsigned int address, value;
+    bool ok;
+
+    if (strlen(str) >= sizeof(buf)) {
+        return false;
+    }
+
+    strcpy(buf, str);
+
+    sep = strchr(buf, '=');
+    if (sep == NULL) {
+        return false;
+    }
+
+    *sep = '\0';
+
+    address = str2uint(buf, 0, max_address, &ok);
+    if (!ok) {
+        return false;
+    }
+
+    value = str2uint(sep + 1, 0, MAX_VALUE, &ok);
+    if (!ok) {
+        return false;
+    }
+
+    reg->address = (uint8_t) address;
+    reg->value = (uint8_t) value;
+    reg->write = true;
+
+    return true;
+}
+
 int cmd_poke(struct cli_state *state, int argc, char **argv)
 {
     /* Valid commands:
         poke dac <address> <value>
-        poke lms <address> <value>
-        poke si  <address> <value>
+        poke lms <address> <value> [value ...]
+        poke si  <address> <value> [value ...]
+        poke lms <address>=<value> [<address>=<value> ...]
+        poke si  <address>=<value> [<address>=<value> ...]
+
+       Multiple values are written to consecutive addresses. All of the
+       writes, and the readback of LMS registers, are performed in a single
+       batch.
     */
-    int rv = CLI_RET_OK;
+    struct bladerf_reg_access regs[2 * MAX_NUM_ADDRESSES];
+    int (*f)(struct bladerf *, struct bladerf_reg_access *, unsigned int);
+    unsigned int address, value, max_address, count, i;
     int status;
-    bool ok;
-    int (*f)(struct bladerf *, uint8_t, uint8_t);
-    unsigned int address, value;
+    bool ok, lms, pairs;
+
+    if (argc < 3) {
+        cli_err(state, argv[0], "Invalid number of arguments (%d)\n", argc);
+        return CLI_RET_INVPARAM;
+    }
+
+    /* Are we writing to the DAC? */
+    if( strcasecmp( argv[1], "dac" ) == 0 ) {
+        /* TODO: Point function pointer */
+        /* f = vctcxo_dac_write */
+        f = NULL;
+        max_address = DAC_MAX_ADDRESS;
+        lms = false;
+    }
+
+    /* Are we writing to the LMS6002D */
+    else if( strcasecmp( argv[1], "lms" ) == 0 ) {
+        f = bladerf_lms_access;
+        max_address = LMS_MAX_ADDRESS;
+        lms = true;
+    }
+
+    /* Are we writing to the Si5338? */
+    else if( strcasecmp( argv[1], "si" ) == 0 ) {
+        f = bladerf_si5338_access;
+        max_address = SI_MAX_ADDRESS;
+        lms = false;
+    }
+
+    /* I guess we aren't writing to anything :( */
+    else {
+        cli_err(state, argv[0], "%s is not a pokeable device\n", argv[1] );
+        return CLI_RET_INVPARAM;
+    }
 
-    if( argc == 4 ) {
+    pairs = strchr(argv[2], '=') != NULL;
 
-        /* Parse the value */
-        value = str2uint( argv[3], 0, MAX_VALUE, &ok );
+    if ((pairs && argc - 2 > MAX_NUM_ADDRESSES) ||
+        (!pairs && (argc < 4 || argc - 3 > MAX_NUM_ADDRESSES)) ||
+        (f == NULL && argc != 4)) {
+        cli_err(state, argv[0], "Invalid number of arguments (%d)\n", argc);
+        return CLI_RET_INVPARAM;
+    }
+
+    if (pairs) {
+        /* Parse the <address>=<value> pairs */
+        for (count = 0; count < (unsigned int) argc - 2; count++) {
+            if (!parse_pair(argv[count + 2], max_address, &regs[count])) {
+                cli_err(state, argv[0],
+                        "Invalid address=value pair provided (%s)\n",
+                        argv[count + 2]);
+                return CLI_RET_INVPARAM;
+            }
+        }
+    } else {
+        /* Parse address */
+        address = str2uint( argv[2], 0, max_address, &ok );
         if( !ok ) {
-            cli_err(state, argv[0],
-                    "Invalid value provided (%s)", argv[3]);
+            invalid_address(state, argv[0], argv[2]);
             return CLI_RET_INVPARAM;
         }
 
-        /* Are we reading from the DAC? */
-        if( strcasecmp( argv[1], "dac" ) == 0 ) {
-            /* Parse address */
-            address = str2uint( argv[2], 0, DAC_MAX_ADDRESS, &ok );
+        /* Parse the values */
+        for (count = 0; count < (unsigned int) argc - 3; count++) {
+            value = str2uint( argv[count + 3], 0, MAX_VALUE, &ok );
             if( !ok ) {
-                invalid_address(state, argv[0], argv[2]);
-                rv = CLI_RET_INVPARAM;
-            } else {
-                /* TODO: Point function pointer */
-                /* f = vctcxo_dac_write */
-                f = NULL;
+                cli_err(state, argv[0],
+                        "Invalid value provided (%s)\n", argv[count + 3]);
+                return CLI_RET_INVPARAM;
             }
-        }
 
-        /* Are we reading from the LMS6002D */
-        else if( strcasecmp( argv[1], "lms" ) == 0 ) {
-            /* Parse address */
-            address = str2uint( argv[2], 0, LMS_MAX_ADDRESS, &ok );
-            if( !ok ) {
-                invalid_address(state, argv[0], argv[2]);
-                rv = CLI_RET_INVPARAM;
-            } else {
-                f = bladerf_lms_write;
+            if (address + count > max_address) {
+                cli_err(state, argv[0],
+                        "Too many values provided for address %s\n",
+                        argv[2]);
+                return CLI_RET_INVPARAM;
             }
-        }
 
-        /* Are we reading from the Si5338? */
-        else if( strcasecmp( argv[1], "si" ) == 0 ) {
-            /* Parse address */
-            address = str2uint( argv[2], 0, SI_MAX_ADDRESS, &ok );
-            if( !ok ) {
-                invalid_address(state, argv[0], argv[2]);
-                rv = CLI_RET_INVPARAM;
-            } else {
-                f = bladerf_si5338_write;
-            }
+            regs[count].address = (uint8_t) (address + count);
+            regs[count].value = (uint8_t) value;
+            regs[count].write = true;
         }
+    }
 
-        /* I guess we aren't reading from anything :( */
-        else {
-            cli_err(state, argv[0], "%s is not a pokeable device\n", argv[1] );
-            rv = CLI_RET_INVPARAM;
-        }
+    if (f == NULL) {
+        return CLI_RET_OK;
+    }
 
-        /* Write the value to the address */
-        if( rv == CLI_RET_OK && f ) {
-            status = f( state->dev, (uint8_t)address, (uint8_t)value );
-            if (status < 0) {
-                state->last_lib_error = status;
-                rv = CLI_RET_LIBBLADERF;
-            } else {
-                printf( "\n  0x%2.2x: 0x%2.2x\n", address, value );
-                if (f == bladerf_lms_write) {
-                    uint8_t readback;
-                    int status = bladerf_lms_read(state->dev,
-                                                  (uint8_t)address,
-                                                  &readback);
-                    if (status == 0) {
-                        lms_reg_info(address, readback);
-                        putchar('\n'); /* To be consistent with peek output */
-                    }
-                }
-            }
+    /* Read back the LMS registers after they have all been written */
+    if (lms) {
+        for (i = 0; i < count; i++) {
+            regs[count + i].address = regs[i].address;
+            regs[count + i].value = 0;
+            regs[count + i].write = false;
         }
+    }
 
-    } else {
-        cli_err(state, argv[0], "Invalid number of arguments (%d)\n", argc);
-        rv = CLI_RET_INVPARAM;
+    /* Write the values to the addresses */
+    status = f(state->dev, regs, lms ? 2 * count : count);
+    if (status < 0) {
+        state->last_lib_error = status;
+        return CLI_RET_LIBBLADERF;
     }
-    return rv;
-}
 
+    putchar('\n');
+
+    for (i = 0; i < count; i++) {
+        printf( "  0x%2.2x: 0x%2.2x\n", regs[i].address, regs[i].value );
+
+        if (lms) {
+            lms_reg_info(regs[i].address, regs[count + i].value);
+            putchar('\n'); /* To be consistent with peek output */
+        }
+    }
+
+    return CLI_RET_OK;
+}
@@ -333,43 +333,41 @@ int set_frequency(struct cli_state *state, int argc, char **argv)
 
             printf( "\n" );
 
-            /* Change RX frequency */
-            if( argc == 3 || module == BLADERF_MODULE_RX ) {
-                int status = bladerf_set_frequency( state->dev,
-                                                    BLADERF_MODULE_RX, freq );
+            if( argc == 3 ) {
+                /* Change both RX and TX frequency */
+                status = bladerf_set_frequency_both( state->dev, freq );
+            } else {
+                status = bladerf_set_frequency( state->dev, module, freq );
+            }
 
+            if (status < 0) {
+                state->last_lib_error = status;
+                rv = CLI_RET_LIBBLADERF;
+            }
+
+            /* Report the RX frequency */
+            if( rv == CLI_RET_OK &&
+                (argc == 3 || module == BLADERF_MODULE_RX) ) {
+                status = bladerf_get_frequency( state->dev,
+                                                BLADERF_MODULE_RX, &freq );
                 if (status < 0) {
                     state->last_lib_error = status;
                     rv = CLI_RET_LIBBLADERF;
                 } else {
-                    status = bladerf_get_frequency( state->dev,
-                                                    BLADERF_MODULE_RX, &freq );
-                    if (status < 0) {
-                        state->last_lib_error = status;
-                        rv = CLI_RET_LIBBLADERF;
-                    } else {
-                        printf( "  Set RX frequency: %10uHz\n", freq );
-                    }
+                    printf( "  Set RX frequency: %10uHz\n", freq );
                 }
             }
 
-            /* Change TX frequency */
-            if( argc == 3 || module == BLADERF_MODULE_TX ) {
-                status = bladerf_set_frequency( state->dev,
-                                                BLADERF_MODULE_TX, freq );
-
+            /* Report the TX frequency */
+            if( rv == CLI_RET_OK &&
+                (argc == 3 || module == BLADERF_MODULE_TX) ) {
+                status = bladerf_get_frequency( state->dev,
+                                                BLADERF_MODULE_TX, &freq );
                 if (status < 0) {
                     state->last_lib_error = status;
                     rv = CLI_RET_LIBBLADERF;
                 } else {
-                    status = bladerf_get_frequency( state->dev,
-                                                    BLADERF_MODULE_TX, &freq );
-                    if (status < 0) {
-                        state->last_lib_error = status;
-                        rv = CLI_RET_LIBBLADERF;
-                    } else {
-                        printf( "  Set TX frequency: %10uHz\n", freq );
-                    }
+                    printf( "  Set TX frequency: %10uHz\n", freq );
                 }
             }
 
@@ -1191,6 +1189,83 @@ int set_txvga2(struct cli_state *state, int argc, char **argv)
     return rv;
 }
 
+static const char *lpf_mode_str(bladerf_lpf_mode mode)
+{
+    switch (mode) {
+        case BLADERF_LPF_NORMAL:    return "normal";
+        case BLADERF_LPF_BYPASSED:  return "bypassed";
+        case BLADERF_LPF_DISABLED:  return "disabled";
+        default:                    return "unknown";
+    }
+}
+
+static const char *loopback_str(bladerf_loopback loopback)
+{
+    switch (loopback) {
+        case BLADERF_LB_BB_TXLPF_RXVGA2:    return "bb_txlpf_rxvga2";
+        case BLADERF_LB_BB_TXLPF_RXLPF:     return "bb_txlpf_rxlpf";
+        case BLADERF_LB_BB_TXVGA1_RXVGA2:   return "bb_txvga1_rxvga2";
+        case BLADERF_LB_BB_TXVGA1_RXLPF:    return "bb_txvga1_rxlpf";
+        case BLADERF_LB_RF_LNA1:            return "rf_lna1";
+        case BLADERF_LB_RF_LNA2:            return "rf_lna2";
+        case BLADERF_LB_RF_LNA3:            return "rf_lna3";
+        case BLADERF_LB_FIRMWARE:           return "firmware";
+        case BLADERF_LB_NONE:               return "none";
+        default:                            return "unknown";
+    }
+}
+
+static const char *lnagain_str(bladerf_lna_gain gain)
+{
+    switch (gain) {
+        case BLADERF_LNA_GAIN_MAX:      return "6 dB";
+        case BLADERF_LNA_GAIN_MID:      return "3 dB";
+        case BLADERF_LNA_GAIN_BYPASS:   return "0 dB";
+        default:                        return "Unknown";
+    }
+}
+
+/* Print a summary of the RF configuration, obtained in a single snapshot */
+static int print_config(struct cli_state *state)
+{
+    int status;
+    struct bladerf_config_snapshot c;
+
+    status = bladerf_get_config_snapshot(state->dev, &c);
+    if (status != 0) {
+        state->last_lib_error = status;
+        return CLI_RET_LIBBLADERF;
+    }
+
+    printf("\n");
+    printf("  %-20s%10uHz\n", "RX Frequency:", c.rx_frequency);
+    printf("  %-20s%10uHz\n", "TX Frequency:", c.tx_frequency);
+    printf("  %-20s%10uHz\n", "RX Bandwidth:", c.rx_bandwidth);
+    printf("  %-20s%10uHz\n", "TX Bandwidth:", c.tx_bandwidth);
+    printf("  %-20s%s\n", "RX LPF mode:", lpf_mode_str(c.rx_lpf_mode));
+    printf("  %-20s%s\n", "TX LPF mode:", lpf_mode_str(c.tx_lpf_mode));
+    printf("  %-20s%"PRIu64" %"PRIu64"/%"PRIu64"\n", "RX sample rate:",
+           c.rx_samplerate.integer, c.rx_samplerate.num,
+           c.rx_samplerate.den);
+    printf("  %-20s%"PRIu64" %"PRIu64"/%"PRIu64"\n", "TX sample rate:",
+           c.tx_samplerate.integer, c.tx_samplerate.num,
+           c.tx_samplerate.den);
+    printf("  %-20s%s\n", "LNA Gain:", lnagain_str(c.lnagain));
+    printf("  %-20s%ddB\n", "RXVGA1 Gain:", c.rxvga1);
+    printf("  %-20s%ddB\n", "RXVGA2 Gain:", c.rxvga2);
+    printf("  %-20s%ddB\n", "TXVGA1 Gain:", c.txvga1);
+    printf("  %-20s%ddB\n", "TXVGA2 Gain:", c.txvga2);
+    printf("  %-20s%s\n", "Loopback mode:", loopback_str(c.loopback));
+    printf("  %-20s%s\n", "Sampling:",
+           c.sampling == BLADERF_SAMPLING_EXTERNAL ? "External" :
+           c.sampling == BLADERF_SAMPLING_INTERNAL ? "Internal" : "Unknown");
+    printf("  %-20s0x%8.8x\n", "GPIO:", c.gpio);
+    printf("  %-20s0x%4.4x\n", "VCTCXO Trim DAC:", c.vctcxo_trim);
+    printf("\n");
+
+    return CLI_RET_OK;
+}
+
 struct printset_entry *get_printset_entry( char *name)
 {
     int i;
@@ -1246,7 +1321,7 @@ int cmd_print(struct cli_state *state, int argc, char **argv)
             rv = CLI_RET_INVPARAM;
         }
     } else {
-        rv = CLI_RET_NARGS;
+        rv = print_config(state);
     }
     return rv;
 }
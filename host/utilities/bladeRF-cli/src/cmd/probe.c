@@ -28,8 +28,12 @@ static inline const char *backend2str(bladerf_backend b)
             return "libusb";
         case BLADERF_BACKEND_CYPRESS:
             return "CyUSB driver";
+        case BLADERF_BACKEND_USBFS:
+            return "Linux usbfs";
         case BLADERF_BACKEND_LINUX:
             return "Linux kernel driver";
+        case BLADERF_BACKEND_NET:
+            return "Network";
         default:
             return "Unknown";
     }
@@ -17,6 +17,11 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
+/* O_DIRECT and fallocate() */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#   define _GNU_SOURCE
+#endif
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
@@ -26,11 +31,43 @@
 #include <errno.h>
 #include <string.h>
 #include <inttypes.h>
+#include <math.h>
+#include <signal.h>
 
 #include "rel_assert.h"
 #include "host_config.h"
 #include "rxtx_impl.h"
 #include "minmax.h"
+#include "input/input.h"
+#include "sigmf.h"
+
+/* Write binary output files with O_DIRECT, using fallocate() to preallocate
+ * them, when requested */
+#ifndef ENABLE_RX_DIRECT_IO
+#   if BLADERF_OS_LINUX
+#       define ENABLE_RX_DIRECT_IO 1
+#   else
+#       define ENABLE_RX_DIRECT_IO 0
+#   endif
+#endif
+
+#if ENABLE_RX_DIRECT_IO
+#   include <fcntl.h>
+#   include <unistd.h>
+
+/* Alignment required of O_DIRECT buffers, lengths, and file offsets. Any
+ * buffer of a multiple of 1024 samples is a multiple of this. */
+#   define RX_DIRECT_ALIGNMENT  4096
+
+/* Granularity at which output files are preallocated */
+#   define RX_PREALLOC_CHUNK    (256 * 1024 * 1024)
+#endif
+
+static const struct numeric_suffix rx_rotate_time_suffixes[] = {
+    { FIELD_INIT(.suffix, "s"), FIELD_INIT(.multiplier, 1) },
+    { FIELD_INIT(.suffix, "m"), FIELD_INIT(.multiplier, 60) },
+    { FIELD_INIT(.suffix, "h"), FIELD_INIT(.multiplier, 60 * 60) },
+};
 
 #if BLADERF_OS_WINDOWS
 #   define EOL "\r\n"
@@ -39,38 +76,207 @@
 #endif
 
 /**
- * Peform adjustments on received samples before writing them out:
- *  (1) Mask off FPGA markers
- *  (2) Convert little-endian samples to host endianness, if needed.
+ * Convert received samples, which are little-endian, to host endianness
+ * before writing them out. This is a no-op on little-endian hosts.
  *
  *  @param  buff    Sample buffer
  *  @param  n       Number of samples
  */
 static inline void sc16q11_sample_fixup(int16_t *buf, size_t n)
 {
+#if BLADERF_BIG_ENDIAN
     size_t i;
 
+    /* Swap the bytes of I and Q together, with operations on a whole sample
+     * that the compiler can vectorize */
     for (i = 0; i < n; i++) {
-        /* I - Mask off the marker and sign extend */
-//        *buf &= (*buf) & 0x0fff;
-//        if (*buf & 0x800) {
-//            *buf |= 0xf000;
-//        }
+        uint32_t sample;
+
+        memcpy(&sample, &buf[2 * i], sizeof(sample));
+        sample = ((sample & 0x00ff00ff) << 8) | ((sample >> 8) & 0x00ff00ff);
+        memcpy(&buf[2 * i], &sample, sizeof(sample));
+    }
+#else
+    (void) buf;
+    (void) n;
+#endif
+}
+
+/* Form the path of the index'th output file: the configured path, with
+ * ".<index>" appended to it for all but the first.
+ *
+ * returns a heap-allocated path, or NULL on an allocation failure */
+static char *rx_file_path(struct rxtx_data *rx, unsigned int index)
+{
+    char *expanded;
+    char *path;
+    size_t len;
 
-        *buf = LE16_TO_HOST(*buf);
-        buf++;
+    MUTEX_LOCK(&rx->file_mgmt.file_meta_lock);
+    expanded = input_expand_path(rx->file_mgmt.path);
+    MUTEX_UNLOCK(&rx->file_mgmt.file_meta_lock);
 
-        /* Q - Mask off the marker and sign extend */
-//        *buf = HOST_TO_LE16(*buf) & 0x0fff;
-//        if (*buf & 0x800) {
-//            *buf |= 0xf000;
-//        }
+    if (expanded == NULL || index == 0) {
+        return expanded;
+    }
 
-        *buf = LE16_TO_HOST(*buf);
-        buf++;
+    len = strlen(expanded) + 12;
+    path = malloc(len);
+    if (path != NULL) {
+        snprintf(path, len, "%s.%u", expanded, index);
     }
+
+    free(expanded);
+    return path;
 }
 
+/* Close the current output file and open the next one in the sequence
+ *
+ * @pre file_lock is held
+ *
+ * returns 0 on success, CLI_RET_* on failure (and calls set_last_error()) */
+static int rx_next_file(struct rxtx_data *rx)
+{
+    struct rx_file_state *fs = &((struct rx_params *)rx->params)->file_state;
+    char *path;
+    int status;
+
+    path = rx_file_path(rx, fs->index + 1);
+    if (path == NULL) {
+        set_last_error(&rx->last_error, ETYPE_CLI, CLI_RET_MEM);
+        return CLI_RET_MEM;
+    }
+
+    fs->index++;
+
+    fclose(rx->file_mgmt.file);
+    rx->file_mgmt.file = fopen(path, "wb");
+
+    if (rx->file_mgmt.file == NULL) {
+        set_last_error(&rx->last_error, ETYPE_ERRNO, errno);
+        status = CLI_RET_FILEOP;
+    } else {
+        status = 0;
+    }
+
+    free(path);
+
+    fs->bytes = 0;
+    fs->allocated = 0;
+    fs->opened = time(NULL);
+    fs->direct = false;
+
+    return status;
+}
+
+/* Close the current output file and open the next one in the rotation,
+ * named by appending ".<index>" to the configured path, if the current file
+ * has reached the configured size or age.
+ *
+ * @pre file_lock is held
+ *
+ * returns 0 on success, CLI_RET_* on failure (and calls set_last_error()) */
+static int rx_rotate_file(struct rxtx_data *rx)
+{
+    struct rx_file_state *fs = &((struct rx_params *)rx->params)->file_state;
+    const time_t now = time(NULL);
+
+    if (fs->rotate_bytes != 0 && fs->bytes >= fs->rotate_bytes) {
+        return rx_next_file(rx);
+    } else if (fs->rotate_secs != 0 &&
+               (uint64_t) (now - fs->opened) >= fs->rotate_secs) {
+        return rx_next_file(rx);
+    }
+
+    return 0;
+}
+
+#if ENABLE_RX_DIRECT_IO
+/* Set or clear O_DIRECT on an output file descriptor */
+static int rx_set_direct(int fd, bool enable)
+{
+    int flags = fcntl(fd, F_GETFL);
+
+    if (flags < 0) {
+        return -1;
+    } else if (enable) {
+        flags |= O_DIRECT;
+    } else {
+        flags &= ~O_DIRECT;
+    }
+
+    return fcntl(fd, F_SETFL, flags);
+}
+
+/*
+ * Write samples without stdio buffering, bypassing the page cache if
+ * possible. The ring's buffers are suitably aligned for O_DIRECT; only the
+ * final, partial buffer of a reception is written without it.
+ *
+ * returns 0 on success, CLI_RET_* on failure (and calls set_last_error()) */
+static int rx_write_bin_direct(struct rxtx_data *rx,
+                               int16_t *samples, size_t n_samples)
+{
+    struct rx_file_state *fs = &((struct rx_params *)rx->params)->file_state;
+    const uint8_t *data = (const uint8_t *) samples;
+    size_t len = n_samples * 2 * sizeof(int16_t);
+    const bool aligned = (len % RX_DIRECT_ALIGNMENT) == 0;
+    int status;
+    int fd;
+
+    MUTEX_LOCK(&rx->file_mgmt.file_lock);
+
+    status = rx_rotate_file(rx);
+    if (status != 0) {
+        goto out;
+    }
+
+    fd = fileno(rx->file_mgmt.file);
+
+    /* O_DIRECT is not supported by all filesystems, in which case this
+     * falls back to unbuffered writes through the page cache */
+    if (fs->direct != aligned) {
+        if (rx_set_direct(fd, aligned) == 0) {
+            fs->direct = aligned;
+        }
+    }
+
+    /* Preallocate ahead of the writes, rather than having the filesystem
+     * extend the file a little at a time */
+    if (fs->bytes + len > fs->allocated) {
+        if (fallocate(fd, FALLOC_FL_KEEP_SIZE, (off_t) fs->allocated,
+                      RX_PREALLOC_CHUNK) == 0) {
+            fs->allocated += RX_PREALLOC_CHUNK;
+        } else {
+            /* Don't retry on every write if this isn't supported */
+            fs->allocated = UINT64_MAX;
+        }
+    }
+
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            set_last_error(&rx->last_error, ETYPE_ERRNO, errno);
+            status = CLI_RET_FILEOP;
+            goto out;
+        }
+
+        data += n;
+        len -= (size_t) n;
+        fs->bytes += (uint64_t) n;
+    }
+
+out:
+    MUTEX_UNLOCK(&rx->file_mgmt.file_lock);
+    return status;
+}
+#endif
+
 /*
  * @pre data_mgmt lock is held
  *
@@ -79,11 +285,20 @@ static int rx_write_bin_sc16q11(struct rxtx_data *rx,
                                 int16_t *samples, size_t n_samples)
 {
     size_t status;
+    struct rx_file_state *fs = &((struct rx_params *)rx->params)->file_state;
 
     MUTEX_LOCK(&rx->file_mgmt.file_lock);
+
+    if (rx_rotate_file(rx) != 0) {
+        MUTEX_UNLOCK(&rx->file_mgmt.file_lock);
+        return CLI_RET_FILEOP;
+    }
+
     status = fwrite(samples, sizeof(int16_t),
                     2 * n_samples,  /* I and Q are each an int16_t */
                     rx->file_mgmt.file);
+    fs->bytes += status * sizeof(int16_t);
+
     MUTEX_UNLOCK(&rx->file_mgmt.file_lock);
 
     if (status != (2 * n_samples)) {
@@ -92,103 +307,923 @@ static int rx_write_bin_sc16q11(struct rxtx_data *rx,
     } else {
         return 0;
     }
-}
+}
+
+/* Size of the block in which CSV output is formatted before being written.
+ * Each line requires at most RX_CSV_LINE_MAX bytes. */
+#define RX_CSV_BLOCK_SIZE   (16 * 1024)
+#define RX_CSV_LINE_MAX     (2 * 6 + 2 + sizeof(EOL) - 1)
+
+/* Format a value in decimal, returning the number of characters written */
+static inline size_t rx_format_int16(char *out, int16_t value)
+{
+    char digits[5];
+    size_t n_digits = 0;
+    size_t len = 0;
+    unsigned int v;
+
+    if (value < 0) {
+        out[len++] = '-';
+        v = (unsigned int) (-(int) value);
+    } else {
+        v = (unsigned int) value;
+    }
+
+    do {
+        digits[n_digits++] = (char) ('0' + (v % 10));
+        v /= 10;
+    } while (v != 0);
+
+    while (n_digits != 0) {
+        out[len++] = digits[--n_digits];
+    }
+
+    return len;
+}
+
+/* returns 0 on success, CLI_RET_* on failure (and calls set_last_error()) */
+static int rx_write_csv_sc16q11(struct rxtx_data *rx,
+                                int16_t *samples, size_t n_samples)
+{
+    size_t i;
+    int status = 0;
+    const size_t to_write = n_samples * 2;  /* int16_t for I, another for Q */
+    char block[RX_CSV_BLOCK_SIZE];
+    size_t len = 0;
+    struct rx_file_state *fs = &((struct rx_params *)rx->params)->file_state;
+
+    MUTEX_LOCK(&rx->file_mgmt.file_lock);
+
+    status = rx_rotate_file(rx);
+
+    for (i = 0; status == 0 && i < to_write; i += 2) {
+        len += rx_format_int16(&block[len], samples[i]);
+        block[len++] = ',';
+        block[len++] = ' ';
+        len += rx_format_int16(&block[len], samples[i + 1]);
+        memcpy(&block[len], EOL, sizeof(EOL) - 1);
+        len += sizeof(EOL) - 1;
+
+        /* Write out the block once it's full, or if this is the last line */
+        if (len > (sizeof(block) - RX_CSV_LINE_MAX) || (i + 2) >= to_write) {
+            if (fwrite(block, 1, len, rx->file_mgmt.file) != len) {
+                set_last_error(&rx->last_error, ETYPE_ERRNO, errno);
+                status = CLI_RET_FILEOP;
+            } else {
+                fs->bytes += len;
+            }
+
+            len = 0;
+        }
+    }
+
+    MUTEX_UNLOCK(&rx->file_mgmt.file_lock);
+    return status;
+}
+
+/* Size of the block that samples are converted into before being written
+ * out, for the formats that are converted from SC16 Q11 */
+#define RX_CONVERT_BLOCK_SIZE   (64 * 1024)
+
+/* Pack samples into 3 bytes per I/Q pair: I[7:0], Q[3:0] I[11:8], Q[11:4].
+ * This is the little-endian representation of (Q << 12) | I, with each
+ * component in 12-bit two's complement form, as in the
+ * BLADERF_FORMAT_SC16_Q11_PACKED format. */
+static void rx_convert_sc12(uint8_t *out, const int16_t *samples, size_t n,
+                            unsigned int shift)
+{
+    (void) shift;
+    bladerf_pack_sc16_q11(out, samples, (unsigned int) n);
+}
+
+/* Scale samples down by 2^shift, rounding and saturating to 8 bits */
+static void rx_convert_sc8(uint8_t *out, const int16_t *samples, size_t n,
+                           unsigned int shift)
+{
+    bladerf_convert_sc16q11_to_cs8((int8_t *) out, samples, (unsigned int) n,
+                                   shift);
+}
+
+/* Scale samples to [-1.0, 1.0) */
+static void rx_convert_cf32(uint8_t *out, const int16_t *samples, size_t n,
+                            unsigned int shift)
+{
+    (void) shift;
+    bladerf_convert_sc16q11_to_cf32((float *) out, samples, (unsigned int) n);
+}
+
+/* Convert samples to another format, one block at a time, and write them out.
+ *
+ * The conversions above use libbladeRF's SIMD kernels, and run in the writer
+ * thread such that they do not delay reception.
+ *
+ * returns 0 on success, CLI_RET_* on failure (and calls set_last_error()) */
+static int rx_write_converted(struct rxtx_data *rx,
+                              const int16_t *samples, size_t n_samples,
+                              size_t bytes_per_sample,
+                              void (*convert)(uint8_t *out,
+                                              const int16_t *samples,
+                                              size_t n, unsigned int shift))
+{
+    int status;
+    /* Declared as floats so that it is suitably aligned for any format */
+    float block[RX_CONVERT_BLOCK_SIZE / sizeof(float)];
+    const size_t block_samples = sizeof(block) / bytes_per_sample;
+    struct rx_file_state *fs = &((struct rx_params *)rx->params)->file_state;
+
+    MUTEX_LOCK(&rx->file_mgmt.file_lock);
+
+    status = rx_rotate_file(rx);
+
+    while (status == 0 && n_samples != 0) {
+        const size_t n = min_sz(n_samples, block_samples);
+        const size_t len = n * bytes_per_sample;
+
+        convert((uint8_t *) block, samples, n, fs->sc8_shift);
+
+        if (fwrite(block, 1, len, rx->file_mgmt.file) != len) {
+            set_last_error(&rx->last_error, ETYPE_ERRNO, errno);
+            status = CLI_RET_FILEOP;
+        } else {
+            fs->bytes += len;
+        }
+
+        samples += 2 * n;
+        n_samples -= n;
+    }
+
+    MUTEX_UNLOCK(&rx->file_mgmt.file_lock);
+    return status;
+}
+
+static int rx_write_bin_sc12(struct rxtx_data *rx,
+                             int16_t *samples, size_t n_samples)
+{
+    return rx_write_converted(rx, samples, n_samples, 3, rx_convert_sc12);
+}
+
+static int rx_write_bin_sc8(struct rxtx_data *rx,
+                            int16_t *samples, size_t n_samples)
+{
+    return rx_write_converted(rx, samples, n_samples, 2, rx_convert_sc8);
+}
+
+static int rx_write_bin_cf32(struct rxtx_data *rx,
+                             int16_t *samples, size_t n_samples)
+{
+    return rx_write_converted(rx, samples, n_samples, 2 * sizeof(float),
+                              rx_convert_cf32);
+}
+
+/* Header line of the CSV file written in the spectrum format */
+#define RX_SPECTRUM_HEADER \
+    "report,frames,peak_hz,peak_dbfs,noise_floor_dbfs,analyzed_pct" EOL
+
+/* Record the statistics of an averaged spectrum and append them to the
+ * output file. This is called from the analyzer's worker threads. */
+static int rx_spectrum_report(void *arg, const struct spectrum_stats *stats)
+{
+    struct rxtx_data *rx = (struct rxtx_data *) arg;
+    struct rx_params *rx_params = rx->params;
+    const uint64_t total = stats->analyzed + stats->skipped;
+    const double analyzed_pct = (total == 0) ? 0.0 :
+                                100.0 * stats->analyzed / total;
+    int ret;
+
+    MUTEX_LOCK(&rx->param_lock);
+    rx_params->spectrum_stats = *stats;
+    MUTEX_UNLOCK(&rx->param_lock);
+
+    MUTEX_LOCK(&rx->file_mgmt.file_lock);
+    ret = fprintf(rx->file_mgmt.file,
+                  "%" PRIu64 ",%u,%.0f,%.2f,%.2f,%.1f" EOL,
+                  stats->reports, stats->frames, stats->peak_hz,
+                  stats->peak_dbfs, stats->noise_dbfs, analyzed_pct);
+    MUTEX_UNLOCK(&rx->file_mgmt.file_lock);
+
+    return (ret < 0) ? CLI_RET_FILEOP : 0;
+}
+
+/* Analyze samples rather than writing them out. Statistics are written
+ * by rx_spectrum_report().
+ *
+ * returns 0 on success, CLI_RET_* on failure (and calls set_last_error()) */
+static int rx_write_spectrum(struct rxtx_data *rx,
+                             int16_t *samples, size_t n_samples)
+{
+    struct rx_file_state *fs = &((struct rx_params *)rx->params)->file_state;
+    int status = spectrum_process(fs->spectrum, samples, n_samples);
+
+    if (status != 0) {
+        set_last_error(&rx->last_error, ETYPE_CLI, status);
+    }
+
+    return status;
+}
+
+/* Ring of sample buffers, filled by the RX thread and written out to the
+ * file by a writer thread, such that file I/O stalls do not hold up
+ * reception until the ring fills */
+struct rx_ring {
+    MUTEX lock;
+    pthread_cond_t cond;        /* Signaled when a buffer is filled or freed */
+
+    int16_t *samples;           /* `depth' buffers of `samples_per_buffer' */
+    size_t *lengths;            /* # of samples to write from each buffer */
+    unsigned int depth;
+    unsigned int samples_per_buffer;
+
+    unsigned int head;          /* Next buffer to fill */
+    unsigned int tail;          /* Next buffer to write out */
+    unsigned int count;         /* # of filled buffers */
+    unsigned int high_water;    /* Max value of count */
+    unsigned int stalls;        /* # of times the RX thread waited for space */
+
+    bool done;                  /* No more buffers will be filled */
+    int status;                 /* Write failure; stops reception */
+
+    struct rxtx_data *rx;
+    int (*write_samples)(struct rxtx_data *rx, int16_t *samples, size_t n);
+};
+
+static inline int16_t *rx_ring_buffer(struct rx_ring *ring, unsigned int i)
+{
+    return ring->samples + (size_t) i * ring->samples_per_buffer * 2;
+}
+
+static void *rx_writer_task(void *arg)
+{
+    struct rx_ring *ring = (struct rx_ring *) arg;
+    int status = 0;
+
+    MUTEX_LOCK(&ring->lock);
+
+    while (status == 0) {
+        int16_t *samples;
+        size_t n;
+
+        while (ring->count == 0 && !ring->done) {
+            pthread_cond_wait(&ring->cond, &ring->lock);
+        }
+
+        /* Everything that was received has been written */
+        if (ring->count == 0) {
+            break;
+        }
+
+        samples = rx_ring_buffer(ring, ring->tail);
+        n = ring->lengths[ring->tail];
+
+        MUTEX_UNLOCK(&ring->lock);
+
+        sc16q11_sample_fixup(samples, n);
+        status = ring->write_samples(ring->rx, samples, n);
+
+        MUTEX_LOCK(&ring->lock);
+
+        ring->tail = (ring->tail + 1) % ring->depth;
+        ring->count--;
+        ring->status = status;
+        pthread_cond_broadcast(&ring->cond);
+    }
+
+    MUTEX_UNLOCK(&ring->lock);
+    return NULL;
+}
+
+static int rx_task_exec_running(struct rxtx_data *rx, struct cli_state *s)
+{
+    int status = 0;
+    unsigned int samples_per_buffer;
+    size_t num_samples;
+    size_t samples_read = 0;
+    unsigned int timeout_ms;
+    struct rx_params *rx_params = rx->params;
+    struct rx_ring ring;
+    pthread_t writer_thread;
+    bool writer_started = false;
+    bool use_sigmf;
+    bool use_spectrum;
+    bool use_meta;
+    uint64_t start_timestamp;
+    struct bladerf_metadata meta;
+    struct sigmf_capture capture;
+    bool capture_valid = false;
+    struct spectrum spectrum;
+    bool spectrum_valid = false;
+    unsigned int fft_size, fft_averages, fft_threads;
+
+    /* Read the parameters that will be used for the sync transfers */
+    MUTEX_LOCK(&rx->data_mgmt.lock);
+    timeout_ms = rx->data_mgmt.timeout_ms;
+    samples_per_buffer = rx->data_mgmt.samples_per_buffer;
+    MUTEX_UNLOCK(&rx->data_mgmt.lock);
+
+    MUTEX_LOCK(&rx->file_mgmt.file_meta_lock);
+    use_sigmf = (rx->file_mgmt.format == RXTX_FMT_SIGMF_SC16Q11);
+    use_spectrum = (rx->file_mgmt.format == RXTX_FMT_SPECTRUM);
+    MUTEX_UNLOCK(&rx->file_mgmt.file_meta_lock);
+
+    memset(&meta, 0, sizeof(meta));
+    memset(&capture, 0, sizeof(capture));
+
+    memset(&ring, 0, sizeof(ring));
+    MUTEX_INIT(&ring.lock);
+    pthread_cond_init(&ring.cond, NULL);
+    ring.samples_per_buffer = samples_per_buffer;
+    ring.rx = rx;
+
+    MUTEX_LOCK(&rx->param_lock);
+    num_samples = rx_params->n_samples;
+    ring.write_samples = rx_params->write_samples;
+    ring.depth = rx_params->ring_depth;
+    start_timestamp = rx_params->start_timestamp;
+    rx_params->start_timestamp = 0;
+    rx_params->first_timestamp = 0;
+    fft_size = rx_params->fft_size;
+    fft_averages = rx_params->fft_averages;
+    fft_threads = rx_params->fft_threads;
+    memset(&rx_params->spectrum_stats, 0, sizeof(rx_params->spectrum_stats));
+    MUTEX_UNLOCK(&rx->param_lock);
+
+    /* Timestamps are required to start at a scheduled time */
+    use_meta = use_sigmf || (start_timestamp != 0);
+
+    /* Allocate the ring of sample buffers up front, such that no allocations
+     * occur while receiving */
+#if ENABLE_RX_DIRECT_IO
+    if (posix_memalign((void **) &ring.samples, RX_DIRECT_ALIGNMENT,
+                       (size_t) ring.depth * samples_per_buffer *
+                       sizeof(int16_t) * 2) != 0) {
+        ring.samples = NULL;
+        errno = ENOMEM;
+    }
+#else
+    ring.samples = malloc((size_t) ring.depth * samples_per_buffer *
+                          sizeof(int16_t) * 2);
+#endif
+    ring.lengths = calloc(ring.depth, sizeof(ring.lengths[0]));
+
+    if (ring.samples == NULL || ring.lengths == NULL) {
+        status = errno;
+        set_last_error(&rx->last_error, ETYPE_ERRNO, status);
+    } else if (use_sigmf) {
+        /* Record the state the samples are received with */
+        MUTEX_LOCK(&s->dev_lock);
+        status = sigmf_capture_init(&capture, s->dev);
+        MUTEX_UNLOCK(&s->dev_lock);
+
+        if (status != 0) {
+            set_last_error(&rx->last_error, ETYPE_BLADERF, status);
+        } else {
+            capture_valid = true;
+        }
+    } else if (use_spectrum) {
+        unsigned int sample_rate, frequency;
+
+        MUTEX_LOCK(&s->dev_lock);
+        status = bladerf_get_sample_rate(s->dev, BLADERF_MODULE_RX,
+                                         &sample_rate);
+        if (status == 0) {
+            status = bladerf_get_frequency(s->dev, BLADERF_MODULE_RX,
+                                           &frequency);
+        }
+        MUTEX_UNLOCK(&s->dev_lock);
+
+        if (status != 0) {
+            set_last_error(&rx->last_error, ETYPE_BLADERF, status);
+        } else {
+            spectrum_valid = true;
+            status = spectrum_init(&spectrum, fft_size, fft_averages,
+                                   fft_threads, false, sample_rate, frequency,
+                                   rx_spectrum_report, rx);
+        }
+
+        if (status == 0) {
+            MUTEX_LOCK(&rx->file_mgmt.file_lock);
+            if (fputs(RX_SPECTRUM_HEADER, rx->file_mgmt.file) < 0) {
+                status = CLI_RET_FILEOP;
+            }
+            MUTEX_UNLOCK(&rx->file_mgmt.file_lock);
+        }
+
+        if (status == 0) {
+            /* The writer thread has not yet been started */
+            rx_params->file_state.spectrum = &spectrum;
+        } else if (spectrum_valid) {
+            set_last_error(&rx->last_error, ETYPE_CLI, status);
+        }
+    }
+
+    if (status == 0) {
+        status = pthread_create(&writer_thread, NULL, rx_writer_task, &ring);
+        if (status != 0) {
+            set_last_error(&rx->last_error, ETYPE_ERRNO, status);
+        } else {
+            writer_started = true;
+        }
+    }
+
+    /*
+     * Keep reading samples until a failure or until all requested samples
+     * have been read
+     */
+    while (status == 0 && (num_samples == 0 || samples_read < num_samples)) {
+        int16_t *samples;
+        unsigned int count;
+
+        /*
+         * Stop stream on STOP or SHUTDOWN, but only clear STOP. This will keep
+         * the SHUTDOWN request around so we can read it when determining our
+         * state transition
+         */
+        unsigned char requests = rxtx_get_requests(rx, RXTX_TASK_REQ_STOP);
+        if (requests & (RXTX_TASK_REQ_STOP | RXTX_TASK_REQ_SHUTDOWN)) {
+            break;
+        }
+
+        /* Wait for the writer to free up a buffer, if the ring is full */
+        MUTEX_LOCK(&ring.lock);
+
+        if (ring.count == ring.depth) {
+            ring.stalls++;
+        }
+
+        while (ring.count == ring.depth && ring.status == 0) {
+            pthread_cond_wait(&ring.cond, &ring.lock);
+        }
+
+        status = ring.status;
+        MUTEX_UNLOCK(&ring.lock);
+
+        if (status != 0) {
+            set_last_error(&rx->last_error, ETYPE_CLI, status);
+            break;
+        }
+
+        /* Only this thread modifies the head of the ring */
+        samples = rx_ring_buffer(&ring, ring.head);
+
+        /* Read the samples into the sample buffer. With metadata, fewer
+         * samples are returned when a discontinuity is encountered. A
+         * scheduled reception begins with the sample at the start
+         * timestamp. */
+        if (use_meta) {
+            if (samples_read == 0 && start_timestamp != 0) {
+                meta.flags = 0;
+                meta.timestamp = start_timestamp;
+            } else {
+                meta.flags = BLADERF_META_FLAG_RX_NOW;
+            }
+
+            status = bladerf_sync_rx(s->dev, samples, samples_per_buffer,
+                                     &meta, timeout_ms);
+            count = meta.actual_count;
+
+            if (status == 0 && samples_read == 0 && count != 0) {
+                MUTEX_LOCK(&rx->param_lock);
+                rx_params->first_timestamp = meta.timestamp;
+                MUTEX_UNLOCK(&rx->param_lock);
+            }
+        } else {
+            status = bladerf_sync_rx(s->dev, samples, samples_per_buffer,
+                                     NULL, timeout_ms);
+            count = samples_per_buffer;
+        }
+
+        if (status != 0) {
+            set_last_error(&rx->last_error, ETYPE_BLADERF, status);
+            break;
+        }
+
+        /* A # of samples of 0 receives until stopped */
+        if (num_samples != 0) {
+            count = (unsigned int) min_sz(count, (num_samples - samples_read));
+        }
+
+        if (use_sigmf) {
+            status = sigmf_capture_update(&capture, &meta, count);
+            if (status != 0) {
+                set_last_error(&rx->last_error, ETYPE_BLADERF, status);
+                break;
+            }
+        }
+
+        if (count != 0) {
+            /* Hand the samples off to the writer */
+            MUTEX_LOCK(&ring.lock);
+
+            ring.lengths[ring.head] = count;
+
+            ring.head = (ring.head + 1) % ring.depth;
+            ring.count++;
+            if (ring.count > ring.high_water) {
+                ring.high_water = ring.count;
+            }
+
+            pthread_cond_broadcast(&ring.cond);
+            MUTEX_UNLOCK(&ring.lock);
+        }
+
+        samples_read += count;
+    }
+
+    /* Let the writer finish writing out what has been received */
+    if (writer_started) {
+        MUTEX_LOCK(&ring.lock);
+        ring.done = true;
+        pthread_cond_broadcast(&ring.cond);
+        MUTEX_UNLOCK(&ring.lock);
+
+        pthread_join(writer_thread, NULL);
+
+        if (status == 0 && ring.status != 0) {
+            status = ring.status;
+            set_last_error(&rx->last_error, ETYPE_CLI, status);
+        }
+    }
+
+    /* Write the metadata for whatever was received, even if reception
+     * ended in an error */
+    if (capture_valid) {
+        char *path;
+        int meta_status;
+
+        MUTEX_LOCK(&rx->file_mgmt.file_meta_lock);
+        path = input_expand_path(rx->file_mgmt.path);
+        MUTEX_UNLOCK(&rx->file_mgmt.file_meta_lock);
+
+        if (path == NULL) {
+            meta_status = CLI_RET_MEM;
+        } else {
+            meta_status = sigmf_write_meta(&capture, path);
+            free(path);
+        }
+
+        if (status == 0 && meta_status != 0) {
+            status = meta_status;
+            set_last_error(&rx->last_error, ETYPE_CLI, status);
+        }
+    }
+
+    sigmf_capture_deinit(&capture);
+
+    /* Report the remainder of what was analyzed */
+    if (spectrum_valid) {
+        const int spectrum_status = spectrum_finish(&spectrum);
+
+        if (status == 0 && spectrum_status != 0) {
+            status = spectrum_status;
+            set_last_error(&rx->last_error, ETYPE_CLI, status);
+        }
+
+        spectrum_deinit(&spectrum);
+        rx_params->file_state.spectrum = NULL;
+    }
+
+    MUTEX_LOCK(&rx->param_lock);
+    rx_params->ring_high_water = ring.high_water;
+    rx_params->ring_stalls = ring.stalls;
+    MUTEX_UNLOCK(&rx->param_lock);
+
+    free(ring.samples);
+    free(ring.lengths);
+    pthread_cond_destroy(&ring.cond);
+    pthread_mutex_destroy(&ring.lock);
+
+    return status;
+}
+
+/* Set by rx_signal_trigger(), and consumed by the flight recorder */
+static volatile sig_atomic_t rx_signal_triggered = 0;
+
+void rx_signal_trigger(void)
+{
+    rx_signal_triggered = 1;
+}
+
+/* Preallocated buffers of the most recently received samples, and their
+ * metadata, kept by flight recorder receptions */
+struct rx_history {
+    int16_t *samples;               /* `depth' buffers of `samples_per_buffer' */
+    struct bladerf_metadata *meta;  /* actual_count is the # of samples held */
+    unsigned int depth;
+    unsigned int samples_per_buffer;
+
+    unsigned int head;              /* Next buffer to fill */
+    unsigned int count;             /* # of buffers held */
+};
+
+static inline int16_t *rx_history_buffer(struct rx_history *h, unsigned int i)
+{
+    return h->samples + (size_t) i * h->samples_per_buffer * 2;
+}
+
+/* Mean power of SC16 Q11 samples, in dBFS */
+static double rx_power_dbfs(const int16_t *samples, unsigned int n)
+{
+    double sum = 0;
+    unsigned int i;
+
+    for (i = 0; i < 2 * n; i++) {
+        sum += (double) samples[i] * samples[i];
+    }
+
+    if (sum == 0) {
+        return -INFINITY;
+    }
+
+    return 10.0 * log10(sum / n / (2048.0 * 2048.0));
+}
+
+/* Number of buffers required to hold the specified duration of samples */
+static unsigned int rx_history_buffers(double secs, unsigned int sample_rate,
+                                       unsigned int samples_per_buffer)
+{
+    const double samples = ceil(secs * sample_rate);
+    return (unsigned int) ceil(samples / samples_per_buffer);
+}
+
+/* Write out the history, oldest buffer first. The first dump of a reception
+ * is written to the configured file, and each one after it to the next file
+ * of the sequence used for rotation. The history is then emptied.
+ *
+ * returns 0 on success, CLI_RET_* or BLADERF_ERR_* on failure (and calls
+ * set_last_error()) */
+static int rx_dump_history(struct rxtx_data *rx, struct cli_state *s,
+                           struct rx_history *h, uint64_t trigger_timestamp,
+                           bool use_sigmf)
+{
+    struct rx_params *rx_params = rx->params;
+    struct sigmf_capture capture;
+    bool capture_valid = false;
+    uint64_t first_timestamp = 0;
+    uint64_t num_samples = 0;
+    unsigned int dumps, i;
+    int status = 0;
+
+    MUTEX_LOCK(&rx->param_lock);
+    dumps = rx_params->dumps;
+    MUTEX_UNLOCK(&rx->param_lock);
+
+    if (dumps != 0) {
+        MUTEX_LOCK(&rx->file_mgmt.file_lock);
+        status = rx_next_file(rx);
+        MUTEX_UNLOCK(&rx->file_mgmt.file_lock);
+    }
 
-/* returns 0 on success, CLI_RET_* on failure (and calls set_last_error()) */
-static int rx_write_csv_sc16q11(struct rxtx_data *rx,
-                                int16_t *samples, size_t n_samples)
-{
-    size_t i;
-    int status = 0;
-    const size_t to_write = n_samples * 2;  /* int16_t for I, another for Q */
-    char line[32] = { 0 };
+    memset(&capture, 0, sizeof(capture));
 
-    MUTEX_LOCK(&rx->file_mgmt.file_lock);
+    if (status == 0 && use_sigmf) {
+        MUTEX_LOCK(&s->dev_lock);
+        status = sigmf_capture_init(&capture, s->dev);
+        MUTEX_UNLOCK(&s->dev_lock);
+
+        if (status != 0) {
+            set_last_error(&rx->last_error, ETYPE_BLADERF, status);
+        } else {
+            capture_valid = true;
+        }
+    }
+
+    for (i = 0; status == 0 && i < h->count; i++) {
+        const unsigned int index = (h->head + h->depth - h->count + i) %
+                                   h->depth;
+        const struct bladerf_metadata *meta = &h->meta[index];
+        int16_t *samples = rx_history_buffer(h, index);
 
-    for (i = 0; i < to_write; i += 2) {
-        snprintf(line, sizeof(line), "%d, %d" EOL, samples[i], samples[i + 1]);
+        if (i == 0) {
+            first_timestamp = meta->timestamp;
+        }
+
+        if (capture_valid) {
+            status = sigmf_capture_update(&capture, meta, meta->actual_count);
+            if (status != 0) {
+                set_last_error(&rx->last_error, ETYPE_BLADERF, status);
+                break;
+            }
+        }
+
+        sc16q11_sample_fixup(samples, meta->actual_count);
+        status = rx_params->write_samples(rx, samples, meta->actual_count);
+        num_samples += meta->actual_count;
+    }
 
-        if (fputs(line, rx->file_mgmt.file) < 0) {
+    if (status == 0) {
+        MUTEX_LOCK(&rx->file_mgmt.file_lock);
+        if (fflush(rx->file_mgmt.file) != 0) {
             set_last_error(&rx->last_error, ETYPE_ERRNO, errno);
             status = CLI_RET_FILEOP;
-            break;
         }
+        MUTEX_UNLOCK(&rx->file_mgmt.file_lock);
     }
 
-    MUTEX_UNLOCK(&rx->file_mgmt.file_lock);
+    if (status == 0 && capture_valid) {
+        char *path = rx_file_path(rx, rx_params->file_state.index);
+
+        if (path == NULL) {
+            status = CLI_RET_MEM;
+        } else {
+            status = sigmf_write_meta(&capture, path);
+            free(path);
+        }
+
+        if (status != 0) {
+            set_last_error(&rx->last_error, ETYPE_CLI, status);
+        }
+    }
+
+    sigmf_capture_deinit(&capture);
+
+    if (status == 0) {
+        MUTEX_LOCK(&rx->param_lock);
+        rx_params->dumps++;
+        rx_params->dump_timestamp = first_timestamp;
+        rx_params->trigger_timestamp = trigger_timestamp;
+        rx_params->dump_samples = num_samples;
+        MUTEX_UNLOCK(&rx->param_lock);
+
+        rxtx_notify_event(rx, "rx dump\n");
+    }
+
+    h->count = 0;
     return status;
 }
 
-static int rx_task_exec_running(struct rxtx_data *rx, struct cli_state *s)
+/*
+ * Receive into a history of the most recent samples, without writing them
+ * out until a trigger occurs: an "rx trigger" command, SIGUSR1, or a buffer
+ * whose mean power reaches the trigger level. The history kept from before
+ * the trigger, and the samples received in the post-trigger time after it,
+ * are then written out as one dump.
+ *
+ * Reception pauses while a dump is written. With the SigMF format, each
+ * dump's metadata records the timestamps of its samples, including any
+ * discontinuity this introduces into the history.
+ */
+static int rx_task_exec_recording(struct rxtx_data *rx, struct cli_state *s)
 {
-    int status = 0;
-    int samples_per_buffer;
-    void *samples;
-    size_t num_samples;
-    size_t samples_read = 0;
-    int (*write_samples)(struct rxtx_data *rx, int16_t *samples, size_t n);
-    unsigned int timeout_ms;
+    struct rx_params *rx_params = rx->params;
+    struct rx_history h;
+    unsigned int samples_per_buffer, timeout_ms, sample_rate;
+    unsigned int pre_buffers, post_buffers, remaining = 0;
+    size_t num_samples, samples_read = 0;
+    double history_secs, post_secs, trigger_dbfs;
+    bool trigger_level_set, use_sigmf, triggered = false;
+    uint64_t trigger_timestamp = 0;
+    int status;
 
-    /* Read the parameters that will be used for the sync transfers */
     MUTEX_LOCK(&rx->data_mgmt.lock);
     timeout_ms = rx->data_mgmt.timeout_ms;
     samples_per_buffer = rx->data_mgmt.samples_per_buffer;
     MUTEX_UNLOCK(&rx->data_mgmt.lock);
 
+    MUTEX_LOCK(&rx->file_mgmt.file_meta_lock);
+    use_sigmf = (rx->file_mgmt.format == RXTX_FMT_SIGMF_SC16Q11);
+    MUTEX_UNLOCK(&rx->file_mgmt.file_meta_lock);
+
     MUTEX_LOCK(&rx->param_lock);
-    num_samples = ((struct rx_params*)rx->params)->n_samples;
-    write_samples = ((struct rx_params*)rx->params)->write_samples;
+    num_samples = rx_params->n_samples;
+    history_secs = rx_params->history_secs;
+    post_secs = rx_params->post_secs;
+    trigger_level_set = rx_params->trigger_level_set;
+    trigger_dbfs = rx_params->trigger_dbfs;
+    rx_params->trigger_req = false;
+    rx_params->first_timestamp = 0;
+    rx_params->dumps = 0;
+    rx_params->dump_timestamp = 0;
+    rx_params->trigger_timestamp = 0;
+    rx_params->dump_samples = 0;
     MUTEX_UNLOCK(&rx->param_lock);
 
-    /* Allocate a buffer for the block of samples */
-    samples = malloc(samples_per_buffer * sizeof(uint16_t) * 2);
-    if (samples == NULL) {
-        status = errno;
+    MUTEX_LOCK(&s->dev_lock);
+    status = bladerf_get_sample_rate(s->dev, BLADERF_MODULE_RX, &sample_rate);
+    MUTEX_UNLOCK(&s->dev_lock);
+
+    if (status != 0) {
+        set_last_error(&rx->last_error, ETYPE_BLADERF, status);
+        return status;
+    }
+
+    pre_buffers = rx_history_buffers(history_secs, sample_rate,
+                                     samples_per_buffer);
+    post_buffers = rx_history_buffers(post_secs, sample_rate,
+                                      samples_per_buffer);
+
+    /* The buffer that triggers a dump is part of the history */
+    if (pre_buffers == 0) {
+        pre_buffers = 1;
+    }
+
+    memset(&h, 0, sizeof(h));
+    h.depth = pre_buffers + post_buffers;
+    h.samples_per_buffer = samples_per_buffer;
+
+    /* All of the history is allocated up front, such that no allocations
+     * occur while receiving */
+#if ENABLE_RX_DIRECT_IO
+    if (posix_memalign((void **) &h.samples, RX_DIRECT_ALIGNMENT,
+                       (size_t) h.depth * samples_per_buffer *
+                       sizeof(int16_t) * 2) != 0) {
+        h.samples = NULL;
+    }
+#else
+    h.samples = malloc((size_t) h.depth * samples_per_buffer *
+                       sizeof(int16_t) * 2);
+#endif
+    h.meta = calloc(h.depth, sizeof(h.meta[0]));
+
+    if (h.samples == NULL || h.meta == NULL) {
+        status = ENOMEM;
         set_last_error(&rx->last_error, ETYPE_ERRNO, status);
     }
 
-    /*
-     * Keep reading samples until a failure or until all requested samples
-     * have been read
-     */
+    rx_signal_triggered = 0;
+
     while (status == 0 && (num_samples == 0 || samples_read < num_samples)) {
-        /*
-         * Stop stream on STOP or SHUTDOWN, but only clear STOP. This will keep
-         * the SHUTDOWN request around so we can read it when determining our
-         * state transition
-         */
+        struct bladerf_metadata *meta = &h.meta[h.head];
+        int16_t *samples = rx_history_buffer(&h, h.head);
+        unsigned int count;
+
         unsigned char requests = rxtx_get_requests(rx, RXTX_TASK_REQ_STOP);
         if (requests & (RXTX_TASK_REQ_STOP | RXTX_TASK_REQ_SHUTDOWN)) {
             break;
         }
 
-        /* Read the samples into the sample buffer */
-        status = bladerf_sync_rx(s->dev, samples, samples_per_buffer, NULL,
-                                 timeout_ms);
+        memset(meta, 0, sizeof(*meta));
+        meta->flags = BLADERF_META_FLAG_RX_NOW;
 
+        status = bladerf_sync_rx(s->dev, samples, samples_per_buffer,
+                                 meta, timeout_ms);
         if (status != 0) {
             set_last_error(&rx->last_error, ETYPE_BLADERF, status);
+            break;
+        }
+
+        count = meta->actual_count;
+        if (num_samples != 0) {
+            count = (unsigned int) min_sz(count, (num_samples - samples_read));
+            meta->actual_count = count;
+        }
+
+        if (count == 0) {
+            continue;
+        }
+
+        if (samples_read == 0) {
+            MUTEX_LOCK(&rx->param_lock);
+            rx_params->first_timestamp = meta->timestamp;
+            MUTEX_UNLOCK(&rx->param_lock);
+        }
+
+        h.head = (h.head + 1) % h.depth;
+        if (h.count < h.depth) {
+            h.count++;
+        }
+
+        samples_read += count;
+
+        if (triggered) {
+            remaining--;
         } else {
-            size_t to_write = min_sz(samples_per_buffer,
-                                     (num_samples - samples_read));
+            bool trigger;
 
-            /* Write the samples to the output file */
-            sc16q11_sample_fixup(samples, to_write);
-            status = write_samples(rx, samples, to_write);
+            MUTEX_LOCK(&rx->param_lock);
+            trigger = rx_params->trigger_req;
+            rx_params->trigger_req = false;
+            MUTEX_UNLOCK(&rx->param_lock);
 
-            if (status != 0) {
-                set_last_error(&rx->last_error, ETYPE_CLI, status);
+            if (rx_signal_triggered) {
+                rx_signal_triggered = 0;
+                trigger = true;
+            }
+
+            if (trigger || (trigger_level_set &&
+                            rx_power_dbfs(samples, count) >= trigger_dbfs)) {
+                triggered = true;
+                trigger_timestamp = meta->timestamp;
+                remaining = post_buffers;
             }
         }
 
-        samples_read += samples_per_buffer;
+        if (triggered && remaining == 0) {
+            status = rx_dump_history(rx, s, &h, trigger_timestamp, use_sigmf);
+            triggered = false;
+        }
     }
 
-    /* Free the sample buffer */
-    if (samples != NULL) {
-        free(samples);
+    /* Write out what was received after a trigger before reception ended */
+    if (triggered) {
+        const int dump_status = rx_dump_history(rx, s, &h, trigger_timestamp,
+                                                use_sigmf);
+        if (status == 0) {
+            status = dump_status;
+        }
     }
 
+    free(h.samples);
+    free(h.meta);
+
     return status;
 }
 
@@ -229,6 +1264,18 @@ void *rx_task(void *cli_state_arg)
                 set_last_error(&rx->last_error, ETYPE_ERRNO, 0);
                 status = 0;
 
+                /* Reset the output file state for this reception */
+                MUTEX_LOCK(&rx->param_lock);
+                memset(&rx_params->file_state, 0,
+                       sizeof(rx_params->file_state));
+                rx_params->file_state.opened = time(NULL);
+                rx_params->file_state.use_direct = rx_params->direct;
+                rx_params->file_state.rotate_bytes = rx_params->rotate_bytes;
+                rx_params->file_state.rotate_secs = rx_params->rotate_secs;
+                rx_params->file_state.sc8_shift = rx_params->sc8_shift;
+                rx_params->file_state.recording = rx_params->history_secs != 0;
+                MUTEX_UNLOCK(&rx->param_lock);
+
                 /* Choose the callback appropriate for the desired file type */
                 MUTEX_LOCK(&rx->file_mgmt.file_meta_lock);
 
@@ -237,8 +1284,30 @@ void *rx_task(void *cli_state_arg)
                         rx_params->write_samples = rx_write_csv_sc16q11;
                         break;
 
+                    case RXTX_FMT_BIN_SC12:
+                        rx_params->write_samples = rx_write_bin_sc12;
+                        break;
+
+                    case RXTX_FMT_BIN_SC8:
+                        rx_params->write_samples = rx_write_bin_sc8;
+                        break;
+
+                    case RXTX_FMT_BIN_CF32:
+                        rx_params->write_samples = rx_write_bin_cf32;
+                        break;
+
+                    case RXTX_FMT_SPECTRUM:
+                        rx_params->write_samples = rx_write_spectrum;
+                        break;
+
                     case RXTX_FMT_BIN_SC16Q11:
+                    case RXTX_FMT_SIGMF_SC16Q11:
                         rx_params->write_samples = rx_write_bin_sc16q11;
+#if ENABLE_RX_DIRECT_IO
+                        if (rx_params->file_state.use_direct) {
+                            rx_params->write_samples = rx_write_bin_direct;
+                        }
+#endif
                         break;
 
                     default:
@@ -253,13 +1322,30 @@ void *rx_task(void *cli_state_arg)
 
                 MUTEX_UNLOCK(&rx->file_mgmt.file_meta_lock);
 
-                /* Set up the reception stream and buffer information */
+                /* Set up the reception stream and buffer information. The
+                 * SigMF format, scheduled receptions and the flight recorder
+                 * require the timestamps of samples. */
                 if (status == 0) {
+                    bladerf_format fmt = BLADERF_FORMAT_SC16_Q11;
+
+                    MUTEX_LOCK(&rx->file_mgmt.file_meta_lock);
+                    if (rx->file_mgmt.format == RXTX_FMT_SIGMF_SC16Q11) {
+                        fmt = BLADERF_FORMAT_SC16_Q11_META;
+                    }
+                    MUTEX_UNLOCK(&rx->file_mgmt.file_meta_lock);
+
+                    MUTEX_LOCK(&rx->param_lock);
+                    if (rx_params->start_timestamp != 0 ||
+                        rx_params->file_state.recording) {
+                        fmt = BLADERF_FORMAT_SC16_Q11_META;
+                    }
+                    MUTEX_UNLOCK(&rx->param_lock);
+
                     MUTEX_LOCK(&rx->data_mgmt.lock);
 
                     status = bladerf_sync_config(cli_state->dev,
                                                  BLADERF_MODULE_RX,
-                                                 BLADERF_FORMAT_SC16_Q11,
+                                                 fmt,
                                                  rx->data_mgmt.num_buffers,
                                                  rx->data_mgmt.samples_per_buffer,
                                                  rx->data_mgmt.num_transfers,
@@ -291,7 +1377,11 @@ void *rx_task(void *cli_state_arg)
                 if (status < 0) {
                     set_last_error(&rx->last_error, ETYPE_BLADERF, status);
                 } else {
-                    status = rx_task_exec_running(rx, cli_state);
+                    if (rx_params->file_state.recording) {
+                        status = rx_task_exec_recording(rx, cli_state);
+                    } else {
+                        status = rx_task_exec_running(rx, cli_state);
+                    }
 
                     MUTEX_LOCK(dev_lock);
                     disable_status = bladerf_enable_module(cli_state->dev,
@@ -324,7 +1414,7 @@ void *rx_task(void *cli_state_arg)
     return NULL;
 }
 
-static int rx_cmd_start(struct cli_state *s)
+int rx_cmd_start(struct cli_state *s)
 {
     int status;
 
@@ -334,14 +1424,58 @@ static int rx_cmd_start(struct cli_state *s)
         return status;
     }
 
+    /* The SigMF metadata describes a single data file, and spectrum
+     * statistics are written to a single log */
+    MUTEX_LOCK(&s->rx->file_mgmt.file_meta_lock);
+    if (s->rx->file_mgmt.format == RXTX_FMT_SIGMF_SC16Q11 ||
+        s->rx->file_mgmt.format == RXTX_FMT_SPECTRUM) {
+        struct rx_params *rx_params = s->rx->params;
+
+        MUTEX_LOCK(&s->rx->param_lock);
+        if (rx_params->rotate_bytes != 0 || rx_params->rotate_secs != 0) {
+            status = CLI_RET_INVPARAM;
+        }
+        MUTEX_UNLOCK(&s->rx->param_lock);
+    }
+    MUTEX_UNLOCK(&s->rx->file_mgmt.file_meta_lock);
+
+    if (status != 0) {
+        cli_err(s, "rx", "File rotation is not supported with the "
+                "sigmf and spectrum formats.\n");
+        return status;
+    }
+
+    /* Flight recorder dumps are each written to a file of their own */
+    MUTEX_LOCK(&s->rx->file_mgmt.file_meta_lock);
+    {
+        struct rx_params *rx_params = s->rx->params;
+
+        MUTEX_LOCK(&s->rx->param_lock);
+        if (rx_params->history_secs != 0 &&
+            (s->rx->file_mgmt.format == RXTX_FMT_SPECTRUM ||
+             rx_params->rotate_bytes != 0 || rx_params->rotate_secs != 0)) {
+            status = CLI_RET_INVPARAM;
+        }
+        MUTEX_UNLOCK(&s->rx->param_lock);
+    }
+    MUTEX_UNLOCK(&s->rx->file_mgmt.file_meta_lock);
+
+    if (status != 0) {
+        cli_err(s, "rx", "The spectrum format and file rotation are not "
+                "supported with a history.\n");
+        return status;
+    }
+
     /* Set up output file */
     MUTEX_LOCK(&s->rx->file_mgmt.file_lock);
-    if(s->rx->file_mgmt.format == RXTX_FMT_CSV_SC16Q11) {
+    if (s->rx->file_mgmt.format == RXTX_FMT_CSV_SC16Q11 ||
+        s->rx->file_mgmt.format == RXTX_FMT_SPECTRUM) {
         status = expand_and_open(s->rx->file_mgmt.path, "w",
                                  &s->rx->file_mgmt.file);
 
     } else {
-        /* RXTX_FMT_BIN_SC16Q11, open file in binary mode */
+        /* RXTX_FMT_BIN_SC16Q11 or RXTX_FMT_SIGMF_SC16Q11, open file in
+         * binary mode */
         status = expand_and_open(s->rx->file_mgmt.path, "wb",
                                  &s->rx->file_mgmt.file);
     }
@@ -368,10 +1502,40 @@ static int rx_cmd_start(struct cli_state *s)
 static void rx_print_config(struct rxtx_data *rx)
 {
     size_t n_samples;
+    unsigned int ring_depth, ring_high_water, ring_stalls;
+    unsigned int sc8_shift;
+    unsigned int fft_size, fft_averages, fft_threads;
+    struct spectrum_stats spectrum_stats;
+    bool direct;
+    uint64_t rotate_bytes;
+    unsigned int rotate_secs;
+    double history_secs, post_secs, trigger_dbfs;
+    bool trigger_level_set;
+    unsigned int dumps;
+    uint64_t dump_timestamp, trigger_timestamp, dump_samples;
     struct rx_params *rx_params = rx->params;
 
     MUTEX_LOCK(&rx->param_lock);
     n_samples = rx_params->n_samples;
+    ring_depth = rx_params->ring_depth;
+    ring_high_water = rx_params->ring_high_water;
+    ring_stalls = rx_params->ring_stalls;
+    sc8_shift = rx_params->sc8_shift;
+    fft_size = rx_params->fft_size;
+    fft_averages = rx_params->fft_averages;
+    fft_threads = rx_params->fft_threads;
+    spectrum_stats = rx_params->spectrum_stats;
+    direct = rx_params->direct;
+    rotate_bytes = rx_params->rotate_bytes;
+    rotate_secs = rx_params->rotate_secs;
+    history_secs = rx_params->history_secs;
+    post_secs = rx_params->post_secs;
+    trigger_level_set = rx_params->trigger_level_set;
+    trigger_dbfs = rx_params->trigger_dbfs;
+    dumps = rx_params->dumps;
+    dump_timestamp = rx_params->dump_timestamp;
+    trigger_timestamp = rx_params->trigger_timestamp;
+    dump_samples = rx_params->dump_samples;
     MUTEX_UNLOCK(&rx->param_lock);
 
     rxtx_print_state(rx, "\n  State: ", "\n");
@@ -386,6 +1550,60 @@ static void rx_print_config(struct rxtx_data *rx)
     }
     rxtx_print_stream_info(rx, "  ", "\n");
 
+    printf("  SC8 shift: %u\n", sc8_shift);
+    printf("  Direct I/O: %s\n", direct ? "on" : "off");
+
+    if (rotate_bytes) {
+        printf("  Rotate size: %" PRIu64 " bytes\n", rotate_bytes);
+    } else {
+        printf("  Rotate size: off\n");
+    }
+
+    if (rotate_secs) {
+        printf("  Rotate time: %u s\n", rotate_secs);
+    } else {
+        printf("  Rotate time: off\n");
+    }
+
+    if (history_secs != 0) {
+        printf("  History: %g s, post-trigger: %g s\n", history_secs,
+               post_secs);
+    } else {
+        printf("  History: off\n");
+    }
+
+    if (trigger_level_set) {
+        printf("  Trigger level: %.2f dBFS\n", trigger_dbfs);
+    } else {
+        printf("  Trigger level: off\n");
+    }
+
+    if (dumps != 0) {
+        printf("  Dumps: %u (last: %" PRIu64 " samples from timestamp %"
+               PRIu64 ", triggered at %" PRIu64 ")\n", dumps, dump_samples,
+               dump_timestamp, trigger_timestamp);
+    }
+
+    printf("  # Ring buffers: %u\n", ring_depth);
+    printf("  Ring high-water mark: %u (full %u times)\n",
+           ring_high_water, ring_stalls);
+
+    printf("  FFT size: %u\n", fft_size);
+    printf("  FFT averages: %u\n", fft_averages);
+    printf("  FFT threads: %u\n", fft_threads);
+
+    if (spectrum_stats.reports != 0) {
+        const uint64_t total = spectrum_stats.analyzed + spectrum_stats.skipped;
+
+        printf("  Spectrum peak: %.2f dBFS at %.0f Hz\n",
+               spectrum_stats.peak_dbfs, spectrum_stats.peak_hz);
+        printf("  Spectrum noise floor: %.2f dBFS\n",
+               spectrum_stats.noise_dbfs);
+        printf("  Spectrum reports: %" PRIu64 " (%.1f%% of samples "
+               "analyzed)\n", spectrum_stats.reports,
+               100.0 * spectrum_stats.analyzed / total);
+    }
+
     printf("\n");
 }
 
@@ -426,6 +1644,193 @@ static int rx_cmd_config(struct cli_state *s, int argc, char **argv)
                     return CLI_RET_INVPARAM;
                 }
 
+            } else if (!strcasecmp("direct", argv[i])) {
+                /* Configure use of O_DIRECT for binary output */
+                bool direct;
+
+                if (!strcasecmp(val, "on")) {
+                    direct = true;
+                } else if (!strcasecmp(val, "off")) {
+                    direct = false;
+                } else {
+                    cli_err(s, argv[0], RXTX_ERRMSG_VALUE(argv[i], val));
+                    return CLI_RET_INVPARAM;
+                }
+
+#if !ENABLE_RX_DIRECT_IO
+                if (direct) {
+                    cli_err(s, argv[0],
+                            "Direct I/O is not supported on this platform.\n");
+                    return CLI_RET_INVPARAM;
+                }
+#endif
+
+                MUTEX_LOCK(&s->rx->param_lock);
+                rx_params->direct = direct;
+                MUTEX_UNLOCK(&s->rx->param_lock);
+
+            } else if (!strcasecmp("rotate_size", argv[i])) {
+                /* Configure size at which to start a new output file */
+                uint64_t n;
+                bool ok;
+
+                n = str2uint64_suffix(val, 0, UINT64_MAX, rxtx_kmg_suffixes,
+                                      (int)rxtx_kmg_suffixes_len, &ok);
+
+                if (ok) {
+                    MUTEX_LOCK(&s->rx->param_lock);
+                    rx_params->rotate_bytes = n;
+                    MUTEX_UNLOCK(&s->rx->param_lock);
+                } else {
+                    cli_err(s, argv[0], RXTX_ERRMSG_VALUE(argv[i], val));
+                    return CLI_RET_INVPARAM;
+                }
+
+            } else if (!strcasecmp("rotate_time", argv[i])) {
+                /* Configure age at which to start a new output file */
+                unsigned int n;
+                bool ok;
+
+                n = str2uint_suffix(val, 0, UINT_MAX, rx_rotate_time_suffixes,
+                                    (int)ARRAY_SIZE(rx_rotate_time_suffixes),
+                                    &ok);
+
+                if (ok) {
+                    MUTEX_LOCK(&s->rx->param_lock);
+                    rx_params->rotate_secs = n;
+                    MUTEX_UNLOCK(&s->rx->param_lock);
+                } else {
+                    cli_err(s, argv[0], RXTX_ERRMSG_VALUE(argv[i], val));
+                    return CLI_RET_INVPARAM;
+                }
+
+            } else if (!strcasecmp("sc8_shift", argv[i])) {
+                /* Configure scaling of samples written in the SC8 format */
+                unsigned int shift;
+                bool ok;
+
+                shift = str2uint(val, 0, RX_SC8_SHIFT_MAX, &ok);
+
+                if (ok) {
+                    MUTEX_LOCK(&s->rx->param_lock);
+                    rx_params->sc8_shift = shift;
+                    MUTEX_UNLOCK(&s->rx->param_lock);
+                } else {
+                    cli_err(s, argv[0], RXTX_ERRMSG_VALUE(argv[i], val));
+                    return CLI_RET_INVPARAM;
+                }
+
+            } else if (!strcasecmp("fft_size", argv[i])) {
+                /* Configure the FFT size used by the spectrum format */
+                unsigned int size;
+                bool ok;
+
+                size = str2uint_suffix(val, SPECTRUM_FFT_SIZE_MIN,
+                                       SPECTRUM_FFT_SIZE_MAX,
+                                       rxtx_kmg_suffixes,
+                                       (int)rxtx_kmg_suffixes_len, &ok);
+
+                if (ok && (size & (size - 1)) == 0) {
+                    MUTEX_LOCK(&s->rx->param_lock);
+                    rx_params->fft_size = size;
+                    MUTEX_UNLOCK(&s->rx->param_lock);
+                } else {
+                    cli_err(s, argv[0], RXTX_ERRMSG_VALUE(argv[i], val));
+                    return CLI_RET_INVPARAM;
+                }
+
+            } else if (!strcasecmp("fft_avg", argv[i])) {
+                /* Configure the # of FFTs averaged per spectrum report */
+                unsigned int averages;
+                bool ok;
+
+                averages = str2uint_suffix(val, 1, RX_FFT_AVERAGES_MAX,
+                                           rxtx_kmg_suffixes,
+                                           (int)rxtx_kmg_suffixes_len, &ok);
+
+                if (ok) {
+                    MUTEX_LOCK(&s->rx->param_lock);
+                    rx_params->fft_averages = averages;
+                    MUTEX_UNLOCK(&s->rx->param_lock);
+                } else {
+                    cli_err(s, argv[0], RXTX_ERRMSG_VALUE(argv[i], val));
+                    return CLI_RET_INVPARAM;
+                }
+
+            } else if (!strcasecmp("fft_threads", argv[i])) {
+                /* Configure the # of spectrum analysis worker threads */
+                unsigned int threads;
+                bool ok;
+
+                threads = str2uint(val, 1, SPECTRUM_THREADS_MAX, &ok);
+
+                if (ok) {
+                    MUTEX_LOCK(&s->rx->param_lock);
+                    rx_params->fft_threads = threads;
+                    MUTEX_UNLOCK(&s->rx->param_lock);
+                } else {
+                    cli_err(s, argv[0], RXTX_ERRMSG_VALUE(argv[i], val));
+                    return CLI_RET_INVPARAM;
+                }
+
+            } else if (!strcasecmp("history", argv[i]) ||
+                       !strcasecmp("post", argv[i])) {
+                /* Configure the flight recorder's durations */
+                double secs;
+                bool ok;
+
+                secs = str2double(val, 0, RX_HISTORY_SECS_MAX, &ok);
+
+                if (ok) {
+                    MUTEX_LOCK(&s->rx->param_lock);
+                    if (!strcasecmp("history", argv[i])) {
+                        rx_params->history_secs = secs;
+                    } else {
+                        rx_params->post_secs = secs;
+                    }
+                    MUTEX_UNLOCK(&s->rx->param_lock);
+                } else {
+                    cli_err(s, argv[0], RXTX_ERRMSG_VALUE(argv[i], val));
+                    return CLI_RET_INVPARAM;
+                }
+
+            } else if (!strcasecmp("trigger", argv[i])) {
+                /* Configure the flight recorder's power trigger */
+                double dbfs = 0;
+                bool ok = true;
+                const bool off = !strcasecmp(val, "off");
+
+                if (!off) {
+                    dbfs = str2double(val, -200.0, 0.0, &ok);
+                }
+
+                if (ok) {
+                    MUTEX_LOCK(&s->rx->param_lock);
+                    rx_params->trigger_level_set = !off;
+                    rx_params->trigger_dbfs = dbfs;
+                    MUTEX_UNLOCK(&s->rx->param_lock);
+                } else {
+                    cli_err(s, argv[0], RXTX_ERRMSG_VALUE(argv[i], val));
+                    return CLI_RET_INVPARAM;
+                }
+
+            } else if (!strcasecmp("ring", argv[i])) {
+                /* Configure number of buffers queued for the file writer */
+                unsigned int depth;
+                bool ok;
+
+                depth = str2uint(val, RX_RING_DEPTH_MIN, RX_RING_DEPTH_MAX,
+                                 &ok);
+
+                if (ok) {
+                    MUTEX_LOCK(&s->rx->param_lock);
+                    rx_params->ring_depth = depth;
+                    MUTEX_UNLOCK(&s->rx->param_lock);
+                } else {
+                    cli_err(s, argv[0], RXTX_ERRMSG_VALUE(argv[i], val));
+                    return CLI_RET_INVPARAM;
+                }
+
             } else {
                 cli_err(s, argv[0],
                         "Unrecognized config parameter: %s\n", argv[i]);
@@ -437,6 +1842,27 @@ static int rx_cmd_config(struct cli_state *s, int argc, char **argv)
     return 0;
 }
 
+/* Request a dump from the running flight recorder reception */
+static int rx_cmd_trigger(struct cli_state *s)
+{
+    struct rx_params *rx_params = s->rx->params;
+    bool recording;
+
+    MUTEX_LOCK(&s->rx->param_lock);
+    recording = rx_params->file_state.recording;
+    if (recording) {
+        rx_params->trigger_req = true;
+    }
+    MUTEX_UNLOCK(&s->rx->param_lock);
+
+    if (!recording || rxtx_get_state(s->rx) != RXTX_STATE_RUNNING) {
+        cli_err(s, "rx", "No reception with a history is running.\n");
+        return CLI_RET_STATE;
+    }
+
+    return 0;
+}
+
 int cmd_rx(struct cli_state *s, int argc, char **argv)
 {
     int ret;
@@ -454,6 +1880,8 @@ int cmd_rx(struct cli_state *s, int argc, char **argv)
         ret = rx_cmd_config(s, argc, argv);
     } else if (!strcasecmp(argv[1], RXTX_CMD_WAIT)) {
         ret = rxtx_handle_wait(s, s->rx, argc, argv);
+    } else if (!strcasecmp(argv[1], RX_CMD_TRIGGER)) {
+        ret = rx_cmd_trigger(s);
     } else {
         cli_err(s, argv[0], "Invalid command: \"%s\"\n", argv[1]);
         ret = CLI_RET_INVPARAM;
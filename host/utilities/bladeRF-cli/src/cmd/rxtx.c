@@ -31,6 +31,13 @@
 #include <time.h>
 #endif
 
+#if BLADERF_OS_WINDOWS
+#include <io.h>
+#define write _write
+#else
+#include <unistd.h>
+#endif
+
 #include "rxtx.h"
 #include "rxtx_impl.h"
 #include "cmd/cmd.h"
@@ -70,8 +77,40 @@ void rxtx_set_state(struct rxtx_data *rxtx, enum rxtx_state state)
 {
     MUTEX_LOCK(&rxtx->task_mgmt.lock);
     rxtx->task_mgmt.state = state;
-    pthread_cond_signal(&rxtx->task_mgmt.signal_state_change);
+    pthread_cond_broadcast(&rxtx->task_mgmt.signal_state_change);
+    MUTEX_UNLOCK(&rxtx->task_mgmt.lock);
+}
+
+void rxtx_set_notify_fd(struct rxtx_data *rxtx, int fd)
+{
+    MUTEX_LOCK(&rxtx->task_mgmt.lock);
+    rxtx->task_mgmt.notify_fd = fd;
+    MUTEX_UNLOCK(&rxtx->task_mgmt.lock);
+}
+
+void rxtx_notify_event(struct rxtx_data *rxtx, const char *event)
+{
+    int fd;
+
+    MUTEX_LOCK(&rxtx->task_mgmt.lock);
+    fd = rxtx->task_mgmt.notify_fd;
     MUTEX_UNLOCK(&rxtx->task_mgmt.lock);
+
+    if (fd >= 0) {
+        /* Events are short enough to be written atomically to a pipe */
+        if (write(fd, event, (unsigned int) strlen(event)) < 0) {
+            fprintf(stderr, "Failed to write %s event: %s\n",
+                    rxtx->module == BLADERF_MODULE_RX ? "RX" : "TX",
+                    strerror(errno));
+        }
+    }
+}
+
+/* Write a completion event to the notification descriptor, if one is set */
+static void rxtx_notify(struct rxtx_data *rxtx)
+{
+    rxtx_notify_event(rxtx, rxtx->module == BLADERF_MODULE_RX ?
+                                "rx done\n" : "tx done\n");
 }
 
 enum rxtx_state rxtx_get_state(struct rxtx_data *rxtx)
@@ -194,6 +233,21 @@ void rxtx_print_file_format(struct rxtx_data *rxtx,
         case RXTX_FMT_BIN_SC16Q11:
             printf("%sSC16 Q11, Binary%s", prefix, suffix);
             break;
+        case RXTX_FMT_SIGMF_SC16Q11:
+            printf("%sSC16 Q11, SigMF%s", prefix, suffix);
+            break;
+        case RXTX_FMT_BIN_SC12:
+            printf("%sSC12, Packed binary%s", prefix, suffix);
+            break;
+        case RXTX_FMT_BIN_SC8:
+            printf("%sSC8, Binary%s", prefix, suffix);
+            break;
+        case RXTX_FMT_BIN_CF32:
+            printf("%sCF32, Binary%s", prefix, suffix);
+            break;
+        case RXTX_FMT_SPECTRUM:
+            printf("%sSpectrum statistics, CSV%s", prefix, suffix);
+            break;
         default:
             printf("%sNot configured%s", prefix, suffix);
     }
@@ -255,6 +309,16 @@ enum rxtx_fmt rxtx_str2fmt(const char *str)
         ret = RXTX_FMT_CSV_SC16Q11;
     } else if (!strcasecmp("bin", str)) {
         ret = RXTX_FMT_BIN_SC16Q11;
+    } else if (!strcasecmp("sigmf", str)) {
+        ret = RXTX_FMT_SIGMF_SC16Q11;
+    } else if (!strcasecmp("sc12", str)) {
+        ret = RXTX_FMT_BIN_SC12;
+    } else if (!strcasecmp("sc8", str)) {
+        ret = RXTX_FMT_BIN_SC8;
+    } else if (!strcasecmp("cf32", str)) {
+        ret = RXTX_FMT_BIN_CF32;
+    } else if (!strcasecmp("spectrum", str)) {
+        ret = RXTX_FMT_SPECTRUM;
     }
 
     return ret;
@@ -284,6 +348,28 @@ struct rxtx_data *rxtx_data_alloc(bladerf_module module)
             return NULL;
         } else {
             rx_params->n_samples = 100000;
+            rx_params->ring_depth = RX_RING_DEPTH_DEFAULT;
+            rx_params->sc8_shift = RX_SC8_SHIFT_DEFAULT;
+            rx_params->fft_size = RX_FFT_SIZE_DEFAULT;
+            rx_params->fft_averages = RX_FFT_AVERAGES_DEFAULT;
+            rx_params->fft_threads = RX_FFT_THREADS_DEFAULT;
+            memset(&rx_params->spectrum_stats, 0,
+                   sizeof(rx_params->spectrum_stats));
+            rx_params->ring_high_water = 0;
+            rx_params->ring_stalls = 0;
+            rx_params->direct = false;
+            rx_params->rotate_bytes = 0;
+            rx_params->rotate_secs = 0;
+            rx_params->history_secs = 0;
+            rx_params->post_secs = 0;
+            rx_params->trigger_level_set = false;
+            rx_params->trigger_dbfs = 0;
+            rx_params->trigger_req = false;
+            rx_params->dumps = 0;
+            rx_params->dump_timestamp = 0;
+            rx_params->trigger_timestamp = 0;
+            rx_params->dump_samples = 0;
+            memset(&rx_params->file_state, 0, sizeof(rx_params->file_state));
             ret->params = rx_params;
         }
     } else {
@@ -296,6 +382,8 @@ struct rxtx_data *rxtx_data_alloc(bladerf_module module)
         } else {
             tx_params->repeat = 1;
             tx_params->repeat_delay = 0;
+            tx_params->ring_depth = TX_RING_DEPTH_DEFAULT;
+            tx_params->ring_stalls = 0;
             ret->params = tx_params;
         }
     }
@@ -325,6 +413,7 @@ struct rxtx_data *rxtx_data_alloc(bladerf_module module)
     pthread_cond_init(&ret->task_mgmt.signal_done, NULL);
     pthread_cond_init(&ret->task_mgmt.signal_state_change, NULL);
     ret->task_mgmt.main_task_waiting = false;
+    ret->task_mgmt.notify_fd = -1;
 
     cli_error_init(&ret->last_error);
 
@@ -661,6 +750,7 @@ void rxtx_task_exec_stop(struct rxtx_data *rxtx, unsigned char *requests)
     *requests = 0;
 
     rxtx_release_wait(rxtx);
+    rxtx_notify(rxtx);
 }
 
 int rxtx_handle_wait(struct cli_state *s, struct rxtx_data *rxtx,
@@ -683,12 +773,6 @@ int rxtx_handle_wait(struct cli_state *s, struct rxtx_data *rxtx,
         return CLI_RET_NARGS;
     }
 
-    /* The start cmd should have waited until we entered the RUNNING state */
-    state = rxtx_get_state(rxtx);
-    if (state != RXTX_STATE_RUNNING) {
-        return 0;
-    }
-
     if (argc == 3) {
         timeout_ms = str2uint_suffix(argv[2], 0, UINT_MAX, times,
                                      sizeof(times)/sizeof(times[0]), &ok);
@@ -705,6 +789,7 @@ int rxtx_handle_wait(struct cli_state *s, struct rxtx_data *rxtx,
      * able to acquire the device control lock to release this wait. */
     MUTEX_UNLOCK(&s->dev_lock);
 
+    status = 0;
     if (timeout_ms != 0) {
         const unsigned int timeout_sec = timeout_ms / 1000;
 
@@ -720,30 +805,32 @@ int rxtx_handle_wait(struct cli_state *s, struct rxtx_data *rxtx,
             timeout_abs.tv_sec += timeout_abs.tv_nsec / NSEC_PER_SEC;
             timeout_abs.tv_nsec %= NSEC_PER_SEC;
         }
+    }
 
-        MUTEX_LOCK(&rxtx->task_mgmt.lock);
-        rxtx->task_mgmt.main_task_waiting = true;
-        while (rxtx->task_mgmt.main_task_waiting) {
+    /* The start cmd should have waited until we entered the RUNNING state.
+     * The state is checked under the same lock that the task holds when
+     * releasing the wait, such that a task completing just before we begin
+     * waiting cannot leave us blocked until the timeout expires. A task in
+     * the STOP state has yet to close its file and release the wait. */
+    MUTEX_LOCK(&rxtx->task_mgmt.lock);
+    state = rxtx->task_mgmt.state;
+    rxtx->task_mgmt.main_task_waiting =
+        (state == RXTX_STATE_RUNNING || state == RXTX_STATE_STOP);
+
+    while (rxtx->task_mgmt.main_task_waiting && status == 0) {
+        if (timeout_ms != 0) {
             status = pthread_cond_timedwait(&rxtx->task_mgmt.signal_done,
                                             &rxtx->task_mgmt.lock,
                                             &timeout_abs);
-
-            if (status == ETIMEDOUT) {
-                rxtx->task_mgmt.main_task_waiting = false;
-            }
-        }
-        MUTEX_UNLOCK(&rxtx->task_mgmt.lock);
-
-    } else {
-        MUTEX_LOCK(&rxtx->task_mgmt.lock);
-        rxtx->task_mgmt.main_task_waiting = true;
-        while (rxtx->task_mgmt.main_task_waiting) {
+        } else {
             status = pthread_cond_wait(&rxtx->task_mgmt.signal_done,
                                        &rxtx->task_mgmt.lock);
         }
-        MUTEX_UNLOCK(&rxtx->task_mgmt.lock);
     }
 
+    rxtx->task_mgmt.main_task_waiting = false;
+    MUTEX_UNLOCK(&rxtx->task_mgmt.lock);
+
 out:
     /* Re-acquire the device control lock, as the top-level command handler
      * will be unlocking this when it's done */
@@ -77,6 +77,23 @@ void rxtx_shutdown(struct rxtx_data *rxtx);
  */
 bool rxtx_release_wait(struct rxtx_data *rxtx);
 
+/**
+ * Write a completion event, "rx done" or "tx done" followed by a newline, to
+ * the specified file descriptor each time the task stops running. This allows
+ * an external process to poll() for the completion of captures and
+ * transmissions, rather than parsing the CLI's output or polling its state.
+ *
+ * @param   rxtx    RX/TX data handle
+ * @param   fd      File descriptor, or -1 to disable notifications
+ */
+void rxtx_set_notify_fd(struct rxtx_data *rxtx, int fd);
+
+/**
+ * Trigger a dump of the running flight recorder reception, if any. This only
+ * sets a flag, and may be called from a signal handler.
+ */
+void rx_signal_trigger(void);
+
 /**
  * Free data allocated with rxtx_data_alloc()
  *
@@ -27,10 +27,12 @@
 #ifndef RXTX_IMPL_H__
 #define RXTX_IMPL_H__
 
+#include <time.h>
 #include <libbladeRF.h>
 #include "cmd.h"
 #include "conversions.h"
 #include "thread.h"
+#include "spectrum.h"
 
 #define RXTX_ERRMSG_VALUE(param, value) \
     "Invalid value for \"%s\" (%s)\n", param, value
@@ -50,13 +52,23 @@
 #define RXTX_CMD_STOP "stop"
 #define RXTX_CMD_CONFIG "config"
 #define RXTX_CMD_WAIT "wait"
+#define RX_CMD_TRIGGER "trigger"
 
 #define TMP_FILE_NAME "bladeRF_samples_from_csv.bin"
 
 enum rxtx_fmt {
     RXTX_FMT_INVALID = -1,
     RXTX_FMT_CSV_SC16Q11,   /* CSV (Comma-separated, one entry per line) */
-    RXTX_FMT_BIN_SC16Q11    /* Binary (big-endian), c16 I,Q */
+    RXTX_FMT_BIN_SC16Q11,   /* Binary (big-endian), c16 I,Q */
+    RXTX_FMT_SIGMF_SC16Q11, /* Binary, with a SigMF metadata sidecar */
+
+    /* Formats that samples are converted to when receiving. These are not
+     * supported for transmission. */
+    RXTX_FMT_BIN_SC12,      /* Binary, packed 12-bit I,Q in 3 bytes */
+    RXTX_FMT_BIN_SC8,       /* Binary, 8-bit I,Q, scaled by sc8_shift */
+    RXTX_FMT_BIN_CF32,      /* Binary, host-endian 32-bit float I,Q */
+    RXTX_FMT_SPECTRUM       /* CSV of averaged spectrum statistics, in
+                             *   place of the samples */
 };
 
 enum rxtx_state {
@@ -113,6 +125,8 @@ struct task_mgmt
     pthread_cond_t signal_done; /* Signal when task finishes work */
     pthread_cond_t signal_state_change; /* Signal after state change */
     bool main_task_waiting;     /* Main task is blocked waiting */
+    int notify_fd;              /* Descriptor to which a completion event is
+                                 *   written whenever the task stops, or -1 */
 };
 
 /* RX or TX-specific parameters */
@@ -132,16 +146,113 @@ struct rxtx_data
     void *params;
 };
 
+/* Number of sample blocks prefetched from the file by the TX prefetch
+ * thread */
+#define TX_RING_DEPTH_DEFAULT   32
+#define TX_RING_DEPTH_MIN       2
+#define TX_RING_DEPTH_MAX       4096
+
 struct tx_params
 {
     unsigned int repeat_delay;  /* us delay between repetitions */
     unsigned int repeat;        /* # of repetitions */
+
+    unsigned int ring_depth;    /* # of blocks prefetched from the file */
+    unsigned int ring_stalls;   /* # of times the ring was empty during the
+                                 *   most recent transmission */
+
+    uint64_t start_timestamp;   /* Timestamp to start the next transmission
+                                 *   at, set by the trx command. Cleared once
+                                 *   used. 0 = start immediately. */
+    uint64_t burst_timestamp;   /* Timestamp the most recent transmission
+                                 *   was scheduled to start at. 0 = none */
+};
+
+/* Number of sample buffers queued between the RX and file writer threads */
+#define RX_RING_DEPTH_DEFAULT   32
+#define RX_RING_DEPTH_MIN       2
+#define RX_RING_DEPTH_MAX       4096
+
+/* Right shift applied to SC16 Q11 samples when converting them to SC8. The
+ * default maps the full [-2048, 2047] range onto [-128, 127]. */
+#define RX_SC8_SHIFT_DEFAULT    4
+#define RX_SC8_SHIFT_MAX        11
+
+/* Analysis performed for RXTX_FMT_SPECTRUM */
+#define RX_FFT_SIZE_DEFAULT     1024
+#define RX_FFT_AVERAGES_DEFAULT 100
+#define RX_FFT_AVERAGES_MAX     1000000
+#define RX_FFT_THREADS_DEFAULT  2
+
+/* Maximum flight recorder history and post-trigger durations, in seconds */
+#define RX_HISTORY_SECS_MAX     3600.0
+
+/* State of the file currently being written to by the RX file writer */
+struct rx_file_state
+{
+    uint64_t bytes;             /* # of bytes written to the file */
+    uint64_t allocated;         /* # of bytes preallocated for the file */
+    time_t opened;              /* Time at which the file was opened */
+    unsigned int index;         /* # of times the output has been rotated */
+    bool direct;                /* O_DIRECT is currently set on the file */
+
+    /* Copies of the rx_params items, made when reception starts */
+    bool use_direct;
+    uint64_t rotate_bytes;
+    unsigned int rotate_secs;
+    unsigned int sc8_shift;
+    bool recording;             /* history_secs != 0 */
+
+    struct spectrum *spectrum;  /* Analyzer for RXTX_FMT_SPECTRUM */
 };
 
 struct rx_params
 {
     size_t n_samples;           /* Number of samples to receive */
     int (*write_samples)(struct rxtx_data *rx, int16_t *samples, size_t n);
+
+    unsigned int ring_depth;    /* # of buffers queued for the file writer */
+    unsigned int sc8_shift;     /* Right shift applied for RXTX_FMT_BIN_SC8 */
+
+    /* Analysis performed for RXTX_FMT_SPECTRUM */
+    unsigned int fft_size;      /* # of samples per FFT */
+    unsigned int fft_averages;  /* # of FFTs averaged per report */
+    unsigned int fft_threads;   /* # of worker threads */
+    struct spectrum_stats spectrum_stats;   /* Most recent report */
+
+    /* Ring usage during the most recent reception */
+    unsigned int ring_high_water;   /* Max # of buffers awaiting writing */
+    unsigned int ring_stalls;       /* # of times the ring was full */
+
+    bool direct;                /* Bypass the page cache for binary output */
+    uint64_t rotate_bytes;      /* Start a new file after this many bytes.
+                                 *   0 = never */
+    unsigned int rotate_secs;   /* Start a new file after this many seconds.
+                                 *   0 = never */
+
+    uint64_t start_timestamp;   /* Timestamp to start the next reception
+                                 *   at, set by the trx command. Cleared once
+                                 *   used. 0 = start immediately. */
+    uint64_t first_timestamp;   /* Timestamp of the first sample of the most
+                                 *   recent reception with metadata.
+                                 *   0 = none */
+
+    /* "Flight recorder" receptions keep the most recent samples in memory,
+     * and only write them out when triggered */
+    double history_secs;        /* Seconds kept before a trigger. 0 = off */
+    double post_secs;           /* Seconds kept after a trigger */
+    bool trigger_level_set;     /* Trigger on a buffer's mean power */
+    double trigger_dbfs;        /* ...when it reaches this level */
+    bool trigger_req;           /* Trigger requested by "rx trigger" */
+
+    /* Dumps written by the most recent flight recorder reception */
+    unsigned int dumps;         /* # of dumps */
+    uint64_t dump_timestamp;    /* Timestamp of the first sample of the last */
+    uint64_t trigger_timestamp; /* Timestamp of the buffer that triggered it */
+    uint64_t dump_samples;      /* # of samples in it */
+
+    /* Only accessed by the file writer while receiving */
+    struct rx_file_state file_state;
 };
 
 /* Multipliers in units of 1024 */
@@ -152,6 +263,25 @@ extern const size_t rxtx_kmg_suffixes_len;
 void * rx_task(void *cli_state);
 void * tx_task(void *cli_state);
 
+/**
+ * Handle an rx/tx start command: open the configured file and start the task
+ *
+ * @param   s       CLI state
+ *
+ * @return 0 on success, CLI_RET_* for any errors
+ */
+int rx_cmd_start(struct cli_state *s);
+int tx_cmd_start(struct cli_state *s);
+
+/**
+ * Write an event, such as "rx done" followed by a newline, to the task's
+ * notification descriptor, if one has been set
+ *
+ * @param   rxtx    RX/TX data handle
+ * @param   event   Event line
+ */
+void rxtx_notify_event(struct rxtx_data *rxtx, const char *event);
+
 /**
  * Set tasks's current state
  *
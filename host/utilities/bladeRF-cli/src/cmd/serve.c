@@ -0,0 +1,172 @@
+/*
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <signal.h>
+#include <inttypes.h>
+#include <libbladeRF.h>
+#include <conversions.h>
+#include "cmd.h"
+
+static int serve(struct cli_state *state,
+                 const struct bladerf_net_serve_config *config)
+{
+    int status;
+
+    /* The CLI's own handler only interrupts rx/tx waits and input, so let
+     * Ctrl-C terminate the program while serving */
+#if BLADERF_OS_WINDOWS
+    status = bladerf_net_serve_with_config(state->dev, config);
+#else
+    struct sigaction sigact, sigint_prev;
+
+    memset(&sigact, 0, sizeof(sigact));
+    sigemptyset(&sigact.sa_mask);
+    sigact.sa_handler = SIG_DFL;
+
+    sigaction(SIGINT, &sigact, &sigint_prev);
+    status = bladerf_net_serve_with_config(state->dev, config);
+    sigaction(SIGINT, &sigint_prev, NULL);
+#endif
+
+    return status;
+}
+
+int cmd_serve(struct cli_state *state, int argc, char **argv)
+{
+    struct bladerf_net_serve_config config;
+    struct bladerf_rx_share_config share_config;
+    struct bladerf_rx_share *share = NULL;
+    const char *share_name = NULL;
+    unsigned int port = 0;
+    bool ok = true;
+    int status;
+    int i;
+
+    memset(&config, 0, sizeof(config));
+
+    share_config.num_slots = 64;
+    share_config.slot_size = 16384;
+    share_config.num_buffers = 32;
+    share_config.buffer_size = 16384;
+    share_config.num_transfers = 16;
+
+    for (i = 1; i < argc; i++) {
+        char *val = strchr(argv[i], '=');
+
+        if (val == NULL) {
+            cli_err(state, argv[0], "Expected <param>=<value>: %s\n",
+                    argv[i]);
+            return CLI_RET_INVPARAM;
+        }
+
+        *val++ = '\0';
+
+        if (!strcasecmp(argv[i], "port")) {
+            port = str2uint(val, 1, UINT16_MAX, &ok);
+        } else if (!strcasecmp(argv[i], "address")) {
+            config.address = val;
+            ok = val[0] != '\0';
+        } else if (!strcasecmp(argv[i], "sessions")) {
+            config.sessions = str2uint(val, 0, UINT_MAX, &ok);
+        } else if (!strcasecmp(argv[i], "socket")) {
+            config.path = val;
+            ok = val[0] == '/';
+        } else if (!strcasecmp(argv[i], "shared")) {
+            if (!strcasecmp(val, "on")) {
+                config.shared = true;
+            } else if (!strcasecmp(val, "off")) {
+                config.shared = false;
+            } else {
+                ok = false;
+            }
+        } else if (!strcasecmp(argv[i], "rx_share")) {
+            share_name = val;
+            ok = val[0] != '\0';
+        } else if (!strcasecmp(argv[i], "slots")) {
+            share_config.num_slots = str2uint(val, 2, 65536, &ok);
+            ok = ok && (share_config.num_slots &
+                        (share_config.num_slots - 1)) == 0;
+        } else if (!strcasecmp(argv[i], "slot_size")) {
+            share_config.slot_size = str2uint(val, 1024, UINT_MAX, &ok);
+            ok = ok && share_config.slot_size % 1024 == 0;
+        } else {
+            cli_err(state, argv[0], "Invalid parameter: %s\n", argv[i]);
+            return CLI_RET_INVPARAM;
+        }
+
+        if (!ok) {
+            cli_err(state, argv[0], "Invalid %s value: %s\n", argv[i], val);
+            return CLI_RET_INVPARAM;
+        }
+    }
+
+    config.port = (uint16_t) port;
+
+    if (share_name != NULL) {
+        /* Clients cannot stream RX while it is published */
+        config.shared = true;
+        share_config.buffer_size = share_config.slot_size;
+
+        status = bladerf_rx_share_start(state->dev, share_name,
+                                        &share_config, &share);
+        if (status != 0) {
+            state->last_lib_error = status;
+            return CLI_RET_LIBBLADERF;
+        }
+
+        printf("\n  Publishing RX samples to \"%s\" (%u slots of %u "
+               "samples).\n", share_name, share_config.num_slots,
+               share_config.slot_size);
+    }
+
+    if (config.sessions == 0) {
+        printf("\n  Serving until interrupted with Ctrl-C.\n\n");
+    } else {
+        printf("\n  Serving %u session%s.\n\n", config.sessions,
+               config.sessions == 1 ? "" : "s");
+    }
+
+    status = serve(state, &config);
+
+    if (share != NULL) {
+        struct bladerf_rx_share_stats stats;
+        int share_status;
+
+        bladerf_rx_share_get_stats(share, &stats);
+        share_status = bladerf_rx_share_stop(share);
+
+        printf("  Published %" PRIu64 " slots (%" PRIu64 " overruns, %"
+               PRIu64 " timeouts).\n\n", stats.slots, stats.overruns,
+               stats.timeouts);
+
+        if (status == 0) {
+            status = share_status;
+        }
+    }
+
+    if (status != 0) {
+        state->last_lib_error = status;
+        return CLI_RET_LIBBLADERF;
+    }
+
+    return 0;
+}
@@ -0,0 +1,271 @@
+/*
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2014 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "host_config.h"
+#include "common.h"
+#include "version.h"
+#include "sigmf.h"
+
+/* Initial number of segments to allocate. This is doubled as needed. */
+#define SIGMF_SEGMENTS_INITIAL  64
+
+/* Version of the SigMF specification the metadata adheres to */
+#define SIGMF_VERSION   "1.0.0"
+
+/* Samples are written in host byte order */
+#if BLADERF_BIG_ENDIAN
+#   define SIGMF_DATATYPE   "ci16_be"
+#else
+#   define SIGMF_DATATYPE   "ci16_le"
+#endif
+
+int sigmf_capture_init(struct sigmf_capture *c, struct bladerf *dev)
+{
+    int status;
+
+    memset(c, 0, sizeof(*c));
+    c->start = time(NULL);
+
+    status = bladerf_get_serial(dev, c->serial);
+
+    if (status == 0) {
+        status = bladerf_get_frequency(dev, BLADERF_MODULE_RX, &c->frequency);
+    }
+
+    if (status == 0) {
+        status = bladerf_get_sample_rate(dev, BLADERF_MODULE_RX,
+                                         &c->sample_rate);
+    }
+
+    if (status == 0) {
+        status = bladerf_get_bandwidth(dev, BLADERF_MODULE_RX, &c->bandwidth);
+    }
+
+    if (status == 0) {
+        status = bladerf_get_lna_gain(dev, &c->lna);
+    }
+
+    if (status == 0) {
+        status = bladerf_get_rxvga1(dev, &c->rxvga1);
+    }
+
+    if (status == 0) {
+        status = bladerf_get_rxvga2(dev, &c->rxvga2);
+    }
+
+    return status;
+}
+
+static int add_segment(struct sigmf_capture *c, uint64_t timestamp,
+                       uint64_t dropped)
+{
+    struct sigmf_segment *seg;
+
+    if (c->num_segments == c->max_segments) {
+        const size_t max = (c->max_segments == 0) ?
+                            SIGMF_SEGMENTS_INITIAL : 2 * c->max_segments;
+
+        seg = realloc(c->segments, max * sizeof(c->segments[0]));
+        if (seg == NULL) {
+            return BLADERF_ERR_MEM;
+        }
+
+        c->segments = seg;
+        c->max_segments = max;
+    }
+
+    seg = &c->segments[c->num_segments++];
+    seg->sample_start = c->num_samples;
+    seg->timestamp = timestamp;
+    seg->dropped = dropped;
+
+    return 0;
+}
+
+int sigmf_capture_update(struct sigmf_capture *c,
+                         const struct bladerf_metadata *meta,
+                         unsigned int count)
+{
+    int status = 0;
+
+    c->overruns += meta->overruns;
+
+    if (count == 0) {
+        /* A discontinuity reported without any samples. The gap is accounted
+         * for once the samples following it are received. */
+        return 0;
+    }
+
+    if (c->num_segments == 0) {
+        status = add_segment(c, meta->timestamp, 0);
+    } else if (meta->timestamp != c->next_timestamp) {
+        const uint64_t dropped = (meta->timestamp > c->next_timestamp) ?
+                                  meta->timestamp - c->next_timestamp : 0;
+
+        status = add_segment(c, meta->timestamp, dropped);
+    }
+
+    if (status == 0) {
+        c->num_samples += count;
+        c->next_timestamp = meta->timestamp + count;
+    }
+
+    return status;
+}
+
+/* Form the sidecar path by replacing the data file's extension, or by
+ * appending the sidecar extension if the data file has another name */
+static char *meta_path(const char *data_path)
+{
+    const size_t data_ext_len = strlen(SIGMF_DATA_EXT);
+    size_t len = strlen(data_path);
+    char *path;
+
+    if (len >= data_ext_len &&
+        !strcmp(data_path + len - data_ext_len, SIGMF_DATA_EXT)) {
+        len -= data_ext_len;
+    }
+
+    path = malloc(len + strlen(SIGMF_META_EXT) + 1);
+    if (path != NULL) {
+        memcpy(path, data_path, len);
+        strcpy(path + len, SIGMF_META_EXT);
+    }
+
+    return path;
+}
+
+static const char *lna2str(bladerf_lna_gain lna)
+{
+    switch (lna) {
+        case BLADERF_LNA_GAIN_BYPASS:
+            return "bypass";
+        case BLADERF_LNA_GAIN_MID:
+            return "mid";
+        case BLADERF_LNA_GAIN_MAX:
+            return "max";
+        default:
+            return "unknown";
+    }
+}
+
+int sigmf_write_meta(const struct sigmf_capture *c, const char *data_path)
+{
+    char *path;
+    FILE *f;
+    size_t i;
+    char datetime[32];
+    struct tm *tm;
+
+    path = meta_path(data_path);
+    if (path == NULL) {
+        return CLI_RET_MEM;
+    }
+
+    f = fopen(path, "w");
+    free(path);
+
+    if (f == NULL) {
+        return CLI_RET_FILEOP;
+    }
+
+    tm = gmtime(&c->start);
+    if (tm == NULL || !strftime(datetime, sizeof(datetime),
+                                "%Y-%m-%dT%H:%M:%SZ", tm)) {
+        datetime[0] = '\0';
+    }
+
+    fprintf(f, "{\n");
+    fprintf(f, "    \"global\": {\n");
+    fprintf(f, "        \"core:datatype\": \"%s\",\n", SIGMF_DATATYPE);
+    fprintf(f, "        \"core:sample_rate\": %u,\n", c->sample_rate);
+    fprintf(f, "        \"core:version\": \"%s\",\n", SIGMF_VERSION);
+    fprintf(f, "        \"core:num_channels\": 1,\n");
+    fprintf(f, "        \"core:hw\": \"bladeRF %s\",\n", c->serial);
+    fprintf(f, "        \"core:recorder\": \"bladeRF-cli %s\",\n",
+            BLADERF_CLI_VERSION);
+    fprintf(f, "        \"bladerf:format\": \"SC16 Q11\",\n");
+    fprintf(f, "        \"bladerf:bandwidth\": %u,\n", c->bandwidth);
+    fprintf(f, "        \"bladerf:lna_gain\": \"%s\",\n", lna2str(c->lna));
+    fprintf(f, "        \"bladerf:rxvga1\": %d,\n", c->rxvga1);
+    fprintf(f, "        \"bladerf:rxvga2\": %d,\n", c->rxvga2);
+    fprintf(f, "        \"bladerf:num_samples\": %" PRIu64 ",\n",
+            c->num_samples);
+    fprintf(f, "        \"bladerf:overruns\": %" PRIu32 "\n", c->overruns);
+    fprintf(f, "    },\n");
+
+    fprintf(f, "    \"captures\": [");
+    for (i = 0; i < c->num_segments; i++) {
+        const struct sigmf_segment *seg = &c->segments[i];
+
+        fprintf(f, "%s\n        {\n", (i == 0) ? "" : ",");
+        fprintf(f, "            \"core:sample_start\": %" PRIu64 ",\n",
+                seg->sample_start);
+        fprintf(f, "            \"core:frequency\": %u,\n", c->frequency);
+
+        /* Only the time at which reception began is known. The times of
+         * subsequent segments follow from their timestamps. */
+        if (i == 0 && datetime[0] != '\0') {
+            fprintf(f, "            \"core:datetime\": \"%s\",\n", datetime);
+        }
+
+        fprintf(f, "            \"bladerf:timestamp\": %" PRIu64 "\n",
+                seg->timestamp);
+        fprintf(f, "        }");
+    }
+    fprintf(f, "%s],\n", (c->num_segments == 0) ? "" : "\n    ");
+
+    fprintf(f, "    \"annotations\": [");
+    for (i = 1; i < c->num_segments; i++) {
+        const struct sigmf_segment *seg = &c->segments[i];
+
+        fprintf(f, "%s\n        {\n", (i == 1) ? "" : ",");
+        fprintf(f, "            \"core:sample_start\": %" PRIu64 ",\n",
+                seg->sample_start);
+        fprintf(f, "            \"core:sample_count\": 0,\n");
+        fprintf(f, "            \"core:comment\": \"Discontinuity\",\n");
+        fprintf(f, "            \"bladerf:timestamp\": %" PRIu64 ",\n",
+                seg->timestamp);
+        fprintf(f, "            \"bladerf:dropped_samples\": %" PRIu64 "\n",
+                seg->dropped);
+        fprintf(f, "        }");
+    }
+    fprintf(f, "%s]\n", (c->num_segments <= 1) ? "" : "\n    ");
+    fprintf(f, "}\n");
+
+    if (ferror(f)) {
+        fclose(f);
+        return CLI_RET_FILEOP;
+    }
+
+    return (fclose(f) == 0) ? 0 : CLI_RET_FILEOP;
+}
+
+void sigmf_capture_deinit(struct sigmf_capture *c)
+{
+    free(c->segments);
+    c->segments = NULL;
+    c->num_segments = 0;
+    c->max_segments = 0;
+}
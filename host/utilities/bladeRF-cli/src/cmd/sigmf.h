@@ -0,0 +1,122 @@
+/**
+ * @file sigmf.h
+ *
+ * @brief SigMF metadata for received samples
+ *
+ * Samples captured in the "sigmf" format are written to the data file exactly
+ * as they are in the "bin" format, such that the data file may be memory
+ * mapped and indexed directly. The metadata accompanying them is written to a
+ * JSON sidecar file, in the form described by the Signal Metadata Format
+ * (SigMF) specification.
+ *
+ * The sidecar's "captures" list contains an entry for each contiguous
+ * segment of samples, sorted by sample index. Each entry records the index of
+ * its first sample within the data file, along with that sample's timestamp.
+ * Thus, the sample received at a particular timestamp may be located by
+ * finding the last segment whose timestamp does not exceed it. Gaps between
+ * segments (e.g., due to overruns) are additionally recorded in the
+ * "annotations" list.
+ *
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2014 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef CMD_SIGMF_H_
+#define CMD_SIGMF_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <time.h>
+#include <libbladeRF.h>
+
+/* Data file extension that is replaced to form the sidecar's filename */
+#define SIGMF_DATA_EXT  ".sigmf-data"
+
+/* Metadata sidecar file extension */
+#define SIGMF_META_EXT  ".sigmf-meta"
+
+/* A contiguous run of received samples */
+struct sigmf_segment {
+    uint64_t sample_start;      /* Index of the first sample in the file */
+    uint64_t timestamp;         /* Timestamp of the first sample */
+    uint64_t dropped;           /* # of samples missing before this segment */
+};
+
+/* Device state and segments of a single reception */
+struct sigmf_capture {
+    time_t start;                   /* Wall-clock time reception started */
+    char serial[BLADERF_SERIAL_LENGTH];
+    unsigned int frequency;         /* Hz */
+    unsigned int sample_rate;       /* samples/s */
+    unsigned int bandwidth;         /* Hz */
+    bladerf_lna_gain lna;
+    int rxvga1;                     /* dB */
+    int rxvga2;                     /* dB */
+
+    struct sigmf_segment *segments; /* Sorted by sample_start */
+    size_t num_segments;
+    size_t max_segments;            /* Allocated length of segments */
+
+    uint64_t num_samples;           /* Total # of samples captured */
+    uint64_t next_timestamp;        /* Timestamp expected of the next sample */
+    uint32_t overruns;              /* Sum of bladerf_metadata overruns */
+};
+
+/**
+ * Initialize a capture, recording the current state of the RX module
+ *
+ * @param[out]  c       Capture to initialize
+ * @param[in]   dev     Device handle
+ *
+ * @return 0 on success, BLADERF_ERR_* on failure
+ */
+int sigmf_capture_init(struct sigmf_capture *c, struct bladerf *dev);
+
+/**
+ * Account for samples received with the provided metadata, starting a new
+ * segment if they do not directly follow those previously received.
+ *
+ * @param   c       Capture
+ * @param   meta    Metadata from bladerf_sync_rx()
+ * @param   count   Number of these samples written to the data file
+ *
+ * @return 0 on success, BLADERF_ERR_MEM on an allocation failure
+ */
+int sigmf_capture_update(struct sigmf_capture *c,
+                         const struct bladerf_metadata *meta,
+                         unsigned int count);
+
+/**
+ * Write a capture's metadata to the sidecar file associated with the
+ * provided data file.
+ *
+ * @param   c           Capture
+ * @param   data_path   Path of the sample data file
+ *
+ * @return 0 on success, CLI_RET_* on failure
+ */
+int sigmf_write_meta(const struct sigmf_capture *c, const char *data_path);
+
+/**
+ * Free memory associated with a capture
+ *
+ * @param   c       Capture
+ */
+void sigmf_capture_deinit(struct sigmf_capture *c);
+
+#endif
@@ -0,0 +1,490 @@
+/*
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2014 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <libbladeRF.h>
+
+#include "common.h"
+#include "spectrum.h"
+
+#ifndef M_PI
+#   define M_PI 3.14159265358979323846
+#endif
+
+/* Power assigned to empty bins, such that their level is finite */
+#define SPECTRUM_POWER_MIN  1e-20
+
+struct spectrum_worker {
+    struct spectrum *sp;
+    pthread_t thread;
+    bool busy;                  /* A frame has been handed to this worker */
+
+    int16_t *input;             /* Frame to transform */
+    float *fft;                 /* Interleaved complex FFT buffer */
+    float *power;               /* Power spectrum, in FFT-shifted order */
+};
+
+/* In-place, radix-2 decimation-in-time FFT of interleaved complex values */
+static void spectrum_fft(const struct spectrum *sp, float *x)
+{
+    const unsigned int n = sp->fft_size;
+    unsigned int i, k, len;
+
+    for (i = 0; i < n; i++) {
+        const unsigned int j = sp->bitrev[i];
+
+        if (i < j) {
+            float tmp;
+
+            tmp = x[2 * i];
+            x[2 * i] = x[2 * j];
+            x[2 * j] = tmp;
+
+            tmp = x[2 * i + 1];
+            x[2 * i + 1] = x[2 * j + 1];
+            x[2 * j + 1] = tmp;
+        }
+    }
+
+    for (len = 2; len <= n; len <<= 1) {
+        const unsigned int half = len / 2;
+        const unsigned int step = n / len;
+
+        for (i = 0; i < n; i += len) {
+            for (k = 0; k < half; k++) {
+                const float wr = sp->twiddles[2 * k * step];
+                const float wi = sp->twiddles[2 * k * step + 1];
+                float *a = &x[2 * (i + k)];
+                float *b = &x[2 * (i + k + half)];
+                const float tr = b[0] * wr - b[1] * wi;
+                const float ti = b[0] * wi + b[1] * wr;
+
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] += tr;
+                a[1] += ti;
+            }
+        }
+    }
+}
+
+/* Window and transform a frame, producing its power spectrum with DC in the
+ * center. The window is prescaled such that a full-scale tone is 0 dBFS.
+ *
+ * The library's SIMD conversion produces floats, and the window is stored
+ * with one coefficient per I and Q value, so that the compiler vectorizes
+ * the multiply. */
+static void spectrum_transform(const struct spectrum *sp,
+                               struct spectrum_worker *w)
+{
+    const unsigned int n = sp->fft_size;
+    const unsigned int half = n / 2;
+    unsigned int i;
+    float *x = w->fft;
+    const float *window = sp->window;
+
+    bladerf_convert_sc16q11_to_cf32(x, w->input, n);
+
+    for (i = 0; i < 2 * n; i++) {
+        x[i] *= window[i];
+    }
+
+    spectrum_fft(sp, w->fft);
+
+    for (i = 0; i < n; i++) {
+        const float re = w->fft[2 * i];
+        const float im = w->fft[2 * i + 1];
+
+        w->power[(i + half) & (n - 1)] = re * re + im * im;
+    }
+}
+
+static inline double spectrum_db(double power)
+{
+    return 10.0 * log10(power + SPECTRUM_POWER_MIN);
+}
+
+static int compare_float(const void *a, const void *b)
+{
+    const float x = *(const float *) a;
+    const float y = *(const float *) b;
+
+    return (x > y) - (x < y);
+}
+
+/* Reduce the accumulated spectra to their statistics and pass them to the
+ * report callback.
+ *
+ * @pre lock is held, and accum_count is non-zero */
+static void spectrum_report(struct spectrum *sp)
+{
+    const unsigned int n = sp->fft_size;
+    unsigned int i, peak = 0;
+    double peak_power = -1.0;
+    int status;
+
+    for (i = 0; i < n; i++) {
+        const double power = sp->accum[i] / sp->accum_count;
+
+        if (power > peak_power) {
+            peak_power = power;
+            peak = i;
+        }
+
+        sp->scratch[i] = (float) power;
+        sp->dbfs[i] = (float) spectrum_db(power);
+    }
+
+    /* The median is insensitive to the signals present in a few bins */
+    qsort(sp->scratch, n, sizeof(sp->scratch[0]), compare_float);
+
+    sp->stats.reports++;
+    sp->stats.frames = sp->accum_count;
+    sp->stats.peak_hz = sp->frequency +
+                        ((double) peak - n / 2) * sp->sample_rate / n;
+    sp->stats.peak_dbfs = spectrum_db(peak_power);
+    sp->stats.noise_dbfs = spectrum_db(sp->scratch[n / 2]);
+    sp->stats.dbfs = sp->dbfs;
+
+    memset(sp->accum, 0, n * sizeof(sp->accum[0]));
+    sp->accum_count = 0;
+
+    status = sp->report(sp->report_arg, &sp->stats);
+    if (sp->status == 0) {
+        sp->status = status;
+    }
+}
+
+static void *spectrum_worker_task(void *arg)
+{
+    struct spectrum_worker *w = (struct spectrum_worker *) arg;
+    struct spectrum *sp = w->sp;
+    unsigned int i;
+
+    MUTEX_LOCK(&sp->lock);
+
+    while (true) {
+        while (!w->busy && !sp->stop) {
+            pthread_cond_wait(&sp->cond, &sp->lock);
+        }
+
+        /* Any frame handed off before stopping is still analyzed */
+        if (!w->busy) {
+            break;
+        }
+
+        MUTEX_UNLOCK(&sp->lock);
+        spectrum_transform(sp, w);
+        MUTEX_LOCK(&sp->lock);
+
+        for (i = 0; i < sp->fft_size; i++) {
+            sp->accum[i] += w->power[i];
+        }
+
+        sp->stats.analyzed += sp->fft_size;
+
+        if (++sp->accum_count == sp->averages) {
+            spectrum_report(sp);
+        }
+
+        w->busy = false;
+        sp->idle++;
+        pthread_cond_broadcast(&sp->cond);
+    }
+
+    MUTEX_UNLOCK(&sp->lock);
+    return NULL;
+}
+
+int spectrum_init(struct spectrum *sp, unsigned int fft_size,
+                  unsigned int averages, unsigned int threads, bool lossless,
+                  unsigned int sample_rate, unsigned int frequency,
+                  spectrum_report_fn report, void *report_arg)
+{
+    unsigned int i, bits;
+    double window_sum = 0.0;
+
+    memset(sp, 0, sizeof(*sp));
+    MUTEX_INIT(&sp->lock);
+    pthread_cond_init(&sp->cond, NULL);
+
+    if (fft_size < SPECTRUM_FFT_SIZE_MIN || fft_size > SPECTRUM_FFT_SIZE_MAX ||
+        (fft_size & (fft_size - 1)) != 0 || averages == 0 ||
+        threads == 0 || threads > SPECTRUM_THREADS_MAX) {
+        return CLI_RET_INVPARAM;
+    }
+
+    sp->fft_size = fft_size;
+    sp->averages = averages;
+    sp->lossless = lossless;
+    sp->sample_rate = sample_rate;
+    sp->frequency = frequency;
+    sp->report = report;
+    sp->report_arg = report_arg;
+
+    sp->window = malloc(2 * fft_size * sizeof(sp->window[0]));
+    sp->twiddles = malloc(fft_size * sizeof(sp->twiddles[0]));
+    sp->bitrev = malloc(fft_size * sizeof(sp->bitrev[0]));
+    sp->frame = malloc(2 * fft_size * sizeof(sp->frame[0]));
+    sp->accum = calloc(fft_size, sizeof(sp->accum[0]));
+    sp->scratch = malloc(fft_size * sizeof(sp->scratch[0]));
+    sp->dbfs = malloc(fft_size * sizeof(sp->dbfs[0]));
+    sp->workers = calloc(threads, sizeof(sp->workers[0]));
+
+    if (sp->window == NULL || sp->twiddles == NULL || sp->bitrev == NULL ||
+        sp->frame == NULL || sp->accum == NULL || sp->scratch == NULL ||
+        sp->dbfs == NULL || sp->workers == NULL) {
+        return CLI_RET_MEM;
+    }
+
+    for (i = 0; i < fft_size; i++) {
+        window_sum += 0.5 - 0.5 * cos(2.0 * M_PI * i / fft_size);
+    }
+
+    /* Normalize to the window's coherent gain. Conversion to floats has
+     * already normalized samples to full scale. */
+    for (i = 0; i < fft_size; i++) {
+        const double w = 0.5 - 0.5 * cos(2.0 * M_PI * i / fft_size);
+
+        sp->window[2 * i] = (float) (w / window_sum);
+        sp->window[2 * i + 1] = sp->window[2 * i];
+    }
+
+    for (i = 0; i < fft_size / 2; i++) {
+        sp->twiddles[2 * i] = (float) cos(-2.0 * M_PI * i / fft_size);
+        sp->twiddles[2 * i + 1] = (float) sin(-2.0 * M_PI * i / fft_size);
+    }
+
+    for (bits = 0; (1u << bits) < fft_size; bits++);
+
+    for (i = 0; i < fft_size; i++) {
+        unsigned int b, rev = 0;
+
+        for (b = 0; b < bits; b++) {
+            rev |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+
+        sp->bitrev[i] = rev;
+    }
+
+    sp->num_workers = threads;
+
+    for (i = 0; i < threads; i++) {
+        struct spectrum_worker *w = &sp->workers[i];
+
+        w->sp = sp;
+        w->input = malloc(2 * fft_size * sizeof(w->input[0]));
+        w->fft = malloc(2 * fft_size * sizeof(w->fft[0]));
+        w->power = malloc(fft_size * sizeof(w->power[0]));
+
+        if (w->input == NULL || w->fft == NULL || w->power == NULL) {
+            return CLI_RET_MEM;
+        }
+    }
+
+    for (i = 0; i < threads; i++) {
+        if (pthread_create(&sp->workers[i].thread, NULL,
+                           spectrum_worker_task, &sp->workers[i]) != 0) {
+            return CLI_RET_UNKNOWN;
+        }
+
+        MUTEX_LOCK(&sp->lock);
+        sp->num_started++;
+        sp->idle++;
+        MUTEX_UNLOCK(&sp->lock);
+    }
+
+    return 0;
+}
+
+/* Hand the filled frame off to an idle worker, or drop it if there is none
+ *
+ * @pre lock is held */
+static void spectrum_dispatch(struct spectrum *sp)
+{
+    unsigned int i;
+
+    for (i = 0; i < sp->num_started; i++) {
+        struct spectrum_worker *w = &sp->workers[i];
+
+        if (!w->busy) {
+            int16_t *tmp = w->input;
+
+            /* Swap buffers, rather than copy the frame */
+            w->input = sp->frame;
+            sp->frame = tmp;
+
+            w->busy = true;
+            sp->idle--;
+            pthread_cond_broadcast(&sp->cond);
+            return;
+        }
+    }
+
+    sp->stats.skipped += sp->fft_size;
+}
+
+int spectrum_process(struct spectrum *sp, const int16_t *samples, size_t n)
+{
+    size_t i = 0;
+    int status;
+
+    while (i < n) {
+        size_t to_copy;
+
+        /* Only start a frame if a worker is available to transform it.
+         * Otherwise, wait for one if no samples may be lost, or skip the
+         * rest of this buffer. */
+        if (sp->fill == 0) {
+            bool skip;
+
+            MUTEX_LOCK(&sp->lock);
+
+            while (sp->lossless && sp->idle == 0 && sp->status == 0) {
+                pthread_cond_wait(&sp->cond, &sp->lock);
+            }
+
+            skip = (sp->idle == 0 || sp->status != 0);
+            if (skip) {
+                sp->stats.skipped += n - i;
+            }
+            MUTEX_UNLOCK(&sp->lock);
+
+            if (skip) {
+                break;
+            }
+        }
+
+        to_copy = sp->fft_size - sp->fill;
+        if (to_copy > n - i) {
+            to_copy = n - i;
+        }
+
+        memcpy(&sp->frame[2 * sp->fill], &samples[2 * i],
+               2 * to_copy * sizeof(samples[0]));
+
+        sp->fill += (unsigned int) to_copy;
+        i += to_copy;
+
+        if (sp->fill == sp->fft_size) {
+            MUTEX_LOCK(&sp->lock);
+            spectrum_dispatch(sp);
+            MUTEX_UNLOCK(&sp->lock);
+
+            sp->fill = 0;
+        }
+    }
+
+    MUTEX_LOCK(&sp->lock);
+    status = sp->status;
+    MUTEX_UNLOCK(&sp->lock);
+
+    return status;
+}
+
+int spectrum_flush(struct spectrum *sp, unsigned int frequency)
+{
+    int status;
+
+    MUTEX_LOCK(&sp->lock);
+
+    while (sp->idle != sp->num_started) {
+        pthread_cond_wait(&sp->cond, &sp->lock);
+    }
+
+    if (sp->accum_count != 0) {
+        spectrum_report(sp);
+    }
+
+    sp->frequency = frequency;
+    status = sp->status;
+    MUTEX_UNLOCK(&sp->lock);
+
+    /* A partial frame would mix samples of both frequencies */
+    sp->fill = 0;
+
+    return status;
+}
+
+static void spectrum_stop(struct spectrum *sp)
+{
+    unsigned int i;
+
+    MUTEX_LOCK(&sp->lock);
+    sp->stop = true;
+    pthread_cond_broadcast(&sp->cond);
+    MUTEX_UNLOCK(&sp->lock);
+
+    for (i = 0; i < sp->num_started; i++) {
+        pthread_join(sp->workers[i].thread, NULL);
+    }
+
+    sp->num_started = 0;
+}
+
+int spectrum_finish(struct spectrum *sp)
+{
+    int status;
+
+    spectrum_stop(sp);
+
+    /* Report whatever has been averaged since the last report, such that
+     * short receptions still produce a result */
+    MUTEX_LOCK(&sp->lock);
+
+    if (sp->accum_count != 0) {
+        spectrum_report(sp);
+    }
+
+    status = sp->status;
+    MUTEX_UNLOCK(&sp->lock);
+
+    return status;
+}
+
+void spectrum_deinit(struct spectrum *sp)
+{
+    unsigned int i;
+
+    spectrum_stop(sp);
+
+    if (sp->workers != NULL) {
+        for (i = 0; i < sp->num_workers; i++) {
+            free(sp->workers[i].input);
+            free(sp->workers[i].fft);
+            free(sp->workers[i].power);
+        }
+    }
+
+    free(sp->workers);
+    free(sp->window);
+    free(sp->twiddles);
+    free(sp->bitrev);
+    free(sp->frame);
+    free(sp->accum);
+    free(sp->scratch);
+    free(sp->dbfs);
+
+    pthread_cond_destroy(&sp->cond);
+    pthread_mutex_destroy(&sp->lock);
+
+    memset(sp, 0, sizeof(*sp));
+}
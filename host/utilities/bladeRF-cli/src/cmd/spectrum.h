@@ -0,0 +1,176 @@
+/**
+ * @file spectrum.h
+ *
+ * @brief Averaged power spectra of received samples
+ *
+ * Samples received in the "spectrum" format are not written to the output
+ * file. Instead, frames of samples are windowed and transformed by a pool of
+ * worker threads, and the resulting power spectra are averaged. Each averaged
+ * spectrum is reduced to its peak and noise floor, which are reported to the
+ * caller.
+ *
+ * Frames are only handed to workers that are idle. When all of the workers
+ * are busy, the buffers received in the meantime are skipped, such that
+ * analysis never holds up reception at high sample rates. A lossless
+ * analyzer instead waits for a worker to become idle.
+ *
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2014 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef CMD_SPECTRUM_H_
+#define CMD_SPECTRUM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "thread.h"
+
+/* Supported FFT sizes. The size must be a power of two. */
+#define SPECTRUM_FFT_SIZE_MIN       64
+#define SPECTRUM_FFT_SIZE_MAX       65536
+
+/* Maximum number of worker threads */
+#define SPECTRUM_THREADS_MAX        16
+
+/* Statistics of the most recent averaged spectrum */
+struct spectrum_stats {
+    uint64_t reports;           /* # of averaged spectra computed */
+    unsigned int frames;        /* # of FFTs averaged into this spectrum */
+
+    double peak_hz;             /* Frequency of the strongest bin */
+    double peak_dbfs;           /* Power of the strongest bin */
+    double noise_dbfs;          /* Median power of all bins */
+
+    uint64_t analyzed;          /* Total # of samples transformed */
+    uint64_t skipped;           /* Total # of samples skipped to keep up */
+
+    const float *dbfs;          /* Power of each bin, in FFT-shifted order.
+                                 *   Only valid during the report callback. */
+};
+
+/* Called with each averaged spectrum's statistics, from a worker thread.
+ * A non-zero (CLI_RET_*) return value is returned by spectrum_process(). */
+typedef int (*spectrum_report_fn)(void *arg, const struct spectrum_stats *s);
+
+struct spectrum_worker;
+
+struct spectrum {
+    MUTEX lock;
+    pthread_cond_t cond;        /* Signaled when a frame is handed off or
+                                 *   finished, and on stopping */
+
+    unsigned int fft_size;
+    unsigned int averages;      /* # of FFTs per averaged spectrum */
+    bool lossless;              /* Wait for a worker rather than skip */
+    unsigned int sample_rate;   /* samples/s */
+    unsigned int frequency;     /* Center frequency, Hz */
+
+    /* Read-only tables shared by the workers */
+    float *window;              /* Hann window, prescaled to dBFS, with each
+                                 *   coefficient repeated for I and Q */
+    float *twiddles;            /* exp(-2*pi*j*k/fft_size), k < fft_size/2 */
+    unsigned int *bitrev;       /* Bit-reversed indices */
+
+    struct spectrum_worker *workers;
+    unsigned int num_workers;
+    unsigned int num_started;
+    unsigned int idle;          /* # of workers without a frame */
+
+    int16_t *frame;             /* Frame being filled by spectrum_process() */
+    unsigned int fill;          /* # of samples in frame */
+
+    double *accum;              /* Sum of power spectra, in FFT-shifted order */
+    float *scratch;             /* Used to find the median */
+    float *dbfs;                /* Reported power of each bin */
+    unsigned int accum_count;   /* # of spectra in accum */
+
+    struct spectrum_stats stats;
+    bool stop;
+    int status;                 /* First failure from the report callback */
+
+    spectrum_report_fn report;
+    void *report_arg;
+};
+
+/**
+ * Initialize an analyzer and start its worker threads
+ *
+ * @param[out]  sp          Analyzer to initialize
+ * @param[in]   fft_size    FFT size. Must be a power of two between
+ *                          SPECTRUM_FFT_SIZE_MIN and SPECTRUM_FFT_SIZE_MAX.
+ * @param[in]   averages    Number of FFTs to average per report
+ * @param[in]   threads     Number of worker threads
+ * @param[in]   lossless    Block in spectrum_process() until a worker is
+ *                          available, rather than skipping samples
+ * @param[in]   sample_rate Sample rate, in samples/s
+ * @param[in]   frequency   Center frequency, in Hz
+ * @param[in]   report      Callback for each averaged spectrum
+ * @param[in]   report_arg  Argument passed to `report`
+ *
+ * @return 0 on success, CLI_RET_* on failure. spectrum_deinit() must be
+ *         called in either case.
+ */
+int spectrum_init(struct spectrum *sp, unsigned int fft_size,
+                  unsigned int averages, unsigned int threads, bool lossless,
+                  unsigned int sample_rate, unsigned int frequency,
+                  spectrum_report_fn report, void *report_arg);
+
+/**
+ * Analyze received samples. Unless the analyzer is lossless, samples are
+ * dropped if all of the workers are busy, so this does not block on the
+ * analysis.
+ *
+ * @param   sp          Analyzer
+ * @param   samples     Interleaved SC16 Q11 samples, in host byte order
+ * @param   n           Number of samples
+ *
+ * @return 0 on success, or the failure returned by the report callback
+ */
+int spectrum_process(struct spectrum *sp, const int16_t *samples, size_t n);
+
+/**
+ * Wait for the workers to finish analyzing and report any partial average.
+ * Any partially filled frame is discarded, and subsequent samples are
+ * analyzed as being centered at `frequency`.
+ *
+ * @param   sp          Analyzer
+ * @param   frequency   Center frequency of subsequent samples, in Hz
+ *
+ * @return 0 on success, or the failure returned by the report callback
+ */
+int spectrum_flush(struct spectrum *sp, unsigned int frequency);
+
+/**
+ * Wait for the workers to finish analyzing, report any partial average,
+ * and stop the workers.
+ *
+ * @param   sp          Analyzer
+ *
+ * @return 0 on success, or the failure returned by the report callback
+ */
+int spectrum_finish(struct spectrum *sp);
+
+/**
+ * Stop any workers still running and free memory associated with an analyzer
+ *
+ * @param   sp          Analyzer
+ */
+void spectrum_deinit(struct spectrum *sp);
+
+#endif
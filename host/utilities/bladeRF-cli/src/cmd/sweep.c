@@ -0,0 +1,537 @@
+/*
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <libbladeRF.h>
+#include <conversions.h>
+#include "cmd.h"
+#include "spectrum.h"
+
+#if BLADERF_OS_WINDOWS || BLADERF_OS_OSX
+#include "clock_gettime.h"
+#else
+#include <time.h>
+#endif
+
+#ifdef CLOCK_MONOTONIC
+#   define SWEEP_CLOCK CLOCK_MONOTONIC
+#else
+#   define SWEEP_CLOCK CLOCK_REALTIME
+#endif
+
+#if BLADERF_OS_WINDOWS
+#   define EOL "\r\n"
+#else
+#   define EOL "\n"
+#endif
+
+/* Defaults for the optional parameters */
+#ifndef SWEEP_DEFAULT_FFT_SIZE
+#   define SWEEP_DEFAULT_FFT_SIZE   1024
+#endif
+
+#ifndef SWEEP_DEFAULT_AVERAGES
+#   define SWEEP_DEFAULT_AVERAGES   16
+#endif
+
+#ifndef SWEEP_DEFAULT_SETTLE_US
+#   define SWEEP_DEFAULT_SETTLE_US  100
+#endif
+
+#ifndef SWEEP_DEFAULT_THREADS
+#   define SWEEP_DEFAULT_THREADS    2
+#endif
+
+/* Samples are received in chunks of this size */
+#define SWEEP_CHUNK         8192
+
+/* Stream configuration */
+#define SWEEP_NUM_BUFFERS   32
+#define SWEEP_BUFFER_SIZE   8192
+#define SWEEP_NUM_XFERS     16
+#define SWEEP_TIMEOUT_MS    2500
+
+/* The LMS6002D's low and high band LNAs and mixers are switched at this
+ * frequency. Scheduled retunes cannot cross it. */
+#define SWEEP_BAND_HIGH     1500000000u
+
+struct sweep_step {
+    unsigned int frequency;         /* Center frequency */
+    struct bladerf_quick_tune tune;
+};
+
+struct sweep {
+    struct sweep_step *steps;
+    unsigned int num_steps;
+    unsigned int step;              /* Step currently being analyzed */
+
+    unsigned int fft_size;
+    unsigned int bins_per_step;     /* Central bins kept from each step */
+
+    float *dbfs;                    /* Stitched spectrum of one sweep */
+    unsigned int num_bins;
+};
+
+struct sweep_params {
+    unsigned int start, stop, step;
+    unsigned int fft_size;
+    unsigned int averages;
+    unsigned int settle_us;
+    unsigned int threads;
+    unsigned int sweeps;
+    char *file;
+};
+
+/* Keep the central bins of each step, where the anti-aliasing filters'
+ * response is flattest. This is called from the analyzer with its lock
+ * held. */
+static int sweep_report(void *arg, const struct spectrum_stats *stats)
+{
+    struct sweep *sw = (struct sweep *) arg;
+    const unsigned int first = (sw->fft_size - sw->bins_per_step) / 2;
+
+    memcpy(&sw->dbfs[sw->step * sw->bins_per_step], &stats->dbfs[first],
+           sw->bins_per_step * sizeof(sw->dbfs[0]));
+
+    return 0;
+}
+
+static int sweep_write(FILE *f, const struct sweep *sw, unsigned int sweep,
+                       double start_hz, double bin_hz)
+{
+    unsigned int i;
+
+    fprintf(f, "%u,%.0f,%.3f,%u", sweep, start_hz, bin_hz, sw->num_bins);
+
+    for (i = 0; i < sw->num_bins; i++) {
+        fprintf(f, ",%.2f", sw->dbfs[i]);
+    }
+
+    fputs(EOL, f);
+
+    return ferror(f) ? CLI_RET_FILEOP : 0;
+}
+
+static inline bool same_band(unsigned int a, unsigned int b)
+{
+    return (a >= SWEEP_BAND_HIGH) == (b >= SWEEP_BAND_HIGH);
+}
+
+static inline double elapsed_s(const struct timespec *start,
+                               const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) +
+           (end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Receive `n` samples starting at timestamp `t`, and pass them to the
+ * analyzer. Samples before `t`, received while the LMS6002D settles, are
+ * discarded by the library. */
+static int sweep_capture(struct bladerf *dev, struct spectrum *sp,
+                         int16_t *buf, uint64_t t, uint64_t n,
+                         unsigned int *overruns)
+{
+    int status;
+    struct bladerf_metadata meta;
+
+    while (n != 0) {
+        const unsigned int to_rx = (n < SWEEP_CHUNK) ?
+                                   (unsigned int) n : SWEEP_CHUNK;
+
+        memset(&meta, 0, sizeof(meta));
+        meta.timestamp = t;
+
+        status = bladerf_sync_rx(dev, buf, to_rx, &meta, SWEEP_TIMEOUT_MS);
+
+        if (status == BLADERF_ERR_TIME_PAST) {
+            /* The requested samples were dropped. Continue with whatever
+             * is available now. */
+            (*overruns)++;
+            meta.flags = BLADERF_META_FLAG_RX_NOW;
+            status = bladerf_sync_rx(dev, buf, to_rx, &meta,
+                                     SWEEP_TIMEOUT_MS);
+        } else if (meta.status & BLADERF_META_STATUS_OVERRUN) {
+            (*overruns)++;
+        }
+
+        if (status != 0) {
+            return status;
+        }
+
+        status = spectrum_process(sp, buf, meta.actual_count);
+        if (status != 0) {
+            return status;
+        }
+
+        t = meta.timestamp + meta.actual_count;
+        n -= meta.actual_count;
+    }
+
+    return 0;
+}
+
+static int sweep_parse(struct cli_state *state, int argc, char **argv,
+                       struct sweep_params *p)
+{
+    int i;
+    bool ok;
+
+    p->start = str2uint_suffix(argv[1], BLADERF_FREQUENCY_MIN,
+                               BLADERF_FREQUENCY_MAX, freq_suffixes,
+                               NUM_FREQ_SUFFIXES, &ok);
+    if (!ok) {
+        cli_err(state, argv[0], "Invalid start frequency: %s\n", argv[1]);
+        return CLI_RET_INVPARAM;
+    }
+
+    p->stop = str2uint_suffix(argv[2], p->start + 1, BLADERF_FREQUENCY_MAX,
+                              freq_suffixes, NUM_FREQ_SUFFIXES, &ok);
+    if (!ok) {
+        cli_err(state, argv[0], "Invalid stop frequency: %s\n", argv[2]);
+        return CLI_RET_INVPARAM;
+    }
+
+    for (i = 3; i < argc; i++) {
+        char *val = strchr(argv[i], '=');
+
+        if (val == NULL) {
+            cli_err(state, argv[0], "Expected <param>=<value>: %s\n",
+                    argv[i]);
+            return CLI_RET_INVPARAM;
+        }
+
+        *val++ = '\0';
+
+        if (!strcasecmp(argv[i], "step")) {
+            p->step = str2uint_suffix(val, 1, UINT_MAX, freq_suffixes,
+                                      NUM_FREQ_SUFFIXES, &ok);
+        } else if (!strcasecmp(argv[i], "fft")) {
+            p->fft_size = str2uint(val, SPECTRUM_FFT_SIZE_MIN,
+                                   SPECTRUM_FFT_SIZE_MAX, &ok);
+            ok = ok && (p->fft_size & (p->fft_size - 1)) == 0;
+        } else if (!strcasecmp(argv[i], "averages")) {
+            p->averages = str2uint(val, 1, UINT_MAX, &ok);
+        } else if (!strcasecmp(argv[i], "settle")) {
+            p->settle_us = str2uint(val, 0, UINT_MAX, &ok);
+        } else if (!strcasecmp(argv[i], "threads")) {
+            p->threads = str2uint(val, 1, SPECTRUM_THREADS_MAX, &ok);
+        } else if (!strcasecmp(argv[i], "sweeps")) {
+            p->sweeps = str2uint(val, 1, UINT_MAX, &ok);
+        } else if (!strcasecmp(argv[i], "file")) {
+            free(p->file);
+            p->file = strdup(val);
+            ok = (p->file != NULL);
+            if (!ok) {
+                return CLI_RET_MEM;
+            }
+        } else {
+            cli_err(state, argv[0], "Invalid parameter: %s\n", argv[i]);
+            return CLI_RET_INVPARAM;
+        }
+
+        if (!ok) {
+            cli_err(state, argv[0], "Invalid %s value: %s\n", argv[i], val);
+            return CLI_RET_INVPARAM;
+        }
+    }
+
+    return 0;
+}
+
+/* Find each step's quick tune parameters. This leaves the RX module tuned
+ * to the first step. */
+static int sweep_tune_steps(struct bladerf *dev, struct sweep *sw,
+                            const struct sweep_params *p)
+{
+    int status = 0;
+    unsigned int i;
+
+    for (i = sw->num_steps; i-- > 0 && status == 0; ) {
+        struct sweep_step *s = &sw->steps[i];
+        const uint64_t f = (uint64_t) p->start + p->step / 2 +
+                           (uint64_t) i * p->step;
+
+        s->frequency = (f > BLADERF_FREQUENCY_MAX) ?
+                       BLADERF_FREQUENCY_MAX : (unsigned int) f;
+
+        status = bladerf_set_frequency(dev, BLADERF_MODULE_RX, s->frequency);
+        if (status == 0) {
+            status = bladerf_get_quick_tune(dev, BLADERF_MODULE_RX, &s->tune);
+        }
+    }
+
+    return status;
+}
+
+int cmd_sweep(struct cli_state *state, int argc, char **argv)
+{
+    int status;
+    unsigned int rate, i, k;
+    uint64_t t, settle, capture;
+    bool schedule = true;
+    bool enabled = false;
+    bool spectrum_valid = false;
+    unsigned int scheduled = 0, retuned = 0, overruns = 0;
+    double total_s = 0.0;
+    struct timespec sweep_start, sweep_end;
+    struct bladerf_quick_tune orig;
+    struct sweep sw;
+    struct sweep_params p;
+    struct spectrum sp;
+    int16_t *buf = NULL;
+    FILE *f = NULL;
+
+    if (argc < 3) {
+        return CLI_RET_NARGS;
+    }
+
+    memset(&sw, 0, sizeof(sw));
+    memset(&p, 0, sizeof(p));
+    p.fft_size = SWEEP_DEFAULT_FFT_SIZE;
+    p.averages = SWEEP_DEFAULT_AVERAGES;
+    p.settle_us = SWEEP_DEFAULT_SETTLE_US;
+    p.threads = SWEEP_DEFAULT_THREADS;
+    p.sweeps = 1;
+
+    status = sweep_parse(state, argc, argv, &p);
+    if (status != 0) {
+        goto out;
+    }
+
+    status = bladerf_get_sample_rate(state->dev, BLADERF_MODULE_RX, &rate);
+    if (status != 0) {
+        goto out_lib;
+    }
+
+    /* By default, overlap steps by a quarter of the sample rate */
+    if (p.step == 0) {
+        p.step = rate / 4 * 3;
+    } else if (p.step > rate) {
+        cli_err(state, argv[0], "The step may not exceed the sample rate "
+                "(%u Hz).\n", rate);
+        status = CLI_RET_INVPARAM;
+        goto out;
+    }
+
+    sw.fft_size = p.fft_size;
+    sw.bins_per_step = (unsigned int)
+                       ((uint64_t) p.step * p.fft_size / rate);
+    sw.num_steps = (p.stop - p.start + p.step - 1) / p.step;
+
+    if (sw.bins_per_step == 0) {
+        cli_err(state, argv[0], "The step is smaller than one FFT bin.\n");
+        status = CLI_RET_INVPARAM;
+        goto out;
+    }
+
+    sw.num_bins = sw.num_steps * sw.bins_per_step;
+    sw.steps = calloc(sw.num_steps, sizeof(sw.steps[0]));
+    sw.dbfs = calloc(sw.num_bins, sizeof(sw.dbfs[0]));
+    buf = malloc(2 * SWEEP_CHUNK * sizeof(buf[0]));
+
+    if (sw.steps == NULL || sw.dbfs == NULL || buf == NULL) {
+        status = CLI_RET_MEM;
+        goto out;
+    }
+
+    if (p.file != NULL) {
+        status = expand_and_open(p.file, "w", &f);
+        if (status != 0) {
+            goto out;
+        }
+    }
+
+    status = bladerf_get_quick_tune(state->dev, BLADERF_MODULE_RX, &orig);
+    if (status != 0) {
+        goto out_lib;
+    }
+
+    printf("\n  Tuning %u steps...\n", sw.num_steps);
+
+    status = sweep_tune_steps(state->dev, &sw, &p);
+    if (status != 0) {
+        goto out_restore;
+    }
+
+    spectrum_valid = true;
+    status = spectrum_init(&sp, p.fft_size, p.averages, p.threads, true,
+                           rate, sw.steps[0].frequency, sweep_report, &sw);
+    if (status != 0) {
+        goto out_restore;
+    }
+
+    /* Ensure old samples are flushed */
+    status = bladerf_enable_module(state->dev, BLADERF_MODULE_RX, false);
+    if (status == 0) {
+        status = bladerf_sync_config(state->dev, BLADERF_MODULE_RX,
+                                     BLADERF_FORMAT_SC16_Q11_META,
+                                     SWEEP_NUM_BUFFERS, SWEEP_BUFFER_SIZE,
+                                     SWEEP_NUM_XFERS, SWEEP_TIMEOUT_MS);
+    }
+
+    if (status == 0) {
+        status = bladerf_enable_module(state->dev, BLADERF_MODULE_RX, true);
+        enabled = (status == 0);
+    }
+
+    if (status == 0) {
+        status = bladerf_get_timestamp(state->dev, BLADERF_MODULE_RX, &t);
+    }
+
+    if (status != 0) {
+        goto out_lib_restore;
+    }
+
+    settle = (uint64_t) p.settle_us * rate / 1000000;
+    capture = (uint64_t) p.fft_size * p.averages;
+
+    for (i = 0; i < p.sweeps; i++) {
+        clock_gettime(SWEEP_CLOCK, &sweep_start);
+
+        for (k = 0; k < sw.num_steps; k++) {
+            const bool last = (i + 1 == p.sweeps && k + 1 == sw.num_steps);
+            const unsigned int next = (k + 1) % sw.num_steps;
+            const uint64_t t_start = t + settle;
+            const uint64_t t_end = t_start + capture;
+            bool queued = false;
+
+            /* Queue the retune to the next step at the end of this capture,
+             * such that it is performed while this step is analyzed */
+            if (!last && schedule &&
+                same_band(sw.steps[k].frequency, sw.steps[next].frequency)) {
+
+                status = bladerf_schedule_retune(state->dev,
+                                                 BLADERF_MODULE_RX, t_end,
+                                                 &sw.steps[next].tune);
+
+                if (status == BLADERF_ERR_UPDATE_FPGA ||
+                    status == BLADERF_ERR_UNSUPPORTED) {
+                    schedule = false;
+                    status = 0;
+                } else if (status != 0) {
+                    goto out_lib_restore;
+                } else {
+                    queued = true;
+                }
+            }
+
+            status = sweep_capture(state->dev, &sp, buf, t_start, capture,
+                                   &overruns);
+            if (status == 0 && !last && !queued) {
+                status = bladerf_quick_retune(state->dev, BLADERF_MODULE_RX,
+                                              &sw.steps[next].tune);
+                if (status == 0) {
+                    status = bladerf_get_timestamp(state->dev,
+                                                   BLADERF_MODULE_RX, &t);
+                }
+                retuned++;
+            } else if (queued) {
+                t = t_end;
+                scheduled++;
+            }
+
+            if (status != 0) {
+                goto out_lib_restore;
+            }
+
+            /* The analyzer reports this step before returning */
+            status = spectrum_flush(&sp, sw.steps[next].frequency);
+            if (status != 0) {
+                goto out_restore;
+            }
+
+            sw.step = next;
+        }
+
+        clock_gettime(SWEEP_CLOCK, &sweep_end);
+        total_s += elapsed_s(&sweep_start, &sweep_end);
+
+        if (f != NULL) {
+            status = sweep_write(f, &sw, i,
+                                 (double) sw.steps[0].frequency -
+                                     p.step / 2.0,
+                                 (double) rate / p.fft_size);
+            if (status != 0) {
+                goto out_restore;
+            }
+        }
+    }
+
+    {
+        unsigned int peak = 0;
+        const double bin_hz = (double) rate / p.fft_size;
+
+        for (k = 1; k < sw.num_bins; k++) {
+            if (sw.dbfs[k] > sw.dbfs[peak]) {
+                peak = k;
+            }
+        }
+
+        printf("  Swept %u - %u Hz in %u steps of %u Hz.\n\n",
+               p.start, p.stop, sw.num_steps, p.step);
+        printf("    Sweeps:            %u\n", p.sweeps);
+        printf("    Sweeps/s:          %.2f\n",
+               total_s > 0 ? p.sweeps / total_s : 0.0);
+        printf("    Resolution:        %.0f Hz\n", bin_hz);
+        printf("    Scheduled retunes: %u\n", scheduled);
+        printf("    Host retunes:      %u\n", retuned);
+        printf("    Overruns:          %u\n", overruns);
+        printf("    Peak (last sweep): %.0f Hz, %.2f dBFS\n\n",
+               sw.steps[0].frequency - p.step / 2.0 + peak * bin_hz,
+               sw.dbfs[peak]);
+    }
+
+    goto out_restore;
+
+out_lib_restore:
+    state->last_lib_error = status;
+    status = CLI_RET_LIBBLADERF;
+
+out_restore:
+    if (spectrum_valid) {
+        spectrum_deinit(&sp);
+    }
+
+    if (enabled) {
+        bladerf_enable_module(state->dev, BLADERF_MODULE_RX, false);
+    }
+
+    bladerf_quick_retune(state->dev, BLADERF_MODULE_RX, &orig);
+    goto out;
+
+out_lib:
+    state->last_lib_error = status;
+    status = CLI_RET_LIBBLADERF;
+
+out:
+    if (f != NULL) {
+        fclose(f);
+    }
+
+    free(buf);
+    free(sw.steps);
+    free(sw.dbfs);
+    free(p.file);
+    return status;
+}
@@ -0,0 +1,173 @@
+/*
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <libbladeRF.h>
+#include <conversions.h>
+#include "cmd.h"
+
+/* Number of records kept by "trace start" if no size is given */
+#ifndef TRACE_DEFAULT_RECORDS
+#   define TRACE_DEFAULT_RECORDS 4096
+#endif
+
+/* Number of records fetched from the library at a time */
+#define TRACE_READ_CHUNK 256
+
+static const char *trace_type_str(bladerf_trace_type type)
+{
+    switch (type) {
+        case BLADERF_TRACE_PERIPHERAL:  return "peripheral";
+        case BLADERF_TRACE_CONTROL:     return "control";
+        case BLADERF_TRACE_BULK_OUT:    return "bulk out";
+        case BLADERF_TRACE_BULK_IN:     return "bulk in";
+        default:                        return "unknown";
+    }
+}
+
+static const char *trace_target_str(bladerf_trace_target target)
+{
+    switch (target) {
+        case BLADERF_TRACE_TARGET_FX3:      return "FX3";
+        case BLADERF_TRACE_TARGET_FPGA:     return "FPGA";
+        case BLADERF_TRACE_TARGET_FLASH:    return "Flash";
+        case BLADERF_TRACE_TARGET_GPIO:     return "GPIO";
+        case BLADERF_TRACE_TARGET_LMS:      return "LMS6002D";
+        case BLADERF_TRACE_TARGET_SI5338:   return "Si5338";
+        case BLADERF_TRACE_TARGET_VCTCXO:   return "VCTCXO";
+        default:                            return "unknown";
+    }
+}
+
+/* Write one record as a Chrome trace "complete" event. Each target gets its
+ * own track, such that peripheral accesses enclose their bulk transfers. */
+static void trace_write_event(FILE *f, const struct bladerf_trace_record *r,
+                              uint64_t base_ns, bool first)
+{
+    fprintf(f, "%s\n    {\"name\": \"%s %s\", \"cat\": \"%s\", \"ph\": \"X\", "
+               "\"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %d, "
+               "\"args\": {\"request\": %u, \"length\": %u, \"status\": %d}}",
+            first ? "" : ",",
+            trace_target_str(r->target), trace_type_str(r->type),
+            trace_type_str(r->type),
+            (r->start_ns - base_ns) / 1000.0, r->duration_ns / 1000.0,
+            (int) r->target, r->request, r->length, r->status);
+}
+
+static int trace_dump(struct cli_state *state, const char *filename)
+{
+    int status;
+    FILE *f;
+    unsigned int i, n;
+    unsigned int total = 0;
+    uint64_t base_ns = 0;
+    struct bladerf_trace_record records[TRACE_READ_CHUNK];
+
+    status = expand_and_open(filename, "w", &f);
+    if (status != 0) {
+        return status;
+    }
+
+    fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+
+    do {
+        status = bladerf_trace_read(state->dev, records,
+                                    TRACE_READ_CHUNK, &n);
+        if (status != 0) {
+            break;
+        }
+
+        for (i = 0; i < n; i++, total++) {
+            if (total == 0) {
+                base_ns = records[0].start_ns;
+            }
+
+            trace_write_event(f, &records[i], base_ns, total == 0);
+        }
+    } while (n == TRACE_READ_CHUNK);
+
+    fprintf(f, "\n]}\n");
+
+    if (ferror(f)) {
+        fclose(f);
+        return CLI_RET_FILEOP;
+    } else if (fclose(f) != 0) {
+        return CLI_RET_FILEOP;
+    }
+
+    if (status != 0) {
+        state->last_lib_error = status;
+        return CLI_RET_LIBBLADERF;
+    }
+
+    printf("\n  Wrote %u trace records to %s\n\n", total, filename);
+    return CLI_RET_OK;
+}
+
+int cmd_trace(struct cli_state *state, int argc, char **argv)
+{
+    int status;
+    bool ok;
+    unsigned int num_records = TRACE_DEFAULT_RECORDS;
+
+    if (argc < 2) {
+        return CLI_RET_NARGS;
+    }
+
+    if (!strcasecmp(argv[1], "start")) {
+        if (argc > 3) {
+            return CLI_RET_NARGS;
+        } else if (argc == 3) {
+            num_records = str2uint(argv[2], 1, UINT_MAX, &ok);
+            if (!ok) {
+                cli_err(state, argv[0], "Invalid number of records: %s\n",
+                        argv[2]);
+                return CLI_RET_INVPARAM;
+            }
+        }
+
+        status = bladerf_trace_enable(state->dev, num_records);
+    } else if (!strcasecmp(argv[1], "stop")) {
+        if (argc != 2) {
+            return CLI_RET_NARGS;
+        }
+
+        status = bladerf_trace_enable(state->dev, 0);
+    } else if (!strcasecmp(argv[1], "dump")) {
+        if (argc != 3) {
+            return CLI_RET_NARGS;
+        }
+
+        return trace_dump(state, argv[2]);
+    } else {
+        cli_err(state, argv[0], "Invalid command: %s\n", argv[1]);
+        return CLI_RET_INVPARAM;
+    }
+
+    if (status != 0) {
+        state->last_lib_error = status;
+        return CLI_RET_LIBBLADERF;
+    }
+
+    return CLI_RET_OK;
+}
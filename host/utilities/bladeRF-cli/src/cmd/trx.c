@@ -0,0 +1,237 @@
+/*
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2014 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <limits.h>
+
+#include "rel_assert.h"
+#include "rxtx_impl.h"
+
+/* Default time between the trx start command and the start of RX and TX */
+#ifndef TRX_START_DELAY_DEFAULT_MS
+#   define TRX_START_DELAY_DEFAULT_MS   250
+#endif
+
+static const struct numeric_suffix trx_time_suffixes[] = {
+    { FIELD_INIT(.suffix, "ms"), FIELD_INIT(.multiplier, 1) },
+    { FIELD_INIT(.suffix, "s"), FIELD_INIT(.multiplier, 1000) },
+};
+
+static void trx_print_timing(struct cli_state *s)
+{
+    struct rx_params *rx_params = s->rx->params;
+    struct tx_params *tx_params = s->tx->params;
+    uint64_t rx_first, tx_start;
+
+    MUTEX_LOCK(&s->rx->param_lock);
+    rx_first = rx_params->first_timestamp;
+    MUTEX_UNLOCK(&s->rx->param_lock);
+
+    MUTEX_LOCK(&s->tx->param_lock);
+    tx_start = tx_params->burst_timestamp;
+    MUTEX_UNLOCK(&s->tx->param_lock);
+
+    printf("\n");
+    rxtx_print_state(s->rx, "  RX state: ", "\n");
+    rxtx_print_state(s->tx, "  TX state: ", "\n");
+
+    if (tx_start != 0) {
+        printf("  TX start timestamp: %" PRIu64 "\n", tx_start);
+    } else {
+        printf("  TX start timestamp: none\n");
+    }
+
+    if (rx_first != 0) {
+        printf("  RX first sample timestamp: %" PRIu64 "\n", rx_first);
+    } else {
+        printf("  RX first sample timestamp: none\n");
+    }
+
+    /* The RX and TX timestamp counters are enabled together, and run at
+     * the same rate, so this relates the two sample streams */
+    if (rx_first != 0 && tx_start != 0) {
+        printf("  TX start relative to RX sample 0: %" PRId64 " samples\n",
+               (int64_t) (tx_start - rx_first));
+    }
+
+    printf("\n");
+}
+
+/* Enable the timestamp counters by configuring both modules for metadata,
+ * such that the current time may be read. The RX and TX tasks configure the
+ * modules again when they start; this does not reset the counters. */
+static int trx_enable_timestamps(struct cli_state *s)
+{
+    int status = 0;
+    struct rxtx_data *modules[2] = { s->rx, s->tx };
+    size_t i;
+
+    for (i = 0; i < ARRAY_SIZE(modules) && status == 0; i++) {
+        struct rxtx_data *rxtx = modules[i];
+
+        MUTEX_LOCK(&rxtx->data_mgmt.lock);
+        status = bladerf_sync_config(s->dev, rxtx->module,
+                                     BLADERF_FORMAT_SC16_Q11_META,
+                                     rxtx->data_mgmt.num_buffers,
+                                     rxtx->data_mgmt.samples_per_buffer,
+                                     rxtx->data_mgmt.num_transfers,
+                                     rxtx->data_mgmt.timeout_ms);
+        MUTEX_UNLOCK(&rxtx->data_mgmt.lock);
+    }
+
+    return status;
+}
+
+static int trx_cmd_start(struct cli_state *s, int argc, char **argv)
+{
+    int status;
+    unsigned int delay_ms = TRX_START_DELAY_DEFAULT_MS;
+    unsigned int rx_rate, tx_rate;
+    uint64_t rx_now, tx_now, start;
+    struct rx_params *rx_params = s->rx->params;
+    struct tx_params *tx_params = s->tx->params;
+
+    if (argc > 3) {
+        return CLI_RET_NARGS;
+    } else if (argc == 3) {
+        bool ok;
+
+        delay_ms = str2uint_suffix(argv[2], 1, UINT_MAX, trx_time_suffixes,
+                                   (int) ARRAY_SIZE(trx_time_suffixes), &ok);
+        if (!ok) {
+            cli_err(s, argv[0], "Invalid start delay: \"%s\"\n", argv[2]);
+            return CLI_RET_INVPARAM;
+        }
+    }
+
+    status = rxtx_cmd_start_check(s, s->rx, "rx");
+    if (status == 0) {
+        status = rxtx_cmd_start_check(s, s->tx, "tx");
+    }
+
+    if (status != 0) {
+        return status;
+    }
+
+    /* The timestamps of both modules advance at their sample rates */
+    status = bladerf_get_sample_rate(s->dev, BLADERF_MODULE_RX, &rx_rate);
+    if (status == 0) {
+        status = bladerf_get_sample_rate(s->dev, BLADERF_MODULE_TX, &tx_rate);
+    }
+
+    if (status != 0) {
+        s->last_lib_error = status;
+        return CLI_RET_LIBBLADERF;
+    } else if (rx_rate != tx_rate) {
+        cli_err(s, argv[0], "RX and TX sample rates must be equal "
+                "(RX: %u, TX: %u).\n", rx_rate, tx_rate);
+        return CLI_RET_INVPARAM;
+    }
+
+    status = trx_enable_timestamps(s);
+
+    if (status == 0) {
+        status = bladerf_get_timestamp(s->dev, BLADERF_MODULE_RX, &rx_now);
+    }
+
+    if (status == 0) {
+        status = bladerf_get_timestamp(s->dev, BLADERF_MODULE_TX, &tx_now);
+    }
+
+    if (status != 0) {
+        s->last_lib_error = status;
+        return CLI_RET_LIBBLADERF;
+    }
+
+    /* Leave enough time for both tasks to start up and fill their buffers */
+    start = rx_now + (uint64_t) rx_rate * delay_ms / 1000;
+
+    MUTEX_LOCK(&s->rx->param_lock);
+    rx_params->start_timestamp = start;
+    MUTEX_UNLOCK(&s->rx->param_lock);
+
+    MUTEX_LOCK(&s->tx->param_lock);
+    tx_params->start_timestamp = start;
+    MUTEX_UNLOCK(&s->tx->param_lock);
+
+    status = rx_cmd_start(s);
+    if (status == 0) {
+        status = tx_cmd_start(s);
+        if (status != 0) {
+            rxtx_cmd_stop(s, s->rx);
+        }
+    }
+
+    if (status != 0) {
+        MUTEX_LOCK(&s->rx->param_lock);
+        rx_params->start_timestamp = 0;
+        MUTEX_UNLOCK(&s->rx->param_lock);
+
+        MUTEX_LOCK(&s->tx->param_lock);
+        tx_params->start_timestamp = 0;
+        MUTEX_UNLOCK(&s->tx->param_lock);
+
+        return status;
+    }
+
+    printf("\n  RX and TX scheduled to start at timestamp %" PRIu64 ".\n",
+           start);
+    printf("  Timestamps when scheduled: RX=%" PRIu64 ", TX=%" PRIu64 "\n\n",
+           rx_now, tx_now);
+
+    return 0;
+}
+
+static int trx_cmd_stop(struct cli_state *s)
+{
+    int rx_status = rxtx_cmd_stop(s, s->rx);
+    int tx_status = rxtx_cmd_stop(s, s->tx);
+
+    /* Succeed if either was running */
+    return (rx_status == 0 || tx_status == 0) ? 0 : rx_status;
+}
+
+int cmd_trx(struct cli_state *s, int argc, char **argv)
+{
+    int ret;
+
+    assert(argc > 0);
+
+    if (argc == 1) {
+        trx_print_timing(s);
+        ret = 0;
+    } else if (!strcasecmp(argv[1], RXTX_CMD_START)) {
+        ret = trx_cmd_start(s, argc, argv);
+    } else if (!strcasecmp(argv[1], RXTX_CMD_STOP)) {
+        ret = trx_cmd_stop(s);
+    } else if (!strcasecmp(argv[1], RXTX_CMD_WAIT)) {
+        /* Wait for transmission to finish, then reception */
+        ret = rxtx_handle_wait(s, s->tx, argc, argv);
+        if (ret == 0) {
+            ret = rxtx_handle_wait(s, s->rx, argc, argv);
+        }
+    } else {
+        cli_err(s, argv[0], "Invalid command: \"%s\"\n", argv[1]);
+        ret = CLI_RET_INVPARAM;
+    }
+
+    return ret;
+}
@@ -36,34 +36,289 @@
 #define SC16Q11_IQ_MIN  (-2048)
 #define SC16Q11_IQ_MAX  (2047)
 
+/* Transmit samples directly from a mapping of the input file, rather than
+ * reading the file into a buffer, where supported */
+#ifndef ENABLE_TX_MMAP
+#   if BLADERF_OS_LINUX || BLADERF_OS_OSX
+#       define ENABLE_TX_MMAP 1
+#   else
+#       define ENABLE_TX_MMAP 0
+#   endif
+#endif
+
+#if ENABLE_TX_MMAP
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#endif
+
+/* Input file samples, which are either mapped or read from the file */
+struct tx_input {
+    const int16_t *samples;     /* Mapped samples, or NULL if not mapped */
+    size_t num_samples;         /* Number of mapped samples */
+    size_t offset;              /* Index of the next sample to transmit */
+};
+
+static void tx_input_map(struct tx_input *in, FILE *file)
+{
+    in->samples = NULL;
+    in->num_samples = 0;
+    in->offset = 0;
+
+#if ENABLE_TX_MMAP
+    {
+        struct stat st;
+        void *mapping;
+        const int fd = fileno(file);
+
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+            (size_t) st.st_size < 2 * sizeof(int16_t)) {
+            return;
+        }
+
+        mapping = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED,
+                       fd, 0);
+        if (mapping == MAP_FAILED) {
+            return;
+        }
+
+        /* The file is read sequentially, and possibly repeatedly. Keep it
+         * resident following the first pass. */
+        madvise(mapping, (size_t) st.st_size, MADV_WILLNEED);
+
+        in->samples = (const int16_t *) mapping;
+        in->num_samples = (size_t) st.st_size / (2 * sizeof(int16_t));
+    }
+#endif
+}
+
+static void tx_input_unmap(struct tx_input *in)
+{
+#if ENABLE_TX_MMAP
+    if (in->samples != NULL) {
+        munmap((void *) in->samples, in->num_samples * 2 * sizeof(int16_t));
+    }
+#endif
+
+    in->samples = NULL;
+}
+
+/* Ring of sample blocks, filled from the input file by a prefetch thread and
+ * transmitted by the TX thread, such that file I/O stalls do not starve the
+ * TX stream until the ring empties */
+struct tx_ring {
+    MUTEX lock;
+    pthread_cond_t cond;        /* Signaled when a block is filled or freed */
+
+    int16_t *samples;           /* `depth' blocks of `samples_per_block' */
+    size_t *lengths;            /* # of samples in each block */
+    unsigned int depth;
+    unsigned int samples_per_block;
+
+    unsigned int head;          /* Next block to fill */
+    unsigned int tail;          /* Next block to transmit */
+    unsigned int count;         /* # of filled blocks */
+    unsigned int stalls;        /* # of times the TX thread waited for data */
+
+    bool done;                  /* No more blocks will be filled */
+    bool stop;                  /* Request for the prefetch thread to stop */
+    int status;                 /* Read failure; stops transmission */
+
+    /* Only accessed by the prefetch thread */
+    struct rxtx_data *tx;
+    struct tx_input input;
+    unsigned int repeats;       /* # of repetitions. 0 = infinite */
+    unsigned int delay_samples; /* # of zero samples between repetitions */
+};
+
+static inline int16_t *tx_ring_block(struct tx_ring *ring, unsigned int i)
+{
+    return ring->samples + (size_t) i * ring->samples_per_block * 2;
+}
+
+static void *tx_prefetch_task(void *arg)
+{
+    struct tx_ring *ring = (struct tx_ring *) arg;
+    struct rxtx_data *tx = ring->tx;
+    struct tx_input *input = &ring->input;
+    int status = 0;
+    unsigned int repeats_remaining = ring->repeats;
+    const bool repeat_infinite = (ring->repeats == 0);
+    size_t delay_samples_remaining = 0;
+
+    enum state { READ_FILE, DELAY, DONE };
+    enum state state = READ_FILE;
+
+    while (state != DONE && status == 0) {
+        int16_t *block;
+        size_t filled = 0;
+
+        /* Wait for the TX thread to free up a block, if the ring is full */
+        MUTEX_LOCK(&ring->lock);
+
+        while (ring->count == ring->depth && !ring->stop) {
+            pthread_cond_wait(&ring->cond, &ring->lock);
+        }
+
+        if (ring->stop) {
+            MUTEX_UNLOCK(&ring->lock);
+            break;
+        }
+
+        MUTEX_UNLOCK(&ring->lock);
+
+        /* Only this thread modifies the head of the ring */
+        block = tx_ring_block(ring, ring->head);
+
+        /* Keep adding to the block until it is full or a failure occurs */
+        while (filled < ring->samples_per_block && state != DONE &&
+               status == 0) {
+
+            const size_t space = ring->samples_per_block - filled;
+            int16_t *current = block + 2 * filled;
+            size_t samples_populated = 0;
+            bool eof = false;
+
+            switch (state) {
+                case READ_FILE:
+                    if (input->samples != NULL) {
+                        /* Copy from the mapping of the input file */
+                        samples_populated = min_sz(space,
+                                                   input->num_samples -
+                                                   input->offset);
+
+                        memcpy(current, &input->samples[2 * input->offset],
+                               samples_populated * 2 * sizeof(int16_t));
+
+                        input->offset += samples_populated;
+                        eof = (input->offset == input->num_samples);
+                        if (eof) {
+                            input->offset = 0;
+                        }
+                    } else {
+                        MUTEX_LOCK(&tx->file_mgmt.file_lock);
+
+                        /* Read from the input file */
+                        samples_populated = fread(current,
+                                                  2 * sizeof(int16_t),
+                                                  space, tx->file_mgmt.file);
+
+                        eof = feof(tx->file_mgmt.file);
+                        if (eof) {
+                            /* Clear the EOF condition and rewind the file */
+                            clearerr(tx->file_mgmt.file);
+                            rewind(tx->file_mgmt.file);
+                        } else if (ferror(tx->file_mgmt.file)) {
+                            status = errno;
+                            set_last_error(&tx->last_error, ETYPE_ERRNO,
+                                           status);
+                        }
+
+                        MUTEX_UNLOCK(&tx->file_mgmt.file_lock);
+                    }
+
+                    /* If the end of the file was reached, determine whether
+                     * to delay, re-read from the file, or finish */
+                    if (eof) {
+                        repeats_remaining--;
+
+                        if ((repeats_remaining > 0) || repeat_infinite) {
+                            if (ring->delay_samples != 0) {
+                                delay_samples_remaining = ring->delay_samples;
+                                state = DELAY;
+                            }
+                        } else {
+                            state = DONE;
+                        }
+                    }
+                    break;
+
+                case DELAY:
+                    /* Insert as many zeros as are necessary to realize the
+                     * specified repeat delay */
+                    samples_populated = min_sz(space, delay_samples_remaining);
+
+                    memset(current, 0,
+                           samples_populated * 2 * sizeof(int16_t));
+
+                    delay_samples_remaining -= samples_populated;
+
+                    if (delay_samples_remaining == 0) {
+                        state = READ_FILE;
+                    }
+                    break;
+
+                case DONE:
+                default:
+                    break;
+            }
+
+            filled += samples_populated;
+        }
+
+        /* Hand the block off to the TX thread */
+        MUTEX_LOCK(&ring->lock);
+
+        if (filled != 0) {
+            ring->lengths[ring->head] = filled;
+            ring->head = (ring->head + 1) % ring->depth;
+            ring->count++;
+        }
+
+        ring->status = status;
+        pthread_cond_broadcast(&ring->cond);
+        MUTEX_UNLOCK(&ring->lock);
+    }
+
+    MUTEX_LOCK(&ring->lock);
+    ring->done = true;
+    pthread_cond_broadcast(&ring->cond);
+    MUTEX_UNLOCK(&ring->lock);
+
+    return NULL;
+}
+
 static int tx_task_exec_running(struct rxtx_data *tx, struct cli_state *s)
 {
     int status = 0;
-    unsigned int samples_per_buffer;
-    int16_t *tx_buffer;
     struct tx_params *tx_params = tx->params;
-    unsigned int repeats_remaining;
     unsigned int delay_us;
-    unsigned int delay_samples;
-    unsigned int delay_samples_remaining;
-    bool repeat_infinite;
     unsigned int timeout_ms;
     unsigned int sample_rate;
-
-    enum state { INIT, READ_FILE, DELAY, PAD_TRAILING, DONE };
-    enum state state = INIT;
+    struct tx_ring ring;
+    pthread_t prefetch_thread;
+    bool prefetch_started = false;
+    bool primed = false;
+    size_t tail_offset = 0;     /* # of samples sent from the tail block */
+    bool done = false;
+    uint64_t start_timestamp;
+    struct bladerf_metadata meta;
+    struct bladerf_metadata *meta_ptr = NULL;
+
+    memset(&ring, 0, sizeof(ring));
+    ring.tx = tx;
 
     /* Fetch the parameters required for the TX operation */
     MUTEX_LOCK(&tx->param_lock);
-    repeats_remaining = tx_params->repeat;
+    ring.repeats = tx_params->repeat;
+    ring.depth = tx_params->ring_depth;
     delay_us = tx_params->repeat_delay;
+    start_timestamp = tx_params->start_timestamp;
+    tx_params->start_timestamp = 0;
+    tx_params->burst_timestamp = start_timestamp;
     MUTEX_UNLOCK(&tx->param_lock);
 
-    repeat_infinite = (repeats_remaining == 0);
+    /* A scheduled transmission is sent as a single burst, starting at the
+     * start timestamp */
+    memset(&meta, 0, sizeof(meta));
+    if (start_timestamp != 0) {
+        meta.flags = BLADERF_META_FLAG_TX_BURST_START;
+        meta.timestamp = start_timestamp;
+        meta_ptr = &meta;
+    }
 
     MUTEX_LOCK(&tx->data_mgmt.lock);
-    samples_per_buffer = (unsigned int)tx->data_mgmt.samples_per_buffer;
     timeout_ms = tx->data_mgmt.timeout_ms;
+    ring.samples_per_block = tx->data_mgmt.samples_per_buffer;
     MUTEX_UNLOCK(&tx->data_mgmt.lock);
 
     status = bladerf_get_sample_rate(s->dev, tx->module, &sample_rate);
@@ -73,24 +328,53 @@ static int tx_task_exec_running(struct rxtx_data *tx, struct cli_state *s)
     }
 
     /* Compute delay time as a sample count */
-    delay_samples = (unsigned int)((uint64_t)sample_rate * delay_us / 1000000);
-    delay_samples_remaining = delay_samples;
+    ring.delay_samples = (unsigned int)((uint64_t)sample_rate * delay_us /
+                                        1000000);
 
-    /* Allocate a buffer to hold each block of samples to transmit */
-    tx_buffer = (int16_t*) malloc(samples_per_buffer * 2 * sizeof(int16_t));
-    if (tx_buffer == NULL) {
-        status = CLI_RET_MEM;
-        set_last_error(&tx->last_error, ETYPE_ERRNO,
-                       errno == 0 ? ENOMEM : errno);
+    MUTEX_INIT(&ring.lock);
+    pthread_cond_init(&ring.cond, NULL);
+
+    /* Allocate the ring of sample blocks up front, such that no allocations
+     * occur while transmitting */
+    ring.samples = malloc((size_t) ring.depth * ring.samples_per_block *
+                          sizeof(int16_t) * 2);
+    ring.lengths = calloc(ring.depth, sizeof(ring.lengths[0]));
+
+    if (ring.samples == NULL || ring.lengths == NULL) {
+        status = errno;
+        set_last_error(&tx->last_error, ETYPE_ERRNO, status);
+    } else {
+        MUTEX_LOCK(&tx->file_mgmt.file_lock);
+        tx_input_map(&ring.input, tx->file_mgmt.file);
+        MUTEX_UNLOCK(&tx->file_mgmt.file_lock);
+
+        status = pthread_create(&prefetch_thread, NULL,
+                                tx_prefetch_task, &ring);
+        if (status != 0) {
+            set_last_error(&tx->last_error, ETYPE_ERRNO, status);
+        } else {
+            prefetch_started = true;
+        }
+    }
+
+    /* Pre-stage the ring before starting to transmit */
+    if (status == 0) {
+        MUTEX_LOCK(&ring.lock);
+        while (ring.count < ring.depth && !ring.done) {
+            pthread_cond_wait(&ring.cond, &ring.lock);
+        }
+        MUTEX_UNLOCK(&ring.lock);
     }
 
     /* Keep writing samples while there is more data to send and no failures
      * have occurred */
-    while (state != DONE && status == 0) {
+    while (!done && status == 0) {
 
         unsigned char requests;
-        unsigned int buffer_samples_remaining = samples_per_buffer;
-        int16_t *tx_buffer_current = tx_buffer;
+        unsigned int buffer_samples_remaining;
+        unsigned int buffer_samples;
+        void *tx_buffer;
+        int16_t *tx_buffer_current;
 
         /* Stop stream on STOP or SHUTDOWN, but only clear STOP. This will keep
          * the SHUTDOWN request around so we can read it when determining
@@ -100,81 +384,88 @@ static int tx_task_exec_running(struct rxtx_data *tx, struct cli_state *s)
             break;
         }
 
+        /* Fill the stream's buffers directly, rather than copying samples
+         * through an intermediate buffer */
+        status = bladerf_sync_tx_acquire(s->dev, &tx_buffer, &buffer_samples,
+                                         meta_ptr, timeout_ms);
+        if (status != 0) {
+            set_last_error(&tx->last_error, ETYPE_BLADERF, status);
+            status = CLI_RET_LIBBLADERF;
+            break;
+        }
+
+        meta.flags = 0;
+
+        buffer_samples_remaining = buffer_samples;
+        tx_buffer_current = (int16_t *) tx_buffer;
+
         /* Keep adding to the buffer until it is full or a failure occurs */
-        while (buffer_samples_remaining > 0 && status == 0 && state != DONE) {
-            size_t samples_populated = 0;
+        while (buffer_samples_remaining > 0 && status == 0 && !done) {
+            const int16_t *block;
+            size_t samples_populated;
+            size_t block_len;
 
-            switch (state) {
-                case INIT:
-                case READ_FILE:
+            /* Wait for the prefetch thread to fill a block */
+            MUTEX_LOCK(&ring.lock);
 
-                    MUTEX_LOCK(&tx->file_mgmt.file_lock);
+            if (ring.count == 0 && !ring.done && primed) {
+                ring.stalls++;
+            }
 
-                    /* Read from the input file */
-                    samples_populated = fread(tx_buffer_current,
-                                              2 * sizeof(int16_t),
-                                              buffer_samples_remaining,
-                                              tx->file_mgmt.file);
+            while (ring.count == 0 && !ring.done) {
+                pthread_cond_wait(&ring.cond, &ring.lock);
+            }
 
-                    assert(samples_populated <= UINT_MAX);
+            status = ring.status;
+            block_len = ring.lengths[ring.tail];
 
-                    /* If the end of the file was reached, determine whether
-                     * to delay, re-read from the file, or pad the rest of the
-                     * buffer and finish */
-                    if (feof(tx->file_mgmt.file)) {
-                        repeats_remaining--;
+            if (status == 0 && ring.count == 0) {
+                /* The final repetition has been sent. Populate the remainder
+                 * of the buffer with zeros, such that it is transmitted, or
+                 * end the burst, which does so. */
+                MUTEX_UNLOCK(&ring.lock);
 
-                        if ((repeats_remaining > 0) || repeat_infinite) {
-                            if (delay_samples != 0) {
-                                delay_samples_remaining = delay_samples;
-                                state = DELAY;
-                            }
-                        }
-                        else {
-                            state = PAD_TRAILING;
-                        }
+                if (meta_ptr != NULL) {
+                    meta.flags = BLADERF_META_FLAG_TX_BURST_END;
+                } else {
+                    memset(tx_buffer_current, 0,
+                           buffer_samples_remaining * 2 * sizeof(int16_t));
 
-                        /* Clear the EOF condition and rewind the file */
-                        clearerr(tx->file_mgmt.file);
-                        rewind(tx->file_mgmt.file);
-                    }
+                    buffer_samples_remaining = 0;
+                }
 
-                    /* Check for errors */
-                    else if (ferror(tx->file_mgmt.file)) {
-                        status = errno;
-                        set_last_error(&tx->last_error, ETYPE_ERRNO, status);
-                    }
+                done = true;
+                break;
+            }
 
-                    MUTEX_UNLOCK(&tx->file_mgmt.file_lock);
-                    break;
+            MUTEX_UNLOCK(&ring.lock);
 
-                case DELAY:
-                    /* Insert as many zeros as are necessary to realize the
-                     * specified repeat delay */
-                    samples_populated = uint_min(buffer_samples_remaining,
-                                                 delay_samples_remaining);
+            if (status != 0) {
+                status = CLI_RET_FILEOP;
+                break;
+            }
 
-                    memset(tx_buffer_current, 0,
-                           samples_populated * 2 * sizeof(uint16_t));
+            /* Only this thread modifies the tail of the ring */
+            block = tx_ring_block(&ring, ring.tail);
 
-                    delay_samples_remaining -= (unsigned int)samples_populated;
+            samples_populated = min_sz(buffer_samples_remaining,
+                                       block_len - tail_offset);
 
-                    if (delay_samples_remaining == 0) {
-                        state = READ_FILE;
-                    }
-                    break;
+            memcpy(tx_buffer_current, &block[2 * tail_offset],
+                   samples_populated * 2 * sizeof(int16_t));
 
-                case PAD_TRAILING:
-                    /* Populate the remainder of the buffer with zeros */
-                    memset(tx_buffer_current, 0,
-                            buffer_samples_remaining * 2 * sizeof(uint16_t));
+            tail_offset += samples_populated;
+            primed = true;
 
-                    state = DONE;
-                    break;
+            /* Return the block to the prefetch thread once it's been sent */
+            if (tail_offset == block_len) {
+                tail_offset = 0;
 
-                case DONE:
-                default:
-                    break;
+                MUTEX_LOCK(&ring.lock);
+                ring.tail = (ring.tail + 1) % ring.depth;
+                ring.count--;
+                pthread_cond_broadcast(&ring.cond);
+                MUTEX_UNLOCK(&ring.lock);
             }
 
             /* Advance the buffer pointer.
@@ -183,20 +474,191 @@ static int tx_task_exec_running(struct rxtx_data *tx, struct cli_state *s)
             tx_buffer_current += (2 * samples_populated);
         }
 
-        /* If there were no errors, transmit the data buffer */
+        /* Submit what was written. The buffer is transmitted once full. */
         if (status == 0) {
-            bladerf_sync_tx(s->dev, tx_buffer, samples_per_buffer, NULL,
-                            timeout_ms);
+            status = bladerf_sync_tx_commit(s->dev, tx_buffer,
+                                            buffer_samples -
+                                            buffer_samples_remaining,
+                                            meta_ptr);
+            if (status != 0) {
+                set_last_error(&tx->last_error, ETYPE_BLADERF, status);
+                status = CLI_RET_LIBBLADERF;
+            }
+        } else {
+            bladerf_sync_tx_commit(s->dev, tx_buffer, 0, meta_ptr);
         }
     }
 
-    free(tx_buffer);
+    if (prefetch_started) {
+        MUTEX_LOCK(&ring.lock);
+        ring.stop = true;
+        pthread_cond_broadcast(&ring.cond);
+        MUTEX_UNLOCK(&ring.lock);
+
+        pthread_join(prefetch_thread, NULL);
+    }
+
+    MUTEX_LOCK(&tx->param_lock);
+    tx_params->ring_stalls = ring.stalls;
+    MUTEX_UNLOCK(&tx->param_lock);
+
+    tx_input_unmap(&ring.input);
+    free(ring.samples);
+    free(ring.lengths);
+    pthread_cond_destroy(&ring.cond);
+    pthread_mutex_destroy(&ring.lock);
+
     return status;
 }
 
+/* Size of the blocks in which CSV files are read. No line may exceed this. */
+#define TX_CSV_BLOCK_SIZE   (64 * 1024)
+
+/* Number of samples converted from CSV before they are written out */
+#define TX_CSV_SAMPLES_PER_WRITE    4096
+
+static inline bool tx_csv_is_delim(char c)
+{
+    switch (c) {
+        case ' ':
+        case '\r':
+        case '\n':
+        case '\t':
+        case ',':
+        case '.':
+        case ':':
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+/* Parse a CSV value, which is NUL-terminated. Plain decimal values, which
+ * are by far the most common, are handled here; anything else (e.g., hex) is
+ * left to str2int(). */
+static int tx_csv_parse_value(char *token, size_t len, bool *ok)
+{
+    size_t i = 0;
+    bool negative = false;
+    int value = 0;
+
+    if (token[0] == '-' || token[0] == '+') {
+        negative = (token[0] == '-');
+        i++;
+    }
+
+    /* A leading 0 would denote an octal value */
+    if (len - i < 1 || len - i > 5 || (token[i] == '0' && len - i > 1)) {
+        return str2int(token, INT16_MIN, INT16_MAX, ok);
+    }
+
+    for (; i < len; i++) {
+        if (token[i] < '0' || token[i] > '9') {
+            return str2int(token, INT16_MIN, INT16_MAX, ok);
+        }
+
+        value = value * 10 + (token[i] - '0');
+    }
+
+    if (negative) {
+        value = -value;
+    }
+
+    *ok = (value >= INT16_MIN && value <= INT16_MAX);
+    return *ok ? value : 0;
+}
+
+static inline int tx_csv_clamp(int value, unsigned int *n_clamped)
+{
+    if (value < SC16Q11_IQ_MIN) {
+        (*n_clamped)++;
+        return SC16Q11_IQ_MIN;
+    } else if (value > SC16Q11_IQ_MAX) {
+        (*n_clamped)++;
+        return SC16Q11_IQ_MAX;
+    } else {
+        return value;
+    }
+}
+
+/* Parse a single line of CSV, which is NUL-terminated, into an I/Q pair.
+ *
+ * return 0 on success, CLI_RET_* on failure. `has_sample' is set to false
+ * for blank lines.
+ */
+static int tx_csv_parse_line(struct cli_state *s, char *line, int line_num,
+                             int16_t iq[2], bool *has_sample,
+                             unsigned int *n_clamped)
+{
+    char *tokens[3];
+    size_t lens[3];
+    unsigned int n_tokens = 0;
+    char *c = line;
+    bool ok;
+
+    /* Split the line into (up to) its first three tokens */
+    while (*c != '\0' && n_tokens < 3) {
+        if (tx_csv_is_delim(*c)) {
+            c++;
+        } else {
+            tokens[n_tokens] = c;
+            while (*c != '\0' && !tx_csv_is_delim(*c)) {
+                c++;
+            }
+
+            lens[n_tokens] = c - tokens[n_tokens];
+            n_tokens++;
+
+            if (*c != '\0') {
+                *c++ = '\0';
+            }
+        }
+    }
+
+    *has_sample = false;
+
+    if (n_tokens == 0) {
+        return 0;
+    }
+
+    /* I */
+    iq[0] = tx_csv_clamp(tx_csv_parse_value(tokens[0], lens[0], &ok),
+                         n_clamped);
+    if (!ok) {
+        cli_err(s, "tx", "Line %d: Encountered invalid I value.\n", line_num);
+        return CLI_RET_INVPARAM;
+    }
+
+    /* Q */
+    if (n_tokens < 2) {
+        cli_err(s, "tx", "Error: Q value missing.\n");
+        return CLI_RET_INVPARAM;
+    }
+
+    iq[1] = tx_csv_clamp(tx_csv_parse_value(tokens[1], lens[1], &ok),
+                         n_clamped);
+    if (!ok) {
+        cli_err(s, "tx", "Line %d: encountered invalid Q value.\n", line_num);
+        return CLI_RET_INVPARAM;
+    }
+
+    /* Check for extraneous tokens */
+    if (n_tokens > 2) {
+        cli_err(s, "tx", "Line (%d): Encountered extra token(s).\n", line_num);
+        return CLI_RET_INVPARAM;
+    }
+
+    *has_sample = true;
+    return 0;
+}
+
 /* Create a temp (binary) file from a CSV so we don't have to waste time
  * parsing it in between sending samples.
  *
+ * The CSV is read and parsed a block at a time, and the resulting samples
+ * are written out in blocks as well.
+ *
  * Postconditions: TX cfg's file descriptor, filename, and format will be
  *                 changed. (On success they'll be set to the binary file,
  *                 and on failure the csv will be closed.)
@@ -206,18 +668,17 @@ static int tx_task_exec_running(struct rxtx_data *tx, struct cli_state *s)
 static int tx_csv_to_sc16q11(struct cli_state *s)
 {
     struct rxtx_data *tx = s->tx;
-    const char delim[] = " \r\n\t,.:";
-    char buf[81] = { 0 };
-    char *token, *saveptr;
-    int tmp_int;
-    int16_t tmp_iq[2];
-    bool ok;
+    char *buf = NULL;
+    size_t buf_len = 0;
+    int16_t *samples = NULL;
+    size_t n_samples = 0;
     int status;
     FILE *bin = NULL;
     FILE *csv = NULL;
     char *bin_name = NULL;
     int line = 1;
     unsigned int n_clamped = 0;
+    bool eof = false;
 
     assert(tx->file_mgmt.path != NULL);
 
@@ -227,7 +688,9 @@ static int tx_csv_to_sc16q11(struct cli_state *s)
     }
 
     bin_name = strdup(TMP_FILE_NAME);
-    if (!bin_name) {
+    buf = malloc(TX_CSV_BLOCK_SIZE + 1);
+    samples = malloc(TX_CSV_SAMPLES_PER_WRITE * 2 * sizeof(samples[0]));
+    if (!bin_name || !buf || !samples) {
         status = CLI_RET_MEM;
         goto tx_csv_to_sc16q11_out;
     }
@@ -237,99 +700,101 @@ static int tx_csv_to_sc16q11(struct cli_state *s)
         goto tx_csv_to_sc16q11_out;
     }
 
-    while (fgets(buf, sizeof(buf), csv))
-    {
-        /* I */
-        token = strtok_r(buf, delim, &saveptr);
-
-        if (token) {
-            tmp_int = str2int(token, INT16_MIN, INT16_MAX, &ok);
-
-            if (tmp_int < SC16Q11_IQ_MIN) {
-                tmp_int = SC16Q11_IQ_MIN;
-                n_clamped++;
-            } else if (tmp_int > SC16Q11_IQ_MAX) {
-                tmp_int = SC16Q11_IQ_MAX;
-                n_clamped++;
-            }
+    while (status == 0 && !(eof && buf_len == 0)) {
+        char *start = buf;
+        char *end;
 
-            if (ok) {
-                tmp_iq[0] = tmp_int;
-            } else {
-                cli_err(s, "tx",
-                        "Line %d: Encountered invalid I value.\n", line);
-                status = CLI_RET_INVPARAM;
-                break;
-            }
+        /* Top off the buffer, following any partial line left over */
+        if (!eof) {
+            buf_len += fread(buf + buf_len, 1, TX_CSV_BLOCK_SIZE - buf_len, csv);
+            if (buf_len < TX_CSV_BLOCK_SIZE) {
+                if (ferror(csv)) {
+                    status = CLI_RET_FILEOP;
+                    break;
+                }
 
-            /* Q */
-            token = strtok_r(NULL, delim, &saveptr);
+                eof = true;
+            }
+        }
 
-            if (token) {
-                tmp_int = str2int(token, INT16_MIN, INT16_MAX, &ok);
+        buf[buf_len] = '\0';
 
-                if (tmp_int < SC16Q11_IQ_MIN) {
-                    tmp_int = SC16Q11_IQ_MIN;
-                    n_clamped++;
-                } else if (tmp_int > SC16Q11_IQ_MAX) {
-                    tmp_int = SC16Q11_IQ_MAX;
-                    n_clamped++;
-                }
+        /* Parse each complete line. At EOF, the last line need not be
+         * terminated. */
+        while (status == 0 && start < buf + buf_len) {
+            bool has_sample;
 
-                if (ok) {
-                    tmp_iq[1] = tmp_int;
-                } else {
-                    cli_err(s, "tx",
-                            "Line %d: encountered invalid Q value.\n", line);
-                    status = CLI_RET_INVPARAM;
+            end = memchr(start, '\n', buf + buf_len - start);
+            if (end == NULL) {
+                if (!eof) {
                     break;
                 }
 
-            } else {
-                cli_err(s, "tx", "Error: Q value missing.\n");
-                status = CLI_RET_INVPARAM;
-                break;
+                end = buf + buf_len;
             }
 
-            /* Check for extraneous tokens */
-            token = strtok_r(NULL, delim, &saveptr);
-            if (!token) {
-                if (fwrite(tmp_iq, sizeof(tmp_iq[0]), 2, bin) != 2) {
-                    status = CLI_RET_FILEOP;
-                    break;
+            *end = '\0';
+
+            status = tx_csv_parse_line(s, start, line,
+                                       &samples[2 * n_samples],
+                                       &has_sample, &n_clamped);
+
+            if (status == 0 && has_sample) {
+                n_samples++;
+
+                if (n_samples == TX_CSV_SAMPLES_PER_WRITE) {
+                    if (fwrite(samples, sizeof(samples[0]), 2 * n_samples,
+                               bin) != 2 * n_samples) {
+                        status = CLI_RET_FILEOP;
+                    }
+
+                    n_samples = 0;
                 }
-            } else {
-                cli_err(s, "tx",
-                        "Line (%d): Encountered extra token(s).\n", line);
-                status = CLI_RET_INVPARAM;
-                break;
             }
+
+            start = end + 1;
+            line++;
         }
 
-        line++;
+        if (start >= buf + buf_len) {
+            buf_len = 0;
+        } else if (start == buf) {
+            cli_err(s, "tx", "Line %d: Line is too long.\n", line);
+            status = CLI_RET_INVPARAM;
+        } else {
+            /* Move the partial line to the start of the buffer */
+            buf_len -= start - buf;
+            memmove(buf, start, buf_len);
+        }
     }
 
-    if (status == 0) {
-        if (feof(csv)) {
-            tx->file_mgmt.format = RXTX_FMT_BIN_SC16Q11;
-            free(tx->file_mgmt.path);
-            tx->file_mgmt.path = bin_name;
-
-            if (n_clamped != 0) {
-                printf("  Warning: %u values clamped within DAC SC16 Q11 "
-                       "range of [%d, %d].\n",
-                       n_clamped, SC16Q11_IQ_MIN, SC16Q11_IQ_MAX);
-            }
-        } else {
+    if (status == 0 && n_samples != 0) {
+        if (fwrite(samples, sizeof(samples[0]), 2 * n_samples, bin) !=
+            2 * n_samples) {
             status = CLI_RET_FILEOP;
         }
     }
 
+    if (status == 0) {
+        tx->file_mgmt.format = RXTX_FMT_BIN_SC16Q11;
+        free(tx->file_mgmt.path);
+        tx->file_mgmt.path = bin_name;
+
+        if (n_clamped != 0) {
+            printf("  Warning: %u values clamped within DAC SC16 Q11 "
+                   "range of [%d, %d].\n",
+                   n_clamped, SC16Q11_IQ_MIN, SC16Q11_IQ_MAX);
+        }
+    }
+
 tx_csv_to_sc16q11_out:
     if (status != 0) {
         free(bin_name);
     }
 
+    free(buf);
+    free(samples);
+
     if (csv) {
         fclose(csv);
     }
@@ -349,6 +814,7 @@ void *tx_task(void *cli_state_arg)
     enum rxtx_state task_state;
     struct cli_state *cli_state = (struct cli_state *) cli_state_arg;
     struct rxtx_data *tx = cli_state->tx;
+    struct tx_params *tx_params = tx->params;
     MUTEX *dev_lock = &cli_state->dev_lock;
 
     /* We expect to be in the IDLE state when this is kicked off. We could
@@ -374,6 +840,7 @@ void *tx_task(void *cli_state_arg)
             case RXTX_STATE_START:
             {
                 enum error_type err_type = ETYPE_BUG;
+                bladerf_format fmt;
 
                 /* Clear out the last error */
                 set_last_error(&tx->last_error, ETYPE_ERRNO, 0);
@@ -383,10 +850,16 @@ void *tx_task(void *cli_state_arg)
                 assert(tx->file_mgmt.file != NULL);
                 MUTEX_UNLOCK(&tx->file_mgmt.file_meta_lock);
 
-                /* Initialize the TX synchronous data configuration */
+                /* Initialize the TX synchronous data configuration.
+                 * Scheduled transmissions require timestamps. */
+                MUTEX_LOCK(&tx->param_lock);
+                fmt = (tx_params->start_timestamp != 0) ?
+                        BLADERF_FORMAT_SC16_Q11_META : BLADERF_FORMAT_SC16_Q11;
+                MUTEX_UNLOCK(&tx->param_lock);
+
                 status = bladerf_sync_config(cli_state->dev,
                                              BLADERF_MODULE_TX,
-                                             BLADERF_FORMAT_SC16_Q11,
+                                             fmt,
                                              tx->data_mgmt.num_buffers,
                                              tx->data_mgmt.samples_per_buffer,
                                              tx->data_mgmt.num_transfers,
@@ -452,7 +925,7 @@ void *tx_task(void *cli_state_arg)
     return NULL;
 }
 
-static int tx_cmd_start(struct cli_state *s)
+int tx_cmd_start(struct cli_state *s)
 {
     int status = 0;
 
@@ -465,6 +938,20 @@ static int tx_cmd_start(struct cli_state *s)
     /* Perform file conversion (if needed) and open input file */
     MUTEX_LOCK(&s->tx->file_mgmt.file_meta_lock);
 
+    switch (s->tx->file_mgmt.format) {
+        case RXTX_FMT_BIN_SC12:
+        case RXTX_FMT_BIN_SC8:
+        case RXTX_FMT_BIN_CF32:
+        case RXTX_FMT_SPECTRUM:
+            cli_err(s, "tx", "The configured file format is only supported "
+                    "for reception.\n");
+            status = CLI_RET_INVPARAM;
+            break;
+
+        default:
+            break;
+    }
+
     if (s->tx->file_mgmt.format == RXTX_FMT_CSV_SC16Q11) {
         status = tx_csv_to_sc16q11(s);
 
@@ -477,7 +964,9 @@ static int tx_cmd_start(struct cli_state *s)
     if (status == 0) {
         MUTEX_LOCK(&s->tx->file_mgmt.file_lock);
 
-        assert(s->tx->file_mgmt.format == RXTX_FMT_BIN_SC16Q11);
+        /* The data file of a SigMF recording contains binary samples */
+        assert(s->tx->file_mgmt.format == RXTX_FMT_BIN_SC16Q11 ||
+               s->tx->file_mgmt.format == RXTX_FMT_SIGMF_SC16Q11);
         status = expand_and_open(s->tx->file_mgmt.path, "rb",
                                  &s->tx->file_mgmt.file);
         MUTEX_UNLOCK(&s->tx->file_mgmt.file_lock);
@@ -505,12 +994,14 @@ static int tx_cmd_start(struct cli_state *s)
 
 static void tx_print_config(struct rxtx_data *tx)
 {
-    unsigned int repetitions, repeat_delay;
+    unsigned int repetitions, repeat_delay, ring_depth, ring_stalls;
     struct tx_params *tx_params = tx->params;
 
     MUTEX_LOCK(&tx->param_lock);
     repetitions = tx_params->repeat;
     repeat_delay = tx_params->repeat_delay;
+    ring_depth = tx_params->ring_depth;
+    ring_stalls = tx_params->ring_stalls;
     MUTEX_UNLOCK(&tx->param_lock);
 
     printf("\n");
@@ -533,6 +1024,9 @@ static void tx_print_config(struct rxtx_data *tx)
 
     rxtx_print_stream_info(tx, "  ", "\n");
 
+    printf("  # Ring buffers: %u\n", ring_depth);
+    printf("  Ring empty: %u times\n", ring_stalls);
+
     printf("\n");
 }
 
@@ -589,6 +1083,23 @@ static int tx_config(struct cli_state *s, int argc, char **argv)
                     return CLI_RET_INVPARAM;
                 }
 
+            } else if (!strcasecmp("ring", argv[i])) {
+                /* Configure the number of blocks prefetched from the file */
+                unsigned int depth;
+                bool ok;
+
+                depth = str2uint(val, TX_RING_DEPTH_MIN, TX_RING_DEPTH_MAX,
+                                 &ok);
+
+                if (ok) {
+                    MUTEX_LOCK(&s->tx->param_lock);
+                    tx_params->ring_depth = depth;
+                    MUTEX_UNLOCK(&s->tx->param_lock);
+                } else {
+                    cli_err(s, argv[0], RXTX_ERRMSG_VALUE(argv[i], val));
+                    return CLI_RET_INVPARAM;
+                }
+
             } else {
                 cli_err(s, argv[0],
                         "Unrecognized config parameter: %s\n", argv[i]);
@@ -29,8 +29,10 @@
 
 #include "cmd.h"
 #include "cmd/rxtx.h"
+#include "cmd/capture.h"
 #include "script.h"
 #include "input.h"
+#include "server.h"
 
 /* There's currently only ever 1 active cli_state */
 static struct cli_state *cli_state;
@@ -44,14 +46,22 @@ static inline void ctrlc_handler_common(int signal)
             /* Unblock any rx/tx "wait" commands */
             waiting = rxtx_release_wait(cli_state->rx);
             waiting |= rxtx_release_wait(cli_state->tx);
+            waiting |= capture_release_wait(cli_state->capture);
         }
 
         if (!waiting) {
             /* Let interactive support know we got a ctrl-C if we weren't just
              * waiting on an rx/tx wait command */
             input_ctrlc();
+            cli_server_ctrlc();
         }
     }
+#ifdef SIGUSR1
+    else if (signal == SIGUSR1) {
+        /* Dump the flight recorder's history */
+        rx_signal_trigger();
+    }
+#endif
 }
 
 #if BLADERF_OS_WINDOWS
@@ -88,6 +98,7 @@ static void init_signal_handling()
 
     sigaction(SIGINT, &sigact, NULL);
     sigaction(SIGTERM, &sigact, NULL);
+    sigaction(SIGUSR1, &sigact, NULL);
 }
 #endif
 
@@ -99,6 +110,9 @@ struct cli_state *cli_state_create()
         cli_state->dev = NULL;
         cli_state->last_lib_error = 0;
         cli_state->scripts = NULL;
+        cli_state->batch_set = false;
+        cli_state->batch_dev = NULL;
+        cli_state->capture = NULL;
 
         pthread_mutex_init(&cli_state->dev_lock, NULL);
 
@@ -146,6 +160,9 @@ void cli_state_destroy(struct cli_state *s)
     if (s) {
         cli_close_all_scripts(&s->scripts);
 
+        capture_free(s->capture);
+        s->capture = NULL;
+
         if (s->rx) {
             rxtx_shutdown(s->rx);
             rxtx_data_free(s->rx);
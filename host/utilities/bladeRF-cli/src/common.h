@@ -99,8 +99,15 @@ struct cli_state {
     struct str_queue *exec_list;    /**< List of commands from the cmd line */
     struct script *scripts;         /**< Open script files */
 
+    bool batch_set;                 /**< Batch consecutive set commands in
+                                     *   scripts */
+    struct bladerf *batch_dev;      /**< Device with a batch open, or NULL */
+
     struct rxtx_data *rx;           /**< Data for sample reception */
     struct rxtx_data *tx;           /**< Data for sample transmission */
+
+    struct capture *capture;        /**< Multi-device capture, created by the
+                                     *   first "capture" command */
 };
 
 /**
@@ -19,6 +19,7 @@
  */
 #include <errno.h>
 #include <string.h>
+#include <ctype.h>
 #include "input.h"
 #include "input_impl.h"
 #include "cmd.h"
@@ -48,6 +49,86 @@ static void exit_script(struct cli_state *s)
     }
 }
 
+/* Classify a line as a set command (1), a blank line or comment (0), or any
+ * other command (-1) */
+static int line_type(const char *line)
+{
+    size_t len;
+
+    while (isspace((unsigned char) *line)) {
+        line++;
+    }
+
+    if (*line == '\0' || *line == '#') {
+        return 0;
+    }
+
+    for (len = 0; line[len] != '\0' && !isspace((unsigned char) line[len]);
+         len++);
+
+    if ((len == 3 && !strncasecmp(line, "set", 3)) ||
+        (len == 1 && tolower((unsigned char) line[0]) == 's')) {
+        return 1;
+    }
+
+    return -1;
+}
+
+/* Send the writes of the batch in progress, if any */
+static int batch_end(struct cli_state *s)
+{
+    int status;
+
+    if (s->batch_dev == NULL) {
+        return 0;
+    }
+
+    status = bladerf_batch_end(s->batch_dev);
+    s->batch_dev = NULL;
+
+    if (status != 0) {
+        cli_err(s, "Error", "Failed to apply batched settings.\n");
+        s->last_lib_error = status;
+        return CLI_RET_LIBBLADERF;
+    }
+
+    return 0;
+}
+
+/* When enabled, consecutive set commands in a script are performed as one
+ * batch, such that their LMS6002D writes are sent to the device together.
+ * The batch ends before the next command of any other kind. */
+static int batch_update(struct cli_state *s, const char *line)
+{
+    int type, status;
+
+    if (!s->batch_set || s->exec_from_cmdline ||
+        !cli_script_loaded(s->scripts)) {
+        return batch_end(s);
+    }
+
+    type = line_type(line);
+
+    if (type < 0 || s->dev != s->batch_dev) {
+        status = batch_end(s);
+        if (status != 0 || type < 0) {
+            return status;
+        }
+    }
+
+    if (type > 0 && s->batch_dev == NULL && s->dev != NULL) {
+        status = bladerf_batch_begin(s->dev);
+        if (status != 0) {
+            s->last_lib_error = status;
+            return CLI_RET_LIBBLADERF;
+        }
+
+        s->batch_dev = s->dev;
+    }
+
+    return 0;
+}
+
 int input_loop(struct cli_state *s, bool interactive)
 {
     char *line;
@@ -82,6 +163,7 @@ int input_loop(struct cli_state *s, bool interactive)
 
         if (!line && !s->exec_from_cmdline) {
             if (cli_script_loaded(s->scripts)) {
+                status = batch_end(s);
 
                 if (!s->exec_from_cmdline) {
                     exit_script(s);
@@ -97,7 +179,10 @@ int input_loop(struct cli_state *s, bool interactive)
                 break;
             }
         } else {
-            status = cmd_handle(s, line);
+            status = batch_update(s, line);
+            if (status == 0) {
+                status = cmd_handle(s, line);
+            }
 
             if (status < 0) {
                 error = cli_strerror(status, s->last_lib_error);
@@ -153,6 +238,7 @@ int input_loop(struct cli_state *s, bool interactive)
         }
     }
 
+    batch_end(s);
     input_deinit();
 
     return 0;
@@ -0,0 +1,329 @@
+/*
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include "server.h"
+#include "input_impl.h"
+#include "cmd.h"
+#include "script.h"
+
+static volatile sig_atomic_t caught_signal = 0;
+
+void cli_server_ctrlc(void)
+{
+    caught_signal = 1;
+}
+
+#if BLADERF_OS_WINDOWS
+int cli_server_run(struct cli_state *s, const char *address)
+{
+    cli_err(s, "Error", "Listening for commands is not supported on this "
+                        "platform.\n");
+    return CLI_RET_CMD_HANDLED;
+}
+#else
+
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netdb.h>
+
+/* Listen on a Unix domain socket, replacing a stale socket at its path */
+static int listen_unix(const char *path)
+{
+    struct sockaddr_un addr;
+    struct stat st;
+    int fd;
+
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path is too long: %s\n", path);
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        bool stale = false;
+
+        if (errno == EADDRINUSE && stat(path, &st) == 0 &&
+            S_ISSOCK(st.st_mode)) {
+            int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (probe >= 0) {
+                stale = connect(probe, (struct sockaddr *) &addr,
+                                sizeof(addr)) != 0 && errno == ECONNREFUSED;
+                close(probe);
+            }
+        }
+
+        if (!stale || unlink(path) != 0 ||
+            bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+            fprintf(stderr, "Failed to bind to %s: %s\n", path,
+                    strerror(errno));
+            close(fd);
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+/* Listen on a TCP [host:]port */
+static int listen_tcp(const char *address)
+{
+    char host[256];
+    const char *port = strrchr(address, ':');
+    struct addrinfo hints, *res, *ai;
+    int status, fd = -1;
+    const int one = 1;
+
+    if (port == NULL) {
+        strcpy(host, "localhost");
+        port = address[0] != '\0' ? address : CLI_SERVER_DEFAULT_PORT;
+    } else if ((size_t) (port - address) < sizeof(host)) {
+        memcpy(host, address, (size_t) (port - address));
+        host[port - address] = '\0';
+        port++;
+    } else {
+        fprintf(stderr, "Invalid address: %s\n", address);
+        return -1;
+    }
+
+    /* Accept [addr]:port for IPv6 addresses */
+    if (host[0] == '[' && host[strlen(host) - 1] == ']') {
+        memmove(host, host + 1, strlen(host) - 2);
+        host[strlen(host) - 2] = '\0';
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    status = getaddrinfo(host[0] != '\0' ? host : NULL, port, &hints, &res);
+    if (status != 0) {
+        fprintf(stderr, "Failed to resolve %s: %s\n", address,
+                gai_strerror(status));
+        return -1;
+    }
+
+    for (ai = res; ai != NULL && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    freeaddrinfo(res);
+
+    if (fd < 0) {
+        fprintf(stderr, "Failed to bind to %s: %s\n", address,
+                strerror(errno));
+    }
+
+    return fd;
+}
+
+/* Write a command's status line */
+static void put_status(struct cli_state *s, int status)
+{
+    const char *error = NULL;
+
+    if (status < 0 && status != CLI_RET_QUIT) {
+        error = cli_strerror(status, s->last_lib_error);
+        if (error == NULL) {
+            /* The command has already described the failure */
+            error = "Command failed";
+        }
+    }
+
+    fflush(stderr);
+
+    if (error == NULL) {
+        printf(CLI_SERVER_STATUS_PFX "ok\n");
+    } else {
+        printf(CLI_SERVER_STATUS_PFX "error %s\n", error);
+    }
+
+    fflush(stdout);
+}
+
+static void strip_eol(char *line)
+{
+    char *eol = strchr(line, '\r');
+
+    if (eol != NULL || (eol = strchr(line, '\n')) != NULL) {
+        *eol = '\0';
+    }
+}
+
+/* Run the script loaded by a "run" command, and any it runs in turn */
+static int run_scripts(struct cli_state *s)
+{
+    char line[CLI_MAX_LINE_LEN + 1];
+    int status = 0;
+
+    while (status == 0 && cli_script_loaded(s->scripts)) {
+        if (fgets(line, sizeof(line), cli_script_file(s->scripts)) == NULL) {
+            cli_close_script(&s->scripts);
+            continue;
+        }
+
+        strip_eol(line);
+        status = cmd_handle(s, line);
+        cli_script_bump_line_count(s->scripts);
+
+        /* Carry on into any nested script, and ignore other state changes */
+        if (status > 0) {
+            status = 0;
+        }
+    }
+
+    cli_close_all_scripts(&s->scripts);
+    return status;
+}
+
+/* Execute a client's commands until it disconnects or quits */
+static int serve_client(struct cli_state *s, FILE *in)
+{
+    char line[CLI_MAX_LINE_LEN + 1];
+    int status = 0;
+
+    while (!cli_fatal(status) && status != CLI_RET_QUIT && !caught_signal) {
+        if (fgets(line, sizeof(line), in) == NULL) {
+            if (ferror(in) && errno == EINTR) {
+                clearerr(in);
+                continue;
+            }
+            break;
+        }
+
+        strip_eol(line);
+        status = cmd_handle(s, line);
+
+        if (status == CLI_RET_RUN_SCRIPT) {
+            status = run_scripts(s);
+        } else if (status > 0) {
+            status = 0;
+        }
+
+        put_status(s, status);
+    }
+
+    return cli_fatal(status) ? status : 0;
+}
+
+int cli_server_run(struct cli_state *s, const char *address)
+{
+    struct sigaction sigact;
+    const bool is_unix = address[0] == '/';
+    int listen_fd, stdout_fd, stderr_fd;
+    int status = 0;
+
+    listen_fd = is_unix ? listen_unix(address) : listen_tcp(address);
+    if (listen_fd < 0) {
+        return CLI_RET_CMD_HANDLED;
+    }
+
+    if (listen(listen_fd, 8) != 0) {
+        perror("listen");
+        close(listen_fd);
+        return CLI_RET_CMD_HANDLED;
+    }
+
+    /* A client disconnecting while output is written to it must not
+     * terminate the program */
+    memset(&sigact, 0, sizeof(sigact));
+    sigemptyset(&sigact.sa_mask);
+    sigact.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sigact, NULL);
+
+    printf("Listening for commands on %s\n", address);
+    fflush(stdout);
+
+    stdout_fd = dup(STDOUT_FILENO);
+    stderr_fd = dup(STDERR_FILENO);
+
+    caught_signal = 0;
+
+    while (status == 0 && !caught_signal) {
+        FILE *in;
+        int fd = accept(listen_fd, NULL, NULL);
+
+        if (fd < 0) {
+            if (errno != EINTR && errno != ECONNABORTED) {
+                perror("accept");
+                status = CLI_RET_CMD_HANDLED;
+            }
+            continue;
+        }
+
+        in = fdopen(fd, "r");
+        if (in == NULL) {
+            close(fd);
+            continue;
+        }
+
+        /* Commands, and the RX/TX tasks, print to the client while it is
+         * connected */
+        fflush(stdout);
+        fflush(stderr);
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+
+        status = serve_client(s, in);
+
+        fflush(stdout);
+        fflush(stderr);
+        dup2(stdout_fd, STDOUT_FILENO);
+        dup2(stderr_fd, STDERR_FILENO);
+
+        fclose(in);
+    }
+
+    close(stdout_fd);
+    close(stderr_fd);
+    close(listen_fd);
+
+    if (is_unix) {
+        unlink(address);
+    }
+
+    return status;
+}
+#endif
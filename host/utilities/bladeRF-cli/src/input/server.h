@@ -0,0 +1,60 @@
+/**
+ * @file server.h
+ *
+ * @brief Headless mode, in which commands are accepted over a socket
+ *
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef SERVER_H_
+#define SERVER_H_
+
+#include "common.h"
+
+/** Prefix of the line that completes each command's response */
+#define CLI_SERVER_STATUS_PFX   "@"
+
+/** Port used when a TCP address does not specify one */
+#ifndef CLI_SERVER_DEFAULT_PORT
+#   define CLI_SERVER_DEFAULT_PORT "5920"
+#endif
+
+/**
+ * Accept commands over a socket until interrupted.
+ *
+ * Clients are served one at a time. Each line a client sends is executed as
+ * an interactive-mode command. The command's output, including its errors,
+ * is sent to the client as it is produced, followed by a line of
+ * "@ok" or "@error <message>". The "quit" command ends the connection.
+ *
+ * @param   s           CLI state
+ * @param   address     Path of a Unix domain socket, if it begins with '/'.
+ *                      Otherwise, a TCP [host:]port to listen on, where the
+ *                      host defaults to the loopback interface.
+ *
+ * @return  0 once interrupted, CLI_RET_* on failure
+ */
+int cli_server_run(struct cli_state *s, const char *address);
+
+/**
+ * Notify the server that we caught Ctrl-C, such that it stops accepting
+ * commands.
+ */
+void cli_server_ctrlc(void);
+
+#endif
@@ -25,12 +25,16 @@
 #include <errno.h>
 #include <pthread.h>
 #include <string.h>
+#include <limits.h>
 #include <libbladeRF.h>
 #include "input/input.h"
+#include "input/server.h"
 #include "str_queue.h"
 #include "script.h"
 #include "common.h"
 #include "cmd.h"
+#include "cmd/rxtx.h"
+#include "conversions.h"
 #include "version.h"
 
 
@@ -50,6 +54,9 @@ static const struct option longopts[] = {
     { "version",            no_argument,        0,  2  },
     { "help",               no_argument,        0, 'h' },
     { "help-interactive",   no_argument,        0,  3  },
+    { "batch",              no_argument,        0,  4  },
+    { "notify-fd",          required_argument,  0,  5  },
+    { "listen",             required_argument,  0,  6  },
     { 0,                    0,                  0,  0  },
 };
 
@@ -64,6 +71,8 @@ struct rc_config {
     bool show_help_interactive;
     bool show_version;
     bool show_lib_version;
+    bool batch;
+    int notify_fd;
 
     bladerf_log_level verbosity;
 
@@ -72,6 +81,7 @@ struct rc_config {
     char *flash_fpga_file;
     char *fpga_file;
     char *script_file;
+    char *listen_addr;
 };
 
 static void init_rc_config(struct rc_config *rc)
@@ -84,6 +94,8 @@ static void init_rc_config(struct rc_config *rc)
     rc->show_help = false;
     rc->show_version = false;
     rc->show_lib_version = false;
+    rc->batch = false;
+    rc->notify_fd = -1;
     rc->show_help_interactive = false;
 
     rc->verbosity = BLADERF_LOG_LEVEL_INFO;
@@ -93,6 +105,7 @@ static void init_rc_config(struct rc_config *rc)
     rc->flash_fpga_file = NULL;
     rc->fpga_file = NULL;
     rc->script_file = NULL;
+    rc->listen_addr = NULL;
 }
 
 static void deinit_rc_config(struct rc_config *rc)
@@ -102,6 +115,7 @@ static void deinit_rc_config(struct rc_config *rc)
     free(rc->flash_fpga_file);
     free(rc->fpga_file);
     free(rc->script_file);
+    free(rc->listen_addr);
 }
 
 /* Fetch runtime-configuration info
@@ -234,6 +248,35 @@ int get_rc_config(int argc, char *argv[], struct rc_config *rc,
                 rc->show_help_interactive = true;
                 break;
 
+            case 4:
+                rc->batch = true;
+                break;
+
+            case 5: {
+                bool ok;
+                rc->notify_fd = str2int(optarg, 0, INT_MAX, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Error: Invalid file descriptor: %s\n",
+                            optarg);
+                    return -1;
+                }
+                break;
+            }
+
+            case 6:
+                if (rc->listen_addr != NULL) {
+                    fprintf(stderr, "Error: Listen address specified more "
+                            "than once.\n");
+                    return -1;
+                }
+
+                rc->listen_addr = strdup(optarg);
+                if (!rc->listen_addr) {
+                    perror("strdup");
+                    return -1;
+                }
+                break;
+
             default:
                 return -1;
         }
@@ -241,6 +284,12 @@ int get_rc_config(int argc, char *argv[], struct rc_config *rc,
         c = getopt_long(argc, argv, OPTSTR, longopts, &optidx);
     } while (c != -1);
 
+    if (rc->listen_addr != NULL && rc->interactive_mode) {
+        fprintf(stderr, "Error: --listen cannot be used with interactive "
+                "mode.\n");
+        return -1;
+    }
+
     return 0;
 }
 
@@ -262,7 +311,18 @@ void usage(const char *argv0)
     printf("                                   Multiple -e flags may be specified. The commands\n");
     printf("                                   will be executed in the provided order.\n");
     printf("  -s, --script <file>              Run provided script.\n");
+    printf("      --batch                      Apply consecutive 'set' commands in scripts\n");
+    printf("                                   as one batch of device writes. Errors are\n");
+    printf("                                   then reported at the end of each batch.\n");
     printf("  -i, --interactive                Enter interactive mode.\n");
+    printf("      --listen <address>           Keep the device open, and execute commands\n");
+    printf("                                   received on a Unix domain socket (a path\n");
+    printf("                                   starting with '/') or a TCP [host:]port,\n");
+    printf("                                   until interrupted. Each command's output is\n");
+    printf("                                   followed by \"@ok\" or \"@error <message>\".\n");
+    printf("      --notify-fd <fd>             Write \"rx done\" or \"tx done\" lines to the\n");
+    printf("                                   inherited file descriptor <fd> when an rx or\n");
+    printf("                                   tx task stops, for use with poll().\n");
     printf("      --lib-version                Print libbladeRF version and exit.\n");
     printf("  -v, --verbosity <level>          Set the libbladeRF verbosity level.\n");
     printf("                                   Levels, listed in increasing verbosity, are:\n");
@@ -283,6 +343,7 @@ void usage(const char *argv0)
     printf("\n");
     printf("  Commands are executed in the following order:\n");
     printf("    Command line options, -e <command>, script commands, interactive mode commands.\n");
+    printf("    Commands received via --listen follow any -e or script commands.\n");
     printf("\n");
     printf("  When running 'rx/tx start' from a script or via -e, ensure these commands\n");
     printf("  are later followed by 'rx/tx wait [timeout]' to ensure the program will\n");
@@ -416,6 +477,7 @@ int main(int argc, char *argv[])
     struct rc_config rc;
     struct cli_state *state;
     bool exit_immediately = false;
+    bool have_cmds;
     struct str_queue exec_list;
 
     /* If no actions are specified, just show the usage text and exit */
@@ -441,6 +503,11 @@ int main(int argc, char *argv[])
     state->exec_list = &exec_list;
     bladerf_log_set_verbosity(rc.verbosity);
 
+    /* Stream command output to clients as it is produced */
+    if (rc.listen_addr != NULL) {
+        setvbuf(stdout, NULL, _IOLBF, 0);
+    }
+
     if (rc.show_help) {
         usage(argv[0]);
         exit_immediately = true;
@@ -485,6 +552,10 @@ int main(int argc, char *argv[])
             goto main_issues;
         }
 
+        state->batch_set = rc.batch;
+        rxtx_set_notify_fd(state->rx, rc.notify_fd);
+        rxtx_set_notify_fd(state->tx, rc.notify_fd);
+
         if (rc.script_file) {
             status = cli_open_script(&state->scripts, rc.script_file);
             if (status != 0) {
@@ -495,15 +566,22 @@ int main(int argc, char *argv[])
         }
 
         /* Drop into interactive mode or begin executing commands from a a
-         * command-line list or a script. If we're not requested to do either,
-         * exit cleanly */
-        if (!str_queue_empty(&exec_list) || rc.interactive_mode ||
-            cli_script_loaded(state->scripts)) {
+         * command-line list or a script, and then listen for commands if
+         * requested. If we're not requested to do any of these, exit
+         * cleanly */
+        have_cmds = !str_queue_empty(&exec_list) || rc.interactive_mode ||
+                    cli_script_loaded(state->scripts);
 
+        if (have_cmds || rc.listen_addr != NULL) {
             status = cli_start_tasks(state);
-            if (status == 0) {
+
+            if (status == 0 && have_cmds) {
                 status = input_loop(state, rc.interactive_mode);
             }
+
+            if (status == 0 && rc.listen_addr != NULL) {
+                status = cli_server_run(state, rc.listen_addr);
+            }
         }
     }
 
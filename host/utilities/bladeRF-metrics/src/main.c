@@ -0,0 +1,630 @@
+/*
+ * This file is part of the bladeRF project
+ *
+ * bladeRF OpenMetrics exporter
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <libbladeRF.h>
+#include "host_config.h"
+#include "conversions.h"
+#include "metrics.h"
+#include "version.h"
+
+#if BLADERF_OS_WINDOWS
+#   include <windows.h>
+#else
+#   include <unistd.h>
+#   include <poll.h>
+#   include <sys/types.h>
+#   include <sys/socket.h>
+#   include <sys/time.h>
+#   include <netdb.h>
+#endif
+
+/* Upper bound on the number of devices to monitor */
+#define MAX_DEVICES 64
+
+/* Default time between file updates, and between scrapes for HTTP */
+#define DEFAULT_FILE_INTERVAL_S     15.0
+#define DEFAULT_HTTP_INTERVAL_S     1.0
+
+#define DEFAULT_HTTP_PORT           "9910"
+
+/* Largest HTTP request header accepted, and time allowed to receive it */
+#define HTTP_REQUEST_MAX            4096
+#define HTTP_TIMEOUT_S              5
+
+#define OPTSTR "d:l:o:i:v:h"
+
+static const struct option longopts[] = {
+    { "device",         required_argument,  0, 'd' },
+    { "listen",         required_argument,  0, 'l' },
+    { "output",         required_argument,  0, 'o' },
+    { "interval",       required_argument,  0, 'i' },
+    { "verbosity",      required_argument,  0, 'v' },
+    { "version",        no_argument,        0,  1  },
+    { "help",           no_argument,        0, 'h' },
+    { 0,                0,                  0,  0  },
+};
+
+struct options {
+    const char *idents[MAX_DEVICES];
+    size_t num_idents;
+    const char *listen;
+    const char *output;
+    double interval_s;
+    bladerf_log_level verbosity;
+};
+
+static volatile sig_atomic_t caught_signal = 0;
+
+static void handle_signal(int signum)
+{
+    caught_signal = 1;
+}
+
+static void usage(const char *argv0)
+{
+    printf("Usage: %s <options>\n", argv0);
+    printf("bladeRF OpenMetrics exporter (" BLADERF_METRICS_VERSION ")\n\n");
+    printf("Publishes the configuration, FX3 counters, FIFO fill level marks,\n");
+    printf("and network backend statistics of one or more devices.\n\n");
+    printf("Options:\n");
+    printf("  -d, --device <device>        Monitor the specified device. This may be\n");
+    printf("                               given multiple times. By default, all\n");
+    printf("                               locally attached devices are monitored.\n");
+    printf("  -l, --listen <[host:]port>   Serve the metrics over HTTP at /metrics.\n");
+    printf("                               The default port is " DEFAULT_HTTP_PORT ".\n");
+    printf("  -o, --output <file>          Periodically rewrite <file> with the\n");
+    printf("                               metrics, e.g., for node_exporter's\n");
+    printf("                               textfile collector.\n");
+    printf("  -i, --interval <seconds>     Time between updates of the --output file\n");
+    printf("                               (default: %g), or the least time between\n",
+           DEFAULT_FILE_INTERVAL_S);
+    printf("                               scrapes for --listen (default: %g).\n",
+           DEFAULT_HTTP_INTERVAL_S);
+    printf("  -v, --verbosity <level>      Set the libbladeRF verbosity level.\n");
+    printf("      --version                Print the version and exit.\n");
+    printf("  -h, --help                   Show this help text.\n");
+    printf("\n");
+    printf("Without --listen or --output, the metrics are printed once.\n");
+    printf("\n");
+}
+
+static int get_options(int argc, char *argv[], struct options *opts)
+{
+    int c;
+    bool ok;
+
+    memset(opts, 0, sizeof(*opts));
+    opts->interval_s = -1.0;
+    opts->verbosity = BLADERF_LOG_LEVEL_WARNING;
+
+    while ((c = getopt_long(argc, argv, OPTSTR, longopts, NULL)) != -1) {
+        switch (c) {
+            case 'd':
+                if (opts->num_idents >= MAX_DEVICES) {
+                    fprintf(stderr, "At most %u devices may be specified.\n",
+                            MAX_DEVICES);
+                    return -1;
+                }
+                opts->idents[opts->num_idents++] = optarg;
+                break;
+
+            case 'l':
+                opts->listen = optarg;
+                break;
+
+            case 'o':
+                opts->output = optarg;
+                break;
+
+            case 'i':
+                opts->interval_s = str2double(optarg, 0.0, 86400.0, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Invalid interval: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 'v':
+                opts->verbosity = str2loglevel(optarg, &ok);
+                if (!ok) {
+                    fprintf(stderr, "Invalid log level: %s\n", optarg);
+                    return -1;
+                }
+                break;
+
+            case 1:
+                printf(BLADERF_METRICS_VERSION "\n");
+                exit(EXIT_SUCCESS);
+
+            case 'h':
+                usage(argv[0]);
+                exit(EXIT_SUCCESS);
+
+            default:
+                return -1;
+        }
+    }
+
+    if (opts->listen != NULL && opts->output != NULL) {
+        fprintf(stderr, "Only one of --listen and --output may be used.\n");
+        return -1;
+    }
+
+    if (opts->interval_s < 0.0) {
+        opts->interval_s = opts->listen != NULL ? DEFAULT_HTTP_INTERVAL_S
+                                                : DEFAULT_FILE_INTERVAL_S;
+    }
+
+    return 0;
+}
+
+/* Build the list of devices to monitor. Probed devices are identified by
+ * serial number, so that they are matched across reconnections. */
+static struct metrics_device *get_devices(const struct options *opts,
+                                          size_t *num_devs)
+{
+    struct metrics_device *devs;
+    struct bladerf_devinfo *list = NULL;
+    size_t n, i;
+    int count = 0;
+
+    if (opts->num_idents != 0) {
+        n = opts->num_idents;
+    } else {
+        count = bladerf_get_device_list(&list);
+        if (count <= 0) {
+            fprintf(stderr, "No devices found.\n");
+            return NULL;
+        }
+
+        n = count > MAX_DEVICES ? MAX_DEVICES : (size_t) count;
+    }
+
+    devs = (struct metrics_device *) calloc(n, sizeof(devs[0]));
+    if (devs == NULL) {
+        perror("calloc");
+        goto out;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (opts->num_idents != 0) {
+            devs[i].ident = opts->idents[i];
+        } else {
+            char *ident = (char *) malloc(BLADERF_SERIAL_LENGTH + 16);
+
+            if (ident == NULL) {
+                perror("malloc");
+                free(devs);
+                devs = NULL;
+                goto out;
+            }
+
+            snprintf(ident, BLADERF_SERIAL_LENGTH + 16, "*:serial=%s",
+                     list[i].serial);
+            devs[i].ident = ident;
+        }
+    }
+
+    *num_devs = n;
+
+out:
+    if (list != NULL) {
+        bladerf_free_device_list(list);
+    }
+
+    return devs;
+}
+
+static void free_devices(const struct options *opts,
+                         struct metrics_device *devs, size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        metrics_close(&devs[i]);
+
+        if (opts->num_idents == 0) {
+            free((char *) devs[i].ident);
+        }
+    }
+
+    free(devs);
+}
+
+static void scrape_all(struct text_buf *out, struct metrics_device *devs,
+                       size_t n)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        metrics_scrape(&devs[i]);
+    }
+
+    text_buf_clear(out);
+    metrics_format(out, devs, n);
+}
+
+static void sleep_ms(unsigned int ms)
+{
+#if BLADERF_OS_WINDOWS
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+/* Sleep for `seconds`, returning early if a signal is caught */
+static void wait_interval(double seconds)
+{
+    double waited = 0.0;
+
+    while (!caught_signal && waited < seconds) {
+        sleep_ms(100);
+        waited += 0.1;
+    }
+}
+
+/* Replace `path` with the buffer's contents, without readers ever seeing
+ * a partially written file */
+static int write_file(const char *path, const struct text_buf *text)
+{
+    char *tmp;
+    FILE *f;
+    int status = -1;
+    const size_t len = strlen(path) + 5;
+
+    tmp = (char *) malloc(len);
+    if (tmp == NULL) {
+        perror("malloc");
+        return -1;
+    }
+
+    snprintf(tmp, len, "%s.tmp", path);
+
+    f = fopen(tmp, "w");
+    if (f == NULL) {
+        fprintf(stderr, "Failed to open %s: %s\n", tmp, strerror(errno));
+        goto out;
+    }
+
+    if (fwrite(text->data, 1, text->len, f) != text->len) {
+        fprintf(stderr, "Failed to write %s: %s\n", tmp, strerror(errno));
+        fclose(f);
+        goto out;
+    }
+
+    if (fclose(f) != 0) {
+        fprintf(stderr, "Failed to write %s: %s\n", tmp, strerror(errno));
+        goto out;
+    }
+
+#if BLADERF_OS_WINDOWS
+    /* rename() does not replace an existing file here */
+    remove(path);
+#endif
+
+    if (rename(tmp, path) != 0) {
+        fprintf(stderr, "Failed to rename %s: %s\n", tmp, strerror(errno));
+        goto out;
+    }
+
+    status = 0;
+
+out:
+    free(tmp);
+    return status;
+}
+
+static int run_file(const struct options *opts, struct metrics_device *devs,
+                    size_t n, struct text_buf *text)
+{
+    while (!caught_signal) {
+        scrape_all(text, devs, n);
+
+        if (text->failed) {
+            fprintf(stderr, "Failed to allocate metrics text.\n");
+            return -1;
+        }
+
+        if (write_file(opts->output, text) != 0) {
+            return -1;
+        }
+
+        wait_interval(opts->interval_s);
+    }
+
+    return 0;
+}
+
+#if BLADERF_OS_WINDOWS
+static int run_http(const struct options *opts, struct metrics_device *devs,
+                    size_t n, struct text_buf *text)
+{
+    fprintf(stderr, "Serving metrics over HTTP is not supported on this "
+                    "platform. Use --output instead.\n");
+    return -1;
+}
+#else
+
+/* Bind a TCP socket to "[host:]port", where host may be "[address]" for
+ * IPv6 addresses */
+static int bind_tcp(const char *address)
+{
+    struct addrinfo hints, *res, *ai;
+    char host[256] = { 0 };
+    const char *port = strrchr(address, ':');
+    int fd = -1;
+    int one = 1;
+    int status;
+
+    if (port == NULL) {
+        port = address[0] != '\0' ? address : DEFAULT_HTTP_PORT;
+    } else if ((size_t) (port - address) < sizeof(host)) {
+        memcpy(host, address, (size_t) (port - address));
+        host[port - address] = '\0';
+        port++;
+    } else {
+        fprintf(stderr, "Invalid address: %s\n", address);
+        return -1;
+    }
+
+    if (host[0] == '[' && host[strlen(host) - 1] == ']') {
+        memmove(host, host + 1, strlen(host) - 2);
+        host[strlen(host) - 2] = '\0';
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    status = getaddrinfo(host[0] != '\0' ? host : NULL, port, &hints, &res);
+    if (status != 0) {
+        fprintf(stderr, "Failed to resolve %s: %s\n", address,
+                gai_strerror(status));
+        return -1;
+    }
+
+    for (ai = res; ai != NULL && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    freeaddrinfo(res);
+
+    if (fd < 0) {
+        fprintf(stderr, "Failed to bind to %s: %s\n", address,
+                strerror(errno));
+    }
+
+    return fd;
+}
+
+static void send_all(int fd, const char *data, size_t len)
+{
+    while (len != 0) {
+        const ssize_t n = send(fd, data, len, 0);
+
+        if (n <= 0) {
+            return;
+        }
+
+        data += n;
+        len -= (size_t) n;
+    }
+}
+
+static void send_response(int fd, const char *status, const char *type,
+                          const char *body, size_t len)
+{
+    char header[256];
+    const int n = snprintf(header, sizeof(header),
+                           "HTTP/1.1 %s\r\n"
+                           "Content-Type: %s\r\n"
+                           "Content-Length: %zu\r\n"
+                           "Connection: close\r\n\r\n",
+                           status, type, len);
+
+    send_all(fd, header, (size_t) n);
+    send_all(fd, body, len);
+}
+
+/* Read a request's header, and respond to it */
+static void handle_request(int fd, struct text_buf *text, bool *scrape,
+                           struct metrics_device *devs, size_t n)
+{
+    static const char not_found[] = "Metrics are served at /metrics\n";
+    char req[HTTP_REQUEST_MAX + 1];
+    size_t len = 0;
+    struct timeval tv;
+    bool head;
+
+    tv.tv_sec = HTTP_TIMEOUT_S;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    while (len < HTTP_REQUEST_MAX) {
+        const ssize_t r = recv(fd, req + len, HTTP_REQUEST_MAX - len, 0);
+
+        if (r <= 0) {
+            return;
+        }
+
+        len += (size_t) r;
+        req[len] = '\0';
+
+        if (strstr(req, "\r\n\r\n") != NULL) {
+            break;
+        }
+    }
+
+    req[len] = '\0';
+    head = strncmp(req, "HEAD ", 5) == 0;
+
+    if (strncmp(req, "GET ", 4) != 0 && !head) {
+        send_response(fd, "405 Method Not Allowed", "text/plain", "", 0);
+        return;
+    }
+
+    if (strncmp(req + (head ? 5 : 4), "/metrics", 8) != 0 ||
+        strchr(" ?", req[(head ? 5 : 4) + 8]) == NULL) {
+        send_response(fd, "404 Not Found", "text/plain",
+                      not_found, head ? 0 : sizeof(not_found) - 1);
+        return;
+    }
+
+    if (*scrape) {
+        scrape_all(text, devs, n);
+        *scrape = false;
+    }
+
+    if (text->failed) {
+        send_response(fd, "500 Internal Server Error", "text/plain", "", 0);
+        return;
+    }
+
+    send_response(fd, "200 OK",
+                  "application/openmetrics-text; version=1.0.0; "
+                  "charset=utf-8",
+                  text->data, head ? 0 : text->len);
+}
+
+static int run_http(const struct options *opts, struct metrics_device *devs,
+                    size_t n, struct text_buf *text)
+{
+    struct pollfd pfd;
+    double since_scrape;
+    bool scrape = true;
+    int fd;
+
+    fd = bind_tcp(opts->listen);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (listen(fd, 8) != 0) {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+
+    /* Results are reused by requests that arrive within the interval */
+    since_scrape = 0.0;
+
+    while (!caught_signal) {
+        int conn;
+
+        pfd.fd = fd;
+        pfd.events = POLLIN;
+
+        if (poll(&pfd, 1, 100) != 1) {
+            since_scrape += 0.1;
+            if (since_scrape >= opts->interval_s) {
+                scrape = true;
+            }
+            continue;
+        }
+
+        conn = accept(fd, NULL, NULL);
+        if (conn < 0) {
+            continue;
+        }
+
+        if (since_scrape >= opts->interval_s) {
+            scrape = true;
+        }
+
+        if (scrape) {
+            since_scrape = 0.0;
+        }
+
+        handle_request(conn, text, &scrape, devs, n);
+        close(conn);
+    }
+
+    close(fd);
+    return 0;
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+    struct options opts;
+    struct metrics_device *devs;
+    struct text_buf text;
+    size_t num_devs = 0;
+    int status;
+
+    if (get_options(argc, argv, &opts) != 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    bladerf_log_set_verbosity(opts.verbosity);
+
+    devs = get_devices(&opts, &num_devs);
+    if (devs == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+#if !BLADERF_OS_WINDOWS
+    /* A client closing its connection early should not end the process */
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    memset(&text, 0, sizeof(text));
+
+    if (opts.listen != NULL) {
+        status = run_http(&opts, devs, num_devs, &text);
+    } else if (opts.output != NULL) {
+        status = run_file(&opts, devs, num_devs, &text);
+    } else {
+        scrape_all(&text, devs, num_devs);
+        status = text.failed ? -1 : 0;
+
+        if (status == 0) {
+            fwrite(text.data, 1, text.len, stdout);
+        }
+    }
+
+    text_buf_free(&text);
+    free_devices(&opts, devs, num_devs);
+
+    return status == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
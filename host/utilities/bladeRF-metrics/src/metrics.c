@@ -0,0 +1,578 @@
+/*
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+#include "host_config.h"
+#include "metrics.h"
+
+#if BLADERF_OS_WINDOWS || BLADERF_OS_OSX
+#include "clock_gettime.h"
+#else
+#include <time.h>
+#endif
+
+void text_buf_printf(struct text_buf *b, const char *fmt, ...)
+{
+    va_list args;
+    int n;
+
+    if (b->failed) {
+        return;
+    }
+
+    while (true) {
+        const size_t avail = b->cap - b->len;
+
+        va_start(args, fmt);
+        n = vsnprintf(b->data != NULL ? b->data + b->len : NULL, avail,
+                      fmt, args);
+        va_end(args);
+
+        if (n < 0) {
+            b->failed = true;
+            return;
+        } else if ((size_t) n < avail) {
+            b->len += (size_t) n;
+            return;
+        } else {
+            const size_t cap = 2 * (b->cap + (size_t) n) + 1;
+            char *data = (char *) realloc(b->data, cap);
+
+            if (data == NULL) {
+                b->failed = true;
+                return;
+            }
+
+            b->data = data;
+            b->cap = cap;
+        }
+    }
+}
+
+void text_buf_clear(struct text_buf *b)
+{
+    b->len = 0;
+    b->failed = false;
+
+    if (b->data != NULL) {
+        b->data[0] = '\0';
+    }
+}
+
+void text_buf_free(struct text_buf *b)
+{
+    free(b->data);
+    memset(b, 0, sizeof(*b));
+}
+
+/* Features that the device's firmware, FPGA, or backend may lack. Their
+ * metrics are left out, rather than failing the scrape. */
+static bool is_unsupported(int status)
+{
+    return status == BLADERF_ERR_UNSUPPORTED ||
+           status == BLADERF_ERR_UPDATE_FPGA ||
+           status == BLADERF_ERR_UPDATE_FW;
+}
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_REALTIME, &ts) != 0) {
+        return 0.0;
+    }
+
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void metrics_close(struct metrics_device *d)
+{
+    if (d->dev != NULL) {
+        bladerf_close(d->dev);
+        d->dev = NULL;
+    }
+}
+
+void metrics_scrape(struct metrics_device *d)
+{
+    const double start = now_seconds();
+    int status = 0;
+
+    d->have_config = d->have_fx3 = d->have_fifo = d->have_net = false;
+
+    if (d->dev == NULL) {
+        status = bladerf_open(&d->dev, d->ident);
+        if (status != 0) {
+            d->dev = NULL;
+            goto out;
+        }
+
+        status = bladerf_get_serial(d->dev, d->serial);
+        if (status != 0) {
+            goto out;
+        }
+    }
+
+    /* Each of these is a single request, or a few batched ones, so that
+     * scrapes add little to the control path of a device in use */
+    status = bladerf_get_config_snapshot(d->dev, &d->config);
+    if (status == 0) {
+        d->have_config = true;
+    } else if (!is_unsupported(status)) {
+        goto out;
+    }
+
+    status = bladerf_get_fx3_stats(d->dev, &d->fx3, false);
+    if (status == 0) {
+        d->have_fx3 = true;
+    } else if (!is_unsupported(status)) {
+        goto out;
+    }
+
+    status = bladerf_get_fifo_levels(d->dev, &d->fifo);
+    if (status == 0) {
+        d->have_fifo = true;
+    } else if (!is_unsupported(status)) {
+        goto out;
+    }
+
+    status = bladerf_get_net_stats(d->dev, &d->net);
+    if (status == 0) {
+        d->have_net = true;
+    } else if (!is_unsupported(status)) {
+        goto out;
+    }
+
+    status = 0;
+
+out:
+    d->up = (status == 0);
+    d->scrape_seconds = now_seconds() - start;
+
+    if (status != 0) {
+        d->scrape_errors++;
+        fprintf(stderr, "Failed to scrape %s: %s\n",
+                d->ident, bladerf_strerror(status));
+
+        /* Reopen the device at the next scrape if it has gone away */
+        if (status == BLADERF_ERR_NODEV || status == BLADERF_ERR_IO) {
+            metrics_close(d);
+        }
+    }
+}
+
+/* Write the metadata lines that begin a metric family */
+static void family(struct text_buf *b, const char *name, const char *type,
+                   const char *unit, const char *help)
+{
+    text_buf_printf(b, "# TYPE %s %s\n", name, type);
+    if (unit != NULL) {
+        text_buf_printf(b, "# UNIT %s %s\n", name, unit);
+    }
+    text_buf_printf(b, "# HELP %s %s\n", name, help);
+}
+
+/* Write a label value, escaped as OpenMetrics requires */
+static void label_value(struct text_buf *b, const char *value)
+{
+    for (; *value != '\0'; value++) {
+        switch (*value) {
+            case '\\':
+                text_buf_printf(b, "\\\\");
+                break;
+
+            case '"':
+                text_buf_printf(b, "\\\"");
+                break;
+
+            case '\n':
+                text_buf_printf(b, "\\n");
+                break;
+
+            default:
+                text_buf_printf(b, "%c", *value);
+                break;
+        }
+    }
+}
+
+/* Write the start of a sample, up to its value. `labels` are any labels
+ * in addition to the device's, or NULL. */
+static void sample_name(struct text_buf *b, const char *name,
+                        const struct metrics_device *d, const char *labels)
+{
+    text_buf_printf(b, "%s{device=\"", name);
+    label_value(b, d->ident);
+    if (labels != NULL) {
+        text_buf_printf(b, "\",%s} ", labels);
+    } else {
+        text_buf_printf(b, "\"} ");
+    }
+}
+
+static void sample_u64(struct text_buf *b, const char *name,
+                       const struct metrics_device *d, const char *labels,
+                       uint64_t value)
+{
+    sample_name(b, name, d, labels);
+    text_buf_printf(b, "%" PRIu64 "\n", value);
+}
+
+static void sample_f64(struct text_buf *b, const char *name,
+                       const struct metrics_device *d, const char *labels,
+                       double value)
+{
+    sample_name(b, name, d, labels);
+    text_buf_printf(b, "%.9g\n", value);
+}
+
+static double rate_hz(const struct bladerf_rational_rate *rate)
+{
+    double hz = (double) rate->integer;
+
+    if (rate->den != 0) {
+        hz += (double) rate->num / (double) rate->den;
+    }
+
+    return hz;
+}
+
+static unsigned int lna_gain_db(bladerf_lna_gain gain)
+{
+    switch (gain) {
+        case BLADERF_LNA_GAIN_MAX:
+            return BLADERF_LNA_GAIN_MAX_DB;
+
+        case BLADERF_LNA_GAIN_MID:
+            return BLADERF_LNA_GAIN_MID_DB;
+
+        default:
+            return 0;
+    }
+}
+
+/* FX3 counters, which are reported as read, with a series for each module
+ * (and side of the DMA channel) that they are kept for */
+struct fx3_series {
+    const char *labels;
+    size_t offset;
+    bool wide;          /* uint64_t, rather than uint32_t */
+};
+
+struct fx3_family {
+    const char *name;
+    const char *unit;
+    const char *help;
+    unsigned int num_series;
+    struct fx3_series series[4];
+};
+
+#define FX3_FIELD(f)    offsetof(struct bladerf_fx3_stats, f)
+
+static const struct fx3_family fx3_families[] = {
+    {
+        "bladerf_fx3_bytes", "bytes",
+        "Sample bytes moved through the FX3's DMA channels",
+        4,
+        {
+            { "module=\"rx\",side=\"produced\"", FX3_FIELD(rx_prod_bytes),
+              true },
+            { "module=\"rx\",side=\"consumed\"", FX3_FIELD(rx_cons_bytes),
+              true },
+            { "module=\"tx\",side=\"produced\"", FX3_FIELD(tx_prod_bytes),
+              true },
+            { "module=\"tx\",side=\"consumed\"", FX3_FIELD(tx_cons_bytes),
+              true },
+        },
+    },
+    {
+        "bladerf_fx3_overruns", NULL,
+        "RX GPIF overruns, where the FX3's sample buffering was exhausted",
+        1,
+        { { "module=\"rx\"", FX3_FIELD(rx_overruns), false } },
+    },
+    {
+        "bladerf_fx3_underruns", NULL,
+        "TX GPIF underruns, where the FPGA requested samples that were "
+        "not yet available",
+        1,
+        { { "module=\"tx\"", FX3_FIELD(tx_underruns), false } },
+    },
+    {
+        "bladerf_fx3_dma_errors", NULL,
+        "FX3 DMA channel errors",
+        2,
+        {
+            { "module=\"rx\"", FX3_FIELD(rx_dma_errors), false },
+            { "module=\"tx\"", FX3_FIELD(tx_dma_errors), false },
+        },
+    },
+    {
+        "bladerf_fx3_pib_errors", NULL,
+        "FX3 P-port errors, other than GPIF state machine errors",
+        1,
+        { { NULL, FX3_FIELD(pib_errors), false } },
+    },
+    {
+        "bladerf_fx3_gpif_errors", NULL,
+        "FX3 GPIF state machine errors",
+        1,
+        { { NULL, FX3_FIELD(gpif_errors), false } },
+    },
+    {
+        "bladerf_fx3_flow_control", NULL,
+        "TX flow control events issued to the host for lack of a free "
+        "DMA buffer",
+        1,
+        { { "module=\"tx\"", FX3_FIELD(tx_ep_flow_control), false } },
+    },
+    {
+        "bladerf_fx3_endpoint_retries", NULL,
+        "SuperSpeed sample endpoint retries",
+        2,
+        {
+            { "module=\"rx\"", FX3_FIELD(rx_ep_retries), false },
+            { "module=\"tx\"", FX3_FIELD(tx_ep_retries), false },
+        },
+    },
+    {
+        "bladerf_fx3_endpoint_errors", NULL,
+        "Sample endpoint sequence and stream errors",
+        2,
+        {
+            { "module=\"rx\"", FX3_FIELD(rx_ep_errors), false },
+            { "module=\"tx\"", FX3_FIELD(tx_ep_errors), false },
+        },
+    },
+};
+
+static void format_fx3(struct text_buf *b, const struct metrics_device *devs,
+                       size_t n)
+{
+    char name[64];
+    size_t f, s, i;
+
+    for (f = 0; f < sizeof(fx3_families) / sizeof(fx3_families[0]); f++) {
+        const struct fx3_family *fam = &fx3_families[f];
+
+        family(b, fam->name, "counter", fam->unit, fam->help);
+        snprintf(name, sizeof(name), "%s_total", fam->name);
+
+        for (i = 0; i < n; i++) {
+            const uint8_t *fx3 = (const uint8_t *) &devs[i].fx3;
+
+            if (!devs[i].have_fx3) {
+                continue;
+            }
+
+            for (s = 0; s < fam->num_series; s++) {
+                const struct fx3_series *series = &fam->series[s];
+                uint64_t value;
+
+                if (series->wide) {
+                    memcpy(&value, fx3 + series->offset, sizeof(value));
+                } else {
+                    uint32_t value32;
+                    memcpy(&value32, fx3 + series->offset, sizeof(value32));
+                    value = value32;
+                }
+
+                sample_u64(b, name, &devs[i], series->labels, value);
+            }
+        }
+    }
+}
+
+static void format_config(struct text_buf *b,
+                          const struct metrics_device *devs, size_t n)
+{
+    size_t i;
+
+    family(b, "bladerf_frequency_hertz", "gauge", "hertz",
+           "Tuned frequency");
+    for (i = 0; i < n; i++) {
+        if (devs[i].have_config) {
+            sample_u64(b, "bladerf_frequency_hertz", &devs[i],
+                       "module=\"rx\"", devs[i].config.rx_frequency);
+            sample_u64(b, "bladerf_frequency_hertz", &devs[i],
+                       "module=\"tx\"", devs[i].config.tx_frequency);
+        }
+    }
+
+    family(b, "bladerf_bandwidth_hertz", "gauge", "hertz",
+           "LPF bandwidth");
+    for (i = 0; i < n; i++) {
+        if (devs[i].have_config) {
+            sample_u64(b, "bladerf_bandwidth_hertz", &devs[i],
+                       "module=\"rx\"", devs[i].config.rx_bandwidth);
+            sample_u64(b, "bladerf_bandwidth_hertz", &devs[i],
+                       "module=\"tx\"", devs[i].config.tx_bandwidth);
+        }
+    }
+
+    family(b, "bladerf_sample_rate_hertz", "gauge", "hertz",
+           "Sample rate");
+    for (i = 0; i < n; i++) {
+        if (devs[i].have_config) {
+            sample_f64(b, "bladerf_sample_rate_hertz", &devs[i],
+                       "module=\"rx\"", rate_hz(&devs[i].config.rx_samplerate));
+            sample_f64(b, "bladerf_sample_rate_hertz", &devs[i],
+                       "module=\"tx\"", rate_hz(&devs[i].config.tx_samplerate));
+        }
+    }
+
+    family(b, "bladerf_gain_decibels", "gauge", "decibels",
+           "Gain of each amplifier stage");
+    for (i = 0; i < n; i++) {
+        const struct bladerf_config_snapshot *c = &devs[i].config;
+
+        if (devs[i].have_config) {
+            sample_u64(b, "bladerf_gain_decibels", &devs[i],
+                       "stage=\"lna\"", lna_gain_db(c->lnagain));
+            sample_f64(b, "bladerf_gain_decibels", &devs[i],
+                       "stage=\"rxvga1\"", c->rxvga1);
+            sample_f64(b, "bladerf_gain_decibels", &devs[i],
+                       "stage=\"rxvga2\"", c->rxvga2);
+            sample_f64(b, "bladerf_gain_decibels", &devs[i],
+                       "stage=\"txvga1\"", c->txvga1);
+            sample_f64(b, "bladerf_gain_decibels", &devs[i],
+                       "stage=\"txvga2\"", c->txvga2);
+        }
+    }
+
+    family(b, "bladerf_vctcxo_trim", "gauge", NULL,
+           "VCTCXO trim DAC value");
+    for (i = 0; i < n; i++) {
+        if (devs[i].have_config) {
+            sample_u64(b, "bladerf_vctcxo_trim", &devs[i], NULL,
+                       devs[i].config.vctcxo_trim);
+        }
+    }
+}
+
+static void format_fifo(struct text_buf *b, const struct metrics_device *devs,
+                        size_t n)
+{
+    size_t i;
+
+    family(b, "bladerf_fifo_depth_words", "gauge", "words",
+           "Depth of the FPGA's sample FIFO");
+    for (i = 0; i < n; i++) {
+        if (devs[i].have_fifo) {
+            sample_u64(b, "bladerf_fifo_depth_words", &devs[i],
+                       "module=\"rx\"", devs[i].fifo.rx_depth);
+            sample_u64(b, "bladerf_fifo_depth_words", &devs[i],
+                       "module=\"tx\"", devs[i].fifo.tx_depth);
+        }
+    }
+
+    family(b, "bladerf_fifo_rx_high_water_words", "gauge", "words",
+           "Highest RX sample FIFO fill level since RX was last enabled");
+    for (i = 0; i < n; i++) {
+        if (devs[i].have_fifo) {
+            sample_u64(b, "bladerf_fifo_rx_high_water_words", &devs[i], NULL,
+                       devs[i].fifo.rx_high_water);
+        }
+    }
+
+    family(b, "bladerf_fifo_tx_low_water_words", "gauge", "words",
+           "Lowest TX sample FIFO fill level since TX was last enabled");
+    for (i = 0; i < n; i++) {
+        if (devs[i].have_fifo) {
+            sample_u64(b, "bladerf_fifo_tx_low_water_words", &devs[i], NULL,
+                       devs[i].fifo.tx_low_water);
+        }
+    }
+}
+
+static void format_net(struct text_buf *b, const struct metrics_device *devs,
+                       size_t n)
+{
+    size_t i;
+
+    family(b, "bladerf_net_requests", "counter", NULL,
+           "Control requests performed over the network backend");
+    for (i = 0; i < n; i++) {
+        if (devs[i].have_net) {
+            sample_u64(b, "bladerf_net_requests_total", &devs[i], NULL,
+                       devs[i].net.requests);
+        }
+    }
+
+    family(b, "bladerf_net_rtt_seconds", "gauge", "seconds",
+           "Round-trip time of network backend control requests");
+    for (i = 0; i < n; i++) {
+        if (devs[i].have_net) {
+            sample_f64(b, "bladerf_net_rtt_seconds", &devs[i],
+                       "stat=\"mean\"", devs[i].net.rtt_mean_us * 1e-6);
+            sample_f64(b, "bladerf_net_rtt_seconds", &devs[i],
+                       "stat=\"min\"", devs[i].net.rtt_min_us * 1e-6);
+            sample_f64(b, "bladerf_net_rtt_seconds", &devs[i],
+                       "stat=\"max\"", devs[i].net.rtt_max_us * 1e-6);
+        }
+    }
+}
+
+void metrics_format(struct text_buf *out, const struct metrics_device *devs,
+                    size_t n)
+{
+    size_t i;
+
+    family(out, "bladerf_device", "info", NULL, "Device identity");
+    for (i = 0; i < n; i++) {
+        if (devs[i].serial[0] != '\0') {
+            text_buf_printf(out, "bladerf_device_info{device=\"");
+            label_value(out, devs[i].ident);
+            text_buf_printf(out, "\",serial=\"");
+            label_value(out, devs[i].serial);
+            text_buf_printf(out, "\"} 1\n");
+        }
+    }
+
+    family(out, "bladerf_up", "gauge", NULL,
+           "Whether the device's latest scrape succeeded");
+    for (i = 0; i < n; i++) {
+        sample_u64(out, "bladerf_up", &devs[i], NULL, devs[i].up ? 1 : 0);
+    }
+
+    family(out, "bladerf_scrape_errors", "counter", NULL,
+           "Scrapes of the device that have failed");
+    for (i = 0; i < n; i++) {
+        sample_u64(out, "bladerf_scrape_errors_total", &devs[i], NULL,
+                   devs[i].scrape_errors);
+    }
+
+    family(out, "bladerf_scrape_duration_seconds", "gauge", "seconds",
+           "Time taken by the device's latest scrape");
+    for (i = 0; i < n; i++) {
+        sample_f64(out, "bladerf_scrape_duration_seconds", &devs[i], NULL,
+                   devs[i].scrape_seconds);
+    }
+
+    format_config(out, devs, n);
+    format_fx3(out, devs, n);
+    format_fifo(out, devs, n);
+    format_net(out, devs, n);
+
+    text_buf_printf(out, "# EOF\n");
+}
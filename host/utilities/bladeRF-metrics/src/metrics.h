@@ -0,0 +1,103 @@
+/*
+ * This file is part of the bladeRF project
+ *
+ * Copyright (C) 2015 Nuand LLC
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef METRICS_H__
+#define METRICS_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <libbladeRF.h>
+
+/* Growable text buffer that an exposition is written to */
+struct text_buf {
+    char *data;
+    size_t len;
+    size_t cap;
+    bool failed;        /* An allocation failed, and text has been lost */
+};
+
+/* A monitored device and the results of its latest scrape */
+struct metrics_device {
+    const char *ident;          /* Device identifier string */
+    struct bladerf *dev;        /* NULL while the device is not open */
+    char serial[BLADERF_SERIAL_LENGTH];
+
+    bool up;                    /* The latest scrape succeeded */
+    uint64_t scrape_errors;     /* Scrapes that have failed */
+    double scrape_seconds;      /* Duration of the latest scrape */
+
+    /* Each of these is only valid when its have_* flag is set, as the
+     * device's firmware, FPGA, or backend may not provide it */
+    bool have_config;
+    struct bladerf_config_snapshot config;
+
+    bool have_fx3;
+    struct bladerf_fx3_stats fx3;
+
+    bool have_fifo;
+    struct bladerf_fifo_levels fifo;
+
+    bool have_net;
+    struct bladerf_net_stats net;
+};
+
+/**
+ * Read a device's metrics, opening the device first if it is not open.
+ * The device is closed if it appears to have gone away, and is reopened by
+ * a later call.
+ *
+ * @param   d       Device to scrape
+ */
+void metrics_scrape(struct metrics_device *d);
+
+/**
+ * Close a device, if it is open
+ *
+ * @param   d       Device to close
+ */
+void metrics_close(struct metrics_device *d);
+
+/**
+ * Write the latest scrape results of all devices as an OpenMetrics text
+ * exposition, terminated by its "# EOF" line
+ *
+ * @param   out     Buffer to append to
+ * @param   devs    Devices
+ * @param   n       Number of devices
+ */
+void metrics_format(struct text_buf *out, const struct metrics_device *devs,
+                    size_t n);
+
+/**
+ * Append formatted text to a buffer
+ */
+void text_buf_printf(struct text_buf *b, const char *fmt, ...);
+
+/**
+ * Discard a buffer's text, retaining its allocation
+ */
+void text_buf_clear(struct text_buf *b);
+
+/**
+ * Free a buffer's allocation
+ */
+void text_buf_free(struct text_buf *b);
+
+#endif